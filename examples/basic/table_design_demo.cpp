@@ -25,7 +25,7 @@ TimeSeriesData generateStockData(int64_t timestamp, const std::string& symbol, d
     data.value = price;
     data.tags["symbol"] = symbol;
     data.tags["type"] = "trade";
-    data.fields["volume"] = std::to_string(std::rand() % 1000);
+    data.fields["volume"] = std::rand() % 1000;
     return data;
 }
 
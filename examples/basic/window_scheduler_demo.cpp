@@ -38,8 +38,8 @@ TimeSeriesData generateStockData(const std::string& symbol, int64_t timestamp) {
     data.timestamp = timestamp;
     data.tags = {{"symbol", symbol}, {"exchange", "NYSE"}};
     data.fields = {
-        {"price", std::to_string(price_dist(gen))},
-        {"volume", std::to_string(volume_dist(gen))}
+        {"price", price_dist(gen)},
+        {"volume", volume_dist(gen)}
     };
     
     return data;
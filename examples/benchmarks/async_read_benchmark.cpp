@@ -0,0 +1,186 @@
+/**
+ * @file async_read_benchmark.cpp
+ * @brief SSTable 批量异步读取基准测试
+ *
+ * 构造大量时间范围相互重叠的 L0 SSTable，然后执行覆盖全部文件的宽范围查询，
+ * 比较以下读取方式的延迟：
+ * 1. 同步 mmap 读取（默认）
+ * 2. 同步 pread 读取（关闭 mmap）
+ * 3. 线程池批量读取（AsyncReader::Backend::ThreadPool）
+ * 4. io_uring 批量读取（AsyncReader::Backend::IoUring，内核不支持时跳过）
+ *
+ * 每轮查询前用 posix_fadvise(DONTNEED) 尽量把文件移出页缓存，
+ * 以模拟冷数据读取。
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "sage_tsdb/core/async_reader.h"
+#include "sage_tsdb/core/lsm_tree.h"
+
+using namespace sage_tsdb;
+namespace fs = std::filesystem;
+
+// ============================================================================
+// 基准测试配置
+// ============================================================================
+
+struct BenchmarkConfig {
+    std::string data_dir = "./async_read_benchmark_data";
+    size_t num_files = 64;               // 重叠的 L0 文件数
+    size_t points_per_file = 20000;
+    size_t block_size_points = 1024;
+    size_t readahead_blocks = 8;
+    size_t queries = 5;                  // 每种读取方式的查询次数
+};
+
+struct ModeResult {
+    std::string name;
+    double avg_ms = 0.0;
+    double min_ms = 0.0;
+    size_t points = 0;
+};
+
+LSMConfig makeLsmConfig(const BenchmarkConfig& config) {
+    LSMConfig lsm;
+    lsm.data_dir = config.data_dir;
+    lsm.enable_compression = true;
+    lsm.block_size_points = config.block_size_points;
+    lsm.readahead_blocks = config.readahead_blocks;
+    lsm.enable_wal = false;
+    // 保持所有文件在 L0，使每次查询都要合并全部文件
+    lsm.level0_file_num_compaction_trigger = config.num_files * 2;
+    lsm.level0_slowdown_writes_trigger = config.num_files * 2;
+    lsm.level0_stop_writes_trigger = config.num_files * 2;
+    return lsm;
+}
+
+void buildData(const BenchmarkConfig& config) {
+    fs::remove_all(config.data_dir);
+    LSMTree tree(makeLsmConfig(config));
+
+    // 第 f 个文件写入时间戳 i * num_files + f，各文件覆盖同一时间范围
+    for (size_t f = 0; f < config.num_files; ++f) {
+        for (size_t i = 0; i < config.points_per_file; ++i) {
+            TimeSeriesData point;
+            point.timestamp = static_cast<int64_t>(i * config.num_files + f);
+            point.value = static_cast<double>(i) * 0.5 + static_cast<double>(f);
+            point.tags["sensor"] = "s" + std::to_string(f % 8);
+            tree.put(point.timestamp, point);
+        }
+        tree.flush();
+    }
+}
+
+void dropPageCache(const BenchmarkConfig& config) {
+    for (const auto& entry : fs::directory_iterator(config.data_dir)) {
+        if (entry.path().extension() != ".sst") continue;
+        int fd = ::open(entry.path().c_str(), O_RDONLY);
+        if (fd < 0) continue;
+        ::fdatasync(fd);
+        ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        ::close(fd);
+    }
+}
+
+ModeResult runMode(const BenchmarkConfig& config, const std::string& name, bool use_mmap,
+                   std::shared_ptr<AsyncReader> reader) {
+    LSMConfig lsm = makeLsmConfig(config);
+    lsm.use_mmap_reads = use_mmap;
+    lsm.async_reader = std::move(reader);
+    LSMTree tree(lsm);
+
+    ModeResult result;
+    result.name = name;
+    result.min_ms = 1e300;
+    int64_t end = static_cast<int64_t>(config.points_per_file * config.num_files);
+    for (size_t q = 0; q < config.queries; ++q) {
+        dropPageCache(config);
+        auto start = std::chrono::steady_clock::now();
+        size_t points = 0;
+        for (auto iter = tree.new_iterator(0, end); iter->valid(); iter->next()) {
+            ++points;
+        }
+        auto elapsed = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+        result.avg_ms += elapsed / static_cast<double>(config.queries);
+        result.min_ms = std::min(result.min_ms, elapsed);
+        result.points = points;
+    }
+    return result;
+}
+
+int main(int argc, char** argv) {
+    BenchmarkConfig config;
+
+    // 解析参数
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--data-dir" && i + 1 < argc) {
+            config.data_dir = argv[++i];
+        } else if (arg == "--files" && i + 1 < argc) {
+            config.num_files = std::stoul(argv[++i]);
+        } else if (arg == "--points" && i + 1 < argc) {
+            config.points_per_file = std::stoul(argv[++i]);
+        } else if (arg == "--block-size" && i + 1 < argc) {
+            config.block_size_points = std::stoul(argv[++i]);
+        } else if (arg == "--readahead" && i + 1 < argc) {
+            config.readahead_blocks = std::stoul(argv[++i]);
+        } else if (arg == "--queries" && i + 1 < argc) {
+            config.queries = std::max<size_t>(1, std::stoul(argv[++i]));
+        } else if (arg == "--help") {
+            std::cout << "Usage: " << argv[0] << " [options]\n"
+                      << "Options:\n"
+                      << "  --data-dir <path>    Scratch directory (removed afterwards)\n"
+                      << "  --files <n>          Overlapping SSTables (default 64)\n"
+                      << "  --points <n>         Points per SSTable (default 20000)\n"
+                      << "  --block-size <n>     Points per block (default 1024)\n"
+                      << "  --readahead <n>      Blocks per file per batch (default 8)\n"
+                      << "  --queries <n>        Queries per mode (default 5)\n"
+                      << "  --help               Show this help\n";
+            return 0;
+        }
+    }
+
+    std::cout << "[Configuration]\n";
+    std::cout << "  Files: " << config.num_files << ", Points/file: " << config.points_per_file
+              << ", Block size: " << config.block_size_points
+              << ", Readahead: " << config.readahead_blocks << "\n";
+
+    buildData(config);
+
+    std::vector<ModeResult> results;
+    results.push_back(runMode(config, "sync (mmap)", true, nullptr));
+    results.push_back(runMode(config, "sync (pread)", false, nullptr));
+    results.push_back(runMode(config, "thread_pool", false,
+                              AsyncReader::create(AsyncReader::Backend::ThreadPool)));
+    if (auto uring = AsyncReader::create(AsyncReader::Backend::IoUring)) {
+        results.push_back(runMode(config, "io_uring", false, uring));
+    } else {
+        std::cout << "[INFO] io_uring not available, skipped\n";
+    }
+
+    std::cout << "\n" << std::string(64, '=') << "\n";
+    std::cout << std::left << std::setw(16) << "Mode" << std::right
+              << std::setw(14) << "Avg (ms)" << std::setw(14) << "Min (ms)"
+              << std::setw(14) << "Points" << "\n";
+    std::cout << std::string(64, '-') << "\n";
+    for (const auto& result : results) {
+        std::cout << std::left << std::setw(16) << result.name << std::right << std::fixed
+                  << std::setprecision(2) << std::setw(14) << result.avg_ms
+                  << std::setw(14) << result.min_ms << std::setw(14) << result.points << "\n";
+    }
+    std::cout << std::string(64, '=') << "\n";
+
+    fs::remove_all(config.data_dir);
+    return 0;
+}
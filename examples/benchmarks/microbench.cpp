@@ -0,0 +1,296 @@
+/**
+ * @file microbench.cpp
+ * @brief 存储热路径微基准测试（Google Benchmark）
+ *
+ * 覆盖 MemTable::put、BloomFilter::might_contain、SSTable::get / range_query、
+ * TimeSeriesIndex::query（带 / 不带 tag 过滤）、WriteAheadLog::append 与
+ * WindowAggregator::process。各用例按数据量、序列数和乱序比例参数化，
+ * 同一组参数每次生成相同的数据（固定随机种子），结果可跨提交比较：
+ *
+ *   ./sage_tsdb_microbench --benchmark_out=base.json --benchmark_out_format=json
+ *   compare.py benchmarks base.json head.json   # Google Benchmark 自带的 tools/compare.py
+ */
+
+#include <algorithm>
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "sage_tsdb/algorithms/window_aggregator.h"
+#include "sage_tsdb/core/lsm_tree.h"
+#include "sage_tsdb/core/time_series_index.h"
+
+using namespace sage_tsdb;
+namespace fs = std::filesystem;
+
+namespace {
+
+// ============================================================================
+// 数据生成
+// ============================================================================
+
+constexpr int64_t kInterval = 10;           // 相邻点的时间间隔（毫秒）
+constexpr int64_t kMaxLateness = 1000;      // 乱序点最多提前的时间
+
+// points 个点轮流分布在 series 个序列上，时间戳按 kInterval 递增；
+// ooo_percent% 的点时间戳提前至多 kMaxLateness，模拟乱序到达
+std::vector<TimeSeriesData> makePoints(size_t points, size_t series, int64_t ooo_percent) {
+    std::mt19937_64 rng(42);
+    std::uniform_int_distribution<int64_t> percent(0, 99);
+    std::uniform_int_distribution<int64_t> lateness(1, kMaxLateness);
+
+    std::vector<std::string> names(series);
+    for (size_t s = 0; s < series; ++s) {
+        names[s] = "s" + std::to_string(s);
+    }
+
+    std::vector<TimeSeriesData> data;
+    data.reserve(points);
+    for (size_t i = 0; i < points; ++i) {
+        int64_t ts = static_cast<int64_t>(i) * kInterval;
+        if (percent(rng) < ooo_percent) {
+            ts = std::max<int64_t>(0, ts - lateness(rng));
+        }
+        TimeSeriesData point(ts, static_cast<double>(i % 1000) * 0.25);
+        point.tags["series"] = names[i % series];
+        point.tags["region"] = (i % 2 == 0) ? "east" : "west";
+        data.push_back(std::move(point));
+    }
+    return data;
+}
+
+int64_t endTimestamp(size_t points) {
+    return static_cast<int64_t>(points) * kInterval;
+}
+
+// 每个用例独占一个临时目录，结束时删除
+class ScratchDir {
+public:
+    explicit ScratchDir(const std::string& name)
+        : path_(fs::temp_directory_path() / ("sage_tsdb_microbench_" + name)) {
+        fs::remove_all(path_);
+        fs::create_directories(path_);
+    }
+    ~ScratchDir() {
+        std::error_code ec;
+        fs::remove_all(path_, ec);
+    }
+    std::string file(const std::string& name) const { return (path_ / name).string(); }
+
+private:
+    fs::path path_;
+};
+
+// 数据写入 MemTable 后取出，得到 SSTable 要求的（时间戳, 序列）顺序
+std::vector<TimeSeriesData> sortedForSSTable(const std::vector<TimeSeriesData>& data) {
+    MemTable memtable(SIZE_MAX);
+    for (const auto& point : data) {
+        memtable.put(point.timestamp, point);
+    }
+    return memtable.get_all();
+}
+
+void setCounters(benchmark::State& state, size_t items) {
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * items));
+}
+
+// ============================================================================
+// MemTable::put  参数：点数 / 序列数 / 乱序百分比
+// ============================================================================
+
+void BM_MemTablePut(benchmark::State& state) {
+    auto data = makePoints(state.range(0), state.range(1), state.range(2));
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto memtable = std::make_unique<MemTable>(SIZE_MAX);
+        state.ResumeTiming();
+        for (const auto& point : data) {
+            memtable->put(point.timestamp, point);
+        }
+        benchmark::DoNotOptimize(memtable->size());
+        state.PauseTiming();
+        memtable.reset();
+        state.ResumeTiming();
+    }
+    setCounters(state, data.size());
+}
+BENCHMARK(BM_MemTablePut)
+    ->ArgNames({"points", "series", "ooo_pct"})
+    ->ArgsProduct({{10000, 100000}, {1, 100}, {0, 20}})
+    ->Unit(benchmark::kMillisecond);
+
+// ============================================================================
+// BloomFilter::might_contain  参数：键数；一半查询命中、一半不命中
+// ============================================================================
+
+void BM_BloomFilterMightContain(benchmark::State& state) {
+    const size_t keys = static_cast<size_t>(state.range(0));
+    BloomFilter filter(keys * 10, 3);
+    for (size_t i = 0; i < keys; ++i) {
+        filter.add(static_cast<int64_t>(i) * 2);
+    }
+
+    int64_t key = 0;
+    const int64_t limit = static_cast<int64_t>(keys) * 2;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(filter.might_contain(key));
+        key = (key + 1 < limit) ? key + 1 : 0;
+    }
+    setCounters(state, 1);
+}
+BENCHMARK(BM_BloomFilterMightContain)
+    ->ArgName("keys")
+    ->Arg(10000)
+    ->Arg(1000000);
+
+// ============================================================================
+// SSTable::get / range_query  参数：点数 / 序列数 / 格式（1 行式，2 列式）
+// ============================================================================
+
+std::shared_ptr<SSTable> buildSSTable(const ScratchDir& dir, benchmark::State& state) {
+    SSTableOptions options;
+    options.format_version = static_cast<uint32_t>(state.range(2));
+    auto sstable = std::make_shared<SSTable>(dir.file("L0_1.sst"), 0, 1, options);
+    if (!sstable->build_from_memtable(
+            sortedForSSTable(makePoints(state.range(0), state.range(1), 0)))) {
+        state.SkipWithError("SSTable build failed");
+        return nullptr;
+    }
+    return sstable;
+}
+
+void BM_SSTableGet(benchmark::State& state) {
+    ScratchDir dir("sstable_get");
+    auto sstable = buildSSTable(dir, state);
+    if (!sstable) {
+        return;
+    }
+
+    // 点查询的时间戳在整个文件范围内均匀分布
+    std::mt19937_64 rng(7);
+    std::uniform_int_distribution<int64_t> index(0, state.range(0) - 1);
+    TimeSeriesData result;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(sstable->get(index(rng) * kInterval, result));
+    }
+    setCounters(state, 1);
+}
+BENCHMARK(BM_SSTableGet)
+    ->ArgNames({"points", "series", "format"})
+    ->ArgsProduct({{100000}, {1, 100}, {1, 2}});
+
+void BM_SSTableRangeQuery(benchmark::State& state) {
+    ScratchDir dir("sstable_range");
+    auto sstable = buildSSTable(dir, state);
+    if (!sstable) {
+        return;
+    }
+
+    // 每次查询文件中间 1% 的时间范围
+    const int64_t end = endTimestamp(state.range(0));
+    const int64_t start = end / 2;
+    const int64_t span = std::max<int64_t>(end / 100, kInterval);
+    size_t points = 0;
+    for (auto _ : state) {
+        auto results = sstable->range_query(start, start + span - 1);
+        points = results.size();
+        benchmark::DoNotOptimize(results.data());
+    }
+    setCounters(state, points);
+}
+BENCHMARK(BM_SSTableRangeQuery)
+    ->ArgNames({"points", "series", "format"})
+    ->ArgsProduct({{100000}, {1, 100}, {1, 2}})
+    ->Unit(benchmark::kMicrosecond);
+
+// ============================================================================
+// TimeSeriesIndex::query  参数：点数 / 序列数 / 乱序百分比 / 是否按 tag 过滤
+// ============================================================================
+
+void BM_TimeSeriesIndexQuery(benchmark::State& state) {
+    TimeSeriesIndex index;
+    index.add_batch(makePoints(state.range(0), state.range(1), state.range(2)));
+
+    // 查询中间 10% 的时间范围，可选只取一个序列
+    const int64_t end = endTimestamp(state.range(0));
+    QueryConfig config(TimeRange(end / 2, end / 2 + end / 10));
+    config.limit = 0;
+    if (state.range(3) != 0) {
+        config.filter_tags["series"] = "s0";
+    }
+
+    size_t points = 0;
+    for (auto _ : state) {
+        auto results = index.query(config);
+        points = results.size();
+        benchmark::DoNotOptimize(results.data());
+    }
+    setCounters(state, points);
+}
+BENCHMARK(BM_TimeSeriesIndexQuery)
+    ->ArgNames({"points", "series", "ooo_pct", "tags"})
+    ->ArgsProduct({{100000}, {1, 100}, {0, 20}, {0, 1}})
+    ->Unit(benchmark::kMicrosecond);
+
+// ============================================================================
+// WriteAheadLog::append  参数：每轮追加点数 / 序列数；不 fsync，只测编码与写入
+// ============================================================================
+
+void BM_WalAppend(benchmark::State& state) {
+    ScratchDir dir("wal");
+    WalOptions options;
+    options.sync_mode = WalSyncMode::None;
+    WriteAheadLog wal(dir.file("wal.log"), options);
+    auto data = makePoints(state.range(0), state.range(1), 0);
+
+    for (auto _ : state) {
+        for (const auto& point : data) {
+            wal.append(point.timestamp, point);
+        }
+        // 清空日志不计入耗时，避免文件随迭代无限增长
+        state.PauseTiming();
+        wal.clear();
+        state.ResumeTiming();
+    }
+    setCounters(state, data.size());
+}
+BENCHMARK(BM_WalAppend)
+    ->ArgNames({"points", "series"})
+    ->ArgsProduct({{10000}, {1, 100}})
+    ->Unit(benchmark::kMillisecond);
+
+// ============================================================================
+// WindowAggregator::process  参数：点数 / 乱序百分比 / 窗口类型（0 滚动，1 滑动）
+// ============================================================================
+
+void BM_WindowAggregatorProcess(benchmark::State& state) {
+    auto data = makePoints(state.range(0), 1, state.range(1));
+    AlgorithmConfig config;
+    config["window_size"] = "1000";
+    config["aggregation"] = "avg";
+    if (state.range(2) == 0) {
+        config["window_type"] = "tumbling";
+    } else {
+        config["window_type"] = "sliding";
+        config["slide_interval"] = "250";
+    }
+    WindowAggregator aggregator(config);
+
+    for (auto _ : state) {
+        auto windows = aggregator.process(data);
+        benchmark::DoNotOptimize(windows.data());
+    }
+    setCounters(state, data.size());
+}
+BENCHMARK(BM_WindowAggregatorProcess)
+    ->ArgNames({"points", "ooo_pct", "sliding"})
+    ->ArgsProduct({{100000}, {0, 20}, {0, 1}})
+    ->Unit(benchmark::kMillisecond);
+
+} // anonymous namespace
+
+BENCHMARK_MAIN();
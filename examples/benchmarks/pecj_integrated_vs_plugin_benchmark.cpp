@@ -31,6 +31,7 @@
  * 使用示例:
  *   ./pecj_integrated_vs_plugin_benchmark
  *   ./pecj_integrated_vs_plugin_benchmark --events 50000 --threads 8
+ *   ./pecj_integrated_vs_plugin_benchmark --operator SHJ --simd
  *   ./pecj_integrated_vs_plugin_benchmark --help
  *
  * @author sageTSDB Team
@@ -98,6 +99,7 @@ struct BenchmarkConfig {
     
     // Operator type
     std::string operator_type = "IMA";
+    bool enable_simd = false;         // Integrated mode: built-in hash join kernel (IAWJ/SHJ)
     
     // Output configuration
     bool verbose = true;
@@ -361,14 +363,14 @@ void generateTestData(std::vector<TimeSeriesData>& s_data,
         s.timestamp = i * 100;  // 100us interval
         s.tags["key"] = std::to_string(key_dist(rng));
         s.tags["stream"] = "S";
-        s.fields["value"] = std::to_string(value_dist(rng));
+        s.fields["value"] = value_dist(rng);
         s_data.push_back(s);
         
         TimeSeriesData r;
         r.timestamp = i * 100 + 50;  // Offset by 50us
         r.tags["key"] = std::to_string(key_dist(rng));
         r.tags["stream"] = "R";
-        r.fields["value"] = std::to_string(value_dist(rng));
+        r.fields["value"] = value_dist(rng);
         r_data.push_back(r);
     }
 }
@@ -423,6 +425,7 @@ BenchmarkResult runIntegratedModeBenchmark(
     pecj_config.watermark_time_ms = config.watermark_time_ms;
     pecj_config.lateness_ms = config.lateness_ms;
     pecj_config.join_sum=true;
+    pecj_config.enable_simd = config.enable_simd;
     
     compute::PECJComputeEngine engine;
     if (!engine.initialize(pecj_config, &db, nullptr)) {
@@ -846,15 +849,9 @@ BenchmarkResult runPluginModeBenchmark(
         
         pecj_adapter->restartOperator(static_cast<uint64_t>(local_min), effective_window_len);
         
-        // Feed all S tuples first
-        for (const auto& d : window_s_data) {
-            pecj_adapter->feedStreamS(d);
-        }
-        
-        // Then feed all R tuples
-        for (const auto& d : window_r_data) {
-            pecj_adapter->feedStreamR(d);
-        }
+        // Feed all S tuples first, then all R tuples, one batch each
+        pecj_adapter->feedStreamSBatch(window_s_data);
+        pecj_adapter->feedStreamRBatch(window_r_data);
         
         auto pure_compute_end = std::chrono::steady_clock::now();
         double window_pure_compute_time = std::chrono::duration<double, std::milli>(
@@ -1208,6 +1205,7 @@ void printUsage(const char* prog_name) {
               << "  --window-us N      Window length in microseconds (default: 10000)\n"
               << "  --slide-us N       Slide length in microseconds (default: 5000)\n"
               << "  --operator TYPE    Operator type: IMA, SHJ, etc. (default: IMA)\n"
+              << "  --simd             Integrated mode joins IAWJ/SHJ with the built-in hash join kernel\n"
               << "  --repeat N         Number of repetitions (default: 3)\n"
               << "  --output FILE      Output results to file\n"
               << "  --json FILE        Output results in JSON format for visualization\n"
@@ -1248,6 +1246,8 @@ int main(int argc, char** argv) {
             config.slide_len_us = std::stoull(argv[++i]);
         } else if (arg == "--operator" && i + 1 < argc) {
             config.operator_type = argv[++i];
+        } else if (arg == "--simd") {
+            config.enable_simd = true;
         } else if (arg == "--repeat" && i + 1 < argc) {
             config.repeat_count = std::stoi(argv[++i]);
         } else if (arg == "--output" && i + 1 < argc) {
@@ -1269,6 +1269,7 @@ int main(int argc, char** argv) {
     std::cout << "  Window Length    : " << (config.window_len_us / 1000.0) << " ms\n";
     std::cout << "  Slide Length     : " << (config.slide_len_us / 1000.0) << " ms\n";
     std::cout << "  Operator         : " << config.operator_type << "\n";
+    std::cout << "  Join Kernel      : " << (config.enable_simd ? "built-in hash join" : "PECJ operator") << "\n";
     std::cout << "  Repetitions      : " << config.repeat_count << "\n";
     std::cout << std::endl;
     
@@ -1291,7 +1292,7 @@ int main(int argc, char** argv) {
             d.timestamp = s_records[i].arrival_time;
             d.tags["key"] = std::to_string(s_records[i].key);
             d.tags["stream"] = "S";
-            d.fields["value"] = std::to_string(s_records[i].value);
+            d.fields["value"] = s_records[i].value;
             s_data.push_back(d);
         }
         for (size_t i = 0; i < std::min(r_records.size(), max_per_stream); i++) {
@@ -1299,7 +1300,7 @@ int main(int argc, char** argv) {
             d.timestamp = r_records[i].arrival_time;
             d.tags["key"] = std::to_string(r_records[i].key);
             d.tags["stream"] = "R";
-            d.fields["value"] = std::to_string(r_records[i].value);
+            d.fields["value"] = r_records[i].value;
             r_data.push_back(d);
         }
         
@@ -1495,6 +1496,7 @@ int main(int argc, char** argv) {
                 json_file << "    \"window_len_us\": " << config.window_len_us << ",\n";
                 json_file << "    \"slide_len_us\": " << config.slide_len_us << ",\n";
                 json_file << "    \"operator_type\": \"" << config.operator_type << "\",\n";
+                json_file << "    \"enable_simd\": " << (config.enable_simd ? "true" : "false") << ",\n";
                 json_file << "    \"repeat_count\": " << config.repeat_count << "\n";
                 json_file << "  },\n";
                 json_file << "  \"integrated_mode\": ";
@@ -0,0 +1,1040 @@
+/**
+ * @file tsdb_bench.cpp
+ * @brief 端到端混合负载基准测试（db_bench 风格）
+ *
+ * 按配置驱动真实形态的混合负载，报告各操作的吞吐量与延迟分位数：
+ * - 写入：序列基数、批大小、乱序比例与最大延迟
+ * - 查询：latest / range / tag_filtered / aggregate 四种形态，按权重混合
+ * - 读写比例：每个工作线程的每次操作以 read_fraction 的概率为查询
+ * - 闭环（closed）：操作背靠背执行；开环（open）：按 ingest_rate 或
+ *   ops_per_second 固定到达，延迟从计划开始时间算起（包含排队，避免协调遗漏）
+ * - PECJ 窗口 Join（需以 PECJ_MODE_INTEGRATED 构建）：独立线程向 S/R 流写入，
+ *   由 WindowScheduler 触发窗口计算
+ *
+ * 负载定义沿用 configs/ 下的配置格式：demo_configurations 中每一项是一个
+ * 命名负载（program 为 tsdb_bench），见 configs/tsdb_bench_configs.json。
+ * 命令行参数覆盖配置文件中的值。
+ *
+ * 以 -DENABLE_TRACING=ON 构建时，--trace <file> 记录窗口调度、PECJ 各阶段、
+ * flush/compaction 的 span，结束后写出 Chrome trace JSON（可用 ui.perfetto.dev 打开）。
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "sage_tsdb/core/table_manager.h"
+#include "sage_tsdb/core/trace.h"
+
+#ifdef PECJ_MODE_INTEGRATED
+#include "sage_tsdb/compute/pecj_compute_engine.h"
+#include "sage_tsdb/compute/window_scheduler.h"
+#include "sage_tsdb/core/resource_manager.h"
+#include "sage_tsdb/core/time_series_db.h"
+#endif
+
+using namespace sage_tsdb;
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+// ============================================================================
+// 最小 JSON 解析（只用于读取 configs/ 中的负载定义）
+// ============================================================================
+
+struct JsonValue {
+    enum class Type { Null, Bool, Number, String, Array, Object };
+    Type type = Type::Null;
+    bool boolean = false;
+    double number = 0.0;
+    std::string string;
+    std::vector<JsonValue> array;
+    std::map<std::string, JsonValue> object;
+
+    const JsonValue* find(const std::string& key) const {
+        if (type != Type::Object) {
+            return nullptr;
+        }
+        auto it = object.find(key);
+        return it == object.end() ? nullptr : &it->second;
+    }
+};
+
+class JsonParser {
+public:
+    explicit JsonParser(const std::string& text) : text_(text) {}
+
+    JsonValue parse() {
+        JsonValue value = parseValue();
+        skipSpace();
+        if (pos_ != text_.size()) {
+            fail("trailing characters");
+        }
+        return value;
+    }
+
+private:
+    [[noreturn]] void fail(const std::string& what) const {
+        throw std::runtime_error("JSON parse error at offset " + std::to_string(pos_) + ": " + what);
+    }
+
+    void skipSpace() {
+        while (pos_ < text_.size() && std::isspace(static_cast<unsigned char>(text_[pos_]))) {
+            pos_++;
+        }
+    }
+
+    bool consume(char c) {
+        skipSpace();
+        if (pos_ < text_.size() && text_[pos_] == c) {
+            pos_++;
+            return true;
+        }
+        return false;
+    }
+
+    void expect(char c) {
+        if (!consume(c)) {
+            fail(std::string("expected '") + c + "'");
+        }
+    }
+
+    JsonValue parseValue() {
+        skipSpace();
+        if (pos_ >= text_.size()) {
+            fail("unexpected end");
+        }
+        JsonValue value;
+        char c = text_[pos_];
+        if (c == '{') {
+            pos_++;
+            value.type = JsonValue::Type::Object;
+            if (consume('}')) {
+                return value;
+            }
+            do {
+                skipSpace();
+                std::string key = parseString();
+                expect(':');
+                value.object[key] = parseValue();
+            } while (consume(','));
+            expect('}');
+        } else if (c == '[') {
+            pos_++;
+            value.type = JsonValue::Type::Array;
+            if (consume(']')) {
+                return value;
+            }
+            do {
+                value.array.push_back(parseValue());
+            } while (consume(','));
+            expect(']');
+        } else if (c == '"') {
+            value.type = JsonValue::Type::String;
+            value.string = parseString();
+        } else if (text_.compare(pos_, 4, "true") == 0) {
+            pos_ += 4;
+            value.type = JsonValue::Type::Bool;
+            value.boolean = true;
+        } else if (text_.compare(pos_, 5, "false") == 0) {
+            pos_ += 5;
+            value.type = JsonValue::Type::Bool;
+        } else if (text_.compare(pos_, 4, "null") == 0) {
+            pos_ += 4;
+        } else {
+            size_t end = pos_;
+            while (end < text_.size() && std::strchr("+-0123456789.eE", text_[end]) != nullptr) {
+                end++;
+            }
+            if (end == pos_) {
+                fail("unexpected character");
+            }
+            value.type = JsonValue::Type::Number;
+            value.number = std::stod(text_.substr(pos_, end - pos_));
+            pos_ = end;
+        }
+        return value;
+    }
+
+    std::string parseString() {
+        if (pos_ >= text_.size() || text_[pos_] != '"') {
+            fail("expected string");
+        }
+        pos_++;
+        std::string out;
+        while (pos_ < text_.size() && text_[pos_] != '"') {
+            char c = text_[pos_++];
+            if (c == '\\' && pos_ < text_.size()) {
+                char escaped = text_[pos_++];
+                switch (escaped) {
+                    case 'n': out += '\n'; break;
+                    case 't': out += '\t'; break;
+                    case 'u': out += '?'; pos_ = std::min(pos_ + 4, text_.size()); break;
+                    default: out += escaped; break;
+                }
+            } else {
+                out += c;
+            }
+        }
+        if (pos_ >= text_.size()) {
+            fail("unterminated string");
+        }
+        pos_++;
+        return out;
+    }
+
+    const std::string& text_;
+    size_t pos_ = 0;
+};
+
+// ============================================================================
+// 负载配置
+// ============================================================================
+
+struct QueryMix {
+    double latest = 1.0;                 // 各查询形态的权重
+    double range = 1.0;
+    double tag_filtered = 1.0;
+    double aggregate = 1.0;
+    int64_t range_ms = 60000;            // range / tag_filtered / aggregate 覆盖最近多少毫秒
+    int64_t aggregate_window_ms = 1000;  // aggregate 的窗口宽度
+    size_t latest_n = 10;
+};
+
+struct PecjWorkload {
+    bool enabled = false;
+    std::string op = "IAWJ";
+    int64_t window_len_ms = 1000;
+    int64_t slide_len_ms = 500;
+    size_t threads = 2;
+    size_t keys = 100;                   // Join 键基数
+    double events_per_second = 20000;    // S 与 R 合计
+    std::string trigger = "watermark";   // watermark / hybrid / count
+    size_t trigger_count = 1000;         // hybrid / count 的触发条数
+};
+
+struct BenchConfig {
+    std::string name = "default";
+    std::string description = "mixed ingest and query";
+    std::string data_dir = "./tsdb_bench_data";
+    size_t memory_mb = 0;                // 全局 MemTable 预算（0 表示不限制）
+    bool keep_data = false;
+
+    double duration_s = 10.0;
+    size_t threads = 4;
+    bool open_loop = false;
+    size_t series = 1000;                // 序列基数（host 标签取值数）
+    size_t regions = 8;                  // region 标签取值数（aggregate 按其分组）
+    size_t batch_size = 100;
+    double ingest_rate = 0;              // 开环写入速率（点/秒，所有线程合计）
+    double ops_per_second = 0;           // 开环操作速率；为 0 时由 ingest_rate 推出
+    double read_fraction = 0.2;
+    double out_of_order = 0.05;          // 乱序点比例
+    int64_t max_lateness_ms = 5000;
+    size_t preload_points = 100000;      // 开始计时前写入的点数，使查询有数据可读
+    uint64_t seed = 42;
+
+    QueryMix queries;
+    PecjWorkload pecj;
+};
+
+double numberOr(const JsonValue& section, const char* key, double fallback) {
+    const JsonValue* value = section.find(key);
+    return value && value->type == JsonValue::Type::Number ? value->number : fallback;
+}
+
+bool boolOr(const JsonValue& section, const char* key, bool fallback) {
+    const JsonValue* value = section.find(key);
+    return value && value->type == JsonValue::Type::Bool ? value->boolean : fallback;
+}
+
+std::string stringOr(const JsonValue& section, const char* key, const std::string& fallback) {
+    const JsonValue* value = section.find(key);
+    return value && value->type == JsonValue::Type::String ? value->string : fallback;
+}
+
+void applyJson(const JsonValue& entry, BenchConfig& config) {
+    config.description = stringOr(entry, "description", config.description);
+
+    if (const JsonValue* storage = entry.find("storage")) {
+        config.data_dir = stringOr(*storage, "data_dir", config.data_dir);
+        config.memory_mb = static_cast<size_t>(numberOr(*storage, "memory_mb", config.memory_mb));
+        config.keep_data = boolOr(*storage, "keep_data", config.keep_data);
+    }
+    if (const JsonValue* workload = entry.find("workload")) {
+        const JsonValue& w = *workload;
+        config.duration_s = numberOr(w, "duration_s", config.duration_s);
+        config.threads = static_cast<size_t>(numberOr(w, "threads", config.threads));
+        config.open_loop = stringOr(w, "mode", config.open_loop ? "open" : "closed") == "open";
+        config.series = static_cast<size_t>(numberOr(w, "series", config.series));
+        config.regions = static_cast<size_t>(numberOr(w, "regions", config.regions));
+        config.batch_size = static_cast<size_t>(numberOr(w, "batch_size", config.batch_size));
+        config.ingest_rate = numberOr(w, "ingest_rate", config.ingest_rate);
+        config.ops_per_second = numberOr(w, "ops_per_second", config.ops_per_second);
+        config.read_fraction = numberOr(w, "read_fraction", config.read_fraction);
+        config.out_of_order = numberOr(w, "out_of_order", config.out_of_order);
+        config.max_lateness_ms = static_cast<int64_t>(numberOr(w, "max_lateness_ms", config.max_lateness_ms));
+        config.preload_points = static_cast<size_t>(numberOr(w, "preload_points", config.preload_points));
+        config.seed = static_cast<uint64_t>(numberOr(w, "seed", static_cast<double>(config.seed)));
+    }
+    if (const JsonValue* queries = entry.find("queries")) {
+        QueryMix& q = config.queries;
+        q.latest = numberOr(*queries, "latest", q.latest);
+        q.range = numberOr(*queries, "range", q.range);
+        q.tag_filtered = numberOr(*queries, "tag_filtered", q.tag_filtered);
+        q.aggregate = numberOr(*queries, "aggregate", q.aggregate);
+        q.range_ms = static_cast<int64_t>(numberOr(*queries, "range_ms", q.range_ms));
+        q.aggregate_window_ms = static_cast<int64_t>(
+            numberOr(*queries, "aggregate_window_ms", q.aggregate_window_ms));
+        q.latest_n = static_cast<size_t>(numberOr(*queries, "latest_n", q.latest_n));
+    }
+    // 与 demo_configs.json 的 pecj 小节同名：operator / window_len_ms / slide_len_ms / threads
+    if (const JsonValue* pecj = entry.find("pecj")) {
+        PecjWorkload& p = config.pecj;
+        p.enabled = boolOr(*pecj, "enabled", true);
+        p.op = stringOr(*pecj, "operator", p.op);
+        p.window_len_ms = static_cast<int64_t>(numberOr(*pecj, "window_len_ms", p.window_len_ms));
+        p.slide_len_ms = static_cast<int64_t>(numberOr(*pecj, "slide_len_ms", p.slide_len_ms));
+        p.threads = static_cast<size_t>(numberOr(*pecj, "threads", p.threads));
+        p.keys = static_cast<size_t>(numberOr(*pecj, "keys", p.keys));
+        p.events_per_second = numberOr(*pecj, "events_per_second", p.events_per_second);
+        p.trigger = stringOr(*pecj, "trigger", p.trigger);
+        p.trigger_count = static_cast<size_t>(numberOr(*pecj, "trigger_count", p.trigger_count));
+    }
+}
+
+JsonValue loadJson(const std::string& path) {
+    std::ifstream in(path);
+    if (!in.is_open()) {
+        throw std::runtime_error("Failed to open config: " + path);
+    }
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    std::string text = buffer.str();
+    return JsonParser(text).parse();
+}
+
+// ============================================================================
+// 延迟统计
+// ============================================================================
+
+enum Op { kWrite, kLatest, kRange, kTagFiltered, kAggregate, kJoinIngest, kWindowJoin, kNumOps };
+
+const char* const kOpNames[kNumOps] = {
+    "write", "latest", "range", "tag_filtered", "aggregate", "join_ingest", "window_join"};
+
+struct OpStats {
+    std::vector<double> latencies_us;
+    uint64_t points = 0;                 // 写入的点数或查询返回的点数
+    uint64_t errors = 0;
+
+    void merge(OpStats&& other) {
+        latencies_us.insert(latencies_us.end(), other.latencies_us.begin(), other.latencies_us.end());
+        points += other.points;
+        errors += other.errors;
+    }
+};
+
+using ThreadStats = std::vector<OpStats>;
+
+double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    size_t rank = static_cast<size_t>(std::ceil(p * static_cast<double>(sorted.size())));
+    return sorted[std::min(sorted.size() - 1, rank > 0 ? rank - 1 : 0)];
+}
+
+// ============================================================================
+// 负载生成
+// ============================================================================
+
+class Workload {
+public:
+    Workload(const BenchConfig& config, TableManager& tables, Clock::time_point epoch, uint64_t seed)
+        : config_(config), tables_(tables), table_(tables.getStreamTable("bench")),
+          epoch_(epoch), rng_(seed), unit_(0.0, 1.0),
+          series_(0, std::max<size_t>(1, config.series) - 1),
+          lateness_(1, std::max<int64_t>(1, config.max_lateness_ms)) {
+        const QueryMix& q = config.queries;
+        double weights[] = {q.latest, q.range, q.tag_filtered, q.aggregate};
+        double total = 0;
+        for (double w : weights) {
+            total += std::max(0.0, w);
+            cumulative_.push_back(total);
+        }
+        if (total <= 0) {
+            cumulative_ = {1, 1, 1, 1};   // 全部权重为 0 时只做 latest
+        }
+        batch_.reserve(config.batch_size);
+    }
+
+    // 事件时间取自墙钟（毫秒），乱序点提前至多 max_lateness_ms
+    int64_t now() const {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - epoch_).count() +
+               kBaseTimestamp;
+    }
+
+    size_t write(ThreadStats& stats) {
+        batch_.clear();
+        int64_t ts = now();
+        for (size_t i = 0; i < config_.batch_size; ++i) {
+            size_t series = series_(rng_);
+            int64_t point_ts = ts;
+            if (unit_(rng_) < config_.out_of_order) {
+                point_ts -= lateness_(rng_);
+            }
+            TimeSeriesData point(point_ts, 20.0 + 10.0 * unit_(rng_));
+            point.tags["host"] = "h" + std::to_string(series);
+            point.tags["region"] = "r" + std::to_string(series % std::max<size_t>(1, config_.regions));
+            batch_.push_back(std::move(point));
+        }
+        table_->insertBatch(std::move(batch_));
+        batch_ = std::vector<TimeSeriesData>();
+        batch_.reserve(config_.batch_size);
+        stats[kWrite].points += config_.batch_size;
+        return config_.batch_size;
+    }
+
+    Op pickQuery() {
+        double r = unit_(rng_) * cumulative_.back();
+        for (size_t i = 0; i < cumulative_.size(); ++i) {
+            if (r < cumulative_[i]) {
+                return static_cast<Op>(kLatest + i);
+            }
+        }
+        return kLatest;
+    }
+
+    void query(Op op, ThreadStats& stats) {
+        const QueryMix& q = config_.queries;
+        int64_t end = now();
+        QueryConfig query(TimeRange(end - q.range_ms, end));
+        query.limit = 0;
+        size_t results = 0;
+        try {
+            switch (op) {
+                case kLatest:
+                    results = table_->queryLatest(q.latest_n).size();
+                    break;
+                case kRange:
+                    results = tables_.query("bench", query).size();
+                    break;
+                case kTagFiltered:
+                    query.filter_tags["host"] = "h" + std::to_string(series_(rng_));
+                    results = tables_.query("bench", query).size();
+                    break;
+                case kAggregate:
+                    query.aggregation = AggregationType::AVG;
+                    query.window_size = q.aggregate_window_ms;
+                    query.group_by = {"region"};
+                    results = tables_.query("bench", query).size();
+                    break;
+                default:
+                    break;
+            }
+        } catch (const std::exception&) {
+            stats[op].errors++;
+        }
+        stats[op].points += results;
+    }
+
+    bool nextIsRead() { return unit_(rng_) < config_.read_fraction; }
+
+    static constexpr int64_t kBaseTimestamp = 1700000000000;
+
+private:
+    const BenchConfig& config_;
+    TableManager& tables_;
+    std::shared_ptr<StreamTable> table_;
+    Clock::time_point epoch_;
+    std::mt19937_64 rng_;
+    std::uniform_real_distribution<double> unit_;
+    std::uniform_int_distribution<size_t> series_;
+    std::uniform_int_distribution<int64_t> lateness_;
+    std::vector<double> cumulative_;
+    std::vector<TimeSeriesData> batch_;
+};
+
+double elapsedUs(Clock::time_point from, Clock::time_point to) {
+    return std::chrono::duration<double, std::micro>(to - from).count();
+}
+
+// 闭环：操作背靠背执行；开环：按 interval 固定到达，延迟从计划时间算起
+void runWorker(const BenchConfig& config, TableManager& tables, Clock::time_point epoch,
+               Clock::time_point start, Clock::time_point deadline, double ops_per_thread,
+               size_t worker, ThreadStats& stats) {
+    Workload workload(config, tables, epoch, config.seed + 1000 * (worker + 1));
+    const bool paced = config.open_loop && ops_per_thread > 0;
+    const auto interval = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(paced ? 1.0 / ops_per_thread : 0.0));
+    // 各线程错开起点，避免同时到达
+    Clock::time_point scheduled = start + interval * worker / std::max<size_t>(1, config.threads);
+
+    while (true) {
+        Clock::time_point begin;
+        if (paced) {
+            if (scheduled >= deadline) {
+                break;
+            }
+            std::this_thread::sleep_until(scheduled);
+            begin = scheduled;
+            scheduled += interval;
+        } else {
+            begin = Clock::now();
+            if (begin >= deadline) {
+                break;
+            }
+        }
+
+        Op op = kWrite;
+        if (workload.nextIsRead()) {
+            op = workload.pickQuery();
+            workload.query(op, stats);
+        } else {
+            workload.write(stats);
+        }
+        stats[op].latencies_us.push_back(elapsedUs(begin, Clock::now()));
+    }
+}
+
+// ============================================================================
+// PECJ 窗口 Join 负载
+// ============================================================================
+
+#ifdef PECJ_MODE_INTEGRATED
+
+class JoinWorkload {
+public:
+    JoinWorkload(const BenchConfig& config, TableManager& tables)
+        : config_(config), tables_(tables) {}
+
+    bool start(Clock::time_point deadline) {
+        const PecjWorkload& p = config_.pecj;
+        tables_.createStreamTable("stream_s");
+        tables_.createStreamTable("stream_r");
+        tables_.createJoinResultTable("join_results");
+        db_.createTable("stream_s");
+        db_.createTable("stream_r");
+
+        resources_ = core::createResourceManager();
+        core::ResourceRequest request;
+        request.requested_threads = static_cast<int>(std::max<size_t>(1, p.threads));
+        handle_ = resources_->allocate("tsdb_bench", request);
+        if (!handle_) {
+            std::cerr << "[ERROR] Failed to allocate PECJ resources" << std::endl;
+            return false;
+        }
+
+        compute::ComputeConfig compute_config;
+        compute_config.window_len_us = static_cast<uint64_t>(p.window_len_ms) * 1000;
+        compute_config.slide_len_us = static_cast<uint64_t>(p.slide_len_ms) * 1000;
+        compute_config.operator_type = p.op;
+        compute_config.max_threads = static_cast<int>(p.threads);
+        compute_config.enable_simd = true;   // IAWJ / SHJ 走内置 Join 内核，无 PECJ 库时也精确计数
+        if (!engine_.initialize(compute_config, &db_, handle_.get())) {
+            std::cerr << "[ERROR] Failed to initialize PECJ compute engine" << std::endl;
+            return false;
+        }
+
+        compute::WindowSchedulerConfig scheduler_config;
+        scheduler_config.window_type = p.slide_len_ms < p.window_len_ms
+                                           ? compute::WindowType::Sliding
+                                           : compute::WindowType::Tumbling;
+        scheduler_config.window_len_us = compute_config.window_len_us;
+        scheduler_config.slide_len_us = compute_config.slide_len_us;
+        // 计数触发的窗口提前完成，之后落入的元组按迟到数据增量重算
+        scheduler_config.trigger_policy = p.trigger == "count"    ? compute::TriggerPolicy::CountBased
+                                          : p.trigger == "hybrid" ? compute::TriggerPolicy::Hybrid
+                                                                  : compute::TriggerPolicy::Watermark;
+        scheduler_config.trigger_count_threshold = p.trigger_count;
+        scheduler_config.max_concurrent_windows = std::max<size_t>(1, p.threads);
+        scheduler_ = std::make_unique<compute::WindowScheduler>(
+            scheduler_config, &engine_, &tables_, handle_.get());
+        scheduler_->onWindowCompleted(
+            [this](const compute::WindowInfo&, const compute::ComputeStatus& status) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                windows_.latencies_us.push_back(status.computation_time_ms * 1000.0);
+                windows_.points += status.join_count;
+            });
+        scheduler_->onWindowFailed(
+            [this](const compute::WindowInfo&, const compute::ComputeStatus&) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                windows_.errors++;
+            });
+        scheduler_->watchTable("stream_s", 0);
+        scheduler_->watchTable("stream_r", 1);
+        if (!scheduler_->start()) {
+            std::cerr << "[ERROR] Failed to start WindowScheduler" << std::endl;
+            return false;
+        }
+        feeder_ = std::thread([this, deadline]() { feed(deadline); });
+        return true;
+    }
+
+    // 等待写入线程结束，补齐未触发的窗口后停止调度器
+    void finish(ThreadStats& stats) {
+        if (feeder_.joinable()) {
+            feeder_.join();
+        }
+        if (scheduler_) {
+            scheduler_->triggerPendingWindows();
+            scheduler_->stop(true);
+            metrics_ = scheduler_->getMetrics();
+        }
+        stats[kJoinIngest].merge(std::move(ingest_));
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats[kWindowJoin].merge(std::move(windows_));
+    }
+
+    const compute::SchedulingMetrics& metrics() const { return metrics_; }
+
+private:
+    // S、R 交替写入，开环到达；时间戳为微秒，与窗口参数一致
+    void feed(Clock::time_point deadline) {
+        const PecjWorkload& p = config_.pecj;
+        std::mt19937_64 rng(config_.seed + 7);
+        std::uniform_int_distribution<size_t> key(0, std::max<size_t>(1, p.keys) - 1);
+        auto s_table = tables_.getStreamTable("stream_s");
+        auto r_table = tables_.getStreamTable("stream_r");
+        const auto interval = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(1.0 / std::max(1.0, p.events_per_second)));
+        const Clock::time_point start = Clock::now();
+        Clock::time_point scheduled = start;
+        for (uint64_t i = 0; scheduled < deadline; ++i, scheduled += interval) {
+            std::this_thread::sleep_until(scheduled);
+            TimeSeriesData tuple;
+            tuple.timestamp = static_cast<int64_t>(elapsedUs(start, scheduled));
+            tuple.tags["key"] = std::to_string(key(rng));
+            tuple.value = 1.0;
+            bool is_s = (i % 2 == 0);
+            db_.insert(is_s ? "stream_s" : "stream_r", tuple);
+            (is_s ? s_table : r_table)->insert(tuple);
+            ingest_.latencies_us.push_back(elapsedUs(scheduled, Clock::now()));
+            ingest_.points++;
+        }
+    }
+
+    const BenchConfig& config_;
+    TableManager& tables_;
+    TimeSeriesDB db_;                    // PECJComputeEngine 从 TimeSeriesDB 读取窗口数据
+    std::shared_ptr<core::ResourceManager> resources_;
+    std::shared_ptr<core::ResourceHandle> handle_;
+    compute::PECJComputeEngine engine_;
+    std::unique_ptr<compute::WindowScheduler> scheduler_;
+    std::thread feeder_;
+    std::mutex mutex_;
+    OpStats ingest_;
+    OpStats windows_;
+    compute::SchedulingMetrics metrics_;
+};
+
+#endif // PECJ_MODE_INTEGRATED
+
+// ============================================================================
+// 报告
+// ============================================================================
+
+struct OpReport {
+    std::string name;
+    uint64_t count = 0;
+    uint64_t points = 0;
+    uint64_t errors = 0;
+    double ops_per_second = 0;
+    double points_per_second = 0;
+    double p50_ms = 0, p95_ms = 0, p99_ms = 0, p999_ms = 0, max_ms = 0;
+};
+
+std::vector<OpReport> buildReports(ThreadStats& totals, double seconds) {
+    std::vector<OpReport> reports;
+    for (int op = 0; op < kNumOps; ++op) {
+        auto& latencies = totals[op].latencies_us;
+        if (latencies.empty() && totals[op].errors == 0) {
+            continue;
+        }
+        std::sort(latencies.begin(), latencies.end());
+        OpReport report;
+        report.name = kOpNames[op];
+        report.count = latencies.size();
+        report.points = totals[op].points;
+        report.errors = totals[op].errors;
+        report.ops_per_second = static_cast<double>(report.count) / seconds;
+        report.points_per_second = static_cast<double>(report.points) / seconds;
+        report.p50_ms = percentile(latencies, 0.50) / 1000.0;
+        report.p95_ms = percentile(latencies, 0.95) / 1000.0;
+        report.p99_ms = percentile(latencies, 0.99) / 1000.0;
+        report.p999_ms = percentile(latencies, 0.999) / 1000.0;
+        report.max_ms = latencies.empty() ? 0.0 : latencies.back() / 1000.0;
+        reports.push_back(report);
+    }
+    return reports;
+}
+
+void printReports(const std::vector<OpReport>& reports) {
+    std::cout << "\n" << std::string(110, '=') << "\n";
+    std::cout << std::left << std::setw(14) << "Operation" << std::right
+              << std::setw(10) << "Count" << std::setw(12) << "Ops/s"
+              << std::setw(14) << "Points/s" << std::setw(10) << "p50 ms"
+              << std::setw(10) << "p95 ms" << std::setw(10) << "p99 ms"
+              << std::setw(11) << "p99.9 ms" << std::setw(11) << "max ms"
+              << std::setw(8) << "Errors" << "\n";
+    std::cout << std::string(110, '-') << "\n";
+    for (const auto& r : reports) {
+        std::cout << std::left << std::setw(14) << r.name << std::right << std::fixed
+                  << std::setw(10) << r.count
+                  << std::setw(12) << std::setprecision(1) << r.ops_per_second
+                  << std::setw(14) << std::setprecision(0) << r.points_per_second
+                  << std::setprecision(3)
+                  << std::setw(10) << r.p50_ms << std::setw(10) << r.p95_ms
+                  << std::setw(10) << r.p99_ms << std::setw(11) << r.p999_ms
+                  << std::setw(11) << r.max_ms << std::setw(8) << r.errors << "\n";
+    }
+    std::cout << std::string(110, '=') << "\n";
+}
+
+std::string jsonEscape(const std::string& text) {
+    std::string out;
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+        }
+        out += c;
+    }
+    return out;
+}
+
+bool writeJson(const std::string& path, const BenchConfig& config, double seconds,
+               const std::vector<OpReport>& reports) {
+    std::ofstream out(path);
+    if (!out.is_open()) {
+        return false;
+    }
+    out << "{\n";
+    out << "  \"workload\": \"" << jsonEscape(config.name) << "\",\n";
+    out << "  \"mode\": \"" << (config.open_loop ? "open" : "closed") << "\",\n";
+    out << "  \"duration_s\": " << seconds << ",\n";
+    out << "  \"threads\": " << config.threads << ",\n";
+    out << "  \"series\": " << config.series << ",\n";
+    out << "  \"batch_size\": " << config.batch_size << ",\n";
+    out << "  \"read_fraction\": " << config.read_fraction << ",\n";
+    out << "  \"out_of_order\": " << config.out_of_order << ",\n";
+    out << "  \"operations\": [\n";
+    for (size_t i = 0; i < reports.size(); ++i) {
+        const auto& r = reports[i];
+        out << "    {\"name\": \"" << r.name << "\", \"count\": " << r.count
+            << ", \"points\": " << r.points << ", \"errors\": " << r.errors
+            << ", \"ops_per_second\": " << r.ops_per_second
+            << ", \"points_per_second\": " << r.points_per_second
+            << ", \"p50_ms\": " << r.p50_ms << ", \"p95_ms\": " << r.p95_ms
+            << ", \"p99_ms\": " << r.p99_ms << ", \"p999_ms\": " << r.p999_ms
+            << ", \"max_ms\": " << r.max_ms << "}" << (i + 1 < reports.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+    return static_cast<bool>(out);
+}
+
+void printUsage(const char* program) {
+    std::cout << "Usage: " << program << " [options]\n"
+              << "Options:\n"
+              << "  --config <file>        Workload file in the configs/ format\n"
+              << "  --workload <name>      Entry of demo_configurations to run\n"
+              << "  --list                 List the workloads of --config\n"
+              << "  --duration <s>         Measured run time (default 10)\n"
+              << "  --threads <n>          Worker threads (default 4)\n"
+              << "  --mode <closed|open>   Back-to-back or fixed-arrival operations\n"
+              << "  --rate <points/s>      Open loop: ingest rate of all workers\n"
+              << "  --ops <ops/s>          Open loop: operation rate (overrides --rate)\n"
+              << "  --series <n>           Series cardinality (default 1000)\n"
+              << "  --batch <n>            Points per write (default 100)\n"
+              << "  --read-fraction <f>    Share of operations that are queries (default 0.2)\n"
+              << "  --ooo <f>              Share of out-of-order points (default 0.05)\n"
+              << "  --preload <n>          Points written before measuring (default 100000)\n"
+              << "  --memory-mb <n>        Global MemTable budget (default unlimited)\n"
+              << "  --data-dir <path>      Scratch directory (removed afterwards)\n"
+              << "  --keep-data            Keep the data directory\n"
+#ifdef PECJ_MODE_INTEGRATED
+              << "  --pecj                 Also run PECJ window joins through WindowScheduler\n"
+#endif
+              << "  --json <file>          Write the report as JSON\n"
+#ifdef SAGE_TSDB_ENABLE_TRACING
+              << "  --trace <file>         Write trace spans as Chrome trace JSON\n"
+#endif
+              << "  --help                 Show this help\n";
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv) {
+    BenchConfig config;
+    std::string config_file;
+    std::string workload_name;
+    std::string json_output;
+    std::string trace_output;
+    bool list_only = false;
+
+    // 先确定配置文件与负载，再用其余参数覆盖
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--config" && i + 1 < argc) {
+            config_file = argv[++i];
+        } else if (arg == "--workload" && i + 1 < argc) {
+            workload_name = argv[++i];
+        } else if (arg == "--list") {
+            list_only = true;
+        } else if (arg == "--help") {
+            printUsage(argv[0]);
+            return 0;
+        }
+    }
+
+    if (!config_file.empty()) {
+        try {
+            JsonValue root = loadJson(config_file);
+            const JsonValue* workloads = root.find("demo_configurations");
+            if (!workloads || workloads->type != JsonValue::Type::Object) {
+                std::cerr << "[ERROR] " << config_file << " has no demo_configurations" << std::endl;
+                return 1;
+            }
+            if (list_only) {
+                for (const auto& [name, entry] : workloads->object) {
+                    if (stringOr(entry, "program", "tsdb_bench") == "tsdb_bench") {
+                        std::cout << std::left << std::setw(24) << name
+                                  << stringOr(entry, "description", "") << "\n";
+                    }
+                }
+                return 0;
+            }
+            if (workload_name.empty()) {
+                std::cerr << "[ERROR] --workload is required with --config (see --list)" << std::endl;
+                return 1;
+            }
+            const JsonValue* entry = workloads->find(workload_name);
+            if (!entry) {
+                std::cerr << "[ERROR] No workload named " << workload_name << std::endl;
+                return 1;
+            }
+            config.name = workload_name;
+            applyJson(*entry, config);
+        } catch (const std::exception& e) {
+            std::cerr << "[ERROR] " << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if ((arg == "--config" || arg == "--workload") && has_value) {
+            ++i;
+        } else if (arg == "--duration" && has_value) {
+            config.duration_s = std::stod(argv[++i]);
+        } else if (arg == "--threads" && has_value) {
+            config.threads = std::stoul(argv[++i]);
+        } else if (arg == "--mode" && has_value) {
+            config.open_loop = std::string(argv[++i]) == "open";
+        } else if (arg == "--rate" && has_value) {
+            config.ingest_rate = std::stod(argv[++i]);
+        } else if (arg == "--ops" && has_value) {
+            config.ops_per_second = std::stod(argv[++i]);
+        } else if (arg == "--series" && has_value) {
+            config.series = std::stoul(argv[++i]);
+        } else if (arg == "--batch" && has_value) {
+            config.batch_size = std::max<size_t>(1, std::stoul(argv[++i]));
+        } else if (arg == "--read-fraction" && has_value) {
+            config.read_fraction = std::stod(argv[++i]);
+        } else if (arg == "--ooo" && has_value) {
+            config.out_of_order = std::stod(argv[++i]);
+        } else if (arg == "--preload" && has_value) {
+            config.preload_points = std::stoul(argv[++i]);
+        } else if (arg == "--memory-mb" && has_value) {
+            config.memory_mb = std::stoul(argv[++i]);
+        } else if (arg == "--data-dir" && has_value) {
+            config.data_dir = argv[++i];
+        } else if (arg == "--keep-data") {
+            config.keep_data = true;
+        } else if (arg == "--pecj") {
+            config.pecj.enabled = true;
+        } else if (arg == "--json" && has_value) {
+            json_output = argv[++i];
+        } else if (arg == "--trace" && has_value) {
+            trace_output = argv[++i];
+        } else if (arg != "--list" && arg != "--help") {
+            std::cerr << "[ERROR] Unknown option: " << arg << std::endl;
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    config.threads = std::max<size_t>(1, config.threads);
+    config.batch_size = std::max<size_t>(1, config.batch_size);
+    config.read_fraction = std::clamp(config.read_fraction, 0.0, 1.0);
+
+#ifdef SAGE_TSDB_ENABLE_TRACING
+    Tracer::instance().enable(!trace_output.empty());
+#else
+    if (!trace_output.empty()) {
+        std::cout << "[INFO] Built without ENABLE_TRACING, --trace ignored\n";
+        trace_output.clear();
+    }
+#endif
+
+#ifndef PECJ_MODE_INTEGRATED
+    if (config.pecj.enabled) {
+        std::cout << "[INFO] Built without PECJ_MODE_INTEGRATED, window joins skipped\n";
+        config.pecj.enabled = false;
+    }
+#endif
+
+    // 开环速率：未给出操作速率时由写入速率推出
+    double ops_per_second = config.ops_per_second;
+    if (config.open_loop && ops_per_second <= 0 && config.ingest_rate > 0 && config.read_fraction < 1.0) {
+        ops_per_second = config.ingest_rate / static_cast<double>(config.batch_size) /
+                         (1.0 - config.read_fraction);
+    }
+    if (config.open_loop && ops_per_second <= 0) {
+        std::cerr << "[ERROR] Open loop needs ingest_rate (--rate) or ops_per_second (--ops)" << std::endl;
+        return 1;
+    }
+
+    std::cout << "[Workload] " << config.name << ": " << config.description << "\n";
+    std::cout << "  Mode: " << (config.open_loop ? "open loop" : "closed loop");
+    if (config.open_loop) {
+        std::cout << " (" << ops_per_second << " ops/s, ~"
+                  << ops_per_second * (1.0 - config.read_fraction) * config.batch_size << " points/s)";
+    }
+    std::cout << ", Threads: " << config.threads << ", Duration: " << config.duration_s << "s\n";
+    std::cout << "  Series: " << config.series << ", Batch: " << config.batch_size
+              << ", Out-of-order: " << config.out_of_order * 100 << "% (<= "
+              << config.max_lateness_ms << "ms), Reads: " << config.read_fraction * 100 << "%\n";
+    std::cout << "  Queries (weights): latest " << config.queries.latest << ", range "
+              << config.queries.range << ", tag_filtered " << config.queries.tag_filtered
+              << ", aggregate " << config.queries.aggregate << " over "
+              << config.queries.range_ms << "ms\n";
+    if (config.pecj.enabled) {
+        std::cout << "  PECJ: " << config.pecj.op << ", window " << config.pecj.window_len_ms
+                  << "ms / slide " << config.pecj.slide_len_ms << "ms, "
+                  << config.pecj.events_per_second << " events/s\n";
+    }
+
+    fs::remove_all(config.data_dir);
+    int exit_code = 0;
+    {
+        TableManager tables(config.data_dir);
+        if (config.memory_mb > 0) {
+            tables.setGlobalMemoryLimit(config.memory_mb * 1024 * 1024);
+        }
+        tables.createStreamTable("bench");
+
+        // 预写入：时间戳落在计时开始前的 range_ms 内，使查询一开始就有数据
+        const Clock::time_point epoch = Clock::now();
+        {
+            std::mt19937_64 rng(config.seed);
+            std::vector<TimeSeriesData> batch;
+            auto table = tables.getStreamTable("bench");
+            int64_t span = std::max<int64_t>(1, config.queries.range_ms);
+            for (size_t i = 0; i < config.preload_points; ++i) {
+                size_t series = i % std::max<size_t>(1, config.series);
+                int64_t ts = Workload::kBaseTimestamp - span +
+                             static_cast<int64_t>(i * span / std::max<size_t>(1, config.preload_points));
+                TimeSeriesData point(ts, static_cast<double>(rng() % 1000) / 10.0);
+                point.tags["host"] = "h" + std::to_string(series);
+                point.tags["region"] = "r" + std::to_string(series % std::max<size_t>(1, config.regions));
+                batch.push_back(std::move(point));
+                if (batch.size() == 10000 || i + 1 == config.preload_points) {
+                    table->insertBatch(std::move(batch));
+                    batch.clear();
+                }
+            }
+        }
+
+        const Clock::time_point start = Clock::now();
+        const Clock::time_point deadline =
+            start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(config.duration_s));
+
+#ifdef PECJ_MODE_INTEGRATED
+        std::unique_ptr<JoinWorkload> joins;
+        if (config.pecj.enabled) {
+            joins = std::make_unique<JoinWorkload>(config, tables);
+            if (!joins->start(deadline)) {
+                return 1;
+            }
+        }
+#endif
+
+        std::vector<ThreadStats> per_thread(config.threads, ThreadStats(kNumOps));
+        std::vector<std::thread> workers;
+        double ops_per_thread = ops_per_second / static_cast<double>(config.threads);
+        for (size_t t = 0; t < config.threads; ++t) {
+            workers.emplace_back(runWorker, std::cref(config), std::ref(tables), epoch, start, deadline,
+                                 ops_per_thread, t, std::ref(per_thread[t]));
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        const double seconds = elapsedUs(start, Clock::now()) / 1e6;
+
+        ThreadStats totals(kNumOps);
+        for (auto& stats : per_thread) {
+            for (int op = 0; op < kNumOps; ++op) {
+                totals[op].merge(std::move(stats[op]));
+            }
+        }
+#ifdef PECJ_MODE_INTEGRATED
+        if (joins) {
+            joins->finish(totals);
+        }
+#endif
+
+        auto reports = buildReports(totals, seconds);
+        printReports(reports);
+#ifdef PECJ_MODE_INTEGRATED
+        if (joins) {
+            const auto& metrics = joins->metrics();
+            std::cout << "  Windows completed: " << metrics.total_windows_completed
+                      << ", end-to-end p50/p99: " << metrics.p50_end_to_end_latency_ms << "/"
+                      << metrics.p99_end_to_end_latency_ms << " ms\n";
+        }
+#endif
+        auto table_stats = tables.getStreamTable("bench")->getStats();
+        std::cout << "  Flushes: " << table_stats.flush_count << ", write stalls: "
+                  << table_stats.write_stalls << "\n";
+
+        if (!json_output.empty()) {
+            if (writeJson(json_output, config, seconds, reports)) {
+                std::cout << "[INFO] Report written to " << json_output << "\n";
+            } else {
+                std::cerr << "[ERROR] Failed to write " << json_output << std::endl;
+                exit_code = 1;
+            }
+        }
+    }
+    if (!trace_output.empty()) {
+        Tracer::instance().enable(false);
+        if (Tracer::instance().writeChromeTrace(trace_output)) {
+            std::cout << "[INFO] Trace written to " << trace_output << "\n";
+        } else {
+            std::cerr << "[ERROR] Failed to write " << trace_output << std::endl;
+            exit_code = 1;
+        }
+    }
+    if (!config.keep_data) {
+        fs::remove_all(config.data_dir);
+    }
+    return exit_code;
+}
@@ -378,8 +378,8 @@ ExperimentStats runSingleExperiment(
         ts_data.timestamp = tagged.record.arrival_time;
         ts_data.tags["stream"] = tagged.is_s_stream ? "S" : "R";
         ts_data.tags["key"] = std::to_string(tagged.record.key);
-        ts_data.fields["value"] = std::to_string(tagged.record.value);
-        ts_data.fields["event_time"] = std::to_string(tagged.record.event_time);
+        ts_data.fields["value"] = tagged.record.value;
+        ts_data.fields["event_time"] = tagged.record.event_time;
         
         if (tagged.is_s_stream) {
             db.insert("stream_s", ts_data);
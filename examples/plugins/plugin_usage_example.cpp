@@ -142,6 +142,7 @@ int main() {
         // Small delay to simulate real-time streaming
         // std::this_thread::sleep_for(std::chrono::microseconds(100));
     }
+    plugin_mgr.flushFeeds();  // Deliver the last partial micro-batch
     
     auto end_time = std::chrono::high_resolution_clock::now();
     auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
@@ -3,13 +3,18 @@
 #include "algorithm_base.h"
 #include <deque>
 #include <functional>
+#include <limits>
+#include <unordered_map>
 
 namespace sage_tsdb {
 
 /**
  * @brief Stream buffer for handling out-of-order data
  * 
- * Uses watermarking to handle late arrivals
+ * Uses watermarking to handle late arrivals. The watermark is the
+ * largest timestamp seen minus max_delay, kept in O(1) per point; the
+ * points are held in a min-heap on timestamp, so releasing the ready ones
+ * costs O(log n) each instead of a sort of the whole buffer.
  */
 class StreamBuffer {
 public:
@@ -39,7 +44,12 @@ public:
     /**
      * @brief Get buffer size
      */
-    size_t size() const { return buffer_.size(); }
+    size_t size() const { return heap_.size(); }
+    
+    /**
+     * @brief Points added at or behind the watermark so far
+     */
+    int64_t late_count() const { return late_count_; }
     
     /**
      * @brief Clear buffer
@@ -47,11 +57,14 @@ public:
     void clear();
 
 private:
-    void update_watermark();
+    void push(const TimeSeriesData& data);
     
     int64_t max_delay_;
     int64_t watermark_;
-    std::deque<TimeSeriesData> buffer_;
+    int64_t max_timestamp_;
+    bool has_data_;
+    int64_t late_count_;
+    std::vector<TimeSeriesData> heap_;  // Min-heap on timestamp
 };
 
 /**
@@ -60,6 +73,16 @@ private:
  * Joins two time series streams based on time windows,
  * handling out-of-order arrivals using watermarking.
  * 
+ * Symmetric hash join: each side keeps the tuples released by its buffer
+ * in a window state partitioned by join key (one partition without a key)
+ * and sorted by timestamp. Released tuples of both sides are handled in
+ * timestamp order; each probes the other side's partition for the range
+ * [ts - window_size, ts + window_size] and is then stored, so a pair is
+ * produced once, by whichever tuple comes second, also across calls.
+ * Stored tuples expire once the other side's watermark is more than
+ * window_size past them. A tuple released behind its own side's expiry
+ * horizon still probes but is not stored (counted in dropped_late).
+ * 
  * Configuration parameters:
  * - window_size: Join window size in milliseconds
  * - max_delay: Maximum out-of-order delay in milliseconds
@@ -107,25 +130,28 @@ public:
 
 private:
     /**
-     * @brief Join ready data from both buffers
+     * @brief Window state of one side: join key -> tuples sorted by timestamp
      */
-    std::vector<std::pair<TimeSeriesData, TimeSeriesData>> join_data(
-        const std::vector<TimeSeriesData>& left_data,
-        const std::vector<TimeSeriesData>& right_data);
+    struct WindowState {
+        std::unordered_map<std::string, std::deque<TimeSeriesData>> partitions;
+        int64_t horizon = std::numeric_limits<int64_t>::min();  // Tuples older than this are expired
+        size_t size = 0;
+        
+        void clear();
+        // Drops tuples older than horizon and empty partitions
+        void expire(int64_t horizon);
+    };
     
     /**
-     * @brief Hash join on specified key
+     * @brief Probe the other side with tuple, then store it on its side
      */
-    std::vector<std::pair<TimeSeriesData, TimeSeriesData>> hash_join(
-        const std::vector<TimeSeriesData>& left_data,
-        const std::vector<TimeSeriesData>& right_data);
+    void join_tuple(const TimeSeriesData& tuple, bool is_left,
+                    std::vector<std::pair<TimeSeriesData, TimeSeriesData>>& joined);
     
     /**
-     * @brief Nested loop join with window condition
+     * @brief Partition key of tuple; false if it lacks the join key tag
      */
-    std::vector<std::pair<TimeSeriesData, TimeSeriesData>> nested_loop_join(
-        const std::vector<TimeSeriesData>& left_data,
-        const std::vector<TimeSeriesData>& right_data);
+    bool partition_key(const TimeSeriesData& tuple, std::string& key) const;
     
     // Configuration
     int64_t window_size_;
@@ -137,6 +163,10 @@ private:
     StreamBuffer left_buffer_;
     StreamBuffer right_buffer_;
     
+    // Window state
+    WindowState left_state_;
+    WindowState right_state_;
+    
     // Statistics
     mutable int64_t total_joined_;
     mutable int64_t late_arrivals_;
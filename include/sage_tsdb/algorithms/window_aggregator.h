@@ -1,6 +1,7 @@
 #pragma once
 
 #include "algorithm_base.h"
+#include <memory>
 
 namespace sage_tsdb {
 
@@ -24,77 +25,109 @@ enum class WindowType {
  * - window_size: Window size in milliseconds
  * - slide_interval: Slide interval for sliding windows (ms)
  * - session_gap: Inactivity gap for session windows (ms)
- * - aggregation: Aggregation function (sum/avg/min/max/count/etc.)
+ * - aggregation: Aggregation function (sum/avg/min/max/count/first/last/
+ *   stddev/quantile/distinct; pNN is quantile NN/100, e.g. p99)
+ * - quantile: q of the quantile aggregation (default 0.5)
+ * 
+ * Two ways to feed it:
+ * - process(): a whole batch at once (sorted first if out of order)
+ * - push()/advance_watermark()/flush(): streaming, points in arrival
+ *   order; points wait in a buffer until the watermark passes them, so
+ *   reordering ahead of the watermark is harmless. advance_watermark()
+ *   and flush() return the windows they completed
+ * 
+ * Both share one incremental engine: a point is added to the open window
+ * state once, sliding windows subtract what slides out (sum, count and sum
+ * of squares; min/max through a two-stacks queue, amortized O(1)), and
+ * sessions close when a point or the watermark is more than session_gap
+ * past their last point. quantile and distinct are mergeable sketches
+ * (t-digest, HyperLogLog) and cannot be subtracted: a sliding window
+ * rebuilds them from its values when it is emitted.
  */
 class WindowAggregator : public TimeSeriesAlgorithm {
 public:
     explicit WindowAggregator(const AlgorithmConfig& config = {});
+    ~WindowAggregator() override;
     
     /**
      * @brief Process window aggregation
      * @param input Input time series data
      * @return Aggregated data (one point per window)
+     * 
+     * Independent of the streaming state.
      */
     std::vector<TimeSeriesData> process(
         const std::vector<TimeSeriesData>& input) override;
     
     /**
-     * @brief Reset algorithm state
+     * @brief Add a point to the stream
+     * 
+     * Points may come in any order: each is buffered until the watermark
+     * passes it. A point older than the watermark is dropped and counted
+     * as late.
      */
-    void reset() override;
+    void push(const TimeSeriesData& point);
     
     /**
-     * @brief Get aggregator statistics
-     */
-    std::map<std::string, int64_t> get_stats() const override;
-
-private:
-    /**
-     * @brief Process with tumbling windows
+     * @brief Declare that no point older than watermark will be pushed
+     * @return Windows ending at or before it and sessions it closes
+     * 
+     * Buffered points older than watermark enter their windows first, in
+     * timestamp order (arrival order among equal timestamps).
      */
-    std::vector<TimeSeriesData> tumbling_window(
-        const std::vector<TimeSeriesData>& data);
+    std::vector<TimeSeriesData> advance_watermark(int64_t watermark);
     
     /**
-     * @brief Process with sliding windows
+     * @brief Complete every window still open in the stream, buffered
+     *        points included
      */
-    std::vector<TimeSeriesData> sliding_window(
-        const std::vector<TimeSeriesData>& data);
+    std::vector<TimeSeriesData> flush();
     
     /**
-     * @brief Process with session windows
+     * @brief Reset algorithm state (statistics and the stream)
      */
-    std::vector<TimeSeriesData> session_window(
-        const std::vector<TimeSeriesData>& data);
+    void reset() override;
     
     /**
-     * @brief Aggregate data in a window
+     * @brief Get aggregator statistics
      */
-    TimeSeriesData aggregate_window(
-        const std::vector<TimeSeriesData>& window_data,
-        int64_t window_timestamp);
+    std::map<std::string, int64_t> get_stats() const override;
+
+private:
+    class Stream;
     
     /**
      * @brief Align timestamp to window boundary
      */
     int64_t align_to_window(int64_t timestamp) const;
     
-    /**
-     * @brief Apply aggregation function
-     */
-    double apply_aggregation(const std::vector<double>& values) const;
-    
     // Configuration
     WindowType window_type_;
     int64_t window_size_;
     int64_t slide_interval_;
     int64_t session_gap_;
     AggregationType aggregation_;
+    double quantile_;
     
     // Statistics
     mutable int64_t windows_created_;
     mutable int64_t windows_completed_;
     mutable int64_t data_points_processed_;
+    mutable int64_t late_points_;
+    
+    // Streaming state
+    struct Pending {
+        uint64_t seq;             // Arrival order, breaks timestamp ties
+        TimeSeriesData point;
+    };
+    
+    // Feeds the pending points older than watermark (all at INT64_MAX) to the stream
+    void release_before(int64_t watermark, std::vector<TimeSeriesData>& results);
+    
+    std::unique_ptr<Stream> stream_;
+    std::vector<Pending> pending_;  // Min-heap on (timestamp, seq) of points ahead of the watermark
+    uint64_t next_seq_ = 0;
+    int64_t watermark_;
 };
 
 } // namespace sage_tsdb
@@ -0,0 +1,128 @@
+#pragma once
+
+#include "../core/aggregation.h"
+#include "../core/table_manager.h"
+#include "../core/time_series_data.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace sage_tsdb {
+namespace cluster {
+
+/**
+ * @brief RPCs between a ClusterRouter and the ShardServers
+ *
+ * Every message, request or response, is
+ *
+ *     u32 body size, u8 code, body
+ *
+ * little-endian. A request's code is its RpcKind; a response's is an
+ * RpcStatus, with an Error body holding the message text. Bodies:
+ *
+ *     Insert     request: one ingest binary frame (table + ColumnarBlock)
+ *                response: u64 points written
+ *     Query      request: table, QueryConfig; response: one binary frame
+ *     Aggregate  request: table, QueryConfig; response: partial aggregates
+ *     Ping       empty both ways
+ *
+ * Requests on one connection are answered in order.
+ */
+
+enum class RpcKind : uint8_t {
+    Ping = 0,
+    Insert = 1,
+    Query = 2,
+    Aggregate = 3
+};
+
+enum class RpcStatus : uint8_t {
+    Ok = 0,
+    Error = 1
+};
+
+inline constexpr size_t kMessageHeaderBytes = 5;
+inline constexpr size_t kMaxMessageBytes = 256 * 1024 * 1024;
+
+/**
+ * @brief Aggregate of the points of one window and group on one shard
+ *
+ * group holds the group_by tags (empty without group_by). Partials of the
+ * same window and group from different shards merge into the final value,
+ * since each shard's summary covers its own points.
+ */
+struct PartialAggregate {
+    int64_t window_start = 0;
+    Tags group;
+    BlockSummary summary;
+};
+
+// Points are sorted by timestamp first, as the block encoding requires
+void encode_points(const std::string& table, const std::vector<TimeSeriesData>& points,
+                   std::vector<uint8_t>& out);
+bool decode_points(const uint8_t* data, size_t size, std::string& table,
+                   std::vector<TimeSeriesData>& points);
+
+void encode_query(const std::string& table, const QueryConfig& config, std::vector<uint8_t>& out);
+bool decode_query(const uint8_t* data, size_t size, std::string& table, QueryConfig& config);
+
+// Sketches are sent only by summaries that keep them
+void encode_partials(const std::vector<PartialAggregate>& partials, std::vector<uint8_t>& out);
+bool decode_partials(const uint8_t* data, size_t size, std::vector<PartialAggregate>& partials);
+
+/**
+ * @brief Partials of points (in timestamp order) by window and group
+ *
+ * Windows are aligned to multiples of window_size; without one, the single
+ * window starts at the range start, as in TimeSeriesIndex. Sketches are
+ * kept only when config.aggregation needs them.
+ */
+std::vector<PartialAggregate> partial_aggregate(const std::vector<TimeSeriesData>& points,
+                                                const QueryConfig& config);
+
+/**
+ * @brief Merge partials from any number of shards into the query result
+ *
+ * One point per window and group, stamped with the window start and tagged
+ * with filter_tags plus the group's tags, ordered by window, then group;
+ * at most config.limit of them.
+ */
+std::vector<TimeSeriesData> finish_aggregate(const std::vector<PartialAggregate>& partials,
+                                             const QueryConfig& config);
+
+/**
+ * @brief What a shard does for each RPC, against its own TableManager
+ *
+ * Shared by ShardServer and by routers serving their local node in-process.
+ * Insert creates a missing stream table with create_config when given, and
+ * returns the points written. Reads of a table the node does not have
+ * return nothing: it simply owns none of its points.
+ */
+size_t local_insert(TableManager& manager, const std::string& table,
+                    std::vector<TimeSeriesData>&& points, const TableConfig* create_config,
+                    std::string& error);
+std::vector<TimeSeriesData> local_query(TableManager& manager, const std::string& table,
+                                        const QueryConfig& config);
+std::vector<PartialAggregate> local_aggregate(TableManager& manager, const std::string& table,
+                                              const QueryConfig& config);
+
+/**
+ * @brief Blocking I/O of one whole message on a socket
+ * @return false on a closed connection, an I/O error or timeout, or an
+ *         oversized message
+ */
+bool send_message(int fd, uint8_t code, const std::vector<uint8_t>& body);
+bool recv_message(int fd, uint8_t& code, std::vector<uint8_t>& body);
+
+/**
+ * @brief Blocking TCP connection with timeout as its send and receive
+ *        timeouts (0 for none)
+ * @return The socket, or -1 with error set
+ */
+int connect_to(const std::string& host, int port, std::chrono::milliseconds timeout,
+               std::string& error);
+
+} // namespace cluster
+} // namespace sage_tsdb
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "cluster_protocol.h"
+#include "shard_map.h"
+#include "../core/table_manager.h"
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace sage_tsdb {
+namespace cluster {
+
+struct ClusterRouterConfig {
+    // Node served in-process through the local manager instead of RPCs
+    std::string local_node;
+    TableConfig table_config;            // Config of tables the local node creates
+    std::chrono::milliseconds timeout{10000};  // Per RPC send and receive
+    size_t max_idle_connections = 4;     // Pooled per node
+};
+
+/**
+ * @brief Routes writes and queries of a sharded cluster
+ *
+ * insertBatch() splits a batch by shard owner and sends each node one
+ * Insert RPC, all nodes at once. query() asks only the nodes the shard map
+ * cannot rule out (ShardMap::nodesFor) and merges their answers: raw
+ * queries by timestamp, aggregations by merging the partial aggregates
+ * every node computed over its own points, so only one summary per window
+ * and group crosses the network.
+ *
+ * Any number of routers may serve one cluster, each holding a copy of the
+ * shard map; routers are thread-safe. A failed RPC is retried once on a
+ * new connection when it went out on a pooled one, which is safe for
+ * inserts since a table keeps one version per timestamp and tags.
+ */
+class ClusterRouter {
+public:
+    ClusterRouter(ShardMap map, std::shared_ptr<TableManager> local_manager = nullptr,
+                  ClusterRouterConfig config = {});
+    ~ClusterRouter();
+
+    ClusterRouter(const ClusterRouter&) = delete;
+    ClusterRouter& operator=(const ClusterRouter&) = delete;
+
+    const ShardMap& shardMap() const { return map_; }
+
+    /**
+     * @brief Write points to the owners of their shards
+     * @return false if a node could not take its points (see lastError());
+     *         the other nodes' points are written regardless
+     */
+    bool insertBatch(const std::string& table, const std::vector<TimeSeriesData>& points);
+
+    /**
+     * @brief Scatter-gather query; same results as TableManager/StreamTable
+     *        querying all the points in one place
+     * @return false if a node failed to answer (out is then incomplete)
+     */
+    bool query(const std::string& table, const QueryConfig& config,
+               std::vector<TimeSeriesData>& out);
+
+    // Round trip to every node
+    bool ping();
+
+    std::string lastError() const;
+
+private:
+    bool call(const std::string& node_id, RpcKind kind, const std::vector<uint8_t>& request,
+              std::vector<uint8_t>& response);
+    int connect(const NodeInfo& node);
+    void release(const std::string& node_id, int fd);
+    bool isLocal(const std::string& node_id) const;
+
+    // Run fn(i) for every nodes[i], remote ones on their own threads
+    template <typename Fn>
+    void fanOut(const std::vector<std::string>& nodes, Fn&& fn);
+
+    void fail(const std::string& message);
+
+    ShardMap map_;
+    std::shared_ptr<TableManager> local_;
+    ClusterRouterConfig config_;
+
+    std::mutex pool_mutex_;
+    std::map<std::string, std::vector<int>> idle_;  // Connections by node id
+
+    mutable std::mutex error_mutex_;
+    std::string last_error_;
+};
+
+} // namespace cluster
+} // namespace sage_tsdb
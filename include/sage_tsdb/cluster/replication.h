@@ -0,0 +1,223 @@
+#pragma once
+
+#include "cluster_protocol.h"
+#include "../core/table_manager.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace sage_tsdb {
+namespace cluster {
+
+/**
+ * @brief Replication stream between a leader's ShardServer and a follower
+ *
+ * The follower opens a connection to the leader's shard port and sends one
+ * Subscribe (u64 last applied segment id, u8 snapshot wanted). The leader
+ * then only sends, with the message framing of cluster_protocol.h:
+ *
+ *     SnapshotChunk  ingest binary frames of existing points
+ *     SnapshotDone   u64 id of the last segment the snapshot covers
+ *     Segment        u64 id, u64 id of the newest sealed segment, then
+ *                    the segment's binary frames
+ *     Heartbeat      u64 id of the newest sealed segment, sent when idle
+ *     Error          text; a follower that fell behind the retained log
+ *                    gets "gap" and subscribes again with a snapshot
+ */
+enum class ReplicationKind : uint8_t {
+    Subscribe = 16,
+    SnapshotChunk = 17,
+    SnapshotDone = 18,
+    Segment = 19,
+    Heartbeat = 20,
+    Error = 21
+};
+
+struct ReplicationLogOptions {
+    size_t segment_bytes = 1024 * 1024;                 // Seal once this much is open
+    std::chrono::milliseconds segment_interval{20};     // ... or once it is this old
+    size_t retain_bytes = 256 * 1024 * 1024;            // Sealed segments kept for followers
+    size_t snapshot_chunk_points = 64 * 1024;           // Points per snapshot message
+};
+
+/**
+ * @brief The leader's log of committed writes, cut into sealed segments
+ *
+ * Listens to every stream table of a TableManager, including tables
+ * created later: a batch reaches the log after the table accepted it (past
+ * the WAL's group commit), as one ingest binary frame. Frames accumulate
+ * in an open segment that is sealed, and given the next id, when it holds
+ * segment_bytes or is segment_interval old. Sealed segments are immutable
+ * and shared by every follower reading them; the oldest are dropped past
+ * retain_bytes.
+ *
+ * Frames name tables and tags in full, so followers need not share the
+ * leader's series catalog (which the LSM WAL records refer to).
+ */
+class ReplicationLog {
+public:
+    struct Segment {
+        uint64_t id = 0;
+        std::vector<uint8_t> frames;     // Concatenated binary frames
+        size_t points = 0;
+    };
+
+    ReplicationLog(std::shared_ptr<TableManager> manager, ReplicationLogOptions options = {});
+    ~ReplicationLog();
+
+    ReplicationLog(const ReplicationLog&) = delete;
+    ReplicationLog& operator=(const ReplicationLog&) = delete;
+
+    /**
+     * @brief Seal the open segment, if it holds anything
+     * @return Id of the newest sealed segment: once a follower applied it,
+     *         it has every write committed before the call
+     */
+    uint64_t seal();
+
+    uint64_t lastSealed() const;
+
+    /**
+     * @brief Sealed segments after after_id, up to about max_bytes
+     *
+     * Waits up to wait for one to be sealed (sealing the open segment once
+     * it is due). Returns false when segments after after_id were already
+     * dropped, so the reader must start over from a snapshot.
+     */
+    bool read(uint64_t after_id, std::vector<std::shared_ptr<const Segment>>& out,
+              size_t max_bytes, std::chrono::milliseconds wait);
+
+    /**
+     * @brief Stream every stored point to send, snapshot_chunk_points at a
+     *        time, and return the segment id the snapshot is consistent with
+     *
+     * Writes racing with the snapshot may show up in it and in the segments
+     * after the returned id; applying both converges, since a table keeps
+     * the newest version of each point.
+     */
+    uint64_t snapshot(const std::function<bool(const std::vector<uint8_t>& frames)>& send);
+
+    const ReplicationLogOptions& options() const { return options_; }
+    std::shared_ptr<TableManager> manager() const { return manager_; }
+
+private:
+    void append(const std::string& table, const TimeSeriesData* data, size_t count);
+    uint64_t sealLocked();              // Caller holds mutex_
+
+    std::shared_ptr<TableManager> manager_;
+    ReplicationLogOptions options_;
+    uint64_t listener_id_ = 0;
+
+    mutable std::mutex mutex_;
+    std::condition_variable sealed_cv_;
+    Segment open_;
+    std::chrono::steady_clock::time_point open_since_;
+    std::deque<std::shared_ptr<const Segment>> sealed_;
+    size_t sealed_bytes_ = 0;
+    uint64_t next_id_ = 1;
+
+    std::shared_ptr<Counter> segments_sealed_;
+    std::shared_ptr<Counter> points_logged_;
+};
+
+/**
+ * @brief Leader half of a subscription: stream snapshot and segments to
+ *        the follower on fd until it goes away or running turns false
+ */
+void serve_replication(ReplicationLog& log, int fd, const std::vector<uint8_t>& subscribe,
+                       const std::atomic<bool>& running);
+
+struct FollowerConfig {
+    std::string leader_host = "127.0.0.1";
+    int leader_port = 8090;                             // The leader's ShardServer
+    std::chrono::milliseconds max_staleness{1000};      // Reads fail beyond this lag
+    std::chrono::milliseconds reconnect_interval{200};
+    TableConfig table_config;                           // Config of replicated tables
+};
+
+/**
+ * @brief Read-only replica of a leader's stream tables
+ *
+ * A thread subscribes to the leader, bootstraps from a snapshot the first
+ * time, then applies sealed segments in order into the local TableManager
+ * (its own tables and LSM trees). After a disconnect it resubscribes from
+ * the last applied segment.
+ *
+ * Staleness is the time since the follower last knew it held everything
+ * the leader had sealed, measured on the follower's clock from the
+ * leader's heartbeats; the leader's open segment adds up to its
+ * segment_interval. query() and queryLatest() refuse to answer beyond
+ * max_staleness, so reads are bounded-stale or fail.
+ *
+ * The local tables must not be written to other than by replication.
+ */
+class ReplicaFollower {
+public:
+    ReplicaFollower(std::shared_ptr<TableManager> local, FollowerConfig config = {});
+    ~ReplicaFollower();
+
+    ReplicaFollower(const ReplicaFollower&) = delete;
+    ReplicaFollower& operator=(const ReplicaFollower&) = delete;
+
+    void start();
+    void stop();
+
+    bool isRunning() const { return running_.load(); }
+
+    // Last segment applied; 0 before the first snapshot completes
+    uint64_t appliedSegment() const { return applied_.load(); }
+
+    // Wait until the snapshot and segment id (from ReplicationLog::seal())
+    // are applied
+    bool waitForSegment(uint64_t id, std::chrono::milliseconds timeout) const;
+
+    // Time since the follower was last known caught up; max() before that
+    std::chrono::milliseconds staleness() const;
+
+    /**
+     * @brief TableManager::query against the replica
+     * @return false if the replica is staler than max_staleness or the
+     *         query fails (see lastError())
+     */
+    bool query(const std::string& table, const QueryConfig& config,
+               std::vector<TimeSeriesData>& out);
+    bool queryLatest(const std::string& table, size_t n, std::vector<TimeSeriesData>& out);
+
+    std::string lastError() const;
+
+private:
+    void run();
+    bool follow(int fd);
+    bool applyFrames(const uint8_t* data, size_t size);
+    bool checkFresh();
+    void setApplied(uint64_t id);
+    void fail(const std::string& message);
+
+    std::shared_ptr<TableManager> local_;
+    FollowerConfig config_;
+
+    std::atomic<bool> running_{false};
+    std::thread thread_;
+    std::atomic<int> fd_{-1};
+    bool need_snapshot_ = true;          // Follower thread only
+
+    std::atomic<uint64_t> applied_{0};
+    std::atomic<int64_t> caught_up_at_ns_{0};  // steady_clock; 0 = never
+    bool synced_ = false;                // Snapshot applied; under applied_mutex_
+    mutable std::mutex applied_mutex_;
+    mutable std::condition_variable applied_cv_;
+
+    mutable std::mutex error_mutex_;
+    std::string last_error_;
+};
+
+} // namespace cluster
+} // namespace sage_tsdb
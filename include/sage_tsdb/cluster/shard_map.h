@@ -0,0 +1,128 @@
+#pragma once
+
+#include "../core/time_series_data.h"
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace sage_tsdb {
+namespace cluster {
+
+/**
+ * @brief A node of the cluster: a process serving its TableManager through
+ * a ShardServer
+ */
+struct NodeInfo {
+    std::string id;
+    std::string host = "127.0.0.1";
+    int port = 0;
+};
+
+/**
+ * @brief How the points of a table are spread over the shards
+ *
+ * By series (the default): the shard_by tags are hashed, the whole tag set
+ * when empty, so a series always lives on one shard. Naming tags keeps
+ * filters and group_by on them on one shard, and lets tables that share a
+ * placement be joined locally.
+ *
+ * By time: with partition_ms > 0, partition ts / partition_ms goes to
+ * shard partition % num_shards, so recent data spreads over every node
+ * and a query visits only the shards of its time range.
+ */
+struct TablePlacement {
+    std::vector<std::string> shard_by;
+    int64_t partition_ms = 0;
+
+    bool operator==(const TablePlacement& other) const {
+        return shard_by == other.shard_by && partition_ms == other.partition_ms;
+    }
+};
+
+/**
+ * @brief Assignment of table shards to nodes
+ *
+ * Every table is cut into the same num_shards virtual shards, each owned
+ * by one node; moving a shard between nodes is a change of owner, not of
+ * hashing. Tables are placed in colocation groups: tables of one group
+ * share their placement, so points with equal shard_by values land on the
+ * same node whatever the table.
+ *
+ * A window join of two tables grouped with shard_by = {kJoinKeyTag} finds
+ * every matching pair on one node; each node then runs its own
+ * WindowScheduler over its local tables and the cluster's join result is
+ * the sum of the nodes' (see joinsLocally()).
+ *
+ * Not thread-safe to modify; routers copy the map they are given.
+ */
+class ShardMap {
+public:
+    static constexpr size_t kDefaultShards = 64;
+    static constexpr const char* kJoinKeyTag = "key";  // Tag the PECJ engine joins on
+
+    explicit ShardMap(size_t num_shards = kDefaultShards);
+
+    // Throws std::invalid_argument for an empty or duplicate id
+    void addNode(const NodeInfo& node);
+    const std::vector<NodeInfo>& nodes() const { return nodes_; }
+    const NodeInfo* node(const std::string& id) const;
+
+    // Spread the shards over the nodes in turn
+    void assignRoundRobin();
+    // Throws std::invalid_argument for an unknown node or shard
+    void assign(size_t shard, const std::string& node_id);
+    const std::string& ownerOfShard(size_t shard) const { return owners_.at(shard); }
+
+    size_t numShards() const { return owners_.size(); }
+
+    // Placement of table's group; tables not mentioned are placed by series
+    void setPlacement(const std::string& table, const TablePlacement& placement);
+    const TablePlacement& placement(const std::string& table) const;
+
+    // Put table in the group of with, taking its placement
+    void colocate(const std::string& table, const std::string& with);
+    bool colocated(const std::string& a, const std::string& b) const;
+
+    // Whether a join of s and r on kJoinKeyTag never crosses nodes
+    bool joinsLocally(const std::string& s, const std::string& r) const;
+
+    size_t shardOf(const std::string& table, const TimeSeriesData& point) const;
+    const std::string& ownerOf(const std::string& table, const TimeSeriesData& point) const;
+
+    /**
+     * @brief Nodes that may hold points of table matching filter_tags in
+     * range, in node order
+     *
+     * One node when the filter binds every shard_by tag; for time
+     * placement the owners of the partitions range covers; all owners
+     * otherwise.
+     */
+    std::vector<std::string> nodesFor(const std::string& table, const TimeRange& range,
+                                      const Tags& filter_tags) const;
+
+    /**
+     * @brief Text form, one directive per line:
+     *
+     *     shards 64
+     *     node <id> <host> <port>
+     *     assign <shard> <node>          (omitted shards: round robin)
+     *     place <table> [partition_ms=N] [tag...]
+     *     colocate <table> <with>
+     */
+    std::string serialize() const;
+    static bool parse(const std::string& text, ShardMap& out, std::string* error = nullptr);
+
+private:
+    const std::string& group(const std::string& table) const;
+    size_t shardOfTags(const TablePlacement& placement, const Tags& tags) const;
+
+    std::vector<NodeInfo> nodes_;
+    std::vector<std::string> owners_;                   // Node id by shard
+    std::map<std::string, std::string> group_of_;        // Table -> colocation group
+    std::map<std::string, TablePlacement> placements_;   // By group
+};
+
+} // namespace cluster
+} // namespace sage_tsdb
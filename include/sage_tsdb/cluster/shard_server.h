@@ -0,0 +1,105 @@
+#pragma once
+
+#include "cluster_protocol.h"
+#include "replication.h"
+#include "../core/table_manager.h"
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace sage_tsdb {
+namespace cluster {
+
+struct ShardServerConfig {
+    std::string bind_address = "0.0.0.0";
+    int port = 8090;                     // 0 picks a free port
+    size_t max_connections = 256;        // Routers keep a few each
+    bool create_tables = true;           // Create missing stream tables on first insert
+    TableConfig table_config;            // Config of tables created by the server
+};
+
+/**
+ * @brief Serves a node's TableManager to ClusterRouters
+ *
+ * Answers the RPCs of cluster_protocol.h against the local tables: routed
+ * inserts, raw range queries and partial aggregates. Every connection gets
+ * a thread that handles its requests in turn, so a slow query delays only
+ * the router call that sent it; routers pool their connections.
+ *
+ * With a ReplicationLog set, a connection that opens with a Subscribe
+ * becomes a replication stream to a ReplicaFollower (see replication.h).
+ *
+ * Requests are counted in the manager's MetricsRegistry as
+ * sage_tsdb_shard_rpcs_total{kind} and sage_tsdb_shard_rpc_errors_total.
+ */
+class ShardServer {
+public:
+    ShardServer(std::shared_ptr<TableManager> manager, ShardServerConfig config = {});
+    ~ShardServer();
+
+    ShardServer(const ShardServer&) = delete;
+    ShardServer& operator=(const ShardServer&) = delete;
+
+    /**
+     * @brief Bind the port and start accepting
+     * @return false if the socket cannot be set up (see lastError())
+     */
+    bool start();
+
+    /**
+     * @brief Close every connection and join their threads
+     *
+     * Requests being handled complete first; their responses are dropped.
+     */
+    void stop();
+
+    // Serve followers from log; call before start()
+    void setReplicationLog(std::shared_ptr<ReplicationLog> log) { replication_ = std::move(log); }
+
+    bool isRunning() const { return running_.load(); }
+
+    // Bound port (useful with port 0); -1 when not started
+    int port() const { return port_; }
+
+    std::string lastError() const;
+
+private:
+    struct Worker {
+        int fd = -1;
+        std::thread thread;
+        std::atomic<bool> done{false};
+    };
+
+    void run();
+    void serve(Worker& worker);
+    bool handle(RpcKind kind, const std::vector<uint8_t>& request, std::vector<uint8_t>& response,
+                std::string& error);
+    void reapWorkers(bool all);
+    void fail(const std::string& message);
+
+    std::shared_ptr<TableManager> manager_;
+    ShardServerConfig config_;
+    std::shared_ptr<ReplicationLog> replication_;
+
+    int listen_fd_ = -1;
+    int wake_fd_ = -1;
+    int port_ = -1;
+
+    std::atomic<bool> running_{false};
+    std::thread thread_;
+
+    std::mutex workers_mutex_;
+    std::list<std::unique_ptr<Worker>> workers_;
+
+    std::shared_ptr<Counter> rpc_counts_[4];  // By RpcKind
+    std::shared_ptr<Counter> rpc_errors_;
+
+    mutable std::mutex error_mutex_;
+    std::string last_error_;
+};
+
+} // namespace cluster
+} // namespace sage_tsdb
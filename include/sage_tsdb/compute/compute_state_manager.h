@@ -1,9 +1,14 @@
 #pragma once
 
 #include "sage_tsdb/core/time_series_data.h"
+#include <condition_variable>
 #include <cstdint>
+#include <deque>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 #include <map>
 
@@ -42,6 +47,17 @@ struct ComputeState {
         : timestamp(0), watermark(0), window_id(0), processed_events(0) {}
 };
 
+/**
+ * @brief Checkpoint write counters
+ */
+struct CheckpointStats {
+    uint64_t base_checkpoints = 0;      ///< Full operator state written
+    uint64_t delta_checkpoints = 0;     ///< Only pages changed since the base written
+    uint64_t failed_checkpoints = 0;    ///< Writes that did not reach the table
+    uint64_t operator_bytes_written = 0;  ///< Operator state bytes in written records
+    uint64_t pending = 0;               ///< Queued, not yet written
+};
+
 /**
  * @brief Compute state manager
  * 
@@ -55,6 +71,15 @@ struct ComputeState {
  * - Each compute engine has its own state record
  * - Supports checkpoint-based recovery
  * - Thread-safe for concurrent access
+ * 
+ * The latest state of each engine is also kept in memory as an immutable
+ * snapshot: saveState() swaps in a new one, so loadState() is a map
+ * lookup and createCheckpoint() only takes a reference (copy-on-write).
+ * Checkpoint records are written by a background writer in the order
+ * they were created. A checkpoint is either a base (full operator state)
+ * or a delta holding the fixed-size pages of operator_state that differ
+ * from the last base; a new base is written every kMaxDeltasPerBase
+ * deltas or when a delta would exceed half the state.
  */
 class ComputeStateManager {
 public:
@@ -64,6 +89,9 @@ public:
      */
     explicit ComputeStateManager(TimeSeriesDB* db);
     
+    /**
+     * @brief Waits for queued checkpoints, then stops the writer
+     */
     ~ComputeStateManager();
     
     /**
@@ -94,7 +122,12 @@ public:
     /**
      * @brief Delete compute state
      * @param compute_name Compute engine identifier
-     * @return true if deleted successfully
+     * @return true if deleted, false if there was no state or the write failed
+     * 
+     * Writes a tombstone record, so loadState(), hasState() and listStates()
+     * stop returning the state, here and in managers opened on the table
+     * later. Existing checkpoints are kept; those of a state saved again
+     * start from a new base.
      */
     bool deleteState(const std::string& compute_name);
     
@@ -106,7 +139,7 @@ public:
     
     /**
      * @brief Persist state to disk (through LSM-Tree)
-     * @param compute_name Compute engine identifier (empty = all)
+     * @param compute_name Unused: the database checkpoint covers every engine
      * @return true if persisted successfully
      * 
      * This triggers a flush from MemTable to LSM-Tree Level 0.
@@ -117,18 +150,43 @@ public:
      * @brief Create a checkpoint of current state
      * @param compute_name Compute engine identifier
      * @param checkpoint_id Checkpoint identifier
-     * @return true if checkpoint created successfully
+     * @return true if the checkpoint was queued, false if there is no state
      * 
-     * Checkpoints are immutable snapshots stored separately.
+     * Checkpoints are immutable snapshots stored separately. The snapshot
+     * is taken at once; the record is written off the calling thread (see
+     * flushCheckpoints()).
      */
     bool createCheckpoint(const std::string& compute_name, uint64_t checkpoint_id);
     
+    /**
+     * @brief Block until every queued checkpoint has been written
+     */
+    void flushCheckpoints();
+    
+    /**
+     * @brief Latest checkpoint created for a compute engine
+     * @param compute_name Compute engine identifier
+     * @param checkpoint_id Output checkpoint identifier
+     * @return false if none was created or found in the table
+     * 
+     * O(1) for engines checkpointed by this manager; otherwise the table
+     * is scanned once and the result cached.
+     */
+    bool latestCheckpoint(const std::string& compute_name, uint64_t& checkpoint_id);
+    
+    /**
+     * @brief Checkpoint write counters
+     */
+    CheckpointStats getCheckpointStats() const;
+    
     /**
      * @brief Restore state from checkpoint
      * @param compute_name Compute engine identifier
      * @param checkpoint_id Checkpoint identifier
      * @param state Output state object
      * @return true if restored successfully
+     * 
+     * Waits for queued checkpoints; a delta is applied to its base.
      */
     bool restoreCheckpoint(const std::string& compute_name, 
                           uint64_t checkpoint_id,
@@ -137,7 +195,7 @@ public:
     /**
      * @brief List checkpoints for a compute engine
      * @param compute_name Compute engine identifier
-     * @return Vector of checkpoint IDs and metadata
+     * @return Vector of checkpoint IDs and metadata, without deleted ones
      */
     std::vector<std::pair<uint64_t, std::map<std::string, int64_t>>> 
     listCheckpoints(const std::string& compute_name) const;
@@ -146,7 +204,11 @@ public:
      * @brief Delete a checkpoint
      * @param compute_name Compute engine identifier
      * @param checkpoint_id Checkpoint identifier
-     * @return true if deleted successfully
+     * @return true if deleted, false if there was no such checkpoint or the write failed
+     * 
+     * Waits for queued checkpoints, then writes a tombstone that
+     * listCheckpoints(), latestCheckpoint() and restoreCheckpoint() respect.
+     * Deltas taken against a deleted base can still be restored.
      */
     bool deleteCheckpoint(const std::string& compute_name, uint64_t checkpoint_id);
     
@@ -166,13 +228,76 @@ public:
      * @return true if deserialized successfully
      */
     static bool deserialize(const std::vector<uint8_t>& data, ComputeState& state);
+    
+    /**
+     * @brief Encode the pages of current that differ from base
+     * 
+     * Format: [total_len:8][page_count:4] then per page [index:4][bytes],
+     * each page DELTA_PAGE_SIZE bytes except a shorter last one.
+     */
+    static std::vector<uint8_t> encodeDelta(const std::vector<uint8_t>& base,
+                                            const std::vector<uint8_t>& current);
+    
+    /**
+     * @brief Rebuild operator state from a base and encodeDelta() output
+     */
+    static bool applyDelta(const std::vector<uint8_t>& base, const std::vector<uint8_t>& delta,
+                           std::vector<uint8_t>& out);
+    
+    static constexpr size_t DELTA_PAGE_SIZE = 4096;
+    static constexpr size_t kMaxDeltasPerBase = 16;
 
 private:
+    using StatePtr = std::shared_ptr<const ComputeState>;
+    
     TimeSeriesDB* db_;  ///< Database reference (not owned)
     
     static constexpr const char* STATE_TABLE_NAME = "_compute_state";
     static constexpr const char* CHECKPOINT_TABLE_NAME = "_compute_checkpoint";
     
+    struct PendingCheckpoint {
+        std::string compute_name;
+        uint64_t checkpoint_id = 0;
+        StatePtr state;
+    };
+    
+    // Last base written per engine; touched by the writer thread only
+    struct BaseCheckpoint {
+        uint64_t checkpoint_id = 0;
+        StatePtr state;
+        size_t deltas = 0;
+    };
+    
+    mutable std::mutex index_mutex_;
+    std::unordered_map<std::string, StatePtr> latest_states_;        ///< Guarded by index_mutex_
+    std::unordered_map<std::string, uint64_t> latest_checkpoints_;   ///< Guarded by index_mutex_
+    int64_t last_state_timestamp_ = 0;        ///< Guarded by index_mutex_; keeps state records ordered
+    
+    mutable std::mutex writer_mutex_;
+    std::condition_variable writer_cv_;       ///< New work or stop
+    std::condition_variable flushed_cv_;      ///< Queue drained
+    std::deque<PendingCheckpoint> pending_;   ///< Guarded by writer_mutex_
+    bool writing_ = false;                    ///< Guarded by writer_mutex_
+    bool stopping_ = false;                   ///< Guarded by writer_mutex_
+    CheckpointStats stats_;                   ///< Guarded by writer_mutex_
+    std::unordered_map<std::string, BaseCheckpoint> bases_;
+    int64_t last_checkpoint_timestamp_ = 0;   ///< Writer only; keeps records in creation order
+    std::thread writer_;
+    
+    void writerLoop();
+    
+    // Write one checkpoint record (base or delta); true on success
+    bool writeCheckpoint(const PendingCheckpoint& checkpoint, bool& wrote_base,
+                         size_t& operator_bytes);
+    
+    // Latest state record of an engine, tombstone included; false if there is none
+    bool queryState(const std::string& compute_name, TimeSeriesData& record) const;
+    
+    // Latest record of a checkpoint; false if there is none or it was deleted.
+    // include_deleted skips the tombstone instead (for the bases of deltas)
+    bool queryCheckpoint(const std::string& compute_name, uint64_t checkpoint_id,
+                         TimeSeriesData& record, bool include_deleted = false) const;
+    
     // Helper: Convert ComputeState to TimeSeriesData
     TimeSeriesData stateToData(const ComputeState& state) const;
     
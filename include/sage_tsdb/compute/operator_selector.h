@@ -0,0 +1,146 @@
+/**
+ * @file operator_selector.h
+ * @brief Cost-based choice of the PECJ operator for the next window
+ */
+
+#pragma once
+
+#ifdef PECJ_MODE_INTEGRATED
+
+#include "sage_tsdb/compute/pecj_compute_engine.h"
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace sage_tsdb {
+namespace compute {
+
+/**
+ * @brief Workload of one window as seen by the engine
+ */
+struct WorkloadSample {
+    size_t input_tuples = 0;        ///< |S| + |R|
+    uint64_t window_len_us = 0;
+    double distinct_keys = 0.0;     ///< Key cardinality (estimated)
+    double selectivity = 0.0;       ///< join_count / (|S| * |R|)
+};
+
+/**
+ * @brief Predicted cost and accuracy of one operator on the current workload
+ */
+struct OperatorEstimate {
+    PECJOperatorType type = PECJOperatorType::IAWJ;
+    double latency_ms = 0.0;
+    double error = 0.0;             ///< Expected relative error of the window result
+    bool meets_slo = false;
+};
+
+/**
+ * @brief Picks the operator that meets the latency SLO with the lowest error
+ *
+ * The workload (arrival rate, disorder, key cardinality, selectivity) is
+ * tracked as a moving average of the windows observed. Disorder is the
+ * fraction of tuples that arrive after their window was computed.
+ *
+ * Latency model: per-tuple cost of each operator times the expected
+ * window size, plus a per-key cost for the operators that keep per-key
+ * statistics (PECJ) and a per-late-tuple buffering cost (MSWJ). The
+ * constants are priors in relative units; every observed window corrects
+ * the operator that ran by the ratio of its measured to predicted latency,
+ * and operators not run yet are scaled by the average correction, so the
+ * model adapts to the machine.
+ *
+ * Error model: an exact intra-window join misses the pairs of late tuples,
+ * about 2 * disorder of the result; MSWJ recovers most of them by
+ * buffering, PECJ compensates them and pays an estimation error that
+ * shrinks with the tuples per key.
+ *
+ * choose() returns the candidate with the lowest predicted error among
+ * those predicted to meet the SLO, or the fastest one when none does. To
+ * avoid flapping it keeps the current operator for min_windows_per_switch
+ * windows after a switch, and while it meets the SLO with an error within
+ * switch_margin of the best.
+ *
+ * Thread-safe.
+ */
+class OperatorSelector {
+public:
+    static std::vector<PECJOperatorType> defaultCandidates();
+
+    /**
+     * @param latency_slo_ms Window latency target (> 0)
+     * @param candidates Operators to choose among; the first one runs until
+     *        a window has been observed
+     */
+    explicit OperatorSelector(double latency_slo_ms,
+                              std::vector<PECJOperatorType> candidates = defaultCandidates());
+
+    /**
+     * @brief Record a window computed by op in latency_ms
+     *
+     * A window cut off by its deadline should be passed with timed_out; it
+     * counts as twice the SLO, as its real cost is unknown but larger.
+     */
+    void observeWindow(PECJOperatorType op, const WorkloadSample& sample,
+                       double latency_ms, bool timed_out = false);
+
+    /**
+     * @brief Record tuples that arrived after their window was computed
+     */
+    void observeLateTuples(size_t late_tuples);
+
+    /**
+     * @brief Operator for the next window; logs a decision when it changes
+     * @param window_id Window just observed, recorded with the decision
+     */
+    PECJOperatorType choose(uint64_t window_id);
+
+    PECJOperatorType current() const;
+
+    /**
+     * @brief Predictions for every candidate on the current workload
+     */
+    std::vector<OperatorEstimate> estimates() const;
+
+    /**
+     * @brief Switches made so far, oldest first (at most MAX_DECISIONS)
+     */
+    std::vector<OperatorDecision> decisions() const;
+    uint64_t switches() const;
+
+    double arrivalRate() const;
+    double disorder() const;
+
+    static constexpr size_t MAX_DECISIONS = 32;
+    size_t min_windows_per_switch = 3;
+    double switch_margin = 0.01;     ///< Error improvement needed to leave a fine operator
+
+private:
+    OperatorEstimate estimate(PECJOperatorType op) const;  // Caller holds mutex_
+    double calibration(PECJOperatorType op) const;        // Caller holds mutex_
+    double lateFraction() const;                          // Caller holds mutex_
+
+    const double latency_slo_ms_;
+    const std::vector<PECJOperatorType> candidates_;
+
+    mutable std::mutex mutex_;
+    PECJOperatorType current_;
+    bool observed_ = false;
+    double arrival_rate_ = 0.0;      ///< Tuples per second
+    double window_tuples_ = 0.0;
+    double distinct_keys_ = 1.0;
+    double selectivity_ = 0.0;
+    double recent_tuples_ = 0.0;     ///< Window tuples, decayed per window
+    double recent_late_ = 0.0;       ///< Late tuples, decayed the same way
+    std::map<PECJOperatorType, double> calibration_;  ///< Measured / predicted latency
+    size_t windows_since_switch_ = 0;
+    uint64_t switches_ = 0;
+    std::vector<OperatorDecision> decisions_;
+};
+
+} // namespace compute
+} // namespace sage_tsdb
+
+#endif // PECJ_MODE_INTEGRATED
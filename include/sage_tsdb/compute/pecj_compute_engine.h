@@ -12,18 +12,26 @@
 
 #pragma once
 
+#include <chrono>
 #include <cstdint>
+#include <functional>
 #include <memory>
 #include <string>
 #include <vector>
 #include <shared_mutex>
+#include <mutex>
 #include <atomic>
+#include <condition_variable>
+
+#include "sage_tsdb/core/latency_histogram.h"
+#include "sage_tsdb/core/metrics_registry.h"
 
 #ifdef PECJ_MODE_INTEGRATED
 
 // Forward declarations
 namespace sage_tsdb {
 class TimeSeriesDB;  // TimeSeriesDB is in sage_tsdb namespace, not sage_tsdb::core
+struct TimeSeriesData;
 
 namespace core {
 class ResourceHandle;
@@ -38,6 +46,9 @@ struct TrackTuple;
 namespace sage_tsdb {
 namespace compute {
 
+class SharedScanCoordinator;
+class OperatorSelector;
+
 /**
  * @brief Time range specification for window queries
  */
@@ -53,6 +64,35 @@ struct TimeRange {
     inline bool valid() const { return end_us > start_us; }
 };
 
+/**
+ * @brief Deadline and cancel flag polled by the join kernels
+ * 
+ * Kernels check expired() only between batches of tuples (or panes), so
+ * a window stops within one batch of the deadline or of cancel(). A
+ * default-constructed token never expires.
+ */
+class CancellationToken {
+public:
+    CancellationToken() = default;
+    explicit CancellationToken(std::chrono::steady_clock::duration timeout)
+        : deadline_(std::chrono::steady_clock::now() + timeout) {}
+    
+    CancellationToken(const CancellationToken&) = delete;
+    CancellationToken& operator=(const CancellationToken&) = delete;
+    
+    void cancel() { cancelled_.store(true, std::memory_order_relaxed); }
+    
+    bool expired() const {
+        return cancelled_.load(std::memory_order_relaxed) ||
+               (deadline_ != std::chrono::steady_clock::time_point::max() &&
+                std::chrono::steady_clock::now() >= deadline_);
+    }
+    
+private:
+    std::atomic<bool> cancelled_{false};
+    std::chrono::steady_clock::time_point deadline_ = std::chrono::steady_clock::time_point::max();
+};
+
 /**
  * @brief PECJ operator type enumeration
  * 
@@ -68,6 +108,7 @@ struct TimeRange {
  * - SHJ: Symmetric Hash Join (raw baseline)
  * - PRJ: Progressive Join (raw baseline)
  * - PECJ: PECJ operator with full compensation
+ * - Auto: chosen per window by the engine's cost model (OperatorSelector)
  */
 enum class PECJOperatorType {
     IAWJ,           ///< Intra-window join - single window only
@@ -80,7 +121,8 @@ enum class PECJOperatorType {
     LazyIAWJSel,    ///< Lazy evaluation PECJ join
     SHJ,            ///< Symmetric Hash Join (baseline)
     PRJ,            ///< Progressive Join (baseline)
-    PECJ            ///< Full PECJ operator
+    PECJ,           ///< Full PECJ operator
+    Auto            ///< Cost-based choice among IAWJ/SHJ/PRJ/MSWJ/PECJ
 };
 
 /**
@@ -101,10 +143,20 @@ inline std::string operatorTypeToString(PECJOperatorType type) {
         case PECJOperatorType::SHJ:         return "SHJ";
         case PECJOperatorType::PRJ:         return "PRJ";
         case PECJOperatorType::PECJ:        return "IMA";  // PECJ uses IMA internally
+        case PECJOperatorType::Auto:        return "Auto";
         default:                            return "IAWJ";
     }
 }
 
+/**
+ * @brief Name of an operator as accepted in ComputeConfig::operator_type
+ * 
+ * Unlike operatorTypeToString(), PECJ is named PECJ rather than its IMA tag.
+ */
+inline std::string operatorName(PECJOperatorType type) {
+    return type == PECJOperatorType::PECJ ? "PECJ" : operatorTypeToString(type);
+}
+
 /**
  * @brief Convert string tag to operator type enum
  * @param tag The string tag
@@ -122,6 +174,7 @@ inline PECJOperatorType stringToOperatorType(const std::string& tag) {
     if (tag == "SHJ")         return PECJOperatorType::SHJ;
     if (tag == "PRJ")         return PECJOperatorType::PRJ;
     if (tag == "PECJ" || tag == "PEC") return PECJOperatorType::PECJ;
+    if (tag == "Auto")        return PECJOperatorType::Auto;
     return PECJOperatorType::IAWJ;  // Default
 }
 
@@ -153,10 +206,11 @@ struct ComputeConfig {
     uint64_t slide_len_us = 500000;       ///< Slide length (500ms default)
     
     // Algorithm parameters
-    std::string operator_type = "IAWJ";   ///< Operator type string tag
+    std::string operator_type = "IAWJ";   ///< Operator type string tag ("Auto" = cost-based choice)
     PECJOperatorType operator_enum = PECJOperatorType::IAWJ; ///< Operator type enum
     uint64_t max_delay_us = 100000;       ///< Maximum allowed delay (100ms)
     double aqp_threshold = 0.05;          ///< AQP error threshold (5%)
+    double latency_slo_ms = 0.0;          ///< Auto: window latency target (0 = timeout_ms, or 1s without one)
     
     // PECJ-specific parameters
     uint64_t s_buffer_len = 100000;       ///< S buffer size
@@ -175,14 +229,22 @@ struct ComputeConfig {
     // MSWJ specific
     bool mswj_compensation = false;        ///< Enable linear compensation in MSWJ
     
+    // Pane-based sliding windows
+    bool enable_pane_mode = false;         ///< Build windows from cached slide-sized panes (exact key-equality join count)
+    size_t max_cached_panes = 0;           ///< Pane cache bound (0 = window_len / slide_len + 1)
+    
     // Resource limits
     size_t max_memory_bytes = 2ULL * 1024 * 1024 * 1024;  ///< 2GB default
-    int max_threads = 4;                  ///< Thread limit
+    int max_threads = 4;                  ///< Thread limit; key buckets the join kernel splits a window into
+    size_t parallel_join_min_tuples = 65536;  ///< Smaller windows join on one thread
+    size_t max_concurrent_windows = 4;    ///< Pooled operators; further windows wait for one
     
     // Performance tuning
     bool enable_aqp = true;               ///< Enable AQP fallback
-    bool enable_simd = true;              ///< Enable SIMD optimization
-    uint64_t timeout_ms = 1000;           ///< Computation timeout
+    bool enable_simd = false;             ///< Join IAWJ/SHJ windows with the built-in radix hash join (SIMD probes)
+    uint64_t timeout_ms = 1000;           ///< Window deadline (0 = none); late windows return an estimate
+    bool complete_after_timeout = true;   ///< Recompute timed-out windows exactly on the background handle
+    bool retain_late_state = false;       ///< Keep per-key window state for max_delay_us to join late tuples alone
     
     // Table names
     std::string stream_s_table = "stream_s";
@@ -212,7 +274,33 @@ struct ComputeStatus {
     double selectivity = 0.0;             ///< join_count / (|S| * |R|)
     double aqp_error = 0.0;               ///< |exact - aqp| / exact
     bool used_aqp = false;                ///< Whether AQP was used
-    bool timeout_occurred = false;        ///< Whether timeout happened
+    bool timeout_occurred = false;        ///< Deadline cut the join short; join_count is an estimate
+    bool exact_completion = false;        ///< Background exact result of a timed-out window
+    
+    // Pane mode
+    bool used_panes = false;              ///< Whether the window was combined from panes
+    size_t panes_computed = 0;            ///< Panes read from the tables for this window
+    size_t panes_reused = 0;              ///< Panes taken from the cache
+    
+    bool used_join_kernel = false;        ///< Joined by the built-in hash join kernel (enable_simd)
+    size_t join_buckets = 0;              ///< Key buckets the kernel joined as separate tasks
+    
+    bool late_correction = false;         ///< join_count updated by late tuples (inputs are the late tuples)
+    
+    size_t key_cardinality = 0;           ///< Distinct keys in a sample of the inputs (Auto only)
+};
+
+/**
+ * @brief A switch of the Auto operator, with the prediction that caused it
+ */
+struct OperatorDecision {
+    uint64_t window_id = 0;               ///< Last window run on the previous operator
+    std::string from;
+    std::string to;
+    double predicted_latency_ms = 0.0;
+    double predicted_error = 0.0;
+    double arrival_rate = 0.0;            ///< Tuples per second when decided
+    double disorder = 0.0;                ///< Late tuple fraction when decided
 };
 
 /**
@@ -224,11 +312,14 @@ struct ComputeMetrics {
     uint64_t total_tuples_processed = 0;
     double avg_throughput_events_per_sec = 0.0;
     
-    // Latency metrics (milliseconds)
+    // Latency metrics (milliseconds, over all completed windows)
     double avg_window_latency_ms = 0.0;
     double min_window_latency_ms = 0.0;
     double max_window_latency_ms = 0.0;
+    double p50_window_latency_ms = 0.0;
+    double p90_window_latency_ms = 0.0;
     double p99_window_latency_ms = 0.0;
+    double p999_window_latency_ms = 0.0;
     
     // Resource metrics
     size_t peak_memory_bytes = 0;
@@ -243,7 +334,25 @@ struct ComputeMetrics {
     // Error metrics
     uint64_t failed_windows = 0;
     uint64_t timeout_windows = 0;
+    uint64_t exact_completions = 0;       ///< Timed-out windows later completed exactly
     uint64_t retry_count = 0;
+    
+    // Pane mode
+    uint64_t panes_computed = 0;
+    uint64_t pane_cache_hits = 0;
+    
+    // Operator pool
+    uint64_t pooled_operators = 0;        ///< Operator instances built so far
+    
+    // Late data
+    uint64_t late_corrections = 0;        ///< joinLateTuples() calls that updated a window
+    uint64_t late_tuples_joined = 0;
+    uint64_t retained_windows = 0;        ///< Windows whose state is kept for late tuples
+    
+    // Auto operator (kept across reset(), like the cost model)
+    std::string active_operator;          ///< Operator of the next window
+    uint64_t operator_switches = 0;
+    std::vector<OperatorDecision> operator_decisions;  ///< Recent switches, oldest first
 };
 
 /**
@@ -297,16 +406,91 @@ public:
      * 4. Convert results back to sageTSDB format
      * 5. Write results to join_results table
      * 6. Return computation statistics
+     * 
+     * Pane mode (config.enable_pane_mode): when window_len is a multiple
+     * of slide_len and time_range is slide-aligned, the stream is cut into
+     * slide-sized panes. Each pane is read once and reduced to per-key
+     * tuple counts, which are cached; the window's join count is kept
+     * incrementally as panes enter and leave it, so a slide costs
+     * O(slide) instead of O(window). Panes before the window start (the
+     * watermark) are evicted. A pane is read when it first enters a
+     * window; tuples arriving in it later are not seen, as in the
+     * scheduler's watermark contract. Other windows, and join_sum, use
+     * the operator path.
+     * 
+     * Join kernel (config.enable_simd, IAWJ and SHJ only): windows that do
+     * not take the pane path are joined by the built-in radix-partitioned
+     * hash join instead of the PECJ operator, exactly and with the same
+     * load shedding; a deadline is checked between partitions and a
+     * cut-off join is scaled by the share of partitions joined. Windows of
+     * at least parallel_join_min_tuples are split by key into max_threads
+     * buckets, joined as tasks on the resource handle (the calling thread
+     * joins buckets too); counts, sums and per-bucket estimates are added.
      */
     ComputeStatus executeWindowJoin(uint64_t window_id,
                                     const TimeRange& time_range);
     
+    /**
+     * @brief Execute a window join that stops when token expires
+     * 
+     * The overload above uses a token with a ComputeConfig::timeout_ms
+     * deadline. The operator path feeds S and R in matching batches of
+     * tuples and the pane path adds one pane at a time; both check the
+     * token in between. When it has expired, the window returns the
+     * partial count scaled by 1/f^2 for the fed fraction f of each stream,
+     * with timeout_occurred and used_aqp set. If complete_after_timeout is
+     * set and a background handle is installed, the window is then
+     * recomputed without a deadline on that handle and the exact status
+     * (exact_completion set) is passed to the onExactResult callbacks,
+     * e.g. to update the JoinResultTable.
+     */
+    ComputeStatus executeWindowJoin(uint64_t window_id,
+                                    const TimeRange& time_range,
+                                    const CancellationToken& token);
+    
+    /**
+     * @brief Join tuples that arrived after their window was computed
+     * @param window_id Window computed earlier
+     * @param late_s Late tuples of stream S ("key" tag, "value" field)
+     * @param late_r Late tuples of stream R
+     * @return Status whose join_count is the window's updated result
+     * 
+     * With config.retain_late_state, every computed window keeps its
+     * per-key tuple counts (and R value sums for join_sum) until the
+     * watermark passes its end + max_delay_us. Late tuples are joined only
+     * against the opposite side of that state and then added to it, so
+     * the result grows by exactly the pairs they form, without reading
+     * the window again. Fails if the window's state is not retained
+     * (disabled, expired, or a timed-out pane window); the caller then
+     * recomputes the window.
+     */
+    ComputeStatus joinLateTuples(uint64_t window_id,
+                                 const std::vector<TimeSeriesData>& late_s,
+                                 const std::vector<TimeSeriesData>& late_r);
+    
+    /**
+     * @brief Drop retained state of windows with end + max_delay_us <= watermark_us
+     * 
+     * Computing a window also expires state up to its start.
+     */
+    void expireLateState(int64_t watermark_us);
+    
     /**
      * @brief Get runtime metrics (thread-safe)
      * @return Current metrics snapshot
      */
     ComputeMetrics getMetrics() const;
     
+    /**
+     * @brief Export the window counters, peak memory, sample rate and
+     *        window latency as sage_tsdb_compute_* metrics
+     * @return Handles that must be dropped before the engine
+     * 
+     * Every callback reads a Counter or an atomic, never metrics_mutex_.
+     */
+    std::vector<MetricsRegistry::Handle> registerMetrics(MetricsRegistry& registry,
+                                                         const Tags& labels) const;
+    
     /**
      * @brief Reset computation state
      * 
@@ -324,6 +508,72 @@ public:
      * @brief Get current configuration
      */
     const ComputeConfig& getConfig() const { return config_; }
+    
+    /**
+     * @brief Operator the next window runs on
+     * 
+     * config.operator_type, except with "Auto": then an OperatorSelector
+     * observes every window (arrival rate, key cardinality, selectivity,
+     * latency) and every joinLateTuples() call (disorder), and between
+     * windows picks the operator predicted to meet latency_slo_ms with the
+     * lowest error. Pooled operators are rebuilt for the new type when
+     * they next run; with enable_simd, IAWJ and SHJ windows take the join
+     * kernel. Switches are logged in ComputeMetrics::operator_decisions.
+     */
+    std::string activeOperator() const;
+    
+    // ========== Load Shedding ==========
+    
+    /**
+     * @brief Feed only a sample of each stream and scale the count (AQP)
+     * @param rate Fraction of tuples kept, clamped to (0, 1]; 1 = exact join
+     * 
+     * With rate r every round(1/r)-th tuple of S and R is fed and the join
+     * count is scaled by the squared stride. Ignored unless
+     * ComputeConfig::enable_aqp.
+     */
+    void setSampleRate(double rate);
+    double getSampleRate() const { return sample_rate_.load(); }
+    
+    /**
+     * @brief Change the operator pool bound (ComputeConfig::max_concurrent_windows)
+     */
+    void setMaxConcurrentWindows(size_t windows);
+    
+    // ========== Timeout Completion ==========
+    
+    using ExactResultCallback = std::function<void(const ComputeStatus&)>;
+    
+    /**
+     * @brief Handle that recomputes timed-out windows (not owned)
+     * 
+     * Typically allocated with a lower priority than the handle running
+     * the windows, so exact completions only use idle workers. Null
+     * disables background completion.
+     */
+    void setBackgroundHandle(core::ResourceHandle* handle);
+    
+    // ========== Shared Scans ==========
+    
+    /**
+     * @brief Read the input tables through a coordinator shared with other engines (not owned)
+     * 
+     * Window scans and pane counts then come from the coordinator's cache,
+     * so engines running different operators or window lengths over the
+     * same streams read each table range once between them; engines with
+     * the same slide also share panes. See SharedScanCoordinator for when
+     * tuples are read. Set before windows run; null reads the tables
+     * directly again. The coordinator must outlive the engine or be reset
+     * here first.
+     */
+    void setSharedScan(SharedScanCoordinator* scan);
+    
+    /**
+     * @brief Register a callback for exact results of timed-out windows
+     * 
+     * Called on a background worker; must be registered before windows run.
+     */
+    void onExactResult(ExactResultCallback callback);
 
 private:
     // === Core Components ===
@@ -332,28 +582,85 @@ private:
     ComputeConfig config_;                      ///< Algorithm configuration
     std::atomic<bool> initialized_;             ///< Initialization flag
     
-    // === PECJ Operator ===
-#ifdef PECJ_FULL_INTEGRATION
-    std::shared_ptr<OoOJoin::AbstractOperator> pecj_operator_;  // PECJ uses shared_ptr
-#endif
-    
     // === Metrics Tracking ===
-    mutable std::shared_mutex metrics_mutex_;   ///< Protects metrics_
+    mutable std::shared_mutex metrics_mutex_;   ///< Protects metrics_ (AQP error only)
     ComputeMetrics metrics_;                    ///< Runtime metrics
-    std::vector<double> latency_samples_;       ///< Latency history for percentile calculation
+    LatencyHistogram window_latency_;           ///< Window computation time (us), lock-free
+    
+    // Counted without metrics_mutex_; getMetrics() copies them into ComputeMetrics
+    Counter windows_completed_;
+    Counter tuples_processed_;
+    Counter failed_windows_;
+    Counter timeout_windows_;
+    Counter exact_completions_;
+    Counter panes_computed_;
+    Counter pane_cache_hits_;
+    Counter late_corrections_;
+    Counter late_tuples_joined_;
+    std::atomic<double> selectivity_sum_{0.0}; ///< Over completed windows
+    std::atomic<size_t> peak_memory_bytes_{0};
     
     // === Memory Management ===
     std::atomic<size_t> current_memory_usage_; ///< Current memory usage
+    std::atomic<double> sample_rate_{1.0};     ///< AQP sampling; 1 = exact
+    
+    // === Timeout Completion ===
+    std::atomic<core::ResourceHandle*> background_handle_{nullptr};
+    std::vector<ExactResultCallback> exact_callbacks_;
+    std::mutex callbacks_mutex_;
+    struct Lifetime {                           ///< Lets queued completions outlive the engine safely
+        std::shared_mutex mutex;                ///< Shared while a completion runs
+        bool alive = true;
+    };
+    std::shared_ptr<Lifetime> lifetime_ = std::make_shared<Lifetime>();
+    
+    // === Auto Operator ===
+    std::unique_ptr<OperatorSelector> selector_; ///< Set when operator_type is "Auto"
+    
+    // === Shared Scans ===
+    SharedScanCoordinator* shared_scan_ = nullptr;
+    uint64_t scan_consumer_ = 0;                ///< Our consumer id at shared_scan_
+    
+    // === Pane Mode ===
+    struct PaneState;                           ///< Cached panes and running window aggregate
+    std::unique_ptr<PaneState> panes_;
+    std::mutex pane_mutex_;                     ///< Serializes pane-mode windows
+    
+    // === Late Data ===
+    struct LateWindow;                          ///< Per-key counts of one computed window
+    struct LateState;                           ///< Retained windows by id
+    std::unique_ptr<LateState> late_;
+    mutable std::mutex late_mutex_;             ///< Protects late_
+    
+    // === Operator Pool ===
+    struct WindowSlot;                          ///< Configured PECJ operator plus its input buffers
+    std::vector<std::unique_ptr<WindowSlot>> idle_slots_;
+    size_t slots_created_ = 0;                  ///< Idle plus checked out
+    size_t slot_limit_ = 1;                     ///< Current max_concurrent_windows
+    mutable std::mutex pool_mutex_;             ///< Protects idle_slots_ and slots_created_
+    std::condition_variable pool_cv_;           ///< Signalled when a slot is returned
     
     // === Private Methods ===
     
-#ifdef PECJ_FULL_INTEGRATION
     /**
-     * @brief Convert sageTSDB data to PECJ TrackTuple format
+     * @brief Check out a slot, waiting while max_concurrent_windows are
+     *        checked out and building one when none is idle
+     * 
+     * The slot goes back to the pool when the returned pointer is released.
+     * nullptr if a new operator could not be created.
      */
-    std::vector<OoOJoin::TrackTuple> convertFromTable(
-        const std::vector<std::vector<uint8_t>>& db_data);
+    std::shared_ptr<WindowSlot> acquireSlot();
     
+    /**
+     * @brief Scan both input tables for time_range into slot in one pass
+     * 
+     * Keys, values and event times are read straight from the table views;
+     * [min_ts, max_ts] is widened to cover every scanned tuple.
+     */
+    void scanWindowInputs(const TimeRange& time_range, WindowSlot& slot,
+                          int64_t& min_ts, int64_t& max_ts);
+    
+#ifdef PECJ_FULL_INTEGRATION
     /**
      * @brief Convert PECJ join result to sageTSDB format
      */
@@ -362,38 +669,77 @@ private:
 #endif
     
     /**
-     * @brief Update metrics after window completion
+     * @brief Operator for the next window (the selector's choice in Auto mode)
      */
-    void updateMetrics(const ComputeStatus& status);
+    PECJOperatorType currentOperator() const;
     
     /**
-     * @brief Check if memory usage exceeds limit
+     * @brief Feed a computed window to the Auto selector and pick the next operator
      */
-    bool checkMemoryLimit() const;
+    void selectOperator(PECJOperatorType ran, const TimeRange& time_range,
+                        const ComputeStatus& status);
     
     /**
-     * @brief Create PECJ operator based on configuration
+     * @brief Whether time_range can be combined from panes
      */
-    bool createPECJOperator();
+    bool paneAligned(const TimeRange& time_range) const;
     
-#ifdef PECJ_FULL_INTEGRATION
     /**
-     * @brief Execute join with timeout protection
+     * @brief Validate and run one window, scheduling its exact completion on timeout
      */
-    ComputeStatus executeWithTimeout(
-        const std::vector<OoOJoin::TrackTuple>& s_data,
-        const std::vector<OoOJoin::TrackTuple>& r_data,
-        uint64_t window_id,
-        const TimeRange& time_range);
+    ComputeStatus execute(uint64_t window_id, const TimeRange& time_range,
+                          const CancellationToken& token, bool exact_completion);
     
     /**
-     * @brief Fallback to AQP estimation
+     * @brief Execute a window on a pooled PECJ operator
      */
-    ComputeStatus fallbackToAQP(
-        const std::vector<OoOJoin::TrackTuple>& s_data,
-        const std::vector<OoOJoin::TrackTuple>& r_data,
-        uint64_t window_id);
-#endif
+    ComputeStatus executeOperatorWindow(uint64_t window_id, const TimeRange& time_range,
+                                        const CancellationToken& token, bool exact_completion);
+    
+    /**
+     * @brief Whether windows run on the built-in hash join kernel
+     */
+    bool usesJoinKernel() const;
+    
+    /**
+     * @brief Execute a window with the radix-partitioned hash join kernel
+     * 
+     * Exact key-equality join of the window's tuples (count, or R values
+     * summed over the pairs with join_sum), without a PECJ operator.
+     */
+    ComputeStatus executeKernelWindow(uint64_t window_id, const TimeRange& time_range,
+                                      const CancellationToken& token, bool exact_completion);
+    
+    /**
+     * @brief Execute a slide-aligned window from cached panes
+     */
+    ComputeStatus executePaneWindow(uint64_t window_id, const TimeRange& time_range,
+                                    const CancellationToken& token, bool exact_completion);
+    
+    /**
+     * @brief Keep window's state for late tuples (config.retain_late_state)
+     */
+    void retainLateWindow(uint64_t window_id, LateWindow window);
+    
+    /**
+     * @brief Recompute a timed-out window without deadline on the background handle
+     */
+    void scheduleExactCompletion(uint64_t window_id, const TimeRange& time_range);
+    
+    /**
+     * @brief Update metrics after window completion
+     */
+    void updateMetrics(const ComputeStatus& status);
+    
+    /**
+     * @brief Check if memory usage exceeds limit
+     */
+    bool checkMemoryLimit() const;
+    
+    /**
+     * @brief Create and configure the PECJ operator of slot
+     */
+    bool createPECJOperator(WindowSlot& slot);
     
     /**
      * @brief Write join results to database table
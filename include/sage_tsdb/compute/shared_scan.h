@@ -0,0 +1,165 @@
+/**
+ * @file shared_scan.h
+ * @brief Table scans shared by the compute engines reading the same streams
+ */
+
+#pragma once
+
+#include "sage_tsdb/core/time_series_data.h"
+#include <cstdint>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace sage_tsdb {
+
+class TimeSeriesDB;
+
+namespace compute {
+
+/**
+ * @brief Join input of one stream in columnar form
+ *
+ * clear() keeps the capacity, so a buffer reused across windows stops
+ * allocating once it has held the largest window.
+ */
+struct ScanColumns {
+    std::vector<uint64_t> keys;
+    std::vector<double> values;
+    std::vector<int64_t> event_times;
+
+    size_t size() const { return keys.size(); }
+
+    void clear() {
+        keys.clear();
+        values.clear();
+        event_times.clear();
+    }
+};
+
+/**
+ * @brief One slide-sized pane of both streams reduced to per-key tuple counts
+ */
+struct PaneCounts {
+    std::unordered_map<uint64_t, uint64_t> s_keys;
+    std::unordered_map<uint64_t, uint64_t> r_keys;
+    size_t s_count = 0;
+    size_t r_count = 0;
+};
+
+// Join key of a tuple ("key" tag), 0 if absent or malformed
+uint64_t joinKey(const Tags& tags);
+
+// Payload of a tuple ("value" field), 0 if absent or malformed
+double joinValue(const Fields& fields);
+
+// Appends the tuples of table in [start_us, end_us] (both inclusive) to
+// out, widening [min_ts, max_ts] to cover them
+void scanTableRange(const TimeSeriesDB& db, const std::string& table,
+                    int64_t start_us, int64_t end_us, ScanColumns& out,
+                    int64_t& min_ts, int64_t& max_ts);
+
+/**
+ * @brief Shared-scan counters
+ */
+struct SharedScanStats {
+    uint64_t segments_read = 0;    ///< Table reads, one per table segment
+    uint64_t segment_hits = 0;     ///< Segment requests served from the cache
+    uint64_t panes_computed = 0;
+    uint64_t pane_hits = 0;
+    size_t cached_segments = 0;
+    size_t cached_panes = 0;
+    size_t consumers = 0;
+};
+
+/**
+ * @brief Reads each table time range once for every engine that needs it
+ *
+ * Tables are cut into fixed segments of segment_len_us. The first scan
+ * touching a segment reads it from the database into columns; every
+ * other scan of it, by any consumer, copies the cached columns instead,
+ * and concurrent scans of a segment wait for the one read. Panes (per-key
+ * counts of a slide-sized range of both streams) are shared the same way
+ * between consumers with the same slide and tables, whatever their window
+ * lengths. The read cost thus stays that of one query however many
+ * engines run over the same streams.
+ *
+ * Consumers report the start of each window they compute; segments and
+ * panes ending before the earliest reported start are dropped. A segment
+ * is read once, when first needed, so tuples inserted into its range
+ * afterwards are not seen: windows should be computed once the watermark
+ * has passed them, as with pane mode.
+ *
+ * Thread-safe.
+ */
+class SharedScanCoordinator {
+public:
+    /**
+     * @param db Database the segments are read from (not owned)
+     * @param segment_len_us Length of a cached segment; a divisor of the
+     *        consumers' slides avoids reading tuples outside their windows
+     */
+    explicit SharedScanCoordinator(const TimeSeriesDB* db, uint64_t segment_len_us = 100000);
+
+    SharedScanCoordinator(const SharedScanCoordinator&) = delete;
+    SharedScanCoordinator& operator=(const SharedScanCoordinator&) = delete;
+
+    uint64_t registerConsumer();
+    void unregisterConsumer(uint64_t consumer);
+
+    /**
+     * @brief Append the tuples of table in [start_us, end_us] (inclusive) to out
+     *
+     * Same result as scanTableRange(), read through the segment cache.
+     */
+    void scan(const std::string& table, int64_t start_us, int64_t end_us,
+              ScanColumns& out, int64_t& min_ts, int64_t& max_ts);
+
+    /**
+     * @brief Pane index of slide_len_us, i.e. [index * slide, (index + 1) * slide)
+     */
+    std::shared_ptr<const PaneCounts> pane(const std::string& s_table, const std::string& r_table,
+                                           uint64_t slide_len_us, int64_t index);
+
+    /**
+     * @brief Record that consumer computes no window starting before start_us
+     */
+    void advance(uint64_t consumer, int64_t start_us);
+
+    SharedScanStats getStats() const;
+
+    /**
+     * @brief Drop every cached segment and pane
+     */
+    void clear();
+
+    uint64_t segmentLength() const { return segment_len_us_; }
+
+private:
+    using SegmentPtr = std::shared_ptr<const ScanColumns>;
+    using PanePtr = std::shared_ptr<const PaneCounts>;
+    using SegmentKey = std::pair<std::string, int64_t>;                            // Table, index
+    using PaneKey = std::tuple<std::string, std::string, uint64_t, int64_t>;       // S, R, slide, index
+
+    SegmentPtr segment(const std::string& table, int64_t index);
+    void evict();  // Caller holds mutex_
+
+    const TimeSeriesDB* db_;
+    const int64_t segment_len_us_;
+
+    mutable std::mutex mutex_;
+    std::map<SegmentKey, std::shared_future<SegmentPtr>> segments_;  ///< Loading or loaded
+    std::map<PaneKey, std::shared_future<PanePtr>> panes_;
+    std::map<uint64_t, int64_t> progress_;                           ///< Consumer -> earliest window start
+    uint64_t next_consumer_ = 1;
+    SharedScanStats stats_;
+};
+
+} // namespace compute
+} // namespace sage_tsdb
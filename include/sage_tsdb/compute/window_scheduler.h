@@ -14,8 +14,10 @@
 #pragma once
 
 #include "pecj_compute_engine.h"
+#include "sage_tsdb/core/metrics_registry.h"
 #include <cstdint>
 #include <functional>
+#include <limits>
 #include <memory>
 #include <string>
 #include <vector>
@@ -24,15 +26,18 @@
 #include <condition_variable>
 #include <unordered_map>
 #include <queue>
+#include <utility>
 #include <atomic>
 
 #ifdef PECJ_MODE_INTEGRATED
 
 namespace sage_tsdb {
-namespace core {
+struct TimeSeriesData;
 class TableManager;
 class StreamTable;
+namespace core {
 class ResourceHandle;
+class ResourceManager;
 }
 }
 
@@ -96,22 +101,31 @@ struct WindowSchedulerConfig {
     
     // Trigger policy
     TriggerPolicy trigger_policy = TriggerPolicy::Hybrid;
-    uint64_t trigger_interval_us = 100000; ///< Check interval (100ms)
+    uint64_t trigger_interval_us = 100000; ///< Maintenance interval (100ms); triggers wake the scheduler at once
     size_t trigger_count_threshold = 1000; ///< Minimum tuples per window
     
     // Scheduling parameters
     uint64_t max_delay_us = 100000;       ///< Maximum allowed delay
     uint64_t watermark_slack_us = 50000;  ///< Watermark slack (50ms)
-    bool allow_late_data = true;          ///< Process late-arriving data
+    bool allow_late_data = true;          ///< Process late-arriving data (see WindowScheduler)
     
     // Performance tuning
     size_t max_pending_windows = 10;      ///< Maximum windows in queue
     size_t max_concurrent_windows = 4;    ///< Parallel window computation
     bool enable_adaptive_scheduling = true; ///< Adjust based on workload
     
+    // Adaptive scheduling (feedback controller, see WindowScheduler::adapt)
+    double target_p99_latency_ms = 1000.0;  ///< SLO for ready-to-completion window latency
+    uint64_t adapt_interval_us = 500000;    ///< Controller period (500ms)
+    size_t min_concurrent_windows = 1;      ///< Floor when shedding concurrency
+    size_t max_adaptive_windows = 0;        ///< Ceiling when adding concurrency (0 = hardware threads)
+    size_t max_count_threshold_scale = 8;   ///< trigger_count_threshold may grow to this multiple
+    double aqp_sample_rate = 0.25;          ///< Engine sample rate while AQP is switched on
+    
     // Table names to watch
     std::string stream_s_table = "stream_s";
     std::string stream_r_table = "stream_r";
+    std::string result_table = "join_results";  ///< JoinResultTable receiving late-data corrections, if it exists
     
     // Monitoring
     bool enable_metrics = true;
@@ -136,6 +150,8 @@ struct WindowInfo {
     size_t stream_s_count = 0;    ///< Tuples in stream S
     size_t stream_r_count = 0;    ///< Tuples in stream R
     int64_t created_at_us = 0;    ///< Window creation timestamp
+    int64_t last_insert_at_us = 0; ///< Wall time of the latest insert into the window
+    int64_t ready_at_us = 0;      ///< When a trigger marked the window ready
     int64_t triggered_at_us = 0;  ///< Trigger timestamp
     int64_t completed_at_us = 0;  ///< Completion timestamp
 };
@@ -151,10 +167,19 @@ struct SchedulingMetrics {
     uint64_t pending_windows = 0;
     uint64_t active_windows = 0;
     
-    // Timing statistics
-    double avg_scheduling_latency_ms = 0.0;
-    double avg_window_completion_ms = 0.0;
+    // Timing statistics (milliseconds, over all windows since reset)
+    double avg_scheduling_latency_ms = 0.0;   ///< Ready -> handed to the resource handle
+    double p50_scheduling_latency_ms = 0.0;
+    double p90_scheduling_latency_ms = 0.0;
+    double p99_scheduling_latency_ms = 0.0;
+    double p999_scheduling_latency_ms = 0.0;
+    double avg_window_completion_ms = 0.0;    ///< Engine execution time
     double max_window_completion_ms = 0.0;
+    double avg_end_to_end_latency_ms = 0.0;   ///< Last insert into the window -> result
+    double p50_end_to_end_latency_ms = 0.0;
+    double p90_end_to_end_latency_ms = 0.0;
+    double p99_end_to_end_latency_ms = 0.0;
+    double p999_end_to_end_latency_ms = 0.0;
     
     // Throughput
     double windows_per_second = 0.0;
@@ -163,6 +188,15 @@ struct SchedulingMetrics {
     // Late data statistics
     uint64_t late_data_count = 0;
     uint64_t late_windows_recomputed = 0;
+    uint64_t late_windows_corrected = 0;  ///< Updated by joining only the late tuples
+    
+    // Adaptive scheduling
+    double p99_window_latency_ms = 0.0;   ///< Over the windows seen by the last controller step
+    size_t concurrency_limit = 0;         ///< Current max concurrent windows
+    size_t count_threshold = 0;           ///< Current trigger_count_threshold
+    bool aqp_active = false;              ///< Engine sampling switched on
+    uint64_t adaptations = 0;             ///< Controller steps that changed a setting
+    std::string last_adaptation;          ///< Latest decision, e.g. "concurrency 4 -> 5 (...)"
 };
 
 /**
@@ -186,6 +220,16 @@ using WindowCallback = std::function<void(const WindowInfo&, const ComputeStatus
  * 4. Automatically trigger window computations
  * 5. Callback on window completion
  * 6. Stop scheduler gracefully
+ * 
+ * Late data: tuples arriving for a completed window (has_late_data) are
+ * collected per window and handed to PECJComputeEngine::joinLateTuples(),
+ * which joins only them against the window's retained state (see
+ * ComputeConfig::retain_late_state). The updated count goes to the
+ * completion callbacks with late_correction set and, as a record tagged
+ * correction=late, to the result_table JoinResultTable. Windows without
+ * retained state, or whose late tuples are not known (onDataInserted),
+ * are recomputed in full. Late correction tasks take a concurrency slot
+ * like windows do.
  */
 class WindowScheduler {
 public:
@@ -198,7 +242,7 @@ public:
      */
     WindowScheduler(const WindowSchedulerConfig& config,
                     PECJComputeEngine* compute_engine,
-                    core::TableManager* table_manager,
+                    TableManager* table_manager,
                     core::ResourceHandle* resource_handle);
     
     ~WindowScheduler();
@@ -228,6 +272,10 @@ public:
      * @brief Watch a table for insertion events
      * @param table_name Name of the table to watch
      * @param stream_id Stream identifier (0 for S, 1 for R)
+     * 
+     * If the table manager has a StreamTable of that name, an insert
+     * listener on it reports every insert/insertBatch to the scheduler, so
+     * count and watermark triggers fire on the inserting thread.
      */
     void watchTable(const std::string& table_name, int stream_id);
     
@@ -278,6 +326,9 @@ public:
     /**
      * @brief Update watermark (timestamp below which no more data expected)
      * @param watermark_us Watermark timestamp
+     * 
+     * Windows whose end + watermark_slack_us is now covered become ready
+     * and the scheduler is woken immediately.
      */
     void updateWatermark(int64_t watermark_us);
     
@@ -286,6 +337,29 @@ public:
      */
     int64_t getWatermark() const { return watermark_us_.load(); }
     
+    // ========== Adaptive Scheduling ==========
+    
+    /**
+     * @brief Take resource pressure into account in adapt() (not owned)
+     */
+    void setResourceManager(core::ResourceManager* resource_manager);
+    
+    /**
+     * @brief Run one step of the adaptive controller
+     * 
+     * Called by the scheduler loop every adapt_interval_us when
+     * enable_adaptive_scheduling is set. Compares the p99 latency of the
+     * windows completed since the last change with target_p99_latency_ms
+     * and changes at most one setting per step:
+     * - resource pressure: halve concurrency (down to min_concurrent_windows)
+     * - over the SLO with windows queued: one more concurrent window
+     * - over the SLO otherwise: switch the engine to sampled AQP joins,
+     *   then double trigger_count_threshold
+     * - under half the SLO: undo AQP, then the threshold increase
+     * Decisions are reported in SchedulingMetrics.
+     */
+    void adapt();
+    
     // ========== Query & Monitoring ==========
     
     /**
@@ -326,6 +400,12 @@ private:
      */
     void schedulerLoop();
     
+    /**
+     * @brief Insert listener of a watched StreamTable
+     */
+    void onBatchInserted(const std::string& table_name,
+                         const TimeSeriesData* data, size_t count);
+    
     /**
      * @brief Check if a window should be triggered
      */
@@ -337,20 +417,70 @@ private:
     WindowInfo createWindow(int64_t timestamp);
     
     /**
-     * @brief Get or create window for a timestamp
+     * @brief Get or create window for a timestamp (caller holds windows_mutex_)
      */
     uint64_t getWindowIdForTimestamp(int64_t timestamp);
     
     /**
-     * @brief Execute window computation asynchronously
+     * @brief Execute window computation asynchronously (caller holds windows_mutex_)
      */
     void executeWindowAsync(WindowInfo& window);
     
     /**
-     * @brief Update window statistics
+     * @brief Update window statistics (caller holds windows_mutex_)
      */
     void updateWindowStats(uint64_t window_id, const std::string& table_name, size_t count);
     
+    /**
+     * @brief Account one insert to its window and mark it ready if a trigger
+     *        fires (caller holds windows_mutex_)
+     * @param point The inserted tuple, if known; needed to join it alone when late
+     * @return true if the window became ready or has late work
+     */
+    bool recordInsert(const std::string& table_name, int64_t timestamp, size_t count,
+                      int64_t now_us, const TimeSeriesData* point = nullptr);
+    
+    /**
+     * @brief Queue late tuples of a completed window, or recompute it
+     *        (caller holds windows_mutex_)
+     * @return true if there is late work for the scheduler
+     */
+    bool recordLateInsert(WindowInfo& window, const std::string& table_name, size_t count,
+                          const TimeSeriesData* point);
+    
+    /**
+     * @brief Recompute a completed window in full (caller holds windows_mutex_)
+     */
+    void recomputeWindow(WindowInfo& window);
+    
+    /**
+     * @brief Submit the collected late tuples of one window as a correction
+     *        task (caller holds windows_mutex_)
+     */
+    void executeLateCorrection(uint64_t window_id);
+    
+    /**
+     * @brief Write a late correction to the result table, if it exists
+     */
+    void writeCorrection(const WindowInfo& window, const ComputeStatus& status);
+    
+    /**
+     * @brief Invoke completion or failure callbacks
+     */
+    void invokeCallbacks(const WindowInfo& window, const ComputeStatus& status);
+    
+    /**
+     * @brief Queue a window for computation (caller holds windows_mutex_)
+     */
+    void markReady(WindowInfo& window);
+    
+    /**
+     * @brief Mark ready every window whose watermark deadline is covered
+     *        (caller holds windows_mutex_)
+     * @return Number of windows that became ready
+     */
+    size_t fireWatermarkTimers(int64_t watermark_us);
+    
     /**
      * @brief Update watermark based on data timestamps
      */
@@ -373,7 +503,7 @@ private:
     
     // External components (not owned)
     PECJComputeEngine* compute_engine_;
-    core::TableManager* table_manager_;
+    TableManager* table_manager_;
     core::ResourceHandle* resource_handle_;
     
     // Scheduler state
@@ -384,8 +514,22 @@ private:
     // Window management
     std::unordered_map<uint64_t, WindowInfo> windows_;  ///< window_id -> WindowInfo
     std::priority_queue<uint64_t> pending_windows_;     ///< Windows ready to compute (min-heap by window_id)
+    size_t active_windows_ = 0;                         ///< Windows currently computing
     mutable std::mutex windows_mutex_;
-    std::condition_variable windows_cv_;
+    std::condition_variable windows_cv_;                ///< Signalled on ready, completion and stop
+    
+    // Late tuples of completed windows, awaiting a correction task
+    struct LateTuples {
+        std::vector<TimeSeriesData> s;
+        std::vector<TimeSeriesData> r;
+    };
+    std::unordered_map<uint64_t, LateTuples> late_tuples_;  ///< Guarded by windows_mutex_
+    
+    // Watermark deadlines (end + slack -> window_id), earliest first
+    using WatermarkTimer = std::pair<int64_t, uint64_t>;
+    std::priority_queue<WatermarkTimer, std::vector<WatermarkTimer>,
+                        std::greater<WatermarkTimer>> watermark_timers_;
+    std::atomic<int64_t> next_deadline_us_{std::numeric_limits<int64_t>::max()};  ///< Earliest deadline
     
     // Watermark tracking
     std::atomic<int64_t> watermark_us_{0};
@@ -398,6 +542,8 @@ private:
     struct WatchedTable {
         std::string table_name;
         int stream_id;  // 0 for S, 1 for R
+        std::shared_ptr<StreamTable> table;  // Null if not a StreamTable
+        uint64_t listener_id = 0;
     };
     std::vector<WatchedTable> watched_tables_;
     mutable std::mutex watched_tables_mutex_;
@@ -412,8 +558,21 @@ private:
     SchedulingMetrics metrics_;
     int64_t metrics_last_update_us_ = 0;
     
-    // Performance tracking
-    std::vector<double> window_completion_times_;  // For computing averages
+    // Latency tracking (microseconds; lock-free, merged in getMetrics)
+    LatencyHistogram completion_latency_;          // Engine execution
+    LatencyHistogram scheduling_latency_;          // Ready -> triggered
+    LatencyHistogram end_to_end_latency_;          // Last insert -> completed
+    LatencyHistogram adapt_latency_;               // Ready -> completed, since the last adaptation
+    Counter windows_completed_;
+    Counter windows_failed_;
+    std::vector<MetricsRegistry::Handle> metric_handles_;  // In the TableManager's registry
+    
+    // Adaptive scheduling (limits guarded by windows_mutex_)
+    core::ResourceManager* resource_manager_ = nullptr;
+    size_t concurrency_limit_;
+    size_t count_threshold_;
+    bool aqp_active_ = false;
+    int64_t last_adapt_us_ = 0;                    // Scheduler thread only
 };
 
 } // namespace compute
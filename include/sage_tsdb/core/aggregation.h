@@ -0,0 +1,302 @@
+#pragma once
+
+#include "sketch.h"
+#include "time_series_data.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+namespace sage_tsdb {
+
+/**
+ * @brief Count/sum/min/max/first/last of the values of a run of points
+ *
+ * Stored per SSTable block so aggregates over whole blocks need no
+ * decoding. Values are TimeSeriesData::as_double(). merge() assumes the
+ * two summaries cover disjoint time ranges.
+ *
+ * add() also feeds a quantile and a distinct-count sketch, which answer
+ * QUANTILE and DISTINCT. Summaries built without them (column kernels,
+ * files written before sketches existed) have sketched == false and
+ * yield NaN for those two.
+ */
+struct BlockSummary {
+    uint64_t count = 0;
+    double sum = 0.0;
+    double sum_squares = 0.0;
+    double min = 0.0;
+    double max = 0.0;
+    int64_t first_timestamp = 0;
+    double first = 0.0;
+    int64_t last_timestamp = 0;
+    double last = 0.0;
+    QuantileSketch quantiles;
+    DistinctSketch distinct;
+    bool sketched = true;       // The sketches cover every point counted
+    
+    bool empty() const { return count == 0; }
+    // Points must arrive in timestamp order
+    void add(const TimeSeriesData& point) { add(point.timestamp, point.as_double()); }
+    void add(int64_t timestamp, double value);
+    // Without with_sketches the result drops its sketches (cheaper)
+    void merge(const BlockSummary& other, bool with_sketches = true);
+    // NaN for an empty summary, except COUNT, SUM and DISTINCT; NONE yields
+    // NaN; quantile is the q of QUANTILE
+    double value(AggregationType type, double quantile = 0.5) const;
+    
+    size_t memory_bytes() const {
+        return sizeof(BlockSummary) + quantiles.memory_bytes() + distinct.memory_bytes();
+    }
+};
+
+// Whether type is answered from the sketches rather than the moments
+inline bool needs_sketches(AggregationType type) {
+    return type == AggregationType::QUANTILE || type == AggregationType::DISTINCT;
+}
+
+/**
+ * @brief Scan kernels over value columns
+ *
+ * Sum, sum of squares, min and max are accumulated in SIMD lanes (AVX-512
+ * or AVX2 as simd::active() picks at run time, four independent scalar
+ * lanes otherwise) and combined at the end, so sums may differ from a
+ * sequential loop in the last bits. NaN values propagate into the sums
+ * and are skipped by min and max on every path. Timestamps must be in ascending
+ * order; first and last are taken from the ends.
+ */
+namespace column_kernels {
+
+// Summary of values[0, count) stamped timestamps[0, count)
+BlockSummary summarize(const int64_t* timestamps, const double* values, size_t count);
+
+// Summary of values[rows[i]] for i in [0, count); rows increasing
+BlockSummary summarize_rows(const int64_t* timestamps, const double* values,
+                            const uint32_t* rows, size_t count);
+
+} // namespace column_kernels
+
+/**
+ * @brief Running aggregate specialized for one AggregationType
+ *
+ * Keeps only the state Type needs, so the per-point work of e.g. COUNT is
+ * a single increment. Points must arrive in timestamp order; whole
+ * summaries of later points may be folded in with add(BlockSummary)
+ * (sketched ones for QUANTILE and DISTINCT).
+ */
+template <AggregationType Type>
+class Accumulator {
+public:
+    explicit Accumulator(double quantile = 0.5) : quantile_(quantile) {}
+    
+    bool empty() const { return count_ == 0; }
+    
+    void add(double value) {
+        if constexpr (Type == AggregationType::MIN) {
+            min_ = count_ == 0 ? value : std::min(min_, value);
+        } else if constexpr (Type == AggregationType::MAX) {
+            max_ = count_ == 0 ? value : std::max(max_, value);
+        } else if constexpr (Type == AggregationType::FIRST) {
+            if (count_ == 0) first_ = value;
+        } else if constexpr (Type == AggregationType::LAST) {
+            last_ = value;
+        } else if constexpr (Type == AggregationType::QUANTILE) {
+            quantiles_.add(value);
+        } else if constexpr (Type == AggregationType::DISTINCT) {
+            distinct_.add(value);
+        } else if constexpr (Type != AggregationType::COUNT) {
+            sum_ += value;
+            if constexpr (Type == AggregationType::STDDEV) {
+                sum_squares_ += value * value;
+            }
+        }
+        ++count_;
+    }
+    
+    void add(const BlockSummary& summary) {
+        if (summary.empty()) {
+            return;
+        }
+        if constexpr (Type == AggregationType::MIN) {
+            min_ = count_ == 0 ? summary.min : std::min(min_, summary.min);
+        } else if constexpr (Type == AggregationType::MAX) {
+            max_ = count_ == 0 ? summary.max : std::max(max_, summary.max);
+        } else if constexpr (Type == AggregationType::FIRST) {
+            if (count_ == 0) first_ = summary.first;
+        } else if constexpr (Type == AggregationType::LAST) {
+            last_ = summary.last;
+        } else if constexpr (Type == AggregationType::QUANTILE) {
+            quantiles_.merge(summary.quantiles);
+        } else if constexpr (Type == AggregationType::DISTINCT) {
+            distinct_.merge(summary.distinct);
+        } else if constexpr (Type != AggregationType::COUNT) {
+            sum_ += summary.sum;
+            if constexpr (Type == AggregationType::STDDEV) {
+                sum_squares_ += summary.sum_squares;
+            }
+        }
+        count_ += summary.count;
+    }
+    
+    // Same conventions as BlockSummary::value()
+    double value() const {
+        if constexpr (Type == AggregationType::COUNT) {
+            return static_cast<double>(count_);
+        } else if constexpr (Type == AggregationType::SUM) {
+            return sum_;
+        } else if constexpr (Type == AggregationType::DISTINCT) {
+            return distinct_.estimate();
+        } else {
+            if (count_ == 0) {
+                return std::nan("");
+            }
+            if constexpr (Type == AggregationType::AVG) {
+                return sum_ / count_;
+            } else if constexpr (Type == AggregationType::MIN) {
+                return min_;
+            } else if constexpr (Type == AggregationType::MAX) {
+                return max_;
+            } else if constexpr (Type == AggregationType::FIRST) {
+                return first_;
+            } else if constexpr (Type == AggregationType::LAST) {
+                return last_;
+            } else if constexpr (Type == AggregationType::STDDEV) {
+                double mean = sum_ / count_;
+                return std::sqrt(std::max(0.0, sum_squares_ / count_ - mean * mean));
+            } else if constexpr (Type == AggregationType::QUANTILE) {
+                return quantiles_.quantile(quantile_);
+            } else {
+                return std::nan("");
+            }
+        }
+    }
+    
+private:
+    uint64_t count_ = 0;
+    double sum_ = 0.0;
+    double sum_squares_ = 0.0;
+    double min_ = 0.0;
+    double max_ = 0.0;
+    double first_ = 0.0;
+    double last_ = 0.0;
+    double quantile_;
+    QuantileSketch quantiles_;
+    DistinctSketch distinct_;
+};
+
+/**
+ * @brief One aggregate of a window and group
+ */
+struct AggregateBucket {
+    int64_t window_start;
+    uint32_t group;
+    double value;
+};
+
+/**
+ * @brief One-pass windowed aggregation over groups of points
+ *
+ * Windows are [k * window_size, (k + 1) * window_size); window_size 0
+ * puts everything in one window starting at origin. Points of each group
+ * must arrive in timestamp order (groups may interleave), so a group's
+ * window is complete as soon as a later one starts. quantile is the q of
+ * QUANTILE.
+ */
+template <AggregationType Type>
+class WindowedAggregator {
+public:
+    WindowedAggregator(int64_t window_size, int64_t origin, double quantile = 0.5)
+        : window_size_(window_size), origin_(origin), quantile_(quantile) {}
+    
+    void add(uint32_t group, int64_t timestamp, double value) {
+        open(group, timestamp).add(value);
+    }
+    
+    // Fold in a summary of points of one window
+    void add(uint32_t group, const BlockSummary& summary) {
+        if (!summary.empty()) {
+            open(group, summary.first_timestamp).add(summary);
+        }
+    }
+    
+    // Every non-empty bucket, ordered by window start, then group
+    std::vector<AggregateBucket> finish() {
+        for (uint32_t group = 0; group < current_.size(); ++group) {
+            close(group);
+        }
+        std::sort(buckets_.begin(), buckets_.end(),
+            [](const AggregateBucket& a, const AggregateBucket& b) {
+                return a.window_start != b.window_start ? a.window_start < b.window_start
+                                                        : a.group < b.group;
+            });
+        return std::move(buckets_);
+    }
+    
+    int64_t window_start(int64_t timestamp) const {
+        if (window_size_ <= 0) {
+            return origin_;
+        }
+        return timestamp - (((timestamp % window_size_) + window_size_) % window_size_);
+    }
+    
+private:
+    struct Open {
+        int64_t window_start = 0;
+        Accumulator<Type> accumulator;
+    };
+    
+    int64_t window_size_;
+    int64_t origin_;
+    double quantile_;
+    std::vector<Open> current_;             // Indexed by group
+    std::vector<AggregateBucket> buckets_;
+    
+    Accumulator<Type>& open(uint32_t group, int64_t timestamp) {
+        if (group >= current_.size()) {
+            current_.resize(group + 1, Open{0, Accumulator<Type>(quantile_)});
+        }
+        int64_t start = window_start(timestamp);
+        Open& entry = current_[group];
+        if (!entry.accumulator.empty() && entry.window_start != start) {
+            close(group);
+        }
+        entry.window_start = start;
+        return entry.accumulator;
+    }
+    
+    void close(uint32_t group) {
+        Open& entry = current_[group];
+        if (!entry.accumulator.empty()) {
+            buckets_.push_back({entry.window_start, group, entry.accumulator.value()});
+            entry.accumulator = Accumulator<Type>(quantile_);
+        }
+    }
+};
+
+/**
+ * @brief Call fn(std::integral_constant<AggregationType, type>) so that
+ *        fn can instantiate the kernels specialized for type
+ * @return fn's result; NONE and unknown types dispatch as NONE, whose
+ *         accumulator yields NaN
+ */
+template <typename Fn>
+decltype(auto) dispatch_aggregation(AggregationType type, Fn&& fn) {
+    using T = AggregationType;
+    switch (type) {
+        case T::SUM: return fn(std::integral_constant<T, T::SUM>{});
+        case T::AVG: return fn(std::integral_constant<T, T::AVG>{});
+        case T::MIN: return fn(std::integral_constant<T, T::MIN>{});
+        case T::MAX: return fn(std::integral_constant<T, T::MAX>{});
+        case T::COUNT: return fn(std::integral_constant<T, T::COUNT>{});
+        case T::FIRST: return fn(std::integral_constant<T, T::FIRST>{});
+        case T::LAST: return fn(std::integral_constant<T, T::LAST>{});
+        case T::STDDEV: return fn(std::integral_constant<T, T::STDDEV>{});
+        case T::QUANTILE: return fn(std::integral_constant<T, T::QUANTILE>{});
+        case T::DISTINCT: return fn(std::integral_constant<T, T::DISTINCT>{});
+        default: return fn(std::integral_constant<T, T::NONE>{});
+    }
+}
+
+} // namespace sage_tsdb
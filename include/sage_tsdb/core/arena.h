@@ -0,0 +1,66 @@
+#pragma once
+
+#include "memory_tracker.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+namespace sage_tsdb {
+
+/**
+ * @brief Concurrent bump allocator
+ *
+ * Memory is carved out of blocks of kBlockSize bytes (requests over a
+ * quarter of that get a block of their own) and is never freed piecemeal:
+ * reset() and the destructor release every block at once. allocate() is
+ * lock-free while the current block has room; installing the next block
+ * takes a mutex.
+ *
+ * Objects placed in the arena are not destroyed by it; owners run the
+ * destructors that matter before reset().
+ *
+ * With a MemoryTracker, every block is charged to it while held.
+ */
+class Arena {
+public:
+    static constexpr size_t kBlockSize = 64 * 1024;
+
+    explicit Arena(std::shared_ptr<MemoryTracker> tracker = nullptr)
+        : tracker_(std::move(tracker)) {}
+    ~Arena();
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    // alignment must be a power of two; may be called from several threads
+    void* allocate(size_t bytes, size_t alignment = alignof(std::max_align_t));
+
+    // Release every block; no allocate() may run concurrently
+    void reset();
+
+    // Bytes of blocks held, including what is not handed out yet
+    size_t memory_usage() const { return memory_usage_.load(std::memory_order_relaxed); }
+
+private:
+    struct Block {
+        Block* prev;
+        size_t size;                    // Usable bytes after the header
+        std::atomic<size_t> used{0};
+
+        char* data() { return reinterpret_cast<char*>(this + 1); }
+    };
+
+    Block* new_block(size_t size, Block* prev);
+    // Bump-allocate from block; null if it lacks room
+    static void* try_allocate(Block* block, size_t bytes, size_t alignment);
+
+    std::atomic<Block*> current_{nullptr};
+    Block* large_ = nullptr;            // Blocks of single large requests
+    std::mutex mutex_;                  // Installs blocks
+    std::atomic<size_t> memory_usage_{0};
+    std::shared_ptr<MemoryTracker> tracker_;
+};
+
+} // namespace sage_tsdb
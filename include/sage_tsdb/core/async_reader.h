@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace sage_tsdb {
+
+/**
+ * @brief Batched positional reads with many requests in flight
+ *
+ * read_batch() queues every request of a batch at once and reports each
+ * one as it finishes, in completion order and on the calling thread, so a
+ * caller can decode one block while the device still serves the others.
+ *
+ * Backends:
+ * - IoUring: one io_uring per reader, the whole batch submitted with one
+ *   system call (built when ENABLE_IO_URING finds linux/io_uring.h)
+ * - ThreadPool: pread() from worker threads
+ *
+ * Backend::Auto takes io_uring when the kernel allows it (it may be
+ * disabled by seccomp or kernel.io_uring_disabled) and the pool otherwise.
+ * Short reads and requests the kernel rejects are finished with pread(),
+ * so every backend fills the same bytes.
+ */
+class AsyncReader {
+public:
+    enum class Backend { Auto, IoUring, ThreadPool };
+
+    struct Request {
+        int fd = -1;
+        uint64_t offset = 0;
+        uint8_t* buffer = nullptr;
+        size_t size = 0;
+        int64_t result = 0;             // Bytes read, or -errno
+    };
+
+    // nullptr when the requested backend is not available
+    static std::shared_ptr<AsyncReader> create(Backend backend = Backend::Auto,
+                                               unsigned queue_depth = 64,
+                                               size_t num_threads = 4);
+    static bool io_uring_available();
+
+    virtual ~AsyncReader() = default;
+
+    // Returns once every request is done; on_complete(i) runs for each
+    // request index as it completes. Safe to call from several threads.
+    virtual void read_batch(std::vector<Request>& requests,
+                            const std::function<void(size_t)>& on_complete) = 0;
+    virtual const char* name() const = 0;
+};
+
+} // namespace sage_tsdb
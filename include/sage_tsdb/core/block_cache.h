@@ -0,0 +1,147 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace sage_tsdb {
+
+/**
+ * @brief Per-consumer hit/miss counters (one instance per LSMTree)
+ */
+struct BlockCacheCounters {
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+};
+
+/**
+ * @brief Sharded, capacity-bounded LRU cache of decoded SSTable blocks
+ *
+ * One instance is shared by every LSMTree of a TableManager. Entries are
+ * keyed by (file id, block offset) and hold type-erased immutable values,
+ * so readers keep using a block after it has been evicted.
+ *
+ * Each shard keeps two LRU lists. High priority entries (index and bloom
+ * filter blocks) are only evicted once all low priority entries (data
+ * blocks) are gone, as long as they stay within high_priority_ratio of the
+ * shard capacity; beyond that the oldest ones are demoted to low priority.
+ */
+class BlockCache {
+public:
+    enum class Priority { Low, High };
+
+    struct Key {
+        uint64_t file_id;
+        uint64_t offset;
+
+        bool operator==(const Key& other) const {
+            return file_id == other.file_id && offset == other.offset;
+        }
+    };
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t inserts = 0;
+        uint64_t evictions = 0;
+        size_t usage_bytes = 0;
+        size_t high_priority_usage_bytes = 0;
+        size_t capacity_bytes = 0;
+        size_t num_entries = 0;
+    };
+
+    using Value = std::shared_ptr<const void>;
+
+    explicit BlockCache(size_t capacity_bytes, size_t num_shard_bits = 4,
+                        double high_priority_ratio = 0.5);
+    ~BlockCache() = default;
+
+    BlockCache(const BlockCache&) = delete;
+    BlockCache& operator=(const BlockCache&) = delete;
+
+    /**
+     * @brief Look up a block and mark it most recently used
+     * @return nullptr on miss
+     */
+    Value lookup(const Key& key);
+
+    template<typename T>
+    std::shared_ptr<const T> lookup_as(const Key& key) {
+        return std::static_pointer_cast<const T>(lookup(key));
+    }
+
+    /**
+     * @brief Insert or replace a block
+     * @param charge Approximate memory held by the value in bytes
+     *
+     * Values larger than a whole shard are not cached.
+     */
+    void insert(const Key& key, Value value, size_t charge,
+                Priority priority = Priority::Low);
+
+    void erase(const Key& key);
+
+    // Drop every block of a file (called when an SSTable is deleted)
+    void erase_file(uint64_t file_id);
+
+    // Unique id for a newly opened file; ids are never reused
+    static uint64_t new_file_id();
+
+    // Lock-free: sums the shards' atomics, so the totals may be mid-update
+    Stats get_stats() const;
+    size_t get_capacity() const { return capacity_bytes_; }
+
+private:
+    struct KeyHash {
+        size_t operator()(const Key& key) const {
+            uint64_t h = key.file_id * 0x9e3779b97f4a7c15ULL;
+            h ^= key.offset + 0x9e3779b9 + (h << 6) + (h >> 2);
+            return static_cast<size_t>(h);
+        }
+    };
+
+    struct Entry {
+        Key key;
+        Value value;
+        size_t charge;
+        Priority priority;
+    };
+
+    using EntryList = std::list<Entry>;
+
+    // Usage and counters are written under the mutex but read without it,
+    // so get_stats() never blocks a reader or an insert
+    struct Shard {
+        mutable std::mutex mutex;
+        EntryList high;                                   // Front = most recent
+        EntryList low;
+        std::unordered_map<Key, EntryList::iterator, KeyHash> table;
+        size_t capacity = 0;
+        size_t high_capacity = 0;
+        std::atomic<size_t> usage{0};
+        std::atomic<size_t> high_usage{0};
+        std::atomic<size_t> entries{0};
+        std::atomic<uint64_t> hits{0};
+        std::atomic<uint64_t> misses{0};
+        std::atomic<uint64_t> inserts{0};
+        std::atomic<uint64_t> evictions{0};
+    };
+
+    size_t capacity_bytes_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+    size_t shard_mask_;
+
+    Shard& shard_for(const Key& key) {
+        return *shards_[(KeyHash()(key) >> 16) & shard_mask_];
+    }
+
+    void remove_entry(Shard& shard, EntryList::iterator it);
+    void enforce_capacity(Shard& shard);
+};
+
+} // namespace sage_tsdb
@@ -0,0 +1,155 @@
+#pragma once
+
+#include "time_series_data.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace sage_tsdb {
+
+/**
+ * @brief MSB-first bit stream writer used by the columnar block codec
+ */
+class BitWriter {
+public:
+    void write_bit(bool bit);
+    void write_bits(uint64_t value, int num_bits);
+
+    // Pads the trailing partial byte with zeros
+    const std::vector<uint8_t>& bytes() const { return bytes_; }
+    size_t bit_count() const { return bit_count_; }
+
+private:
+    std::vector<uint8_t> bytes_;
+    size_t bit_count_ = 0;
+};
+
+/**
+ * @brief MSB-first bit stream reader matching BitWriter
+ */
+class BitReader {
+public:
+    BitReader(const uint8_t* data, size_t size_bytes)
+        : data_(data), size_bits_(size_bytes * 8), pos_(0) {}
+
+    bool read_bit(bool& bit);
+    bool read_bits(int num_bits, uint64_t& value);
+
+private:
+    const uint8_t* data_;
+    size_t size_bits_;
+    size_t pos_;
+};
+
+/**
+ * @brief Delta-of-delta timestamp encoder (Gorilla paper, section 4.1.1)
+ *
+ * The first timestamp and first delta are stored raw; every following
+ * timestamp stores the zigzag-encoded change of its delta in a
+ * variable-length bucket. Regularly sampled series cost one bit per point.
+ */
+class TimestampEncoder {
+public:
+    explicit TimestampEncoder(BitWriter& writer) : writer_(writer) {}
+    void append(int64_t timestamp);
+
+private:
+    BitWriter& writer_;
+    size_t count_ = 0;
+    int64_t prev_timestamp_ = 0;
+    int64_t prev_delta_ = 0;
+};
+
+class TimestampDecoder {
+public:
+    explicit TimestampDecoder(BitReader& reader) : reader_(reader) {}
+    bool next(int64_t& timestamp);
+
+private:
+    BitReader& reader_;
+    size_t count_ = 0;
+    int64_t prev_timestamp_ = 0;
+    int64_t prev_delta_ = 0;
+};
+
+/**
+ * @brief XOR floating point encoder (Gorilla paper, section 4.1.2)
+ *
+ * Each value is XORed with its predecessor; identical values cost one bit
+ * and slowly changing values only store their meaningful middle bits.
+ */
+class XorValueEncoder {
+public:
+    explicit XorValueEncoder(BitWriter& writer) : writer_(writer) {}
+    void append(double value);
+
+private:
+    BitWriter& writer_;
+    size_t count_ = 0;
+    uint64_t prev_bits_ = 0;
+    int prev_leading_ = -1;
+    int prev_trailing_ = 0;
+};
+
+class XorValueDecoder {
+public:
+    explicit XorValueDecoder(BitReader& reader) : reader_(reader) {}
+    bool next(double& value);
+
+private:
+    BitReader& reader_;
+    size_t count_ = 0;
+    uint64_t prev_bits_ = 0;
+    int prev_leading_ = 0;
+    int prev_trailing_ = 0;
+};
+
+// Varint / zigzag helpers shared by the on-disk formats
+void put_varint64(std::vector<uint8_t>& out, uint64_t value);
+bool get_varint64(const uint8_t*& ptr, const uint8_t* end, uint64_t& value);
+
+// CRC32C (Castagnoli); pass a previous result as crc to extend it
+uint32_t crc32c(const uint8_t* data, size_t size, uint32_t crc = 0);
+
+inline uint64_t zigzag_encode(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+inline int64_t zigzag_decode(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+/**
+ * @brief Columnar encoding of a run of time-ordered points
+ *
+ * Block layout (all multi-byte integers little-endian or varint):
+ * - u32 num_points, u8 flags
+ * - varint length + delta-of-delta timestamp bit stream
+ * - varint length + XOR bit stream of scalar values
+ * - [flags & kHasArrays] per-point varint kind (0 = scalar, n + 1 = array
+ *   of n doubles) followed by the raw array elements
+ * - tag dictionary: distinct tag sets, then per-point varint dictionary id
+ * - [flags & kHasFields] field dictionary encoded the same way, values in
+ *   FieldValue binary form with kTypedFields (older blocks: text values)
+ */
+class ColumnarBlock {
+public:
+    static constexpr uint8_t kHasArrays = 0x01;
+    static constexpr uint8_t kHasFields = 0x02;
+    static constexpr uint8_t kTypedFields = 0x04;
+
+    /**
+     * @brief Encode points (already sorted by timestamp) into out
+     */
+    static void encode(const TimeSeriesData* points, size_t count,
+                       std::vector<uint8_t>& out);
+
+    /**
+     * @brief Decode a block produced by encode(), appending to out
+     * @return false if the block is truncated or malformed
+     */
+    static bool decode(const uint8_t* data, size_t size,
+                       std::vector<TimeSeriesData>& out);
+};
+
+} // namespace sage_tsdb
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace sage_tsdb {
+
+/**
+ * @brief Split-block bloom filter over 64-bit keys
+ *
+ * Every key maps to one 32-byte bucket and sets one bit in each of its
+ * eight 32-bit words, so a probe touches a single cache line and needs one
+ * multiply and shift per word instead of separate hash functions. With
+ * AVX2 the eight words are checked in one instruction; otherwise the loop
+ * is left to the compiler.
+ *
+ * SSTables key it by series id and by every (tag key, tag value) pair, so
+ * tag-filtered scans can skip files and blocks.
+ *
+ * A default-constructed (empty) filter holds no information and answers
+ * might_contain() with true.
+ */
+class BlockedBloomFilter {
+public:
+    BlockedBloomFilter() = default;
+    explicit BlockedBloomFilter(size_t num_keys, size_t bits_per_key = 10);
+
+    void add(uint64_t key);
+    bool might_contain(uint64_t key) const;
+    // True only if every key might be present
+    bool might_contain_all(const std::vector<uint64_t>& keys) const;
+
+    bool empty() const { return buckets_.empty(); }
+    size_t size_bytes() const { return buckets_.size() * sizeof(Bucket); }
+
+    // [u32 num buckets][buckets]
+    void serialize(std::vector<uint8_t>& out) const;
+    bool deserialize(const uint8_t*& ptr, const uint8_t* end);
+
+    // Key of one tag pair; distinct from the plain series id keys
+    static uint64_t tag_key(const std::string& key, const std::string& value);
+
+private:
+    static constexpr size_t kWordsPerBucket = 8;
+
+    struct alignas(32) Bucket {
+        uint32_t words[kWordsPerBucket];
+    };
+
+    std::vector<Bucket> buckets_;
+
+    static uint64_t mix(uint64_t key);
+    size_t bucket_for(uint64_t hash) const;
+};
+
+} // namespace sage_tsdb
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "mapped_file.h"
+#include "time_series_data.h"
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace sage_tsdb {
+
+/**
+ * @brief Columnar bulk files for backfills and exports
+ *
+ * A bulk file is a run of ColumnarBlock frames, the encoding SSTable
+ * blocks use, behind a small header. Timestamps, values, tag and field
+ * dictionaries are therefore stored column by column, and reading a frame
+ * decodes whole columns instead of parsing rows.
+ *
+ * Layout (little-endian):
+ * - u32 kMagic, u32 kVersion
+ * - per frame: u32 encoded size, u32 crc32c of the block, block bytes
+ *
+ * Points within a frame are timestamp-ordered; frames need not be.
+ */
+class BulkFileWriter {
+public:
+    static constexpr uint32_t kMagic = 0x4B4C4253;     // "SBLK"
+    static constexpr uint32_t kVersion = 1;
+    static constexpr size_t kFramePoints = 4096;
+
+    BulkFileWriter() = default;
+    ~BulkFileWriter();
+
+    BulkFileWriter(const BulkFileWriter&) = delete;
+    BulkFileWriter& operator=(const BulkFileWriter&) = delete;
+
+    // Create or truncate path and write the header
+    bool open(const std::string& path);
+
+    // Buffer a point; a frame is written every kFramePoints points. Points
+    // are sorted by timestamp within their frame, so any order is accepted.
+    bool append(const TimeSeriesData& point);
+    bool append(TimeSeriesData&& point);
+    bool append(const TimeSeriesData* points, size_t count);
+
+    // Write the last partial frame and close the file
+    bool close();
+
+    uint64_t points_written() const { return points_written_; }
+
+private:
+    bool write_frame();
+
+    std::ofstream out_;
+    std::vector<TimeSeriesData> pending_;
+    std::vector<uint8_t> encoded_;
+    uint64_t points_written_ = 0;
+};
+
+/**
+ * @brief Frame-by-frame reader of a bulk file
+ */
+class BulkFileReader {
+public:
+    // Map path and check its header; false if missing or not a bulk file
+    bool open(const std::string& path);
+
+    /**
+     * @brief Decode the next frame, appending its points to out
+     * @return false at the end of the file or on a corrupt frame (see corrupt())
+     */
+    bool next(std::vector<TimeSeriesData>& out);
+
+    bool corrupt() const { return corrupt_; }
+
+private:
+    std::shared_ptr<MappedFile> file_;
+    size_t offset_ = 0;
+    bool corrupt_ = false;
+};
+
+/**
+ * @brief Write points to a new bulk file at path
+ */
+bool write_bulk_file(const std::string& path, const std::vector<TimeSeriesData>& points);
+
+/**
+ * @brief Read every point of a bulk file, frame after frame
+ * @return false if the file cannot be opened or is corrupt
+ */
+bool read_bulk_file(const std::string& path, std::vector<TimeSeriesData>& points);
+
+} // namespace sage_tsdb
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace sage_tsdb {
+
+/**
+ * @brief Equi-join of two key columns reduced to a count (and a sum)
+ */
+struct JoinAggregate {
+    uint64_t pairs = 0;            // Matching (s, r) pairs
+    double sum = 0.0;              // R value summed over matching pairs (with r_values)
+    size_t partitions = 1;         // Radix partitions of the build side
+    size_t partitions_joined = 1;  // Fewer when stopped early
+};
+
+/**
+ * @brief Radix-partitioned hash join kernels
+ *
+ * The smaller side is aggregated per key into an open-addressing table
+ * and the other side probes it. Inputs whose build side exceeds a few
+ * thousand tuples are first scattered into radix partitions by key hash,
+ * so each partition's table stays in L2 while it is built and probed.
+ * Probes run in batches of SIMD lanes (8 with AVX-512, 4 with AVX2, as
+ * simd::active() picks at run time): hash, gather and compare one batch
+ * at once, finishing only the lanes that hit a collision on the scalar
+ * path.
+ * Sums are accumulated per lane and may differ from a sequential loop in
+ * the last bits.
+ */
+namespace join_kernels {
+
+using StopCheck = std::function<bool()>;
+
+// Queues a task on some thread; false if it was not queued
+using TaskSubmit = std::function<bool(std::function<void()>)>;
+
+// Joins s_keys[0, s_count) with r_keys[0, r_count). With r_values, sum
+// is the total of r_values[i] over the pairs R tuple i is part of.
+// should_stop is polled between partitions; a stopped join has covered
+// the keys of partitions_joined of the partitions.
+JoinAggregate hash_join(const uint64_t* s_keys, size_t s_count,
+                        const uint64_t* r_keys, const double* r_values, size_t r_count,
+                        const StopCheck& should_stop = {});
+
+// Splits both inputs by key into `ways` buckets and joins each bucket with
+// hash_join() as its own task. Up to ways - 1 tasks go to submit; the
+// caller joins buckets too and returns once all are done, so it never
+// waits on a task that has not started. Returns one aggregate per bucket,
+// each with its own partitions / partitions_joined when stopped early.
+std::vector<JoinAggregate> parallel_hash_join(const uint64_t* s_keys, size_t s_count,
+                                              const uint64_t* r_keys, const double* r_values,
+                                              size_t r_count, size_t ways,
+                                              const TaskSubmit& submit,
+                                              const StopCheck& should_stop = {});
+
+} // namespace join_kernels
+
+} // namespace sage_tsdb
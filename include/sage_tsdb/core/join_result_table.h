@@ -25,6 +25,15 @@ namespace sage_tsdb {
  * - aqp_estimate: AQP 估计值（可选）
  * - payload: 序列化的详细 Join 结果
  * - metrics: 计算指标（延迟、资源使用等）
+ * 
+ * 存储格式：
+ * - 每条记录在底层 StreamTable 中占一行：value = join_count，
+ *   tags = window_id、algorithm 与用户标签，fields["record"] = 二进制记录
+ * - 二进制记录 = 72 字节定长头（窗口、时间戳与全部数值指标）
+ *   + varint 长度前缀的 algorithm、error_message、payload
+ * - 内存中另按列保存定长指标（window_id、timestamp、join_count 等），
+ *   queryByWindow 与 queryAggregateStats 只扫描这些列，不解析记录；
+ *   重新打开持久化的表时从存储重建
  */
 class JoinResultTable {
 public:
@@ -75,11 +84,17 @@ public:
         
         /**
          * @brief 将 payload 反序列化为 Join 对
+         * @throws std::runtime_error payload 损坏时
          */
         std::vector<std::pair<TimeSeriesData, TimeSeriesData>> deserializePayload() const;
         
         /**
          * @brief 从 Join 对序列化为 payload
+         * 
+         * 格式：版本字节、varint 对数，之后每个点依次为 zigzag varint 时间戳差值、
+         * varint 值类型（0 标量，n+1 为 n 维数组）与原始 double、
+         * varint 标签集编号（首次出现时随后内联标签集）、varint 个数与 fields
+         * （varint 长度前缀的键 + FieldValue 二进制值；版本 1 的值为字符串）
          */
         void serializePayload(const std::vector<std::pair<TimeSeriesData, TimeSeriesData>>& join_pairs);
     };
@@ -240,10 +255,25 @@ private:
     // 底层存储（复用 StreamTable 的 LSM-Tree）
     std::unique_ptr<StreamTable> storage_;         // 存储引擎
     
-    // 窗口 ID 索引（加速查询）
+    // 定长指标列（每条记录一行，同一行位置对应各列）
+    struct Columns {
+        std::vector<uint64_t> window_id;
+        std::vector<int64_t> timestamp;
+        std::vector<uint64_t> series;              // 标签哈希，与 timestamp 一起确定存储中的行
+        std::vector<uint64_t> join_count;
+        std::vector<double> selectivity;
+        std::vector<double> computation_time_ms;
+        std::vector<uint8_t> flags;                // 是否使用 AQP / 是否有错误
+        std::vector<uint32_t> payload_bytes;
+        
+        size_t size() const { return window_id.size(); }
+    };
+    Columns columns_;
+    
+    // 窗口 ID 索引：窗口 → 列中的行位置
     std::unordered_map<uint64_t, std::vector<size_t>> window_index_;
     
-    // 统计信息
+    // 统计信息（getStats 时由列计算）
     mutable Stats stats_;
     
     // 线程安全
@@ -253,6 +283,11 @@ private:
     TimeSeriesData recordToTimeSeriesData(const JoinRecord& record) const;
     JoinRecord timeSeriesDataToRecord(const TimeSeriesData& data) const;
     void updateStats() const;
+    
+    // 写入列；同一窗口、时间戳与标签的记录覆盖已有行（与存储去重一致）
+    void appendColumns(const JoinRecord& record, uint64_t series);
+    void rebuildWindowIndex();
+    void loadColumns();
 };
 
 } // namespace sage_tsdb
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "time_series_data.h"
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace sage_tsdb {
+
+/**
+ * @brief Newest points of a table, overall and per series
+ *
+ * Fed from the insert path. Keeps the newest `capacity` points of the
+ * whole table and the newest `per_series` points of every series, each in
+ * a timestamp-ordered ring, so the latest n points are read without a
+ * scan. In-order points are appended in O(1); late ones are placed by
+ * binary search, or dropped once older than everything kept. A point with
+ * the timestamp and tags of a kept one replaces it, as in the MemTable.
+ *
+ * The cache is warm once it has seen every point that could still be
+ * among the newest. A table reopened from disk starts cold and is warmed
+ * by replaying its stored points through add().
+ */
+class LastValueCache {
+public:
+    LastValueCache(size_t capacity, size_t per_series, bool warm = true);
+
+    LastValueCache(const LastValueCache&) = delete;
+    LastValueCache& operator=(const LastValueCache&) = delete;
+
+    void add(const TimeSeriesData& point);
+    void add(const TimeSeriesData* points, size_t count);
+
+    // Newest n points (at most capacity) with timestamp >= from, newest first
+    std::vector<TimeSeriesData> latest(size_t n, int64_t from) const;
+
+    // Newest n points (at most per_series) of each series matching
+    // filter_tags, with timestamp >= from; series ordered by tags, each
+    // newest first
+    std::vector<TimeSeriesData> latest_per_series(size_t n, const Tags& filter_tags,
+                                                  int64_t from) const;
+
+    bool is_warm() const;
+    void set_warm();
+    // Drop everything; the cache stays warm only if the table is now empty
+    void clear(bool warm);
+
+    size_t capacity() const { return capacity_; }
+    size_t per_series() const { return per_series_; }
+    size_t series_count() const;
+
+private:
+    using Ring = std::deque<TimeSeriesData>;  // Oldest first
+
+    struct Series {
+        Tags tags;
+        Ring points;
+    };
+
+    size_t capacity_;
+    size_t per_series_;
+
+    mutable std::mutex mutex_;
+    Ring latest_;
+    std::unordered_map<uint64_t, Series> series_;  // Keyed by series_id()
+    bool warm_;
+
+    static void insert(Ring& ring, const TimeSeriesData& point, size_t limit);
+};
+
+} // namespace sage_tsdb
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace sage_tsdb {
+
+/**
+ * @brief Lock-free log-linear (HDR-style) histogram of latencies
+ *
+ * Values (e.g. microseconds) are counted in buckets whose width grows with
+ * the value: every power-of-two range is split into 32 linear sub-buckets,
+ * so any percentile is reported within ~3% of the true sample. record()
+ * is O(1): one bucket index computation and a few relaxed atomic updates
+ * on the calling thread's stripe, with no lock and no allocation. Readers
+ * merge the stripes in snapshot(), at a cost fixed by the bucket count
+ * rather than the number of samples.
+ *
+ * Values at or above 2^kMaxValueBits are clamped into the last bucket.
+ */
+class LatencyHistogram {
+public:
+    static constexpr int kSubBucketBits = 6;
+    static constexpr int kMaxValueBits = 40;  // ~12.7 days in microseconds
+    static constexpr size_t kStripes = 8;
+
+    static constexpr uint64_t kSubBucketCount = uint64_t{1} << kSubBucketBits;
+    static constexpr uint64_t kSubBucketHalf = kSubBucketCount / 2;
+    static constexpr size_t kBucketCount =
+        (kMaxValueBits - kSubBucketBits + 2) * kSubBucketHalf;
+
+    /**
+     * @brief Merged counts at one point in time
+     */
+    struct Snapshot {
+        std::vector<uint64_t> counts;  // Per bucket
+        uint64_t count = 0;
+        uint64_t min = 0;
+        uint64_t max = 0;
+        double mean = 0.0;
+
+        // Value at quantile q in [0, 1]; 0 when empty
+        uint64_t percentile(double q) const;
+    };
+
+    LatencyHistogram();
+
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+    void record(uint64_t value);
+
+    Snapshot snapshot() const;
+
+    uint64_t count() const;
+
+    // Samples recorded concurrently with reset() may survive it
+    void reset();
+
+    static size_t bucket_index(uint64_t value);
+    // Smallest and largest value counted in a bucket
+    static uint64_t bucket_lowest(size_t index);
+    static uint64_t bucket_highest(size_t index);
+
+private:
+    struct alignas(64) Stripe {
+        std::array<std::atomic<uint64_t>, kBucketCount> counts;
+        std::atomic<uint64_t> total{0};
+        std::atomic<uint64_t> sum{0};
+        std::atomic<uint64_t> min;
+        std::atomic<uint64_t> max{0};
+    };
+
+    std::array<Stripe, kStripes> stripes_;
+};
+
+} // namespace sage_tsdb
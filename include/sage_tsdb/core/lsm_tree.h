@@ -1,16 +1,29 @@
 #pragma once
 
+#include "aggregation.h"
+#include "arena.h"
+#include "async_reader.h"
+#include "block_cache.h"
+#include "blocked_bloom_filter.h"
+#include "mapped_file.h"
+#include "metrics_registry.h"
+#include "rate_limiter.h"
+#include "series_catalog.h"
 #include "time_series_data.h"
 #include <atomic>
 #include <condition_variable>
+#include <climits>
 #include <cstdint>
 #include <fstream>
+#include <functional>
 #include <map>
 #include <memory>
 #include <mutex>
 #include <set>
+#include <shared_mutex>
 #include <string>
 #include <thread>
+#include <unordered_map>
 #include <vector>
 
 namespace sage_tsdb {
@@ -26,10 +39,12 @@ public:
     void add(int64_t key);
     bool might_contain(int64_t key) const;
     void clear();
+    size_t size_bytes() const { return (bits_.size() + 7) / 8; }
     
     // Serialization
     void serialize(std::ofstream& out) const;
     bool deserialize(std::ifstream& in);
+    bool deserialize(const uint8_t* data, size_t size);
     
 private:
     std::vector<bool> bits_;
@@ -39,60 +54,247 @@ private:
 };
 
 /**
- * @brief Write-Ahead Log for crash recovery
+ * @brief WAL durability level
+ */
+enum class WalSyncMode {
+    None,       // Hand records to the OS only; survives process but not machine crashes
+    PerGroup,   // fdatasync every commit group before append() returns
+    Interval    // fdatasync from a background thread every sync_interval_ms
+};
+
+struct WalOptions {
+    WalSyncMode sync_mode = WalSyncMode::Interval;
+    uint32_t sync_interval_ms = 100;
+    size_t buffer_bytes = 256 * 1024;   // Unsynced modes write once this much is pending
+    size_t recovery_threads = 4;        // Threads verifying and decoding the log on open/recover
+    // Log series ids instead of tag maps; must be persistent and the same
+    // catalog on every open of the log
+    std::shared_ptr<SeriesCatalog> catalog;
+};
+
+/**
+ * @brief Write-Ahead Log for crash recovery (group commit)
+ *
+ * File layout: u32 magic, u32 version, then records framed as
+ * [u32 payload length][u32 crc32c(payload)][payload]. Recovery stops at
+ * the first torn or corrupt record. With a catalog, a record names its
+ * series by id (flagged in the value type byte) rather than spelling out
+ * the tags; records of either kind decode in the same log. Logs written by the old unframed
+ * format are converted when opened.
+ *
+ * Writers encode their record outside the lock and append it to a shared
+ * buffer. Whoever finds no flush in progress becomes the leader and writes
+ * (and, if required, syncs) everything pending in one go; writers arriving
+ * meanwhile join the next group.
  */
 class WriteAheadLog {
 public:
-    explicit WriteAheadLog(const std::string& log_path);
+    static constexpr uint32_t kMagic = 0x4C415753;   // "SWAL"
+    static constexpr uint32_t kVersion = 2;
+    
+    explicit WriteAheadLog(const std::string& log_path, const WalOptions& options = WalOptions());
     ~WriteAheadLog();
     
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+    
     bool append(int64_t timestamp, const TimeSeriesData& data);
-    std::map<int64_t, TimeSeriesData> recover();
+    bool append_batch(const std::vector<TimeSeriesData>& batch, size_t begin = 0);  // One group
+    std::vector<TimeSeriesData> recover();  // In log order
     bool clear();
-    bool sync();
+    bool sync();                            // Write and fdatasync everything appended so far
+    
+    uint64_t get_num_syncs() const { return num_syncs_.load(std::memory_order_relaxed); }
     
 private:
     std::string log_path_;
-    std::ofstream log_file_;
+    WalOptions options_;
+    int fd_ = -1;
+    
     std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<uint8_t> pending_;          // Records not yet handed to the OS
+    std::vector<uint8_t> flushing_;         // Owned by the current leader
+    uint64_t appended_seq_ = 0;
+    uint64_t written_seq_ = 0;
+    uint64_t synced_seq_ = 0;
+    bool leader_active_ = false;
+    bool failed_ = false;
+    std::atomic<uint64_t> num_syncs_{0};
+    
+    bool stop_ = false;
+    std::thread sync_thread_;
+    
+    bool append_frames(const std::vector<uint8_t>& frames);
+    bool open_log();
+    bool reset_file();
+    // Wait until record seq is written (and synced if durable), leading a group if needed
+    bool commit(std::unique_lock<std::mutex>& lock, uint64_t seq, bool durable);
+    void sync_worker();
 };
 
 /**
- * @brief In-memory sorted table (skip list based)
+ * @brief In-memory sorted table (concurrent skip list)
+ * 
+ * Entries are ordered by (timestamp, series id, sequence descending), so
+ * points of different series sharing a timestamp coexist, and rewriting a
+ * point adds a newer version that shadows the old one. Timestamp-major
+ * order lets a flush stream entries straight into an SSTable.
+ * 
+ * With a catalog, entries keep a series id instead of their tag map, and
+ * the tags are looked up again when points are read out.
+ * 
+ * Nodes live in an Arena owned by the table: inserting a point bump-
+ * allocates its node, and clear() drops the whole arena at once. Only
+ * nodes that own heap memory of their own (tags without a catalog,
+ * fields, vector values) are destroyed one by one. The arena's blocks are
+ * charged to tracker when one is given.
+ * 
+ * put() is lock-free and may be called from several threads at once;
+ * readers may run concurrently with writers. clear() and destruction need
+ * external exclusion (LSMTree holds memtable_mutex_ exclusively).
  */
 class MemTable {
 public:
-    MemTable(size_t max_size_bytes = 4 * 1024 * 1024); // 4MB default
-    ~MemTable() = default;
+    struct Key {
+        int64_t timestamp;
+        uint64_t series_id;
+        uint64_t sequence;          // Higher = newer
+    };
+    
+    MemTable(size_t max_size_bytes = 4 * 1024 * 1024,  // 4MB default
+             std::shared_ptr<SeriesCatalog> catalog = nullptr,
+             std::shared_ptr<MemoryTracker> tracker = nullptr);
+    ~MemTable();
+    
+    MemTable(const MemTable&) = delete;
+    MemTable& operator=(const MemTable&) = delete;
     
     bool put(int64_t timestamp, const TimeSeriesData& data);
+    // Takes over the tags, fields and vector of data; data is left as it
+    // was when the table is full
+    bool put(int64_t timestamp, TimeSeriesData&& data);
+    // Insert with a sequence taken from reserve_sequences(), so a log can be
+    // replayed from several threads and still keep its last version of each
+    // point. Never rejects the point for lack of space.
+    void put(int64_t timestamp, const TimeSeriesData& data, uint64_t sequence);
+    // First of count consecutive sequences newer than everything inserted so far
+    uint64_t reserve_sequences(uint64_t count);
+    // Newest version of the first series at timestamp
     bool get(int64_t timestamp, TimeSeriesData& data) const;
     bool is_full() const;
-    size_t size() const { return data_.size(); }
+    size_t size() const { return num_entries_.load(std::memory_order_relaxed); }
     size_t size_bytes() const { return size_bytes_; }
     
-    // Range query
+    // Range query (newest version per series and timestamp)
     std::vector<TimeSeriesData> range_query(int64_t start_time, int64_t end_time) const;
     
-    // Get all data (for flushing to SSTable)
-    const std::map<int64_t, TimeSeriesData>& get_all() const { return data_; }
+    // Visit the points range_query() would return in place, without copying
+    // them: data carries no tags when they are interned, tags always has
+    // them. Both stay valid until clear(). Stops when visit returns false.
+    void scan(int64_t start_time, int64_t end_time,
+              const std::function<bool(const TimeSeriesData& data, const Tags& tags)>& visit) const;
+    
+    // Get all data in key order (for flushing to SSTable)
+    std::vector<TimeSeriesData> get_all() const;
     
     void clear();
     
+    // Approximate memory charged for one point
+    static size_t estimate_size(const TimeSeriesData& data);
+    
+    // Bytes of arena blocks held by the nodes
+    size_t arena_bytes() const { return arena_.memory_usage(); }
+    
 private:
-    std::map<int64_t, TimeSeriesData> data_;
+    static constexpr int kMaxHeight = 12;
+    
+    struct Node;
+    
+    std::shared_ptr<SeriesCatalog> catalog_;
+    Arena arena_;
+    Node* head_;
+    std::atomic<int> max_height_;
+    std::atomic<uint64_t> next_sequence_;
     size_t max_size_bytes_;
     std::atomic<size_t> size_bytes_;
-    mutable std::mutex mutex_;
-    
-    size_t estimate_size(const TimeSeriesData& data) const;
+    std::atomic<size_t> num_entries_;
+    std::atomic<size_t> owning_nodes_;  // Nodes whose destructor frees memory
+    
+    static bool key_less(const Key& a, const Key& b);
+    template <typename Data>
+    void insert(const Key& key, Data&& data, size_t data_size);
+    // Charge for data in this table: tags cost one id when interned
+    size_t entry_size(const TimeSeriesData& data) const;
+    TimeSeriesData resolve(const Node* node) const;
+    template <typename Data>
+    Node* new_node(const Key& key, Data&& data, uint32_t series, int height);
+    static int random_height();
+    
+    // First node with key >= target
+    Node* find_greater_or_equal(const Key& target) const;
+    void find_splice_for_level(const Key& key, Node* before, int level,
+                               Node** out_prev, Node** out_next) const;
+};
+
+/**
+ * @brief Options controlling how an SSTable is written
+ */
+struct SSTableOptions {
+    uint32_t format_version = 1;        // SSTable::kRowFormatVersion or kColumnarFormatVersion
+    size_t block_size_points = 4096;    // Points per columnar block (format v2 only)
+    bool block_sketches = false;        // Store quantile/distinct sketches per block
+    bool use_mmap = true;               // Serve reads from a read-only file mapping
+    std::shared_ptr<BlockCache> block_cache;            // Shared decoded block cache (optional)
+    std::shared_ptr<BlockCacheCounters> cache_counters; // Hit/miss counters of the owner
+    std::shared_ptr<RateLimiter> rate_limiter;          // Throttles file writes (optional)
+    std::shared_ptr<AsyncReader> async_reader;          // Batched block reads (optional)
+    size_t readahead_blocks = 8;                        // Blocks per batch of an iterator
 };
 
 /**
  * @brief Sorted String Table (immutable on-disk file)
+ * 
+ * Two on-disk formats are supported:
+ * - v1 (row): [metadata][bloom][per-point index][row records]
+ * - v2 (columnar): [metadata][compressed blocks][bloom][block index],
+ *   each block holding delta-of-delta timestamps, XOR-encoded values and
+ *   dictionary-encoded tags (see ColumnarBlock)
+ * 
+ * Both may end with a key filter section: a BlockedBloomFilter over the
+ * series ids and tag pairs of the file and one per block, then
+ * [u32 kSummaryMagic][BlockSummary per block], optionally
+ * [u32 kSketchMagic][quantile and distinct sketch per block], followed by a footer
+ * [u64 section offset][u32 crc32c][u32 kFilterMagic]. Files without it are
+ * read as before and never skipped; files whose section stops after the
+ * filters have no summaries and are always decoded.
+ * 
+ * The format is recorded in Metadata::version, so files of either version
+ * can be read regardless of the options used to write new tables.
+ * 
+ * Once loaded, metadata and index are immutable and reads take no lock.
+ * With SSTableOptions::use_mmap the file is mapped for the lifetime of the
+ * object, so readers holding a shared_ptr<SSTable> keep working after
+ * compaction unlinks the file.
+ * 
+ * Reads go through decoded blocks: columnar blocks in v2, runs of
+ * kRowBlockPoints rows in v1. With a BlockCache, decoded blocks are cached
+ * at low priority and the index/bloom filter at high priority; without
+ * one the index is pinned in the SSTable itself.
+ * 
+ * With SSTableOptions::async_reader, iterators read blocks that miss the
+ * cache readahead_blocks at a time through the reader instead of one by
+ * one, and read_blocks() batches blocks of several files together.
  */
 class SSTable {
 public:
+    static constexpr uint32_t kRowFormatVersion = 1;
+    static constexpr uint32_t kColumnarFormatVersion = 2;
+    static constexpr size_t kRowBlockPoints = 128;   // v1 rows per sparse index entry
+    static constexpr uint32_t kFilterMagic = 0x544C4653;   // "SFLT"
+    static constexpr uint32_t kSummaryMagic = 0x4D555353;  // "SSUM"
+    static constexpr uint32_t kSketchMagic = 0x4B535353;   // "SSSK"
+    
     struct Metadata {
         uint32_t magic_number;        // 0x53535442 "SSTB"
         uint32_t version;
@@ -108,21 +310,166 @@ public:
         Metadata();
     };
     
+    // Per-row index entry of the v1 on-disk layout (not kept in memory)
     struct IndexEntry {
         int64_t timestamp;
         uint64_t offset;            // Offset in data section
         uint32_t size;              // Size of data block
     };
     
-    SSTable(const std::string& file_path, uint64_t level, uint64_t sequence);
-    ~SSTable() = default;
+    struct BlockIndexEntry {
+        int64_t min_timestamp;
+        int64_t max_timestamp;
+        uint64_t offset;            // Offset of the encoded block
+        uint32_t size;              // Encoded block size in bytes
+        uint32_t num_points;
+    };
+    
+    // Bloom filter and sparse index of one file, shared with the block cache.
+    // Both formats keep one BlockIndexEntry per block, so memory grows with
+    // the number of blocks rather than points.
+    struct IndexBlock {
+        std::unique_ptr<BloomFilter> bloom_filter;      // Timestamps, for get()
+        std::vector<BlockIndexEntry> block_index;
+        BlockedBloomFilter key_filter;                  // Series ids and tag pairs of the file
+        std::vector<BlockedBloomFilter> block_filters;  // Same per block; empty for old files
+        std::vector<BlockSummary> block_summaries;      // Per block; empty for old files
+        
+        size_t memory_bytes() const {
+            size_t bytes = block_index.capacity() * sizeof(BlockIndexEntry) +
+                           block_summaries.capacity() * sizeof(BlockSummary) +
+                           (bloom_filter ? bloom_filter->size_bytes() : 0) +
+                           key_filter.size_bytes();
+            for (const auto& filter : block_filters) {
+                bytes += sizeof(filter) + filter.size_bytes();
+            }
+            for (const auto& summary : block_summaries) {
+                bytes += summary.memory_bytes() - sizeof(BlockSummary);
+            }
+            return bytes;
+        }
+        
+        bool block_might_match(size_t block_no, const std::vector<uint64_t>& keys) const {
+            return block_no >= block_filters.size() ||
+                   block_filters[block_no].might_contain_all(keys);
+        }
+    };
+    
+    using BlockPtr = std::shared_ptr<const std::vector<TimeSeriesData>>;
+    
+    // Maximal run of consecutive blocks whose time ranges touch, so no
+    // timestamp of the run appears in a block outside it
+    struct BlockSpan {
+        int64_t min_timestamp;
+        int64_t max_timestamp;
+        size_t first_block;
+        size_t last_block;              // Inclusive
+        bool has_summary;               // Every block of the run has one
+        BlockSummary summary;           // Merged over the run when has_summary
+    };
+    
+    // One block to fetch with read_blocks()
+    struct BlockRead {
+        SSTable* table;
+        std::shared_ptr<const IndexBlock> index;
+        size_t block_no;
+        BlockPtr block;                 // Set when the read and decode succeed
+    };
+    
+    /**
+     * @brief Forward scan over every point of a file, one decoded block at a time
+     *
+     * Blocks starting after end_time, whose key filter rules out one of
+     * filter_keys, or flagged in skip_blocks are never read. Points of the blocks that are read are
+     * all returned, so callers still check timestamps and tags themselves.
+     *
+     * The iterator does not own the SSTable; keep a shared_ptr to it alive.
+     */
+    class Iterator {
+    public:
+        bool valid() const { return block_ && pos_ < block_->size(); }
+        const TimeSeriesData& value() const { return (*block_)[pos_]; }
+        void next();
+        
+    private:
+        friend class SSTable;
+        Iterator(SSTable* table, std::shared_ptr<const IndexBlock> index, bool fill_cache,
+                 int64_t start_time, int64_t end_time, std::vector<uint64_t> filter_keys,
+                 std::vector<char> skip_blocks, std::vector<BlockRead> prefetched);
+        void load(size_t block_no);
+        BlockPtr take_prefetched(size_t block_no);
+        void prefetch(size_t block_no);
+        
+        SSTable* table_;
+        std::shared_ptr<const IndexBlock> index_;
+        bool fill_cache_;
+        int64_t end_time_;
+        std::vector<uint64_t> filter_keys_;
+        std::vector<char> skip_blocks_;
+        std::unordered_map<size_t, BlockPtr> prefetched_;   // Read ahead, not yet visited
+        std::ifstream in_;
+        std::vector<uint8_t> scratch_;
+        size_t block_no_ = 0;
+        BlockPtr block_;
+        size_t pos_ = 0;
+    };
+    
+    SSTable(const std::string& file_path, uint64_t level, uint64_t sequence,
+            const SSTableOptions& options = SSTableOptions());
+    ~SSTable();
+    
+    // Load metadata, bloom filter and index of an existing file
+    bool open();
+    
+    // Take the metadata recorded in the manifest instead of reading the
+    // file; the file is opened and checked against it on first access
+    void open_lazily(uint32_t format_version, uint64_t num_entries,
+                     int64_t min_timestamp, int64_t max_timestamp);
+    bool is_loaded() const { return loaded_.load(std::memory_order_acquire); }
     
     // Build from MemTable
-    bool build_from_memtable(const std::map<int64_t, TimeSeriesData>& data);
+    // Points must be sorted by timestamp (and series id within a timestamp)
+    bool build_from_memtable(const std::vector<TimeSeriesData>& data);
     
     // Build from multiple SSTables (for compaction)
     bool build_from_sstables(const std::vector<std::shared_ptr<SSTable>>& sstables);
     
+    // Incremental build: add() points in the order build_from_memtable()
+    // expects. expected_entries, when known, lets v1 files be written in
+    // place instead of through a spill file.
+    bool begin_build(uint64_t expected_entries = 0);
+    bool add(const TimeSeriesData& point);
+    bool finish_build();
+    uint64_t get_build_bytes() const;   // Approximate file size so far
+    
+    // fill_cache = false keeps one-off scans (compaction) from evicting hot blocks.
+    // prefetched blocks, from read_blocks(), are used instead of reading them again.
+    std::unique_ptr<Iterator> new_iterator(bool fill_cache = true, int64_t start_time = INT64_MIN,
+                                           int64_t end_time = INT64_MAX,
+                                           std::vector<uint64_t> filter_keys = {},
+                                           std::vector<char> skip_blocks = {},
+                                           std::vector<BlockRead> prefetched = {});
+    
+    // The first limit blocks an iterator with the same arguments would read
+    std::vector<BlockRead> plan_block_reads(int64_t start_time, int64_t end_time,
+                                            const std::vector<uint64_t>& filter_keys,
+                                            const std::vector<char>& skip_blocks, size_t limit);
+    
+    // Serves reads from the block cache and fetches the rest as one batch,
+    // decoding each block as its read completes. Blocks that cannot be read
+    // are left unset for the caller to read synchronously.
+    static void read_blocks(AsyncReader& reader, std::vector<BlockRead>& reads,
+                            bool fill_cache = true);
+    
+    // Block runs overlapping [start_time, end_time], in block order. With
+    // with_sketches, runs containing a block without sketches have no
+    // summary; without it, merged summaries drop their sketches.
+    std::vector<BlockSpan> block_spans(int64_t start_time, int64_t end_time,
+                                       bool with_sketches = false);
+    
+    // First timestamp of every block, for splitting work by time range
+    std::vector<int64_t> get_block_boundaries();
+    
     // Query operations
     bool get(int64_t timestamp, TimeSeriesData& data);
     std::vector<TimeSeriesData> range_query(int64_t start_time, int64_t end_time);
@@ -133,29 +480,120 @@ public:
     int64_t get_min_timestamp() const { return metadata_.min_timestamp; }
     int64_t get_max_timestamp() const { return metadata_.max_timestamp; }
     size_t get_num_entries() const { return metadata_.num_entries; }
+    uint32_t get_format_version() const { return metadata_.version; }
     std::string get_file_path() const { return file_path_; }
     
     // Check if timestamp might be in this SSTable
     bool might_contain(int64_t timestamp);
     
+    // False if the key filter rules out any of keys (series ids or
+    // BlockedBloomFilter::tag_key values); true for files without filters
+    bool might_match(const std::vector<uint64_t>& keys);
+    
+    // Filter keys selecting points that carry all of tags
+    static std::vector<uint64_t> filter_keys_for(const Tags& tags);
+    
     // Get file size
     size_t get_file_size() const;
     
+    // Memory held by the sparse index and bloom filter of this file
+    size_t get_index_memory_bytes() const {
+        return index_memory_bytes_.load(std::memory_order_relaxed);
+    }
+    
 private:
     std::string file_path_;
+    SSTableOptions options_;
     Metadata metadata_;
-    std::unique_ptr<BloomFilter> bloom_filter_;
-    std::vector<IndexEntry> index_;
-    mutable std::mutex mutex_;
+    uint64_t file_id_;                           // Block cache key prefix
+    std::shared_ptr<const IndexBlock> index_block_;  // Pinned when there is no cache
+    std::atomic<size_t> index_memory_bytes_{0};
+    std::shared_ptr<MappedFile> mapping_;        // Set when options_.use_mmap
+    int read_fd_ = -1;                           // Set when options_.async_reader
+    std::atomic<bool> loaded_{false};
+    bool metadata_known_ = false;                // Set by open_lazily()
+    mutable std::mutex mutex_;                   // Serializes loading only
+    
+    struct BuildState;
+    std::unique_ptr<BuildState> build_;          // Set between begin_build() and finish_build()
+    
+    bool ensure_loaded();
+    bool flush_build_block(BuildState& state);
+    void throttle_write(BuildState& state, size_t bytes, bool force = false);
+    
+    // Index access through the cache, reloading it after eviction
+    std::shared_ptr<const IndexBlock> index_block();
+    std::shared_ptr<IndexBlock> load_index_block(std::ifstream& in, std::vector<uint8_t>& scratch);
+    void publish_index_block(std::shared_ptr<const IndexBlock> block);
+    void count_cache_access(bool hit);
+    
+    // First block that may hold points >= timestamp
+    size_t find_block(const IndexBlock& block, int64_t timestamp) const;
+    static void append_sparse_row(std::vector<BlockIndexEntry>& blocks, const IndexEntry& row,
+                                  size_t row_no);
+    BlockPtr load_block(std::ifstream& in, std::vector<uint8_t>& scratch,
+                        const IndexBlock& block, size_t block_no, bool fill_cache = true);
+    BlockPtr lookup_block(const BlockIndexEntry& entry);
+    BlockPtr decode_block(const uint8_t* ptr, const BlockIndexEntry& entry, bool fill_cache);
+    // First block from block_no on an iterator with these bounds reads,
+    // or block_index.size()
+    static size_t next_readable_block(const IndexBlock& block, size_t block_no, int64_t end_time,
+                                      const std::vector<uint64_t>& filter_keys,
+                                      const std::vector<char>& skip_blocks);
+    static size_t estimate_block_charge(const std::vector<TimeSeriesData>& points);
+    
+    // Returns [offset, offset + size) from the mapping, or reads it through
+    // a lazily opened stream into scratch; nullptr if out of range
+    const uint8_t* read_range(std::ifstream& in, uint64_t offset, uint64_t size,
+                              std::vector<uint8_t>& scratch) const;
     
     bool write_metadata(std::ofstream& out);
-    bool read_metadata(std::ifstream& in);
+    bool read_metadata(const uint8_t* ptr, size_t size, Metadata& metadata) const;
     bool write_bloom_filter(std::ofstream& out);
-    bool read_bloom_filter(std::ifstream& in);
+    bool read_bloom_filter(const uint8_t* ptr, size_t size, IndexBlock& block);
     bool write_index(std::ofstream& out);
-    bool read_index(std::ifstream& in);
-    bool write_data(std::ofstream& out, const std::map<int64_t, TimeSeriesData>& data);
-    bool read_data_at(std::ifstream& in, uint64_t offset, uint32_t size, TimeSeriesData& data);
+    bool read_index(const uint8_t* ptr, size_t size, IndexBlock& block);
+    // Key filter section and footer; offset is 0 when the file has none
+    bool write_key_filters(std::ofstream& out, BuildState& state);
+    bool read_key_filters(std::ifstream& in, std::vector<uint8_t>& scratch, uint64_t file_size,
+                          IndexBlock& block, uint64_t& offset);
+    bool read_data_at(const uint8_t*& ptr, const uint8_t* end, TimeSeriesData& data) const;
+};
+
+/**
+ * @brief K-way merge of SSTables that yields each (timestamp, series) once
+ *
+ * Output is ordered by timestamp, then series id. When several inputs hold
+ * the same point, the one with the highest sequence number wins. Memory is
+ * one decoded block per input, independent of the input sizes.
+ */
+class MergingIterator {
+public:
+    // Yields points with start_time <= timestamp <= end_time
+    explicit MergingIterator(const std::vector<std::shared_ptr<SSTable>>& sstables,
+                             bool fill_cache = false, int64_t start_time = INT64_MIN,
+                             int64_t end_time = INT64_MAX);
+    
+    bool valid() const { return !heap_.empty() && heap_.front().timestamp <= end_time_; }
+    const TimeSeriesData& value() const { return heap_.front().iter->value(); }
+    void next();
+    
+private:
+    struct Head {
+        SSTable::Iterator* iter;
+        int64_t timestamp;
+        uint64_t series_id;
+        uint64_t sequence;
+    };
+    
+    // Min-heap order: smallest key first, newest version first within a key
+    static bool heap_less(const Head& a, const Head& b);
+    void push(SSTable::Iterator* iter, uint64_t sequence);
+    
+    std::vector<std::shared_ptr<SSTable>> sstables_;   // Keeps the iterators' tables alive
+    std::vector<std::unique_ptr<SSTable::Iterator>> iters_;
+    std::vector<Head> heap_;
+    int64_t end_time_;
 };
 
 /**
@@ -167,7 +605,39 @@ struct LSMConfig {
     size_t max_levels = 7;                              // Maximum number of levels
     size_t level_size_multiplier = 10;                  // Each level is 10x larger
     size_t bloom_filter_bits_per_key = 10;              // Bloom filter size
-    bool enable_compression = false;                     // Future: compression
+    bool enable_compression = false;                     // Write columnar SSTables (format v2)
+    size_t block_size_points = 4096;                    // Points per columnar block
+    // Keep quantile and distinct sketches in the block summaries, so
+    // QUANTILE and DISTINCT skip decoding like the other aggregations. Costs
+    // up to a few KB of index memory per block.
+    bool block_sketches = false;
+    bool use_mmap_reads = true;                          // Memory-map SSTables for reads
+    size_t target_file_size_bytes = 64 * 1024 * 1024;   // Compaction output file size
+    size_t compaction_threads = 2;                      // Background compaction pool size
+    size_t max_subcompactions = 4;                      // Parallel time ranges per compaction
+    
+    // Retention: with partition_duration set, no SSTable spans two
+    // partitions [k * duration, (k + 1) * duration), so expired data goes
+    // away by unlinking whole files. ttl is measured back from the newest
+    // timestamp written; both use timestamp units and 0 disables them.
+    int64_t partition_duration = 0;
+    int64_t ttl = 0;
+    
+    // Write stalls: slow puts down, then stop them, while compaction catches up
+    size_t level0_slowdown_writes_trigger = 20;         // L0 files before puts are delayed
+    size_t level0_stop_writes_trigger = 36;             // L0 files before puts block
+    uint64_t soft_pending_compaction_bytes_limit = 1ULL << 30;   // Delay above 1GB of debt
+    uint64_t hard_pending_compaction_bytes_limit = 4ULL << 30;   // Block above 4GB of debt
+    uint64_t delayed_write_rate = 16 * 1024 * 1024;     // Bytes/s accepted while delayed
+    std::shared_ptr<RateLimiter> rate_limiter;           // Flush/compaction write budget; nullptr disables
+    std::shared_ptr<BlockCache> block_cache;             // Shared across trees; nullptr disables
+    std::shared_ptr<MemoryTracker> memory_tracker;       // Charged with memtable arena blocks
+    bool enable_wal = true;                              // Log puts for crash recovery
+    WalSyncMode wal_sync_mode = WalSyncMode::Interval;   // WAL durability level
+    uint32_t wal_sync_interval_ms = 100;                 // Used by WalSyncMode::Interval
+    size_t recovery_threads = 4;                         // Parallel WAL decoding and replay
+    std::shared_ptr<AsyncReader> async_reader;           // Batched SSTable reads; nullptr disables
+    size_t readahead_blocks = 8;                         // Blocks per file per batch
     std::string data_dir = "./lsm_data";                // Data directory
     
     LSMConfig() = default;
@@ -182,22 +652,116 @@ struct LSMConfig {
  * - Bloom filters for fast negative lookups
  * - Range query support
  * - Crash recovery via WAL
+ * 
+ * The SSTable set is recorded in a MANIFEST file (level, sequence, entry
+ * count, time range and format of every file), rewritten atomically
+ * whenever it changes. On startup the tree is rebuilt from the manifest
+ * without touching the SSTables, which are opened on first access; .sst
+ * files the manifest does not list are leftovers of an interrupted flush or
+ * compaction and are deleted. Directories without a manifest are scanned.
+ * 
+ * Retention drops whole SSTables whose newest point is older than the
+ * cutoff and hides everything older than the cutoff from reads, so it
+ * costs O(files) and never rewrites data.
  */
 class LSMTree {
 public:
+    /**
+     * @brief Ordered scan over a time range of the whole tree
+     *
+     * Merges the MemTables and every overlapping SSTable lazily, yielding
+     * the newest version of each (timestamp, series) in timestamp, then
+     * series id order. The MemTables are copied when the iterator is
+     * created (they are bounded by memtable_size_bytes); SSTables are read
+     * one decoded block at a time, so stopping early skips the rest of the
+     * files. The iterator sees the tree as of its creation and may outlive
+     * flushes and compactions.
+     *
+     * With filter_tags only points carrying all of those tags are yielded;
+     * SSTables and blocks whose key filters rule the tags out are skipped.
+     */
+    class Iterator {
+    public:
+        bool valid() const { return !heap_.empty() && heap_.front().timestamp <= end_time_; }
+        const TimeSeriesData& value() const { return heap_.front().source->value(); }
+        void next();
+        
+    private:
+        friend class LSMTree;
+        
+        // A sorted run: a MemTable copy or an SSTable iterator
+        struct Source {
+            std::vector<TimeSeriesData> points;
+            size_t pos = 0;
+            std::unique_ptr<SSTable::Iterator> table_iter;
+            
+            bool valid() const { return table_iter ? table_iter->valid() : pos < points.size(); }
+            const TimeSeriesData& value() const {
+                return table_iter ? table_iter->value() : points[pos];
+            }
+            void next() {
+                if (table_iter) table_iter->next(); else ++pos;
+            }
+        };
+        
+        struct Head {
+            Source* source;
+            int64_t timestamp;
+            uint64_t series_id;
+            size_t rank;            // Lower = newer source
+        };
+        
+        Iterator(int64_t end_time, const Tags& filter_tags)
+            : end_time_(end_time), filter_tags_(filter_tags) {}
+        bool matches(const TimeSeriesData& point) const;
+        void add_source(std::unique_ptr<Source> source);
+        void push(Source* source, size_t rank);
+        static bool heap_greater(const Head& a, const Head& b);
+        
+        std::vector<std::shared_ptr<SSTable>> sstables_;   // Keeps the iterators' tables alive
+        std::vector<std::unique_ptr<Source>> sources_;     // Newest first
+        std::vector<Head> heap_;
+        int64_t end_time_;
+        Tags filter_tags_;
+    };
+    
     explicit LSMTree(const LSMConfig& config = LSMConfig());
     ~LSMTree();
     
     // Basic operations
     bool put(int64_t timestamp, const TimeSeriesData& data);
+    // Moves tags, fields and vector into the MemTable instead of copying
+    bool put(int64_t timestamp, TimeSeriesData&& data);
     bool get(int64_t timestamp, TimeSeriesData& data);
-    std::vector<TimeSeriesData> range_query(int64_t start_time, int64_t end_time);
+    // At most limit points (0 = all) from the start of the range
+    std::vector<TimeSeriesData> range_query(int64_t start_time, int64_t end_time,
+                                            size_t limit = 0);
+    // Points with start_time <= timestamp <= end_time carrying all of filter_tags
+    std::unique_ptr<Iterator> new_iterator(int64_t start_time = INT64_MIN,
+                                           int64_t end_time = INT64_MAX,
+                                           const Tags& filter_tags = {});
+    
+    // Summary of the points new_iterator(start_time, end_time, filter_tags)
+    // would return. Without tag filters, block runs that lie inside the
+    // range and overlap no other source are taken from their stored
+    // summaries; only the remaining blocks are decoded. The quantile and
+    // distinct sketches are only kept with with_sketches.
+    BlockSummary aggregate(int64_t start_time, int64_t end_time, const Tags& filter_tags = {},
+                           bool with_sketches = false);
     
     // Batch operations
     bool put_batch(const std::vector<TimeSeriesData>& data_batch);
+    // Leaves the points of data_batch moved from, timestamps intact
+    bool put_batch(std::vector<TimeSeriesData>&& data_batch);
     
     // Flush operations
     bool flush();  // Flush current MemTable to disk
+    // Write points straight to level-0 SSTables, bypassing the WAL and the
+    // MemTable, for callers that buffer writes themselves. points must be
+    // ordered by timestamp, then series_id(), one version each, as
+    // MemTable::get_all() returns them; they shadow everything written
+    // before. Visible to iterators created after it returns.
+    bool ingest(const std::vector<TimeSeriesData>& points);
     
     // Compaction
     void trigger_compaction();
@@ -211,67 +775,190 @@ public:
         uint64_t sstable_hits = 0;
         uint64_t bloom_filter_rejections = 0;
         uint64_t compactions = 0;
+        uint64_t block_cache_hits = 0;                  // Lookups by this tree's SSTables
+        uint64_t block_cache_misses = 0;
         size_t num_sstables = 0;
         size_t total_size_bytes = 0;
+        size_t index_memory_bytes = 0;                  // Resident sparse indexes + bloom filters
+        size_t loaded_sstables = 0;                     // SSTables opened since startup
+        uint64_t write_stall_micros = 0;                // Time puts spent delayed or stopped
+        uint64_t write_slowdowns = 0;                   // Puts that were delayed
+        uint64_t write_stops = 0;                       // Puts that waited for compaction
+        size_t level0_files = 0;
+        uint64_t pending_compaction_bytes = 0;
+        uint64_t expired_sstables = 0;                  // Files unlinked by retention
+        uint64_t expired_points = 0;
+        uint64_t summarized_blocks = 0;                 // Blocks aggregate() did not decode
     };
     
     Statistics get_statistics() const;
     
+    // Export the counters above (lock-free reads) as sage_tsdb_lsm_* metrics;
+    // the handles must be dropped before this tree
+    std::vector<MetricsRegistry::Handle> register_metrics(MetricsRegistry& registry,
+                                                          const Tags& labels) const;
+    
     // Maintenance
     void clear_all();
     bool recover_from_wal();
     
+    // Checkpoints. SSTables never change once written, so a checkpoint is
+    // the current file set hard-linked into dir (copied where linking
+    // fails, e.g. across filesystems) plus a MANIFEST listing it; the
+    // MemTables are flushed first. Costs one link per file and no data
+    // copies. dir is created if needed and must not hold another checkpoint.
+    bool create_checkpoint(const std::string& dir);
+    // Replace every point with the contents of a checkpoint made by
+    // create_checkpoint: the MemTables and WAL are dropped, the current
+    // SSTables unlinked and the checkpoint's files linked in. The
+    // checkpoint directory stays valid for further restores.
+    bool restore_checkpoint(const std::string& dir);
+    
+    // Remove points older than cutoff: unlinks every SSTable holding only
+    // such points and hides the rest from reads. Files of levels under
+    // compaction are dropped by a later call. Returns the points unlinked.
+    size_t drop_before(int64_t cutoff);
+    int64_t get_retention_cutoff() const { return retention_cutoff_.load(); }
+    // Upper bound of every timestamp written; INT64_MIN when empty
+    int64_t get_newest_timestamp() const { return newest_timestamp_.load(); }
+    
     // Configuration
     LSMConfig get_config() const { return config_; }
     
 private:
     LSMConfig config_;
     
+    // Tag sets of every series written (data_dir/SERIES); nullptr if it
+    // could not be opened
+    std::shared_ptr<SeriesCatalog> series_catalog_;
+    
     // MemTable
     std::unique_ptr<MemTable> active_memtable_;
     std::unique_ptr<MemTable> immutable_memtable_;
     
-    // WAL
+    // WAL (nullptr when disabled)
     std::unique_ptr<WriteAheadLog> wal_;
     
     // SSTables organized by level
     std::map<uint64_t, std::vector<std::shared_ptr<SSTable>>> levels_;
     
     // Synchronization
-    mutable std::mutex memtable_mutex_;
+    mutable std::shared_mutex memtable_mutex_;     // Shared for puts/reads, exclusive to switch MemTables
     mutable std::mutex sstable_mutex_;
     std::mutex compaction_mutex_;
     std::condition_variable compaction_cv_;
     
-    // Background compaction thread
-    std::thread compaction_thread_;
+    // Background compaction pool. Jobs on disjoint level pairs run
+    // concurrently; busy_levels_ is guarded by sstable_mutex_, the rest by
+    // compaction_mutex_.
+    struct CompactionJob {
+        uint64_t level = 0;
+        std::vector<std::shared_ptr<SSTable>> inputs;
+    };
+    
+    std::vector<std::thread> compaction_threads_;
     std::atomic<bool> running_;
     std::atomic<bool> compaction_needed_;
-    
-    // Statistics
-    mutable std::mutex stats_mutex_;
-    Statistics stats_;
+    uint64_t compaction_generation_ = 0;           // Bumped by triggers and finished jobs
+    size_t running_compactions_ = 0;
+    std::set<uint64_t> busy_levels_;
+    
+    // Statistics: sharded counters, summed by get_statistics() and scrapes
+    Counter puts_;
+    Counter gets_;
+    Counter memtable_hits_;
+    Counter sstable_hits_;
+    Counter bloom_filter_rejections_;
+    Counter compactions_;
+    Counter expired_sstables_;
+    Counter expired_points_;
+    Counter summarized_blocks_;
+    
+    // File counts, recomputed with the write stall state
+    std::atomic<size_t> sstable_count_{0};
+    std::atomic<uint64_t> sstable_bytes_{0};
+    std::atomic<size_t> level0_files_{0};
+    
+    // Write stall state, recomputed whenever levels_ changes
+    enum class WriteStall { None, Delayed, Stopped };
+    std::atomic<WriteStall> write_stall_{WriteStall::None};
+    std::atomic<uint64_t> pending_compaction_bytes_{0};
+    std::mutex stall_mutex_;
+    std::condition_variable stall_cv_;
+    RateLimiter delayed_writes_;                   // Paces puts while WriteStall::Delayed
+    std::atomic<uint64_t> write_stall_micros_{0};
+    std::atomic<uint64_t> write_slowdowns_{0};
+    std::atomic<uint64_t> write_stops_{0};
+    
+    // Block cache accounting for this tree
+    std::shared_ptr<BlockCacheCounters> cache_counters_;
     
     // Sequence number for SSTables
     std::atomic<uint64_t> next_sequence_;
     
+    // Retention state: reads skip timestamps below retention_cutoff_
+    std::atomic<int64_t> newest_timestamp_{INT64_MIN};
+    std::atomic<int64_t> retention_cutoff_{INT64_MIN};
+    
     // Private methods
     void compaction_worker();
+    // Delay or block a put of about bytes according to write_stall_
+    void maybe_stall_write(size_t bytes);
+    void update_write_stall();                     // Requires sstable_mutex_
+    // Slow path of put(): switch MemTables under the exclusive lock
+    bool put_after_switch(int64_t timestamp, const TimeSeriesData& data);
+    // put()/put_batch() copying (Data const) or moving the points
+    template <typename Data>
+    bool put_point(int64_t timestamp, Data&& data);
+    template <typename Batch>
+    bool put_points(Batch& data_batch);
     void flush_memtable_to_l0();
-    void compact_level(uint64_t level);
+    // Build SSTables at level from sorted points, cut at partition boundaries
+    bool write_partitioned(const std::vector<TimeSeriesData>& points, uint64_t level,
+                           std::vector<std::shared_ptr<SSTable>>& outputs);
+    int64_t partition_of(int64_t timestamp) const;
+    void note_timestamp(int64_t timestamp);
+    void apply_ttl();
+    bool run_one_compaction();
+    bool pick_compaction(CompactionJob& job);      // Requires sstable_mutex_
     std::vector<std::shared_ptr<SSTable>> select_sstables_for_compaction(uint64_t level);
     bool merge_sstables(const std::vector<std::shared_ptr<SSTable>>& sstables, 
-                       uint64_t target_level);
+                       uint64_t target_level, std::vector<std::shared_ptr<SSTable>>& outputs);
+    // Time ranges [start, end] splitting a compaction into subcompactions
+    std::vector<std::pair<int64_t, int64_t>> plan_subcompactions(
+        const std::vector<std::shared_ptr<SSTable>>& sstables) const;
+    bool merge_range(const std::vector<std::shared_ptr<SSTable>>& sstables, uint64_t target_level,
+                     int64_t start_time, int64_t end_time,
+                     std::vector<std::shared_ptr<SSTable>>& outputs);
     
     std::string generate_sstable_path(uint64_t level, uint64_t sequence);
+    SSTableOptions sstable_options() const;
     bool load_existing_sstables();
     
+    // Manifest of levels_; both require sstable_mutex_
+    static constexpr uint32_t kManifestMagic = 0x4E414D53;   // "SMAN"
+    static constexpr uint32_t kManifestVersion = 2;   // v2 adds the retention cutoff
+    std::string manifest_path() const { return config_.data_dir + "/MANIFEST"; }
+    bool load_manifest();
+    bool write_manifest();
+    bool write_manifest_to(const std::string& path);
+    // Sort loaded levels oldest first and note their timestamps
+    void index_loaded_sstables();
+    void scan_sstable_files();
+    
     // Query helpers
     bool search_in_memtables(int64_t timestamp, TimeSeriesData& data);
     bool search_in_sstables(int64_t timestamp, TimeSeriesData& data);
     
-    void merge_range_results(std::vector<TimeSeriesData>& results,
-                            const std::vector<TimeSeriesData>& new_results);
+    // Copy of the current SSTable set in level order, newest file first within
+    // a level, taken under sstable_mutex_
+    std::vector<std::shared_ptr<SSTable>> snapshot_sstables() const;
+    
+    // new_iterator(); with summary set, isolated block runs inside the range
+    // are merged into *summary and left out of the iterator
+    std::unique_ptr<Iterator> open_iterator(int64_t start_time, int64_t end_time,
+                                            const Tags& filter_tags, BlockSummary* summary,
+                                            bool with_sketches);
 };
 
 } // namespace sage_tsdb
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace sage_tsdb {
+
+/**
+ * @brief Read-only memory mapping of an immutable file
+ *
+ * The mapping stays valid for the lifetime of the object, even if the
+ * underlying file is unlinked in the meantime, so holders of a
+ * shared_ptr<MappedFile> can keep reading after compaction removed it.
+ */
+class MappedFile {
+public:
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /**
+     * @brief Map the whole file
+     * @return nullptr if the file cannot be opened or mapped
+     */
+    static std::shared_ptr<MappedFile> open(const std::string& path);
+
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+
+    // Bounds-checked access to [offset, offset + length)
+    bool contains(uint64_t offset, uint64_t length) const {
+        return offset <= size_ && length <= size_ - offset;
+    }
+
+private:
+    MappedFile(const uint8_t* data, size_t size) : data_(data), size_(size) {}
+
+    const uint8_t* data_;
+    size_t size_;
+};
+
+} // namespace sage_tsdb
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+namespace sage_tsdb {
+
+/**
+ * @brief Running total of the memory charged by its users
+ *
+ * Arenas and memtables given a tracker charge the blocks they hold and
+ * release them when freed, so one tracker can sum the memory of everything
+ * a plugin or compute engine builds (see ResourceHandle::memoryTracker()).
+ * Charging is a relaxed atomic add; nothing is ever refused here, limits
+ * are enforced by whoever reads usage().
+ */
+class MemoryTracker {
+public:
+    MemoryTracker() = default;
+
+    MemoryTracker(const MemoryTracker&) = delete;
+    MemoryTracker& operator=(const MemoryTracker&) = delete;
+
+    void consume(size_t bytes) {
+        size_t usage = usage_.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+        size_t peak = peak_.load(std::memory_order_relaxed);
+        while (usage > peak &&
+               !peak_.compare_exchange_weak(peak, usage, std::memory_order_relaxed)) {
+        }
+    }
+
+    void release(size_t bytes) { usage_.fetch_sub(bytes, std::memory_order_relaxed); }
+
+    size_t usage() const { return usage_.load(std::memory_order_relaxed); }
+    size_t peak() const { return peak_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<size_t> usage_{0};
+    std::atomic<size_t> peak_{0};
+};
+
+} // namespace sage_tsdb
@@ -0,0 +1,172 @@
+#pragma once
+
+#include "latency_histogram.h"
+#include "time_series_data.h"
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace sage_tsdb {
+
+/**
+ * @brief Monotonic counter sharded over cache-line-sized stripes
+ *
+ * inc() is one relaxed fetch_add on the calling thread's stripe, so
+ * threads do not contend on a shared line; value() sums the stripes.
+ */
+class Counter {
+public:
+    static constexpr size_t kStripes = 8;
+
+    Counter() = default;
+    Counter(const Counter&) = delete;
+    Counter& operator=(const Counter&) = delete;
+
+    void inc(uint64_t n = 1);
+    uint64_t value() const;
+
+    // Increments concurrent with reset() may survive it
+    void reset();
+
+private:
+    struct alignas(64) Stripe {
+        std::atomic<uint64_t> value{0};
+    };
+
+    std::array<Stripe, kStripes> stripes_;
+};
+
+/**
+ * @brief Value that can go up and down
+ */
+class Gauge {
+public:
+    Gauge() = default;
+    Gauge(const Gauge&) = delete;
+    Gauge& operator=(const Gauge&) = delete;
+
+    void set(double value) { value_.store(value, std::memory_order_relaxed); }
+    void add(double delta);
+    double value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<double> value_{0.0};
+};
+
+/**
+ * @brief Process metrics in one place, exported in the Prometheus text format
+ *
+ * A metric is a family name (e.g. "sage_tsdb_lsm_puts_total") plus a set of
+ * labels. Subsystems either record into metrics the registry owns (counter(),
+ * gauge(), histogram()) or register callbacks over state they already keep
+ * (addCounter(), addGauge(), addHistogram()), which are read at scrape time.
+ *
+ * Recording never touches the registry. Scraping takes the registry's own
+ * mutex and reads the metrics; callbacks must likewise only load atomics
+ * (or call lock-free accessors), never take a lock the write or query path
+ * holds. A callback stays registered until its Handle is destroyed, which
+ * waits for a scrape in progress, so owners drop their handles before the
+ * state the callbacks read.
+ *
+ * Histograms are LatencyHistograms; they are exported with cumulative
+ * buckets at fixed bounds, after multiplying recorded values by a scale
+ * (1e-6 turns microseconds into the seconds Prometheus expects).
+ */
+class MetricsRegistry {
+public:
+    enum class Type { Counter, Gauge, Histogram };
+
+    // Bucket bounds (seconds) of exported latency histograms
+    static const std::vector<double>& defaultLatencyBounds();
+
+    /**
+     * @brief Unregisters a callback metric on destruction
+     */
+    class Handle {
+    public:
+        Handle() = default;
+        ~Handle() { reset(); }
+        Handle(Handle&& other) noexcept;
+        Handle& operator=(Handle&& other) noexcept;
+        Handle(const Handle&) = delete;
+        Handle& operator=(const Handle&) = delete;
+
+        void reset();
+        explicit operator bool() const { return registry_ != nullptr; }
+
+    private:
+        friend class MetricsRegistry;
+        Handle(MetricsRegistry* registry, uint64_t id) : registry_(registry), id_(id) {}
+
+        MetricsRegistry* registry_ = nullptr;
+        uint64_t id_ = 0;
+    };
+
+    MetricsRegistry() = default;
+    MetricsRegistry(const MetricsRegistry&) = delete;
+    MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+
+    // Owned metrics: the same name and labels return the same instance.
+    // Throws std::invalid_argument for an invalid name or one registered
+    // with another type.
+    std::shared_ptr<Counter> counter(const std::string& name, const std::string& help,
+                                     const Tags& labels = {});
+    std::shared_ptr<Gauge> gauge(const std::string& name, const std::string& help,
+                                 const Tags& labels = {});
+    std::shared_ptr<LatencyHistogram> histogram(const std::string& name, const std::string& help,
+                                                const Tags& labels = {}, double scale = 1e-6);
+
+    // Callback metrics, read at every scrape while the handle lives
+    [[nodiscard]] Handle addCounter(const std::string& name, const std::string& help,
+                                    const Tags& labels, std::function<double()> read);
+    [[nodiscard]] Handle addGauge(const std::string& name, const std::string& help,
+                                  const Tags& labels, std::function<double()> read);
+    [[nodiscard]] Handle addHistogram(const std::string& name, const std::string& help,
+                                      const Tags& labels, const LatencyHistogram* histogram,
+                                      double scale = 1e-6);
+
+    // Prometheus text exposition format (version 0.0.4)
+    void writePrometheus(std::ostream& out) const;
+    std::string exportPrometheus() const;
+
+    // Current value of a counter or gauge series; false if it is not registered
+    bool read(const std::string& name, const Tags& labels, double& value) const;
+
+    size_t size() const;
+
+private:
+    struct Series {
+        Tags labels;
+        std::function<double()> read;              // Counter / Gauge
+        const LatencyHistogram* histogram = nullptr;
+        double scale = 1.0;
+        std::shared_ptr<void> owned;               // Keeps owned metrics alive
+    };
+
+    struct Family {
+        Type type = Type::Counter;
+        std::string help;
+        std::map<uint64_t, Series> series;         // By id, in registration order
+    };
+
+    Family& family(const std::string& name, const std::string& help, Type type);
+    const Series* findSeries(const Family& family, const Tags& labels) const;
+    std::shared_ptr<void> findOwned(const std::string& name, Type type, const Tags& labels) const;
+    uint64_t add(const std::string& name, const std::string& help, Type type, Series series);
+    void remove(uint64_t id);
+
+    mutable std::mutex mutex_;
+    std::map<std::string, Family> families_;
+    std::map<uint64_t, std::string> family_of_;    // Series id -> family name
+    uint64_t next_id_ = 1;
+};
+
+} // namespace sage_tsdb
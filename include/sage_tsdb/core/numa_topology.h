@@ -0,0 +1,54 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace sage_tsdb {
+namespace core {
+
+/**
+ * @brief CPUs of one NUMA node
+ */
+struct NumaNode {
+    int id = 0;
+    std::vector<int> cpus;  // Ascending
+};
+
+/**
+ * @brief NUMA nodes and their CPUs, read from Linux sysfs
+ *
+ * Without sysfs (or on other platforms) the machine is one node 0 holding
+ * every hardware thread, so callers need no special case.
+ */
+class NumaTopology {
+public:
+    // The running machine, read once
+    static const NumaTopology& system();
+
+    // Nodes under a sysfs node directory ("/sys/devices/system/node")
+    static NumaTopology load(const std::string& node_dir);
+
+    // "0-3,8,10-11" -> {0, 1, 2, 3, 8, 10, 11}; malformed ranges are skipped
+    static std::vector<int> parse_cpu_list(const std::string& list);
+
+    const std::vector<NumaNode>& nodes() const { return nodes_; }
+    size_t node_count() const { return nodes_.size(); }
+
+    // nullptr when the node does not exist
+    const NumaNode* node(int id) const;
+
+    // -1 when the CPU belongs to no node
+    int node_of_cpu(int cpu) const;
+
+private:
+    std::vector<NumaNode> nodes_;  // Ascending id
+};
+
+// Restrict the calling thread to cpus; false if unsupported or rejected
+bool pin_current_thread(const std::vector<int>& cpus);
+
+// CPU the calling thread runs on, -1 if unknown
+int current_cpu();
+
+}  // namespace core
+}  // namespace sage_tsdb
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+namespace sage_tsdb {
+
+/**
+ * @brief Token bucket limiting background write bandwidth
+ *
+ * Flushes and compactions call request() before writing; one instance can
+ * be shared by several LSMTrees so they split a single disk budget. The
+ * bucket holds at most refill_period worth of tokens, so idle time does
+ * not turn into a long burst later.
+ */
+class RateLimiter {
+public:
+    explicit RateLimiter(uint64_t bytes_per_second,
+                         std::chrono::microseconds refill_period = std::chrono::milliseconds(100));
+
+    RateLimiter(const RateLimiter&) = delete;
+    RateLimiter& operator=(const RateLimiter&) = delete;
+
+    // Block until bytes may be written; 0 bytes per second disables limiting
+    void request(size_t bytes);
+
+    void set_bytes_per_second(uint64_t bytes_per_second);
+    uint64_t get_bytes_per_second() const {
+        return bytes_per_second_.load(std::memory_order_relaxed);
+    }
+
+    uint64_t get_total_bytes() const { return total_bytes_.load(std::memory_order_relaxed); }
+    uint64_t get_total_wait_micros() const {
+        return total_wait_micros_.load(std::memory_order_relaxed);
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    std::atomic<uint64_t> bytes_per_second_;
+    std::chrono::microseconds refill_period_;
+
+    std::mutex mutex_;
+    double available_ = 0;          // Tokens (bytes) in the bucket
+    Clock::time_point last_refill_;
+
+    std::atomic<uint64_t> total_bytes_{0};
+    std::atomic<uint64_t> total_wait_micros_{0};
+
+    double burst_bytes() const;
+    void refill(Clock::time_point now);
+};
+
+} // namespace sage_tsdb
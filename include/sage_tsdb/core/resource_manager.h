@@ -1,5 +1,7 @@
 #pragma once
 
+#include "memory_tracker.h"
+#include "work_stealing_executor.h"
 #include <cstdint>
 #include <memory>
 #include <string>
@@ -8,6 +10,10 @@
 #include <atomic>
 
 namespace sage_tsdb {
+
+class MetricsRegistry;
+class WriteBufferManager;
+
 namespace core {
 
 /**
@@ -19,10 +25,11 @@ namespace core {
 struct ResourceRequest {
     // Thread allocation
     int requested_threads = 0;  ///< Desired number of worker threads (0 = use default)
+    double max_cpu = 0.0;  ///< Worker-seconds per second the tasks may use (0 = no limit beyond the threads)
     
     // Memory constraints
     uint64_t max_memory_bytes = 0;  ///< Soft memory limit in bytes (0 = unlimited)
-    uint64_t critical_memory_bytes = 0;  ///< Hard limit; triggers forced cleanup
+    uint64_t critical_memory_bytes = 0;  ///< Hard limit; throttles the handle's tasks until back under max_memory_bytes
     
     // GPU/Device allocation (optional)
     std::vector<int> gpu_ids;  ///< Preferred GPU device IDs (empty = CPU only)
@@ -30,8 +37,11 @@ struct ResourceRequest {
     // Model/Asset paths (optional)
     std::string model_path;  ///< Path to ML model file (for caching)
     
-    // Priority hint
-    int priority = 0;  ///< Higher values = higher priority (default 0)
+    // Scheduling priority
+    int priority = 0;  ///< Higher values are served first by the shared pool (default 0)
+    
+    // Placement
+    int numa_node = -1;  ///< Run tasks on pinned workers of this NUMA node (-1 = unbound)
     
     ResourceRequest() = default;
 };
@@ -44,7 +54,7 @@ struct ResourceRequest {
 struct ResourceUsage {
     int threads_used = 0;  ///< Current active threads
     uint64_t memory_used_bytes = 0;  ///< Current memory footprint
-    uint64_t queue_length = 0;  ///< Pending work items in queue
+    uint64_t queue_length = 0;  ///< Pending work items (reported + tasks not yet started)
     
     // Throughput metrics
     uint64_t tuples_processed = 0;  ///< Total tuples/events processed
@@ -54,6 +64,18 @@ struct ResourceUsage {
     uint64_t errors_count = 0;  ///< Total error count
     std::string last_error;  ///< Last error message (if any)
     
+    // Placement
+    int numa_node = -1;  ///< NUMA node the handle's workers run on (-1 = unbound)
+    std::vector<int> cpus;  ///< CPUs those workers are pinned to (empty = unpinned)
+    
+    // Enforcement
+    uint64_t cpu_time_ns = 0;  ///< Worker time spent in the handle's tasks
+    double cpu_limit = -1.0;  ///< Enforced worker-seconds per second (-1 = unlimited, 0 = paused)
+    double throttle_factor = 1.0;  ///< Set by throttleCompute (1.0 = not throttled)
+    bool memory_throttled = false;  ///< Throttled after reaching critical_memory_bytes
+    uint64_t throttled_tasks = 0;  ///< Times a task was held back for lack of CPU budget
+    uint64_t yields = 0;  ///< Times shouldYield() asked the tasks to make way
+    
     ResourceUsage() = default;
 };
 
@@ -76,6 +98,16 @@ public:
      */
     virtual bool submitTask(std::function<void()> task) = 0;
     
+    /**
+     * @brief Submit a move-only task without wrapping it in std::function
+     * @param task Callable to execute; stored inline when it fits Task::kInlineSize
+     * @return true if task was enqueued successfully
+     * 
+     * The default forwards to submitTask(). Handles from createResourceManager()
+     * queue the Task itself, so small callables are submitted without allocating.
+     */
+    virtual bool submit(Task task);
+    
     /**
      * @brief Check if resource allocation is still valid
      * @return true if handle is valid and resources are available
@@ -93,8 +125,30 @@ public:
      * @param usage Current usage metrics
      * 
      * Plugins should call this periodically (e.g., every 1-5 seconds).
+     * Memory charged to memoryTracker() is added to the reported
+     * memory_used_bytes, so leave it out of the report.
      */
     virtual void reportUsage(const ResourceUsage& usage) = 0;
+    
+    /**
+     * @brief Tracker to charge the handle's memory to
+     * @return nullptr when the handle does not account memory (the default)
+     * 
+     * Pass it to the arenas and tables the plugin builds (Arena,
+     * TableConfig::memory_tracker) so their memory counts against
+     * max_memory_bytes and critical_memory_bytes without being reported.
+     */
+    virtual std::shared_ptr<MemoryTracker> memoryTracker() const { return nullptr; }
+    
+    /**
+     * @brief Whether running tasks should make way for higher priority work
+     * 
+     * True while a handle of higher priority has tasks waiting for a
+     * worker. Long tasks check it between steps and resubmit the rest of
+     * their work instead of holding on to the worker. The default never
+     * asks to yield.
+     */
+    virtual bool shouldYield() const { return false; }
 };
 
 /**
@@ -107,6 +161,21 @@ public:
  * - Single global instance (managed by PluginManager)
  * - Thread-safe allocation/deallocation
  * - Supports degradation (reduce quota or switch to stub mode)
+ * - All handles share one work-stealing pool (WorkStealingExecutor); a
+ *   handle's requested_threads is its concurrency quota and its priority
+ *   orders it against other handles. The pool grows to the sum of the
+ *   quotas, so a handle can always run up to its quota at once.
+ * - Placement: a handle whose request names a numa_node gets workers
+ *   pinned to that node's CPUs (one group per node, sized to the node's
+ *   quotas). Memory its tasks allocate is placed node-local by the
+ *   kernel's first-touch policy, so tables ingested from those tasks keep
+ *   their memtables on the node. In NUMA-aware mode, requests without a
+ *   node are placed on the least loaded node.
+ * - Enforcement: each handle's worker time is accounted and, once it has a
+ *   CPU limit, drawn from a token bucket on its queue (see TaskQueue).
+ *   The limit is max_cpu, scaled down by throttleCompute() and, while the
+ *   handle's memory is over critical_memory_bytes, by a further 4x.
+ *   Priorities also preempt at task boundaries through shouldYield().
  */
 class ResourceManager {
 public:
@@ -117,6 +186,7 @@ public:
      * @param plugin_name Unique plugin identifier
      * @param request Resource requirements
      * @return Handle to allocated resources, or nullptr if allocation fails
+     *         (including a numa_node the machine does not have)
      * 
      * Thread-safe. May block if resources are temporarily unavailable.
      */
@@ -149,7 +219,9 @@ public:
      * @param new_request Updated resource limits
      * @return true if adjustment succeeded
      * 
-     * Used for runtime tuning or degradation strategies.
+     * Used for runtime tuning or degradation strategies. Non-zero memory
+     * limits, thread quota, CPU limit and priority in new_request are
+     * applied; the NUMA node is not changed.
      */
     virtual bool adjustQuota(
         const std::string& plugin_name,
@@ -162,12 +234,41 @@ public:
      */
     virtual void setGlobalLimits(int max_threads, uint64_t max_memory_bytes) = 0;
     
+    /**
+     * @brief Place requests without a numa_node on the least loaded node
+     * @param enabled false (default) leaves such handles on unbound workers
+     * 
+     * Affects later allocations only; a handle keeps its node for its lifetime.
+     */
+    virtual void setNumaAware(bool enabled) = 0;
+    
     /**
      * @brief Check if system is under resource pressure
      * @return true if close to global limits (triggers degradation)
+     * 
+     * Also true once any attached write buffer reaches its soft limit.
      */
     virtual bool isUnderPressure() const = 0;
     
+    /**
+     * @brief Include a shared memtable budget in pressure detection
+     * @param write_buffer Budget to watch (e.g. TableManager::getWriteBufferManager())
+     * 
+     * Only a weak reference is kept; the budget may be destroyed first.
+     */
+    virtual void attachWriteBuffer(std::shared_ptr<WriteBufferManager> write_buffer) = 0;
+    
+    /**
+     * @brief Export every handle's usage into a metrics registry
+     * @param registry Registry to export into (e.g. TableManager::getMetricsRegistry()), or nullptr to stop
+     * 
+     * Handles allocated before or after the call register sage_tsdb_resource_*
+     * series labelled {kind="plugin"|"compute", handle=<name>}, and drop them
+     * when released. The series read only atomics the handle already keeps
+     * (memory, queue length, CPU time and throttling), never a handle lock.
+     */
+    virtual void attachMetrics(std::shared_ptr<MetricsRegistry> registry) = 0;
+    
     // ========== Compute Engine Resource Management ==========
     
     /**
@@ -219,7 +320,9 @@ public:
      * @param factor Throttle factor (0.0 = pause, 1.0 = no throttle)
      * 
      * Used when compute engine consumes too many resources.
-     * Example: factor = 0.5 means reduce throughput to 50%.
+     * Example: factor = 0.5 means reduce throughput to 50%: the engine's
+     * tasks get half of its max_cpu, or of its thread quota without one,
+     * in worker-seconds per second. Paused engines keep their queued tasks.
      */
     virtual void throttleCompute(const std::string& compute_name, double factor) = 0;
     
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace sage_tsdb {
+
+/**
+ * @brief Compressed set of 32-bit integers (Roaring layout)
+ *
+ * Values are split by their upper 16 bits into containers. A container
+ * holds its lower halves as a sorted uint16_t array while it has at most
+ * kArrayMax values and as a 65536-bit bitmap beyond that, so sparse and
+ * dense postings both stay small and intersect quickly:
+ * - array & array: merge, or galloping search when one side is much
+ *   smaller
+ * - array & bitmap: one bit test per array value
+ * - bitmap & bitmap: word-wise AND (AVX2 when available)
+ *
+ * add() is cheapest when values arrive in increasing order, which is how
+ * TimeSeriesIndex appends row numbers.
+ */
+class RoaringBitmap {
+public:
+    RoaringBitmap() = default;
+
+    void add(uint32_t value);
+    bool contains(uint32_t value) const;
+    uint64_t cardinality() const;
+    bool empty() const { return containers_.empty(); }
+    void clear() { containers_.clear(); }
+    size_t size_bytes() const;
+
+    // Values lo <= value < hi
+    static RoaringBitmap range(uint32_t lo, uint32_t hi);
+    // values must be strictly increasing
+    static RoaringBitmap from_sorted(const uint32_t* values, size_t count);
+
+    RoaringBitmap& operator&=(const RoaringBitmap& other);
+    // Smallest first, stopping as soon as the result is empty; empty input
+    // yields an empty set
+    static RoaringBitmap intersect(std::vector<const RoaringBitmap*> bitmaps);
+
+    // Drops every value >= first
+    void remove_from(uint32_t first);
+
+    // Calls fn(value) in increasing order until it returns false
+    template <typename Fn>
+    void for_each(Fn&& fn) const {
+        for_each_from(0, std::forward<Fn>(fn));
+    }
+
+    // Same, starting at the first value >= first
+    template <typename Fn>
+    void for_each_from(uint32_t first, Fn&& fn) const {
+        uint16_t first_key = static_cast<uint16_t>(first >> 16);
+        for (size_t c = lower_bound(first_key); c < containers_.size(); ++c) {
+            const auto& container = containers_[c];
+            uint32_t high = static_cast<uint32_t>(container.key) << 16;
+            uint16_t start = container.key == first_key ? static_cast<uint16_t>(first) : 0;
+            if (!container.is_bitmap()) {
+                auto it = std::lower_bound(container.array.begin(), container.array.end(), start);
+                for (; it != container.array.end(); ++it) {
+                    if (!fn(high | *it)) return;
+                }
+                continue;
+            }
+            for (size_t w = start >> 6; w < kBitmapWords; ++w) {
+                uint64_t word = container.bitmap[w];
+                if (w == static_cast<size_t>(start >> 6)) {
+                    word &= ~uint64_t(0) << (start & 63);
+                }
+                for (; word != 0; word &= word - 1) {
+                    uint32_t low = static_cast<uint32_t>(w * 64 + __builtin_ctzll(word));
+                    if (!fn(high | low)) return;
+                }
+            }
+        }
+    }
+
+    std::vector<uint32_t> to_vector() const;
+
+private:
+    static constexpr size_t kArrayMax = 4096;      // Larger containers become bitmaps
+    static constexpr size_t kBitmapWords = 65536 / 64;
+
+    struct Container {
+        uint16_t key = 0;                   // Upper 16 bits of the values
+        uint32_t cardinality = 0;
+        std::vector<uint16_t> array;        // Sorted lower halves, when not a bitmap
+        std::vector<uint64_t> bitmap;       // kBitmapWords words, or empty
+
+        bool is_bitmap() const { return !bitmap.empty(); }
+        bool contains(uint16_t low) const;
+        void to_bitmap();
+        void to_array();
+    };
+
+    std::vector<Container> containers_;     // Ordered by key, none empty
+
+    size_t lower_bound(uint16_t key) const;     // First container with key >= key
+    Container* find_or_insert(uint16_t key);
+    static Container intersect(const Container& a, const Container& b);
+};
+
+} // namespace sage_tsdb
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "aggregation.h"
+#include "stream_table.h"
+#include <functional>
+#include <limits>
+#include <map>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+namespace sage_tsdb {
+
+/**
+ * @brief 持续 rollup（降采样）定义
+ */
+struct RollupConfig {
+    std::string name;                              // rollup 名，也是存储桶的 StreamTable 表名
+    std::string source_table;                      // 源 StreamTable
+    int64_t bucket_width = 1000;                   // 桶宽（与时间戳同单位，如 1s = 1000ms）
+    std::vector<AggregationType> aggregations;     // 可回答的聚合（空表示全部）
+    std::vector<std::string> group_by;             // 分组标签
+    int64_t allowed_lateness = 0;                  // 水位线 = 已见最大时间戳 - allowed_lateness
+};
+
+/**
+ * @brief 增量维护的 rollup
+ *
+ * 设计：
+ * - 每个 (桶, 分组) 保存一份 BlockSummary，摘要可合并，
+ *   因此 1m 的 rollup 也能回答 5m、1h 等桶宽整数倍的窗口；
+ *   摘要含分位数与去重计数草图，QUANTILE/DISTINCT 同样按桶合并
+ * - 源表每次写入后增量更新；桶在水位线越过其结束时间之前保持打开，
+ *   期间到达的乱序数据照常计入；之后写入存储表（seal）
+ * - 落在已 seal 桶中的迟到数据被丢弃并计入 late_dropped
+ * - 存储表每行：timestamp = 桶起点，tags = 分组标签，value = 编码后的摘要
+ *
+ * 线程安全：ingest 独占加锁，scan 共享加锁
+ */
+class Rollup {
+public:
+    struct Stats {
+        uint64_t points = 0;          // 已计入的源数据点
+        uint64_t late_dropped = 0;    // 迟于水位线被丢弃的数据点
+        uint64_t sealed_buckets = 0;  // 已写入存储表的 (桶, 分组)
+        size_t open_buckets = 0;      // 内存中仍打开的 (桶, 分组)
+        int64_t watermark = std::numeric_limits<int64_t>::min();
+    };
+
+    /**
+     * @param config rollup 定义（bucket_width 必须为正）
+     * @param storage 保存已 seal 桶的表
+     */
+    Rollup(const RollupConfig& config, std::shared_ptr<StreamTable> storage);
+
+    const RollupConfig& getConfig() const { return config_; }
+    std::shared_ptr<StreamTable> getStorage() const { return storage_; }
+
+    /**
+     * @brief 计入源表新写入的数据（StreamTable 写入监听器）
+     */
+    void ingest(const TimeSeriesData* data, size_t count);
+
+    /**
+     * @brief 把打开的桶也写入存储表，但保持打开
+     *
+     * 用于持久化检查点；桶之后 seal 时以新版本覆盖
+     */
+    void checkpoint();
+
+    /**
+     * @brief 能否回答该聚合查询
+     *
+     * 要求：聚合在 aggregations 中；window_size 为 0 或桶宽的整数倍；
+     * filter_tags 与 group_by 的标签都在 rollup 的 group_by 中
+     */
+    bool canAnswer(const QueryConfig& config) const;
+
+    /**
+     * @brief 访问 range 内与 filter_tags 匹配的每个非空 (桶, 分组)，含打开的桶
+     * @param range 时间范围，只返回起点落在其中的桶
+     */
+    void scan(const TimeRange& range, const Tags& filter_tags,
+              const std::function<void(int64_t bucket_start, const Tags& group,
+                                       const BlockSummary& summary)>& visit) const;
+
+    int64_t bucketStart(int64_t timestamp) const;
+
+    Stats getStats() const;
+
+private:
+    RollupConfig config_;
+    std::shared_ptr<StreamTable> storage_;
+
+    mutable std::shared_mutex mutex_;
+    std::map<int64_t, std::map<Tags, BlockSummary>> open_;  // 桶起点 → 分组 → 摘要
+    int64_t max_timestamp_ = std::numeric_limits<int64_t>::min();
+    int64_t sealed_before_ = std::numeric_limits<int64_t>::min();  // 起点早于它的桶已 seal
+    Stats stats_;
+
+    Tags groupOf(const Tags& tags) const;
+    void sealBefore(int64_t bucket_start);    // 调用者独占持有 mutex_
+    std::vector<TimeSeriesData> encodeBucket(int64_t bucket_start,
+                                             const std::map<Tags, BlockSummary>& groups) const;
+};
+
+} // namespace sage_tsdb
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "time_series_data.h"
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace sage_tsdb {
+
+/**
+ * @brief Dictionary from tag sets to compact series ids
+ *
+ * Each distinct tag set is stored once and numbered densely from 0 in the
+ * order it was first seen. Indexes, MemTables and the WAL keep the 32-bit
+ * id next to a point instead of its tag map and resolve it back through
+ * tags() when handing points out.
+ *
+ * Ids are only meaningful within one catalog. A catalog opened on a file
+ * appends every new series to it (fdatasync'd before intern() returns), so
+ * ids stay stable across restarts and may be written to logs. File
+ * layout: u32 magic, u32 version, then records framed as
+ * [u32 payload length][u32 crc32c(payload)][u32 id][string map]; a torn
+ * tail is dropped on open.
+ *
+ * Thread-safe. References returned by tags() stay valid for the lifetime
+ * of the catalog.
+ */
+class SeriesCatalog {
+public:
+    static constexpr uint32_t kMagic = 0x54414353;   // "SCAT"
+    static constexpr uint32_t kVersion = 1;
+    static constexpr uint32_t kInvalidId = UINT32_MAX;
+
+    SeriesCatalog() = default;          // In memory only
+    ~SeriesCatalog();
+
+    SeriesCatalog(const SeriesCatalog&) = delete;
+    SeriesCatalog& operator=(const SeriesCatalog&) = delete;
+
+    /**
+     * @brief Load the series stored at path and persist new ones there
+     * @return false if the file cannot be read or created
+     */
+    bool open(const std::string& path);
+
+    /**
+     * @brief Id of tags, adding the series if it is new
+     * @return kInvalidId if a new series could not be persisted
+     */
+    uint32_t intern(const Tags& tags);
+
+    // Id of an existing series, or kInvalidId
+    uint32_t find(const Tags& tags) const;
+
+    // Tag set of id; id must come from this catalog
+    const Tags& tags(uint32_t id) const;
+
+    bool contains(uint32_t id) const;
+    size_t size() const;
+    // Approximate heap bytes held by the dictionary
+    size_t memory_bytes() const;
+
+private:
+    mutable std::shared_mutex mutex_;
+    std::deque<Tags> series_;                               // Indexed by id
+    std::unordered_multimap<uint64_t, uint32_t> by_hash_;   // hash_tags -> id
+    size_t string_bytes_ = 0;
+    int fd_ = -1;                                           // Catalog file, or -1
+
+    uint32_t find_locked(const Tags& tags, uint64_t hash) const;
+};
+
+} // namespace sage_tsdb
@@ -0,0 +1,119 @@
+#pragma once
+
+#include "lsm_tree.h"
+#include "series_catalog.h"
+#include "time_series_data.h"
+#include "time_series_index.h"
+#include <atomic>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace sage_tsdb {
+
+/**
+ * @brief Configuration of a ShardedTable
+ */
+struct ShardedTableConfig {
+    size_t num_shards = 4;
+
+    // Tags hashed to pick a series' shard; the whole tag set when empty.
+    // Naming them lets filters and group_by on those tags stay on one shard.
+    std::vector<std::string> shard_by;
+
+    // When set, every shard also writes an LSMTree (MemTable + WAL) under
+    // data_dir/shard-<i>, configured from lsm, and reloads its index from
+    // it on open
+    std::string data_dir;
+    LSMConfig lsm;
+};
+
+/**
+ * @brief Table whose series are hash-partitioned across independent shards
+ *
+ * Each shard has its own TimeSeriesIndex and, with a data_dir, its own
+ * LSMTree, so writes to different shards never contend; insertBatch()
+ * splits a batch by shard and applies the shards in parallel. All shards
+ * share one SeriesCatalog.
+ *
+ * Queries fan out to the shards the filter can match and merge their
+ * results by timestamp (ties in shard order):
+ * - a filter binding every shard_by tag selects exactly one shard
+ * - otherwise shards that never saw one of the filter's tag values are
+ *   skipped
+ * Aggregations run inside the shards when one shard is visited or every
+ * group lives on one shard (group_by covers shard_by); otherwise the
+ * shards' points are aggregated after the merge.
+ *
+ * Thread-safe.
+ */
+class ShardedTable {
+public:
+    explicit ShardedTable(const ShardedTableConfig& config = ShardedTableConfig{},
+                          std::shared_ptr<SeriesCatalog> catalog = nullptr);
+    ~ShardedTable();
+
+    ShardedTable(const ShardedTable&) = delete;
+    ShardedTable& operator=(const ShardedTable&) = delete;
+
+    /**
+     * @brief Add one point to its series' shard
+     * @return Number of points added to the table before this one
+     */
+    size_t insert(const TimeSeriesData& data);
+
+    /**
+     * @brief Add points, one thread per shard touched
+     * @return Index of each point, as insert() would number them
+     */
+    std::vector<size_t> insertBatch(const std::vector<TimeSeriesData>& data_list);
+
+    /**
+     * @brief Query like TimeSeriesIndex::query() across the shards
+     */
+    std::vector<TimeSeriesData> query(const QueryConfig& config) const;
+    // query() without copying the points, like TimeSeriesIndex::query_view()
+    TimeSeriesIndex::ResultView query_view(const QueryConfig& config) const;
+
+    // Shard that stores series tags
+    size_t shard_of(const Tags& tags) const;
+    // Shards that may hold points carrying every filter tag, ascending
+    std::vector<size_t> candidate_shards(const Tags& filter_tags) const;
+
+    size_t num_shards() const { return shards_.size(); }
+    size_t size() const;
+    bool empty() const;
+    // Drops the in-memory data; shard trees keep what they persisted
+    void clear();
+
+    const std::shared_ptr<SeriesCatalog>& catalog() const { return catalog_; }
+
+private:
+    struct Shard {
+        std::unique_ptr<TimeSeriesIndex> index;
+        std::unique_ptr<LSMTree> tree;              // null without a data_dir
+
+        // Tag values of the shard's series, for pruning
+        mutable std::shared_mutex tags_mutex;
+        std::unordered_set<uint32_t> series;
+        std::unordered_map<std::string, std::unordered_set<std::string>> tag_values;
+
+        void note_series(uint32_t id, const Tags& tags);
+        bool may_match(const Tags& filter_tags) const;
+    };
+
+    // Write points to the shard's tree and index
+    void apply(Shard& shard, const std::vector<const TimeSeriesData*>& points);
+    // Whether every group of config lives on a single shard
+    bool groups_within_shards(const QueryConfig& config) const;
+
+    ShardedTableConfig config_;
+    std::shared_ptr<SeriesCatalog> catalog_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+    std::atomic<size_t> next_index_{0};
+};
+
+} // namespace sage_tsdb
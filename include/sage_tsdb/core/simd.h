@@ -0,0 +1,49 @@
+#pragma once
+
+// Kernels with vector variants compile each one with a target attribute,
+// so a portable build carries all of them and picks one at run time
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define SAGE_TSDB_SIMD_DISPATCH 1
+#define SAGE_TSDB_TARGET(isa) __attribute__((target(isa)))
+
+// GCC 12 reports the _mm*_undefined_* placeholders these headers pass to
+// gathers and masked ops as uninitialized
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+#include <immintrin.h>
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+namespace sage_tsdb {
+
+/**
+ * @brief Run-time choice of the vector ISA used by the scan kernels
+ *
+ * The widest level the CPU supports is detected once. The environment
+ * variable SAGE_TSDB_SIMD (scalar, avx2 or avx512) caps it at startup, and
+ * set_level() caps it later so tests and benchmarks can compare paths.
+ * Without SAGE_TSDB_SIMD_DISPATCH only the scalar level exists.
+ */
+namespace simd {
+
+enum class Level { Scalar = 0, AVX2 = 1, AVX512 = 2 };
+
+// Widest level this CPU supports
+Level detected();
+
+// Level the kernels run at
+Level active();
+
+// Caps the kernels at level, clamped to detected(); returns the level now active
+Level set_level(Level level);
+
+const char* name(Level level);
+
+} // namespace simd
+
+} // namespace sage_tsdb
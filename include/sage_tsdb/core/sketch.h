@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace sage_tsdb {
+
+/**
+ * @brief Mergeable quantile sketch (merging t-digest)
+ *
+ * Values are buffered and periodically merged into at most about
+ * kCompression centroids, sized by the arcsine scale function so that
+ * centroids near the tails stay small: p99 and p1 are much more accurate
+ * than the median's rank error of roughly 1 / kCompression. Two sketches
+ * merge into one as if it had seen both inputs, in any order.
+ *
+ * Const members never modify the sketch, so sketches shared between
+ * readers (e.g. SSTable block summaries) need no lock.
+ */
+class QuantileSketch {
+public:
+    static constexpr double kCompression = 100.0;
+
+    bool empty() const { return count_ == 0; }
+    uint64_t count() const { return count_; }
+
+    void add(double value);
+    void merge(const QuantileSketch& other);
+    // Merge buffered values now and release the buffer, e.g. before storing
+    void compact();
+
+    // Value at rank q * count(), q clamped to [0, 1]; NaN if empty
+    double quantile(double q) const;
+
+    size_t memory_bytes() const;
+
+    // Binary form used in SSTable files
+    void serialize(std::vector<uint8_t>& out) const;
+    bool deserialize(const uint8_t*& ptr, const uint8_t* end);
+
+    // Same as a list of doubles, for array-valued rows (rollups)
+    void encode(std::vector<double>& out) const;
+    bool decode(const double*& ptr, const double* end);
+
+private:
+    struct Centroid {
+        double mean;
+        double weight;
+    };
+
+    // Compresses the buffer into the centroids
+    void compress();
+    // Centroids including the buffer, without modifying the sketch
+    std::vector<Centroid> merged() const;
+    static void compress(std::vector<Centroid>& centroids);
+
+    std::vector<Centroid> centroids_;   // Sorted by mean
+    std::vector<Centroid> buffer_;      // Values and merged sketches not compressed yet
+    uint64_t count_ = 0;
+    double min_ = 0.0;
+    double max_ = 0.0;
+};
+
+/**
+ * @brief Mergeable distinct-count sketch (HyperLogLog)
+ *
+ * 2^kPrecision six-bit registers give a standard error of about 2.3%.
+ * Small sketches keep only their non-zero registers, sorted by index, and
+ * switch to the dense array once that would be larger. Merging takes the
+ * maximum of every register, so it is exact and order independent.
+ */
+class DistinctSketch {
+public:
+    static constexpr int kPrecision = 11;
+    static constexpr uint32_t kRegisters = 1u << kPrecision;
+
+    bool empty() const { return sparse_.empty() && registers_.empty(); }
+
+    // Values equal as doubles count once (0.0 and -0.0 included)
+    void add(double value);
+    void add_hash(uint64_t hash);
+    void merge(const DistinctSketch& other);
+
+    double estimate() const;
+
+    size_t memory_bytes() const;
+
+    void serialize(std::vector<uint8_t>& out) const;
+    bool deserialize(const uint8_t*& ptr, const uint8_t* end);
+
+    void encode(std::vector<double>& out) const;
+    bool decode(const double*& ptr, const double* end);
+
+private:
+    static constexpr uint32_t kSparseLimit = kRegisters / 4;  // 4-byte entries
+
+    void set(uint32_t index, uint8_t rank);
+    void densify();
+
+    std::vector<uint32_t> sparse_;      // (index << 6) | rank, sorted; while small
+    std::vector<uint8_t> registers_;    // kRegisters ranks once dense
+};
+
+} // namespace sage_tsdb
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "mapped_file.h"
+#include "time_series_data.h"
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace sage_tsdb {
+
+/**
+ * @brief Location and range of one chunk of a snapshot file
+ */
+struct SnapshotChunk {
+    uint64_t offset = 0;
+    uint32_t size = 0;
+    uint32_t crc = 0;                 // crc32c of the chunk bytes
+    uint32_t points = 0;
+    int64_t min_timestamp = 0;
+    int64_t max_timestamp = 0;
+};
+
+/**
+ * @brief Chunked snapshot files for StorageEngine
+ *
+ * Points are written as independent ColumnarBlock chunks and located by a
+ * footer index, so a writer holds one chunk at a time and readers decode
+ * chunks in any order, on as many threads as they like.
+ *
+ * Layout (little-endian):
+ * - u32 kMagic, u32 kVersion
+ * - chunk bytes, back to back
+ * - footer: per chunk u64 offset, u32 size, u32 crc32c, u32 points,
+ *   i64 min timestamp, i64 max timestamp
+ * - trailer: u64 footer offset, u32 chunk count, u32 kMagic
+ *
+ * A file without its trailer (an interrupted write) does not open.
+ */
+class SnapshotWriter {
+public:
+    static constexpr uint32_t kMagic = 0x43445453;     // "STDC"
+    static constexpr uint32_t kVersion = 1;
+    static constexpr size_t kChunkPoints = 16384;
+
+    SnapshotWriter() = default;
+    ~SnapshotWriter();
+
+    SnapshotWriter(const SnapshotWriter&) = delete;
+    SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+
+    // Create or truncate path and write the header
+    bool open(const std::string& path);
+
+    // Buffer a point; a chunk is written every kChunkPoints points, sorted
+    // by timestamp within the chunk
+    bool append(const TimeSeriesData& point);
+    bool append(TimeSeriesData&& point);
+
+    // Write the last chunk, the footer and the trailer
+    bool close();
+
+    uint64_t points_written() const { return points_written_; }
+    uint64_t bytes_written() const { return offset_; }
+
+private:
+    bool write_chunk();
+
+    std::ofstream out_;
+    std::vector<TimeSeriesData> pending_;
+    std::vector<uint8_t> encoded_;
+    std::vector<SnapshotChunk> chunks_;
+    uint64_t offset_ = 0;
+    uint64_t points_written_ = 0;
+};
+
+/**
+ * @brief Reader of a snapshot file; chunks decode independently
+ */
+class SnapshotReader {
+public:
+    using ChunkSink = std::function<void(std::vector<TimeSeriesData>&&)>;
+
+    // Map path and read its footer; false if missing or not a complete snapshot
+    bool open(const std::string& path);
+
+    const std::vector<SnapshotChunk>& chunks() const { return chunks_; }
+    uint64_t point_count() const;
+    size_t file_size() const { return file_ ? file_->size() : 0; }
+
+    /**
+     * @brief Decode chunk i, appending its points to out; safe to call
+     * from several threads at once
+     * @return false if the chunk is corrupt
+     */
+    bool read_chunk(size_t i, std::vector<TimeSeriesData>& out) const;
+
+    /**
+     * @brief Decode every chunk on up to threads threads (0 = one per core)
+     *
+     * sink receives each chunk once, in file order, from whichever worker
+     * decoded it; calls never overlap. At most one decoded chunk per
+     * worker is held at a time.
+     *
+     * @return false if a chunk is corrupt; chunks before it were delivered
+     */
+    bool for_each_chunk(const ChunkSink& sink, size_t threads = 0) const;
+
+private:
+    std::shared_ptr<MappedFile> file_;
+    std::vector<SnapshotChunk> chunks_;
+};
+
+} // namespace sage_tsdb
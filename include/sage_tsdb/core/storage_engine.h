@@ -2,10 +2,12 @@
 
 #include "time_series_data.h"
 #include "lsm_tree.h"
+#include "snapshot_file.h"
 #include <cstdint>
 #include <fstream>
 #include <memory>
 #include <string>
+#include <type_traits>
 #include <vector>
 
 namespace sage_tsdb {
@@ -78,18 +80,64 @@ public:
     /**
      * @brief Save time series data to disk
      * @param data Vector of time series data
-     * @param file_path Path to save file (for compatibility, uses LSM tree internally)
+     * @param file_path Path of the chunked snapshot file written for load()
      * @return true if successful
+     *
+     * The points are also put into the LSM tree, tagged with file_path,
+     * so that query() finds them.
      */
     bool save(const std::vector<TimeSeriesData>& data, const std::string& file_path);
     
     /**
      * @brief Load time series data from disk
-     * @param file_path Path to load file (for compatibility, queries LSM tree)
+     * @param file_path Path to load file: a chunked snapshot, else the
+     *        points save() put in the LSM tree for it
      * @return Vector of loaded data
      */
     std::vector<TimeSeriesData> load(const std::string& file_path);
     
+    /**
+     * @brief Write points to a chunked snapshot file (see SnapshotWriter)
+     * @param first, last Points to write; TimeSeriesData or anything with to_data()
+     * @param file_path Path of the snapshot file
+     * @return true if successful
+     *
+     * Pulls points one at a time and writes a chunk every
+     * SnapshotWriter::kChunkPoints points, so only one chunk is held in
+     * memory. Unlike save(), nothing goes into the LSM tree.
+     */
+    template <typename Iterator>
+    bool save_chunked(Iterator first, Iterator last, const std::string& file_path);
+    
+    /**
+     * @brief Decode a chunked snapshot file on up to threads threads (0 = one per core)
+     * @param sink Receives every chunk once, in file order, never concurrently
+     * @return false if the file is missing, not a snapshot, or corrupt
+     */
+    bool load_chunked(const std::string& file_path, const SnapshotReader::ChunkSink& sink,
+                      size_t threads = 0);
+    
+    /**
+     * @brief Whether file_path is a complete chunked snapshot file
+     */
+    static bool is_chunked_file(const std::string& file_path);
+    
+    /**
+     * @brief Query persisted data across all files
+     * @param config Time range, tag filters and limit (0 = no limit)
+     * @return Matching points in timestamp order
+     *
+     * Streams the LSM tree and stops as soon as config.limit points match.
+     * With config.aggregation set, returns one point per window of
+     * config.window_size (aligned to multiples of it; the whole range when
+     * 0) holding the aggregate, timestamped with the window start. Empty
+     * windows are left out. Whole SSTable blocks are aggregated from their
+     * stored summaries without decoding. With config.group_by, there is
+     * one point per window and group, carrying the group's tags; those
+     * queries decode every point once.
+     */
+    std::vector<TimeSeriesData> query(const QueryConfig& config);
+    
     /**
      * @brief Create a checkpoint
      * @param data Vector of time series data
@@ -183,6 +231,22 @@ private:
      */
     bool save_checkpoint_metadata();
     
+    /**
+     * @brief Put data into the LSM tree tagged with file_path, then flush
+     */
+    bool put_tagged(const std::vector<TimeSeriesData>& data, const std::string& file_path);
+    
+    /**
+     * @brief Windowed aggregate query (config.aggregation != NONE)
+     */
+    std::vector<TimeSeriesData> aggregate(const QueryConfig& config);
+    
+    /**
+     * @brief Aggregate with config.group_by over [start, end] in one streaming pass
+     */
+    std::vector<TimeSeriesData> aggregate_groups(const QueryConfig& config, int64_t start,
+                                                 int64_t end);
+    
     std::string base_path_;                           // Base directory for storage
     std::map<uint64_t, CheckpointInfo> checkpoints_;  // Checkpoint registry
     bool compression_enabled_;                         // Compression flag
@@ -191,9 +255,29 @@ private:
     
     // LSM tree for efficient storage
     std::unique_ptr<LSMTree> lsm_tree_;
-    
-    // File to data mapping for independent file storage
-    std::map<std::string, std::vector<TimeSeriesData>> file_data_mapping_;
 };
 
+template <typename Iterator>
+bool StorageEngine::save_chunked(Iterator first, Iterator last, const std::string& file_path) {
+    SnapshotWriter writer;
+    if (!writer.open(file_path)) {
+        return false;
+    }
+    for (; first != last; ++first) {
+        bool ok;
+        if constexpr (std::is_convertible_v<decltype(*first), const TimeSeriesData&>) {
+            ok = writer.append(*first);
+        } else {
+            ok = writer.append((*first).to_data());
+        }
+        if (!ok) {
+            writer.close();
+            return false;
+        }
+    }
+    bool ok = writer.close();
+    bytes_written_ += writer.bytes_written();
+    return ok;
+}
+
 } // namespace sage_tsdb
@@ -3,13 +3,20 @@
 #include "time_series_data.h"
 #include "time_series_index.h"
 #include "lsm_tree.h"
+#include "write_buffer_manager.h"
+#include "last_value_cache.h"
+#include <atomic>
 #include <memory>
 #include <string>
 #include <vector>
 #include <mutex>
 #include <unordered_map>
 #include <chrono>
+#include <condition_variable>
+#include <functional>
 #include <shared_mutex>
+#include <limits>
+#include <thread>
 
 namespace sage_tsdb {
 
@@ -20,16 +27,25 @@ struct TableConfig {
     // MemTable 配置
     size_t memtable_size_bytes = 64 * 1024 * 1024;  // 64MB
     double memtable_flush_threshold = 0.9;           // 90% 触发 flush
+    size_t max_immutable_memtables = 2;              // flush 队列深度，队满时写入阻塞
     
     // LSM-Tree 配置
     size_t lsm_level0_file_num_compaction_trigger = 4;
     size_t lsm_max_levels = 7;
     double lsm_level_size_multiplier = 10.0;
     
+    // 值类型：只存标量 double 的表写入数组值时抛 std::invalid_argument，
+    // 索引按标量列存放，不为数组值预留旁列
+    bool scalar_values = false;
+    
     // 索引配置
     bool enable_timestamp_index = true;
     std::vector<std::string> indexed_tags;           // 需要索引的标签
     
+    // 最新值缓存（queryLatest / queryLatestPerSeries，0 表示禁用）
+    size_t latest_cache_size = 1024;                 // 整表保留的最新数据点数
+    size_t latest_cache_per_series = 1;              // 每个序列保留的最新数据点数
+    
     // 性能配置
     size_t write_buffer_size = 4 * 1024 * 1024;     // 4MB
     bool enable_compression = true;
@@ -37,6 +53,21 @@ struct TableConfig {
     // 持久化配置
     std::string data_dir;                            // 数据目录
     bool enable_wal = true;                          // 写前日志
+    WalSyncMode wal_sync_mode = WalSyncMode::Interval; // WAL 持久化级别
+    uint32_t wal_sync_interval_ms = 100;             // Interval 模式下的 fsync 周期
+    
+    // 保留策略（时间戳单位，0 表示关闭）
+    int64_t partition_duration = 0;                  // 时间分区宽度，SSTable 不跨分区（如 3600000 = 按小时）
+    int64_t ttl = 0;                                 // 早于最新时间戳 ttl 的数据过期，按整个文件删除
+    
+    // 缓存配置
+    std::shared_ptr<BlockCache> block_cache;         // 共享块缓存（TableManager 自动注入）
+    std::shared_ptr<RateLimiter> rate_limiter;       // flush/compaction 写带宽限制（可多表共享）
+    std::shared_ptr<WriteBufferManager> write_buffer_manager; // 多表共享的 MemTable 内存预算（TableManager 自动注入）
+    std::shared_ptr<MemoryTracker> memory_tracker;   // MemTable 内存记账（如插件的 ResourceHandle::memoryTracker()）
+    
+    // 监控：表的指标以 table=<表名> 标签注册到此处（TableManager 自动注入）
+    std::shared_ptr<MetricsRegistry> metrics_registry;
 };
 
 /**
@@ -44,9 +75,15 @@ struct TableConfig {
  * 
  * 设计原则：
  * - 所有数据先写入 MemTable，再 flush 到 LSM-Tree
+ * - 双缓冲 flush：MemTable 写满时立即换上新的，旧的进入 flush 队列，
+ *   由后台线程按先后写成 SSTable；写入只在队列已满时阻塞
+ * - 全局内存预算（可选，需 LSM-Tree）：MemTable 占用计入共享的 WriteBufferManager，
+ *   超过软限制时由其挑选最大/最旧的 MemTable 切换 flush，达到硬限制时写入阻塞
  * - 支持乱序插入（自动按时间排序）
  * - 提供窗口查询接口（高效范围查询）
  * - 支持标签索引（加速过滤）
+ * - 查询无锁：读者原子地取得当前 MemTable 组合的快照（引用计数保活），
+ *   写者切换 MemTable 时发布新的组合，不会形成读写锁排队
  * 
  * 适用场景：
  * - Stream S 和 Stream R 的独立表
@@ -74,6 +111,7 @@ public:
      * 
      * 线程安全：支持多线程并发写入
      * 性能：O(log n) 平均，O(1) 最好（直接插入 MemTable）
+     * @throws std::invalid_argument scalar_values 表写入数组值时
      */
     size_t insert(const TimeSeriesData& data);
     
@@ -86,6 +124,28 @@ public:
      */
     std::vector<size_t> insertBatch(const std::vector<TimeSeriesData>& data_list);
     
+    /**
+     * @brief 批量插入数据，标签、字段与数组值移入 MemTable 而不复制
+     * 
+     * 之后 data_list 中的数据点只保留时间戳。注册了写入监听器或启用
+     * 最新值缓存时需在写入后读取整批，此时退化为复制写入。
+     */
+    std::vector<size_t> insertBatch(std::vector<TimeSeriesData>&& data_list);
+    
+    /**
+     * @brief 从列式批量文件（BulkFileWriter 格式）导入数据
+     * @param path 批量文件路径
+     * @return 导入的数据条数（同一 (timestamp, tags) 只计最后一个版本）
+     * @throws std::runtime_error 文件无法读取、损坏或写入 SSTable 失败时；
+     *         此前已导入的批次保持可见
+     * @throws std::invalid_argument scalar_values 表遇到数组值时
+     * 
+     * 有 LSM-Tree 时不经 WAL 与 MemTable：每攒够约一个 MemTable 大小的帧，
+     * 按 (timestamp, series) 排序去重后直接写成 Level 0 SSTable；
+     * 内存中尚未 flush 的同键数据仍优先。没有 LSM-Tree 时按 insertBatch 写入。
+     */
+    size_t importFile(const std::string& path);
+    
     // ========== 数据查询接口 ==========
     
     /**
@@ -94,11 +154,14 @@ public:
      * @param filter_tags 可选的标签过滤器
      * @return 匹配的数据列表（已按时间排序）
      * 
-     * 实现：
+     * 实现（scanRange）：
      * 1. 查询 MemTable（内存中的最新数据）
-     * 2. 查询 Immutable MemTable（正在 flush 的数据）
-     * 3. 查询 LSM-Tree 各层（磁盘上的历史数据）
-     * 4. 合并去重，按时间排序返回
+     * 2. 查询 flush 队列中的 Immutable MemTable
+     * 3. 查询 LSM-Tree 各层（磁盘上的历史数据），按 SSTable 的 min/max
+     *    时间戳与标签过滤器跳过无关文件，逐块解码
+     * 4. 按时间戳多路归并；同一 (timestamp, tags) 只保留最新来源的版本
+     * 
+     * 线程安全：读取 MemTable 快照，不加锁，不阻塞写入
      */
     std::vector<TimeSeriesData> query(const TimeRange& range,
                                       const Tags& filter_tags = {}) const;
@@ -118,18 +181,42 @@ public:
      * @brief 查询最新的 N 条数据
      * @param n 数据条数
      * @return 最新的 n 条数据（降序排列）
+     * 
+     * n 不超过 latest_cache_size 时由最新值缓存直接回答，O(n)；
+     * 重启后缓存为冷，首次调用扫描一遍（含 LSM-Tree）回填
      */
     std::vector<TimeSeriesData> queryLatest(size_t n) const;
     
+    /**
+     * @brief 查询每个序列最新的 N 条数据（"当前状态"）
+     * @param n 每个序列的条数（默认只取最新值）
+     * @param filter_tags 只返回标签匹配的序列
+     * @return 按序列标签排序，同一序列内降序
+     * 
+     * n 不超过 latest_cache_per_series 时由缓存回答，否则扫描全表
+     */
+    std::vector<TimeSeriesData> queryLatestPerSeries(size_t n = 1,
+                                                     const Tags& filter_tags = {}) const;
+    
     /**
      * @brief 统计查询（不返回完整数据）
      * @param range 时间范围
      * @return 数据条数
      * 
-     * 优化：仅统计，不加载完整数据
+     * 与 query() 读同一路径（含 LSM-Tree），仅统计，不复制数据点
      */
     size_t count(const TimeRange& range) const;
     
+    /**
+     * @brief 把 range 内匹配 filter_tags 的数据导出为列式批量文件
+     * @return 导出的数据条数
+     * @throws std::runtime_error 文件写入失败时
+     * 
+     * 与 query() 读同一路径，但边扫描边按帧编码写出，不在内存中保留结果
+     */
+    size_t exportFile(const std::string& path, const TimeRange& range,
+                      const Tags& filter_tags = {}) const;
+    
     // ========== 索引管理 ==========
     
     /**
@@ -157,7 +244,8 @@ public:
      * @brief 手动触发 MemTable flush
      * @return 是否成功
      * 
-     * 正常情况下自动触发，但可手动调用（如测试、checkpoint）
+     * 正常情况下由后台线程自动完成，但可手动调用（如测试、checkpoint）；
+     * 切换当前 MemTable 并等待 flush 队列全部写入 LSM-Tree
      */
     bool flush();
     
@@ -166,11 +254,61 @@ public:
      */
     bool compact();
     
+    /**
+     * @brief 删除指定时间之前的数据
+     * @param before_timestamp 早于此时间戳的数据不再可见
+     * @return 随整个 SSTable 文件删除的记录数
+     * 
+     * 实现：LSM-Tree 中只含过期数据的文件直接 unlink，代价 O(文件数)；
+     * 其余过期记录（MemTable 或跨越截止时间的文件中）在查询时被过滤
+     */
+    size_t dropBefore(int64_t before_timestamp);
+    
     /**
      * @brief 清空所有数据
      */
     void clear();
     
+    /**
+     * @brief 创建 checkpoint
+     * @param dir checkpoint 目录（不存在则创建），不能已含 checkpoint
+     * @return 是否成功；无 LSM-Tree（data_dir 为空）的表返回 false
+     * 
+     * 先 flush MemTable，再把 LSM-Tree 的 SSTable 硬链接到 dir 并写入 MANIFEST。
+     * SSTable 写入后不再修改，因此无需复制数据，耗时与文件数成正比
+     */
+    bool createCheckpoint(const std::string& dir);
+    
+    /**
+     * @brief 恢复到 createCheckpoint 创建的 checkpoint
+     * @param dir checkpoint 目录，恢复后仍可再次使用
+     * @return 是否成功
+     * 
+     * 丢弃 MemTable 与当前 SSTable，链接回 checkpoint 中的文件。
+     * 与重新打开表一样，内存索引和统计计数从零开始
+     */
+    bool restoreCheckpoint(const std::string& dir);
+    
+    // ========== 写入监听 ==========
+    
+    /**
+     * @brief 写入监听器：每次 insert/insertBatch 落入 MemTable 后调用
+     * 
+     * 在写入线程上、表锁之外调用，可能被多个写入线程并发调用
+     */
+    using InsertListener = std::function<void(const TimeSeriesData* data, size_t count)>;
+    
+    /**
+     * @brief 注册写入监听器（如增量维护的 rollup）
+     * @return 监听器 ID，用于 removeInsertListener
+     */
+    uint64_t addInsertListener(InsertListener listener);
+    
+    /**
+     * @brief 注销写入监听器（进行中的回调仍会完成）
+     */
+    void removeInsertListener(uint64_t id);
+    
     // ========== 统计信息 ==========
     
     /**
@@ -180,6 +318,7 @@ public:
         std::string name;                // 表名
         size_t total_records;            // 总记录数
         size_t memtable_records;         // MemTable 记录数
+        size_t memtable_bytes;           // MemTable 内存占用（含 flush 队列）
         size_t lsm_levels;               // LSM-Tree 层数
         size_t disk_size_bytes;          // 磁盘占用
         int64_t min_timestamp;           // 最早时间戳
@@ -187,6 +326,11 @@ public:
         size_t num_indexes;              // 索引数量
         double write_throughput;         // 写入吞吐量 (records/sec)
         double query_latency_ms;         // 平均查询延迟 (ms)
+        size_t flush_queue_depth;        // 等待 flush 的 MemTable 数
+        uint64_t flush_count;            // 已完成的 flush 次数
+        uint64_t write_stalls;           // 因 flush 队列已满而阻塞的切换次数
+        double last_flush_ms;            // 最近一次 flush 耗时 (ms)
+        double avg_flush_ms;             // 平均 flush 耗时 (ms)
     };
     
     Stats getStats() const;
@@ -211,33 +355,96 @@ private:
     TableConfig config_;                            // 表配置 (forward declared above)
     
     // LSM-Tree 存储引擎
-    std::unique_ptr<MemTable> memtable_;           // 当前活跃的 MemTable
-    std::unique_ptr<MemTable> immutable_memtable_; // 正在 flush 的 MemTable
+    // MemTable 组合：整体替换，不原地修改；读者持有的旧组合在其释放后才销毁
+    struct MemTableSet {
+        std::shared_ptr<MemTable> active;          // 当前活跃的 MemTable
+        std::vector<std::shared_ptr<MemTable>> immutables; // flush 队列，新到旧
+    };
+    std::atomic<std::shared_ptr<const MemTableSet>> memtables_;
     std::unique_ptr<LSMTree> lsm_tree_;            // LSM-Tree（Level 0-N）
     
     // 索引
+    std::shared_ptr<SeriesCatalog> series_catalog_; // 各索引共用的序列字典
     std::unique_ptr<TimeSeriesIndex> index_;       // 时间戳索引
     std::unordered_map<std::string, 
                       std::unique_ptr<TimeSeriesIndex>> tag_indexes_; // 标签索引
     
+    // 最新值缓存（写入路径更新）；warm_mutex_ 保证只回填一次
+    std::unique_ptr<LastValueCache> latest_cache_;
+    mutable std::mutex warm_mutex_;
+    
+    // 写入监听器：写时复制，写入路径无锁读取
+    using InsertListeners = std::vector<std::pair<uint64_t, InsertListener>>;
+    std::atomic<std::shared_ptr<const InsertListeners>> insert_listeners_;
+    std::mutex listeners_mutex_;                    // 串行化监听器的增删
+    uint64_t next_listener_id_ = 1;
+    
+    // 保留截止时间：早于它的数据对查询不可见
+    std::atomic<int64_t> retention_cutoff_{std::numeric_limits<int64_t>::min()};
+    
     // 窗口映射（可选，由 WindowScheduler 管理）
     mutable std::unordered_map<uint64_t, TimeRange> window_ranges_;
     
-    // 统计信息
+    // 写入计数（写者并发更新，查询无锁读取）
+    std::atomic<size_t> total_records_{0};
+    mutable std::atomic<size_t> memtable_records_{0};   // updateStats() 按 MemTable 校正
+    std::atomic<int64_t> min_timestamp_{std::numeric_limits<int64_t>::max()};
+    std::atomic<int64_t> max_timestamp_{std::numeric_limits<int64_t>::min()};
+    
+    // 延迟直方图（微秒，无锁记录）与写入阻塞计数
+    mutable LatencyHistogram query_latency_;
+    LatencyHistogram flush_latency_;
+    Counter write_stalls_;
+    std::vector<MetricsRegistry::Handle> metric_handles_;  // 析构时最先注销
+    
+    // 其余统计信息，受 stats_mutex_ 保护
     mutable Stats stats_;
     mutable std::chrono::steady_clock::time_point last_stats_update_;
+    mutable std::mutex stats_mutex_;
+    
+    // 线程安全：写入共享持有 mutex_（MemTable 与索引自身支持并发写入），
+    // 切换 MemTable、clear、增删索引时独占持有；查询不加锁
+    mutable std::shared_mutex mutex_;
+    std::mutex flush_mutex_;                        // 持有期间写入一个 MemTable；clear() 据此等待
+    
+    // 后台 flush 线程（仅有 LSM-Tree 时启动）：queue_cv_ 在队列变化时通知
+    std::thread flush_thread_;
+    std::mutex queue_mutex_;
+    std::condition_variable queue_cv_;
+    std::atomic<bool> flush_running_{false};
+    std::atomic<bool> flush_failed_{false};         // 最近一次 flush 失败，稍后重试
     
-    // 线程安全
-    mutable std::shared_mutex mutex_;              // 读写锁
-    std::mutex flush_mutex_;                        // flush 操作锁
+    // 全局内存预算（仅有 LSM-Tree 时参与，否则 MemTable 无法释放）
+    std::shared_ptr<WriteBufferManager> write_buffer_;
+    uint64_t write_buffer_client_ = 0;
+    std::atomic<std::chrono::steady_clock::rep> active_since_{0}; // 当前 MemTable 的创建时间
     
     // 内部辅助方法
     void maybeFlush();                             // 检查是否需要 flush
-    void doFlush();                                // 执行 flush
+    void rotateMemTable(const std::shared_ptr<MemTable>& full); // 把 full 换入 flush 队列（若仍为 active）
+    void flushLoop();                              // 后台 flush 线程主循环
+    void dropInMemoryState(bool empty);            // 丢弃 MemTable、索引与计数；调用方持有 mutex_
+    bool flushOldest();                            // 把队列中最旧的 MemTable 写入 LSM-Tree
+    void notifyQueue();                            // 队列变化后唤醒等待者
+    void notifyInsert(const TimeSeriesData* data, size_t count) const; // 调用写入监听器
+    void checkValue(const TimeSeriesData& data) const;  // scalar_values 表拒绝数组值
+    // insertBatch 的实现：Batch 为 const 时复制，否则移动数据点
+    template <typename Batch>
+    std::vector<size_t> insertPoints(Batch& data_list);
+    size_t ingestPoints(std::vector<TimeSeriesData>& points); // importFile 的一批：排序去重后写入 SSTable
+    void warmLatestCache() const;                  // 冷缓存：扫描可见数据回填
+    void scanInto(LastValueCache& cache) const;     // 把全部可见数据送入 cache
+    bool requestFlush();                           // WriteBufferManager 回调：队列有空位时切换 active
     void updateStats() const;                      // 更新统计信息
-    std::vector<TimeSeriesData> mergeQueryResults(
-        const std::vector<TimeSeriesData>& mem_results,
-        const std::vector<TimeSeriesData>& lsm_results) const;
+    void registerMetrics();                        // 把表与 LSM-Tree 的指标注册到 metrics_registry
+    int64_t visibleFrom() const;                   // 考虑 dropBefore 与 TTL 后最早可见的时间戳
+    void publishMemTables(std::shared_ptr<MemTable> active,
+                          std::vector<std::shared_ptr<MemTable>> immutables);  // 发布新的 MemTable 组合
+    // 按时间戳有序访问 range 内匹配 filter_tags 的数据：MemTable 快照与
+    // LSM-Tree 归并，同一 (timestamp, tags) 只交出最新来源的版本
+    void scanRange(const TimeRange& range, const Tags& filter_tags,
+                   const std::function<void(const TimeSeriesData& data,
+                                            const Tags& tags)>& visit) const;
 };
 
 } // namespace sage_tsdb
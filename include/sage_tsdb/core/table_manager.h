@@ -2,6 +2,8 @@
 
 #include "stream_table.h"
 #include "join_result_table.h"
+#include "resource_manager.h"
+#include "rollup.h"
 #include <memory>
 #include <string>
 #include <unordered_map>
@@ -34,11 +36,18 @@ public:
         ComputeState   // 计算状态表（用于持久化 PECJ 状态）
     };
     
+    static constexpr size_t kDefaultBlockCacheBytes = 256 * 1024 * 1024;  // 256MB
+    
     /**
      * @brief 构造函数
      * @param base_data_dir 数据根目录
+     * @param block_cache_bytes 所有表共享的块缓存容量（0 表示禁用）
+     * @param flush_policy 全局内存超过软限制时挑选 MemTable 的策略
      */
-    explicit TableManager(const std::string& base_data_dir = "");
+    explicit TableManager(const std::string& base_data_dir = "",
+                          size_t block_cache_bytes = kDefaultBlockCacheBytes,
+                          WriteBufferManager::FlushPolicy flush_policy =
+                              WriteBufferManager::FlushPolicy::Largest);
     
     ~TableManager();
     
@@ -76,6 +85,28 @@ public:
      */
     bool createPECJTables(const std::string& prefix = "");
     
+    /**
+     * @brief 创建持续 rollup（降采样）
+     * @param rollup rollup 定义；rollup.name 同时是存储桶的 Stream 表名
+     * @param config 存储表配置
+     * @return 是否创建成功（源表须为已存在的 Stream 表，名称不可重复）
+     * 
+     * 创建时回填源表已有数据，之后随源表写入增量更新；
+     * 应在写入开始前定义，回填期间并发写入的数据可能被计入两次。
+     * 删除源表或存储表时 rollup 随之停止维护
+     */
+    bool createRollup(const RollupConfig& rollup, const TableConfig& config = TableConfig{});
+    
+    /**
+     * @brief 获取 rollup（不存在返回 nullptr）
+     */
+    std::shared_ptr<Rollup> getRollup(const std::string& name) const;
+    
+    /**
+     * @brief 列出源表的所有 rollup
+     */
+    std::vector<std::string> listRollups(const std::string& source_table) const;
+    
     // ========== 表访问接口 ==========
     
     /**
@@ -101,6 +132,19 @@ public:
      */
     bool hasTable(const std::string& name) const;
     
+    /**
+     * @brief 查询 Stream 表，聚合查询由规划器自动选用 rollup
+     * @param name 表名（不存在或不是 Stream 表时抛出异常）
+     * @param config 查询配置
+     * @return 非聚合查询返回原始数据；聚合查询每个 (窗口, 分组) 一条，
+     *         按窗口起点、分组标签排序，tags 为 filter_tags 加分组值
+     * 
+     * 规划：在能回答该查询的 rollup 中选桶宽最大者（见 Rollup::canAnswer），
+     * 对齐到桶边界的中间部分读 rollup，两端不足一个桶的部分读源表；
+     * 没有可用的 rollup 时全部读源表
+     */
+    std::vector<TimeSeriesData> query(const std::string& name, const QueryConfig& config) const;
+    
     /**
      * @brief 获取表类型
      * @param name 表名
@@ -151,25 +195,63 @@ public:
      */
     size_t getTableCount() const;
     
+    // ========== 写入监听 ==========
+    
+    /**
+     * @brief 所有 Stream 表的写入监听器：回调多一个表名参数，其余同
+     *        StreamTable::InsertListener
+     */
+    using TableInsertListener = std::function<void(const std::string& table,
+                                                   const TimeSeriesData* data, size_t count)>;
+    
+    /**
+     * @brief 在每张 Stream 表（含 rollup 存储表）上注册写入监听器
+     * @return 监听器 ID，用于 removeTableInsertListener
+     * 
+     * 之后创建的表在对外可见之前挂上监听器，不会漏掉新表的首批写入；
+     * 已有表注册之前的写入不会回调（如复制日志需另行做快照）
+     */
+    uint64_t addTableInsertListener(TableInsertListener listener);
+    
+    /**
+     * @brief 从所有表上注销监听器（进行中的回调仍会完成）
+     */
+    void removeTableInsertListener(uint64_t id);
+    
     // ========== 批量操作 ==========
     
     /**
      * @brief 批量插入数据到多个表
      * @param table_data 表名 → 数据列表的映射
-     * @return 每个表的插入索引
+     * @param errors 可选，输出失败表的错误信息（表不存在、不是 StreamTable 或写入抛出异常）
+     * @return 每个成功表的插入索引
      * 
      * 用途：同时写入 stream_s 和 stream_r
+     * 各表并行写入（见 setWorkerPool），总延迟取决于最慢的表；表锁只在解析表名时持有
      */
     std::map<std::string, std::vector<size_t>> insertBatchToTables(
-        const std::map<std::string, std::vector<TimeSeriesData>>& table_data);
+        const std::map<std::string, std::vector<TimeSeriesData>>& table_data,
+        std::map<std::string, std::string>* errors = nullptr);
     
     /**
      * @brief 批量查询多个表
      * @param queries 表名 → 查询范围的映射
-     * @return 每个表的查询结果
+     * @param errors 可选，输出失败表的错误信息
+     * @return 每个成功表的查询结果
+     * 
+     * 各表并行查询，方式同 insertBatchToTables
      */
     std::map<std::string, std::vector<TimeSeriesData>> queryBatchFromTables(
-        const std::map<std::string, TimeRange>& queries) const;
+        const std::map<std::string, TimeRange>& queries,
+        std::map<std::string, std::string>* errors = nullptr) const;
+    
+    /**
+     * @brief 设置批量多表操作使用的共享线程池
+     * @param pool ResourceManager 分配的句柄（nullptr 表示每次使用临时线程）
+     * 
+     * 调用线程也会参与执行，线程池繁忙时不会阻塞等待
+     */
+    void setWorkerPool(std::shared_ptr<core::ResourceHandle> pool);
     
     // ========== 持久化管理 ==========
     
@@ -193,6 +275,34 @@ public:
      */
     bool enableCheckpoint(const std::string& name, int interval_seconds = 60);
     
+    /**
+     * @brief 为所有 StreamTable 创建一致的 checkpoint
+     * @param checkpoint_id checkpoint 名称，保存在 <数据根目录>/.checkpoints/<checkpoint_id>
+     * @return 是否成功；未设置数据根目录或名称已存在时返回 false
+     * 
+     * 各表 flush 后硬链接其 SSTable（见 StreamTable::createCheckpoint），不复制数据。
+     * 先写入临时目录，全部成功后再改名，不会留下不完整的 checkpoint
+     */
+    bool createCheckpoint(const std::string& checkpoint_id);
+    
+    /**
+     * @brief 把所有 StreamTable 恢复到指定 checkpoint
+     * @return 是否全部恢复成功
+     * 
+     * checkpoint 中没有的表（之后创建的）被清空；checkpoint 中有但当前未创建的表被跳过
+     */
+    bool restoreCheckpoint(const std::string& checkpoint_id);
+    
+    /**
+     * @brief 列出已有的 checkpoint（按名称排序）
+     */
+    std::vector<std::string> listCheckpoints() const;
+    
+    /**
+     * @brief 删除 checkpoint；仍被表引用的 SSTable 因硬链接不受影响
+     */
+    bool deleteCheckpoint(const std::string& checkpoint_id);
+    
     // ========== 统计信息 ==========
     
     /**
@@ -205,6 +315,10 @@ public:
         size_t total_disk_bytes;                   // 总磁盘占用
         double total_write_throughput;             // 总写入吞吐量
         std::map<std::string, size_t> table_sizes; // 每个表的大小
+        BlockCache::Stats block_cache;             // 共享块缓存统计
+        size_t write_buffer_bytes;                 // 全局内存预算中的 MemTable 占用
+        uint64_t write_buffer_flushes;             // 因软限制触发的 MemTable 切换次数
+        uint64_t write_buffer_stalls;              // 因硬限制阻塞的写入次数
     };
     
     GlobalStats getGlobalStats() const;
@@ -228,16 +342,43 @@ public:
     
     /**
      * @brief 设置全局内存限制
-     * @param max_memory_bytes 最大内存（字节）
+     * @param max_memory_bytes 所有 StreamTable 的 MemTable 共享的预算（字节，0 表示不限制）
      * 
-     * 超过限制时自动触发 flush
+     * 超过软限制（90%）时按策略切换最大/最旧的 MemTable 进入 flush，
+     * 达到限制时 insert 阻塞直到 flush 释放内存
      */
     void setGlobalMemoryLimit(size_t max_memory_bytes);
     
     /**
-     * @brief 获取当前内存使用
+     * @brief 获取当前内存使用（所有表的 MemTable，含 flush 队列）
      */
     size_t getCurrentMemoryUsage() const;
+    
+    /**
+     * @brief 获取共享的 MemTable 内存预算，可交给 core::ResourceManager 参与压力判断
+     */
+    std::shared_ptr<WriteBufferManager> getWriteBufferManager() const { return write_buffer_; }
+    
+    /**
+     * @brief 获取共享块缓存（禁用时返回 nullptr）
+     */
+    std::shared_ptr<BlockCache> getBlockCache() const { return block_cache_; }
+    
+    // ========== 监控 ==========
+    
+    /**
+     * @brief 获取指标注册表
+     * 
+     * 各 StreamTable（及其 LSM-Tree）以 table=<表名> 标签注册，全局内存预算
+     * 注册为 sage_tsdb_write_buffer_*；WindowScheduler、IngestServer 等组件
+     * 也注册到这里。抓取只读原子量，不阻塞写入与查询。
+     */
+    std::shared_ptr<MetricsRegistry> getMetricsRegistry() const { return metrics_; }
+    
+    /**
+     * @brief 以 Prometheus 文本格式导出全部指标
+     */
+    std::string exportMetrics() const { return metrics_->exportPrometheus(); }
 
 private:
     // 内部表元数据
@@ -261,11 +402,54 @@ private:
     // 全局配置
     size_t global_memory_limit_;                   // 全局内存限制
     
+    // 所有表共享的 SSTable 块缓存
+    std::shared_ptr<BlockCache> block_cache_;
+    
+    // 所有表共享的 MemTable 内存预算（未设置限制时只做统计）
+    std::shared_ptr<WriteBufferManager> write_buffer_;
+    
+    // 指标注册表（注入各表）及本管理器自身指标的注册句柄
+    std::shared_ptr<MetricsRegistry> metrics_;
+    std::vector<MetricsRegistry::Handle> metric_handles_;
+    
+    // 批量多表操作的共享线程池（可选）
+    std::shared_ptr<core::ResourceHandle> worker_pool_;
+    
+    // rollup 名 → rollup 及其在源表上的写入监听器
+    struct RollupEntry {
+        std::shared_ptr<Rollup> rollup;
+        uint64_t listener_id;
+    };
+    std::map<std::string, RollupEntry> rollups_;
+    
+    // 管理器级写入监听器及其在各表上的 StreamTable 监听器 ID
+    struct TableListenerEntry {
+        TableInsertListener listener;
+        std::map<std::string, uint64_t> table_ids;  // 表名 → 监听器 ID
+    };
+    std::map<uint64_t, TableListenerEntry> table_listeners_;
+    uint64_t next_table_listener_id_ = 1;
+    
     // 线程安全
     mutable std::shared_mutex mutex_;
     
+    // 批量操作中解析出的表（失败时 table 为空，error 为原因）
+    struct ResolvedTable {
+        std::shared_ptr<StreamTable> table;
+        std::string error;
+    };
+    
     // 内部辅助方法
     std::string getTableDataDir(const std::string& name) const;
+    std::string getCheckpointDir(const std::string& checkpoint_id) const;
+    TableConfig prepareConfig(const std::string& name, const TableConfig& config) const;
+    void detachRollup(const RollupEntry& entry);    // 调用者持有 mutex_
+    // 把管理器级监听器挂到新表上，调用者持有 mutex_
+    void attachTableListeners(const std::string& name, StreamTable& table);
+    std::vector<ResolvedTable> resolveStreamTables(const std::vector<std::string>& names,
+                                                   std::shared_ptr<core::ResourceHandle>& pool) const;
+    template <typename Fn>
+    static void runFanOut(size_t count, const std::shared_ptr<core::ResourceHandle>& pool, Fn&& fn);
     void checkMemoryLimit();
     void updateGlobalStats() const;
     
@@ -1,10 +1,13 @@
 #pragma once
 
 #include <cctype>
+#include <concepts>
 #include <cstdint>
+#include <iosfwd>
 #include <map>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <variant>
 #include <vector>
 
@@ -22,10 +25,80 @@ using TimeSeriesValue = std::variant<double, std::vector<double>>;
  */
 using Tags = std::map<std::string, std::string>;
 
+/**
+ * @brief Typed value of a field: int64, double, bool or string
+ *
+ * Numbers are kept and stored in native binary, so numeric fields are not
+ * formatted and parsed on every write and read. Any integral type is stored
+ * as int64 (uint64 values above INT64_MAX wrap; as_uint64() undoes that).
+ *
+ * The as_*() accessors convert between the types, parsing strings, so data
+ * written as text before fields were typed reads the same; to_string() is
+ * the compatibility accessor for code that wants text.
+ */
+class FieldValue {
+public:
+    enum class Type : uint8_t { INT64 = 0, DOUBLE = 1, BOOL = 2, STRING = 3 };
+
+    FieldValue() : value_(std::string()) {}
+    template <std::integral T>
+        requires(!std::same_as<T, bool>)
+    FieldValue(T value) : value_(static_cast<int64_t>(value)) {}
+    FieldValue(double value) : value_(value) {}
+    FieldValue(float value) : value_(static_cast<double>(value)) {}
+    FieldValue(bool value) : value_(value) {}
+    FieldValue(std::string value) : value_(std::move(value)) {}
+    FieldValue(std::string_view value) : value_(std::string(value)) {}
+    FieldValue(const char* value) : value_(std::string(value)) {}
+
+    Type type() const { return static_cast<Type>(value_.index()); }
+    bool is_int64() const { return type() == Type::INT64; }
+    bool is_double() const { return type() == Type::DOUBLE; }
+    bool is_bool() const { return type() == Type::BOOL; }
+    bool is_string() const { return type() == Type::STRING; }
+
+    // Conversions; strings are parsed, 0 / false if they are not numbers
+    int64_t as_int64() const;
+    uint64_t as_uint64() const;
+    double as_double() const;
+    bool as_bool() const;     // Strings: "true" or "1"
+
+    // Text form (shortest round-trip form for doubles, "true"/"false")
+    std::string to_string() const;
+    // The string without a copy, or nullptr if the value is not a string
+    const std::string* if_string() const { return std::get_if<std::string>(&value_); }
+
+    // Payload bytes: 8 for numbers, 1 for bools, the length of strings
+    size_t byte_size() const;
+
+    /**
+     * @brief Binary form: u8 type, then the raw int64 / double, one byte for
+     * a bool or a u32 length and the bytes of a string
+     */
+    void serialize(std::vector<uint8_t>& out) const;
+    bool deserialize(const uint8_t*& ptr, const uint8_t* end);
+
+    bool operator==(const FieldValue& other) const = default;
+    // Strict weak order for use as (part of) a map key; doubles by bits
+    bool operator<(const FieldValue& other) const;
+
+private:
+    std::variant<int64_t, double, bool, std::string> value_;
+};
+
+std::ostream& operator<<(std::ostream& out, const FieldValue& value);
+
 /**
  * @brief Fields for additional metadata
  */
-using Fields = std::map<std::string, std::string>;
+using Fields = std::map<std::string, FieldValue>;
+
+/**
+ * @brief Binary form of fields: u32 count, then per field a u32 key length,
+ * the key and FieldValue::serialize()
+ */
+void serialize_fields(const Fields& fields, std::vector<uint8_t>& out);
+bool deserialize_fields(const uint8_t*& ptr, const uint8_t* end, Fields& fields);
 
 /**
  * @brief Time series data point
@@ -79,6 +152,16 @@ struct TimeSeriesData {
     bool is_array() const {
         return std::holds_alternative<std::vector<double>>(value);
     }
+    
+    /**
+     * @brief Identity of the series this point belongs to (hash of tags)
+     */
+    uint64_t series_id() const { return hash_tags(tags); }
+    
+    /**
+     * @brief 64-bit FNV-1a hash over the sorted tag pairs
+     */
+    static uint64_t hash_tags(const Tags& tags);
 };
 
 /**
@@ -114,7 +197,9 @@ enum class AggregationType {
     COUNT = 4,
     FIRST = 5,
     LAST = 6,
-    STDDEV = 7
+    STDDEV = 7,
+    QUANTILE = 8,   // QueryConfig::quantile of the values (t-digest estimate)
+    DISTINCT = 9    // Number of distinct values (HyperLogLog estimate)
 };
 
 /**
@@ -126,6 +211,10 @@ struct QueryConfig {
     AggregationType aggregation = AggregationType::NONE;
     int64_t window_size = 0;  // milliseconds, 0 means no windowing
     int32_t limit = 1000;     // default limit
+    double quantile = 0.5;    // q of QUANTILE, in [0, 1] (0.99 for p99)
+    // With an aggregation: tag keys to group by, one result per window and
+    // distinct combination of their values (missing tags count as a value)
+    std::vector<std::string> group_by;
     
     QueryConfig() = default;
     
@@ -149,6 +238,8 @@ inline std::string aggregation_to_string(AggregationType type) {
         case AggregationType::FIRST: return "first";
         case AggregationType::LAST: return "last";
         case AggregationType::STDDEV: return "stddev";
+        case AggregationType::QUANTILE: return "quantile";
+        case AggregationType::DISTINCT: return "distinct";
         case AggregationType::NONE: return "none";
         default: return "unknown";
     }
@@ -172,6 +263,8 @@ inline AggregationType string_to_aggregation(const std::string& str) {
     if (lower == "first") return AggregationType::FIRST;
     if (lower == "last") return AggregationType::LAST;
     if (lower == "stddev") return AggregationType::STDDEV;
+    if (lower == "quantile") return AggregationType::QUANTILE;
+    if (lower == "distinct") return AggregationType::DISTINCT;
     if (lower == "none") return AggregationType::NONE;
     
     throw std::invalid_argument("Unknown aggregation type: " + str);
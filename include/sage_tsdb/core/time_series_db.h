@@ -1,6 +1,7 @@
 #pragma once
 
 #include "time_series_data.h"
+#include "sharded_table.h"
 #include "time_series_index.h"
 #include <memory>
 #include <string>
@@ -52,6 +53,17 @@ public:
      */
     bool createTable(const std::string& name, TableType type = TableType::TimeSeries);
     
+    /**
+     * @brief Create a table hash-partitioned across config.num_shards shards
+     * @param name Table name
+     * @param config Shard count, shard key tags and optional per-shard storage
+     * @return true if created successfully, false if already exists
+     * 
+     * insert/insertBatch/query work on it like on any other table;
+     * insertBatch writes the shards in parallel.
+     */
+    bool createShardedTable(const std::string& name, const ShardedTableConfig& config);
+    
     /**
      * @brief Drop a table
      * @param name Table name
@@ -118,6 +130,32 @@ public:
                                        const TimeRange& time_range,
                                        const Tags& filter_tags = {}) const;
     
+    /**
+     * @brief Query a specific table without copying the matching points
+     * @param table_name Source table name
+     * @param config Query configuration
+     * @return View of the points query() would return; it pins what it
+     *         reads and stays valid however the table changes after
+     * 
+     * Example:
+     *   for (auto point : db.query_view("stream_s", config)) {
+     *       use(point.timestamp(), point.as_double(), point.tags());
+     *   }
+     */
+    TimeSeriesIndex::ResultView query_view(const std::string& table_name,
+                                           const QueryConfig& config) const;
+    
+    /**
+     * @brief Query a specific table with time range without copying
+     * @param table_name Source table name
+     * @param time_range Time range for query
+     * @param filter_tags Optional tags to filter by
+     * @return View of the matching data points
+     */
+    TimeSeriesIndex::ResultView query_view(const std::string& table_name,
+                                           const TimeRange& time_range,
+                                           const Tags& filter_tags = {}) const;
+    
     // ========== Default Table API (backward compatible) ==========
     
     /**
@@ -158,6 +196,19 @@ public:
      */
     std::vector<size_t> add_batch(const std::vector<TimeSeriesData>& data_list);
     
+    /**
+     * @brief Add scalar points of one series given as columns
+     * @param timestamps Timestamp of each point
+     * @param values Value of each point
+     * @param count Number of points
+     * @param tags Tags shared by every point
+     * @return Index of the first added point
+     * 
+     * No TimeSeriesData is built per point; see TimeSeriesIndex::add_columns.
+     */
+    size_t add_columns(const int64_t* timestamps, const double* values, size_t count,
+                       const Tags& tags = {});
+    
     /**
      * @brief Query time series data
      * @param config Query configuration
@@ -174,6 +225,13 @@ public:
     std::vector<TimeSeriesData> query(const TimeRange& time_range,
                                        const Tags& filter_tags = {}) const;
     
+    /**
+     * @brief Query the default table without copying the matching points
+     * @param config Query configuration
+     * @return View of the matching data points
+     */
+    TimeSeriesIndex::ResultView query_view(const QueryConfig& config) const;
+    
     /**
      * @brief Register an algorithm
      * @param name Algorithm name
@@ -232,6 +290,10 @@ public:
      * @brief Save all data to disk
      * @param file_path Path to save file
      * @return true if successful
+     *
+     * Writes a chunked snapshot (see SnapshotWriter) from a view of the
+     * index, one chunk at a time; concurrent writers are not blocked and
+     * are not part of the snapshot.
      */
     bool save_to_disk(const std::string& file_path);
     
@@ -240,9 +302,19 @@ public:
      * @param file_path Path to load file
      * @param clear_existing If true, clears existing data before loading
      * @return true if successful
+     *
+     * Snapshot chunks are decoded in parallel and moved into the index in
+     * file order. Chunks before a corrupt one stay loaded.
      */
     bool load_from_disk(const std::string& file_path, bool clear_existing = true);
     
+    /**
+     * @brief Query persisted data without loading it into memory
+     * @param config Query configuration; config.limit bounds the scan (0 = no limit)
+     * @return Matching points in timestamp order
+     */
+    std::vector<TimeSeriesData> query_from_disk(const QueryConfig& config) const;
+    
     /**
      * @brief Create a checkpoint of current data
      * @param checkpoint_id Checkpoint identifier
@@ -312,12 +384,18 @@ public:
     void setResourceManager(std::shared_ptr<ResourceManager> resource_manager);
 
 private:
+    // Series dictionary shared by every table's index
+    std::shared_ptr<SeriesCatalog> series_catalog_;
+    
     // Core index (default table)
     std::unique_ptr<TimeSeriesIndex> index_;
     
     // Multi-table storage: table_name -> index
     std::unordered_map<std::string, std::unique_ptr<TimeSeriesIndex>> tables_;
     
+    // Sharded tables; names are unique across tables_ and sharded_tables_
+    std::unordered_map<std::string, std::unique_ptr<ShardedTable>> sharded_tables_;
+    
     // Table type metadata: table_name -> type
     std::unordered_map<std::string, TableType> table_types_;
     
@@ -337,6 +415,7 @@ private:
     // Helper: Get or create table index
     TimeSeriesIndex* getTableIndex(const std::string& table_name);
     const TimeSeriesIndex* getTableIndex(const std::string& table_name) const;
+    ShardedTable* getShardedTable(const std::string& table_name) const;
 };
 
 } // namespace sage_tsdb
@@ -1,107 +1,389 @@
 #pragma once
 
+#include "aggregation.h"
+#include "roaring_bitmap.h"
+#include "series_catalog.h"
 #include "time_series_data.h"
 #include <algorithm>
+#include <atomic>
 #include <memory>
-#include <shared_mutex>
+#include <mutex>
+#include <span>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace sage_tsdb {
 
 /**
  * @brief Index structure for efficient time series queries
- * 
+ *
  * Provides:
  * - Fast binary search by timestamp
- * - Tag-based indexing for filtering
- * - Automatic sorting for out-of-order data
- * - Thread-safe operations with read-write locks
+ * - The main run is stored column-wise in chunks of kChunkRows rows:
+ *   timestamps, values, series ids and sort keys in contiguous arrays,
+ *   with vector values and fields (which most points lack) kept aside in
+ *   a side column that a chunk only has once one of its rows needs it.
+ *   Chunks of plain scalars are nothing but the four raw columns and are
+ *   copied with bulk column copies. Rows carry a SeriesCatalog id
+ *   instead of their tag map; tags are looked up again only for the
+ *   points a query returns
+ * - A scalar index (scalar_values) rejects vector values outright
+ * - Tag-based indexing for filtering: a full chunk is sealed with a
+ *   RoaringBitmap of its rows per (key, value) pair; filters intersect the
+ *   postings and AND the result with the rows of the time range. The
+ *   chunk still filling is filtered by its series ids
+ * - Out-of-order points go to a small sorted delta buffer; queries merge
+ *   it with the main run on the fly, and once it holds
+ *   kDeltaMergeThreshold points it is merged into the main run by
+ *   rewriting only the chunks from its earliest point on
+ * - Queries with an aggregation are answered from the columns in one
+ *   pass without materializing points: per window (config.window_size,
+ *   aligned to multiples of it; the whole range when 0) and per group of
+ *   config.group_by values. Unfiltered, ungrouped runs of rows are
+ *   scanned by column_kernels; otherwise the selected rows feed a
+ *   WindowedAggregator specialized for the aggregation type
+ * - Lock-free reads (read-copy-update): readers pin the current Version,
+ *   an immutable chunk list plus the delta buffer, and see the rows its
+ *   last chunk had published at that moment. Writers are serialized by a
+ *   mutex; an append fills the next slot of the last chunk and then
+ *   publishes it by bumping the chunk's size, and every other change (a
+ *   new or grown chunk, a late point, a merge) builds a new Version and
+ *   swaps it in atomically. Replaced chunks live on until the last reader
+ *   holding them lets go
+ * - query_view() hands out that pinned version as a ResultView, so
+ *   callers can read the selected points without copying them
+ *
+ * Rows are ordered by timestamp, then by the numeric "key" tag; points
+ * that compare equal keep their arrival order.
  */
 class TimeSeriesIndex {
 public:
-    TimeSeriesIndex();
+    static constexpr size_t kDeltaMergeThreshold = 1024;
+    static constexpr size_t kChunkRows = 4096;
+
+    /**
+     * @param catalog Series dictionary, possibly shared with other indexes;
+     *                a private one is created when null
+     * @param scalar_values Accept only scalar values; add() throws
+     *                std::invalid_argument for a vector value
+     */
+    explicit TimeSeriesIndex(std::shared_ptr<SeriesCatalog> catalog = nullptr,
+                             bool scalar_values = false);
     ~TimeSeriesIndex() = default;
-    
+
     /**
      * @brief Add a single data point
      * @param data Time series data point
-     * @return Index of added data
+     * @return Number of points added before this one
      */
     size_t add(const TimeSeriesData& data);
-    
+
     /**
      * @brief Add multiple data points
      * @param data_list Vector of time series data
      * @return Vector of indices
      */
     std::vector<size_t> add_batch(const std::vector<TimeSeriesData>& data_list);
-    
+
+    /**
+     * @brief Add multiple data points, moving their values and fields
+     *
+     * Rows are built before the lock is taken once for the whole batch;
+     * data_list is left empty.
+     */
+    std::vector<size_t> add_batch(std::vector<TimeSeriesData>&& data_list);
+
+    /**
+     * @brief Add count scalar points of one series given as columns
+     * @param timestamps Timestamp of each point
+     * @param values Value of each point
+     * @param tags Tags shared by every point
+     * @return Number of points added before the first one
+     *
+     * The tags are interned once and the rows go straight into the
+     * columns, under one lock acquisition for the whole run.
+     */
+    size_t add_columns(const int64_t* timestamps, const double* values, size_t count,
+                       const Tags& tags = {});
+
     /**
      * @brief Query data within time range
      * @param config Query configuration
-     * @return Vector of matching data points
+     * @return Matching data points; with an aggregation, one point per
+     *         non-empty window and group, timestamped with the window start
+     *         and carrying filter_tags plus the group's tags, ordered by
+     *         window then group (first-seen order); limit caps the points
      */
     std::vector<TimeSeriesData> query(const QueryConfig& config) const;
-    
+
+    class ResultView;
+
+    /**
+     * @brief Query without copying the selected points
+     * @param config Query configuration
+     * @return The points query(config) would return, read in place from
+     *         the version the query saw; later writes, merges and clear()
+     *         leave the view unchanged
+     */
+    ResultView query_view(const QueryConfig& config) const;
+
     /**
      * @brief Get data point by index
-     * @param index Data point index
+     * @param index Position in timestamp order
      * @return Time series data
      */
     TimeSeriesData get(size_t index) const;
-    
+
     /**
      * @brief Get number of data points
      */
     size_t size() const;
-    
+
     /**
      * @brief Check if index is empty
      */
     bool empty() const;
-    
+
     /**
      * @brief Clear all data
      */
     void clear();
 
+    const std::shared_ptr<SeriesCatalog>& catalog() const { return catalog_; }
+    bool scalar_values() const { return scalar_values_; }
+
 private:
+    static constexpr size_t kFirstChunkRows = 64;   // Doubled up to kChunkRows
+
+    // A point without its tags, plus what is needed to order and filter it
+    struct Row {
+        TimeSeriesData point;       // tags left empty
+        uint32_t series;            // Id in catalog_
+        uint64_t key;               // Numeric "key" tag, 0 if absent
+    };
+
+    // Parts of a main run point that do not fit the columns
+    struct Extra {
+        std::vector<double> vector_value;   // Whole value of a vector point
+        bool is_vector = false;
+        Fields fields;
+    };
+
+    using Extras = std::unique_ptr<std::shared_ptr<const Extra>[]>;
+
+    // Rows of the main run, one entry per row in every column. Slots below
+    // size never change; postings are complete once sealed is set.
+    struct Chunk {
+        Chunk(size_t capacity, bool with_extras);
+
+        size_t capacity;
+        std::unique_ptr<int64_t[]> timestamps;
+        std::unique_ptr<double[]> values;       // Scalar value, or first element of a vector
+        std::unique_ptr<uint32_t[]> series;     // Catalog ids
+        std::unique_ptr<uint64_t[]> keys;       // Numeric "key" tag
+        // Side column, null entries for plain scalars; the whole column is
+        // null while every row is one. Set before the chunk is published.
+        Extras extras;
+        std::atomic<size_t> size{0};            // Published rows
+
+        const Extra* extra(size_t row) const { return extras ? extras[row].get() : nullptr; }
+
+        // Tag index of the chunk's rows: tag_key -> {tag_value -> rows}
+        std::map<std::string, std::map<std::string, RoaringBitmap>> postings;
+        std::atomic<bool> sealed{false};
+    };
+
+    using Chunks = std::vector<std::shared_ptr<Chunk>>;
+
+    // Every chunk but the last is full and sealed, so main run row i is
+    // row i % kChunkRows of chunk i / kChunkRows
+    struct Version {
+        std::shared_ptr<const Chunks> chunks;
+        std::vector<std::shared_ptr<const Row>> delta;  // Late points, sorted by row_less
+    };
+
+    // What a reader works on: a pinned version and the rows its last
+    // chunk had published
+    struct View {
+        std::shared_ptr<const Version> version;
+        size_t last_size = 0;
+
+        const Chunks& chunks() const { return *version->chunks; }
+        size_t chunk_size(size_t c) const {
+            return c + 1 == chunks().size() ? last_size : kChunkRows;
+        }
+        size_t main_rows() const {
+            return chunks().empty() ? 0 : (chunks().size() - 1) * kChunkRows + last_size;
+        }
+        const std::vector<std::shared_ptr<const Row>>& delta() const { return version->delta; }
+        int64_t timestamp(size_t row) const {
+            return chunks()[row / kChunkRows]->timestamps[row % kChunkRows];
+        }
+        uint64_t key(size_t row) const {
+            return chunks()[row / kChunkRows]->keys[row % kChunkRows];
+        }
+    };
+
+    // Rows [lo, hi) of one chunk
+    struct Slice {
+        size_t chunk;
+        size_t lo;
+        size_t hi;
+    };
+
+    // Main run row as (chunk, row in chunk)
+    struct RowRef {
+        uint32_t chunk;
+        uint32_t row;
+    };
+
+    View snapshot() const;
+    // Install version; write_mutex_ held
+    void publish(std::shared_ptr<const Version> version);
+
+    // Row order: timestamp, then numeric "key" tag
+    static bool row_less(const Row& a, const Row& b);
+    // Main run rows of view ordered at or before row
+    static size_t main_upper_bound(const View& view, const Row& row);
+    // Non-empty runs of main run rows with timestamps in range, in order
+    static std::vector<Slice> time_slices(const View& view, const TimeRange& range);
+    // Rows of slice carrying every tag, appended to out in order
+    void filter_slice(const View& view, const Slice& slice, const Tags& tags,
+                      std::unordered_map<uint32_t, bool>& memo,
+                      std::vector<RowRef>& out, size_t limit) const;
+
+    // Point of a delta or main row with its tags restored
+    TimeSeriesData resolve(const Row& row) const;
+    TimeSeriesData resolve_main(const Chunk& chunk, size_t row) const;
+
+    // Rows a query without aggregation selects, in order
+    ResultView select(View view, const QueryConfig& config) const;
+    std::vector<TimeSeriesData> aggregate(const View& view, const QueryConfig& config) const;
+
+    // Writer side, with write_mutex_ held; chunk is not published yet
+    // Whether row fits the columns alone (no vector value, no fields)
+    static bool plain(const Row& row) { return row.point.is_scalar() && row.point.fields.empty(); }
+    static void put_row(Chunk& chunk, size_t slot, Row&& row);
+    // Rows [row, row + n) of from into slots [slot, slot + n) of chunk
+    static void copy_rows(Chunk& chunk, size_t slot, const Chunk& from, size_t row, size_t n);
+    void append_main(Row&& row);
+    // Insert into the main run, or the delta buffer if late; returns the row's index
+    size_t insert_row(Row&& row);
+    void seal(Chunk& chunk) const;
+
     /**
-     * @brief Ensure data is sorted by timestamp
-     */
-    void ensure_sorted();
-    
-    /**
-     * @brief Binary search for timestamp
-     * @param timestamp Target timestamp
-     * @param find_upper If true, find upper bound; else lower bound
-     * @return Index position
-     */
-    size_t binary_search(int64_t timestamp, bool find_upper = false) const;
-    
-    /**
-     * @brief Filter data by tags
-     * @param tags Filter tags
-     * @return Set of matching indices
+     * @brief Merge the delta buffer into the main run
      */
-    std::vector<size_t> filter_by_tags(const Tags& tags) const;
-    
+    void merge_delta();
+
+    // Tag check for rows outside the postings
+    bool matches_tags(uint32_t series, const Tags& tags) const;
+
+    std::shared_ptr<SeriesCatalog> catalog_;
+    bool scalar_values_;
+
+    // Version readers see; replaced as a whole by writers
+    std::atomic<std::shared_ptr<const Version>> version_;
+
+    // Serializes writers; current_ is the writers' copy of version_
+    std::mutex write_mutex_;
+    std::shared_ptr<const Version> current_;
+};
+
+/**
+ * @brief Query result that reads its points in place
+ *
+ * Refers to the main run rows and late points a query selected and pins
+ * the versions holding them, whose rows never change. Point::tags() and
+ * Point::fields() are references into the catalog and the rows; to_data()
+ * copies a point out when one is needed. Aggregated results exist in no
+ * chunk and are owned by the view.
+ *
+ * Valid for as long as it lives, independent of the index; safe to read
+ * from several threads. Move-only.
+ */
+class TimeSeriesIndex::ResultView {
+    struct Entry;
+
+public:
+    class Point {
+    public:
+        int64_t timestamp() const;
+        // Scalar value, or first element of a vector
+        double as_double() const;
+        bool is_vector() const;
+        // Elements of a vector value; a scalar as a single element
+        std::span<const double> values() const;
+        const Tags& tags() const;
+        const Fields& fields() const;
+        // Copy of the point
+        TimeSeriesData to_data() const;
+
+    private:
+        friend class ResultView;
+        Point(const ResultView* view, const Entry* entry) : view_(view), entry_(entry) {}
+
+        const ResultView* view_;
+        const Entry* entry_;
+    };
+
+    class Iterator {
+    public:
+        Point operator*() const { return (*view_)[i_]; }
+        Iterator& operator++() { ++i_; return *this; }
+        bool operator==(const Iterator& other) const { return i_ == other.i_; }
+
+    private:
+        friend class ResultView;
+        Iterator(const ResultView* view, size_t i) : view_(view), i_(i) {}
+
+        const ResultView* view_;
+        size_t i_;
+    };
+
+    ResultView() = default;
+    // View over points already materialized
+    explicit ResultView(std::vector<TimeSeriesData> points);
+
+    ResultView(ResultView&&) = default;
+    ResultView& operator=(ResultView&&) = default;
+    ResultView(const ResultView&) = delete;
+    ResultView& operator=(const ResultView&) = delete;
+
+    size_t size() const { return entries_.size(); }
+    bool empty() const { return entries_.empty(); }
+    Point operator[](size_t i) const { return Point(this, &entries_[i]); }
+    Iterator begin() const { return Iterator(this, 0); }
+    Iterator end() const { return Iterator(this, entries_.size()); }
+
+    // Copies of every point, in order
+    std::vector<TimeSeriesData> materialize() const;
+
+    // Timestamps and scalar values (first element of vectors) of every
+    // point, in order, into arrays of size() elements
+    void copy_columns(int64_t* timestamps, double* values) const;
+
     /**
-     * @brief Rebuild tag index after sorting
+     * @brief Merge views sorted by timestamp, ties in view order
+     * @param views Views of indexes sharing one catalog
+     * @param limit Maximum number of points kept
      */
-    void rebuild_tag_index();
-
-    // Data storage
-    std::vector<TimeSeriesData> data_;
-    
-    // Tag index: tag_key -> {tag_value -> [indices]}
-    std::map<std::string, std::map<std::string, std::vector<size_t>>> tag_index_;
-    
-    // Sorted flag
-    bool sorted_;
-    
-    // Thread safety
-    mutable std::shared_mutex mutex_;
+    static ResultView merge(std::vector<ResultView> views, size_t limit);
+
+private:
+    friend class TimeSeriesIndex;
+
+    struct Entry {
+        const Chunk* chunk;     // Main run row, or null
+        const Row* late;        // Late point, or null
+        uint32_t row;           // Row in chunk, or index in owned_ when both are null
+    };
+
+    std::vector<std::shared_ptr<const Version>> versions_;     // Pin the rows
+    std::shared_ptr<SeriesCatalog> catalog_;
+    std::vector<Entry> entries_;
+    std::vector<TimeSeriesData> owned_;
 };
 
 } // namespace sage_tsdb
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace sage_tsdb {
+
+/**
+ * @brief One completed span, as returned by Tracer::collect()
+ */
+struct TraceEvent {
+    const char* name = "";
+    const char* category = "";
+    int64_t start_ns = 0;        // steady_clock
+    int64_t duration_ns = 0;
+    const char* arg_name = nullptr;  // Optional numeric argument
+    uint64_t arg = 0;
+    uint32_t tid = 0;            // Tracer-assigned thread number
+};
+
+/**
+ * @brief Process-wide span recorder with Chrome trace export
+ *
+ * Each thread records into its own ring buffer, allocated on its first span
+ * while tracing is enabled; a full ring overwrites its oldest spans. A
+ * record is a handful of relaxed stores plus one release store of the head,
+ * with no lock and no allocation. collect() copies every ring and drops the
+ * slots a writer may have overwritten during the copy, so it can run while
+ * threads keep recording.
+ *
+ * Names, categories and argument names must be string literals (or
+ * otherwise outlive the tracer): only the pointers are stored.
+ *
+ * Spans are normally recorded through the SAGE_TSDB_TRACE_* macros below,
+ * which compile to nothing unless SAGE_TSDB_ENABLE_TRACING is defined
+ * (cmake -DENABLE_TRACING=ON). Built with them, tracing still starts
+ * disabled and costs one relaxed load per span until enable(true).
+ */
+class Tracer {
+public:
+    static constexpr size_t kDefaultBufferEvents = 16 * 1024;  // ~768 KB per thread
+
+    static Tracer& instance();
+
+    void enable(bool on) { enabled_.store(on, std::memory_order_relaxed); }
+    bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+    // Ring size of threads that start recording after the call
+    void setBufferEvents(size_t events);
+
+    // Name shown for the calling thread in the exported trace
+    void setThreadName(const std::string& name);
+
+    void record(const char* category, const char* name, int64_t start_ns, int64_t end_ns,
+                const char* arg_name = nullptr, uint64_t arg = 0);
+
+    // Spans still in the rings, ordered by start time
+    std::vector<TraceEvent> collect() const;
+
+    /**
+     * @brief Chrome trace event JSON ("X" complete events plus thread names),
+     * loadable by chrome://tracing and ui.perfetto.dev
+     */
+    void writeChromeTrace(std::ostream& out) const;
+    bool writeChromeTrace(const std::string& path) const;
+
+    // Drop recorded spans, and the rings of threads that have exited
+    void clear();
+
+    static int64_t nowNs();
+
+private:
+    struct Slot {
+        std::atomic<const char*> category{""};
+        std::atomic<const char*> name{""};
+        std::atomic<const char*> arg_name{nullptr};
+        std::atomic<int64_t> start_ns{0};
+        std::atomic<int64_t> duration_ns{0};
+        std::atomic<uint64_t> arg{0};
+    };
+
+    struct ThreadBuffer {
+        explicit ThreadBuffer(size_t events) : slots(events) {}
+
+        std::vector<Slot> slots;
+        std::atomic<uint64_t> head{0};   // Spans ever written; slot = head % size
+        std::atomic<uint64_t> cleared{0};  // head at the last clear()
+        uint32_t tid = 0;
+        std::string thread_name;         // Guarded by the tracer mutex_
+        std::atomic<bool> exited{false};
+    };
+
+    struct ThreadHandle;
+
+    Tracer() = default;
+    ThreadBuffer* local();
+
+    std::atomic<bool> enabled_{false};
+    std::atomic<size_t> buffer_events_{kDefaultBufferEvents};
+
+    mutable std::mutex mutex_;
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers_;
+    uint32_t next_tid_ = 1;
+};
+
+/**
+ * @brief Records [construction, end() or destruction) as one span
+ *
+ * Captures nothing when tracing is disabled at construction.
+ */
+class TraceSpan {
+public:
+    TraceSpan(const char* category, const char* name)
+        : category_(category), name_(name),
+          start_ns_(Tracer::instance().enabled() ? Tracer::nowNs() : 0) {}
+
+    TraceSpan(const char* category, const char* name, const char* arg_name, uint64_t arg)
+        : TraceSpan(category, name) {
+        arg_name_ = arg_name;
+        arg_ = arg;
+    }
+
+    ~TraceSpan() { end(); }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+    void setArg(const char* arg_name, uint64_t arg) {
+        arg_name_ = arg_name;
+        arg_ = arg;
+    }
+
+    void end() {
+        if (start_ns_ != 0) {
+            Tracer::instance().record(category_, name_, start_ns_, Tracer::nowNs(), arg_name_, arg_);
+            start_ns_ = 0;
+        }
+    }
+
+private:
+    const char* category_;
+    const char* name_;
+    int64_t start_ns_;
+    const char* arg_name_ = nullptr;
+    uint64_t arg_ = 0;
+};
+
+} // namespace sage_tsdb
+
+#define SAGE_TSDB_TRACE_CONCAT_INNER(a, b) a##b
+#define SAGE_TSDB_TRACE_CONCAT(a, b) SAGE_TSDB_TRACE_CONCAT_INNER(a, b)
+
+#ifdef SAGE_TSDB_ENABLE_TRACING
+// Span over the rest of the enclosing scope
+#define SAGE_TSDB_TRACE_SCOPE(category, name) \
+    ::sage_tsdb::TraceSpan SAGE_TSDB_TRACE_CONCAT(sage_tsdb_trace_, __LINE__)(category, name)
+#define SAGE_TSDB_TRACE_SCOPE_ARG(category, name, arg_name, arg)                              \
+    ::sage_tsdb::TraceSpan SAGE_TSDB_TRACE_CONCAT(sage_tsdb_trace_, __LINE__)(category, name, \
+                                                                            arg_name, arg)
+// Named span that can be ended before the scope closes
+#define SAGE_TSDB_TRACE_BEGIN(var, category, name) ::sage_tsdb::TraceSpan var(category, name)
+#define SAGE_TSDB_TRACE_END(var) var.end()
+#define SAGE_TSDB_TRACE_SET_ARG(var, arg_name, arg) var.setArg(arg_name, arg)
+// Span between two Tracer::nowNs() timestamps taken elsewhere
+#define SAGE_TSDB_TRACE_RECORD(category, name, start_ns, end_ns, arg_name, arg)                 \
+    do {                                                                                      \
+        if (::sage_tsdb::Tracer::instance().enabled()) {                                      \
+            ::sage_tsdb::Tracer::instance().record(category, name, start_ns, end_ns, arg_name, \
+                                                   arg);                                      \
+        }                                                                                     \
+    } while (0)
+#define SAGE_TSDB_TRACE_NOW() \
+    (::sage_tsdb::Tracer::instance().enabled() ? ::sage_tsdb::Tracer::nowNs() : int64_t{0})
+#else
+#define SAGE_TSDB_TRACE_SCOPE(category, name) ((void)0)
+#define SAGE_TSDB_TRACE_SCOPE_ARG(category, name, arg_name, arg) ((void)0)
+#define SAGE_TSDB_TRACE_BEGIN(var, category, name) ((void)0)
+#define SAGE_TSDB_TRACE_END(var) ((void)0)
+#define SAGE_TSDB_TRACE_SET_ARG(var, arg_name, arg) ((void)0)
+#define SAGE_TSDB_TRACE_RECORD(category, name, start_ns, end_ns, arg_name, arg) ((void)0)
+#define SAGE_TSDB_TRACE_NOW() (int64_t{0})
+#endif
@@ -0,0 +1,392 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace sage_tsdb {
+namespace core {
+
+/**
+ * @brief Move-only void() callable with inline storage
+ *
+ * Callables up to kInlineSize bytes (lambdas with a few captures, a
+ * std::function, a bound member call) are stored in place, so building,
+ * queueing and running a Task does not allocate. Larger callables, or ones
+ * whose move constructor may throw, fall back to a heap copy.
+ */
+class Task {
+public:
+    static constexpr size_t kInlineSize = 48;
+
+    Task() noexcept = default;
+
+    template <typename F,
+              typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, Task>>>
+    Task(F&& fn) {  // NOLINT: implicit like std::function
+        using Fn = std::decay_t<F>;
+        if constexpr (fits_inline<Fn>()) {
+            new (storage_) Fn(std::forward<F>(fn));
+            ops_ = &inline_ops<Fn>;
+        } else {
+            new (storage_) Fn*(new Fn(std::forward<F>(fn)));
+            ops_ = &heap_ops<Fn>;
+        }
+    }
+
+    Task(Task&& other) noexcept : ops_(other.ops_) {
+        if (ops_) {
+            ops_->relocate(storage_, other.storage_);
+            other.ops_ = nullptr;
+        }
+    }
+
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            reset();
+            ops_ = other.ops_;
+            if (ops_) {
+                ops_->relocate(storage_, other.storage_);
+                other.ops_ = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task() { reset(); }
+
+    explicit operator bool() const noexcept { return ops_ != nullptr; }
+
+    void operator()() { ops_->invoke(storage_); }
+
+    void reset() noexcept {
+        if (ops_) {
+            ops_->destroy(storage_);
+            ops_ = nullptr;
+        }
+    }
+
+private:
+    struct Ops {
+        void (*invoke)(void* storage);
+        void (*relocate)(void* dst, void* src) noexcept;  // Move into dst and destroy src
+        void (*destroy)(void* storage) noexcept;
+    };
+
+    template <typename Fn>
+    static constexpr bool fits_inline() {
+        return sizeof(Fn) <= kInlineSize && alignof(Fn) <= alignof(std::max_align_t) &&
+               std::is_nothrow_move_constructible_v<Fn>;
+    }
+
+    template <typename Fn>
+    static constexpr Ops inline_ops = {
+        [](void* storage) { (*static_cast<Fn*>(storage))(); },
+        [](void* dst, void* src) noexcept {
+            new (dst) Fn(std::move(*static_cast<Fn*>(src)));
+            static_cast<Fn*>(src)->~Fn();
+        },
+        [](void* storage) noexcept { static_cast<Fn*>(storage)->~Fn(); },
+    };
+
+    template <typename Fn>
+    static constexpr Ops heap_ops = {
+        [](void* storage) { (**static_cast<Fn**>(storage))(); },
+        [](void* dst, void* src) noexcept { new (dst) Fn*(*static_cast<Fn**>(src)); },
+        [](void* storage) noexcept { delete *static_cast<Fn**>(storage); },
+    };
+
+    alignas(std::max_align_t) unsigned char storage_[kInlineSize];
+    const Ops* ops_ = nullptr;
+};
+
+/**
+ * @brief Fixed-capacity Chase-Lev work-stealing deque of pointers
+ *
+ * The owning thread pushes and pops at the bottom (LIFO, cache-warm);
+ * any other thread steals from the top (FIFO). All operations are
+ * lock-free. push() fails instead of growing when the deque is full, so
+ * no buffer is ever retired while a thief may still read it.
+ *
+ * Follows Lê et al., "Correct and Efficient Work-Stealing for Weak
+ * Memory Models" (PPoPP 2013).
+ */
+template <typename T>
+class WorkStealingDeque {
+public:
+    explicit WorkStealingDeque(size_t capacity = 1024)
+        : mask_(round_up(capacity) - 1), slots_(mask_ + 1) {}
+
+    WorkStealingDeque(const WorkStealingDeque&) = delete;
+    WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+    // Owner only
+    bool push(T* item) {
+        int64_t bottom = bottom_.load(std::memory_order_relaxed);
+        int64_t top = top_.load(std::memory_order_acquire);
+        if (bottom - top > static_cast<int64_t>(mask_)) {
+            return false;
+        }
+        slots_[bottom & mask_].store(item, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom_.store(bottom + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Owner only; nullptr when empty
+    T* pop() {
+        int64_t bottom = bottom_.load(std::memory_order_relaxed) - 1;
+        bottom_.store(bottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t top = top_.load(std::memory_order_relaxed);
+        if (top > bottom) {
+            bottom_.store(bottom + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        T* item = slots_[bottom & mask_].load(std::memory_order_relaxed);
+        if (top == bottom) {
+            // Last item: race a concurrent steal for it
+            if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                              std::memory_order_relaxed)) {
+                item = nullptr;
+            }
+            bottom_.store(bottom + 1, std::memory_order_relaxed);
+        }
+        return item;
+    }
+
+    // Any thread; nullptr when empty or when another thread won the race
+    T* steal() {
+        int64_t top = top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t bottom = bottom_.load(std::memory_order_acquire);
+        if (top >= bottom) {
+            return nullptr;
+        }
+        T* item = slots_[top & mask_].load(std::memory_order_relaxed);
+        if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                          std::memory_order_relaxed)) {
+            return nullptr;
+        }
+        return item;
+    }
+
+    // Approximate when read by a thread other than the owner
+    bool empty() const {
+        return bottom_.load(std::memory_order_relaxed) <= top_.load(std::memory_order_relaxed);
+    }
+
+    size_t capacity() const { return mask_ + 1; }
+
+private:
+    static size_t round_up(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        return size;
+    }
+
+    size_t mask_;
+    alignas(64) std::atomic<int64_t> top_{0};
+    alignas(64) std::atomic<int64_t> bottom_{0};
+    std::vector<std::atomic<T*>> slots_;
+};
+
+class WorkStealingExecutor;
+
+/**
+ * @brief Submission queue of one resource handle on a shared executor
+ *
+ * Carries the handle's scheduling policy: queues are served in priority
+ * order (higher first, round-robin within a priority), and at most
+ * quota() tasks of a queue run at the same time.
+ *
+ * Worker time spent in the queue's tasks is accounted in busy_ns(). With a
+ * CPU limit, that time is also drawn from a token bucket refilled at
+ * cpu_limit() worker-seconds per second and holding at most kCpuBurst of
+ * refill: a task starts only while the bucket is positive, and is charged
+ * once it finishes, so a long task leaves a debt the queue waits out.
+ */
+class TaskQueue {
+public:
+    int priority() const { return priority_.load(std::memory_order_relaxed); }
+    int quota() const { return quota_.load(std::memory_order_relaxed); }
+    // Only workers of this node run the queue's tasks (-1 = unbound workers)
+    int node() const { return node_; }
+
+    // Tasks submitted and not yet started
+    uint64_t pending() const { return pending_.load(std::memory_order_relaxed); }
+    // Tasks currently running
+    uint64_t running() const { return running_.load(std::memory_order_relaxed); }
+
+    static constexpr std::chrono::milliseconds kCpuBurst{100};
+
+    // Worker-seconds per second; negative when unlimited, 0 when paused
+    double cpu_limit() const { return cpu_limit_.load(std::memory_order_relaxed); }
+    // Worker time spent running the queue's tasks
+    uint64_t busy_ns() const { return busy_ns_.load(std::memory_order_relaxed); }
+    // Times a worker passed over a queued task for lack of CPU budget
+    uint64_t throttled() const { return throttled_.load(std::memory_order_relaxed); }
+    // Times should_yield() asked the queue's tasks to make way
+    uint64_t yields() const { return yields_.load(std::memory_order_relaxed); }
+
+    bool is_open() const { return open_.load(std::memory_order_acquire); }
+
+private:
+    friend class WorkStealingExecutor;
+
+    TaskQueue(int priority, int quota, int node)
+        : priority_(priority), quota_(quota), node_(node) {}
+
+    bool try_acquire_slot();
+    void release_slot();
+    bool has_cpu_budget();              // Refills the bucket first
+    void charge_cpu(int64_t ns);
+    // When the bucket turns positive again; max() while paused
+    std::chrono::steady_clock::time_point cpu_budget_at();
+    void refill_cpu(std::chrono::steady_clock::time_point now);  // Caller holds bucket_mutex_
+    bool push(Task&& task);   // Overflow ring; false once closed
+    bool pop(Task& task);
+
+    std::atomic<int> priority_;
+    std::atomic<int> quota_;
+    const int node_;
+    std::atomic<uint64_t> pending_{0};  // Ring + worker deques
+    std::atomic<int> running_{0};
+    std::atomic<uint64_t> queued_{0};   // Ring only
+    std::atomic<bool> open_{true};
+
+    // CPU token bucket, in nanoseconds of worker time
+    std::atomic<double> cpu_limit_{-1.0};
+    std::atomic<uint64_t> busy_ns_{0};
+    std::atomic<uint64_t> throttled_{0};
+    std::atomic<uint64_t> yields_{0};
+    std::mutex bucket_mutex_;
+    double tokens_ns_ = 0;
+    std::chrono::steady_clock::time_point refilled_at_;
+
+    // Ring buffer reused across submissions; grows only when full
+    std::mutex mutex_;
+    std::vector<Task> ring_;
+    size_t head_ = 0;
+    size_t count_ = 0;
+};
+
+/**
+ * @brief Shared work-stealing thread pool
+ *
+ * One set of workers serves every TaskQueue. Each worker owns a
+ * WorkStealingDeque; tasks submitted from a worker thread go to its own
+ * deque, tasks from other threads to the target queue's ring. An idle
+ * worker takes work in this order: its own deque, the rings by priority,
+ * then other workers' deques. Workers with nothing to do park on a
+ * condition variable and are woken by submit(), so there is no polling
+ * delay. Quotas are checked whenever a task is about to run; a stolen
+ * task whose queue is at quota is moved back to that queue's ring.
+ *
+ * Task nodes for the deques are recycled through per-worker free lists,
+ * so steady-state submission does not allocate.
+ *
+ * Workers belong to a NUMA node or are unbound (-1), and serve only the
+ * queues of their own node: they take those queues' rings and steal only
+ * from workers of the same node. Node workers are pinned to the node's
+ * CPUs, so a node-bound queue's tasks, and the memory they first touch,
+ * stay on that node.
+ *
+ * A queue whose CPU budget is spent is skipped like one at quota; parked
+ * workers wake up when its bucket refills.
+ */
+class WorkStealingExecutor {
+public:
+    explicit WorkStealingExecutor(size_t workers = 0, size_t deque_capacity = 1024);
+    ~WorkStealingExecutor();
+
+    WorkStealingExecutor(const WorkStealingExecutor&) = delete;
+    WorkStealingExecutor& operator=(const WorkStealingExecutor&) = delete;
+
+    // Quotas below 1 are raised to 1; node -1 runs on the unbound workers
+    std::shared_ptr<TaskQueue> create_queue(int priority, int quota, int node = -1);
+
+    // Stop accepting tasks for queue and drop the ones not yet started
+    void close_queue(TaskQueue& queue);
+
+    void set_quota(TaskQueue& queue, int quota);
+    void set_priority(TaskQueue& queue, int priority);
+
+    // Limit queue to workers worker-seconds per second of task time;
+    // negative removes the limit and 0 pauses the queue
+    void set_cpu_limit(TaskQueue& queue, double workers);
+
+    /**
+     * @brief Whether tasks of queue should make way for higher priority work
+     *
+     * True while a queue of higher priority on the same node has tasks
+     * waiting to start, for a worker or for its quota, with CPU budget
+     * left. Long-running tasks check this between steps and resubmit the
+     * rest of their work: preemption at task boundaries, which frees the
+     * worker and its core for the higher priority tasks.
+     */
+    bool should_yield(TaskQueue& queue) const;
+
+    // False once the queue is closed or the executor stopped
+    bool submit(const std::shared_ptr<TaskQueue>& queue, Task task);
+
+    // Start workers of node until it has at least count; never shrinks.
+    // Node workers are pinned to cpus (unpinned when empty)
+    void ensure_workers(size_t count, int node = -1, const std::vector<int>& cpus = {});
+    size_t worker_count() const;
+    size_t worker_count(int node) const;
+
+    // Join all workers; tasks not yet started are dropped
+    void stop();
+
+    uint64_t steals() const { return steals_.load(std::memory_order_relaxed); }
+
+private:
+    struct Node;
+    struct Worker;
+    using QueueList = std::vector<std::shared_ptr<TaskQueue>>;  // Highest priority first
+    using WorkerList = std::vector<Worker*>;
+
+    size_t deque_capacity_;
+
+    mutable std::mutex mutex_;  // Guards workers_ and queues_ updates
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::shared_ptr<TaskQueue>> queues_;
+    std::atomic<std::shared_ptr<const WorkerList>> worker_snapshot_;
+    std::atomic<std::shared_ptr<const QueueList>> queue_snapshot_;
+
+    std::mutex park_mutex_;
+    std::condition_variable park_cv_;
+    std::atomic<int> sleeping_{0};
+    std::atomic<bool> stopping_{false};
+    std::atomic<bool> node_workers_{false};  // Any worker bound to a NUMA node
+    std::atomic<uint64_t> steals_{0};
+
+    void run(Worker& worker);
+    bool run_one(Worker& worker);
+    bool run_node(Worker& worker, Node* node);
+    static void execute(TaskQueue& queue, Task& task);
+    bool has_work(const Worker& worker) const;
+    // Earliest refill of a throttled queue with work for worker; max() if none
+    std::chrono::steady_clock::time_point next_refill(const Worker& worker) const;
+    void wake_one();
+    void publish_queues();  // Caller holds mutex_
+    void drain(Worker& worker);
+};
+
+}  // namespace core
+}  // namespace sage_tsdb
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+
+namespace sage_tsdb {
+
+/**
+ * @brief Global memtable budget shared by several tables
+ *
+ * Every memtable byte is charged here while it lives in memory, whether the
+ * memtable is still taking writes (mutable) or waiting in a flush queue.
+ * Once the mutable bytes reach the soft limit, the manager asks one client
+ * (the largest or the oldest active memtable, depending on the policy) to
+ * rotate it into its flush queue. Once the total reaches the budget,
+ * writers block in wait_for_room() until flushes release memory.
+ *
+ * A budget of 0 only tracks usage: nothing is flushed early and no writer
+ * blocks.
+ */
+class WriteBufferManager {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    enum class FlushPolicy {
+        Largest,  // Flush the client with the most mutable bytes
+        Oldest    // Flush the client whose active memtable started first
+    };
+
+    // A memtable owner the manager may ask to flush. Callbacks run under the
+    // client registry lock, so remove_client() waits for them to return.
+    struct Client {
+        std::function<size_t()> mutable_bytes;           // Bytes in the active memtable
+        std::function<Clock::time_point()> mutable_since; // When the active memtable was created
+        std::function<bool()> request_flush;             // Rotate it; false if nothing was done
+    };
+
+    explicit WriteBufferManager(size_t buffer_size, double soft_limit_ratio = 0.9,
+                                FlushPolicy policy = FlushPolicy::Largest);
+
+    WriteBufferManager(const WriteBufferManager&) = delete;
+    WriteBufferManager& operator=(const WriteBufferManager&) = delete;
+
+    uint64_t add_client(Client client);
+    void remove_client(uint64_t id);
+
+    // Accounting: reserve() for new memtable entries, schedule_free() when an
+    // active memtable is rotated into a flush queue, free() once a memtable
+    // is flushed or dropped
+    void reserve(size_t bytes);
+    void schedule_free(size_t bytes);
+    void free(size_t bytes);
+
+    // True once the mutable bytes reach the soft limit
+    bool should_flush() const;
+
+    // Ask one client to rotate its active memtable, chosen by the policy
+    bool flush_one();
+
+    // Block while the total usage is at or above the budget
+    void wait_for_room();
+
+    // True once the total usage reaches the soft limit
+    bool is_under_pressure() const;
+
+    void set_buffer_size(size_t buffer_size);
+    size_t get_buffer_size() const { return buffer_size_.load(std::memory_order_relaxed); }
+    size_t get_soft_limit() const;
+    FlushPolicy get_policy() const { return policy_; }
+
+    size_t get_memory_usage() const { return memory_used_.load(std::memory_order_relaxed); }
+    size_t get_mutable_memory_usage() const {
+        return mutable_used_.load(std::memory_order_relaxed);
+    }
+    size_t get_client_count() const;
+
+    uint64_t get_flush_requests() const { return flush_requests_.load(std::memory_order_relaxed); }
+    uint64_t get_stall_count() const { return stall_count_.load(std::memory_order_relaxed); }
+    uint64_t get_total_stall_micros() const {
+        return total_stall_micros_.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<size_t> buffer_size_;
+    double soft_limit_ratio_;
+    FlushPolicy policy_;
+
+    std::atomic<size_t> memory_used_{0};   // Mutable plus queued memtables
+    std::atomic<size_t> mutable_used_{0};  // Active memtables only
+
+    mutable std::mutex clients_mutex_;
+    std::map<uint64_t, Client> clients_;
+    uint64_t next_client_id_ = 1;
+
+    // Stalled writers wait on stall_cv_ until free() lowers the usage
+    std::mutex stall_mutex_;
+    std::condition_variable stall_cv_;
+
+    std::atomic<uint64_t> flush_requests_{0};
+    std::atomic<uint64_t> stall_count_{0};
+    std::atomic<uint64_t> total_stall_micros_{0};
+
+    bool has_room() const;
+    void notify_stalled();
+};
+
+} // namespace sage_tsdb
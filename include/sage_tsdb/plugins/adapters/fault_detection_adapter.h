@@ -1,9 +1,12 @@
 #pragma once
 
 #include "../plugin_interface.h"
+#include <atomic>
 #include <deque>
 #include <memory>
 #include <mutex>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 // Forward declarations for ML models
@@ -22,6 +25,11 @@ namespace plugins {
  * 
  * Features:
  * - Anomaly detection using VAE reconstruction error
+ * - Per-series statistics: points are grouped into series by their tags
+ *   ("series_tags", comma-separated; all tags if unset), each with its own
+ *   running mean and variance
+ * - Batched scoring: a micro-batch is scored in one pass over
+ *   struct-of-arrays buffers (AVX2/AVX-512 when the CPU has them)
  * - Time series pattern recognition
  * - Threshold-based alerting
  * - Adaptive learning
@@ -39,6 +47,7 @@ public:
     // IAlgorithmPlugin interface
     bool initialize(const PluginConfig& config) override;
     void feedData(const TimeSeriesData& data) override;
+    void feedBatch(std::span<const TimeSeriesData> batch) override;
     AlgorithmResult process() override;
     std::map<std::string, int64_t> getStats() const override;
     void reset() override;
@@ -99,25 +108,54 @@ public:
 
 private:
     /**
-     * @brief Detect anomalies using statistical method
+     * @brief Scores of a micro-batch, one entry per point (struct of arrays)
      */
-    DetectionResult detectZScore(const TimeSeriesData& data);
+    struct ScoreBatch {
+        std::vector<uint32_t> series;
+        std::vector<double> values;
+        std::vector<double> means;       // Series mean including the point
+        std::vector<double> variances;
+        std::vector<double> std_devs;
+        std::vector<double> scores;      // |value - mean| / std_dev
+        std::vector<uint64_t> counts;    // Series samples including the point
+        
+        void resize(size_t n);
+    };
     
     /**
-     * @brief Detect anomalies using VAE
+     * @brief Run the configured detection method on a micro-batch
+     * Caller holds detect_mutex_
      */
-    DetectionResult detectVAE(const TimeSeriesData& data);
+    void detectBatch(std::span<const TimeSeriesData> batch,
+                     std::vector<DetectionResult>& results);
     
     /**
-     * @brief Compute reconstruction error
+     * @brief Update the series statistics with the batch and score it into batch_
+     * Caller holds detect_mutex_
      */
-    double computeReconstructionError(const std::vector<double>& input,
-                                     const std::vector<double>& reconstructed);
+    void scoreBatch(std::span<const TimeSeriesData> batch);
+    
+    /**
+     * @brief Id of the series data belongs to, created on first sight
+     */
+    uint32_t seriesOf(const TimeSeriesData& data);
+    
+    /**
+     * @brief Z-score result of point i of batch_
+     */
+    DetectionResult detectZScore(int64_t timestamp, size_t i) const;
+    
+    /**
+     * @brief VAE results for the whole batch (one inference per batch)
+     */
+    void detectVAE(std::span<const TimeSeriesData> batch,
+                   std::vector<DetectionResult>& results);
     
     /**
-     * @brief Update statistics for z-score calculation
+     * @brief Compute reconstruction error
      */
-    void updateStatistics(double value);
+    double computeReconstructionError(const std::vector<double>& input,
+                                     const std::vector<double>& reconstructed);
     
     /**
      * @brief Initialize ML model
@@ -133,9 +171,16 @@ private:
     // ML Model (shared with PECJ if configured)
     std::shared_ptr<TROCHPACK_VAE::LinearVAE> vae_model_;
     
-    // Statistical tracking
-    std::deque<double> value_history_;
-    double running_mean_;
+    // Statistical tracking, guarded by detect_mutex_
+    mutable std::mutex detect_mutex_;
+    std::vector<std::string> series_tags_;                  // Tags naming a series; empty = all
+    std::unordered_map<std::string, uint32_t> series_ids_;
+    std::vector<double> series_mean_;                       // Welford state by series id
+    std::vector<double> series_variance_;
+    std::vector<uint64_t> series_count_;
+    ScoreBatch batch_;                                      // Scratch, reused across batches
+    std::string key_buffer_;
+    double running_mean_;                                   // Over all series
     double running_variance_;
     size_t sample_count_;
     
@@ -144,11 +189,10 @@ private:
     std::deque<DetectionResult> detection_history_;
     size_t max_history_size_;
     
-    // Statistics
-    mutable std::mutex stats_mutex_;
-    size_t total_samples_;
-    size_t anomalies_detected_;
-    int64_t total_detection_time_us_;
+    // Statistics (atomic so getStats() can be scraped without a lock)
+    std::atomic<size_t> total_samples_;
+    std::atomic<size_t> anomalies_detected_;
+    std::atomic<int64_t> total_detection_time_us_;
     
     // State
     bool initialized_;
@@ -7,7 +7,7 @@
 #include <condition_variable>
 #include <memory>
 #include <mutex>
-#include <queue>
+#include <span>
 #include <thread>
 #include <vector>
 
@@ -53,7 +53,10 @@ namespace plugins {
  * - Can be ported to other databases by changing only this adapter
  * 
  * Multi-threading Model:
- * - Data ingestion is lock-free using SPSC queues
+ * - Data ingestion is lock-free: one bounded ring per stream between the
+ *   producers and the worker; a full ring makes producers wait
+ * - The worker feeds the operator in batches of up to batch_size tuples,
+ *   holding a partial batch at most flush_interval_us
  * - PECJ internal threads handle join computation
  * - Window results are published via EventBus
  * 
@@ -92,6 +95,15 @@ public:
         std::string wm_tag = "arrival";      // Watermark strategy: "arrival", "lateness", "period", etc.
     };
     
+    /**
+     * @brief Ingest path configuration (feedData/feedBatch to the worker)
+     */
+    struct IngestConfig {
+        size_t queue_len = 65536;            // Ring capacity per stream ("ingestQueueLen")
+        size_t batch_size = 256;             // Tuples fed to the operator per batch ("ingestBatch")
+        uint64_t flush_interval_us = 1000;   // Max wait of a partial batch ("ingestFlushUs"; 0 = none)
+    };
+    
     explicit PECJAdapter(const PluginConfig& config);
     ~PECJAdapter() override;
     
@@ -113,6 +125,7 @@ public:
                    core::ResourceHandle* resource_handle) override;
     
     void feedData(const TimeSeriesData& data) override;
+    void feedBatch(std::span<const TimeSeriesData> batch) override;
     AlgorithmResult process() override;
     std::map<std::string, int64_t> getStats() const override;
     void reset() override;
@@ -135,6 +148,15 @@ public:
      */
     void feedStreamR(const TimeSeriesData& data);
     
+    /**
+     * @brief Feed a batch of S (or R) tuples to the operator directly
+     * 
+     * Same as feedStreamS/feedStreamR per tuple, with the timing and
+     * statistics updated once per batch.
+     */
+    void feedStreamSBatch(std::span<const TimeSeriesData> batch);
+    void feedStreamRBatch(std::span<const TimeSeriesData> batch);
+    
     /**
      * @brief Restart PECJ operator for a new window
      * This resets the operator state and prepares for processing new data.
@@ -175,12 +197,39 @@ public:
      */
     const WindowConfig& getWindowConfig() const { return window_config_; }
     
+    /**
+     * @brief Get current ingest configuration
+     */
+    const IngestConfig& getIngestConfig() const { return ingest_config_; }
+    
     /**
      * @brief Get current resource usage (for monitoring)
      */
     core::ResourceUsage getResourceUsage() const;
 
 private:
+    /**
+     * @brief Whether data belongs to stream S ("stream" tag, else timestamp parity)
+     */
+    static bool isStreamS(const TimeSeriesData& data);
+    
+    /**
+     * @brief Queue data for the worker; waits while the stream's ring is full
+     */
+    void enqueue(const TimeSeriesData& data, bool is_s_stream);
+    
+    /**
+     * @brief Wake the worker if enough tuples are pending for it
+     */
+    void signalWorker();
+    
+    /**
+     * @brief Tuples queued in both rings (approximate)
+     */
+    size_t pendingTuples() const;
+    
+    void feedStreamBatch(std::span<const TimeSeriesData> batch, bool is_s_stream);
+    
     /**
      * @brief Convert TimeSeriesData to PECJ TrackTuple
      */
@@ -227,6 +276,9 @@ private:
     // Window configuration
     WindowConfig window_config_;
     
+    // Ingest configuration
+    IngestConfig ingest_config_;
+    
     // Plugin configuration
     PluginConfig config_;
     
@@ -245,10 +297,13 @@ private:
     std::atomic<bool> running_{false};
     std::atomic<bool> initialized_{false};
     
-    // Data queues (for async processing)
-    std::mutex queue_mutex_;
-    std::condition_variable queue_cv_;
-    std::queue<std::pair<TimeSeriesData, bool>> data_queue_; // (data, is_s_stream)
+    // Data rings per stream (for async processing), created by initialize()
+    std::unique_ptr<MpmcRing<TimeSeriesData>> s_ring_;
+    std::unique_ptr<MpmcRing<TimeSeriesData>> r_ring_;
+    std::mutex wake_mutex_;
+    std::condition_variable wake_cv_;
+    std::atomic<size_t> wake_at_{0};           // Pending tuples the idle worker waits for (0 = busy)
+    std::atomic<uint64_t> space_signal_{0};    // Bumped per drained batch; producers on a full ring wait on it
     
     // State mutex
     std::mutex state_mutex_;
@@ -256,7 +311,6 @@ private:
     // Resource management (Integrated mode)
     core::ResourceRequest resource_request_;
     core::ResourceHandle* resource_handle_{nullptr};  // Non-owning pointer managed by PluginManager
-    std::atomic<uint64_t> queue_length_{0};
     
     // Mode detection
     enum class RunMode {
@@ -1,13 +1,21 @@
 #pragma once
 
 #include "../core/time_series_data.h"
+#include "../core/trace.h"
 #include "plugin_interface.h"
+#include <algorithm>
+#include <array>
 #include <atomic>
-#include <condition_variable>
+#include <chrono>
+#include <cstddef>
 #include <functional>
 #include <memory>
 #include <mutex>
-#include <queue>
+#include <new>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
 #include <thread>
 #include <unordered_map>
 #include <vector>
@@ -26,6 +34,45 @@ enum class EventType {
     CUSTOM              // Custom event
 };
 
+constexpr size_t EVENT_TYPE_COUNT = static_cast<size_t>(EventType::CUSTOM) + 1;
+
+/**
+ * @brief Interned event source: a small id plus its name
+ *
+ * The name points into a process-wide table that is never shrunk, so
+ * events carry a source without allocating or copying a string.
+ */
+struct EventSource {
+    uint32_t id = 0;           // 0 = unnamed ("")
+    std::string_view name;
+};
+
+/**
+ * @brief Intern a source name; the same name always yields the same id
+ */
+inline EventSource intern_source(std::string_view name) {
+    struct Registry {
+        std::shared_mutex mutex;
+        std::unordered_map<std::string, uint32_t> ids;  // Node-based: keys never move
+    };
+    static Registry registry;
+    if (name.empty()) {
+        return {};
+    }
+    std::string key(name);
+    {
+        std::shared_lock<std::shared_mutex> lock(registry.mutex);
+        auto it = registry.ids.find(key);
+        if (it != registry.ids.end()) {
+            return {it->second, it->first};
+        }
+    }
+    std::unique_lock<std::shared_mutex> lock(registry.mutex);
+    auto [it, inserted] = registry.ids.try_emplace(
+        std::move(key), static_cast<uint32_t>(registry.ids.size() + 1));
+    return {it->second, it->first};
+}
+
 /**
  * @brief Event structure
  */
@@ -33,11 +80,16 @@ struct Event {
     EventType type;
     int64_t timestamp;
     std::shared_ptr<void> payload;  // Generic payload
-    std::string source;              // Event source plugin name
-    
-    Event(EventType t, int64_t ts, std::shared_ptr<void> p = nullptr, 
+    std::string_view source;        // Event source plugin name (interned)
+    uint32_t source_id = 0;         // Interned id of source
+
+    Event(EventType t, int64_t ts, std::shared_ptr<void> p = nullptr,
           const std::string& src = "")
-        : type(t), timestamp(ts), payload(p), source(src) {}
+        : Event(t, ts, std::move(p), intern_source(src)) {}
+
+    // Hot path: a source interned once by the publisher
+    Event(EventType t, int64_t ts, std::shared_ptr<void> p, EventSource src)
+        : type(t), timestamp(ts), payload(std::move(p)), source(src.name), source_id(src.id) {}
 };
 
 /**
@@ -45,27 +97,216 @@ struct Event {
  */
 using EventCallback = std::function<void(const Event&)>;
 
+/**
+ * @brief What publish() does when the bus is full
+ */
+enum class OverflowPolicy {
+    BLOCK,          // Wait for the dispatcher to make room (drops only once stopped)
+    DROP_OLDEST,    // Discard the oldest queued event
+    DROP_NEWEST     // Discard the event being published
+};
+
+/**
+ * @brief Event bus configuration
+ */
+struct EventBusConfig {
+    size_t capacity = 16384;        // Queued events, rounded up to a power of two
+    OverflowPolicy overflow = OverflowPolicy::BLOCK;
+    size_t batch_size = 256;        // Events the dispatcher drains per wakeup
+};
+
+/**
+ * @brief What the dispatcher does when a subscriber's queue is full
+ */
+enum class DeliveryPolicy {
+    BACKPRESSURE,   // Wait for the subscriber; the bus ring, then publishers, back up
+    DROP,           // Discard the event for this subscriber only
+    SAMPLE          // Past half full keep one event in sample_every; drop when full
+};
+
+/**
+ * @brief Per-subscriber delivery options
+ */
+struct SubscriberOptions {
+    std::string name;               // Shown in stats; "subscriber-<id>" if empty
+    size_t capacity = 0;            // Queued events; 0 = bus capacity
+    DeliveryPolicy policy = DeliveryPolicy::BACKPRESSURE;
+    size_t sample_every = 10;       // SAMPLE: one event kept per this many
+};
+
+/**
+ * @brief Delivery counters of one subscriber
+ */
+struct SubscriberStats {
+    int id = 0;
+    std::string name;
+    EventType type = EventType::CUSTOM;
+    DeliveryPolicy policy = DeliveryPolicy::BACKPRESSURE;
+    uint64_t delivered = 0;         // Callbacks run
+    uint64_t dropped = 0;           // Discarded, queue full
+    uint64_t sampled_out = 0;       // Skipped by SAMPLE
+    size_t queued = 0;              // Approximate
+    int64_t lag_us = 0;             // Queueing delay of the event being or last delivered
+    int64_t max_lag_us = 0;
+};
+
+/**
+ * @brief Event bus counters
+ */
+struct EventBusStats {
+    uint64_t published = 0;         // Events accepted into the ring
+    uint64_t delivered = 0;         // Events handed to the subscriber queues
+    uint64_t dropped_oldest = 0;
+    uint64_t dropped_newest = 0;
+    uint64_t blocked_publishes = 0; // publish() calls that waited for room
+    size_t queued = 0;              // Approximate
+};
+
+/**
+ * @brief Bounded lock-free multi-producer multi-consumer ring
+ *
+ * Each cell carries a sequence number that tells producers and consumers
+ * whose turn it is (Vyukov's bounded MPMC queue): claiming a slot is one
+ * CAS on the head or tail, and no operation takes a lock.
+ */
+template <typename T>
+class MpmcRing {
+public:
+    explicit MpmcRing(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        mask_ = size - 1;
+        cells_ = std::make_unique<Cell[]>(size);
+        for (size_t i = 0; i < size; ++i) {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    ~MpmcRing() {
+        while (try_pop()) {
+        }
+    }
+
+    MpmcRing(const MpmcRing&) = delete;
+    MpmcRing& operator=(const MpmcRing&) = delete;
+
+    // Moves value in only on success; false when full
+    bool try_push(T&& value) {
+        size_t pos = tail_.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &cells_[pos & mask_];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos);
+            if (diff == 0) {
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+        new (cell->storage) T(std::move(value));
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    std::optional<T> try_pop() {
+        size_t pos = head_.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &cells_[pos & mask_];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos + 1);
+            if (diff == 0) {
+                if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return std::nullopt;
+            } else {
+                pos = head_.load(std::memory_order_relaxed);
+            }
+        }
+        T* item = std::launder(reinterpret_cast<T*>(cell->storage));
+        std::optional<T> value(std::move(*item));
+        item->~T();
+        cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+        return value;
+    }
+
+    size_t capacity() const { return mask_ + 1; }
+
+    size_t size_approx() const {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        size_t head = head_.load(std::memory_order_relaxed);
+        return tail > head ? std::min(tail - head, capacity()) : 0;
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence{0};
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    size_t mask_ = 0;
+    std::unique_ptr<Cell[]> cells_;
+    alignas(64) std::atomic<size_t> head_{0};
+    alignas(64) std::atomic<size_t> tail_{0};
+};
+
 /**
  * @brief Thread-safe event bus for plugin communication
- * 
+ *
  * Implements Pub/Sub pattern for decoupled communication between:
  * - sageTSDB core
  * - PECJ plugin
  * - Fault Detection plugin
- * 
+ *
  * Features:
- * - Zero-copy data sharing via shared_ptr
- * - Async event delivery
+ * - Zero-copy data sharing via shared_ptr; events are moved through the
+ *   ring and passed to every subscriber by reference
+ * - Bounded lock-free ring with a configurable overflow policy, so a
+ *   lagging subscriber cannot grow memory without bound
+ * - Async delivery in batches: the dispatcher drains up to batch_size
+ *   events per wakeup and reads the subscriber list once per batch
+ * - Subscriber isolation: the dispatcher only queues events; each
+ *   subscriber has its own bounded queue and worker thread running its
+ *   callback, so a slow subscriber delays the others only if its
+ *   DeliveryPolicy is BACKPRESSURE and its queue is full
  * - Topic-based subscription
  */
 class EventBus {
 public:
-    EventBus() : running_(false) {}
-    
+    explicit EventBus(const EventBusConfig& config = EventBusConfig())
+        : running_(false)
+        , config_(config)
+        , ring_(std::make_unique<MpmcRing<Event>>(std::max<size_t>(config.capacity, 2)))
+        , subscribers_(std::make_shared<const SubscriberTable>()) {}
+
     ~EventBus() {
         stop();
     }
-    
+
+    /**
+     * @brief Replace the configuration; queued events are discarded
+     * @return false while running
+     */
+    bool configure(const EventBusConfig& config) {
+        if (running_.load()) {
+            return false;
+        }
+        config_ = config;
+        ring_ = std::make_unique<MpmcRing<Event>>(std::max<size_t>(config.capacity, 2));
+        return true;
+    }
+
+    const EventBusConfig& config() const { return config_; }
+
     /**
      * @brief Start the event bus
      */
@@ -73,141 +314,438 @@ public:
         if (running_.exchange(true)) {
             return;  // Already running
         }
-        
+
+        {
+            std::lock_guard<std::mutex> lock(subscribers_mutex_);
+            for (const auto& subs : *subscribers_) {
+                for (const auto& sub : subs) {
+                    launch(sub.channel);
+                }
+            }
+        }
+
         worker_thread_ = std::thread([this]() {
-            while (running_) {
-                Event event(EventType::CUSTOM, 0);
-                {
-                    std::unique_lock<std::mutex> lock(queue_mutex_);
-                    cv_.wait(lock, [this]() {
-                        return !event_queue_.empty() || !running_;
-                    });
-                    
+            std::vector<Event> batch;
+            batch.reserve(std::max<size_t>(1, config_.batch_size));
+            while (true) {
+                uint64_t signal = publish_signal_.load(std::memory_order_acquire);
+                drain(batch, std::max<size_t>(1, config_.batch_size));
+                if (batch.empty()) {
                     if (!running_) break;
-                    
-                    if (!event_queue_.empty()) {
-                        event = event_queue_.front();
-                        event_queue_.pop();
-                    } else {
-                        continue;
-                    }
+                    publish_signal_.wait(signal, std::memory_order_acquire);
+                    continue;
                 }
-                
+
+                // Room freed: wake publishers blocked on a full ring
+                space_signal_.fetch_add(1, std::memory_order_release);
+                space_signal_.notify_all();
+
                 // Deliver event to subscribers
-                deliver_event(event);
+                deliver_batch(batch);
+                batch.clear();
+                if (!running_) break;
             }
         });
     }
-    
+
     /**
      * @brief Stop the event bus
+     *
+     * Events still queued in the ring stay there until the next start() or
+     * drain(); events already in a subscriber queue are delivered first.
      */
     void stop() {
         if (!running_.exchange(false)) {
             return;  // Already stopped
         }
-        
-        cv_.notify_all();
+
+        publish_signal_.fetch_add(1, std::memory_order_release);
+        publish_signal_.notify_all();
+        space_signal_.fetch_add(1, std::memory_order_release);
+        space_signal_.notify_all();
         if (worker_thread_.joinable()) {
             worker_thread_.join();
         }
+
+        std::shared_ptr<const SubscriberTable> table;
+        {
+            std::lock_guard<std::mutex> lock(subscribers_mutex_);
+            table = subscribers_;
+        }
+        for (const auto& subs : *table) {
+            for (const auto& sub : subs) {
+                halt(*sub.channel, Channel::DRAIN);
+            }
+        }
     }
-    
+
     /**
      * @brief Subscribe to events of a specific type
      */
-    int subscribe(EventType type, EventCallback callback) {
+    int subscribe(EventType type, EventCallback callback,
+                  const SubscriberOptions& options = SubscriberOptions()) {
         std::lock_guard<std::mutex> lock(subscribers_mutex_);
         int id = next_subscriber_id_++;
-        subscribers_[type].push_back({id, callback});
+        size_t capacity = options.capacity > 0 ? options.capacity : config_.capacity;
+        auto channel = std::make_shared<Channel>(std::max<size_t>(capacity, 2));
+        channel->id = id;
+        channel->type = type;
+        channel->name = options.name.empty() ? "subscriber-" + std::to_string(id) : options.name;
+        channel->policy = options.policy;
+        channel->sample_every = std::max<size_t>(1, options.sample_every);
+        channel->callback = std::move(callback);
+
+        auto table = std::make_shared<SubscriberTable>(*subscribers_);
+        (*table)[static_cast<size_t>(type)].push_back({id, channel});
+        subscribers_ = std::move(table);
+        if (running_) {
+            launch(channel);
+        }
         return id;
     }
-    
+
     /**
      * @brief Unsubscribe from events
+     *
+     * Events still queued for the subscriber are discarded; a callback
+     * already running completes.
      */
     void unsubscribe(int subscriber_id) {
-        std::lock_guard<std::mutex> lock(subscribers_mutex_);
-        for (auto& pair : subscribers_) {
-            auto& subs = pair.second;
-            subs.erase(
-                std::remove_if(subs.begin(), subs.end(),
-                    [subscriber_id](const Subscriber& s) {
-                        return s.id == subscriber_id;
-                    }),
-                subs.end());
+        std::shared_ptr<Channel> removed;
+        {
+            std::lock_guard<std::mutex> lock(subscribers_mutex_);
+            auto table = std::make_shared<SubscriberTable>(*subscribers_);
+            for (auto& subs : *table) {
+                for (auto it = subs.begin(); it != subs.end(); ++it) {
+                    if (it->id == subscriber_id) {
+                        removed = it->channel;
+                        subs.erase(it);
+                        break;
+                    }
+                }
+            }
+            subscribers_ = std::move(table);
+        }
+        if (removed) {
+            halt(*removed, Channel::CLOSED);
         }
     }
-    
+
     /**
      * @brief Publish an event
+     * @return false if the event was dropped (DROP_NEWEST on a full ring,
+     *         or BLOCK while the bus is stopped and full)
      */
-    void publish(const Event& event) {
-        {
-            std::lock_guard<std::mutex> lock(queue_mutex_);
-            event_queue_.push(event);
+    bool publish(Event event) {
+        bool waited = false;
+        while (true) {
+            uint64_t space = space_signal_.load(std::memory_order_acquire);
+            if (ring_->try_push(std::move(event))) {
+                break;
+            }
+            switch (config_.overflow) {
+                case OverflowPolicy::DROP_NEWEST:
+                    dropped_newest_.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                case OverflowPolicy::DROP_OLDEST:
+                    if (ring_->try_pop()) {
+                        dropped_oldest_.fetch_add(1, std::memory_order_relaxed);
+                    }
+                    break;
+                case OverflowPolicy::BLOCK:
+                    // Nobody drains a stopped bus
+                    if (!running_) {
+                        dropped_newest_.fetch_add(1, std::memory_order_relaxed);
+                        return false;
+                    }
+                    if (!waited) {
+                        waited = true;
+                        blocked_publishes_.fetch_add(1, std::memory_order_relaxed);
+                    }
+                    space_signal_.wait(space, std::memory_order_acquire);
+                    break;
+            }
         }
-        cv_.notify_one();
+        published_.fetch_add(1, std::memory_order_relaxed);
+        publish_signal_.fetch_add(1, std::memory_order_release);
+        publish_signal_.notify_one();
+        return true;
     }
-    
+
     /**
      * @brief Publish event with time series data (zero-copy)
      */
-    void publish_data(const std::shared_ptr<TimeSeriesData>& data, 
-                     const std::string& source = "") {
-        Event event(EventType::DATA_INGESTED, data->timestamp, 
-                   std::static_pointer_cast<void>(data), source);
-        publish(event);
+    bool publish_data(const std::shared_ptr<TimeSeriesData>& data,
+                      const std::string& source = "") {
+        return publish_data(data, intern_source(source));
     }
-    
+
+    bool publish_data(const std::shared_ptr<TimeSeriesData>& data, EventSource source) {
+        return publish(Event(EventType::DATA_INGESTED, data->timestamp,
+                             std::static_pointer_cast<void>(data), source));
+    }
+
     /**
      * @brief Publish algorithm result
      */
-    void publish_result(const std::shared_ptr<AlgorithmResult>& result,
-                       const std::string& source = "") {
-        Event event(EventType::RESULT_READY, result->timestamp,
-                   std::static_pointer_cast<void>(result), source);
-        publish(event);
+    bool publish_result(const std::shared_ptr<AlgorithmResult>& result,
+                        const std::string& source = "") {
+        return publish(Event(EventType::RESULT_READY, result->timestamp,
+                             std::static_pointer_cast<void>(result), intern_source(source)));
+    }
+
+    /**
+     * @brief Move up to max_events queued events into out, oldest first
+     *
+     * For pull consumers of a bus that is not started; the dispatcher
+     * drains the same way.
+     */
+    size_t drain(std::vector<Event>& out, size_t max_events) {
+        size_t drained = 0;
+        while (drained < max_events) {
+            auto event = ring_->try_pop();
+            if (!event) {
+                break;
+            }
+            out.push_back(std::move(*event));
+            ++drained;
+        }
+        return drained;
+    }
+
+    EventBusStats getStats() const {
+        EventBusStats stats;
+        stats.published = published_.load(std::memory_order_relaxed);
+        stats.delivered = delivered_.load(std::memory_order_relaxed);
+        stats.dropped_oldest = dropped_oldest_.load(std::memory_order_relaxed);
+        stats.dropped_newest = dropped_newest_.load(std::memory_order_relaxed);
+        stats.blocked_publishes = blocked_publishes_.load(std::memory_order_relaxed);
+        stats.queued = ring_->size_approx();
+        return stats;
+    }
+
+    /**
+     * @brief Delivery counters of every subscriber, in subscription order
+     */
+    std::vector<SubscriberStats> getSubscriberStats() const {
+        std::shared_ptr<const SubscriberTable> table;
+        {
+            std::lock_guard<std::mutex> lock(subscribers_mutex_);
+            table = subscribers_;
+        }
+        std::vector<SubscriberStats> all;
+        int64_t now = nowNs();
+        for (const auto& subs : *table) {
+            for (const auto& sub : subs) {
+                const Channel& channel = *sub.channel;
+                SubscriberStats stats;
+                stats.id = channel.id;
+                stats.name = channel.name;
+                stats.type = channel.type;
+                stats.policy = channel.policy;
+                stats.delivered = channel.delivered.load(std::memory_order_relaxed);
+                stats.dropped = channel.dropped.load(std::memory_order_relaxed);
+                stats.sampled_out = channel.sampled_out.load(std::memory_order_relaxed);
+                stats.queued = channel.queue.size_approx();
+                stats.lag_us = channel.last_lag_ns.load(std::memory_order_relaxed) / 1000;
+                // A callback still running lags by as long as it has taken so far
+                int64_t current = channel.current_enqueued_ns.load(std::memory_order_relaxed);
+                if (current > 0) {
+                    stats.lag_us = std::max(stats.lag_us, (now - current) / 1000);
+                }
+                stats.max_lag_us = std::max(
+                    stats.lag_us, channel.max_lag_ns.load(std::memory_order_relaxed) / 1000);
+                all.push_back(std::move(stats));
+            }
+        }
+        std::sort(all.begin(), all.end(),
+                  [](const SubscriberStats& a, const SubscriberStats& b) { return a.id < b.id; });
+        return all;
     }
 
 private:
+    struct Queued {
+        Event event;
+        int64_t enqueued_ns;
+    };
+
+    /**
+     * @brief Queue, worker and counters of one subscriber
+     *
+     * The dispatcher is the only producer and the worker the only consumer.
+     */
+    struct Channel {
+        enum State { RUNNING, DRAIN, CLOSED };
+
+        explicit Channel(size_t capacity) : queue(capacity) {}
+
+        int id = 0;
+        EventType type = EventType::CUSTOM;
+        std::string name;
+        DeliveryPolicy policy = DeliveryPolicy::BACKPRESSURE;
+        size_t sample_every = 1;
+        size_t sample_count = 0;               // Dispatcher only
+        EventCallback callback;
+
+        MpmcRing<Queued> queue;
+        std::thread worker;                    // Guarded by the bus subscribers_mutex_
+        std::atomic<int> state{RUNNING};
+        std::atomic<uint64_t> push_signal{0};  // Bumped per queued event; the worker waits on it
+        std::atomic<uint64_t> pop_signal{0};   // Bumped per delivered event; BACKPRESSURE waits on it
+
+        std::atomic<uint64_t> delivered{0};
+        std::atomic<uint64_t> dropped{0};
+        std::atomic<uint64_t> sampled_out{0};
+        std::atomic<int64_t> last_lag_ns{0};
+        std::atomic<int64_t> max_lag_ns{0};
+        std::atomic<int64_t> current_enqueued_ns{0};  // 0 when no callback runs
+    };
+
     struct Subscriber {
         int id;
-        EventCallback callback;
+        std::shared_ptr<Channel> channel;
     };
-    
-    void deliver_event(const Event& event) {
-        std::vector<EventCallback> callbacks;
+
+    // Subscribers by event type; replaced, never modified, once published
+    using SubscriberTable = std::array<std::vector<Subscriber>, EVENT_TYPE_COUNT>;
+
+    static int64_t nowNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void deliver_batch(const std::vector<Event>& batch) {
+        SAGE_TSDB_TRACE_SCOPE_ARG("eventbus", "eventbus.dispatch", "events", batch.size());
+        std::shared_ptr<const SubscriberTable> table;
         {
             std::lock_guard<std::mutex> lock(subscribers_mutex_);
-            auto it = subscribers_.find(event.type);
-            if (it != subscribers_.end()) {
-                for (const auto& sub : it->second) {
-                    callbacks.push_back(sub.callback);
-                }
+            table = subscribers_;
+        }
+
+        // Only queue here; callbacks run on the subscribers' own workers
+        for (const Event& event : batch) {
+            for (const auto& sub : (*table)[static_cast<size_t>(event.type)]) {
+                enqueue(*sub.channel, event);
             }
         }
-        
-        // Deliver outside lock to avoid deadlock
-        for (const auto& callback : callbacks) {
-            try {
-                callback(event);
-            } catch (...) {
-                // Log error but continue
+        delivered_.fetch_add(batch.size(), std::memory_order_relaxed);
+    }
+
+    void enqueue(Channel& channel, const Event& event) {
+        if (channel.policy == DeliveryPolicy::SAMPLE &&
+            channel.queue.size_approx() * 2 >= channel.queue.capacity() &&
+            channel.sample_count++ % channel.sample_every != 0) {
+            channel.sampled_out.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        Queued item{event, nowNs()};
+        while (true) {
+            uint64_t space = channel.pop_signal.load(std::memory_order_acquire);
+            if (channel.queue.try_push(std::move(item))) {
+                break;
+            }
+            // Nobody will make room for a closed subscriber
+            if (channel.policy != DeliveryPolicy::BACKPRESSURE ||
+                channel.state.load(std::memory_order_acquire) == Channel::CLOSED) {
+                channel.dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
             }
+            channel.pop_signal.wait(space, std::memory_order_acquire);
         }
+        channel.push_signal.fetch_add(1, std::memory_order_release);
+        channel.push_signal.notify_one();
     }
-    
+
+    // Caller holds subscribers_mutex_; the worker keeps the channel alive
+    void launch(const std::shared_ptr<Channel>& shared) {
+        if (shared->worker.joinable()) {
+            return;
+        }
+        shared->state.store(Channel::RUNNING, std::memory_order_release);
+        shared->worker = std::thread([shared]() {
+            Channel& channel = *shared;
+            while (true) {
+                uint64_t signal = channel.push_signal.load(std::memory_order_acquire);
+                int state = channel.state.load(std::memory_order_acquire);
+                if (state == Channel::CLOSED) {
+                    break;
+                }
+                auto item = channel.queue.try_pop();
+                if (!item) {
+                    if (state == Channel::DRAIN) {
+                        break;
+                    }
+                    channel.push_signal.wait(signal, std::memory_order_acquire);
+                    continue;
+                }
+
+                channel.current_enqueued_ns.store(item->enqueued_ns, std::memory_order_relaxed);
+                int64_t lag = nowNs() - item->enqueued_ns;
+                try {
+                    SAGE_TSDB_TRACE_RECORD("eventbus", "eventbus.queued", item->enqueued_ns,
+                                           item->enqueued_ns + lag, "lag_ns",
+                                           static_cast<uint64_t>(lag));
+                    SAGE_TSDB_TRACE_SCOPE("eventbus", "eventbus.callback");
+                    channel.callback(item->event);
+                } catch (...) {
+                    // Log error but continue
+                }
+                channel.current_enqueued_ns.store(0, std::memory_order_relaxed);
+                channel.last_lag_ns.store(lag, std::memory_order_relaxed);
+                if (lag > channel.max_lag_ns.load(std::memory_order_relaxed)) {
+                    channel.max_lag_ns.store(lag, std::memory_order_relaxed);
+                }
+                channel.delivered.fetch_add(1, std::memory_order_relaxed);
+                channel.pop_signal.fetch_add(1, std::memory_order_release);
+                channel.pop_signal.notify_all();
+            }
+        });
+    }
+
+    /**
+     * @brief Stop the worker of channel: DRAIN delivers what is queued first
+     *
+     * Called from the worker itself (a callback unsubscribing its own
+     * subscriber), the thread is detached rather than joined.
+     */
+    void halt(Channel& channel, Channel::State state) {
+        std::thread worker;
+        {
+            std::lock_guard<std::mutex> lock(subscribers_mutex_);
+            worker = std::move(channel.worker);
+        }
+        channel.state.store(state, std::memory_order_release);
+        channel.push_signal.fetch_add(1, std::memory_order_release);
+        channel.push_signal.notify_all();
+        channel.pop_signal.fetch_add(1, std::memory_order_release);
+        channel.pop_signal.notify_all();
+        if (!worker.joinable()) {
+            return;
+        }
+        if (worker.get_id() == std::this_thread::get_id()) {
+            worker.detach();
+        } else {
+            worker.join();
+        }
+    }
+
     std::atomic<bool> running_;
     std::thread worker_thread_;
-    
-    std::queue<Event> event_queue_;
-    std::mutex queue_mutex_;
-    std::condition_variable cv_;
-    
-    std::unordered_map<EventType, std::vector<Subscriber>> subscribers_;
-    std::mutex subscribers_mutex_;
+
+    EventBusConfig config_;
+    std::unique_ptr<MpmcRing<Event>> ring_;
+    std::atomic<uint64_t> publish_signal_{0};  // Bumped per publish; the dispatcher waits on it
+    std::atomic<uint64_t> space_signal_{0};    // Bumped per drained batch; BLOCK publishers wait on it
+
+    std::shared_ptr<const SubscriberTable> subscribers_;
+    mutable std::mutex subscribers_mutex_;
     int next_subscriber_id_ = 0;
+
+    std::atomic<uint64_t> published_{0};
+    std::atomic<uint64_t> delivered_{0};
+    std::atomic<uint64_t> dropped_oldest_{0};
+    std::atomic<uint64_t> dropped_newest_{0};
+    std::atomic<uint64_t> blocked_publishes_{0};
 };
 
 } // namespace plugins
@@ -5,6 +5,7 @@
 #include <functional>
 #include <map>
 #include <memory>
+#include <span>
 #include <string>
 #include <vector>
 
@@ -74,6 +75,18 @@ public:
      */
     virtual void feedData(const TimeSeriesData& data) = 0;
     
+    /**
+     * @brief Feed a batch of time series data, in order
+     * @param batch Input data; only valid during the call
+     * @note Default loops over feedData(); plugins override it to pay
+     *       locking and dispatch once per batch instead of per tuple
+     */
+    virtual void feedBatch(std::span<const TimeSeriesData> batch) {
+        for (const auto& data : batch) {
+            feedData(data);
+        }
+    }
+    
     /**
      * @brief Process accumulated data
      * @return Processing results
@@ -83,6 +96,9 @@ public:
     /**
      * @brief Get algorithm statistics
      * @return Statistics map (e.g., latency, throughput, accuracy)
+     * 
+     * Read at every metrics scrape once PluginManager::attachMetrics() is
+     * called, so it should only load atomics, never a lock feedData() holds.
      */
     virtual std::map<std::string, int64_t> getStats() const = 0;
     
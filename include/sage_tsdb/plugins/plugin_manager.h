@@ -3,9 +3,13 @@
 #include "plugin_interface.h"
 #include "plugin_registry.h"
 #include "event_bus.h"
+#include "../core/metrics_registry.h"
 #include "../core/resource_manager.h"
+#include <chrono>
+#include <condition_variable>
 #include <memory>
 #include <mutex>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
@@ -63,10 +67,18 @@ public:
     
     /**
      * @brief Feed data to all plugins
-     * Zero-copy: data is shared via shared_ptr
+     * 
+     * The event is published at once; plugins receive the data in
+     * micro-batches through feedBatch(), flushed when feed_batch_size
+     * points are pending or the oldest has waited feed_batch_delay_us.
      */
     void feedDataToAll(const std::shared_ptr<TimeSeriesData>& data);
     
+    /**
+     * @brief Deliver the pending micro-batch to all plugins now
+     */
+    void flushFeeds();
+    
     /**
      * @brief Feed data to specific plugin
      */
@@ -80,9 +92,24 @@ public:
     
     /**
      * @brief Get statistics from all plugins
+     * 
+     * Also has "_event_bus" and, per bus subscriber, "_subscriber:<name>"
+     * with its queue depth, drops and delivery lag (lag_us, max_lag_us).
      */
     std::map<std::string, std::map<std::string, int64_t>> getAllStats() const;
     
+    /**
+     * @brief Export plugin stats and resource usage into a metrics registry
+     * @param registry Registry to export into (e.g. TableManager::getMetricsRegistry()), or nullptr to stop
+     * 
+     * Each getStats() key of a loaded plugin becomes a gauge
+     * sage_tsdb_plugin_stat{plugin=<name>,stat=<key>}, read through
+     * getStats() at scrape time. The keys are taken when the plugin is
+     * loaded, or here for plugins already loaded. Resource handles are
+     * exported through ResourceManager::attachMetrics().
+     */
+    void attachMetrics(std::shared_ptr<MetricsRegistry> registry);
+    
     /**
      * @brief Get list of loaded plugins
      */
@@ -106,6 +133,8 @@ public:
         size_t thread_pool_size = 4;       // Shared thread pool size
         bool enable_zero_copy = true;      // Enable zero-copy data passing
         size_t event_queue_size = 10000;   // Event bus queue size
+        size_t feed_batch_size = 256;      // Points per plugin feed (<= 1: unbatched)
+        uint64_t feed_batch_delay_us = 1000;  // Max wait of a point before its batch is fed
     };
     
     void setResourceConfig(const ResourceConfig& config);
@@ -127,11 +156,33 @@ private:
      */
     void handleDataEvent(const Event& event);
     
+    /**
+     * @brief Feed the pending micro-batch to the enabled plugins
+     * Caller holds feed_mutex_
+     */
+    void dispatchFeedBatch();
+    
+    /**
+     * @brief Replace a plugin's series in metrics_ (caller holds plugins_mutex_)
+     */
+    void registerPluginMetrics(const std::string& name, const PluginPtr& plugin);
+    
+    /**
+     * @brief Flusher thread: bounds the latency of a partial batch
+     */
+    void feedFlushLoop();
+    void stopFeedFlusher();
+    
     // Plugin instances
     std::unordered_map<std::string, PluginPtr> plugins_;
     std::unordered_map<std::string, bool> plugin_enabled_;
     mutable std::mutex plugins_mutex_;
     
+    // Plugin stats in the attached registry (under plugins_mutex_); declared
+    // after plugins_ so the series are dropped first
+    std::shared_ptr<MetricsRegistry> metrics_;
+    std::unordered_map<std::string, std::vector<MetricsRegistry::Handle>> plugin_metrics_;
+    
     // Resource management per plugin
     std::unordered_map<std::string, std::shared_ptr<core::ResourceHandle>> plugin_resources_;
     std::shared_ptr<core::ResourceManager> resource_manager_;
@@ -144,6 +195,14 @@ private:
     ResourceConfig resource_config_;
     mutable std::mutex resource_mutex_;
     
+    // Micro-batched plugin feeds (lock order: feed_mutex_, then plugins_mutex_)
+    std::vector<TimeSeriesData> feed_batch_;
+    std::chrono::steady_clock::time_point feed_batch_start_;
+    std::mutex feed_mutex_;
+    std::condition_variable feed_cv_;
+    std::thread feed_flusher_;
+    bool feed_stop_ = false;
+    
     // State
     bool initialized_;
     bool running_;
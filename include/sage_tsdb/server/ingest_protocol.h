@@ -0,0 +1,77 @@
+#pragma once
+
+#include "../core/time_series_data.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace sage_tsdb {
+namespace server {
+
+/**
+ * @brief Wire formats accepted by the ingest server
+ *
+ * Line protocol (InfluxDB style), one point per line:
+ *
+ *     measurement[,tag=value...] field=value[,field=value...] [timestamp]
+ *
+ * The measurement names the stream table. Commas, spaces and '=' in names
+ * are escaped with a backslash. Field values are floats, integers ("42i"),
+ * unsigned integers ("42u"), booleans (t/true/f/false) or double-quoted
+ * strings. The value field (default "value") becomes the point's value;
+ * without it the first numeric field is used and also kept as a field.
+ * Blank lines and lines starting with '#' are skipped.
+ *
+ * Binary framing, for producers that already hold columns: a connection
+ * (or datagram) that starts with kBinaryMagic carries frames of
+ *
+ *     u32 payload size, u32 crc32c of the payload,
+ *     payload = u16 table name length, table name, ColumnarBlock bytes
+ *
+ * all little-endian. The block is the SSTable and bulk file encoding.
+ */
+
+inline constexpr uint32_t kBinaryMagic = 0x4E494253;       // "SBIN"
+inline constexpr size_t kBinaryHeaderBytes = 8;
+inline constexpr size_t kMaxBinaryFrameBytes = 64 * 1024 * 1024;
+
+struct LineProtocolOptions {
+    std::string value_field = "value";
+    // Incoming timestamps are divided by this (e.g. 1000000 for ns -> ms)
+    int64_t timestamp_divisor = 1;
+};
+
+struct LinePoint {
+    std::string table;
+    TimeSeriesData data;
+};
+
+enum class LineStatus { Point, Skipped, Error };
+
+/**
+ * @brief Parse one line (without its newline; a trailing '\r' is ignored)
+ *
+ * Lines without a timestamp get the current time in milliseconds.
+ * On Error, error (if given) describes the problem and out is unspecified.
+ */
+LineStatus parse_line(std::string_view line, LinePoint& out,
+                      const LineProtocolOptions& options = LineProtocolOptions{},
+                      std::string* error = nullptr);
+
+/**
+ * @brief Append one binary frame for points of table to out
+ */
+void encode_binary_frame(const std::string& table, const TimeSeriesData* points,
+                         size_t count, std::vector<uint8_t>& out);
+
+/**
+ * @brief Decode a frame payload (the bytes after the 8-byte header)
+ * @return false if the payload is malformed; points are appended otherwise
+ */
+bool decode_binary_payload(const uint8_t* data, size_t size, std::string& table,
+                           std::vector<TimeSeriesData>& points);
+
+} // namespace server
+} // namespace sage_tsdb
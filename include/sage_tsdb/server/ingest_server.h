@@ -0,0 +1,168 @@
+#pragma once
+
+#include "ingest_protocol.h"
+#include "../core/table_manager.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace sage_tsdb {
+namespace server {
+
+struct IngestServerConfig {
+    std::string bind_address = "0.0.0.0";
+    int tcp_port = 8089;                 // 0 picks a free port, -1 disables TCP
+    int udp_port = -1;                   // 0 picks a free port, -1 disables UDP
+    size_t batch_points = 5000;          // Flush a connection's batch at this size
+    std::chrono::milliseconds flush_interval{100};  // ... or when it is this old
+    size_t max_connections = 1024;
+    size_t max_line_bytes = 1024 * 1024; // Longer unterminated input closes the connection
+    bool create_tables = true;           // Create missing stream tables on first write
+    TableConfig table_config;            // Config of tables created by the server
+    LineProtocolOptions protocol;
+};
+
+/**
+ * @brief Counters of one TCP connection (or of the UDP socket)
+ */
+struct ConnectionStats {
+    uint64_t id = 0;
+    std::string peer;
+    bool udp = false;
+    bool binary = false;
+    uint64_t bytes_received = 0;
+    uint64_t points_received = 0;
+    uint64_t points_written = 0;
+    uint64_t batches = 0;
+    uint64_t parse_errors = 0;           // Rejected lines or frames
+    uint64_t write_errors = 0;           // Points the tables refused
+    std::chrono::steady_clock::time_point connected_at;
+
+    double seconds() const;              // Since connected_at
+    double points_per_second() const;    // Received points
+    double bytes_per_second() const;
+};
+
+struct IngestServerStats {
+    uint64_t connections_accepted = 0;
+    uint64_t connections_rejected = 0;   // Over max_connections
+    uint64_t active_connections = 0;
+    uint64_t points_written = 0;
+    uint64_t parse_errors = 0;
+    uint64_t write_errors = 0;
+    uint64_t backpressure_pauses = 0;    // Times reading stopped for the memory budget
+    bool paused = false;
+};
+
+/**
+ * @brief Network ingest into a TableManager
+ *
+ * One thread runs an epoll loop over a TCP listener, its connections and an
+ * optional UDP socket. Each connection parses into its own batch, keyed by
+ * table, which goes to TableManager::insertBatchToTables once it holds
+ * batch_points points or is flush_interval old; a closing connection
+ * flushes what it has. The UDP socket batches like one connection.
+ *
+ * Backpressure: while the manager's WriteBufferManager is over its soft
+ * limit the loop stops reading sockets, so TCP senders block on their full
+ * windows (UDP datagrams queue in, and may be dropped by, the kernel).
+ * Writes that do go through still wait for room inside the tables.
+ *
+ * Sockets are epoll-driven; io_uring is only used for SSTable reads.
+ */
+class IngestServer {
+public:
+    IngestServer(std::shared_ptr<TableManager> manager,
+                 IngestServerConfig config = IngestServerConfig{});
+    ~IngestServer();
+
+    IngestServer(const IngestServer&) = delete;
+    IngestServer& operator=(const IngestServer&) = delete;
+
+    /**
+     * @brief Bind the sockets and start the event loop thread
+     * @return false if a socket cannot be set up (see lastError())
+     */
+    bool start();
+
+    /**
+     * @brief Flush every batch, close all sockets and join the loop
+     */
+    void stop();
+
+    bool isRunning() const { return running_.load(); }
+
+    // Bound ports (useful with port 0); -1 when disabled or not started
+    int tcpPort() const { return tcp_port_; }
+    int udpPort() const { return udp_port_; }
+
+    // Open connections, with the UDP socket listed as one of them
+    std::vector<ConnectionStats> getConnectionStats() const;
+    IngestServerStats getStats() const;
+
+    std::string lastError() const;
+
+private:
+    struct Connection;
+
+    void run();
+    void acceptConnections();
+    bool readConnection(Connection& conn);
+    void readDatagrams();
+    bool consume(Connection& conn, const char* data, size_t size);
+    bool consumeLines(Connection& conn);
+    bool consumeFrames(Connection& conn);
+    void pointsAdded(Connection& conn, size_t count);
+    void publish(Connection& conn);
+    void flush(Connection& conn);
+    void flushDue(std::chrono::steady_clock::time_point now);
+    void closeConnection(int fd);
+    void setPaused(bool paused);
+    void closeAll();
+    void fail(const std::string& message);
+
+    std::shared_ptr<TableManager> manager_;
+    IngestServerConfig config_;
+
+    int epoll_fd_ = -1;
+    int wake_fd_ = -1;
+    int listen_fd_ = -1;
+    int udp_fd_ = -1;
+    int tcp_port_ = -1;
+    int udp_port_ = -1;
+
+    std::map<int, std::unique_ptr<Connection>> connections_;  // By fd
+    std::unique_ptr<Connection> udp_;
+    uint64_t next_id_ = 1;
+    std::vector<char> read_buffer_;
+    std::set<std::string> known_tables_;  // Tables seen to exist
+    bool paused_ = false;
+
+    std::atomic<bool> running_{false};
+    std::thread thread_;
+
+    mutable std::mutex stats_mutex_;     // Guards connections_ and the published counters
+    std::string last_error_;
+
+    // Server totals: written by the loop, read lock-free by getStats() and
+    // metrics scrapes (registered in the manager's MetricsRegistry)
+    Counter points_written_;
+    Counter parse_errors_;
+    Counter write_errors_;
+    Counter connections_accepted_;
+    Counter connections_rejected_;
+    Counter backpressure_pauses_;
+    std::atomic<uint64_t> active_connections_{0};
+    std::atomic<bool> paused_flag_{false};
+    std::vector<MetricsRegistry::Handle> metric_handles_;
+};
+
+} // namespace server
+} // namespace sage_tsdb
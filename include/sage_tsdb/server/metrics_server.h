@@ -0,0 +1,63 @@
+#pragma once
+
+#include "../core/metrics_registry.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace sage_tsdb {
+namespace server {
+
+struct MetricsServerConfig {
+    std::string bind_address = "0.0.0.0";
+    int port = 9273;                     // 0 picks a free port
+};
+
+/**
+ * @brief Minimal HTTP endpoint serving a MetricsRegistry to Prometheus
+ *
+ * Answers "GET /metrics" with the text exposition format and anything else
+ * with 404. One request per connection, handled on the server's own thread;
+ * a scrape only takes the registry's mutex, never a table lock.
+ */
+class MetricsServer {
+public:
+    MetricsServer(std::shared_ptr<MetricsRegistry> registry, MetricsServerConfig config = {});
+    ~MetricsServer();
+
+    MetricsServer(const MetricsServer&) = delete;
+    MetricsServer& operator=(const MetricsServer&) = delete;
+
+    bool start();
+    void stop();
+
+    bool isRunning() const { return running_.load(); }
+
+    // Bound port (useful with port 0); -1 when not started
+    int port() const { return port_; }
+
+    std::string lastError() const;
+
+private:
+    void run();
+    void serve(int fd);
+    void fail(const std::string& message);
+
+    std::shared_ptr<MetricsRegistry> registry_;
+    MetricsServerConfig config_;
+
+    int listen_fd_ = -1;
+    int wake_fd_ = -1;
+    int port_ = -1;
+
+    std::atomic<bool> running_{false};
+    std::thread thread_;
+
+    mutable std::mutex error_mutex_;
+    std::string last_error_;
+};
+
+} // namespace server
+} // namespace sage_tsdb
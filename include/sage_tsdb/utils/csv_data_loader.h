@@ -1,14 +1,12 @@
 #pragma once
 
-#include <string>
-#include <vector>
-#include <fstream>
-#include <sstream>
-#include <memory>
-#include <stdexcept>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <iostream>
-#include <algorithm>
+#include <string>
+#include <vector>
 #include "sage_tsdb/core/time_series_data.h"
 
 namespace sage_tsdb {
@@ -53,6 +51,9 @@ struct CSVRecord {
  * 2. 流式加载：逐行读取并通过回调函数处理
  * 
  * 数据格式：key,value,eventTime,arrivalTime
+ * 
+ * 文件以内存映射读取；批量加载按换行切成若干块并行解析（AVX2/SSE2 扫描分隔符，
+ * std::from_chars 解析数值），结果按文件顺序拼接。
  */
 class CSVDataLoader {
 public:
@@ -60,49 +61,18 @@ public:
      * @brief 构造函数
      * @param filepath CSV 文件路径
      * @param skip_header 是否跳过第一行（表头）
+     * @param threads 批量加载的解析线程数（0 表示硬件线程数）
      */
-    explicit CSVDataLoader(const std::string& filepath, bool skip_header = true)
-        : filepath_(filepath), skip_header_(skip_header) {}
+    explicit CSVDataLoader(const std::string& filepath, bool skip_header = true,
+                           size_t threads = 0)
+        : filepath_(filepath), skip_header_(skip_header), threads_(threads) {}
     
     /**
      * @brief 批量加载所有数据
      * @return 所有元组的向量
      * @throw std::runtime_error 文件打开失败或解析错误
      */
-    std::vector<PECJTuple> loadAll() {
-        std::vector<PECJTuple> tuples;
-        std::ifstream file(filepath_);
-        
-        if (!file.is_open()) {
-            throw std::runtime_error("Failed to open file: " + filepath_);
-        }
-        
-        std::string line;
-        int line_number = 0;
-        
-        // 跳过表头
-        if (skip_header_ && std::getline(file, line)) {
-            line_number++;
-        }
-        
-        while (std::getline(file, line)) {
-            line_number++;
-            if (line.empty() || line[0] == '#') {
-                continue;  // 跳过空行和注释
-            }
-            
-            try {
-                tuples.push_back(parseLine(line));
-            } catch (const std::exception& e) {
-                throw std::runtime_error(
-                    "Parse error at line " + std::to_string(line_number) + 
-                    " in file " + filepath_ + ": " + e.what()
-                );
-            }
-        }
-        
-        return tuples;
-    }
+    std::vector<PECJTuple> loadAll();
     
     /**
      * @brief 流式加载数据，每读取一行就调用回调函数
@@ -110,46 +80,7 @@ public:
      * @param max_tuples 最多读取的元组数量（0 表示不限制）
      * @return 实际读取的元组数量
      */
-    size_t loadStream(std::function<void(const PECJTuple&)> callback, size_t max_tuples = 0) {
-        std::ifstream file(filepath_);
-        
-        if (!file.is_open()) {
-            throw std::runtime_error("Failed to open file: " + filepath_);
-        }
-        
-        std::string line;
-        int line_number = 0;
-        size_t tuple_count = 0;
-        
-        // 跳过表头
-        if (skip_header_ && std::getline(file, line)) {
-            line_number++;
-        }
-        
-        while (std::getline(file, line)) {
-            line_number++;
-            if (line.empty() || line[0] == '#') {
-                continue;
-            }
-            
-            try {
-                PECJTuple tuple = parseLine(line);
-                callback(tuple);
-                tuple_count++;
-                
-                if (max_tuples > 0 && tuple_count >= max_tuples) {
-                    break;
-                }
-            } catch (const std::exception& e) {
-                throw std::runtime_error(
-                    "Parse error at line " + std::to_string(line_number) + 
-                    " in file " + filepath_ + ": " + e.what()
-                );
-            }
-        }
-        
-        return tuple_count;
-    }
+    size_t loadStream(std::function<void(const PECJTuple&)> callback, size_t max_tuples = 0);
     
     /**
      * @brief 按到达时间顺序加载数据（用于重放）
@@ -184,73 +115,24 @@ public:
      * @brief Load data from a PECJ-format CSV file (静态方法，兼容旧API)
      * @param filename Path to CSV file
      * @param time_unit_multiplier Multiplier to convert time to microseconds (e.g., 1000 for ms->us, 1 for us->us)
+     * @param threads Parser threads (0 = hardware threads)
      * @return Vector of CSV records, empty on error
      */
-    static std::vector<CSVRecord> loadFromFile(const std::string& filename, int64_t time_unit_multiplier = 1) {
-        std::vector<CSVRecord> records;
-        std::ifstream file(filename);
-        
-        if (!file.is_open()) {
-            std::cerr << "❌ Failed to open file: " << filename << std::endl;
-            return records;
-        }
-        
-        std::string line;
-        bool is_header = true;
-        size_t line_num = 0;
-        
-        // Column indices (default for PECJ format)
-        int idx_key = 0, idx_value = 1, idx_event_time = 2, idx_arrival_time = 3;
-        
-        while (std::getline(file, line)) {
-            line_num++;
-            
-            // Remove trailing \r if present (Windows line endings)
-            if (!line.empty() && line.back() == '\r') {
-                line.pop_back();
-            }
-            
-            if (line.empty()) continue;
-            
-            std::vector<std::string> tokens = split(line, ',');
-            
-            if (is_header) {
-                // Parse header to find column indices
-                for (size_t i = 0; i < tokens.size(); i++) {
-                    if (tokens[i] == "key") idx_key = i;
-                    else if (tokens[i] == "value") idx_value = i;
-                    else if (tokens[i] == "eventTime") idx_event_time = i;
-                    else if (tokens[i] == "arrivalTime" || tokens[i] == "arriveTime") {
-                        idx_arrival_time = i;
-                    }
-                }
-                is_header = false;
-                continue;
-            }
-            
-            // Parse data row
-            if (tokens.size() < 4) {
-                std::cerr << "⚠ Skipping invalid line " << line_num << ": " << line << std::endl;
-                continue;
-            }
-            
-            try {
-                CSVRecord record;
-                record.key = std::stoll(tokens[idx_key]);
-                record.value = std::stod(tokens[idx_value]);
-                // Apply time unit conversion (e.g., milliseconds to microseconds)
-                record.event_time = static_cast<int64_t>(std::stod(tokens[idx_event_time]) * time_unit_multiplier);
-                record.arrival_time = static_cast<int64_t>(std::stod(tokens[idx_arrival_time]) * time_unit_multiplier);
-                records.push_back(record);
-            } catch (const std::exception& e) {
-                std::cerr << "⚠ Error parsing line " << line_num << ": " << e.what() << std::endl;
-            }
-        }
-        
-        file.close();
-        std::cout << "✓ Loaded " << records.size() << " records from " << filename << std::endl;
-        return records;
-    }
+    static std::vector<CSVRecord> loadFromFile(const std::string& filename,
+                                               int64_t time_unit_multiplier = 1,
+                                               size_t threads = 0);
+    
+    /**
+     * @brief Load a PECJ-format CSV file as points of stream_name
+     * 
+     * Same rows and points as toTimeSeriesData over loadFromFile, but the
+     * points are built by the parser threads. The result can be moved
+     * straight into StreamTable::insertBatch.
+     */
+    static std::vector<TimeSeriesData> loadTimeSeries(const std::string& filename,
+                                                      const std::string& stream_name,
+                                                      int64_t time_unit_multiplier = 1,
+                                                      size_t threads = 0);
     
     /**
      * @brief Convert CSV record to TimeSeriesData (静态方法，兼容旧API)
@@ -263,8 +145,8 @@ public:
         data.timestamp = record.event_time;  // Use event_time as timestamp
         data.tags["stream"] = stream_name;
         data.tags["key"] = std::to_string(record.key);
-        data.fields["value"] = std::to_string(record.value);
-        data.fields["arrival_time"] = std::to_string(record.arrival_time);
+        data.fields["value"] = record.value;
+        data.fields["arrival_time"] = record.arrival_time;
         return data;
     }
     
@@ -297,57 +179,9 @@ public:
     }
 
 private:
-    /**
-     * @brief 解析一行 CSV 数据
-     * @param line CSV 行字符串
-     * @return 解析后的 PECJTuple
-     */
-    PECJTuple parseLine(const std::string& line) {
-        std::stringstream ss(line);
-        std::string token;
-        std::vector<std::string> tokens;
-        
-        // 分割逗号
-        while (std::getline(ss, token, ',')) {
-            tokens.push_back(token);
-        }
-        
-        if (tokens.size() != 4) {
-            throw std::runtime_error(
-                "Invalid CSV format. Expected 4 columns (key,value,eventTime,arrivalTime), got " + 
-                std::to_string(tokens.size())
-            );
-        }
-        
-        try {
-            PECJTuple tuple;
-            tuple.key = std::stoull(tokens[0]);
-            tuple.value = std::stod(tokens[1]);
-            tuple.eventTime = std::stoull(tokens[2]);
-            tuple.arrivalTime = std::stoull(tokens[3]);
-            return tuple;
-        } catch (const std::exception& e) {
-            throw std::runtime_error("Failed to parse numeric values: " + std::string(e.what()));
-        }
-    }
-    
-    /**
-     * @brief Split string by delimiter (静态辅助函数)
-     */
-    static std::vector<std::string> split(const std::string& str, char delimiter) {
-        std::vector<std::string> tokens;
-        std::stringstream ss(str);
-        std::string token;
-        
-        while (std::getline(ss, token, delimiter)) {
-            tokens.push_back(token);
-        }
-        
-        return tokens;
-    }
-    
     std::string filepath_;
     bool skip_header_;
+    size_t threads_;
 };
 
 }  // namespace utils
@@ -15,6 +15,89 @@
 namespace py = pybind11;
 using namespace sage_tsdb;
 
+namespace pybind11 {
+namespace detail {
+
+// Field values map to Python bool, int, float and str
+template <>
+struct type_caster<FieldValue> {
+    PYBIND11_TYPE_CASTER(FieldValue, const_name("FieldValue"));
+
+    bool load(handle src, bool) {
+        if (PyBool_Check(src.ptr())) {
+            value = FieldValue(src.ptr() == Py_True);
+        } else if (PyLong_Check(src.ptr())) {
+            value = FieldValue(src.cast<int64_t>());
+        } else if (PyFloat_Check(src.ptr())) {
+            value = FieldValue(src.cast<double>());
+        } else if (PyUnicode_Check(src.ptr())) {
+            value = FieldValue(src.cast<std::string>());
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    static handle cast(const FieldValue& field, return_value_policy, handle) {
+        switch (field.type()) {
+            case FieldValue::Type::INT64:  return PyLong_FromLongLong(field.as_int64());
+            case FieldValue::Type::DOUBLE: return PyFloat_FromDouble(field.as_double());
+            case FieldValue::Type::BOOL:   return py::bool_(field.as_bool()).release();
+            default:                       return py::str(*field.if_string()).release();
+        }
+    }
+};
+
+} // namespace detail
+} // namespace pybind11
+
+namespace {
+
+using Int64Array = py::array_t<int64_t, py::array::c_style | py::array::forcecast>;
+using DoubleArray = py::array_t<double, py::array::c_style | py::array::forcecast>;
+
+/**
+ * @brief Add columns from NumPy arrays without building per-point objects
+ *
+ * C-contiguous int64 / float64 arrays are read in place through the
+ * buffer protocol (others are converted once); the GIL is released while
+ * the points are inserted.
+ */
+size_t addNumpy(TimeSeriesDB& db, const Int64Array& timestamps, const DoubleArray& values,
+                const Tags& tags) {
+    if (timestamps.ndim() != 1 || values.ndim() != 1 || timestamps.size() != values.size()) {
+        throw py::value_error("add_numpy: timestamps and values must be 1-D arrays of equal length");
+    }
+    const int64_t* ts = timestamps.data();
+    const double* vs = values.data();
+    auto count = static_cast<size_t>(timestamps.size());
+    py::gil_scoped_release release;
+    return db.add_columns(ts, vs, count, tags);
+}
+
+/**
+ * @brief Query into NumPy arrays (timestamps, values)
+ *
+ * The query and the column copy run without the GIL and read the points
+ * in place; vector values contribute their first element.
+ */
+py::tuple queryNumpy(const TimeSeriesDB& db, const QueryConfig& config) {
+    TimeSeriesIndex::ResultView view;
+    {
+        py::gil_scoped_release release;
+        view = db.query_view(config);
+    }
+    Int64Array timestamps(static_cast<py::ssize_t>(view.size()));
+    DoubleArray values(static_cast<py::ssize_t>(view.size()));
+    {
+        py::gil_scoped_release release;
+        view.copy_columns(timestamps.mutable_data(), values.mutable_data());
+    }
+    return py::make_tuple(std::move(timestamps), std::move(values));
+}
+
+} // anonymous namespace
+
 PYBIND11_MODULE(_sage_tsdb, m) {
     m.doc() = "SAGE TSDB - High-performance time series database C++ bindings";
 
@@ -99,6 +182,24 @@ PYBIND11_MODULE(_sage_tsdb, m) {
              py::arg("time_range"),
              py::arg("filter_tags") = Tags{},
              "Query with time range")
+        .def("add_numpy", &addNumpy,
+             py::arg("timestamps"),
+             py::arg("values"),
+             py::arg("tags") = Tags{},
+             "Add scalar points of one series from int64 timestamp and float64 value arrays")
+        .def("query_numpy", &queryNumpy,
+             py::arg("config"),
+             "Query into (timestamps, values) NumPy arrays")
+        .def("query_numpy", [](const TimeSeriesDB& db, const TimeRange& time_range,
+                               const Tags& filter_tags) {
+                 QueryConfig config;
+                 config.time_range = time_range;
+                 config.filter_tags = filter_tags;
+                 return queryNumpy(db, config);
+             },
+             py::arg("time_range"),
+             py::arg("filter_tags") = Tags{},
+             "Query a time range into (timestamps, values) NumPy arrays")
         .def("size", &TimeSeriesDB::size,
              "Get number of data points")
         .def("clear", &TimeSeriesDB::clear,
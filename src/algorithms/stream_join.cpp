@@ -4,60 +4,67 @@
 
 namespace sage_tsdb {
 
+namespace {
+
+// Heap order: earliest timestamp on top
+bool later(const TimeSeriesData& a, const TimeSeriesData& b) {
+    return a.timestamp > b.timestamp;
+}
+
+bool earlier(const TimeSeriesData& a, const TimeSeriesData& b) {
+    return a.timestamp < b.timestamp;
+}
+
+} // anonymous namespace
+
 // StreamBuffer implementation
 StreamBuffer::StreamBuffer(int64_t max_delay)
-    : max_delay_(max_delay), watermark_(0) {}
+    : max_delay_(max_delay), watermark_(0), max_timestamp_(0),
+      has_data_(false), late_count_(0) {}
 
 void StreamBuffer::add(const TimeSeriesData& data) {
-    buffer_.push_back(data);
-    update_watermark();
+    push(data);
 }
 
 void StreamBuffer::add_batch(const std::vector<TimeSeriesData>& data) {
+    heap_.reserve(heap_.size() + data.size());
     for (const auto& d : data) {
-        buffer_.push_back(d);
+        push(d);
     }
-    update_watermark();
+}
+
+void StreamBuffer::push(const TimeSeriesData& data) {
+    if (has_data_ && data.timestamp <= watermark_) {
+        ++late_count_;
+    }
+    if (!has_data_ || data.timestamp > max_timestamp_) {
+        max_timestamp_ = data.timestamp;
+        watermark_ = max_timestamp_ - max_delay_;
+        has_data_ = true;
+    }
+    heap_.push_back(data);
+    std::push_heap(heap_.begin(), heap_.end(), later);
 }
 
 std::vector<TimeSeriesData> StreamBuffer::get_ready_data() {
     std::vector<TimeSeriesData> ready;
     
-    // Sort buffer
-    std::sort(buffer_.begin(), buffer_.end(),
-             [](const TimeSeriesData& a, const TimeSeriesData& b) {
-                 return a.timestamp < b.timestamp;
-             });
-    
-    // Extract ready data (before watermark)
-    auto it = buffer_.begin();
-    while (it != buffer_.end() && it->timestamp <= watermark_) {
-        ready.push_back(*it);
-        ++it;
+    // Pop ready data (before watermark) in timestamp order
+    while (!heap_.empty() && heap_.front().timestamp <= watermark_) {
+        std::pop_heap(heap_.begin(), heap_.end(), later);
+        ready.push_back(std::move(heap_.back()));
+        heap_.pop_back();
     }
     
-    // Remove ready data from buffer
-    buffer_.erase(buffer_.begin(), it);
-    
     return ready;
 }
 
 void StreamBuffer::clear() {
-    buffer_.clear();
+    heap_.clear();
     watermark_ = 0;
-}
-
-void StreamBuffer::update_watermark() {
-    if (!buffer_.empty()) {
-        // Find latest timestamp
-        int64_t max_ts = buffer_[0].timestamp;
-        for (const auto& data : buffer_) {
-            if (data.timestamp > max_ts) {
-                max_ts = data.timestamp;
-            }
-        }
-        watermark_ = max_ts - max_delay_;
-    }
+    max_timestamp_ = 0;
+    has_data_ = false;
+    late_count_ = 0;
 }
 
 // StreamJoin implementation
@@ -91,15 +98,33 @@ std::vector<std::pair<TimeSeriesData, TimeSeriesData>> StreamJoin::process_join(
     const std::vector<TimeSeriesData>& right_stream) {
     
     // Add data to buffers
+    int64_t left_late = left_buffer_.late_count();
+    int64_t right_late = right_buffer_.late_count();
     left_buffer_.add_batch(left_stream);
     right_buffer_.add_batch(right_stream);
+    late_arrivals_ += (left_buffer_.late_count() - left_late) +
+                      (right_buffer_.late_count() - right_late);
     
     // Get ready data
     auto left_ready = left_buffer_.get_ready_data();
     auto right_ready = right_buffer_.get_ready_data();
     
-    // Perform join
-    auto joined = join_data(left_ready, right_ready);
+    // Join both sides in timestamp order against the window state
+    std::vector<std::pair<TimeSeriesData, TimeSeriesData>> joined;
+    size_t l = 0;
+    size_t r = 0;
+    while (l < left_ready.size() || r < right_ready.size()) {
+        if (r == right_ready.size() ||
+            (l < left_ready.size() && left_ready[l].timestamp <= right_ready[r].timestamp)) {
+            join_tuple(left_ready[l++], true, joined);
+        } else {
+            join_tuple(right_ready[r++], false, joined);
+        }
+    }
+    
+    // No later tuple of the other side can reach these any more
+    left_state_.expire(right_buffer_.get_watermark() - window_size_);
+    right_state_.expire(left_buffer_.get_watermark() - window_size_);
     
     total_joined_ += joined.size();
     
@@ -113,6 +138,8 @@ void StreamJoin::set_join_predicate(JoinPredicate predicate) {
 void StreamJoin::reset() {
     left_buffer_.clear();
     right_buffer_.clear();
+    left_state_.clear();
+    right_state_.clear();
     total_joined_ = 0;
     late_arrivals_ = 0;
     dropped_late_ = 0;
@@ -125,78 +152,90 @@ std::map<std::string, int64_t> StreamJoin::get_stats() const {
         {"dropped_late", dropped_late_},
         {"left_buffer_size", static_cast<int64_t>(left_buffer_.size())},
         {"right_buffer_size", static_cast<int64_t>(right_buffer_.size())},
+        {"left_state_size", static_cast<int64_t>(left_state_.size)},
+        {"right_state_size", static_cast<int64_t>(right_state_.size)},
         {"left_watermark", left_buffer_.get_watermark()},
         {"right_watermark", right_buffer_.get_watermark()}
     };
 }
 
-std::vector<std::pair<TimeSeriesData, TimeSeriesData>> StreamJoin::join_data(
-    const std::vector<TimeSeriesData>& left_data,
-    const std::vector<TimeSeriesData>& right_data) {
-    
-    if (!join_key_.empty()) {
-        return hash_join(left_data, right_data);
-    } else {
-        return nested_loop_join(left_data, right_data);
-    }
+void StreamJoin::WindowState::clear() {
+    partitions.clear();
+    horizon = std::numeric_limits<int64_t>::min();
+    size = 0;
 }
 
-std::vector<std::pair<TimeSeriesData, TimeSeriesData>> StreamJoin::hash_join(
-    const std::vector<TimeSeriesData>& left_data,
-    const std::vector<TimeSeriesData>& right_data) {
-    
-    std::vector<std::pair<TimeSeriesData, TimeSeriesData>> joined;
-    
-    // Build hash table for right stream
-    std::unordered_map<std::string, std::vector<TimeSeriesData>> right_hash;
-    for (const auto& right : right_data) {
-        auto it = right.tags.find(join_key_);
-        if (it != right.tags.end()) {
-            right_hash[it->second].push_back(right);
-        }
+void StreamJoin::WindowState::expire(int64_t new_horizon) {
+    if (new_horizon <= horizon) {
+        return;
     }
-    
-    // Probe with left stream
-    for (const auto& left : left_data) {
-        auto it = left.tags.find(join_key_);
-        if (it != left.tags.end()) {
-            auto hash_it = right_hash.find(it->second);
-            if (hash_it != right_hash.end()) {
-                for (const auto& right : hash_it->second) {
-                    // Check window condition
-                    if (std::abs(left.timestamp - right.timestamp) <= window_size_) {
-                        // Check custom predicate if provided
-                        if (!join_predicate_ || join_predicate_(left, right)) {
-                            joined.emplace_back(left, right);
-                        }
-                    }
-                }
-            }
+    horizon = new_horizon;
+    for (auto it = partitions.begin(); it != partitions.end();) {
+        auto& tuples = it->second;
+        while (!tuples.empty() && tuples.front().timestamp < horizon) {
+            tuples.pop_front();
+            --size;
+        }
+        if (tuples.empty()) {
+            it = partitions.erase(it);
+        } else {
+            ++it;
         }
     }
-    
-    return joined;
 }
 
-std::vector<std::pair<TimeSeriesData, TimeSeriesData>> StreamJoin::nested_loop_join(
-    const std::vector<TimeSeriesData>& left_data,
-    const std::vector<TimeSeriesData>& right_data) {
-    
-    std::vector<std::pair<TimeSeriesData, TimeSeriesData>> joined;
-    
-    for (const auto& left : left_data) {
-        for (const auto& right : right_data) {
-            // Check window condition
-            if (std::abs(left.timestamp - right.timestamp) <= window_size_) {
-                // Check custom predicate if provided
-                if (!join_predicate_ || join_predicate_(left, right)) {
-                    joined.emplace_back(left, right);
-                }
+bool StreamJoin::partition_key(const TimeSeriesData& tuple, std::string& key) const {
+    if (join_key_.empty()) {
+        key.clear();
+        return true;
+    }
+    auto it = tuple.tags.find(join_key_);
+    if (it == tuple.tags.end()) {
+        return false;
+    }
+    key = it->second;
+    return true;
+}
+
+void StreamJoin::join_tuple(const TimeSeriesData& tuple, bool is_left,
+                            std::vector<std::pair<TimeSeriesData, TimeSeriesData>>& joined) {
+    std::string key;
+    if (!partition_key(tuple, key)) {
+        return;
+    }
+    WindowState& own = is_left ? left_state_ : right_state_;
+    WindowState& other = is_left ? right_state_ : left_state_;
+    
+    // Probe the matching partition over the window range
+    auto partition = other.partitions.find(key);
+    if (partition != other.partitions.end()) {
+        auto& tuples = partition->second;
+        auto it = std::lower_bound(tuples.begin(), tuples.end(), tuple.timestamp - window_size_,
+                                   [](const TimeSeriesData& t, int64_t ts) {
+                                       return t.timestamp < ts;
+                                   });
+        for (; it != tuples.end() && it->timestamp <= tuple.timestamp + window_size_; ++it) {
+            const TimeSeriesData& left = is_left ? tuple : *it;
+            const TimeSeriesData& right = is_left ? *it : tuple;
+            // Check custom predicate if provided
+            if (!join_predicate_ || join_predicate_(left, right)) {
+                joined.emplace_back(left, right);
             }
         }
     }
     
-    return joined;
+    // Store; late tuples go to their sorted position
+    if (tuple.timestamp < own.horizon) {
+        ++dropped_late_;
+        return;
+    }
+    auto& tuples = own.partitions[key];
+    if (tuples.empty() || tuples.back().timestamp <= tuple.timestamp) {
+        tuples.push_back(tuple);
+    } else {
+        tuples.insert(std::upper_bound(tuples.begin(), tuples.end(), tuple, earlier), tuple);
+    }
+    ++own.size;
 }
 
 } // namespace sage_tsdb
@@ -1,15 +1,363 @@
 #include "sage_tsdb/algorithms/window_aggregator.h"
+#include "sage_tsdb/core/aggregation.h"
 #include <algorithm>
-#include <cmath>
-#include <numeric>
+#include <deque>
+#include <limits>
 
 namespace sage_tsdb {
 
+namespace {
+
+/**
+ * @brief FIFO of values with amortized O(1) min and max (two stacks)
+ *
+ * Each stack entry carries the min/max of itself and everything below it;
+ * pop() refills the out stack from the in stack when it runs dry.
+ */
+class MinMaxQueue {
+public:
+    void push(double value) {
+        in_.push_back(in_.empty() ? Item{value, value, value}
+                                  : Item{value, std::min(value, in_.back().min),
+                                         std::max(value, in_.back().max)});
+    }
+    
+    void pop() {
+        if (out_.empty()) {
+            while (!in_.empty()) {
+                double value = in_.back().value;
+                in_.pop_back();
+                out_.push_back(out_.empty() ? Item{value, value, value}
+                                            : Item{value, std::min(value, out_.back().min),
+                                                   std::max(value, out_.back().max)});
+            }
+        }
+        out_.pop_back();
+    }
+    
+    double min() const {
+        if (in_.empty()) return out_.back().min;
+        if (out_.empty()) return in_.back().min;
+        return std::min(in_.back().min, out_.back().min);
+    }
+    
+    double max() const {
+        if (in_.empty()) return out_.back().max;
+        if (out_.empty()) return in_.back().max;
+        return std::max(in_.back().max, out_.back().max);
+    }
+    
+    // Oldest value first
+    template <typename Fn>
+    void for_each(Fn&& fn) const {
+        for (auto it = out_.rbegin(); it != out_.rend(); ++it) fn(it->value);
+        for (const auto& item : in_) fn(item.value);
+    }
+    
+    void clear() {
+        in_.clear();
+        out_.clear();
+    }
+
+private:
+    struct Item {
+        double value;
+        double min;
+        double max;
+    };
+    
+    std::vector<Item> in_;
+    std::vector<Item> out_;
+};
+
+// Calls fn on every value of point (all elements of a vector point)
+template <typename Fn>
+void for_each_value(const TimeSeriesData& point, Fn&& fn) {
+    if (const auto* scalar = std::get_if<double>(&point.value)) {
+        fn(*scalar);
+    } else {
+        for (double value : std::get<std::vector<double>>(point.value)) {
+            fn(value);
+        }
+    }
+}
+
+} // anonymous namespace
+
+/**
+ * @brief Incremental window state shared by push() and process()
+ *
+ * Tumbling and session windows keep one running BlockSummary plus the
+ * merged tags. Sliding windows keep the points of the oldest open window
+ * in arrival order: sum, sum of squares and count are subtracted when a
+ * point slides out, min/max come from a MinMaxQueue and the merged tags
+ * remember which point set each key last, so evicting it drops the key.
+ * The sketches of quantile/distinct are only kept when that is the
+ * aggregation.
+ */
+class WindowAggregator::Stream {
+public:
+    explicit Stream(const WindowAggregator& owner)
+        : owner_(owner), sketches_(needs_sketches(owner.aggregation_)) {
+        summary_.sketched = sketches_;
+    }
+    
+    // Points come in timestamp order, none older than the watermark
+    void push(const TimeSeriesData& point, std::vector<TimeSeriesData>& out) {
+        ++owner_.data_points_processed_;
+        
+        switch (owner_.window_type_) {
+            case WindowType::TUMBLING: {
+                int64_t start = owner_.align_to_window(point.timestamp);
+                if (open_ && start != window_start_) {
+                    emit(out);
+                }
+                if (!open_) {
+                    open(start);
+                }
+                add(point);
+                break;
+            }
+            case WindowType::SLIDING:
+                if (!started_) {
+                    window_start_ = owner_.align_to_window(point.timestamp);
+                }
+                close_sliding(point.timestamp, out);
+                if (point.timestamp >= window_start_) {
+                    add_sliding(point);
+                }
+                break;
+            case WindowType::SESSION:
+                if (open_ && point.timestamp - last_timestamp_ > owner_.session_gap_) {
+                    emit(out);
+                }
+                if (!open_) {
+                    open(point.timestamp);
+                }
+                add(point);
+                break;
+        }
+        
+        started_ = true;
+        last_timestamp_ = point.timestamp;
+    }
+    
+    void advance_watermark(int64_t watermark, std::vector<TimeSeriesData>& out) {
+        if (watermark <= watermark_) {
+            return;
+        }
+        watermark_ = watermark;
+        if (!started_) {
+            return;
+        }
+        
+        switch (owner_.window_type_) {
+            case WindowType::TUMBLING:
+                if (open_ && window_start_ + owner_.window_size_ <= watermark) {
+                    emit(out);
+                }
+                break;
+            case WindowType::SLIDING:
+                close_sliding(watermark, out);
+                break;
+            case WindowType::SESSION:
+                // Any later point is more than session_gap past the last one
+                if (open_ && watermark - last_timestamp_ > owner_.session_gap_) {
+                    emit(out);
+                }
+                break;
+        }
+    }
+    
+    void flush(std::vector<TimeSeriesData>& out) {
+        if (owner_.window_type_ == WindowType::SLIDING) {
+            while (!points_.empty()) {
+                evict_before(window_start_);
+                if (!points_.empty()) {
+                    emit_sliding(out);
+                }
+                window_start_ += owner_.slide_interval_;
+                ++owner_.windows_created_;
+            }
+        } else if (open_) {
+            emit(out);
+        }
+        
+        // The stream starts over
+        started_ = false;
+        watermark_ = std::numeric_limits<int64_t>::min();
+        next_seq_ = 0;
+    }
+
+private:
+    // Evicted points are remembered by their aggregates only
+    struct Point {
+        int64_t timestamp;
+        uint64_t seq;
+        uint64_t count;
+        double sum;
+        double sum_squares;
+        double first;
+        double last;
+        std::shared_ptr<const Tags> tags;
+    };
+    
+    void open(int64_t start) {
+        open_ = true;
+        window_start_ = start;
+        ++owner_.windows_created_;
+    }
+    
+    void add(const TimeSeriesData& point) {
+        for_each_value(point, [&](double value) { summary_.add(point.timestamp, value); });
+        for (const auto& [key, value] : point.tags) {
+            tags_[key] = value;
+        }
+        ++points_in_window_;
+    }
+    
+    void emit(std::vector<TimeSeriesData>& out) {
+        out.push_back(result(summary_, tags_, points_in_window_));
+        summary_ = BlockSummary{};
+        summary_.sketched = sketches_;
+        tags_.clear();
+        points_in_window_ = 0;
+        open_ = false;
+    }
+    
+    void add_sliding(const TimeSeriesData& point) {
+        Point entry{point.timestamp, next_seq_++, 0, 0.0, 0.0, 0.0, 0.0, nullptr};
+        for_each_value(point, [&](double value) {
+            if (entry.count == 0) entry.first = value;
+            entry.last = value;
+            entry.sum += value;
+            entry.sum_squares += value * value;
+            ++entry.count;
+            values_.push(value);
+        });
+        summary_.count += entry.count;
+        summary_.sum += entry.sum;
+        summary_.sum_squares += entry.sum_squares;
+        
+        // Runs of points with the same tags share one copy
+        if (!points_.empty() && *points_.back().tags == point.tags) {
+            entry.tags = points_.back().tags;
+        } else {
+            entry.tags = std::make_shared<const Tags>(point.tags);
+        }
+        for (const auto& [key, value] : point.tags) {
+            sliding_tags_[key] = {value, entry.seq};
+        }
+        points_.push_back(std::move(entry));
+    }
+    
+    void evict_before(int64_t start) {
+        while (!points_.empty() && points_.front().timestamp < start) {
+            const Point& entry = points_.front();
+            for (uint64_t i = 0; i < entry.count; ++i) {
+                values_.pop();
+            }
+            summary_.count -= entry.count;
+            summary_.sum -= entry.sum;
+            summary_.sum_squares -= entry.sum_squares;
+            for (const auto& [key, value] : *entry.tags) {
+                auto it = sliding_tags_.find(key);
+                if (it != sliding_tags_.end() && it->second.second == entry.seq) {
+                    sliding_tags_.erase(it);  // No later point in the window sets key
+                }
+            }
+            points_.pop_front();
+        }
+        if (points_.empty()) {
+            // Start from exact zeros instead of accumulated rounding
+            summary_ = BlockSummary{};
+            summary_.sketched = sketches_;
+            values_.clear();
+        }
+    }
+    
+    // Completes the windows ending at or before until
+    void close_sliding(int64_t until, std::vector<TimeSeriesData>& out) {
+        const int64_t size = owner_.window_size_;
+        const int64_t slide = owner_.slide_interval_;
+        while (window_start_ + size <= until) {
+            evict_before(window_start_);
+            if (points_.empty()) {
+                // Skip the run of empty windows in one step
+                int64_t skipped = (until - size - window_start_) / slide + 1;
+                window_start_ += skipped * slide;
+                owner_.windows_created_ += skipped;
+                break;
+            }
+            emit_sliding(out);
+            window_start_ += slide;
+            ++owner_.windows_created_;
+        }
+        evict_before(window_start_);
+    }
+    
+    void emit_sliding(std::vector<TimeSeriesData>& out) {
+        BlockSummary summary = summary_;
+        if (summary.count > 0) {
+            summary.min = values_.min();
+            summary.max = values_.max();
+            auto first = std::find_if(points_.begin(), points_.end(),
+                                      [](const Point& p) { return p.count > 0; });
+            auto last = std::find_if(points_.rbegin(), points_.rend(),
+                                     [](const Point& p) { return p.count > 0; });
+            summary.first = first->first;
+            summary.last = last->last;
+            if (sketches_) {
+                values_.for_each([&](double value) {
+                    summary.quantiles.add(value);
+                    summary.distinct.add(value);
+                });
+            }
+        }
+        Tags tags;
+        for (const auto& [key, value] : sliding_tags_) {
+            tags.emplace_hint(tags.end(), key, value.first);
+        }
+        out.push_back(result(summary, tags, points_.size()));
+    }
+    
+    TimeSeriesData result(const BlockSummary& summary, const Tags& tags, size_t points) const {
+        double value = summary.count > 0 ? summary.value(owner_.aggregation_, owner_.quantile_)
+                                         : 0.0;
+        TimeSeriesData data(window_start_, value, tags);
+        data.fields["window_size"] = points;
+        ++owner_.windows_completed_;
+        return data;
+    }
+    
+    const WindowAggregator& owner_;
+    const bool sketches_;
+    
+    bool started_ = false;
+    int64_t last_timestamp_ = 0;
+    int64_t watermark_ = std::numeric_limits<int64_t>::min();
+    
+    // Open window (tumbling/session) or oldest open window (sliding)
+    bool open_ = false;
+    int64_t window_start_ = 0;
+    BlockSummary summary_;
+    Tags tags_;
+    size_t points_in_window_ = 0;
+    
+    // Sliding only
+    std::deque<Point> points_;
+    MinMaxQueue values_;
+    std::map<std::string, std::pair<std::string, uint64_t>> sliding_tags_;  ///< Key -> value, seq of setter
+    uint64_t next_seq_ = 0;
+};
+
 WindowAggregator::WindowAggregator(const AlgorithmConfig& config)
     : TimeSeriesAlgorithm(config),
       windows_created_(0),
       windows_completed_(0),
-      data_points_processed_(0) {
+      data_points_processed_(0),
+      late_points_(0),
+      watermark_(std::numeric_limits<int64_t>::min()) {
     
     // Parse configuration
     std::string window_type_str = get_config("window_type", "tumbling");
@@ -40,11 +388,32 @@ WindowAggregator::WindowAggregator(const AlgorithmConfig& config)
         aggregation_ = AggregationType::MAX;
     } else if (agg_str == "count") {
         aggregation_ = AggregationType::COUNT;
+    } else if (agg_str == "first") {
+        aggregation_ = AggregationType::FIRST;
+    } else if (agg_str == "last") {
+        aggregation_ = AggregationType::LAST;
+    } else if (agg_str == "stddev") {
+        aggregation_ = AggregationType::STDDEV;
+    } else if (agg_str == "distinct") {
+        aggregation_ = AggregationType::DISTINCT;
+    } else if (agg_str == "quantile") {
+        aggregation_ = AggregationType::QUANTILE;
+    } else if (agg_str.size() > 1 && agg_str[0] == 'p' &&
+               agg_str.find_first_not_of("0123456789.", 1) == std::string::npos) {
+        aggregation_ = AggregationType::QUANTILE;   // p99 = quantile 0.99
     } else {
         aggregation_ = AggregationType::AVG;
     }
+    
+    if (aggregation_ == AggregationType::QUANTILE && agg_str != "quantile") {
+        quantile_ = std::stod(agg_str.substr(1)) / 100.0;
+    } else {
+        quantile_ = std::stod(get_config("quantile", "0.5"));
+    }
 }
 
+WindowAggregator::~WindowAggregator() = default;
+
 std::vector<TimeSeriesData> WindowAggregator::process(
     const std::vector<TimeSeriesData>& input) {
     
@@ -52,227 +421,107 @@ std::vector<TimeSeriesData> WindowAggregator::process(
         return {};
     }
     
-    // Sort input by timestamp
-    auto sorted_data = input;
-    std::sort(sorted_data.begin(), sorted_data.end(),
-             [](const TimeSeriesData& a, const TimeSeriesData& b) {
-                 return a.timestamp < b.timestamp;
-             });
+    auto by_time = [](const TimeSeriesData& a, const TimeSeriesData& b) {
+        return a.timestamp < b.timestamp;
+    };
     
-    // Apply windowing based on type
-    switch (window_type_) {
-        case WindowType::TUMBLING:
-            return tumbling_window(sorted_data);
-        case WindowType::SLIDING:
-            return sliding_window(sorted_data);
-        case WindowType::SESSION:
-            return session_window(sorted_data);
-        default:
-            return {};
+    // Sort only when needed
+    const std::vector<TimeSeriesData>* data = &input;
+    std::vector<TimeSeriesData> sorted_data;
+    if (!std::is_sorted(input.begin(), input.end(), by_time)) {
+        sorted_data = input;
+        std::stable_sort(sorted_data.begin(), sorted_data.end(), by_time);
+        data = &sorted_data;
     }
+    
+    std::vector<TimeSeriesData> results;
+    Stream stream(*this);
+    for (const auto& point : *data) {
+        stream.push(point, results);
+    }
+    stream.flush(results);
+    return results;
 }
 
-void WindowAggregator::reset() {
-    windows_created_ = 0;
-    windows_completed_ = 0;
-    data_points_processed_ = 0;
-}
+namespace {
 
-std::map<std::string, int64_t> WindowAggregator::get_stats() const {
-    return {
-        {"windows_created", windows_created_},
-        {"windows_completed", windows_completed_},
-        {"data_points_processed", data_points_processed_}
-    };
+// Heap order of pending points: the top is the earliest, first pushed
+struct LaterPending {
+    template <typename Pending>
+    bool operator()(const Pending& a, const Pending& b) const {
+        return a.point.timestamp != b.point.timestamp ? a.point.timestamp > b.point.timestamp
+                                                      : a.seq > b.seq;
+    }
+};
+
+} // anonymous namespace
+
+void WindowAggregator::push(const TimeSeriesData& point) {
+    if (point.timestamp < watermark_) {
+        ++late_points_;
+        return;
+    }
+    pending_.push_back({next_seq_++, point});
+    std::push_heap(pending_.begin(), pending_.end(), LaterPending{});
 }
 
-std::vector<TimeSeriesData> WindowAggregator::tumbling_window(
-    const std::vector<TimeSeriesData>& data) {
-    
-    std::vector<TimeSeriesData> results;
-    std::vector<TimeSeriesData> window_data;
-    
-    int64_t window_start = align_to_window(data[0].timestamp);
-    
-    for (const auto& point : data) {
-        int64_t point_window = align_to_window(point.timestamp);
-        
-        if (point_window == window_start) {
-            window_data.push_back(point);
-        } else {
-            // Complete current window
-            if (!window_data.empty()) {
-                results.push_back(aggregate_window(window_data, window_start));
-                ++windows_completed_;
-            }
-            
-            // Advance to new window
-            window_start = point_window;
-            window_data = {point};
-            ++windows_created_;
-        }
+void WindowAggregator::release_before(int64_t watermark, std::vector<TimeSeriesData>& results) {
+    if (!stream_) {
+        stream_ = std::make_unique<Stream>(*this);
     }
-    
-    // Complete last window
-    if (!window_data.empty()) {
-        results.push_back(aggregate_window(window_data, window_start));
-        ++windows_completed_;
+    const bool all = watermark == std::numeric_limits<int64_t>::max();
+    while (!pending_.empty() && (all || pending_.front().point.timestamp < watermark)) {
+        std::pop_heap(pending_.begin(), pending_.end(), LaterPending{});
+        stream_->push(pending_.back().point, results);
+        pending_.pop_back();
     }
-    
-    data_points_processed_ += data.size();
-    return results;
 }
 
-std::vector<TimeSeriesData> WindowAggregator::sliding_window(
-    const std::vector<TimeSeriesData>& data) {
-    
+std::vector<TimeSeriesData> WindowAggregator::advance_watermark(int64_t watermark) {
     std::vector<TimeSeriesData> results;
-    
-    int64_t window_start = align_to_window(data[0].timestamp);
-    int64_t last_timestamp = data.back().timestamp;
-    
-    while (window_start <= last_timestamp) {
-        int64_t window_end = window_start + window_size_;
-        
-        // Collect data in this window
-        std::vector<TimeSeriesData> window_data;
-        for (const auto& point : data) {
-            if (point.timestamp >= window_start && point.timestamp < window_end) {
-                window_data.push_back(point);
-            }
-        }
-        
-        if (!window_data.empty()) {
-            results.push_back(aggregate_window(window_data, window_start));
-            ++windows_completed_;
-        }
-        
-        // Slide to next window
-        window_start += slide_interval_;
-        ++windows_created_;
+    if (watermark <= watermark_) {
+        return results;
     }
-    
-    data_points_processed_ += data.size();
+    watermark_ = watermark;
+    release_before(watermark, results);
+    stream_->advance_watermark(watermark, results);
     return results;
 }
 
-std::vector<TimeSeriesData> WindowAggregator::session_window(
-    const std::vector<TimeSeriesData>& data) {
-    
+std::vector<TimeSeriesData> WindowAggregator::flush() {
     std::vector<TimeSeriesData> results;
-    std::vector<TimeSeriesData> session_data;
-    
-    int64_t session_start = data[0].timestamp;
-    int64_t last_timestamp = data[0].timestamp;
-    
-    for (const auto& point : data) {
-        if (point.timestamp - last_timestamp <= session_gap_) {
-            // Within session
-            session_data.push_back(point);
-        } else {
-            // Complete current session
-            if (!session_data.empty()) {
-                results.push_back(aggregate_window(session_data, session_start));
-                ++windows_completed_;
-            }
-            
-            // Start new session
-            session_data = {point};
-            session_start = point.timestamp;
-            ++windows_created_;
-        }
-        
-        last_timestamp = point.timestamp;
-    }
+    release_before(std::numeric_limits<int64_t>::max(), results);
+    stream_->flush(results);
     
-    // Complete last session
-    if (!session_data.empty()) {
-        results.push_back(aggregate_window(session_data, session_start));
-        ++windows_completed_;
-    }
-    
-    data_points_processed_ += data.size();
+    // The stream starts over
+    watermark_ = std::numeric_limits<int64_t>::min();
+    next_seq_ = 0;
     return results;
 }
 
-TimeSeriesData WindowAggregator::aggregate_window(
-    const std::vector<TimeSeriesData>& window_data,
-    int64_t window_timestamp) {
-    
-    // Extract values
-    std::vector<double> values;
-    for (const auto& point : window_data) {
-        if (point.is_scalar()) {
-            values.push_back(point.as_double());
-        } else {
-            auto vec = point.as_vector();
-            values.insert(values.end(), vec.begin(), vec.end());
-        }
-    }
-    
-    // Apply aggregation
-    double agg_value = apply_aggregation(values);
-    
-    // Merge tags
-    Tags merged_tags;
-    for (const auto& point : window_data) {
-        for (const auto& [key, value] : point.tags) {
-            merged_tags[key] = value;
-        }
-    }
-    
-    // Create result
-    TimeSeriesData result(window_timestamp, agg_value, merged_tags);
-    result.fields["window_size"] = std::to_string(window_data.size());
-    
-    return result;
+void WindowAggregator::reset() {
+    windows_created_ = 0;
+    windows_completed_ = 0;
+    data_points_processed_ = 0;
+    late_points_ = 0;
+    stream_.reset();
+    pending_.clear();
+    next_seq_ = 0;
+    watermark_ = std::numeric_limits<int64_t>::min();
 }
 
-int64_t WindowAggregator::align_to_window(int64_t timestamp) const {
-    return (timestamp / window_size_) * window_size_;
+std::map<std::string, int64_t> WindowAggregator::get_stats() const {
+    return {
+        {"windows_created", windows_created_},
+        {"windows_completed", windows_completed_},
+        {"data_points_processed", data_points_processed_},
+        {"late_points", late_points_},
+        {"buffered_points", static_cast<int64_t>(pending_.size())}
+    };
 }
 
-double WindowAggregator::apply_aggregation(const std::vector<double>& values) const {
-    if (values.empty()) {
-        return 0.0;
-    }
-    
-    switch (aggregation_) {
-        case AggregationType::SUM:
-            return std::accumulate(values.begin(), values.end(), 0.0);
-        
-        case AggregationType::AVG: {
-            double sum = std::accumulate(values.begin(), values.end(), 0.0);
-            return sum / values.size();
-        }
-        
-        case AggregationType::MIN:
-            return *std::min_element(values.begin(), values.end());
-        
-        case AggregationType::MAX:
-            return *std::max_element(values.begin(), values.end());
-        
-        case AggregationType::COUNT:
-            return static_cast<double>(values.size());
-        
-        case AggregationType::FIRST:
-            return values.front();
-        
-        case AggregationType::LAST:
-            return values.back();
-        
-        case AggregationType::STDDEV: {
-            double mean = std::accumulate(values.begin(), values.end(), 0.0) / values.size();
-            double sq_sum = 0.0;
-            for (double v : values) {
-                sq_sum += (v - mean) * (v - mean);
-            }
-            return std::sqrt(sq_sum / values.size());
-        }
-        
-        default:
-            return 0.0;
-    }
+int64_t WindowAggregator::align_to_window(int64_t timestamp) const {
+    return (timestamp / window_size_) * window_size_;
 }
 
 } // namespace sage_tsdb
@@ -0,0 +1,380 @@
+#include "sage_tsdb/cluster/cluster_protocol.h"
+#include "sage_tsdb/core/block_codec.h"
+#include "sage_tsdb/core/stream_table.h"
+#include "sage_tsdb/server/ingest_protocol.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <map>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <utility>
+
+namespace sage_tsdb {
+namespace cluster {
+
+namespace {
+
+template<typename T>
+void append_pod(std::vector<uint8_t>& out, const T& value) {
+    const auto* bytes = reinterpret_cast<const uint8_t*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template<typename T>
+bool read_pod(const uint8_t*& ptr, const uint8_t* end, T& value) {
+    if (static_cast<size_t>(end - ptr) < sizeof(T)) {
+        return false;
+    }
+    std::memcpy(&value, ptr, sizeof(T));
+    ptr += sizeof(T);
+    return true;
+}
+
+void append_string(std::vector<uint8_t>& out, const std::string& value) {
+    append_pod(out, static_cast<uint32_t>(value.size()));
+    out.insert(out.end(), value.begin(), value.end());
+}
+
+bool read_string(const uint8_t*& ptr, const uint8_t* end, std::string& value) {
+    uint32_t len;
+    if (!read_pod(ptr, end, len) || static_cast<size_t>(end - ptr) < len) {
+        return false;
+    }
+    value.assign(reinterpret_cast<const char*>(ptr), len);
+    ptr += len;
+    return true;
+}
+
+void append_tags(std::vector<uint8_t>& out, const Tags& tags) {
+    append_pod(out, static_cast<uint32_t>(tags.size()));
+    for (const auto& [key, value] : tags) {
+        append_string(out, key);
+        append_string(out, value);
+    }
+}
+
+bool read_tags(const uint8_t*& ptr, const uint8_t* end, Tags& tags) {
+    uint32_t count;
+    if (!read_pod(ptr, end, count)) {
+        return false;
+    }
+    tags.clear();
+    for (uint32_t i = 0; i < count; ++i) {
+        std::string key;
+        std::string value;
+        if (!read_string(ptr, end, key) || !read_string(ptr, end, value)) {
+            return false;
+        }
+        tags.emplace(std::move(key), std::move(value));
+    }
+    return true;
+}
+
+int64_t window_of(int64_t timestamp, const QueryConfig& config) {
+    int64_t window = config.window_size;
+    if (window <= 0) {
+        return config.time_range.start_time;
+    }
+    return timestamp - (((timestamp % window) + window) % window);
+}
+
+bool io_all(int fd, uint8_t* data, size_t size, bool sending) {
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = sending ? ::send(fd, data + done, size - done, MSG_NOSIGNAL)
+                            : ::recv(fd, data + done, size - done, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        done += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+} // anonymous namespace
+
+void encode_points(const std::string& table, const std::vector<TimeSeriesData>& points,
+                   std::vector<uint8_t>& out) {
+    auto by_time = [](const TimeSeriesData& a, const TimeSeriesData& b) {
+        return a.timestamp < b.timestamp;
+    };
+    if (std::is_sorted(points.begin(), points.end(), by_time)) {
+        server::encode_binary_frame(table, points.data(), points.size(), out);
+        return;
+    }
+    std::vector<TimeSeriesData> sorted = points;
+    std::stable_sort(sorted.begin(), sorted.end(), by_time);
+    server::encode_binary_frame(table, sorted.data(), sorted.size(), out);
+}
+
+bool decode_points(const uint8_t* data, size_t size, std::string& table,
+                   std::vector<TimeSeriesData>& points) {
+    uint32_t payload_size;
+    uint32_t crc;
+    const uint8_t* ptr = data;
+    const uint8_t* end = data + size;
+    if (!read_pod(ptr, end, payload_size) || !read_pod(ptr, end, crc) ||
+        static_cast<size_t>(end - ptr) != payload_size || crc32c(ptr, payload_size) != crc) {
+        return false;
+    }
+    return server::decode_binary_payload(ptr, payload_size, table, points);
+}
+
+void encode_query(const std::string& table, const QueryConfig& config, std::vector<uint8_t>& out) {
+    append_string(out, table);
+    append_pod(out, config.time_range.start_time);
+    append_pod(out, config.time_range.end_time);
+    append_tags(out, config.filter_tags);
+    append_pod(out, static_cast<int32_t>(config.aggregation));
+    append_pod(out, config.window_size);
+    append_pod(out, config.limit);
+    append_pod(out, config.quantile);
+    append_pod(out, static_cast<uint32_t>(config.group_by.size()));
+    for (const auto& tag : config.group_by) {
+        append_string(out, tag);
+    }
+}
+
+bool decode_query(const uint8_t* data, size_t size, std::string& table, QueryConfig& config) {
+    const uint8_t* ptr = data;
+    const uint8_t* end = data + size;
+    int32_t aggregation;
+    uint32_t group_count;
+    if (!read_string(ptr, end, table) || !read_pod(ptr, end, config.time_range.start_time) ||
+        !read_pod(ptr, end, config.time_range.end_time) ||
+        !read_tags(ptr, end, config.filter_tags) || !read_pod(ptr, end, aggregation) ||
+        !read_pod(ptr, end, config.window_size) || !read_pod(ptr, end, config.limit) ||
+        !read_pod(ptr, end, config.quantile) || !read_pod(ptr, end, group_count)) {
+        return false;
+    }
+    config.aggregation = static_cast<AggregationType>(aggregation);
+    config.group_by.clear();
+    for (uint32_t i = 0; i < group_count; ++i) {
+        std::string tag;
+        if (!read_string(ptr, end, tag)) {
+            return false;
+        }
+        config.group_by.push_back(std::move(tag));
+    }
+    return ptr == end;
+}
+
+void encode_partials(const std::vector<PartialAggregate>& partials, std::vector<uint8_t>& out) {
+    append_pod(out, static_cast<uint32_t>(partials.size()));
+    for (const auto& partial : partials) {
+        const BlockSummary& summary = partial.summary;
+        append_pod(out, partial.window_start);
+        append_tags(out, partial.group);
+        append_pod(out, summary.count);
+        append_pod(out, summary.sum);
+        append_pod(out, summary.sum_squares);
+        append_pod(out, summary.min);
+        append_pod(out, summary.max);
+        append_pod(out, summary.first_timestamp);
+        append_pod(out, summary.first);
+        append_pod(out, summary.last_timestamp);
+        append_pod(out, summary.last);
+        append_pod(out, static_cast<uint8_t>(summary.sketched));
+        if (summary.sketched) {
+            summary.quantiles.serialize(out);
+            summary.distinct.serialize(out);
+        }
+    }
+}
+
+bool decode_partials(const uint8_t* data, size_t size, std::vector<PartialAggregate>& partials) {
+    const uint8_t* ptr = data;
+    const uint8_t* end = data + size;
+    uint32_t count;
+    if (!read_pod(ptr, end, count)) {
+        return false;
+    }
+    partials.clear();
+    for (uint32_t i = 0; i < count; ++i) {
+        PartialAggregate partial;
+        BlockSummary& summary = partial.summary;
+        uint8_t sketched;
+        if (!read_pod(ptr, end, partial.window_start) || !read_tags(ptr, end, partial.group) ||
+            !read_pod(ptr, end, summary.count) || !read_pod(ptr, end, summary.sum) ||
+            !read_pod(ptr, end, summary.sum_squares) || !read_pod(ptr, end, summary.min) ||
+            !read_pod(ptr, end, summary.max) || !read_pod(ptr, end, summary.first_timestamp) ||
+            !read_pod(ptr, end, summary.first) || !read_pod(ptr, end, summary.last_timestamp) ||
+            !read_pod(ptr, end, summary.last) || !read_pod(ptr, end, sketched)) {
+            return false;
+        }
+        summary.sketched = sketched != 0;
+        if (summary.sketched && (!summary.quantiles.deserialize(ptr, end) ||
+                                 !summary.distinct.deserialize(ptr, end))) {
+            return false;
+        }
+        partials.push_back(std::move(partial));
+    }
+    return ptr == end;
+}
+
+std::vector<PartialAggregate> partial_aggregate(const std::vector<TimeSeriesData>& points,
+                                                const QueryConfig& config) {
+    bool sketched = needs_sketches(config.aggregation);
+    std::map<std::pair<int64_t, Tags>, BlockSummary> buckets;
+    Tags group;
+    for (const auto& point : points) {
+        group.clear();
+        for (const auto& tag : config.group_by) {
+            auto it = point.tags.find(tag);
+            if (it != point.tags.end()) {
+                group.insert(*it);
+            }
+        }
+        auto [it, inserted] = buckets.try_emplace({window_of(point.timestamp, config), group});
+        if (inserted) {
+            it->second.sketched = sketched;
+        }
+        it->second.add(point);
+    }
+
+    std::vector<PartialAggregate> partials;
+    partials.reserve(buckets.size());
+    for (auto& [key, summary] : buckets) {
+        if (sketched) {
+            summary.quantiles.compact();
+        }
+        partials.push_back({key.first, key.second, std::move(summary)});
+    }
+    return partials;
+}
+
+std::vector<TimeSeriesData> finish_aggregate(const std::vector<PartialAggregate>& partials,
+                                             const QueryConfig& config) {
+    std::map<std::pair<int64_t, Tags>, BlockSummary> buckets;
+    for (const auto& partial : partials) {
+        auto [it, inserted] = buckets.try_emplace({partial.window_start, partial.group},
+                                                  partial.summary);
+        if (!inserted) {
+            it->second.merge(partial.summary);
+        }
+    }
+
+    size_t limit = config.limit > 0 ? static_cast<size_t>(config.limit) : SIZE_MAX;
+    std::vector<TimeSeriesData> results;
+    for (const auto& [key, summary] : buckets) {
+        if (results.size() >= limit) {
+            break;
+        }
+        Tags tags = config.filter_tags;
+        tags.insert(key.second.begin(), key.second.end());
+        results.emplace_back(key.first, summary.value(config.aggregation, config.quantile),
+                             std::move(tags));
+    }
+    return results;
+}
+
+size_t local_insert(TableManager& manager, const std::string& table,
+                    std::vector<TimeSeriesData>&& points, const TableConfig* create_config,
+                    std::string& error) {
+    auto stream = manager.getStreamTable(table);
+    if (!stream && create_config) {
+        manager.createStreamTable(table, *create_config);  // May lose a race: look again
+        stream = manager.getStreamTable(table);
+    }
+    if (!stream) {
+        error = "no stream table " + table;
+        return 0;
+    }
+    try {
+        return stream->insertBatch(std::move(points)).size();
+    } catch (const std::exception& e) {
+        error = e.what();
+        return 0;
+    }
+}
+
+std::vector<TimeSeriesData> local_query(TableManager& manager, const std::string& table,
+                                        const QueryConfig& config) {
+    auto stream = manager.getStreamTable(table);
+    if (!stream) {
+        return {};
+    }
+    auto points = stream->query(config.time_range, config.filter_tags);
+    if (config.limit > 0 && points.size() > static_cast<size_t>(config.limit)) {
+        points.resize(static_cast<size_t>(config.limit));
+    }
+    return points;
+}
+
+std::vector<PartialAggregate> local_aggregate(TableManager& manager, const std::string& table,
+                                              const QueryConfig& config) {
+    auto stream = manager.getStreamTable(table);
+    if (!stream) {
+        return {};
+    }
+    return partial_aggregate(stream->query(config.time_range, config.filter_tags), config);
+}
+
+bool send_message(int fd, uint8_t code, const std::vector<uint8_t>& body) {
+    if (body.size() > kMaxMessageBytes) {
+        return false;
+    }
+    uint8_t header[kMessageHeaderBytes];
+    uint32_t size = static_cast<uint32_t>(body.size());
+    std::memcpy(header, &size, sizeof(size));
+    header[4] = code;
+    return io_all(fd, header, sizeof(header), true) &&
+           io_all(fd, const_cast<uint8_t*>(body.data()), body.size(), true);
+}
+
+bool recv_message(int fd, uint8_t& code, std::vector<uint8_t>& body) {
+    uint8_t header[kMessageHeaderBytes];
+    if (!io_all(fd, header, sizeof(header), false)) {
+        return false;
+    }
+    uint32_t size;
+    std::memcpy(&size, header, sizeof(size));
+    if (size > kMaxMessageBytes) {
+        return false;
+    }
+    code = header[4];
+    body.resize(size);
+    return io_all(fd, body.data(), size, false);
+}
+
+int connect_to(const std::string& host, int port, std::chrono::milliseconds timeout,
+               std::string& error) {
+    addrinfo hints{};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* addresses = nullptr;
+    if (::getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses) != 0) {
+        error = "cannot resolve " + host;
+        return -1;
+    }
+    int fd = -1;
+    for (addrinfo* a = addresses; a; a = a->ai_next) {
+        fd = ::socket(a->ai_family, a->ai_socktype | SOCK_CLOEXEC, a->ai_protocol);
+        if (fd < 0) continue;
+        if (::connect(fd, a->ai_addr, a->ai_addrlen) == 0) break;
+        ::close(fd);
+        fd = -1;
+    }
+    ::freeaddrinfo(addresses);
+    if (fd < 0) {
+        error = "cannot connect to " + host + ":" + std::to_string(port) + ": " +
+                std::strerror(errno);
+        return -1;
+    }
+
+    int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    timeval tv{};
+    tv.tv_sec = static_cast<time_t>(timeout.count() / 1000);
+    tv.tv_usec = static_cast<suseconds_t>((timeout.count() % 1000) * 1000);
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    return fd;
+}
+
+} // namespace cluster
+} // namespace sage_tsdb
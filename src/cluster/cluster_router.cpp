@@ -0,0 +1,231 @@
+#include "sage_tsdb/cluster/cluster_router.h"
+#include "sage_tsdb/core/trace.h"
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <unistd.h>
+
+namespace sage_tsdb {
+namespace cluster {
+
+ClusterRouter::ClusterRouter(ShardMap map, std::shared_ptr<TableManager> local_manager,
+                             ClusterRouterConfig config)
+    : map_(std::move(map)), local_(std::move(local_manager)), config_(std::move(config)) {}
+
+ClusterRouter::~ClusterRouter() {
+    for (auto& [node, fds] : idle_) {
+        for (int fd : fds) {
+            ::close(fd);
+        }
+    }
+}
+
+void ClusterRouter::fail(const std::string& message) {
+    std::lock_guard<std::mutex> lock(error_mutex_);
+    last_error_ = message;
+}
+
+std::string ClusterRouter::lastError() const {
+    std::lock_guard<std::mutex> lock(error_mutex_);
+    return last_error_;
+}
+
+bool ClusterRouter::isLocal(const std::string& node_id) const {
+    return local_ && !config_.local_node.empty() && node_id == config_.local_node;
+}
+
+template <typename Fn>
+void ClusterRouter::fanOut(const std::vector<std::string>& nodes, Fn&& fn) {
+    std::vector<std::thread> threads;
+    size_t inline_index = nodes.size();
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        // The calling thread takes the local node, or else the last one
+        if (isLocal(nodes[i]) || (inline_index == nodes.size() && i + 1 == nodes.size())) {
+            inline_index = i;
+            continue;
+        }
+        threads.emplace_back([&fn, i]() { fn(i); });
+    }
+    if (inline_index < nodes.size()) {
+        fn(inline_index);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+int ClusterRouter::connect(const NodeInfo& node) {
+    std::string error;
+    int fd = connect_to(node.host, node.port, config_.timeout, error);
+    if (fd < 0) {
+        fail("node " + node.id + ": " + error);
+    }
+    return fd;
+}
+
+void ClusterRouter::release(const std::string& node_id, int fd) {
+    std::lock_guard<std::mutex> lock(pool_mutex_);
+    auto& fds = idle_[node_id];
+    if (fds.size() < config_.max_idle_connections) {
+        fds.push_back(fd);
+    } else {
+        ::close(fd);
+    }
+}
+
+bool ClusterRouter::call(const std::string& node_id, RpcKind kind,
+                         const std::vector<uint8_t>& request, std::vector<uint8_t>& response) {
+    const NodeInfo* node = map_.node(node_id);
+    if (!node) {
+        fail("unknown node " + node_id);
+        return false;
+    }
+
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        int fd = -1;
+        bool pooled = false;
+        {
+            std::lock_guard<std::mutex> lock(pool_mutex_);
+            auto& fds = idle_[node_id];
+            if (!fds.empty()) {
+                fd = fds.back();
+                fds.pop_back();
+                pooled = true;
+            }
+        }
+        if (fd < 0 && (fd = connect(*node)) < 0) {
+            return false;
+        }
+
+        uint8_t status;
+        if (!send_message(fd, static_cast<uint8_t>(kind), request) ||
+            !recv_message(fd, status, response)) {
+            ::close(fd);
+            if (pooled) {
+                continue;  // The node may have closed an idle connection
+            }
+            fail("rpc to node " + node_id + " failed");
+            return false;
+        }
+        release(node_id, fd);
+        if (status != static_cast<uint8_t>(RpcStatus::Ok)) {
+            fail("node " + node_id + ": " + std::string(response.begin(), response.end()));
+            return false;
+        }
+        return true;
+    }
+    fail("rpc to node " + node_id + " failed");
+    return false;
+}
+
+bool ClusterRouter::insertBatch(const std::string& table,
+                                const std::vector<TimeSeriesData>& points) {
+    SAGE_TSDB_TRACE_SCOPE_ARG("cluster", "router.insert", "points", points.size());
+    std::map<std::string, std::vector<TimeSeriesData>> by_node;
+    for (const auto& point : points) {
+        by_node[map_.ownerOf(table, point)].push_back(point);
+    }
+
+    std::vector<std::string> nodes;
+    std::vector<std::vector<TimeSeriesData>*> batches;
+    for (auto& [node, batch] : by_node) {
+        nodes.push_back(node);
+        batches.push_back(&batch);
+    }
+    std::vector<char> ok(nodes.size(), 0);
+    fanOut(nodes, [&](size_t i) {
+        std::vector<TimeSeriesData>& batch = *batches[i];
+        size_t count = batch.size();
+        if (isLocal(nodes[i])) {
+            std::string error;
+            ok[i] = local_insert(*local_, table, std::move(batch), &config_.table_config, error) ==
+                    count;
+            if (!ok[i]) {
+                fail("node " + nodes[i] + ": " + error);
+            }
+            return;
+        }
+        std::vector<uint8_t> request;
+        std::vector<uint8_t> response;
+        encode_points(table, batch, request);
+        uint64_t written = 0;
+        if (call(nodes[i], RpcKind::Insert, request, response) &&
+            response.size() == sizeof(written)) {
+            std::memcpy(&written, response.data(), sizeof(written));
+        }
+        ok[i] = written == count;
+    });
+    return std::all_of(ok.begin(), ok.end(), [](char node_ok) { return node_ok != 0; });
+}
+
+bool ClusterRouter::query(const std::string& table, const QueryConfig& config,
+                          std::vector<TimeSeriesData>& out) {
+    SAGE_TSDB_TRACE_SCOPE("cluster", "router.query");
+    std::vector<std::string> nodes = map_.nodesFor(table, config.time_range, config.filter_tags);
+    bool aggregate = config.aggregation != AggregationType::NONE;
+    std::vector<uint8_t> request;
+    encode_query(table, config, request);
+
+    std::vector<std::vector<TimeSeriesData>> points(nodes.size());
+    std::vector<std::vector<PartialAggregate>> partials(nodes.size());
+    std::vector<char> ok(nodes.size(), 0);
+    fanOut(nodes, [&](size_t i) {
+        if (isLocal(nodes[i])) {
+            if (aggregate) {
+                partials[i] = local_aggregate(*local_, table, config);
+            } else {
+                points[i] = local_query(*local_, table, config);
+            }
+            ok[i] = 1;
+            return;
+        }
+        std::vector<uint8_t> response;
+        if (!call(nodes[i], aggregate ? RpcKind::Aggregate : RpcKind::Query, request, response)) {
+            return;
+        }
+        std::string name;
+        ok[i] = aggregate ? decode_partials(response.data(), response.size(), partials[i])
+                          : decode_points(response.data(), response.size(), name, points[i]);
+        if (!ok[i]) {
+            fail("malformed response from node " + nodes[i]);
+        }
+    });
+
+    out.clear();
+    if (aggregate) {
+        std::vector<PartialAggregate> all;
+        for (auto& node_partials : partials) {
+            std::move(node_partials.begin(), node_partials.end(), std::back_inserter(all));
+        }
+        out = finish_aggregate(all, config);
+    } else {
+        // Every node answered its earliest points; merge and keep the limit
+        for (auto& node_points : points) {
+            std::move(node_points.begin(), node_points.end(), std::back_inserter(out));
+        }
+        std::stable_sort(out.begin(), out.end(), [](const TimeSeriesData& a,
+                                                     const TimeSeriesData& b) {
+            return a.timestamp < b.timestamp;
+        });
+        if (config.limit > 0 && out.size() > static_cast<size_t>(config.limit)) {
+            out.resize(static_cast<size_t>(config.limit));
+        }
+    }
+    return std::all_of(ok.begin(), ok.end(), [](char node_ok) { return node_ok != 0; });
+}
+
+bool ClusterRouter::ping() {
+    std::vector<std::string> nodes;
+    for (const auto& node : map_.nodes()) {
+        nodes.push_back(node.id);
+    }
+    std::vector<char> ok(nodes.size(), 0);
+    fanOut(nodes, [&](size_t i) {
+        std::vector<uint8_t> response;
+        ok[i] = isLocal(nodes[i]) || call(nodes[i], RpcKind::Ping, {}, response);
+    });
+    return std::all_of(ok.begin(), ok.end(), [](char node_ok) { return node_ok != 0; });
+}
+
+} // namespace cluster
+} // namespace sage_tsdb
@@ -0,0 +1,475 @@
+#include "sage_tsdb/cluster/replication.h"
+#include "sage_tsdb/core/stream_table.h"
+#include "sage_tsdb/server/ingest_protocol.h"
+#include <algorithm>
+#include <cstring>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace sage_tsdb {
+namespace cluster {
+
+namespace {
+
+constexpr auto kHeartbeatInterval = std::chrono::milliseconds(200);  // Idle leader
+constexpr auto kLeaderTimeout = std::chrono::milliseconds(2000);     // Silent leader
+constexpr size_t kMaxSendBytes = 4 * 1024 * 1024;
+
+template<typename T>
+void append_pod(std::vector<uint8_t>& out, const T& value) {
+    const auto* bytes = reinterpret_cast<const uint8_t*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template<typename T>
+bool read_pod(const uint8_t*& ptr, const uint8_t* end, T& value) {
+    if (static_cast<size_t>(end - ptr) < sizeof(T)) {
+        return false;
+    }
+    std::memcpy(&value, ptr, sizeof(T));
+    ptr += sizeof(T);
+    return true;
+}
+
+int64_t steady_now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool send_error(int fd, const std::string& message) {
+    return send_message(fd, static_cast<uint8_t>(ReplicationKind::Error),
+                        std::vector<uint8_t>(message.begin(), message.end()));
+}
+
+} // anonymous namespace
+
+// ============================================================================
+// ReplicationLog
+// ============================================================================
+
+ReplicationLog::ReplicationLog(std::shared_ptr<TableManager> manager,
+                               ReplicationLogOptions options)
+    : manager_(std::move(manager)), options_(options) {
+    MetricsRegistry& registry = *manager_->getMetricsRegistry();
+    segments_sealed_ = registry.counter("sage_tsdb_replication_segments_total",
+                                        "Replication log segments sealed");
+    points_logged_ = registry.counter("sage_tsdb_replication_points_total",
+                                      "Points appended to the replication log");
+    open_since_ = std::chrono::steady_clock::now();
+    listener_id_ = manager_->addTableInsertListener(
+        [this](const std::string& table, const TimeSeriesData* data, size_t count) {
+            append(table, data, count);
+        });
+}
+
+ReplicationLog::~ReplicationLog() {
+    manager_->removeTableInsertListener(listener_id_);
+}
+
+void ReplicationLog::append(const std::string& table, const TimeSeriesData* data, size_t count) {
+    if (count == 0) {
+        return;
+    }
+    // Encode outside the lock; the block encoding wants timestamp order
+    std::vector<uint8_t> frame;
+    auto by_time = [](const TimeSeriesData& a, const TimeSeriesData& b) {
+        return a.timestamp < b.timestamp;
+    };
+    if (std::is_sorted(data, data + count, by_time)) {
+        server::encode_binary_frame(table, data, count, frame);
+    } else {
+        std::vector<TimeSeriesData> sorted(data, data + count);
+        std::stable_sort(sorted.begin(), sorted.end(), by_time);
+        server::encode_binary_frame(table, sorted.data(), sorted.size(), frame);
+    }
+    points_logged_->inc(count);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (open_.frames.empty()) {
+        open_since_ = std::chrono::steady_clock::now();
+    }
+    open_.frames.insert(open_.frames.end(), frame.begin(), frame.end());
+    open_.points += count;
+    if (open_.frames.size() >= options_.segment_bytes) {
+        sealLocked();
+    }
+}
+
+uint64_t ReplicationLog::sealLocked() {
+    if (!open_.frames.empty()) {
+        open_.id = next_id_++;
+        sealed_bytes_ += open_.frames.size();
+        sealed_.push_back(std::make_shared<const Segment>(std::move(open_)));
+        open_ = Segment();
+        segments_sealed_->inc();
+        // Keep the newest segment whatever its size
+        while (sealed_.size() > 1 && sealed_bytes_ > options_.retain_bytes) {
+            sealed_bytes_ -= sealed_.front()->frames.size();
+            sealed_.pop_front();
+        }
+        sealed_cv_.notify_all();
+    }
+    return next_id_ - 1;
+}
+
+uint64_t ReplicationLog::seal() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return sealLocked();
+}
+
+uint64_t ReplicationLog::lastSealed() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return next_id_ - 1;
+}
+
+bool ReplicationLog::read(uint64_t after_id, std::vector<std::shared_ptr<const Segment>>& out,
+                          size_t max_bytes, std::chrono::milliseconds wait) {
+    out.clear();
+    auto deadline = std::chrono::steady_clock::now() + wait;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        uint64_t oldest = sealed_.empty() ? next_id_ : sealed_.front()->id;
+        if (after_id + 1 < oldest) {
+            return false;  // Dropped already
+        }
+        if (after_id + 1 < next_id_) {
+            break;
+        }
+        auto now = std::chrono::steady_clock::now();
+        if (!open_.frames.empty() && now - open_since_ >= options_.segment_interval) {
+            sealLocked();
+            continue;
+        }
+        if (now >= deadline) {
+            return true;
+        }
+        auto until = open_.frames.empty() ? deadline
+                                          : std::min(deadline, open_since_ + options_.segment_interval);
+        sealed_cv_.wait_until(lock, until);
+    }
+
+    size_t bytes = 0;
+    for (size_t i = static_cast<size_t>(after_id + 1 - sealed_.front()->id);
+         i < sealed_.size() && (out.empty() || bytes + sealed_[i]->frames.size() <= max_bytes);
+         ++i) {
+        bytes += sealed_[i]->frames.size();
+        out.push_back(sealed_[i]);
+    }
+    return true;
+}
+
+uint64_t ReplicationLog::snapshot(const std::function<bool(const std::vector<uint8_t>&)>& send) {
+    uint64_t consistent_with = seal();
+    const size_t chunk = std::max<size_t>(options_.snapshot_chunk_points, 1);
+    for (const auto& name : manager_->listTablesByType(TableManager::TableType::Stream)) {
+        auto table = manager_->getStreamTable(name);
+        if (!table) {
+            continue;  // Dropped meanwhile
+        }
+        auto stats = table->getStats();
+        if (stats.total_records == 0 || stats.min_timestamp > stats.max_timestamp) {
+            continue;
+        }
+        // Halve ranges until each holds a few chunks, so memory stays bounded
+        std::vector<TimeRange> ranges = {TimeRange(stats.min_timestamp, stats.max_timestamp)};
+        while (!ranges.empty()) {
+            TimeRange range = ranges.back();
+            ranges.pop_back();
+            if (range.end_time > range.start_time && table->count(range) > 4 * chunk) {
+                int64_t mid = range.start_time + (range.end_time - range.start_time) / 2;
+                ranges.emplace_back(mid + 1, range.end_time);
+                ranges.emplace_back(range.start_time, mid);
+                continue;
+            }
+            auto points = table->query(range);
+            for (size_t i = 0; i < points.size(); i += chunk) {
+                std::vector<uint8_t> frames;
+                server::encode_binary_frame(name, points.data() + i,
+                                            std::min(chunk, points.size() - i), frames);
+                if (!send(frames)) {
+                    return consistent_with;
+                }
+            }
+        }
+    }
+    return consistent_with;
+}
+
+void serve_replication(ReplicationLog& log, int fd, const std::vector<uint8_t>& subscribe,
+                       const std::atomic<bool>& running) {
+    uint64_t after = 0;
+    uint8_t snapshot = 0;
+    const uint8_t* ptr = subscribe.data();
+    const uint8_t* end = ptr + subscribe.size();
+    if (!read_pod(ptr, end, after) || !read_pod(ptr, end, snapshot)) {
+        send_error(fd, "malformed subscribe");
+        return;
+    }
+    if (!snapshot && after > log.lastSealed()) {
+        send_error(fd, "gap");  // Segments of an earlier leader process
+        return;
+    }
+
+    if (snapshot) {
+        bool sent = true;
+        after = log.snapshot([&](const std::vector<uint8_t>& frames) {
+            sent = running.load() &&
+                   send_message(fd, static_cast<uint8_t>(ReplicationKind::SnapshotChunk), frames);
+            return sent;
+        });
+        std::vector<uint8_t> done;
+        append_pod(done, after);
+        if (!sent ||
+            !send_message(fd, static_cast<uint8_t>(ReplicationKind::SnapshotDone), done)) {
+            return;
+        }
+    }
+
+    std::vector<std::shared_ptr<const ReplicationLog::Segment>> segments;
+    std::vector<uint8_t> body;
+    while (running.load()) {
+        if (!log.read(after, segments, kMaxSendBytes, kHeartbeatInterval)) {
+            send_error(fd, "gap");
+            return;
+        }
+        uint64_t last_sealed = log.lastSealed();
+        if (segments.empty()) {
+            body.clear();
+            append_pod(body, last_sealed);
+            if (!send_message(fd, static_cast<uint8_t>(ReplicationKind::Heartbeat), body)) {
+                return;
+            }
+            continue;
+        }
+        for (const auto& segment : segments) {
+            body.clear();
+            append_pod(body, segment->id);
+            append_pod(body, last_sealed);
+            body.insert(body.end(), segment->frames.begin(), segment->frames.end());
+            if (!send_message(fd, static_cast<uint8_t>(ReplicationKind::Segment), body)) {
+                return;
+            }
+            after = segment->id;
+        }
+    }
+}
+
+// ============================================================================
+// ReplicaFollower
+// ============================================================================
+
+ReplicaFollower::ReplicaFollower(std::shared_ptr<TableManager> local, FollowerConfig config)
+    : local_(std::move(local)), config_(std::move(config)) {}
+
+ReplicaFollower::~ReplicaFollower() {
+    stop();
+}
+
+void ReplicaFollower::fail(const std::string& message) {
+    std::lock_guard<std::mutex> lock(error_mutex_);
+    last_error_ = message;
+}
+
+std::string ReplicaFollower::lastError() const {
+    std::lock_guard<std::mutex> lock(error_mutex_);
+    return last_error_;
+}
+
+void ReplicaFollower::start() {
+    if (running_.exchange(true)) {
+        return;
+    }
+    thread_ = std::thread(&ReplicaFollower::run, this);
+}
+
+void ReplicaFollower::stop() {
+    if (!running_.exchange(false)) {
+        return;
+    }
+    int fd = fd_.load();
+    if (fd >= 0) {
+        ::shutdown(fd, SHUT_RDWR);  // Unblocks the follower's recv
+    }
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void ReplicaFollower::run() {
+    while (running_.load()) {
+        std::string error;
+        int fd = connect_to(config_.leader_host, config_.leader_port, kLeaderTimeout, error);
+        if (fd >= 0) {
+            fd_.store(fd);
+            if (running_.load() && !follow(fd) && running_.load()) {
+                fail("replication from " + config_.leader_host + " interrupted");
+            }
+            fd_.store(-1);
+            ::close(fd);
+        } else {
+            fail(error);
+        }
+        auto resume = std::chrono::steady_clock::now() + config_.reconnect_interval;
+        while (running_.load() && std::chrono::steady_clock::now() < resume) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+}
+
+bool ReplicaFollower::follow(int fd) {
+    std::vector<uint8_t> request;
+    append_pod(request, applied_.load());
+    append_pod(request, static_cast<uint8_t>(need_snapshot_));
+    if (!send_message(fd, static_cast<uint8_t>(ReplicationKind::Subscribe), request)) {
+        return false;
+    }
+
+    uint8_t code;
+    std::vector<uint8_t> body;
+    while (running_.load() && recv_message(fd, code, body)) {
+        const uint8_t* ptr = body.data();
+        const uint8_t* end = ptr + body.size();
+        uint64_t id = 0;
+        uint64_t last_sealed = 0;
+        switch (static_cast<ReplicationKind>(code)) {
+            case ReplicationKind::SnapshotChunk:
+                if (!applyFrames(ptr, body.size())) return false;
+                break;
+            case ReplicationKind::SnapshotDone:
+                if (!read_pod(ptr, end, id)) return false;
+                need_snapshot_ = false;
+                setApplied(id);
+                break;
+            case ReplicationKind::Segment:
+                if (!read_pod(ptr, end, id) || !read_pod(ptr, end, last_sealed)) return false;
+                if (id != applied_.load() + 1) {
+                    fail("segment " + std::to_string(id) + " out of order");
+                    need_snapshot_ = true;
+                    return false;
+                }
+                if (!applyFrames(ptr, static_cast<size_t>(end - ptr))) return false;
+                setApplied(id);
+                if (id >= last_sealed) {
+                    caught_up_at_ns_.store(steady_now_ns());
+                }
+                break;
+            case ReplicationKind::Heartbeat:
+                if (!read_pod(ptr, end, last_sealed)) return false;
+                if (applied_.load() >= last_sealed) {
+                    caught_up_at_ns_.store(steady_now_ns());
+                }
+                break;
+            case ReplicationKind::Error: {
+                std::string message(body.begin(), body.end());
+                if (message == "gap") {
+                    need_snapshot_ = true;  // Start over from a snapshot
+                    return true;
+                }
+                fail("leader: " + message);
+                return false;
+            }
+            default:
+                fail("unexpected replication message " + std::to_string(code));
+                return false;
+        }
+    }
+    return false;
+}
+
+bool ReplicaFollower::applyFrames(const uint8_t* data, size_t size) {
+    const uint8_t* ptr = data;
+    const uint8_t* end = data + size;
+    std::string table;
+    std::vector<TimeSeriesData> points;
+    while (ptr < end) {
+        uint32_t payload_size;
+        if (static_cast<size_t>(end - ptr) < server::kBinaryHeaderBytes) {
+            fail("truncated replication frame");
+            return false;
+        }
+        std::memcpy(&payload_size, ptr, sizeof(payload_size));
+        size_t frame_size = server::kBinaryHeaderBytes + payload_size;
+        points.clear();
+        if (static_cast<size_t>(end - ptr) < frame_size ||
+            !decode_points(ptr, frame_size, table, points)) {
+            fail("malformed replication frame");
+            return false;
+        }
+        ptr += frame_size;
+        size_t count = points.size();
+        std::string error;
+        if (local_insert(*local_, table, std::move(points), &config_.table_config, error) != count) {
+            fail("cannot apply to " + table + ": " + error);
+            return false;
+        }
+    }
+    return true;
+}
+
+void ReplicaFollower::setApplied(uint64_t id) {
+    {
+        std::lock_guard<std::mutex> lock(applied_mutex_);
+        applied_.store(id);
+        synced_ = true;  // Only ever after the first snapshot
+    }
+    applied_cv_.notify_all();
+}
+
+bool ReplicaFollower::waitForSegment(uint64_t id, std::chrono::milliseconds timeout) const {
+    std::unique_lock<std::mutex> lock(applied_mutex_);
+    return applied_cv_.wait_for(lock, timeout,
+                                [&]() { return synced_ && applied_.load() >= id; });
+}
+
+std::chrono::milliseconds ReplicaFollower::staleness() const {
+    int64_t caught_up = caught_up_at_ns_.load();
+    if (caught_up == 0) {
+        return std::chrono::milliseconds::max();
+    }
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::nanoseconds(steady_now_ns() - caught_up));
+}
+
+bool ReplicaFollower::checkFresh() {
+    auto lag = staleness();
+    if (lag > config_.max_staleness) {
+        fail(lag == std::chrono::milliseconds::max()
+                 ? std::string("replica has not caught up yet")
+                 : "replica is " + std::to_string(lag.count()) + " ms stale");
+        return false;
+    }
+    return true;
+}
+
+bool ReplicaFollower::query(const std::string& table, const QueryConfig& config,
+                            std::vector<TimeSeriesData>& out) {
+    if (!checkFresh()) {
+        return false;
+    }
+    out.clear();
+    if (!local_->hasTable(table)) {
+        return true;  // Nothing replicated to it yet
+    }
+    try {
+        out = local_->query(table, config);
+    } catch (const std::exception& e) {
+        fail(e.what());
+        return false;
+    }
+    return true;
+}
+
+bool ReplicaFollower::queryLatest(const std::string& table, size_t n,
+                                  std::vector<TimeSeriesData>& out) {
+    if (!checkFresh()) {
+        return false;
+    }
+    out.clear();
+    if (auto stream = local_->getStreamTable(table)) {
+        out = stream->queryLatest(n);
+    }
+    return true;
+}
+
+} // namespace cluster
+} // namespace sage_tsdb
@@ -0,0 +1,283 @@
+#include "sage_tsdb/cluster/shard_map.h"
+#include <algorithm>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+namespace sage_tsdb {
+namespace cluster {
+
+namespace {
+
+// Full murmur3 finalizer: tag hashes of similar series differ in few bits,
+// and shard ownership needs them spread over every shard
+uint64_t mix(uint64_t hash) {
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+const TablePlacement& default_placement() {
+    static const TablePlacement placement;
+    return placement;
+}
+
+int64_t floor_div(int64_t a, int64_t b) {
+    int64_t q = a / b;
+    return (a % b != 0 && (a < 0) != (b < 0)) ? q - 1 : q;
+}
+
+} // anonymous namespace
+
+ShardMap::ShardMap(size_t num_shards) : owners_(std::max<size_t>(num_shards, 1)) {}
+
+void ShardMap::addNode(const NodeInfo& node) {
+    if (node.id.empty() || this->node(node.id)) {
+        throw std::invalid_argument("Invalid or duplicate node id: " + node.id);
+    }
+    nodes_.push_back(node);
+}
+
+const NodeInfo* ShardMap::node(const std::string& id) const {
+    for (const auto& node : nodes_) {
+        if (node.id == id) {
+            return &node;
+        }
+    }
+    return nullptr;
+}
+
+void ShardMap::assignRoundRobin() {
+    if (nodes_.empty()) {
+        return;
+    }
+    for (size_t shard = 0; shard < owners_.size(); ++shard) {
+        owners_[shard] = nodes_[shard % nodes_.size()].id;
+    }
+}
+
+void ShardMap::assign(size_t shard, const std::string& node_id) {
+    if (shard >= owners_.size() || !node(node_id)) {
+        throw std::invalid_argument("Cannot assign shard " + std::to_string(shard) + " to " +
+                                    node_id);
+    }
+    owners_[shard] = node_id;
+}
+
+const std::string& ShardMap::group(const std::string& table) const {
+    auto it = group_of_.find(table);
+    return it != group_of_.end() ? it->second : table;
+}
+
+void ShardMap::setPlacement(const std::string& table, const TablePlacement& placement) {
+    placements_[group(table)] = placement;
+}
+
+const TablePlacement& ShardMap::placement(const std::string& table) const {
+    auto it = placements_.find(group(table));
+    return it != placements_.end() ? it->second : default_placement();
+}
+
+void ShardMap::colocate(const std::string& table, const std::string& with) {
+    std::string target = group(with);
+    std::string old = group(table);
+    if (old == target) {
+        return;
+    }
+    // Tables already grouped with table move along
+    for (auto& [member, member_group] : group_of_) {
+        if (member_group == old) {
+            member_group = target;
+        }
+    }
+    group_of_[table] = target;
+    if (old == table) {
+        placements_.erase(old);
+    }
+}
+
+bool ShardMap::colocated(const std::string& a, const std::string& b) const {
+    return group(a) == group(b);
+}
+
+bool ShardMap::joinsLocally(const std::string& s, const std::string& r) const {
+    const TablePlacement& placed = placement(s);
+    return colocated(s, r) && placed.partition_ms == 0 && placed.shard_by.size() == 1 &&
+           placed.shard_by[0] == kJoinKeyTag;
+}
+
+size_t ShardMap::shardOfTags(const TablePlacement& placement, const Tags& tags) const {
+    uint64_t hash;
+    if (placement.shard_by.empty()) {
+        hash = TimeSeriesData::hash_tags(tags);
+    } else {
+        Tags key;
+        for (const auto& name : placement.shard_by) {
+            auto it = tags.find(name);
+            key[name] = it != tags.end() ? it->second : "";
+        }
+        hash = TimeSeriesData::hash_tags(key);
+    }
+    return static_cast<size_t>(mix(hash) % owners_.size());
+}
+
+size_t ShardMap::shardOf(const std::string& table, const TimeSeriesData& point) const {
+    const TablePlacement& placed = placement(table);
+    if (placed.partition_ms > 0) {
+        int64_t partition = floor_div(point.timestamp, placed.partition_ms);
+        int64_t shards = static_cast<int64_t>(owners_.size());
+        return static_cast<size_t>(((partition % shards) + shards) % shards);
+    }
+    return shardOfTags(placed, point.tags);
+}
+
+const std::string& ShardMap::ownerOf(const std::string& table, const TimeSeriesData& point) const {
+    return owners_[shardOf(table, point)];
+}
+
+std::vector<std::string> ShardMap::nodesFor(const std::string& table, const TimeRange& range,
+                                            const Tags& filter_tags) const {
+    const TablePlacement& placed = placement(table);
+    std::set<std::string> owners;
+    if (placed.partition_ms > 0) {
+        int64_t first = floor_div(range.start_time, placed.partition_ms);
+        int64_t last = floor_div(range.end_time, placed.partition_ms);
+        int64_t shards = static_cast<int64_t>(owners_.size());
+        for (int64_t p = first; p <= last && p - first < shards; ++p) {
+            owners.insert(owners_[static_cast<size_t>(((p % shards) + shards) % shards)]);
+        }
+    } else if (!placed.shard_by.empty() &&
+               std::all_of(placed.shard_by.begin(), placed.shard_by.end(),
+                           [&](const std::string& tag) { return filter_tags.count(tag) > 0; })) {
+        owners.insert(owners_[shardOfTags(placed, filter_tags)]);
+    } else {
+        owners.insert(owners_.begin(), owners_.end());
+    }
+
+    std::vector<std::string> result;
+    for (const auto& node : nodes_) {
+        if (owners.count(node.id)) {
+            result.push_back(node.id);
+        }
+    }
+    return result;
+}
+
+std::string ShardMap::serialize() const {
+    std::ostringstream out;
+    out << "shards " << owners_.size() << "\n";
+    for (const auto& node : nodes_) {
+        out << "node " << node.id << " " << node.host << " " << node.port << "\n";
+    }
+    for (size_t shard = 0; shard < owners_.size(); ++shard) {
+        if (!owners_[shard].empty()) {
+            out << "assign " << shard << " " << owners_[shard] << "\n";
+        }
+    }
+    for (const auto& [name, placed] : placements_) {
+        out << "place " << name;
+        if (placed.partition_ms > 0) {
+            out << " partition_ms=" << placed.partition_ms;
+        }
+        for (const auto& tag : placed.shard_by) {
+            out << " " << tag;
+        }
+        out << "\n";
+    }
+    for (const auto& [table, target] : group_of_) {
+        out << "colocate " << table << " " << target << "\n";
+    }
+    return out.str();
+}
+
+bool ShardMap::parse(const std::string& text, ShardMap& out, std::string* error) {
+    auto fail = [error](size_t line, const std::string& message) {
+        if (error) {
+            *error = "line " + std::to_string(line) + ": " + message;
+        }
+        return false;
+    };
+
+    ShardMap map;
+    std::vector<bool> assigned;
+    std::istringstream in(text);
+    std::string line;
+    size_t number = 0;
+    try {
+        while (std::getline(in, line)) {
+            ++number;
+            std::istringstream words(line);
+            std::string directive;
+            if (!(words >> directive) || directive[0] == '#') {
+                continue;
+            }
+            if (directive == "shards") {
+                size_t shards = 0;
+                if (!(words >> shards) || shards == 0 || !map.nodes_.empty()) {
+                    return fail(number, "shards must be positive and come first");
+                }
+                map.owners_.assign(shards, "");
+            } else if (directive == "node") {
+                NodeInfo node;
+                if (!(words >> node.id >> node.host >> node.port)) {
+                    return fail(number, "expected: node <id> <host> <port>");
+                }
+                map.addNode(node);
+            } else if (directive == "assign") {
+                size_t shard = 0;
+                std::string node;
+                if (!(words >> shard >> node)) {
+                    return fail(number, "expected: assign <shard> <node>");
+                }
+                map.assign(shard, node);
+                assigned.resize(map.owners_.size());
+                assigned[shard] = true;
+            } else if (directive == "place") {
+                std::string table;
+                if (!(words >> table)) {
+                    return fail(number, "expected: place <table> [partition_ms=N] [tag...]");
+                }
+                TablePlacement placed;
+                std::string word;
+                while (words >> word) {
+                    if (word.rfind("partition_ms=", 0) == 0) {
+                        placed.partition_ms = std::stoll(word.substr(13));
+                    } else {
+                        placed.shard_by.push_back(word);
+                    }
+                }
+                map.setPlacement(table, placed);
+            } else if (directive == "colocate") {
+                std::string table;
+                std::string with;
+                if (!(words >> table >> with)) {
+                    return fail(number, "expected: colocate <table> <with>");
+                }
+                map.colocate(table, with);
+            } else {
+                return fail(number, "unknown directive " + directive);
+            }
+        }
+    } catch (const std::exception& e) {
+        return fail(number, e.what());
+    }
+    if (map.nodes_.empty()) {
+        return fail(number, "no nodes");
+    }
+
+    // Shards without an assign line are spread like assignRoundRobin()
+    assigned.resize(map.owners_.size());
+    for (size_t shard = 0; shard < map.owners_.size(); ++shard) {
+        if (!assigned[shard]) {
+            map.owners_[shard] = map.nodes_[shard % map.nodes_.size()].id;
+        }
+    }
+    out = std::move(map);
+    return true;
+}
+
+} // namespace cluster
+} // namespace sage_tsdb
@@ -0,0 +1,235 @@
+#include "sage_tsdb/cluster/shard_server.h"
+#include "sage_tsdb/core/trace.h"
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace sage_tsdb {
+namespace cluster {
+
+ShardServer::ShardServer(std::shared_ptr<TableManager> manager, ShardServerConfig config)
+    : manager_(std::move(manager)), config_(std::move(config)) {
+    if (!manager_) {
+        return;  // start() reports it
+    }
+    MetricsRegistry& registry = *manager_->getMetricsRegistry();
+    const char* kinds[] = {"ping", "insert", "query", "aggregate"};
+    for (size_t i = 0; i < 4; ++i) {
+        rpc_counts_[i] = registry.counter("sage_tsdb_shard_rpcs_total",
+                                          "RPCs handled by the shard server", {{"kind", kinds[i]}});
+    }
+    rpc_errors_ = registry.counter("sage_tsdb_shard_rpc_errors_total",
+                                   "Malformed or failed shard RPCs");
+}
+
+ShardServer::~ShardServer() {
+    stop();
+}
+
+void ShardServer::fail(const std::string& message) {
+    std::cerr << "ShardServer: " << message << std::endl;
+    std::lock_guard<std::mutex> lock(error_mutex_);
+    last_error_ = message;
+}
+
+std::string ShardServer::lastError() const {
+    std::lock_guard<std::mutex> lock(error_mutex_);
+    return last_error_;
+}
+
+bool ShardServer::start() {
+    if (running_.load()) {
+        return true;
+    }
+    if (!manager_) {
+        fail("no table manager");
+        return false;
+    }
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(config_.port));
+    if (inet_pton(AF_INET, config_.bind_address.c_str(), &addr.sin_addr) != 1) {
+        fail("invalid bind address " + config_.bind_address);
+        return false;
+    }
+
+    auto cleanup = [this](const std::string& what) {
+        fail(what + ": " + std::strerror(errno));
+        for (int* fd : {&listen_fd_, &wake_fd_}) {
+            if (*fd >= 0) {
+                ::close(*fd);
+                *fd = -1;
+            }
+        }
+        port_ = -1;
+        return false;
+    };
+
+    wake_fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd_ < 0) return cleanup("eventfd");
+    listen_fd_ = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0) return cleanup("socket");
+    int one = 1;
+    ::setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (::bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        return cleanup("port " + std::to_string(config_.port));
+    }
+    if (::listen(listen_fd_, SOMAXCONN) != 0) return cleanup("listen");
+    sockaddr_in local{};
+    socklen_t len = sizeof(local);
+    if (::getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&local), &len) != 0) {
+        return cleanup("getsockname");
+    }
+    port_ = ntohs(local.sin_port);
+
+    running_.store(true);
+    thread_ = std::thread(&ShardServer::run, this);
+    return true;
+}
+
+void ShardServer::stop() {
+    if (!running_.exchange(false)) {
+        return;
+    }
+    uint64_t one = 1;
+    [[maybe_unused]] ssize_t n = ::write(wake_fd_, &one, sizeof(one));
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    reapWorkers(true);
+    ::close(listen_fd_);
+    ::close(wake_fd_);
+    listen_fd_ = wake_fd_ = -1;
+    port_ = -1;
+}
+
+void ShardServer::reapWorkers(bool all) {
+    std::list<std::unique_ptr<Worker>> finished;
+    {
+        std::lock_guard<std::mutex> lock(workers_mutex_);
+        for (auto it = workers_.begin(); it != workers_.end();) {
+            if (all) {
+                ::shutdown((*it)->fd, SHUT_RDWR);  // Unblocks a recv waiting for a request
+            }
+            if (all || (*it)->done.load()) {
+                finished.splice(finished.end(), workers_, it++);
+            } else {
+                ++it;
+            }
+        }
+    }
+    for (auto& worker : finished) {
+        worker->thread.join();
+        ::close(worker->fd);
+    }
+}
+
+void ShardServer::run() {
+    pollfd fds[2] = {{listen_fd_, POLLIN, 0}, {wake_fd_, POLLIN, 0}};
+    while (running_.load()) {
+        if (::poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            fail(std::string("poll: ") + std::strerror(errno));
+            break;
+        }
+        if (fds[1].revents) {
+            break;  // running_ is already false
+        }
+        reapWorkers(false);
+        while (true) {
+            int fd = ::accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd < 0) break;
+            std::lock_guard<std::mutex> lock(workers_mutex_);
+            if (workers_.size() >= config_.max_connections) {
+                ::close(fd);
+                continue;
+            }
+            int one = 1;
+            ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            auto worker = std::make_unique<Worker>();
+            worker->fd = fd;
+            Worker* raw = worker.get();
+            workers_.push_back(std::move(worker));
+            raw->thread = std::thread([this, raw]() { serve(*raw); });
+        }
+    }
+}
+
+void ShardServer::serve(Worker& worker) {
+    uint8_t code;
+    std::vector<uint8_t> request;
+    std::vector<uint8_t> response;
+    while (running_.load() && recv_message(worker.fd, code, request)) {
+        if (code == static_cast<uint8_t>(ReplicationKind::Subscribe) && replication_) {
+            serve_replication(*replication_, worker.fd, request, running_);
+            break;  // The connection belonged to the stream
+        }
+        response.clear();
+        std::string error;
+        bool ok = code <= static_cast<uint8_t>(RpcKind::Aggregate) &&
+                  handle(static_cast<RpcKind>(code), request, response, error);
+        if (!ok) {
+            rpc_errors_->inc();
+            response.assign(error.begin(), error.end());
+        }
+        if (!send_message(worker.fd, static_cast<uint8_t>(ok ? RpcStatus::Ok : RpcStatus::Error),
+                          response)) {
+            break;
+        }
+    }
+    worker.done.store(true);
+}
+
+bool ShardServer::handle(RpcKind kind, const std::vector<uint8_t>& request,
+                         std::vector<uint8_t>& response, std::string& error) {
+    SAGE_TSDB_TRACE_SCOPE_ARG("cluster", "shard.rpc", "kind", static_cast<uint64_t>(kind));
+    rpc_counts_[static_cast<size_t>(kind)]->inc();
+    std::string table;
+    switch (kind) {
+        case RpcKind::Ping:
+            return true;
+        case RpcKind::Insert: {
+            std::vector<TimeSeriesData> points;
+            if (!decode_points(request.data(), request.size(), table, points)) {
+                error = "malformed insert";
+                return false;
+            }
+            size_t count = points.size();
+            uint64_t written = local_insert(*manager_, table, std::move(points),
+                                            config_.create_tables ? &config_.table_config : nullptr,
+                                            error);
+            if (written == 0 && count > 0) {
+                return false;
+            }
+            response.resize(sizeof(written));
+            std::memcpy(response.data(), &written, sizeof(written));
+            return true;
+        }
+        case RpcKind::Query:
+        case RpcKind::Aggregate: {
+            QueryConfig config;
+            if (!decode_query(request.data(), request.size(), table, config)) {
+                error = "malformed query";
+                return false;
+            }
+            if (kind == RpcKind::Query) {
+                encode_points(table, local_query(*manager_, table, config), response);
+            } else {
+                encode_partials(local_aggregate(*manager_, table, config), response);
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace cluster
+} // namespace sage_tsdb
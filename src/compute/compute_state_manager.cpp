@@ -1,6 +1,8 @@
 #include "sage_tsdb/compute/compute_state_manager.h"
 #include "sage_tsdb/core/time_series_db.h"
+#include <algorithm>
 #include <cstring>
+#include <limits>
 #include <stdexcept>
 #include <chrono>
 
@@ -15,6 +17,44 @@ namespace {
             system_clock::now().time_since_epoch()
         ).count();
     }
+    
+    // Checkpoint payloads are stored one byte per double, as before deltas
+    std::vector<uint8_t> payloadBytes(const TimeSeriesData& data) {
+        std::vector<uint8_t> bytes;
+        if (std::holds_alternative<std::vector<double>>(data.value)) {
+            const auto& vec = std::get<std::vector<double>>(data.value);
+            bytes.resize(vec.size());
+            std::transform(vec.begin(), vec.end(), bytes.begin(),
+                          [](double d) { return static_cast<uint8_t>(d); });
+        }
+        return bytes;
+    }
+    
+    template <typename T>
+    void appendRaw(std::vector<uint8_t>& buffer, const T& value) {
+        const auto* bytes = reinterpret_cast<const uint8_t*>(&value);
+        buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+    }
+    
+    // Deleted states and checkpoints are rows of kind "tombstone" written
+    // after the records they hide
+    constexpr const char* kTombstone = "tombstone";
+    
+    bool isTombstone(const TimeSeriesData& data) {
+        auto it = data.fields.find("kind");
+        return it != data.fields.end() && it->second.to_string() == kTombstone;
+    }
+    
+    // Latest record (highest timestamp); nullptr if there is none
+    const TimeSeriesData* latestRecord(const std::vector<TimeSeriesData>& records) {
+        const TimeSeriesData* latest = nullptr;
+        for (const auto& record : records) {
+            if (!latest || record.timestamp > latest->timestamp) {
+                latest = &record;
+            }
+        }
+        return latest;
+    }
 }
 
 ComputeStateManager::ComputeStateManager(TimeSeriesDB* db)
@@ -23,9 +63,20 @@ ComputeStateManager::ComputeStateManager(TimeSeriesDB* db)
         throw std::invalid_argument("TimeSeriesDB pointer cannot be null");
     }
     ensureTablesExist();
+    writer_ = std::thread([this]() { writerLoop(); });
 }
 
-ComputeStateManager::~ComputeStateManager() = default;
+ComputeStateManager::~ComputeStateManager() {
+    {
+        std::lock_guard<std::mutex> lock(writer_mutex_);
+        stopping_ = true;
+    }
+    writer_cv_.notify_all();
+    // The writer drains the queue before it exits
+    if (writer_.joinable()) {
+        writer_.join();
+    }
+}
 
 void ComputeStateManager::ensureTablesExist() {
     // Create state table if not exists
@@ -46,16 +97,21 @@ bool ComputeStateManager::saveState(const std::string& compute_name,
     }
     
     try {
-        // Convert state to TimeSeriesData
-        TimeSeriesData data = stateToData(state);
+        // Immutable snapshot: readers and queued checkpoints keep the one they took
+        auto snapshot = std::make_shared<ComputeState>(state);
+        snapshot->compute_name = compute_name;
         
-        // Delete old state (if exists)
-        // Note: In a real implementation, we'd use an update operation
-        // For now, we rely on the latest timestamp
+        // Convert state to TimeSeriesData
+        TimeSeriesData data = stateToData(*snapshot);
         
-        // Insert new state
+        // The latest record wins, so records are ordered with deleteState()'s
+        // tombstones under the index lock
+        std::lock_guard<std::mutex> lock(index_mutex_);
+        data.timestamp = std::max(data.timestamp, last_state_timestamp_ + 1);
+        snapshot->timestamp = data.timestamp;
         db_->insert(STATE_TABLE_NAME, data);
-        
+        last_state_timestamp_ = data.timestamp;
+        latest_states_[compute_name] = std::move(snapshot);
         return true;
     } catch (const std::exception& e) {
         // Log error (in production, use proper logging)
@@ -69,29 +125,27 @@ bool ComputeStateManager::loadState(const std::string& compute_name,
         return false;
     }
     
+    std::lock_guard<std::mutex> lock(index_mutex_);
+    auto it = latest_states_.find(compute_name);
+    if (it != latest_states_.end()) {
+        state = *it->second;
+        return true;
+    }
+    
     try {
-        // Query latest state for this compute engine
-        Tags filter_tags = {{"compute_name", compute_name}};
-        
-        // Query all states for this compute engine
-        auto results = db_->query(STATE_TABLE_NAME, 
-                                 TimeRange(0, std::numeric_limits<int64_t>::max()),
-                                 filter_tags);
-        
-        if (results.empty()) {
+        // Not saved through this manager: find the latest state in the table,
+        // under the lock so a concurrent delete cannot be cached over
+        TimeSeriesData latest;
+        if (!queryState(compute_name, latest) || isTombstone(latest)) {
             return false;
         }
         
-        // Get the latest state (highest timestamp)
-        const TimeSeriesData* latest = &results[0];
-        for (const auto& result : results) {
-            if (result.timestamp > latest->timestamp) {
-                latest = &result;
-            }
+        // Convert to ComputeState, and remember it for the next lookup
+        if (!dataToState(latest, state)) {
+            return false;
         }
-        
-        // Convert to ComputeState
-        return dataToState(*latest, state);
+        latest_states_.emplace(compute_name, std::make_shared<const ComputeState>(state));
+        return true;
         
     } catch (const std::exception& e) {
         return false;
@@ -102,22 +156,55 @@ bool ComputeStateManager::hasState(const std::string& compute_name) const {
     if (compute_name.empty()) {
         return false;
     }
+    {
+        std::lock_guard<std::mutex> lock(index_mutex_);
+        if (latest_states_.count(compute_name) > 0) {
+            return true;
+        }
+    }
     
     try {
-        Tags filter_tags = {{"compute_name", compute_name}};
-        auto results = db_->query(STATE_TABLE_NAME,
-                                 TimeRange(0, std::numeric_limits<int64_t>::max()),
-                                 filter_tags);
-        return !results.empty();
+        TimeSeriesData latest;
+        return queryState(compute_name, latest) && !isTombstone(latest);
     } catch (const std::exception& e) {
         return false;
     }
 }
 
 bool ComputeStateManager::deleteState(const std::string& compute_name) {
-    // Note: In a real LSM-Tree implementation, we'd insert a tombstone record
-    // For now, this is a placeholder
-    // The actual deletion would happen during compaction
+    if (compute_name.empty()) {
+        return false;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(index_mutex_);
+        try {
+            TimeSeriesData latest;
+            bool stored = queryState(compute_name, latest);
+            if (latest_states_.count(compute_name) == 0 && (!stored || isTombstone(latest))) {
+                return false;  // Nothing to delete
+            }
+            
+            // The tombstone hides every earlier record; compaction keeps them
+            TimeSeriesData tombstone;
+            tombstone.timestamp = std::max(getCurrentTimestamp(), last_state_timestamp_ + 1);
+            if (stored) {
+                tombstone.timestamp = std::max(tombstone.timestamp, latest.timestamp + 1);
+            }
+            tombstone.tags = {{"compute_name", compute_name}};
+            tombstone.fields = {{"kind", kTombstone}};
+            db_->insert(STATE_TABLE_NAME, tombstone);
+            last_state_timestamp_ = tombstone.timestamp;
+        } catch (const std::exception& e) {
+            return false;
+        }
+        latest_states_.erase(compute_name);
+    }
+    
+    // Checkpoints of a state saved later start from a new base
+    std::unique_lock<std::mutex> lock(writer_mutex_);
+    flushed_cv_.wait(lock, [this]() { return pending_.empty() && !writing_; });
+    bases_.erase(compute_name);
     return true;
 }
 
@@ -129,16 +216,24 @@ std::vector<std::string> ComputeStateManager::listStates() const {
         auto results = db_->query(STATE_TABLE_NAME,
                                  TimeRange(0, std::numeric_limits<int64_t>::max()));
         
-        // Extract unique compute names
-        std::set<std::string> unique_names;
+        // Latest record per compute name; deleted ones end in a tombstone
+        std::map<std::string, const TimeSeriesData*> latest;
         for (const auto& result : results) {
             auto it = result.tags.find("compute_name");
-            if (it != result.tags.end()) {
-                unique_names.insert(it->second);
+            if (it == result.tags.end()) {
+                continue;
+            }
+            auto& entry = latest[it->second];
+            if (!entry || result.timestamp > entry->timestamp) {
+                entry = &result;
             }
         }
         
-        compute_names.assign(unique_names.begin(), unique_names.end());
+        for (const auto& [name, record] : latest) {
+            if (!isTombstone(*record)) {
+                compute_names.push_back(name);
+            }
+        }
         
     } catch (const std::exception& e) {
         // Return empty vector on error
@@ -147,7 +242,7 @@ std::vector<std::string> ComputeStateManager::listStates() const {
     return compute_names;
 }
 
-bool ComputeStateManager::persistState(const std::string& compute_name) {
+bool ComputeStateManager::persistState(const std::string& /*compute_name*/) {
     // In a real implementation, this would trigger:
     // 1. Flush MemTable to immutable MemTable
     // 2. Write immutable MemTable to SSTable (Level 0)
@@ -168,38 +263,199 @@ bool ComputeStateManager::createCheckpoint(const std::string& compute_name,
         return false;
     }
     
-    try {
-        // Load current state
-        ComputeState current_state;
-        if (!loadState(compute_name, current_state)) {
+    // Take the current snapshot; loadState() caches one read from the table
+    StatePtr snapshot;
+    {
+        std::lock_guard<std::mutex> lock(index_mutex_);
+        auto it = latest_states_.find(compute_name);
+        if (it != latest_states_.end()) {
+            snapshot = it->second;
+        }
+    }
+    if (!snapshot) {
+        ComputeState loaded;
+        if (!loadState(compute_name, loaded)) {
             return false;
         }
-        
-        // Create checkpoint record
-        TimeSeriesData checkpoint_data;
-        checkpoint_data.timestamp = getCurrentTimestamp();
-        checkpoint_data.tags = {
-            {"compute_name", compute_name},
-            {"checkpoint_id", std::to_string(checkpoint_id)}
-        };
-        checkpoint_data.fields = {
-            {"watermark", std::to_string(current_state.watermark)},
-            {"window_id", std::to_string(current_state.window_id)},
-            {"processed_events", std::to_string(current_state.processed_events)}
-        };
-        
-        // Serialize operator state
-        auto serialized = serialize(current_state);
-        checkpoint_data.value = std::vector<double>(serialized.begin(), serialized.end());
-        
-        // Insert checkpoint
+        std::lock_guard<std::mutex> lock(index_mutex_);
+        snapshot = latest_states_[compute_name];
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(index_mutex_);
+        latest_checkpoints_[compute_name] = checkpoint_id;
+    }
+    {
+        std::lock_guard<std::mutex> lock(writer_mutex_);
+        pending_.push_back(PendingCheckpoint{compute_name, checkpoint_id, std::move(snapshot)});
+        stats_.pending++;
+    }
+    writer_cv_.notify_one();
+    return true;
+}
+
+void ComputeStateManager::flushCheckpoints() {
+    std::unique_lock<std::mutex> lock(writer_mutex_);
+    flushed_cv_.wait(lock, [this]() { return pending_.empty() && !writing_; });
+}
+
+bool ComputeStateManager::latestCheckpoint(const std::string& compute_name,
+                                           uint64_t& checkpoint_id) {
+    {
+        std::lock_guard<std::mutex> lock(index_mutex_);
+        auto it = latest_checkpoints_.find(compute_name);
+        if (it != latest_checkpoints_.end()) {
+            checkpoint_id = it->second;
+            return true;
+        }
+    }
+    
+    // Checkpoints of an earlier run: the most recently written one
+    auto checkpoints = listCheckpoints(compute_name);
+    if (checkpoints.empty()) {
+        return false;
+    }
+    auto latest = std::max_element(checkpoints.begin(), checkpoints.end(),
+                                   [](const auto& a, const auto& b) {
+                                       return a.second.at("timestamp") < b.second.at("timestamp");
+                                   });
+    checkpoint_id = latest->first;
+    std::lock_guard<std::mutex> lock(index_mutex_);
+    latest_checkpoints_.try_emplace(compute_name, checkpoint_id);
+    return true;
+}
+
+CheckpointStats ComputeStateManager::getCheckpointStats() const {
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+    return stats_;
+}
+
+void ComputeStateManager::writerLoop() {
+    std::unique_lock<std::mutex> lock(writer_mutex_);
+    while (true) {
+        writer_cv_.wait(lock, [this]() { return stopping_ || !pending_.empty(); });
+        if (pending_.empty()) {
+            break;  // Stopping with nothing left to write
+        }
+        PendingCheckpoint checkpoint = std::move(pending_.front());
+        pending_.pop_front();
+        writing_ = true;
+        lock.unlock();
+        
+        bool wrote_base = false;
+        size_t operator_bytes = 0;
+        bool ok = writeCheckpoint(checkpoint, wrote_base, operator_bytes);
+        checkpoint.state.reset();
+        
+        lock.lock();
+        writing_ = false;
+        stats_.pending--;
+        if (!ok) {
+            stats_.failed_checkpoints++;
+        } else {
+            (wrote_base ? stats_.base_checkpoints : stats_.delta_checkpoints)++;
+            stats_.operator_bytes_written += operator_bytes;
+        }
+        if (pending_.empty()) {
+            flushed_cv_.notify_all();
+        }
+    }
+}
+
+bool ComputeStateManager::writeCheckpoint(const PendingCheckpoint& checkpoint, bool& wrote_base,
+                                          size_t& operator_bytes) {
+    const ComputeState& state = *checkpoint.state;
+    
+    // Create checkpoint record
+    TimeSeriesData checkpoint_data;
+    checkpoint_data.timestamp = std::max(getCurrentTimestamp(), last_checkpoint_timestamp_ + 1);
+    checkpoint_data.tags = {
+        {"compute_name", checkpoint.compute_name},
+        {"checkpoint_id", std::to_string(checkpoint.checkpoint_id)}
+    };
+    checkpoint_data.fields = {
+        {"watermark", state.watermark},
+        {"window_id", state.window_id},
+        {"processed_events", state.processed_events}
+    };
+    
+    // A delta against the last base while it stays small
+    std::vector<uint8_t> serialized;
+    auto base_it = bases_.find(checkpoint.compute_name);
+    if (base_it != bases_.end() && base_it->second.deltas < kMaxDeltasPerBase) {
+        auto delta = encodeDelta(base_it->second.state->operator_state, state.operator_state);
+        if (delta.size() <= state.operator_state.size() / 2) {
+            ComputeState header;
+            header.compute_name = state.compute_name;
+            header.timestamp = state.timestamp;
+            header.watermark = state.watermark;
+            header.window_id = state.window_id;
+            header.processed_events = state.processed_events;
+            header.metadata = state.metadata;
+            header.operator_state = std::move(delta);
+            serialized = serialize(header);
+            operator_bytes = header.operator_state.size();
+            checkpoint_data.fields["kind"] = "delta";
+            checkpoint_data.fields["base_id"] = base_it->second.checkpoint_id;
+        }
+    }
+    wrote_base = serialized.empty();
+    if (wrote_base) {
+        serialized = serialize(state);
+        operator_bytes = state.operator_state.size();
+        checkpoint_data.fields["kind"] = "base";
+    }
+    checkpoint_data.value = std::vector<double>(serialized.begin(), serialized.end());
+    
+    try {
         db_->insert(CHECKPOINT_TABLE_NAME, checkpoint_data);
-        
-        return true;
-        
     } catch (const std::exception& e) {
         return false;
     }
+    
+    last_checkpoint_timestamp_ = checkpoint_data.timestamp;
+    if (wrote_base) {
+        bases_[checkpoint.compute_name] = BaseCheckpoint{checkpoint.checkpoint_id, checkpoint.state, 0};
+    } else {
+        base_it->second.deltas++;
+    }
+    return true;
+}
+
+bool ComputeStateManager::queryState(const std::string& compute_name,
+                                     TimeSeriesData& record) const {
+    Tags filter_tags = {{"compute_name", compute_name}};
+    auto results = db_->query(STATE_TABLE_NAME,
+                             TimeRange(0, std::numeric_limits<int64_t>::max()),
+                             filter_tags);
+    const TimeSeriesData* latest = latestRecord(results);
+    if (!latest) {
+        return false;
+    }
+    record = *latest;
+    return true;
+}
+
+bool ComputeStateManager::queryCheckpoint(const std::string& compute_name, uint64_t checkpoint_id,
+                                          TimeSeriesData& record, bool include_deleted) const {
+    Tags filter_tags = {
+        {"compute_name", compute_name},
+        {"checkpoint_id", std::to_string(checkpoint_id)}
+    };
+    auto results = db_->query(CHECKPOINT_TABLE_NAME,
+                             TimeRange(0, std::numeric_limits<int64_t>::max()),
+                             filter_tags);
+    if (include_deleted) {
+        // Only the checkpoint's own records, whether or not it was deleted since
+        results.erase(std::remove_if(results.begin(), results.end(), isTombstone),
+                      results.end());
+    }
+    const TimeSeriesData* latest = latestRecord(results);
+    if (!latest || isTombstone(*latest)) {
+        return false;
+    }
+    record = *latest;
+    return true;
 }
 
 bool ComputeStateManager::restoreCheckpoint(const std::string& compute_name,
@@ -209,51 +465,42 @@ bool ComputeStateManager::restoreCheckpoint(const std::string& compute_name,
         return false;
     }
     
+    // The checkpoint may still be queued
+    flushCheckpoints();
+    
     try {
-        // Query checkpoint
-        Tags filter_tags = {
-            {"compute_name", compute_name},
-            {"checkpoint_id", std::to_string(checkpoint_id)}
-        };
-        
-        auto results = db_->query(CHECKPOINT_TABLE_NAME,
-                                 TimeRange(0, std::numeric_limits<int64_t>::max()),
-                                 filter_tags);
-        
-        if (results.empty()) {
+        TimeSeriesData checkpoint_data;
+        if (!queryCheckpoint(compute_name, checkpoint_id, checkpoint_data)) {
             return false;
         }
         
-        // Deserialize from latest matching record
-        const auto& checkpoint_data = results[0];
-        
-        // Extract fields
-        state.compute_name = compute_name;
-        state.timestamp = checkpoint_data.timestamp;
-        
-        auto watermark_it = checkpoint_data.fields.find("watermark");
-        if (watermark_it != checkpoint_data.fields.end()) {
-            state.watermark = std::stoll(watermark_it->second);
-        }
-        
-        auto window_id_it = checkpoint_data.fields.find("window_id");
-        if (window_id_it != checkpoint_data.fields.end()) {
-            state.window_id = std::stoull(window_id_it->second);
-        }
-        
-        auto processed_events_it = checkpoint_data.fields.find("processed_events");
-        if (processed_events_it != checkpoint_data.fields.end()) {
-            state.processed_events = std::stoull(processed_events_it->second);
+        ComputeState restored;
+        if (!deserialize(payloadBytes(checkpoint_data), restored)) {
+            return false;
         }
         
-        // Deserialize operator state
-        if (std::holds_alternative<std::vector<double>>(checkpoint_data.value)) {
-            const auto& vec = std::get<std::vector<double>>(checkpoint_data.value);
-            state.operator_state.resize(vec.size());
-            std::transform(vec.begin(), vec.end(), state.operator_state.begin(),
-                          [](double d) { return static_cast<uint8_t>(d); });
+        // A delta holds only the pages that differ from its base, which
+        // stays readable after the base itself is deleted
+auto kind_it = checkpoint_data.fields.find("kind");
+        if (kind_it != checkpoint_data.fields.end() && kind_it->second == "delta") {
+            auto base_id_it = checkpoint_data.fields.find("base_id");
+            TimeSeriesData base_data;
+            ComputeState base;
+            if (base_id_it == checkpoint_data.fields.end() ||
+                !queryCheckpoint(compute_name, base_id_it->second.as_uint64(), base_data, true) ||
+                !deserialize(payloadBytes(base_data), base)) {
+                return false;
+            }
+            std::vector<uint8_t> operator_state;
+            if (!applyDelta(base.operator_state, restored.operator_state, operator_state)) {
+                return false;
+            }
+            restored.operator_state = std::move(operator_state);
         }
         
+        restored.compute_name = compute_name;
+        restored.timestamp = checkpoint_data.timestamp;
+        state = std::move(restored);
         return true;
         
     } catch (const std::exception& e) {
@@ -275,22 +522,33 @@ ComputeStateManager::listCheckpoints(const std::string& compute_name) const {
                                  TimeRange(0, std::numeric_limits<int64_t>::max()),
                                  filter_tags);
         
+        // Latest record per checkpoint; deleted ones end in a tombstone
+        std::map<uint64_t, const TimeSeriesData*> latest;
         for (const auto& data : results) {
             auto checkpoint_id_it = data.tags.find("checkpoint_id");
             if (checkpoint_id_it == data.tags.end()) {
                 continue;
             }
-            
-            uint64_t checkpoint_id = std::stoull(checkpoint_id_it->second);
+            auto& entry = latest[std::stoull(checkpoint_id_it->second)];
+            if (!entry || data.timestamp > entry->timestamp) {
+                entry = &data;
+            }
+        }
+        
+        for (const auto& [checkpoint_id, record] : latest) {
+            if (isTombstone(*record)) {
+                continue;
+            }
+            const TimeSeriesData& data = *record;
             
             std::map<std::string, int64_t> metadata;
             metadata["timestamp"] = data.timestamp;
             
             if (auto it = data.fields.find("window_id"); it != data.fields.end()) {
-                metadata["window_id"] = std::stoll(it->second);
+                metadata["window_id"] = it->second.as_int64();
             }
             if (auto it = data.fields.find("processed_events"); it != data.fields.end()) {
-                metadata["processed_events"] = std::stoll(it->second);
+                metadata["processed_events"] = it->second.as_int64();
             }
             
             result.emplace_back(checkpoint_id, metadata);
@@ -305,7 +563,43 @@ ComputeStateManager::listCheckpoints(const std::string& compute_name) const {
 
 bool ComputeStateManager::deleteCheckpoint(const std::string& compute_name,
                                            uint64_t checkpoint_id) {
-    // Similar to deleteState, this would insert a tombstone in a real implementation
+    if (compute_name.empty()) {
+        return false;
+    }
+    
+    {
+        // Written by this thread while the writer is idle, so the tombstone
+        // follows every queued record of the checkpoint
+        std::unique_lock<std::mutex> lock(writer_mutex_);
+        flushed_cv_.wait(lock, [this]() { return pending_.empty() && !writing_; });
+        
+        try {
+            TimeSeriesData record;
+            if (!queryCheckpoint(compute_name, checkpoint_id, record)) {
+                return false;  // No such checkpoint, or already deleted
+            }
+            
+            TimeSeriesData tombstone;
+            tombstone.timestamp = std::max({getCurrentTimestamp(), last_checkpoint_timestamp_ + 1,
+                                            record.timestamp + 1});
+            tombstone.tags = {
+                {"compute_name", compute_name},
+                {"checkpoint_id", std::to_string(checkpoint_id)}
+            };
+            tombstone.fields = {{"kind", kTombstone}};
+            db_->insert(CHECKPOINT_TABLE_NAME, tombstone);
+            last_checkpoint_timestamp_ = tombstone.timestamp;
+        } catch (const std::exception& e) {
+            return false;
+        }
+    }
+    
+    // latestCheckpoint() falls back to the remaining ones
+    std::lock_guard<std::mutex> lock(index_mutex_);
+    auto it = latest_checkpoints_.find(compute_name);
+    if (it != latest_checkpoints_.end() && it->second == checkpoint_id) {
+        latest_checkpoints_.erase(it);
+    }
     return true;
 }
 
@@ -425,6 +719,65 @@ bool ComputeStateManager::deserialize(const std::vector<uint8_t>& data,
     }
 }
 
+std::vector<uint8_t> ComputeStateManager::encodeDelta(const std::vector<uint8_t>& base,
+                                                      const std::vector<uint8_t>& current) {
+    std::vector<uint8_t> delta;
+    appendRaw(delta, static_cast<uint64_t>(current.size()));
+    appendRaw(delta, uint32_t{0});  // Page count, filled in below
+    
+    uint32_t pages = 0;
+    for (size_t offset = 0; offset < current.size(); offset += DELTA_PAGE_SIZE) {
+        size_t len = std::min(DELTA_PAGE_SIZE, current.size() - offset);
+        bool same = offset + len <= base.size() &&
+                    std::memcmp(base.data() + offset, current.data() + offset, len) == 0;
+        if (same) {
+            continue;
+        }
+        appendRaw(delta, static_cast<uint32_t>(offset / DELTA_PAGE_SIZE));
+        delta.insert(delta.end(), current.begin() + offset, current.begin() + offset + len);
+        ++pages;
+    }
+    std::memcpy(delta.data() + sizeof(uint64_t), &pages, sizeof(pages));
+    return delta;
+}
+
+bool ComputeStateManager::applyDelta(const std::vector<uint8_t>& base,
+                                     const std::vector<uint8_t>& delta,
+                                     std::vector<uint8_t>& out) {
+    uint64_t total = 0;
+    uint32_t pages = 0;
+    if (delta.size() < sizeof(total) + sizeof(pages)) {
+        return false;
+    }
+    std::memcpy(&total, delta.data(), sizeof(total));
+    std::memcpy(&pages, delta.data() + sizeof(total), sizeof(pages));
+    
+    // Unchanged pages come from the base
+    out.assign(total, 0);
+    std::memcpy(out.data(), base.data(), std::min<size_t>(total, base.size()));
+    
+    size_t offset = sizeof(total) + sizeof(pages);
+    for (uint32_t i = 0; i < pages; ++i) {
+        uint32_t index = 0;
+        if (offset + sizeof(index) > delta.size()) {
+            return false;
+        }
+        std::memcpy(&index, delta.data() + offset, sizeof(index));
+        offset += sizeof(index);
+        size_t begin = static_cast<size_t>(index) * DELTA_PAGE_SIZE;
+        if (begin >= total) {
+            return false;
+        }
+        size_t len = std::min<size_t>(DELTA_PAGE_SIZE, total - begin);
+        if (offset + len > delta.size()) {
+            return false;
+        }
+        std::memcpy(out.data() + begin, delta.data() + offset, len);
+        offset += len;
+    }
+    return offset == delta.size();
+}
+
 // ========== Private Helper Methods ==========
 
 TimeSeriesData ComputeStateManager::stateToData(const ComputeState& state) const {
@@ -436,9 +789,9 @@ TimeSeriesData ComputeStateManager::stateToData(const ComputeState& state) const
     
     // Store fields
     data.fields = {
-        {"watermark", std::to_string(state.watermark)},
-        {"window_id", std::to_string(state.window_id)},
-        {"processed_events", std::to_string(state.processed_events)}
+        {"watermark", state.watermark},
+        {"window_id", state.window_id},
+        {"processed_events", state.processed_events}
     };
     
     // Add metadata
@@ -465,30 +818,29 @@ bool ComputeStateManager::dataToState(const TimeSeriesData& data,
     
     // Extract fields
     if (auto it = data.fields.find("watermark"); it != data.fields.end()) {
-        state.watermark = std::stoll(it->second);
+        state.watermark = it->second.as_int64();
     }
     if (auto it = data.fields.find("window_id"); it != data.fields.end()) {
-        state.window_id = std::stoull(it->second);
+        state.window_id = it->second.as_uint64();
     }
     if (auto it = data.fields.find("processed_events"); it != data.fields.end()) {
-        state.processed_events = std::stoull(it->second);
+        state.processed_events = it->second.as_uint64();
     }
     
     // Extract metadata (fields prefixed with "meta_")
     state.metadata.clear();
     for (const auto& [key, value] : data.fields) {
         if (key.find("meta_") == 0) {
-            state.metadata[key.substr(5)] = value;
+            state.metadata[key.substr(5)] = value.to_string();
         }
     }
     
-    // Deserialize operator state from value
-    if (std::holds_alternative<std::vector<double>>(data.value)) {
-        const auto& vec = std::get<std::vector<double>>(data.value);
-        state.operator_state.resize(vec.size());
-        std::transform(vec.begin(), vec.end(), state.operator_state.begin(),
-                      [](double d) { return static_cast<uint8_t>(d); });
+    // Value holds the whole serialized state (see stateToData)
+    ComputeState stored;
+    if (!deserialize(payloadBytes(data), stored)) {
+        return false;
     }
+    state.operator_state = std::move(stored.operator_state);
     
     return true;
 }
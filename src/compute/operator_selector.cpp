@@ -0,0 +1,258 @@
+/**
+ * @file operator_selector.cpp
+ * @brief Implementation of OperatorSelector
+ */
+
+#ifdef PECJ_MODE_INTEGRATED
+
+#include "sage_tsdb/compute/operator_selector.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace sage_tsdb {
+namespace compute {
+
+namespace {
+
+constexpr double AVERAGE_WEIGHT = 0.3;  ///< Weight of the newest window in moving averages
+
+/**
+ * @brief Relative cost and accuracy of an operator
+ *
+ * Costs in nanoseconds: per input tuple, per result pair enumerated, per
+ * distinct key modelled and per late tuple buffered. residual is the
+ * share of the pairs of late tuples the operator still gets wrong.
+ */
+struct OperatorProfile {
+    double tuple_ns;
+    double pair_ns;
+    double key_ns;
+    double late_ns;
+    double residual;
+    bool estimates;  ///< Result is a model estimate (error shrinks with tuples per key)
+};
+
+OperatorProfile profile(PECJOperatorType op) {
+    switch (op) {
+        case PECJOperatorType::SHJ:         return {100.0, 5.0, 0.0, 0.0, 1.0, false};
+        case PECJOperatorType::IAWJ:        return {150.0, 0.0, 0.0, 0.0, 1.0, false};
+        case PECJOperatorType::PRJ:         return {250.0, 5.0, 0.0, 0.0, 1.0, false};
+        case PECJOperatorType::MSWJ:        return {300.0, 0.0, 0.0, 2000.0, 0.3, false};
+        case PECJOperatorType::IMA:
+        case PECJOperatorType::PECJ:        return {500.0, 0.0, 1000.0, 0.0, 0.1, true};
+        default:                            return {400.0, 0.0, 1000.0, 0.0, 0.2, true};
+    }
+}
+
+double ewma(double average, double sample, bool first) {
+    return first ? sample : average + AVERAGE_WEIGHT * (sample - average);
+}
+
+/**
+ * @brief Uncalibrated latency of op on a window (ms)
+ */
+double modelLatencyMs(PECJOperatorType op, double tuples, double keys,
+                      double selectivity, double disorder) {
+    const OperatorProfile p = profile(op);
+    double side = tuples / 2.0;
+    double pairs = selectivity * side * side;
+    double ns = p.tuple_ns * tuples + p.pair_ns * pairs + p.key_ns * keys +
+                p.late_ns * disorder * tuples;
+    return ns / 1e6;
+}
+
+} // anonymous namespace
+
+std::vector<PECJOperatorType> OperatorSelector::defaultCandidates() {
+    return {PECJOperatorType::IAWJ, PECJOperatorType::SHJ, PECJOperatorType::PRJ,
+            PECJOperatorType::MSWJ, PECJOperatorType::PECJ};
+}
+
+OperatorSelector::OperatorSelector(double latency_slo_ms, std::vector<PECJOperatorType> candidates)
+    : latency_slo_ms_(latency_slo_ms), candidates_(std::move(candidates)) {
+    if (latency_slo_ms_ <= 0.0 || candidates_.empty()) {
+        throw std::invalid_argument("OperatorSelector: non-positive SLO or no candidates");
+    }
+    current_ = candidates_.front();
+}
+
+void OperatorSelector::observeWindow(PECJOperatorType op, const WorkloadSample& sample,
+                                     double latency_ms, bool timed_out) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const bool first = !observed_;
+    observed_ = true;
+    windows_since_switch_++;
+
+    auto tuples = static_cast<double>(sample.input_tuples);
+    double seconds = static_cast<double>(sample.window_len_us) / 1e6;
+    if (seconds > 0.0) {
+        arrival_rate_ = ewma(arrival_rate_, tuples / seconds, first);
+    }
+    window_tuples_ = ewma(window_tuples_, tuples, first);
+    distinct_keys_ = ewma(distinct_keys_, std::max(1.0, sample.distinct_keys), first);
+    selectivity_ = ewma(selectivity_, sample.selectivity, first);
+    recent_tuples_ = recent_tuples_ * (1.0 - AVERAGE_WEIGHT) + tuples;
+    recent_late_ *= 1.0 - AVERAGE_WEIGHT;
+
+    // Correct the model of op by what this window cost
+    double measured = timed_out ? std::max(latency_ms, 2.0 * latency_slo_ms_) : latency_ms;
+    double predicted = modelLatencyMs(op, tuples, std::max(1.0, sample.distinct_keys),
+                                      sample.selectivity, lateFraction());
+    if (predicted > 0.0 && measured > 0.0) {
+        auto it = calibration_.find(op);
+        double ratio = measured / predicted;
+        if (it == calibration_.end()) {
+            calibration_.emplace(op, ratio);
+        } else {
+            it->second = ewma(it->second, ratio, false);
+        }
+    }
+}
+
+void OperatorSelector::observeLateTuples(size_t late_tuples) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    recent_late_ += static_cast<double>(late_tuples);
+}
+
+double OperatorSelector::lateFraction() const {
+    double total = recent_tuples_ + recent_late_;
+    return total > 0.0 ? recent_late_ / total : 0.0;
+}
+
+double OperatorSelector::calibration(PECJOperatorType op) const {
+    auto it = calibration_.find(op);
+    if (it != calibration_.end()) {
+        return it->second;
+    }
+    // Not run yet: assume it is off by as much as the operators that ran
+    if (calibration_.empty()) {
+        return 1.0;
+    }
+    double sum = 0.0;
+    for (const auto& [type, ratio] : calibration_) {
+        sum += ratio;
+    }
+    return sum / static_cast<double>(calibration_.size());
+}
+
+OperatorEstimate OperatorSelector::estimate(PECJOperatorType op) const {
+    const double disorder = lateFraction();
+    OperatorEstimate estimate;
+    estimate.type = op;
+    estimate.latency_ms = calibration(op) *
+        modelLatencyMs(op, window_tuples_, distinct_keys_, selectivity_, disorder);
+    estimate.meets_slo = estimate.latency_ms <= latency_slo_ms_;
+
+    const OperatorProfile p = profile(op);
+    double missed = std::min(1.0, 2.0 * disorder);
+    estimate.error = p.residual * missed;
+    if (p.estimates && disorder > 0.0) {
+        // Compensation extrapolates per key; fewer tuples per key, noisier
+        double per_key = std::max(1.0, window_tuples_ / distinct_keys_);
+        estimate.error += missed / std::sqrt(per_key);
+    }
+    estimate.error = std::min(1.0, estimate.error);
+    return estimate;
+}
+
+PECJOperatorType OperatorSelector::choose(uint64_t window_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!observed_) {
+        return current_;
+    }
+    if (switches_ > 0 && windows_since_switch_ < min_windows_per_switch) {
+        return current_;
+    }
+
+    // Lowest error within the SLO, ties to the faster; else the fastest
+    const OperatorEstimate* best = nullptr;
+    std::vector<OperatorEstimate> all;
+    all.reserve(candidates_.size());
+    for (PECJOperatorType op : candidates_) {
+        all.push_back(estimate(op));
+    }
+    for (const auto& candidate : all) {
+        if (!best) {
+            best = &candidate;
+            continue;
+        }
+        bool better;
+        if (candidate.meets_slo != best->meets_slo) {
+            better = candidate.meets_slo;
+        } else if (candidate.meets_slo && candidate.error != best->error) {
+            better = candidate.error < best->error;
+        } else {
+            better = candidate.latency_ms < best->latency_ms;
+        }
+        if (better) {
+            best = &candidate;
+        }
+    }
+    if (best->type == current_) {
+        return current_;
+    }
+
+    OperatorEstimate now = estimate(current_);
+    if (now.meets_slo && now.error <= best->error + switch_margin) {
+        return current_;  // Good enough; not worth a switch
+    }
+
+    OperatorDecision decision;
+    decision.window_id = window_id;
+    decision.from = operatorName(current_);
+    decision.to = operatorName(best->type);
+    decision.predicted_latency_ms = best->latency_ms;
+    decision.predicted_error = best->error;
+    decision.arrival_rate = arrival_rate_;
+    decision.disorder = lateFraction();
+    if (decisions_.size() == MAX_DECISIONS) {
+        decisions_.erase(decisions_.begin());
+    }
+    decisions_.push_back(std::move(decision));
+
+    current_ = best->type;
+    windows_since_switch_ = 0;
+    switches_++;
+    return current_;
+}
+
+PECJOperatorType OperatorSelector::current() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return current_;
+}
+
+std::vector<OperatorEstimate> OperatorSelector::estimates() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<OperatorEstimate> all;
+    for (PECJOperatorType op : candidates_) {
+        all.push_back(estimate(op));
+    }
+    return all;
+}
+
+std::vector<OperatorDecision> OperatorSelector::decisions() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return decisions_;
+}
+
+uint64_t OperatorSelector::switches() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return switches_;
+}
+
+double OperatorSelector::arrivalRate() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return arrival_rate_;
+}
+
+double OperatorSelector::disorder() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return lateFraction();
+}
+
+} // namespace compute
+} // namespace sage_tsdb
+
+#endif // PECJ_MODE_INTEGRATED
@@ -11,16 +11,24 @@
 #include <algorithm>
 #include <chrono>
 #include <cmath>
+#include <iostream>
 #include <stdexcept>
 #include <sstream>
 #include <mutex>
 #include <numeric>
 #include <memory>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
 
 // sageTSDB core headers - include BEFORE everything else
 #include "sage_tsdb/core/time_series_db.h"
 #include "sage_tsdb/core/time_series_data.h"
 #include "sage_tsdb/core/resource_manager.h"
+#include "sage_tsdb/core/hash_join.h"
+#include "sage_tsdb/core/trace.h"
+#include "sage_tsdb/compute/shared_scan.h"
+#include "sage_tsdb/compute/operator_selector.h"
 
 // Now include the header - after core dependencies are resolved
 #include "sage_tsdb/compute/pecj_compute_engine.h"
@@ -51,21 +59,9 @@ namespace compute {
 
 namespace {
     // Constants
-    constexpr size_t MAX_LATENCY_SAMPLES = 1000;  ///< Max samples for percentile calculation
     constexpr double MEMORY_CHECK_THRESHOLD = 0.9; ///< Memory warning threshold (90%)
-    
-    /**
-     * @brief Calculate percentile from sorted samples
-     */
-    double calculatePercentile(const std::vector<double>& sorted_samples, double percentile) {
-        if (sorted_samples.empty()) return 0.0;
-        
-        size_t index = static_cast<size_t>(sorted_samples.size() * percentile);
-        if (index >= sorted_samples.size()) {
-            index = sorted_samples.size() - 1;
-        }
-        return sorted_samples[index];
-    }
+    constexpr size_t CANCEL_CHECK_BATCH = 4096;    ///< Tuples per stream fed between deadline checks
+    constexpr size_t KEY_SAMPLE = 4096;            ///< Keys per stream sampled for the key cardinality
     
     /**
      * @brief Get current timestamp in microseconds
@@ -76,23 +72,248 @@ namespace {
             now.time_since_epoch()).count();
     }
     
+    using KeyCounts = std::unordered_map<uint64_t, uint64_t>;
+    
+    using StreamColumns = ScanColumns;
+    
+    /**
+     * @brief Distinct keys among up to KEY_SAMPLE evenly spaced keys of each stream
+     */
+    size_t sampleKeyCardinality(const StreamColumns& s, const StreamColumns& r) {
+        std::unordered_set<uint64_t> keys;
+        keys.reserve(2 * KEY_SAMPLE);
+        for (const StreamColumns* columns : {&s, &r}) {
+            size_t stride = std::max<size_t>(1, columns->size() / KEY_SAMPLE);
+            for (size_t i = 0; i < columns->size(); i += stride) {
+                keys.insert(columns->keys[i]);
+            }
+        }
+        return keys.size();
+    }
+    
+    /**
+     * @brief Keep every stride-th tuple of columns, compacted in place
+     */
+    void keepEvery(StreamColumns& columns, size_t stride) {
+        size_t kept = 0;
+        for (size_t i = 0; i < columns.size(); i += stride, ++kept) {
+            columns.keys[kept] = columns.keys[i];
+            columns.values[kept] = columns.values[i];
+            columns.event_times[kept] = columns.event_times[i];
+        }
+        columns.keys.resize(kept);
+        columns.values.resize(kept);
+        columns.event_times.resize(kept);
+    }
+    
+#ifdef PECJ_FULL_INTEGRATION
+    /**
+     * @brief Window-sized block of TrackTuples handed to the operator
+     * 
+     * All tuples of a window live in one vector; the operator receives
+     * aliasing shared_ptrs that share the block's control block, so feeding
+     * a tuple costs no allocation. The block is refilled in place once the
+     * operator has dropped every pointer into it, and replaced otherwise.
+     */
+    class TupleArena {
+    public:
+        // Builds every stride-th tuple of columns; returns the tuple count
+        size_t fill(const StreamColumns& columns, int64_t base_ts, size_t stride) {
+            if (!block_ || block_.use_count() > 1) {
+                block_ = std::make_shared<std::vector<OoOJoin::TrackTuple>>();
+            }
+            auto& tuples = *block_;
+            tuples.clear();
+            tuples.reserve((columns.size() + stride - 1) / stride);
+            for (size_t i = 0; i < columns.size(); i += stride) {
+                // Normalize to the operator's relative window [0, window_len]
+                auto ts = static_cast<OoOJoin::tsType>(columns.event_times[i] - base_ts);
+                tuples.emplace_back(static_cast<OoOJoin::keyType>(columns.keys[i]),
+                                    static_cast<OoOJoin::valueType>(columns.values[i]),
+                                    ts, ts);
+            }
+            return tuples.size();
+        }
+        
+        // Feeds tuples [begin, end) of the last fill()
+        template <typename Feed>
+        void feed(size_t begin, size_t end, Feed&& feed_tuple) {
+            auto& tuples = *block_;
+            for (size_t i = begin; i < end; ++i) {
+                feed_tuple(std::shared_ptr<OoOJoin::TrackTuple>(block_, &tuples[i]));
+            }
+        }
+        
+    private:
+        std::shared_ptr<std::vector<OoOJoin::TrackTuple>> block_;
+    };
+#endif
+    
 } // anonymous namespace
 
+/**
+ * @brief Pane cache plus the aggregate of the panes [first, last) in the current window
+ * 
+ * join_count = sum over keys of s_keys[k] * r_keys[k], kept up to date as
+ * panes are added and removed.
+ */
+struct PECJComputeEngine::PaneState {
+    std::map<int64_t, std::shared_ptr<const PaneCounts>> panes;   ///< Pane index -> counts
+    int64_t first = 0;
+    int64_t last = 0;                ///< Empty window when first == last
+    KeyCounts s_keys;
+    KeyCounts r_keys;
+    size_t s_count = 0;
+    size_t r_count = 0;
+    uint64_t join_count = 0;
+    
+    void clearWindow() {
+        s_keys.clear();
+        r_keys.clear();
+        s_count = r_count = 0;
+        join_count = 0;
+        first = last = 0;
+    }
+    
+    void add(const PaneCounts& pane) {
+        for (const auto& [key, count] : pane.s_keys) {
+            auto it = r_keys.find(key);
+            if (it != r_keys.end()) join_count += count * it->second;
+            s_keys[key] += count;
+        }
+        // s_keys now includes the pane, which also counts its own S x R pairs
+        for (const auto& [key, count] : pane.r_keys) {
+            auto it = s_keys.find(key);
+            if (it != s_keys.end()) join_count += count * it->second;
+            r_keys[key] += count;
+        }
+        s_count += pane.s_count;
+        r_count += pane.r_count;
+    }
+    
+    void remove(const PaneCounts& pane) {
+        // Exact reverse of add()
+        for (const auto& [key, count] : pane.r_keys) {
+            auto it = r_keys.find(key);
+            if ((it->second -= count) == 0) r_keys.erase(it);
+            auto s_it = s_keys.find(key);
+            if (s_it != s_keys.end()) join_count -= count * s_it->second;
+        }
+        for (const auto& [key, count] : pane.s_keys) {
+            auto it = s_keys.find(key);
+            if ((it->second -= count) == 0) s_keys.erase(it);
+            auto r_it = r_keys.find(key);
+            if (r_it != r_keys.end()) join_count -= count * r_it->second;
+        }
+        s_count -= pane.s_count;
+        r_count -= pane.r_count;
+    }
+};
+
+/**
+ * @brief Per-key tuple counts of a computed window, plus the result reported for it
+ * 
+ * R keys also carry the sum of their values, which is what join_sum adds
+ * for each pair.
+ */
+struct PECJComputeEngine::LateWindow {
+    struct RKey {
+        uint64_t count = 0;
+        double sum = 0.0;
+    };
+    
+    TimeRange time_range;
+    KeyCounts s_keys;
+    std::unordered_map<uint64_t, RKey> r_keys;
+    size_t s_count = 0;
+    size_t r_count = 0;
+    double result = 0.0;   ///< Join count, or sum with join_sum
+    
+    void addS(uint64_t key) {
+        s_keys[key]++;
+        s_count++;
+    }
+    
+    void addR(uint64_t key, double value) {
+        RKey& r = r_keys[key];
+        r.count++;
+        r.sum += value;
+        r_count++;
+    }
+    
+    void addColumns(const std::vector<uint64_t>& s, const std::vector<uint64_t>& r,
+                    const std::vector<double>& r_values) {
+        s_keys.reserve(s.size());
+        r_keys.reserve(r.size());
+        for (uint64_t key : s) addS(key);
+        for (size_t i = 0; i < r.size(); ++i) addR(r[i], r_values[i]);
+    }
+};
+
+/**
+ * @brief Windows whose state is retained for late tuples, by window id
+ */
+struct PECJComputeEngine::LateState {
+    std::map<uint64_t, LateWindow> windows;
+    
+    void expire(int64_t watermark_us, uint64_t max_delay_us) {
+        for (auto it = windows.begin(); it != windows.end();) {
+            if (it->second.time_range.end_us + static_cast<int64_t>(max_delay_us) <= watermark_us) {
+                it = windows.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+};
+
+/**
+ * @brief One pooled PECJ operator with the buffers of the window it runs
+ * 
+ * The operator is created and configured (setConfig, sized S/R buffers)
+ * once; each window only rebases it: setWindow when the length changes,
+ * then start()/stop() around tuples whose event times are offset to 0.
+ */
+struct PECJComputeEngine::WindowSlot {
+#ifdef PECJ_FULL_INTEGRATION
+    std::shared_ptr<OoOJoin::AbstractOperator> op;  // PECJ uses shared_ptr
+    PECJOperatorType op_type = PECJOperatorType::IAWJ;
+    uint64_t window_len = 0;                        ///< Length of the last setWindow()
+    TupleArena s_tuples;
+    TupleArena r_tuples;
+#endif
+    StreamColumns s;
+    StreamColumns r;
+};
+
 PECJComputeEngine::PECJComputeEngine()
     : db_(nullptr)
     , resource_handle_(nullptr)
     , initialized_(false)
-    , current_memory_usage_(0) {
+    , current_memory_usage_(0)
+    , panes_(std::make_unique<PaneState>())
+    , late_(std::make_unique<LateState>()) {
 }
 
 #ifdef PECJ_FULL_INTEGRATION
 PECJComputeEngine::~PECJComputeEngine() {
-    // Cleanup PECJ operator (requires complete type)
-    pecj_operator_.reset();
+    // Wait for running exact completions; queued ones become no-ops
+    {
+        std::unique_lock<std::shared_mutex> lock(lifetime_->mutex);
+        lifetime_->alive = false;
+    }
+    // Cleanup pooled PECJ operators (requires complete type)
+    idle_slots_.clear();
+    setSharedScan(nullptr);
 }
 #else
 PECJComputeEngine::~PECJComputeEngine() {
-    // No PECJ operator to clean up in stub mode
+    // Wait for running exact completions; queued ones become no-ops
+    {
+        std::unique_lock<std::shared_mutex> lock(lifetime_->mutex);
+        lifetime_->alive = false;
+    }
+    setSharedScan(nullptr);
 }
 #endif
 
@@ -119,20 +340,41 @@ bool PECJComputeEngine::initialize(const ComputeConfig& config,
         return false;
     }
     
-    // Create PECJ operator
-    if (!createPECJOperator()) {
+    selector_.reset();
+    if (stringToOperatorType(config_.operator_type) == PECJOperatorType::Auto) {
+        double slo_ms = config_.latency_slo_ms;
+        if (slo_ms <= 0.0) {
+            slo_ms = config_.timeout_ms > 0 ? static_cast<double>(config_.timeout_ms) : 1000.0;
+        }
+        selector_ = std::make_unique<OperatorSelector>(slo_ms);
+    }
+    
+    // Build the first pooled operator up front so a bad configuration
+    // fails here rather than in the first window
+    {
+        std::lock_guard<std::mutex> pool_lock(pool_mutex_);
+        idle_slots_.clear();
+        slots_created_ = 0;
+        slot_limit_ = std::max<size_t>(1, config_.max_concurrent_windows);
+    }
+    auto slot = std::make_unique<WindowSlot>();
+    if (!createPECJOperator(*slot)) {
         return false;
     }
+    {
+        std::lock_guard<std::mutex> pool_lock(pool_mutex_);
+        idle_slots_.push_back(std::move(slot));
+        slots_created_ = 1;
+    }
     
     // Initialize metrics
     metrics_ = ComputeMetrics{};
-    latency_samples_.reserve(MAX_LATENCY_SAMPLES);
     
     initialized_.store(true);
     return true;
 }
 
-bool PECJComputeEngine::createPECJOperator() {
+bool PECJComputeEngine::createPECJOperator(WindowSlot& slot) {
 #ifdef PECJ_FULL_INTEGRATION
     try {
         // Create PECJ config map - use direct make_shared to avoid macro issues
@@ -162,61 +404,65 @@ bool PECJComputeEngine::createPECJOperator() {
         }
         
         // Sync operator_enum with operator_type string if needed
-        PECJOperatorType op_type = stringToOperatorType(config_.operator_type);
+        PECJOperatorType op_type = currentOperator();
         
         // Create operator based on type - support all PECJ operators
+        std::shared_ptr<OoOJoin::AbstractOperator> op;
         switch (op_type) {
             case PECJOperatorType::IAWJ:
-                pecj_operator_ = std::make_shared<OoOJoin::IAWJOperator>();
+                op = std::make_shared<OoOJoin::IAWJOperator>();
                 break;
             case PECJOperatorType::MeanAQP:
-                pecj_operator_ = std::make_shared<OoOJoin::MeanAQPIAWJOperator>();
+                op = std::make_shared<OoOJoin::MeanAQPIAWJOperator>();
                 break;
             case PECJOperatorType::IMA:
-                pecj_operator_ = std::make_shared<OoOJoin::IMAIAWJOperator>();
+                op = std::make_shared<OoOJoin::IMAIAWJOperator>();
                 break;
             case PECJOperatorType::MSWJ:
-                pecj_operator_ = std::make_shared<OoOJoin::MSWJOperator>();
+                op = std::make_shared<OoOJoin::MSWJOperator>();
                 break;
             case PECJOperatorType::AI:
-                pecj_operator_ = std::make_shared<OoOJoin::AIOperator>();
+                op = std::make_shared<OoOJoin::AIOperator>();
                 break;
             case PECJOperatorType::LinearSVI:
-                pecj_operator_ = std::make_shared<OoOJoin::LinearSVIOperator>();
+                op = std::make_shared<OoOJoin::LinearSVIOperator>();
                 break;
             case PECJOperatorType::IAWJSel:
-                pecj_operator_ = std::make_shared<OoOJoin::IAWJSelOperator>();
+                op = std::make_shared<OoOJoin::IAWJSelOperator>();
                 break;
             case PECJOperatorType::LazyIAWJSel:
-                pecj_operator_ = std::make_shared<OoOJoin::LazyIAWJSelOperator>();
+                op = std::make_shared<OoOJoin::LazyIAWJSelOperator>();
                 break;
             case PECJOperatorType::SHJ:
-                pecj_operator_ = std::make_shared<OoOJoin::RawSHJOperator>();
+                op = std::make_shared<OoOJoin::RawSHJOperator>();
                 break;
             case PECJOperatorType::PRJ:
-                pecj_operator_ = std::make_shared<OoOJoin::RawPRJOperator>();
+                op = std::make_shared<OoOJoin::RawPRJOperator>();
                 break;
             case PECJOperatorType::PECJ:
                 // PECJ uses IMAIAWJOperator internally (same as PECJOperator)
-                pecj_operator_ = std::make_shared<OoOJoin::IMAIAWJOperator>();
+                op = std::make_shared<OoOJoin::IMAIAWJOperator>();
                 break;
             default:
                 // Default to IAWJ
-                pecj_operator_ = std::make_shared<OoOJoin::IAWJOperator>();
+                op = std::make_shared<OoOJoin::IAWJOperator>();
                 break;
         }
         
-        if (!pecj_operator_) {
+        if (!op) {
             return false;
         }
         
         // Set configuration
-        if (!pecj_operator_->setConfig(pecj_config)) {
+        if (!op->setConfig(pecj_config)) {
             return false;
         }
         
         // Set initial window parameters (will be adjusted in executeWindowJoin)
-        pecj_operator_->setWindow(config_.window_len_us, config_.slide_len_us);
+        op->setWindow(config_.window_len_us, config_.slide_len_us);
+        slot.op = std::move(op);
+        slot.op_type = op_type;
+        slot.window_len = config_.window_len_us;
         
         // Note: We don't call syncTimeStruct or start() here anymore.
         // These will be called in executeWindowJoin() with the correct
@@ -231,12 +477,29 @@ bool PECJComputeEngine::createPECJOperator() {
     }
 #else
     // Stub mode: no actual PECJ operator
+    (void)slot;
     return true;
 #endif
 }
 
 ComputeStatus PECJComputeEngine::executeWindowJoin(uint64_t window_id,
                                                     const TimeRange& time_range) {
+    if (config_.timeout_ms == 0) {
+        return execute(window_id, time_range, CancellationToken{}, false);
+    }
+    CancellationToken deadline(std::chrono::milliseconds(config_.timeout_ms));
+    return execute(window_id, time_range, deadline, false);
+}
+
+ComputeStatus PECJComputeEngine::executeWindowJoin(uint64_t window_id,
+                                                    const TimeRange& time_range,
+                                                    const CancellationToken& token) {
+    return execute(window_id, time_range, token, false);
+}
+
+ComputeStatus PECJComputeEngine::execute(uint64_t window_id, const TimeRange& time_range,
+                                         const CancellationToken& token, bool exact_completion) {
+    SAGE_TSDB_TRACE_SCOPE_ARG("compute", "pecj.execute", "window_id", window_id);
     if (!initialized_.load()) {
         return ComputeStatus{
             .success = false,
@@ -253,73 +516,104 @@ ComputeStatus PECJComputeEngine::executeWindowJoin(uint64_t window_id,
         };
     }
     
+    // Segments and panes before this window are no longer needed by it
+    if (shared_scan_) {
+        shared_scan_->advance(scan_consumer_, time_range.start_us);
+    }
+    
+    ComputeStatus status;
+    PECJOperatorType op_type = currentOperator();
+    if (config_.enable_pane_mode && paneAligned(time_range)) {
+        status = executePaneWindow(window_id, time_range, token, exact_completion);
+    } else if (usesJoinKernel()) {
+        status = executeKernelWindow(window_id, time_range, token, exact_completion);
+    } else {
+        status = executeOperatorWindow(window_id, time_range, token, exact_completion);
+    }
+    
+    if (selector_ && status.success && !exact_completion && !status.used_panes) {
+        selectOperator(op_type, time_range, status);
+    }
+    
+    if (status.timeout_occurred && !exact_completion) {
+        scheduleExactCompletion(window_id, time_range);
+    }
+    return status;
+}
+
+ComputeStatus PECJComputeEngine::executeOperatorWindow(uint64_t window_id,
+                                                       const TimeRange& time_range,
+                                                       const CancellationToken& token,
+                                                       bool exact_completion) {
     auto start_time = std::chrono::steady_clock::now();
     
     ComputeStatus status;
     status.window_id = window_id;
+    status.exact_completion = exact_completion;
     
 #ifdef PECJ_FULL_INTEGRATION
     try {
-        if (!pecj_operator_) {
+        // Concurrent windows each run on their own pooled operator
+        auto slot = acquireSlot();
+        if (!slot || !slot->op) {
             status.success = false;
             status.error = "PECJ operator not initialized";
             return status;
         }
+        // Auto mode switched operators since this slot last ran
+        if (slot->op_type != currentOperator() && !createPECJOperator(*slot)) {
+            status.success = false;
+            status.error = "Failed to switch PECJ operator";
+            return status;
+        }
+        auto& op = slot->op;
         
-        // Step 1: Query data from sageTSDB tables
-        // Create TimeRange for query
-        sage_tsdb::TimeRange query_range;
-        query_range.start_time = time_range.start_us;
-        query_range.end_time = time_range.end_us;
-        
-        auto s_data_tsdb = db_->query(config_.stream_s_table, query_range);
-        auto r_data_tsdb = db_->query(config_.stream_r_table, query_range);
+        // Step 1: Scan both tables into columns in one pass, tracking the
+        // timestamp range on the way
+        int64_t min_ts = INT64_MAX;
+        int64_t max_ts = INT64_MIN;
+        scanWindowInputs(time_range, *slot, min_ts, max_ts);
         
-        status.input_s_count = s_data_tsdb.size();
-        status.input_r_count = r_data_tsdb.size();
+        status.input_s_count = slot->s.size();
+        status.input_r_count = slot->r.size();
+        if (selector_) {
+            status.key_cardinality = sampleKeyCardinality(slot->s, slot->r);
+        }
         
         // =====================================================================
-        // CRITICAL FIX: Reinitialize PECJ operator for each window execution
+        // Rebase the pooled operator onto this window
         // 
         // PECJ Window Semantics:
         // - start() sets window to [0, windowLen] (relative time)
         // - feedTuple checks if tuple.eventTime is within [startTime, endTime]
-        // - We need to normalize eventTime to be within the window range
+        // - Event times are offset by the window's min timestamp
         // =====================================================================
         
-        // Calculate the min timestamp from queried data
-        uint64_t min_timestamp = UINT64_MAX;
-        uint64_t max_timestamp = 0;
-        
-        for (const auto& data : s_data_tsdb) {
-            if (data.timestamp < min_timestamp) min_timestamp = data.timestamp;
-            if (data.timestamp > max_timestamp) max_timestamp = data.timestamp;
-        }
-        for (const auto& data : r_data_tsdb) {
-            if (data.timestamp < min_timestamp) min_timestamp = data.timestamp;
-            if (data.timestamp > max_timestamp) max_timestamp = data.timestamp;
-        }
-        
         // Handle empty data case
-        if (min_timestamp == UINT64_MAX) {
-            min_timestamp = 0;
-            max_timestamp = config_.window_len_us;
+        uint64_t min_timestamp = 0;
+        uint64_t max_timestamp = config_.window_len_us;
+        if (min_ts <= max_ts) {
+            min_timestamp = static_cast<uint64_t>(min_ts);
+            max_timestamp = static_cast<uint64_t>(max_ts);
         }
         
         // Calculate window length to cover all data with some margin
         uint64_t actual_data_span = max_timestamp - min_timestamp + 1;
         uint64_t effective_window_len = std::max(config_.window_len_us, actual_data_span + 1000);
         
-        // Reconfigure PECJ operator with correct window size
-        pecj_operator_->setWindow(effective_window_len, config_.slide_len_us);
+        // Resize the window only when this slot last ran a different length
+        if (slot->window_len != effective_window_len) {
+            op->setWindow(effective_window_len, config_.slide_len_us);
+            slot->window_len = effective_window_len;
+        }
         
         // Synchronize time structure - this is the reference point for relative time
         struct timeval tv;
         gettimeofday(&tv, nullptr);
-        pecj_operator_->syncTimeStruct(tv);
+        op->syncTimeStruct(tv);
         
-        // CRITICAL: Call start() to reset window state to [0, effective_window_len]
-        if (!pecj_operator_->start()) {
+        // start() resets window state to [0, effective_window_len]
+        if (!op->start()) {
             status.success = false;
             status.error = "Failed to restart PECJ operator";
             return status;
@@ -327,58 +621,51 @@ ComputeStatus PECJComputeEngine::executeWindowJoin(uint64_t window_id,
         
         // Step 2: Feed data to PECJ operator with NORMALIZED eventTime
         // Use getAQPResult() to get results with prediction compensation (for IMA operator)
-        size_t join_count_before = pecj_operator_->getAQPResult();
+        size_t join_count_before = op->getAQPResult();
         
-        for (const auto& data : s_data_tsdb) {
-            // Convert TimeSeriesData to PECJ tuple
-            OoOJoin::keyType key = 0;
-            if (data.tags.count("key")) {
-                key = std::stoull(data.tags.at("key"));
-            }
-            
-            OoOJoin::valueType value = 0;
-            if (data.fields.count("value")) {
-                value = static_cast<OoOJoin::valueType>(std::stod(data.fields.at("value")));
-            }
-            
-            // CRITICAL FIX: Normalize eventTime to be within [0, window_len]
-            // eventTime is what PECJ uses to determine if tuple is in window
-            OoOJoin::tsType eventTime = data.timestamp - min_timestamp;  // Normalized to start from 0
-            OoOJoin::tsType arrivalTime = data.timestamp - min_timestamp;  // Also normalized
-            
-            auto tuple = std::make_shared<OoOJoin::TrackTuple>(key, value, eventTime, arrivalTime);
-            pecj_operator_->feedTupleS(tuple);
+        // Load shedding: a sample of both streams when a rate is set
+        size_t stride = 1;
+        if (double rate = sample_rate_.load(); config_.enable_aqp && rate < 1.0) {
+            stride = static_cast<size_t>(std::lround(1.0 / rate));
         }
         
-        for (const auto& data : r_data_tsdb) {
-            // Convert TimeSeriesData to PECJ tuple
-            OoOJoin::keyType key = 0;
-            if (data.tags.count("key")) {
-                key = std::stoull(data.tags.at("key"));
-            }
-            
-            OoOJoin::valueType value = 0;
-            if (data.fields.count("value")) {
-                value = static_cast<OoOJoin::valueType>(std::stod(data.fields.at("value")));
-            }
-            
-            // CRITICAL FIX: Normalize eventTime to be within [0, window_len]
-            OoOJoin::tsType eventTime = data.timestamp - min_timestamp;  // Normalized to start from 0
-            OoOJoin::tsType arrivalTime = data.timestamp - min_timestamp;  // Also normalized
-            
-            auto tuple = std::make_shared<OoOJoin::TrackTuple>(key, value, eventTime, arrivalTime);
-            pecj_operator_->feedTupleR(tuple);
+        SAGE_TSDB_TRACE_BEGIN(convert_span, "compute", "pecj.convert");
+        auto base_ts = static_cast<int64_t>(min_timestamp);
+        const size_t s_total = slot->s_tuples.fill(slot->s, base_ts, stride);
+        const size_t r_total = slot->r_tuples.fill(slot->r, base_ts, stride);
+        SAGE_TSDB_TRACE_END(convert_span);
+        
+        SAGE_TSDB_TRACE_BEGIN(operator_span, "compute", "pecj.operator");
+        
+        // Feed both streams in the same fractions, so a window cut off at
+        // the deadline has joined a known share of each
+        const size_t steps = std::max<size_t>(
+            1, (std::max(s_total, r_total) + CANCEL_CHECK_BATCH - 1) / CANCEL_CHECK_BATCH);
+        size_t fed_steps = 0;
+        size_t s_fed = 0;
+        size_t r_fed = 0;
+        while (fed_steps < steps && (fed_steps == 0 || !token.expired())) {
+            ++fed_steps;
+            size_t s_next = s_total * fed_steps / steps;
+            size_t r_next = r_total * fed_steps / steps;
+            slot->s_tuples.feed(s_fed, s_next, [&op](auto tuple) {
+                op->feedTupleS(tuple);
+            });
+            slot->r_tuples.feed(r_fed, r_next, [&op](auto tuple) {
+                op->feedTupleR(tuple);
+            });
+            s_fed = s_next;
+            r_fed = r_next;
         }
         
         // Step 3: Get join results BEFORE stopping (stop() may clear state)
         // Get both confirmed result and AQP result for comparison
-        size_t confirmed_result = pecj_operator_->getResult();
-        size_t aqp_result = pecj_operator_->getAQPResult();
+        size_t confirmed_result = op->getResult();
+        size_t aqp_result = op->getAQPResult();
         status.join_count = aqp_result - join_count_before;
         
         // Step 3.5: Get AQP result if operator supports it
-        PECJOperatorType op_type = stringToOperatorType(config_.operator_type);
-        if (operatorSupportsAQP(op_type)) {
+        if (operatorSupportsAQP(slot->op_type)) {
             status.aqp_estimate = static_cast<double>(aqp_result);
             status.used_aqp = true;
             
@@ -389,8 +676,24 @@ ComputeStatus PECJComputeEngine::executeWindowJoin(uint64_t window_id,
             }
         }
         
+        // A sampled pair survives with probability 1/stride^2, a pair of
+        // a cut-off window with f^2 for the fed fraction f
+        double scale = static_cast<double>(stride * stride);
+        if (fed_steps < steps) {
+            double fed = static_cast<double>(fed_steps) / static_cast<double>(steps);
+            scale /= fed * fed;
+            status.timeout_occurred = true;
+        }
+        if (scale > 1.0) {
+            status.join_count = static_cast<size_t>(
+                std::llround(static_cast<double>(status.join_count) * scale));
+            status.aqp_estimate = static_cast<double>(status.join_count);
+            status.used_aqp = true;
+        }
+        
         // Step 4: Stop operator after getting results
-        pecj_operator_->stop();
+        op->stop();
+        SAGE_TSDB_TRACE_END(operator_span);
         
         // Step 4: Calculate metrics
         auto end_time = std::chrono::steady_clock::now();
@@ -404,6 +707,14 @@ ComputeStatus PECJComputeEngine::executeWindowJoin(uint64_t window_id,
         
         status.success = true;
         
+        if (config_.retain_late_state) {
+            LateWindow late;
+            late.time_range = time_range;
+            late.addColumns(slot->s.keys, slot->r.keys, slot->r.values);
+            late.result = static_cast<double>(status.join_count);
+            retainLateWindow(window_id, std::move(late));
+        }
+        
         // Step 5: Update global metrics
         updateMetrics(status);
         
@@ -412,7 +723,18 @@ ComputeStatus PECJComputeEngine::executeWindowJoin(uint64_t window_id,
         status.error = std::string("Exception: ") + e.what();
     }
 #else
-    // Stub mode: return successful status without computation
+    // Stub mode: scan the inputs so the counts are real, but do not join
+    (void)token;
+    if (auto slot = acquireSlot()) {
+        int64_t min_ts = INT64_MAX;
+        int64_t max_ts = INT64_MIN;
+        scanWindowInputs(time_range, *slot, min_ts, max_ts);
+        status.input_s_count = slot->s.size();
+        status.input_r_count = slot->r.size();
+        if (selector_) {
+            status.key_cardinality = sampleKeyCardinality(slot->s, slot->r);
+        }
+    }
     status.success = true;
     status.join_count = 0;
     status.computation_time_ms = 0.0;
@@ -422,101 +744,416 @@ ComputeStatus PECJComputeEngine::executeWindowJoin(uint64_t window_id,
     return status;
 }
 
-#ifdef PECJ_FULL_INTEGRATION
-// Note: This function is not currently used - PECJ join is triggered via feedTuple* methods
-ComputeStatus PECJComputeEngine::executeWithTimeout(
-    const std::vector<OoOJoin::TrackTuple>& s_data,
-    const std::vector<OoOJoin::TrackTuple>& r_data,
-    uint64_t window_id,
-    const TimeRange& time_range) {
-    (void)time_range;  // Unused parameter
-    (void)s_data;
-    (void)r_data;
+bool PECJComputeEngine::usesJoinKernel() const {
+    // The kernel computes exact intra-window joins, i.e. what IAWJ and SHJ report
+    if (!config_.enable_simd) {
+        return false;
+    }
+    PECJOperatorType op_type = currentOperator();
+    return op_type == PECJOperatorType::IAWJ || op_type == PECJOperatorType::SHJ;
+}
+
+PECJOperatorType PECJComputeEngine::currentOperator() const {
+    return selector_ ? selector_->current() : stringToOperatorType(config_.operator_type);
+}
+
+std::string PECJComputeEngine::activeOperator() const {
+    return operatorName(currentOperator());
+}
+
+void PECJComputeEngine::selectOperator(PECJOperatorType ran, const TimeRange& time_range,
+                                       const ComputeStatus& status) {
+    WorkloadSample sample;
+    sample.input_tuples = status.input_s_count + status.input_r_count;
+    sample.window_len_us = static_cast<uint64_t>(time_range.duration());
+    sample.distinct_keys = static_cast<double>(status.key_cardinality);
+    sample.selectivity = status.selectivity;
+    selector_->observeWindow(ran, sample, status.computation_time_ms, status.timeout_occurred);
+    selector_->choose(status.window_id);
+}
+
+ComputeStatus PECJComputeEngine::executeKernelWindow(uint64_t window_id,
+                                                     const TimeRange& time_range,
+                                                     const CancellationToken& token,
+                                                     bool exact_completion) {
+    auto start_time = std::chrono::steady_clock::now();
     
     ComputeStatus status;
     status.window_id = window_id;
-    status.success = false;
-    status.error = "executeWithTimeout not implemented - use feedTuple* methods instead";
+    status.exact_completion = exact_completion;
+    status.used_join_kernel = true;
     
-    /* Legacy code - PECJ doesn't have a join() method
     try {
-        auto start = std::chrono::steady_clock::now();
+        // The slot only lends its column buffers here
+        auto slot = acquireSlot();
+        if (!slot) {
+            status.success = false;
+            status.error = "No window slot available";
+            return status;
+        }
         
-        // Execute PECJ join
-        std::vector<std::pair<OoOJoin::TrackTuple, OoOJoin::TrackTuple>> join_results;
+        int64_t min_ts = INT64_MAX;
+        int64_t max_ts = INT64_MIN;
+        scanWindowInputs(time_range, *slot, min_ts, max_ts);
+        status.input_s_count = slot->s.size();
+        status.input_r_count = slot->r.size();
+        if (selector_) {
+            status.key_cardinality = sampleKeyCardinality(slot->s, slot->r);
+        }
+        
+        // Late tuples join against every tuple, not just the sample
+        LateWindow late;
+        if (config_.retain_late_state) {
+            late.time_range = time_range;
+            late.addColumns(slot->s.keys, slot->r.keys, slot->r.values);
+        }
+        
+        // Load shedding: the same sample of both streams as the operator path
+        size_t stride = 1;
+        if (double rate = sample_rate_.load(); config_.enable_aqp && rate < 1.0) {
+            stride = static_cast<size_t>(std::lround(1.0 / rate));
+        }
+        if (stride > 1) {
+            keepEvery(slot->s, stride);
+            keepEvery(slot->r, stride);
+        }
+        
+        // Large windows are split by key into buckets joined in parallel
+        size_t ways = 1;
+        if (resource_handle_ && config_.max_threads > 1 &&
+            slot->s.size() + slot->r.size() >= config_.parallel_join_min_tuples) {
+            ways = static_cast<size_t>(config_.max_threads);
+            int allocated = resource_handle_->getAllocated().requested_threads;
+            if (allocated > 0) {
+                ways = std::min(ways, static_cast<size_t>(allocated));
+            }
+        }
+        auto submit = [handle = resource_handle_](std::function<void()> task) {
+            return handle->submitTask(std::move(task));
+        };
+        SAGE_TSDB_TRACE_BEGIN(join_span, "compute", "pecj.join_kernel");
+        SAGE_TSDB_TRACE_SET_ARG(join_span, "ways", ways);
+        auto buckets = join_kernels::parallel_hash_join(
+            slot->s.keys.data(), slot->s.size(),
+            slot->r.keys.data(), config_.join_sum ? slot->r.values.data() : nullptr,
+            slot->r.size(), ways,
+            ways > 1 ? join_kernels::TaskSubmit(submit) : join_kernels::TaskSubmit(),
+            [&token]() { return token.expired(); });
+        SAGE_TSDB_TRACE_END(join_span);
+        status.join_buckets = buckets.size();
         
-        // TODO: Implement timeout mechanism using resource_handle_->submitTask()
-        // For now, execute directly
-        if (pecj_operator_) {
-            // PECJ processes tuples via feedTupleS/R, not a join() method
+        // Buckets hold disjoint keys: add their results, each scaled up by
+        // its own share of partitions joined when the deadline cut it off
+        double result = 0.0;
+        for (const JoinAggregate& joined : buckets) {
+            double partial = config_.join_sum ? joined.sum : static_cast<double>(joined.pairs);
+            if (joined.partitions_joined < joined.partitions) {
+                partial *= static_cast<double>(joined.partitions) /
+                           static_cast<double>(joined.partitions_joined);
+                status.timeout_occurred = true;
+            }
+            result += partial;
+        }
+        
+        // A sampled pair survives with probability 1/stride^2
+        double scale = static_cast<double>(stride * stride);
+        status.join_count = static_cast<size_t>(std::llround(result * scale));
+        if (scale > 1.0 || status.timeout_occurred) {
+            status.aqp_estimate = static_cast<double>(status.join_count);
+            status.used_aqp = true;
         }
         
-    */ // End of legacy code
+        status.computation_time_ms = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start_time).count();
+        if (status.input_s_count > 0 && status.input_r_count > 0) {
+            status.selectivity = static_cast<double>(status.join_count) /
+                               (status.input_s_count * status.input_r_count);
+        }
+        status.success = true;
+        
+        if (config_.retain_late_state) {
+            late.result = static_cast<double>(status.join_count);
+            retainLateWindow(window_id, std::move(late));
+        }
+        
+        updateMetrics(status);
+        
+    } catch (const std::exception& e) {
+        status.success = false;
+        status.error = std::string("Exception: ") + e.what();
+    }
     
     return status;
 }
 
-#endif // PECJ_FULL_INTEGRATION (end of executeWithTimeout)
+std::shared_ptr<PECJComputeEngine::WindowSlot> PECJComputeEngine::acquireSlot() {
+    // Return the slot to the pool instead of destroying it
+    auto lease = [this](WindowSlot* slot) {
+        return std::shared_ptr<WindowSlot>(slot, [this](WindowSlot* returned) {
+            {
+                std::lock_guard<std::mutex> pool_lock(pool_mutex_);
+                idle_slots_.emplace_back(returned);
+            }
+            pool_cv_.notify_one();
+        });
+    };
+    
+    std::unique_lock<std::mutex> pool_lock(pool_mutex_);
+    // Bound the slots checked out, so a lowered limit takes effect even
+    // while more slots exist
+    pool_cv_.wait(pool_lock, [&]() {
+        return slots_created_ - idle_slots_.size() < slot_limit_;
+    });
+    if (!idle_slots_.empty()) {
+        WindowSlot* slot = idle_slots_.back().release();
+        idle_slots_.pop_back();
+        return lease(slot);
+    }
+    
+    // Build outside the lock; the count reserves the slot meanwhile
+    slots_created_++;
+    pool_lock.unlock();
+    auto slot = std::make_unique<WindowSlot>();
+    if (!createPECJOperator(*slot)) {
+        pool_lock.lock();
+        slots_created_--;
+        pool_lock.unlock();
+        pool_cv_.notify_one();
+        return nullptr;
+    }
+    return lease(slot.release());
+}
+
+void PECJComputeEngine::scanWindowInputs(const TimeRange& time_range, WindowSlot& slot,
+                                         int64_t& min_ts, int64_t& max_ts) {
+    SAGE_TSDB_TRACE_SCOPE("compute", "pecj.scan");
+    slot.s.clear();
+    slot.r.clear();
+    if (shared_scan_) {
+        shared_scan_->scan(config_.stream_s_table, time_range.start_us, time_range.end_us,
+                           slot.s, min_ts, max_ts);
+        shared_scan_->scan(config_.stream_r_table, time_range.start_us, time_range.end_us,
+                           slot.r, min_ts, max_ts);
+        return;
+    }
+    scanTableRange(*db_, config_.stream_s_table, time_range.start_us, time_range.end_us,
+                   slot.s, min_ts, max_ts);
+    scanTableRange(*db_, config_.stream_r_table, time_range.start_us, time_range.end_us,
+                   slot.r, min_ts, max_ts);
+}
 
-#ifdef PECJ_FULL_INTEGRATION
-// Note: This function is not currently used
-ComputeStatus PECJComputeEngine::fallbackToAQP(
-    const std::vector<OoOJoin::TrackTuple>& s_data,
-    const std::vector<OoOJoin::TrackTuple>& r_data,
-    uint64_t window_id) {
-    (void)s_data;
-    (void)r_data;
+bool PECJComputeEngine::paneAligned(const TimeRange& time_range) const {
+    const auto slide = static_cast<int64_t>(config_.slide_len_us);
+    const auto window = static_cast<int64_t>(config_.window_len_us);
+    // join_sum needs tuple values, which panes do not keep
+    return !config_.join_sum && window % slide == 0 && time_range.start_us >= 0 &&
+           time_range.duration() == window && time_range.start_us % slide == 0;
+}
+
+ComputeStatus PECJComputeEngine::executePaneWindow(uint64_t window_id,
+                                                    const TimeRange& time_range,
+                                                    const CancellationToken& token,
+                                                    bool exact_completion) {
+    auto start_time = std::chrono::steady_clock::now();
     
     ComputeStatus status;
     status.window_id = window_id;
-    status.success = false;
-    status.error = "AQP fallback not implemented";
-    /* Legacy code
-    status.input_s_count = s_data.size();
-    status.input_r_count = r_data.size();
-    status.used_aqp = true;
+    status.exact_completion = exact_completion;
+    status.used_panes = true;
+    
+    const auto slide = static_cast<int64_t>(config_.slide_len_us);
+    const int64_t first = time_range.start_us / slide;
+    const int64_t last = time_range.end_us / slide;
+    LateWindow late;
+    
     try {
-        // Simple AQP estimation: use sampling
-        double sample_ratio = 0.1; // Sample 10%
-        size_t s_sample_size = std::max(size_t(1), size_t(s_data.size() * sample_ratio));
-        size_t r_sample_size = std::max(size_t(1), size_t(r_data.size() * sample_ratio));
+        std::lock_guard<std::mutex> lock(pane_mutex_);
+        PaneState& state = *panes_;
         
-        // Execute join on sample
-        std::vector<OoOJoin::TrackTuple> s_sample(s_data.begin(), 
-                                                   s_data.begin() + s_sample_size);
-        std::vector<OoOJoin::TrackTuple> r_sample(r_data.begin(),
-                                                   r_data.begin() + r_sample_size);
+        // Read a pane once: reduce both streams to per-key counts, or take
+        // them from the engines sharing scans
+        auto pane = [&](int64_t index) -> const PaneCounts& {
+            auto it = state.panes.find(index);
+            if (it != state.panes.end()) {
+                status.panes_reused++;
+                return *it->second;
+            }
+            SAGE_TSDB_TRACE_SCOPE_ARG("compute", "pecj.pane_scan", "pane",
+                                      static_cast<uint64_t>(index));
+            std::shared_ptr<const PaneCounts> counts;
+            if (shared_scan_) {
+                counts = shared_scan_->pane(config_.stream_s_table, config_.stream_r_table,
+                                            config_.slide_len_us, index);
+            } else {
+                auto computed = std::make_shared<PaneCounts>();
+                // Table queries are inclusive at both ends; panes are [start, end)
+                sage_tsdb::TimeRange range(index * slide, (index + 1) * slide - 1);
+                for (auto point : db_->query_view(config_.stream_s_table, range)) {
+                    computed->s_keys[joinKey(point.tags())]++;
+                    computed->s_count++;
+                }
+                for (auto point : db_->query_view(config_.stream_r_table, range)) {
+                    computed->r_keys[joinKey(point.tags())]++;
+                    computed->r_count++;
+                }
+                counts = std::move(computed);
+            }
+            status.panes_computed++;
+            return *state.panes.emplace(index, std::move(counts)).first->second;
+        };
+        
+        // Slide the running aggregate to [first, last); a window that does
+        // not overlap the previous one is rebuilt from its panes
+        if (first >= state.last || last <= state.first) {
+            state.clearWindow();
+            state.first = state.last = first;
+        }
+        while (state.first < first) state.remove(pane(state.first++));
+        while (state.last > last) state.remove(pane(--state.last));
         
-        // PECJ doesn't have join() method
-        //auto sample_results = pecj_operator_->join(s_sample, r_sample);
+        // Panes entering the window are the batches: past the deadline the
+        // aggregate stays at the panes added so far, and the next window
+        // slides on from there
+        size_t added = 0;
+        auto more = [&]() { return added++ == 0 || !token.expired(); };
+        while (state.first > first && more()) state.add(pane(--state.first));
+        while (state.last < last && more()) state.add(pane(state.last++));
+        
+        // Evict panes behind the watermark (the window start), then enforce the bound
+        state.panes.erase(state.panes.begin(), state.panes.lower_bound(first));
+        size_t max_panes = config_.max_cached_panes > 0
+            ? config_.max_cached_panes
+            : static_cast<size_t>(last - first) + 1;
+        while (state.panes.size() > max_panes) {
+            state.panes.erase(std::prev(state.panes.end()));
+        }
+        
+        status.join_count = static_cast<size_t>(state.join_count);
+        status.input_s_count = state.s_count;
+        status.input_r_count = state.r_count;
+        status.success = true;
         
-    */ // End of legacy code
+        const int64_t covered = state.last - state.first;
+        if (covered < last - first) {
+            // Estimate from the covered share of the window's panes
+            double fed = static_cast<double>(covered) / static_cast<double>(last - first);
+            status.join_count = static_cast<size_t>(
+                std::llround(static_cast<double>(state.join_count) / (fed * fed)));
+            status.aqp_estimate = static_cast<double>(status.join_count);
+            status.used_aqp = true;
+            status.timeout_occurred = true;
+        } else if (config_.retain_late_state) {
+            // Panes keep no values: pane windows never use join_sum
+            late.time_range = time_range;
+            late.s_keys = state.s_keys;
+            for (const auto& [key, count] : state.r_keys) {
+                late.r_keys[key].count = count;
+            }
+            late.s_count = state.s_count;
+            late.r_count = state.r_count;
+            late.result = static_cast<double>(state.join_count);
+        }
+    } catch (const std::exception& e) {
+        // Leave no half-applied window behind
+        panes_->clearWindow();
+        status.success = false;
+        status.error = std::string("Exception: ") + e.what();
+        return status;
+    }
+    
+    status.computation_time_ms = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start_time).count();
+    if (status.input_s_count > 0 && status.input_r_count > 0) {
+        status.selectivity = static_cast<double>(status.join_count) /
+                           (static_cast<double>(status.input_s_count) * status.input_r_count);
+    }
     
+    if (config_.retain_late_state && !status.timeout_occurred) {
+        retainLateWindow(window_id, std::move(late));
+    }
+    
+    updateMetrics(status);
     return status;
 }
-#endif // PECJ_FULL_INTEGRATION
 
-#ifdef PECJ_FULL_INTEGRATION
-std::vector<OoOJoin::TrackTuple> PECJComputeEngine::convertFromTable(
-    const std::vector<std::vector<uint8_t>>& db_data) {
+void PECJComputeEngine::retainLateWindow(uint64_t window_id, LateWindow window) {
+    std::lock_guard<std::mutex> lock(late_mutex_);
+    // Windows start in time order, so a window's start is a watermark
+    late_->expire(window.time_range.start_us, config_.max_delay_us);
+    late_->windows[window_id] = std::move(window);
+}
+
+ComputeStatus PECJComputeEngine::joinLateTuples(uint64_t window_id,
+                                                const std::vector<TimeSeriesData>& late_s,
+                                                const std::vector<TimeSeriesData>& late_r) {
+    auto start_time = std::chrono::steady_clock::now();
     
-    std::vector<OoOJoin::TrackTuple> result;
-    result.reserve(db_data.size());
+    ComputeStatus status;
+    status.window_id = window_id;
+    status.late_correction = true;
+    status.input_s_count = late_s.size();
+    status.input_r_count = late_r.size();
+    
+    // Late tuples are the disorder the Auto selector weighs, retained or not
+    if (selector_) {
+        selector_->observeLateTuples(late_s.size() + late_r.size());
+    }
     
-    for (const auto& raw_data : db_data) {
-        if (raw_data.size() < sizeof(OoOJoin::TrackTuple)) {
-            continue; // Skip invalid data
+    {
+        std::lock_guard<std::mutex> lock(late_mutex_);
+        auto it = late_->windows.find(window_id);
+        if (it == late_->windows.end()) {
+            status.success = false;
+            status.error = "Window state not retained";
+            return status;
+        }
+        LateWindow& window = it->second;
+        
+        // S against the retained R, then R against S including the late S:
+        // every new pair is counted once
+        double delta = 0.0;
+        for (const auto& tuple : late_s) {
+            uint64_t key = joinKey(tuple.tags);
+            auto r = window.r_keys.find(key);
+            if (r != window.r_keys.end()) {
+                delta += config_.join_sum ? r->second.sum : static_cast<double>(r->second.count);
+            }
+            window.addS(key);
+        }
+        for (const auto& tuple : late_r) {
+            uint64_t key = joinKey(tuple.tags);
+            double value = joinValue(tuple.fields);
+            auto s = window.s_keys.find(key);
+            if (s != window.s_keys.end()) {
+                double pairs = static_cast<double>(s->second);
+                delta += config_.join_sum ? pairs * value : pairs;
+            }
+            window.addR(key, value);
         }
         
-        // Deserialize from bytes
-        OoOJoin::TrackTuple tuple(0); // Provide default key value
-        std::memcpy(&tuple, raw_data.data(), sizeof(OoOJoin::TrackTuple));
-        result.push_back(tuple);
+        window.result += delta;
+        status.join_count = static_cast<size_t>(std::llround(window.result));
+        if (window.s_count > 0 && window.r_count > 0) {
+            status.selectivity = window.result /
+                               (static_cast<double>(window.s_count) * window.r_count);
+        }
     }
     
-    return result;
+    status.success = true;
+    status.computation_time_ms = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start_time).count();
+    
+    late_corrections_.inc();
+    late_tuples_joined_.inc(late_s.size() + late_r.size());
+    return status;
+}
+
+void PECJComputeEngine::expireLateState(int64_t watermark_us) {
+    std::lock_guard<std::mutex> lock(late_mutex_);
+    late_->expire(watermark_us, config_.max_delay_us);
 }
 
+#ifdef PECJ_FULL_INTEGRATION
 std::vector<std::vector<uint8_t>> PECJComputeEngine::convertToTable(
     const std::vector<std::pair<OoOJoin::TrackTuple, OoOJoin::TrackTuple>>& pecj_result) {
     
@@ -542,6 +1179,7 @@ std::vector<std::vector<uint8_t>> PECJComputeEngine::convertToTable(
 bool PECJComputeEngine::writeResults(uint64_t window_id,
                                      const std::vector<std::vector<uint8_t>>& results,
                                      const ComputeStatus& status) {
+    SAGE_TSDB_TRACE_SCOPE_ARG("compute", "pecj.write_results", "window_id", window_id);
     (void)window_id;  // Unused parameter
     (void)results;    // Unused parameter
     (void)status;     // Unused parameter
@@ -568,54 +1206,47 @@ bool PECJComputeEngine::writeResults(uint64_t window_id,
 }
 
 void PECJComputeEngine::updateMetrics(const ComputeStatus& status) {
-    std::unique_lock<std::shared_mutex> lock(metrics_mutex_);
+    if (status.exact_completion) {
+        // The window itself was already counted when it timed out
+        exact_completions_.inc();
+        return;
+    }
+    
+    // Latency goes to the histogram; percentiles are derived on read in
+    // getMetrics()
+    if (status.computation_time_ms > 0) {
+        window_latency_.record(static_cast<uint64_t>(status.computation_time_ms * 1000.0));
+    }
     
     if (status.success) {
-        metrics_.total_windows_completed++;
-        metrics_.total_tuples_processed += status.input_s_count + status.input_r_count;
+        windows_completed_.inc();
+        tuples_processed_.inc(status.input_s_count + status.input_r_count);
     } else {
-        metrics_.failed_windows++;
+        failed_windows_.inc();
     }
     
     if (status.timeout_occurred) {
-        metrics_.timeout_windows++;
+        timeout_windows_.inc();
     }
     
-    // Update latency statistics
-    if (status.computation_time_ms > 0) {
-        latency_samples_.push_back(status.computation_time_ms);
-        
-        // Keep only recent samples
-        if (latency_samples_.size() > MAX_LATENCY_SAMPLES) {
-            latency_samples_.erase(latency_samples_.begin());
-        }
-        
-        // Calculate statistics
-        auto sorted_samples = latency_samples_;
-        std::sort(sorted_samples.begin(), sorted_samples.end());
-        
-        metrics_.avg_window_latency_ms = std::accumulate(
-            sorted_samples.begin(), sorted_samples.end(), 0.0) / sorted_samples.size();
-        
-        metrics_.min_window_latency_ms = sorted_samples.front();
-        metrics_.max_window_latency_ms = sorted_samples.back();
-        metrics_.p99_window_latency_ms = calculatePercentile(sorted_samples, 0.99);
-    }
+    panes_computed_.inc(status.panes_computed);
+    pane_cache_hits_.inc(status.panes_reused);
     
-    // Update selectivity
+    // Selectivity is averaged over completed windows on read
     if (status.selectivity > 0) {
-        double total_selectivity = metrics_.avg_join_selectivity * 
-                                  (metrics_.total_windows_completed - 1);
-        metrics_.avg_join_selectivity = 
-            (total_selectivity + status.selectivity) / metrics_.total_windows_completed;
+        selectivity_sum_.fetch_add(status.selectivity, std::memory_order_relaxed);
     }
     
     // Update memory
-    metrics_.peak_memory_bytes = std::max(metrics_.peak_memory_bytes, 
-                                         status.memory_used_bytes);
+    size_t peak = peak_memory_bytes_.load(std::memory_order_relaxed);
+    while (status.memory_used_bytes > peak &&
+           !peak_memory_bytes_.compare_exchange_weak(peak, status.memory_used_bytes,
+                                                     std::memory_order_relaxed)) {
+    }
     
     // Update AQP metrics
     if (status.used_aqp && status.aqp_error > 0) {
+        std::unique_lock<std::shared_mutex> lock(metrics_mutex_);
         double total_error = metrics_.avg_aqp_error_rate * 
                            (metrics_.aqp_invocations - 1);
         metrics_.avg_aqp_error_rate = 
@@ -623,9 +1254,157 @@ void PECJComputeEngine::updateMetrics(const ComputeStatus& status) {
     }
 }
 
+std::vector<MetricsRegistry::Handle> PECJComputeEngine::registerMetrics(
+    MetricsRegistry& registry, const Tags& labels) const {
+    std::vector<MetricsRegistry::Handle> handles;
+    auto counter = [&](const char* name, const char* help, const Counter& value) {
+        handles.push_back(registry.addCounter(name, help, labels, [&value]() {
+            return static_cast<double>(value.value());
+        }));
+    };
+    auto gauge = [&](const char* name, const char* help, const auto& value) {
+        handles.push_back(registry.addGauge(name, help, labels, [&value]() {
+            return static_cast<double>(value.load(std::memory_order_relaxed));
+        }));
+    };
+    
+    counter("sage_tsdb_compute_windows_completed_total", "Windows the engine joined",
+            windows_completed_);
+    counter("sage_tsdb_compute_tuples_processed_total", "Input tuples of completed windows",
+            tuples_processed_);
+    counter("sage_tsdb_compute_windows_failed_total", "Windows the engine failed to join",
+            failed_windows_);
+    counter("sage_tsdb_compute_windows_timeout_total", "Windows that hit their deadline",
+            timeout_windows_);
+    counter("sage_tsdb_compute_exact_completions_total",
+            "Timed-out windows later completed exactly", exact_completions_);
+    counter("sage_tsdb_compute_panes_computed_total", "Panes joined", panes_computed_);
+    counter("sage_tsdb_compute_pane_cache_hits_total", "Panes reused from the cache",
+            pane_cache_hits_);
+    counter("sage_tsdb_compute_late_corrections_total", "Windows updated by late tuples",
+            late_corrections_);
+    counter("sage_tsdb_compute_late_tuples_total", "Late tuples joined into retained windows",
+            late_tuples_joined_);
+    gauge("sage_tsdb_compute_peak_memory_bytes", "Largest memory use of a window",
+          peak_memory_bytes_);
+    gauge("sage_tsdb_compute_sample_rate", "AQP sampling rate (1 = exact)", sample_rate_);
+    handles.push_back(registry.addHistogram("sage_tsdb_compute_window_seconds",
+                                            "Engine computation time per window", labels,
+                                            &window_latency_));
+    return handles;
+}
+
+void PECJComputeEngine::setSampleRate(double rate) {
+    sample_rate_.store(std::clamp(rate, 1e-3, 1.0));
+}
+
+void PECJComputeEngine::setMaxConcurrentWindows(size_t windows) {
+    {
+        std::lock_guard<std::mutex> pool_lock(pool_mutex_);
+        slot_limit_ = std::max<size_t>(1, windows);
+    }
+    // A larger bound may admit waiting windows
+    pool_cv_.notify_all();
+}
+
+void PECJComputeEngine::setBackgroundHandle(core::ResourceHandle* handle) {
+    background_handle_.store(handle);
+}
+
+void PECJComputeEngine::setSharedScan(SharedScanCoordinator* scan) {
+    if (shared_scan_) {
+        shared_scan_->unregisterConsumer(scan_consumer_);
+    }
+    shared_scan_ = scan;
+    scan_consumer_ = scan ? scan->registerConsumer() : 0;
+    
+    // Cached panes may come from a different source
+    std::lock_guard<std::mutex> pane_lock(pane_mutex_);
+    panes_->panes.clear();
+    panes_->clearWindow();
+}
+
+void PECJComputeEngine::onExactResult(ExactResultCallback callback) {
+    std::lock_guard<std::mutex> lock(callbacks_mutex_);
+    exact_callbacks_.push_back(std::move(callback));
+}
+
+void PECJComputeEngine::scheduleExactCompletion(uint64_t window_id, const TimeRange& time_range) {
+    core::ResourceHandle* handle = background_handle_.load();
+    if (!config_.complete_after_timeout || !handle) {
+        return;
+    }
+    
+    handle->submitTask([this, lifetime = lifetime_, window_id, time_range]() {
+        std::shared_lock<std::shared_mutex> alive(lifetime->mutex);
+        if (!lifetime->alive) {
+            return;  // Engine destroyed while the task was queued
+        }
+        
+        CancellationToken no_deadline;
+        ComputeStatus status = execute(window_id, time_range, no_deadline, true);
+        
+        std::vector<ExactResultCallback> callbacks;
+        {
+            std::lock_guard<std::mutex> lock(callbacks_mutex_);
+            callbacks = exact_callbacks_;
+        }
+        for (auto& callback : callbacks) {
+            try {
+                callback(status);
+            } catch (const std::exception& e) {
+                std::cerr << "PECJComputeEngine: exact result callback error: " << e.what() << std::endl;
+            }
+        }
+    });
+}
+
 ComputeMetrics PECJComputeEngine::getMetrics() const {
-    std::shared_lock<std::shared_mutex> lock(metrics_mutex_);
-    return metrics_;
+    ComputeMetrics metrics;
+    {
+        std::shared_lock<std::shared_mutex> lock(metrics_mutex_);
+        metrics = metrics_;
+    }
+    metrics.total_windows_completed = windows_completed_.value();
+    metrics.total_tuples_processed = tuples_processed_.value();
+    metrics.failed_windows = failed_windows_.value();
+    metrics.timeout_windows = timeout_windows_.value();
+    metrics.exact_completions = exact_completions_.value();
+    metrics.panes_computed = panes_computed_.value();
+    metrics.pane_cache_hits = pane_cache_hits_.value();
+    metrics.late_corrections = late_corrections_.value();
+    metrics.late_tuples_joined = late_tuples_joined_.value();
+    metrics.peak_memory_bytes = peak_memory_bytes_.load(std::memory_order_relaxed);
+    if (metrics.total_windows_completed > 0) {
+        metrics.avg_join_selectivity = selectivity_sum_.load(std::memory_order_relaxed) /
+                                       metrics.total_windows_completed;
+    }
+    
+    auto latency = window_latency_.snapshot();
+    if (latency.count > 0) {
+        metrics.avg_window_latency_ms = latency.mean / 1000.0;
+        metrics.min_window_latency_ms = latency.min / 1000.0;
+        metrics.max_window_latency_ms = latency.max / 1000.0;
+        metrics.p50_window_latency_ms = latency.percentile(0.5) / 1000.0;
+        metrics.p90_window_latency_ms = latency.percentile(0.9) / 1000.0;
+        metrics.p99_window_latency_ms = latency.percentile(0.99) / 1000.0;
+        metrics.p999_window_latency_ms = latency.percentile(0.999) / 1000.0;
+    }
+    
+    {
+        std::lock_guard<std::mutex> late_lock(late_mutex_);
+        metrics.retained_windows = late_->windows.size();
+    }
+    
+    if (selector_) {
+        metrics.operator_switches = selector_->switches();
+        metrics.operator_decisions = selector_->decisions();
+    }
+    metrics.active_operator = activeOperator();
+    
+    std::lock_guard<std::mutex> pool_lock(pool_mutex_);
+    metrics.pooled_operators = slots_created_;
+    return metrics;
 }
 
 void PECJComputeEngine::reset() {
@@ -633,11 +1412,26 @@ void PECJComputeEngine::reset() {
     
     // Reset metrics
     metrics_ = ComputeMetrics{};
-    latency_samples_.clear();
+    for (Counter* counter : {&windows_completed_, &tuples_processed_, &failed_windows_,
+                             &timeout_windows_, &exact_completions_, &panes_computed_,
+                             &pane_cache_hits_, &late_corrections_, &late_tuples_joined_}) {
+        counter->reset();
+    }
+    selectivity_sum_.store(0.0);
+    peak_memory_bytes_.store(0);
+    window_latency_.reset();
     current_memory_usage_.store(0);
     
     // Note: We do NOT reset the PECJ operator or clear data in tables
     // Those are managed by sageTSDB
+    
+    // Cached panes may no longer match the tables
+    std::lock_guard<std::mutex> pane_lock(pane_mutex_);
+    panes_->panes.clear();
+    panes_->clearWindow();
+    
+    std::lock_guard<std::mutex> late_lock(late_mutex_);
+    late_->windows.clear();
 }
 
 bool PECJComputeEngine::checkMemoryLimit() const {
@@ -0,0 +1,237 @@
+/**
+ * @file shared_scan.cpp
+ * @brief Implementation of SharedScanCoordinator
+ */
+
+#include "sage_tsdb/compute/shared_scan.h"
+#include "sage_tsdb/core/time_series_db.h"
+
+#include <algorithm>
+#include <charconv>
+#include <limits>
+#include <stdexcept>
+
+namespace sage_tsdb {
+namespace compute {
+
+namespace {
+
+/**
+ * @brief Parse a number stored as text; 0 if empty or malformed
+ *
+ * std::from_chars neither allocates nor throws, unlike stoull/stod.
+ */
+template <typename T>
+T parseNumber(const std::string& text) {
+    T value{};
+    std::from_chars(text.data(), text.data() + text.size(), value);
+    return value;
+}
+
+int64_t floorDiv(int64_t value, int64_t divisor) {
+    int64_t quotient = value / divisor;
+    return (value % divisor != 0 && value < 0) ? quotient - 1 : quotient;
+}
+
+/**
+ * @brief Entry of key in cache, loaded once
+ *
+ * The first caller inserts a pending entry and loads it without the lock;
+ * later callers wait on the entry. A failed load is removed again, so the
+ * next caller retries.
+ */
+template <typename Value, typename Key, typename Load>
+Value loadOnce(std::mutex& mutex, std::map<Key, std::shared_future<Value>>& cache, const Key& key,
+               uint64_t& loads, uint64_t& hits, Load&& load) {
+    std::promise<Value> promise;
+    std::shared_future<Value> future;
+    bool loader = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto [it, inserted] = cache.try_emplace(key);
+        if (inserted) {
+            it->second = promise.get_future().share();
+            loader = true;
+            loads++;
+        } else {
+            hits++;
+        }
+        future = it->second;
+    }
+    if (loader) {
+        try {
+            promise.set_value(load());
+        } catch (...) {
+            promise.set_exception(std::current_exception());
+            std::lock_guard<std::mutex> lock(mutex);
+            cache.erase(key);
+        }
+    }
+    return future.get();
+}
+
+} // anonymous namespace
+
+uint64_t joinKey(const Tags& tags) {
+    auto it = tags.find("key");
+    return it != tags.end() ? parseNumber<uint64_t>(it->second) : 0;
+}
+
+double joinValue(const Fields& fields) {
+    auto it = fields.find("value");
+    return it != fields.end() ? it->second.as_double() : 0.0;
+}
+
+void scanTableRange(const TimeSeriesDB& db, const std::string& table,
+                    int64_t start_us, int64_t end_us, ScanColumns& out,
+                    int64_t& min_ts, int64_t& max_ts) {
+    // Views read the points in place; only key and value are extracted
+    auto view = db.query_view(table, sage_tsdb::TimeRange(start_us, end_us));
+    size_t n = out.size() + view.size();
+    out.keys.reserve(n);
+    out.values.reserve(n);
+    out.event_times.reserve(n);
+    for (auto point : view) {
+        int64_t ts = point.timestamp();
+        min_ts = std::min(min_ts, ts);
+        max_ts = std::max(max_ts, ts);
+        out.keys.push_back(joinKey(point.tags()));
+        out.values.push_back(joinValue(point.fields()));
+        out.event_times.push_back(ts);
+    }
+}
+
+SharedScanCoordinator::SharedScanCoordinator(const TimeSeriesDB* db, uint64_t segment_len_us)
+    : db_(db), segment_len_us_(static_cast<int64_t>(segment_len_us)) {
+    if (!db_ || segment_len_us_ <= 0) {
+        throw std::invalid_argument("SharedScanCoordinator: null database or empty segment");
+    }
+}
+
+uint64_t SharedScanCoordinator::registerConsumer() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint64_t consumer = next_consumer_++;
+    progress_[consumer] = std::numeric_limits<int64_t>::min();
+    return consumer;
+}
+
+void SharedScanCoordinator::unregisterConsumer(uint64_t consumer) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    progress_.erase(consumer);
+    evict();
+}
+
+SharedScanCoordinator::SegmentPtr SharedScanCoordinator::segment(const std::string& table,
+                                                                 int64_t index) {
+    return loadOnce(mutex_, segments_, SegmentKey(table, index),
+                    stats_.segments_read, stats_.segment_hits, [&]() {
+        auto columns = std::make_shared<ScanColumns>();
+        int64_t min_ts = std::numeric_limits<int64_t>::max();
+        int64_t max_ts = std::numeric_limits<int64_t>::min();
+        int64_t start = index * segment_len_us_;
+        scanTableRange(*db_, table, start, start + segment_len_us_ - 1, *columns, min_ts, max_ts);
+        return SegmentPtr(std::move(columns));
+    });
+}
+
+void SharedScanCoordinator::scan(const std::string& table, int64_t start_us, int64_t end_us,
+                                 ScanColumns& out, int64_t& min_ts, int64_t& max_ts) {
+    if (end_us < start_us) {
+        return;
+    }
+    for (int64_t index = floorDiv(start_us, segment_len_us_);
+         index <= floorDiv(end_us, segment_len_us_); ++index) {
+        SegmentPtr columns = segment(table, index);
+        const int64_t segment_start = index * segment_len_us_;
+        const bool whole = segment_start >= start_us && segment_start + segment_len_us_ - 1 <= end_us;
+        for (size_t i = 0; i < columns->size(); ++i) {
+            int64_t ts = columns->event_times[i];
+            if (!whole && (ts < start_us || ts > end_us)) {
+                continue;
+            }
+            min_ts = std::min(min_ts, ts);
+            max_ts = std::max(max_ts, ts);
+            out.keys.push_back(columns->keys[i]);
+            out.values.push_back(columns->values[i]);
+            out.event_times.push_back(ts);
+        }
+    }
+}
+
+std::shared_ptr<const PaneCounts> SharedScanCoordinator::pane(const std::string& s_table,
+                                                              const std::string& r_table,
+                                                              uint64_t slide_len_us,
+                                                              int64_t index) {
+    return loadOnce(mutex_, panes_, PaneKey(s_table, r_table, slide_len_us, index),
+                    stats_.panes_computed, stats_.pane_hits, [&]() {
+        const auto slide = static_cast<int64_t>(slide_len_us);
+        ScanColumns s;
+        ScanColumns r;
+        int64_t min_ts = std::numeric_limits<int64_t>::max();
+        int64_t max_ts = std::numeric_limits<int64_t>::min();
+        // Panes are [start, end); scans are inclusive at both ends
+        scan(s_table, index * slide, (index + 1) * slide - 1, s, min_ts, max_ts);
+        scan(r_table, index * slide, (index + 1) * slide - 1, r, min_ts, max_ts);
+
+        auto counts = std::make_shared<PaneCounts>();
+        for (uint64_t key : s.keys) counts->s_keys[key]++;
+        for (uint64_t key : r.keys) counts->r_keys[key]++;
+        counts->s_count = s.size();
+        counts->r_count = r.size();
+        return PanePtr(std::move(counts));
+    });
+}
+
+void SharedScanCoordinator::advance(uint64_t consumer, int64_t start_us) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = progress_.find(consumer);
+    if (it == progress_.end() || start_us <= it->second) {
+        return;
+    }
+    it->second = start_us;
+    evict();
+}
+
+void SharedScanCoordinator::evict() {
+    if (progress_.empty()) {
+        return;  // Nobody left to tell what is still needed
+    }
+    int64_t low = std::numeric_limits<int64_t>::max();
+    for (const auto& [consumer, start_us] : progress_) {
+        low = std::min(low, start_us);
+    }
+
+    for (auto it = segments_.begin(); it != segments_.end();) {
+        if ((it->first.second + 1) * segment_len_us_ <= low) {
+            it = segments_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for (auto it = panes_.begin(); it != panes_.end();) {
+        const auto slide = static_cast<int64_t>(std::get<2>(it->first));
+        if ((std::get<3>(it->first) + 1) * slide <= low) {
+            it = panes_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+SharedScanStats SharedScanCoordinator::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    SharedScanStats stats = stats_;
+    stats.cached_segments = segments_.size();
+    stats.cached_panes = panes_.size();
+    stats.consumers = progress_.size();
+    return stats;
+}
+
+void SharedScanCoordinator::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    segments_.clear();
+    panes_.clear();
+}
+
+} // namespace compute
+} // namespace sage_tsdb
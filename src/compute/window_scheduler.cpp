@@ -12,7 +12,9 @@
 
 #include "sage_tsdb/core/table_manager.h"
 #include "sage_tsdb/core/stream_table.h"
+#include "sage_tsdb/core/join_result_table.h"
 #include "sage_tsdb/core/resource_manager.h"
+#include "sage_tsdb/core/trace.h"
 #include <algorithm>
 #include <chrono>
 #include <iostream>
@@ -32,19 +34,56 @@ static int64_t getCurrentTimeUs() {
 
 WindowScheduler::WindowScheduler(const WindowSchedulerConfig& config,
                                  PECJComputeEngine* compute_engine,
-                                 core::TableManager* table_manager,
+                                 TableManager* table_manager,
                                  core::ResourceHandle* resource_handle)
     : config_(config),
       compute_engine_(compute_engine),
       table_manager_(table_manager),
-      resource_handle_(resource_handle) {
+      resource_handle_(resource_handle),
+      concurrency_limit_(std::max<size_t>(1, config.max_concurrent_windows)),
+      count_threshold_(config.trigger_count_threshold) {
     
     if (!compute_engine_ || !table_manager_ || !resource_handle_) {
         throw std::invalid_argument("WindowScheduler: null pointer arguments");
     }
+    metrics_.concurrency_limit = concurrency_limit_;
+    metrics_.count_threshold = count_threshold_;
+    
+    // Export the lock-free counters and histograms, labelled by the joined tables
+    MetricsRegistry& registry = *table_manager_->getMetricsRegistry();
+    const Tags labels{{"stream_s", config_.stream_s_table}, {"stream_r", config_.stream_r_table}};
+    metric_handles_.push_back(registry.addCounter(
+        "sage_tsdb_windows_completed_total", "Window joins that succeeded", labels,
+        [this]() { return static_cast<double>(windows_completed_.value()); }));
+    metric_handles_.push_back(registry.addCounter(
+        "sage_tsdb_windows_failed_total", "Window joins that failed", labels,
+        [this]() { return static_cast<double>(windows_failed_.value()); }));
+    metric_handles_.push_back(registry.addHistogram(
+        "sage_tsdb_window_compute_seconds", "Engine time per window", labels, &completion_latency_));
+    metric_handles_.push_back(registry.addHistogram(
+        "sage_tsdb_window_scheduling_seconds", "Ready to handed to the engine", labels,
+        &scheduling_latency_));
+    metric_handles_.push_back(registry.addHistogram(
+        "sage_tsdb_window_end_to_end_seconds", "Last insert to window completed", labels,
+        &end_to_end_latency_));
+    for (auto& handle : compute_engine_->registerMetrics(registry, labels)) {
+        metric_handles_.push_back(std::move(handle));
+    }
 }
 
 WindowScheduler::~WindowScheduler() {
+    metric_handles_.clear();
+    
+    // Detach from watched tables before their listeners outlive us
+    {
+        std::lock_guard<std::mutex> lock(watched_tables_mutex_);
+        for (auto& watched : watched_tables_) {
+            if (watched.table) {
+                watched.table->removeInsertListener(watched.listener_id);
+            }
+        }
+        watched_tables_.clear();
+    }
     stop(false);  // Don't wait for completion
 }
 
@@ -83,14 +122,9 @@ void WindowScheduler::stop(bool wait_completion) {
     }
     
     if (wait_completion) {
-        // Wait for all active windows to complete
+        // Completing windows notify windows_cv_
         std::unique_lock<std::mutex> lock(windows_mutex_);
-        // Simple wait - in production, add timeout
-        while (getActiveWindowCount() > 0) {
-            lock.unlock();
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
-            lock.lock();
-        }
+        windows_cv_.wait(lock, [this]() { return active_windows_ == 0; });
     }
     
     running_.store(false);
@@ -100,8 +134,21 @@ void WindowScheduler::stop(bool wait_completion) {
 // ========== Table Watching ==========
 
 void WindowScheduler::watchTable(const std::string& table_name, int stream_id) {
+    WatchedTable watched{table_name, stream_id, nullptr, 0};
+    try {
+        watched.table = table_manager_->getStreamTable(table_name);
+    } catch (const std::runtime_error&) {
+        // Not a StreamTable: only explicit onDataInserted() calls reach us
+    }
+    if (watched.table) {
+        watched.listener_id = watched.table->addInsertListener(
+            [this, table_name](const TimeSeriesData* data, size_t count) {
+                onBatchInserted(table_name, data, count);
+            });
+    }
+    
     std::lock_guard<std::mutex> lock(watched_tables_mutex_);
-    watched_tables_.push_back({table_name, stream_id});
+    watched_tables_.push_back(std::move(watched));
     std::cout << "WindowScheduler: watching table '" << table_name 
               << "' (stream_id=" << stream_id << ")" << std::endl;
 }
@@ -113,27 +160,39 @@ void WindowScheduler::onDataInserted(const std::string& table_name,
         return;
     }
     
-    // Update watermark
+    // Update watermark (fires any watermark deadlines it covers)
     updateWatermarkAuto(timestamp);
     
-    // Get or create window for this timestamp
-    uint64_t window_id = getWindowIdForTimestamp(timestamp);
+    std::lock_guard<std::mutex> lock(windows_mutex_);
+    if (recordInsert(table_name, timestamp, count, getCurrentTimeUs())) {
+        windows_cv_.notify_one();
+    }
+}
+
+void WindowScheduler::onBatchInserted(const std::string& table_name,
+                                      const TimeSeriesData* data, size_t count) {
+    if (!running_.load() || count == 0) {
+        return;
+    }
     
-    // Update window statistics
-    updateWindowStats(window_id, table_name, count);
+    int64_t max_timestamp = data[0].timestamp;
+    for (size_t i = 1; i < count; ++i) {
+        max_timestamp = std::max(max_timestamp, data[i].timestamp);
+    }
+    updateWatermarkAuto(max_timestamp);
     
-    // Check if window should be triggered
+    // One lock for the whole batch
+    bool triggered = false;
+    int64_t now_us = getCurrentTimeUs();
     {
         std::lock_guard<std::mutex> lock(windows_mutex_);
-        auto it = windows_.find(window_id);
-        if (it != windows_.end() && shouldTriggerWindow(it->second)) {
-            if (!it->second.is_computing && !it->second.is_completed) {
-                it->second.is_ready = true;
-                pending_windows_.push(window_id);
-                windows_cv_.notify_one();
-            }
+        for (size_t i = 0; i < count; ++i) {
+            triggered |= recordInsert(table_name, data[i].timestamp, 1, now_us, &data[i]);
         }
     }
+    if (triggered) {
+        windows_cv_.notify_one();
+    }
 }
 
 // ========== Manual Triggering ==========
@@ -149,17 +208,16 @@ bool WindowScheduler::scheduleWindow(uint64_t window_id, const TimeRange& time_r
         window.time_range = time_range;
         window.watermark_us = watermark_us_.load();
         window.created_at_us = getCurrentTimeUs();
-        window.is_ready = true;
         
-        windows_[window_id] = window;
-        pending_windows_.push(window_id);
+        markReady(windows_[window_id] = window);
         windows_cv_.notify_one();
         
         return true;
     } else if (!it->second.is_computing && !it->second.is_completed) {
         // Window exists but not started
-        it->second.is_ready = true;
-        pending_windows_.push(window_id);
+        if (!it->second.is_ready) {
+            markReady(it->second);
+        }
         windows_cv_.notify_one();
         
         return true;
@@ -175,8 +233,7 @@ size_t WindowScheduler::triggerPendingWindows() {
     for (auto& pair : windows_) {
         auto& window = pair.second;
         if (!window.is_ready && !window.is_computing && !window.is_completed) {
-            window.is_ready = true;
-            pending_windows_.push(window.window_id);
+            markReady(window);
             count++;
         }
     }
@@ -204,16 +261,156 @@ void WindowScheduler::onWindowFailed(WindowCallback callback) {
 
 void WindowScheduler::updateWatermark(int64_t watermark_us) {
     int64_t old_watermark = watermark_us_.load();
-    if (watermark_us > old_watermark) {
-        watermark_us_.store(watermark_us);
+    while (watermark_us > old_watermark &&
+           !watermark_us_.compare_exchange_weak(old_watermark, watermark_us)) {
+    }
+    if (watermark_us <= old_watermark) {
+        return;  // Did not advance
+    }
+    
+    // Take the lock only when a deadline is due
+    if (watermark_us < next_deadline_us_.load()) {
+        return;
+    }
+    size_t fired = 0;
+    {
+        std::lock_guard<std::mutex> lock(windows_mutex_);
+        fired = fireWatermarkTimers(watermark_us);
+    }
+    if (fired > 0) {
+        windows_cv_.notify_one();
+    }
+}
+
+// ========== Adaptive Scheduling ==========
+
+void WindowScheduler::setResourceManager(core::ResourceManager* resource_manager) {
+    std::lock_guard<std::mutex> lock(windows_mutex_);
+    resource_manager_ = resource_manager;
+}
+
+void WindowScheduler::adapt() {
+    // p99 of the windows completed since the last change
+    auto latency = adapt_latency_.snapshot();
+    const bool has_samples = latency.count > 0;
+    const double p99_ms = latency.percentile(0.99) / 1000.0;
+    
+    const double slo_ms = config_.target_p99_latency_ms;
+    const size_t base_threshold = config_.trigger_count_threshold;
+    const size_t max_threshold = base_threshold * std::max<size_t>(1, config_.max_count_threshold_scale);
+    const size_t floor = std::max<size_t>(1, config_.min_concurrent_windows);
+    size_t ceiling = config_.max_adaptive_windows;
+    if (ceiling == 0) {
+        ceiling = std::max<size_t>(config_.max_concurrent_windows, std::thread::hardware_concurrency());
+    }
+    
+    std::string decision;
+    size_t new_concurrency = 0;  // 0 = unchanged
+    bool aqp_changed = false;
+    bool aqp_active = false;
+    size_t concurrency = 0;
+    size_t threshold = 0;
+    {
+        std::lock_guard<std::mutex> lock(windows_mutex_);
+        const bool pressure = resource_manager_ && resource_manager_->isUnderPressure();
+        const bool over_slo = has_samples && p99_ms > slo_ms;
+        const size_t queued = pending_windows_.size();
+        const std::string why = pressure ? std::string("resource pressure")
+            : "p99 " + std::to_string(static_cast<int64_t>(p99_ms)) + "ms vs SLO " +
+              std::to_string(static_cast<int64_t>(slo_ms)) + "ms";
+        
+        auto set_concurrency = [&](size_t value) {
+            decision = "concurrency " + std::to_string(concurrency_limit_) + " -> " +
+                       std::to_string(value) + " (" + why + ", " + std::to_string(queued) + " queued)";
+            concurrency_limit_ = value;
+            new_concurrency = value;
+        };
+        auto set_threshold = [&](size_t value) {
+            decision = "count threshold " + std::to_string(count_threshold_) + " -> " +
+                       std::to_string(value) + " (" + why + ")";
+            count_threshold_ = value;
+        };
+        
+        if (pressure && concurrency_limit_ > floor) {
+            // Oversubscribed: back off multiplicatively
+            set_concurrency(std::max(floor, concurrency_limit_ / 2));
+        } else if (over_slo && !pressure && queued > 0 && concurrency_limit_ < ceiling) {
+            // Windows wait on the limit: add one
+            set_concurrency(concurrency_limit_ + 1);
+        } else if ((over_slo || pressure) && !aqp_active_ && config_.aqp_sample_rate < 1.0) {
+            aqp_active_ = true;
+            aqp_changed = true;
+            decision = "AQP on (" + why + ")";
+        } else if ((over_slo || pressure) && count_threshold_ < max_threshold) {
+            set_threshold(std::min(max_threshold, std::max<size_t>(1, count_threshold_ * 2)));
+        } else if (!pressure && (!has_samples || p99_ms < slo_ms / 2)) {
+            // Comfortably within the SLO: undo load shedding, AQP first
+            if (aqp_active_) {
+                aqp_active_ = false;
+                aqp_changed = true;
+                decision = "AQP off (" + why + ")";
+            } else if (count_threshold_ > base_threshold) {
+                set_threshold(std::max(base_threshold, count_threshold_ / 2));
+            }
+        }
+        
+        aqp_active = aqp_active_;
+        concurrency = concurrency_limit_;
+        threshold = count_threshold_;
+        if (new_concurrency > 0) {
+            windows_cv_.notify_one();
+        }
+    }
+    
+    if (new_concurrency > 0) {
+        compute_engine_->setMaxConcurrentWindows(new_concurrency);
+    }
+    if (aqp_changed) {
+        compute_engine_->setSampleRate(aqp_active ? config_.aqp_sample_rate : 1.0);
+    }
+    
+    std::lock_guard<std::mutex> lock(metrics_mutex_);
+    metrics_.p99_window_latency_ms = p99_ms;
+    metrics_.concurrency_limit = concurrency;
+    metrics_.count_threshold = threshold;
+    metrics_.aqp_active = aqp_active;
+    if (!decision.empty()) {
+        metrics_.adaptations++;
+        metrics_.last_adaptation = std::move(decision);
+        // Judge the next step on windows run under the new settings
+        adapt_latency_.reset();
     }
 }
 
 // ========== Query & Monitoring ==========
 
 SchedulingMetrics WindowScheduler::getMetrics() const {
-    std::lock_guard<std::mutex> lock(metrics_mutex_);
-    return metrics_;
+    SchedulingMetrics metrics;
+    {
+        std::lock_guard<std::mutex> lock(metrics_mutex_);
+        metrics = metrics_;
+    }
+    metrics.total_windows_completed = windows_completed_.value();
+    metrics.total_windows_failed = windows_failed_.value();
+    
+    auto scheduling = scheduling_latency_.snapshot();
+    metrics.avg_scheduling_latency_ms = scheduling.mean / 1000.0;
+    metrics.p50_scheduling_latency_ms = scheduling.percentile(0.5) / 1000.0;
+    metrics.p90_scheduling_latency_ms = scheduling.percentile(0.9) / 1000.0;
+    metrics.p99_scheduling_latency_ms = scheduling.percentile(0.99) / 1000.0;
+    metrics.p999_scheduling_latency_ms = scheduling.percentile(0.999) / 1000.0;
+    
+    auto completion = completion_latency_.snapshot();
+    metrics.avg_window_completion_ms = completion.mean / 1000.0;
+    metrics.max_window_completion_ms = completion.max / 1000.0;
+    
+    auto end_to_end = end_to_end_latency_.snapshot();
+    metrics.avg_end_to_end_latency_ms = end_to_end.mean / 1000.0;
+    metrics.p50_end_to_end_latency_ms = end_to_end.percentile(0.5) / 1000.0;
+    metrics.p90_end_to_end_latency_ms = end_to_end.percentile(0.9) / 1000.0;
+    metrics.p99_end_to_end_latency_ms = end_to_end.percentile(0.99) / 1000.0;
+    metrics.p999_end_to_end_latency_ms = end_to_end.percentile(0.999) / 1000.0;
+    return metrics;
 }
 
 std::vector<WindowInfo> WindowScheduler::getAllWindows() const {
@@ -247,15 +444,7 @@ size_t WindowScheduler::getPendingWindowCount() const {
 
 size_t WindowScheduler::getActiveWindowCount() const {
     std::lock_guard<std::mutex> lock(windows_mutex_);
-    
-    size_t count = 0;
-    for (const auto& pair : windows_) {
-        if (pair.second.is_computing) {
-            count++;
-        }
-    }
-    
-    return count;
+    return active_windows_;
 }
 
 void WindowScheduler::reset() {
@@ -265,12 +454,26 @@ void WindowScheduler::reset() {
     while (!pending_windows_.empty()) {
         pending_windows_.pop();
     }
+    while (!watermark_timers_.empty()) {
+        watermark_timers_.pop();
+    }
+    late_tuples_.clear();
+    next_deadline_us_.store(std::numeric_limits<int64_t>::max());
     next_window_id_.store(1);
     watermark_us_.store(0);
     max_timestamp_seen_.store(0);
     
     std::lock_guard<std::mutex> metrics_lock(metrics_mutex_);
     metrics_ = SchedulingMetrics{};
+    metrics_.concurrency_limit = concurrency_limit_;
+    metrics_.count_threshold = count_threshold_;
+    metrics_.aqp_active = aqp_active_;
+    windows_completed_.reset();
+    windows_failed_.reset();
+    completion_latency_.reset();
+    scheduling_latency_.reset();
+    end_to_end_latency_.reset();
+    adapt_latency_.reset();
 }
 
 // ========== Internal Methods ==========
@@ -280,11 +483,14 @@ void WindowScheduler::schedulerLoop() {
         try {
             std::unique_lock<std::mutex> lock(windows_mutex_);
             
-            // Wait for pending windows or timeout
+            // Triggers and completions notify windows_cv_; the timeout only
+            // paces the maintenance below
             windows_cv_.wait_for(lock, 
                 std::chrono::microseconds(config_.trigger_interval_us),
                 [this]() { 
-                    return !pending_windows_.empty() || stop_requested_.load(); 
+                    return stop_requested_.load() ||
+                           ((!pending_windows_.empty() || !late_tuples_.empty()) &&
+                            active_windows_ < concurrency_limit_);
                 });
             
             if (stop_requested_.load()) {
@@ -293,7 +499,7 @@ void WindowScheduler::schedulerLoop() {
             
             // Process pending windows
             while (!pending_windows_.empty() && 
-                   getActiveWindowCount() < config_.max_concurrent_windows) {
+                   active_windows_ < concurrency_limit_) {
                 
                 uint64_t window_id = pending_windows_.top();
                 pending_windows_.pop();
@@ -307,12 +513,24 @@ void WindowScheduler::schedulerLoop() {
                 executeWindowAsync(it->second);
             }
             
+            // Then corrections of completed windows that received late tuples
+            while (!late_tuples_.empty() && active_windows_ < concurrency_limit_) {
+                executeLateCorrection(late_tuples_.begin()->first);
+            }
+            
             lock.unlock();
             
             // Periodic maintenance
             cleanupOldWindows();
             updateMetrics();
             
+            int64_t now = getCurrentTimeUs();
+            if (config_.enable_adaptive_scheduling &&
+                now - last_adapt_us_ >= static_cast<int64_t>(config_.adapt_interval_us)) {
+                last_adapt_us_ = now;
+                adapt();
+            }
+            
         } catch (const std::exception& e) {
             std::cerr << "WindowScheduler: error in scheduler loop: " << e.what() << std::endl;
         }
@@ -334,12 +552,12 @@ bool WindowScheduler::shouldTriggerWindow(const WindowInfo& window) {
         
         case TriggerPolicy::CountBased:
             // Trigger when enough tuples collected
-            return (window.stream_s_count + window.stream_r_count) >= config_.trigger_count_threshold;
+            return (window.stream_s_count + window.stream_r_count) >= count_threshold_;
         
         case TriggerPolicy::Hybrid:
             // Trigger when either condition is met
             return current_watermark >= static_cast<int64_t>(window.time_range.end_us + config_.watermark_slack_us) ||
-                   (window.stream_s_count + window.stream_r_count) >= config_.trigger_count_threshold;
+                   (window.stream_s_count + window.stream_r_count) >= count_threshold_;
         
         case TriggerPolicy::Watermark:
             // Trigger based on watermark only
@@ -405,8 +623,6 @@ WindowInfo WindowScheduler::createWindow(int64_t timestamp) {
 }
 
 uint64_t WindowScheduler::getWindowIdForTimestamp(int64_t timestamp) {
-    std::lock_guard<std::mutex> lock(windows_mutex_);
-    
     // Find existing window that contains this timestamp
     for (const auto& pair : windows_) {
         if (pair.second.time_range.contains(timestamp)) {
@@ -419,94 +635,267 @@ uint64_t WindowScheduler::getWindowIdForTimestamp(int64_t timestamp) {
     uint64_t window_id = window.window_id;
     windows_[window_id] = window;
     
+    // Time-based triggers wait on the watermark passing end + slack
+    if (config_.trigger_policy == TriggerPolicy::TimeBased ||
+        config_.trigger_policy == TriggerPolicy::Hybrid ||
+        config_.trigger_policy == TriggerPolicy::Watermark) {
+        int64_t deadline = window.time_range.end_us + static_cast<int64_t>(config_.watermark_slack_us);
+        watermark_timers_.emplace(deadline, window_id);
+        next_deadline_us_.store(watermark_timers_.top().first);
+    }
+    
     return window_id;
 }
 
+bool WindowScheduler::recordInsert(const std::string& table_name,
+                                   int64_t timestamp, size_t count, int64_t now_us,
+                                   const TimeSeriesData* point) {
+    uint64_t window_id = getWindowIdForTimestamp(timestamp);
+    updateWindowStats(window_id, table_name, count);
+    
+    auto it = windows_.find(window_id);
+    if (it != windows_.end()) {
+        it->second.last_insert_at_us = now_us;
+        if (it->second.is_completed) {
+            return recordLateInsert(it->second, table_name, count, point);
+        }
+    }
+    if (it != windows_.end() && !it->second.is_ready && shouldTriggerWindow(it->second)) {
+        markReady(it->second);
+        return true;
+    }
+    return false;
+}
+
+bool WindowScheduler::recordLateInsert(WindowInfo& window, const std::string& table_name,
+                                       size_t count, const TimeSeriesData* point) {
+    window.has_late_data = true;
+    {
+        std::lock_guard<std::mutex> lock(metrics_mutex_);
+        metrics_.late_data_count += count;
+    }
+    if (!config_.allow_late_data) {
+        return false;
+    }
+    
+    // Without the tuple there is nothing to join on its own
+    if (!point) {
+        recomputeWindow(window);
+        return true;
+    }
+    if (table_name == config_.stream_s_table) {
+        late_tuples_[window.window_id].s.push_back(*point);
+    } else if (table_name == config_.stream_r_table) {
+        late_tuples_[window.window_id].r.push_back(*point);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void WindowScheduler::recomputeWindow(WindowInfo& window) {
+    // The recomputation reads the late tuples collected so far too
+    late_tuples_.erase(window.window_id);
+    window.is_completed = false;
+    markReady(window);
+    std::lock_guard<std::mutex> lock(metrics_mutex_);
+    metrics_.late_windows_recomputed++;
+}
+
+void WindowScheduler::markReady(WindowInfo& window) {
+    window.is_ready = true;
+    window.ready_at_us = getCurrentTimeUs();
+    pending_windows_.push(window.window_id);
+}
+
+size_t WindowScheduler::fireWatermarkTimers(int64_t watermark_us) {
+    size_t fired = 0;
+    while (!watermark_timers_.empty() && watermark_timers_.top().first <= watermark_us) {
+        uint64_t window_id = watermark_timers_.top().second;
+        watermark_timers_.pop();
+        
+        // Windows may have been triggered otherwise or cleaned up since
+        auto it = windows_.find(window_id);
+        if (it != windows_.end() && !it->second.is_ready && shouldTriggerWindow(it->second)) {
+            markReady(it->second);
+            fired++;
+        }
+    }
+    next_deadline_us_.store(watermark_timers_.empty() ? std::numeric_limits<int64_t>::max()
+                                                       : watermark_timers_.top().first);
+    return fired;
+}
+
 void WindowScheduler::executeWindowAsync(WindowInfo& window) {
     window.is_computing = true;
     window.triggered_at_us = getCurrentTimeUs();
+    active_windows_++;
     
-    // Submit to resource handle (asynchronous execution)
-    if (resource_handle_) {
-        resource_handle_->submitTask([this, window_id = window.window_id]() {
-            WindowInfo window_copy;
-            
-            {
-                std::lock_guard<std::mutex> lock(windows_mutex_);
-                auto it = windows_.find(window_id);
-                if (it == windows_.end()) {
-                    return;  // Window was removed
-                }
-                window_copy = it->second;
+    // Scheduling latency: ready -> handed to the resource handle
+    if (window.ready_at_us > 0) {
+        scheduling_latency_.record(static_cast<uint64_t>(window.triggered_at_us - window.ready_at_us));
+    }
+    {
+        std::lock_guard<std::mutex> lock(metrics_mutex_);
+        metrics_.total_windows_scheduled++;
+    }
+    
+    auto task = [this, window_id = window.window_id, submitted_ns = SAGE_TSDB_TRACE_NOW()]() {
+        // Time spent queued in the resource handle, then the window itself
+        if (submitted_ns != 0) {
+            SAGE_TSDB_TRACE_RECORD("compute", "window.queued", submitted_ns,
+                                   Tracer::nowNs(), "window_id", window_id);
+        }
+        SAGE_TSDB_TRACE_SCOPE_ARG("compute", "window.execute", "window_id", window_id);
+        WindowInfo window_copy;
+        
+        {
+            std::lock_guard<std::mutex> lock(windows_mutex_);
+            auto it = windows_.find(window_id);
+            if (it == windows_.end()) {
+                active_windows_--;  // Window was removed
+                windows_cv_.notify_all();
+                return;
             }
-            
-            // Execute PECJ computation
-            auto start_time = getCurrentTimeUs();
-            ComputeStatus status = compute_engine_->executeWindowJoin(
-                window_copy.window_id, 
-                window_copy.time_range
-            );
-            auto end_time = getCurrentTimeUs();
-            
-            double completion_time_ms = (end_time - start_time) / 1000.0;
-            
-            // Update window state
-            {
-                std::lock_guard<std::mutex> lock(windows_mutex_);
-                auto it = windows_.find(window_id);
-                if (it != windows_.end()) {
-                    it->second.is_computing = false;
-                    it->second.is_completed = true;
-                    it->second.completed_at_us = end_time;
-                    window_copy = it->second;  // Get updated copy
-                }
+            window_copy = it->second;
+        }
+        
+        // Execute PECJ computation
+        auto start_time = getCurrentTimeUs();
+        ComputeStatus status = compute_engine_->executeWindowJoin(
+            window_copy.window_id, 
+            window_copy.time_range
+        );
+        auto end_time = getCurrentTimeUs();
+        
+        // Update window state
+        {
+            std::lock_guard<std::mutex> lock(windows_mutex_);
+            auto it = windows_.find(window_id);
+            if (it != windows_.end()) {
+                it->second.is_computing = false;
+                it->second.is_completed = true;
+                it->second.completed_at_us = end_time;
+                window_copy = it->second;  // Get updated copy
             }
-            
-            // Update metrics
-            {
-                std::lock_guard<std::mutex> lock(metrics_mutex_);
+        }
+        
+        // Update metrics
+        completion_latency_.record(static_cast<uint64_t>(end_time - start_time));
+        if (window_copy.ready_at_us > 0) {
+            adapt_latency_.record(static_cast<uint64_t>(end_time - window_copy.ready_at_us));
+        }
+        if (window_copy.last_insert_at_us > 0 && end_time > window_copy.last_insert_at_us) {
+            end_to_end_latency_.record(static_cast<uint64_t>(end_time - window_copy.last_insert_at_us));
+        }
+        (status.success ? windows_completed_ : windows_failed_).inc();
+        
+        {
+            SAGE_TSDB_TRACE_SCOPE("compute", "window.callbacks");
+            invokeCallbacks(window_copy, status);
+        }
+        
+        // Release the slot last, notifying under the lock: wakes the
+        // scheduler for a queued window, and stop() may return right after
+        std::lock_guard<std::mutex> lock(windows_mutex_);
+        active_windows_--;
+        windows_cv_.notify_all();
+    };
+    
+    // Submit to resource handle (asynchronous execution)
+    bool submitted = resource_handle_ && resource_handle_->submitTask(std::move(task));
+    if (!submitted) {
+        // Not running: leave the window to be triggered again
+        window.is_computing = false;
+        window.is_ready = false;
+        active_windows_--;
+    }
+}
+
+void WindowScheduler::executeLateCorrection(uint64_t window_id) {
+    auto late = late_tuples_.extract(window_id);
+    auto it = windows_.find(window_id);
+    if (late.empty() || it == windows_.end()) {
+        return;  // Window cleaned up meanwhile
+    }
+    active_windows_++;
+    
+    auto task = [this, window_id, tuples = std::move(late.mapped())]() {
+        SAGE_TSDB_TRACE_SCOPE_ARG("compute", "window.late_correction", "window_id", window_id);
+        ComputeStatus status = compute_engine_->joinLateTuples(window_id, tuples.s, tuples.r);
+        
+        WindowInfo window_copy;
+        bool corrected = false;
+        {
+            std::lock_guard<std::mutex> lock(windows_mutex_);
+            auto it = windows_.find(window_id);
+            if (it != windows_.end()) {
                 if (status.success) {
-                    metrics_.total_windows_completed++;
-                } else {
-                    metrics_.total_windows_failed++;
-                }
-                
-                window_completion_times_.push_back(completion_time_ms);
-                if (window_completion_times_.size() > 100) {
-                    window_completion_times_.erase(window_completion_times_.begin());
+                    window_copy = it->second;
+                    corrected = true;
+                } else if (it->second.is_completed) {
+                    recomputeWindow(it->second);  // No retained state to join against
                 }
             }
-            
-            // Invoke callbacks
+        }
+        
+        if (corrected) {
             {
-                std::lock_guard<std::mutex> lock(callbacks_mutex_);
-                if (status.success) {
-                    for (auto& callback : completion_callbacks_) {
-                        try {
-                            callback(window_copy, status);
-                        } catch (const std::exception& e) {
-                            std::cerr << "WindowScheduler: callback error: " << e.what() << std::endl;
-                        }
-                    }
-                } else {
-                    for (auto& callback : failure_callbacks_) {
-                        try {
-                            callback(window_copy, status);
-                        } catch (const std::exception& e) {
-                            std::cerr << "WindowScheduler: callback error: " << e.what() << std::endl;
-                        }
-                    }
-                }
+                std::lock_guard<std::mutex> lock(metrics_mutex_);
+                metrics_.late_windows_corrected++;
             }
-        });
+            writeCorrection(window_copy, status);
+            invokeCallbacks(window_copy, status);
+        }
+        
+        std::lock_guard<std::mutex> lock(windows_mutex_);
+        active_windows_--;
+        windows_cv_.notify_all();
+    };
+    
+    bool submitted = resource_handle_ && resource_handle_->submitTask(std::move(task));
+    if (!submitted) {
+        // The tuples went with the task: recompute the window instead
+        active_windows_--;
+        recomputeWindow(it->second);
+    }
+}
+
+void WindowScheduler::writeCorrection(const WindowInfo& window, const ComputeStatus& status) {
+    try {
+        auto table = table_manager_->getJoinResultTable(config_.result_table);
+        if (!table) {
+            return;
+        }
+        JoinResultTable::JoinRecord record;
+        record.window_id = window.window_id;
+        record.timestamp = window.time_range.end_us;
+        record.join_count = status.join_count;
+        record.selectivity = status.selectivity;
+        record.metrics.computation_time_ms = status.computation_time_ms;
+        record.metrics.algorithm_type = compute_engine_->activeOperator();
+        record.tags = {{"correction", "late"}};
+        table->insertJoinResult(record);
+    } catch (const std::exception& e) {
+        std::cerr << "WindowScheduler: correction write error: " << e.what() << std::endl;
+    }
+}
+
+void WindowScheduler::invokeCallbacks(const WindowInfo& window, const ComputeStatus& status) {
+    std::lock_guard<std::mutex> lock(callbacks_mutex_);
+    auto& callbacks = status.success ? completion_callbacks_ : failure_callbacks_;
+    for (auto& callback : callbacks) {
+        try {
+            callback(window, status);
+        } catch (const std::exception& e) {
+            std::cerr << "WindowScheduler: callback error: " << e.what() << std::endl;
+        }
     }
 }
 
 void WindowScheduler::updateWindowStats(uint64_t window_id, 
                                         const std::string& table_name, 
                                         size_t count) {
-    std::lock_guard<std::mutex> lock(windows_mutex_);
-    
     auto it = windows_.find(window_id);
     if (it == windows_.end()) {
         return;
@@ -551,11 +940,23 @@ void WindowScheduler::cleanupOldWindows() {
     for (uint64_t window_id : to_remove) {
         windows_.erase(window_id);
     }
+    
+    // State kept for late tuples is not needed past the allowed delay
+    compute_engine_->expireLateState(watermark_us_.load());
 }
 
 void WindowScheduler::updateMetrics() {
     int64_t current_time = getCurrentTimeUs();
     
+    // Lock order is windows_mutex_ before metrics_mutex_
+    size_t pending = 0;
+    size_t active = 0;
+    {
+        std::lock_guard<std::mutex> windows_lock(windows_mutex_);
+        pending = pending_windows_.size();
+        active = active_windows_;
+    }
+    
     std::lock_guard<std::mutex> lock(metrics_mutex_);
     
     // Update only if enough time has passed
@@ -563,27 +964,15 @@ void WindowScheduler::updateMetrics() {
         return;
     }
     
-    // Calculate average completion time
-    if (!window_completion_times_.empty()) {
-        double sum = 0.0;
-        double max_time = 0.0;
-        for (double time : window_completion_times_) {
-            sum += time;
-            max_time = std::max(max_time, time);
-        }
-        metrics_.avg_window_completion_ms = sum / window_completion_times_.size();
-        metrics_.max_window_completion_ms = max_time;
-    }
-    
     // Calculate windows per second
     double elapsed_s = (current_time - metrics_last_update_us_) / 1000000.0;
     if (elapsed_s > 0) {
-        metrics_.windows_per_second = metrics_.total_windows_completed / elapsed_s;
+        metrics_.windows_per_second = windows_completed_.value() / elapsed_s;
     }
     
     // Update current state
-    metrics_.pending_windows = pending_windows_.size();
-    metrics_.active_windows = getActiveWindowCount();
+    metrics_.pending_windows = pending;
+    metrics_.active_windows = active;
     
     metrics_last_update_us_ = current_time;
 }
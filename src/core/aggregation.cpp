@@ -0,0 +1,292 @@
+#include "sage_tsdb/core/aggregation.h"
+#include "sage_tsdb/core/simd.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace sage_tsdb {
+
+void BlockSummary::add(int64_t timestamp, double value) {
+    if (count == 0) {
+        min = max = value;
+        first_timestamp = timestamp;
+        first = value;
+    } else {
+        min = std::min(min, value);
+        max = std::max(max, value);
+    }
+    last_timestamp = timestamp;
+    last = value;
+    sum += value;
+    sum_squares += value * value;
+    ++count;
+    if (sketched) {
+        quantiles.add(value);
+        distinct.add(value);
+    }
+}
+
+void BlockSummary::merge(const BlockSummary& other, bool with_sketches) {
+    if (other.count == 0) {
+        return;
+    }
+    sketched = sketched && other.sketched && with_sketches;
+    if (sketched) {
+        quantiles.merge(other.quantiles);
+        distinct.merge(other.distinct);
+    } else if (!quantiles.empty() || !distinct.empty()) {
+        quantiles = QuantileSketch();
+        distinct = DistinctSketch();
+    }
+    if (count == 0) {
+        count = other.count;
+        sum = other.sum;
+        sum_squares = other.sum_squares;
+        min = other.min;
+        max = other.max;
+        first_timestamp = other.first_timestamp;
+        first = other.first;
+        last_timestamp = other.last_timestamp;
+        last = other.last;
+        return;
+    }
+    min = std::min(min, other.min);
+    max = std::max(max, other.max);
+    if (other.first_timestamp < first_timestamp) {
+        first_timestamp = other.first_timestamp;
+        first = other.first;
+    }
+    if (other.last_timestamp > last_timestamp) {
+        last_timestamp = other.last_timestamp;
+        last = other.last;
+    }
+    sum += other.sum;
+    sum_squares += other.sum_squares;
+    count += other.count;
+}
+
+double BlockSummary::value(AggregationType type, double quantile) const {
+    if (needs_sketches(type) && !sketched) {
+        return std::nan("");
+    }
+    switch (type) {
+        case AggregationType::COUNT: return static_cast<double>(count);
+        case AggregationType::SUM: return sum;
+        case AggregationType::DISTINCT: return distinct.estimate();
+        default: break;
+    }
+    if (count == 0) {
+        return std::nan("");
+    }
+    switch (type) {
+        case AggregationType::AVG: return sum / count;
+        case AggregationType::MIN: return min;
+        case AggregationType::MAX: return max;
+        case AggregationType::FIRST: return first;
+        case AggregationType::LAST: return last;
+        case AggregationType::STDDEV: {
+            double mean = sum / count;
+            return std::sqrt(std::max(0.0, sum_squares / count - mean * mean));
+        }
+        case AggregationType::QUANTILE: return quantiles.quantile(quantile);
+        default: return std::nan("");
+    }
+}
+
+namespace column_kernels {
+
+namespace {
+
+// Lane-wise partial results, combined once at the end
+struct Lanes {
+    double sum = 0.0;
+    double sum_squares = 0.0;
+    double min = std::numeric_limits<double>::infinity();
+    double max = -std::numeric_limits<double>::infinity();
+    
+    void add(double value) {
+        sum += value;
+        sum_squares += value * value;
+        min = std::min(min, value);
+        max = std::max(max, value);
+    }
+};
+
+BlockSummary finish(const Lanes& lanes, size_t count, int64_t first_timestamp, double first,
+                    int64_t last_timestamp, double last) {
+    BlockSummary summary;
+    if (count == 0) {
+        return summary;
+    }
+    summary.sketched = false;   // Moments only
+    summary.count = count;
+    summary.sum = lanes.sum;
+    summary.sum_squares = lanes.sum_squares;
+    summary.min = lanes.min;
+    summary.max = lanes.max;
+    summary.first_timestamp = first_timestamp;
+    summary.first = first;
+    summary.last_timestamp = last_timestamp;
+    summary.last = last;
+    return summary;
+}
+
+// Each kernel runs full lane batches and returns where the scalar tail
+// starts. Vector min/max take the new value as the first operand, so a
+// NaN lane yields the running value and NaNs are skipped as by Lanes::add
+
+size_t summarize_scalar(const double* values, size_t count, Lanes& lanes) {
+    Lanes part[4];
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        for (int lane = 0; lane < 4; ++lane) {
+            part[lane].add(values[i + lane]);
+        }
+    }
+    for (const auto& lane : part) {
+        lanes.sum += lane.sum;
+        lanes.sum_squares += lane.sum_squares;
+        lanes.min = std::min(lanes.min, lane.min);
+        lanes.max = std::max(lanes.max, lane.max);
+    }
+    return i;
+}
+
+#if defined(SAGE_TSDB_SIMD_DISPATCH)
+SAGE_TSDB_TARGET("avx2")
+void reduce(__m256d sum, __m256d squares, __m256d min, __m256d max, Lanes& lanes) {
+    alignas(32) double s[4], q[4], lo[4], hi[4];
+    _mm256_store_pd(s, sum);
+    _mm256_store_pd(q, squares);
+    _mm256_store_pd(lo, min);
+    _mm256_store_pd(hi, max);
+    for (int i = 0; i < 4; ++i) {
+        lanes.sum += s[i];
+        lanes.sum_squares += q[i];
+        lanes.min = std::min(lanes.min, lo[i]);
+        lanes.max = std::max(lanes.max, hi[i]);
+    }
+}
+
+SAGE_TSDB_TARGET("avx512f")
+void reduce(__m512d sum, __m512d squares, __m512d min, __m512d max, Lanes& lanes) {
+    lanes.sum += _mm512_reduce_add_pd(sum);
+    lanes.sum_squares += _mm512_reduce_add_pd(squares);
+    lanes.min = std::min(lanes.min, _mm512_reduce_min_pd(min));
+    lanes.max = std::max(lanes.max, _mm512_reduce_max_pd(max));
+}
+
+SAGE_TSDB_TARGET("avx2")
+size_t summarize_avx2(const double* values, size_t count, Lanes& lanes) {
+    __m256d sum = _mm256_setzero_pd(), squares = _mm256_setzero_pd();
+    __m256d min = _mm256_set1_pd(lanes.min), max = _mm256_set1_pd(lanes.max);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256d v = _mm256_loadu_pd(values + i);
+        sum = _mm256_add_pd(sum, v);
+        squares = _mm256_add_pd(squares, _mm256_mul_pd(v, v));
+        min = _mm256_min_pd(v, min);
+        max = _mm256_max_pd(v, max);
+    }
+    reduce(sum, squares, min, max, lanes);
+    return i;
+}
+
+SAGE_TSDB_TARGET("avx512f")
+size_t summarize_avx512(const double* values, size_t count, Lanes& lanes) {
+    __m512d sum = _mm512_setzero_pd(), squares = _mm512_setzero_pd();
+    __m512d min = _mm512_set1_pd(lanes.min), max = _mm512_set1_pd(lanes.max);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m512d v = _mm512_loadu_pd(values + i);
+        sum = _mm512_add_pd(sum, v);
+        squares = _mm512_fmadd_pd(v, v, squares);
+        min = _mm512_min_pd(v, min);
+        max = _mm512_max_pd(v, max);
+    }
+    reduce(sum, squares, min, max, lanes);
+    return i;
+}
+
+SAGE_TSDB_TARGET("avx2")
+size_t summarize_rows_avx2(const double* values, const uint32_t* rows, size_t count,
+                           Lanes& lanes) {
+    __m256d sum = _mm256_setzero_pd(), squares = _mm256_setzero_pd();
+    __m256d min = _mm256_set1_pd(lanes.min), max = _mm256_set1_pd(lanes.max);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i index = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows + i));
+        __m256d v = _mm256_i32gather_pd(values, index, 8);
+        sum = _mm256_add_pd(sum, v);
+        squares = _mm256_add_pd(squares, _mm256_mul_pd(v, v));
+        min = _mm256_min_pd(v, min);
+        max = _mm256_max_pd(v, max);
+    }
+    reduce(sum, squares, min, max, lanes);
+    return i;
+}
+
+SAGE_TSDB_TARGET("avx512f")
+size_t summarize_rows_avx512(const double* values, const uint32_t* rows, size_t count,
+                             Lanes& lanes) {
+    __m512d sum = _mm512_setzero_pd(), squares = _mm512_setzero_pd();
+    __m512d min = _mm512_set1_pd(lanes.min), max = _mm512_set1_pd(lanes.max);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i index = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rows + i));
+        __m512d v = _mm512_i32gather_pd(index, values, 8);
+        sum = _mm512_add_pd(sum, v);
+        squares = _mm512_fmadd_pd(v, v, squares);
+        min = _mm512_min_pd(v, min);
+        max = _mm512_max_pd(v, max);
+    }
+    reduce(sum, squares, min, max, lanes);
+    return i;
+}
+#endif
+
+} // namespace
+
+BlockSummary summarize(const int64_t* timestamps, const double* values, size_t count) {
+    Lanes lanes;
+    size_t i;
+    switch (simd::active()) {
+#if defined(SAGE_TSDB_SIMD_DISPATCH)
+        case simd::Level::AVX512: i = summarize_avx512(values, count, lanes); break;
+        case simd::Level::AVX2: i = summarize_avx2(values, count, lanes); break;
+#endif
+        default: i = summarize_scalar(values, count, lanes); break;
+    }
+    for (; i < count; ++i) {
+        lanes.add(values[i]);
+    }
+    if (count == 0) {
+        return BlockSummary();
+    }
+    return finish(lanes, count, timestamps[0], values[0], timestamps[count - 1], values[count - 1]);
+}
+
+BlockSummary summarize_rows(const int64_t* timestamps, const double* values,
+                            const uint32_t* rows, size_t count) {
+    Lanes lanes;
+    size_t i = 0;
+    switch (simd::active()) {
+#if defined(SAGE_TSDB_SIMD_DISPATCH)
+        case simd::Level::AVX512: i = summarize_rows_avx512(values, rows, count, lanes); break;
+        case simd::Level::AVX2: i = summarize_rows_avx2(values, rows, count, lanes); break;
+#endif
+        default: break;
+    }
+    for (; i < count; ++i) {
+        lanes.add(values[rows[i]]);
+    }
+    if (count == 0) {
+        return BlockSummary();
+    }
+    uint32_t front = rows[0], back = rows[count - 1];
+    return finish(lanes, count, timestamps[front], values[front], timestamps[back], values[back]);
+}
+
+} // namespace column_kernels
+
+} // namespace sage_tsdb
@@ -0,0 +1,75 @@
+#include "sage_tsdb/core/arena.h"
+#include <new>
+
+namespace sage_tsdb {
+
+Arena::~Arena() {
+    reset();
+}
+
+Arena::Block* Arena::new_block(size_t size, Block* prev) {
+    void* memory = ::operator new(sizeof(Block) + size, std::align_val_t{alignof(std::max_align_t)});
+    Block* block = new (memory) Block();
+    block->prev = prev;
+    block->size = size;
+    memory_usage_.fetch_add(sizeof(Block) + size, std::memory_order_relaxed);
+    if (tracker_) {
+        tracker_->consume(sizeof(Block) + size);
+    }
+    return block;
+}
+
+void* Arena::try_allocate(Block* block, size_t bytes, size_t alignment) {
+    const auto base = reinterpret_cast<uintptr_t>(block->data());
+    size_t used = block->used.load(std::memory_order_relaxed);
+    for (;;) {
+        size_t start = ((base + used + alignment - 1) & ~(uintptr_t(alignment) - 1)) - base;
+        if (start + bytes > block->size) {
+            return nullptr;
+        }
+        if (block->used.compare_exchange_weak(used, start + bytes, std::memory_order_relaxed)) {
+            return block->data() + start;
+        }
+    }
+}
+
+void* Arena::allocate(size_t bytes, size_t alignment) {
+    if (bytes > kBlockSize / 4) {
+        // Would waste most of a shared block
+        std::lock_guard<std::mutex> lock(mutex_);
+        large_ = new_block(bytes + alignment, large_);
+        return try_allocate(large_, bytes, alignment);
+    }
+    for (;;) {
+        Block* block = current_.load(std::memory_order_acquire);
+        if (block) {
+            if (void* memory = try_allocate(block, bytes, alignment)) {
+                return memory;
+            }
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (current_.load(std::memory_order_relaxed) == block) {
+            current_.store(new_block(kBlockSize, block), std::memory_order_release);
+        }
+    }
+}
+
+void Arena::reset() {
+    auto release = [](Block* block) {
+        while (block) {
+            Block* prev = block->prev;
+            block->~Block();
+            ::operator delete(block, std::align_val_t{alignof(std::max_align_t)});
+            block = prev;
+        }
+    };
+    release(current_.exchange(nullptr, std::memory_order_relaxed));
+    release(large_);
+    large_ = nullptr;
+    size_t released = memory_usage_.exchange(0, std::memory_order_relaxed);
+    if (tracker_) {
+        tracker_->release(released);
+    }
+}
+
+} // namespace sage_tsdb
@@ -0,0 +1,311 @@
+#include "sage_tsdb/core/async_reader.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
+
+#if defined(SAGE_TSDB_HAVE_IO_URING)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+namespace sage_tsdb {
+
+namespace {
+
+int64_t pread_fully(int fd, uint8_t* buffer, size_t size, uint64_t offset) {
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = ::pread(fd, buffer + done, size - done, static_cast<off_t>(offset + done));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -errno;
+        }
+        if (n == 0) break;      // End of file
+        done += static_cast<size_t>(n);
+    }
+    return static_cast<int64_t>(done);
+}
+
+class ThreadPoolReader : public AsyncReader {
+public:
+    explicit ThreadPoolReader(size_t num_threads) {
+        for (size_t i = 0; i < std::max<size_t>(1, num_threads); ++i) {
+            workers_.emplace_back([this]() { run(); });
+        }
+    }
+
+    ~ThreadPoolReader() override {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        cv_.notify_all();
+        for (auto& worker : workers_) {
+            worker.join();
+        }
+    }
+
+    void read_batch(std::vector<Request>& requests,
+                    const std::function<void(size_t)>& on_complete) override {
+        // Shared with the tasks, which may still notify after the last wakeup
+        struct Batch {
+            std::mutex mutex;
+            std::condition_variable cv;
+            std::vector<size_t> done;
+        };
+        auto batch = std::make_shared<Batch>();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (size_t i = 0; i < requests.size(); ++i) {
+                Request* request = &requests[i];
+                tasks_.emplace_back([request, i, batch]() {
+                    request->result = pread_fully(request->fd, request->buffer, request->size,
+                                                  request->offset);
+                    {
+                        std::lock_guard<std::mutex> batch_lock(batch->mutex);
+                        batch->done.push_back(i);
+                    }
+                    batch->cv.notify_one();
+                });
+            }
+        }
+        cv_.notify_all();
+
+        std::vector<size_t> ready;
+        for (size_t completed = 0; completed < requests.size(); ) {
+            {
+                std::unique_lock<std::mutex> lock(batch->mutex);
+                batch->cv.wait(lock, [&] { return !batch->done.empty(); });
+                ready.swap(batch->done);
+            }
+            for (size_t i : ready) {
+                on_complete(i);
+            }
+            completed += ready.size();
+            ready.clear();
+        }
+    }
+
+    const char* name() const override { return "thread_pool"; }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<std::function<void()>> tasks_;
+    std::vector<std::thread> workers_;
+    bool stopping_ = false;
+
+    void run() {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+                if (tasks_.empty()) return;
+                task = std::move(tasks_.front());
+                tasks_.pop_front();
+            }
+            task();
+        }
+    }
+};
+
+#if defined(SAGE_TSDB_HAVE_IO_URING)
+
+// Minimal io_uring over the raw system calls, so no liburing is needed
+class IoUringReader : public AsyncReader {
+public:
+    static std::unique_ptr<IoUringReader> create(unsigned queue_depth) {
+        std::unique_ptr<IoUringReader> reader(new IoUringReader());
+        return reader->setup(std::max(1u, queue_depth)) ? std::move(reader) : nullptr;
+    }
+
+    ~IoUringReader() override {
+        if (sqes_ != MAP_FAILED) ::munmap(sqes_, sqes_size_);
+        if (cq_ptr_ != MAP_FAILED && cq_ptr_ != sq_ptr_) ::munmap(cq_ptr_, cq_size_);
+        if (sq_ptr_ != MAP_FAILED) ::munmap(sq_ptr_, sq_size_);
+        if (ring_fd_ >= 0) ::close(ring_fd_);
+    }
+
+    void read_batch(std::vector<Request>& requests,
+                    const std::function<void(size_t)>& on_complete) override {
+        // The rings have a single producer and consumer
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        size_t next = 0;
+        size_t completed = 0;
+        unsigned in_flight = 0;
+        unsigned unsubmitted = 0;
+        while (completed < requests.size()) {
+            while (next < requests.size() && in_flight < entries_) {
+                queue_read(requests[next], next);
+                ++next;
+                ++in_flight;
+                ++unsubmitted;
+            }
+
+            int ret = static_cast<int>(::syscall(__NR_io_uring_enter, ring_fd_, unsubmitted, 1,
+                                                 IORING_ENTER_GETEVENTS, nullptr, 0));
+            if (ret >= 0) {
+                unsubmitted -= std::min<unsigned>(unsubmitted, static_cast<unsigned>(ret));
+            } else if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+                // Ring unusable: finish what the kernel never took with pread()
+                finish_unsubmitted(requests, next, unsubmitted, on_complete, completed,
+                                   in_flight);
+            }
+
+            unsigned head = *cq_head_;
+            unsigned tail = std::atomic_ref<unsigned>(*cq_tail_).load(std::memory_order_acquire);
+            for (; head != tail; ++head) {
+                const io_uring_cqe& cqe = cqes_[head & *cq_mask_];
+                size_t i = static_cast<size_t>(cqe.user_data);
+                complete(requests[i], cqe.res);
+                on_complete(i);
+                ++completed;
+                --in_flight;
+            }
+            std::atomic_ref<unsigned>(*cq_head_).store(head, std::memory_order_release);
+        }
+    }
+
+    const char* name() const override { return "io_uring"; }
+
+private:
+    std::mutex mutex_;
+    int ring_fd_ = -1;
+    unsigned entries_ = 0;
+    void* sq_ptr_ = MAP_FAILED;
+    void* cq_ptr_ = MAP_FAILED;
+    void* sqes_ = MAP_FAILED;
+    size_t sq_size_ = 0;
+    size_t cq_size_ = 0;
+    size_t sqes_size_ = 0;
+    unsigned* sq_tail_ = nullptr;
+    unsigned* sq_mask_ = nullptr;
+    unsigned* sq_array_ = nullptr;
+    unsigned* cq_head_ = nullptr;
+    unsigned* cq_tail_ = nullptr;
+    unsigned* cq_mask_ = nullptr;
+    io_uring_cqe* cqes_ = nullptr;
+
+    bool setup(unsigned queue_depth) {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        ring_fd_ = static_cast<int>(::syscall(__NR_io_uring_setup, queue_depth, &params));
+        if (ring_fd_ < 0) {
+            return false;
+        }
+        entries_ = params.sq_entries;
+
+        sq_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single_mmap) {
+            sq_size_ = cq_size_ = std::max(sq_size_, cq_size_);
+        }
+
+        sq_ptr_ = ::mmap(nullptr, sq_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         ring_fd_, IORING_OFF_SQ_RING);
+        if (sq_ptr_ == MAP_FAILED) return false;
+        cq_ptr_ = single_mmap ? sq_ptr_
+            : ::mmap(nullptr, cq_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     ring_fd_, IORING_OFF_CQ_RING);
+        if (cq_ptr_ == MAP_FAILED) return false;
+        sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+        sqes_ = ::mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       ring_fd_, IORING_OFF_SQES);
+        if (sqes_ == MAP_FAILED) return false;
+
+        auto* sq = static_cast<uint8_t*>(sq_ptr_);
+        auto* cq = static_cast<uint8_t*>(cq_ptr_);
+        sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sq_mask_ = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cq_mask_ = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        return true;
+    }
+
+    void queue_read(const Request& request, size_t user_data) {
+        unsigned tail = *sq_tail_;
+        unsigned index = tail & *sq_mask_;
+        io_uring_sqe& sqe = static_cast<io_uring_sqe*>(sqes_)[index];
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = IORING_OP_READ;
+        sqe.fd = request.fd;
+        sqe.off = request.offset;
+        sqe.addr = reinterpret_cast<uint64_t>(request.buffer);
+        sqe.len = static_cast<uint32_t>(request.size);
+        sqe.user_data = user_data;
+        sq_array_[index] = index;
+        std::atomic_ref<unsigned>(*sq_tail_).store(tail + 1, std::memory_order_release);
+    }
+
+    // Kernels without IORING_OP_READ answer -EINVAL; short reads get the rest
+    static void complete(Request& request, int32_t res) {
+        if (res < 0) {
+            request.result = pread_fully(request.fd, request.buffer, request.size, request.offset);
+        } else if (static_cast<size_t>(res) < request.size) {
+            int64_t rest = pread_fully(request.fd, request.buffer + res, request.size - res,
+                                       request.offset + res);
+            request.result = rest < 0 ? rest : res + rest;
+        } else {
+            request.result = res;
+        }
+    }
+
+    void finish_unsubmitted(std::vector<Request>& requests, size_t next, unsigned& unsubmitted,
+                            const std::function<void(size_t)>& on_complete, size_t& completed,
+                            unsigned& in_flight) {
+        // The unsubmitted entries are the last ones queued; take them back
+        std::atomic_ref<unsigned>(*sq_tail_).store(*sq_tail_ - unsubmitted,
+                                                   std::memory_order_release);
+        for (size_t i = next - unsubmitted; i < next; ++i) {
+            requests[i].result = pread_fully(requests[i].fd, requests[i].buffer,
+                                             requests[i].size, requests[i].offset);
+            on_complete(i);
+            ++completed;
+            --in_flight;
+        }
+        unsubmitted = 0;
+    }
+};
+
+#endif
+
+} // namespace
+
+std::shared_ptr<AsyncReader> AsyncReader::create(Backend backend, unsigned queue_depth,
+                                                 size_t num_threads) {
+#if defined(SAGE_TSDB_HAVE_IO_URING)
+    if (backend != Backend::ThreadPool) {
+        if (auto reader = IoUringReader::create(queue_depth)) {
+            return reader;
+        }
+    }
+#endif
+    if (backend == Backend::IoUring) {
+        return nullptr;
+    }
+    return std::make_shared<ThreadPoolReader>(num_threads);
+}
+
+bool AsyncReader::io_uring_available() {
+#if defined(SAGE_TSDB_HAVE_IO_URING)
+    return IoUringReader::create(1) != nullptr;
+#else
+    return false;
+#endif
+}
+
+} // namespace sage_tsdb
@@ -0,0 +1,162 @@
+#include "sage_tsdb/core/block_cache.h"
+#include <algorithm>
+
+namespace sage_tsdb {
+
+namespace {
+
+// Shard stats have a single writer at a time (the shard mutex holder), so
+// a relaxed load and store is enough and cheaper than a locked RMW
+template<typename T>
+void add_relaxed(std::atomic<T>& stat, T delta) {
+    stat.store(stat.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+}
+
+template<typename T>
+void sub_relaxed(std::atomic<T>& stat, T delta) {
+    stat.store(stat.load(std::memory_order_relaxed) - delta, std::memory_order_relaxed);
+}
+
+} // namespace
+
+BlockCache::BlockCache(size_t capacity_bytes, size_t num_shard_bits,
+                       double high_priority_ratio)
+    : capacity_bytes_(capacity_bytes) {
+    size_t num_shards = size_t(1) << std::min<size_t>(num_shard_bits, 10);
+    shard_mask_ = num_shards - 1;
+    high_priority_ratio = std::clamp(high_priority_ratio, 0.0, 1.0);
+
+    shards_.reserve(num_shards);
+    for (size_t i = 0; i < num_shards; ++i) {
+        auto shard = std::make_unique<Shard>();
+        shard->capacity = (capacity_bytes + num_shards - 1) / num_shards;
+        shard->high_capacity = static_cast<size_t>(shard->capacity * high_priority_ratio);
+        shards_.push_back(std::move(shard));
+    }
+}
+
+uint64_t BlockCache::new_file_id() {
+    static std::atomic<uint64_t> next_id{1};
+    return next_id.fetch_add(1, std::memory_order_relaxed);
+}
+
+BlockCache::Value BlockCache::lookup(const Key& key) {
+    Shard& shard = shard_for(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto it = shard.table.find(key);
+    if (it == shard.table.end()) {
+        add_relaxed<uint64_t>(shard.misses, 1);
+        return nullptr;
+    }
+
+    // Move to the front of its own priority list
+    auto entry = it->second;
+    auto& list = (entry->priority == Priority::High) ? shard.high : shard.low;
+    list.splice(list.begin(), list, entry);
+
+    add_relaxed<uint64_t>(shard.hits, 1);
+    return entry->value;
+}
+
+void BlockCache::insert(const Key& key, Value value, size_t charge, Priority priority) {
+    Shard& shard = shard_for(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto existing = shard.table.find(key);
+    if (existing != shard.table.end()) {
+        remove_entry(shard, existing->second);
+    }
+
+    if (charge > shard.capacity) {
+        return;
+    }
+
+    auto& list = (priority == Priority::High) ? shard.high : shard.low;
+    list.push_front(Entry{key, std::move(value), charge, priority});
+    shard.table[key] = list.begin();
+    add_relaxed<size_t>(shard.entries, 1);
+    add_relaxed(shard.usage, charge);
+    if (priority == Priority::High) {
+        add_relaxed(shard.high_usage, charge);
+    }
+    add_relaxed<uint64_t>(shard.inserts, 1);
+
+    enforce_capacity(shard);
+}
+
+void BlockCache::erase(const Key& key) {
+    Shard& shard = shard_for(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto it = shard.table.find(key);
+    if (it != shard.table.end()) {
+        remove_entry(shard, it->second);
+    }
+}
+
+void BlockCache::erase_file(uint64_t file_id) {
+    for (auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        for (auto* list : {&shard->high, &shard->low}) {
+            for (auto it = list->begin(); it != list->end();) {
+                auto next = std::next(it);
+                if (it->key.file_id == file_id) {
+                    remove_entry(*shard, it);
+                }
+                it = next;
+            }
+        }
+    }
+}
+
+BlockCache::Stats BlockCache::get_stats() const {
+    Stats stats;
+    stats.capacity_bytes = capacity_bytes_;
+    for (const auto& shard : shards_) {
+        stats.hits += shard->hits.load(std::memory_order_relaxed);
+        stats.misses += shard->misses.load(std::memory_order_relaxed);
+        stats.inserts += shard->inserts.load(std::memory_order_relaxed);
+        stats.evictions += shard->evictions.load(std::memory_order_relaxed);
+        stats.usage_bytes += shard->usage.load(std::memory_order_relaxed);
+        stats.high_priority_usage_bytes += shard->high_usage.load(std::memory_order_relaxed);
+        stats.num_entries += shard->entries.load(std::memory_order_relaxed);
+    }
+    return stats;
+}
+
+void BlockCache::remove_entry(Shard& shard, EntryList::iterator it) {
+    sub_relaxed(shard.usage, it->charge);
+    sub_relaxed<size_t>(shard.entries, 1);
+    if (it->priority == Priority::High) {
+        sub_relaxed(shard.high_usage, it->charge);
+        shard.table.erase(it->key);
+        shard.high.erase(it);
+    } else {
+        shard.table.erase(it->key);
+        shard.low.erase(it);
+    }
+}
+
+void BlockCache::enforce_capacity(Shard& shard) {
+    // Demote the oldest high priority blocks once their pool is full
+    while (shard.high_usage.load(std::memory_order_relaxed) > shard.high_capacity &&
+           !shard.high.empty()) {
+        auto oldest = std::prev(shard.high.end());
+        oldest->priority = Priority::Low;
+        sub_relaxed(shard.high_usage, oldest->charge);
+        shard.low.splice(shard.low.begin(), shard.high, oldest);
+    }
+
+    // Evict data blocks first, index/filter blocks only as a last resort
+    while (shard.usage.load(std::memory_order_relaxed) > shard.capacity) {
+        auto& victims = shard.low.empty() ? shard.high : shard.low;
+        if (victims.empty()) {
+            break;
+        }
+        remove_entry(shard, std::prev(victims.end()));
+        add_relaxed<uint64_t>(shard.evictions, 1);
+    }
+}
+
+} // namespace sage_tsdb
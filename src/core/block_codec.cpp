@@ -0,0 +1,539 @@
+#include "sage_tsdb/core/block_codec.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <map>
+
+namespace sage_tsdb {
+
+// ============================================================================
+// Bit streams
+// ============================================================================
+
+void BitWriter::write_bit(bool bit) {
+    write_bits(bit ? 1 : 0, 1);
+}
+
+void BitWriter::write_bits(uint64_t value, int num_bits) {
+    while (num_bits > 0) {
+        int bit_in_byte = static_cast<int>(bit_count_ % 8);
+        if (bit_in_byte == 0) {
+            bytes_.push_back(0);
+        }
+        int free_bits = 8 - bit_in_byte;
+        int take = std::min(free_bits, num_bits);
+        uint8_t chunk = static_cast<uint8_t>(
+            (value >> (num_bits - take)) & ((1u << take) - 1));
+        bytes_.back() |= static_cast<uint8_t>(chunk << (free_bits - take));
+        num_bits -= take;
+        bit_count_ += take;
+    }
+}
+
+bool BitReader::read_bit(bool& bit) {
+    uint64_t value;
+    if (!read_bits(1, value)) return false;
+    bit = value != 0;
+    return true;
+}
+
+bool BitReader::read_bits(int num_bits, uint64_t& value) {
+    if (pos_ + static_cast<size_t>(num_bits) > size_bits_) {
+        return false;
+    }
+    value = 0;
+    while (num_bits > 0) {
+        int bit_in_byte = static_cast<int>(pos_ % 8);
+        int avail = 8 - bit_in_byte;
+        int take = std::min(avail, num_bits);
+        uint8_t byte = data_[pos_ / 8];
+        uint64_t chunk = (byte >> (avail - take)) & ((1u << take) - 1);
+        value = (value << take) | chunk;
+        num_bits -= take;
+        pos_ += take;
+    }
+    return true;
+}
+
+// ============================================================================
+// Delta-of-delta timestamps
+// ============================================================================
+
+void TimestampEncoder::append(int64_t timestamp) {
+    if (count_ == 0) {
+        writer_.write_bits(static_cast<uint64_t>(timestamp), 64);
+    } else if (count_ == 1) {
+        prev_delta_ = static_cast<int64_t>(
+            static_cast<uint64_t>(timestamp) - static_cast<uint64_t>(prev_timestamp_));
+        writer_.write_bits(zigzag_encode(prev_delta_), 64);
+    } else {
+        int64_t delta = static_cast<int64_t>(
+            static_cast<uint64_t>(timestamp) - static_cast<uint64_t>(prev_timestamp_));
+        uint64_t dod = zigzag_encode(static_cast<int64_t>(
+            static_cast<uint64_t>(delta) - static_cast<uint64_t>(prev_delta_)));
+
+        if (dod == 0) {
+            writer_.write_bit(false);
+        } else if (dod < (1ULL << 7)) {
+            writer_.write_bits(0b10, 2);
+            writer_.write_bits(dod, 7);
+        } else if (dod < (1ULL << 9)) {
+            writer_.write_bits(0b110, 3);
+            writer_.write_bits(dod, 9);
+        } else if (dod < (1ULL << 12)) {
+            writer_.write_bits(0b1110, 4);
+            writer_.write_bits(dod, 12);
+        } else {
+            writer_.write_bits(0b1111, 4);
+            writer_.write_bits(dod, 64);
+        }
+        prev_delta_ = delta;
+    }
+    prev_timestamp_ = timestamp;
+    ++count_;
+}
+
+bool TimestampDecoder::next(int64_t& timestamp) {
+    uint64_t raw;
+    if (count_ == 0) {
+        if (!reader_.read_bits(64, raw)) return false;
+        timestamp = static_cast<int64_t>(raw);
+    } else if (count_ == 1) {
+        if (!reader_.read_bits(64, raw)) return false;
+        prev_delta_ = zigzag_decode(raw);
+        timestamp = static_cast<int64_t>(
+            static_cast<uint64_t>(prev_timestamp_) + static_cast<uint64_t>(prev_delta_));
+    } else {
+        // Count leading 1 bits of the bucket selector (at most 4)
+        int ones = 0;
+        bool bit;
+        while (ones < 4) {
+            if (!reader_.read_bit(bit)) return false;
+            if (!bit) break;
+            ++ones;
+        }
+
+        uint64_t dod = 0;
+        static constexpr int kBucketBits[] = {0, 7, 9, 12, 64};
+        if (ones > 0 && !reader_.read_bits(kBucketBits[ones], dod)) {
+            return false;
+        }
+
+        int64_t delta = static_cast<int64_t>(
+            static_cast<uint64_t>(prev_delta_) + static_cast<uint64_t>(zigzag_decode(dod)));
+        timestamp = static_cast<int64_t>(
+            static_cast<uint64_t>(prev_timestamp_) + static_cast<uint64_t>(delta));
+        prev_delta_ = delta;
+    }
+    prev_timestamp_ = timestamp;
+    ++count_;
+    return true;
+}
+
+// ============================================================================
+// XOR values
+// ============================================================================
+
+void XorValueEncoder::append(double value) {
+    uint64_t bits = std::bit_cast<uint64_t>(value);
+
+    if (count_ == 0) {
+        writer_.write_bits(bits, 64);
+    } else {
+        uint64_t x = bits ^ prev_bits_;
+        if (x == 0) {
+            writer_.write_bit(false);
+        } else {
+            writer_.write_bit(true);
+            int leading = std::min(std::countl_zero(x), 31);
+            int trailing = std::countr_zero(x);
+
+            if (prev_leading_ >= 0 && leading >= prev_leading_ && trailing >= prev_trailing_) {
+                // Meaningful bits fit in the previous window
+                writer_.write_bit(false);
+                writer_.write_bits(x >> prev_trailing_, 64 - prev_leading_ - prev_trailing_);
+            } else {
+                int significant = 64 - leading - trailing;
+                writer_.write_bit(true);
+                writer_.write_bits(static_cast<uint64_t>(leading), 5);
+                writer_.write_bits(static_cast<uint64_t>(significant & 63), 6);
+                writer_.write_bits(x >> trailing, significant);
+                prev_leading_ = leading;
+                prev_trailing_ = trailing;
+            }
+        }
+    }
+    prev_bits_ = bits;
+    ++count_;
+}
+
+bool XorValueDecoder::next(double& value) {
+    if (count_ == 0) {
+        if (!reader_.read_bits(64, prev_bits_)) return false;
+    } else {
+        bool bit;
+        if (!reader_.read_bit(bit)) return false;
+        if (bit) {
+            bool new_window;
+            if (!reader_.read_bit(new_window)) return false;
+            if (new_window) {
+                uint64_t leading, significant;
+                if (!reader_.read_bits(5, leading)) return false;
+                if (!reader_.read_bits(6, significant)) return false;
+                if (significant == 0) significant = 64;
+                prev_leading_ = static_cast<int>(leading);
+                prev_trailing_ = 64 - prev_leading_ - static_cast<int>(significant);
+                if (prev_trailing_ < 0) return false;
+            }
+            uint64_t meaningful;
+            if (!reader_.read_bits(64 - prev_leading_ - prev_trailing_, meaningful)) {
+                return false;
+            }
+            prev_bits_ ^= meaningful << prev_trailing_;
+        }
+    }
+    value = std::bit_cast<double>(prev_bits_);
+    ++count_;
+    return true;
+}
+
+// ============================================================================
+// Varints
+// ============================================================================
+
+void put_varint64(std::vector<uint8_t>& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+bool get_varint64(const uint8_t*& ptr, const uint8_t* end, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift <= 63 && ptr < end; shift += 7) {
+        uint64_t byte = *ptr++;
+        value |= (byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// ============================================================================
+// CRC32C
+// ============================================================================
+
+namespace {
+
+struct Crc32cTable {
+    uint32_t entries[8][256];
+
+    Crc32cTable() {
+        // Castagnoli polynomial, reflected
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc >> 1) ^ (0x82F63B78u & (0u - (crc & 1u)));
+            }
+            entries[0][i] = crc;
+        }
+        for (uint32_t i = 0; i < 256; ++i) {
+            for (int t = 1; t < 8; ++t) {
+                uint32_t prev = entries[t - 1][i];
+                entries[t][i] = (prev >> 8) ^ entries[0][prev & 0xFF];
+            }
+        }
+    }
+};
+
+const Crc32cTable& crc32c_table() {
+    static const Crc32cTable table;
+    return table;
+}
+
+} // namespace
+
+uint32_t crc32c(const uint8_t* data, size_t size, uint32_t crc) {
+    const auto& t = crc32c_table().entries;
+    crc = ~crc;
+
+    // Slicing-by-8
+    while (size >= 8) {
+        uint64_t word;
+        std::memcpy(&word, data, sizeof(word));
+        word ^= crc;
+        crc = t[7][word & 0xFF] ^ t[6][(word >> 8) & 0xFF] ^
+              t[5][(word >> 16) & 0xFF] ^ t[4][(word >> 24) & 0xFF] ^
+              t[3][(word >> 32) & 0xFF] ^ t[2][(word >> 40) & 0xFF] ^
+              t[1][(word >> 48) & 0xFF] ^ t[0][word >> 56];
+        data += 8;
+        size -= 8;
+    }
+    while (size-- > 0) {
+        crc = (crc >> 8) ^ t[0][(crc ^ *data++) & 0xFF];
+    }
+    return ~crc;
+}
+
+// ============================================================================
+// Columnar block
+// ============================================================================
+
+namespace {
+
+void put_string(std::vector<uint8_t>& out, const std::string& s) {
+    put_varint64(out, s.size());
+    out.insert(out.end(), s.begin(), s.end());
+}
+
+bool get_string(const uint8_t*& ptr, const uint8_t* end, std::string& s) {
+    uint64_t len;
+    if (!get_varint64(ptr, end, len) || static_cast<uint64_t>(end - ptr) < len) {
+        return false;
+    }
+    s.assign(reinterpret_cast<const char*>(ptr), len);
+    ptr += len;
+    return true;
+}
+
+void put_stream(std::vector<uint8_t>& out, const BitWriter& writer) {
+    put_varint64(out, writer.bytes().size());
+    out.insert(out.end(), writer.bytes().begin(), writer.bytes().end());
+}
+
+void put_value(std::vector<uint8_t>& out, const std::string& value) {
+    put_string(out, value);
+}
+
+void put_value(std::vector<uint8_t>& out, const FieldValue& value) {
+    value.serialize(out);
+}
+
+bool get_value(const uint8_t*& ptr, const uint8_t* end, std::string& value) {
+    return get_string(ptr, end, value);
+}
+
+bool get_value(const uint8_t*& ptr, const uint8_t* end, FieldValue& value) {
+    return value.deserialize(ptr, end);
+}
+
+/**
+ * @brief Writes the distinct maps once, then one dictionary id per point
+ */
+template <typename Map, typename Getter>
+void put_dictionary(std::vector<uint8_t>& out, const TimeSeriesData* points,
+                    size_t count, Getter getter) {
+    std::map<Map, uint64_t> ids;
+    std::vector<const Map*> entries;
+    std::vector<uint64_t> point_ids;
+    point_ids.reserve(count);
+
+    for (size_t i = 0; i < count; ++i) {
+        const Map& m = getter(points[i]);
+        auto [it, inserted] = ids.emplace(m, entries.size());
+        if (inserted) {
+            entries.push_back(&it->first);
+        }
+        point_ids.push_back(it->second);
+    }
+
+    put_varint64(out, entries.size());
+    for (const Map* m : entries) {
+        put_varint64(out, m->size());
+        for (const auto& [key, value] : *m) {
+            put_string(out, key);
+            put_value(out, value);
+        }
+    }
+
+    // A single shared entry needs no per-point ids
+    if (entries.size() > 1) {
+        for (uint64_t id : point_ids) {
+            put_varint64(out, id);
+        }
+    }
+}
+
+// Value is the type the dictionary was written with; blocks from before
+// fields were typed hold text fields
+template <typename Map, typename Value = typename Map::mapped_type, typename Setter>
+bool get_dictionary(const uint8_t*& ptr, const uint8_t* end,
+                    std::vector<TimeSeriesData>& out, size_t first, size_t count,
+                    Setter setter) {
+    uint64_t num_entries;
+    if (!get_varint64(ptr, end, num_entries)) return false;
+
+    std::vector<Map> entries(num_entries);
+    for (auto& m : entries) {
+        uint64_t num_pairs;
+        if (!get_varint64(ptr, end, num_pairs)) return false;
+        for (uint64_t p = 0; p < num_pairs; ++p) {
+            std::string key;
+            Value value;
+            if (!get_string(ptr, end, key) || !get_value(ptr, end, value)) {
+                return false;
+            }
+            m.emplace(std::move(key), std::move(value));
+        }
+    }
+
+    if (entries.empty()) {
+        return count == 0;
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        uint64_t id = 0;
+        if (entries.size() > 1 && !get_varint64(ptr, end, id)) return false;
+        if (id >= entries.size()) return false;
+        setter(out[first + i], entries[id]);
+    }
+    return true;
+}
+
+} // namespace
+
+void ColumnarBlock::encode(const TimeSeriesData* points, size_t count,
+                           std::vector<uint8_t>& out) {
+    uint8_t flags = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (points[i].is_array()) flags |= kHasArrays;
+        if (!points[i].fields.empty()) flags |= kHasFields | kTypedFields;
+    }
+
+    uint32_t num_points = static_cast<uint32_t>(count);
+    size_t header_pos = out.size();
+    out.resize(header_pos + sizeof(num_points));
+    std::memcpy(out.data() + header_pos, &num_points, sizeof(num_points));
+    out.push_back(flags);
+
+    // Timestamp column
+    BitWriter ts_writer;
+    TimestampEncoder ts_encoder(ts_writer);
+    for (size_t i = 0; i < count; ++i) {
+        ts_encoder.append(points[i].timestamp);
+    }
+    put_stream(out, ts_writer);
+
+    // Scalar value column
+    BitWriter value_writer;
+    XorValueEncoder value_encoder(value_writer);
+    for (size_t i = 0; i < count; ++i) {
+        if (points[i].is_scalar()) {
+            value_encoder.append(std::get<double>(points[i].value));
+        }
+    }
+    put_stream(out, value_writer);
+
+    // Array values (rare; stored raw after a per-point kind column)
+    if (flags & kHasArrays) {
+        for (size_t i = 0; i < count; ++i) {
+            uint64_t kind = points[i].is_scalar()
+                ? 0 : std::get<std::vector<double>>(points[i].value).size() + 1;
+            put_varint64(out, kind);
+        }
+        for (size_t i = 0; i < count; ++i) {
+            if (!points[i].is_array()) continue;
+            const auto& vec = std::get<std::vector<double>>(points[i].value);
+            size_t pos = out.size();
+            out.resize(pos + vec.size() * sizeof(double));
+            if (!vec.empty()) {
+                std::memcpy(out.data() + pos, vec.data(), vec.size() * sizeof(double));
+            }
+        }
+    }
+
+    put_dictionary<Tags>(out, points, count,
+                         [](const TimeSeriesData& d) -> const Tags& { return d.tags; });
+    if (flags & kHasFields) {
+        put_dictionary<Fields>(out, points, count,
+                               [](const TimeSeriesData& d) -> const Fields& { return d.fields; });
+    }
+}
+
+bool ColumnarBlock::decode(const uint8_t* data, size_t size,
+                           std::vector<TimeSeriesData>& out) {
+    const uint8_t* ptr = data;
+    const uint8_t* end = data + size;
+
+    uint32_t num_points;
+    if (size < sizeof(num_points) + 1) return false;
+    std::memcpy(&num_points, ptr, sizeof(num_points));
+    ptr += sizeof(num_points);
+    uint8_t flags = *ptr++;
+
+    size_t first = out.size();
+    out.resize(first + num_points);
+
+    // Timestamp column
+    uint64_t stream_len;
+    if (!get_varint64(ptr, end, stream_len) || static_cast<uint64_t>(end - ptr) < stream_len) {
+        return false;
+    }
+    {
+        BitReader reader(ptr, stream_len);
+        TimestampDecoder decoder(reader);
+        for (uint32_t i = 0; i < num_points; ++i) {
+            if (!decoder.next(out[first + i].timestamp)) return false;
+        }
+    }
+    ptr += stream_len;
+
+    // Scalar value column (decoded after kinds are known)
+    if (!get_varint64(ptr, end, stream_len) || static_cast<uint64_t>(end - ptr) < stream_len) {
+        return false;
+    }
+    const uint8_t* value_stream = ptr;
+    ptr += stream_len;
+
+    std::vector<uint64_t> kinds;
+    if (flags & kHasArrays) {
+        kinds.resize(num_points);
+        for (auto& kind : kinds) {
+            if (!get_varint64(ptr, end, kind)) return false;
+        }
+        for (uint32_t i = 0; i < num_points; ++i) {
+            if (kinds[i] == 0) continue;
+            size_t n = kinds[i] - 1;
+            if (static_cast<size_t>(end - ptr) < n * sizeof(double)) return false;
+            std::vector<double> vec(n);
+            if (n > 0) {
+                std::memcpy(vec.data(), ptr, n * sizeof(double));
+            }
+            ptr += n * sizeof(double);
+            out[first + i].value = std::move(vec);
+        }
+    }
+
+    {
+        BitReader reader(value_stream, stream_len);
+        XorValueDecoder decoder(reader);
+        for (uint32_t i = 0; i < num_points; ++i) {
+            if (!kinds.empty() && kinds[i] != 0) continue;
+            double value;
+            if (!decoder.next(value)) return false;
+            out[first + i].value = value;
+        }
+    }
+
+    if (!get_dictionary<Tags>(ptr, end, out, first, num_points,
+                              [](TimeSeriesData& d, const Tags& m) { d.tags = m; })) {
+        return false;
+    }
+    if (flags & kHasFields) {
+        bool ok = (flags & kTypedFields)
+            ? get_dictionary<Fields>(ptr, end, out, first, num_points,
+                                     [](TimeSeriesData& d, const Fields& m) { d.fields = m; })
+            : get_dictionary<Fields, std::string>(
+                  ptr, end, out, first, num_points,
+                  [](TimeSeriesData& d, const Fields& m) { d.fields = m; });
+        if (!ok) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+} // namespace sage_tsdb
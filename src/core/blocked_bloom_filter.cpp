@@ -0,0 +1,124 @@
+#include "sage_tsdb/core/blocked_bloom_filter.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace sage_tsdb {
+
+namespace {
+
+// Odd multipliers from the Parquet split-block bloom filter
+alignas(32) constexpr uint32_t kSalts[8] = {
+    0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+    0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U};
+
+} // namespace
+
+BlockedBloomFilter::BlockedBloomFilter(size_t num_keys, size_t bits_per_key) {
+    size_t bits = std::max<size_t>(1, num_keys) * std::max<size_t>(1, bits_per_key);
+    buckets_.resize((bits + sizeof(Bucket) * 8 - 1) / (sizeof(Bucket) * 8));
+}
+
+uint64_t BlockedBloomFilter::mix(uint64_t key) {
+    // splitmix64 finalizer; series ids are already hashes but tag keys are not
+    key ^= key >> 30;
+    key *= 0xbf58476d1ce4e5b9ULL;
+    key ^= key >> 27;
+    key *= 0x94d049bb133111ebULL;
+    key ^= key >> 31;
+    return key;
+}
+
+size_t BlockedBloomFilter::bucket_for(uint64_t hash) const {
+    // Multiply-shift range reduction on the upper half
+    return static_cast<size_t>(((hash >> 32) * buckets_.size()) >> 32);
+}
+
+void BlockedBloomFilter::add(uint64_t key) {
+    if (buckets_.empty()) {
+        return;
+    }
+    uint64_t hash = mix(key);
+    uint32_t low = static_cast<uint32_t>(hash);
+    Bucket& bucket = buckets_[bucket_for(hash)];
+    for (size_t i = 0; i < kWordsPerBucket; ++i) {
+        bucket.words[i] |= 1U << ((low * kSalts[i]) >> 27);
+    }
+}
+
+bool BlockedBloomFilter::might_contain(uint64_t key) const {
+    if (buckets_.empty()) {
+        return true;
+    }
+    uint64_t hash = mix(key);
+    uint32_t low = static_cast<uint32_t>(hash);
+    const Bucket& bucket = buckets_[bucket_for(hash)];
+
+#if defined(__AVX2__)
+    __m256i salts = _mm256_load_si256(reinterpret_cast<const __m256i*>(kSalts));
+    __m256i shifts = _mm256_srli_epi32(_mm256_mullo_epi32(_mm256_set1_epi32(low), salts), 27);
+    __m256i mask = _mm256_sllv_epi32(_mm256_set1_epi32(1), shifts);
+    __m256i words = _mm256_load_si256(reinterpret_cast<const __m256i*>(bucket.words));
+    // testc: (~words & mask) == 0
+    return _mm256_testc_si256(words, mask) != 0;
+#else
+    uint32_t missing = 0;
+    for (size_t i = 0; i < kWordsPerBucket; ++i) {
+        missing |= ~bucket.words[i] & (1U << ((low * kSalts[i]) >> 27));
+    }
+    return missing == 0;
+#endif
+}
+
+bool BlockedBloomFilter::might_contain_all(const std::vector<uint64_t>& keys) const {
+    for (uint64_t key : keys) {
+        if (!might_contain(key)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void BlockedBloomFilter::serialize(std::vector<uint8_t>& out) const {
+    uint32_t num_buckets = static_cast<uint32_t>(buckets_.size());
+    const auto* header = reinterpret_cast<const uint8_t*>(&num_buckets);
+    out.insert(out.end(), header, header + sizeof(num_buckets));
+    const auto* bytes = reinterpret_cast<const uint8_t*>(buckets_.data());
+    out.insert(out.end(), bytes, bytes + size_bytes());
+}
+
+bool BlockedBloomFilter::deserialize(const uint8_t*& ptr, const uint8_t* end) {
+    uint32_t num_buckets;
+    if (static_cast<size_t>(end - ptr) < sizeof(num_buckets)) return false;
+    std::memcpy(&num_buckets, ptr, sizeof(num_buckets));
+    ptr += sizeof(num_buckets);
+
+    size_t bytes = static_cast<size_t>(num_buckets) * sizeof(Bucket);
+    if (static_cast<size_t>(end - ptr) < bytes) return false;
+    buckets_.resize(num_buckets);
+    std::memcpy(buckets_.data(), ptr, bytes);
+    ptr += bytes;
+    return true;
+}
+
+uint64_t BlockedBloomFilter::tag_key(const std::string& key, const std::string& value) {
+    // FNV-1a over "key=value", then salted so it cannot equal a series id
+    // of a series with that single tag
+    uint64_t hash = 14695981039346656037ULL;
+    auto feed = [&hash](const std::string& str) {
+        for (unsigned char c : str) {
+            hash ^= c;
+            hash *= 1099511628211ULL;
+        }
+    };
+    feed(key);
+    hash ^= '=';
+    hash *= 1099511628211ULL;
+    feed(value);
+    return hash ^ 0x7461676b6579ULL;  // "tagkey"
+}
+
+} // namespace sage_tsdb
@@ -0,0 +1,147 @@
+#include "sage_tsdb/core/bulk_file.h"
+#include "sage_tsdb/core/block_codec.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <utility>
+
+namespace sage_tsdb {
+
+namespace {
+
+template<typename T>
+void write_pod(std::ofstream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template<typename T>
+bool read_pod(const uint8_t*& ptr, const uint8_t* end, T& value) {
+    if (static_cast<size_t>(end - ptr) < sizeof(T)) {
+        return false;
+    }
+    std::memcpy(&value, ptr, sizeof(T));
+    ptr += sizeof(T);
+    return true;
+}
+
+} // anonymous namespace
+
+BulkFileWriter::~BulkFileWriter() {
+    if (out_.is_open()) {
+        close();
+    }
+}
+
+bool BulkFileWriter::open(const std::string& path) {
+    out_.open(path, std::ios::binary | std::ios::trunc);
+    if (!out_) {
+        std::cerr << "Failed to create bulk file: " << path << std::endl;
+        return false;
+    }
+    write_pod(out_, kMagic);
+    write_pod(out_, kVersion);
+    pending_.reserve(kFramePoints);
+    points_written_ = 0;
+    return static_cast<bool>(out_);
+}
+
+bool BulkFileWriter::append(const TimeSeriesData& point) {
+    pending_.push_back(point);
+    return pending_.size() < kFramePoints || write_frame();
+}
+
+bool BulkFileWriter::append(TimeSeriesData&& point) {
+    pending_.push_back(std::move(point));
+    return pending_.size() < kFramePoints || write_frame();
+}
+
+bool BulkFileWriter::append(const TimeSeriesData* points, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        if (!append(points[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool BulkFileWriter::write_frame() {
+    if (pending_.empty()) {
+        return true;
+    }
+    // Stable: equal timestamps keep their order, so later versions stay later
+    std::stable_sort(pending_.begin(), pending_.end(),
+                     [](const TimeSeriesData& a, const TimeSeriesData& b) {
+                         return a.timestamp < b.timestamp;
+                     });
+    encoded_.clear();
+    ColumnarBlock::encode(pending_.data(), pending_.size(), encoded_);
+
+    write_pod(out_, static_cast<uint32_t>(encoded_.size()));
+    write_pod(out_, crc32c(encoded_.data(), encoded_.size()));
+    out_.write(reinterpret_cast<const char*>(encoded_.data()),
+               static_cast<std::streamsize>(encoded_.size()));
+    points_written_ += pending_.size();
+    pending_.clear();
+    return static_cast<bool>(out_);
+}
+
+bool BulkFileWriter::close() {
+    bool ok = write_frame();
+    out_.close();
+    return ok && !out_.fail();
+}
+
+bool BulkFileReader::open(const std::string& path) {
+    file_ = MappedFile::open(path);
+    corrupt_ = false;
+    offset_ = 0;
+    if (!file_) {
+        return false;
+    }
+    const uint8_t* ptr = file_->data();
+    const uint8_t* end = ptr + file_->size();
+    uint32_t magic;
+    uint32_t version;
+    if (!read_pod(ptr, end, magic) || !read_pod(ptr, end, version) ||
+        magic != BulkFileWriter::kMagic || version != BulkFileWriter::kVersion) {
+        file_.reset();
+        return false;
+    }
+    offset_ = static_cast<size_t>(ptr - file_->data());
+    return true;
+}
+
+bool BulkFileReader::next(std::vector<TimeSeriesData>& out) {
+    if (!file_ || corrupt_ || offset_ == file_->size()) {
+        return false;
+    }
+    const uint8_t* ptr = file_->data() + offset_;
+    const uint8_t* end = file_->data() + file_->size();
+    uint32_t size;
+    uint32_t crc;
+    if (!read_pod(ptr, end, size) || !read_pod(ptr, end, crc) ||
+        static_cast<size_t>(end - ptr) < size || crc32c(ptr, size) != crc ||
+        !ColumnarBlock::decode(ptr, size, out)) {
+        corrupt_ = true;
+        return false;
+    }
+    offset_ = static_cast<size_t>(ptr + size - file_->data());
+    return true;
+}
+
+bool write_bulk_file(const std::string& path, const std::vector<TimeSeriesData>& points) {
+    BulkFileWriter writer;
+    return writer.open(path) && writer.append(points.data(), points.size()) && writer.close();
+}
+
+bool read_bulk_file(const std::string& path, std::vector<TimeSeriesData>& points) {
+    BulkFileReader reader;
+    if (!reader.open(path)) {
+        return false;
+    }
+    while (reader.next(points)) {
+    }
+    return !reader.corrupt();
+}
+
+} // namespace sage_tsdb
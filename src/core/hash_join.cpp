@@ -0,0 +1,412 @@
+#include "sage_tsdb/core/hash_join.h"
+#include "sage_tsdb/core/simd.h"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace sage_tsdb {
+namespace join_kernels {
+
+namespace {
+
+constexpr size_t kPartitionTuples = 4096;  // Build tuples per partition: table fits in L2
+constexpr int kMaxPartitionBits = 10;      // 1024-way scatter stays TLB friendly
+constexpr int kHashShift = 16;             // Low product bits are poorly mixed
+constexpr uint64_t kBucketMul = 0x9E3779B97F4A7C15;  // Remixes the hash for task buckets
+
+constexpr uint64_t kMulLow = 0x9E3779B1;
+constexpr uint64_t kMulHigh = 0x85EBCA77;
+
+// 32x32 -> 64 bit products, so SIMD lanes compute the same hash
+inline uint64_t hash_key(uint64_t key) {
+    return ((key & 0xFFFFFFFF) * kMulLow) ^ ((key >> 32) * kMulHigh);
+}
+
+struct Table {
+    std::vector<uint64_t> keys;
+    std::vector<uint64_t> counts;  // 0 = empty slot
+    std::vector<double> weights;   // Per key: tuple count or value sum of the build side
+    uint64_t mask = 0;
+    int shift = 0;                 // slot = (hash >> shift) & mask
+
+    void reset(size_t build_count, int hash_shift, bool weighted) {
+        size_t capacity = std::bit_ceil(std::max<size_t>(16, build_count * 2));
+        keys.assign(capacity, 0);
+        counts.assign(capacity, 0);
+        if (weighted) {
+            weights.assign(capacity, 0.0);
+        }
+        mask = capacity - 1;
+        shift = hash_shift;
+    }
+
+    void build(const uint64_t* build_keys, const double* values, size_t n, bool weighted) {
+        for (size_t i = 0; i < n; ++i) {
+            uint64_t key = build_keys[i];
+            uint64_t slot = (hash_key(key) >> shift) & mask;
+            while (counts[slot] != 0 && keys[slot] != key) {
+                slot = (slot + 1) & mask;
+            }
+            keys[slot] = key;
+            counts[slot]++;
+            if (weighted) {
+                weights[slot] += values ? values[i] : 1.0;
+            }
+        }
+    }
+
+    // Continues the linear probe of key from its home slot
+    template <bool kSum>
+    void probe_one(uint64_t key, double factor, uint64_t& pairs, double& sum) const {
+        uint64_t slot = (hash_key(key) >> shift) & mask;
+        while (counts[slot] != 0) {
+            if (keys[slot] == key) {
+                pairs += counts[slot];
+                if constexpr (kSum) {
+                    sum += weights[slot] * factor;
+                }
+                return;
+            }
+            slot = (slot + 1) & mask;
+        }
+    }
+};
+
+// Probe kernels handle full lane batches and return where the scalar
+// tail starts. With kFactors each probe tuple's match is weighted by
+// factors[i], else by 1
+#if defined(SAGE_TSDB_SIMD_DISPATCH)
+template <bool kSum, bool kFactors>
+SAGE_TSDB_TARGET("avx512f")
+size_t probe_avx512(const Table& table, const uint64_t* keys, const double* factors, size_t n,
+                    uint64_t& pairs, double& sum) {
+    size_t i = 0;
+    const __m512i mul_low = _mm512_set1_epi64(kMulLow);
+    const __m512i mul_high = _mm512_set1_epi64(kMulHigh);
+    const __m512i mask = _mm512_set1_epi64(static_cast<long long>(table.mask));
+    const __m512i zero = _mm512_setzero_si512();
+    __m512i pair_lanes = _mm512_setzero_si512();
+    __m512d sum_lanes = _mm512_setzero_pd();
+    for (; i + 8 <= n; i += 8) {
+        __m512i key = _mm512_loadu_si512(keys + i);
+        __m512i hash = _mm512_xor_si512(_mm512_mul_epu32(key, mul_low),
+                                        _mm512_mul_epu32(_mm512_srli_epi64(key, 32), mul_high));
+        __m512i slot = _mm512_and_si512(_mm512_srl_epi64(hash, _mm_cvtsi32_si128(table.shift)), mask);
+        __m512i slot_key = _mm512_i64gather_epi64(slot, table.keys.data(), 8);
+        __m512i slot_count = _mm512_i64gather_epi64(slot, table.counts.data(), 8);
+        __mmask8 hit = _mm512_cmpeq_epi64_mask(slot_key, key);
+        __mmask8 empty = _mm512_cmpeq_epi64_mask(slot_count, zero);
+        pair_lanes = _mm512_mask_add_epi64(pair_lanes, hit, pair_lanes, slot_count);
+        if constexpr (kSum) {
+            __m512d weight = _mm512_mask_i64gather_pd(_mm512_setzero_pd(), hit, slot,
+                                                      table.weights.data(), 8);
+            if constexpr (kFactors) {
+                weight = _mm512_mul_pd(weight, _mm512_loadu_pd(factors + i));
+            }
+            sum_lanes = _mm512_add_pd(sum_lanes, weight);
+        }
+        // Lanes that found another key keep probing one by one
+        unsigned collided = static_cast<unsigned>(~(hit | empty)) & 0xFF;
+        while (collided != 0) {
+            int lane = std::countr_zero(collided);
+            collided &= collided - 1;
+            table.probe_one<kSum>(keys[i + lane], kFactors ? factors[i + lane] : 1.0, pairs, sum);
+        }
+    }
+    pairs += static_cast<uint64_t>(_mm512_reduce_add_epi64(pair_lanes));
+    sum += _mm512_reduce_add_pd(sum_lanes);
+    return i;
+}
+
+template <bool kSum, bool kFactors>
+SAGE_TSDB_TARGET("avx2")
+size_t probe_avx2(const Table& table, const uint64_t* keys, const double* factors, size_t n,
+                  uint64_t& pairs, double& sum) {
+    size_t i = 0;
+    const __m256i mul_low = _mm256_set1_epi64x(kMulLow);
+    const __m256i mul_high = _mm256_set1_epi64x(kMulHigh);
+    const __m256i mask = _mm256_set1_epi64x(static_cast<long long>(table.mask));
+    const __m256i zero = _mm256_setzero_si256();
+    const auto* slot_keys = reinterpret_cast<const long long*>(table.keys.data());
+    const auto* slot_counts = reinterpret_cast<const long long*>(table.counts.data());
+    __m256i pair_lanes = _mm256_setzero_si256();
+    __m256d sum_lanes = _mm256_setzero_pd();
+    for (; i + 4 <= n; i += 4) {
+        __m256i key = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i));
+        __m256i hash = _mm256_xor_si256(_mm256_mul_epu32(key, mul_low),
+                                        _mm256_mul_epu32(_mm256_srli_epi64(key, 32), mul_high));
+        __m256i slot = _mm256_and_si256(_mm256_srl_epi64(hash, _mm_cvtsi32_si128(table.shift)), mask);
+        __m256i slot_key = _mm256_i64gather_epi64(slot_keys, slot, 8);
+        __m256i slot_count = _mm256_i64gather_epi64(slot_counts, slot, 8);
+        __m256i hit = _mm256_cmpeq_epi64(slot_key, key);
+        __m256i empty = _mm256_cmpeq_epi64(slot_count, zero);
+        // An empty slot has count and weight 0, so a key-0 "hit" there adds nothing
+        pair_lanes = _mm256_add_epi64(pair_lanes, _mm256_and_si256(slot_count, hit));
+        if constexpr (kSum) {
+            __m256d weight = _mm256_and_pd(_mm256_i64gather_pd(table.weights.data(), slot, 8),
+                                           _mm256_castsi256_pd(hit));
+            if constexpr (kFactors) {
+                weight = _mm256_mul_pd(weight, _mm256_loadu_pd(factors + i));
+            }
+            sum_lanes = _mm256_add_pd(sum_lanes, weight);
+        }
+        // Lanes that found another key keep probing one by one
+        unsigned resolved = static_cast<unsigned>(
+            _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_or_si256(hit, empty))));
+        unsigned collided = ~resolved & 0xF;
+        while (collided != 0) {
+            int lane = std::countr_zero(collided);
+            collided &= collided - 1;
+            table.probe_one<kSum>(keys[i + lane], kFactors ? factors[i + lane] : 1.0, pairs, sum);
+        }
+    }
+    alignas(32) uint64_t pair_out[4];
+    alignas(32) double sum_out[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(pair_out), pair_lanes);
+    _mm256_store_pd(sum_out, sum_lanes);
+    for (int lane = 0; lane < 4; ++lane) {
+        pairs += pair_out[lane];
+        sum += sum_out[lane];
+    }
+    return i;
+}
+#endif
+
+template <bool kSum, bool kFactors>
+void probe(const Table& table, const uint64_t* keys, const double* factors, size_t n,
+           uint64_t& pairs, double& sum) {
+    size_t i = 0;
+    switch (simd::active()) {
+#if defined(SAGE_TSDB_SIMD_DISPATCH)
+        case simd::Level::AVX512:
+            i = probe_avx512<kSum, kFactors>(table, keys, factors, n, pairs, sum);
+            break;
+        case simd::Level::AVX2:
+            i = probe_avx2<kSum, kFactors>(table, keys, factors, n, pairs, sum);
+            break;
+#endif
+        default: break;
+    }
+    for (; i < n; ++i) {
+        table.probe_one<kSum>(keys[i], kFactors ? factors[i] : 1.0, pairs, sum);
+    }
+}
+
+// Stable scatter of keys (and values) into 2^bits partitions by hash
+void scatter(const uint64_t* keys, const double* values, size_t n, int bits,
+             std::vector<uint16_t>& parts, std::vector<size_t>& cursor,
+             std::vector<size_t>& offsets, std::vector<uint64_t>& out_keys,
+             std::vector<double>& out_values) {
+    const size_t partitions = size_t{1} << bits;
+    const uint64_t mask = partitions - 1;
+    offsets.assign(partitions + 1, 0);
+    parts.resize(n);
+    for (size_t i = 0; i < n; ++i) {
+        parts[i] = static_cast<uint16_t>((hash_key(keys[i]) >> kHashShift) & mask);
+        offsets[parts[i] + 1]++;
+    }
+    for (size_t p = 0; p < partitions; ++p) {
+        offsets[p + 1] += offsets[p];
+    }
+
+    cursor.assign(offsets.begin(), offsets.end() - 1);
+    out_keys.resize(n);
+    if (values) {
+        out_values.resize(n);
+    }
+    for (size_t i = 0; i < n; ++i) {
+        size_t pos = cursor[parts[i]]++;
+        out_keys[pos] = keys[i];
+        if (values) {
+            out_values[pos] = values[i];
+        }
+    }
+}
+
+// Per-thread buffers, reused across joins
+struct Scratch {
+    std::vector<uint16_t> parts;
+    std::vector<size_t> cursor;
+    std::vector<uint64_t> build_keys;
+    std::vector<uint64_t> probe_keys;
+    std::vector<double> build_values;
+    std::vector<double> probe_values;
+    std::vector<size_t> build_offsets;
+    std::vector<size_t> probe_offsets;
+    Table table;
+};
+
+// Key buckets of both inputs, joined by whichever thread claims them
+struct BucketJoin {
+    std::vector<std::vector<uint64_t>> s_keys;
+    std::vector<std::vector<uint64_t>> r_keys;
+    std::vector<std::vector<double>> r_values;
+    std::vector<JoinAggregate> results;
+    bool sum = false;
+    StopCheck should_stop;
+
+    std::atomic<size_t> next{0};
+    std::mutex mutex;
+    std::condition_variable done_cv;
+    size_t done = 0;
+    std::exception_ptr error;
+
+    // Joins unclaimed buckets until none is left
+    void run() {
+        for (size_t b = next.fetch_add(1); b < results.size(); b = next.fetch_add(1)) {
+            std::exception_ptr failure;
+            try {
+                results[b] = hash_join(s_keys[b].data(), s_keys[b].size(),
+                                       r_keys[b].data(), sum ? r_values[b].data() : nullptr,
+                                       r_keys[b].size(), should_stop);
+            } catch (...) {
+                failure = std::current_exception();
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            if (failure && !error) {
+                error = failure;
+            }
+            if (++done == results.size()) {
+                done_cv.notify_all();
+            }
+        }
+    }
+};
+
+// Top bits of a 64-bit remix: small keys leave the high hash bits zero,
+// and the partition bits must stay uniform within a bucket
+inline size_t bucket_of(uint64_t key, size_t ways) {
+    uint64_t mixed = (hash_key(key) >> kHashShift) * kBucketMul;
+    return static_cast<size_t>(((mixed >> 32) * ways) >> 32);
+}
+
+} // namespace
+
+JoinAggregate hash_join(const uint64_t* s_keys, size_t s_count,
+                        const uint64_t* r_keys, const double* r_values, size_t r_count,
+                        const StopCheck& should_stop) {
+    JoinAggregate result;
+    if (s_count == 0 || r_count == 0) {
+        return result;
+    }
+
+    // Build on the smaller side. The R value of a pair then comes from the
+    // probe tuple (S built: weight = S count) or the table (R built:
+    // weight = sum of the key's R values)
+    const bool sum = r_values != nullptr;
+    const bool build_s = s_count <= r_count;
+    const uint64_t* build_keys = build_s ? s_keys : r_keys;
+    const double* build_values = build_s ? nullptr : r_values;
+    const size_t build_count = build_s ? s_count : r_count;
+    const uint64_t* probe_keys = build_s ? r_keys : s_keys;
+    const double* probe_values = build_s ? r_values : nullptr;
+    const size_t probe_count = build_s ? r_count : s_count;
+
+    int bits = 0;
+    while (bits < kMaxPartitionBits && (build_count >> bits) > kPartitionTuples) {
+        ++bits;
+    }
+
+    thread_local Scratch scratch;
+    size_t partitions = 1;
+    if (bits > 0) {
+        scatter(build_keys, build_values, build_count, bits, scratch.parts, scratch.cursor,
+                scratch.build_offsets, scratch.build_keys, scratch.build_values);
+        scatter(probe_keys, probe_values, probe_count, bits, scratch.parts, scratch.cursor,
+                scratch.probe_offsets, scratch.probe_keys, scratch.probe_values);
+        partitions = size_t{1} << bits;
+    }
+
+    result.partitions = partitions;
+    result.partitions_joined = 0;
+    for (size_t p = 0; p < partitions; ++p) {
+        if (p > 0 && should_stop && should_stop()) {
+            break;
+        }
+        const uint64_t* bk = build_keys;
+        const double* bv = build_values;
+        size_t bn = build_count;
+        const uint64_t* pk = probe_keys;
+        const double* pv = probe_values;
+        size_t pn = probe_count;
+        if (bits > 0) {
+            size_t b0 = scratch.build_offsets[p];
+            bn = scratch.build_offsets[p + 1] - b0;
+            bk = scratch.build_keys.data() + b0;
+            bv = build_values ? scratch.build_values.data() + b0 : nullptr;
+            size_t p0 = scratch.probe_offsets[p];
+            pn = scratch.probe_offsets[p + 1] - p0;
+            pk = scratch.probe_keys.data() + p0;
+            pv = probe_values ? scratch.probe_values.data() + p0 : nullptr;
+        }
+        result.partitions_joined++;
+        if (bn == 0 || pn == 0) {
+            continue;
+        }
+
+        scratch.table.reset(bn, kHashShift + bits, sum);
+        scratch.table.build(bk, bv, bn, sum);
+        if (!sum) {
+            probe<false, false>(scratch.table, pk, nullptr, pn, result.pairs, result.sum);
+        } else if (pv) {
+            probe<true, true>(scratch.table, pk, pv, pn, result.pairs, result.sum);
+        } else {
+            probe<true, false>(scratch.table, pk, nullptr, pn, result.pairs, result.sum);
+        }
+    }
+    return result;
+}
+
+std::vector<JoinAggregate> parallel_hash_join(const uint64_t* s_keys, size_t s_count,
+                                              const uint64_t* r_keys, const double* r_values,
+                                              size_t r_count, size_t ways,
+                                              const TaskSubmit& submit,
+                                              const StopCheck& should_stop) {
+    ways = std::max<size_t>(1, ways);
+    if (ways == 1 || s_count == 0 || r_count == 0) {
+        return {hash_join(s_keys, s_count, r_keys, r_values, r_count, should_stop)};
+    }
+
+    // Shared with the tasks, which may start after the last bucket is done
+    auto join = std::make_shared<BucketJoin>();
+    join->sum = r_values != nullptr;
+    join->should_stop = should_stop;
+    join->s_keys.resize(ways);
+    join->r_keys.resize(ways);
+    join->r_values.resize(ways);
+    join->results.resize(ways);
+    for (size_t i = 0; i < s_count; ++i) {
+        join->s_keys[bucket_of(s_keys[i], ways)].push_back(s_keys[i]);
+    }
+    for (size_t i = 0; i < r_count; ++i) {
+        size_t b = bucket_of(r_keys[i], ways);
+        join->r_keys[b].push_back(r_keys[i]);
+        if (join->sum) {
+            join->r_values[b].push_back(r_values[i]);
+        }
+    }
+
+    if (submit) {
+        for (size_t t = 1; t < ways; ++t) {
+            if (!submit([join]() { join->run(); })) {
+                break;
+            }
+        }
+    }
+    join->run();
+
+    std::unique_lock<std::mutex> lock(join->mutex);
+    join->done_cv.wait(lock, [&]() { return join->done == ways; });
+    if (join->error) {
+        std::rethrow_exception(join->error);
+    }
+    return join->results;
+}
+
+} // namespace join_kernels
+} // namespace sage_tsdb
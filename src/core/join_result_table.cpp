@@ -1,42 +1,332 @@
 #include "sage_tsdb/core/join_result_table.h"
+#include "sage_tsdb/core/block_codec.h"
 #include <algorithm>
+#include <cstring>
+#include <limits>
 #include <stdexcept>
-#include <sstream>
 
 namespace sage_tsdb {
 
+namespace {
+
+// ========== 二进制记录格式 ==========
+
+constexpr uint8_t kRecordVersion = 1;
+constexpr uint8_t kPayloadVersion = 2;      // 1：fields 为字符串；2：fields 为类型化二进制
+constexpr const char* kRecordField = "record";
+
+constexpr uint8_t kFlagUsedAqp = 1 << 0;
+constexpr uint8_t kFlagHasError = 1 << 1;
+
+// 定长头，按主机字节序整体 memcpy（与 SSTable 块格式相同的假设）
+struct PackedJoinRecord {
+    uint64_t window_id;
+    int64_t timestamp;
+    uint64_t join_count;
+    double aqp_estimate;
+    double selectivity;
+    double computation_time_ms;
+    uint64_t memory_used_bytes;
+    double cpu_usage_percent;
+    int32_t threads_used;
+    uint8_t flags;
+    uint8_t version;
+    uint16_t reserved;
+};
+static_assert(sizeof(PackedJoinRecord) == 72, "PackedJoinRecord must stay fixed-width");
+
+void put_bytes(std::vector<uint8_t>& out, const void* data, size_t size) {
+    const auto* bytes = static_cast<const uint8_t*>(data);
+    out.insert(out.end(), bytes, bytes + size);
+}
+
+void put_string(std::vector<uint8_t>& out, const std::string& value) {
+    put_varint64(out, value.size());
+    put_bytes(out, value.data(), value.size());
+}
+
+bool get_string(const uint8_t*& ptr, const uint8_t* end, std::string& value) {
+    uint64_t size;
+    if (!get_varint64(ptr, end, size) || size > static_cast<uint64_t>(end - ptr)) {
+        return false;
+    }
+    value.assign(reinterpret_cast<const char*>(ptr), size);
+    ptr += size;
+    return true;
+}
+
+void put_string_map(std::vector<uint8_t>& out, const std::map<std::string, std::string>& map) {
+    put_varint64(out, map.size());
+    for (const auto& [key, value] : map) {
+        put_string(out, key);
+        put_string(out, value);
+    }
+}
+
+template <typename Map>
+bool get_string_map(const uint8_t*& ptr, const uint8_t* end, Map& map) {
+    uint64_t count;
+    if (!get_varint64(ptr, end, count)) {
+        return false;
+    }
+    for (uint64_t i = 0; i < count; ++i) {
+        std::string key, value;
+        if (!get_string(ptr, end, key) || !get_string(ptr, end, value)) {
+            return false;
+        }
+        map.emplace(std::move(key), std::move(value));
+    }
+    return true;
+}
+
+uint8_t record_flags(const JoinResultTable::JoinRecord& record) {
+    uint8_t flags = 0;
+    if (record.metrics.used_aqp) flags |= kFlagUsedAqp;
+    if (record.hasError()) flags |= kFlagHasError;
+    return flags;
+}
+
+std::string encode_record(const JoinResultTable::JoinRecord& record) {
+    PackedJoinRecord packed{};
+    packed.window_id = record.window_id;
+    packed.timestamp = record.timestamp;
+    packed.join_count = record.join_count;
+    packed.aqp_estimate = record.aqp_estimate;
+    packed.selectivity = record.selectivity;
+    packed.computation_time_ms = record.metrics.computation_time_ms;
+    packed.memory_used_bytes = record.metrics.memory_used_bytes;
+    packed.cpu_usage_percent = record.metrics.cpu_usage_percent;
+    packed.threads_used = record.metrics.threads_used;
+    packed.flags = record_flags(record);
+    packed.version = kRecordVersion;
+
+    std::vector<uint8_t> out;
+    out.reserve(sizeof(packed) + record.metrics.algorithm_type.size() +
+                record.error_message.size() + record.payload.size() + 8);
+    put_bytes(out, &packed, sizeof(packed));
+    put_string(out, record.metrics.algorithm_type);
+    put_string(out, record.error_message);
+    put_varint64(out, record.payload.size());
+    put_bytes(out, record.payload.data(), record.payload.size());
+    return std::string(out.begin(), out.end());
+}
+
+bool decode_record(const std::string& encoded, JoinResultTable::JoinRecord& record) {
+    if (encoded.size() < sizeof(PackedJoinRecord)) {
+        return false;
+    }
+    PackedJoinRecord packed;
+    std::memcpy(&packed, encoded.data(), sizeof(packed));
+    if (packed.version != kRecordVersion) {
+        return false;
+    }
+    record.window_id = packed.window_id;
+    record.timestamp = packed.timestamp;
+    record.join_count = packed.join_count;
+    record.aqp_estimate = packed.aqp_estimate;
+    record.selectivity = packed.selectivity;
+    record.metrics.computation_time_ms = packed.computation_time_ms;
+    record.metrics.memory_used_bytes = packed.memory_used_bytes;
+    record.metrics.cpu_usage_percent = packed.cpu_usage_percent;
+    record.metrics.threads_used = packed.threads_used;
+    record.metrics.used_aqp = (packed.flags & kFlagUsedAqp) != 0;
+
+    const auto* ptr = reinterpret_cast<const uint8_t*>(encoded.data()) + sizeof(packed);
+    const auto* end = reinterpret_cast<const uint8_t*>(encoded.data()) + encoded.size();
+    std::string payload;
+    if (!get_string(ptr, end, record.metrics.algorithm_type) ||
+        !get_string(ptr, end, record.error_message) ||
+        !get_string(ptr, end, payload)) {
+        return false;
+    }
+    record.payload.assign(payload.begin(), payload.end());
+    return true;
+}
+
+// 早期版本把指标写成字符串 fields，读取旧数据时回退到这里
+void decode_legacy_fields(const Fields& fields, JoinResultTable::JoinRecord& record) {
+    if (fields.count("join_count")) {
+        record.join_count = fields.at("join_count").as_uint64();
+    }
+    if (fields.count("aqp_estimate")) {
+        record.aqp_estimate = fields.at("aqp_estimate").as_double();
+    }
+    if (fields.count("selectivity")) {
+        record.selectivity = fields.at("selectivity").as_double();
+    }
+    if (fields.count("computation_time_ms")) {
+        record.metrics.computation_time_ms = fields.at("computation_time_ms").as_double();
+    }
+    if (fields.count("memory_used_bytes")) {
+        record.metrics.memory_used_bytes = fields.at("memory_used_bytes").as_uint64();
+    }
+    if (fields.count("threads_used")) {
+        record.metrics.threads_used = static_cast<int>(fields.at("threads_used").as_int64());
+    }
+    if (fields.count("cpu_usage_percent")) {
+        record.metrics.cpu_usage_percent = fields.at("cpu_usage_percent").as_double();
+    }
+    if (fields.count("used_aqp")) {
+        record.metrics.used_aqp = fields.at("used_aqp").as_bool();
+    }
+    if (fields.count("error")) {
+        record.error_message = fields.at("error").to_string();
+    }
+}
+
+// ========== payload 编解码 ==========
+
+class PayloadWriter {
+public:
+    explicit PayloadWriter(std::vector<uint8_t>& out) : out_(out) {}
+
+    void put(const TimeSeriesData& point) {
+        put_varint64(out_, zigzag_encode(static_cast<int64_t>(
+            static_cast<uint64_t>(point.timestamp) - static_cast<uint64_t>(prev_timestamp_))));
+        prev_timestamp_ = point.timestamp;
+
+        if (point.is_scalar()) {
+            put_varint64(out_, 0);
+            double value = std::get<double>(point.value);
+            put_bytes(out_, &value, sizeof(value));
+        } else {
+            const auto& values = std::get<std::vector<double>>(point.value);
+            put_varint64(out_, values.size() + 1);
+            put_bytes(out_, values.data(), values.size() * sizeof(double));
+        }
+
+        // 同一窗口的 Join 对通常只有少数几种标签集，重复出现时只写编号
+        auto [it, inserted] = tag_sets_.try_emplace(point.tags, tag_sets_.size());
+        put_varint64(out_, it->second);
+        if (inserted) {
+            put_string_map(out_, point.tags);
+        }
+        put_varint64(out_, point.fields.size());
+        for (const auto& [key, value] : point.fields) {
+            put_string(out_, key);
+            value.serialize(out_);
+        }
+    }
+
+private:
+    std::vector<uint8_t>& out_;
+    int64_t prev_timestamp_ = 0;
+    std::map<Tags, uint64_t> tag_sets_;
+};
+
+class PayloadReader {
+public:
+    PayloadReader(const uint8_t* ptr, const uint8_t* end, uint8_t version)
+        : ptr_(ptr), end_(end), typed_fields_(version >= 2) {}
+
+    bool get(TimeSeriesData& point) {
+        uint64_t delta, kind, tag_set;
+        if (!get_varint64(ptr_, end_, delta) || !get_varint64(ptr_, end_, kind)) {
+            return false;
+        }
+        prev_timestamp_ = static_cast<int64_t>(
+            static_cast<uint64_t>(prev_timestamp_) + static_cast<uint64_t>(zigzag_decode(delta)));
+        point.timestamp = prev_timestamp_;
+
+        uint64_t doubles = kind == 0 ? 1 : kind - 1;
+        if (doubles > static_cast<uint64_t>(end_ - ptr_) / sizeof(double)) {
+            return false;
+        }
+        if (kind == 0) {
+            double value;
+            std::memcpy(&value, ptr_, sizeof(value));
+            point.value = value;
+        } else {
+            std::vector<double> values(doubles);
+            std::memcpy(values.data(), ptr_, doubles * sizeof(double));
+            point.value = std::move(values);
+        }
+        ptr_ += doubles * sizeof(double);
+
+        if (!get_varint64(ptr_, end_, tag_set) || tag_set > tag_sets_.size()) {
+            return false;
+        }
+        if (tag_set == tag_sets_.size()) {
+            Tags tags;
+            if (!get_string_map(ptr_, end_, tags)) {
+                return false;
+            }
+            tag_sets_.push_back(std::move(tags));
+        }
+        point.tags = tag_sets_[tag_set];
+        return typed_fields_ ? get_fields(point.fields) : get_string_map(ptr_, end_, point.fields);
+    }
+
+private:
+    bool get_fields(Fields& fields) {
+        uint64_t count;
+        if (!get_varint64(ptr_, end_, count)) {
+            return false;
+        }
+        for (uint64_t i = 0; i < count; ++i) {
+            std::string key;
+            FieldValue value;
+            if (!get_string(ptr_, end_, key) || !value.deserialize(ptr_, end_)) {
+                return false;
+            }
+            fields.emplace(std::move(key), std::move(value));
+        }
+        return true;
+    }
+
+    const uint8_t* ptr_;
+    const uint8_t* end_;
+    bool typed_fields_;
+    int64_t prev_timestamp_ = 0;
+    std::vector<Tags> tag_sets_;
+};
+
+} // namespace
+
 // ========== JoinRecord 序列化方法 ==========
 
 std::vector<std::pair<TimeSeriesData, TimeSeriesData>> 
 JoinResultTable::JoinRecord::deserializePayload() const {
-    // TODO: 实现反序列化逻辑
-    // 这里需要根据 payload 格式解析 Join 对
     std::vector<std::pair<TimeSeriesData, TimeSeriesData>> result;
-    
-    // 简单实现：假设 payload 为空表示无详细结果
     if (payload.empty()) {
         return result;
     }
     
-    // 实际实现需要使用序列化库（如 protobuf, msgpack）
-    // 这里仅作占位
-    
+    const uint8_t* ptr = payload.data();
+    const uint8_t* end = payload.data() + payload.size();
+    uint64_t count;
+    uint8_t version = *ptr++;
+    if (version < 1 || version > kPayloadVersion || !get_varint64(ptr, end, count)) {
+        throw std::runtime_error("Corrupt join payload header");
+    }
+    // 每个点至少 12 字节，防止损坏的计数导致超大分配
+    result.reserve(std::min<uint64_t>(count, payload.size() / 24));
+    
+    PayloadReader reader(ptr, end, version);
+    for (uint64_t i = 0; i < count; ++i) {
+        std::pair<TimeSeriesData, TimeSeriesData> pair;
+        if (!reader.get(pair.first) || !reader.get(pair.second)) {
+            throw std::runtime_error("Corrupt join payload at pair " + std::to_string(i));
+        }
+        result.push_back(std::move(pair));
+    }
     return result;
 }
 
 void JoinResultTable::JoinRecord::serializePayload(
     const std::vector<std::pair<TimeSeriesData, TimeSeriesData>>& join_pairs) {
-    // TODO: 实现序列化逻辑
-    // 将 Join 对序列化为字节流
-    
-    // 简单实现：如果为空则不存储
+    payload.clear();
     if (join_pairs.empty()) {
-        payload.clear();
         return;
     }
     
-    // 实际实现需要使用序列化库
-    // 这里仅作占位
+    payload.push_back(kPayloadVersion);
+    put_varint64(payload, join_pairs.size());
+    PayloadWriter writer(payload);
+    for (const auto& [left, right] : join_pairs) {
+        writer.put(left);
+        writer.put(right);
+    }
 }
 
 // ========== JoinResultTable 实现 ==========
@@ -47,17 +337,13 @@ JoinResultTable::JoinResultTable(const std::string& name, const TableConfig& con
     // 使用 StreamTable 作为底层存储
     storage_ = std::make_unique<StreamTable>(name + "_storage", config);
     
-    // 初始化统计信息
     stats_.name = name_;
-    stats_.total_records = 0;
-    stats_.total_joins = 0;
-    stats_.avg_join_per_window = 0.0;
-    stats_.avg_computation_time_ms = 0.0;
-    stats_.min_timestamp = std::numeric_limits<int64_t>::max();
-    stats_.max_timestamp = std::numeric_limits<int64_t>::min();
-    stats_.payload_size_bytes = 0;
-    stats_.aqp_usage_count = 0;
-    stats_.error_count = 0;
+    
+    // 持久化的表重新打开时，从存储重建指标列
+    if (!config_.data_dir.empty()) {
+        loadColumns();
+    }
+    updateStats();
 }
 
 JoinResultTable::~JoinResultTable() {
@@ -70,49 +356,32 @@ JoinResultTable::~JoinResultTable() {
 size_t JoinResultTable::insertJoinResult(const JoinRecord& record) {
     std::unique_lock<std::shared_mutex> lock(mutex_);
     
-    // 将 JoinRecord 转换为 TimeSeriesData
+    // 将 JoinRecord 编码为一行
     TimeSeriesData data = recordToTimeSeriesData(record);
     
     // 插入到底层存储
     size_t index = storage_->insert(data);
     
-    // 更新窗口索引
-    window_index_[record.window_id].push_back(index);
-    
-    // 更新统计信息
-    stats_.total_records++;
-    stats_.total_joins += record.join_count;
-    stats_.min_timestamp = std::min(stats_.min_timestamp, record.timestamp);
-    stats_.max_timestamp = std::max(stats_.max_timestamp, record.timestamp);
-    stats_.payload_size_bytes += record.payload.size();
-    
-    if (record.metrics.used_aqp) {
-        stats_.aqp_usage_count++;
-    }
-    
-    if (record.hasError()) {
-        stats_.error_count++;
-    }
-    
-    // 更新平均值
-    if (stats_.total_records > 0) {
-        stats_.avg_join_per_window = 
-            static_cast<double>(stats_.total_joins) / stats_.total_records;
-        stats_.avg_computation_time_ms = 
-            (stats_.avg_computation_time_ms * (stats_.total_records - 1) + 
-             record.metrics.computation_time_ms) / stats_.total_records;
-    }
+    // 更新指标列与窗口索引
+    appendColumns(record, data.series_id());
     
     return index;
 }
 
 std::vector<size_t> JoinResultTable::insertJoinResultBatch(
     const std::vector<JoinRecord>& records) {
-    std::vector<size_t> indices;
-    indices.reserve(records.size());
+    std::unique_lock<std::shared_mutex> lock(mutex_);
     
+    std::vector<TimeSeriesData> rows;
+    rows.reserve(records.size());
     for (const auto& record : records) {
-        indices.push_back(insertJoinResult(record));
+        rows.push_back(recordToTimeSeriesData(record));
+    }
+    
+    auto indices = storage_->insertBatch(rows);
+    
+    for (size_t i = 0; i < records.size(); ++i) {
+        appendColumns(records[i], rows[i].series_id());
     }
     
     return indices;
@@ -145,20 +414,20 @@ JoinResultTable::queryByWindow(uint64_t window_id) const {
         return results; // 窗口不存在
     }
     
-    // 通过索引查询数据
-    for (size_t idx : it->second) {
-        // 这里需要实现通过索引查询单条记录的方法
-        // 暂时使用查询所有数据然后过滤的方式
-        // TODO: 优化为直接索引访问
+    // 由列得到该窗口的时间戳，逐个做单点查询，不扫描整个时间范围
+    std::vector<int64_t> timestamps;
+    timestamps.reserve(it->second.size());
+    for (size_t row : it->second) {
+        timestamps.push_back(columns_.timestamp[row]);
     }
+    std::sort(timestamps.begin(), timestamps.end());
+    timestamps.erase(std::unique(timestamps.begin(), timestamps.end()), timestamps.end());
     
-    // 临时实现：查询所有数据并过滤
     Tags filter_tags = {{"window_id", std::to_string(window_id)}};
-    TimeRange full_range(0, std::numeric_limits<int64_t>::max());
-    auto data_list = storage_->query(full_range, filter_tags);
-    
-    for (const auto& data : data_list) {
-        results.push_back(timeSeriesDataToRecord(data));
+    for (int64_t timestamp : timestamps) {
+        for (const auto& data : storage_->query(TimeRange(timestamp, timestamp), filter_tags)) {
+            results.push_back(timeSeriesDataToRecord(data));
+        }
     }
     
     return results;
@@ -217,10 +486,8 @@ JoinResultTable::AggregateStats
 JoinResultTable::queryAggregateStats(const TimeRange& range) const {
     std::shared_lock<std::shared_mutex> lock(mutex_);
     
-    auto records = queryByTimeRange(range);
-    
     AggregateStats agg_stats;
-    agg_stats.total_windows = records.size();
+    agg_stats.total_windows = 0;
     agg_stats.total_joins = 0;
     agg_stats.avg_join_count = 0.0;
     agg_stats.avg_computation_time_ms = 0.0;
@@ -228,31 +495,31 @@ JoinResultTable::queryAggregateStats(const TimeRange& range) const {
     agg_stats.aqp_usage_count = 0;
     agg_stats.error_count = 0;
     
-    if (records.empty()) {
-        return agg_stats;
-    }
-    
+    // 只扫描指标列，不读取也不解码记录
     double total_computation_time = 0.0;
     double total_selectivity = 0.0;
-    
-    for (const auto& record : records) {
-        agg_stats.total_joins += record.join_count;
-        total_computation_time += record.metrics.computation_time_ms;
-        total_selectivity += record.selectivity;
-        
-        if (record.metrics.used_aqp) {
-            agg_stats.aqp_usage_count++;
-        }
-        
-        if (record.hasError()) {
-            agg_stats.error_count++;
+    const size_t rows = columns_.size();
+    for (size_t row = 0; row < rows; ++row) {
+        int64_t timestamp = columns_.timestamp[row];
+        if (timestamp < range.start_time || timestamp > range.end_time) {
+            continue;
         }
+        agg_stats.total_windows++;
+        agg_stats.total_joins += columns_.join_count[row];
+        total_computation_time += columns_.computation_time_ms[row];
+        total_selectivity += columns_.selectivity[row];
+        agg_stats.aqp_usage_count += (columns_.flags[row] & kFlagUsedAqp) != 0;
+        agg_stats.error_count += (columns_.flags[row] & kFlagHasError) != 0;
+    }
+    
+    if (agg_stats.total_windows == 0) {
+        return agg_stats;
     }
     
     agg_stats.avg_join_count = 
-        static_cast<double>(agg_stats.total_joins) / records.size();
-    agg_stats.avg_computation_time_ms = total_computation_time / records.size();
-    agg_stats.avg_selectivity = total_selectivity / records.size();
+        static_cast<double>(agg_stats.total_joins) / agg_stats.total_windows;
+    agg_stats.avg_computation_time_ms = total_computation_time / agg_stats.total_windows;
+    agg_stats.avg_selectivity = total_selectivity / agg_stats.total_windows;
     
     return agg_stats;
 }
@@ -269,44 +536,68 @@ bool JoinResultTable::createTagIndex(const std::string& tag_name) {
 size_t JoinResultTable::deleteOldResults(int64_t before_timestamp) {
     std::unique_lock<std::shared_mutex> lock(mutex_);
     
-    // TODO: 实现删除逻辑
-    // 需要扩展 StreamTable 支持删除操作
+    // 按整个 SSTable 文件删除，代价 O(文件数)
+    storage_->dropBefore(before_timestamp);
+    
+    // 压缩指标列，去掉已删除的行
+    const size_t rows = columns_.size();
+    size_t kept = 0;
+    for (size_t row = 0; row < rows; ++row) {
+        if (columns_.timestamp[row] < before_timestamp) {
+            continue;
+        }
+        if (kept != row) {
+            columns_.window_id[kept] = columns_.window_id[row];
+            columns_.timestamp[kept] = columns_.timestamp[row];
+            columns_.series[kept] = columns_.series[row];
+            columns_.join_count[kept] = columns_.join_count[row];
+            columns_.selectivity[kept] = columns_.selectivity[row];
+            columns_.computation_time_ms[kept] = columns_.computation_time_ms[row];
+            columns_.flags[kept] = columns_.flags[row];
+            columns_.payload_bytes[kept] = columns_.payload_bytes[row];
+        }
+        kept++;
+    }
+    if (kept == rows) {
+        return 0;
+    }
     
-    return 0;
+    columns_.window_id.resize(kept);
+    columns_.timestamp.resize(kept);
+    columns_.series.resize(kept);
+    columns_.join_count.resize(kept);
+    columns_.selectivity.resize(kept);
+    columns_.computation_time_ms.resize(kept);
+    columns_.flags.resize(kept);
+    columns_.payload_bytes.resize(kept);
+    rebuildWindowIndex();
+    
+    return rows - kept;
 }
 
 void JoinResultTable::clear() {
     std::unique_lock<std::shared_mutex> lock(mutex_);
     
     storage_->clear();
+    columns_ = Columns{};
     window_index_.clear();
-    
-    // 重置统计信息
-    stats_.total_records = 0;
-    stats_.total_joins = 0;
-    stats_.avg_join_per_window = 0.0;
-    stats_.avg_computation_time_ms = 0.0;
-    stats_.min_timestamp = std::numeric_limits<int64_t>::max();
-    stats_.max_timestamp = std::numeric_limits<int64_t>::min();
-    stats_.payload_size_bytes = 0;
-    stats_.aqp_usage_count = 0;
-    stats_.error_count = 0;
 }
 
 JoinResultTable::Stats JoinResultTable::getStats() const {
-    std::shared_lock<std::shared_mutex> lock(mutex_);
+    // updateStats 写 stats_，独占加锁
+    std::unique_lock<std::shared_mutex> lock(mutex_);
     updateStats();
     return stats_;
 }
 
 size_t JoinResultTable::size() const {
     std::shared_lock<std::shared_mutex> lock(mutex_);
-    return stats_.total_records;
+    return columns_.size();
 }
 
 bool JoinResultTable::empty() const {
     std::shared_lock<std::shared_mutex> lock(mutex_);
-    return stats_.total_records == 0;
+    return columns_.size() == 0;
 }
 
 // ========== 内部辅助方法 ==========
@@ -316,30 +607,17 @@ TimeSeriesData JoinResultTable::recordToTimeSeriesData(const JoinRecord& record)
     data.timestamp = record.timestamp;
     data.value = static_cast<double>(record.join_count);
     
-    // 将 JoinRecord 字段编码到 tags 和 fields
+    // window_id 与 algorithm 保留为标签，用于按窗口/标签过滤
     data.tags["window_id"] = std::to_string(record.window_id);
     data.tags["algorithm"] = record.metrics.algorithm_type;
     
-    data.fields["join_count"] = std::to_string(record.join_count);
-    data.fields["aqp_estimate"] = std::to_string(record.aqp_estimate);
-    data.fields["selectivity"] = std::to_string(record.selectivity);
-    data.fields["computation_time_ms"] = std::to_string(record.metrics.computation_time_ms);
-    data.fields["memory_used_bytes"] = std::to_string(record.metrics.memory_used_bytes);
-    data.fields["threads_used"] = std::to_string(record.metrics.threads_used);
-    data.fields["cpu_usage_percent"] = std::to_string(record.metrics.cpu_usage_percent);
-    data.fields["used_aqp"] = record.metrics.used_aqp ? "true" : "false";
-    
-    if (!record.error_message.empty()) {
-        data.fields["error"] = record.error_message;
-    }
-    
     // 合并用户自定义标签
     for (const auto& [k, v] : record.tags) {
         data.tags[k] = v;
     }
     
-    // Payload 存储（需要特殊处理）
-    // TODO: 考虑使用专门的 Blob 存储
+    // 指标、错误信息与 payload 编码为一个二进制字段
+    data.fields[kRecordField] = encode_record(record);
     
     return data;
 }
@@ -348,7 +626,6 @@ JoinResultTable::JoinRecord
 JoinResultTable::timeSeriesDataToRecord(const TimeSeriesData& data) const {
     JoinRecord record;
     
-    // 从 tags 和 fields 解码
     if (data.tags.count("window_id")) {
         record.window_id = std::stoull(data.tags.at("window_id"));
     }
@@ -359,54 +636,96 @@ JoinResultTable::timeSeriesDataToRecord(const TimeSeriesData& data) const {
     
     record.timestamp = data.timestamp;
     
-    if (data.fields.count("join_count")) {
-        record.join_count = std::stoull(data.fields.at("join_count"));
-    }
-    
-    if (data.fields.count("aqp_estimate")) {
-        record.aqp_estimate = std::stod(data.fields.at("aqp_estimate"));
-    }
-    
-    if (data.fields.count("selectivity")) {
-        record.selectivity = std::stod(data.fields.at("selectivity"));
+    auto encoded = data.fields.find(kRecordField);
+    const std::string* bytes = encoded != data.fields.end() ? encoded->second.if_string() : nullptr;
+    if (!bytes || !decode_record(*bytes, record)) {
+        decode_legacy_fields(data.fields, record);
     }
     
-    if (data.fields.count("computation_time_ms")) {
-        record.metrics.computation_time_ms = std::stod(data.fields.at("computation_time_ms"));
+    // 恢复用户自定义标签
+    for (const auto& [k, v] : data.tags) {
+        if (k != "window_id" && k != "algorithm") {
+            record.tags[k] = v;
+        }
     }
     
-    if (data.fields.count("memory_used_bytes")) {
-        record.metrics.memory_used_bytes = std::stoull(data.fields.at("memory_used_bytes"));
+    return record;
+}
+
+void JoinResultTable::appendColumns(const JoinRecord& record, uint64_t series) {
+    auto& rows = window_index_[record.window_id];
+    
+    size_t row = columns_.size();
+    for (size_t existing : rows) {
+        if (columns_.timestamp[existing] == record.timestamp &&
+            columns_.series[existing] == series) {
+            row = existing;
+            break;
+        }
     }
     
-    if (data.fields.count("threads_used")) {
-        record.metrics.threads_used = std::stoi(data.fields.at("threads_used"));
+    if (row == columns_.size()) {
+        rows.push_back(row);
+        columns_.window_id.push_back(record.window_id);
+        columns_.timestamp.push_back(record.timestamp);
+        columns_.series.push_back(series);
+        columns_.join_count.emplace_back();
+        columns_.selectivity.emplace_back();
+        columns_.computation_time_ms.emplace_back();
+        columns_.flags.emplace_back();
+        columns_.payload_bytes.emplace_back();
     }
     
-    if (data.fields.count("cpu_usage_percent")) {
-        record.metrics.cpu_usage_percent = std::stod(data.fields.at("cpu_usage_percent"));
+    columns_.join_count[row] = record.join_count;
+    columns_.selectivity[row] = record.selectivity;
+    columns_.computation_time_ms[row] = record.metrics.computation_time_ms;
+    columns_.flags[row] = record_flags(record);
+    columns_.payload_bytes[row] = static_cast<uint32_t>(record.payload.size());
+}
+
+void JoinResultTable::rebuildWindowIndex() {
+    window_index_.clear();
+    for (size_t row = 0; row < columns_.size(); ++row) {
+        window_index_[columns_.window_id[row]].push_back(row);
     }
-    
-    if (data.fields.count("used_aqp")) {
-        record.metrics.used_aqp = (data.fields.at("used_aqp") == "true");
+}
+
+void JoinResultTable::loadColumns() {
+    TimeRange full_range(std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::max());
+    for (const auto& data : storage_->query(full_range)) {
+        appendColumns(timeSeriesDataToRecord(data), data.series_id());
     }
+}
+
+void JoinResultTable::updateStats() const {
+    // 由指标列计算，调用者持有 mutex_
+    stats_.total_records = columns_.size();
+    stats_.total_joins = 0;
+    stats_.min_timestamp = std::numeric_limits<int64_t>::max();
+    stats_.max_timestamp = std::numeric_limits<int64_t>::min();
+    stats_.payload_size_bytes = 0;
+    stats_.aqp_usage_count = 0;
+    stats_.error_count = 0;
     
-    if (data.fields.count("error")) {
-        record.error_message = data.fields.at("error");
+    double total_computation_time = 0.0;
+    for (size_t row = 0; row < columns_.size(); ++row) {
+        stats_.total_joins += columns_.join_count[row];
+        stats_.min_timestamp = std::min(stats_.min_timestamp, columns_.timestamp[row]);
+        stats_.max_timestamp = std::max(stats_.max_timestamp, columns_.timestamp[row]);
+        stats_.payload_size_bytes += columns_.payload_bytes[row];
+        stats_.aqp_usage_count += (columns_.flags[row] & kFlagUsedAqp) != 0;
+        stats_.error_count += (columns_.flags[row] & kFlagHasError) != 0;
+        total_computation_time += columns_.computation_time_ms[row];
     }
     
-    // 恢复用户自定义标签
-    for (const auto& [k, v] : data.tags) {
-        if (k != "window_id" && k != "algorithm") {
-            record.tags[k] = v;
-        }
+    if (stats_.total_records > 0) {
+        stats_.avg_join_per_window = 
+            static_cast<double>(stats_.total_joins) / stats_.total_records;
+        stats_.avg_computation_time_ms = total_computation_time / stats_.total_records;
+    } else {
+        stats_.avg_join_per_window = 0.0;
+        stats_.avg_computation_time_ms = 0.0;
     }
-    
-    return record;
-}
-
-void JoinResultTable::updateStats() const {
-    // 统计信息在插入时已更新，这里无需额外操作
 }
 
 } // namespace sage_tsdb
@@ -0,0 +1,128 @@
+#include "sage_tsdb/core/last_value_cache.h"
+#include <algorithm>
+#include <map>
+
+namespace sage_tsdb {
+
+namespace {
+
+bool matches(const Tags& tags, const Tags& filter_tags) {
+    for (const auto& [key, value] : filter_tags) {
+        auto it = tags.find(key);
+        if (it == tags.end() || it->second != value) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+LastValueCache::LastValueCache(size_t capacity, size_t per_series, bool warm)
+    : capacity_(capacity), per_series_(per_series), warm_(warm) {}
+
+void LastValueCache::insert(Ring& ring, const TimeSeriesData& point, size_t limit) {
+    if (limit == 0) {
+        return;
+    }
+    if (ring.empty() || point.timestamp > ring.back().timestamp) {
+        ring.push_back(point);
+    } else {
+        if (ring.size() >= limit && point.timestamp < ring.front().timestamp) {
+            return;  // Older than everything kept
+        }
+        // Replace a kept version of the same point, otherwise insert after
+        // the points with the same timestamp
+        auto it = std::lower_bound(ring.begin(), ring.end(), point.timestamp,
+            [](const TimeSeriesData& kept, int64_t ts) { return kept.timestamp < ts; });
+        for (; it != ring.end() && it->timestamp == point.timestamp; ++it) {
+            if (it->tags == point.tags) {
+                *it = point;
+                return;
+            }
+        }
+        ring.insert(it, point);
+    }
+    if (ring.size() > limit) {
+        ring.pop_front();
+    }
+}
+
+void LastValueCache::add(const TimeSeriesData& point) {
+    add(&point, 1);
+}
+
+void LastValueCache::add(const TimeSeriesData* points, size_t count) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i = 0; i < count; ++i) {
+        const TimeSeriesData& point = points[i];
+        insert(latest_, point, capacity_);
+        if (per_series_ > 0) {
+            auto [it, inserted] = series_.try_emplace(point.series_id());
+            if (inserted) {
+                it->second.tags = point.tags;
+            }
+            insert(it->second.points, point, per_series_);
+        }
+    }
+}
+
+std::vector<TimeSeriesData> LastValueCache::latest(size_t n, int64_t from) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<TimeSeriesData> results;
+    results.reserve(std::min(n, latest_.size()));
+    for (auto it = latest_.rbegin(); it != latest_.rend() && results.size() < n; ++it) {
+        if (it->timestamp < from) {
+            break;
+        }
+        results.push_back(*it);
+    }
+    return results;
+}
+
+std::vector<TimeSeriesData> LastValueCache::latest_per_series(size_t n, const Tags& filter_tags,
+                                                              int64_t from) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::map<Tags, const Ring*> ordered;
+    for (const auto& [id, series] : series_) {
+        if (matches(series.tags, filter_tags)) {
+            ordered.emplace(series.tags, &series.points);
+        }
+    }
+
+    std::vector<TimeSeriesData> results;
+    for (const auto& [tags, ring] : ordered) {
+        size_t taken = 0;
+        for (auto it = ring->rbegin(); it != ring->rend() && taken < n; ++it, ++taken) {
+            if (it->timestamp < from) {
+                break;
+            }
+            results.push_back(*it);
+        }
+    }
+    return results;
+}
+
+bool LastValueCache::is_warm() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return warm_;
+}
+
+void LastValueCache::set_warm() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    warm_ = true;
+}
+
+void LastValueCache::clear(bool warm) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    latest_.clear();
+    series_.clear();
+    warm_ = warm;
+}
+
+size_t LastValueCache::series_count() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return series_.size();
+}
+
+} // namespace sage_tsdb
@@ -0,0 +1,141 @@
+#include "sage_tsdb/core/latency_histogram.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <limits>
+
+namespace sage_tsdb {
+
+namespace {
+
+constexpr uint64_t kMaxValue = (uint64_t{1} << LatencyHistogram::kMaxValueBits) - 1;
+
+// Threads are spread over the stripes in arrival order
+size_t stripe_of_this_thread() {
+    static std::atomic<size_t> next{0};
+    thread_local size_t stripe = next.fetch_add(1, std::memory_order_relaxed) %
+                                 LatencyHistogram::kStripes;
+    return stripe;
+}
+
+void store_min(std::atomic<uint64_t>& target, uint64_t value) {
+    uint64_t current = target.load(std::memory_order_relaxed);
+    while (value < current &&
+           !target.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+void store_max(std::atomic<uint64_t>& target, uint64_t value) {
+    uint64_t current = target.load(std::memory_order_relaxed);
+    while (value > current &&
+           !target.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+}  // namespace
+
+LatencyHistogram::LatencyHistogram() {
+    reset();
+}
+
+size_t LatencyHistogram::bucket_index(uint64_t value) {
+    value = std::min(value, kMaxValue);
+    if (value < kSubBucketCount) {
+        return static_cast<size_t>(value);
+    }
+    // Keep the top kSubBucketBits bits: [half, count) sub-buckets per octave
+    int shift = std::bit_width(value) - kSubBucketBits;
+    return static_cast<size_t>(shift) * kSubBucketHalf + static_cast<size_t>(value >> shift);
+}
+
+uint64_t LatencyHistogram::bucket_lowest(size_t index) {
+    if (index < kSubBucketCount) {
+        return index;
+    }
+    size_t shift = index / kSubBucketHalf - 1;
+    uint64_t sub = index % kSubBucketHalf + kSubBucketHalf;
+    return sub << shift;
+}
+
+uint64_t LatencyHistogram::bucket_highest(size_t index) {
+    if (index < kSubBucketCount) {
+        return index;
+    }
+    size_t shift = index / kSubBucketHalf - 1;
+    return bucket_lowest(index) + (uint64_t{1} << shift) - 1;
+}
+
+void LatencyHistogram::record(uint64_t value) {
+    Stripe& stripe = stripes_[stripe_of_this_thread()];
+    store_min(stripe.min, value);
+    store_max(stripe.max, value);
+    stripe.sum.fetch_add(value, std::memory_order_relaxed);
+    stripe.counts[bucket_index(value)].fetch_add(1, std::memory_order_relaxed);
+    stripe.total.fetch_add(1, std::memory_order_relaxed);
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::snapshot() const {
+    Snapshot snap;
+    snap.counts.assign(kBucketCount, 0);
+    uint64_t sum = 0;
+    uint64_t min = std::numeric_limits<uint64_t>::max();
+    for (const Stripe& stripe : stripes_) {
+        for (size_t i = 0; i < kBucketCount; ++i) {
+            snap.counts[i] += stripe.counts[i].load(std::memory_order_relaxed);
+        }
+        sum += stripe.sum.load(std::memory_order_relaxed);
+        min = std::min(min, stripe.min.load(std::memory_order_relaxed));
+        snap.max = std::max(snap.max, stripe.max.load(std::memory_order_relaxed));
+    }
+    // Count from the buckets so percentiles agree with it under concurrent records
+    for (uint64_t c : snap.counts) {
+        snap.count += c;
+    }
+    if (snap.count > 0) {
+        snap.min = min;
+        snap.mean = static_cast<double>(sum) / static_cast<double>(snap.count);
+    }
+    return snap;
+}
+
+uint64_t LatencyHistogram::Snapshot::percentile(double q) const {
+    if (count == 0) {
+        return 0;
+    }
+    q = std::clamp(q, 0.0, 1.0);
+    uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(q * count)));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts.size(); ++i) {
+        seen += counts[i];
+        if (seen >= rank) {
+            // Report the bucket's highest value, bounded by what was observed
+            // (min/max may lag the counts while records are in flight)
+            uint64_t value = bucket_highest(i);
+            return min <= max ? std::clamp(value, min, max) : value;
+        }
+    }
+    return max;
+}
+
+uint64_t LatencyHistogram::count() const {
+    uint64_t total = 0;
+    for (const Stripe& stripe : stripes_) {
+        total += stripe.total.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+void LatencyHistogram::reset() {
+    for (Stripe& stripe : stripes_) {
+        for (auto& c : stripe.counts) {
+            c.store(0, std::memory_order_relaxed);
+        }
+        stripe.total.store(0, std::memory_order_relaxed);
+        stripe.sum.store(0, std::memory_order_relaxed);
+        stripe.min.store(std::numeric_limits<uint64_t>::max(), std::memory_order_relaxed);
+        stripe.max.store(0, std::memory_order_relaxed);
+    }
+}
+
+} // namespace sage_tsdb
@@ -1,10 +1,23 @@
 #include "sage_tsdb/core/lsm_tree.h"
+#include "sage_tsdb/core/block_codec.h"
+#include "sage_tsdb/core/block_cache.h"
+#include "sage_tsdb/core/mapped_file.h"
+#include "sage_tsdb/core/trace.h"
 #include <algorithm>
+#include <cerrno>
 #include <chrono>
+#include <cmath>
+#include <cstdio>
 #include <cstring>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <iterator>
+#include <set>
+#include <type_traits>
+#include <unordered_set>
+#include <fcntl.h>
+#include <unistd.h>
 
 namespace sage_tsdb {
 
@@ -91,497 +104,1932 @@ bool BloomFilter::deserialize(std::ifstream& in) {
     return true;
 }
 
+bool BloomFilter::deserialize(const uint8_t* data, size_t size) {
+    uint64_t num_bits;
+    uint64_t num_hash;
+    if (size < sizeof(num_bits) + sizeof(num_hash)) return false;
+    std::memcpy(&num_bits, data, sizeof(num_bits));
+    std::memcpy(&num_hash, data + sizeof(num_bits), sizeof(num_hash));
+    
+    const uint8_t* bytes = data + sizeof(num_bits) + sizeof(num_hash);
+    if ((size - sizeof(num_bits) - sizeof(num_hash)) < (num_bits + 7) / 8) return false;
+    
+    num_hash_functions_ = num_hash;
+    bits_.assign(num_bits, false);
+    for (size_t i = 0; i < num_bits; ++i) {
+        bits_[i] = (bytes[i / 8] & (1 << (i % 8))) != 0;
+    }
+    
+    return true;
+}
+
 // ============================================================================
 // WriteAheadLog Implementation
 // ============================================================================
 
-WriteAheadLog::WriteAheadLog(const std::string& log_path)
-    : log_path_(log_path) {
-    // Open log file in append mode
-    log_file_.open(log_path_, std::ios::binary | std::ios::app);
-    if (!log_file_.is_open()) {
-        std::cerr << "Failed to open WAL: " << log_path_ << std::endl;
+namespace {
+
+template<typename T>
+void append_pod(std::vector<uint8_t>& out, const T& value) {
+    const auto* bytes = reinterpret_cast<const uint8_t*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template<typename T>
+bool read_pod(const uint8_t*& ptr, const uint8_t* end, T& value) {
+    if (static_cast<size_t>(end - ptr) < sizeof(T)) {
+        return false;
+    }
+    std::memcpy(&value, ptr, sizeof(T));
+    ptr += sizeof(T);
+    return true;
+}
+
+bool read_string(const uint8_t*& ptr, const uint8_t* end, std::string& value) {
+    uint32_t len;
+    if (!read_pod(ptr, end, len) || static_cast<size_t>(end - ptr) < len) {
+        return false;
     }
+    value.assign(reinterpret_cast<const char*>(ptr), len);
+    ptr += len;
+    return true;
 }
 
-WriteAheadLog::~WriteAheadLog() {
-    if (log_file_.is_open()) {
-        log_file_.flush();
-        log_file_.close();
+void append_string_map(std::vector<uint8_t>& out, const std::map<std::string, std::string>& map) {
+    append_pod(out, static_cast<uint32_t>(map.size()));
+    for (const auto& [key, value] : map) {
+        append_pod(out, static_cast<uint32_t>(key.size()));
+        out.insert(out.end(), key.begin(), key.end());
+        append_pod(out, static_cast<uint32_t>(value.size()));
+        out.insert(out.end(), value.begin(), value.end());
     }
 }
 
-bool WriteAheadLog::append(int64_t timestamp, const TimeSeriesData& data) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    
-    if (!log_file_.is_open()) {
+// Also reads fields written as text before fields were typed
+template <typename Map>
+bool read_string_map(const uint8_t*& ptr, const uint8_t* end, Map& map) {
+    uint32_t count;
+    if (!read_pod(ptr, end, count)) {
         return false;
     }
+    for (uint32_t i = 0; i < count; ++i) {
+        std::string key, value;
+        if (!read_string(ptr, end, key) || !read_string(ptr, end, value)) {
+            return false;
+        }
+        map[key] = value;
+    }
+    return true;
+}
+
+// Set in the value type byte when the tags are replaced by a catalog id
+constexpr uint8_t kWalSeriesIdFlag = 0x80;
+// Set in the value type byte when the fields are typed (serialize_fields);
+// records without it hold text fields
+constexpr uint8_t kWalTypedFieldsFlag = 0x40;
+
+// WAL record payload; also the whole on-disk layout of the old unframed log.
+// With a catalog the tags are written as their series id; fails only if a
+// new series cannot be persisted to the catalog.
+bool encode_wal_record(int64_t timestamp, const TimeSeriesData& data, std::vector<uint8_t>& out,
+                       SeriesCatalog* catalog = nullptr) {
+    uint32_t series = SeriesCatalog::kInvalidId;
+    if (catalog) {
+        series = catalog->intern(data.tags);
+        if (series == SeriesCatalog::kInvalidId) {
+            return false;
+        }
+    }
     
-    // Write timestamp
-    log_file_.write(reinterpret_cast<const char*>(&timestamp), sizeof(timestamp));
-    
-    // Write value type (0 = scalar, 1 = vector)
-    uint8_t value_type = data.is_scalar() ? 0 : 1;
-    log_file_.write(reinterpret_cast<const char*>(&value_type), sizeof(value_type));
+    append_pod(out, timestamp);
     
-    // Write value
+    // Value type (0 = scalar, 1 = vector)
+    uint8_t value_type = (data.is_scalar() ? 0 : 1) | kWalTypedFieldsFlag;
+    if (catalog) {
+        value_type |= kWalSeriesIdFlag;
+    }
+    append_pod(out, value_type);
     if (data.is_scalar()) {
-        double val = data.as_double();
-        log_file_.write(reinterpret_cast<const char*>(&val), sizeof(val));
+        append_pod(out, data.as_double());
     } else {
-        auto vec = data.as_vector();
-        uint64_t vec_size = vec.size();
-        log_file_.write(reinterpret_cast<const char*>(&vec_size), sizeof(vec_size));
-        log_file_.write(reinterpret_cast<const char*>(vec.data()), vec_size * sizeof(double));
+        const auto& vec = std::get<std::vector<double>>(data.value);
+        append_pod(out, static_cast<uint64_t>(vec.size()));
+        const auto* bytes = reinterpret_cast<const uint8_t*>(vec.data());
+        out.insert(out.end(), bytes, bytes + vec.size() * sizeof(double));
     }
     
-    // Write tags
-    uint32_t num_tags = data.tags.size();
-    log_file_.write(reinterpret_cast<const char*>(&num_tags), sizeof(num_tags));
-    for (const auto& [key, value] : data.tags) {
-        uint32_t key_len = key.size();
-        uint32_t val_len = value.size();
-        log_file_.write(reinterpret_cast<const char*>(&key_len), sizeof(key_len));
-        log_file_.write(key.data(), key_len);
-        log_file_.write(reinterpret_cast<const char*>(&val_len), sizeof(val_len));
-        log_file_.write(value.data(), val_len);
+    if (catalog) {
+        append_pod(out, series);
+    } else {
+        append_string_map(out, data.tags);
+    }
+    serialize_fields(data.fields, out);
+    return true;
+}
+
+bool decode_wal_record(const uint8_t*& ptr, const uint8_t* end, TimeSeriesData& data,
+                       const SeriesCatalog* catalog = nullptr) {
+    uint8_t value_type;
+    if (!read_pod(ptr, end, data.timestamp) || !read_pod(ptr, end, value_type)) {
+        return false;
     }
+    bool has_series_id = (value_type & kWalSeriesIdFlag) != 0;
+    bool typed_fields = (value_type & kWalTypedFieldsFlag) != 0;
+    value_type &= ~(kWalSeriesIdFlag | kWalTypedFieldsFlag);
     
-    // Write fields
-    uint32_t num_fields = data.fields.size();
-    log_file_.write(reinterpret_cast<const char*>(&num_fields), sizeof(num_fields));
-    for (const auto& [key, value] : data.fields) {
-        uint32_t key_len = key.size();
-        uint32_t val_len = value.size();
-        log_file_.write(reinterpret_cast<const char*>(&key_len), sizeof(key_len));
-        log_file_.write(key.data(), key_len);
-        log_file_.write(reinterpret_cast<const char*>(&val_len), sizeof(val_len));
-        log_file_.write(value.data(), val_len);
+    if (value_type == 0) {
+        double val;
+        if (!read_pod(ptr, end, val)) {
+            return false;
+        }
+        data.value = val;
+    } else {
+        uint64_t vec_size;
+        if (!read_pod(ptr, end, vec_size) ||
+            static_cast<uint64_t>(end - ptr) / sizeof(double) < vec_size) {
+            return false;
+        }
+        std::vector<double> vec(vec_size);
+        std::memcpy(vec.data(), ptr, vec_size * sizeof(double));
+        ptr += vec_size * sizeof(double);
+        data.value = std::move(vec);
     }
     
-    return log_file_.good();
+    if (has_series_id) {
+        uint32_t series;
+        if (!catalog || !read_pod(ptr, end, series) || !catalog->contains(series)) {
+            return false;
+        }
+        data.tags = catalog->tags(series);
+    } else if (!read_string_map(ptr, end, data.tags)) {
+        return false;
+    }
+    return typed_fields ? deserialize_fields(ptr, end, data.fields)
+                        : read_string_map(ptr, end, data.fields);
 }
 
-std::map<int64_t, TimeSeriesData> WriteAheadLog::recover() {
-    std::map<int64_t, TimeSeriesData> result;
-    
-    std::ifstream in(log_path_, std::ios::binary);
-    if (!in.is_open()) {
-        return result;
+constexpr size_t kWalHeaderSize = 2 * sizeof(uint32_t);
+constexpr size_t kWalFrameSize = 2 * sizeof(uint32_t);
+
+void append_wal_header(std::vector<uint8_t>& out) {
+    append_pod(out, WriteAheadLog::kMagic);
+    append_pod(out, WriteAheadLog::kVersion);
+}
+
+void append_wal_frame(std::vector<uint8_t>& out, const std::vector<uint8_t>& payload) {
+    append_pod(out, static_cast<uint32_t>(payload.size()));
+    append_pod(out, crc32c(payload.data(), payload.size()));
+    out.insert(out.end(), payload.begin(), payload.end());
+}
+
+bool has_wal_header(const std::vector<uint8_t>& file) {
+    uint32_t magic = 0;
+    if (file.size() >= sizeof(magic)) {
+        std::memcpy(&magic, file.data(), sizeof(magic));
     }
-    
-    while (in.peek() != EOF) {
-        // Read timestamp
-        int64_t timestamp;
-        in.read(reinterpret_cast<char*>(&timestamp), sizeof(timestamp));
-        if (!in) break;
-        
-        TimeSeriesData data;
-        data.timestamp = timestamp;
-        
-        // Read value type
-        uint8_t value_type;
-        in.read(reinterpret_cast<char*>(&value_type), sizeof(value_type));
-        if (!in) break;
-        
-        // Read value
-        if (value_type == 0) {
-            double val;
-            in.read(reinterpret_cast<char*>(&val), sizeof(val));
-            if (!in) break;
-            data.value = val;
-        } else {
-            uint64_t vec_size;
-            in.read(reinterpret_cast<char*>(&vec_size), sizeof(vec_size));
-            if (!in) break;
-            
-            std::vector<double> vec(vec_size);
-            in.read(reinterpret_cast<char*>(vec.data()), vec_size * sizeof(double));
-            if (!in) break;
-            data.value = vec;
+    return magic == WriteAheadLog::kMagic;
+}
+
+/**
+ * Decode framed records; returns the offset just past the last intact one.
+ *
+ * Frame boundaries are found with one pass over the length prefixes. The
+ * frames are then cut into segments whose checksums are verified (and,
+ * with out, payloads decoded) on up to num_threads threads. Everything
+ * from the first bad frame on is dropped, as a sequential scan would.
+ */
+size_t decode_wal_frames(const std::vector<uint8_t>& file, std::vector<TimeSeriesData>* out,
+                         size_t num_threads = 1, const SeriesCatalog* catalog = nullptr) {
+    struct Frame {
+        size_t offset;          // Of the payload
+        uint32_t length;
+        uint32_t crc;
+    };
+    
+    std::vector<Frame> frames;
+    size_t pos = kWalHeaderSize;
+    while (pos <= file.size() && file.size() - pos >= kWalFrameSize) {
+        Frame frame;
+        std::memcpy(&frame.length, file.data() + pos, sizeof(frame.length));
+        std::memcpy(&frame.crc, file.data() + pos + sizeof(frame.length), sizeof(frame.crc));
+        frame.offset = pos + kWalFrameSize;
+        if (file.size() - frame.offset < frame.length) {
+            break;  // Torn write at the tail
         }
-        
-        // Read tags
-        uint32_t num_tags;
-        in.read(reinterpret_cast<char*>(&num_tags), sizeof(num_tags));
-        if (!in) break;
-        
-        for (uint32_t i = 0; i < num_tags; ++i) {
-            uint32_t key_len, val_len;
-            in.read(reinterpret_cast<char*>(&key_len), sizeof(key_len));
-            if (!in) break;
-            
-            std::string key(key_len, '\0');
-            in.read(&key[0], key_len);
-            if (!in) break;
-            
-            in.read(reinterpret_cast<char*>(&val_len), sizeof(val_len));
-            if (!in) break;
-            
-            std::string value(val_len, '\0');
-            in.read(&value[0], val_len);
-            if (!in) break;
-            
-            data.tags[key] = value;
+        frames.push_back(frame);
+        pos = frame.offset + frame.length;
+    }
+    
+    // Segments below this size are not worth a thread
+    constexpr size_t kMinFramesPerSegment = 4096;
+    size_t num_segments = std::clamp<size_t>(frames.size() / kMinFramesPerSegment, 1,
+                                             std::max<size_t>(1, num_threads));
+    size_t per_segment = (frames.size() + num_segments - 1) / num_segments;
+    
+    std::vector<std::vector<TimeSeriesData>> decoded(num_segments);
+    std::vector<size_t> first_bad(num_segments, frames.size());
+    auto run_segment = [&](size_t segment) {
+        size_t begin = segment * per_segment;
+        size_t end = std::min(frames.size(), begin + per_segment);
+        if (out) {
+            decoded[segment].reserve(end - begin);
         }
-        
-        // Read fields
-        uint32_t num_fields;
-        in.read(reinterpret_cast<char*>(&num_fields), sizeof(num_fields));
-        if (!in) break;
-        
-        for (uint32_t i = 0; i < num_fields; ++i) {
-            uint32_t key_len, val_len;
-            in.read(reinterpret_cast<char*>(&key_len), sizeof(key_len));
-            if (!in) break;
-            
-            std::string key(key_len, '\0');
-            in.read(&key[0], key_len);
-            if (!in) break;
-            
-            in.read(reinterpret_cast<char*>(&val_len), sizeof(val_len));
-            if (!in) break;
-            
-            std::string value(val_len, '\0');
-            in.read(&value[0], val_len);
-            if (!in) break;
-            
-            data.fields[key] = value;
+        for (size_t i = begin; i < end; ++i) {
+            const Frame& frame = frames[i];
+            const uint8_t* payload = file.data() + frame.offset;
+            if (crc32c(payload, frame.length) != frame.crc) {
+                first_bad[segment] = i;
+                return;
+            }
+            if (!out) {
+                continue;
+            }
+            const uint8_t* record = payload;
+            TimeSeriesData data;
+            if (!decode_wal_record(record, payload + frame.length, data, catalog) ||
+                record != payload + frame.length) {
+                first_bad[segment] = i;
+                return;
+            }
+            decoded[segment].push_back(std::move(data));
+        }
+    };
+    
+    std::vector<std::thread> workers;
+    for (size_t segment = 1; segment < num_segments; ++segment) {
+        workers.emplace_back(run_segment, segment);
+    }
+    run_segment(0);
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    
+    size_t valid_frames = *std::min_element(first_bad.begin(), first_bad.end());
+    if (out) {
+        out->reserve(out->size() + valid_frames);
+        size_t taken = 0;
+        for (size_t segment = 0; segment < num_segments && taken < valid_frames; ++segment) {
+            size_t take = std::min(decoded[segment].size(), valid_frames - taken);
+            out->insert(out->end(), std::make_move_iterator(decoded[segment].begin()),
+                        std::make_move_iterator(decoded[segment].begin() + take));
+            taken += take;
         }
-        
-        result[timestamp] = data;
     }
-    
-    in.close();
-    return result;
+    return valid_frames == 0 ? std::min(kWalHeaderSize, file.size())
+                             : frames[valid_frames - 1].offset + frames[valid_frames - 1].length;
 }
 
-bool WriteAheadLog::clear() {
-    std::lock_guard<std::mutex> lock(mutex_);
-    
-    if (log_file_.is_open()) {
-        log_file_.close();
+bool read_whole_file(const std::string& path, std::vector<uint8_t>& contents) {
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in.is_open()) {
+        return false;
+    }
+    contents.resize(static_cast<size_t>(in.tellg()));
+    in.seekg(0);
+    in.read(reinterpret_cast<char*>(contents.data()), contents.size());
+    return static_cast<bool>(in);
+}
+
+bool write_fully(int fd, const uint8_t* data, size_t size) {
+    while (size > 0) {
+        ssize_t written = ::write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+// Hard-link from as to, copying where the filesystem cannot link them
+bool link_or_copy(const fs::path& from, const fs::path& to) {
+    std::error_code ec;
+    if (fs::exists(to, ec) && fs::equivalent(from, to, ec)) {
+        return true;
+    }
+    fs::remove(to, ec);
+    ec.clear();
+    fs::create_hard_link(from, to, ec);
+    if (!ec) {
+        return true;
+    }
+    ec.clear();
+    return fs::copy_file(from, to, fs::copy_options::overwrite_existing, ec) && !ec;
+}
+
+} // namespace
+
+WriteAheadLog::WriteAheadLog(const std::string& log_path, const WalOptions& options)
+    : log_path_(log_path), options_(options) {
+    if (!open_log()) {
+        std::cerr << "Failed to open WAL: " << log_path_ << std::endl;
+        failed_ = true;
     }
     
-    // Remove old file
-    if (fs::exists(log_path_)) {
-        fs::remove(log_path_);
+    if (options_.sync_mode == WalSyncMode::Interval) {
+        sync_thread_ = std::thread(&WriteAheadLog::sync_worker, this);
+    }
+}
+
+WriteAheadLog::~WriteAheadLog() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    if (sync_thread_.joinable()) {
+        sync_thread_.join();
     }
     
-    // Reopen fresh file
-    log_file_.open(log_path_, std::ios::binary | std::ios::app);
-    return log_file_.is_open();
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (fd_ >= 0) {
+            commit(lock, appended_seq_, options_.sync_mode != WalSyncMode::None);
+        }
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
 }
 
-bool WriteAheadLog::sync() {
-    std::lock_guard<std::mutex> lock(mutex_);
+bool WriteAheadLog::open_log() {
+    std::vector<uint8_t> contents;
+    if (!fs::exists(log_path_) || !read_whole_file(log_path_, contents) || contents.empty()) {
+        return reset_file();
+    }
     
-    if (log_file_.is_open()) {
-        log_file_.flush();
-        return log_file_.good();
+    if (has_wal_header(contents)) {
+        // Drop a torn tail so new records are not appended behind garbage
+        size_t valid_end = decode_wal_frames(contents, nullptr, options_.recovery_threads);
+        if (valid_end < contents.size()) {
+            fs::resize_file(log_path_, valid_end);
+        }
+    } else {
+        // Old unframed log: re-frame whatever records are intact
+        std::vector<uint8_t> converted;
+        append_wal_header(converted);
+        const uint8_t* ptr = contents.data();
+        const uint8_t* end = ptr + contents.size();
+        std::vector<uint8_t> payload;
+        while (ptr < end) {
+            TimeSeriesData data;
+            if (!decode_wal_record(ptr, end, data)) {
+                break;
+            }
+            payload.clear();
+            encode_wal_record(data.timestamp, data, payload);
+            append_wal_frame(converted, payload);
+        }
+        
+        std::string tmp_path = log_path_ + ".tmp";
+        int tmp_fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (tmp_fd < 0) {
+            return false;
+        }
+        bool ok = write_fully(tmp_fd, converted.data(), converted.size()) && ::fsync(tmp_fd) == 0;
+        ::close(tmp_fd);
+        if (!ok || std::rename(tmp_path.c_str(), log_path_.c_str()) != 0) {
+            return false;
+        }
     }
-    return false;
+    
+    fd_ = ::open(log_path_.c_str(), O_WRONLY | O_APPEND);
+    return fd_ >= 0;
 }
 
-// ============================================================================
-// MemTable Implementation
-// ============================================================================
+bool WriteAheadLog::reset_file() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+    fd_ = ::open(log_path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (fd_ < 0) {
+        return false;
+    }
+    
+    std::vector<uint8_t> header;
+    append_wal_header(header);
+    return write_fully(fd_, header.data(), header.size());
+}
 
-MemTable::MemTable(size_t max_size_bytes)
-    : max_size_bytes_(max_size_bytes), size_bytes_(0) {}
+bool WriteAheadLog::append(int64_t timestamp, const TimeSeriesData& data) {
+    // Encode outside the lock
+    thread_local std::vector<uint8_t> payload;
+    thread_local std::vector<uint8_t> frames;
+    payload.clear();
+    frames.clear();
+    if (!encode_wal_record(timestamp, data, payload, options_.catalog.get())) {
+        return false;
+    }
+    append_wal_frame(frames, payload);
+    return append_frames(frames);
+}
 
-bool MemTable::put(int64_t timestamp, const TimeSeriesData& data) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    
-    size_t data_size = estimate_size(data);
-    
-    // Check if inserting would exceed max size
-    if (size_bytes_ + data_size > max_size_bytes_ && data_.find(timestamp) == data_.end()) {
-        return false; // MemTable is full
+bool WriteAheadLog::append_batch(const std::vector<TimeSeriesData>& batch, size_t begin) {
+    if (begin >= batch.size()) {
+        return true;
     }
     
-    // If updating existing entry, adjust size
-    auto it = data_.find(timestamp);
-    if (it != data_.end()) {
-        size_bytes_ -= estimate_size(it->second);
+    thread_local std::vector<uint8_t> payload;
+    thread_local std::vector<uint8_t> frames;
+    frames.clear();
+    for (size_t i = begin; i < batch.size(); ++i) {
+        payload.clear();
+        if (!encode_wal_record(batch[i].timestamp, batch[i], payload, options_.catalog.get())) {
+            return false;
+        }
+        append_wal_frame(frames, payload);
+    }
+    return append_frames(frames);
+}
+
+bool WriteAheadLog::append_frames(const std::vector<uint8_t>& frames) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (failed_) {
+        return false;
     }
     
-    data_[timestamp] = data;
-    size_bytes_ += data_size;
+    pending_.insert(pending_.end(), frames.begin(), frames.end());
+    uint64_t seq = ++appended_seq_;
     
+    if (options_.sync_mode == WalSyncMode::PerGroup) {
+        return commit(lock, seq, true);
+    }
+    if (pending_.size() >= options_.buffer_bytes && !leader_active_) {
+        return commit(lock, seq, false);
+    }
     return true;
 }
 
-bool MemTable::get(int64_t timestamp, TimeSeriesData& data) const {
-    std::lock_guard<std::mutex> lock(mutex_);
-    
-    auto it = data_.find(timestamp);
-    if (it != data_.end()) {
-        data = it->second;
-        return true;
+bool WriteAheadLog::commit(std::unique_lock<std::mutex>& lock, uint64_t seq, bool durable) {
+    while (true) {
+        if (failed_) {
+            return false;
+        }
+        if (written_seq_ >= seq && (!durable || synced_seq_ >= seq)) {
+            return true;
+        }
+        if (leader_active_) {
+            cv_.wait(lock);
+            continue;
+        }
+        
+        // Lead one group: everything appended so far
+        leader_active_ = true;
+        flushing_.swap(pending_);
+        uint64_t group_seq = appended_seq_;
+        lock.unlock();
+        
+        bool ok = write_fully(fd_, flushing_.data(), flushing_.size());
+        if (ok && durable) {
+            ok = ::fdatasync(fd_) == 0;
+            num_syncs_.fetch_add(1, std::memory_order_relaxed);
+        }
+        flushing_.clear();
+        
+        lock.lock();
+        leader_active_ = false;
+        if (ok) {
+            written_seq_ = group_seq;
+            if (durable) {
+                synced_seq_ = group_seq;
+            }
+        } else {
+            std::cerr << "WAL write failed: " << log_path_ << std::endl;
+            failed_ = true;
+        }
+        cv_.notify_all();
     }
-    return false;
 }
 
-bool MemTable::is_full() const {
-    return size_bytes_ >= max_size_bytes_;
+void WriteAheadLog::sync_worker() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stop_) {
+        cv_.wait_for(lock, std::chrono::milliseconds(options_.sync_interval_ms),
+                     [this] { return stop_; });
+        if (!stop_ && synced_seq_ < appended_seq_) {
+            commit(lock, appended_seq_, true);
+        }
+    }
 }
 
-std::vector<TimeSeriesData> MemTable::range_query(int64_t start_time, int64_t end_time) const {
-    std::lock_guard<std::mutex> lock(mutex_);
-    
+std::vector<TimeSeriesData> WriteAheadLog::recover() {
     std::vector<TimeSeriesData> result;
     
-    auto it_start = data_.lower_bound(start_time);
-    auto it_end = data_.upper_bound(end_time);
+    {
+        // Make buffered records visible to the reader below
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (fd_ >= 0) {
+            commit(lock, appended_seq_, false);
+        }
+    }
     
-    for (auto it = it_start; it != it_end; ++it) {
-        result.push_back(it->second);
+    std::vector<uint8_t> contents;
+    if (!read_whole_file(log_path_, contents) || !has_wal_header(contents)) {
+        return result;
     }
     
+    decode_wal_frames(contents, &result, options_.recovery_threads, options_.catalog.get());
     return result;
 }
 
-void MemTable::clear() {
-    std::lock_guard<std::mutex> lock(mutex_);
-    data_.clear();
-    size_bytes_ = 0;
+bool WriteAheadLog::clear() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this] { return !leader_active_; });
+    
+    // Everything appended so far is persisted elsewhere now
+    pending_.clear();
+    written_seq_ = appended_seq_;
+    synced_seq_ = appended_seq_;
+    failed_ = !reset_file();
+    if (!failed_ && options_.sync_mode != WalSyncMode::None) {
+        ::fdatasync(fd_);
+    }
+    return !failed_;
 }
 
-size_t MemTable::estimate_size(const TimeSeriesData& data) const {
-    size_t size = sizeof(int64_t); // timestamp
+bool WriteAheadLog::sync() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return fd_ >= 0 && commit(lock, appended_seq_, true);
+}
+
+// ============================================================================
+// MemTable Implementation
+// ============================================================================
+
+struct MemTable::Node {
+    Key key;
+    TimeSeriesData data;        // tags left empty when series is an id
+    uint32_t series;            // Catalog id, or SeriesCatalog::kInvalidId
+    // Extra levels are allocated past the end of the struct
+    std::atomic<Node*> next_[1];
+    
+    // Copies or moves (Data is TimeSeriesData) the parts of d a node keeps
+    template <typename Data>
+    Node(const Key& k, Data&& d, uint32_t s) : key(k), series(s) {
+        data.timestamp = d.timestamp;
+        data.value = std::forward<Data>(d).value;
+        data.fields = std::forward<Data>(d).fields;
+        if (series == SeriesCatalog::kInvalidId) {
+            data.tags = std::forward<Data>(d).tags;
+        }
+    }
     
-    // Value size
-    if (data.is_scalar()) {
-        size += sizeof(double);
-    } else {
-        auto vec = data.as_vector();
-        size += sizeof(size_t) + vec.size() * sizeof(double);
+    // Whose destructor frees memory, so clear() has to run it
+    bool owns_memory() const {
+        return !data.is_scalar() || !data.tags.empty() || !data.fields.empty();
     }
     
-    // Tags size
-    for (const auto& [key, value] : data.tags) {
-        size += key.size() + value.size() + 2 * sizeof(size_t);
+    Node* next(int level) const {
+        return next_[level].load(std::memory_order_acquire);
     }
     
-    // Fields size
-    for (const auto& [key, value] : data.fields) {
-        size += key.size() + value.size() + 2 * sizeof(size_t);
+    void set_next_relaxed(int level, Node* node) {
+        next_[level].store(node, std::memory_order_relaxed);
     }
     
-    return size;
+    bool cas_next(int level, Node* expected, Node* node) {
+        return next_[level].compare_exchange_strong(expected, node, std::memory_order_acq_rel);
+    }
+};
+
+MemTable::MemTable(size_t max_size_bytes, std::shared_ptr<SeriesCatalog> catalog,
+                   std::shared_ptr<MemoryTracker> tracker)
+    : catalog_(std::move(catalog)),
+      arena_(std::move(tracker)),
+      max_height_(1),
+      next_sequence_(0),
+      max_size_bytes_(max_size_bytes),
+      size_bytes_(0),
+      num_entries_(0),
+      owning_nodes_(0) {
+    head_ = new_node(Key{INT64_MIN, 0, 0}, TimeSeriesData(), SeriesCatalog::kInvalidId, kMaxHeight);
 }
 
-// ============================================================================
-// SSTable Implementation
-// ============================================================================
+MemTable::~MemTable() {
+    clear();
+}
 
-SSTable::Metadata::Metadata()
-    : magic_number(0x53535442), // "SSTB"
-      version(1),
-      level(0),
-      sequence_number(0),
-      num_entries(0),
-      min_timestamp(0),
-      max_timestamp(0),
-      bloom_filter_offset(0),
-      index_offset(0),
-      data_offset(0) {}
+template <typename Data>
+MemTable::Node* MemTable::new_node(const Key& key, Data&& data, uint32_t series, int height) {
+    size_t bytes = sizeof(Node) + sizeof(std::atomic<Node*>) * (height - 1);
+    void* memory = arena_.allocate(bytes, alignof(Node));
+    Node* node = new (memory) Node(key, std::forward<Data>(data), series);
+    for (int level = 1; level < height; ++level) {
+        new (&node->next_[level]) std::atomic<Node*>(nullptr);
+    }
+    node->next_[0].store(nullptr, std::memory_order_relaxed);
+    return node;
+}
 
-SSTable::SSTable(const std::string& file_path, uint64_t level, uint64_t sequence)
-    : file_path_(file_path) {
-    metadata_.level = level;
-    metadata_.sequence_number = sequence;
+int MemTable::random_height() {
+    // Branching factor 4
+    thread_local uint64_t state =
+        0x9e3779b97f4a7c15ULL ^ reinterpret_cast<uintptr_t>(&state);
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    
+    int height = 1;
+    uint64_t bits = state;
+    while (height < kMaxHeight && (bits & 3) == 0) {
+        ++height;
+        bits >>= 2;
+    }
+    return height;
 }
 
-bool SSTable::build_from_memtable(const std::map<int64_t, TimeSeriesData>& data) {
-    if (data.empty()) {
-        return false;
+bool MemTable::key_less(const Key& a, const Key& b) {
+    if (a.timestamp != b.timestamp) return a.timestamp < b.timestamp;
+    if (a.series_id != b.series_id) return a.series_id < b.series_id;
+    return a.sequence > b.sequence;
+}
+
+MemTable::Node* MemTable::find_greater_or_equal(const Key& target) const {
+    Node* x = head_;
+    for (int level = max_height_.load(std::memory_order_acquire) - 1; level >= 0; --level) {
+        Node* next = x->next(level);
+        while (next && key_less(next->key, target)) {
+            x = next;
+            next = x->next(level);
+        }
     }
-    
-    std::ofstream out(file_path_, std::ios::binary);
-    if (!out.is_open()) {
-        std::cerr << "Failed to create SSTable: " << file_path_ << std::endl;
-        return false;
+    return x->next(0);
+}
+
+void MemTable::find_splice_for_level(const Key& key, Node* before, int level,
+                                     Node** out_prev, Node** out_next) const {
+    Node* x = before;
+    while (true) {
+        Node* next = x->next(level);
+        if (!next || !key_less(next->key, key)) {
+            *out_prev = x;
+            *out_next = next;
+            return;
+        }
+        x = next;
+    }
+}
+
+bool MemTable::put(int64_t timestamp, const TimeSeriesData& data) {
+    size_t data_size = entry_size(data);
+    
+    // Check if inserting would exceed max size
+    if (size_bytes_.load(std::memory_order_relaxed) + data_size > max_size_bytes_ &&
+        num_entries_.load(std::memory_order_relaxed) > 0) {
+        return false; // MemTable is full
+    }
+    
+    Key key{timestamp, data.series_id(),
+            next_sequence_.fetch_add(1, std::memory_order_relaxed) + 1};
+    insert(key, data, data_size);
+    return true;
+}
+
+bool MemTable::put(int64_t timestamp, TimeSeriesData&& data) {
+    size_t data_size = entry_size(data);
+    
+    if (size_bytes_.load(std::memory_order_relaxed) + data_size > max_size_bytes_ &&
+        num_entries_.load(std::memory_order_relaxed) > 0) {
+        return false; // MemTable is full; data untouched
+    }
+    
+    Key key{timestamp, data.series_id(),
+            next_sequence_.fetch_add(1, std::memory_order_relaxed) + 1};
+    insert(key, std::move(data), data_size);
+    return true;
+}
+
+void MemTable::put(int64_t timestamp, const TimeSeriesData& data, uint64_t sequence) {
+    // Keep later put() calls newer than the replayed entry
+    uint64_t current = next_sequence_.load(std::memory_order_relaxed);
+    while (current < sequence &&
+           !next_sequence_.compare_exchange_weak(current, sequence, std::memory_order_relaxed)) {
+    }
+    insert(Key{timestamp, data.series_id(), sequence}, data, entry_size(data));
+}
+
+uint64_t MemTable::reserve_sequences(uint64_t count) {
+    return next_sequence_.fetch_add(count, std::memory_order_relaxed) + 1;
+}
+
+template <typename Data>
+void MemTable::insert(const Key& key, Data&& data, size_t data_size) {
+    int height = random_height();
+    uint32_t series = catalog_ ? catalog_->intern(data.tags) : SeriesCatalog::kInvalidId;
+    Node* node = new_node(key, std::forward<Data>(data), series, height);
+    node->data.timestamp = key.timestamp;
+    if (node->owns_memory()) {
+        owning_nodes_.fetch_add(1, std::memory_order_relaxed);
+    }
+    
+    int max_height = max_height_.load(std::memory_order_relaxed);
+    while (height > max_height) {
+        if (max_height_.compare_exchange_weak(max_height, height)) {
+            max_height = height;
+            break;
+        }
+    }
+    
+    // Locate the splice top-down, then link bottom-up so that a node is
+    // reachable at level 0 before any higher level points to it
+    Node* prev[kMaxHeight];
+    Node* next[kMaxHeight];
+    Node* x = head_;
+    for (int level = max_height - 1; level >= 0; --level) {
+        find_splice_for_level(key, x, level, &prev[level], &next[level]);
+        x = prev[level];
+    }
+    
+    for (int level = 0; level < height; ++level) {
+        while (true) {
+            node->set_next_relaxed(level, next[level]);
+            if (prev[level]->cas_next(level, next[level], node)) {
+                break;
+            }
+            // Lost a race with another insert at this level
+            find_splice_for_level(key, prev[level], level, &prev[level], &next[level]);
+        }
+    }
+    
+    size_bytes_.fetch_add(data_size, std::memory_order_relaxed);
+    num_entries_.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool MemTable::get(int64_t timestamp, TimeSeriesData& data) const {
+    Node* node = find_greater_or_equal(Key{timestamp, 0, UINT64_MAX});
+    if (node && node->key.timestamp == timestamp) {
+        data = resolve(node);
+        return true;
+    }
+    return false;
+}
+
+bool MemTable::is_full() const {
+    return size_bytes_ >= max_size_bytes_;
+}
+
+std::vector<TimeSeriesData> MemTable::range_query(int64_t start_time, int64_t end_time) const {
+    std::vector<TimeSeriesData> result;
+    
+    scan(start_time, end_time, [&](const TimeSeriesData& data, const Tags& tags) {
+        result.push_back(data);
+        result.back().tags = tags;
+        return true;
+    });
+    
+    return result;
+}
+
+void MemTable::scan(int64_t start_time, int64_t end_time,
+                    const std::function<bool(const TimeSeriesData& data, const Tags& tags)>& visit) const {
+    const Node* last = nullptr;
+    for (Node* node = find_greater_or_equal(Key{start_time, 0, UINT64_MAX});
+         node && node->key.timestamp <= end_time; node = node->next(0)) {
+        // Older versions of the same point follow the newest one
+        if (last && last->key.timestamp == node->key.timestamp &&
+            last->key.series_id == node->key.series_id) {
+            continue;
+        }
+        const Tags& tags = node->series != SeriesCatalog::kInvalidId
+            ? catalog_->tags(node->series) : node->data.tags;
+        if (!visit(node->data, tags)) {
+            return;
+        }
+        last = node;
+    }
+}
+
+std::vector<TimeSeriesData> MemTable::get_all() const {
+    return range_query(INT64_MIN, INT64_MAX);
+}
+
+void MemTable::clear() {
+    // Plain nodes hold nothing beyond their arena slot
+    if (owning_nodes_.load(std::memory_order_relaxed) > 0) {
+        for (Node* node = head_->next(0); node; node = node->next(0)) {
+            if (node->owns_memory()) {
+                node->~Node();
+            }
+        }
+    }
+    arena_.reset();
+    head_ = new_node(Key{INT64_MIN, 0, 0}, TimeSeriesData(), SeriesCatalog::kInvalidId, kMaxHeight);
+    max_height_ = 1;
+    size_bytes_ = 0;
+    num_entries_ = 0;
+    owning_nodes_ = 0;
+}
+
+TimeSeriesData MemTable::resolve(const Node* node) const {
+    TimeSeriesData data = node->data;
+    if (node->series != SeriesCatalog::kInvalidId) {
+        data.tags = catalog_->tags(node->series);
+    }
+    return data;
+}
+
+size_t MemTable::entry_size(const TimeSeriesData& data) const {
+    size_t size = estimate_size(data);
+    if (catalog_) {
+        for (const auto& [key, value] : data.tags) {
+            size -= key.size() + value.size() + 2 * sizeof(size_t);
+        }
+        size += sizeof(uint32_t);
+    }
+    return size;
+}
+
+size_t MemTable::estimate_size(const TimeSeriesData& data) {
+    size_t size = sizeof(int64_t); // timestamp
+    
+    // Value size
+    if (data.is_scalar()) {
+        size += sizeof(double);
+    } else {
+        auto vec = data.as_vector();
+        size += sizeof(size_t) + vec.size() * sizeof(double);
     }
     
-    // Prepare metadata
-    metadata_.num_entries = data.size();
-    metadata_.min_timestamp = data.begin()->first;
-    metadata_.max_timestamp = data.rbegin()->first;
+    // Tags size
+    for (const auto& [key, value] : data.tags) {
+        size += key.size() + value.size() + 2 * sizeof(size_t);
+    }
+    
+    // Fields size
+    for (const auto& [key, value] : data.fields) {
+        size += key.size() + value.byte_size() + 2 * sizeof(size_t);
+    }
+    
+    return size;
+}
+
+// ============================================================================
+// SSTable Implementation
+// ============================================================================
+
+struct SSTable::BuildState {
+    std::ofstream out;
+    uint64_t expected_entries = 0;
+    uint64_t num_entries = 0;
+    uint64_t bytes_written = 0;
+    std::vector<uint8_t> buffer;
+    
+    // v1: rows go straight after the reserved bloom/index space when the
+    // entry count is known up front, otherwise into a spill file
+    std::ofstream rows;
+    std::string rows_path;
+    std::vector<IndexEntry> row_index;
+    
+    // v2: pending block and bloom filter keys
+    std::vector<TimeSeriesData> block;
+    std::vector<int64_t> timestamps;
+    
+    // Key filters: distinct series and tag pair keys of the current block
+    // and of the whole file
+    std::unordered_set<uint64_t> block_series;
+    std::vector<uint64_t> block_keys;
+    std::unordered_set<uint64_t> file_keys;
+    std::vector<BlockedBloomFilter> block_filters;
+    
+    // Value summaries: current block and every sealed one
+    BlockSummary block_summary;
+    std::vector<BlockSummary> block_summaries;
+    
+    std::shared_ptr<IndexBlock> index = std::make_shared<IndexBlock>();
+    
+    uint64_t unthrottled_bytes = 0;     // Written but not yet charged to the rate limiter
+};
+
+SSTable::Metadata::Metadata()
+    : magic_number(0x53535442), // "SSTB"
+      version(1),
+      level(0),
+      sequence_number(0),
+      num_entries(0),
+      min_timestamp(0),
+      max_timestamp(0),
+      bloom_filter_offset(0),
+      index_offset(0),
+      data_offset(0) {}
+
+SSTable::SSTable(const std::string& file_path, uint64_t level, uint64_t sequence,
+                 const SSTableOptions& options)
+    : file_path_(file_path), options_(options), file_id_(BlockCache::new_file_id()) {
+    metadata_.level = level;
+    metadata_.sequence_number = sequence;
+}
+
+SSTable::~SSTable() {
+    // Abandoned build: drop the v1 spill file
+    if (build_ && !build_->rows_path.empty()) {
+        build_->rows.close();
+        fs::remove(build_->rows_path);
+    }
+    if (options_.block_cache) {
+        options_.block_cache->erase_file(file_id_);
+    }
+    if (read_fd_ >= 0) {
+        ::close(read_fd_);
+    }
+}
+
+bool SSTable::open() {
+    return ensure_loaded();
+}
+
+void SSTable::open_lazily(uint32_t format_version, uint64_t num_entries,
+                          int64_t min_timestamp, int64_t max_timestamp) {
+    metadata_.version = format_version;
+    metadata_.num_entries = num_entries;
+    metadata_.min_timestamp = min_timestamp;
+    metadata_.max_timestamp = max_timestamp;
+    metadata_known_ = true;
+}
+
+bool SSTable::ensure_loaded() {
+    if (loaded_.load(std::memory_order_acquire)) {
+        return true;
+    }
+    
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (loaded_.load(std::memory_order_relaxed)) {
+        return true;
+    }
+    
+    if (options_.use_mmap) {
+        mapping_ = MappedFile::open(file_path_);
+        if (!mapping_) return false;
+    }
+    if (options_.async_reader && read_fd_ < 0) {
+        // Opened with the file so reads keep working after compaction unlinks it
+        read_fd_ = ::open(file_path_.c_str(), O_RDONLY | O_CLOEXEC);
+    }
+    
+    std::ifstream in;
+    std::vector<uint8_t> scratch;
+    
+    Metadata header;
+    const uint8_t* ptr = read_range(in, 0, sizeof(header), scratch);
+    if (!ptr || !read_metadata(ptr, sizeof(header), header)) return false;
+    
+    if (metadata_known_) {
+        // Readers may already use the manifest fields, so only fill in the
+        // offsets, after making sure the file is the one the manifest means
+        if (header.version != metadata_.version || header.num_entries != metadata_.num_entries ||
+            header.min_timestamp != metadata_.min_timestamp ||
+            header.max_timestamp != metadata_.max_timestamp) {
+            std::cerr << "SSTable does not match the manifest: " << file_path_ << std::endl;
+            return false;
+        }
+        metadata_.bloom_filter_offset = header.bloom_filter_offset;
+        metadata_.index_offset = header.index_offset;
+        metadata_.data_offset = header.data_offset;
+    } else {
+        metadata_ = header;
+    }
+    
+    auto block = load_index_block(in, scratch);
+    if (!block) return false;
+    publish_index_block(std::move(block));
+    
+    loaded_.store(true, std::memory_order_release);
+    return true;
+}
+
+const uint8_t* SSTable::read_range(std::ifstream& in, uint64_t offset, uint64_t size,
+                                   std::vector<uint8_t>& scratch) const {
+    if (mapping_) {
+        return mapping_->contains(offset, size) ? mapping_->data() + offset : nullptr;
+    }
+    
+    if (!in.is_open()) {
+        in.open(file_path_, std::ios::binary);
+        if (!in.is_open()) return nullptr;
+    }
+    
+    scratch.resize(size);
+    in.seekg(offset);
+    in.read(reinterpret_cast<char*>(scratch.data()), size);
+    return in ? scratch.data() : nullptr;
+}
+
+std::shared_ptr<SSTable::IndexBlock> SSTable::load_index_block(std::ifstream& in,
+                                                               std::vector<uint8_t>& scratch) {
+    auto block = std::make_shared<IndexBlock>();
+    
+    uint64_t file_size = mapping_ ? mapping_->size() : get_file_size();
+    uint64_t filters_offset = 0;
+    if (!read_key_filters(in, scratch, file_size, *block, filters_offset)) return nullptr;
+    
+    // Bloom filter is followed by the index in both formats
+    if (metadata_.index_offset < metadata_.bloom_filter_offset) return nullptr;
+    uint64_t bloom_size = metadata_.index_offset - metadata_.bloom_filter_offset;
+    const uint8_t* ptr = read_range(in, metadata_.bloom_filter_offset, bloom_size, scratch);
+    if (!ptr || !read_bloom_filter(ptr, bloom_size, *block)) return nullptr;
+    
+    // v1 index ends where row data starts, v2 index runs to the key filters
+    // (or the end of file)
+    uint64_t index_end = (metadata_.version == kColumnarFormatVersion)
+        ? (filters_offset ? filters_offset : file_size)
+        : metadata_.data_offset;
+    if (index_end < metadata_.index_offset) return nullptr;
+    uint64_t index_size = index_end - metadata_.index_offset;
+    ptr = read_range(in, metadata_.index_offset, index_size, scratch);
+    if (!ptr || !read_index(ptr, index_size, *block)) return nullptr;
+    
+    if (block->block_filters.size() != block->block_index.size()) {
+        block->block_filters.clear();
+    }
+    if (block->block_summaries.size() != block->block_index.size()) {
+        block->block_summaries.clear();
+    }
+    return block;
+}
+
+void SSTable::publish_index_block(std::shared_ptr<const IndexBlock> block) {
+    if (options_.block_cache) {
+        // Offset 0 holds the metadata, so it never collides with a data block
+        size_t charge = block->memory_bytes();
+        index_memory_bytes_.store(charge, std::memory_order_relaxed);
+        options_.block_cache->insert({file_id_, 0}, std::move(block), charge,
+                                     BlockCache::Priority::High);
+    } else {
+        index_memory_bytes_.store(block->memory_bytes(), std::memory_order_relaxed);
+        index_block_ = std::move(block);
+    }
+}
+
+std::shared_ptr<const SSTable::IndexBlock> SSTable::index_block() {
+    if (!ensure_loaded()) return nullptr;
+    if (!options_.block_cache) return index_block_;
+    
+    if (auto cached = options_.block_cache->lookup_as<IndexBlock>({file_id_, 0})) {
+        count_cache_access(true);
+        return cached;
+    }
+    count_cache_access(false);
+    
+    // Evicted: reload from the file (the mapping keeps it readable)
+    std::ifstream in;
+    std::vector<uint8_t> scratch;
+    std::shared_ptr<const IndexBlock> block = load_index_block(in, scratch);
+    if (block) {
+        publish_index_block(block);
+    }
+    return block;
+}
+
+void SSTable::count_cache_access(bool hit) {
+    if (options_.cache_counters) {
+        (hit ? options_.cache_counters->hits : options_.cache_counters->misses)
+            .fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+namespace {
+
+constexpr size_t kBloomBitsPerKey = 10;
+constexpr size_t kBloomHashFunctions = 3;
+constexpr size_t kRowIndexEntrySize = sizeof(int64_t) + sizeof(uint64_t) + sizeof(uint32_t);
+
+constexpr size_t kFilterFooterSize = sizeof(uint64_t) + 2 * sizeof(uint32_t);
+
+size_t bloom_serialized_size(uint64_t num_keys) {
+    return 2 * sizeof(uint64_t) + (num_keys * kBloomBitsPerKey + 7) / 8;
+}
+
+// Collect the filter keys of a point; tags are hashed once per series and block
+void add_filter_keys(std::unordered_set<uint64_t>& block_series, std::vector<uint64_t>& block_keys,
+                     const TimeSeriesData& point) {
+    uint64_t series_id = point.series_id();
+    if (!block_series.insert(series_id).second) {
+        return;
+    }
+    block_keys.push_back(series_id);
+    for (const auto& [key, value] : point.tags) {
+        block_keys.push_back(BlockedBloomFilter::tag_key(key, value));
+    }
+}
+
+BlockedBloomFilter build_key_filter(std::vector<uint64_t>& keys) {
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    BlockedBloomFilter filter(keys.size(), kBloomBitsPerKey);
+    for (uint64_t key : keys) {
+        filter.add(key);
+    }
+    return filter;
+}
+
+} // namespace
+
+void SSTable::throttle_write(BuildState& state, size_t bytes, bool force) {
+    // Charge the limiter in chunks rather than per row
+    constexpr uint64_t kThrottleChunkBytes = 64 * 1024;
+    state.unthrottled_bytes += bytes;
+    if (options_.rate_limiter && state.unthrottled_bytes > 0 &&
+        (force || state.unthrottled_bytes >= kThrottleChunkBytes)) {
+        options_.rate_limiter->request(state.unthrottled_bytes);
+        state.unthrottled_bytes = 0;
+    }
+}
+
+namespace {
+
+void seal_block_filter(std::unordered_set<uint64_t>& block_series, std::vector<uint64_t>& block_keys,
+                       std::unordered_set<uint64_t>& file_keys,
+                       std::vector<BlockedBloomFilter>& block_filters) {
+    file_keys.insert(block_keys.begin(), block_keys.end());
+    block_filters.push_back(build_key_filter(block_keys));
+    block_keys.clear();
+    block_series.clear();
+}
+
+void seal_block_summary(BlockSummary& current, std::vector<BlockSummary>& summaries) {
+    bool sketched = current.sketched;
+    current.quantiles.compact();
+    summaries.push_back(std::move(current));
+    current = BlockSummary();
+    current.sketched = sketched;
+}
+
+void append_summary(std::vector<uint8_t>& out, const BlockSummary& summary) {
+    append_pod(out, summary.count);
+    append_pod(out, summary.sum);
+    append_pod(out, summary.sum_squares);
+    append_pod(out, summary.min);
+    append_pod(out, summary.max);
+    append_pod(out, summary.first_timestamp);
+    append_pod(out, summary.first);
+    append_pod(out, summary.last_timestamp);
+    append_pod(out, summary.last);
+}
+
+bool read_summary(const uint8_t*& ptr, const uint8_t* end, BlockSummary& summary) {
+    return read_pod(ptr, end, summary.count) && read_pod(ptr, end, summary.sum) &&
+           read_pod(ptr, end, summary.sum_squares) && read_pod(ptr, end, summary.min) &&
+           read_pod(ptr, end, summary.max) && read_pod(ptr, end, summary.first_timestamp) &&
+           read_pod(ptr, end, summary.first) && read_pod(ptr, end, summary.last_timestamp) &&
+           read_pod(ptr, end, summary.last);
+}
+
+} // namespace
+
+bool SSTable::build_from_memtable(const std::vector<TimeSeriesData>& data) {
+    if (data.empty()) {
+        return false;
+    }
+    
+    if (!begin_build(data.size())) {
+        return false;
+    }
+    for (const auto& point : data) {
+        if (!add(point)) {
+            return false;
+        }
+    }
+    return finish_build();
+}
+
+bool SSTable::begin_build(uint64_t expected_entries) {
+    build_ = std::make_unique<BuildState>();
+    auto& state = *build_;
+    state.expected_entries = expected_entries;
+    
+    state.out.open(file_path_, std::ios::binary | std::ios::trunc);
+    if (!state.out.is_open()) {
+        std::cerr << "Failed to create SSTable: " << file_path_ << std::endl;
+        build_.reset();
+        return false;
+    }
+    
+    metadata_.version = options_.format_version;
+    metadata_.num_entries = 0;
+    state.block_summary.sketched = options_.block_sketches;
     
     // Reserve space for metadata (will write later)
-    size_t metadata_size = sizeof(SSTable::Metadata);
-    std::vector<char> metadata_buffer(metadata_size, 0);
-    out.write(metadata_buffer.data(), metadata_size);
-    
-    // Create bloom filter
-    size_t bloom_bits = data.size() * 10; // 10 bits per key
-    bloom_filter_ = std::make_unique<BloomFilter>(bloom_bits, 3);
-    for (const auto& [ts, _] : data) {
-        bloom_filter_->add(ts);
-    }
-    
-    // Write bloom filter
-    metadata_.bloom_filter_offset = out.tellp();
-    bloom_filter_->serialize(out);
-    
-    // Write index
-    metadata_.index_offset = out.tellp();
-    index_.clear();
-    index_.reserve(data.size());
-    
-    // Reserve space for index
-    size_t index_size = data.size() * (sizeof(int64_t) + sizeof(uint64_t) + sizeof(uint32_t));
-    std::vector<char> index_buffer(index_size, 0);
-    out.write(index_buffer.data(), index_size);
-    
-    // Write data and build index
-    metadata_.data_offset = out.tellp();
-    for (const auto& [timestamp, ts_data] : data) {
-        IndexEntry entry;
-        entry.timestamp = timestamp;
-        entry.offset = out.tellp();
+    std::vector<char> zeros(sizeof(Metadata), 0);
+    state.out.write(zeros.data(), zeros.size());
+    
+    if (metadata_.version == kColumnarFormatVersion) {
+        // Blocks follow the metadata directly; bloom filter and index go last
+        metadata_.data_offset = sizeof(Metadata);
+        state.block.reserve(std::max<size_t>(1, options_.block_size_points));
+    } else if (expected_entries > 0) {
+        metadata_.bloom_filter_offset = sizeof(Metadata);
+        metadata_.index_offset = metadata_.bloom_filter_offset + bloom_serialized_size(expected_entries);
+        metadata_.data_offset = metadata_.index_offset + expected_entries * kRowIndexEntrySize;
+        state.out.seekp(metadata_.data_offset);
+        state.row_index.reserve(expected_entries);
+    } else {
+        state.rows_path = file_path_ + ".rows";
+        state.rows.open(state.rows_path, std::ios::binary | std::ios::trunc);
+        if (!state.rows.is_open()) {
+            std::cerr << "Failed to create SSTable spill file: " << state.rows_path << std::endl;
+            build_.reset();
+            return false;
+        }
+    }
+    
+    state.bytes_written = sizeof(Metadata);
+    return state.out.good();
+}
+
+bool SSTable::add(const TimeSeriesData& point) {
+    if (!build_) {
+        return false;
+    }
+    auto& state = *build_;
+    
+    if (state.num_entries == 0) {
+        metadata_.min_timestamp = point.timestamp;
+    }
+    metadata_.max_timestamp = point.timestamp;
+    state.num_entries++;
+    add_filter_keys(state.block_series, state.block_keys, point);
+    state.block_summary.add(point);
+    
+    if (metadata_.version == kColumnarFormatVersion) {
+        state.timestamps.push_back(point.timestamp);
+        state.block.push_back(point);
+        if (state.block.size() >= std::max<size_t>(1, options_.block_size_points)) {
+            return flush_build_block(state);
+        }
+        return true;
+    }
+    
+    if (state.expected_entries > 0 && state.num_entries > state.expected_entries) {
+        std::cerr << "SSTable build exceeded its reserved entries: " << file_path_ << std::endl;
+        return false;
+    }
+    
+    // v1 row records share their layout with WAL records
+    state.buffer.clear();
+    encode_wal_record(point.timestamp, point, state.buffer);
+    
+    bool spill = state.expected_entries == 0;
+    IndexEntry entry;
+    entry.timestamp = point.timestamp;
+    entry.offset = spill ? state.bytes_written - sizeof(Metadata) : state.bytes_written +
+                           (metadata_.data_offset - sizeof(Metadata));
+    entry.size = static_cast<uint32_t>(state.buffer.size());
+    
+    auto& out = spill ? state.rows : state.out;
+    throttle_write(state, state.buffer.size());
+    out.write(reinterpret_cast<const char*>(state.buffer.data()), state.buffer.size());
+    state.bytes_written += state.buffer.size();
+    state.row_index.push_back(entry);
+    if (state.row_index.size() % kRowBlockPoints == 0) {
+        seal_block_filter(state.block_series, state.block_keys, state.file_keys,
+                          state.block_filters);
+        seal_block_summary(state.block_summary, state.block_summaries);
+    }
+    return out.good();
+}
+
+bool SSTable::flush_build_block(BuildState& state) {
+    auto& block = state.block;
+    
+    BlockIndexEntry entry;
+    entry.min_timestamp = block.front().timestamp;
+    entry.max_timestamp = block.back().timestamp;
+    entry.offset = state.bytes_written;
+    entry.num_points = static_cast<uint32_t>(block.size());
+    
+    state.buffer.clear();
+    ColumnarBlock::encode(block.data(), block.size(), state.buffer);
+    throttle_write(state, state.buffer.size());
+    state.out.write(reinterpret_cast<const char*>(state.buffer.data()), state.buffer.size());
+    entry.size = static_cast<uint32_t>(state.buffer.size());
+    state.bytes_written += state.buffer.size();
+    
+    state.index->block_index.push_back(entry);
+    block.clear();
+    seal_block_filter(state.block_series, state.block_keys, state.file_keys, state.block_filters);
+    seal_block_summary(state.block_summary, state.block_summaries);
+    return state.out.good();
+}
+
+uint64_t SSTable::get_build_bytes() const {
+    if (!build_) {
+        return 0;
+    }
+    // Spilled v1 rows still need their index written in front of them
+    return build_->bytes_written + build_->row_index.size() * kRowIndexEntrySize;
+}
+
+bool SSTable::finish_build() {
+    if (!build_) {
+        return false;
+    }
+    std::unique_ptr<BuildState> state_holder = std::move(build_);
+    auto& state = *state_holder;
+    auto& out = state.out;
+    auto& index = *state.index;
+    
+    if (state.num_entries == 0) {
+        out.close();
+        fs::remove(file_path_);
+        if (!state.rows_path.empty()) {
+            state.rows.close();
+            fs::remove(state.rows_path);
+        }
+        return false;
+    }
+    metadata_.num_entries = state.num_entries;
+    
+    // Bloom filter sized for the reserved space (v1 in place) or the real count
+    uint64_t bloom_keys = (metadata_.version == kRowFormatVersion && state.expected_entries > 0)
+        ? state.expected_entries : state.num_entries;
+    index.bloom_filter = std::make_unique<BloomFilter>(bloom_keys * kBloomBitsPerKey,
+                                                       kBloomHashFunctions);
+    
+    if (metadata_.version == kColumnarFormatVersion) {
+        if (!state.block.empty() && !flush_build_block(state)) {
+            return false;
+        }
+        for (int64_t ts : state.timestamps) {
+            index.bloom_filter->add(ts);
+        }
         
-        // Write timestamp
-        out.write(reinterpret_cast<const char*>(&timestamp), sizeof(timestamp));
+        metadata_.bloom_filter_offset = state.bytes_written;
+        index.bloom_filter->serialize(out);
+        metadata_.index_offset = out.tellp();
+        uint64_t num_blocks = index.block_index.size();
+        out.write(reinterpret_cast<const char*>(&num_blocks), sizeof(num_blocks));
+        for (const auto& entry : index.block_index) {
+            out.write(reinterpret_cast<const char*>(&entry.min_timestamp), sizeof(entry.min_timestamp));
+            out.write(reinterpret_cast<const char*>(&entry.max_timestamp), sizeof(entry.max_timestamp));
+            out.write(reinterpret_cast<const char*>(&entry.offset), sizeof(entry.offset));
+            out.write(reinterpret_cast<const char*>(&entry.size), sizeof(entry.size));
+            out.write(reinterpret_cast<const char*>(&entry.num_points), sizeof(entry.num_points));
+        }
+    } else {
+        if (state.row_index.size() % kRowBlockPoints != 0) {
+            seal_block_filter(state.block_series, state.block_keys, state.file_keys,
+                              state.block_filters);
+            seal_block_summary(state.block_summary, state.block_summaries);
+        }
         
-        // Write value type and value
-        uint8_t value_type = ts_data.is_scalar() ? 0 : 1;
-        out.write(reinterpret_cast<const char*>(&value_type), sizeof(value_type));
+        bool spill = state.expected_entries == 0;
+        if (spill) {
+            metadata_.bloom_filter_offset = sizeof(Metadata);
+            metadata_.index_offset = metadata_.bloom_filter_offset + bloom_serialized_size(bloom_keys);
+            metadata_.data_offset = metadata_.index_offset + state.num_entries * kRowIndexEntrySize;
+        }
         
-        if (ts_data.is_scalar()) {
-            double val = ts_data.as_double();
-            out.write(reinterpret_cast<const char*>(&val), sizeof(val));
-        } else {
-            auto vec = ts_data.as_vector();
-            uint64_t vec_size = vec.size();
-            out.write(reinterpret_cast<const char*>(&vec_size), sizeof(vec_size));
-            out.write(reinterpret_cast<const char*>(vec.data()), vec_size * sizeof(double));
+        for (size_t i = 0; i < state.row_index.size(); ++i) {
+            auto& entry = state.row_index[i];
+            if (spill) {
+                entry.offset += metadata_.data_offset;
+            }
+            index.bloom_filter->add(entry.timestamp);
+            append_sparse_row(index.block_index, entry, i);
         }
         
-        // Write tags
-        uint32_t num_tags = ts_data.tags.size();
-        out.write(reinterpret_cast<const char*>(&num_tags), sizeof(num_tags));
-        for (const auto& [key, value] : ts_data.tags) {
-            uint32_t key_len = key.size();
-            uint32_t val_len = value.size();
-            out.write(reinterpret_cast<const char*>(&key_len), sizeof(key_len));
-            out.write(key.data(), key_len);
-            out.write(reinterpret_cast<const char*>(&val_len), sizeof(val_len));
-            out.write(value.data(), val_len);
+        // Bloom filter and per-row index in front of the rows (on-disk v1 layout)
+        out.seekp(metadata_.bloom_filter_offset);
+        index.bloom_filter->serialize(out);
+        for (const auto& entry : state.row_index) {
+            out.write(reinterpret_cast<const char*>(&entry.timestamp), sizeof(entry.timestamp));
+            out.write(reinterpret_cast<const char*>(&entry.offset), sizeof(entry.offset));
+            out.write(reinterpret_cast<const char*>(&entry.size), sizeof(entry.size));
+        }
+        
+        if (spill) {
+            // Append the spilled rows in bounded chunks
+            state.rows.close();
+            std::ifstream rows(state.rows_path, std::ios::binary);
+            std::vector<char> chunk(1 << 20);
+            out.seekp(metadata_.data_offset);
+            while (rows) {
+                rows.read(chunk.data(), chunk.size());
+                out.write(chunk.data(), rows.gcount());
+            }
+            rows.close();
+            fs::remove(state.rows_path);
+        }
+    }
+    
+    // Key filters go last in both formats
+    out.seekp(0, std::ios::end);
+    uint64_t filters_begin = out.tellp();
+    if (!write_key_filters(out, state)) {
+        return false;
+    }
+    
+    // Bloom filter, index, key filters and (for spilled v1 rows) the copied data
+    uint64_t tail_bytes = bloom_serialized_size(bloom_keys) +
+                          (static_cast<uint64_t>(out.tellp()) - filters_begin);
+    if (metadata_.version == kRowFormatVersion) {
+        tail_bytes += state.row_index.size() * kRowIndexEntrySize +
+                      (state.expected_entries == 0 ? state.bytes_written : 0);
+    } else {
+        tail_bytes += sizeof(uint64_t) + index.block_index.size() * sizeof(BlockIndexEntry);
+    }
+    throttle_write(state, tail_bytes, true);
+    
+    // Write metadata to beginning
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&metadata_), sizeof(metadata_));
+    
+    out.close();
+    if (!out.good()) {
+        return false;
+    }
+    
+    if (options_.use_mmap) {
+        mapping_ = MappedFile::open(file_path_);
+        if (!mapping_) return false;
+    }
+    publish_index_block(std::move(state.index));
+    loaded_.store(true, std::memory_order_release);
+    return true;
+}
+
+bool SSTable::write_key_filters(std::ofstream& out, BuildState& state) {
+    auto& index = *state.index;
+    std::vector<uint64_t> file_keys(state.file_keys.begin(), state.file_keys.end());
+    index.key_filter = build_key_filter(file_keys);
+    index.block_filters = std::move(state.block_filters);
+    index.block_summaries = std::move(state.block_summaries);
+    
+    // [u32 num blocks][file filter][block filters...][u32 "SSUM"][block summaries...]
+    std::vector<uint8_t>& section = state.buffer;
+    section.clear();
+    uint32_t num_filters = static_cast<uint32_t>(index.block_filters.size());
+    append_pod(section, num_filters);
+    index.key_filter.serialize(section);
+    for (const auto& filter : index.block_filters) {
+        filter.serialize(section);
+    }
+    append_pod(section, kSummaryMagic);
+    for (const auto& summary : index.block_summaries) {
+        append_summary(section, summary);
+    }
+    bool sketched = std::all_of(index.block_summaries.begin(), index.block_summaries.end(),
+                                [](const BlockSummary& summary) { return summary.sketched; });
+    if (sketched) {
+        append_pod(section, kSketchMagic);
+        for (const auto& summary : index.block_summaries) {
+            summary.quantiles.serialize(section);
+            summary.distinct.serialize(section);
+        }
+    }
+    
+    uint64_t offset = out.tellp();
+    append_pod(section, offset);
+    append_pod(section, crc32c(section.data(), section.size() - sizeof(offset)));
+    append_pod(section, kFilterMagic);
+    out.write(reinterpret_cast<const char*>(section.data()), section.size());
+    return out.good();
+}
+
+bool SSTable::read_key_filters(std::ifstream& in, std::vector<uint8_t>& scratch,
+                               uint64_t file_size, IndexBlock& block, uint64_t& offset) {
+    offset = 0;
+    if (file_size < sizeof(Metadata) + kFilterFooterSize) return true;
+    
+    const uint8_t* ptr = read_range(in, file_size - kFilterFooterSize, kFilterFooterSize, scratch);
+    if (!ptr) return false;
+    uint64_t section_offset;
+    uint32_t crc;
+    uint32_t magic;
+    std::memcpy(&section_offset, ptr, sizeof(section_offset));
+    std::memcpy(&crc, ptr + sizeof(section_offset), sizeof(crc));
+    std::memcpy(&magic, ptr + sizeof(section_offset) + sizeof(crc), sizeof(magic));
+    if (magic != kFilterMagic || section_offset < sizeof(Metadata) ||
+        section_offset > file_size - kFilterFooterSize) {
+        return true;    // Written before key filters existed
+    }
+    
+    uint64_t size = file_size - kFilterFooterSize - section_offset;
+    ptr = read_range(in, section_offset, size, scratch);
+    if (!ptr || crc32c(ptr, size) != crc) {
+        std::cerr << "Ignoring corrupt key filters in SSTable: " << file_path_ << std::endl;
+        return true;
+    }
+    
+    const uint8_t* end = ptr + size;
+    uint32_t num_filters;
+    if (size < sizeof(num_filters)) return true;
+    std::memcpy(&num_filters, ptr, sizeof(num_filters));
+    ptr += sizeof(num_filters);
+    
+    BlockedBloomFilter key_filter;
+    std::vector<BlockedBloomFilter> block_filters(num_filters);
+    if (!key_filter.deserialize(ptr, end)) return true;
+    for (auto& filter : block_filters) {
+        if (!filter.deserialize(ptr, end)) return true;
+    }
+    
+    block.key_filter = std::move(key_filter);
+    block.block_filters = std::move(block_filters);
+    offset = section_offset;
+    
+    // Summaries follow in files written since they were added
+    uint32_t summary_magic;
+    if (read_pod(ptr, end, summary_magic) && summary_magic == kSummaryMagic) {
+        std::vector<BlockSummary> summaries(num_filters);
+        for (auto& summary : summaries) {
+            if (!read_summary(ptr, end, summary)) return true;
+        }
+        // Then their sketches, in files written since sketches were added
+        uint32_t sketch_magic;
+        bool sketched = read_pod(ptr, end, sketch_magic) && sketch_magic == kSketchMagic;
+        for (auto& summary : summaries) {
+            summary.sketched = sketched && summary.quantiles.deserialize(ptr, end) &&
+                               summary.distinct.deserialize(ptr, end);
+            if (!summary.sketched) {
+                sketched = false;
+                summary.quantiles = QuantileSketch();
+                summary.distinct = DistinctSketch();
+            }
+        }
+        block.block_summaries = std::move(summaries);
+    }
+    return true;
+}
+
+size_t SSTable::find_block(const IndexBlock& block, int64_t timestamp) const {
+    auto it = std::lower_bound(block.block_index.begin(), block.block_index.end(), timestamp,
+        [](const BlockIndexEntry& entry, int64_t ts) {
+            return entry.max_timestamp < ts;
+        });
+    return std::distance(block.block_index.begin(), it);
+}
+
+SSTable::BlockPtr SSTable::load_block(std::ifstream& in, std::vector<uint8_t>& scratch,
+                                      const IndexBlock& block, size_t block_no,
+                                      bool fill_cache) {
+    const auto& entry = block.block_index[block_no];
+    if (auto cached = lookup_block(entry)) {
+        return cached;
+    }
+    
+    const uint8_t* ptr = read_range(in, entry.offset, entry.size, scratch);
+    if (!ptr) return nullptr;
+    return decode_block(ptr, entry, fill_cache);
+}
+
+SSTable::BlockPtr SSTable::lookup_block(const BlockIndexEntry& entry) {
+    const auto& cache = options_.block_cache;
+    if (!cache) {
+        return nullptr;
+    }
+    auto cached = cache->lookup_as<std::vector<TimeSeriesData>>({file_id_, entry.offset});
+    count_cache_access(cached != nullptr);
+    return cached;
+}
+
+SSTable::BlockPtr SSTable::decode_block(const uint8_t* ptr, const BlockIndexEntry& entry,
+                                        bool fill_cache) {
+    auto points = std::make_shared<std::vector<TimeSeriesData>>();
+    if (metadata_.version == kColumnarFormatVersion) {
+        if (!ColumnarBlock::decode(ptr, entry.size, *points)) return nullptr;
+    } else {
+        // Rows are contiguous and self-delimiting, so scan them in order
+        const uint8_t* end = ptr + entry.size;
+        points->resize(entry.num_points);
+        for (auto& point : *points) {
+            if (!read_data_at(ptr, end, point)) {
+                return nullptr;
+            }
+        }
+    }
+    
+    const auto& cache = options_.block_cache;
+    if (cache && fill_cache) {
+        cache->insert({file_id_, entry.offset}, points, estimate_block_charge(*points));
+    }
+    return points;
+}
+
+size_t SSTable::next_readable_block(const IndexBlock& block, size_t block_no, int64_t end_time,
+                                    const std::vector<uint64_t>& filter_keys,
+                                    const std::vector<char>& skip_blocks) {
+    const size_t num_blocks = block.block_index.size();
+    for (; block_no < num_blocks; ++block_no) {
+        if (block.block_index[block_no].min_timestamp > end_time) {
+            return num_blocks;
+        }
+        if (!filter_keys.empty() && !block.block_might_match(block_no, filter_keys)) {
+            continue;
+        }
+        if (block_no < skip_blocks.size() && skip_blocks[block_no]) {
+            continue;
+        }
+        return block_no;
+    }
+    return num_blocks;
+}
+
+std::vector<SSTable::BlockRead> SSTable::plan_block_reads(int64_t start_time, int64_t end_time,
+                                                          const std::vector<uint64_t>& filter_keys,
+                                                          const std::vector<char>& skip_blocks,
+                                                          size_t limit) {
+    std::vector<BlockRead> reads;
+    auto index = index_block();
+    if (!index) {
+        return reads;
+    }
+    
+    size_t block_no = find_block(*index, start_time);
+    while (reads.size() < limit) {
+        block_no = next_readable_block(*index, block_no, end_time, filter_keys, skip_blocks);
+        if (block_no >= index->block_index.size()) {
+            break;
+        }
+        reads.push_back({this, index, block_no, nullptr});
+        ++block_no;
+    }
+    return reads;
+}
+
+void SSTable::read_blocks(AsyncReader& reader, std::vector<BlockRead>& reads, bool fill_cache) {
+    std::vector<AsyncReader::Request> requests;
+    std::vector<size_t> owners;                     // Index in reads of each request
+    std::vector<std::vector<uint8_t>> buffers;
+    requests.reserve(reads.size());
+    owners.reserve(reads.size());
+    buffers.reserve(reads.size());
+    
+    for (size_t i = 0; i < reads.size(); ++i) {
+        auto& read = reads[i];
+        const auto& entry = read.index->block_index[read.block_no];
+        if ((read.block = read.table->lookup_block(entry))) {
+            continue;
+        }
+        if (read.table->read_fd_ < 0) {
+            continue;
+        }
+        buffers.emplace_back(entry.size);
+        AsyncReader::Request request;
+        request.fd = read.table->read_fd_;
+        request.offset = entry.offset;
+        request.buffer = buffers.back().data();
+        request.size = entry.size;
+        requests.push_back(request);
+        owners.push_back(i);
+    }
+    if (requests.empty()) {
+        return;
+    }
+    
+    reader.read_batch(requests, [&](size_t k) {
+        const auto& request = requests[k];
+        if (request.result != static_cast<int64_t>(request.size)) {
+            return;
+        }
+        auto& read = reads[owners[k]];
+        read.block = read.table->decode_block(request.buffer,
+                                              read.index->block_index[read.block_no], fill_cache);
+    });
+}
+
+std::unique_ptr<SSTable::Iterator> SSTable::new_iterator(bool fill_cache, int64_t start_time,
+                                                         int64_t end_time,
+                                                         std::vector<uint64_t> filter_keys,
+                                                         std::vector<char> skip_blocks,
+                                                         std::vector<BlockRead> prefetched) {
+    return std::unique_ptr<Iterator>(new Iterator(this, index_block(), fill_cache, start_time,
+                                                  end_time, std::move(filter_keys),
+                                                  std::move(skip_blocks), std::move(prefetched)));
+}
+
+std::vector<SSTable::BlockSpan> SSTable::block_spans(int64_t start_time, int64_t end_time,
+                                                     bool with_sketches) {
+    std::vector<BlockSpan> spans;
+    auto index = index_block();
+    if (!index) {
+        return spans;
+    }
+    
+    const auto& blocks = index->block_index;
+    const auto& summaries = index->block_summaries;
+    for (size_t i = find_block(*index, start_time);
+         i < blocks.size() && blocks[i].min_timestamp <= end_time; ++i) {
+        // Blocks sharing a timestamp belong to the same run
+        bool extend = !spans.empty() && spans.back().last_block + 1 == i &&
+                      blocks[i].min_timestamp <= spans.back().max_timestamp;
+        if (!extend) {
+            BlockSpan span;
+            span.min_timestamp = blocks[i].min_timestamp;
+            span.max_timestamp = blocks[i].max_timestamp;
+            span.first_block = i;
+            span.last_block = i;
+            span.has_summary = !summaries.empty();
+            spans.push_back(span);
+        }
+        auto& span = spans.back();
+        span.last_block = i;
+        span.max_timestamp = std::max(span.max_timestamp, blocks[i].max_timestamp);
+        if (span.has_summary && with_sketches && !summaries[i].sketched) {
+            span.has_summary = false;
+        }
+        if (span.has_summary) {
+            span.summary.merge(summaries[i], with_sketches);
+        }
+    }
+    
+    // A run cut off by end_time may continue into the next block
+    if (!spans.empty()) {
+        auto& last = spans.back();
+        size_t next = last.last_block + 1;
+        while (next < blocks.size() && blocks[next].min_timestamp <= last.max_timestamp) {
+            last.max_timestamp = std::max(last.max_timestamp, blocks[next].max_timestamp);
+            last.last_block = next;
+            if (last.has_summary && with_sketches && !summaries[next].sketched) {
+                last.has_summary = false;
+            }
+            if (last.has_summary) {
+                last.summary.merge(summaries[next], with_sketches);
+            }
+            ++next;
+        }
+    }
+    return spans;
+}
+
+std::vector<int64_t> SSTable::get_block_boundaries() {
+    std::vector<int64_t> boundaries;
+    if (auto index = index_block()) {
+        boundaries.reserve(index->block_index.size());
+        for (const auto& entry : index->block_index) {
+            boundaries.push_back(entry.min_timestamp);
+        }
+    }
+    return boundaries;
+}
+
+SSTable::Iterator::Iterator(SSTable* table, std::shared_ptr<const IndexBlock> index,
+                            bool fill_cache, int64_t start_time, int64_t end_time,
+                            std::vector<uint64_t> filter_keys, std::vector<char> skip_blocks,
+                            std::vector<BlockRead> prefetched)
+    : table_(table), index_(std::move(index)), fill_cache_(fill_cache), end_time_(end_time),
+      filter_keys_(std::move(filter_keys)), skip_blocks_(std::move(skip_blocks)) {
+    if (!index_) {
+        return;
+    }
+    for (auto& read : prefetched) {
+        if (read.block && read.table == table_) {
+            prefetched_.emplace(read.block_no, std::move(read.block));
+        }
+    }
+    
+    load(table_->find_block(*index_, start_time));
+    while (valid() && value().timestamp < start_time) {
+        next();
+    }
+}
+
+void SSTable::Iterator::load(size_t block_no) {
+    block_.reset();
+    pos_ = 0;
+    if (!index_) {
+        return;
+    }
+    // Skip empty and filtered-out blocks; a failed read ends the scan
+    for (block_no_ = block_no; ; ++block_no_) {
+        block_no_ = next_readable_block(*index_, block_no_, end_time_, filter_keys_, skip_blocks_);
+        if (block_no_ >= index_->block_index.size()) {
+            break;
+        }
+        block_ = take_prefetched(block_no_);
+        if (!block_) {
+            block_ = table_->load_block(in_, scratch_, *index_, block_no_, fill_cache_);
+        }
+        if (!block_ || !block_->empty()) {
+            return;
+        }
+    }
+    block_.reset();
+}
+
+SSTable::BlockPtr SSTable::Iterator::take_prefetched(size_t block_no) {
+    auto it = prefetched_.find(block_no);
+    if (it == prefetched_.end() && table_->options_.async_reader &&
+        table_->options_.readahead_blocks > 0) {
+        prefetch(block_no);
+        it = prefetched_.find(block_no);
+    }
+    if (it == prefetched_.end()) {
+        return nullptr;
+    }
+    BlockPtr block = std::move(it->second);
+    prefetched_.erase(it);
+    return block;
+}
+
+void SSTable::Iterator::prefetch(size_t block_no) {
+    std::vector<BlockRead> reads;
+    while (reads.size() < table_->options_.readahead_blocks) {
+        block_no = next_readable_block(*index_, block_no, end_time_, filter_keys_, skip_blocks_);
+        if (block_no >= index_->block_index.size()) {
+            break;
         }
-        
-        // Write fields
-        uint32_t num_fields = ts_data.fields.size();
-        out.write(reinterpret_cast<const char*>(&num_fields), sizeof(num_fields));
-        for (const auto& [key, value] : ts_data.fields) {
-            uint32_t key_len = key.size();
-            uint32_t val_len = value.size();
-            out.write(reinterpret_cast<const char*>(&key_len), sizeof(key_len));
-            out.write(key.data(), key_len);
-            out.write(reinterpret_cast<const char*>(&val_len), sizeof(val_len));
-            out.write(value.data(), val_len);
+        if (!prefetched_.count(block_no)) {
+            reads.push_back({table_, index_, block_no, nullptr});
         }
-        
-        entry.size = static_cast<uint32_t>(static_cast<uint64_t>(out.tellp()) - entry.offset);
-        index_.push_back(entry);
+        ++block_no;
     }
     
-    // Write index back to reserved space
-    out.seekp(metadata_.index_offset);
-    for (const auto& entry : index_) {
-        out.write(reinterpret_cast<const char*>(&entry.timestamp), sizeof(entry.timestamp));
-        out.write(reinterpret_cast<const char*>(&entry.offset), sizeof(entry.offset));
-        out.write(reinterpret_cast<const char*>(&entry.size), sizeof(entry.size));
+    read_blocks(*table_->options_.async_reader, reads, fill_cache_);
+    for (auto& read : reads) {
+        if (read.block) {
+            prefetched_.emplace(read.block_no, std::move(read.block));
+        }
     }
-    
-    // Write metadata to beginning
-    out.seekp(0);
-    out.write(reinterpret_cast<const char*>(&metadata_), sizeof(metadata_));
-    
-    out.close();
-    return true;
+}
+
+void SSTable::Iterator::next() {
+    if (++pos_ >= block_->size()) {
+        load(block_no_ + 1);
+    }
+}
+
+size_t SSTable::estimate_block_charge(const std::vector<TimeSeriesData>& points) {
+    // Rough heap footprint; map nodes cost about 64 bytes plus their strings
+    size_t charge = sizeof(std::vector<TimeSeriesData>) + points.size() * sizeof(TimeSeriesData);
+    for (const auto& point : points) {
+        if (!point.is_scalar()) {
+            charge += point.as_vector().size() * sizeof(double);
+        }
+        for (const auto& [key, value] : point.tags) {
+            charge += 64 + key.size() + value.size();
+        }
+        for (const auto& [key, value] : point.fields) {
+            charge += 64 + key.size() + value.byte_size();
+        }
+    }
+    return charge;
 }
 
 bool SSTable::get(int64_t timestamp, TimeSeriesData& data) {
-    std::lock_guard<std::mutex> lock(mutex_);
+    // Metadata and index are immutable once loaded, so no lock is needed
+    auto index = index_block();
+    if (!index) return false;
     
     // Check bloom filter first
-    if (bloom_filter_ && !bloom_filter_->might_contain(timestamp)) {
+    if (index->bloom_filter && !index->bloom_filter->might_contain(timestamp)) {
         return false;
     }
     
-    // Load metadata and index if not already loaded
-    if (index_.empty()) {
-        std::ifstream in(file_path_, std::ios::binary);
-        if (!in.is_open()) return false;
-        
-        if (!read_metadata(in)) return false;
-        if (!read_bloom_filter(in)) return false;
-        if (!read_index(in)) return false;
-        
-        in.close();
+    size_t block_no = find_block(*index, timestamp);
+    if (block_no >= index->block_index.size() ||
+        index->block_index[block_no].min_timestamp > timestamp) {
+        return false;
     }
     
-    // Binary search in index
-    auto it = std::lower_bound(index_.begin(), index_.end(), timestamp,
-        [](const IndexEntry& entry, int64_t ts) {
-            return entry.timestamp < ts;
-        });
+    std::ifstream in;
+    std::vector<uint8_t> scratch;
+    auto points = load_block(in, scratch, *index, block_no);
+    if (!points) return false;
     
-    if (it == index_.end() || it->timestamp != timestamp) {
+    auto it = std::lower_bound(points->begin(), points->end(), timestamp,
+        [](const TimeSeriesData& point, int64_t ts) {
+            return point.timestamp < ts;
+        });
+    if (it == points->end() || it->timestamp != timestamp) {
         return false;
     }
-    
-    // Read data at offset
-    std::ifstream in(file_path_, std::ios::binary);
-    if (!in.is_open()) return false;
-    
-    return read_data_at(in, it->offset, it->size, data);
+    data = *it;
+    return true;
 }
 
 std::vector<TimeSeriesData> SSTable::range_query(int64_t start_time, int64_t end_time) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    
     std::vector<TimeSeriesData> result;
     
-    // Load index if not already loaded
-    if (index_.empty()) {
-        std::ifstream in(file_path_, std::ios::binary);
-        if (!in.is_open()) return result;
-        
-        if (!read_metadata(in)) return result;
-        if (!read_bloom_filter(in)) return result;
-        if (!read_index(in)) return result;
-        
-        in.close();
-    }
-    
-    // Find range in index
-    auto it_start = std::lower_bound(index_.begin(), index_.end(), start_time,
-        [](const IndexEntry& entry, int64_t ts) {
-            return entry.timestamp < ts;
-        });
-    
-    auto it_end = std::upper_bound(index_.begin(), index_.end(), end_time,
-        [](int64_t ts, const IndexEntry& entry) {
-            return ts < entry.timestamp;
-        });
+    auto index = index_block();
+    if (!index) return result;
     
-    // Read all entries in range
-    std::ifstream in(file_path_, std::ios::binary);
-    if (!in.is_open()) return result;
+    std::ifstream in;
+    std::vector<uint8_t> scratch;
     
-    for (auto it = it_start; it != it_end; ++it) {
-        TimeSeriesData data;
-        if (read_data_at(in, it->offset, it->size, data)) {
-            result.push_back(data);
+    const auto& blocks = index->block_index;
+    for (size_t block_no = find_block(*index, start_time);
+         block_no < blocks.size() && blocks[block_no].min_timestamp <= end_time;
+         ++block_no) {
+        auto points = load_block(in, scratch, *index, block_no);
+        if (!points) {
+            break;
         }
+        
+        auto first = std::lower_bound(points->begin(), points->end(), start_time,
+            [](const TimeSeriesData& point, int64_t ts) {
+                return point.timestamp < ts;
+            });
+        auto last = std::upper_bound(first, points->end(), end_time,
+            [](int64_t ts, const TimeSeriesData& point) {
+                return ts < point.timestamp;
+            });
+        result.insert(result.end(), first, last);
     }
     
-    in.close();
     return result;
 }
 
@@ -590,13 +2038,28 @@ bool SSTable::might_contain(int64_t timestamp) {
         return false;
     }
     
-    if (bloom_filter_) {
-        return bloom_filter_->might_contain(timestamp);
+    auto index = index_block();
+    if (index && index->bloom_filter) {
+        return index->bloom_filter->might_contain(timestamp);
     }
     
     return true;
 }
 
+bool SSTable::might_match(const std::vector<uint64_t>& keys) {
+    auto index = index_block();
+    return !index || index->key_filter.might_contain_all(keys);
+}
+
+std::vector<uint64_t> SSTable::filter_keys_for(const Tags& tags) {
+    std::vector<uint64_t> keys;
+    keys.reserve(tags.size());
+    for (const auto& [key, value] : tags) {
+        keys.push_back(BlockedBloomFilter::tag_key(key, value));
+    }
+    return keys;
+}
+
 size_t SSTable::get_file_size() const {
     if (fs::exists(file_path_)) {
         return fs::file_size(file_path_);
@@ -609,135 +2072,254 @@ bool SSTable::write_metadata(std::ofstream& out) {
     return out.good();
 }
 
-bool SSTable::read_metadata(std::ifstream& in) {
-    in.seekg(0);
-    in.read(reinterpret_cast<char*>(&metadata_), sizeof(metadata_));
-    return in.good() && metadata_.magic_number == 0x53535442;
+bool SSTable::read_metadata(const uint8_t* ptr, size_t size, Metadata& metadata) const {
+    if (size < sizeof(metadata)) return false;
+    std::memcpy(&metadata, ptr, sizeof(metadata));
+    return metadata.magic_number == 0x53535442 &&
+           (metadata.version == kRowFormatVersion ||
+            metadata.version == kColumnarFormatVersion);
 }
 
-bool SSTable::read_bloom_filter(std::ifstream& in) {
-    in.seekg(metadata_.bloom_filter_offset);
-    
-    if (!bloom_filter_) {
-        bloom_filter_ = std::make_unique<BloomFilter>(100, 3);
+bool SSTable::read_bloom_filter(const uint8_t* ptr, size_t size, IndexBlock& block) {
+    if (!block.bloom_filter) {
+        block.bloom_filter = std::make_unique<BloomFilter>(100, 3);
     }
     
-    return bloom_filter_->deserialize(in);
+    return block.bloom_filter->deserialize(ptr, size);
 }
 
-bool SSTable::read_index(std::ifstream& in) {
-    in.seekg(metadata_.index_offset);
+bool SSTable::read_index(const uint8_t* ptr, size_t size, IndexBlock& block) {
+    const uint8_t* end = ptr + size;
+    auto read = [&](auto& value) {
+        if (static_cast<size_t>(end - ptr) < sizeof(value)) return false;
+        std::memcpy(&value, ptr, sizeof(value));
+        ptr += sizeof(value);
+        return true;
+    };
+    
+    if (metadata_.version == kColumnarFormatVersion) {
+        uint64_t num_blocks;
+        if (!read(num_blocks)) return false;
+        
+        block.block_index.clear();
+        block.block_index.reserve(num_blocks);
+        for (uint64_t i = 0; i < num_blocks; ++i) {
+            BlockIndexEntry entry;
+            if (!read(entry.min_timestamp) || !read(entry.max_timestamp) ||
+                !read(entry.offset) || !read(entry.size) || !read(entry.num_points)) {
+                return false;
+            }
+            block.block_index.push_back(entry);
+        }
+        return true;
+    }
     
-    index_.clear();
-    index_.reserve(metadata_.num_entries);
+    // v1 stores one entry per row; keep only one per kRowBlockPoints rows
+    block.block_index.clear();
+    block.block_index.reserve((metadata_.num_entries + kRowBlockPoints - 1) / kRowBlockPoints);
     
     for (uint64_t i = 0; i < metadata_.num_entries; ++i) {
         IndexEntry entry;
-        in.read(reinterpret_cast<char*>(&entry.timestamp), sizeof(entry.timestamp));
-        in.read(reinterpret_cast<char*>(&entry.offset), sizeof(entry.offset));
-        in.read(reinterpret_cast<char*>(&entry.size), sizeof(entry.size));
-        
-        if (!in) return false;
-        index_.push_back(entry);
+        if (!read(entry.timestamp) || !read(entry.offset) || !read(entry.size)) {
+            return false;
+        }
+        append_sparse_row(block.block_index, entry, i);
     }
     
     return true;
 }
 
-bool SSTable::read_data_at(std::ifstream& in, uint64_t offset, uint32_t size, TimeSeriesData& data) {
-    in.seekg(offset);
+void SSTable::append_sparse_row(std::vector<BlockIndexEntry>& blocks, const IndexEntry& row,
+                                size_t row_no) {
+    if (row_no % kRowBlockPoints == 0) {
+        blocks.push_back(BlockIndexEntry{row.timestamp, row.timestamp, row.offset, 0, 0});
+    }
+    
+    auto& block = blocks.back();
+    block.max_timestamp = row.timestamp;
+    block.size = static_cast<uint32_t>(row.offset + row.size - block.offset);
+    block.num_points++;
+}
+
+bool SSTable::read_data_at(const uint8_t*& ptr, const uint8_t* end, TimeSeriesData& data) const {
+    auto read = [&](auto& value) {
+        if (static_cast<size_t>(end - ptr) < sizeof(value)) return false;
+        std::memcpy(&value, ptr, sizeof(value));
+        ptr += sizeof(value);
+        return true;
+    };
+    auto read_string = [&](std::string& str) {
+        uint32_t len;
+        if (!read(len) || static_cast<size_t>(end - ptr) < len) return false;
+        str.assign(reinterpret_cast<const char*>(ptr), len);
+        ptr += len;
+        return true;
+    };
     
     // Read timestamp
-    int64_t timestamp;
-    in.read(reinterpret_cast<char*>(&timestamp), sizeof(timestamp));
-    if (!in) return false;
-    data.timestamp = timestamp;
+    if (!read(data.timestamp)) return false;
     
     // Read value type
     uint8_t value_type;
-    in.read(reinterpret_cast<char*>(&value_type), sizeof(value_type));
-    if (!in) return false;
+    if (!read(value_type)) return false;
+    bool typed_fields = (value_type & kWalTypedFieldsFlag) != 0;
+    value_type &= ~kWalTypedFieldsFlag;
     
     // Read value
     if (value_type == 0) {
         double val;
-        in.read(reinterpret_cast<char*>(&val), sizeof(val));
-        if (!in) return false;
+        if (!read(val)) return false;
         data.value = val;
     } else {
         uint64_t vec_size;
-        in.read(reinterpret_cast<char*>(&vec_size), sizeof(vec_size));
-        if (!in) return false;
+        if (!read(vec_size)) return false;
+        if (static_cast<size_t>(end - ptr) / sizeof(double) < vec_size) return false;
         
         std::vector<double> vec(vec_size);
-        in.read(reinterpret_cast<char*>(vec.data()), vec_size * sizeof(double));
-        if (!in) return false;
-        data.value = vec;
+        std::memcpy(vec.data(), ptr, vec_size * sizeof(double));
+        ptr += vec_size * sizeof(double);
+        data.value = std::move(vec);
     }
     
     // Read tags
     uint32_t num_tags;
-    in.read(reinterpret_cast<char*>(&num_tags), sizeof(num_tags));
-    if (!in) return false;
+    if (!read(num_tags)) return false;
     
     for (uint32_t i = 0; i < num_tags; ++i) {
-        uint32_t key_len, val_len;
-        in.read(reinterpret_cast<char*>(&key_len), sizeof(key_len));
-        if (!in) return false;
-        
-        std::string key(key_len, '\0');
-        in.read(&key[0], key_len);
-        if (!in) return false;
-        
-        in.read(reinterpret_cast<char*>(&val_len), sizeof(val_len));
-        if (!in) return false;
-        
-        std::string value(val_len, '\0');
-        in.read(&value[0], val_len);
-        if (!in) return false;
-        
-        data.tags[key] = value;
+        std::string key, value;
+        if (!read_string(key) || !read_string(value)) return false;
+        data.tags[key] = std::move(value);
     }
     
     // Read fields
+    if (typed_fields) {
+        return deserialize_fields(ptr, end, data.fields);
+    }
     uint32_t num_fields;
-    in.read(reinterpret_cast<char*>(&num_fields), sizeof(num_fields));
-    if (!in) return false;
+    if (!read(num_fields)) return false;
     
     for (uint32_t i = 0; i < num_fields; ++i) {
-        uint32_t key_len, val_len;
-        in.read(reinterpret_cast<char*>(&key_len), sizeof(key_len));
-        if (!in) return false;
-        
-        std::string key(key_len, '\0');
-        in.read(&key[0], key_len);
-        if (!in) return false;
-        
-        in.read(reinterpret_cast<char*>(&val_len), sizeof(val_len));
-        if (!in) return false;
-        
-        std::string value(val_len, '\0');
-        in.read(&value[0], val_len);
-        if (!in) return false;
-        
-        data.fields[key] = value;
+        std::string key, value;
+        if (!read_string(key) || !read_string(value)) return false;
+        data.fields[key] = std::move(value);
     }
     
     return true;
 }
 
 bool SSTable::build_from_sstables(const std::vector<std::shared_ptr<SSTable>>& sstables) {
-    // Merge multiple SSTables into one
-    std::map<int64_t, TimeSeriesData> merged_data;
-    
-    for (const auto& sstable : sstables) {
-        auto range_data = sstable->range_query(INT64_MIN, INT64_MAX);
-        for (const auto& data : range_data) {
-            merged_data[data.timestamp] = data;
+    // Stream-merge the inputs; newer versions win
+    if (!begin_build()) {
+        return false;
+    }
+    for (MergingIterator it(sstables); it.valid(); it.next()) {
+        if (!add(it.value())) {
+            return false;
         }
     }
-    
-    return build_from_memtable(merged_data);
+    return finish_build();
+}
+
+// ============================================================================
+// MergingIterator Implementation
+// ============================================================================
+
+MergingIterator::MergingIterator(const std::vector<std::shared_ptr<SSTable>>& sstables,
+                                 bool fill_cache, int64_t start_time, int64_t end_time)
+    : sstables_(sstables), end_time_(end_time) {
+    iters_.reserve(sstables_.size());
+    heap_.reserve(sstables_.size());
+    for (const auto& sstable : sstables_) {
+        iters_.push_back(sstable->new_iterator(fill_cache, start_time));
+        push(iters_.back().get(), sstable->get_sequence());
+    }
+}
+
+bool MergingIterator::heap_less(const Head& a, const Head& b) {
+    if (a.timestamp != b.timestamp) return a.timestamp < b.timestamp;
+    if (a.series_id != b.series_id) return a.series_id < b.series_id;
+    return a.sequence > b.sequence;
+}
+
+void MergingIterator::push(SSTable::Iterator* iter, uint64_t sequence) {
+    if (!iter->valid()) {
+        return;
+    }
+    const auto& point = iter->value();
+    heap_.push_back(Head{iter, point.timestamp, point.series_id(), sequence});
+    // std heap functions build a max-heap, so invert the order
+    std::push_heap(heap_.begin(), heap_.end(),
+                   [](const Head& a, const Head& b) { return heap_less(b, a); });
+}
+
+void MergingIterator::next() {
+    auto greater = [](const Head& a, const Head& b) { return heap_less(b, a); };
+    
+    // Advance the current head and every older version of the same point
+    Head top = heap_.front();
+    do {
+        std::pop_heap(heap_.begin(), heap_.end(), greater);
+        Head head = heap_.back();
+        heap_.pop_back();
+        head.iter->next();
+        push(head.iter, head.sequence);
+    } while (!heap_.empty() && heap_.front().timestamp == top.timestamp &&
+             heap_.front().series_id == top.series_id);
+}
+
+// ============================================================================
+// LSMTree::Iterator Implementation
+// ============================================================================
+
+bool LSMTree::Iterator::heap_greater(const Head& a, const Head& b) {
+    // std heap functions build a max-heap, so "greater" puts the smallest
+    // key, and the newest source within a key, at the front
+    if (a.timestamp != b.timestamp) return a.timestamp > b.timestamp;
+    if (a.series_id != b.series_id) return a.series_id > b.series_id;
+    return a.rank > b.rank;
+}
+
+void LSMTree::Iterator::add_source(std::unique_ptr<Source> source) {
+    size_t rank = sources_.size();
+    sources_.push_back(std::move(source));
+    push(sources_.back().get(), rank);
+}
+
+bool LSMTree::Iterator::matches(const TimeSeriesData& point) const {
+    for (const auto& [key, value] : filter_tags_) {
+        auto it = point.tags.find(key);
+        if (it == point.tags.end() || it->second != value) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void LSMTree::Iterator::push(Source* source, size_t rank) {
+    // Every version of a point has the same tags, so filtering before the
+    // merge cannot expose an older version
+    while (source->valid() && !filter_tags_.empty() && !matches(source->value())) {
+        source->next();
+    }
+    if (!source->valid()) {
+        return;
+    }
+    const auto& point = source->value();
+    heap_.push_back(Head{source, point.timestamp, point.series_id(), rank});
+    std::push_heap(heap_.begin(), heap_.end(), heap_greater);
+}
+
+void LSMTree::Iterator::next() {
+    // Advance the current head and every older version of the same point
+    Head top = heap_.front();
+    do {
+        std::pop_heap(heap_.begin(), heap_.end(), heap_greater);
+        Head head = heap_.back();
+        heap_.pop_back();
+        head.source->next();
+        push(head.source, head.rank);
+    } while (!heap_.empty() && heap_.front().timestamp == top.timestamp &&
+             heap_.front().series_id == top.series_id);
 }
 
 // ============================================================================
@@ -748,6 +2330,8 @@ LSMTree::LSMTree(const LSMConfig& config)
     : config_(config),
       running_(true),
       compaction_needed_(false),
+      delayed_writes_(config.delayed_write_rate),
+      cache_counters_(std::make_shared<BlockCacheCounters>()),
       next_sequence_(0) {
     
     // Create data directory
@@ -755,26 +2339,54 @@ LSMTree::LSMTree(const LSMConfig& config)
         fs::create_directories(config_.data_dir);
     }
     
+    // Series dictionary: MemTables and the WAL keep ids instead of tags.
+    // Without it points simply carry their tags.
+    series_catalog_ = std::make_shared<SeriesCatalog>();
+    if (!series_catalog_->open(config_.data_dir + "/SERIES")) {
+        std::cerr << "Series catalog unavailable, storing tags inline" << std::endl;
+        series_catalog_.reset();
+    }
+    
     // Initialize MemTable
-    active_memtable_ = std::make_unique<MemTable>(config_.memtable_size_bytes);
+    active_memtable_ = std::make_unique<MemTable>(config_.memtable_size_bytes, series_catalog_,
+                                                      config_.memory_tracker);
     
     // Initialize WAL
-    std::string wal_path = config_.data_dir + "/wal.log";
-    wal_ = std::make_unique<WriteAheadLog>(wal_path);
+    if (config_.enable_wal) {
+        WalOptions wal_options;
+        wal_options.sync_mode = config_.wal_sync_mode;
+        wal_options.sync_interval_ms = config_.wal_sync_interval_ms;
+        wal_options.recovery_threads = config_.recovery_threads;
+        wal_options.catalog = series_catalog_;
+        wal_ = std::make_unique<WriteAheadLog>(config_.data_dir + "/wal.log", wal_options);
+    }
     
     // Load existing SSTables
     load_existing_sstables();
+    apply_ttl();
     
-    // Start compaction thread
-    compaction_thread_ = std::thread(&LSMTree::compaction_worker, this);
+    // Start compaction pool
+    size_t num_threads = std::max<size_t>(1, config_.compaction_threads);
+    for (size_t i = 0; i < num_threads; ++i) {
+        compaction_threads_.emplace_back(&LSMTree::compaction_worker, this);
+    }
 }
 
 LSMTree::~LSMTree() {
-    running_ = false;
+    {
+        std::lock_guard<std::mutex> lock(compaction_mutex_);
+        running_ = false;
+    }
     compaction_cv_.notify_all();
+    {
+        std::lock_guard<std::mutex> lock(stall_mutex_);
+    }
+    stall_cv_.notify_all();
     
-    if (compaction_thread_.joinable()) {
-        compaction_thread_.join();
+    for (auto& thread : compaction_threads_) {
+        if (thread.joinable()) {
+            thread.join();
+        }
     }
     
     // Flush any remaining data
@@ -782,21 +2394,199 @@ LSMTree::~LSMTree() {
 }
 
 bool LSMTree::put(int64_t timestamp, const TimeSeriesData& data) {
-    std::lock_guard<std::mutex> lock(memtable_mutex_);
+    return put_point(timestamp, data);
+}
+
+bool LSMTree::put(int64_t timestamp, TimeSeriesData&& data) {
+    return put_point(timestamp, std::move(data));
+}
+
+template <typename Data>
+bool LSMTree::put_point(int64_t timestamp, Data&& data) {
+    maybe_stall_write(MemTable::estimate_size(data));
     
-    // Write to WAL first
-    if (!wal_->append(timestamp, data)) {
-        std::cerr << "Failed to write to WAL" << std::endl;
+    bool inserted;
+    {
+        // Shared: concurrent writers insert into the lock-free MemTable
+        std::shared_lock<std::shared_mutex> lock(memtable_mutex_);
+        
+        // Write to WAL first
+        if (wal_ && !wal_->append(timestamp, data)) {
+            std::cerr << "Failed to write to WAL" << std::endl;
+            return false;
+        }
+        
+        // A full MemTable leaves data as it was for put_after_switch
+        inserted = active_memtable_->put(timestamp, std::forward<Data>(data));
+    }
+    
+    if (!inserted && !put_after_switch(timestamp, data)) {
         return false;
     }
+    note_timestamp(timestamp);
+    
+    puts_.inc();
+    
+    return true;
+}
+
+bool LSMTree::put_batch(const std::vector<TimeSeriesData>& data_batch) {
+    return put_points(data_batch);
+}
+
+bool LSMTree::put_batch(std::vector<TimeSeriesData>&& data_batch) {
+    return put_points(data_batch);
+}
+
+template <typename Batch>
+bool LSMTree::put_points(Batch& data_batch) {
+    if (write_stall_.load(std::memory_order_acquire) != WriteStall::None) {
+        size_t batch_bytes = 0;
+        for (const auto& data : data_batch) {
+            batch_bytes += MemTable::estimate_size(data);
+        }
+        maybe_stall_write(batch_bytes);
+    }
+    
+    size_t next = 0;
+    while (next < data_batch.size()) {
+        {
+            std::shared_lock<std::shared_mutex> lock(memtable_mutex_);
+            
+            // One WAL group for the whole remainder of the batch
+            if (wal_ && !wal_->append_batch(data_batch, next)) {
+                std::cerr << "Failed to write to WAL" << std::endl;
+                return false;
+            }
+            
+            while (next < data_batch.size()) {
+                bool inserted;
+                if constexpr (std::is_const_v<Batch>) {
+                    inserted = active_memtable_->put(data_batch[next].timestamp, data_batch[next]);
+                } else {
+                    inserted = active_memtable_->put(data_batch[next].timestamp,
+                                                     std::move(data_batch[next]));
+                }
+                if (!inserted) {
+                    break;
+                }
+                ++next;
+            }
+        }
+        
+        if (next < data_batch.size()) {
+            if (!put_after_switch(data_batch[next].timestamp, data_batch[next])) {
+                return false;
+            }
+            ++next;
+        }
+    }
+    
+    int64_t newest = INT64_MIN;
+    for (const auto& data : data_batch) {
+        newest = std::max(newest, data.timestamp);
+    }
+    note_timestamp(newest);
+    
+    puts_.inc(data_batch.size());
+    return true;
+}
+
+void LSMTree::maybe_stall_write(size_t bytes) {
+    WriteStall state = write_stall_.load(std::memory_order_acquire);
+    if (state == WriteStall::None) {
+        return;
+    }
+    
+    auto started = std::chrono::steady_clock::now();
+    if (state == WriteStall::Stopped) {
+        write_stops_.fetch_add(1, std::memory_order_relaxed);
+        trigger_compaction();
+        
+        std::unique_lock<std::mutex> lock(stall_mutex_);
+        stall_cv_.wait(lock, [this] {
+            return write_stall_.load(std::memory_order_acquire) != WriteStall::Stopped ||
+                   !running_;
+        });
+    }
+    
+    if (write_stall_.load(std::memory_order_acquire) == WriteStall::Delayed) {
+        write_slowdowns_.fetch_add(1, std::memory_order_relaxed);
+        delayed_writes_.request(bytes);
+    }
+    
+    auto stalled = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - started);
+    write_stall_micros_.fetch_add(stalled.count(), std::memory_order_relaxed);
+}
+
+void LSMTree::update_write_stall() {
+    // Compaction debt: all of L0 once it is due, plus every level's excess
+    size_t level0_files = levels_[0].size();
+    uint64_t pending = 0;
+    if (level0_files >= config_.level0_file_num_compaction_trigger) {
+        for (const auto& sstable : levels_[0]) {
+            pending += sstable->get_file_size();
+        }
+    }
+    for (uint64_t level = 1; level + 1 < config_.max_levels; ++level) {
+        auto it = levels_.find(level);
+        if (it == levels_.end()) {
+            continue;
+        }
+        uint64_t level_size = 0;
+        for (const auto& sstable : it->second) {
+            level_size += sstable->get_file_size();
+        }
+        uint64_t max_size = (1ULL << level) * config_.level_size_multiplier * 1024 * 1024;
+        if (level_size > max_size) {
+            pending += level_size - max_size;
+        }
+    }
+    pending_compaction_bytes_.store(pending, std::memory_order_relaxed);
+    
+    // File counts for lock-free readers (metrics scrapes)
+    size_t files = 0;
+    uint64_t bytes = 0;
+    for (const auto& [level, sstables] : levels_) {
+        files += sstables.size();
+        for (const auto& sstable : sstables) {
+            bytes += sstable->get_file_size();
+        }
+    }
+    sstable_count_.store(files, std::memory_order_relaxed);
+    sstable_bytes_.store(bytes, std::memory_order_relaxed);
+    level0_files_.store(level0_files, std::memory_order_relaxed);
+    
+    auto over = [](uint64_t value, uint64_t limit) { return limit > 0 && value >= limit; };
+    WriteStall state = WriteStall::None;
+    if (over(level0_files, config_.level0_stop_writes_trigger) ||
+        over(pending, config_.hard_pending_compaction_bytes_limit)) {
+        state = WriteStall::Stopped;
+    } else if (over(level0_files, config_.level0_slowdown_writes_trigger) ||
+               over(pending, config_.soft_pending_compaction_bytes_limit)) {
+        state = WriteStall::Delayed;
+    }
     
-    // Try to insert into active MemTable
+    if (write_stall_.exchange(state, std::memory_order_acq_rel) == WriteStall::Stopped &&
+        state != WriteStall::Stopped) {
+        {
+            std::lock_guard<std::mutex> lock(stall_mutex_);
+        }
+        stall_cv_.notify_all();
+    }
+}
+
+bool LSMTree::put_after_switch(int64_t timestamp, const TimeSeriesData& data) {
+    std::unique_lock<std::shared_mutex> lock(memtable_mutex_);
+    
+    // Another writer may already have switched MemTables
     if (!active_memtable_->put(timestamp, data)) {
         // MemTable is full, need to flush
         immutable_memtable_ = std::move(active_memtable_);
-        active_memtable_ = std::make_unique<MemTable>(config_.memtable_size_bytes);
+        active_memtable_ = std::make_unique<MemTable>(config_.memtable_size_bytes,
+                                                      series_catalog_, config_.memory_tracker);
         
-        // Flush immutable MemTable in background
         flush_memtable_to_l0();
         
         // Try again with new MemTable
@@ -806,109 +2596,270 @@ bool LSMTree::put(int64_t timestamp, const TimeSeriesData& data) {
         }
     }
     
-    // Update statistics
-    {
-        std::lock_guard<std::mutex> stats_lock(stats_mutex_);
-        stats_.total_puts++;
-    }
-    
-    return true;
-}
-
-bool LSMTree::put_batch(const std::vector<TimeSeriesData>& data_batch) {
-    for (const auto& data : data_batch) {
-        if (!put(data.timestamp, data)) {
-            return false;
-        }
+    // Whoever flushed also cleared the WAL, which may have held this point
+    if (wal_ && !wal_->append(timestamp, data)) {
+        std::cerr << "Failed to write to WAL" << std::endl;
+        return false;
     }
     return true;
 }
 
 bool LSMTree::get(int64_t timestamp, TimeSeriesData& data) {
-    // Update statistics
-    {
-        std::lock_guard<std::mutex> stats_lock(stats_mutex_);
-        stats_.total_gets++;
+    gets_.inc();
+    
+    if (timestamp < retention_cutoff_.load(std::memory_order_acquire)) {
+        return false;
     }
     
     // Search in MemTables first
     if (search_in_memtables(timestamp, data)) {
-        std::lock_guard<std::mutex> stats_lock(stats_mutex_);
-        stats_.memtable_hits++;
+        memtable_hits_.inc();
         return true;
     }
     
     // Search in SSTables
     if (search_in_sstables(timestamp, data)) {
-        std::lock_guard<std::mutex> stats_lock(stats_mutex_);
-        stats_.sstable_hits++;
+        sstable_hits_.inc();
         return true;
     }
     
     return false;
 }
 
-std::vector<TimeSeriesData> LSMTree::range_query(int64_t start_time, int64_t end_time) {
+std::vector<TimeSeriesData> LSMTree::range_query(int64_t start_time, int64_t end_time,
+                                                 size_t limit) {
     std::vector<TimeSeriesData> result;
-    
-    // Query MemTables
+    for (auto it = new_iterator(start_time, end_time); it->valid(); it->next()) {
+        result.push_back(it->value());
+        if (limit != 0 && result.size() >= limit) {
+            break;
+        }
+    }
+    return result;
+}
+
+std::unique_ptr<LSMTree::Iterator> LSMTree::new_iterator(int64_t start_time, int64_t end_time,
+                                                         const Tags& filter_tags) {
+    return open_iterator(start_time, end_time, filter_tags, nullptr, false);
+}
+
+BlockSummary LSMTree::aggregate(int64_t start_time, int64_t end_time, const Tags& filter_tags,
+                                bool with_sketches) {
+    // Block summaries cover every series, so tag filters decode everything
+    BlockSummary summary;
+    BlockSummary decoded;
+    decoded.sketched = with_sketches;
+    auto it = open_iterator(start_time, end_time, filter_tags,
+                            filter_tags.empty() ? &summary : nullptr, with_sketches);
+    for (; it->valid(); it->next()) {
+        decoded.add(it->value());
+    }
+    summary.merge(decoded);
+    return summary;
+}
+
+std::unique_ptr<LSMTree::Iterator> LSMTree::open_iterator(int64_t start_time, int64_t end_time,
+                                                          const Tags& filter_tags,
+                                                          BlockSummary* summary,
+                                                          bool with_sketches) {
+    std::unique_ptr<Iterator> iter(new Iterator(end_time, filter_tags));
+    start_time = std::max(start_time, retention_cutoff_.load(std::memory_order_acquire));
+    if (start_time > end_time) {
+        return iter;
+    }
+    
+    // Sources are added newest first: active, immutable, then SSTables in
+    // level order. Taking the SSTable snapshot under the MemTable lock means
+    // a concurrent flush cannot move points between the two unseen.
+    std::vector<std::shared_ptr<SSTable>> sstables;
+    std::vector<std::unique_ptr<Iterator::Source>> memtable_sources;
     {
-        std::lock_guard<std::mutex> lock(memtable_mutex_);
+        std::shared_lock<std::shared_mutex> lock(memtable_mutex_);
+        
+        for (const MemTable* memtable : {active_memtable_.get(), immutable_memtable_.get()}) {
+            if (memtable && memtable->size() > 0) {
+                auto source = std::make_unique<Iterator::Source>();
+                source->points = memtable->range_query(start_time, end_time);
+                memtable_sources.push_back(std::move(source));
+            }
+        }
+        
+        sstables = snapshot_sstables();
+    }
+    
+    // SSTables are opened outside the lock; the snapshot keeps them alive
+    auto filter_keys = SSTable::filter_keys_for(filter_tags);
+    sstables.erase(std::remove_if(sstables.begin(), sstables.end(),
+        [&](const std::shared_ptr<SSTable>& sstable) {
+            return sstable->get_min_timestamp() > end_time ||
+                   sstable->get_max_timestamp() < start_time ||
+                   !sstable->might_match(filter_keys);
+        }), sstables.end());
+    
+    std::vector<std::vector<char>> skip_blocks(sstables.size());
+    if (summary) {
+        // A block run no other source overlaps holds the only version of each
+        // of its points, so its summary can stand in for decoding it
+        struct Interval {
+            int64_t min_timestamp;
+            int64_t max_timestamp;
+            size_t table;                   // sstables.size() for MemTables
+            SSTable::BlockSpan span;
+        };
+        std::vector<Interval> intervals;
+        for (const auto& source : memtable_sources) {
+            if (!source->points.empty()) {
+                intervals.push_back({source->points.front().timestamp,
+                                     source->points.back().timestamp, sstables.size(), {}});
+            }
+        }
+        for (size_t i = 0; i < sstables.size(); ++i) {
+            for (const auto& span : sstables[i]->block_spans(start_time, end_time, with_sketches)) {
+                intervals.push_back({span.min_timestamp, span.max_timestamp, i, span});
+            }
+        }
+        std::sort(intervals.begin(), intervals.end(),
+            [](const Interval& a, const Interval& b) { return a.min_timestamp < b.min_timestamp; });
         
-        auto active_results = active_memtable_->range_query(start_time, end_time);
-        merge_range_results(result, active_results);
+        uint64_t summarized = 0;
+        int64_t reach = INT64_MIN;          // Largest max_timestamp of earlier intervals
+        for (size_t k = 0; k < intervals.size(); ++k) {
+            const auto& interval = intervals[k];
+            bool isolated = (k == 0 || reach < interval.min_timestamp) &&
+                            (k + 1 == intervals.size() ||
+                             intervals[k + 1].min_timestamp > interval.max_timestamp);
+            reach = std::max(reach, interval.max_timestamp);
+            if (!isolated || interval.table == sstables.size() || !interval.span.has_summary ||
+                interval.min_timestamp < start_time || interval.max_timestamp > end_time) {
+                continue;
+            }
+            
+            summary->merge(interval.span.summary, with_sketches);
+            auto& skip = skip_blocks[interval.table];
+            skip.resize(std::max(skip.size(), interval.span.last_block + 1), 0);
+            std::fill(skip.begin() + interval.span.first_block,
+                      skip.begin() + interval.span.last_block + 1, 1);
+            summarized += interval.span.last_block - interval.span.first_block + 1;
+        }
         
-        if (immutable_memtable_) {
-            auto immutable_results = immutable_memtable_->range_query(start_time, end_time);
-            merge_range_results(result, immutable_results);
+        summarized_blocks_.inc(summarized);
+    }
+    
+    std::vector<std::vector<SSTable::BlockRead>> prefetched(sstables.size());
+    if (config_.async_reader && !sstables.empty()) {
+        // The merge needs the first block of every file before it yields
+        // anything, so fetch those of all files in one batch
+        std::vector<SSTable::BlockRead> reads;
+        for (size_t i = 0; i < sstables.size(); ++i) {
+            auto planned = sstables[i]->plan_block_reads(start_time, end_time, filter_keys,
+                                                         skip_blocks[i],
+                                                         std::max<size_t>(1, config_.readahead_blocks));
+            reads.insert(reads.end(), std::make_move_iterator(planned.begin()),
+                         std::make_move_iterator(planned.end()));
         }
-    }
-    
-    // Query SSTables
-    {
-        std::lock_guard<std::mutex> lock(sstable_mutex_);
+        SSTable::read_blocks(*config_.async_reader, reads);
         
-        for (const auto& [level, sstables] : levels_) {
-            for (const auto& sstable : sstables) {
-                if (sstable->get_min_timestamp() <= end_time && 
-                    sstable->get_max_timestamp() >= start_time) {
-                    auto sstable_results = sstable->range_query(start_time, end_time);
-                    merge_range_results(result, sstable_results);
-                }
+        size_t next = 0;
+        for (auto& read : reads) {
+            while (read.table != sstables[next].get()) {
+                ++next;
             }
+            prefetched[next].push_back(std::move(read));
         }
     }
     
-    return result;
+    for (auto& source : memtable_sources) {
+        iter->add_source(std::move(source));
+    }
+    for (size_t i = 0; i < sstables.size(); ++i) {
+        auto source = std::make_unique<Iterator::Source>();
+        source->table_iter = sstables[i]->new_iterator(true, start_time, end_time, filter_keys,
+                                                       std::move(skip_blocks[i]),
+                                                       std::move(prefetched[i]));
+        iter->add_source(std::move(source));
+        iter->sstables_.push_back(sstables[i]);
+    }
+    
+    return iter;
 }
 
 bool LSMTree::flush() {
-    std::lock_guard<std::mutex> lock(memtable_mutex_);
+    std::unique_lock<std::shared_mutex> lock(memtable_mutex_);
     
     if (active_memtable_->size() > 0) {
         immutable_memtable_ = std::move(active_memtable_);
-        active_memtable_ = std::make_unique<MemTable>(config_.memtable_size_bytes);
+        active_memtable_ = std::make_unique<MemTable>(config_.memtable_size_bytes,
+                                                      series_catalog_, config_.memory_tracker);
         
         flush_memtable_to_l0();
     }
     
-    return true;
+    return true;
+}
+
+bool LSMTree::ingest(const std::vector<TimeSeriesData>& points) {
+    if (points.empty()) {
+        return true;
+    }
+    SAGE_TSDB_TRACE_SCOPE_ARG("storage", "lsm.ingest", "points", points.size());
+    
+    std::vector<std::shared_ptr<SSTable>> outputs;
+    if (!write_partitioned(points, 0, outputs)) {
+        std::cerr << "Failed to ingest points into SSTable" << std::endl;
+        return false;
+    }
+    note_timestamp(points.back().timestamp);
+    
+    bool recorded;
+    {
+        std::lock_guard<std::mutex> lock(sstable_mutex_);
+        levels_[0].insert(levels_[0].end(), outputs.begin(), outputs.end());
+        update_write_stall();
+        recorded = write_manifest();
+        if (levels_[0].size() >= config_.level0_file_num_compaction_trigger) {
+            trigger_compaction();
+        }
+    }
+    if (!recorded) {
+        std::cerr << "Ingested SSTables missing from manifest" << std::endl;
+    }
+    apply_ttl();
+    
+    puts_.inc(points.size());
+    return recorded;
 }
 
 void LSMTree::trigger_compaction() {
-    compaction_needed_ = true;
-    compaction_cv_.notify_one();
+    // May be called with sstable_mutex_ held; workers never take
+    // sstable_mutex_ while holding compaction_mutex_
+    {
+        std::lock_guard<std::mutex> lock(compaction_mutex_);
+        compaction_needed_ = true;
+        compaction_generation_++;
+    }
+    compaction_cv_.notify_all();
 }
 
 void LSMTree::wait_for_compaction() {
     std::unique_lock<std::mutex> lock(compaction_mutex_);
-    compaction_cv_.wait(lock, [this] { return !compaction_needed_; });
+    compaction_cv_.wait(lock, [this] {
+        return !running_ || (!compaction_needed_ && running_compactions_ == 0);
+    });
 }
 
 LSMTree::Statistics LSMTree::get_statistics() const {
-    std::lock_guard<std::mutex> lock(stats_mutex_);
-    
-    Statistics stats = stats_;
+    Statistics stats;
+    stats.total_puts = puts_.value();
+    stats.total_gets = gets_.value();
+    stats.memtable_hits = memtable_hits_.value();
+    stats.sstable_hits = sstable_hits_.value();
+    stats.bloom_filter_rejections = bloom_filter_rejections_.value();
+    stats.compactions = compactions_.value();
+    stats.expired_sstables = expired_sstables_.value();
+    stats.expired_points = expired_points_.value();
+    stats.summarized_blocks = summarized_blocks_.value();
+    stats.block_cache_hits = cache_counters_->hits.load(std::memory_order_relaxed);
+    stats.block_cache_misses = cache_counters_->misses.load(std::memory_order_relaxed);
     
     // Update SSTable info
     std::lock_guard<std::mutex> sstable_lock(sstable_mutex_);
@@ -916,14 +2867,68 @@ LSMTree::Statistics LSMTree::get_statistics() const {
         stats.num_sstables += sstables.size();
         for (const auto& sstable : sstables) {
             stats.total_size_bytes += sstable->get_file_size();
+            stats.index_memory_bytes += sstable->get_index_memory_bytes();
+            stats.loaded_sstables += sstable->is_loaded() ? 1 : 0;
         }
     }
+    stats.level0_files = levels_.count(0) ? levels_.at(0).size() : 0;
+    stats.pending_compaction_bytes = pending_compaction_bytes_.load(std::memory_order_relaxed);
+    stats.write_stall_micros = write_stall_micros_.load(std::memory_order_relaxed);
+    stats.write_slowdowns = write_slowdowns_.load(std::memory_order_relaxed);
+    stats.write_stops = write_stops_.load(std::memory_order_relaxed);
     
     return stats;
 }
 
+std::vector<MetricsRegistry::Handle> LSMTree::register_metrics(MetricsRegistry& registry,
+                                                               const Tags& labels) const {
+    std::vector<MetricsRegistry::Handle> handles;
+    auto counter = [&](const char* name, const char* help, const Counter& value) {
+        handles.push_back(registry.addCounter(name, help, labels, [&value]() {
+            return static_cast<double>(value.value());
+        }));
+    };
+    auto atomic = [&](bool is_counter, const char* name, const char* help, const auto& value) {
+        auto read = [&value]() {
+            return static_cast<double>(value.load(std::memory_order_relaxed));
+        };
+        handles.push_back(is_counter ? registry.addCounter(name, help, labels, read)
+                                     : registry.addGauge(name, help, labels, read));
+    };
+    
+    counter("sage_tsdb_lsm_puts_total", "Points written to the LSM-Tree", puts_);
+    counter("sage_tsdb_lsm_gets_total", "Point lookups", gets_);
+    counter("sage_tsdb_lsm_memtable_hits_total", "Point lookups answered by a MemTable",
+            memtable_hits_);
+    counter("sage_tsdb_lsm_sstable_hits_total", "Point lookups answered by an SSTable",
+            sstable_hits_);
+    counter("sage_tsdb_lsm_bloom_filter_rejections_total", "SSTables skipped by their bloom filter",
+            bloom_filter_rejections_);
+    counter("sage_tsdb_lsm_compactions_total", "Completed compactions", compactions_);
+    counter("sage_tsdb_lsm_expired_sstables_total", "SSTables dropped by retention",
+            expired_sstables_);
+    counter("sage_tsdb_lsm_expired_points_total", "Points dropped by retention", expired_points_);
+    counter("sage_tsdb_lsm_summarized_blocks_total", "Blocks aggregated from their summaries",
+            summarized_blocks_);
+    atomic(true, "sage_tsdb_lsm_block_cache_hits_total", "Block cache hits", cache_counters_->hits);
+    atomic(true, "sage_tsdb_lsm_block_cache_misses_total", "Block cache misses",
+           cache_counters_->misses);
+    atomic(true, "sage_tsdb_lsm_write_stall_micros_total", "Time puts spent delayed or stopped",
+           write_stall_micros_);
+    atomic(true, "sage_tsdb_lsm_write_slowdowns_total", "Puts delayed by compaction debt",
+           write_slowdowns_);
+    atomic(true, "sage_tsdb_lsm_write_stops_total", "Puts that waited for compaction",
+           write_stops_);
+    atomic(false, "sage_tsdb_lsm_sstables", "SSTables in all levels", sstable_count_);
+    atomic(false, "sage_tsdb_lsm_sstable_bytes", "Size of all SSTables", sstable_bytes_);
+    atomic(false, "sage_tsdb_lsm_level0_files", "SSTables in level 0", level0_files_);
+    atomic(false, "sage_tsdb_lsm_pending_compaction_bytes", "Estimated compaction debt",
+           pending_compaction_bytes_);
+    return handles;
+}
+
 void LSMTree::clear_all() {
-    std::lock_guard<std::mutex> memtable_lock(memtable_mutex_);
+    std::unique_lock<std::shared_mutex> memtable_lock(memtable_mutex_);
     std::lock_guard<std::mutex> sstable_lock(sstable_mutex_);
     
     // Clear MemTables
@@ -931,7 +2936,9 @@ void LSMTree::clear_all() {
     immutable_memtable_.reset();
     
     // Clear WAL
-    wal_->clear();
+    if (wal_) {
+        wal_->clear();
+    }
     
     // Delete all SSTables
     for (auto& [level, sstables] : levels_) {
@@ -943,13 +2950,107 @@ void LSMTree::clear_all() {
         }
     }
     levels_.clear();
+    update_write_stall();
+    newest_timestamp_ = INT64_MIN;
+    retention_cutoff_ = INT64_MIN;
+    write_manifest();
     
     // Reset statistics
-    std::lock_guard<std::mutex> stats_lock(stats_mutex_);
-    stats_ = Statistics();
+    for (Counter* counter : {&puts_, &gets_, &memtable_hits_, &sstable_hits_,
+                             &bloom_filter_rejections_, &compactions_, &expired_sstables_,
+                             &expired_points_, &summarized_blocks_}) {
+        counter->reset();
+    }
+}
+
+bool LSMTree::create_checkpoint(const std::string& dir) {
+    std::error_code ec;
+    fs::create_directories(dir, ec);
+    if (ec || fs::exists(fs::path(dir) / "MANIFEST")) {
+        std::cerr << "Cannot create checkpoint in: " << dir << std::endl;
+        return false;
+    }
+    
+    // Flushing under the exclusive lock makes the checkpoint hold exactly
+    // the writes acknowledged so far
+    std::unique_lock<std::shared_mutex> memtable_lock(memtable_mutex_);
+    if (active_memtable_->size() > 0) {
+        immutable_memtable_ = std::move(active_memtable_);
+        active_memtable_ = std::make_unique<MemTable>(config_.memtable_size_bytes,
+                                                      series_catalog_, config_.memory_tracker);
+        flush_memtable_to_l0();
+    }
+    if (immutable_memtable_) {
+        std::cerr << "Checkpoint aborted: MemTable flush failed" << std::endl;
+        return false;
+    }
+    
+    // Files listed in levels_ are only unlinked after leaving it
+    std::lock_guard<std::mutex> sstable_lock(sstable_mutex_);
+    for (const auto& [level, sstables] : levels_) {
+        for (const auto& sstable : sstables) {
+            fs::path from = sstable->get_file_path();
+            if (!link_or_copy(from, fs::path(dir) / from.filename())) {
+                std::cerr << "Failed to add to checkpoint: " << from << std::endl;
+                return false;
+            }
+        }
+    }
+    // Written last: a checkpoint without a MANIFEST is incomplete
+    return write_manifest_to((fs::path(dir) / "MANIFEST").string());
+}
+
+bool LSMTree::restore_checkpoint(const std::string& dir) {
+    fs::path checkpoint_manifest = fs::path(dir) / "MANIFEST";
+    if (!fs::exists(checkpoint_manifest)) {
+        std::cerr << "Not a checkpoint: " << dir << std::endl;
+        return false;
+    }
+    
+    std::unique_lock<std::shared_mutex> memtable_lock(memtable_mutex_);
+    std::lock_guard<std::mutex> sstable_lock(sstable_mutex_);
+    
+    // Link the checkpoint's files in before switching manifests, so a crash
+    // leaves either the old file set or the checkpoint's. SSTables never
+    // change, so a file already present under the same name is kept.
+    for (const auto& entry : fs::directory_iterator(dir)) {
+        if (entry.path().extension() == ".sst" &&
+            !link_or_copy(entry.path(), fs::path(config_.data_dir) / entry.path().filename())) {
+            std::cerr << "Failed to restore from checkpoint: " << entry.path() << std::endl;
+            return false;
+        }
+    }
+    std::error_code ec;
+    std::string tmp_path = manifest_path() + ".tmp";
+    fs::copy_file(checkpoint_manifest, tmp_path, fs::copy_options::overwrite_existing, ec);
+    if (ec || std::rename(tmp_path.c_str(), manifest_path().c_str()) != 0) {
+        std::cerr << "Failed to restore manifest from: " << checkpoint_manifest << std::endl;
+        return false;
+    }
+    
+    // The checkpoint holds every point now; readers still holding the old
+    // tables keep their mappings
+    active_memtable_->clear();
+    immutable_memtable_.reset();
+    if (wal_) {
+        wal_->clear();
+    }
+    levels_.clear();
+    newest_timestamp_ = INT64_MIN;
+    retention_cutoff_ = INT64_MIN;
+    
+    // Unlinks the files the checkpoint does not list
+    bool ok = load_manifest();
+    index_loaded_sstables();
+    update_write_stall();
+    return write_manifest() && ok;
 }
 
 bool LSMTree::recover_from_wal() {
+    if (!wal_) {
+        return true;
+    }
+    
     auto recovered_data = wal_->recover();
     
     if (recovered_data.empty()) {
@@ -957,13 +3058,37 @@ bool LSMTree::recover_from_wal() {
     }
     
     std::cout << "Recovering " << recovered_data.size() << " entries from WAL" << std::endl;
+    for (const auto& data : recovered_data) {
+        note_timestamp(data.timestamp);
+    }
+    
+    // Replay in log order segments on several threads; sequences follow the
+    // log, so the last version of a point wins whichever thread inserts
+    // first. The records stay in the WAL until the MemTable is flushed.
+    std::shared_lock<std::shared_mutex> lock(memtable_mutex_);
+    uint64_t first_sequence = active_memtable_->reserve_sequences(recovered_data.size());
+    
+    constexpr size_t kMinEntriesPerThread = 16384;
+    size_t num_threads = std::clamp<size_t>(recovered_data.size() / kMinEntriesPerThread, 1,
+                                            std::max<size_t>(1, config_.recovery_threads));
+    size_t per_thread = (recovered_data.size() + num_threads - 1) / num_threads;
+    auto replay = [&](size_t part) {
+        size_t begin = part * per_thread;
+        size_t end = std::min(recovered_data.size(), begin + per_thread);
+        for (size_t i = begin; i < end; ++i) {
+            const auto& data = recovered_data[i];
+            active_memtable_->put(data.timestamp, data, first_sequence + i);
+        }
+    };
     
-    for (const auto& [timestamp, data] : recovered_data) {
-        active_memtable_->put(timestamp, data);
+    std::vector<std::thread> workers;
+    for (size_t part = 1; part < num_threads; ++part) {
+        workers.emplace_back(replay, part);
+    }
+    replay(0);
+    for (auto& worker : workers) {
+        worker.join();
     }
-    
-    // Clear WAL after recovery
-    wal_->clear();
     
     return true;
 }
@@ -971,98 +3096,289 @@ bool LSMTree::recover_from_wal() {
 // Private methods
 
 void LSMTree::compaction_worker() {
-    while (running_) {
-        std::unique_lock<std::mutex> lock(compaction_mutex_);
-        compaction_cv_.wait_for(lock, std::chrono::seconds(1), 
-            [this] { return compaction_needed_.load() || !running_.load(); });
+    uint64_t seen_generation = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(compaction_mutex_);
+            compaction_cv_.wait(lock, [&] {
+                return !running_ ||
+                       (compaction_needed_ && compaction_generation_ != seen_generation);
+            });
+            if (!running_) break;
+            seen_generation = compaction_generation_;
+            running_compactions_++;
+        }
         
-        if (!running_) break;
+        bool did_work = run_one_compaction();
         
-        if (compaction_needed_) {
-            // Check level 0
-            {
-                std::lock_guard<std::mutex> sstable_lock(sstable_mutex_);
-                if (levels_[0].size() >= config_.level0_file_num_compaction_trigger) {
-                    compact_level(0);
-                }
+        {
+            std::lock_guard<std::mutex> lock(compaction_mutex_);
+            running_compactions_--;
+            if (did_work) {
+                // Outputs may push the next level over its limit
+                compaction_generation_++;
+            } else if (running_compactions_ == 0 && compaction_generation_ == seen_generation) {
+                compaction_needed_ = false;
             }
-            
-            // Check other levels
-            for (uint64_t level = 1; level < config_.max_levels - 1; ++level) {
-                std::lock_guard<std::mutex> sstable_lock(sstable_mutex_);
-                size_t level_size = 0;
-                for (const auto& sstable : levels_[level]) {
-                    level_size += sstable->get_file_size();
-                }
-                
-                size_t max_size = (1ULL << level) * config_.level_size_multiplier * 1024 * 1024;
-                if (level_size > max_size) {
-                    compact_level(level);
-                }
+        }
+        compaction_cv_.notify_all();
+    }
+}
+
+bool LSMTree::run_one_compaction() {
+    CompactionJob job;
+    {
+        std::lock_guard<std::mutex> sstable_lock(sstable_mutex_);
+        if (!pick_compaction(job)) {
+            return false;
+        }
+    }
+    SAGE_TSDB_TRACE_SCOPE_ARG("storage", "lsm.compaction", "level", job.level);
+    
+    // Merge without holding sstable_mutex_, so flushes and reads carry on
+    std::vector<std::shared_ptr<SSTable>> outputs;
+    SAGE_TSDB_TRACE_BEGIN(merge_span, "storage", "lsm.merge");
+    SAGE_TSDB_TRACE_SET_ARG(merge_span, "inputs", job.inputs.size());
+    bool ok = merge_sstables(job.inputs, job.level + 1, outputs);
+    SAGE_TSDB_TRACE_END(merge_span);
+    
+    bool recorded = false;
+    bool superseded = false;
+    {
+        std::lock_guard<std::mutex> sstable_lock(sstable_mutex_);
+        // clear_all() or restore_checkpoint() may have replaced the inputs
+        // meanwhile; their paths can name restored files by now
+        auto& source = levels_[job.level];
+        for (const auto& sstable : job.inputs) {
+            if (std::find(source.begin(), source.end(), sstable) == source.end()) {
+                superseded = true;
+            }
+        }
+        if (ok && !superseded) {
+            for (const auto& sstable : job.inputs) {
+                source.erase(std::remove(source.begin(), source.end(), sstable), source.end());
+            }
+            auto& target = levels_[job.level + 1];
+            target.insert(target.end(), outputs.begin(), outputs.end());
+            update_write_stall();
+            recorded = write_manifest();
+        }
+        busy_levels_.erase(job.level);
+        busy_levels_.erase(job.level + 1);
+    }
+    
+    if (!ok) {
+        std::cerr << "Compaction of level " << job.level << " failed" << std::endl;
+        return false;
+    }
+    if (superseded) {
+        for (const auto& sstable : outputs) {
+            fs::remove(sstable->get_file_path());
+        }
+        return false;
+    }
+    
+    // Until a manifest without them is on disk, a restart still needs the
+    // inputs (the outputs are then discarded as leftovers)
+    if (!recorded) {
+        std::cerr << "Keeping compaction inputs: manifest write failed" << std::endl;
+        return false;
+    }
+    
+    // Readers still holding the old tables keep their mappings
+    for (const auto& sstable : job.inputs) {
+        std::string file_path = sstable->get_file_path();
+        if (fs::exists(file_path)) {
+            fs::remove(file_path);
+        }
+    }
+    
+    compactions_.inc();
+    
+    // Expired files of the levels just compacted were skipped while busy
+    apply_ttl();
+    return true;
+}
+
+bool LSMTree::pick_compaction(CompactionJob& job) {
+    auto available = [this](uint64_t level) {
+        return !busy_levels_.count(level) && !busy_levels_.count(level + 1);
+    };
+    
+    // Check level 0
+    if (available(0) && levels_[0].size() >= config_.level0_file_num_compaction_trigger) {
+        job.level = 0;
+    } else {
+        // Check other levels
+        bool found = false;
+        for (uint64_t level = 1; level + 1 < config_.max_levels && !found; ++level) {
+            if (!available(level)) {
+                continue;
+            }
+            size_t level_size = 0;
+            for (const auto& sstable : levels_[level]) {
+                level_size += sstable->get_file_size();
             }
             
-            compaction_needed_ = false;
-            
-            // Update statistics
-            std::lock_guard<std::mutex> stats_lock(stats_mutex_);
-            stats_.compactions++;
+            size_t max_size = (1ULL << level) * config_.level_size_multiplier * 1024 * 1024;
+            if (level_size > max_size) {
+                job.level = level;
+                found = true;
+            }
+        }
+        if (!found) {
+            return false;
         }
     }
+    
+    job.inputs = select_sstables_for_compaction(job.level);
+    if (job.inputs.empty()) {
+        return false;
+    }
+    busy_levels_.insert(job.level);
+    busy_levels_.insert(job.level + 1);
+    return true;
 }
 
 void LSMTree::flush_memtable_to_l0() {
     if (!immutable_memtable_ || immutable_memtable_->size() == 0) {
         return;
     }
+    SAGE_TSDB_TRACE_SCOPE_ARG("storage", "lsm.flush", "points", immutable_memtable_->size());
     
-    // Create new SSTable
-    uint64_t sequence = next_sequence_++;
-    std::string sstable_path = generate_sstable_path(0, sequence);
-    
-    auto sstable = std::make_shared<SSTable>(sstable_path, 0, sequence);
-    
-    if (sstable->build_from_memtable(immutable_memtable_->get_all())) {
-        std::lock_guard<std::mutex> lock(sstable_mutex_);
-        levels_[0].push_back(sstable);
-        
-        // Clear WAL after successful flush
-        wal_->clear();
-        
-        // Reset immutable MemTable
-        immutable_memtable_.reset();
-        
-        // Trigger compaction if needed
-        if (levels_[0].size() >= config_.level0_file_num_compaction_trigger) {
-            trigger_compaction();
+    // Create new SSTables, one per time partition
+    std::vector<std::shared_ptr<SSTable>> outputs;
+    if (write_partitioned(immutable_memtable_->get_all(), 0, outputs)) {
+        {
+            std::lock_guard<std::mutex> lock(sstable_mutex_);
+            levels_[0].insert(levels_[0].end(), outputs.begin(), outputs.end());
+            update_write_stall();
+            
+            // Clear WAL once the new files are recorded; without the manifest
+            // entries they would be deleted as leftovers on restart
+            if (!write_manifest()) {
+                std::cerr << "Keeping WAL after flush: manifest write failed" << std::endl;
+            } else if (wal_) {
+                wal_->clear();
+            }
+            
+            // Reset immutable MemTable
+            immutable_memtable_.reset();
+            
+            // Trigger compaction if needed
+            if (levels_[0].size() >= config_.level0_file_num_compaction_trigger) {
+                trigger_compaction();
+            }
         }
+        apply_ttl();
     } else {
         std::cerr << "Failed to flush MemTable to SSTable" << std::endl;
     }
 }
 
-void LSMTree::compact_level(uint64_t level) {
-    auto sstables = select_sstables_for_compaction(level);
-    
-    if (sstables.empty()) {
+bool LSMTree::write_partitioned(const std::vector<TimeSeriesData>& points, uint64_t level,
+                                std::vector<std::shared_ptr<SSTable>>& outputs) {
+    size_t begin = 0;
+    while (begin < points.size()) {
+        size_t end = begin + 1;
+        if (config_.partition_duration > 0) {
+            int64_t partition = partition_of(points[begin].timestamp);
+            while (end < points.size() && partition_of(points[end].timestamp) == partition) {
+                ++end;
+            }
+        } else {
+            end = points.size();
+        }
+        
+        uint64_t sequence = next_sequence_++;
+        auto sstable = std::make_shared<SSTable>(generate_sstable_path(level, sequence),
+                                                 level, sequence, sstable_options());
+        bool ok = sstable->begin_build(end - begin);
+        for (size_t i = begin; ok && i < end; ++i) {
+            ok = sstable->add(points[i]);
+        }
+        if (!ok || !sstable->finish_build()) {
+            fs::remove(sstable->get_file_path());
+            for (const auto& output : outputs) {
+                fs::remove(output->get_file_path());
+            }
+            outputs.clear();
+            return false;
+        }
+        outputs.push_back(std::move(sstable));
+        begin = end;
+    }
+    return !outputs.empty();
+}
+
+int64_t LSMTree::partition_of(int64_t timestamp) const {
+    int64_t duration = config_.partition_duration;
+    if (duration <= 0) {
+        return 0;
+    }
+    // Floor division, so negative timestamps get their own partitions
+    int64_t partition = timestamp / duration;
+    return (timestamp % duration < 0) ? partition - 1 : partition;
+}
+
+void LSMTree::note_timestamp(int64_t timestamp) {
+    int64_t newest = newest_timestamp_.load(std::memory_order_relaxed);
+    while (timestamp > newest &&
+           !newest_timestamp_.compare_exchange_weak(newest, timestamp,
+                                                    std::memory_order_relaxed)) {
+    }
+}
+
+void LSMTree::apply_ttl() {
+    int64_t newest = newest_timestamp_.load(std::memory_order_relaxed);
+    if (config_.ttl <= 0 || newest < INT64_MIN + config_.ttl) {
         return;
     }
+    drop_before(newest - config_.ttl);
+}
+
+size_t LSMTree::drop_before(int64_t cutoff) {
+    // Hide the range first, so readers never see it partly dropped
+    int64_t current = retention_cutoff_.load(std::memory_order_relaxed);
+    while (cutoff > current &&
+           !retention_cutoff_.compare_exchange_weak(current, cutoff, std::memory_order_acq_rel)) {
+    }
     
-    merge_sstables(sstables, level + 1);
-    
-    // Remove old SSTables
-    for (const auto& sstable : sstables) {
-        auto& level_sstables = levels_[level];
-        level_sstables.erase(
-            std::remove(level_sstables.begin(), level_sstables.end(), sstable),
-            level_sstables.end()
-        );
+    std::vector<std::shared_ptr<SSTable>> dropped;
+    {
+        std::lock_guard<std::mutex> lock(sstable_mutex_);
+        for (auto& [level, sstables] : levels_) {
+            if (busy_levels_.count(level)) {
+                continue;
+            }
+            auto expired = [cutoff](const std::shared_ptr<SSTable>& sstable) {
+                return sstable->get_max_timestamp() < cutoff;
+            };
+            std::copy_if(sstables.begin(), sstables.end(), std::back_inserter(dropped), expired);
+            sstables.erase(std::remove_if(sstables.begin(), sstables.end(), expired),
+                           sstables.end());
+        }
+        if (dropped.empty()) {
+            return 0;
+        }
+        update_write_stall();
         
-        // Delete file
-        std::string file_path = sstable->get_file_path();
-        if (fs::exists(file_path)) {
-            fs::remove(file_path);
+        // The cutoff in the manifest keeps the files hidden if unlinking fails
+        if (!write_manifest()) {
+            std::cerr << "Keeping expired SSTables: manifest write failed" << std::endl;
+            return 0;
         }
     }
+    
+    size_t points = 0;
+    for (const auto& sstable : dropped) {
+        points += sstable->get_num_entries();
+        fs::remove(sstable->get_file_path());
+    }
+    
+    expired_sstables_.inc(dropped.size());
+    expired_points_.inc(points);
+    return points;
 }
 
 std::vector<std::shared_ptr<SSTable>> LSMTree::select_sstables_for_compaction(uint64_t level) {
@@ -1087,23 +3403,130 @@ std::vector<std::shared_ptr<SSTable>> LSMTree::select_sstables_for_compaction(ui
 }
 
 bool LSMTree::merge_sstables(const std::vector<std::shared_ptr<SSTable>>& sstables, 
-                             uint64_t target_level) {
+                             uint64_t target_level,
+                             std::vector<std::shared_ptr<SSTable>>& outputs) {
     if (sstables.empty()) {
         return false;
     }
     
-    // Create new SSTable
-    uint64_t sequence = next_sequence_++;
-    std::string sstable_path = generate_sstable_path(target_level, sequence);
+    auto ranges = plan_subcompactions(sstables);
+    if (ranges.size() == 1) {
+        return merge_range(sstables, target_level, ranges[0].first, ranges[0].second, outputs);
+    }
+    
+    // Subcompactions cover disjoint time ranges, so their outputs never overlap
+    std::vector<std::vector<std::shared_ptr<SSTable>>> parts(ranges.size());
+    std::vector<char> results(ranges.size(), 0);
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < ranges.size(); ++i) {
+        workers.emplace_back([&, i]() {
+            results[i] = merge_range(sstables, target_level, ranges[i].first, ranges[i].second,
+                                     parts[i]);
+        });
+    }
+    results[0] = merge_range(sstables, target_level, ranges[0].first, ranges[0].second, parts[0]);
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    
+    bool ok = std::all_of(results.begin(), results.end(), [](char r) { return r != 0; });
+    for (auto& part : parts) {
+        for (auto& output : part) {
+            if (ok) {
+                outputs.push_back(std::move(output));
+            } else {
+                fs::remove(output->get_file_path());
+            }
+        }
+    }
+    return ok && !outputs.empty();
+}
+
+std::vector<std::pair<int64_t, int64_t>> LSMTree::plan_subcompactions(
+    const std::vector<std::shared_ptr<SSTable>>& sstables) const {
+    std::vector<std::pair<int64_t, int64_t>> ranges;
     
-    auto new_sstable = std::make_shared<SSTable>(sstable_path, target_level, sequence);
+    size_t total_bytes = 0;
+    for (const auto& sstable : sstables) {
+        total_bytes += sstable->get_file_size();
+    }
+    size_t target = std::max<size_t>(1, config_.target_file_size_bytes);
+    size_t num_ranges = std::min(std::max<size_t>(1, config_.max_subcompactions),
+                                 std::max<size_t>(1, total_bytes / target));
     
-    if (new_sstable->build_from_sstables(sstables)) {
-        levels_[target_level].push_back(new_sstable);
-        return true;
+    // Cut at block starts so each range begins on a timestamp boundary
+    std::vector<int64_t> boundaries;
+    if (num_ranges > 1) {
+        for (const auto& sstable : sstables) {
+            auto blocks = sstable->get_block_boundaries();
+            boundaries.insert(boundaries.end(), blocks.begin(), blocks.end());
+        }
+        std::sort(boundaries.begin(), boundaries.end());
+        boundaries.erase(std::unique(boundaries.begin(), boundaries.end()), boundaries.end());
     }
     
-    return false;
+    int64_t start = INT64_MIN;
+    for (size_t i = 1; i < num_ranges && boundaries.size() > 1; ++i) {
+        int64_t cut = boundaries[i * boundaries.size() / num_ranges];
+        if (cut > start && cut != INT64_MIN) {
+            ranges.emplace_back(start, cut - 1);
+            start = cut;
+        }
+    }
+    ranges.emplace_back(start, INT64_MAX);
+    return ranges;
+}
+
+bool LSMTree::merge_range(const std::vector<std::shared_ptr<SSTable>>& sstables,
+                          uint64_t target_level, int64_t start_time, int64_t end_time,
+                          std::vector<std::shared_ptr<SSTable>>& outputs) {
+    // Stream the merged points into output files of about target_file_size_bytes
+    std::shared_ptr<SSTable> current;
+    
+    auto discard_outputs = [&]() {
+        for (const auto& output : outputs) {
+            fs::remove(output->get_file_path());
+        }
+        outputs.clear();
+    };
+    
+    MergingIterator it(sstables, false, start_time, end_time);
+    while (it.valid()) {
+        if (!current) {
+            uint64_t sequence = next_sequence_++;
+            current = std::make_shared<SSTable>(generate_sstable_path(target_level, sequence),
+                                                target_level, sequence, sstable_options());
+            if (!current->begin_build()) {
+                discard_outputs();
+                return false;
+            }
+        }
+        
+        // Only cut between timestamps so a file never splits a point lookup
+        int64_t timestamp = it.value().timestamp;
+        if (!current->add(it.value())) {
+            discard_outputs();
+            fs::remove(current->get_file_path());
+            return false;
+        }
+        it.next();
+        
+        bool cut = !it.valid() ||
+            (it.value().timestamp != timestamp &&
+             (current->get_build_bytes() >= config_.target_file_size_bytes ||
+              partition_of(it.value().timestamp) != partition_of(timestamp)));
+        if (cut) {
+            if (!current->finish_build()) {
+                discard_outputs();
+                return false;
+            }
+            outputs.push_back(std::move(current));
+            current.reset();
+        }
+    }
+    
+    // An empty range is fine; other subcompactions may hold all the points
+    return true;
 }
 
 std::string LSMTree::generate_sstable_path(uint64_t level, uint64_t sequence) {
@@ -1112,12 +3535,52 @@ std::string LSMTree::generate_sstable_path(uint64_t level, uint64_t sequence) {
     return oss.str();
 }
 
+SSTableOptions LSMTree::sstable_options() const {
+    SSTableOptions options;
+    options.format_version = config_.enable_compression
+        ? SSTable::kColumnarFormatVersion
+        : SSTable::kRowFormatVersion;
+    options.block_size_points = config_.block_size_points;
+    options.block_sketches = config_.block_sketches;
+    options.use_mmap = config_.use_mmap_reads;
+    options.block_cache = config_.block_cache;
+    options.cache_counters = cache_counters_;
+    options.rate_limiter = config_.rate_limiter;
+    options.async_reader = config_.async_reader;
+    options.readahead_blocks = config_.readahead_blocks;
+    return options;
+}
+
 bool LSMTree::load_existing_sstables() {
     if (!fs::exists(config_.data_dir)) {
         return true;
     }
     
-    // Scan directory for SSTable files
+    std::lock_guard<std::mutex> lock(sstable_mutex_);
+    if (!load_manifest()) {
+        levels_.clear();
+        scan_sstable_files();
+    }
+    
+    index_loaded_sstables();
+    update_write_stall();
+    return write_manifest();
+}
+
+void LSMTree::index_loaded_sstables() {
+    // Directory order is arbitrary; compaction expects oldest first
+    for (auto& [level, sstables] : levels_) {
+        std::sort(sstables.begin(), sstables.end(),
+            [](const std::shared_ptr<SSTable>& a, const std::shared_ptr<SSTable>& b) {
+                return a->get_sequence() < b->get_sequence();
+            });
+        for (const auto& sstable : sstables) {
+            note_timestamp(sstable->get_max_timestamp());
+        }
+    }
+}
+
+void LSMTree::scan_sstable_files() {
     for (const auto& entry : fs::directory_iterator(config_.data_dir)) {
         if (entry.path().extension() == ".sst") {
             std::string filename = entry.path().filename().string();
@@ -1129,7 +3592,12 @@ bool LSMTree::load_existing_sstables() {
             uint64_t level = std::stoull(filename.substr(1, underscore_pos - 1));
             uint64_t sequence = std::stoull(filename.substr(underscore_pos + 1));
             
-            auto sstable = std::make_shared<SSTable>(entry.path().string(), level, sequence);
+            auto sstable = std::make_shared<SSTable>(entry.path().string(), level, sequence,
+                                                     sstable_options());
+            if (!sstable->open()) {
+                std::cerr << "Skipping unreadable SSTable: " << entry.path() << std::endl;
+                continue;
+            }
             levels_[level].push_back(sstable);
             
             if (sequence >= next_sequence_) {
@@ -1137,12 +3605,117 @@ bool LSMTree::load_existing_sstables() {
             }
         }
     }
+}
+
+bool LSMTree::load_manifest() {
+    std::vector<uint8_t> contents;
+    if (!fs::exists(manifest_path()) || !read_whole_file(manifest_path(), contents)) {
+        return false;
+    }
+    
+    // [u32 magic][u32 version][u64 next sequence][i64 retention cutoff, v2]
+    // [u64 count][entries][u32 crc32c]
+    const uint8_t* ptr = contents.data();
+    const uint8_t* end = ptr + contents.size();
+    uint32_t magic, version, crc;
+    uint64_t next_sequence, count;
+    int64_t retention_cutoff = INT64_MIN;
+    if (contents.size() < sizeof(crc)) return false;
+    std::memcpy(&crc, end - sizeof(crc), sizeof(crc));
+    end -= sizeof(crc);
+    if (crc32c(ptr, end - ptr) != crc ||
+        !read_pod(ptr, end, magic) || magic != kManifestMagic ||
+        !read_pod(ptr, end, version) || version < 1 || version > kManifestVersion ||
+        !read_pod(ptr, end, next_sequence) ||
+        (version >= 2 && !read_pod(ptr, end, retention_cutoff)) ||
+        !read_pod(ptr, end, count)) {
+        std::cerr << "Ignoring unreadable manifest: " << manifest_path() << std::endl;
+        return false;
+    }
+    
+    std::set<std::string> listed;
+    for (uint64_t i = 0; i < count; ++i) {
+        uint64_t level, sequence, num_entries;
+        int64_t min_timestamp, max_timestamp;
+        uint32_t format_version;
+        if (!read_pod(ptr, end, level) || !read_pod(ptr, end, sequence) ||
+            !read_pod(ptr, end, num_entries) || !read_pod(ptr, end, min_timestamp) ||
+            !read_pod(ptr, end, max_timestamp) || !read_pod(ptr, end, format_version)) {
+            return false;
+        }
+        
+        std::string path = generate_sstable_path(level, sequence);
+        listed.insert(fs::path(path).filename().string());
+        if (!fs::exists(path)) {
+            std::cerr << "SSTable listed in manifest is missing: " << path << std::endl;
+            continue;
+        }
+        
+        auto sstable = std::make_shared<SSTable>(path, level, sequence, sstable_options());
+        sstable->open_lazily(format_version, num_entries, min_timestamp, max_timestamp);
+        levels_[level].push_back(sstable);
+        next_sequence = std::max(next_sequence, sequence + 1);
+    }
+    next_sequence_ = std::max<uint64_t>(next_sequence_, next_sequence);
+    retention_cutoff_ = std::max(retention_cutoff_.load(), retention_cutoff);
+    
+    // Files written after the last manifest update never became visible
+    for (const auto& entry : fs::directory_iterator(config_.data_dir)) {
+        if (entry.path().extension() == ".sst" &&
+            !listed.count(entry.path().filename().string())) {
+            std::cerr << "Removing SSTable not in manifest: " << entry.path() << std::endl;
+            fs::remove(entry.path());
+        }
+    }
+    return true;
+}
+
+bool LSMTree::write_manifest() {
+    return write_manifest_to(manifest_path());
+}
+
+bool LSMTree::write_manifest_to(const std::string& path) {
+    std::vector<uint8_t> contents;
+    append_pod(contents, kManifestMagic);
+    append_pod(contents, kManifestVersion);
+    append_pod(contents, static_cast<uint64_t>(next_sequence_.load()));
+    append_pod(contents, retention_cutoff_.load());
+    
+    uint64_t count = 0;
+    for (const auto& [level, sstables] : levels_) {
+        count += sstables.size();
+    }
+    append_pod(contents, count);
+    for (const auto& [level, sstables] : levels_) {
+        for (const auto& sstable : sstables) {
+            append_pod(contents, level);
+            append_pod(contents, sstable->get_sequence());
+            append_pod(contents, static_cast<uint64_t>(sstable->get_num_entries()));
+            append_pod(contents, sstable->get_min_timestamp());
+            append_pod(contents, sstable->get_max_timestamp());
+            append_pod(contents, sstable->get_format_version());
+        }
+    }
+    append_pod(contents, crc32c(contents.data(), contents.size()));
     
+    // Write a new file and rename it over the old one
+    std::string tmp_path = path + ".tmp";
+    int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::cerr << "Failed to write manifest: " << tmp_path << std::endl;
+        return false;
+    }
+    bool ok = write_fully(fd, contents.data(), contents.size()) && ::fsync(fd) == 0;
+    ::close(fd);
+    if (!ok || std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        std::cerr << "Failed to write manifest: " << path << std::endl;
+        return false;
+    }
     return true;
 }
 
 bool LSMTree::search_in_memtables(int64_t timestamp, TimeSeriesData& data) {
-    std::lock_guard<std::mutex> lock(memtable_mutex_);
+    std::shared_lock<std::shared_mutex> lock(memtable_mutex_);
     
     // Search active MemTable first
     if (active_memtable_->get(timestamp, data)) {
@@ -1158,48 +3731,35 @@ bool LSMTree::search_in_memtables(int64_t timestamp, TimeSeriesData& data) {
 }
 
 bool LSMTree::search_in_sstables(int64_t timestamp, TimeSeriesData& data) {
-    std::lock_guard<std::mutex> lock(sstable_mutex_);
-    
     // Search from level 0 to highest level
-    for (uint64_t level = 0; level < config_.max_levels; ++level) {
-        if (levels_.find(level) == levels_.end()) {
+    for (const auto& sstable : snapshot_sstables()) {
+        // Use bloom filter for quick rejection
+        if (!sstable->might_contain(timestamp)) {
+            bloom_filter_rejections_.inc();
             continue;
         }
         
-        for (auto& sstable : levels_[level]) {
-            // Use bloom filter for quick rejection
-            if (!sstable->might_contain(timestamp)) {
-                std::lock_guard<std::mutex> stats_lock(stats_mutex_);
-                stats_.bloom_filter_rejections++;
-                continue;
-            }
-            
-            if (sstable->get(timestamp, data)) {
-                return true;
-            }
+        if (sstable->get(timestamp, data)) {
+            return true;
         }
     }
     
     return false;
 }
 
-void LSMTree::merge_range_results(std::vector<TimeSeriesData>& results,
-                                  const std::vector<TimeSeriesData>& new_results) {
-    // Merge and deduplicate based on timestamp
-    std::map<int64_t, TimeSeriesData> merged;
-    
-    for (const auto& data : results) {
-        merged[data.timestamp] = data;
-    }
-    
-    for (const auto& data : new_results) {
-        merged[data.timestamp] = data;
-    }
+std::vector<std::shared_ptr<SSTable>> LSMTree::snapshot_sstables() const {
+    std::lock_guard<std::mutex> lock(sstable_mutex_);
     
-    results.clear();
-    for (const auto& [_, data] : merged) {
-        results.push_back(data);
-    }
+    std::vector<std::shared_ptr<SSTable>> snapshot;
+    for (const auto& [level, sstables] : levels_) {
+        size_t level_begin = snapshot.size();
+        snapshot.insert(snapshot.end(), sstables.begin(), sstables.end());
+        std::sort(snapshot.begin() + level_begin, snapshot.end(),
+            [](const std::shared_ptr<SSTable>& a, const std::shared_ptr<SSTable>& b) {
+                return a->get_sequence() > b->get_sequence();
+            });
+    }
+    return snapshot;
 }
 
 } // namespace sage_tsdb
@@ -0,0 +1,39 @@
+#include "sage_tsdb/core/mapped_file.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace sage_tsdb {
+
+MappedFile::~MappedFile() {
+    if (data_ && size_ > 0) {
+        munmap(const_cast<uint8_t*>(data_), size_);
+    }
+}
+
+std::shared_ptr<MappedFile> MappedFile::open(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        ::close(fd);
+        return nullptr;
+    }
+
+    size_t size = static_cast<size_t>(st.st_size);
+    void* addr = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    // The mapping keeps its own reference to the file
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        return nullptr;
+    }
+
+    return std::shared_ptr<MappedFile>(
+        new MappedFile(static_cast<const uint8_t*>(addr), size));
+}
+
+} // namespace sage_tsdb
@@ -0,0 +1,370 @@
+#include "sage_tsdb/core/metrics_registry.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+#include <stdexcept>
+
+namespace sage_tsdb {
+
+namespace {
+
+// Threads are spread over the stripes in arrival order
+size_t stripe_of_this_thread() {
+    static std::atomic<size_t> next{0};
+    thread_local size_t stripe = next.fetch_add(1, std::memory_order_relaxed) %
+                                 Counter::kStripes;
+    return stripe;
+}
+
+bool valid_name(const std::string& name, bool allow_colon) {
+    if (name.empty()) {
+        return false;
+    }
+    for (size_t i = 0; i < name.size(); ++i) {
+        char c = name[i];
+        bool ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' ||
+                  (allow_colon && c == ':') || (i > 0 && c >= '0' && c <= '9');
+        if (!ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+const char* type_name(MetricsRegistry::Type type) {
+    switch (type) {
+        case MetricsRegistry::Type::Counter: return "counter";
+        case MetricsRegistry::Type::Gauge: return "gauge";
+        case MetricsRegistry::Type::Histogram: return "histogram";
+    }
+    return "untyped";
+}
+
+std::string format_value(double value) {
+    if (std::isnan(value)) {
+        return "NaN";
+    }
+    if (std::isinf(value)) {
+        return value > 0 ? "+Inf" : "-Inf";
+    }
+    char buffer[32];
+    if (value == std::floor(value) && std::fabs(value) < 1e15) {
+        std::snprintf(buffer, sizeof(buffer), "%.0f", value);
+    } else {
+        std::snprintf(buffer, sizeof(buffer), "%.15g", value);
+    }
+    return buffer;
+}
+
+void escape_into(std::ostream& out, const std::string& text, bool quote) {
+    for (char c : text) {
+        if (c == '\\') {
+            out << "\\\\";
+        } else if (c == '\n') {
+            out << "\\n";
+        } else if (quote && c == '"') {
+            out << "\\\"";
+        } else {
+            out << c;
+        }
+    }
+}
+
+// {a="1",b="2"}, with an optional extra label appended (histogram "le")
+void write_labels(std::ostream& out, const Tags& labels,
+                  const char* extra_name = nullptr, const std::string& extra_value = "") {
+    if (labels.empty() && !extra_name) {
+        return;
+    }
+    out << '{';
+    bool first = true;
+    for (const auto& [key, value] : labels) {
+        out << (first ? "" : ",") << key << "=\"";
+        escape_into(out, value, true);
+        out << '"';
+        first = false;
+    }
+    if (extra_name) {
+        out << (first ? "" : ",") << extra_name << "=\"" << extra_value << '"';
+    }
+    out << '}';
+}
+
+} // anonymous namespace
+
+// ========== Counter / Gauge ==========
+
+void Counter::inc(uint64_t n) {
+    stripes_[stripe_of_this_thread()].value.fetch_add(n, std::memory_order_relaxed);
+}
+
+uint64_t Counter::value() const {
+    uint64_t total = 0;
+    for (const Stripe& stripe : stripes_) {
+        total += stripe.value.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+void Counter::reset() {
+    for (Stripe& stripe : stripes_) {
+        stripe.value.store(0, std::memory_order_relaxed);
+    }
+}
+
+void Gauge::add(double delta) {
+    double current = value_.load(std::memory_order_relaxed);
+    while (!value_.compare_exchange_weak(current, current + delta, std::memory_order_relaxed)) {
+    }
+}
+
+// ========== Handle ==========
+
+MetricsRegistry::Handle::Handle(Handle&& other) noexcept
+    : registry_(other.registry_), id_(other.id_) {
+    other.registry_ = nullptr;
+}
+
+MetricsRegistry::Handle& MetricsRegistry::Handle::operator=(Handle&& other) noexcept {
+    if (this != &other) {
+        reset();
+        registry_ = other.registry_;
+        id_ = other.id_;
+        other.registry_ = nullptr;
+    }
+    return *this;
+}
+
+void MetricsRegistry::Handle::reset() {
+    if (registry_) {
+        registry_->remove(id_);
+        registry_ = nullptr;
+    }
+}
+
+// ========== MetricsRegistry ==========
+
+const std::vector<double>& MetricsRegistry::defaultLatencyBounds() {
+    static const std::vector<double> bounds = {
+        0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025,
+        0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10};
+    return bounds;
+}
+
+MetricsRegistry::Family& MetricsRegistry::family(const std::string& name, const std::string& help,
+                                                 Type type) {
+    if (!valid_name(name, true)) {
+        throw std::invalid_argument("Invalid metric name: " + name);
+    }
+    auto [it, inserted] = families_.try_emplace(name);
+    if (inserted) {
+        it->second.type = type;
+        it->second.help = help;
+    } else if (it->second.type != type) {
+        throw std::invalid_argument("Metric " + name + " is already a " +
+                                    type_name(it->second.type));
+    }
+    return it->second;
+}
+
+const MetricsRegistry::Series* MetricsRegistry::findSeries(const Family& family,
+                                                           const Tags& labels) const {
+    for (const auto& [id, series] : family.series) {
+        if (series.labels == labels) {
+            return &series;
+        }
+    }
+    return nullptr;
+}
+
+std::shared_ptr<void> MetricsRegistry::findOwned(const std::string& name, Type type,
+                                                 const Tags& labels) const {
+    auto it = families_.find(name);
+    if (it == families_.end()) {
+        return nullptr;
+    }
+    if (it->second.type != type) {
+        throw std::invalid_argument("Metric " + name + " is already a " +
+                                    type_name(it->second.type));
+    }
+    const Series* series = findSeries(it->second, labels);
+    return series ? series->owned : nullptr;
+}
+
+uint64_t MetricsRegistry::add(const std::string& name, const std::string& help, Type type,
+                              Series series) {
+    for (const auto& [key, value] : series.labels) {
+        if (!valid_name(key, false) || key == "le") {
+            throw std::invalid_argument("Invalid label name: " + key);
+        }
+    }
+    Family& fam = family(name, help, type);
+    uint64_t id = next_id_++;
+    fam.series.emplace(id, std::move(series));
+    family_of_[id] = name;
+    return id;
+}
+
+void MetricsRegistry::remove(uint64_t id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = family_of_.find(id);
+    if (it == family_of_.end()) {
+        return;
+    }
+    auto fam = families_.find(it->second);
+    fam->second.series.erase(id);
+    if (fam->second.series.empty()) {
+        families_.erase(fam);
+    }
+    family_of_.erase(it);
+}
+
+std::shared_ptr<Counter> MetricsRegistry::counter(const std::string& name, const std::string& help,
+                                                  const Tags& labels) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (auto existing = findOwned(name, Type::Counter, labels)) {
+        return std::static_pointer_cast<Counter>(existing);
+    }
+    auto metric = std::make_shared<Counter>();
+    Series series;
+    series.labels = labels;
+    series.read = [raw = metric.get()]() { return static_cast<double>(raw->value()); };
+    series.owned = metric;
+    add(name, help, Type::Counter, std::move(series));
+    return metric;
+}
+
+std::shared_ptr<Gauge> MetricsRegistry::gauge(const std::string& name, const std::string& help,
+                                              const Tags& labels) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (auto existing = findOwned(name, Type::Gauge, labels)) {
+        return std::static_pointer_cast<Gauge>(existing);
+    }
+    auto metric = std::make_shared<Gauge>();
+    Series series;
+    series.labels = labels;
+    series.read = [raw = metric.get()]() { return raw->value(); };
+    series.owned = metric;
+    add(name, help, Type::Gauge, std::move(series));
+    return metric;
+}
+
+std::shared_ptr<LatencyHistogram> MetricsRegistry::histogram(const std::string& name,
+                                                             const std::string& help,
+                                                             const Tags& labels, double scale) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (auto existing = findOwned(name, Type::Histogram, labels)) {
+        return std::static_pointer_cast<LatencyHistogram>(existing);
+    }
+    auto metric = std::make_shared<LatencyHistogram>();
+    Series series;
+    series.labels = labels;
+    series.histogram = metric.get();
+    series.scale = scale;
+    series.owned = metric;
+    add(name, help, Type::Histogram, std::move(series));
+    return metric;
+}
+
+MetricsRegistry::Handle MetricsRegistry::addCounter(const std::string& name, const std::string& help,
+                                                    const Tags& labels, std::function<double()> read) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Series series;
+    series.labels = labels;
+    series.read = std::move(read);
+    return Handle(this, add(name, help, Type::Counter, std::move(series)));
+}
+
+MetricsRegistry::Handle MetricsRegistry::addGauge(const std::string& name, const std::string& help,
+                                                  const Tags& labels, std::function<double()> read) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Series series;
+    series.labels = labels;
+    series.read = std::move(read);
+    return Handle(this, add(name, help, Type::Gauge, std::move(series)));
+}
+
+MetricsRegistry::Handle MetricsRegistry::addHistogram(const std::string& name,
+                                                      const std::string& help, const Tags& labels,
+                                                      const LatencyHistogram* histogram,
+                                                      double scale) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Series series;
+    series.labels = labels;
+    series.histogram = histogram;
+    series.scale = scale;
+    return Handle(this, add(name, help, Type::Histogram, std::move(series)));
+}
+
+void MetricsRegistry::writePrometheus(std::ostream& out) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto& bounds = defaultLatencyBounds();
+    for (const auto& [name, fam] : families_) {
+        out << "# HELP " << name << ' ';
+        escape_into(out, fam.help, false);
+        out << "\n# TYPE " << name << ' ' << type_name(fam.type) << '\n';
+
+        for (const auto& [id, series] : fam.series) {
+            if (fam.type != Type::Histogram) {
+                out << name;
+                write_labels(out, series.labels);
+                out << ' ' << format_value(series.read()) << '\n';
+                continue;
+            }
+
+            // Buckets are ~3% wide, so a bound inside one counts it in the next bound up
+            LatencyHistogram::Snapshot snap = series.histogram->snapshot();
+            size_t bucket = 0;
+            uint64_t cumulative = 0;
+            for (double bound : bounds) {
+                while (bucket < snap.counts.size() &&
+                       static_cast<double>(LatencyHistogram::bucket_highest(bucket)) * series.scale <=
+                           bound) {
+                    cumulative += snap.counts[bucket++];
+                }
+                out << name << "_bucket";
+                write_labels(out, series.labels, "le", format_value(bound));
+                out << ' ' << cumulative << '\n';
+            }
+            out << name << "_bucket";
+            write_labels(out, series.labels, "le", "+Inf");
+            out << ' ' << snap.count << '\n';
+            out << name << "_sum";
+            write_labels(out, series.labels);
+            out << ' ' << format_value(snap.mean * static_cast<double>(snap.count) * series.scale)
+                << '\n';
+            out << name << "_count";
+            write_labels(out, series.labels);
+            out << ' ' << snap.count << '\n';
+        }
+    }
+}
+
+std::string MetricsRegistry::exportPrometheus() const {
+    std::ostringstream out;
+    writePrometheus(out);
+    return out.str();
+}
+
+bool MetricsRegistry::read(const std::string& name, const Tags& labels, double& value) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = families_.find(name);
+    if (it == families_.end() || it->second.type == Type::Histogram) {
+        return false;
+    }
+    const Series* series = findSeries(it->second, labels);
+    if (!series) {
+        return false;
+    }
+    value = series->read();
+    return true;
+}
+
+size_t MetricsRegistry::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return family_of_.size();
+}
+
+} // namespace sage_tsdb
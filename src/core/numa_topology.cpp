@@ -0,0 +1,148 @@
+#include "sage_tsdb/core/numa_topology.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace sage_tsdb {
+namespace core {
+
+namespace {
+
+bool parse_int(const std::string& text, int& value) {
+    auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return ec == std::errc() && end == text.data() + text.size();
+}
+
+}  // namespace
+
+std::vector<int> NumaTopology::parse_cpu_list(const std::string& list) {
+    std::vector<int> cpus;
+    size_t begin = 0;
+    while (begin < list.size()) {
+        size_t end = list.find(',', begin);
+        if (end == std::string::npos) {
+            end = list.size();
+        }
+        std::string range = list.substr(begin, end - begin);
+        while (!range.empty() && std::isspace(static_cast<unsigned char>(range.back()))) {
+            range.pop_back();
+        }
+        size_t dash = range.find('-');
+        int first = 0;
+        int last = 0;
+        if (dash == std::string::npos) {
+            if (parse_int(range, first)) {
+                cpus.push_back(first);
+            }
+        } else if (parse_int(range.substr(0, dash), first) &&
+                   parse_int(range.substr(dash + 1), last) && first <= last) {
+            for (int cpu = first; cpu <= last; ++cpu) {
+                cpus.push_back(cpu);
+            }
+        }
+        begin = end + 1;
+    }
+    std::sort(cpus.begin(), cpus.end());
+    cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+    return cpus;
+}
+
+NumaTopology NumaTopology::load(const std::string& node_dir) {
+    NumaTopology topology;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(node_dir, ec)) {
+        std::string name = entry.path().filename().string();
+        int id = 0;
+        if (name.rfind("node", 0) != 0 || !parse_int(name.substr(4), id)) {
+            continue;
+        }
+        std::ifstream file(entry.path() / "cpulist");
+        std::string list;
+        if (!file || !std::getline(file, list)) {
+            continue;
+        }
+        NumaNode node;
+        node.id = id;
+        node.cpus = parse_cpu_list(list);
+        // Memory-only nodes have no CPUs to run on
+        if (!node.cpus.empty()) {
+            topology.nodes_.push_back(std::move(node));
+        }
+    }
+    std::sort(topology.nodes_.begin(), topology.nodes_.end(),
+              [](const NumaNode& a, const NumaNode& b) { return a.id < b.id; });
+    return topology;
+}
+
+const NumaTopology& NumaTopology::system() {
+    static const NumaTopology topology = []() {
+        NumaTopology loaded = load("/sys/devices/system/node");
+        if (loaded.nodes_.empty()) {
+            NumaNode node;
+            unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+            for (unsigned cpu = 0; cpu < threads; ++cpu) {
+                node.cpus.push_back(static_cast<int>(cpu));
+            }
+            loaded.nodes_.push_back(std::move(node));
+        }
+        return loaded;
+    }();
+    return topology;
+}
+
+const NumaNode* NumaTopology::node(int id) const {
+    for (const NumaNode& node : nodes_) {
+        if (node.id == id) {
+            return &node;
+        }
+    }
+    return nullptr;
+}
+
+int NumaTopology::node_of_cpu(int cpu) const {
+    for (const NumaNode& node : nodes_) {
+        if (std::binary_search(node.cpus.begin(), node.cpus.end(), cpu)) {
+            return node.id;
+        }
+    }
+    return -1;
+}
+
+bool pin_current_thread(const std::vector<int>& cpus) {
+#if defined(__linux__)
+    if (cpus.empty()) {
+        return false;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+        if (cpu >= 0 && cpu < CPU_SETSIZE) {
+            CPU_SET(cpu, &set);
+        }
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)cpus;
+    return false;
+#endif
+}
+
+int current_cpu() {
+#if defined(__linux__)
+    return sched_getcpu();
+#else
+    return -1;
+#endif
+}
+
+}  // namespace core
+}  // namespace sage_tsdb
@@ -0,0 +1,64 @@
+#include "sage_tsdb/core/rate_limiter.h"
+#include <algorithm>
+#include <thread>
+
+namespace sage_tsdb {
+
+RateLimiter::RateLimiter(uint64_t bytes_per_second, std::chrono::microseconds refill_period)
+    : bytes_per_second_(bytes_per_second),
+      refill_period_(std::max(refill_period, std::chrono::microseconds(1000))),
+      last_refill_(Clock::now()) {
+    available_ = burst_bytes();
+}
+
+void RateLimiter::set_bytes_per_second(uint64_t bytes_per_second) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    refill(Clock::now());
+    bytes_per_second_.store(bytes_per_second, std::memory_order_relaxed);
+    available_ = std::min(available_, burst_bytes());
+}
+
+double RateLimiter::burst_bytes() const {
+    return static_cast<double>(bytes_per_second_.load(std::memory_order_relaxed)) *
+           refill_period_.count() / 1e6;
+}
+
+void RateLimiter::refill(Clock::time_point now) {
+    double elapsed = std::chrono::duration<double>(now - last_refill_).count();
+    last_refill_ = now;
+    available_ = std::min(burst_bytes(),
+                          available_ + elapsed * bytes_per_second_.load(std::memory_order_relaxed));
+}
+
+void RateLimiter::request(size_t bytes) {
+    total_bytes_.fetch_add(bytes, std::memory_order_relaxed);
+
+    auto started = Clock::now();
+    double remaining = static_cast<double>(bytes);
+    while (remaining > 0) {
+        std::chrono::duration<double> wait{0};
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            uint64_t rate = bytes_per_second_.load(std::memory_order_relaxed);
+            if (rate == 0) {
+                break;
+            }
+
+            // Requests larger than the bucket are granted piecewise
+            refill(Clock::now());
+            double chunk = std::min(remaining, std::max(1.0, burst_bytes()));
+            if (available_ >= chunk) {
+                available_ -= chunk;
+                remaining -= chunk;
+                continue;
+            }
+            wait = std::chrono::duration<double>((chunk - available_) / rate);
+        }
+        std::this_thread::sleep_for(wait);
+    }
+
+    auto waited = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - started);
+    total_wait_micros_.fetch_add(waited.count(), std::memory_order_relaxed);
+}
+
+} // namespace sage_tsdb
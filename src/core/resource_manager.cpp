@@ -1,30 +1,58 @@
 #include "sage_tsdb/core/resource_manager.h"
+#include "sage_tsdb/core/metrics_registry.h"
+#include "sage_tsdb/core/numa_topology.h"
+#include "sage_tsdb/core/write_buffer_manager.h"
+#include <algorithm>
 #include <mutex>
 #include <unordered_map>
-#include <queue>
 #include <thread>
-#include <condition_variable>
 
 namespace sage_tsdb {
 namespace core {
 
+namespace {
+
+constexpr double kMemoryThrottleFactor = 0.25;  // CPU share left over critical memory
+
+}  // namespace
+
+bool ResourceHandle::submit(Task task) {
+    // std::function needs a copyable target, so share the move-only task
+    auto shared = std::make_shared<Task>(std::move(task));
+    return submitTask([shared]() { (*shared)(); });
+}
+
 /**
  * @brief Internal resource handle implementation
+ * 
+ * Tasks go to the handle's queue on the manager's shared executor. The
+ * queue's CPU limit is recomputed whenever one of its inputs changes:
+ * the allocation, the throttle factor or the memory state, which is
+ * checked on every submission and usage report.
  */
 class ResourceHandleImpl : public ResourceHandle {
 public:
-    ResourceHandleImpl(const std::string& name, const ResourceRequest& allocated)
-        : plugin_name_(name), allocated_(allocated), valid_(true) {}
+    ResourceHandleImpl(const std::string& name, const ResourceRequest& allocated,
+                       std::shared_ptr<WorkStealingExecutor> executor, std::vector<int> cpus)
+        : plugin_name_(name), allocated_(allocated), valid_(true),
+          executor_(std::move(executor)),
+          queue_(executor_->create_queue(allocated.priority, allocated.requested_threads,
+                                         allocated.numa_node)),
+          cpus_(std::move(cpus)),
+          tracker_(std::make_shared<MemoryTracker>()) {
+        applyCpuLimit();
+    }
     
     ~ResourceHandleImpl() override = default;
     
     bool submitTask(std::function<void()> task) override {
+        return submit(Task(std::move(task)));
+    }
+    
+    bool submit(Task task) override {
         if (!valid_) return false;
-        
-        std::lock_guard<std::mutex> lock(queue_mutex_);
-        task_queue_.push(std::move(task));
-        queue_cv_.notify_one();
-        return true;
+        checkMemory();
+        return executor_->submit(queue_, std::move(task));
     }
     
     bool isValid() const override {
@@ -32,50 +60,111 @@ public:
     }
     
     ResourceRequest getAllocated() const override {
+        std::lock_guard<std::mutex> lock(usage_mutex_);
         return allocated_;
     }
     
     void reportUsage(const ResourceUsage& usage) override {
-        std::lock_guard<std::mutex> lock(usage_mutex_);
-        current_usage_ = usage;
+        {
+            std::lock_guard<std::mutex> lock(usage_mutex_);
+            current_usage_ = usage;
+        }
+        reported_memory_.store(usage.memory_used_bytes, std::memory_order_relaxed);
+        reported_queue_.store(usage.queue_length, std::memory_order_relaxed);
+        reported_tuples_.store(usage.tuples_processed, std::memory_order_relaxed);
+        checkMemory();
+    }
+    
+    std::shared_ptr<MemoryTracker> memoryTracker() const override {
+        return tracker_;
     }
     
-    ResourceUsage getUsage() const {
+    bool shouldYield() const override {
+        return executor_->should_yield(*queue_);
+    }
+    
+    ResourceUsage getUsage() {
+        checkMemory();
         std::lock_guard<std::mutex> lock(usage_mutex_);
-        return current_usage_;
+        ResourceUsage usage = current_usage_;
+        usage.memory_used_bytes += tracker_->usage();
+        usage.queue_length += queue_->pending();
+        usage.numa_node = queue_->node();
+        usage.cpus = cpus_;
+        usage.cpu_time_ns = queue_->busy_ns();
+        usage.cpu_limit = queue_->cpu_limit();
+        usage.throttle_factor = throttle_factor_.load(std::memory_order_relaxed);
+        usage.memory_throttled = memory_throttled_.load(std::memory_order_relaxed);
+        usage.throttled_tasks = queue_->throttled();
+        usage.yields = queue_->yields();
+        return usage;
+    }
+    
+    void updateAllocation(ResourceRequest allocated) {
+        allocated.numa_node = queue_->node();  // Fixed with the queue
+        {
+            std::lock_guard<std::mutex> lock(usage_mutex_);
+            allocated_ = allocated;
+        }
+        executor_->set_quota(*queue_, allocated.requested_threads);
+        executor_->set_priority(*queue_, allocated.priority);
+        checkMemory();
+        applyCpuLimit();
+    }
+    
+    void setThrottle(double factor) {
+        throttle_factor_.store(std::clamp(factor, 0.0, 1.0), std::memory_order_relaxed);
+        applyCpuLimit();
     }
     
     void invalidate() {
         valid_.store(false);
-        queue_cv_.notify_all();
+        executor_->close_queue(*queue_);
     }
     
-    // Worker thread loop (called by thread pool)
-    void processTasksUntil(std::atomic<bool>& should_stop) {
-        while (!should_stop.load() && valid_.load()) {
-            std::function<void()> task;
-            {
-                std::unique_lock<std::mutex> lock(queue_mutex_);
-                queue_cv_.wait_for(lock, std::chrono::milliseconds(100), [this, &should_stop]() {
-                    return !task_queue_.empty() || should_stop.load() || !valid_.load();
-                });
-                
-                if (task_queue_.empty() || should_stop.load() || !valid_.load()) {
-                    continue;
-                }
-                
-                task = std::move(task_queue_.front());
-                task_queue_.pop();
-            }
-            
-            if (task) {
-                try {
-                    task();
-                } catch (...) {
-                    // Log error but continue processing
-                }
-            }
+    // Replace this handle's series in registry (nullptr drops them); the
+    // manager calls it under its mutex
+    void registerMetrics(std::shared_ptr<MetricsRegistry> registry, const char* kind) {
+        metric_handles_.clear();
+        metrics_ = std::move(registry);
+        if (!metrics_) {
+            return;
         }
+        
+        const Tags labels{{"kind", kind}, {"handle", plugin_name_}};
+        auto gauge = [&](const char* name, const char* help, std::function<double()> read) {
+            metric_handles_.push_back(metrics_->addGauge(name, help, labels, std::move(read)));
+        };
+        auto counter = [&](const char* name, const char* help, std::function<double()> read) {
+            metric_handles_.push_back(metrics_->addCounter(name, help, labels, std::move(read)));
+        };
+        gauge("sage_tsdb_resource_memory_bytes", "Reported plus tracked memory of the handle",
+              [this]() {
+                  return static_cast<double>(reported_memory_.load(std::memory_order_relaxed) +
+                                             tracker_->usage());
+              });
+        gauge("sage_tsdb_resource_queue_length", "Reported work items plus tasks not yet started",
+              [this]() {
+                  return static_cast<double>(reported_queue_.load(std::memory_order_relaxed) +
+                                             queue_->pending());
+              });
+        counter("sage_tsdb_resource_tuples_processed_total", "Tuples the handle's owner reported",
+                [this]() {
+                    return static_cast<double>(reported_tuples_.load(std::memory_order_relaxed));
+                });
+        counter("sage_tsdb_resource_cpu_seconds_total", "Worker time spent in the handle's tasks",
+                [this]() { return static_cast<double>(queue_->busy_ns()) * 1e-9; });
+        gauge("sage_tsdb_resource_cpu_limit", "Worker-seconds per second allowed (-1 = unlimited)",
+              [this]() { return queue_->cpu_limit(); });
+        gauge("sage_tsdb_resource_throttle_factor", "Throttle set through throttleCompute()",
+              [this]() { return throttle_factor_.load(std::memory_order_relaxed); });
+        gauge("sage_tsdb_resource_memory_throttled", "1 while over critical_memory_bytes",
+              [this]() { return memory_throttled_.load(std::memory_order_relaxed) ? 1.0 : 0.0; });
+        counter("sage_tsdb_resource_throttled_tasks_total",
+                "Times a queued task waited for CPU budget",
+                [this]() { return static_cast<double>(queue_->throttled()); });
+        counter("sage_tsdb_resource_yields_total", "Times the handle's tasks were asked to yield",
+                [this]() { return static_cast<double>(queue_->yields()); });
     }
     
 private:
@@ -83,14 +172,65 @@ private:
     ResourceRequest allocated_;
     std::atomic<bool> valid_;
     
-    // Task queue
-    std::queue<std::function<void()>> task_queue_;
-    mutable std::mutex queue_mutex_;
-    std::condition_variable queue_cv_;
+    // Shared pool and this handle's queue on it
+    std::shared_ptr<WorkStealingExecutor> executor_;
+    std::shared_ptr<TaskQueue> queue_;
+    std::vector<int> cpus_;  // Of the queue's node; empty when unbound
     
     // Usage tracking
     ResourceUsage current_usage_;
     mutable std::mutex usage_mutex_;
+    
+    // Enforcement inputs besides allocated_
+    std::shared_ptr<MemoryTracker> tracker_;
+    std::atomic<uint64_t> reported_memory_{0};
+    std::atomic<uint64_t> reported_queue_{0};
+    std::atomic<uint64_t> reported_tuples_{0};
+    std::atomic<double> throttle_factor_{1.0};
+    std::atomic<bool> memory_throttled_{false};
+    std::mutex limit_mutex_;  // Serializes applyCpuLimit()
+    
+    // Throttle once memory reaches critical_memory_bytes, and release the
+    // throttle only below max_memory_bytes, so it does not flap
+    void checkMemory() {
+        uint64_t critical;
+        uint64_t soft;
+        {
+            std::lock_guard<std::mutex> lock(usage_mutex_);
+            critical = allocated_.critical_memory_bytes;
+            soft = allocated_.max_memory_bytes;
+        }
+        uint64_t memory = reported_memory_.load(std::memory_order_relaxed) + tracker_->usage();
+        bool throttled = memory_throttled_.load(std::memory_order_relaxed);
+        bool over = critical > 0 && memory >= critical;
+        bool under = critical == 0 || memory < std::min(soft > 0 ? soft : critical, critical);
+        if ((!throttled && over) || (throttled && under)) {
+            if (memory_throttled_.compare_exchange_strong(throttled, !throttled)) {
+                applyCpuLimit();
+            }
+        }
+    }
+    
+    void applyCpuLimit() {
+        std::lock_guard<std::mutex> lock(limit_mutex_);
+        ResourceRequest allocated = getAllocated();
+        double factor = throttle_factor_.load(std::memory_order_relaxed);
+        if (memory_throttled_.load(std::memory_order_relaxed)) {
+            factor *= kMemoryThrottleFactor;
+        }
+        double limit = allocated.max_cpu > 0 ? allocated.max_cpu : -1.0;
+        if (factor < 1.0) {
+            // Scale the CPU limit, or the thread quota without one
+            double base = limit > 0 ? limit : std::max(allocated.requested_threads, 1);
+            limit = base * factor;
+        }
+        executor_->set_cpu_limit(*queue_, limit);
+    }
+    
+    // Declared last: the series go before the state they read, the
+    // registry after them
+    std::shared_ptr<MetricsRegistry> metrics_;
+    std::vector<MetricsRegistry::Handle> metric_handles_;
 };
 
 /**
@@ -99,20 +239,16 @@ private:
 class ResourceManagerImpl : public ResourceManager {
 public:
     ResourceManagerImpl() 
-        : max_threads_(0), max_memory_bytes_(0), should_stop_(false) {
+        : max_threads_(0), max_memory_bytes_(0),
+          executor_(std::make_shared<WorkStealingExecutor>()) {
         // Default limits: use hardware concurrency
         max_threads_ = std::thread::hardware_concurrency();
         max_memory_bytes_ = 4ULL * 1024 * 1024 * 1024; // 4GB default
     }
     
     ~ResourceManagerImpl() override {
-        should_stop_.store(true);
-        // Wait for worker threads
-        for (auto& thread : worker_threads_) {
-            if (thread.joinable()) {
-                thread.join();
-            }
-        }
+        // Join the workers; handles that outlive the manager reject new tasks
+        executor_->stop();
     }
     
     std::shared_ptr<ResourceHandle> allocate(
@@ -165,16 +301,18 @@ public:
             allocated.max_memory_bytes = std::min(allocated.max_memory_bytes, available_memory);
         }
         
+        if (!place(allocated)) {
+            return nullptr;  // No such NUMA node
+        }
+        
         // Create handle
-        auto handle = std::make_shared<ResourceHandleImpl>(plugin_name, allocated);
+        auto handle = std::make_shared<ResourceHandleImpl>(plugin_name, allocated, executor_,
+                                                           cpusOf(allocated.numa_node));
         handles_[plugin_name] = handle;
+        handle->registerMetrics(metrics_, "plugin");
         
-        // Spawn worker threads for this plugin
-        for (int i = 0; i < allocated.requested_threads; ++i) {
-            worker_threads_.emplace_back([handle, this]() {
-                handle->processTasksUntil(should_stop_);
-            });
-        }
+        // Grow the shared pool so every handle can run up to its quota
+        growWorkers();
         
         return handle;
     }
@@ -184,6 +322,7 @@ public:
         auto it = handles_.find(plugin_name);
         if (it != handles_.end()) {
             it->second->invalidate();
+            it->second->registerMetrics(nullptr, "plugin");
             handles_.erase(it);
         }
     }
@@ -221,29 +360,26 @@ public:
             return false; // Plugin not found
         }
         
-        // Update the allocated resources for the plugin
-        // Note: Thread count changes would require stopping/restarting threads
-        // For now, we only support memory quota adjustments
-        ResourceRequest current = it->second->getAllocated();
-        
-        // Create updated request (only memory can be adjusted dynamically)
-        ResourceRequest updated = current;
+        ResourceRequest updated = it->second->getAllocated();
         if (new_request.max_memory_bytes > 0) {
             updated.max_memory_bytes = new_request.max_memory_bytes;
         }
         if (new_request.critical_memory_bytes > 0) {
             updated.critical_memory_bytes = new_request.critical_memory_bytes;
         }
-        
-        // Thread count adjustment requires recreation (not implemented yet)
-        if (new_request.requested_threads > 0 && 
-            new_request.requested_threads != current.requested_threads) {
-            // TODO: Implement thread pool resizing
-            return false;
+        if (new_request.requested_threads > 0) {
+            updated.requested_threads = new_request.requested_threads;
+        }
+        if (new_request.max_cpu > 0) {
+            updated.max_cpu = new_request.max_cpu;
+        }
+        if (new_request.priority != 0) {
+            updated.priority = new_request.priority;
         }
         
-        // Apply the new quota (would need to update the handle's internal state)
-        // For this minimal implementation, we just track it
+        // Thread quota and priority take effect on the shared pool at once
+        it->second->updateAllocation(updated);
+        growWorkers();
         return true;
     }
     
@@ -253,6 +389,11 @@ public:
         max_memory_bytes_ = max_memory_bytes;
     }
     
+    void setNumaAware(bool enabled) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        numa_aware_ = enabled;
+    }
+    
     bool isUnderPressure() const override {
         std::lock_guard<std::mutex> lock(mutex_);
         
@@ -265,8 +406,40 @@ public:
             total_memory += usage.memory_used_bytes;
         }
         
-        return (total_threads >= max_threads_ * 0.9) ||
-               (total_memory >= max_memory_bytes_ * 0.9);
+        if ((total_threads >= max_threads_ * 0.9) ||
+            (total_memory >= max_memory_bytes_ * 0.9)) {
+            return true;
+        }
+        
+        for (const auto& weak : write_buffers_) {
+            auto write_buffer = weak.lock();
+            if (write_buffer && write_buffer->is_under_pressure()) {
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    void attachWriteBuffer(std::shared_ptr<WriteBufferManager> write_buffer) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        
+        // Drop budgets whose owners are gone before adding the new one
+        write_buffers_.erase(
+            std::remove_if(write_buffers_.begin(), write_buffers_.end(),
+                           [](const auto& weak) { return weak.expired(); }),
+            write_buffers_.end());
+        write_buffers_.push_back(write_buffer);
+    }
+    
+    void attachMetrics(std::shared_ptr<MetricsRegistry> registry) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        metrics_ = std::move(registry);
+        for (const auto& [name, handle] : handles_) {
+            handle->registerMetrics(metrics_, "plugin");
+        }
+        for (const auto& [name, handle] : compute_handles_) {
+            handle->registerMetrics(metrics_, "compute");
+        }
     }
     
     // ========== Compute Engine Resource Management Implementation ==========
@@ -325,16 +498,17 @@ public:
             allocated.max_memory_bytes = std::min(allocated.max_memory_bytes, available_memory);
         }
         
+        if (!place(allocated)) {
+            return nullptr;
+        }
+        
         // Create handle
-        auto handle = std::make_shared<ResourceHandleImpl>(compute_name, allocated);
+        auto handle = std::make_shared<ResourceHandleImpl>(compute_name, allocated, executor_,
+                                                           cpusOf(allocated.numa_node));
         compute_handles_[compute_name] = handle;
+        handle->registerMetrics(metrics_, "compute");
         
-        // Spawn worker threads for this compute engine
-        for (int i = 0; i < allocated.requested_threads; ++i) {
-            worker_threads_.emplace_back([handle, this]() {
-                handle->processTasksUntil(should_stop_);
-            });
-        }
+        growWorkers();
         
         return handle;
     }
@@ -344,6 +518,7 @@ public:
         auto it = compute_handles_.find(compute_name);
         if (it != compute_handles_.end()) {
             it->second->invalidate();
+            it->second->registerMetrics(nullptr, "compute");
             compute_handles_.erase(it);
         }
     }
@@ -361,14 +536,8 @@ public:
         std::lock_guard<std::mutex> lock(mutex_);
         auto it = compute_handles_.find(compute_name);
         if (it != compute_handles_.end()) {
-            // Store throttle factor for future use
-            compute_throttle_[compute_name] = factor;
-            
-            // In a real implementation, this would:
-            // 1. Adjust task execution rate
-            // 2. Insert delays between tasks
-            // 3. Reduce thread priority
-            // For now, we just track the factor
+            // Enforced by the token bucket of the engine's queue
+            it->second->setThrottle(factor);
         }
     }
     
@@ -391,14 +560,73 @@ private:
     // Compute engine handles (separate pool for isolation)
     std::unordered_map<std::string, std::shared_ptr<ResourceHandleImpl>> compute_handles_;
     
-    // Compute throttle factors
-    std::unordered_map<std::string, double> compute_throttle_;
+    // Memtable budgets consulted by isUnderPressure()
+    std::vector<std::weak_ptr<WriteBufferManager>> write_buffers_;
+    
+    // Registry the handles export into (null = none)
+    std::shared_ptr<MetricsRegistry> metrics_;
     
     int max_threads_;
     uint64_t max_memory_bytes_;
     
-    std::vector<std::thread> worker_threads_;
-    std::atomic<bool> should_stop_;
+    // Shared work-stealing pool serving every handle
+    std::shared_ptr<WorkStealingExecutor> executor_;
+    
+    // Machine topology for NUMA placement
+    const NumaTopology& topology_ = NumaTopology::system();
+    bool numa_aware_ = false;
+    
+    // Sum of allocated thread quotas on node (-1 = unbound); caller holds mutex_
+    size_t totalQuota(int node) const {
+        size_t total = 0;
+        for (const auto* handles : {&handles_, &compute_handles_}) {
+            for (const auto& [name, handle] : *handles) {
+                ResourceRequest allocated = handle->getAllocated();
+                if (allocated.numa_node == node) {
+                    total += allocated.requested_threads;
+                }
+            }
+        }
+        return total;
+    }
+    
+    // Start workers so each node's group covers its quotas; caller holds mutex_
+    void growWorkers() {
+        executor_->ensure_workers(totalQuota(-1));
+        for (const NumaNode& node : topology_.nodes()) {
+            if (size_t quota = totalQuota(node.id); quota > 0) {
+                executor_->ensure_workers(quota, node.id, node.cpus);
+            }
+        }
+    }
+    
+    // Resolve allocated.numa_node: validate a requested node, or pick the
+    // node with the fewest quota threads per CPU in NUMA-aware mode;
+    // false for an unknown node. Caller holds mutex_
+    bool place(ResourceRequest& allocated) const {
+        if (allocated.numa_node >= 0) {
+            return topology_.node(allocated.numa_node) != nullptr;
+        }
+        allocated.numa_node = -1;
+        if (!numa_aware_) {
+            return true;
+        }
+        double best_load = 0.0;
+        for (const NumaNode& node : topology_.nodes()) {
+            double load = static_cast<double>(totalQuota(node.id)) /
+                          static_cast<double>(node.cpus.size());
+            if (allocated.numa_node < 0 || load < best_load) {
+                allocated.numa_node = node.id;
+                best_load = load;
+            }
+        }
+        return true;
+    }
+    
+    std::vector<int> cpusOf(int node) const {
+        const NumaNode* numa_node = topology_.node(node);
+        return numa_node ? numa_node->cpus : std::vector<int>{};
+    }
 };
 
 // Factory function implementation
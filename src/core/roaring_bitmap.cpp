@@ -0,0 +1,355 @@
+#include "sage_tsdb/core/roaring_bitmap.h"
+#include <algorithm>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace sage_tsdb {
+
+namespace {
+
+// Below this size ratio a linear merge beats searching the larger side
+constexpr size_t kGallopRatio = 32;
+
+// First position >= from in [from, end) with *pos >= target
+const uint16_t* gallop(const uint16_t* from, const uint16_t* end, uint16_t target) {
+    size_t step = 1;
+    const uint16_t* lo = from;
+    const uint16_t* hi = from;
+    while (hi < end && *hi < target) {
+        lo = hi + 1;
+        hi = (static_cast<size_t>(end - hi) > step) ? hi + step : end;
+        step <<= 1;
+    }
+    return std::lower_bound(lo, hi, target);
+}
+
+void intersect_arrays(const std::vector<uint16_t>& a, const std::vector<uint16_t>& b,
+                      std::vector<uint16_t>& out) {
+    const auto& small = a.size() <= b.size() ? a : b;
+    const auto& large = a.size() <= b.size() ? b : a;
+    out.reserve(small.size());
+
+    if (small.size() * kGallopRatio < large.size()) {
+        const uint16_t* pos = large.data();
+        const uint16_t* end = large.data() + large.size();
+        for (uint16_t value : small) {
+            pos = gallop(pos, end, value);
+            if (pos == end) break;
+            if (*pos == value) out.push_back(value);
+        }
+        return;
+    }
+
+    size_t i = 0, j = 0;
+    while (i < small.size() && j < large.size()) {
+        if (small[i] < large[j]) {
+            ++i;
+        } else if (large[j] < small[i]) {
+            ++j;
+        } else {
+            out.push_back(small[i]);
+            ++i;
+            ++j;
+        }
+    }
+}
+
+// out = a & b, returning the number of set bits
+uint32_t and_words(const uint64_t* a, const uint64_t* b, uint64_t* out, size_t words) {
+    size_t w = 0;
+#if defined(__AVX2__)
+    for (; w + 4 <= words; w += 4) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + w));
+        __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + w));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + w), _mm256_and_si256(x, y));
+    }
+#endif
+    for (; w < words; ++w) {
+        out[w] = a[w] & b[w];
+    }
+    uint32_t count = 0;
+    for (w = 0; w < words; ++w) {
+        count += static_cast<uint32_t>(__builtin_popcountll(out[w]));
+    }
+    return count;
+}
+
+} // namespace
+
+bool RoaringBitmap::Container::contains(uint16_t low) const {
+    if (is_bitmap()) {
+        return (bitmap[low >> 6] >> (low & 63)) & 1;
+    }
+    return std::binary_search(array.begin(), array.end(), low);
+}
+
+void RoaringBitmap::Container::to_bitmap() {
+    bitmap.assign(kBitmapWords, 0);
+    for (uint16_t low : array) {
+        bitmap[low >> 6] |= uint64_t(1) << (low & 63);
+    }
+    array.clear();
+    array.shrink_to_fit();
+}
+
+void RoaringBitmap::Container::to_array() {
+    std::vector<uint16_t> values;
+    values.reserve(cardinality);
+    for (size_t w = 0; w < kBitmapWords; ++w) {
+        for (uint64_t word = bitmap[w]; word != 0; word &= word - 1) {
+            values.push_back(static_cast<uint16_t>(w * 64 + __builtin_ctzll(word)));
+        }
+    }
+    array = std::move(values);
+    bitmap.clear();
+    bitmap.shrink_to_fit();
+}
+
+size_t RoaringBitmap::lower_bound(uint16_t key) const {
+    auto it = std::lower_bound(containers_.begin(), containers_.end(), key,
+        [](const Container& container, uint16_t k) { return container.key < k; });
+    return static_cast<size_t>(it - containers_.begin());
+}
+
+RoaringBitmap::Container* RoaringBitmap::find_or_insert(uint16_t key) {
+    // Appends land in the last container
+    if (!containers_.empty() && containers_.back().key == key) {
+        return &containers_.back();
+    }
+    if (containers_.empty() || containers_.back().key < key) {
+        containers_.emplace_back();
+        containers_.back().key = key;
+        return &containers_.back();
+    }
+    auto it = std::lower_bound(containers_.begin(), containers_.end(), key,
+        [](const Container& container, uint16_t k) { return container.key < k; });
+    if (it == containers_.end() || it->key != key) {
+        it = containers_.insert(it, Container());
+        it->key = key;
+    }
+    return &*it;
+}
+
+void RoaringBitmap::add(uint32_t value) {
+    Container* container = find_or_insert(static_cast<uint16_t>(value >> 16));
+    uint16_t low = static_cast<uint16_t>(value);
+
+    if (container->is_bitmap()) {
+        uint64_t& word = container->bitmap[low >> 6];
+        uint64_t bit = uint64_t(1) << (low & 63);
+        if (!(word & bit)) {
+            word |= bit;
+            ++container->cardinality;
+        }
+        return;
+    }
+
+    auto& array = container->array;
+    if (array.empty() || array.back() < low) {
+        array.push_back(low);
+    } else {
+        auto it = std::lower_bound(array.begin(), array.end(), low);
+        if (*it == low) return;
+        array.insert(it, low);
+    }
+    if (++container->cardinality > kArrayMax) {
+        container->to_bitmap();
+    }
+}
+
+bool RoaringBitmap::contains(uint32_t value) const {
+    uint16_t key = static_cast<uint16_t>(value >> 16);
+    size_t c = lower_bound(key);
+    return c < containers_.size() && containers_[c].key == key &&
+           containers_[c].contains(static_cast<uint16_t>(value));
+}
+
+void RoaringBitmap::remove_from(uint32_t first) {
+    uint16_t key = static_cast<uint16_t>(first >> 16);
+    uint16_t low = static_cast<uint16_t>(first);
+    size_t c = lower_bound(key);
+    if (c < containers_.size() && containers_[c].key == key && low > 0) {
+        // Keep the part of this container below first
+        auto& container = containers_[c];
+        if (container.is_bitmap()) {
+            container.bitmap[low >> 6] &= ~(~uint64_t(0) << (low & 63));
+            std::fill(container.bitmap.begin() + (low >> 6) + 1, container.bitmap.end(), 0);
+            container.cardinality = 0;
+            for (uint64_t word : container.bitmap) {
+                container.cardinality += static_cast<uint32_t>(__builtin_popcountll(word));
+            }
+            if (container.cardinality <= kArrayMax) {
+                container.to_array();
+            }
+        } else {
+            container.array.erase(std::lower_bound(container.array.begin(),
+                                                   container.array.end(), low),
+                                  container.array.end());
+            container.cardinality = static_cast<uint32_t>(container.array.size());
+        }
+        if (container.cardinality > 0) {
+            ++c;
+        }
+    }
+    containers_.erase(containers_.begin() + c, containers_.end());
+}
+
+uint64_t RoaringBitmap::cardinality() const {
+    uint64_t count = 0;
+    for (const auto& container : containers_) {
+        count += container.cardinality;
+    }
+    return count;
+}
+
+size_t RoaringBitmap::size_bytes() const {
+    size_t bytes = containers_.capacity() * sizeof(Container);
+    for (const auto& container : containers_) {
+        bytes += container.array.capacity() * sizeof(uint16_t) +
+                 container.bitmap.capacity() * sizeof(uint64_t);
+    }
+    return bytes;
+}
+
+RoaringBitmap RoaringBitmap::range(uint32_t lo, uint32_t hi) {
+    RoaringBitmap result;
+    if (lo >= hi) {
+        return result;
+    }
+
+    uint64_t end = hi;
+    for (uint64_t start = lo; start < end; ) {
+        uint64_t container_end = std::min<uint64_t>(end, ((start >> 16) + 1) << 16);
+        Container container;
+        container.key = static_cast<uint16_t>(start >> 16);
+        container.cardinality = static_cast<uint32_t>(container_end - start);
+
+        uint32_t first = static_cast<uint32_t>(start & 0xFFFF);
+        uint32_t last = first + container.cardinality;      // Exclusive, up to 65536
+        if (container.cardinality <= kArrayMax) {
+            container.array.resize(container.cardinality);
+            for (uint32_t i = 0; i < container.cardinality; ++i) {
+                container.array[i] = static_cast<uint16_t>(first + i);
+            }
+        } else {
+            container.bitmap.assign(kBitmapWords, 0);
+            for (uint32_t w = first >> 6; w <= (last - 1) >> 6; ++w) {
+                uint64_t word = ~uint64_t(0);
+                if (w == first >> 6) word &= ~uint64_t(0) << (first & 63);
+                if (w == (last - 1) >> 6 && (last & 63) != 0) {
+                    word &= ~uint64_t(0) >> (64 - (last & 63));
+                }
+                container.bitmap[w] = word;
+            }
+        }
+        result.containers_.push_back(std::move(container));
+        start = container_end;
+    }
+    return result;
+}
+
+RoaringBitmap RoaringBitmap::from_sorted(const uint32_t* values, size_t count) {
+    RoaringBitmap result;
+    for (size_t i = 0; i < count; ) {
+        uint16_t key = static_cast<uint16_t>(values[i] >> 16);
+        size_t j = i;
+        while (j < count && (values[j] >> 16) == key) {
+            ++j;
+        }
+
+        Container container;
+        container.key = key;
+        container.cardinality = static_cast<uint32_t>(j - i);
+        container.array.resize(j - i);
+        for (size_t k = i; k < j; ++k) {
+            container.array[k - i] = static_cast<uint16_t>(values[k]);
+        }
+        if (container.cardinality > kArrayMax) {
+            container.to_bitmap();
+        }
+        result.containers_.push_back(std::move(container));
+        i = j;
+    }
+    return result;
+}
+
+RoaringBitmap::Container RoaringBitmap::intersect(const Container& a, const Container& b) {
+    Container result;
+    result.key = a.key;
+
+    if (a.is_bitmap() && b.is_bitmap()) {
+        result.bitmap.resize(kBitmapWords);
+        result.cardinality = and_words(a.bitmap.data(), b.bitmap.data(), result.bitmap.data(),
+                                       kBitmapWords);
+        if (result.cardinality <= kArrayMax) {
+            result.to_array();
+        }
+        return result;
+    }
+
+    if (a.is_bitmap() || b.is_bitmap()) {
+        const Container& array = a.is_bitmap() ? b : a;
+        const Container& bitmap = a.is_bitmap() ? a : b;
+        result.array.reserve(array.array.size());
+        for (uint16_t low : array.array) {
+            if ((bitmap.bitmap[low >> 6] >> (low & 63)) & 1) {
+                result.array.push_back(low);
+            }
+        }
+    } else {
+        intersect_arrays(a.array, b.array, result.array);
+    }
+    result.cardinality = static_cast<uint32_t>(result.array.size());
+    return result;
+}
+
+RoaringBitmap& RoaringBitmap::operator&=(const RoaringBitmap& other) {
+    std::vector<Container> result;
+    size_t i = 0, j = 0;
+    while (i < containers_.size() && j < other.containers_.size()) {
+        if (containers_[i].key < other.containers_[j].key) {
+            ++i;
+        } else if (other.containers_[j].key < containers_[i].key) {
+            ++j;
+        } else {
+            Container container = intersect(containers_[i], other.containers_[j]);
+            if (container.cardinality > 0) {
+                result.push_back(std::move(container));
+            }
+            ++i;
+            ++j;
+        }
+    }
+    containers_ = std::move(result);
+    return *this;
+}
+
+RoaringBitmap RoaringBitmap::intersect(std::vector<const RoaringBitmap*> bitmaps) {
+    if (bitmaps.empty()) {
+        return RoaringBitmap();
+    }
+    std::sort(bitmaps.begin(), bitmaps.end(),
+        [](const RoaringBitmap* a, const RoaringBitmap* b) {
+            return a->cardinality() < b->cardinality();
+        });
+
+    RoaringBitmap result = *bitmaps.front();
+    for (size_t i = 1; i < bitmaps.size() && !result.empty(); ++i) {
+        result &= *bitmaps[i];
+    }
+    return result;
+}
+
+std::vector<uint32_t> RoaringBitmap::to_vector() const {
+    std::vector<uint32_t> values;
+    values.reserve(cardinality());
+    for_each([&values](uint32_t value) {
+        values.push_back(value);
+        return true;
+    });
+    return values;
+}
+
+} // namespace sage_tsdb
@@ -0,0 +1,231 @@
+#include "sage_tsdb/core/rollup.h"
+#include <algorithm>
+#include <mutex>
+#include <stdexcept>
+
+namespace sage_tsdb {
+
+namespace {
+
+// 存储表中摘要向量的布局；其后是分位数与去重计数草图
+enum SummaryField {
+    kCount, kSum, kSumSquares, kMin, kMax,
+    kFirstTimestamp, kFirst, kLastTimestamp, kLast,
+    kSummaryFields
+};
+
+std::vector<double> encode_summary(const BlockSummary& summary) {
+    std::vector<double> value(kSummaryFields);
+    value[kCount] = static_cast<double>(summary.count);
+    value[kSum] = summary.sum;
+    value[kSumSquares] = summary.sum_squares;
+    value[kMin] = summary.min;
+    value[kMax] = summary.max;
+    value[kFirstTimestamp] = static_cast<double>(summary.first_timestamp);
+    value[kFirst] = summary.first;
+    value[kLastTimestamp] = static_cast<double>(summary.last_timestamp);
+    value[kLast] = summary.last;
+    if (summary.sketched) {
+        summary.quantiles.encode(value);
+        summary.distinct.encode(value);
+    }
+    return value;
+}
+
+bool decode_summary(const TimeSeriesData& row, BlockSummary& summary) {
+    if (!row.is_array()) {
+        return false;
+    }
+    std::vector<double> value = row.as_vector();
+    if (value.size() < kSummaryFields) {
+        return false;
+    }
+    summary.count = static_cast<uint64_t>(value[kCount]);
+    summary.sum = value[kSum];
+    summary.sum_squares = value[kSumSquares];
+    summary.min = value[kMin];
+    summary.max = value[kMax];
+    summary.first_timestamp = static_cast<int64_t>(value[kFirstTimestamp]);
+    summary.first = value[kFirst];
+    summary.last_timestamp = static_cast<int64_t>(value[kLastTimestamp]);
+    summary.last = value[kLast];
+    // 草图之前写入的行没有草图
+    const double* ptr = value.data() + kSummaryFields;
+    const double* end = value.data() + value.size();
+    summary.sketched = ptr != end && summary.quantiles.decode(ptr, end) &&
+                       summary.distinct.decode(ptr, end) && ptr == end;
+    if (!summary.sketched) {
+        summary.quantiles = QuantileSketch();
+        summary.distinct = DistinctSketch();
+    }
+    return true;
+}
+
+bool matches(const Tags& tags, const Tags& filter_tags) {
+    for (const auto& [key, value] : filter_tags) {
+        auto it = tags.find(key);
+        if (it == tags.end() || it->second != value) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+Rollup::Rollup(const RollupConfig& config, std::shared_ptr<StreamTable> storage)
+    : config_(config), storage_(std::move(storage)) {
+    if (config_.bucket_width <= 0) {
+        throw std::invalid_argument("Rollup '" + config_.name + "' needs a positive bucket_width");
+    }
+    config_.allowed_lateness = std::max<int64_t>(config_.allowed_lateness, 0);
+}
+
+int64_t Rollup::bucketStart(int64_t timestamp) const {
+    int64_t width = config_.bucket_width;
+    return timestamp - (((timestamp % width) + width) % width);
+}
+
+Tags Rollup::groupOf(const Tags& tags) const {
+    Tags group;
+    for (const auto& tag : config_.group_by) {
+        auto it = tags.find(tag);
+        if (it != tags.end()) {
+            group.insert(*it);
+        }
+    }
+    return group;
+}
+
+void Rollup::ingest(const TimeSeriesData* data, size_t count) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+
+    for (size_t i = 0; i < count; ++i) {
+        const TimeSeriesData& point = data[i];
+        int64_t start = bucketStart(point.timestamp);
+        if (start < sealed_before_) {
+            ++stats_.late_dropped;
+            continue;
+        }
+        // 乱序数据也要保持 first/last 正确，按时间戳合并而不是追加
+        BlockSummary single;
+        single.add(point.timestamp, point.as_double());
+        open_[start][groupOf(point.tags)].merge(single);
+        max_timestamp_ = std::max(max_timestamp_, point.timestamp);
+        ++stats_.points;
+    }
+
+    if (max_timestamp_ == std::numeric_limits<int64_t>::min()) {
+        return;
+    }
+    int64_t watermark = max_timestamp_ - config_.allowed_lateness;
+    stats_.watermark = watermark;
+    // 桶 [s, s + width) 在 s + width <= watermark 时 seal，即 s < bucketStart(watermark)
+    sealBefore(bucketStart(watermark));
+}
+
+void Rollup::sealBefore(int64_t bucket_start) {
+    if (bucket_start <= sealed_before_) {
+        return;
+    }
+    std::vector<TimeSeriesData> rows;
+    auto end = open_.lower_bound(bucket_start);
+    for (auto it = open_.begin(); it != end; ++it) {
+        auto bucket = encodeBucket(it->first, it->second);
+        rows.insert(rows.end(), std::make_move_iterator(bucket.begin()),
+                    std::make_move_iterator(bucket.end()));
+    }
+    // 先写存储表再移出内存：scan 持共享锁，看到的桶要么打开要么已 seal
+    if (!rows.empty()) {
+        storage_->insertBatch(rows);
+        stats_.sealed_buckets += rows.size();
+    }
+    open_.erase(open_.begin(), end);
+    sealed_before_ = bucket_start;
+}
+
+std::vector<TimeSeriesData> Rollup::encodeBucket(
+    int64_t bucket_start, const std::map<Tags, BlockSummary>& groups) const {
+    std::vector<TimeSeriesData> rows;
+    rows.reserve(groups.size());
+    for (const auto& [group, summary] : groups) {
+        rows.emplace_back(bucket_start, encode_summary(summary), group);
+    }
+    return rows;
+}
+
+void Rollup::checkpoint() {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    std::vector<TimeSeriesData> rows;
+    for (const auto& [start, groups] : open_) {
+        auto bucket = encodeBucket(start, groups);
+        rows.insert(rows.end(), std::make_move_iterator(bucket.begin()),
+                    std::make_move_iterator(bucket.end()));
+    }
+    if (!rows.empty()) {
+        storage_->insertBatch(rows);
+    }
+}
+
+bool Rollup::canAnswer(const QueryConfig& config) const {
+    if (config.aggregation == AggregationType::NONE) {
+        return false;
+    }
+    if (!config_.aggregations.empty() &&
+        std::find(config_.aggregations.begin(), config_.aggregations.end(),
+                  config.aggregation) == config_.aggregations.end()) {
+        return false;
+    }
+    if (config.window_size < 0 ||
+        (config.window_size > 0 && config.window_size % config_.bucket_width != 0)) {
+        return false;
+    }
+    auto grouped = [this](const std::string& tag) {
+        return std::find(config_.group_by.begin(), config_.group_by.end(), tag) !=
+               config_.group_by.end();
+    };
+    for (const auto& [key, value] : config.filter_tags) {
+        if (!grouped(key)) {
+            return false;
+        }
+    }
+    return std::all_of(config.group_by.begin(), config.group_by.end(), grouped);
+}
+
+void Rollup::scan(const TimeRange& range, const Tags& filter_tags,
+                  const std::function<void(int64_t, const Tags&, const BlockSummary&)>& visit) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+
+    // 已 seal 的桶；检查点写入的打开桶以内存中的版本为准
+    for (const auto& row : storage_->query(range, filter_tags)) {
+        auto open_it = open_.find(row.timestamp);
+        if (open_it != open_.end() && open_it->second.count(row.tags)) {
+            continue;
+        }
+        BlockSummary summary;
+        if (decode_summary(row, summary)) {
+            visit(row.timestamp, row.tags, summary);
+        }
+    }
+
+    for (auto it = open_.lower_bound(range.start_time);
+         it != open_.end() && it->first <= range.end_time; ++it) {
+        for (const auto& [group, summary] : it->second) {
+            if (matches(group, filter_tags)) {
+                visit(it->first, group, summary);
+            }
+        }
+    }
+}
+
+Rollup::Stats Rollup::getStats() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    Stats stats = stats_;
+    stats.open_buckets = 0;
+    for (const auto& [start, groups] : open_) {
+        stats.open_buckets += groups.size();
+    }
+    return stats;
+}
+
+} // namespace sage_tsdb
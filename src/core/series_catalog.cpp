@@ -0,0 +1,248 @@
+#include "sage_tsdb/core/series_catalog.h"
+#include "sage_tsdb/core/block_codec.h"
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <mutex>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace sage_tsdb {
+
+namespace {
+
+template<typename T>
+void append_pod(std::vector<uint8_t>& out, const T& value) {
+    const auto* bytes = reinterpret_cast<const uint8_t*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template<typename T>
+bool read_pod(const uint8_t*& ptr, const uint8_t* end, T& value) {
+    if (static_cast<size_t>(end - ptr) < sizeof(T)) {
+        return false;
+    }
+    std::memcpy(&value, ptr, sizeof(T));
+    ptr += sizeof(T);
+    return true;
+}
+
+bool read_string(const uint8_t*& ptr, const uint8_t* end, std::string& value) {
+    uint32_t len;
+    if (!read_pod(ptr, end, len) || static_cast<size_t>(end - ptr) < len) {
+        return false;
+    }
+    value.assign(reinterpret_cast<const char*>(ptr), len);
+    ptr += len;
+    return true;
+}
+
+void append_string(std::vector<uint8_t>& out, const std::string& value) {
+    append_pod(out, static_cast<uint32_t>(value.size()));
+    out.insert(out.end(), value.begin(), value.end());
+}
+
+bool write_fully(int fd, const uint8_t* data, size_t size) {
+    while (size > 0) {
+        ssize_t written = ::write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+constexpr size_t kHeaderSize = 2 * sizeof(uint32_t);
+constexpr size_t kFrameSize = 2 * sizeof(uint32_t);
+
+size_t tags_bytes(const Tags& tags) {
+    size_t bytes = 0;
+    for (const auto& [key, value] : tags) {
+        bytes += key.size() + value.size();
+    }
+    return bytes;
+}
+
+} // namespace
+
+SeriesCatalog::~SeriesCatalog() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+bool SeriesCatalog::open(const std::string& path) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+
+    std::vector<uint8_t> contents;
+    {
+        std::ifstream in(path, std::ios::binary);
+        if (in.is_open()) {
+            contents.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        }
+    }
+
+    size_t valid_end = 0;
+    if (contents.size() >= kHeaderSize) {
+        uint32_t magic, version;
+        std::memcpy(&magic, contents.data(), sizeof(magic));
+        std::memcpy(&version, contents.data() + sizeof(magic), sizeof(version));
+        if (magic != kMagic || version != kVersion) {
+            std::cerr << "Unrecognized series catalog: " << path << std::endl;
+            return false;
+        }
+        valid_end = kHeaderSize;
+
+        // Records must follow the ids already loaded; stop at the first
+        // torn or corrupt one
+        size_t pos = kHeaderSize;
+        while (contents.size() - pos >= kFrameSize) {
+            uint32_t length, crc;
+            std::memcpy(&length, contents.data() + pos, sizeof(length));
+            std::memcpy(&crc, contents.data() + pos + sizeof(length), sizeof(crc));
+            const uint8_t* ptr = contents.data() + pos + kFrameSize;
+            const uint8_t* end = ptr + length;
+            if (contents.size() - pos - kFrameSize < length || crc32c(ptr, length) != crc) {
+                break;
+            }
+
+            uint32_t id, count;
+            Tags tags;
+            bool ok = read_pod(ptr, end, id) && read_pod(ptr, end, count) &&
+                      id == series_.size();
+            for (uint32_t i = 0; ok && i < count; ++i) {
+                std::string key, value;
+                ok = read_string(ptr, end, key) && read_string(ptr, end, value);
+                tags.emplace(std::move(key), std::move(value));
+            }
+            if (!ok || ptr != end) {
+                break;
+            }
+
+            string_bytes_ += tags_bytes(tags);
+            by_hash_.emplace(TimeSeriesData::hash_tags(tags), id);
+            series_.push_back(std::move(tags));
+            pos += kFrameSize + length;
+            valid_end = pos;
+        }
+    }
+
+    fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd_ < 0) {
+        std::cerr << "Failed to open series catalog: " << path << std::endl;
+        return false;
+    }
+    if (valid_end < contents.size() && ::ftruncate(fd_, static_cast<off_t>(valid_end)) != 0) {
+        return false;
+    }
+    if (valid_end == 0) {
+        std::vector<uint8_t> header;
+        append_pod(header, kMagic);
+        append_pod(header, kVersion);
+        if (::ftruncate(fd_, 0) != 0 || !write_fully(fd_, header.data(), header.size()) ||
+            ::fdatasync(fd_) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint32_t SeriesCatalog::find_locked(const Tags& tags, uint64_t hash) const {
+    auto [begin, end] = by_hash_.equal_range(hash);
+    for (auto it = begin; it != end; ++it) {
+        if (series_[it->second] == tags) {
+            return it->second;
+        }
+    }
+    return kInvalidId;
+}
+
+uint32_t SeriesCatalog::find(const Tags& tags) const {
+    uint64_t hash = TimeSeriesData::hash_tags(tags);
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return find_locked(tags, hash);
+}
+
+uint32_t SeriesCatalog::intern(const Tags& tags) {
+    uint64_t hash = TimeSeriesData::hash_tags(tags);
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        uint32_t id = find_locked(tags, hash);
+        if (id != kInvalidId) {
+            return id;
+        }
+    }
+
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    uint32_t id = find_locked(tags, hash);
+    if (id != kInvalidId) {
+        return id;
+    }
+    id = static_cast<uint32_t>(series_.size());
+    if (id == kInvalidId) {
+        return kInvalidId;
+    }
+
+    if (fd_ >= 0) {
+        // Durable before the id can reach any log
+        std::vector<uint8_t> payload;
+        append_pod(payload, id);
+        append_pod(payload, static_cast<uint32_t>(tags.size()));
+        for (const auto& [key, value] : tags) {
+            append_string(payload, key);
+            append_string(payload, value);
+        }
+        std::vector<uint8_t> frame;
+        append_pod(frame, static_cast<uint32_t>(payload.size()));
+        append_pod(frame, crc32c(payload.data(), payload.size()));
+        frame.insert(frame.end(), payload.begin(), payload.end());
+        if (!write_fully(fd_, frame.data(), frame.size()) || ::fdatasync(fd_) != 0) {
+            std::cerr << "Series catalog write failed" << std::endl;
+            return kInvalidId;
+        }
+    }
+
+    string_bytes_ += tags_bytes(tags);
+    by_hash_.emplace(hash, id);
+    series_.push_back(tags);
+    return id;
+}
+
+const Tags& SeriesCatalog::tags(uint32_t id) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return series_.at(id);
+}
+
+bool SeriesCatalog::contains(uint32_t id) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return id < series_.size();
+}
+
+size_t SeriesCatalog::size() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return series_.size();
+}
+
+size_t SeriesCatalog::memory_bytes() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    size_t bytes = string_bytes_ + series_.size() * sizeof(Tags) +
+                   by_hash_.size() * (sizeof(uint64_t) + sizeof(uint32_t) + 2 * sizeof(void*));
+    for (const auto& tags : series_) {
+        // One tree node per pair
+        bytes += tags.size() * (2 * sizeof(std::string) + 4 * sizeof(void*));
+    }
+    return bytes;
+}
+
+} // namespace sage_tsdb
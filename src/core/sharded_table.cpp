@@ -0,0 +1,293 @@
+#include "sage_tsdb/core/sharded_table.h"
+#include "sage_tsdb/core/aggregation.h"
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <thread>
+
+namespace sage_tsdb {
+
+namespace {
+
+// Run fn(i) for every i in [0, count), the first on the calling thread
+template <typename Fn>
+void run_parallel(size_t count, Fn&& fn) {
+    std::vector<std::thread> threads;
+    threads.reserve(count > 0 ? count - 1 : 0);
+    for (size_t i = 1; i < count; ++i) {
+        threads.emplace_back([&fn, i]() { fn(i); });
+    }
+    if (count > 0) {
+        fn(0);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+// Aggregate points in timestamp order the way TimeSeriesIndex does
+std::vector<TimeSeriesData> aggregate_points(const TimeSeriesIndex::ResultView& points,
+                                             const QueryConfig& config) {
+    std::vector<Tags> group_tags = {config.filter_tags};
+    std::map<Tags, uint32_t> group_ids;
+    auto group_of = [&](const Tags& tags) -> uint32_t {
+        if (config.group_by.empty()) {
+            return 0;
+        }
+        Tags key;
+        for (const auto& tag : config.group_by) {
+            auto it = tags.find(tag);
+            if (it != tags.end()) {
+                key.insert(*it);
+            }
+        }
+        auto [it, inserted] = group_ids.emplace(key, static_cast<uint32_t>(group_ids.size()));
+        if (inserted) {
+            Tags out = config.filter_tags;
+            out.insert(key.begin(), key.end());
+            group_tags.resize(group_ids.size());
+            group_tags[it->second] = std::move(out);
+        }
+        return it->second;
+    };
+
+    auto buckets = dispatch_aggregation(config.aggregation, [&](auto type) {
+        WindowedAggregator<decltype(type)::value> aggregator(config.window_size,
+                                                             config.time_range.start_time,
+                                                             config.quantile);
+        for (auto point : points) {
+            aggregator.add(group_of(point.tags()), point.timestamp(), point.as_double());
+        }
+        return aggregator.finish();
+    });
+
+    size_t limit = config.limit > 0 ? static_cast<size_t>(config.limit) : SIZE_MAX;
+    std::vector<TimeSeriesData> results;
+    for (const auto& bucket : buckets) {
+        if (results.size() >= limit) {
+            break;
+        }
+        results.emplace_back(bucket.window_start, bucket.value, group_tags[bucket.group]);
+    }
+    return results;
+}
+
+} // namespace
+
+void ShardedTable::Shard::note_series(uint32_t id, const Tags& tags) {
+    {
+        std::shared_lock<std::shared_mutex> lock(tags_mutex);
+        if (series.count(id)) {
+            return;
+        }
+    }
+    std::unique_lock<std::shared_mutex> lock(tags_mutex);
+    if (series.insert(id).second) {
+        for (const auto& [key, value] : tags) {
+            tag_values[key].insert(value);
+        }
+    }
+}
+
+bool ShardedTable::Shard::may_match(const Tags& filter_tags) const {
+    std::shared_lock<std::shared_mutex> lock(tags_mutex);
+    for (const auto& [key, value] : filter_tags) {
+        auto it = tag_values.find(key);
+        if (it == tag_values.end() || it->second.count(value) == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+ShardedTable::ShardedTable(const ShardedTableConfig& config,
+                           std::shared_ptr<SeriesCatalog> catalog)
+    : config_(config),
+      catalog_(catalog ? std::move(catalog) : std::make_shared<SeriesCatalog>()) {
+    size_t num_shards = std::max<size_t>(config_.num_shards, 1);
+    shards_.reserve(num_shards);
+    for (size_t i = 0; i < num_shards; ++i) {
+        auto shard = std::make_unique<Shard>();
+        shard->index = std::make_unique<TimeSeriesIndex>(catalog_);
+        if (!config_.data_dir.empty()) {
+            LSMConfig lsm_config = config_.lsm;
+            lsm_config.data_dir = config_.data_dir + "/shard-" + std::to_string(i);
+            shard->tree = std::make_unique<LSMTree>(lsm_config);
+        }
+        shards_.push_back(std::move(shard));
+    }
+
+    // Reload the indexes from what the shard trees recovered
+    std::atomic<size_t> loaded{0};
+    run_parallel(shards_.size(), [&](size_t i) {
+        Shard& shard = *shards_[i];
+        if (!shard.tree) {
+            return;
+        }
+        for (auto it = shard.tree->new_iterator(); it->valid(); it->next()) {
+            const TimeSeriesData& point = it->value();
+            shard.index->add(point);
+            shard.note_series(catalog_->intern(point.tags), point.tags);
+            loaded.fetch_add(1, std::memory_order_relaxed);
+        }
+    });
+    next_index_.store(loaded.load());
+}
+
+ShardedTable::~ShardedTable() = default;
+
+size_t ShardedTable::shard_of(const Tags& tags) const {
+    uint64_t hash;
+    if (config_.shard_by.empty()) {
+        hash = TimeSeriesData::hash_tags(tags);
+    } else {
+        Tags key;
+        for (const auto& tag : config_.shard_by) {
+            auto it = tags.find(tag);
+            if (it != tags.end()) {
+                key.insert(*it);
+            }
+        }
+        hash = TimeSeriesData::hash_tags(key);
+    }
+    // FNV leaves the low bits weak: finish with a 64-bit mix
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    return static_cast<size_t>(hash % shards_.size());
+}
+
+std::vector<size_t> ShardedTable::candidate_shards(const Tags& filter_tags) const {
+    std::vector<size_t> shards;
+    bool routed = !config_.shard_by.empty() &&
+        std::all_of(config_.shard_by.begin(), config_.shard_by.end(),
+                    [&](const std::string& tag) { return filter_tags.count(tag) > 0; });
+    if (routed) {
+        size_t shard = shard_of(filter_tags);
+        if (shards_[shard]->may_match(filter_tags)) {
+            shards.push_back(shard);
+        }
+        return shards;
+    }
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        if (filter_tags.empty() || shards_[i]->may_match(filter_tags)) {
+            shards.push_back(i);
+        }
+    }
+    return shards;
+}
+
+void ShardedTable::apply(Shard& shard, const std::vector<const TimeSeriesData*>& points) {
+    if (shard.tree) {
+        // Logged before it becomes visible
+        std::vector<TimeSeriesData> batch;
+        batch.reserve(points.size());
+        for (const auto* point : points) {
+            batch.push_back(*point);
+        }
+        if (!shard.tree->put_batch(std::move(batch))) {
+            std::cerr << "Shard write failed" << std::endl;
+        }
+    }
+    for (const auto* point : points) {
+        shard.index->add(*point);
+        shard.note_series(catalog_->intern(point->tags), point->tags);
+    }
+}
+
+size_t ShardedTable::insert(const TimeSeriesData& data) {
+    size_t index = next_index_.fetch_add(1, std::memory_order_relaxed);
+    apply(*shards_[shard_of(data.tags)], {&data});
+    return index;
+}
+
+std::vector<size_t> ShardedTable::insertBatch(const std::vector<TimeSeriesData>& data_list) {
+    size_t first = next_index_.fetch_add(data_list.size(), std::memory_order_relaxed);
+    std::vector<size_t> indices(data_list.size());
+
+    std::vector<std::vector<const TimeSeriesData*>> parts(shards_.size());
+    for (size_t i = 0; i < data_list.size(); ++i) {
+        indices[i] = first + i;
+        parts[shard_of(data_list[i].tags)].push_back(&data_list[i]);
+    }
+
+    std::vector<size_t> touched;
+    for (size_t s = 0; s < parts.size(); ++s) {
+        if (!parts[s].empty()) {
+            touched.push_back(s);
+        }
+    }
+    run_parallel(touched.size(), [&](size_t i) {
+        apply(*shards_[touched[i]], parts[touched[i]]);
+    });
+    return indices;
+}
+
+bool ShardedTable::groups_within_shards(const QueryConfig& config) const {
+    return !config_.shard_by.empty() &&
+        std::all_of(config_.shard_by.begin(), config_.shard_by.end(),
+                    [&](const std::string& tag) {
+                        return std::find(config.group_by.begin(), config.group_by.end(), tag) !=
+                               config.group_by.end();
+                    });
+}
+
+std::vector<TimeSeriesData> ShardedTable::query(const QueryConfig& config) const {
+    return query_view(config).materialize();
+}
+
+TimeSeriesIndex::ResultView ShardedTable::query_view(const QueryConfig& config) const {
+    std::vector<size_t> shards = candidate_shards(config.filter_tags);
+    if (shards.empty()) {
+        return {};
+    }
+    if (shards.size() == 1) {
+        return shards_[shards.front()]->index->query_view(config);
+    }
+
+    // Groups spanning shards need every point before aggregating
+    bool merge_points = config.aggregation != AggregationType::NONE &&
+                        !groups_within_shards(config);
+    QueryConfig shard_config = config;
+    if (merge_points) {
+        shard_config.aggregation = AggregationType::NONE;
+        shard_config.limit = 0;
+    }
+
+    std::vector<TimeSeriesIndex::ResultView> views(shards.size());
+    run_parallel(shards.size(), [&](size_t i) {
+        views[i] = shards_[shards[i]]->index->query_view(shard_config);
+    });
+
+    if (merge_points) {
+        auto points = TimeSeriesIndex::ResultView::merge(std::move(views), SIZE_MAX);
+        return TimeSeriesIndex::ResultView(aggregate_points(points, config));
+    }
+    size_t limit = config.limit > 0 ? static_cast<size_t>(config.limit) : SIZE_MAX;
+    return TimeSeriesIndex::ResultView::merge(std::move(views), limit);
+}
+
+size_t ShardedTable::size() const {
+    size_t total = 0;
+    for (const auto& shard : shards_) {
+        total += shard->index->size();
+    }
+    return total;
+}
+
+bool ShardedTable::empty() const {
+    return size() == 0;
+}
+
+void ShardedTable::clear() {
+    for (auto& shard : shards_) {
+        shard->index->clear();
+        std::unique_lock<std::shared_mutex> lock(shard->tags_mutex);
+        shard->series.clear();
+        shard->tag_values.clear();
+    }
+    next_index_.store(0);
+}
+
+} // namespace sage_tsdb
@@ -0,0 +1,72 @@
+#include "sage_tsdb/core/simd.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+
+namespace sage_tsdb {
+namespace simd {
+
+namespace {
+
+Level detect() {
+#if defined(SAGE_TSDB_SIMD_DISPATCH)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return Level::AVX512;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return Level::AVX2;
+    }
+#endif
+    return Level::Scalar;
+}
+
+Level clamp(Level level) {
+    return std::min(level, detected());
+}
+
+Level initial_level() {
+    const char* cap = std::getenv("SAGE_TSDB_SIMD");
+    if (cap != nullptr) {
+        for (Level level : {Level::Scalar, Level::AVX2, Level::AVX512}) {
+            if (std::strcmp(cap, name(level)) == 0) {
+                return clamp(level);
+            }
+        }
+    }
+    return detected();
+}
+
+std::atomic<Level>& active_level() {
+    static std::atomic<Level> level{initial_level()};
+    return level;
+}
+
+} // namespace
+
+Level detected() {
+    static const Level level = detect();
+    return level;
+}
+
+Level active() {
+    return active_level().load(std::memory_order_relaxed);
+}
+
+Level set_level(Level level) {
+    level = clamp(level);
+    active_level().store(level, std::memory_order_relaxed);
+    return level;
+}
+
+const char* name(Level level) {
+    switch (level) {
+        case Level::AVX2: return "avx2";
+        case Level::AVX512: return "avx512";
+        default: return "scalar";
+    }
+}
+
+} // namespace simd
+} // namespace sage_tsdb
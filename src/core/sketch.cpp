@@ -0,0 +1,426 @@
+#include "sage_tsdb/core/sketch.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <numbers>
+
+namespace sage_tsdb {
+
+namespace {
+
+template <typename T>
+void append_pod(std::vector<uint8_t>& out, const T& value) {
+    const auto* bytes = reinterpret_cast<const uint8_t*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T>
+bool read_pod(const uint8_t*& ptr, const uint8_t* end, T& value) {
+    if (static_cast<size_t>(end - ptr) < sizeof(T)) {
+        return false;
+    }
+    std::memcpy(&value, ptr, sizeof(T));
+    ptr += sizeof(T);
+    return true;
+}
+
+// Buffered values per compression; larger buffers merge less often
+constexpr size_t kBufferFactor = 5;
+
+// Arcsine scale function of the t-digest and its inverse
+double scale(double q) {
+    return QuantileSketch::kCompression / (2.0 * std::numbers::pi) * std::asin(2.0 * q - 1.0);
+}
+
+double scale_inverse(double k) {
+    double q = (std::sin(k * 2.0 * std::numbers::pi / QuantileSketch::kCompression) + 1.0) / 2.0;
+    return std::clamp(q, 0.0, 1.0);
+}
+
+// splitmix64 finalizer
+uint64_t mix(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+} // anonymous namespace
+
+// ========== QuantileSketch ==========
+
+void QuantileSketch::add(double value) {
+    if (std::isnan(value)) {
+        return;
+    }
+    if (count_ == 0) {
+        min_ = max_ = value;
+    } else {
+        min_ = std::min(min_, value);
+        max_ = std::max(max_, value);
+    }
+    ++count_;
+    buffer_.push_back({value, 1.0});
+    if (buffer_.size() >= kBufferFactor * static_cast<size_t>(kCompression)) {
+        compress();
+    }
+}
+
+void QuantileSketch::merge(const QuantileSketch& other) {
+    if (other.empty()) {
+        return;
+    }
+    if (empty()) {
+        min_ = other.min_;
+        max_ = other.max_;
+    } else {
+        min_ = std::min(min_, other.min_);
+        max_ = std::max(max_, other.max_);
+    }
+    count_ += other.count_;
+    // Small sketches (single points) are only buffered, like add()
+    buffer_.insert(buffer_.end(), other.centroids_.begin(), other.centroids_.end());
+    buffer_.insert(buffer_.end(), other.buffer_.begin(), other.buffer_.end());
+    if (buffer_.size() >= kBufferFactor * static_cast<size_t>(kCompression)) {
+        compress();
+    }
+}
+
+void QuantileSketch::compress() {
+    centroids_.insert(centroids_.end(), buffer_.begin(), buffer_.end());
+    buffer_.clear();
+    compress(centroids_);
+}
+
+void QuantileSketch::compress(std::vector<Centroid>& centroids) {
+    if (centroids.size() <= 1) {
+        return;
+    }
+    std::sort(centroids.begin(), centroids.end(),
+              [](const Centroid& a, const Centroid& b) { return a.mean < b.mean; });
+    double total = 0.0;
+    for (const auto& centroid : centroids) {
+        total += centroid.weight;
+    }
+
+    // Greedily merge neighbours while the centroid spans at most one unit of k
+    size_t out = 0;
+    double done = 0.0;      // Weight of the centroids before centroids[out]
+    double limit = total * scale_inverse(scale(0.0) + 1.0);
+    for (size_t i = 1; i < centroids.size(); ++i) {
+        Centroid& current = centroids[out];
+        const Centroid& next = centroids[i];
+        if (done + current.weight + next.weight <= limit) {
+            double weight = current.weight + next.weight;
+            current.mean += (next.mean - current.mean) * next.weight / weight;
+            current.weight = weight;
+        } else {
+            done += current.weight;
+            limit = total * scale_inverse(scale(done / total) + 1.0);
+            centroids[++out] = next;
+        }
+    }
+    centroids.resize(out + 1);
+}
+
+void QuantileSketch::compact() {
+    compress();
+    buffer_.shrink_to_fit();
+    centroids_.shrink_to_fit();
+}
+
+std::vector<QuantileSketch::Centroid> QuantileSketch::merged() const {
+    std::vector<Centroid> centroids = centroids_;
+    if (!buffer_.empty()) {
+        centroids.insert(centroids.end(), buffer_.begin(), buffer_.end());
+        compress(centroids);
+    }
+    return centroids;
+}
+
+double QuantileSketch::quantile(double q) const {
+    if (empty()) {
+        return std::nan("");
+    }
+    q = std::clamp(q, 0.0, 1.0);
+    std::vector<Centroid> centroids = merged();
+    if (centroids.size() == 1) {
+        return centroids[0].mean;
+    }
+
+    // Each centroid's mean sits at the middle of its weight; interpolate
+    // between neighbouring middles, and towards min/max at the ends
+    double total = static_cast<double>(count_);
+    double rank = q * total;
+    const Centroid& first = centroids.front();
+    if (rank < first.weight / 2.0) {
+        return min_ + (first.mean - min_) * rank / (first.weight / 2.0);
+    }
+    const Centroid& last = centroids.back();
+    if (rank > total - last.weight / 2.0) {
+        double tail = (total - rank) / (last.weight / 2.0);
+        return max_ - (max_ - last.mean) * tail;
+    }
+    double cumulative = first.weight / 2.0;     // Rank of the current middle
+    for (size_t i = 0; i + 1 < centroids.size(); ++i) {
+        double gap = (centroids[i].weight + centroids[i + 1].weight) / 2.0;
+        if (rank <= cumulative + gap) {
+            double t = gap > 0.0 ? (rank - cumulative) / gap : 0.0;
+            return centroids[i].mean + t * (centroids[i + 1].mean - centroids[i].mean);
+        }
+        cumulative += gap;
+    }
+    return last.mean;
+}
+
+size_t QuantileSketch::memory_bytes() const {
+    return (centroids_.capacity() + buffer_.capacity()) * sizeof(Centroid);
+}
+
+void QuantileSketch::serialize(std::vector<uint8_t>& out) const {
+    std::vector<Centroid> centroids = merged();
+    append_pod(out, static_cast<uint32_t>(centroids.size()));
+    if (centroids.empty()) {
+        return;
+    }
+    append_pod(out, min_);
+    append_pod(out, max_);
+    for (const auto& centroid : centroids) {
+        append_pod(out, centroid.mean);
+        append_pod(out, centroid.weight);
+    }
+}
+
+bool QuantileSketch::deserialize(const uint8_t*& ptr, const uint8_t* end) {
+    *this = QuantileSketch();
+    uint32_t size;
+    if (!read_pod(ptr, end, size)) {
+        return false;
+    }
+    if (size == 0) {
+        return true;
+    }
+    if (static_cast<size_t>(end - ptr) < 2 * sizeof(double) + size * sizeof(Centroid) ||
+        !read_pod(ptr, end, min_) || !read_pod(ptr, end, max_)) {
+        return false;
+    }
+    centroids_.resize(size);
+    double total = 0.0;
+    for (auto& centroid : centroids_) {
+        read_pod(ptr, end, centroid.mean);
+        read_pod(ptr, end, centroid.weight);
+        total += centroid.weight;
+    }
+    count_ = static_cast<uint64_t>(std::llround(total));
+    return true;
+}
+
+void QuantileSketch::encode(std::vector<double>& out) const {
+    std::vector<Centroid> centroids = merged();
+    out.push_back(static_cast<double>(centroids.size()));
+    if (centroids.empty()) {
+        return;
+    }
+    out.push_back(min_);
+    out.push_back(max_);
+    for (const auto& centroid : centroids) {
+        out.push_back(centroid.mean);
+        out.push_back(centroid.weight);
+    }
+}
+
+bool QuantileSketch::decode(const double*& ptr, const double* end) {
+    *this = QuantileSketch();
+    if (ptr == end) {
+        return false;
+    }
+    double size = *ptr++;
+    if (!(size >= 0.0) || size > static_cast<double>(end - ptr)) {
+        return false;
+    }
+    auto n = static_cast<size_t>(size);
+    if (n == 0) {
+        return true;
+    }
+    if (static_cast<size_t>(end - ptr) < 2 + 2 * n) {
+        return false;
+    }
+    min_ = *ptr++;
+    max_ = *ptr++;
+    centroids_.resize(n);
+    double total = 0.0;
+    for (auto& centroid : centroids_) {
+        centroid.mean = *ptr++;
+        centroid.weight = *ptr++;
+        total += centroid.weight;
+    }
+    count_ = static_cast<uint64_t>(std::llround(total));
+    return true;
+}
+
+// ========== DistinctSketch ==========
+
+void DistinctSketch::add(double value) {
+    if (value == 0.0) {
+        value = 0.0;    // -0.0 == 0.0
+    }
+    add_hash(mix(std::bit_cast<uint64_t>(value)));
+}
+
+void DistinctSketch::add_hash(uint64_t hash) {
+    auto index = static_cast<uint32_t>(hash >> (64 - kPrecision));
+    uint64_t rest = hash << kPrecision;
+    auto rank = static_cast<uint8_t>(
+        rest == 0 ? 64 - kPrecision + 1 : std::countl_zero(rest) + 1);
+    set(index, rank);
+}
+
+void DistinctSketch::set(uint32_t index, uint8_t rank) {
+    if (!registers_.empty()) {
+        registers_[index] = std::max(registers_[index], rank);
+        return;
+    }
+    uint32_t entry = (index << 6) | rank;
+    auto it = std::lower_bound(sparse_.begin(), sparse_.end(), index << 6);
+    if (it != sparse_.end() && (*it >> 6) == index) {
+        *it = std::max(*it, entry);
+        return;
+    }
+    sparse_.insert(it, entry);
+    if (sparse_.size() > kSparseLimit) {
+        densify();
+    }
+}
+
+void DistinctSketch::densify() {
+    registers_.assign(kRegisters, 0);
+    for (uint32_t entry : sparse_) {
+        registers_[entry >> 6] = static_cast<uint8_t>(entry & 63);
+    }
+    sparse_.clear();
+    sparse_.shrink_to_fit();
+}
+
+void DistinctSketch::merge(const DistinctSketch& other) {
+    if (!other.registers_.empty()) {
+        if (registers_.empty()) {
+            densify();
+        }
+        for (uint32_t i = 0; i < kRegisters; ++i) {
+            registers_[i] = std::max(registers_[i], other.registers_[i]);
+        }
+        return;
+    }
+    for (uint32_t entry : other.sparse_) {
+        set(entry >> 6, static_cast<uint8_t>(entry & 63));
+    }
+}
+
+double DistinctSketch::estimate() const {
+    if (empty()) {
+        return 0.0;
+    }
+    constexpr double m = kRegisters;
+    double sum = 0.0;
+    uint32_t zeros = 0;
+    if (registers_.empty()) {
+        zeros = kRegisters - static_cast<uint32_t>(sparse_.size());
+        sum = zeros;
+        for (uint32_t entry : sparse_) {
+            sum += std::ldexp(1.0, -static_cast<int>(entry & 63));
+        }
+    } else {
+        for (uint8_t rank : registers_) {
+            zeros += rank == 0;
+            sum += std::ldexp(1.0, -static_cast<int>(rank));
+        }
+    }
+    double alpha = 0.7213 / (1.0 + 1.079 / m);
+    double estimate = alpha * m * m / sum;
+    if (estimate <= 2.5 * m && zeros > 0) {
+        estimate = m * std::log(m / zeros);   // Linear counting for small sets
+    }
+    return estimate;
+}
+
+size_t DistinctSketch::memory_bytes() const {
+    return sparse_.capacity() * sizeof(uint32_t) + registers_.capacity();
+}
+
+void DistinctSketch::serialize(std::vector<uint8_t>& out) const {
+    if (registers_.empty()) {
+        append_pod(out, static_cast<uint32_t>(sparse_.size()));
+        for (uint32_t entry : sparse_) {
+            append_pod(out, entry);
+        }
+    } else {
+        append_pod(out, UINT32_MAX);    // Dense
+        out.insert(out.end(), registers_.begin(), registers_.end());
+    }
+}
+
+bool DistinctSketch::deserialize(const uint8_t*& ptr, const uint8_t* end) {
+    *this = DistinctSketch();
+    uint32_t size;
+    if (!read_pod(ptr, end, size)) {
+        return false;
+    }
+    if (size == UINT32_MAX) {
+        if (static_cast<size_t>(end - ptr) < kRegisters) {
+            return false;
+        }
+        registers_.assign(ptr, ptr + kRegisters);
+        ptr += kRegisters;
+        return true;
+    }
+    if (size > kSparseLimit || static_cast<size_t>(end - ptr) < size * sizeof(uint32_t)) {
+        return false;
+    }
+    sparse_.resize(size);
+    for (auto& entry : sparse_) {
+        read_pod(ptr, end, entry);
+    }
+    return std::is_sorted(sparse_.begin(), sparse_.end());
+}
+
+void DistinctSketch::encode(std::vector<double>& out) const {
+    // Non-zero registers as (index << 6) | rank, exact in a double
+    size_t at = out.size();
+    out.push_back(0.0);
+    if (registers_.empty()) {
+        for (uint32_t entry : sparse_) {
+            out.push_back(static_cast<double>(entry));
+        }
+    } else {
+        for (uint32_t i = 0; i < kRegisters; ++i) {
+            if (registers_[i] != 0) {
+                out.push_back(static_cast<double>((i << 6) | registers_[i]));
+            }
+        }
+    }
+    out[at] = static_cast<double>(out.size() - at - 1);
+}
+
+bool DistinctSketch::decode(const double*& ptr, const double* end) {
+    *this = DistinctSketch();
+    if (ptr == end) {
+        return false;
+    }
+    double size = *ptr++;
+    if (!(size >= 0.0) || size > static_cast<double>(end - ptr)) {
+        return false;
+    }
+    for (auto n = static_cast<size_t>(size); n > 0; --n) {
+        auto entry = static_cast<uint32_t>(*ptr++);
+        if ((entry >> 6) >= kRegisters) {
+            return false;
+        }
+        set(entry >> 6, static_cast<uint8_t>(entry & 63));
+    }
+    return true;
+}
+
+} // namespace sage_tsdb
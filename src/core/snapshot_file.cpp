@@ -0,0 +1,228 @@
+#include "sage_tsdb/core/snapshot_file.h"
+#include "sage_tsdb/core/block_codec.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+namespace sage_tsdb {
+
+namespace {
+
+constexpr size_t kFooterEntryBytes = 8 + 4 + 4 + 4 + 8 + 8;
+constexpr size_t kTrailerBytes = 8 + 4 + 4;
+
+template<typename T>
+void write_pod(std::ofstream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template<typename T>
+T read_pod(const uint8_t*& ptr) {
+    T value;
+    std::memcpy(&value, ptr, sizeof(T));
+    ptr += sizeof(T);
+    return value;
+}
+
+} // anonymous namespace
+
+SnapshotWriter::~SnapshotWriter() {
+    if (out_.is_open()) {
+        close();
+    }
+}
+
+bool SnapshotWriter::open(const std::string& path) {
+    out_.open(path, std::ios::binary | std::ios::trunc);
+    if (!out_) {
+        std::cerr << "Failed to create snapshot file: " << path << std::endl;
+        return false;
+    }
+    write_pod(out_, kMagic);
+    write_pod(out_, kVersion);
+    offset_ = sizeof(kMagic) + sizeof(kVersion);
+    pending_.reserve(kChunkPoints);
+    chunks_.clear();
+    points_written_ = 0;
+    return static_cast<bool>(out_);
+}
+
+bool SnapshotWriter::append(const TimeSeriesData& point) {
+    pending_.push_back(point);
+    return pending_.size() < kChunkPoints || write_chunk();
+}
+
+bool SnapshotWriter::append(TimeSeriesData&& point) {
+    pending_.push_back(std::move(point));
+    return pending_.size() < kChunkPoints || write_chunk();
+}
+
+bool SnapshotWriter::write_chunk() {
+    if (pending_.empty()) {
+        return true;
+    }
+    std::stable_sort(pending_.begin(), pending_.end(),
+                     [](const TimeSeriesData& a, const TimeSeriesData& b) {
+                         return a.timestamp < b.timestamp;
+                     });
+    encoded_.clear();
+    ColumnarBlock::encode(pending_.data(), pending_.size(), encoded_);
+
+    SnapshotChunk chunk;
+    chunk.offset = offset_;
+    chunk.size = static_cast<uint32_t>(encoded_.size());
+    chunk.crc = crc32c(encoded_.data(), encoded_.size());
+    chunk.points = static_cast<uint32_t>(pending_.size());
+    chunk.min_timestamp = pending_.front().timestamp;
+    chunk.max_timestamp = pending_.back().timestamp;
+    chunks_.push_back(chunk);
+
+    out_.write(reinterpret_cast<const char*>(encoded_.data()),
+               static_cast<std::streamsize>(encoded_.size()));
+    offset_ += encoded_.size();
+    points_written_ += pending_.size();
+    pending_.clear();
+    return static_cast<bool>(out_);
+}
+
+bool SnapshotWriter::close() {
+    bool ok = write_chunk();
+    uint64_t footer_offset = offset_;
+    for (const auto& chunk : chunks_) {
+        write_pod(out_, chunk.offset);
+        write_pod(out_, chunk.size);
+        write_pod(out_, chunk.crc);
+        write_pod(out_, chunk.points);
+        write_pod(out_, chunk.min_timestamp);
+        write_pod(out_, chunk.max_timestamp);
+    }
+    write_pod(out_, footer_offset);
+    write_pod(out_, static_cast<uint32_t>(chunks_.size()));
+    write_pod(out_, kMagic);
+    offset_ += chunks_.size() * kFooterEntryBytes + kTrailerBytes;
+    out_.close();
+    return ok && !out_.fail();
+}
+
+bool SnapshotReader::open(const std::string& path) {
+    chunks_.clear();
+    file_ = MappedFile::open(path);
+    if (!file_) {
+        return false;
+    }
+    const size_t size = file_->size();
+    const size_t header = sizeof(SnapshotWriter::kMagic) + sizeof(SnapshotWriter::kVersion);
+    if (size < header + kTrailerBytes) {
+        file_.reset();
+        return false;
+    }
+
+    const uint8_t* ptr = file_->data();
+    uint32_t magic = read_pod<uint32_t>(ptr);
+    uint32_t version = read_pod<uint32_t>(ptr);
+    const uint8_t* trailer = file_->data() + size - kTrailerBytes;
+    uint64_t footer_offset = read_pod<uint64_t>(trailer);
+    uint32_t count = read_pod<uint32_t>(trailer);
+    uint32_t tail_magic = read_pod<uint32_t>(trailer);
+    if (magic != SnapshotWriter::kMagic || version != SnapshotWriter::kVersion ||
+        tail_magic != SnapshotWriter::kMagic || footer_offset < header ||
+        footer_offset > size - kTrailerBytes ||
+        (size - kTrailerBytes - footer_offset) != count * kFooterEntryBytes) {
+        file_.reset();
+        return false;
+    }
+
+    ptr = file_->data() + footer_offset;
+    chunks_.resize(count);
+    for (auto& chunk : chunks_) {
+        chunk.offset = read_pod<uint64_t>(ptr);
+        chunk.size = read_pod<uint32_t>(ptr);
+        chunk.crc = read_pod<uint32_t>(ptr);
+        chunk.points = read_pod<uint32_t>(ptr);
+        chunk.min_timestamp = read_pod<int64_t>(ptr);
+        chunk.max_timestamp = read_pod<int64_t>(ptr);
+        if (chunk.offset < header || chunk.offset > footer_offset ||
+            chunk.size > footer_offset - chunk.offset) {
+            chunks_.clear();
+            file_.reset();
+            return false;
+        }
+    }
+    return true;
+}
+
+uint64_t SnapshotReader::point_count() const {
+    uint64_t total = 0;
+    for (const auto& chunk : chunks_) {
+        total += chunk.points;
+    }
+    return total;
+}
+
+bool SnapshotReader::read_chunk(size_t i, std::vector<TimeSeriesData>& out) const {
+    const SnapshotChunk& chunk = chunks_[i];
+    const uint8_t* data = file_->data() + chunk.offset;
+    return crc32c(data, chunk.size) == chunk.crc && ColumnarBlock::decode(data, chunk.size, out);
+}
+
+bool SnapshotReader::for_each_chunk(const ChunkSink& sink, size_t threads) const {
+    if (chunks_.empty()) {
+        return true;
+    }
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threads = std::min(threads, chunks_.size());
+
+    // Workers claim chunks in order and decode them in parallel; delivery
+    // waits for the previous chunk, so sink sees file order
+    std::atomic<size_t> next{0};
+    std::mutex mutex;
+    std::condition_variable turn;
+    size_t delivered = 0;
+    bool failed = false;
+
+    auto work = [&]() {
+        std::vector<TimeSeriesData> points;
+        while (true) {
+            size_t i = next.fetch_add(1);
+            if (i >= chunks_.size()) {
+                return;
+            }
+            points.clear();
+            points.reserve(chunks_[i].points);
+            bool ok = read_chunk(i, points);
+
+            std::unique_lock<std::mutex> lock(mutex);
+            turn.wait(lock, [&] { return delivered == i; });
+            if (!ok) {
+                failed = true;
+            }
+            if (!failed) {
+                sink(std::move(points));
+            }
+            delivered++;
+            turn.notify_all();
+            if (failed) {
+                next.store(chunks_.size());  // Claimed chunks still pass their turn
+                return;
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t t = 1; t < threads; ++t) {
+        workers.emplace_back(work);
+    }
+    work();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    return !failed;
+}
+
+} // namespace sage_tsdb
@@ -4,6 +4,7 @@
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <iterator>
 #include <sstream>
 #include <chrono>
 
@@ -72,9 +73,13 @@ bool StorageEngine::save(const std::vector<TimeSeriesData>& data, const std::str
         return true; // Nothing to save
     }
     
-    // Store file mapping
-    file_data_mapping_[file_path] = data;
-    
+    // The points go into the LSM tree for query() and into a snapshot file
+    // at file_path for load(), which reads it back exactly
+    return put_tagged(data, file_path) && save_chunked(data.begin(), data.end(), file_path);
+}
+
+bool StorageEngine::put_tagged(const std::vector<TimeSeriesData>& data,
+                               const std::string& file_path) {
     // Store data in LSM tree with file_path as part of tags
     for (const auto& point : data) {
         TimeSeriesData tagged_point = point;
@@ -88,36 +93,65 @@ bool StorageEngine::save(const std::vector<TimeSeriesData>& data, const std::str
     
     // Flush to ensure data is persisted
     lsm_tree_->flush();
+    return true;
+}
+
+std::vector<TimeSeriesData> StorageEngine::load(const std::string& file_path) {
+    std::vector<TimeSeriesData> result;
+    if (is_chunked_file(file_path)) {
+        load_chunked(file_path, [&](std::vector<TimeSeriesData>&& chunk) {
+            if (result.empty()) {
+                result = std::move(chunk);
+            } else {
+                result.insert(result.end(), std::make_move_iterator(chunk.begin()),
+                              std::make_move_iterator(chunk.end()));
+            }
+        });
+        return result;
+    }
     
-    // Create a marker file to satisfy fs::exists() checks
-    std::ofstream marker(file_path);
-    if (marker.is_open()) {
-        marker << "LSM-backed file\n";
-        marker.close();
+    // Stream the LSM tree, keeping only points tagged with file_path;
+    // SSTables and blocks of other files are skipped by their key filters
+    auto iter = lsm_tree_->new_iterator(INT64_MIN, INT64_MAX, {{"__file_path__", file_path}});
+    for (; iter->valid(); iter->next()) {
+        // Remove internal tag before returning
+        result.push_back(iter->value());
+        result.back().tags.erase("__file_path__");
     }
     
-    bytes_written_ += data.size() * 100; // Approximate size
-    return true;
+    bytes_read_ += result.size() * 100; // Approximate size
+    return result;
 }
 
-std::vector<TimeSeriesData> StorageEngine::load(const std::string& file_path) {
-    // First check in-memory mapping
-    auto it = file_data_mapping_.find(file_path);
-    if (it != file_data_mapping_.end()) {
-        bytes_read_ += it->second.size() * 100;
-        return it->second;
+bool StorageEngine::load_chunked(const std::string& file_path,
+                                 const SnapshotReader::ChunkSink& sink, size_t threads) {
+    SnapshotReader reader;
+    if (!reader.open(file_path)) {
+        return false;
+    }
+    bool ok = reader.for_each_chunk(sink, threads);
+    bytes_read_ += reader.file_size();
+    return ok;
+}
+
+bool StorageEngine::is_chunked_file(const std::string& file_path) {
+    SnapshotReader reader;
+    return reader.open(file_path);
+}
+
+std::vector<TimeSeriesData> StorageEngine::query(const QueryConfig& config) {
+    if (config.aggregation != AggregationType::NONE) {
+        return aggregate(config);
     }
     
-    // Query from LSM tree filtering by file_path tag
-    auto all_data = lsm_tree_->range_query(INT64_MIN, INT64_MAX);
     std::vector<TimeSeriesData> result;
-    
-    for (auto& data : all_data) {
-        auto tag_it = data.tags.find("__file_path__");
-        if (tag_it != data.tags.end() && tag_it->second == file_path) {
-            // Remove internal tag before returning
-            data.tags.erase("__file_path__");
-            result.push_back(data);
+    auto iter = lsm_tree_->new_iterator(config.time_range.start_time, config.time_range.end_time,
+                                        config.filter_tags);
+    for (; iter->valid(); iter->next()) {
+        result.push_back(iter->value());
+        result.back().tags.erase("__file_path__");
+        if (config.limit > 0 && result.size() >= static_cast<size_t>(config.limit)) {
+            break;
         }
     }
     
@@ -125,6 +159,97 @@ std::vector<TimeSeriesData> StorageEngine::load(const std::string& file_path) {
     return result;
 }
 
+std::vector<TimeSeriesData> StorageEngine::aggregate(const QueryConfig& config) {
+    std::vector<TimeSeriesData> result;
+    int64_t start = config.time_range.start_time;
+    int64_t end = std::min(config.time_range.end_time, lsm_tree_->get_newest_timestamp());
+    
+    // Start at the first point so open-ended ranges do not walk empty windows
+    auto first = lsm_tree_->new_iterator(start, end);
+    if (!first->valid()) {
+        return result;
+    }
+    start = first->value().timestamp;
+    first.reset();
+    
+    if (!config.group_by.empty()) {
+        return aggregate_groups(config, start, end);
+    }
+    
+    auto emit = [&](int64_t timestamp, const BlockSummary& summary) {
+        if (summary.empty()) {
+            return;
+        }
+        TimeSeriesData point(timestamp, summary.value(config.aggregation, config.quantile));
+        point.tags = config.filter_tags;
+        result.push_back(std::move(point));
+    };
+    
+    const bool sketches = needs_sketches(config.aggregation);
+    int64_t window = config.window_size;
+    if (window <= 0) {
+        emit(config.time_range.start_time,
+             lsm_tree_->aggregate(start, end, config.filter_tags, sketches));
+        return result;
+    }
+    
+    int64_t window_start = start - (((start % window) + window) % window);
+    while (window_start <= end) {
+        int64_t window_end = (window_start > INT64_MAX - window) ? INT64_MAX : window_start + window - 1;
+        emit(window_start, lsm_tree_->aggregate(std::max(window_start, start),
+                                                std::min(window_end, end), config.filter_tags,
+                                                sketches));
+        if ((config.limit > 0 && result.size() >= static_cast<size_t>(config.limit)) ||
+            window_end == INT64_MAX) {
+            break;
+        }
+        window_start = window_end + 1;
+    }
+    return result;
+}
+
+std::vector<TimeSeriesData> StorageEngine::aggregate_groups(const QueryConfig& config,
+                                                            int64_t start, int64_t end) {
+    // Groups are only known once points are decoded, so every point is
+    // streamed once through the aggregator
+    std::vector<Tags> group_tags;
+    std::map<Tags, uint32_t> group_ids;
+    auto buckets = dispatch_aggregation(config.aggregation, [&](auto type) {
+        WindowedAggregator<decltype(type)::value> aggregator(config.window_size,
+                                                             config.time_range.start_time,
+                                                             config.quantile);
+        auto iter = lsm_tree_->new_iterator(start, end, config.filter_tags);
+        for (; iter->valid(); iter->next()) {
+            const TimeSeriesData& point = iter->value();
+            Tags key;
+            for (const auto& tag : config.group_by) {
+                auto it = point.tags.find(tag);
+                if (it != point.tags.end()) {
+                    key.insert(*it);
+                }
+            }
+            auto [group_it, inserted] =
+                group_ids.emplace(key, static_cast<uint32_t>(group_ids.size()));
+            if (inserted) {
+                Tags out = config.filter_tags;
+                out.insert(key.begin(), key.end());
+                group_tags.push_back(std::move(out));
+            }
+            aggregator.add(group_it->second, point.timestamp, point.as_double());
+        }
+        return aggregator.finish();
+    });
+    
+    std::vector<TimeSeriesData> result;
+    for (const auto& bucket : buckets) {
+        if (config.limit > 0 && result.size() >= static_cast<size_t>(config.limit)) {
+            break;
+        }
+        result.emplace_back(bucket.window_start, bucket.value, group_tags[bucket.group]);
+    }
+    return result;
+}
+
 bool StorageEngine::create_checkpoint(const std::vector<TimeSeriesData>& data, 
                                        uint64_t checkpoint_id) {
     std::string checkpoint_path = get_checkpoint_path(checkpoint_id);
@@ -195,14 +320,41 @@ bool StorageEngine::append(const std::vector<TimeSeriesData>& data,
         return true;
     }
     
-    // Load existing data
-    auto existing_data = load(file_path);
+    if (!is_chunked_file(file_path)) {
+        // Older LSM-only file: rewrite it whole
+        auto existing_data = load(file_path);
+        existing_data.insert(existing_data.end(), data.begin(), data.end());
+        return save(existing_data, file_path);
+    }
     
-    // Append new data
-    existing_data.insert(existing_data.end(), data.begin(), data.end());
+    if (!put_tagged(data, file_path)) {
+        return false;
+    }
     
-    // Save combined data
-    return save(existing_data, file_path);
+    // Stream the existing chunks and the new points into a new snapshot
+    const std::string tmp_path = file_path + ".tmp";
+    SnapshotWriter writer;
+    if (!writer.open(tmp_path)) {
+        return false;
+    }
+    bool ok = true;
+    bool loaded = load_chunked(file_path, [&](std::vector<TimeSeriesData>&& chunk) {
+        for (auto& point : chunk) {
+            ok = writer.append(std::move(point)) && ok;
+        }
+    });
+    ok = ok && loaded;
+    for (const auto& point : data) {
+        ok = ok && writer.append(point);
+    }
+    ok = writer.close() && ok;
+    if (!ok) {
+        fs::remove(tmp_path);
+        return false;
+    }
+    bytes_written_ += writer.bytes_written();
+    fs::rename(tmp_path, file_path);
+    return true;
 }
 
 std::map<std::string, uint64_t> StorageEngine::get_statistics() const {
@@ -1,37 +1,106 @@
 #include "sage_tsdb/core/stream_table.h"
+#include "sage_tsdb/core/bulk_file.h"
+#include "sage_tsdb/core/trace.h"
 #include <algorithm>
+#include <iostream>
 #include <stdexcept>
+#include <type_traits>
+#include <utility>
 
 namespace sage_tsdb {
 
+namespace {
+
+// 并发写入下维护最小/最大时间戳
+void atomicMin(std::atomic<int64_t>& target, int64_t value) {
+    int64_t current = target.load(std::memory_order_relaxed);
+    while (value < current &&
+           !target.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+}
+
+void atomicMax(std::atomic<int64_t>& target, int64_t value) {
+    int64_t current = target.load(std::memory_order_relaxed);
+    while (value > current &&
+           !target.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+}
+
+bool matchesTags(const Tags& tags, const Tags& filter_tags) {
+    for (const auto& [key, value] : filter_tags) {
+        auto it = tags.find(key);
+        if (it == tags.end() || it->second != value) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
 StreamTable::StreamTable(const std::string& name, const TableConfig& config)
     : name_(name), config_(config) {
     
     // 初始化 MemTable
-    memtable_ = std::make_unique<MemTable>(config_.memtable_size_bytes);
+    publishMemTables(std::make_shared<MemTable>(config_.memtable_size_bytes, nullptr,
+                                                config_.memory_tracker), {});
     
     // 初始化 LSM-Tree
     if (!config_.data_dir.empty()) {
         LSMConfig lsm_config;
         lsm_config.data_dir = config_.data_dir + "/" + name_;
         lsm_config.memtable_size_bytes = config_.memtable_size_bytes;
+        lsm_config.enable_compression = config_.enable_compression;
+        lsm_config.block_cache = config_.block_cache;
+        lsm_config.rate_limiter = config_.rate_limiter;
+        lsm_config.memory_tracker = config_.memory_tracker;
+        lsm_config.enable_wal = config_.enable_wal;
+        lsm_config.wal_sync_mode = config_.wal_sync_mode;
+        lsm_config.wal_sync_interval_ms = config_.wal_sync_interval_ms;
+        lsm_config.partition_duration = config_.partition_duration;
+        lsm_config.ttl = config_.ttl;
         lsm_tree_ = std::make_unique<LSMTree>(lsm_config);
+        
+        // 后台 flush 线程：写入线程只切换 MemTable，不等待落盘
+        flush_running_ = true;
+        flush_thread_ = std::thread(&StreamTable::flushLoop, this);
+        
+        // 加入全局内存预算：超过软限制时可能被选中切换 MemTable
+        if (config_.write_buffer_manager) {
+            write_buffer_ = config_.write_buffer_manager;
+            active_since_ = std::chrono::steady_clock::now().time_since_epoch().count();
+            WriteBufferManager::Client client;
+            client.mutable_bytes = [this]() { return memtables_.load()->active->size_bytes(); };
+            client.mutable_since = [this]() {
+                return std::chrono::steady_clock::time_point(
+                    std::chrono::steady_clock::duration(active_since_.load()));
+            };
+            client.request_flush = [this]() { return requestFlush(); };
+            write_buffer_client_ = write_buffer_->add_client(std::move(client));
+        }
+    }
+    
+    // 最新值缓存：有 LSM-Tree 时可能带着旧数据打开，先视为冷
+    if (config_.latest_cache_size > 0 || config_.latest_cache_per_series > 0) {
+        latest_cache_ = std::make_unique<LastValueCache>(
+            config_.latest_cache_size, config_.latest_cache_per_series, lsm_tree_ == nullptr);
     }
     
-    // 初始化时间戳索引
+    // 初始化时间戳索引（各索引共用一份序列字典，标签集合只存一次）
+    series_catalog_ = std::make_shared<SeriesCatalog>();
     if (config_.enable_timestamp_index) {
-        index_ = std::make_unique<TimeSeriesIndex>();
+        index_ = std::make_unique<TimeSeriesIndex>(series_catalog_, config_.scalar_values);
     }
     
     // 为配置的标签创建索引
     for (const auto& tag_name : config_.indexed_tags) {
-        tag_indexes_[tag_name] = std::make_unique<TimeSeriesIndex>();
+        tag_indexes_[tag_name] = std::make_unique<TimeSeriesIndex>(series_catalog_,
+                                                                   config_.scalar_values);
     }
     
     // 初始化统计信息
     stats_.name = name_;
     stats_.total_records = 0;
     stats_.memtable_records = 0;
+    stats_.memtable_bytes = 0;
     stats_.lsm_levels = 0;
     stats_.disk_size_bytes = 0;
     stats_.min_timestamp = std::numeric_limits<int64_t>::max();
@@ -39,23 +108,67 @@ StreamTable::StreamTable(const std::string& name, const TableConfig& config)
     stats_.num_indexes = tag_indexes_.size() + (index_ ? 1 : 0);
     stats_.write_throughput = 0.0;
     stats_.query_latency_ms = 0.0;
+    stats_.flush_queue_depth = 0;
+    stats_.flush_count = 0;
+    stats_.write_stalls = 0;
+    stats_.last_flush_ms = 0.0;
+    stats_.avg_flush_ms = 0.0;
     
     last_stats_update_ = std::chrono::steady_clock::now();
+    
+    if (config_.metrics_registry) {
+        registerMetrics();
+    }
 }
 
 StreamTable::~StreamTable() {
-    // 确保所有数据 flush 到磁盘
-    if (lsm_tree_ && memtable_) {
-        flush();
+    // 先注销指标：抓取不再读取本表的状态
+    metric_handles_.clear();
+    
+    if (!lsm_tree_) {
+        return;
+    }
+    
+    // 先退出全局内存预算（等待进行中的回调返回），再 flush 全部数据并停止后台线程
+    if (write_buffer_) {
+        write_buffer_->remove_client(write_buffer_client_);
+    }
+    flush();
+    {
+        std::lock_guard<std::mutex> queue_lock(queue_mutex_);
+        flush_running_ = false;
+    }
+    queue_cv_.notify_all();
+    flush_thread_.join();
+    
+    size_t pending = memtables_.load()->immutables.size();
+    if (pending > 0) {
+        std::cerr << "StreamTable " << name_ << ": " << pending
+                  << " MemTable(s) not flushed" << std::endl;
     }
 }
 
 size_t StreamTable::insert(const TimeSeriesData& data) {
-    std::unique_lock<std::shared_mutex> lock(mutex_);
+    checkValue(data);
     
-    // 插入到 MemTable
-    memtable_->put(data.timestamp, data);
-    size_t index = stats_.total_records; // 使用计数作为索引
+    // 全局内存预算已满时阻塞，直到 flush 释放内存（不持有表锁，flush 才能推进）
+    if (write_buffer_) {
+        write_buffer_->wait_for_room();
+    }
+    
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    
+    // 插入到 MemTable（并发写入安全）；已满时换上新的 MemTable 后重试
+    for (auto active = memtables_.load()->active; !active->put(data.timestamp, data) && lsm_tree_;
+         active = memtables_.load()->active) {
+        lock.unlock();
+        rotateMemTable(active);
+        lock.lock();
+    }
+    if (write_buffer_) {
+        write_buffer_->reserve(MemTable::estimate_size(data));
+    }
+    size_t index = total_records_.fetch_add(1, std::memory_order_relaxed); // 使用计数作为索引
     
     // 更新索引
     if (index_) {
@@ -64,115 +177,232 @@ size_t StreamTable::insert(const TimeSeriesData& data) {
     
     // 更新标签索引
     for (const auto& [tag_name, tag_value] : data.tags) {
-        if (tag_indexes_.count(tag_name)) {
-            tag_indexes_[tag_name]->add(data);
+        auto it = tag_indexes_.find(tag_name);
+        if (it != tag_indexes_.end()) {
+            it->second->add(data);
         }
     }
     
+    if (latest_cache_) {
+        latest_cache_->add(data);
+    }
+    
     // 更新统计信息
-    stats_.total_records++;
-    stats_.memtable_records++;
-    stats_.min_timestamp = std::min(stats_.min_timestamp, data.timestamp);
-    stats_.max_timestamp = std::max(stats_.max_timestamp, data.timestamp);
+    memtable_records_.fetch_add(1, std::memory_order_relaxed);
+    atomicMin(min_timestamp_, data.timestamp);
+    atomicMax(max_timestamp_, data.timestamp);
     
-    // 检查是否需要 flush
+    // 检查是否需要 flush（切换 MemTable 需独占锁）
+    lock.unlock();
+    notifyInsert(&data, 1);
     maybeFlush();
     
     return index;
 }
 
 std::vector<size_t> StreamTable::insertBatch(const std::vector<TimeSeriesData>& data_list) {
+    return insertPoints(data_list);
+}
+
+std::vector<size_t> StreamTable::insertBatch(std::vector<TimeSeriesData>&& data_list) {
+    // 监听器与最新值缓存在写入后读取整批，只能复制
+    auto listeners = insert_listeners_.load();
+    if (latest_cache_ || (listeners && !listeners->empty())) {
+        return insertPoints(std::as_const(data_list));
+    }
+    return insertPoints(data_list);
+}
+
+template <typename Batch>
+std::vector<size_t> StreamTable::insertPoints(Batch& data_list) {
+    constexpr bool kMove = !std::is_const_v<Batch>;
+    
+    // 整批先校验，避免写入一半
+    for (const auto& data : data_list) {
+        checkValue(data);
+    }
+    
     std::vector<size_t> indices;
     indices.reserve(data_list.size());
     
-    std::unique_lock<std::shared_mutex> lock(mutex_);
+    // 整批只检查一次预算，一批可能略微超出硬限制
+    if (write_buffer_) {
+        write_buffer_->wait_for_room();
+    }
     
-    for (const auto& data : data_list) {
-        memtable_->put(data.timestamp, data);
-        size_t index = stats_.total_records;
-        indices.push_back(index);
-        
-        // 更新索引
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    
+    // 一次预留整批索引，并发批次的索引互不交错
+    size_t first = total_records_.fetch_add(data_list.size(), std::memory_order_relaxed);
+    auto active = memtables_.load()->active;
+    
+    auto updateIndexes = [&](const TimeSeriesData& data) {
         if (index_) {
             index_->add(data);
         }
-        
         for (const auto& [tag_name, tag_value] : data.tags) {
-            if (tag_indexes_.count(tag_name)) {
-                tag_indexes_[tag_name]->add(data);
+            auto it = tag_indexes_.find(tag_name);
+            if (it != tag_indexes_.end()) {
+                it->second->add(data);
             }
         }
+    };
+    
+    for (auto& data : data_list) {
+        size_t size = MemTable::estimate_size(data);
+        // 移动写入时数据点之后只剩时间戳，索引要先更新
+        if constexpr (kMove) {
+            updateIndexes(data);
+        }
+        bool inserted;
+        do {
+            if constexpr (kMove) {
+                inserted = active->put(data.timestamp, std::move(data));
+            } else {
+                inserted = active->put(data.timestamp, data);
+            }
+            if (!inserted && lsm_tree_) {
+                lock.unlock();
+                rotateMemTable(active);
+                lock.lock();
+                active = memtables_.load()->active;
+            }
+        } while (!inserted && lsm_tree_);
+        if (write_buffer_) {
+            write_buffer_->reserve(size);
+        }
+        indices.push_back(first + indices.size());
+        
+        if constexpr (!kMove) {
+            updateIndexes(data);
+        }
         
         // 更新统计信息
-        stats_.total_records++;
-        stats_.min_timestamp = std::min(stats_.min_timestamp, data.timestamp);
-        stats_.max_timestamp = std::max(stats_.max_timestamp, data.timestamp);
+        atomicMin(min_timestamp_, data.timestamp);
+        atomicMax(max_timestamp_, data.timestamp);
     }
     
-    stats_.memtable_records += data_list.size();
+    if constexpr (!kMove) {
+        if (latest_cache_) {
+            latest_cache_->add(data_list.data(), data_list.size());
+        }
+    }
+    memtable_records_.fetch_add(data_list.size(), std::memory_order_relaxed);
     
-    // 检查是否需要 flush
+    // 检查是否需要 flush（切换 MemTable 需独占锁）
+    lock.unlock();
+    if constexpr (!kMove) {
+        notifyInsert(data_list.data(), data_list.size());
+    }
     maybeFlush();
     
     return indices;
 }
 
-std::vector<TimeSeriesData> StreamTable::query(const TimeRange& range,
-                                               const Tags& filter_tags) const {
-    std::shared_lock<std::shared_mutex> lock(mutex_);
+size_t StreamTable::importFile(const std::string& path) {
+    BulkFileReader reader;
+    if (!reader.open(path)) {
+        throw std::runtime_error("StreamTable " + name_ + ": cannot read bulk file " + path);
+    }
     
-    std::vector<TimeSeriesData> results;
+    // 每批约一个 MemTable 大小，导入 TB 级文件时内存占用有界
+    size_t imported = 0;
+    std::vector<TimeSeriesData> batch;
+    size_t batch_bytes = 0;
+    for (;;) {
+        size_t decoded = batch.size();
+        bool more = reader.next(batch);
+        for (size_t i = decoded; i < batch.size(); ++i) {
+            batch_bytes += MemTable::estimate_size(batch[i]);
+        }
+        if (more && batch_bytes < config_.memtable_size_bytes) {
+            continue;
+        }
+        if (reader.corrupt()) {
+            throw std::runtime_error("StreamTable " + name_ + ": corrupt bulk file " + path +
+                                     " after " + std::to_string(imported) + " points");
+        }
+        imported += ingestPoints(batch);
+        batch.clear();
+        batch_bytes = 0;
+        if (!more) {
+            return imported;
+        }
+    }
+}
+
+size_t StreamTable::ingestPoints(std::vector<TimeSeriesData>& points) {
+    for (const auto& data : points) {
+        checkValue(data);
+    }
+    if (points.empty()) {
+        return 0;
+    }
+    if (!lsm_tree_) {
+        return insertBatch(std::move(points)).size();
+    }
     
-    // 从 MemTable 查询
-    if (memtable_) {
-        auto mem_results = memtable_->range_query(range.start_time, range.end_time);
-        // 应用标签过滤
-        for (const auto& data : mem_results) {
-            bool match = true;
-            for (const auto& [key, value] : filter_tags) {
-                if (data.tags.count(key) == 0 || data.tags.at(key) != value) {
-                    match = false;
-                    break;
-                }
-            }
-            if (match) {
-                results.push_back(data);
+    // LSMTree::ingest 要求按 (timestamp, series) 有序且每键一个版本；同键保留文件中靠后的
+    std::stable_sort(points.begin(), points.end(),
+                     [](const TimeSeriesData& a, const TimeSeriesData& b) {
+                         return a.timestamp != b.timestamp ? a.timestamp < b.timestamp
+                                                           : a.series_id() < b.series_id();
+                     });
+    size_t kept = 0;
+    for (size_t i = 0; i < points.size(); ++i) {
+        if (kept > 0 && points[kept - 1].timestamp == points[i].timestamp &&
+            points[kept - 1].series_id() == points[i].series_id()) {
+            points[kept - 1] = std::move(points[i]);
+        } else {
+            if (kept != i) {
+                points[kept] = std::move(points[i]);
             }
+            ++kept;
         }
     }
+    points.resize(kept);
     
-    // 从 Immutable MemTable 查询
-    if (immutable_memtable_) {
-        auto immut_results = immutable_memtable_->range_query(range.start_time, range.end_time);
-        for (const auto& data : immut_results) {
-            bool match = true;
-            for (const auto& [key, value] : filter_tags) {
-                if (data.tags.count(key) == 0 || data.tags.at(key) != value) {
-                    match = false;
-                    break;
-                }
-            }
-            if (match) {
-                results.push_back(data);
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    if (!lsm_tree_->ingest(points)) {
+        throw std::runtime_error("StreamTable " + name_ + ": failed to write imported SSTables");
+    }
+    total_records_.fetch_add(points.size(), std::memory_order_relaxed);
+    
+    for (const auto& data : points) {
+        if (index_) {
+            index_->add(data);
+        }
+        for (const auto& [tag_name, tag_value] : data.tags) {
+            auto it = tag_indexes_.find(tag_name);
+            if (it != tag_indexes_.end()) {
+                it->second->add(data);
             }
         }
     }
+    atomicMin(min_timestamp_, points.front().timestamp);
+    atomicMax(max_timestamp_, points.back().timestamp);
+    if (latest_cache_) {
+        latest_cache_->add(points.data(), points.size());
+    }
     
-    // TODO: 从 LSM-Tree 查询（需要实现 LSMTree::range_query）
-    
-    // 合并去重，按时间排序
-    std::sort(results.begin(), results.end(), 
-             [](const TimeSeriesData& a, const TimeSeriesData& b) {
-                 return a.timestamp < b.timestamp;
-             });
+    lock.unlock();
+    notifyInsert(points.data(), points.size());
+    return points.size();
+}
+
+std::vector<TimeSeriesData> StreamTable::query(const TimeRange& range,
+                                               const Tags& filter_tags) const {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<TimeSeriesData> results;
     
-    // 去重（如果同一数据在多个地方）
-    results.erase(std::unique(results.begin(), results.end(),
-                             [](const TimeSeriesData& a, const TimeSeriesData& b) {
-                                 return a.timestamp == b.timestamp;
-                             }),
-                 results.end());
+    // 只复制通过标签过滤的数据点
+    scanRange(range, filter_tags, [&](const TimeSeriesData& data, const Tags& tags) {
+        results.push_back(data);
+        results.back().tags = tags;
+    });
     
+    query_latency_.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count()));
     return results;
 }
 
@@ -192,52 +422,85 @@ std::vector<TimeSeriesData> StreamTable::queryWindow(uint64_t window_id) {
 }
 
 std::vector<TimeSeriesData> StreamTable::queryLatest(size_t n) const {
-    std::shared_lock<std::shared_mutex> lock(mutex_);
-    
-    std::vector<TimeSeriesData> results;
-    
-    // 从 MemTable 获取最新数据（通常已按时间排序）
-    if (memtable_) {
-        const auto& mem_data = memtable_->get_all();
-        for (const auto& [ts, data] : mem_data) {
-            results.push_back(data);
-        }
+    if (latest_cache_ && n <= latest_cache_->capacity()) {
+        warmLatestCache();
+        return latest_cache_->latest(n, visibleFrom());
     }
     
-    // 按时间降序排序
-    std::sort(results.begin(), results.end(),
-             [](const TimeSeriesData& a, const TimeSeriesData& b) {
-                 return a.timestamp > b.timestamp;
-             });
-    
-    // 返回前 n 条
-    if (results.size() > n) {
-        results.resize(n);
+    // 超出缓存容量：扫描全表，只保留最新的 n 条
+    LastValueCache scratch(n, 0);
+    scanInto(scratch);
+    return scratch.latest(n, visibleFrom());
+}
+
+std::vector<TimeSeriesData> StreamTable::queryLatestPerSeries(size_t n,
+                                                              const Tags& filter_tags) const {
+    if (latest_cache_ && n <= latest_cache_->per_series()) {
+        warmLatestCache();
+        return latest_cache_->latest_per_series(n, filter_tags, visibleFrom());
     }
     
-    return results;
+    LastValueCache scratch(0, n);
+    scanInto(scratch);
+    return scratch.latest_per_series(n, filter_tags, visibleFrom());
 }
 
-size_t StreamTable::count(const TimeRange& range) const {
+void StreamTable::warmLatestCache() const {
+    if (latest_cache_->is_warm()) {
+        return;
+    }
+    std::lock_guard<std::mutex> warm_lock(warm_mutex_);
+    if (latest_cache_->is_warm()) {
+        return;
+    }
+    // 与 clear() 互斥；并发写入照常进入缓存，与扫描到的同一数据点去重
     std::shared_lock<std::shared_mutex> lock(mutex_);
-    
+    scanInto(*latest_cache_);
+    latest_cache_->set_warm();
+}
+
+void StreamTable::scanInto(LastValueCache& cache) const {
+    scanRange(TimeRange(std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::max()),
+              {}, [&](const TimeSeriesData& data, const Tags& tags) {
+        if (data.tags.empty() && !tags.empty()) {
+            TimeSeriesData point = data;
+            point.tags = tags;
+            cache.add(point);
+        } else {
+            cache.add(data);
+        }
+    });
+}
+
+size_t StreamTable::count(const TimeRange& range) const {
+    // 与 query() 走同一读路径，只计数，不复制数据点
     size_t total = 0;
+    scanRange(range, {}, [&](const TimeSeriesData&, const Tags&) {
+        ++total;
+    });
     
-    // 从 MemTable 统计
-    if (memtable_) {
-        auto mem_results = memtable_->range_query(range.start_time, range.end_time);
-        total += mem_results.size();
+    return total;
+}
+
+size_t StreamTable::exportFile(const std::string& path, const TimeRange& range,
+                               const Tags& filter_tags) const {
+    BulkFileWriter writer;
+    if (!writer.open(path)) {
+        throw std::runtime_error("StreamTable " + name_ + ": cannot create bulk file " + path);
     }
     
-    // 从 Immutable MemTable 统计
-    if (immutable_memtable_) {
-        auto immut_results = immutable_memtable_->range_query(range.start_time, range.end_time);
-        total += immut_results.size();
+    bool written = true;
+    scanRange(range, filter_tags, [&](const TimeSeriesData& data, const Tags& tags) {
+        if (written) {
+            TimeSeriesData point = data;
+            point.tags = tags;
+            written = writer.append(std::move(point));
+        }
+    });
+    if (!writer.close() || !written) {
+        throw std::runtime_error("StreamTable " + name_ + ": failed to write bulk file " + path);
     }
-    
-    // TODO: 从 LSM-Tree 统计
-    
-    return total;
+    return writer.points_written();
 }
 
 bool StreamTable::createIndex(const std::string& field_name) {
@@ -247,7 +510,9 @@ bool StreamTable::createIndex(const std::string& field_name) {
         return false; // 索引已存在
     }
     
-    tag_indexes_[field_name] = std::make_unique<TimeSeriesIndex>();
+    tag_indexes_[field_name] = std::make_unique<TimeSeriesIndex>(series_catalog_,
+                                                                 config_.scalar_values);
+    std::lock_guard<std::mutex> stats_lock(stats_mutex_);
     stats_.num_indexes++;
     
     return true;
@@ -262,6 +527,7 @@ bool StreamTable::dropIndex(const std::string& field_name) {
     }
     
     tag_indexes_.erase(it);
+    std::lock_guard<std::mutex> stats_lock(stats_mutex_);
     stats_.num_indexes--;
     
     return true;
@@ -283,14 +549,21 @@ std::vector<std::string> StreamTable::listIndexes() const {
 }
 
 bool StreamTable::flush() {
-    std::lock_guard<std::mutex> flush_lock(flush_mutex_);
+    if (!lsm_tree_) {
+        return true; // 没有 LSM-Tree，数据只存在于 MemTable
+    }
     
-    if (!memtable_ || memtable_->size() == 0) {
-        return true; // 没有数据需要 flush
+    auto active = memtables_.load()->active;
+    if (active->size() > 0) {
+        rotateMemTable(active);
     }
     
-    doFlush();
-    return true;
+    // 等待后台线程写完队列中的全部 MemTable
+    std::unique_lock<std::mutex> queue_lock(queue_mutex_);
+    queue_cv_.wait(queue_lock, [this]() {
+        return memtables_.load()->immutables.empty() || flush_failed_ || !flush_running_;
+    });
+    return memtables_.load()->immutables.empty();
 }
 
 bool StreamTable::compact() {
@@ -300,95 +573,482 @@ bool StreamTable::compact() {
     return false;
 }
 
+size_t StreamTable::dropBefore(int64_t before_timestamp) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    
+    atomicMax(retention_cutoff_, before_timestamp);
+    
+    // 整个文件过期才删除，不逐条改写
+    if (lsm_tree_) {
+        return lsm_tree_->drop_before(before_timestamp);
+    }
+    return 0;
+}
+
 void StreamTable::clear() {
+    // 先等进行中的 flush 写完，避免清空后又把旧数据写入 LSM-Tree
+    std::lock_guard<std::mutex> flush_lock(flush_mutex_);
     std::unique_lock<std::shared_mutex> lock(mutex_);
     
-    // 清空 MemTable
-    if (memtable_) {
-        memtable_->clear();
+    dropInMemoryState(true);
+    
+    // 查询会读 LSM-Tree，已 flush 的数据一并清除
+    if (lsm_tree_) {
+        lsm_tree_->clear_all();
     }
     
-    if (immutable_memtable_) {
-        immutable_memtable_.reset();
+    lock.unlock();
+    notifyQueue();
+}
+
+bool StreamTable::createCheckpoint(const std::string& dir) {
+    if (!lsm_tree_) {
+        return false;
     }
+    // 先把 MemTable 写入 LSM-Tree，checkpoint 只需链接其中的文件
+    return flush() && lsm_tree_->create_checkpoint(dir);
+}
+
+bool StreamTable::restoreCheckpoint(const std::string& dir) {
+    if (!lsm_tree_) {
+        return false;
+    }
+    std::lock_guard<std::mutex> flush_lock(flush_mutex_);
+    std::unique_lock<std::shared_mutex> lock(mutex_);
     
-    // TODO: 清空 LSM-Tree (需要实现 clear())
+    // 未 flush 的写入晚于 checkpoint，随恢复一并丢弃
+    dropInMemoryState(false);
+    bool ok = lsm_tree_->restore_checkpoint(dir);
+    
+    // 与重新打开表一致：计数从零开始，TTL 仍以恢复数据的最新时间戳为基准
+    max_timestamp_.store(lsm_tree_->get_newest_timestamp());
+    
+    lock.unlock();
+    notifyQueue();
+    return ok;
+}
+
+void StreamTable::dropInMemoryState(bool empty) {
+    // 丢弃的 MemTable 不再占用全局内存预算
+    if (write_buffer_) {
+        auto memtables = memtables_.load();
+        size_t dropped = memtables->active->size_bytes();
+        write_buffer_->schedule_free(dropped);
+        for (const auto& immutable : memtables->immutables) {
+            dropped += immutable->size_bytes();
+        }
+        write_buffer_->free(dropped);
+        active_since_ = std::chrono::steady_clock::now().time_since_epoch().count();
+    }
+    
+    // 换上新的 MemTable 并丢弃 flush 队列（进行中的查询仍读旧快照，不能原地清空）
+    publishMemTables(std::make_shared<MemTable>(config_.memtable_size_bytes, nullptr,
+                                                config_.memory_tracker), {});
     
     // 清空索引
     if (index_) {
         index_->clear();
     }
+    if (latest_cache_) {
+        latest_cache_->clear(empty);
+    }
     
     for (auto& [_, idx] : tag_indexes_) {
         idx->clear();
     }
     
+    retention_cutoff_.store(std::numeric_limits<int64_t>::min());
+    
     // 重置统计信息
-    stats_.total_records = 0;
-    stats_.memtable_records = 0;
-    stats_.min_timestamp = std::numeric_limits<int64_t>::max();
-    stats_.max_timestamp = std::numeric_limits<int64_t>::min();
+    total_records_.store(0);
+    memtable_records_.store(0);
+    min_timestamp_.store(std::numeric_limits<int64_t>::max());
+    max_timestamp_.store(std::numeric_limits<int64_t>::min());
 }
 
 StreamTable::Stats StreamTable::getStats() const {
-    std::shared_lock<std::shared_mutex> lock(mutex_);
+    std::lock_guard<std::mutex> stats_lock(stats_mutex_);
     updateStats();
-    return stats_;
+    
+    Stats stats = stats_;
+    stats.write_stalls = write_stalls_.value();
+    if (query_latency_.count() > 0) {
+        stats.query_latency_ms = query_latency_.snapshot().mean / 1000.0;
+    }
+    stats.total_records = total_records_.load(std::memory_order_relaxed);
+    stats.memtable_records = memtable_records_.load(std::memory_order_relaxed);
+    stats.min_timestamp = min_timestamp_.load(std::memory_order_relaxed);
+    stats.max_timestamp = max_timestamp_.load(std::memory_order_relaxed);
+    auto memtables = memtables_.load();
+    stats.memtable_bytes = memtables->active->size_bytes();
+    for (const auto& immutable : memtables->immutables) {
+        stats.memtable_bytes += immutable->size_bytes();
+    }
+    stats.flush_queue_depth = memtables->immutables.size();
+    return stats;
 }
 
 size_t StreamTable::size() const {
-    std::shared_lock<std::shared_mutex> lock(mutex_);
-    return stats_.total_records;
+    return total_records_.load(std::memory_order_relaxed);
 }
 
 bool StreamTable::empty() const {
-    std::shared_lock<std::shared_mutex> lock(mutex_);
-    return stats_.total_records == 0;
+    return size() == 0;
 }
 
 // ========== 内部辅助方法 ==========
 
 void StreamTable::maybeFlush() {
-    if (!memtable_ || !lsm_tree_) {
+    if (!lsm_tree_) {
         return;
     }
     
-    // 检查 MemTable 是否需要 flush
-    size_t mem_size = memtable_->size();
+    // 检查 MemTable 是否需要 flush（按字节数，与 memtable_size_bytes 同单位）
+    auto active = memtables_.load()->active;
     size_t threshold = config_.memtable_size_bytes * config_.memtable_flush_threshold;
     
-    if (mem_size >= threshold) {
-        // 异步触发 flush（不阻塞写入）
-        std::thread([this]() {
-            this->flush();
-        }).detach();
+    if (active->size_bytes() >= threshold) {
+        rotateMemTable(active);
+    }
+    
+    // 全局预算超过软限制：按策略切换某个表（不一定是本表）的 MemTable
+    if (write_buffer_ && write_buffer_->should_flush()) {
+        write_buffer_->flush_one();
     }
 }
 
-void StreamTable::doFlush() {
-    std::unique_lock<std::shared_mutex> lock(mutex_);
-    
-    if (!memtable_ || memtable_->size() == 0) {
+bool StreamTable::requestFlush() {
+    // 只在队列有空位时切换，回调方不会因本表 flush 跟不上而阻塞
+    auto memtables = memtables_.load();
+    if (memtables->active->size() == 0 ||
+        memtables->immutables.size() >= std::max<size_t>(config_.max_immutable_memtables, 1)) {
+        return false;
+    }
+    rotateMemTable(memtables->active);
+    return true;
+}
+
+uint64_t StreamTable::addInsertListener(InsertListener listener) {
+    std::lock_guard<std::mutex> lock(listeners_mutex_);
+    auto current = insert_listeners_.load();
+    auto listeners = current ? std::make_shared<InsertListeners>(*current)
+                             : std::make_shared<InsertListeners>();
+    uint64_t id = next_listener_id_++;
+    listeners->emplace_back(id, std::move(listener));
+    insert_listeners_.store(std::move(listeners));
+    return id;
+}
+
+void StreamTable::removeInsertListener(uint64_t id) {
+    std::lock_guard<std::mutex> lock(listeners_mutex_);
+    auto current = insert_listeners_.load();
+    if (!current) {
         return;
     }
+    auto listeners = std::make_shared<InsertListeners>();
+    for (const auto& entry : *current) {
+        if (entry.first != id) {
+            listeners->push_back(entry);
+        }
+    }
+    insert_listeners_.store(std::move(listeners));
+}
+
+void StreamTable::checkValue(const TimeSeriesData& data) const {
+    if (config_.scalar_values && !data.is_scalar()) {
+        throw std::invalid_argument("StreamTable " + name_ + ": array value in a scalar table");
+    }
+}
+
+void StreamTable::notifyInsert(const TimeSeriesData* data, size_t count) const {
+    auto listeners = insert_listeners_.load();
+    if (!listeners || count == 0) {
+        return;
+    }
+    for (const auto& [id, listener] : *listeners) {
+        listener(data, count);
+    }
+}
+
+void StreamTable::rotateMemTable(const std::shared_ptr<MemTable>& full) {
+    size_t depth = std::max<size_t>(config_.max_immutable_memtables, 1);
+    bool stalled = false;
+    
+    for (;;) {
+        // 队列已满时写入阻塞，直到后台线程写完最旧的 MemTable
+        {
+            std::unique_lock<std::mutex> queue_lock(queue_mutex_);
+            auto has_room = [&]() {
+                auto memtables = memtables_.load();
+                return memtables->active != full || memtables->immutables.size() < depth ||
+                       !flush_running_;
+            };
+            if (!has_room()) {
+                stalled = true;
+                queue_cv_.wait(queue_lock, has_room);
+            }
+        }
+        
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        auto memtables = memtables_.load();
+        if (memtables->active != full) {
+            break; // 其他写者已经切换过
+        }
+        if (memtables->immutables.size() >= depth && flush_running_) {
+            continue; // 等待期间队列又被占满
+        }
+        
+        // 立即切换：active 进入队列头部（队列按新到旧排列）
+        std::vector<std::shared_ptr<MemTable>> immutables;
+        immutables.reserve(memtables->immutables.size() + 1);
+        immutables.push_back(memtables->active);
+        immutables.insert(immutables.end(), memtables->immutables.begin(),
+                          memtables->immutables.end());
+        publishMemTables(std::make_shared<MemTable>(config_.memtable_size_bytes, nullptr,
+                                                    config_.memory_tracker),
+                         std::move(immutables));
+        memtable_records_.store(0);
+        if (write_buffer_) {
+            write_buffer_->schedule_free(full->size_bytes());  // 独占锁下写者已全部计入
+            active_since_ = std::chrono::steady_clock::now().time_since_epoch().count();
+        }
+        break;
+    }
     
-    // 将当前 MemTable 标记为 Immutable
-    immutable_memtable_ = std::move(memtable_);
+    if (stalled) {
+        write_stalls_.inc();
+    }
+    notifyQueue();
+}
+
+void StreamTable::flushLoop() {
+    std::unique_lock<std::mutex> queue_lock(queue_mutex_);
+    for (;;) {
+        queue_cv_.wait(queue_lock, [this]() {
+            return !flush_running_ || !memtables_.load()->immutables.empty();
+        });
+        if (memtables_.load()->immutables.empty()) {
+            break; // 已停止且队列已清空
+        }
+        
+        queue_lock.unlock();
+        bool ok = flushOldest();
+        queue_lock.lock();
+        
+        // 唤醒等待队列空位的写者与等待 flush 完成的调用者
+        queue_cv_.notify_all();
+        if (!ok) {
+            if (!flush_running_) {
+                break;
+            }
+            queue_cv_.wait_for(queue_lock, std::chrono::milliseconds(100)); // 稍后重试
+        }
+    }
+}
+
+bool StreamTable::flushOldest() {
+    std::lock_guard<std::mutex> flush_lock(flush_mutex_);
     
-    // 创建新的 MemTable
-    memtable_ = std::make_unique<MemTable>(config_.memtable_size_bytes);
+    auto memtables = memtables_.load();
+    if (memtables->immutables.empty()) {
+        return true; // 已被 clear() 丢弃
+    }
+    std::shared_ptr<MemTable> oldest = memtables->immutables.back();
+    SAGE_TSDB_TRACE_SCOPE_ARG("storage", "table.flush", "points", oldest->size());
+    
+    // 写入 LSM-Tree 的 Level 0 后再撤下该 MemTable；
+    // 期间查询可能两边都看到这批数据，由 scanRange() 去重
+    auto start = std::chrono::steady_clock::now();
+    if (!lsm_tree_->ingest(oldest->get_all())) {
+        std::cerr << "StreamTable " << name_ << ": flush to LSM-Tree failed" << std::endl;
+        flush_failed_ = true;
+        return false;
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    double elapsed_ms = std::chrono::duration<double, std::milli>(elapsed).count();
+    flush_latency_.record(static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count()));
+    
+    {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        auto current = memtables_.load();
+        std::vector<std::shared_ptr<MemTable>> immutables = current->immutables;
+        immutables.erase(std::remove(immutables.begin(), immutables.end(), oldest),
+                         immutables.end());
+        publishMemTables(current->active, std::move(immutables));
+    }
+    if (write_buffer_) {
+        write_buffer_->free(oldest->size_bytes());
+    }
+    flush_failed_ = false;
     
-    // 更新统计
-    stats_.memtable_records = 0;
+    std::lock_guard<std::mutex> stats_lock(stats_mutex_);
+    stats_.flush_count++;
+    stats_.last_flush_ms = elapsed_ms;
+    stats_.avg_flush_ms += (elapsed_ms - stats_.avg_flush_ms) / stats_.flush_count;
+    return true;
+}
+
+void StreamTable::notifyQueue() {
+    // 持锁一次再通知：等待者要么已看到新状态，要么已在等待
+    { std::lock_guard<std::mutex> queue_lock(queue_mutex_); }
+    queue_cv_.notify_all();
+}
+
+void StreamTable::scanRange(
+    const TimeRange& range, const Tags& filter_tags,
+    const std::function<void(const TimeSeriesData& data, const Tags& tags)>& visit) const {
+    // 先取 MemTable 快照，再打开 LSM-Tree 迭代器：并发 flush 只会让
+    // 一批数据同时出现在两边（下面去重），不会两边都看不到
+    auto memtables = memtables_.load();
+    
+    int64_t start_time = std::max(range.start_time, visibleFrom());
+    if (start_time > range.end_time) {
+        return;
+    }
+    
+    // MemTable 中的数据点原地引用（快照保活），按时间有序
+    struct PointRef {
+        const TimeSeriesData* data;
+        const Tags* tags;
+    };
+    auto collect = [&](const std::shared_ptr<MemTable>& memtable) {
+        std::vector<PointRef> points;
+        if (memtable) {
+            memtable->scan(start_time, range.end_time,
+                           [&](const TimeSeriesData& data, const Tags& tags) {
+                if (matchesTags(tags, filter_tags)) {
+                    points.push_back({&data, &tags});
+                }
+                return true;
+            });
+        }
+        return points;
+    };
+    // 新到旧：active，然后 flush 队列
+    std::vector<std::vector<PointRef>> sources;
+    sources.push_back(collect(memtables->active));
+    for (const auto& immutable : memtables->immutables) {
+        sources.push_back(collect(immutable));
+    }
+    std::vector<size_t> pos(sources.size(), 0);
+    
+    // LSM-Tree：按 SSTable 的时间范围与标签过滤器剪枝，逐块解码
+    std::unique_ptr<LSMTree::Iterator> lsm_iter;
+    if (lsm_tree_) {
+        lsm_iter = lsm_tree_->new_iterator(start_time, range.end_time, filter_tags);
+    }
     
-    lock.unlock(); // 释放锁，允许写入新 MemTable
+    // 同一时间戳下已交出的 MemTable 数据点：较旧来源中的同一数据点跳过
+    int64_t current_ts = 0;
+    std::vector<std::pair<uint64_t, const Tags*>> emitted;
+    auto shadowed = [&](const TimeSeriesData& data, const Tags& tags) {
+        if (emitted.empty() || data.timestamp != current_ts) {
+            emitted.clear();
+            current_ts = data.timestamp;
+            return false;
+        }
+        uint64_t id = TimeSeriesData::hash_tags(tags);
+        return std::any_of(emitted.begin(), emitted.end(), [&](const auto& entry) {
+            return entry.first == id && *entry.second == tags;
+        });
+    };
+    
+    for (;;) {
+        // 时间戳最小者优先；相同时取较新来源：active、flush 队列、LSM-Tree
+        size_t best = sources.size();
+        int64_t best_ts = 0;
+        for (size_t i = 0; i < sources.size(); ++i) {
+            if (pos[i] < sources[i].size() &&
+                (best == sources.size() || sources[i][pos[i]].data->timestamp < best_ts)) {
+                best = i;
+                best_ts = sources[i][pos[i]].data->timestamp;
+            }
+        }
+        bool from_lsm = lsm_iter && lsm_iter->valid() &&
+                        (best == sources.size() || lsm_iter->value().timestamp < best_ts);
+        if (from_lsm) {
+            const TimeSeriesData& data = lsm_iter->value();
+            if (!shadowed(data, data.tags)) {
+                visit(data, data.tags);
+            }
+            lsm_iter->next();
+            continue;
+        }
+        if (best == sources.size()) {
+            break;
+        }
+        
+        const PointRef& point = sources[best][pos[best]++];
+        if (!shadowed(*point.data, *point.tags)) {
+            visit(*point.data, *point.tags);
+            current_ts = point.data->timestamp;
+            emitted.emplace_back(TimeSeriesData::hash_tags(*point.tags), point.tags);
+        }
+    }
+}
+
+void StreamTable::publishMemTables(std::shared_ptr<MemTable> active,
+                                   std::vector<std::shared_ptr<MemTable>> immutables) {
+    memtables_.store(std::make_shared<const MemTableSet>(
+        MemTableSet{std::move(active), std::move(immutables)}));
+}
+
+int64_t StreamTable::visibleFrom() const {
+    int64_t cutoff = retention_cutoff_.load();
+    
+    // TTL 以最新写入的时间戳为基准（事件时间），与 LSM-Tree 一致
+    int64_t max_timestamp = max_timestamp_.load(std::memory_order_relaxed);
+    if (config_.ttl > 0 &&
+        max_timestamp >= std::numeric_limits<int64_t>::min() + config_.ttl) {
+        cutoff = std::max(cutoff, max_timestamp - config_.ttl);
+    }
+    if (lsm_tree_) {
+        cutoff = std::max(cutoff, lsm_tree_->get_retention_cutoff());
+    }
+    return cutoff;
+}
+
+void StreamTable::registerMetrics() {
+    MetricsRegistry& registry = *config_.metrics_registry;
+    const Tags labels{{"table", name_}};
+    auto gauge = [&](const char* name, const char* help, std::function<double()> read) {
+        metric_handles_.push_back(registry.addGauge(name, help, labels, std::move(read)));
+    };
+    
+    // 只读原子量与无锁结构，不取写入/查询路径上的锁
+    metric_handles_.push_back(registry.addCounter(
+        "sage_tsdb_table_points_total", "Points written to the table", labels,
+        [this]() { return static_cast<double>(total_records_.load(std::memory_order_relaxed)); }));
+    metric_handles_.push_back(registry.addCounter(
+        "sage_tsdb_table_write_stalls_total", "MemTable switches that waited for the flush queue",
+        labels, [this]() { return static_cast<double>(write_stalls_.value()); }));
+    gauge("sage_tsdb_table_memtable_points", "Points in the active MemTable", [this]() {
+        return static_cast<double>(memtable_records_.load(std::memory_order_relaxed));
+    });
+    gauge("sage_tsdb_table_memtable_bytes", "Bytes of the active and queued MemTables", [this]() {
+        auto memtables = memtables_.load();
+        size_t bytes = memtables->active->size_bytes();
+        for (const auto& immutable : memtables->immutables) {
+            bytes += immutable->size_bytes();
+        }
+        return static_cast<double>(bytes);
+    });
+    gauge("sage_tsdb_table_flush_queue_depth", "MemTables waiting for flush", [this]() {
+        return static_cast<double>(memtables_.load()->immutables.size());
+    });
+    gauge("sage_tsdb_table_max_timestamp", "Newest timestamp written", [this]() {
+        return static_cast<double>(max_timestamp_.load(std::memory_order_relaxed));
+    });
+    metric_handles_.push_back(registry.addHistogram(
+        "sage_tsdb_table_query_seconds", "Range query latency", labels, &query_latency_));
+    metric_handles_.push_back(registry.addHistogram(
+        "sage_tsdb_table_flush_seconds", "MemTable flush latency", labels, &flush_latency_));
     
-    // TODO: 将 Immutable MemTable flush 到 LSM-Tree（需要适配 API）
-    if (lsm_tree_ && immutable_memtable_) {
-        // LSMTree::flush() doesn't take parameter, need to redesign
-        // For now, just clear the immutable memtable
-        std::unique_lock<std::shared_mutex> lock2(mutex_);
-        immutable_memtable_.reset();
+    if (lsm_tree_) {
+        for (auto& handle : lsm_tree_->register_metrics(registry, labels)) {
+            metric_handles_.push_back(std::move(handle));
+        }
     }
 }
 
@@ -404,9 +1064,7 @@ void StreamTable::updateStats() const {
     // TODO: 更新 LSM-Tree 统计 (需要实现 API)
     
     // 更新 MemTable 统计
-    if (memtable_) {
-        stats_.memtable_records = memtable_->size();
-    }
+    memtable_records_.store(memtables_.load()->active->size(), std::memory_order_relaxed);
     
     last_stats_update_ = now;
 }
@@ -1,16 +1,72 @@
 #include "sage_tsdb/core/table_manager.h"
+#include <algorithm>
+#include <filesystem>
 #include <stdexcept>
 #include <iostream>
 #include <iomanip>
+#include <condition_variable>
+#include <limits>
+#include <thread>
 
 namespace sage_tsdb {
 
-TableManager::TableManager(const std::string& base_data_dir)
+TableManager::TableManager(const std::string& base_data_dir, size_t block_cache_bytes,
+                           WriteBufferManager::FlushPolicy flush_policy)
     : base_data_dir_(base_data_dir),
-      global_memory_limit_(0) {
+      global_memory_limit_(0),
+      write_buffer_(std::make_shared<WriteBufferManager>(0, 0.9, flush_policy)),
+      metrics_(std::make_shared<MetricsRegistry>()) {
+    if (block_cache_bytes > 0) {
+        block_cache_ = std::make_shared<BlockCache>(block_cache_bytes);
+    }
+    
+    // 全局内存预算的计数均为原子量
+    auto* buffer = write_buffer_.get();
+    auto gauge = [&](const char* name, const char* help, std::function<double()> read) {
+        metric_handles_.push_back(metrics_->addGauge(name, help, {}, std::move(read)));
+    };
+    auto counter = [&](const char* name, const char* help, std::function<double()> read) {
+        metric_handles_.push_back(metrics_->addCounter(name, help, {}, std::move(read)));
+    };
+    gauge("sage_tsdb_write_buffer_limit_bytes", "Global MemTable budget (0 = unlimited)",
+          [buffer]() { return static_cast<double>(buffer->get_buffer_size()); });
+    gauge("sage_tsdb_write_buffer_bytes", "MemTable memory of all tables, flush queues included",
+          [buffer]() { return static_cast<double>(buffer->get_memory_usage()); });
+    gauge("sage_tsdb_write_buffer_mutable_bytes", "Active MemTable memory of all tables",
+          [buffer]() { return static_cast<double>(buffer->get_mutable_memory_usage()); });
+    counter("sage_tsdb_write_buffer_flushes_total", "MemTable switches forced by the soft limit",
+            [buffer]() { return static_cast<double>(buffer->get_flush_requests()); });
+    counter("sage_tsdb_write_buffer_stalls_total", "Writes blocked at the hard limit",
+            [buffer]() { return static_cast<double>(buffer->get_stall_count()); });
+    counter("sage_tsdb_write_buffer_stall_micros_total", "Time writes spent blocked",
+            [buffer]() { return static_cast<double>(buffer->get_total_stall_micros()); });
+
+    // 块缓存的统计同样是原子量，get_stats() 不加分片锁
+    if (block_cache_) {
+        auto* cache = block_cache_.get();
+        counter("sage_tsdb_block_cache_hits_total", "Block cache hits of all tables",
+                [cache]() { return static_cast<double>(cache->get_stats().hits); });
+        counter("sage_tsdb_block_cache_misses_total", "Block cache misses of all tables",
+                [cache]() { return static_cast<double>(cache->get_stats().misses); });
+        counter("sage_tsdb_block_cache_inserts_total", "Blocks inserted into the cache",
+                [cache]() { return static_cast<double>(cache->get_stats().inserts); });
+        counter("sage_tsdb_block_cache_evictions_total", "Blocks evicted to stay within capacity",
+                [cache]() { return static_cast<double>(cache->get_stats().evictions); });
+        gauge("sage_tsdb_block_cache_capacity_bytes", "Block cache capacity",
+              [cache]() { return static_cast<double>(cache->get_capacity()); });
+        gauge("sage_tsdb_block_cache_usage_bytes", "Charge of the cached blocks",
+              [cache]() { return static_cast<double>(cache->get_stats().usage_bytes); });
+        gauge("sage_tsdb_block_cache_high_priority_usage_bytes",
+              "Charge of the cached index and filter blocks",
+              [cache]() { return static_cast<double>(cache->get_stats().high_priority_usage_bytes); });
+        gauge("sage_tsdb_block_cache_entries", "Cached blocks",
+              [cache]() { return static_cast<double>(cache->get_stats().num_entries); });
+    }
 }
 
 TableManager::~TableManager() {
+    metric_handles_.clear();
+    
     // 保存所有表到磁盘
     saveAllTables();
 }
@@ -22,14 +78,9 @@ bool TableManager::createStreamTable(const std::string& name, const TableConfig&
         return false; // 表已存在
     }
     
-    // 设置数据目录
-    TableConfig table_config = config;
-    if (table_config.data_dir.empty() && !base_data_dir_.empty()) {
-        table_config.data_dir = getTableDataDir(name);
-    }
-    
     // 创建表
-    auto table = std::make_shared<StreamTable>(name, table_config);
+    auto table = std::make_shared<StreamTable>(name, prepareConfig(name, config));
+    attachTableListeners(name, *table);
     
     // 注册表
     tables_.emplace(name, TableMetadata(name, TableType::Stream, table));
@@ -44,14 +95,8 @@ bool TableManager::createJoinResultTable(const std::string& name, const TableCon
         return false; // 表已存在
     }
     
-    // 设置数据目录
-    TableConfig table_config = config;
-    if (table_config.data_dir.empty() && !base_data_dir_.empty()) {
-        table_config.data_dir = getTableDataDir(name);
-    }
-    
     // 创建表
-    auto table = std::make_shared<JoinResultTable>(name, table_config);
+    auto table = std::make_shared<JoinResultTable>(name, prepareConfig(name, config));
     
     // 注册表
     tables_.emplace(name, TableMetadata(name, TableType::JoinResult, table));
@@ -77,6 +122,58 @@ bool TableManager::createPECJTables(const std::string& prefix) {
     return success;
 }
 
+bool TableManager::createRollup(const RollupConfig& rollup, const TableConfig& config) {
+    std::shared_ptr<StreamTable> source;
+    std::shared_ptr<Rollup> created;
+    {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        
+        auto source_it = tables_.find(rollup.source_table);
+        if (source_it == tables_.end() || source_it->second.type != TableType::Stream ||
+            tables_.count(rollup.name) || rollup.bucket_width <= 0) {
+            return false;
+        }
+        source = std::static_pointer_cast<StreamTable>(source_it->second.table_ptr);
+        
+        // 存储表是普通的 Stream 表，可直接列出、查询
+        auto storage = std::make_shared<StreamTable>(rollup.name, prepareConfig(rollup.name, config));
+        attachTableListeners(rollup.name, *storage);
+        tables_.emplace(rollup.name, TableMetadata(rollup.name, TableType::Stream, storage));
+        
+        created = std::make_shared<Rollup>(rollup, storage);
+        uint64_t listener = source->addInsertListener(
+            [created](const TimeSeriesData* data, size_t count) { created->ingest(data, count); });
+        rollups_.emplace(rollup.name, RollupEntry{created, listener});
+    }
+    
+    // 回填源表已有数据（不持有表锁）；应在写入开始前定义 rollup，
+    // 回填期间并发写入的数据可能被计入两次
+    auto stats = source->getStats();
+    if (stats.total_records > 0 && stats.min_timestamp <= stats.max_timestamp) {
+        auto existing = source->query(TimeRange(stats.min_timestamp, stats.max_timestamp));
+        created->ingest(existing.data(), existing.size());
+    }
+    
+    return true;
+}
+
+std::shared_ptr<Rollup> TableManager::getRollup(const std::string& name) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto it = rollups_.find(name);
+    return it != rollups_.end() ? it->second.rollup : nullptr;
+}
+
+std::vector<std::string> TableManager::listRollups(const std::string& source_table) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    std::vector<std::string> names;
+    for (const auto& [name, entry] : rollups_) {
+        if (entry.rollup->getConfig().source_table == source_table) {
+            names.push_back(name);
+        }
+    }
+    return names;
+}
+
 std::shared_ptr<StreamTable> TableManager::getStreamTable(const std::string& name) {
     std::shared_lock<std::shared_mutex> lock(mutex_);
     
@@ -137,6 +234,17 @@ bool TableManager::dropTable(const std::string& name) {
         return false; // 表不存在
     }
     
+    // 删除 rollup 的存储表或源表时，对应 rollup 停止维护
+    for (auto rollup_it = rollups_.begin(); rollup_it != rollups_.end();) {
+        const auto& config = rollup_it->second.rollup->getConfig();
+        if (config.name == name || config.source_table == name) {
+            detachRollup(rollup_it->second);
+            rollup_it = rollups_.erase(rollup_it);
+        } else {
+            ++rollup_it;
+        }
+    }
+    
     tables_.erase(it);
     return true;
 }
@@ -162,6 +270,10 @@ bool TableManager::clearTable(const std::string& name) {
 
 void TableManager::dropAllTables() {
     std::unique_lock<std::shared_mutex> lock(mutex_);
+    for (const auto& [name, entry] : rollups_) {
+        detachRollup(entry);
+    }
+    rollups_.clear();
     tables_.clear();
 }
 
@@ -198,14 +310,40 @@ size_t TableManager::getTableCount() const {
 }
 
 std::map<std::string, std::vector<size_t>> TableManager::insertBatchToTables(
-    const std::map<std::string, std::vector<TimeSeriesData>>& table_data) {
-    
-    std::map<std::string, std::vector<size_t>> result;
+    const std::map<std::string, std::vector<TimeSeriesData>>& table_data,
+    std::map<std::string, std::string>* errors) {
     
+    std::vector<std::string> names;
+    std::vector<const std::vector<TimeSeriesData>*> batches;
     for (const auto& [table_name, data_list] : table_data) {
-        auto table = getStreamTable(table_name);
-        if (table) {
-            result[table_name] = table->insertBatch(data_list);
+        names.push_back(table_name);
+        batches.push_back(&data_list);
+    }
+    
+    std::shared_ptr<core::ResourceHandle> pool;
+    auto tables = resolveStreamTables(names, pool);
+    
+    // 每个表只写自己的槽位，结果与串行执行一致
+    std::vector<std::vector<size_t>> indices(names.size());
+    std::vector<std::string> failures(names.size());
+    runFanOut(names.size(), pool, [&](size_t i) {
+        if (!tables[i].table) {
+            failures[i] = tables[i].error;
+            return;
+        }
+        try {
+            indices[i] = tables[i].table->insertBatch(*batches[i]);
+        } catch (const std::exception& e) {
+            failures[i] = e.what();
+        }
+    });
+    
+    std::map<std::string, std::vector<size_t>> result;
+    for (size_t i = 0; i < names.size(); ++i) {
+        if (failures[i].empty()) {
+            result[names[i]] = std::move(indices[i]);
+        } else if (errors) {
+            (*errors)[names[i]] = std::move(failures[i]);
         }
     }
     
@@ -215,31 +353,153 @@ std::map<std::string, std::vector<size_t>> TableManager::insertBatchToTables(
 }
 
 std::map<std::string, std::vector<TimeSeriesData>> TableManager::queryBatchFromTables(
-    const std::map<std::string, TimeRange>& queries) const {
+    const std::map<std::string, TimeRange>& queries,
+    std::map<std::string, std::string>* errors) const {
+    
+    std::vector<std::string> names;
+    std::vector<TimeRange> ranges;
+    for (const auto& [table_name, range] : queries) {
+        names.push_back(table_name);
+        ranges.push_back(range);
+    }
+    
+    std::shared_ptr<core::ResourceHandle> pool;
+    auto tables = resolveStreamTables(names, pool);
+    
+    std::vector<std::vector<TimeSeriesData>> points(names.size());
+    std::vector<std::string> failures(names.size());
+    runFanOut(names.size(), pool, [&](size_t i) {
+        if (!tables[i].table) {
+            failures[i] = tables[i].error;
+            return;
+        }
+        try {
+            points[i] = tables[i].table->query(ranges[i]);
+        } catch (const std::exception& e) {
+            failures[i] = e.what();
+        }
+    });
     
     std::map<std::string, std::vector<TimeSeriesData>> result;
+    for (size_t i = 0; i < names.size(); ++i) {
+        if (failures[i].empty()) {
+            result[names[i]] = std::move(points[i]);
+        } else if (errors) {
+            (*errors)[names[i]] = std::move(failures[i]);
+        }
+    }
     
-    for (const auto& [table_name, range] : queries) {
-        // 尝试作为 StreamTable 查询
+    return result;
+}
+
+std::vector<TimeSeriesData> TableManager::query(const std::string& name,
+                                                const QueryConfig& config) const {
+    std::shared_ptr<StreamTable> source;
+    std::shared_ptr<Rollup> rollup;
+    {
         std::shared_lock<std::shared_mutex> lock(mutex_);
-        auto it = tables_.find(table_name);
-        if (it == tables_.end()) {
-            continue;
+        auto it = tables_.find(name);
+        if (it == tables_.end() || it->second.type != TableType::Stream) {
+            throw std::runtime_error("Table '" + name + "' is not a StreamTable");
         }
+        source = std::static_pointer_cast<StreamTable>(it->second.table_ptr);
         
-        if (it->second.type == TableType::Stream) {
-            auto table = std::static_pointer_cast<StreamTable>(it->second.table_ptr);
-            lock.unlock();
-            result[table_name] = table->query(range);
+        // 选桶宽最大的可用 rollup：要读的行最少
+        for (const auto& [rollup_name, entry] : rollups_) {
+            const auto& rollup_config = entry.rollup->getConfig();
+            if (rollup_config.source_table == name && entry.rollup->canAnswer(config) &&
+                (!rollup || rollup_config.bucket_width > rollup->getConfig().bucket_width)) {
+                rollup = entry.rollup;
+            }
         }
     }
     
-    return result;
+    const TimeRange& range = config.time_range;
+    size_t limit = config.limit > 0 ? static_cast<size_t>(config.limit) : SIZE_MAX;
+    if (config.aggregation == AggregationType::NONE) {
+        auto points = source->query(range, config.filter_tags);
+        if (points.size() > limit) {
+            points.resize(limit);
+        }
+        return points;
+    }
+    
+    // 每个 (窗口, 分组) 合并一份摘要；输出 tags 为 filter_tags 加分组值
+    std::map<std::pair<int64_t, Tags>, BlockSummary> windows;
+    const bool sketches = needs_sketches(config.aggregation);
+    auto add = [&](int64_t timestamp, const Tags& tags, const BlockSummary& summary) {
+        int64_t window_start = range.start_time;
+        if (config.window_size > 0) {
+            window_start = timestamp - (((timestamp % config.window_size) + config.window_size) %
+                                        config.window_size);
+        }
+        Tags group = config.filter_tags;
+        for (const auto& tag : config.group_by) {
+            auto it = tags.find(tag);
+            if (it != tags.end()) {
+                group.insert(*it);
+            }
+        }
+        windows[{window_start, std::move(group)}].merge(summary, sketches);
+    };
+    auto add_raw = [&](const TimeRange& raw_range) {
+        if (raw_range.start_time > raw_range.end_time) {
+            return;
+        }
+        for (const auto& point : source->query(raw_range, config.filter_tags)) {
+            BlockSummary single;
+            single.sketched = sketches;
+            single.add(point.timestamp, point.as_double());
+            add(point.timestamp, point.tags, single);
+        }
+    };
+    
+    // 对齐到桶边界的中间部分读 rollup，两端不足一个桶的部分读源表
+    int64_t first_bucket = 0;
+    int64_t end_bucket = 0;
+    if (rollup) {
+        int64_t width = rollup->getConfig().bucket_width;
+        first_bucket = rollup->bucketStart(range.start_time);
+        if (first_bucket < range.start_time) {
+            first_bucket += width;
+        }
+        end_bucket = range.end_time < std::numeric_limits<int64_t>::max()
+                         ? rollup->bucketStart(range.end_time + 1)
+                         : rollup->bucketStart(range.end_time);
+    }
+    if (rollup && first_bucket < end_bucket) {
+        add_raw(TimeRange(range.start_time, first_bucket - 1));
+        rollup->scan(TimeRange(first_bucket, end_bucket - 1), config.filter_tags, add);
+        add_raw(TimeRange(end_bucket, range.end_time));
+    } else {
+        add_raw(range);
+    }
+    
+    std::vector<TimeSeriesData> results;
+    results.reserve(std::min(limit, windows.size()));
+    for (const auto& [key, summary] : windows) {
+        if (results.size() >= limit) {
+            break;
+        }
+        results.emplace_back(key.first, summary.value(config.aggregation, config.quantile),
+                             key.second);
+    }
+    return results;
+}
+
+void TableManager::setWorkerPool(std::shared_ptr<core::ResourceHandle> pool) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    worker_pool_ = std::move(pool);
 }
 
 bool TableManager::saveAllTables() {
     std::shared_lock<std::shared_mutex> lock(mutex_);
     
+    // 打开的 rollup 桶先写入存储表，随下面的 flush 落盘
+    for (const auto& [name, entry] : rollups_) {
+        entry.rollup->checkpoint();
+    }
+    
     bool success = true;
     
     for (const auto& [name, metadata] : tables_) {
@@ -267,6 +527,110 @@ bool TableManager::enableCheckpoint(const std::string& name, int interval_second
     return false;
 }
 
+namespace {
+
+// checkpoint 名称即目录名，不能跳出 .checkpoints 目录
+bool isValidCheckpointId(const std::string& id) {
+    return !id.empty() && id != "." && id != ".." && id.find('/') == std::string::npos;
+}
+
+} // anonymous namespace
+
+bool TableManager::createCheckpoint(const std::string& checkpoint_id) {
+    namespace fs = std::filesystem;
+    if (base_data_dir_.empty() || !isValidCheckpointId(checkpoint_id)) {
+        return false;
+    }
+    std::string dir = getCheckpointDir(checkpoint_id);
+    std::string tmp_dir = dir + ".tmp";
+    std::error_code ec;
+    if (fs::exists(dir, ec)) {
+        return false;
+    }
+    fs::remove_all(tmp_dir, ec);
+    
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    
+    // 打开的 rollup 桶先写入存储表，随 checkpoint 一起保存
+    for (const auto& [name, entry] : rollups_) {
+        entry.rollup->checkpoint();
+    }
+    
+    bool success = true;
+    for (const auto& [name, metadata] : tables_) {
+        if (metadata.type == TableType::Stream) {
+            auto table = std::static_pointer_cast<StreamTable>(metadata.table_ptr);
+            success = success && table->createCheckpoint(tmp_dir + "/" + name);
+        }
+    }
+    
+    if (success) {
+        fs::create_directories(tmp_dir, ec);
+        fs::rename(tmp_dir, dir, ec);
+        success = !ec;
+    }
+    if (!success) {
+        fs::remove_all(tmp_dir, ec);
+    }
+    return success;
+}
+
+bool TableManager::restoreCheckpoint(const std::string& checkpoint_id) {
+    namespace fs = std::filesystem;
+    if (base_data_dir_.empty() || !isValidCheckpointId(checkpoint_id)) {
+        return false;
+    }
+    std::string dir = getCheckpointDir(checkpoint_id);
+    std::error_code ec;
+    if (!fs::is_directory(dir, ec)) {
+        return false;
+    }
+    
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    
+    bool success = true;
+    for (const auto& [name, metadata] : tables_) {
+        if (metadata.type != TableType::Stream) {
+            continue;
+        }
+        auto table = std::static_pointer_cast<StreamTable>(metadata.table_ptr);
+        std::string table_dir = dir + "/" + name;
+        if (fs::exists(table_dir, ec)) {
+            success &= table->restoreCheckpoint(table_dir);
+        } else {
+            table->clear();
+        }
+    }
+    return success;
+}
+
+std::vector<std::string> TableManager::listCheckpoints() const {
+    namespace fs = std::filesystem;
+    std::vector<std::string> ids;
+    std::error_code ec;
+    std::string root = base_data_dir_ + "/.checkpoints";
+    if (base_data_dir_.empty() || !fs::is_directory(root, ec)) {
+        return ids;
+    }
+    for (const auto& entry : fs::directory_iterator(root, ec)) {
+        // 未完成的 checkpoint 保留 .tmp 后缀
+        if (entry.is_directory() && entry.path().extension() != ".tmp") {
+            ids.push_back(entry.path().filename().string());
+        }
+    }
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
+
+bool TableManager::deleteCheckpoint(const std::string& checkpoint_id) {
+    namespace fs = std::filesystem;
+    if (base_data_dir_.empty() || !isValidCheckpointId(checkpoint_id)) {
+        return false;
+    }
+    std::error_code ec;
+    return fs::remove_all(getCheckpointDir(checkpoint_id), ec) > 0 && !ec;
+}
+
 TableManager::GlobalStats TableManager::getGlobalStats() const {
     std::shared_lock<std::shared_mutex> lock(mutex_);
     
@@ -283,6 +647,7 @@ TableManager::GlobalStats TableManager::getGlobalStats() const {
             auto table_stats = table->getStats();
             
             stats.total_records += table_stats.total_records;
+            stats.total_memory_bytes += table_stats.memtable_bytes;
             stats.total_disk_bytes += table_stats.disk_size_bytes;
             stats.total_write_throughput += table_stats.write_throughput;
             stats.table_sizes[name] = table_stats.total_records;
@@ -296,6 +661,13 @@ TableManager::GlobalStats TableManager::getGlobalStats() const {
         }
     }
     
+    if (block_cache_) {
+        stats.block_cache = block_cache_->get_stats();
+    }
+    stats.write_buffer_bytes = write_buffer_->get_memory_usage();
+    stats.write_buffer_flushes = write_buffer_->get_flush_requests();
+    stats.write_buffer_stalls = write_buffer_->get_stall_count();
+    
     return stats;
 }
 
@@ -363,6 +735,7 @@ void TableManager::compactAllTables() {
 void TableManager::setGlobalMemoryLimit(size_t max_memory_bytes) {
     std::unique_lock<std::shared_mutex> lock(mutex_);
     global_memory_limit_ = max_memory_bytes;
+    write_buffer_->set_buffer_size(max_memory_bytes);
 }
 
 size_t TableManager::getCurrentMemoryUsage() const {
@@ -373,9 +746,7 @@ size_t TableManager::getCurrentMemoryUsage() const {
     for (const auto& [name, metadata] : tables_) {
         if (metadata.type == TableType::Stream) {
             auto table = std::static_pointer_cast<StreamTable>(metadata.table_ptr);
-            auto stats = table->getStats();
-            // 假设 MemTable 占用约为记录数 * 1KB（粗略估计）
-            total += stats.memtable_records * 1024;
+            total += table->getStats().memtable_bytes;
         }
     }
     
@@ -384,20 +755,157 @@ size_t TableManager::getCurrentMemoryUsage() const {
 
 // ========== 内部辅助方法 ==========
 
-std::string TableManager::getTableDataDir(const std::string& name) const {
-    return base_data_dir_ + "/" + name;
+TableConfig TableManager::prepareConfig(const std::string& name, const TableConfig& config) const {
+    // 设置数据目录，注入共享资源
+    TableConfig table_config = config;
+    if (table_config.data_dir.empty() && !base_data_dir_.empty()) {
+        table_config.data_dir = getTableDataDir(name);
+    }
+    if (!table_config.block_cache) {
+        table_config.block_cache = block_cache_;
+    }
+    if (!table_config.write_buffer_manager) {
+        table_config.write_buffer_manager = write_buffer_;
+    }
+    if (!table_config.metrics_registry) {
+        table_config.metrics_registry = metrics_;
+    }
+    return table_config;
 }
 
-void TableManager::checkMemoryLimit() {
-    if (global_memory_limit_ == 0) {
-        return; // 未设置限制
+void TableManager::detachRollup(const RollupEntry& entry) {
+    auto it = tables_.find(entry.rollup->getConfig().source_table);
+    if (it != tables_.end() && it->second.type == TableType::Stream) {
+        std::static_pointer_cast<StreamTable>(it->second.table_ptr)
+            ->removeInsertListener(entry.listener_id);
+    }
+}
+
+void TableManager::attachTableListeners(const std::string& name, StreamTable& table) {
+    for (auto& [id, entry] : table_listeners_) {
+        TableInsertListener listener = entry.listener;
+        entry.table_ids[name] = table.addInsertListener(
+            [listener, name](const TimeSeriesData* data, size_t count) {
+                listener(name, data, count);
+            });
+    }
+}
+
+uint64_t TableManager::addTableInsertListener(TableInsertListener listener) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    uint64_t id = next_table_listener_id_++;
+    TableListenerEntry& entry = table_listeners_[id];
+    entry.listener = std::move(listener);
+    for (const auto& [name, metadata] : tables_) {
+        if (metadata.type != TableType::Stream) {
+            continue;
+        }
+        TableInsertListener listener_copy = entry.listener;
+        entry.table_ids[name] = std::static_pointer_cast<StreamTable>(metadata.table_ptr)
+            ->addInsertListener([listener_copy, name = name](const TimeSeriesData* data,
+                                                             size_t count) {
+                listener_copy(name, data, count);
+            });
     }
+    return id;
+}
+
+void TableManager::removeTableInsertListener(uint64_t id) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    auto it = table_listeners_.find(id);
+    if (it == table_listeners_.end()) {
+        return;
+    }
+    for (const auto& [name, listener_id] : it->second.table_ids) {
+        auto table_it = tables_.find(name);
+        if (table_it != tables_.end() && table_it->second.type == TableType::Stream) {
+            std::static_pointer_cast<StreamTable>(table_it->second.table_ptr)
+                ->removeInsertListener(listener_id);
+        }
+    }
+    table_listeners_.erase(it);
+}
+
+std::vector<TableManager::ResolvedTable> TableManager::resolveStreamTables(
+    const std::vector<std::string>& names,
+    std::shared_ptr<core::ResourceHandle>& pool) const {
     
-    size_t current_usage = getCurrentMemoryUsage();
+    // 只在解析表名时持有表锁，执行期间可以并发创建/删除表
+    std::shared_lock<std::shared_mutex> lock(mutex_);
     
-    if (current_usage > global_memory_limit_) {
-        // 触发全局 flush
-        flushAllTables();
+    std::vector<ResolvedTable> tables(names.size());
+    for (size_t i = 0; i < names.size(); ++i) {
+        auto it = tables_.find(names[i]);
+        if (it == tables_.end()) {
+            tables[i].error = "Table '" + names[i] + "' does not exist";
+        } else if (it->second.type != TableType::Stream) {
+            tables[i].error = "Table '" + names[i] + "' is not a StreamTable";
+        } else {
+            tables[i].table = std::static_pointer_cast<StreamTable>(it->second.table_ptr);
+        }
+    }
+    pool = worker_pool_;
+    return tables;
+}
+
+template <typename Fn>
+void TableManager::runFanOut(size_t count, const std::shared_ptr<core::ResourceHandle>& pool,
+                             Fn&& fn) {
+    if (count <= 1) {
+        if (count == 1) {
+            fn(0);
+        }
+        return;
+    }
+    
+    // 任务按下标领取；调用线程也参与领取，线程池繁忙或调用方本身就在池中时不会死锁
+    struct State {
+        std::atomic<size_t> next{0};
+        size_t done = 0;
+        std::mutex mutex;
+        std::condition_variable cv;
+    };
+    auto state = std::make_shared<State>();
+    auto work = [state, count, &fn]() {
+        // 全部完成后才启动的任务领不到下标，不会再访问 fn
+        for (size_t i = state->next.fetch_add(1); i < count; i = state->next.fetch_add(1)) {
+            fn(i);
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if (++state->done == count) {
+                state->cv.notify_all();
+            }
+        }
+    };
+    
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < count; ++i) {
+        if (!pool || !pool->submit(work)) {
+            threads.emplace_back(work);  // 未设置线程池（或已失效）时使用临时线程
+        }
+    }
+    work();
+    
+    {
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->cv.wait(lock, [&]() { return state->done == count; });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+std::string TableManager::getTableDataDir(const std::string& name) const {
+    return base_data_dir_ + "/" + name;
+}
+
+std::string TableManager::getCheckpointDir(const std::string& checkpoint_id) const {
+    return base_data_dir_ + "/.checkpoints/" + checkpoint_id;
+}
+
+void TableManager::checkMemoryLimit() {
+    // 写入路径已按预算切换 MemTable；这里补一次，覆盖批量写入结束时恰好越过软限制的情况
+    if (write_buffer_->should_flush()) {
+        write_buffer_->flush_one();
     }
 }
 
@@ -1,4 +1,8 @@
 #include "sage_tsdb/core/time_series_data.h"
+#include <bit>
+#include <charconv>
+#include <cstring>
+#include <ostream>
 #include <stdexcept>
 
 namespace sage_tsdb {
@@ -24,4 +28,223 @@ std::vector<double> TimeSeriesData::as_vector() const {
     return {};
 }
 
+namespace {
+
+template <typename T>
+T parse_number(const std::string& text) {
+    T value{};
+    std::from_chars(text.data(), text.data() + text.size(), value);
+    return value;
+}
+
+template <typename T>
+void append_raw(std::vector<uint8_t>& out, const T& value) {
+    const auto* bytes = reinterpret_cast<const uint8_t*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T>
+bool read_raw(const uint8_t*& ptr, const uint8_t* end, T& value) {
+    if (static_cast<size_t>(end - ptr) < sizeof(T)) {
+        return false;
+    }
+    std::memcpy(&value, ptr, sizeof(T));
+    ptr += sizeof(T);
+    return true;
+}
+
+bool read_raw_string(const uint8_t*& ptr, const uint8_t* end, std::string& value) {
+    uint32_t len;
+    if (!read_raw(ptr, end, len) || static_cast<size_t>(end - ptr) < len) {
+        return false;
+    }
+    value.assign(reinterpret_cast<const char*>(ptr), len);
+    ptr += len;
+    return true;
+}
+
+} // anonymous namespace
+
+int64_t FieldValue::as_int64() const {
+    switch (type()) {
+        case Type::INT64: return std::get<int64_t>(value_);
+        case Type::DOUBLE: return static_cast<int64_t>(std::get<double>(value_));
+        case Type::BOOL: return std::get<bool>(value_) ? 1 : 0;
+        default: {
+            // Text written before fields were typed may hold a double
+            const auto& text = std::get<std::string>(value_);
+            int64_t value = 0;
+            auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+            if (ec == std::errc() && end != text.data() + text.size() && *end == '.') {
+                return static_cast<int64_t>(parse_number<double>(text));
+            }
+            return value;
+        }
+    }
+}
+
+uint64_t FieldValue::as_uint64() const {
+    if (is_string()) {
+        const auto& text = std::get<std::string>(value_);
+        if (!text.empty() && text[0] != '-') {
+            auto value = parse_number<uint64_t>(text);
+            if (value > static_cast<uint64_t>(INT64_MAX)) {
+                return value;
+            }
+        }
+    }
+    return static_cast<uint64_t>(as_int64());
+}
+
+double FieldValue::as_double() const {
+    switch (type()) {
+        case Type::INT64: return static_cast<double>(std::get<int64_t>(value_));
+        case Type::DOUBLE: return std::get<double>(value_);
+        case Type::BOOL: return std::get<bool>(value_) ? 1.0 : 0.0;
+        default: return parse_number<double>(std::get<std::string>(value_));
+    }
+}
+
+bool FieldValue::as_bool() const {
+    switch (type()) {
+        case Type::INT64: return std::get<int64_t>(value_) != 0;
+        case Type::DOUBLE: return std::get<double>(value_) != 0.0;
+        case Type::BOOL: return std::get<bool>(value_);
+        default: {
+            const auto& text = std::get<std::string>(value_);
+            return text == "true" || text == "1";
+        }
+    }
+}
+
+std::string FieldValue::to_string() const {
+    switch (type()) {
+        case Type::INT64: return std::to_string(std::get<int64_t>(value_));
+        case Type::DOUBLE: {
+            char buffer[32];
+            auto [end, ec] = std::to_chars(buffer, buffer + sizeof(buffer), std::get<double>(value_));
+            return std::string(buffer, end);
+        }
+        case Type::BOOL: return std::get<bool>(value_) ? "true" : "false";
+        default: return std::get<std::string>(value_);
+    }
+}
+
+size_t FieldValue::byte_size() const {
+    switch (type()) {
+        case Type::BOOL: return 1;
+        case Type::STRING: return std::get<std::string>(value_).size();
+        default: return 8;
+    }
+}
+
+void FieldValue::serialize(std::vector<uint8_t>& out) const {
+    out.push_back(static_cast<uint8_t>(type()));
+    switch (type()) {
+        case Type::INT64: append_raw(out, std::get<int64_t>(value_)); break;
+        case Type::DOUBLE: append_raw(out, std::get<double>(value_)); break;
+        case Type::BOOL: out.push_back(std::get<bool>(value_) ? 1 : 0); break;
+        case Type::STRING: {
+            const auto& text = std::get<std::string>(value_);
+            append_raw(out, static_cast<uint32_t>(text.size()));
+            out.insert(out.end(), text.begin(), text.end());
+            break;
+        }
+    }
+}
+
+bool FieldValue::deserialize(const uint8_t*& ptr, const uint8_t* end) {
+    uint8_t tag;
+    if (!read_raw(ptr, end, tag)) {
+        return false;
+    }
+    switch (static_cast<Type>(tag)) {
+        case Type::INT64: {
+            int64_t value;
+            if (!read_raw(ptr, end, value)) return false;
+            value_ = value;
+            return true;
+        }
+        case Type::DOUBLE: {
+            double value;
+            if (!read_raw(ptr, end, value)) return false;
+            value_ = value;
+            return true;
+        }
+        case Type::BOOL: {
+            uint8_t value;
+            if (!read_raw(ptr, end, value)) return false;
+            value_ = value != 0;
+            return true;
+        }
+        case Type::STRING: {
+            std::string value;
+            if (!read_raw_string(ptr, end, value)) return false;
+            value_ = std::move(value);
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+bool FieldValue::operator<(const FieldValue& other) const {
+    if (value_.index() != other.value_.index()) {
+        return value_.index() < other.value_.index();
+    }
+    if (is_double()) {
+        // NaN must not break map ordering
+        return std::bit_cast<uint64_t>(std::get<double>(value_)) <
+               std::bit_cast<uint64_t>(std::get<double>(other.value_));
+    }
+    return value_ < other.value_;
+}
+
+std::ostream& operator<<(std::ostream& out, const FieldValue& value) {
+    return out << value.to_string();
+}
+
+void serialize_fields(const Fields& fields, std::vector<uint8_t>& out) {
+    append_raw(out, static_cast<uint32_t>(fields.size()));
+    for (const auto& [key, value] : fields) {
+        append_raw(out, static_cast<uint32_t>(key.size()));
+        out.insert(out.end(), key.begin(), key.end());
+        value.serialize(out);
+    }
+}
+
+bool deserialize_fields(const uint8_t*& ptr, const uint8_t* end, Fields& fields) {
+    uint32_t count;
+    if (!read_raw(ptr, end, count)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+        std::string key;
+        FieldValue value;
+        if (!read_raw_string(ptr, end, key) || !value.deserialize(ptr, end)) {
+            return false;
+        }
+        fields.insert_or_assign(std::move(key), std::move(value));
+    }
+    return true;
+}
+
+uint64_t TimeSeriesData::hash_tags(const Tags& tags) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    auto mix = [&hash](const std::string& str) {
+        for (unsigned char c : str) {
+            hash ^= c;
+            hash *= 0x100000001b3ULL;
+        }
+        // Separator so ("ab", "c") and ("a", "bc") differ
+        hash ^= 0xff;
+        hash *= 0x100000001b3ULL;
+    };
+    for (const auto& [key, value] : tags) {
+        mix(key);
+        mix(value);
+    }
+    return hash;
+}
+
 } // namespace sage_tsdb
@@ -7,7 +7,8 @@
 namespace sage_tsdb {
 
 TimeSeriesDB::TimeSeriesDB()
-    : index_(std::make_unique<TimeSeriesIndex>()),
+    : series_catalog_(std::make_shared<SeriesCatalog>()),
+      index_(std::make_unique<TimeSeriesIndex>(series_catalog_)),
       query_count_(0),
       write_count_(0),
       storage_engine_(std::make_unique<StorageEngine>()),
@@ -19,45 +20,62 @@ TimeSeriesDB::~TimeSeriesDB() = default;
 
 bool TimeSeriesDB::createTable(const std::string& name, TableType type) {
     // Check if table already exists
-    if (tables_.find(name) != tables_.end()) {
+    if (hasTable(name)) {
         return false;
     }
     
     // Create new index for this table
-    tables_[name] = std::make_unique<TimeSeriesIndex>();
+    tables_[name] = std::make_unique<TimeSeriesIndex>(series_catalog_);
     table_types_[name] = type;
     
     return true;
 }
 
-bool TimeSeriesDB::dropTable(const std::string& name) {
-    auto it = tables_.find(name);
-    if (it == tables_.end()) {
+bool TimeSeriesDB::createShardedTable(const std::string& name, const ShardedTableConfig& config) {
+    if (hasTable(name)) {
         return false;
     }
     
-    tables_.erase(it);
+    sharded_tables_[name] = std::make_unique<ShardedTable>(config, series_catalog_);
+    table_types_[name] = TableType::TimeSeries;
+    
+    return true;
+}
+
+bool TimeSeriesDB::dropTable(const std::string& name) {
+    if (tables_.erase(name) == 0 && sharded_tables_.erase(name) == 0) {
+        return false;
+    }
     table_types_.erase(name);
     
     return true;
 }
 
 bool TimeSeriesDB::hasTable(const std::string& name) const {
-    return tables_.find(name) != tables_.end();
+    return tables_.find(name) != tables_.end() ||
+           sharded_tables_.find(name) != sharded_tables_.end();
 }
 
 std::vector<std::string> TimeSeriesDB::listTables() const {
     std::vector<std::string> names;
-    names.reserve(tables_.size());
+    names.reserve(tables_.size() + sharded_tables_.size());
     
     for (const auto& [name, _] : tables_) {
         names.push_back(name);
     }
+    for (const auto& [name, _] : sharded_tables_) {
+        names.push_back(name);
+    }
     
     return names;
 }
 
 size_t TimeSeriesDB::insert(const std::string& table_name, const TimeSeriesData& data) {
+    if (auto* sharded = getShardedTable(table_name)) {
+        ++write_count_;
+        return sharded->insert(data);
+    }
+    
     auto* table_index = getTableIndex(table_name);
     if (!table_index) {
         throw std::runtime_error("Table not found: " + table_name);
@@ -69,6 +87,11 @@ size_t TimeSeriesDB::insert(const std::string& table_name, const TimeSeriesData&
 
 std::vector<size_t> TimeSeriesDB::insertBatch(const std::string& table_name,
                                                 const std::vector<TimeSeriesData>& data_list) {
+    if (auto* sharded = getShardedTable(table_name)) {
+        write_count_ += data_list.size();
+        return sharded->insertBatch(data_list);
+    }
+    
     auto* table_index = getTableIndex(table_name);
     if (!table_index) {
         throw std::runtime_error("Table not found: " + table_name);
@@ -80,6 +103,11 @@ std::vector<size_t> TimeSeriesDB::insertBatch(const std::string& table_name,
 
 std::vector<TimeSeriesData> TimeSeriesDB::query(const std::string& table_name,
                                                   const QueryConfig& config) const {
+    if (const auto* sharded = getShardedTable(table_name)) {
+        ++query_count_;
+        return sharded->query(config);
+    }
+    
     const auto* table_index = getTableIndex(table_name);
     if (!table_index) {
         throw std::runtime_error("Table not found: " + table_name);
@@ -97,6 +125,30 @@ std::vector<TimeSeriesData> TimeSeriesDB::query(const std::string& table_name,
     return query(table_name, config);
 }
 
+TimeSeriesIndex::ResultView TimeSeriesDB::query_view(const std::string& table_name,
+                                                     const QueryConfig& config) const {
+    if (const auto* sharded = getShardedTable(table_name)) {
+        ++query_count_;
+        return sharded->query_view(config);
+    }
+    
+    const auto* table_index = getTableIndex(table_name);
+    if (!table_index) {
+        throw std::runtime_error("Table not found: " + table_name);
+    }
+    
+    ++query_count_;
+    return table_index->query_view(config);
+}
+
+TimeSeriesIndex::ResultView TimeSeriesDB::query_view(const std::string& table_name,
+                                                     const TimeRange& time_range,
+                                                     const Tags& filter_tags) const {
+    QueryConfig config(time_range, filter_tags);
+    config.limit = 0;  // No limit when querying by TimeRange
+    return query_view(table_name, config);
+}
+
 TimeSeriesIndex* TimeSeriesDB::getTableIndex(const std::string& table_name) {
     auto it = tables_.find(table_name);
     if (it != tables_.end()) {
@@ -113,6 +165,14 @@ const TimeSeriesIndex* TimeSeriesDB::getTableIndex(const std::string& table_name
     return nullptr;
 }
 
+ShardedTable* TimeSeriesDB::getShardedTable(const std::string& table_name) const {
+    auto it = sharded_tables_.find(table_name);
+    if (it != sharded_tables_.end()) {
+        return it->second.get();
+    }
+    return nullptr;
+}
+
 // ========== Resource Management Implementation ==========
 
 std::shared_ptr<ResourceManager> TimeSeriesDB::getResourceManager() const {
@@ -150,6 +210,12 @@ std::vector<size_t> TimeSeriesDB::add_batch(
     return index_->add_batch(data_list);
 }
 
+size_t TimeSeriesDB::add_columns(const int64_t* timestamps, const double* values, size_t count,
+                                 const Tags& tags) {
+    write_count_ += count;
+    return index_->add_columns(timestamps, values, count, tags);
+}
+
 std::vector<TimeSeriesData> TimeSeriesDB::query(
     const QueryConfig& config) const {
     ++query_count_;
@@ -162,6 +228,11 @@ std::vector<TimeSeriesData> TimeSeriesDB::query(
     return query(config);
 }
 
+TimeSeriesIndex::ResultView TimeSeriesDB::query_view(const QueryConfig& config) const {
+    ++query_count_;
+    return index_->query_view(config);
+}
+
 void TimeSeriesDB::register_algorithm(
     const std::string& name,
     std::shared_ptr<TimeSeriesAlgorithm> algorithm) {
@@ -220,12 +291,13 @@ bool TimeSeriesDB::save_to_disk(const std::string& file_path) {
         return false;
     }
     
-    // Get all data from index
-    TimeRange full_range(0, std::numeric_limits<int64_t>::max());
-    QueryConfig config(full_range);
-    std::vector<TimeSeriesData> all_data = index_->query(config);
-    
-    return storage_engine_->save(all_data, file_path);
+    // The view pins the current version without blocking writers; points
+    // are copied out one chunk at a time as the snapshot is written
+    QueryConfig config(TimeRange(std::numeric_limits<int64_t>::min(),
+                                 std::numeric_limits<int64_t>::max()));
+    config.limit = 0;
+    auto view = index_->query_view(config);
+    return storage_engine_->save_chunked(view.begin(), view.end(), file_path);
 }
 
 bool TimeSeriesDB::load_from_disk(const std::string& file_path, bool clear_existing) {
@@ -233,6 +305,21 @@ bool TimeSeriesDB::load_from_disk(const std::string& file_path, bool clear_exist
         return false;
     }
     
+    if (StorageEngine::is_chunked_file(file_path)) {
+        if (clear_existing) {
+            clear();
+        }
+        // Chunks are decoded in parallel and moved into the index in file
+        // order, so at most one decoded chunk per core is held at a time
+        size_t loaded = 0;
+        bool ok = storage_engine_->load_chunked(file_path, [&](std::vector<TimeSeriesData>&& chunk) {
+            loaded += chunk.size();
+            write_count_ += chunk.size();
+            index_->add_batch(std::move(chunk));
+        });
+        return ok && loaded > 0;
+    }
+    
     std::vector<TimeSeriesData> loaded_data = storage_engine_->load(file_path);
     if (loaded_data.empty()) {
         return false;
@@ -246,6 +333,15 @@ bool TimeSeriesDB::load_from_disk(const std::string& file_path, bool clear_exist
     return true;
 }
 
+std::vector<TimeSeriesData> TimeSeriesDB::query_from_disk(const QueryConfig& config) const {
+    if (!storage_engine_) {
+        return {};
+    }
+    
+    ++query_count_;
+    return storage_engine_->query(config);
+}
+
 bool TimeSeriesDB::create_checkpoint(uint64_t checkpoint_id) {
     if (!storage_engine_) {
         return false;
@@ -1,29 +1,327 @@
 #include "sage_tsdb/core/time_series_index.h"
 #include <algorithm>
-#include <set>
+#include <bit>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
 #include <mutex>
+#include <stdexcept>
+#include <unordered_map>
 
 namespace sage_tsdb {
 
-TimeSeriesIndex::TimeSeriesIndex()
-    : sorted_(true) {}
+namespace {
+
+// Numeric "key" tag, 0 if absent or not a number
+uint64_t numeric_key(const Tags& tags) {
+    auto it = tags.find("key");
+    if (it != tags.end()) {
+        try {
+            return std::stoull(it->second);
+        } catch (...) {}
+    }
+    return 0;
+}
+
+// Whether (ts_a, key_a) sorts strictly before (ts_b, key_b)
+inline bool ordered_before(int64_t ts_a, uint64_t key_a, int64_t ts_b, uint64_t key_b) {
+    return ts_a != ts_b ? ts_a < ts_b : key_a < key_b;
+}
+
+} // namespace
+
+TimeSeriesIndex::Chunk::Chunk(size_t capacity, bool with_extras)
+    : capacity(capacity),
+      timestamps(std::make_unique_for_overwrite<int64_t[]>(capacity)),
+      values(std::make_unique_for_overwrite<double[]>(capacity)),
+      series(std::make_unique_for_overwrite<uint32_t[]>(capacity)),
+      keys(std::make_unique_for_overwrite<uint64_t[]>(capacity)) {
+    if (with_extras) {
+        extras = std::make_unique<std::shared_ptr<const Extra>[]>(capacity);
+    }
+}
+
+TimeSeriesIndex::TimeSeriesIndex(std::shared_ptr<SeriesCatalog> catalog, bool scalar_values)
+    : catalog_(catalog ? std::move(catalog) : std::make_shared<SeriesCatalog>()),
+      scalar_values_(scalar_values) {
+    publish(std::make_shared<const Version>(Version{std::make_shared<const Chunks>(), {}}));
+}
+
+TimeSeriesIndex::View TimeSeriesIndex::snapshot() const {
+    View view;
+    for (;;) {
+        view.version = version_.load();
+        const Chunks& chunks = view.chunks();
+        view.last_size = chunks.empty() ? 0 : chunks.back()->size.load(std::memory_order_acquire);
+        // Unchanged version: the size was read while it was current
+        if (version_.load() == view.version) {
+            return view;
+        }
+    }
+}
+
+void TimeSeriesIndex::publish(std::shared_ptr<const Version> version) {
+    current_ = std::move(version);
+    version_.store(current_);
+}
+
+bool TimeSeriesIndex::row_less(const Row& a, const Row& b) {
+    // Primary sort by timestamp, then by key for deterministic ordering
+    return ordered_before(a.point.timestamp, a.key, b.point.timestamp, b.key);
+}
+
+size_t TimeSeriesIndex::main_upper_bound(const View& view, const Row& row) {
+    size_t left = 0;
+    size_t right = view.main_rows();
+    while (left < right) {
+        size_t mid = left + (right - left) / 2;
+        if (ordered_before(row.point.timestamp, row.key, view.timestamp(mid), view.key(mid))) {
+            right = mid;
+        } else {
+            left = mid + 1;
+        }
+    }
+    return left;
+}
+
+std::vector<TimeSeriesIndex::Slice> TimeSeriesIndex::time_slices(const View& view,
+                                                                 const TimeRange& range) {
+    const Chunks& chunks = view.chunks();
+    std::vector<Slice> slices;
+
+    // First chunk whose last row is not before the range
+    size_t c = std::partition_point(chunks.begin(), chunks.end(), [&](const auto& chunk) {
+        size_t n = view.chunk_size(&chunk - chunks.data());
+        return n > 0 && chunk->timestamps[n - 1] < range.start_time;
+    }) - chunks.begin();
+
+    for (; c < chunks.size(); ++c) {
+        size_t n = view.chunk_size(c);
+        const int64_t* ts = chunks[c]->timestamps.get();
+        if (n == 0 || ts[0] > range.end_time) {
+            break;
+        }
+        size_t lo = std::lower_bound(ts, ts + n, range.start_time) - ts;
+        size_t hi = std::upper_bound(ts + lo, ts + n, range.end_time) - ts;
+        if (lo < hi) {
+            slices.push_back({c, lo, hi});
+        }
+    }
+    return slices;
+}
+
+void TimeSeriesIndex::filter_slice(const View& view, const Slice& slice, const Tags& tags,
+                                   std::unordered_map<uint32_t, bool>& memo,
+                                   std::vector<RowRef>& out, size_t limit) const {
+    const Chunk& chunk = *view.chunks()[slice.chunk];
+    uint32_t c = static_cast<uint32_t>(slice.chunk);
+
+    if (chunk.sealed.load(std::memory_order_acquire)) {
+        // Rows matching the tags, restricted to the slice
+        std::vector<const RoaringBitmap*> postings;
+        postings.reserve(tags.size());
+        for (const auto& [key, value] : tags) {
+            auto key_it = chunk.postings.find(key);
+            if (key_it == chunk.postings.end()) {
+                return;
+            }
+            auto value_it = key_it->second.find(value);
+            if (value_it == key_it->second.end()) {
+                return;
+            }
+            postings.push_back(&value_it->second);
+        }
+        RoaringBitmap matches = RoaringBitmap::intersect(std::move(postings));
+        matches &= RoaringBitmap::range(static_cast<uint32_t>(slice.lo),
+                                        static_cast<uint32_t>(slice.hi));
+        matches.for_each([&](uint32_t row) {
+            out.push_back({c, row});
+            return out.size() < limit;
+        });
+        return;
+    }
+
+    // No postings yet: check each row's series once
+    for (size_t r = slice.lo; r < slice.hi && out.size() < limit; ++r) {
+        auto [it, inserted] = memo.try_emplace(chunk.series[r], false);
+        if (inserted) {
+            it->second = matches_tags(chunk.series[r], tags);
+        }
+        if (it->second) {
+            out.push_back({c, static_cast<uint32_t>(r)});
+        }
+    }
+}
+
+void TimeSeriesIndex::put_row(Chunk& chunk, size_t slot, Row&& row) {
+    chunk.timestamps[slot] = row.point.timestamp;
+    chunk.values[slot] = row.point.as_double();
+    chunk.series[slot] = row.series;
+    chunk.keys[slot] = row.key;
+
+    if (plain(row)) {
+        return;     // Side column slots start out null
+    }
+    if (!chunk.extras) {
+        chunk.extras = std::make_unique<std::shared_ptr<const Extra>[]>(chunk.capacity);
+    }
+    auto extra = std::make_shared<Extra>();
+    if (!row.point.is_scalar()) {
+        extra->vector_value = std::move(std::get<std::vector<double>>(row.point.value));
+        extra->is_vector = true;
+    }
+    extra->fields = std::move(row.point.fields);
+    chunk.extras[slot] = std::move(extra);
+}
+
+void TimeSeriesIndex::copy_rows(Chunk& chunk, size_t slot, const Chunk& from, size_t row,
+                                size_t n) {
+    std::memcpy(&chunk.timestamps[slot], &from.timestamps[row], n * sizeof(int64_t));
+    std::memcpy(&chunk.values[slot], &from.values[row], n * sizeof(double));
+    std::memcpy(&chunk.series[slot], &from.series[row], n * sizeof(uint32_t));
+    std::memcpy(&chunk.keys[slot], &from.keys[row], n * sizeof(uint64_t));
+    if (!from.extras) {
+        return;
+    }
+    if (!chunk.extras) {
+        chunk.extras = std::make_unique<std::shared_ptr<const Extra>[]>(chunk.capacity);
+    }
+    std::copy_n(&from.extras[row], n, &chunk.extras[slot]);
+}
+
+void TimeSeriesIndex::append_main(Row&& row) {
+    const Chunks& chunks = *current_->chunks;
+    Chunk* last = chunks.empty() ? nullptr : chunks.back().get();
+    size_t n = last ? last->size.load(std::memory_order_relaxed) : 0;
+    bool needs_extras = !plain(row);
+
+    if (!last || n == kChunkRows) {
+        auto next = std::make_shared<Chunks>(chunks);
+        next->push_back(std::make_shared<Chunk>(kFirstChunkRows, needs_extras));
+        last = next->back().get();
+        n = 0;
+        publish(std::make_shared<const Version>(Version{std::move(next), current_->delta}));
+    } else if (n == last->capacity || (needs_extras && !last->extras)) {
+        // Readers may be scanning the chunk: grow, or add the side column,
+        // into a copy
+        size_t capacity = n == last->capacity ? std::min(last->capacity * 2, kChunkRows)
+                                              : last->capacity;
+        auto grown = std::make_shared<Chunk>(capacity, needs_extras || last->extras);
+        copy_rows(*grown, 0, *last, 0, n);
+        grown->size.store(n, std::memory_order_relaxed);
+        auto next = std::make_shared<Chunks>(chunks);
+        next->back() = grown;
+        last = grown.get();
+        publish(std::make_shared<const Version>(Version{std::move(next), current_->delta}));
+    }
+
+    put_row(*last, n, std::move(row));
+    last->size.store(n + 1, std::memory_order_release);
+    if (n + 1 == kChunkRows) {
+        seal(*last);
+    }
+}
+
+void TimeSeriesIndex::seal(Chunk& chunk) const {
+    // Postings each series' rows go to
+    std::unordered_map<uint32_t, std::vector<RoaringBitmap*>> series_postings;
+    size_t n = chunk.size.load(std::memory_order_relaxed);
+    for (size_t r = 0; r < n; ++r) {
+        auto [it, inserted] = series_postings.try_emplace(chunk.series[r]);
+        if (inserted) {
+            for (const auto& [key, value] : catalog_->tags(chunk.series[r])) {
+                it->second.push_back(&chunk.postings[key][value]);
+            }
+        }
+        for (RoaringBitmap* posting : it->second) {
+            posting->add(static_cast<uint32_t>(r));
+        }
+    }
+    chunk.sealed.store(true, std::memory_order_release);
+}
+
+TimeSeriesData TimeSeriesIndex::resolve(const Row& row) const {
+    TimeSeriesData data = row.point;
+    data.tags = catalog_->tags(row.series);
+    return data;
+}
+
+TimeSeriesData TimeSeriesIndex::resolve_main(const Chunk& chunk, size_t row) const {
+    TimeSeriesData data(chunk.timestamps[row], chunk.values[row],
+                        catalog_->tags(chunk.series[row]));
+    if (const Extra* extra = chunk.extra(row)) {
+        if (extra->is_vector) {
+            data.value = extra->vector_value;
+        }
+        data.fields = extra->fields;
+    }
+    return data;
+}
 
 size_t TimeSeriesIndex::add(const TimeSeriesData& data) {
-    std::unique_lock<std::shared_mutex> lock(mutex_);
-    
-    size_t idx = data_.size();
-    data_.push_back(data);
-    
-    // Update tag index
-    for (const auto& [key, value] : data.tags) {
-        tag_index_[key][value].push_back(idx);
-    }
-    
-    // Check if data is out of order
-    if (idx > 0 && data.timestamp < data_[idx - 1].timestamp) {
-        sorted_ = false;
-    }
-    
+    if (scalar_values_ && !data.is_scalar()) {
+        throw std::invalid_argument("TimeSeriesIndex: vector value in a scalar index");
+    }
+    Row entry;
+    entry.point.timestamp = data.timestamp;
+    entry.point.value = data.value;
+    entry.point.fields = data.fields;
+    entry.series = catalog_->intern(data.tags);
+    entry.key = numeric_key(data.tags);
+
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    return insert_row(std::move(entry));
+}
+
+size_t TimeSeriesIndex::add_columns(const int64_t* timestamps, const double* values,
+                                    size_t count, const Tags& tags) {
+    Row entry;
+    entry.series = catalog_->intern(tags);
+    entry.key = numeric_key(tags);
+
+    if (count == 0) {
+        return size();
+    }
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    size_t first = 0;
+    for (size_t i = 0; i < count; ++i) {
+        entry.point.timestamp = timestamps[i];
+        entry.point.value = values[i];
+        size_t idx = insert_row(Row(entry));
+        if (i == 0) {
+            first = idx;
+        }
+    }
+    return first;
+}
+
+size_t TimeSeriesIndex::insert_row(Row&& entry) {
+    const Chunks& chunks = *current_->chunks;
+    const Chunk* last = chunks.empty() ? nullptr : chunks.back().get();
+    size_t last_size = last ? last->size.load(std::memory_order_relaxed) : 0;
+    size_t idx = (chunks.empty() ? 0 : (chunks.size() - 1) * kChunkRows + last_size) +
+                 current_->delta.size();
+
+    bool late = last_size > 0 &&
+                ordered_before(entry.point.timestamp, entry.key,
+                               last->timestamps[last_size - 1], last->keys[last_size - 1]);
+    if (late) {
+        // Late point: keep it out of the main run until enough pile up
+        auto version = std::make_shared<Version>(*current_);
+        auto row = std::make_shared<const Row>(std::move(entry));
+        auto pos = std::upper_bound(version->delta.begin(), version->delta.end(), row,
+            [](const auto& a, const auto& b) { return row_less(*a, *b); });
+        version->delta.insert(pos, std::move(row));
+        bool merge = version->delta.size() >= kDeltaMergeThreshold;
+        publish(std::move(version));
+        if (merge) {
+            merge_delta();
+        }
+        return idx;
+    }
+
+    append_main(std::move(entry));
     return idx;
 }
 
@@ -31,214 +329,564 @@ std::vector<size_t> TimeSeriesIndex::add_batch(
     const std::vector<TimeSeriesData>& data_list) {
     std::vector<size_t> indices;
     indices.reserve(data_list.size());
-    
+
     for (const auto& data : data_list) {
         indices.push_back(add(data));
     }
-    
+
+    return indices;
+}
+
+std::vector<size_t> TimeSeriesIndex::add_batch(std::vector<TimeSeriesData>&& data_list) {
+    std::vector<Row> rows(data_list.size());
+    for (size_t i = 0; i < data_list.size(); ++i) {
+        TimeSeriesData& data = data_list[i];
+        if (scalar_values_ && !data.is_scalar()) {
+            throw std::invalid_argument("TimeSeriesIndex: vector value in a scalar index");
+        }
+        rows[i].point.timestamp = data.timestamp;
+        rows[i].point.value = std::move(data.value);
+        rows[i].point.fields = std::move(data.fields);
+        rows[i].series = catalog_->intern(data.tags);
+        rows[i].key = numeric_key(data.tags);
+    }
+    data_list.clear();
+
+    std::vector<size_t> indices;
+    indices.reserve(rows.size());
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    for (auto& row : rows) {
+        indices.push_back(insert_row(std::move(row)));
+    }
     return indices;
 }
 
 std::vector<TimeSeriesData> TimeSeriesIndex::query(
     const QueryConfig& config) const {
-    std::shared_lock<std::shared_mutex> lock(mutex_);
-    
-    // Ensure data is sorted (may need to upgrade lock)
-    if (!sorted_) {
-        lock.unlock();
-        const_cast<TimeSeriesIndex*>(this)->ensure_sorted();
-        lock.lock();
-    }
-    
-    // Binary search for time range
-    size_t start_idx = binary_search(config.time_range.start_time);
-    size_t end_idx = binary_search(config.time_range.end_time, true);
-    
-    // Filter by tags if specified
-    std::vector<TimeSeriesData> results;
-    
-    if (!config.filter_tags.empty()) {
-        auto matching_indices = filter_by_tags(config.filter_tags);
-        
-        // Collect data points in time range that match tags
-        for (size_t i = start_idx; i <= end_idx && i < data_.size(); ++i) {
-            if (std::find(matching_indices.begin(), matching_indices.end(), i) 
-                != matching_indices.end()) {
-                results.push_back(data_[i]);
-                if (config.limit > 0 && 
-                    results.size() >= static_cast<size_t>(config.limit)) {
-                    break;
+    View view = snapshot();
+
+    if (config.aggregation != AggregationType::NONE) {
+        return aggregate(view, config);
+    }
+    return select(std::move(view), config).materialize();
+}
+
+TimeSeriesIndex::ResultView TimeSeriesIndex::query_view(const QueryConfig& config) const {
+    View view = snapshot();
+
+    if (config.aggregation != AggregationType::NONE) {
+        return ResultView(aggregate(view, config));
+    }
+    return select(std::move(view), config);
+}
+
+TimeSeriesIndex::ResultView TimeSeriesIndex::select(View view, const QueryConfig& config) const {
+    size_t limit = config.limit > 0 ? static_cast<size_t>(config.limit) : SIZE_MAX;
+    const Chunks& chunks = view.chunks();
+
+    // Rows of the main run, at most limit of them
+    std::vector<RowRef> rows;
+    std::unordered_map<uint32_t, bool> memo;
+    for (const Slice& slice : time_slices(view, config.time_range)) {
+        if (rows.size() >= limit) {
+            break;
+        }
+        if (!config.filter_tags.empty()) {
+            filter_slice(view, slice, config.filter_tags, memo, rows, limit);
+            continue;
+        }
+        // No tag filtering
+        for (size_t r = slice.lo; r < slice.hi && rows.size() < limit; ++r) {
+            rows.push_back({static_cast<uint32_t>(slice.chunk), static_cast<uint32_t>(r)});
+        }
+    }
+
+    ResultView result;
+    result.catalog_ = catalog_;
+    auto& entries = result.entries_;
+    auto main_entry = [&](RowRef ref) {
+        return ResultView::Entry{chunks[ref.chunk].get(), nullptr, ref.row};
+    };
+
+    const auto& delta = view.delta();
+    if (delta.empty()) {
+        entries.reserve(rows.size());
+        for (RowRef ref : rows) {
+            entries.push_back(main_entry(ref));
+        }
+        result.versions_.push_back(std::move(view.version));
+        return result;
+    }
+
+    // Merge in late points of the range, main run first on ties
+    auto delta_it = std::lower_bound(delta.begin(), delta.end(), config.time_range.start_time,
+        [](const auto& row, int64_t ts) { return row->point.timestamp < ts; });
+    auto next_delta = [&]() {
+        for (; delta_it != delta.end() &&
+               (*delta_it)->point.timestamp <= config.time_range.end_time; ++delta_it) {
+            if (matches_tags((*delta_it)->series, config.filter_tags)) {
+                return true;
+            }
+        }
+        return false;
+    };
+    auto delta_first = [&](RowRef ref) {
+        const Chunk& chunk = *chunks[ref.chunk];
+        return ordered_before((*delta_it)->point.timestamp, (*delta_it)->key,
+                              chunk.timestamps[ref.row], chunk.keys[ref.row]);
+    };
+
+    size_t r = 0;
+    bool have_delta = next_delta();
+    while (entries.size() < limit && (r < rows.size() || have_delta)) {
+        if (have_delta && (r == rows.size() || delta_first(rows[r]))) {
+            entries.push_back({nullptr, delta_it->get(), 0});
+            ++delta_it;
+            have_delta = next_delta();
+        } else {
+            entries.push_back(main_entry(rows[r++]));
+        }
+    }
+
+    result.versions_.push_back(std::move(view.version));
+    return result;
+}
+
+std::vector<TimeSeriesData> TimeSeriesIndex::aggregate(const View& view,
+                                                       const QueryConfig& config) const {
+    const Chunks& chunks = view.chunks();
+    std::vector<Slice> slices = time_slices(view, config.time_range);
+    int64_t window = config.window_size;
+
+    const auto& delta = view.delta();
+    auto delta_it = std::lower_bound(delta.begin(), delta.end(), config.time_range.start_time,
+        [](const auto& row, int64_t ts) { return row->point.timestamp < ts; });
+    auto next_delta = [&]() {
+        for (; delta_it != delta.end() &&
+               (*delta_it)->point.timestamp <= config.time_range.end_time; ++delta_it) {
+            if (matches_tags((*delta_it)->series, config.filter_tags)) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    // Output tags of each group: filter_tags plus the group_by values
+    std::vector<Tags> group_tags = {config.filter_tags};
+    std::unordered_map<uint32_t, uint32_t> series_groups;
+    std::map<Tags, uint32_t> group_ids;
+    auto group_of = [&](uint32_t series) -> uint32_t {
+        if (config.group_by.empty()) {
+            return 0;
+        }
+        auto it = series_groups.find(series);
+        if (it != series_groups.end()) {
+            return it->second;
+        }
+        const Tags& tags = catalog_->tags(series);
+        Tags key;
+        for (const auto& tag : config.group_by) {
+            auto tag_it = tags.find(tag);
+            if (tag_it != tags.end()) {
+                key.insert(*tag_it);
+            }
+        }
+        auto [group_it, inserted] = group_ids.emplace(key, static_cast<uint32_t>(group_ids.size()));
+        if (inserted) {
+            Tags out = config.filter_tags;
+            out.insert(key.begin(), key.end());
+            group_tags.resize(group_ids.size());
+            group_tags[group_it->second] = std::move(out);
+        }
+        series_groups.emplace(series, group_it->second);
+        return group_it->second;
+    };
+
+    auto buckets = dispatch_aggregation(config.aggregation, [&](auto type) {
+        WindowedAggregator<decltype(type)::value> aggregator(window, config.time_range.start_time,
+                                                             config.quantile);
+        bool have_delta = next_delta();
+        auto add_delta = [&]() {
+            aggregator.add(group_of((*delta_it)->series), (*delta_it)->point.timestamp,
+                           (*delta_it)->point.as_double());
+            ++delta_it;
+            have_delta = next_delta();
+        };
+
+        if (config.filter_tags.empty() && config.group_by.empty() &&
+            !needs_sketches(config.aggregation)) {
+            // Runs of rows within one window and between late points are
+            // contiguous in the columns: scan them with the SIMD kernel
+            for (const Slice& slice : slices) {
+                const Chunk& chunk = *chunks[slice.chunk];
+                const int64_t* ts = chunk.timestamps.get();
+                const uint64_t* keys = chunk.keys.get();
+                size_t m = slice.lo;
+                while (m < slice.hi) {
+                    while (have_delta && ordered_before((*delta_it)->point.timestamp,
+                                                        (*delta_it)->key, ts[m], keys[m])) {
+                        add_delta();
+                    }
+                    int64_t window_start = aggregator.window_start(ts[m]);
+                    size_t last = slice.hi;
+                    if (window > 0 && window_start <= INT64_MAX - window) {
+                        last = std::lower_bound(ts + m, ts + last, window_start + window) - ts;
+                    }
+                    if (have_delta) {
+                        // Rows up to the next late point, which follows ties
+                        int64_t delta_ts = (*delta_it)->point.timestamp;
+                        uint64_t delta_key = (*delta_it)->key;
+                        size_t r = m + 1;
+                        while (r < last && !ordered_before(delta_ts, delta_key, ts[r], keys[r])) {
+                            if (ts[r] < delta_ts) {
+                                r = std::lower_bound(ts + r, ts + last, delta_ts) - ts;
+                            } else {
+                                ++r;
+                            }
+                        }
+                        last = r;
+                    }
+                    aggregator.add(0, column_kernels::summarize(ts + m, chunk.values.get() + m,
+                                                                last - m));
+                    m = last;
                 }
             }
+            while (have_delta) {
+                add_delta();
+            }
+            return aggregator.finish();
         }
-    } else {
-        // No tag filtering
-        for (size_t i = start_idx; i <= end_idx && i < data_.size(); ++i) {
-            results.push_back(data_[i]);
-            if (config.limit > 0 && 
-                results.size() >= static_cast<size_t>(config.limit)) {
-                break;
+
+        // Filtered or grouped: one pass over the selected rows in order
+        std::vector<RowRef> rows;
+        std::unordered_map<uint32_t, bool> memo;
+        for (const Slice& slice : slices) {
+            if (!config.filter_tags.empty()) {
+                filter_slice(view, slice, config.filter_tags, memo, rows, SIZE_MAX);
+                continue;
+            }
+            for (size_t r = slice.lo; r < slice.hi; ++r) {
+                rows.push_back({static_cast<uint32_t>(slice.chunk), static_cast<uint32_t>(r)});
             }
         }
+
+        for (size_t r = 0; r < rows.size() || have_delta; ) {
+            const Chunk* chunk = r < rows.size() ? chunks[rows[r].chunk].get() : nullptr;
+            uint32_t row = r < rows.size() ? rows[r].row : 0;
+            if (have_delta && (!chunk || ordered_before((*delta_it)->point.timestamp,
+                                                        (*delta_it)->key, chunk->timestamps[row],
+                                                        chunk->keys[row]))) {
+                add_delta();
+            } else {
+                aggregator.add(group_of(chunk->series[row]), chunk->timestamps[row],
+                               chunk->values[row]);
+                ++r;
+            }
+        }
+        return aggregator.finish();
+    });
+
+    size_t limit = config.limit > 0 ? static_cast<size_t>(config.limit) : SIZE_MAX;
+    std::vector<TimeSeriesData> results;
+    results.reserve(std::min(limit, buckets.size()));
+    for (const auto& bucket : buckets) {
+        if (results.size() >= limit) {
+            break;
+        }
+        results.emplace_back(bucket.window_start, bucket.value, group_tags[bucket.group]);
     }
-    
     return results;
 }
 
 TimeSeriesData TimeSeriesIndex::get(size_t index) const {
-    std::shared_lock<std::shared_mutex> lock(mutex_);
-    
-    if (index >= data_.size()) {
+    View view = snapshot();
+    const auto& delta = view.delta();
+
+    if (index >= view.main_rows() + delta.size()) {
         throw std::out_of_range("Index out of range");
     }
-    
-    return data_[index];
+
+    auto main_row = [&](size_t row) {
+        return resolve_main(*view.chunks()[row / kChunkRows], row % kChunkRows);
+    };
+
+    // Late point j sits after upper_bound(main, delta[j]) main rows
+    for (size_t j = 0; j < delta.size(); ++j) {
+        size_t main_before = main_upper_bound(view, *delta[j]);
+        if (main_before + j == index) {
+            return resolve(*delta[j]);
+        }
+        if (main_before + j > index) {
+            return main_row(index - j);
+        }
+    }
+    return main_row(index - delta.size());
 }
 
 size_t TimeSeriesIndex::size() const {
-    std::shared_lock<std::shared_mutex> lock(mutex_);
-    return data_.size();
+    View view = snapshot();
+    return view.main_rows() + view.delta().size();
 }
 
 bool TimeSeriesIndex::empty() const {
-    std::shared_lock<std::shared_mutex> lock(mutex_);
-    return data_.empty();
+    return size() == 0;
 }
 
 void TimeSeriesIndex::clear() {
-    std::unique_lock<std::shared_mutex> lock(mutex_);
-    data_.clear();
-    tag_index_.clear();
-    sorted_ = true;
-}
-
-void TimeSeriesIndex::ensure_sorted() {
-    std::unique_lock<std::shared_mutex> lock(mutex_);
-    
-    if (!sorted_) {
-        // Sort data by timestamp, then by key for deterministic ordering
-        // Use stable_sort to maintain relative order of equal elements
-        std::stable_sort(data_.begin(), data_.end(),
-                 [](const TimeSeriesData& a, const TimeSeriesData& b) {
-                     // Primary sort by timestamp
-                     if (a.timestamp != b.timestamp) {
-                         return a.timestamp < b.timestamp;
-                     }
-                     // Secondary sort by key for deterministic ordering
-                     uint64_t key_a = 0, key_b = 0;
-                     if (a.tags.find("key") != a.tags.end()) {
-                         try {
-                             key_a = std::stoull(a.tags.at("key"));
-                         } catch (...) {}
-                     }
-                     if (b.tags.find("key") != b.tags.end()) {
-                         try {
-                             key_b = std::stoull(b.tags.at("key"));
-                         } catch (...) {}
-                     }
-                     return key_a < key_b;
-                 });
-        
-        // Rebuild tag index
-        rebuild_tag_index();
-        sorted_ = true;
-    }
-}
-
-size_t TimeSeriesIndex::binary_search(int64_t timestamp, bool find_upper) const {
-    if (data_.empty()) {
-        return 0;
-    }
-    
-    if (find_upper) {
-        // Find the last element with timestamp <= target
-        // This is similar to upper_bound - 1
-        size_t left = 0;
-        size_t right = data_.size();
-        
-        while (left < right) {
-            size_t mid = left + (right - left) / 2;
-            if (data_[mid].timestamp <= timestamp) {
-                left = mid + 1;
-            } else {
-                right = mid;
-            }
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    publish(std::make_shared<const Version>(Version{std::make_shared<const Chunks>(), {}}));
+}
+
+void TimeSeriesIndex::merge_delta() {
+    const auto& delta = current_->delta;
+    if (delta.empty()) {
+        return;
+    }
+
+    const Chunks& chunks = *current_->chunks;
+    View view{current_, chunks.empty() ? 0 : chunks.back()->size.load(std::memory_order_relaxed)};
+    size_t total = view.main_rows();
+
+    // Chunks before the earliest late point are kept; the rest are
+    // rewritten, so readers of the old version are undisturbed
+    size_t first_chunk = main_upper_bound(view, *delta.front()) / kChunkRows;
+    auto next = std::make_shared<Chunks>(chunks.begin(), chunks.begin() + first_chunk);
+    size_t remaining = total - first_chunk * kChunkRows + delta.size();
+
+    std::shared_ptr<Chunk> out;
+    size_t out_rows = 0;
+    auto finish_chunk = [&]() {
+        out->size.store(out_rows, std::memory_order_relaxed);
+        if (out_rows == kChunkRows) {
+            seal(*out);
         }
-        
-        // left now points to the first element > timestamp
-        // We want the last element <= timestamp, so return left - 1
-        // But if all elements are > timestamp, return 0 (no valid range)
-        return (left > 0) ? (left - 1) : 0;
-    } else {
-        // Find the first element with timestamp >= target
-        // This is lower_bound
-        size_t left = 0;
-        size_t right = data_.size();
-        
-        while (left < right) {
-            size_t mid = left + (right - left) / 2;
-            if (data_[mid].timestamp < timestamp) {
-                left = mid + 1;
-            } else {
-                right = mid;
+        next->push_back(std::move(out));
+    };
+    // Free slots of the output chunk, starting the next one when it is full
+    auto room = [&]() {
+        if (!out || out_rows == kChunkRows) {
+            if (out) {
+                finish_chunk();
             }
+            size_t capacity = remaining >= kChunkRows
+                ? kChunkRows : std::max(kFirstChunkRows, std::bit_ceil(remaining));
+            out = std::make_shared<Chunk>(capacity, false);
+            out_rows = 0;
+        }
+        return out->capacity - out_rows;
+    };
+
+    // Main rows go before a late point they tie with
+    size_t i = first_chunk * kChunkRows, j = 0;
+    auto run_end = [&]() { return j < delta.size() ? main_upper_bound(view, *delta[j]) : total; };
+    size_t main_end = run_end();
+    while (i < total || j < delta.size()) {
+        size_t space = room();
+        if (i < main_end) {
+            // Main rows up to the next late point, copied a column run at a time
+            size_t n = std::min({main_end - i, kChunkRows - i % kChunkRows, space});
+            copy_rows(*out, out_rows, *chunks[i / kChunkRows], i % kChunkRows, n);
+            out_rows += n;
+            remaining -= n;
+            i += n;
+        } else {
+            Row row = *delta[j++];
+            put_row(*out, out_rows++, std::move(row));
+            --remaining;
+            main_end = run_end();
         }
-        
-        // left now points to the first element >= timestamp
-        return left;
     }
+    finish_chunk();
+
+    publish(std::make_shared<const Version>(Version{std::move(next), {}}));
 }
 
-std::vector<size_t> TimeSeriesIndex::filter_by_tags(const Tags& tags) const {
-    if (tags.empty()) {
-        return {};
+// ========== ResultView ==========
+
+int64_t TimeSeriesIndex::ResultView::Point::timestamp() const {
+    if (entry_->chunk) {
+        return entry_->chunk->timestamps[entry_->row];
     }
-    
-    std::vector<std::set<size_t>> matching_sets;
-    
-    for (const auto& [key, value] : tags) {
-        auto key_it = tag_index_.find(key);
-        if (key_it != tag_index_.end()) {
-            auto value_it = key_it->second.find(value);
-            if (value_it != key_it->second.end()) {
-                matching_sets.emplace_back(
-                    value_it->second.begin(), value_it->second.end());
-            } else {
-                // Tag value not found
-                return {};
-            }
+    if (entry_->late) {
+        return entry_->late->point.timestamp;
+    }
+    return view_->owned_[entry_->row].timestamp;
+}
+
+double TimeSeriesIndex::ResultView::Point::as_double() const {
+    if (entry_->chunk) {
+        return entry_->chunk->values[entry_->row];
+    }
+    if (entry_->late) {
+        return entry_->late->point.as_double();
+    }
+    return view_->owned_[entry_->row].as_double();
+}
+
+bool TimeSeriesIndex::ResultView::Point::is_vector() const {
+    if (entry_->chunk) {
+        const Extra* extra = entry_->chunk->extra(entry_->row);
+        return extra && extra->is_vector;
+    }
+    if (entry_->late) {
+        return entry_->late->point.is_array();
+    }
+    return view_->owned_[entry_->row].is_array();
+}
+
+std::span<const double> TimeSeriesIndex::ResultView::Point::values() const {
+    if (entry_->chunk) {
+        const Extra* extra = entry_->chunk->extra(entry_->row);
+        if (extra && extra->is_vector) {
+            return extra->vector_value;
+        }
+        return {&entry_->chunk->values[entry_->row], 1};
+    }
+    const TimeSeriesData& point = entry_->late ? entry_->late->point
+                                               : view_->owned_[entry_->row];
+    if (const auto* vector = std::get_if<std::vector<double>>(&point.value)) {
+        return *vector;
+    }
+    return {&std::get<double>(point.value), 1};
+}
+
+const Tags& TimeSeriesIndex::ResultView::Point::tags() const {
+    if (entry_->chunk) {
+        return view_->catalog_->tags(entry_->chunk->series[entry_->row]);
+    }
+    if (entry_->late) {
+        return view_->catalog_->tags(entry_->late->series);
+    }
+    return view_->owned_[entry_->row].tags;
+}
+
+const Fields& TimeSeriesIndex::ResultView::Point::fields() const {
+    static const Fields kNoFields;
+    if (entry_->chunk) {
+        const Extra* extra = entry_->chunk->extra(entry_->row);
+        return extra ? extra->fields : kNoFields;
+    }
+    if (entry_->late) {
+        return entry_->late->point.fields;
+    }
+    return view_->owned_[entry_->row].fields;
+}
+
+TimeSeriesData TimeSeriesIndex::ResultView::Point::to_data() const {
+    if (!entry_->chunk && !entry_->late) {
+        return view_->owned_[entry_->row];
+    }
+    TimeSeriesData data;
+    data.timestamp = timestamp();
+    if (is_vector()) {
+        auto elements = values();
+        data.value = std::vector<double>(elements.begin(), elements.end());
+    } else {
+        data.value = as_double();
+    }
+    data.tags = tags();
+    data.fields = fields();
+    return data;
+}
+
+TimeSeriesIndex::ResultView::ResultView(std::vector<TimeSeriesData> points)
+    : owned_(std::move(points)) {
+    entries_.reserve(owned_.size());
+    for (size_t i = 0; i < owned_.size(); ++i) {
+        entries_.push_back({nullptr, nullptr, static_cast<uint32_t>(i)});
+    }
+}
+
+void TimeSeriesIndex::ResultView::copy_columns(int64_t* timestamps, double* values) const {
+    for (size_t i = 0; i < entries_.size(); ++i) {
+        const Entry& entry = entries_[i];
+        if (entry.chunk) {
+            timestamps[i] = entry.chunk->timestamps[entry.row];
+            values[i] = entry.chunk->values[entry.row];
         } else {
-            // Tag key not found
-            return {};
+            Point point(this, &entry);
+            timestamps[i] = point.timestamp();
+            values[i] = point.as_double();
+        }
+    }
+}
+
+std::vector<TimeSeriesData> TimeSeriesIndex::ResultView::materialize() const {
+    std::vector<TimeSeriesData> points;
+    points.reserve(entries_.size());
+    for (const Entry& entry : entries_) {
+        points.push_back(Point(this, &entry).to_data());
+    }
+    return points;
+}
+
+TimeSeriesIndex::ResultView TimeSeriesIndex::ResultView::merge(std::vector<ResultView> views,
+                                                               size_t limit) {
+    ResultView merged;
+    size_t total = 0;
+    for (auto& view : views) {
+        total += view.size();
+        if (!merged.catalog_) {
+            merged.catalog_ = view.catalog_;
+        }
+        for (auto& version : view.versions_) {
+            merged.versions_.push_back(std::move(version));
         }
     }
-    
-    if (matching_sets.empty()) {
-        return {};
+
+    // Owned points move into the merged view; their entries are renumbered
+    std::vector<size_t> owned_base(views.size());
+    for (size_t i = 0; i < views.size(); ++i) {
+        owned_base[i] = merged.owned_.size();
+        std::move(views[i].owned_.begin(), views[i].owned_.end(),
+                  std::back_inserter(merged.owned_));
     }
-    
-    // Intersect all sets
-    std::set<size_t> result = matching_sets[0];
-    for (size_t i = 1; i < matching_sets.size(); ++i) {
-        std::set<size_t> intersection;
-        std::set_intersection(
-            result.begin(), result.end(),
-            matching_sets[i].begin(), matching_sets[i].end(),
-            std::inserter(intersection, intersection.begin()));
-        result = std::move(intersection);
+    auto timestamp = [&](size_t i, size_t pos) {
+        const Entry& entry = views[i].entries_[pos];
+        if (entry.chunk || entry.late) {
+            return Point(&views[i], &entry).timestamp();
+        }
+        return merged.owned_[owned_base[i] + entry.row].timestamp;
+    };
+
+    merged.entries_.reserve(std::min(total, limit));
+    std::vector<size_t> pos(views.size(), 0);
+    while (merged.entries_.size() < limit) {
+        size_t best = views.size();
+        int64_t best_ts = 0;
+        for (size_t i = 0; i < views.size(); ++i) {
+            if (pos[i] < views[i].size()) {
+                int64_t ts = timestamp(i, pos[i]);
+                if (best == views.size() || ts < best_ts) {
+                    best = i;
+                    best_ts = ts;
+                }
+            }
+        }
+        if (best == views.size()) {
+            break;
+        }
+        Entry entry = views[best].entries_[pos[best]++];
+        if (!entry.chunk && !entry.late) {
+            entry.row = static_cast<uint32_t>(owned_base[best] + entry.row);
+        }
+        merged.entries_.push_back(entry);
     }
-    
-    return std::vector<size_t>(result.begin(), result.end());
+    return merged;
 }
 
-void TimeSeriesIndex::rebuild_tag_index() {
-    tag_index_.clear();
-    
-    for (size_t idx = 0; idx < data_.size(); ++idx) {
-        for (const auto& [key, value] : data_[idx].tags) {
-            tag_index_[key][value].push_back(idx);
+bool TimeSeriesIndex::matches_tags(uint32_t series, const Tags& tags) const {
+    if (tags.empty()) {
+        return true;
+    }
+    const Tags& row_tags = catalog_->tags(series);
+    for (const auto& [key, value] : tags) {
+        auto it = row_tags.find(key);
+        if (it == row_tags.end() || it->second != value) {
+            return false;
         }
     }
+    return true;
 }
 
 } // namespace sage_tsdb
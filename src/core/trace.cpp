@@ -0,0 +1,204 @@
+#include "sage_tsdb/core/trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <unordered_map>
+
+namespace sage_tsdb {
+
+namespace {
+
+void write_json_string(std::ostream& out, const char* text) {
+    out << '"';
+    for (const char* p = text; *p; ++p) {
+        unsigned char c = static_cast<unsigned char>(*p);
+        if (c == '"' || c == '\\') {
+            out << '\\' << *p;
+        } else if (c < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out << escaped;
+        } else {
+            out << *p;
+        }
+    }
+    out << '"';
+}
+
+// Chrome traces count microseconds; keep the nanoseconds as decimals
+void write_micros(std::ostream& out, int64_t ns) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.3f", static_cast<double>(ns) / 1000.0);
+    out << buffer;
+}
+
+} // anonymous namespace
+
+/**
+ * @brief Owns the calling thread's ring reference; marks it exited when the
+ * thread ends, so clear() can let it go
+ */
+struct Tracer::ThreadHandle {
+    std::shared_ptr<ThreadBuffer> buffer;
+
+    ~ThreadHandle() {
+        if (buffer) {
+            buffer->exited.store(true, std::memory_order_release);
+        }
+    }
+};
+
+Tracer& Tracer::instance() {
+    static Tracer tracer;
+    return tracer;
+}
+
+int64_t Tracer::nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Tracer::setBufferEvents(size_t events) {
+    buffer_events_.store(std::max<size_t>(events, 1), std::memory_order_relaxed);
+}
+
+Tracer::ThreadBuffer* Tracer::local() {
+    thread_local ThreadHandle handle;
+    if (!handle.buffer) {
+        auto buffer = std::make_shared<ThreadBuffer>(buffer_events_.load(std::memory_order_relaxed));
+        std::lock_guard<std::mutex> lock(mutex_);
+        buffer->tid = next_tid_++;
+        buffers_.push_back(buffer);
+        handle.buffer = std::move(buffer);
+    }
+    return handle.buffer.get();
+}
+
+void Tracer::setThreadName(const std::string& name) {
+    ThreadBuffer* buffer = local();
+    std::lock_guard<std::mutex> lock(mutex_);
+    buffer->thread_name = name;
+}
+
+void Tracer::record(const char* category, const char* name, int64_t start_ns, int64_t end_ns,
+                    const char* arg_name, uint64_t arg) {
+    ThreadBuffer* buffer = local();
+    uint64_t head = buffer->head.load(std::memory_order_relaxed);
+    Slot& slot = buffer->slots[head % buffer->slots.size()];
+    slot.category.store(category, std::memory_order_relaxed);
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.arg_name.store(arg_name, std::memory_order_relaxed);
+    slot.start_ns.store(start_ns, std::memory_order_relaxed);
+    slot.duration_ns.store(end_ns - start_ns, std::memory_order_relaxed);
+    slot.arg.store(arg, std::memory_order_relaxed);
+    buffer->head.store(head + 1, std::memory_order_release);
+}
+
+std::vector<TraceEvent> Tracer::collect() const {
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        buffers = buffers_;
+    }
+
+    std::vector<TraceEvent> events;
+    for (const auto& buffer : buffers) {
+        const uint64_t size = buffer->slots.size();
+        uint64_t head = buffer->head.load(std::memory_order_acquire);
+        uint64_t first = std::max(head > size ? head - size : 0,
+                                  buffer->cleared.load(std::memory_order_relaxed));
+        size_t begin = events.size();
+        for (uint64_t i = first; i < head; ++i) {
+            const Slot& slot = buffer->slots[i % size];
+            TraceEvent event;
+            event.category = slot.category.load(std::memory_order_relaxed);
+            event.name = slot.name.load(std::memory_order_relaxed);
+            event.arg_name = slot.arg_name.load(std::memory_order_relaxed);
+            event.start_ns = slot.start_ns.load(std::memory_order_relaxed);
+            event.duration_ns = slot.duration_ns.load(std::memory_order_relaxed);
+            event.arg = slot.arg.load(std::memory_order_relaxed);
+            event.tid = buffer->tid;
+            events.push_back(event);
+        }
+        // Slots below the new head - size were rewritten while copying
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t now = buffer->head.load(std::memory_order_relaxed);
+        if (now > first + size) {
+            size_t torn = std::min<uint64_t>(now - size - first, head - first);
+            events.erase(events.begin() + static_cast<std::ptrdiff_t>(begin),
+                         events.begin() + static_cast<std::ptrdiff_t>(begin + torn));
+        }
+    }
+    std::sort(events.begin(), events.end(), [](const TraceEvent& a, const TraceEvent& b) {
+        return a.start_ns < b.start_ns;
+    });
+    return events;
+}
+
+void Tracer::writeChromeTrace(std::ostream& out) const {
+    std::vector<TraceEvent> events = collect();
+    std::unordered_map<uint32_t, std::string> names;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& buffer : buffers_) {
+            names[buffer->tid] = buffer->thread_name.empty()
+                                     ? "thread " + std::to_string(buffer->tid)
+                                     : buffer->thread_name;
+        }
+    }
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    for (const auto& [tid, name] : names) {
+        out << (first ? "\n" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+            << tid << ",\"args\":{\"name\":";
+        write_json_string(out, name.c_str());
+        out << "}}";
+        first = false;
+    }
+    for (const TraceEvent& event : events) {
+        out << (first ? "\n" : ",\n") << "{\"name\":";
+        write_json_string(out, event.name);
+        out << ",\"cat\":";
+        write_json_string(out, event.category);
+        out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.tid << ",\"ts\":";
+        write_micros(out, event.start_ns);
+        out << ",\"dur\":";
+        write_micros(out, event.duration_ns);
+        if (event.arg_name) {
+            out << ",\"args\":{";
+            write_json_string(out, event.arg_name);
+            out << ':' << event.arg << '}';
+        }
+        out << '}';
+        first = false;
+    }
+    out << "\n]}\n";
+}
+
+bool Tracer::writeChromeTrace(const std::string& path) const {
+    std::ofstream out(path);
+    if (!out) {
+        return false;
+    }
+    writeChromeTrace(out);
+    return static_cast<bool>(out);
+}
+
+void Tracer::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    buffers_.erase(std::remove_if(buffers_.begin(), buffers_.end(),
+                                  [](const std::shared_ptr<ThreadBuffer>& buffer) {
+                                      return buffer->exited.load(std::memory_order_acquire);
+                                  }),
+                   buffers_.end());
+    // Only the owner moves head, so hide the spans below it instead
+    for (const auto& buffer : buffers_) {
+        buffer->cleared.store(buffer->head.load(std::memory_order_acquire),
+                              std::memory_order_relaxed);
+    }
+}
+
+} // namespace sage_tsdb
@@ -0,0 +1,539 @@
+#include "sage_tsdb/core/work_stealing_executor.h"
+#include "sage_tsdb/core/numa_topology.h"
+#include <algorithm>
+#include <cmath>
+
+namespace sage_tsdb {
+namespace core {
+
+namespace {
+
+constexpr size_t kMaxFreeNodes = 256;  // Per worker
+
+using Clock = std::chrono::steady_clock;
+
+}  // namespace
+
+// A task queued in a worker deque; the queue reference keeps a closed
+// queue alive until its remaining nodes are discarded
+struct WorkStealingExecutor::Node {
+    Task task;
+    std::shared_ptr<TaskQueue> queue;
+    Node* next = nullptr;  // Free list link
+};
+
+struct WorkStealingExecutor::Worker {
+    Worker(size_t index, int node, std::vector<int> cpus, size_t deque_capacity)
+        : index(index), node(node), cpus(std::move(cpus)), deque(deque_capacity) {}
+
+    size_t index;
+    int node;               // -1 = unbound
+    std::vector<int> cpus;  // Affinity; empty = unpinned
+    WorkStealingDeque<Node> deque;
+    std::thread thread;
+
+    // Touched only by the worker thread
+    Node* free_list = nullptr;
+    size_t free_count = 0;
+    size_t cursor = 0;  // Round-robin position within a priority
+
+    Node* acquire_node() {
+        if (free_list == nullptr) {
+            return new Node;
+        }
+        Node* node = free_list;
+        free_list = node->next;
+        --free_count;
+        return node;
+    }
+
+    void recycle(Node* node) {
+        node->task.reset();
+        node->queue.reset();
+        if (free_count >= kMaxFreeNodes) {
+            delete node;
+            return;
+        }
+        node->next = free_list;
+        free_list = node;
+        ++free_count;
+    }
+};
+
+namespace {
+
+thread_local WorkStealingExecutor* tls_executor = nullptr;
+thread_local void* tls_worker = nullptr;
+
+}  // namespace
+
+// ========== TaskQueue ==========
+
+bool TaskQueue::try_acquire_slot() {
+    int running = running_.load(std::memory_order_relaxed);
+    while (running < quota_.load(std::memory_order_relaxed)) {
+        if (running_.compare_exchange_weak(running, running + 1, std::memory_order_acq_rel,
+                                           std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void TaskQueue::release_slot() {
+    running_.fetch_sub(1, std::memory_order_release);
+}
+
+void TaskQueue::refill_cpu(Clock::time_point now) {
+    double limit = cpu_limit_.load(std::memory_order_relaxed);
+    if (limit > 0) {
+        double burst = limit * std::chrono::duration<double, std::nano>(kCpuBurst).count();
+        double elapsed = std::chrono::duration<double, std::nano>(now - refilled_at_).count();
+        tokens_ns_ = std::min(burst, tokens_ns_ + limit * elapsed);
+    }
+    refilled_at_ = now;
+}
+
+bool TaskQueue::has_cpu_budget() {
+    double limit = cpu_limit_.load(std::memory_order_relaxed);
+    if (limit < 0) {
+        return true;
+    }
+    if (limit == 0) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(bucket_mutex_);
+    refill_cpu(Clock::now());
+    return tokens_ns_ > 0;
+}
+
+void TaskQueue::charge_cpu(int64_t ns) {
+    busy_ns_.fetch_add(static_cast<uint64_t>(ns), std::memory_order_relaxed);
+    if (cpu_limit_.load(std::memory_order_relaxed) < 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(bucket_mutex_);
+    tokens_ns_ -= static_cast<double>(ns);
+}
+
+Clock::time_point TaskQueue::cpu_budget_at() {
+    double limit = cpu_limit_.load(std::memory_order_relaxed);
+    if (limit < 0) {
+        return Clock::now();
+    }
+    if (limit == 0) {
+        return Clock::time_point::max();
+    }
+    std::lock_guard<std::mutex> lock(bucket_mutex_);
+    refill_cpu(Clock::now());
+    if (tokens_ns_ > 0) {
+        return refilled_at_;
+    }
+    return refilled_at_ + std::chrono::nanoseconds(static_cast<int64_t>(
+        std::ceil(-tokens_ns_ / limit)) + 1);
+}
+
+bool TaskQueue::push(Task&& task) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!is_open()) {
+        return false;
+    }
+    if (count_ == ring_.size()) {
+        std::vector<Task> grown(std::max<size_t>(16, ring_.size() * 2));
+        for (size_t i = 0; i < count_; ++i) {
+            grown[i] = std::move(ring_[(head_ + i) % ring_.size()]);
+        }
+        ring_ = std::move(grown);
+        head_ = 0;
+    }
+    ring_[(head_ + count_) % ring_.size()] = std::move(task);
+    ++count_;
+    queued_.fetch_add(1, std::memory_order_seq_cst);
+    return true;
+}
+
+bool TaskQueue::pop(Task& task) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (count_ == 0) {
+        return false;
+    }
+    task = std::move(ring_[head_]);
+    head_ = (head_ + 1) % ring_.size();
+    --count_;
+    queued_.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+}
+
+// ========== WorkStealingExecutor ==========
+
+WorkStealingExecutor::WorkStealingExecutor(size_t workers, size_t deque_capacity)
+    : deque_capacity_(deque_capacity),
+      worker_snapshot_(std::make_shared<const WorkerList>()),
+      queue_snapshot_(std::make_shared<const QueueList>()) {
+    ensure_workers(workers);
+}
+
+WorkStealingExecutor::~WorkStealingExecutor() {
+    stop();
+}
+
+std::shared_ptr<TaskQueue> WorkStealingExecutor::create_queue(int priority, int quota, int node) {
+    std::shared_ptr<TaskQueue> queue(new TaskQueue(priority, std::max(quota, 1), node));
+    std::lock_guard<std::mutex> lock(mutex_);
+    queues_.push_back(queue);
+    publish_queues();
+    return queue;
+}
+
+void WorkStealingExecutor::close_queue(TaskQueue& queue) {
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex_);
+        queue.open_.store(false, std::memory_order_release);
+        for (size_t i = 0; i < queue.count_; ++i) {
+            queue.ring_[(queue.head_ + i) % queue.ring_.size()].reset();
+        }
+        queue.pending_.fetch_sub(queue.count_, std::memory_order_relaxed);
+        queue.queued_.store(0, std::memory_order_relaxed);
+        queue.head_ = 0;
+        queue.count_ = 0;
+    }
+    // Tasks still in worker deques are discarded when they are popped
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    queues_.erase(std::remove_if(queues_.begin(), queues_.end(),
+                                 [&](const auto& q) { return q.get() == &queue; }),
+                  queues_.end());
+    publish_queues();
+}
+
+void WorkStealingExecutor::set_quota(TaskQueue& queue, int quota) {
+    queue.quota_.store(std::max(quota, 1), std::memory_order_relaxed);
+    // Queued tasks may now be runnable
+    std::lock_guard<std::mutex> lock(park_mutex_);
+    park_cv_.notify_all();
+}
+
+void WorkStealingExecutor::set_cpu_limit(TaskQueue& queue, double workers) {
+    {
+        std::lock_guard<std::mutex> lock(queue.bucket_mutex_);
+        auto now = Clock::now();
+        double previous = queue.cpu_limit_.load(std::memory_order_relaxed);
+        queue.refill_cpu(now);
+        queue.cpu_limit_.store(workers, std::memory_order_relaxed);
+        if (workers > 0 && previous <= 0) {
+            // Start with a full bucket
+            queue.tokens_ns_ =
+                workers * std::chrono::duration<double, std::nano>(TaskQueue::kCpuBurst).count();
+        }
+    }
+    // Throttled tasks may now be runnable
+    std::lock_guard<std::mutex> lock(park_mutex_);
+    park_cv_.notify_all();
+}
+
+bool WorkStealingExecutor::should_yield(TaskQueue& queue) const {
+    for (const auto& other : *queue_snapshot_.load()) {
+        if (other.get() != &queue && other->node() == queue.node() &&
+            other->priority() > queue.priority() && other->pending() > 0 &&
+            other->has_cpu_budget()) {
+            queue.yields_.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingExecutor::set_priority(TaskQueue& queue, int priority) {
+    queue.priority_.store(priority, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(mutex_);
+    publish_queues();
+}
+
+void WorkStealingExecutor::publish_queues() {
+    auto list = std::make_shared<QueueList>(queues_);
+    std::stable_sort(list->begin(), list->end(), [](const auto& a, const auto& b) {
+        return a->priority() > b->priority();
+    });
+    queue_snapshot_.store(std::move(list));
+}
+
+bool WorkStealingExecutor::submit(const std::shared_ptr<TaskQueue>& queue, Task task) {
+    if (stopping_.load(std::memory_order_relaxed) || !queue->is_open()) {
+        return false;
+    }
+    queue->pending_.fetch_add(1, std::memory_order_relaxed);
+
+    // From one of our workers of the queue's node: push to its own deque,
+    // where it is found first by this worker and can be stolen by the others
+    if (tls_executor == this && static_cast<Worker*>(tls_worker)->node == queue->node()) {
+        auto& worker = *static_cast<Worker*>(tls_worker);
+        Node* node = worker.acquire_node();
+        node->task = std::move(task);
+        node->queue = queue;
+        if (worker.deque.push(node)) {
+            wake_one();
+            return true;
+        }
+        task = std::move(node->task);
+        worker.recycle(node);
+    }
+
+    if (!queue->push(std::move(task))) {
+        queue->pending_.fetch_sub(1, std::memory_order_relaxed);
+        return false;
+    }
+    wake_one();
+    return true;
+}
+
+void WorkStealingExecutor::wake_one() {
+    // Pairs with the fence in run(): either the parking worker sees the new
+    // task or this thread sees the parking worker
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleeping_.load(std::memory_order_relaxed) > 0) {
+        std::lock_guard<std::mutex> lock(park_mutex_);
+        // A worker of another node would park again and lose the wakeup
+        if (node_workers_.load(std::memory_order_relaxed)) {
+            park_cv_.notify_all();
+        } else {
+            park_cv_.notify_one();
+        }
+    }
+}
+
+void WorkStealingExecutor::ensure_workers(size_t count, int node, const std::vector<int>& cpus) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t existing = static_cast<size_t>(std::count_if(
+        workers_.begin(), workers_.end(), [node](const auto& w) { return w->node == node; }));
+    if (stopping_.load() || existing >= count) {
+        return;
+    }
+    if (node >= 0) {
+        node_workers_.store(true, std::memory_order_relaxed);
+    }
+    size_t first = workers_.size();
+    for (; existing < count; ++existing) {
+        workers_.push_back(std::make_unique<Worker>(workers_.size(), node, cpus, deque_capacity_));
+    }
+
+    auto list = std::make_shared<WorkerList>();
+    for (const auto& worker : workers_) {
+        list->push_back(worker.get());
+    }
+    worker_snapshot_.store(std::move(list));
+
+    for (size_t i = first; i < workers_.size(); ++i) {
+        Worker* worker = workers_[i].get();
+        worker->thread = std::thread([this, worker]() { run(*worker); });
+    }
+}
+
+size_t WorkStealingExecutor::worker_count() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return workers_.size();
+}
+
+size_t WorkStealingExecutor::worker_count(int node) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return static_cast<size_t>(std::count_if(
+        workers_.begin(), workers_.end(), [node](const auto& w) { return w->node == node; }));
+}
+
+void WorkStealingExecutor::stop() {
+    if (stopping_.exchange(true)) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(park_mutex_);
+        park_cv_.notify_all();
+    }
+
+    // No workers are added once stopping_ is set; taking mutex_ once waits
+    // out an ensure_workers() already past that check. Join without it so a
+    // finishing task may still close or reconfigure its queue
+    std::shared_ptr<const WorkerList> workers;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        workers = worker_snapshot_.load();
+    }
+    for (Worker* worker : *workers) {
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+        drain(*worker);
+    }
+
+    std::vector<std::shared_ptr<TaskQueue>> queues;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queues = queues_;
+    }
+    for (auto& queue : queues) {
+        close_queue(*queue);
+    }
+}
+
+void WorkStealingExecutor::drain(Worker& worker) {
+    while (Node* node = worker.deque.pop()) {
+        node->queue->pending_.fetch_sub(1, std::memory_order_relaxed);
+        delete node;
+    }
+    while (Node* node = worker.free_list) {
+        worker.free_list = node->next;
+        delete node;
+    }
+    worker.free_count = 0;
+}
+
+void WorkStealingExecutor::run(Worker& worker) {
+    tls_executor = this;
+    tls_worker = &worker;
+    if (!worker.cpus.empty()) {
+        pin_current_thread(worker.cpus);
+    }
+
+    while (!stopping_.load(std::memory_order_relaxed)) {
+        if (run_one(worker)) {
+            continue;
+        }
+        // Throttled queues get no wakeup when their buckets refill
+        Clock::time_point refill = next_refill(worker);
+        std::unique_lock<std::mutex> lock(park_mutex_);
+        sleeping_.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto ready = [&]() { return stopping_.load() || has_work(worker); };
+        if (refill == Clock::time_point::max()) {
+            park_cv_.wait(lock, ready);
+        } else {
+            park_cv_.wait_until(lock, refill, ready);
+        }
+        sleeping_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    tls_executor = nullptr;
+    tls_worker = nullptr;
+}
+
+bool WorkStealingExecutor::run_one(Worker& worker) {
+    // 1. Own deque, newest first
+    if (Node* node = worker.deque.pop()) {
+        return run_node(worker, node);
+    }
+
+    // 2. Submission rings, highest priority first; rotate within a priority
+    // so queues of equal priority share the workers
+    auto queues = queue_snapshot_.load();
+    size_t rotation = worker.cursor++;
+    for (size_t begin = 0; begin < queues->size();) {
+        size_t end = begin + 1;
+        while (end < queues->size() && (*queues)[end]->priority() == (*queues)[begin]->priority()) {
+            ++end;
+        }
+        size_t group = end - begin;
+        for (size_t k = 0; k < group; ++k) {
+            TaskQueue& queue = *(*queues)[begin + (rotation + k) % group];
+            if (queue.node() != worker.node ||
+                queue.queued_.load(std::memory_order_relaxed) == 0) {
+                continue;
+            }
+            if (!queue.has_cpu_budget()) {
+                queue.throttled_.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            if (!queue.try_acquire_slot()) {
+                continue;
+            }
+            Task task;
+            if (queue.pop(task)) {
+                queue.pending_.fetch_sub(1, std::memory_order_relaxed);
+                execute(queue, task);
+                return true;
+            }
+            queue.release_slot();
+        }
+        begin = end;
+    }
+
+    // 3. Steal the oldest task of another worker of this node
+    auto workers = worker_snapshot_.load();
+    for (size_t k = 1; k < workers->size(); ++k) {
+        Worker* victim = (*workers)[(worker.index + k) % workers->size()];
+        if (victim->node != worker.node) {
+            continue;
+        }
+        if (Node* node = victim->deque.steal()) {
+            steals_.fetch_add(1, std::memory_order_relaxed);
+            return run_node(worker, node);
+        }
+    }
+    return false;
+}
+
+bool WorkStealingExecutor::run_node(Worker& worker, Node* node) {
+    std::shared_ptr<TaskQueue> queue = std::move(node->queue);
+    Task task = std::move(node->task);
+    worker.recycle(node);
+
+    if (!queue->is_open()) {
+        queue->pending_.fetch_sub(1, std::memory_order_relaxed);  // Dropped with its queue
+        return true;
+    }
+    bool budget = queue->node() == worker.node && queue->has_cpu_budget();
+    if (queue->node() == worker.node && !budget) {
+        queue->throttled_.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (!budget || !queue->try_acquire_slot()) {
+        // At quota, out of budget or for another node: park it in the
+        // queue's ring, which is gated and served by the queue's node
+        if (!queue->push(std::move(task))) {
+            queue->pending_.fetch_sub(1, std::memory_order_relaxed);
+        }
+        return true;
+    }
+    queue->pending_.fetch_sub(1, std::memory_order_relaxed);
+    execute(*queue, task);
+    return true;
+}
+
+void WorkStealingExecutor::execute(TaskQueue& queue, Task& task) {
+    auto start = Clock::now();
+    try {
+        task();
+    } catch (...) {
+        // A failing task must not take the worker down
+    }
+    task.reset();
+    queue.charge_cpu(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start)
+                         .count());
+    queue.release_slot();
+}
+
+bool WorkStealingExecutor::has_work(const Worker& worker) const {
+    for (const auto& queue : *queue_snapshot_.load()) {
+        if (queue->node() == worker.node && queue->queued_.load(std::memory_order_relaxed) > 0 &&
+            queue->running_.load(std::memory_order_relaxed) < queue->quota() &&
+            queue->has_cpu_budget()) {
+            return true;
+        }
+    }
+    for (const Worker* other : *worker_snapshot_.load()) {
+        if (other->node == worker.node && !other->deque.empty()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+Clock::time_point WorkStealingExecutor::next_refill(const Worker& worker) const {
+    Clock::time_point earliest = Clock::time_point::max();
+    for (const auto& queue : *queue_snapshot_.load()) {
+        if (queue->node() == worker.node && queue->cpu_limit() > 0 &&
+            queue->queued_.load(std::memory_order_relaxed) > 0) {
+            earliest = std::min(earliest, queue->cpu_budget_at());
+        }
+    }
+    return earliest;
+}
+
+}  // namespace core
+}  // namespace sage_tsdb
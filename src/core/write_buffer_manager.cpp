@@ -0,0 +1,132 @@
+#include "sage_tsdb/core/write_buffer_manager.h"
+#include <algorithm>
+#include <vector>
+
+namespace sage_tsdb {
+
+WriteBufferManager::WriteBufferManager(size_t buffer_size, double soft_limit_ratio,
+                                       FlushPolicy policy)
+    : buffer_size_(buffer_size),
+      soft_limit_ratio_(std::clamp(soft_limit_ratio, 0.0, 1.0)),
+      policy_(policy) {}
+
+uint64_t WriteBufferManager::add_client(Client client) {
+    std::lock_guard<std::mutex> lock(clients_mutex_);
+    uint64_t id = next_client_id_++;
+    clients_.emplace(id, std::move(client));
+    return id;
+}
+
+void WriteBufferManager::remove_client(uint64_t id) {
+    std::lock_guard<std::mutex> lock(clients_mutex_);
+    clients_.erase(id);
+}
+
+size_t WriteBufferManager::get_client_count() const {
+    std::lock_guard<std::mutex> lock(clients_mutex_);
+    return clients_.size();
+}
+
+void WriteBufferManager::reserve(size_t bytes) {
+    memory_used_.fetch_add(bytes, std::memory_order_relaxed);
+    mutable_used_.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void WriteBufferManager::schedule_free(size_t bytes) {
+    mutable_used_.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+void WriteBufferManager::free(size_t bytes) {
+    memory_used_.fetch_sub(bytes, std::memory_order_relaxed);
+    notify_stalled();
+}
+
+size_t WriteBufferManager::get_soft_limit() const {
+    return static_cast<size_t>(get_buffer_size() * soft_limit_ratio_);
+}
+
+void WriteBufferManager::set_buffer_size(size_t buffer_size) {
+    buffer_size_.store(buffer_size, std::memory_order_relaxed);
+    notify_stalled();  // A larger (or disabled) budget may unblock writers
+}
+
+bool WriteBufferManager::should_flush() const {
+    return get_buffer_size() > 0 && get_mutable_memory_usage() >= get_soft_limit();
+}
+
+bool WriteBufferManager::is_under_pressure() const {
+    return get_buffer_size() > 0 && get_memory_usage() >= get_soft_limit();
+}
+
+bool WriteBufferManager::has_room() const {
+    size_t limit = get_buffer_size();
+    return limit == 0 || get_memory_usage() < limit;
+}
+
+bool WriteBufferManager::flush_one() {
+    std::lock_guard<std::mutex> lock(clients_mutex_);
+
+    // Rank once, then fall through to the next candidate if a client
+    // declines (its flush queue is full, or it emptied meanwhile)
+    struct Candidate {
+        const Client* client;
+        size_t bytes;
+        Clock::time_point since;
+    };
+    std::vector<Candidate> candidates;
+    candidates.reserve(clients_.size());
+    for (const auto& [id, client] : clients_) {
+        size_t bytes = client.mutable_bytes();
+        if (bytes > 0) {
+            candidates.push_back({&client, bytes, client.mutable_since()});
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(),
+              [this](const Candidate& a, const Candidate& b) {
+                  if (policy_ == FlushPolicy::Oldest && a.since != b.since) {
+                      return a.since < b.since;
+                  }
+                  return a.bytes > b.bytes;
+              });
+
+    for (const auto& candidate : candidates) {
+        if (candidate.client->request_flush()) {
+            flush_requests_.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+void WriteBufferManager::wait_for_room() {
+    if (has_room()) {
+        return;
+    }
+
+    auto started = Clock::now();
+    stall_count_.fetch_add(1, std::memory_order_relaxed);
+
+    std::unique_lock<std::mutex> lock(stall_mutex_);
+    while (!has_room()) {
+        // Make sure something is draining: the usage may be entirely in
+        // active memtables that never reached their own flush threshold
+        lock.unlock();
+        flush_one();
+        lock.lock();
+        stall_cv_.wait_for(lock, std::chrono::milliseconds(10),
+                           [this]() { return has_room(); });
+    }
+    lock.unlock();
+
+    total_stall_micros_.fetch_add(
+        std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - started).count(),
+        std::memory_order_relaxed);
+}
+
+void WriteBufferManager::notify_stalled() {
+    // Lock once so a writer between its check and wait cannot miss this
+    { std::lock_guard<std::mutex> lock(stall_mutex_); }
+    stall_cv_.notify_all();
+}
+
+} // namespace sage_tsdb
@@ -1,9 +1,11 @@
 #include "sage_tsdb/plugins/adapters/fault_detection_adapter.h"
 #include "sage_tsdb/plugins/plugin_registry.h"
+#include "sage_tsdb/core/simd.h"
 #include <chrono>
 #include <cmath>
 #include <iostream>
 #include <algorithm>
+#include <sstream>
 
 // Stub: Include PECJ's VAE model if using shared models
 // #include "Common/LinearVAE.h"
@@ -11,6 +13,79 @@
 namespace sage_tsdb {
 namespace plugins {
 
+namespace {
+
+constexpr uint64_t MIN_SAMPLES = 10;  // Per series, before scoring
+
+/**
+ * @brief std_devs = sqrt(variances), scores = |values - means| / std_devs
+ *
+ * sqrt and division are correctly rounded in every lane, so the vector
+ * paths (picked by simd::active()) give the same scores as the scalar one.
+ * Each vector kernel handles full lane batches and returns where the
+ * scalar tail starts.
+ */
+#if defined(SAGE_TSDB_SIMD_DISPATCH)
+SAGE_TSDB_TARGET("avx512f")
+size_t zscores_avx512(const double* values, const double* means, const double* variances,
+                      double* std_devs, double* scores, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m512d sd = _mm512_sqrt_pd(_mm512_loadu_pd(variances + i));
+        __m512d diff = _mm512_sub_pd(_mm512_loadu_pd(values + i), _mm512_loadu_pd(means + i));
+        _mm512_storeu_pd(std_devs + i, sd);
+        _mm512_storeu_pd(scores + i, _mm512_div_pd(_mm512_abs_pd(diff), sd));
+    }
+    return i;
+}
+
+SAGE_TSDB_TARGET("avx2")
+size_t zscores_avx2(const double* values, const double* means, const double* variances,
+                    double* std_devs, double* scores, size_t count) {
+    const __m256d sign = _mm256_set1_pd(-0.0);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256d sd = _mm256_sqrt_pd(_mm256_loadu_pd(variances + i));
+        __m256d diff = _mm256_sub_pd(_mm256_loadu_pd(values + i), _mm256_loadu_pd(means + i));
+        _mm256_storeu_pd(std_devs + i, sd);
+        _mm256_storeu_pd(scores + i, _mm256_div_pd(_mm256_andnot_pd(sign, diff), sd));
+    }
+    return i;
+}
+#endif
+
+void zscores(const double* values, const double* means, const double* variances,
+             double* std_devs, double* scores, size_t count) {
+    size_t i = 0;
+    switch (simd::active()) {
+#if defined(SAGE_TSDB_SIMD_DISPATCH)
+        case simd::Level::AVX512:
+            i = zscores_avx512(values, means, variances, std_devs, scores, count);
+            break;
+        case simd::Level::AVX2:
+            i = zscores_avx2(values, means, variances, std_devs, scores, count);
+            break;
+#endif
+        default: break;
+    }
+    for (; i < count; ++i) {
+        std_devs[i] = std::sqrt(variances[i]);
+        scores[i] = std::abs(values[i] - means[i]) / std_devs[i];
+    }
+}
+
+} // anonymous namespace
+
+void FaultDetectionAdapter::ScoreBatch::resize(size_t n) {
+    series.resize(n);
+    values.resize(n);
+    means.resize(n);
+    variances.resize(n);
+    std_devs.resize(n);
+    scores.resize(n);
+    counts.resize(n);
+}
+
 FaultDetectionAdapter::FaultDetectionAdapter(const PluginConfig& config)
     : config_(config),
       detection_method_(DetectionMethod::HYBRID),
@@ -67,6 +142,17 @@ bool FaultDetectionAdapter::initialize(const PluginConfig& config) {
         max_history_size_ = std::stoull(config_.at("max_history"));
     }
     
+    // Parse the tags that identify a series
+    if (config_.find("series_tags") != config_.end()) {
+        std::istringstream tags(config_.at("series_tags"));
+        std::string tag;
+        while (std::getline(tags, tag, ',')) {
+            if (!tag.empty()) {
+                series_tags_.push_back(tag);
+            }
+        }
+    }
+    
     // Initialize ML model if needed
     if (detection_method_ == DetectionMethod::VAE || 
         detection_method_ == DetectionMethod::HYBRID) {
@@ -102,91 +188,165 @@ bool FaultDetectionAdapter::initializeModel() {
 }
 
 void FaultDetectionAdapter::feedData(const TimeSeriesData& data) {
-    if (!initialized_ || !running_) {
+    feedBatch(std::span<const TimeSeriesData>(&data, 1));
+}
+
+void FaultDetectionAdapter::feedBatch(std::span<const TimeSeriesData> batch) {
+    if (!initialized_ || !running_ || batch.empty()) {
         return;
     }
     
     auto start_time = std::chrono::high_resolution_clock::now();
     
-    DetectionResult result;
+    std::vector<DetectionResult> results;
+    {
+        std::lock_guard<std::mutex> lock(detect_mutex_);
+        detectBatch(batch, results);
+    }
+    size_t anomalies = 0;
+    for (const auto& result : results) {
+        if (result.is_anomaly) {
+            anomalies++;
+        }
+    }
+    
+    // Store results and statistics under one lock each
+    {
+        std::lock_guard<std::mutex> lock(results_mutex_);
+        for (auto& result : results) {
+            detection_history_.push_back(std::move(result));
+        }
+        while (detection_history_.size() > max_history_size_) {
+            detection_history_.pop_front();
+        }
+    }
+    
+    auto end_time = std::chrono::high_resolution_clock::now();
+    auto latency = std::chrono::duration_cast<std::chrono::microseconds>(
+        end_time - start_time).count();
+    
+    total_samples_ += batch.size();
+    anomalies_detected_ += anomalies;
+    total_detection_time_us_ += latency;
+}
+
+void FaultDetectionAdapter::detectBatch(std::span<const TimeSeriesData> batch,
+                                        std::vector<DetectionResult>& results) {
+    scoreBatch(batch);
+    results.reserve(batch.size());
     
     switch (detection_method_) {
         case DetectionMethod::ZSCORE:
-            result = detectZScore(data);
+            for (size_t i = 0; i < batch.size(); i++) {
+                results.push_back(detectZScore(batch[i].timestamp, i));
+            }
             break;
         case DetectionMethod::VAE:
-            result = detectVAE(data);
+            detectVAE(batch, results);
             break;
         case DetectionMethod::HYBRID:
             {
-                auto zscore_result = detectZScore(data);
-                auto vae_result = detectVAE(data);
-                // Combine results: anomaly if either method detects it
-                result = zscore_result;
-                result.is_anomaly = zscore_result.is_anomaly || vae_result.is_anomaly;
-                result.anomaly_score = std::max(zscore_result.anomaly_score, 
-                                                vae_result.anomaly_score);
-                result.features["zscore"] = zscore_result.anomaly_score;
-                result.features["vae_error"] = vae_result.anomaly_score;
+                std::vector<DetectionResult> vae_results;
+                detectVAE(batch, vae_results);
+                for (size_t i = 0; i < batch.size(); i++) {
+                    // Combine results: anomaly if either method detects it
+                    auto result = detectZScore(batch[i].timestamp, i);
+                    const auto& vae_result = vae_results[i];
+                    double zscore = result.anomaly_score;
+                    result.is_anomaly = result.is_anomaly || vae_result.is_anomaly;
+                    result.anomaly_score = std::max(zscore, vae_result.anomaly_score);
+                    result.features["zscore"] = zscore;
+                    result.features["vae_error"] = vae_result.anomaly_score;
+                    results.push_back(std::move(result));
+                }
             }
             break;
     }
-    
-    // Store result
-    {
-        std::lock_guard<std::mutex> lock(results_mutex_);
-        detection_history_.push_back(result);
-        if (detection_history_.size() > max_history_size_) {
-            detection_history_.pop_front();
+}
+
+uint32_t FaultDetectionAdapter::seriesOf(const TimeSeriesData& data) {
+    key_buffer_.clear();
+    if (series_tags_.empty()) {
+        for (const auto& [tag, value] : data.tags) {
+            key_buffer_.append(tag).append(1, '=').append(value).append(1, ',');
+        }
+    } else {
+        for (const auto& tag : series_tags_) {
+            auto it = data.tags.find(tag);
+            if (it != data.tags.end()) {
+                key_buffer_.append(it->second);
+            }
+            key_buffer_.append(1, ',');
         }
     }
     
-    auto end_time = std::chrono::high_resolution_clock::now();
-    auto latency = std::chrono::duration_cast<std::chrono::microseconds>(
-        end_time - start_time).count();
-    
-    // Update statistics
-    {
-        std::lock_guard<std::mutex> lock(stats_mutex_);
-        total_samples_++;
-        if (result.is_anomaly) {
-            anomalies_detected_++;
-        }
-        total_detection_time_us_ += latency;
+    auto it = series_ids_.find(key_buffer_);
+    if (it != series_ids_.end()) {
+        return it->second;
+    }
+    auto id = static_cast<uint32_t>(series_mean_.size());
+    series_ids_.emplace(key_buffer_, id);
+    series_mean_.push_back(0.0);
+    series_variance_.push_back(0.0);
+    series_count_.push_back(0);
+    return id;
+}
+
+void FaultDetectionAdapter::scoreBatch(std::span<const TimeSeriesData> batch) {
+    const size_t n = batch.size();
+    batch_.resize(n);
+    
+    // Welford's online algorithm, in order: a point is scored against its
+    // series including itself, so later points of a series see earlier ones
+    for (size_t i = 0; i < n; i++) {
+        uint32_t id = seriesOf(batch[i]);
+        double value = batch[i].as_double();
+        
+        uint64_t count = ++series_count_[id];
+        double delta = value - series_mean_[id];
+        series_mean_[id] += delta / count;
+        series_variance_[id] += (delta * (value - series_mean_[id]) - series_variance_[id]) / count;
+        
+        sample_count_++;
+        double global_delta = value - running_mean_;
+        running_mean_ += global_delta / sample_count_;
+        running_variance_ += (global_delta * (value - running_mean_) - running_variance_) / sample_count_;
+        
+        batch_.series[i] = id;
+        batch_.values[i] = value;
+        batch_.means[i] = series_mean_[id];
+        batch_.variances[i] = series_variance_[id];
+        batch_.counts[i] = count;
     }
+    
+    zscores(batch_.values.data(), batch_.means.data(), batch_.variances.data(),
+            batch_.std_devs.data(), batch_.scores.data(), n);
 }
 
 FaultDetectionAdapter::DetectionResult FaultDetectionAdapter::detectZScore(
-    const TimeSeriesData& data) {
+    int64_t timestamp, size_t i) const {
     
     DetectionResult result;
-    result.timestamp = data.timestamp;
+    result.timestamp = timestamp;
     result.is_anomaly = false;
     result.anomaly_score = 0.0;
     result.severity = Severity::NORMAL;
     
-    // Extract scalar value
-    double value = data.as_double();
-    
-    // Update statistics
-    updateStatistics(value);
-    
     // Need enough samples for reliable detection
-    if (sample_count_ < 10) {
+    if (batch_.counts[i] < MIN_SAMPLES) {
         result.description = "Insufficient data for detection";
         return result;
     }
     
-    // Calculate z-score
-    double std_dev = std::sqrt(running_variance_);
+    double std_dev = batch_.std_devs[i];
     if (std_dev < 1e-9) {
         result.description = "No variation in data";
         return result;
     }
     
-    double zscore = std::abs(value - running_mean_) / std_dev;
+    double zscore = batch_.scores[i];
     result.anomaly_score = zscore;
-    result.features["mean"] = running_mean_;
+    result.features["mean"] = batch_.means[i];
     result.features["std_dev"] = std_dev;
     result.features["zscore"] = zscore;
     
@@ -210,33 +370,32 @@ FaultDetectionAdapter::DetectionResult FaultDetectionAdapter::detectZScore(
     return result;
 }
 
-FaultDetectionAdapter::DetectionResult FaultDetectionAdapter::detectVAE(
-    const TimeSeriesData& data) {
-    
-    DetectionResult result;
-    result.timestamp = data.timestamp;
-    result.is_anomaly = false;
-    result.anomaly_score = 0.0;
-    result.severity = Severity::NORMAL;
-    
+void FaultDetectionAdapter::detectVAE(std::span<const TimeSeriesData> batch,
+                                      std::vector<DetectionResult>& results) {
     // Stub: VAE model not available in stub mode
-    // In full implementation, use VAE for reconstruction and error calculation
-    
-    try {
-        // Stub: Simulate VAE reconstruction error
-        // In full implementation:
-        // - vae_model_->reconstruct(input)
-        // - computeReconstructionError(input, reconstructed)
-        
-        // For stub mode, use simple heuristic: larger deviations = higher error
-        double zscore_result = detectZScore(data).anomaly_score;
-        double error = std::abs(zscore_result);
+    // In full implementation, one forward pass reconstructs the whole batch:
+    // - vae_model_->reconstruct(inputs)  (batch.size() x features)
+    // - computeReconstructionError(input, reconstructed) per point
+    //
+    // For stub mode the reconstruction of a point is its series mean, so
+    // the normalized reconstruction error is the z-score already computed
+    // for the batch: larger deviations = higher error
+    double error_threshold = threshold_ * 0.1;  // Adjust based on model
+    results.reserve(results.size() + batch.size());
+    
+    for (size_t i = 0; i < batch.size(); i++) {
+        DetectionResult result;
+        result.timestamp = batch[i].timestamp;
+        result.is_anomaly = false;
+        result.anomaly_score = 0.0;
+        result.severity = Severity::NORMAL;
         
+        double error = (batch_.counts[i] < MIN_SAMPLES || batch_.std_devs[i] < 1e-9) ?
+            0.0 : batch_.scores[i];
         result.anomaly_score = error;
         result.features["reconstruction_error"] = error;
         
         // Determine if anomaly based on error threshold
-        double error_threshold = threshold_ * 0.1;  // Adjust based on model
         if (error > error_threshold) {
             result.is_anomaly = true;
             
@@ -252,12 +411,8 @@ FaultDetectionAdapter::DetectionResult FaultDetectionAdapter::detectVAE(
         } else {
             result.description = "Normal operation (VAE)";
         }
-        
-    } catch (const std::exception& e) {
-        result.description = std::string("VAE detection error: ") + e.what();
+        results.push_back(std::move(result));
     }
-    
-    return result;
 }
 
 double FaultDetectionAdapter::computeReconstructionError(
@@ -278,20 +433,6 @@ double FaultDetectionAdapter::computeReconstructionError(
     return std::sqrt(sum_squared_error / input.size());  // RMSE
 }
 
-void FaultDetectionAdapter::updateStatistics(double value) {
-    value_history_.push_back(value);
-    if (value_history_.size() > window_size_) {
-        value_history_.pop_front();
-    }
-    
-    // Update running statistics using Welford's online algorithm
-    sample_count_++;
-    double delta = value - running_mean_;
-    running_mean_ += delta / sample_count_;
-    double delta2 = value - running_mean_;
-    running_variance_ += (delta * delta2 - running_variance_) / sample_count_;
-}
-
 AlgorithmResult FaultDetectionAdapter::process() {
     if (!initialized_ || !running_) {
         return AlgorithmResult();
@@ -302,35 +443,39 @@ AlgorithmResult FaultDetectionAdapter::process() {
         std::chrono::system_clock::now().time_since_epoch()
     ).count();
     
-    std::lock_guard<std::mutex> lock(stats_mutex_);
-    result.metrics["total_samples"] = static_cast<double>(total_samples_);
-    result.metrics["anomalies_detected"] = static_cast<double>(anomalies_detected_);
-    result.metrics["anomaly_rate"] = total_samples_ > 0 ? 
-        static_cast<double>(anomalies_detected_) / total_samples_ : 0.0;
+    size_t total_samples = total_samples_.load();
+    size_t anomalies = anomalies_detected_.load();
+    result.metrics["total_samples"] = static_cast<double>(total_samples);
+    result.metrics["anomalies_detected"] = static_cast<double>(anomalies);
+    result.metrics["anomaly_rate"] = total_samples > 0 ? 
+        static_cast<double>(anomalies) / total_samples : 0.0;
     
     return result;
 }
 
 std::map<std::string, int64_t> FaultDetectionAdapter::getStats() const {
-    std::lock_guard<std::mutex> lock(stats_mutex_);
+    size_t total_samples = total_samples_.load();
     
     return {
-        {"total_samples", static_cast<int64_t>(total_samples_)},
-        {"anomalies_detected", static_cast<int64_t>(anomalies_detected_)},
-        {"avg_detection_time_us", total_samples_ > 0 ? 
-            total_detection_time_us_ / total_samples_ : 0}
+        {"total_samples", static_cast<int64_t>(total_samples)},
+        {"anomalies_detected", static_cast<int64_t>(anomalies_detected_.load())},
+        {"avg_detection_time_us", total_samples > 0 ? 
+            total_detection_time_us_.load() / static_cast<int64_t>(total_samples) : 0}
     };
 }
 
 void FaultDetectionAdapter::reset() {
-    std::lock_guard<std::mutex> lock1(stats_mutex_);
-    std::lock_guard<std::mutex> lock2(results_mutex_);
+    std::lock_guard<std::mutex> lock1(results_mutex_);
+    std::lock_guard<std::mutex> lock2(detect_mutex_);
     
     total_samples_ = 0;
     anomalies_detected_ = 0;
     total_detection_time_us_ = 0;
     
-    value_history_.clear();
+    series_ids_.clear();
+    series_mean_.clear();
+    series_variance_.clear();
+    series_count_.clear();
     running_mean_ = 0.0;
     running_variance_ = 0.0;
     sample_count_ = 0;
@@ -400,10 +545,11 @@ void FaultDetectionAdapter::setThreshold(double threshold) {
 std::map<std::string, double> FaultDetectionAdapter::getModelMetrics() const {
     std::map<std::string, double> metrics;
     
-    std::lock_guard<std::mutex> lock(stats_mutex_);
+    std::lock_guard<std::mutex> lock(detect_mutex_);
     metrics["sample_count"] = static_cast<double>(sample_count_);
     metrics["running_mean"] = running_mean_;
     metrics["running_std"] = std::sqrt(running_variance_);
+    metrics["series_count"] = static_cast<double>(series_mean_.size());
     
     return metrics;
 }
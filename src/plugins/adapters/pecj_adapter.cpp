@@ -14,6 +14,7 @@
 
 #include "sage_tsdb/plugins/adapters/pecj_adapter.h"
 #include "sage_tsdb/plugins/plugin_registry.h"
+#include <algorithm>
 #include <chrono>
 #include <iostream>
 #include <sys/time.h>
@@ -79,6 +80,17 @@ void PECJAdapter::parseConfig(const PluginConfig& config) {
         window_config_.wm_tag = config.at("wmTag");
     }
     
+    // Parse ingest configuration
+    if (config.count("ingestQueueLen")) {
+        ingest_config_.queue_len = std::stoull(config.at("ingestQueueLen"));
+    }
+    if (config.count("ingestBatch")) {
+        ingest_config_.batch_size = std::max<size_t>(1, std::stoull(config.at("ingestBatch")));
+    }
+    if (config.count("ingestFlushUs")) {
+        ingest_config_.flush_interval_us = std::stoull(config.at("ingestFlushUs"));
+    }
+    
     // Parse operator type
     if (config.count("operator")) {
         std::string op = config.at("operator");
@@ -137,6 +149,11 @@ bool PECJAdapter::initialize(const PluginConfig& config,
         return false;
     }
     
+    // A full batch must fit in a ring
+    size_t ring_len = std::max(ingest_config_.queue_len, ingest_config_.batch_size);
+    s_ring_ = std::make_unique<MpmcRing<TimeSeriesData>>(ring_len);
+    r_ring_ = std::make_unique<MpmcRing<TimeSeriesData>>(ring_len);
+    
     initialized_.store(true);
     std::cout << "✓ PECJ Adapter initialized successfully" << std::endl;
     return true;
@@ -312,8 +329,14 @@ bool PECJAdapter::stop() {
         running_.store(false);
     }
     
-    // Wake up worker thread
-    queue_cv_.notify_all();
+    // Wake up worker thread, which feeds what is queued before exiting,
+    // and producers waiting on a full ring
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        wake_cv_.notify_all();
+    }
+    space_signal_.fetch_add(1, std::memory_order_release);
+    space_signal_.notify_all();
     
     // Wait for worker thread
     if (worker_thread_.joinable()) {
@@ -344,11 +367,14 @@ void PECJAdapter::reset() {
     min_timestamp_ = 0;
 #endif
     
-    // Clear data queue
-    {
-        std::lock_guard<std::mutex> qlock(queue_mutex_);
-        std::queue<std::pair<TimeSeriesData, bool>> empty;
-        std::swap(data_queue_, empty);
+    // Clear data rings
+    if (s_ring_ && r_ring_) {
+        while (s_ring_->try_pop()) {
+        }
+        while (r_ring_->try_pop()) {
+        }
+        space_signal_.fetch_add(1, std::memory_order_release);
+        space_signal_.notify_all();
     }
 }
 
@@ -419,22 +445,67 @@ void PECJAdapter::feedData(const TimeSeriesData& data) {
         return;
     }
     
-    // Determine stream based on data tags
-    bool is_s_stream = true;
-    if (data.tags.find("stream") != data.tags.end()) {
-        is_s_stream = (data.tags.at("stream") == "S");
-    } else {
-        // Default: use timestamp parity (even->S, odd->R)
-        is_s_stream = ((data.timestamp / 1000) % 2 == 0);
+    // Add to the stream's ring for async processing
+    enqueue(data, isStreamS(data));
+    signalWorker();
+}
+
+void PECJAdapter::feedBatch(std::span<const TimeSeriesData> batch) {
+    if (!initialized_.load() || !running_.load() || batch.empty()) {
+        return;
     }
     
-    // Add to queue for async processing
-    {
-        std::lock_guard<std::mutex> lock(queue_mutex_);
-        data_queue_.push({data, is_s_stream});
-        queue_length_.store(data_queue_.size());
+    // One wakeup check for the whole batch
+    for (const auto& data : batch) {
+        enqueue(data, isStreamS(data));
     }
-    queue_cv_.notify_one();
+    signalWorker();
+}
+
+void PECJAdapter::enqueue(const TimeSeriesData& data, bool is_s_stream) {
+    auto& ring = is_s_stream ? *s_ring_ : *r_ring_;
+    TimeSeriesData item = data;
+    while (true) {
+        uint64_t space = space_signal_.load(std::memory_order_acquire);
+        if (ring.try_push(std::move(item))) {
+            return;
+        }
+        // Nobody drains a stopped adapter
+        if (!running_.load()) {
+            return;
+        }
+        // Full ring: the worker is already woken, as it holds at least a batch
+        signalWorker();
+        space_signal_.wait(space, std::memory_order_acquire);
+    }
+}
+
+void PECJAdapter::signalWorker() {
+    // Pairs with the fence in workerLoop: either the worker sees the new
+    // tuples before it sleeps, or this sees it waiting and wakes it
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    size_t wake_at = wake_at_.load(std::memory_order_relaxed);
+    if (wake_at != 0 && pendingTuples() >= wake_at) {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        wake_cv_.notify_one();
+    }
+}
+
+size_t PECJAdapter::pendingTuples() const {
+    if (!s_ring_ || !r_ring_) {
+        return 0;
+    }
+    return s_ring_->size_approx() + r_ring_->size_approx();
+}
+
+bool PECJAdapter::isStreamS(const TimeSeriesData& data) {
+    // Determine stream based on data tags
+    auto it = data.tags.find("stream");
+    if (it != data.tags.end()) {
+        return it->second == "S";
+    }
+    // Default: use timestamp parity (even->S, odd->R)
+    return (data.timestamp / 1000) % 2 == 0;
 }
 
 void PECJAdapter::feedStreamS(const TimeSeriesData& data) {
@@ -481,6 +552,41 @@ void PECJAdapter::feedStreamR(const TimeSeriesData& data) {
     total_latency_us_.fetch_add(latency);
 }
 
+void PECJAdapter::feedStreamSBatch(std::span<const TimeSeriesData> batch) {
+    feedStreamBatch(batch, true);
+}
+
+void PECJAdapter::feedStreamRBatch(std::span<const TimeSeriesData> batch) {
+    feedStreamBatch(batch, false);
+}
+
+void PECJAdapter::feedStreamBatch(std::span<const TimeSeriesData> batch, bool is_s_stream) {
+    auto start_time = std::chrono::high_resolution_clock::now();
+    
+#ifdef PECJ_FULL_INTEGRATION
+    if (pecj_operator_) {
+        for (const auto& data : batch) {
+            auto track_tuple = convertToTrackTuple(data, is_s_stream);
+            if (!track_tuple) {
+                continue;
+            }
+            if (is_s_stream) {
+                pecj_operator_->feedTupleS(track_tuple);
+            } else {
+                pecj_operator_->feedTupleR(track_tuple);
+            }
+        }
+    }
+#endif
+    
+    auto end_time = std::chrono::high_resolution_clock::now();
+    auto latency = std::chrono::duration_cast<std::chrono::microseconds>(
+        end_time - start_time).count();
+    
+    (is_s_stream ? tuples_processed_s_ : tuples_processed_r_).fetch_add(batch.size());
+    total_latency_us_.fetch_add(latency);
+}
+
 // ============================================================================
 // Data Conversion
 // ============================================================================
@@ -504,12 +610,8 @@ std::shared_ptr<OoOJoin::TrackTuple> PECJAdapter::convertToTrackTuple(
     // Get value - CRITICAL FIX: Match Integrated Mode which uses fields["value"]
     // Instead of data.as_double() which reads from variant (often unset)
     uint64_t value = 0;
-    if (data.fields.find("value") != data.fields.end()) {
-        try {
-            value = static_cast<uint64_t>(std::stod(data.fields.at("value")));
-        } catch (...) {
-            value = 0;
-        }
+    if (auto it = data.fields.find("value"); it != data.fields.end()) {
+        value = static_cast<uint64_t>(it->second.as_double());
     } else {
         // Fallback to as_double() for backward compatibility
         value = static_cast<uint64_t>(data.as_double());
@@ -550,35 +652,81 @@ std::shared_ptr<OoOJoin::TrackTuple> PECJAdapter::convertToTrackTuple(
 // ============================================================================
 
 void PECJAdapter::workerLoop() {
-    while (running_.load()) {
-        std::pair<TimeSeriesData, bool> item;
+    using Clock = std::chrono::steady_clock;
+    const size_t batch_size = std::max<size_t>(1, ingest_config_.batch_size);
+    const auto flush_interval = std::chrono::microseconds(ingest_config_.flush_interval_us);
+    // Backstop for a missed wakeup while idle
+    constexpr auto IDLE_WAIT = std::chrono::milliseconds(100);
+    
+    std::vector<TimeSeriesData> s_batch;
+    std::vector<TimeSeriesData> r_batch;
+    s_batch.reserve(batch_size);
+    r_batch.reserve(batch_size);
+    Clock::time_point partial_since{};
+    
+    while (true) {
+        bool stopping = !running_.load();
+        size_t pending = pendingTuples();
         
-        {
-            std::unique_lock<std::mutex> lock(queue_mutex_);
-            queue_cv_.wait(lock, [this]() {
-                return !data_queue_.empty() || !running_.load();
-            });
-            
-            if (!running_.load() && data_queue_.empty()) {
-                break;
+        // Hold a partial batch until it fills or flush_interval has passed
+        if (!stopping && pending < batch_size) {
+            auto now = Clock::now();
+            if (pending == 0) {
+                partial_since = {};
+            } else if (partial_since == Clock::time_point{}) {
+                partial_since = now;
             }
-            
-            if (!data_queue_.empty()) {
-                item = data_queue_.front();
-                data_queue_.pop();
-            } else {
+            if (pending == 0 || now < partial_since + flush_interval) {
+                std::unique_lock<std::mutex> lock(wake_mutex_);
+                wake_at_.store(pending == 0 ? 1 : batch_size, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                auto ready = [&]() {
+                    return !running_.load() ||
+                           pendingTuples() >= wake_at_.load(std::memory_order_relaxed);
+                };
+                if (pending == 0) {
+                    wake_cv_.wait_for(lock, IDLE_WAIT, ready);
+                } else {
+                    wake_cv_.wait_until(lock, partial_since + flush_interval, ready);
+                }
+                wake_at_.store(0, std::memory_order_relaxed);
                 continue;
             }
         }
+        partial_since = {};
+        
+        while (s_batch.size() < batch_size) {
+            auto item = s_ring_->try_pop();
+            if (!item) break;
+            s_batch.push_back(std::move(*item));
+        }
+        while (r_batch.size() < batch_size) {
+            auto item = r_ring_->try_pop();
+            if (!item) break;
+            r_batch.push_back(std::move(*item));
+        }
+        if (s_batch.empty() && r_batch.empty()) {
+            if (stopping) {
+                break;
+            }
+            continue;
+        }
+        
+        // Room freed: wake producers waiting on a full ring
+        space_signal_.fetch_add(1, std::memory_order_release);
+        space_signal_.notify_all();
         
         // Process data
-        if (item.second) {
-            feedStreamS(item.first);
-        } else {
-            feedStreamR(item.first);
+        if (!s_batch.empty()) {
+            feedStreamSBatch(s_batch);
+            s_batch.clear();
+        }
+        if (!r_batch.empty()) {
+            feedStreamRBatch(r_batch);
+            r_batch.clear();
         }
         
-        // Check for window results periodically
+        // Check for window results once per batch
 #ifdef PECJ_FULL_INTEGRATION
         if (pecj_operator_) {
             size_t result = pecj_operator_->getResult();
@@ -676,7 +824,7 @@ std::map<std::string, int64_t> PECJAdapter::getStats() const {
         {"join_results", static_cast<int64_t>(getJoinResult())},
         {"avg_latency_us", total_processed > 0 ?
             total_latency_us_.load() / static_cast<int64_t>(total_processed) : 0},
-        {"queue_size", static_cast<int64_t>(data_queue_.size())}
+        {"queue_size", static_cast<int64_t>(pendingTuples())}
     };
 }
 
@@ -708,11 +856,11 @@ core::ResourceUsage PECJAdapter::getResourceUsage() const {
         resource_request_.requested_threads : 1;
     
     // Memory estimation (simplified - should use actual RSS)
-    size_t est_memory = data_queue_.size() * sizeof(TimeSeriesData) * 2;
+    size_t est_memory = pendingTuples() * sizeof(TimeSeriesData) * 2;
     usage.memory_used_bytes = est_memory;
     
     // Queue length
-    usage.queue_length = queue_length_.load();
+    usage.queue_length = pendingTuples();
     
     // Processing metrics
     usage.tuples_processed = tuples_processed_s_.load() + tuples_processed_r_.load();
@@ -49,10 +49,20 @@ bool PluginManager::initialize() {
         resource_config_.max_memory_mb * 1024ULL * 1024ULL
     );
     
+    {
+        std::lock_guard<std::mutex> lock(plugins_mutex_);
+        if (metrics_) {
+            resource_manager_->attachMetrics(metrics_);
+        }
+    }
+    
     std::cout << "✓ ResourceManager created (threads=" << resource_config_.thread_pool_size 
               << ", memory=" << resource_config_.max_memory_mb << "MB)" << std::endl;
     
-    // Start event bus
+    // Start event bus, bounded by the configured queue size
+    EventBusConfig bus_config;
+    bus_config.capacity = resource_config_.event_queue_size;
+    event_bus_.configure(bus_config);
     event_bus_.start();
     
     // Setup event subscriptions for plugin coordination
@@ -118,6 +128,7 @@ bool PluginManager::loadPlugin(const std::string& name, const PluginConfig& conf
             std::cerr << "Plugin '" << name << "' rejected ResourceManager initialization" << std::endl;
             // Release the resource handle and fall back
             resource_handle.reset();
+            resource_manager_->release(name);
         }
     }
     
@@ -133,6 +144,7 @@ bool PluginManager::loadPlugin(const std::string& name, const PluginConfig& conf
     // Store plugin
     plugins_[name] = plugin;
     plugin_enabled_[name] = true;
+    registerPluginMetrics(name, plugin);
     
     std::cout << "✓ Plugin '" << name << "' loaded successfully" << std::endl;
     return true;
@@ -159,7 +171,8 @@ bool PluginManager::unloadPlugin(const std::string& name) {
         plugin_resources_.erase(res_it);
     }
     
-    // Remove plugin
+    // Remove plugin, its series first
+    plugin_metrics_.erase(name);
     plugins_.erase(it);
     plugin_enabled_.erase(name);
     
@@ -168,6 +181,14 @@ bool PluginManager::unloadPlugin(const std::string& name) {
 }
 
 bool PluginManager::startAll() {
+    {
+        std::lock_guard<std::mutex> lock(feed_mutex_);
+        if (!feed_flusher_.joinable() && getResourceConfig().feed_batch_size > 1) {
+            feed_stop_ = false;
+            feed_flusher_ = std::thread(&PluginManager::feedFlushLoop, this);
+        }
+    }
+    
     std::lock_guard<std::mutex> lock(plugins_mutex_);
     
     bool all_started = true;
@@ -190,6 +211,10 @@ bool PluginManager::startAll() {
 }
 
 void PluginManager::stopAll() {
+    // Deliver what is pending while the plugins still run
+    flushFeeds();
+    stopFeedFlusher();
+    
     std::lock_guard<std::mutex> lock(plugins_mutex_);
     
     for (auto& pair : plugins_) {
@@ -218,20 +243,75 @@ void PluginManager::feedDataToAll(const std::shared_ptr<TimeSeriesData>& data) {
     }
     
     // Publish to event bus (zero-copy via shared_ptr)
-    event_bus_.publish_data(data, "core");
+    static const EventSource core_source = intern_source("core");
+    event_bus_.publish_data(data, core_source);
+    
+    // Queue for the enabled plugins; a full batch is fed by this caller
+    size_t batch_size = getResourceConfig().feed_batch_size;
+    std::lock_guard<std::mutex> lock(feed_mutex_);
+    if (feed_batch_.empty()) {
+        feed_batch_start_ = std::chrono::steady_clock::now();
+        feed_cv_.notify_one();
+    }
+    feed_batch_.push_back(*data);
+    if (feed_batch_.size() >= batch_size) {
+        dispatchFeedBatch();
+    }
+}
+
+void PluginManager::flushFeeds() {
+    std::lock_guard<std::mutex> lock(feed_mutex_);
+    dispatchFeedBatch();
+}
+
+void PluginManager::dispatchFeedBatch() {
+    if (feed_batch_.empty()) {
+        return;
+    }
     
-    // Direct feed to all enabled plugins
-    std::lock_guard<std::mutex> lock(plugins_mutex_);
-    for (auto& pair : plugins_) {
-        if (plugin_enabled_[pair.first]) {
-            try {
-                pair.second->feedData(*data);
-            } catch (const std::exception& e) {
-                std::cerr << "Error feeding data to plugin '" << pair.first 
-                         << "': " << e.what() << std::endl;
+    std::span<const TimeSeriesData> batch(feed_batch_);
+    {
+        std::lock_guard<std::mutex> lock(plugins_mutex_);
+        for (auto& pair : plugins_) {
+            if (plugin_enabled_[pair.first]) {
+                try {
+                    pair.second->feedBatch(batch);
+                } catch (const std::exception& e) {
+                    std::cerr << "Error feeding data to plugin '" << pair.first 
+                             << "': " << e.what() << std::endl;
+                }
             }
         }
     }
+    feed_batch_.clear();
+}
+
+void PluginManager::feedFlushLoop() {
+    std::unique_lock<std::mutex> lock(feed_mutex_);
+    while (!feed_stop_) {
+        if (feed_batch_.empty()) {
+            feed_cv_.wait(lock, [this] { return feed_stop_ || !feed_batch_.empty(); });
+            continue;
+        }
+        auto deadline = feed_batch_start_ +
+            std::chrono::microseconds(getResourceConfig().feed_batch_delay_us);
+        if (std::chrono::steady_clock::now() >= deadline) {
+            dispatchFeedBatch();
+        } else {
+            feed_cv_.wait_until(lock, deadline);
+        }
+    }
+}
+
+void PluginManager::stopFeedFlusher() {
+    {
+        std::lock_guard<std::mutex> lock(feed_mutex_);
+        feed_stop_ = true;
+    }
+    feed_cv_.notify_all();
+    if (feed_flusher_.joinable()) {
+        feed_flusher_.join();
+    }
 }
 
 void PluginManager::feedDataToPlugin(const std::string& plugin_name,
@@ -284,9 +364,58 @@ PluginManager::getAllStats() const {
             resource_manager_->isUnderPressure() ? 1 : 0;
     }
     
+    // Event bus and per-subscriber delivery lag
+    auto bus_stats = event_bus_.getStats();
+    all_stats["_event_bus"]["published"] = static_cast<int64_t>(bus_stats.published);
+    all_stats["_event_bus"]["delivered"] = static_cast<int64_t>(bus_stats.delivered);
+    all_stats["_event_bus"]["dropped"] =
+        static_cast<int64_t>(bus_stats.dropped_oldest + bus_stats.dropped_newest);
+    all_stats["_event_bus"]["queued"] = static_cast<int64_t>(bus_stats.queued);
+    for (const auto& sub : event_bus_.getSubscriberStats()) {
+        auto& entry = all_stats["_subscriber:" + sub.name];
+        entry["delivered"] = static_cast<int64_t>(sub.delivered);
+        entry["dropped"] = static_cast<int64_t>(sub.dropped);
+        entry["sampled_out"] = static_cast<int64_t>(sub.sampled_out);
+        entry["queued"] = static_cast<int64_t>(sub.queued);
+        entry["lag_us"] = sub.lag_us;
+        entry["max_lag_us"] = sub.max_lag_us;
+    }
+    
     return all_stats;
 }
 
+void PluginManager::attachMetrics(std::shared_ptr<MetricsRegistry> registry) {
+    std::lock_guard<std::mutex> lock(plugins_mutex_);
+    metrics_ = std::move(registry);
+    for (const auto& [name, plugin] : plugins_) {
+        registerPluginMetrics(name, plugin);
+    }
+    if (resource_manager_) {
+        resource_manager_->attachMetrics(metrics_);
+    }
+}
+
+void PluginManager::registerPluginMetrics(const std::string& name, const PluginPtr& plugin) {
+    auto& handles = plugin_metrics_[name];
+    handles.clear();
+    if (!metrics_) {
+        plugin_metrics_.erase(name);
+        return;
+    }
+    
+    // The plugin outlives its handles: unloadPlugin() drops them first
+    IAlgorithmPlugin* source = plugin.get();
+    for (const auto& [key, value] : plugin->getStats()) {
+        handles.push_back(metrics_->addGauge(
+            "sage_tsdb_plugin_stat", "Plugin getStats() value", {{"plugin", name}, {"stat", key}},
+            [source, key = key]() {
+                auto stats = source->getStats();
+                auto it = stats.find(key);
+                return it != stats.end() ? static_cast<double>(it->second) : 0.0;
+            }));
+    }
+}
+
 std::vector<std::string> PluginManager::getLoadedPlugins() const {
     std::lock_guard<std::mutex> lock(plugins_mutex_);
     
@@ -331,18 +460,24 @@ PluginManager::ResourceConfig PluginManager::getResourceConfig() const {
 
 void PluginManager::setupEventSubscriptions() {
     // Subscribe to data ingestion events
+    SubscriberOptions data_options;
+    data_options.name = "plugin_manager.data";
     int sub_id = event_bus_.subscribe(EventType::DATA_INGESTED, 
         [this](const Event& event) {
             this->handleDataEvent(event);
-        });
+        }, data_options);
     event_subscriptions_.push_back(sub_id);
     
-    // Subscribe to result events for logging/monitoring
+    // Subscribe to result events for logging/monitoring; monitoring may
+    // fall behind but must never hold up ingestion
+    SubscriberOptions result_options;
+    result_options.name = "plugin_manager.results";
+    result_options.policy = DeliveryPolicy::DROP;
     sub_id = event_bus_.subscribe(EventType::RESULT_READY,
         [](const Event& event) {
             // Could log or forward results
             // std::cout << "Result ready from: " << event.source << std::endl;
-        });
+        }, result_options);
     event_subscriptions_.push_back(sub_id);
 }
 
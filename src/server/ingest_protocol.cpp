@@ -0,0 +1,252 @@
+#include "sage_tsdb/server/ingest_protocol.h"
+#include "sage_tsdb/core/block_codec.h"
+#include <charconv>
+#include <chrono>
+#include <cstring>
+
+namespace sage_tsdb {
+namespace server {
+
+namespace {
+
+/**
+ * @brief Cursor over one line protocol line
+ */
+class LineCursor {
+public:
+    explicit LineCursor(std::string_view line) : line_(line) {}
+
+    bool done() const { return pos_ >= line_.size(); }
+    char peek() const { return line_[pos_]; }
+    void skip() { ++pos_; }
+    void skip_spaces() {
+        while (!done() && line_[pos_] == ' ') ++pos_;
+    }
+    std::string_view rest() const { return line_.substr(pos_); }
+
+    // Read up to the first unescaped stop character, removing escapes
+    std::string read_name(std::string_view stops) {
+        std::string out;
+        while (!done()) {
+            char c = line_[pos_];
+            if (c == '\\' && pos_ + 1 < line_.size() &&
+                std::strchr(",= \\", line_[pos_ + 1]) != nullptr) {
+                out.push_back(line_[pos_ + 1]);
+                pos_ += 2;
+                continue;
+            }
+            if (stops.find(c) != std::string_view::npos) {
+                break;
+            }
+            out.push_back(c);
+            ++pos_;
+        }
+        return out;
+    }
+
+    // Read a double-quoted string starting at the opening quote
+    bool read_quoted(std::string& out) {
+        ++pos_;
+        while (!done()) {
+            char c = line_[pos_++];
+            if (c == '"') {
+                return true;
+            }
+            if (c == '\\' && !done() && (line_[pos_] == '"' || line_[pos_] == '\\')) {
+                c = line_[pos_++];
+            }
+            out.push_back(c);
+        }
+        return false;
+    }
+
+    // Read an unquoted field value, which ends at ',' or ' '
+    std::string_view read_token() {
+        size_t start = pos_;
+        while (!done() && line_[pos_] != ',' && line_[pos_] != ' ') ++pos_;
+        return line_.substr(start, pos_ - start);
+    }
+
+private:
+    std::string_view line_;
+    size_t pos_ = 0;
+};
+
+template <typename T>
+bool parse_whole(std::string_view text, T& value) {
+    if (text.empty()) {
+        return false;
+    }
+    auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return ec == std::errc() && end == text.data() + text.size();
+}
+
+bool parse_field_value(std::string_view text, FieldValue& value) {
+    if (text == "t" || text == "T" || text == "true" || text == "True" || text == "TRUE") {
+        value = FieldValue(true);
+        return true;
+    }
+    if (text == "f" || text == "F" || text == "false" || text == "False" || text == "FALSE") {
+        value = FieldValue(false);
+        return true;
+    }
+    if (!text.empty() && text.back() == 'i') {
+        int64_t v;
+        if (!parse_whole(text.substr(0, text.size() - 1), v)) return false;
+        value = FieldValue(v);
+        return true;
+    }
+    if (!text.empty() && text.back() == 'u') {
+        uint64_t v;
+        if (!parse_whole(text.substr(0, text.size() - 1), v)) return false;
+        value = FieldValue(v);
+        return true;
+    }
+    double v;
+    if (!parse_whole(text, v)) return false;
+    value = FieldValue(v);
+    return true;
+}
+
+LineStatus fail(std::string* error, std::string message) {
+    if (error) {
+        *error = std::move(message);
+    }
+    return LineStatus::Error;
+}
+
+template <typename T>
+void put_le(std::vector<uint8_t>& out, T value) {
+    uint8_t bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+} // anonymous namespace
+
+LineStatus parse_line(std::string_view line, LinePoint& out,
+                      const LineProtocolOptions& options, std::string* error) {
+    if (!line.empty() && line.back() == '\r') {
+        line.remove_suffix(1);
+    }
+    size_t first = line.find_first_not_of(" \t");
+    if (first == std::string_view::npos || line[first] == '#') {
+        return LineStatus::Skipped;
+    }
+    LineCursor cursor(line.substr(first));
+
+    out.table = cursor.read_name(", ");
+    if (out.table.empty()) {
+        return fail(error, "missing measurement");
+    }
+    out.data = TimeSeriesData();
+
+    while (!cursor.done() && cursor.peek() == ',') {
+        cursor.skip();
+        std::string key = cursor.read_name("=, ");
+        if (key.empty() || cursor.done() || cursor.peek() != '=') {
+            return fail(error, "malformed tag");
+        }
+        cursor.skip();
+        std::string value = cursor.read_name(", ");
+        if (value.empty()) {
+            return fail(error, "empty value for tag " + key);
+        }
+        out.data.tags[std::move(key)] = std::move(value);
+    }
+
+    cursor.skip_spaces();
+    if (cursor.done()) {
+        return fail(error, "missing fields");
+    }
+
+    const std::string* numeric = nullptr;
+    bool has_value = false;
+    do {
+        if (cursor.peek() == ',') {
+            cursor.skip();
+        }
+        std::string key = cursor.read_name("=, ");
+        if (key.empty() || cursor.done() || cursor.peek() != '=') {
+            return fail(error, "malformed field");
+        }
+        cursor.skip();
+        FieldValue value;
+        if (!cursor.done() && cursor.peek() == '"') {
+            std::string text;
+            if (!cursor.read_quoted(text)) {
+                return fail(error, "unterminated string in field " + key);
+            }
+            value = FieldValue(std::move(text));
+        } else if (!parse_field_value(cursor.read_token(), value)) {
+            return fail(error, "bad value for field " + key);
+        }
+
+        const bool is_number = value.is_double() || value.is_int64();
+        if (key == options.value_field) {
+            if (!is_number) {
+                return fail(error, "field " + key + " is not numeric");
+            }
+            out.data.value = value.as_double();
+            has_value = true;
+            continue;
+        }
+        auto [it, inserted] = out.data.fields.insert_or_assign(std::move(key), std::move(value));
+        if (is_number && !numeric) {
+            numeric = &it->first;
+        }
+    } while (!cursor.done() && cursor.peek() == ',');
+
+    if (!has_value && numeric) {
+        out.data.value = out.data.fields.at(*numeric).as_double();
+    }
+
+    cursor.skip_spaces();
+    std::string_view ts = cursor.rest();
+    while (!ts.empty() && ts.back() == ' ') ts.remove_suffix(1);
+    if (ts.empty()) {
+        out.data.timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    } else {
+        int64_t timestamp;
+        if (!parse_whole(ts, timestamp)) {
+            return fail(error, "bad timestamp");
+        }
+        out.data.timestamp = options.timestamp_divisor > 1
+                                 ? timestamp / options.timestamp_divisor
+                                 : timestamp;
+    }
+    return LineStatus::Point;
+}
+
+void encode_binary_frame(const std::string& table, const TimeSeriesData* points,
+                         size_t count, std::vector<uint8_t>& out) {
+    std::vector<uint8_t> payload;
+    put_le(payload, static_cast<uint16_t>(table.size()));
+    payload.insert(payload.end(), table.begin(), table.end());
+    std::vector<uint8_t> block;
+    ColumnarBlock::encode(points, count, block);
+    payload.insert(payload.end(), block.begin(), block.end());
+
+    put_le(out, static_cast<uint32_t>(payload.size()));
+    put_le(out, crc32c(payload.data(), payload.size()));
+    out.insert(out.end(), payload.begin(), payload.end());
+}
+
+bool decode_binary_payload(const uint8_t* data, size_t size, std::string& table,
+                           std::vector<TimeSeriesData>& points) {
+    uint16_t name_len;
+    if (size < sizeof(name_len)) {
+        return false;
+    }
+    std::memcpy(&name_len, data, sizeof(name_len));
+    if (name_len == 0 || size - sizeof(name_len) < name_len) {
+        return false;
+    }
+    table.assign(reinterpret_cast<const char*>(data + sizeof(name_len)), name_len);
+    size_t offset = sizeof(name_len) + name_len;
+    return ColumnarBlock::decode(data + offset, size - offset, points);
+}
+
+} // namespace server
+} // namespace sage_tsdb
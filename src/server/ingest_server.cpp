@@ -0,0 +1,587 @@
+#include "sage_tsdb/server/ingest_server.h"
+#include "sage_tsdb/core/block_codec.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace sage_tsdb {
+namespace server {
+
+namespace {
+
+constexpr size_t kReadBufferBytes = 64 * 1024;  // Also covers the largest datagram
+constexpr int kMaxEvents = 64;
+constexpr int kReadsPerEvent = 16;              // Fairness between busy connections
+constexpr int kDatagramsPerEvent = 64;
+constexpr int kPausedPollMs = 10;               // Budget re-check period while paused
+
+bool starts_with_magic(const std::string& input) {
+    return input.size() >= sizeof(kBinaryMagic) &&
+           std::memcmp(input.data(), &kBinaryMagic, sizeof(kBinaryMagic)) == 0;
+}
+
+std::string peer_name(const sockaddr_in& addr) {
+    char host[INET_ADDRSTRLEN] = {};
+    inet_ntop(AF_INET, &addr.sin_addr, host, sizeof(host));
+    return std::string(host) + ":" + std::to_string(ntohs(addr.sin_port));
+}
+
+} // anonymous namespace
+
+double ConnectionStats::seconds() const {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - connected_at).count();
+}
+
+double ConnectionStats::points_per_second() const {
+    double s = seconds();
+    return s > 0 ? static_cast<double>(points_received) / s : 0.0;
+}
+
+double ConnectionStats::bytes_per_second() const {
+    double s = seconds();
+    return s > 0 ? static_cast<double>(bytes_received) / s : 0.0;
+}
+
+/**
+ * @brief State of one connection; only the loop thread touches it, except
+ * published, which is guarded by stats_mutex_
+ */
+struct IngestServer::Connection {
+    enum class Mode { Unknown, Lines, Binary };
+
+    int fd = -1;
+    Mode mode = Mode::Unknown;
+    std::string input;                   // Bytes not yet parsed
+    std::map<std::string, std::vector<TimeSeriesData>> batch;
+    size_t pending = 0;                  // Points in batch
+    std::chrono::steady_clock::time_point batch_started;
+    LinePoint line;                      // Reused parse target
+    ConnectionStats local;               // Loop thread's counters
+    ConnectionStats published;
+};
+
+IngestServer::IngestServer(std::shared_ptr<TableManager> manager, IngestServerConfig config)
+    : manager_(std::move(manager)), config_(std::move(config)) {
+    if (config_.batch_points == 0) {
+        config_.batch_points = 1;
+    }
+    if (!manager_) {
+        return;  // start() reports it
+    }
+
+    MetricsRegistry& registry = *manager_->getMetricsRegistry();
+    auto counter = [&](const char* name, const char* help, const Counter& value) {
+        metric_handles_.push_back(registry.addCounter(name, help, {}, [&value]() {
+            return static_cast<double>(value.value());
+        }));
+    };
+    counter("sage_tsdb_ingest_points_total", "Points written by the ingest server", points_written_);
+    counter("sage_tsdb_ingest_parse_errors_total", "Rejected lines or frames", parse_errors_);
+    counter("sage_tsdb_ingest_write_errors_total", "Points the tables refused", write_errors_);
+    counter("sage_tsdb_ingest_connections_accepted_total", "Accepted TCP connections",
+            connections_accepted_);
+    counter("sage_tsdb_ingest_connections_rejected_total", "Connections over max_connections",
+            connections_rejected_);
+    counter("sage_tsdb_ingest_backpressure_pauses_total", "Times reading stopped for memory",
+            backpressure_pauses_);
+    metric_handles_.push_back(registry.addGauge(
+        "sage_tsdb_ingest_active_connections", "Open TCP connections", {},
+        [this]() { return static_cast<double>(active_connections_.load()); }));
+    metric_handles_.push_back(registry.addGauge(
+        "sage_tsdb_ingest_paused", "1 while reading is paused for backpressure", {},
+        [this]() { return paused_flag_.load() ? 1.0 : 0.0; }));
+}
+
+IngestServer::~IngestServer() {
+    metric_handles_.clear();
+    stop();
+}
+
+void IngestServer::fail(const std::string& message) {
+    std::cerr << "IngestServer: " << message << std::endl;
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    last_error_ = message;
+}
+
+std::string IngestServer::lastError() const {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    return last_error_;
+}
+
+bool IngestServer::start() {
+    if (running_.load()) {
+        return true;
+    }
+    if (!manager_) {
+        fail("no table manager");
+        return false;
+    }
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    if (inet_pton(AF_INET, config_.bind_address.c_str(), &addr.sin_addr) != 1) {
+        fail("invalid bind address " + config_.bind_address);
+        return false;
+    }
+
+    auto cleanup = [this](const std::string& what) {
+        fail(what + ": " + std::strerror(errno));
+        for (int* fd : {&listen_fd_, &udp_fd_, &wake_fd_, &epoll_fd_}) {
+            if (*fd >= 0) {
+                ::close(*fd);
+                *fd = -1;
+            }
+        }
+        tcp_port_ = udp_port_ = -1;
+        return false;
+    };
+
+    // Bind a socket of type to port, returning the port actually bound
+    auto open_socket = [&](int type, int port, int& fd, int& bound) {
+        fd = ::socket(AF_INET, type | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) return false;
+        int one = 1;
+        ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        addr.sin_port = htons(static_cast<uint16_t>(port));
+        if (::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) return false;
+        if (type == SOCK_STREAM && ::listen(fd, SOMAXCONN) != 0) return false;
+        sockaddr_in local{};
+        socklen_t len = sizeof(local);
+        if (::getsockname(fd, reinterpret_cast<sockaddr*>(&local), &len) != 0) return false;
+        bound = ntohs(local.sin_port);
+        return true;
+    };
+
+    epoll_fd_ = ::epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ < 0) return cleanup("epoll_create1");
+    wake_fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd_ < 0) return cleanup("eventfd");
+    if (config_.tcp_port >= 0 && !open_socket(SOCK_STREAM, config_.tcp_port, listen_fd_, tcp_port_)) {
+        return cleanup("tcp port " + std::to_string(config_.tcp_port));
+    }
+    if (config_.udp_port >= 0 && !open_socket(SOCK_DGRAM, config_.udp_port, udp_fd_, udp_port_)) {
+        return cleanup("udp port " + std::to_string(config_.udp_port));
+    }
+    for (int fd : {wake_fd_, listen_fd_, udp_fd_}) {
+        if (fd < 0) continue;
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) != 0) return cleanup("epoll_ctl");
+    }
+
+    read_buffer_.resize(kReadBufferBytes);
+    if (udp_fd_ >= 0) {
+        udp_ = std::make_unique<Connection>();
+        udp_->fd = udp_fd_;
+        udp_->local.id = 0;
+        udp_->local.peer = "udp:" + std::to_string(udp_port_);
+        udp_->local.udp = true;
+        udp_->local.connected_at = std::chrono::steady_clock::now();
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        udp_->published = udp_->local;
+    }
+    paused_ = false;
+    running_.store(true);
+    thread_ = std::thread(&IngestServer::run, this);
+    return true;
+}
+
+void IngestServer::stop() {
+    if (!running_.exchange(false)) {
+        return;
+    }
+    uint64_t one = 1;
+    [[maybe_unused]] ssize_t n = ::write(wake_fd_, &one, sizeof(one));
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    ::close(wake_fd_);
+    ::close(epoll_fd_);
+    wake_fd_ = epoll_fd_ = -1;
+}
+
+void IngestServer::run() {
+    epoll_event events[kMaxEvents];
+    auto write_buffer = manager_->getWriteBufferManager();
+    const int interval_ms = static_cast<int>(std::max<int64_t>(1, config_.flush_interval.count()));
+
+    while (running_.load()) {
+        bool pressure = write_buffer && write_buffer->is_under_pressure();
+        if (pressure != paused_) {
+            setPaused(pressure);
+        }
+
+        int n = ::epoll_wait(epoll_fd_, events, kMaxEvents, paused_ ? kPausedPollMs : interval_ms);
+        if (n < 0 && errno != EINTR) {
+            fail(std::string("epoll_wait: ") + std::strerror(errno));
+            break;
+        }
+        for (int i = 0; i < n; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == wake_fd_) {
+                continue;  // running_ is already false
+            } else if (fd == listen_fd_) {
+                acceptConnections();
+            } else if (fd == udp_fd_) {
+                readDatagrams();
+            } else {
+                auto it = connections_.find(fd);
+                if (it != connections_.end() && !readConnection(*it->second)) {
+                    closeConnection(fd);
+                }
+            }
+        }
+        flushDue(std::chrono::steady_clock::now());
+    }
+    closeAll();
+}
+
+void IngestServer::setPaused(bool paused) {
+    paused_ = paused;
+    // Interest 0 keeps the fd registered; hangups and errors still arrive
+    auto update = [&](int fd) {
+        epoll_event event{};
+        event.events = paused ? 0u : static_cast<uint32_t>(EPOLLIN);
+        event.data.fd = fd;
+        ::epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &event);
+    };
+    for (int fd : {listen_fd_, udp_fd_}) {
+        if (fd >= 0) update(fd);
+    }
+    for (const auto& [fd, conn] : connections_) {
+        update(fd);
+    }
+    paused_flag_.store(paused);
+    if (paused) {
+        backpressure_pauses_.inc();
+    }
+}
+
+void IngestServer::acceptConnections() {
+    while (true) {
+        sockaddr_in addr{};
+        socklen_t len = sizeof(addr);
+        int fd = ::accept4(listen_fd_, reinterpret_cast<sockaddr*>(&addr), &len,
+                           SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            return;  // EAGAIN, or an error the next accept will report again
+        }
+        if (connections_.size() >= config_.max_connections) {
+            ::close(fd);
+            connections_rejected_.inc();
+            continue;
+        }
+
+        auto conn = std::make_unique<Connection>();
+        conn->fd = fd;
+        conn->local.id = next_id_++;
+        conn->local.peer = peer_name(addr);
+        conn->local.connected_at = std::chrono::steady_clock::now();
+        conn->published = conn->local;
+
+        epoll_event event{};
+        event.events = paused_ ? 0u : static_cast<uint32_t>(EPOLLIN);
+        event.data.fd = fd;
+        if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) != 0) {
+            ::close(fd);
+            continue;
+        }
+        {
+            std::lock_guard<std::mutex> lock(stats_mutex_);
+            connections_.emplace(fd, std::move(conn));
+        }
+        connections_accepted_.inc();
+        active_connections_++;
+    }
+}
+
+bool IngestServer::readConnection(Connection& conn) {
+    bool open = true;
+    for (int i = 0; i < kReadsPerEvent; ++i) {
+        ssize_t n = ::read(conn.fd, read_buffer_.data(), read_buffer_.size());
+        if (n > 0) {
+            if (!consume(conn, read_buffer_.data(), static_cast<size_t>(n))) {
+                open = false;
+                break;
+            }
+            if (static_cast<size_t>(n) < read_buffer_.size()) {
+                break;  // Drained; level-triggered epoll reports any more
+            }
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else {
+            // EOF, or an error other than "nothing to read"
+            open = n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+            break;
+        }
+    }
+    publish(conn);
+    return open;
+}
+
+void IngestServer::readDatagrams() {
+    Connection& conn = *udp_;
+    for (int i = 0; i < kDatagramsPerEvent; ++i) {
+        ssize_t n = ::recv(udp_fd_, read_buffer_.data(), read_buffer_.size(), 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        // Every datagram is self-contained and picks its own format
+        conn.local.bytes_received += static_cast<size_t>(n);
+        conn.input.assign(read_buffer_.data(), static_cast<size_t>(n));
+        if (starts_with_magic(conn.input)) {
+            conn.mode = Connection::Mode::Binary;
+            conn.input.erase(0, sizeof(kBinaryMagic));
+            if (!consumeFrames(conn) || !conn.input.empty()) {
+                conn.local.parse_errors++;  // Truncated or corrupt frame
+            }
+        } else {
+            conn.mode = Connection::Mode::Lines;
+            conn.input.push_back('\n');
+            consumeLines(conn);
+        }
+        conn.input.clear();
+    }
+    publish(conn);
+}
+
+bool IngestServer::consume(Connection& conn, const char* data, size_t size) {
+    conn.local.bytes_received += size;
+    conn.input.append(data, size);
+
+    if (conn.mode == Connection::Mode::Unknown) {
+        if (starts_with_magic(conn.input)) {
+            conn.mode = Connection::Mode::Binary;
+            conn.local.binary = true;
+            conn.input.erase(0, sizeof(kBinaryMagic));
+        } else if (conn.input.size() < sizeof(kBinaryMagic) &&
+                   std::memcmp(conn.input.data(), &kBinaryMagic, conn.input.size()) == 0) {
+            return true;  // Could still become the magic
+        } else {
+            conn.mode = Connection::Mode::Lines;
+        }
+    }
+    return conn.mode == Connection::Mode::Binary ? consumeFrames(conn) : consumeLines(conn);
+}
+
+bool IngestServer::consumeLines(Connection& conn) {
+    size_t start = 0;
+    std::string error;
+    while (true) {
+        size_t end = conn.input.find('\n', start);
+        if (end == std::string::npos) {
+            break;
+        }
+        std::string_view line(conn.input.data() + start, end - start);
+        start = end + 1;
+        switch (parse_line(line, conn.line, config_.protocol, &error)) {
+        case LineStatus::Point:
+            conn.batch[conn.line.table].push_back(std::move(conn.line.data));
+            pointsAdded(conn, 1);
+            break;
+        case LineStatus::Skipped:
+            break;
+        case LineStatus::Error:
+            conn.local.parse_errors++;
+            break;
+        }
+    }
+    conn.input.erase(0, start);
+    return conn.input.size() <= config_.max_line_bytes;
+}
+
+bool IngestServer::consumeFrames(Connection& conn) {
+    size_t offset = 0;
+    std::string table;
+    std::vector<TimeSeriesData> points;
+    bool ok = true;
+    while (conn.input.size() - offset >= kBinaryHeaderBytes) {
+        const auto* header = reinterpret_cast<const uint8_t*>(conn.input.data() + offset);
+        uint32_t size;
+        uint32_t crc;
+        std::memcpy(&size, header, sizeof(size));
+        std::memcpy(&crc, header + sizeof(size), sizeof(crc));
+        if (size > kMaxBinaryFrameBytes) {
+            ok = false;  // No way to find the next frame
+            break;
+        }
+        if (conn.input.size() - offset - kBinaryHeaderBytes < size) {
+            break;
+        }
+        const uint8_t* payload = header + kBinaryHeaderBytes;
+        points.clear();
+        if (crc32c(payload, size) != crc || !decode_binary_payload(payload, size, table, points)) {
+            ok = false;
+            break;
+        }
+        offset += kBinaryHeaderBytes + size;
+
+        auto& batch = conn.batch[table];
+        size_t count = points.size();
+        if (batch.empty()) {
+            batch = std::move(points);
+            points = std::vector<TimeSeriesData>();
+        } else {
+            batch.insert(batch.end(), std::make_move_iterator(points.begin()),
+                         std::make_move_iterator(points.end()));
+        }
+        pointsAdded(conn, count);
+    }
+    conn.input.erase(0, offset);
+    if (!ok) {
+        conn.local.parse_errors++;
+    }
+    return ok;
+}
+
+void IngestServer::pointsAdded(Connection& conn, size_t count) {
+    if (count == 0) {
+        return;
+    }
+    if (conn.pending == 0) {
+        conn.batch_started = std::chrono::steady_clock::now();
+    }
+    conn.pending += count;
+    conn.local.points_received += count;
+    if (conn.pending >= config_.batch_points) {
+        flush(conn);
+    }
+}
+
+void IngestServer::publish(Connection& conn) {
+    parse_errors_.inc(conn.local.parse_errors - conn.published.parse_errors);
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    conn.published = conn.local;
+}
+
+void IngestServer::flush(Connection& conn) {
+    if (conn.pending == 0) {
+        return;
+    }
+    if (config_.create_tables) {
+        for (const auto& [name, points] : conn.batch) {
+            if (known_tables_.count(name) == 0) {
+                if (!manager_->getStreamTable(name)) {
+                    manager_->createStreamTable(name, config_.table_config);
+                }
+                known_tables_.insert(name);
+            }
+        }
+    }
+
+    std::map<std::string, std::string> errors;
+    auto written = manager_->insertBatchToTables(conn.batch, &errors);
+    uint64_t count = 0;
+    for (const auto& [name, indices] : written) {
+        count += indices.size();
+    }
+    for (const auto& [name, error] : errors) {
+        known_tables_.erase(name);  // Dropped meanwhile: look again next time
+    }
+    uint64_t failed = conn.pending - count;
+    conn.batch.clear();
+    conn.pending = 0;
+
+    conn.local.points_written += count;
+    conn.local.write_errors += failed;
+    conn.local.batches++;
+    points_written_.inc(count);
+    write_errors_.inc(failed);
+}
+
+void IngestServer::flushDue(std::chrono::steady_clock::time_point now) {
+    auto due = [&](Connection& conn) {
+        if (conn.pending > 0 && now - conn.batch_started >= config_.flush_interval) {
+            flush(conn);
+            publish(conn);
+        }
+    };
+    for (auto& [fd, conn] : connections_) {
+        due(*conn);
+    }
+    if (udp_) {
+        due(*udp_);
+    }
+}
+
+void IngestServer::closeConnection(int fd) {
+    auto it = connections_.find(fd);
+    if (it == connections_.end()) {
+        return;
+    }
+    Connection& conn = *it->second;
+    // A last line may lack its newline
+    if (conn.mode != Connection::Mode::Binary && !conn.input.empty()) {
+        conn.input.push_back('\n');
+        consumeLines(conn);
+    }
+    flush(conn);
+    publish(conn);
+
+    ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+    ::close(fd);
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        connections_.erase(it);
+    }
+    active_connections_--;
+}
+
+void IngestServer::closeAll() {
+    while (!connections_.empty()) {
+        closeConnection(connections_.begin()->first);
+    }
+    if (udp_) {
+        readDatagrams();  // Whatever the kernel still holds
+        flush(*udp_);
+        publish(*udp_);
+        ::close(udp_fd_);
+        udp_fd_ = -1;
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        udp_.reset();
+    }
+    if (listen_fd_ >= 0) {
+        ::close(listen_fd_);
+        listen_fd_ = -1;
+    }
+}
+
+std::vector<ConnectionStats> IngestServer::getConnectionStats() const {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    std::vector<ConnectionStats> result;
+    result.reserve(connections_.size() + 1);
+    if (udp_) {
+        result.push_back(udp_->published);
+    }
+    for (const auto& [fd, conn] : connections_) {
+        result.push_back(conn->published);
+    }
+    return result;
+}
+
+IngestServerStats IngestServer::getStats() const {
+    IngestServerStats stats;
+    stats.connections_accepted = connections_accepted_.value();
+    stats.connections_rejected = connections_rejected_.value();
+    stats.active_connections = active_connections_.load();
+    stats.points_written = points_written_.value();
+    stats.parse_errors = parse_errors_.value();
+    stats.write_errors = write_errors_.value();
+    stats.backpressure_pauses = backpressure_pauses_.value();
+    stats.paused = paused_flag_.load();
+    return stats;
+}
+
+} // namespace server
+} // namespace sage_tsdb
@@ -0,0 +1,189 @@
+/**
+ * @file ingestd.cpp
+ * @brief Standalone ingest server: line protocol / binary frames over TCP and UDP
+ *
+ * Usage: sage_tsdb_ingestd [--data-dir DIR] [--bind ADDR] [--port N] [--udp-port N]
+ *                          [--batch N] [--flush-ms N] [--memory-mb N] [--precision ns|us|ms]
+ *                          [--metrics-port N] [--shard-port N] [--replicate 0|1]
+ *                          [--follow HOST:PORT]
+ */
+
+#include "sage_tsdb/cluster/replication.h"
+#include "sage_tsdb/cluster/shard_server.h"
+#include "sage_tsdb/server/ingest_server.h"
+#include "sage_tsdb/server/metrics_server.h"
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+
+namespace {
+
+volatile std::sig_atomic_t g_stop = 0;
+
+void on_signal(int) {
+    g_stop = 1;
+}
+
+void usage() {
+    std::cerr << "Usage: sage_tsdb_ingestd [--data-dir DIR] [--bind ADDR] [--port N]"
+                 " [--udp-port N] [--batch N] [--flush-ms N] [--memory-mb N]"
+                 " [--precision ns|us|ms] [--metrics-port N] [--shard-port N]"
+                 " [--replicate 0|1] [--follow HOST:PORT]\n"
+                 "  Timestamps are stored in milliseconds; --precision names the unit"
+                 " clients send (default ms).\n"
+                 "  --metrics-port serves Prometheus metrics at /metrics (-1 disables,"
+                 " the default).\n"
+                 "  --shard-port serves this node's tables to cluster routers (-1 disables,"
+                 " the default).\n"
+                 "  --replicate 1 also streams committed writes to followers on the shard"
+                 " port.\n"
+                 "  --follow replicates a leader's shard port into this node's tables;"
+                 " do not write to them otherwise.\n";
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv) {
+    using namespace sage_tsdb;
+
+    std::string data_dir;
+    size_t memory_mb = 0;
+    int metrics_port = -1;
+    int shard_port = -1;
+    bool replicate = false;
+    std::string follow;
+    server::IngestServerConfig config;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            usage();
+            return 1;
+        }
+        std::string value = argv[++i];
+        if (arg == "--data-dir") {
+            data_dir = value;
+        } else if (arg == "--bind") {
+            config.bind_address = value;
+        } else if (arg == "--port") {
+            config.tcp_port = std::atoi(value.c_str());
+        } else if (arg == "--udp-port") {
+            config.udp_port = std::atoi(value.c_str());
+        } else if (arg == "--batch") {
+            config.batch_points = std::strtoull(value.c_str(), nullptr, 10);
+        } else if (arg == "--flush-ms") {
+            config.flush_interval = std::chrono::milliseconds(std::atoll(value.c_str()));
+        } else if (arg == "--memory-mb") {
+            memory_mb = std::strtoull(value.c_str(), nullptr, 10);
+        } else if (arg == "--metrics-port") {
+            metrics_port = std::atoi(value.c_str());
+        } else if (arg == "--shard-port") {
+            shard_port = std::atoi(value.c_str());
+        } else if (arg == "--replicate") {
+            replicate = value == "1";
+        } else if (arg == "--follow") {
+            follow = value;
+        } else if (arg == "--precision") {
+            if (value == "ns") {
+                config.protocol.timestamp_divisor = 1000000;
+            } else if (value == "us") {
+                config.protocol.timestamp_divisor = 1000;
+            } else if (value != "ms") {
+                usage();
+                return 1;
+            }
+        } else {
+            usage();
+            return 1;
+        }
+    }
+
+    auto manager = std::make_shared<TableManager>(data_dir);
+    if (memory_mb > 0) {
+        manager->setGlobalMemoryLimit(memory_mb * 1024 * 1024);
+    }
+
+    server::IngestServer ingest(manager, config);
+    if (!ingest.start()) {
+        return 1;
+    }
+    std::cout << "Listening on " << config.bind_address << " tcp:" << ingest.tcpPort()
+              << " udp:" << ingest.udpPort() << std::endl;
+
+    server::MetricsServerConfig metrics_config;
+    metrics_config.bind_address = config.bind_address;
+    metrics_config.port = metrics_port;
+    server::MetricsServer metrics(manager->getMetricsRegistry(), metrics_config);
+    if (metrics_port >= 0) {
+        if (!metrics.start()) {
+            return 1;
+        }
+        std::cout << "Metrics at http://" << config.bind_address << ":" << metrics.port()
+                  << "/metrics" << std::endl;
+    }
+
+    cluster::ShardServerConfig shard_config;
+    shard_config.bind_address = config.bind_address;
+    shard_config.port = shard_port;
+    shard_config.table_config = config.table_config;
+    cluster::ShardServer shard(manager, shard_config);
+    if (replicate) {
+        shard.setReplicationLog(std::make_shared<cluster::ReplicationLog>(manager));
+    }
+    if (shard_port >= 0) {
+        if (!shard.start()) {
+            return 1;
+        }
+        std::cout << "Shard RPCs on " << config.bind_address << ":" << shard.port() << std::endl;
+    }
+
+    cluster::FollowerConfig follower_config;
+    follower_config.table_config = config.table_config;
+    size_t colon = follow.rfind(':');
+    if (!follow.empty()) {
+        if (colon == std::string::npos) {
+            usage();
+            return 1;
+        }
+        follower_config.leader_host = follow.substr(0, colon);
+        follower_config.leader_port = std::atoi(follow.c_str() + colon + 1);
+    }
+    cluster::ReplicaFollower follower(manager, follower_config);
+    if (!follow.empty()) {
+        follower.start();
+        std::cout << "Following " << follow << std::endl;
+    }
+
+    std::signal(SIGINT, on_signal);
+    std::signal(SIGTERM, on_signal);
+
+    auto last_report = std::chrono::steady_clock::now();
+    while (!g_stop) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        auto now = std::chrono::steady_clock::now();
+        if (now - last_report < std::chrono::seconds(10)) {
+            continue;
+        }
+        last_report = now;
+        auto stats = ingest.getStats();
+        std::cout << "points=" << stats.points_written << " parse_errors=" << stats.parse_errors
+                  << " write_errors=" << stats.write_errors
+                  << " connections=" << stats.active_connections
+                  << (stats.paused ? " (paused: memory budget)" : "") << std::endl;
+        for (const auto& conn : ingest.getConnectionStats()) {
+            std::cout << "  #" << conn.id << " " << conn.peer << " "
+                      << static_cast<uint64_t>(conn.points_per_second()) << " points/s, "
+                      << static_cast<uint64_t>(conn.bytes_per_second()) << " bytes/s, "
+                      << conn.points_written << " written" << std::endl;
+        }
+    }
+
+    follower.stop();
+    shard.stop();
+    metrics.stop();
+    ingest.stop();
+    manager->flushAllTables();
+    return 0;
+}
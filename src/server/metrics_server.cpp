@@ -0,0 +1,183 @@
+#include "sage_tsdb/server/metrics_server.h"
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace sage_tsdb {
+namespace server {
+
+namespace {
+
+constexpr size_t kMaxRequestBytes = 8192;
+constexpr int kRequestTimeoutMs = 2000;         // Per read, so a stalled client cannot hang the loop
+
+void write_all(int fd, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return;
+        sent += static_cast<size_t>(n);
+    }
+}
+
+std::string response(const char* status, const char* content_type, const std::string& body) {
+    return std::string("HTTP/1.1 ") + status + "\r\nContent-Type: " + content_type +
+           "\r\nContent-Length: " + std::to_string(body.size()) +
+           "\r\nConnection: close\r\n\r\n" + body;
+}
+
+} // anonymous namespace
+
+MetricsServer::MetricsServer(std::shared_ptr<MetricsRegistry> registry, MetricsServerConfig config)
+    : registry_(std::move(registry)), config_(std::move(config)) {}
+
+MetricsServer::~MetricsServer() {
+    stop();
+}
+
+void MetricsServer::fail(const std::string& message) {
+    std::cerr << "MetricsServer: " << message << std::endl;
+    std::lock_guard<std::mutex> lock(error_mutex_);
+    last_error_ = message;
+}
+
+std::string MetricsServer::lastError() const {
+    std::lock_guard<std::mutex> lock(error_mutex_);
+    return last_error_;
+}
+
+bool MetricsServer::start() {
+    if (running_.load()) {
+        return true;
+    }
+    if (!registry_) {
+        fail("no metrics registry");
+        return false;
+    }
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(config_.port));
+    if (inet_pton(AF_INET, config_.bind_address.c_str(), &addr.sin_addr) != 1) {
+        fail("invalid bind address " + config_.bind_address);
+        return false;
+    }
+
+    auto cleanup = [this](const std::string& what) {
+        fail(what + ": " + std::strerror(errno));
+        for (int* fd : {&listen_fd_, &wake_fd_}) {
+            if (*fd >= 0) {
+                ::close(*fd);
+                *fd = -1;
+            }
+        }
+        port_ = -1;
+        return false;
+    };
+
+    wake_fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd_ < 0) return cleanup("eventfd");
+    listen_fd_ = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0) return cleanup("socket");
+    int one = 1;
+    ::setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (::bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        return cleanup("port " + std::to_string(config_.port));
+    }
+    if (::listen(listen_fd_, SOMAXCONN) != 0) return cleanup("listen");
+    sockaddr_in local{};
+    socklen_t len = sizeof(local);
+    if (::getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&local), &len) != 0) {
+        return cleanup("getsockname");
+    }
+    port_ = ntohs(local.sin_port);
+
+    running_.store(true);
+    thread_ = std::thread(&MetricsServer::run, this);
+    return true;
+}
+
+void MetricsServer::stop() {
+    if (!running_.exchange(false)) {
+        return;
+    }
+    uint64_t one = 1;
+    [[maybe_unused]] ssize_t n = ::write(wake_fd_, &one, sizeof(one));
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    ::close(listen_fd_);
+    ::close(wake_fd_);
+    listen_fd_ = wake_fd_ = -1;
+    port_ = -1;
+}
+
+void MetricsServer::run() {
+    pollfd fds[2] = {{listen_fd_, POLLIN, 0}, {wake_fd_, POLLIN, 0}};
+    while (running_.load()) {
+        if (::poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            fail(std::string("poll: ") + std::strerror(errno));
+            break;
+        }
+        if (fds[1].revents) {
+            break;  // running_ is already false
+        }
+        while (true) {
+            int fd = ::accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd < 0) break;
+            serve(fd);
+            ::close(fd);
+        }
+    }
+}
+
+void MetricsServer::serve(int fd) {
+    // Read up to the end of the request headers; a scrape has no body
+    std::string request;
+    char buffer[1024];
+    while (request.find("\r\n\r\n") == std::string::npos && request.size() < kMaxRequestBytes) {
+        pollfd pfd{fd, POLLIN, 0};
+        if (::poll(&pfd, 1, kRequestTimeoutMs) <= 0) return;
+        ssize_t n = ::recv(fd, buffer, sizeof(buffer), 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        request.append(buffer, static_cast<size_t>(n));
+    }
+
+    size_t line_end = request.find("\r\n");
+    std::string line = request.substr(0, line_end);
+    size_t method_end = line.find(' ');
+    size_t path_end = method_end == std::string::npos ? std::string::npos
+                                                      : line.find(' ', method_end + 1);
+    if (line_end == std::string::npos || path_end == std::string::npos) {
+        write_all(fd, response("400 Bad Request", "text/plain", "bad request\n"));
+        return;
+    }
+    std::string method = line.substr(0, method_end);
+    std::string path = line.substr(method_end + 1, path_end - method_end - 1);
+    path = path.substr(0, path.find('?'));
+
+    if (path != "/metrics") {
+        write_all(fd, response("404 Not Found", "text/plain", "not found\n"));
+    } else if (method != "GET" && method != "HEAD") {
+        write_all(fd, response("405 Method Not Allowed", "text/plain", "method not allowed\n"));
+    } else {
+        std::string out = response("200 OK", "text/plain; version=0.0.4; charset=utf-8",
+                                   registry_->exportPrometheus());
+        if (method == "HEAD") {
+            out.resize(out.find("\r\n\r\n") + 4);
+        }
+        write_all(fd, out);
+    }
+}
+
+} // namespace server
+} // namespace sage_tsdb
@@ -0,0 +1,422 @@
+#include "sage_tsdb/utils/csv_data_loader.h"
+#include "sage_tsdb/core/mapped_file.h"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <iterator>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace sage_tsdb {
+namespace utils {
+
+namespace {
+
+constexpr size_t kMinChunkBytes = 1 << 20;  // Smaller files are parsed by one thread
+constexpr size_t kPECJColumns = 4;
+
+/**
+ * @brief First c in [p, end), or end
+ */
+const char* findByte(const char* p, const char* end, char c) {
+#if defined(__AVX2__)
+    const __m256i needle = _mm256_set1_epi8(c);
+    for (; end - p >= 32; p += 32) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, needle)));
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+#elif defined(__SSE2__)
+    const __m128i needle = _mm_set1_epi8(c);
+    for (; end - p >= 16; p += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        auto mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, needle)));
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+#endif
+    for (; p < end; ++p) {
+        if (*p == c) {
+            return p;
+        }
+    }
+    return end;
+}
+
+/**
+ * @brief Calls fn(line) for each line of [p, end) until it returns false
+ *
+ * Lines exclude '\n' and a trailing '\r'. Returns the lines visited.
+ */
+template <typename Fn>
+size_t forEachLine(const char* p, const char* end, Fn&& fn) {
+    size_t lines = 0;
+    while (p < end) {
+        const char* eol = findByte(p, end, '\n');
+        const char* last = (eol > p && eol[-1] == '\r') ? eol - 1 : eol;
+        lines++;
+        if (!fn(std::string_view(p, static_cast<size_t>(last - p)))) {
+            break;
+        }
+        p = eol + 1;
+    }
+    return lines;
+}
+
+/**
+ * @brief Splits line at commas into at most max fields
+ * @return Number of fields in the line, which may exceed max
+ */
+size_t splitFields(std::string_view line, std::string_view* fields, size_t max) {
+    const char* p = line.data();
+    const char* end = p + line.size();
+    size_t count = 0;
+    for (;;) {
+        const char* comma = findByte(p, end, ',');
+        if (count < max) {
+            fields[count] = std::string_view(p, static_cast<size_t>(comma - p));
+        }
+        count++;
+        if (comma == end) {
+            return count;
+        }
+        p = comma + 1;
+    }
+}
+
+std::string_view trim(std::string_view text) {
+    while (!text.empty() && (text.front() == ' ' || text.front() == '\t')) {
+        text.remove_prefix(1);
+    }
+    while (!text.empty() && (text.back() == ' ' || text.back() == '\t')) {
+        text.remove_suffix(1);
+    }
+    if (!text.empty() && text.front() == '+') {
+        text.remove_prefix(1);  // Accepted by stod/stoull, not by from_chars
+    }
+    return text;
+}
+
+bool parseDouble(std::string_view text, double& value) {
+    text = trim(text);
+    auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return ec == std::errc() && ptr == text.data() + text.size() && !text.empty();
+}
+
+/**
+ * @brief Integer field; a fractional part is dropped, as std::stoull did
+ */
+template <typename T>
+bool parseInteger(std::string_view text, T& value) {
+    text = trim(text);
+    auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (ec != std::errc()) {
+        return false;
+    }
+    std::string_view rest(ptr, static_cast<size_t>(text.data() + text.size() - ptr));
+    return rest.empty() || rest.front() == '.';
+}
+
+/**
+ * @brief Rows of one newline-aligned chunk
+ */
+template <typename Row>
+struct ChunkResult {
+    std::vector<Row> rows;
+    size_t lines = 0;
+    std::vector<std::pair<size_t, std::string>> errors;  // (1-based line in chunk, message)
+};
+
+/**
+ * @brief Parse [begin, end) in newline-aligned chunks on up to threads threads
+ *
+ * parse(line, rows) appends the rows of one line and returns an error
+ * message, or nullptr. With stop_on_error a chunk stops at its first error.
+ */
+template <typename Row, typename Parse>
+std::vector<ChunkResult<Row>> parseChunks(const char* begin, const char* end, size_t threads,
+                                          bool stop_on_error, const Parse& parse) {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    size_t size = static_cast<size_t>(end - begin);
+    size_t parts = std::max<size_t>(1, std::min(threads, size / kMinChunkBytes));
+
+    std::vector<const char*> bounds{begin};
+    for (size_t i = 1; i < parts; ++i) {
+        const char* cut = std::max(begin + size * i / parts, bounds.back());
+        cut = findByte(cut, end, '\n');
+        bounds.push_back(cut == end ? end : cut + 1);
+    }
+    bounds.push_back(end);
+
+    std::vector<ChunkResult<Row>> chunks(parts);
+    auto work = [&](size_t i) {
+        ChunkResult<Row>& chunk = chunks[i];
+        // ~30 bytes per PECJ row
+        chunk.rows.reserve(static_cast<size_t>(bounds[i + 1] - bounds[i]) / 24);
+        size_t line_number = 0;
+        chunk.lines = forEachLine(bounds[i], bounds[i + 1], [&](std::string_view line) {
+            line_number++;
+            if (const char* error = parse(line, chunk.rows)) {
+                chunk.errors.emplace_back(line_number, error);
+                return !stop_on_error;
+            }
+            return true;
+        });
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < parts; ++i) {
+        workers.emplace_back(work, i);
+    }
+    work(0);
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    return chunks;
+}
+
+template <typename Row>
+std::vector<Row> concatenate(std::vector<ChunkResult<Row>>& chunks) {
+    if (chunks.size() == 1) {
+        return std::move(chunks.front().rows);
+    }
+    size_t total = 0;
+    for (const auto& chunk : chunks) {
+        total += chunk.rows.size();
+    }
+    std::vector<Row> rows;
+    rows.reserve(total);
+    for (auto& chunk : chunks) {
+        std::move(chunk.rows.begin(), chunk.rows.end(), std::back_inserter(rows));
+        chunk.rows = std::vector<Row>();
+    }
+    return rows;
+}
+
+/**
+ * @brief Map path; null for an empty file
+ * @throw std::runtime_error if it cannot be opened
+ */
+std::shared_ptr<MappedFile> mapFile(const std::string& path) {
+    auto file = MappedFile::open(path);
+    if (!file) {
+        std::error_code ec;
+        if (std::filesystem::is_regular_file(path, ec) && std::filesystem::file_size(path, ec) == 0) {
+            return nullptr;
+        }
+        throw std::runtime_error("Failed to open file: " + path);
+    }
+    return file;
+}
+
+const char* parseTuple(std::string_view line, PECJTuple& tuple) {
+    std::string_view fields[kPECJColumns];
+    if (splitFields(line, fields, kPECJColumns) != kPECJColumns) {
+        return "Invalid CSV format. Expected 4 columns (key,value,eventTime,arrivalTime)";
+    }
+    if (!parseInteger(fields[0], tuple.key) || !parseDouble(fields[1], tuple.value) ||
+        !parseInteger(fields[2], tuple.eventTime) || !parseInteger(fields[3], tuple.arrivalTime)) {
+        return "Failed to parse numeric values";
+    }
+    return nullptr;
+}
+
+bool skipped(std::string_view line) {
+    return line.empty() || line.front() == '#';  // Empty lines and comments
+}
+
+/**
+ * @brief Rows of a PECJ CSV file with a header naming its columns
+ *
+ * make(record) turns each parsed record into a Row. Malformed rows are
+ * reported and skipped.
+ */
+template <typename Row, typename Make>
+std::vector<Row> loadRecords(const std::string& filename, int64_t time_unit_multiplier,
+                             size_t threads, const Make& make) {
+    std::shared_ptr<MappedFile> file;
+    try {
+        file = mapFile(filename);
+    } catch (const std::exception&) {
+        std::cerr << "❌ Failed to open file: " << filename << std::endl;
+        return {};
+    }
+    if (!file) {
+        std::cout << "✓ Loaded 0 records from " << filename << std::endl;
+        return {};
+    }
+
+    const char* p = reinterpret_cast<const char*>(file->data());
+    const char* end = p + file->size();
+
+    // Column indices (default for PECJ format), from the first non-empty line
+    size_t idx_key = 0, idx_value = 1, idx_event_time = 2, idx_arrival_time = 3;
+    size_t header_lines = 0;
+    const char* body = end;
+    forEachLine(p, end, [&](std::string_view line) {
+        header_lines++;
+        if (line.empty()) {
+            return true;
+        }
+        std::vector<std::string_view> names(splitFields(line, nullptr, 0));
+        splitFields(line, names.data(), names.size());
+        for (size_t i = 0; i < names.size(); i++) {
+            if (names[i] == "key") idx_key = i;
+            else if (names[i] == "value") idx_value = i;
+            else if (names[i] == "eventTime") idx_event_time = i;
+            else if (names[i] == "arrivalTime" || names[i] == "arriveTime") idx_arrival_time = i;
+        }
+        body = std::min(end, line.data() + line.size() + 1);
+        if (body < end && *(body - 1) == '\r') {
+            body++;
+        }
+        return false;
+    });
+    const size_t columns = std::max({idx_key, idx_value, idx_event_time, idx_arrival_time,
+                                     kPECJColumns - 1}) + 1;
+    const auto multiplier = static_cast<double>(time_unit_multiplier);
+
+    auto chunks = parseChunks<Row>(body, end, threads, false,
+        [&](std::string_view line, std::vector<Row>& rows) -> const char* {
+            if (line.empty()) {
+                return nullptr;
+            }
+            std::string_view fields[16];
+            std::vector<std::string_view> wide;
+            std::string_view* slots = fields;
+            if (columns > 16) {
+                wide.resize(columns);
+                slots = wide.data();
+            }
+            size_t count = splitFields(line, slots, columns);
+            if (count < kPECJColumns || count < columns) {
+                return "invalid line";
+            }
+            CSVRecord record;
+            double event_time;
+            double arrival_time;
+            if (!parseInteger(slots[idx_key], record.key) ||
+                !parseDouble(slots[idx_value], record.value) ||
+                !parseDouble(slots[idx_event_time], event_time) ||
+                !parseDouble(slots[idx_arrival_time], arrival_time)) {
+                return "malformed number";
+            }
+            // Apply time unit conversion (e.g., milliseconds to microseconds)
+            record.event_time = static_cast<int64_t>(event_time * multiplier);
+            record.arrival_time = static_cast<int64_t>(arrival_time * multiplier);
+            rows.push_back(make(record));
+            return nullptr;
+        });
+
+    size_t first_line = header_lines;
+    for (const auto& chunk : chunks) {
+        for (const auto& [line, message] : chunk.errors) {
+            std::cerr << "⚠ Skipping line " << first_line + line << ": " << message << std::endl;
+        }
+        first_line += chunk.lines;
+    }
+    auto rows = concatenate(chunks);
+    std::cout << "✓ Loaded " << rows.size() << " records from " << filename << std::endl;
+    return rows;
+}
+
+} // anonymous namespace
+
+std::vector<PECJTuple> CSVDataLoader::loadAll() {
+    auto file = mapFile(filepath_);
+    if (!file) {
+        return {};
+    }
+    const char* p = reinterpret_cast<const char*>(file->data());
+    const char* end = p + file->size();
+
+    size_t first_line = 0;
+    if (skip_header_) {
+        const char* eol = findByte(p, end, '\n');
+        p = eol == end ? end : eol + 1;
+        first_line = 1;
+    }
+
+    auto chunks = parseChunks<PECJTuple>(p, end, threads_, true,
+        [](std::string_view line, std::vector<PECJTuple>& tuples) -> const char* {
+            if (skipped(line)) {
+                return nullptr;
+            }
+            PECJTuple tuple;
+            if (const char* error = parseTuple(line, tuple)) {
+                return error;
+            }
+            tuples.push_back(tuple);
+            return nullptr;
+        });
+
+    // Report the first error in file order
+    for (const auto& chunk : chunks) {
+        if (!chunk.errors.empty()) {
+            throw std::runtime_error(
+                "Parse error at line " + std::to_string(first_line + chunk.errors.front().first) +
+                " in file " + filepath_ + ": " + chunk.errors.front().second);
+        }
+        first_line += chunk.lines;
+    }
+    return concatenate(chunks);
+}
+
+size_t CSVDataLoader::loadStream(std::function<void(const PECJTuple&)> callback,
+                                 size_t max_tuples) {
+    auto file = mapFile(filepath_);
+    if (!file) {
+        return 0;
+    }
+    const char* p = reinterpret_cast<const char*>(file->data());
+    const char* end = p + file->size();
+
+    size_t line_number = 0;
+    size_t tuple_count = 0;
+    forEachLine(p, end, [&](std::string_view line) {
+        line_number++;
+        if ((skip_header_ && line_number == 1) || skipped(line)) {
+            return true;
+        }
+        PECJTuple tuple;
+        if (const char* error = parseTuple(line, tuple)) {
+            throw std::runtime_error(
+                "Parse error at line " + std::to_string(line_number) +
+                " in file " + filepath_ + ": " + error);
+        }
+        callback(tuple);
+        tuple_count++;
+        return max_tuples == 0 || tuple_count < max_tuples;
+    });
+    return tuple_count;
+}
+
+std::vector<CSVRecord> CSVDataLoader::loadFromFile(const std::string& filename,
+                                                   int64_t time_unit_multiplier, size_t threads) {
+    return loadRecords<CSVRecord>(filename, time_unit_multiplier, threads,
+                                  [](const CSVRecord& record) { return record; });
+}
+
+std::vector<TimeSeriesData> CSVDataLoader::loadTimeSeries(const std::string& filename,
+                                                          const std::string& stream_name,
+                                                          int64_t time_unit_multiplier,
+                                                          size_t threads) {
+    return loadRecords<TimeSeriesData>(filename, time_unit_multiplier, threads,
+        [&](const CSVRecord& record) { return toTimeSeriesData(record, stream_name); });
+}
+
+} // namespace utils
+} // namespace sage_tsdb
@@ -0,0 +1,278 @@
+#include "sage_tsdb/core/aggregation.h"
+#include "sage_tsdb/core/simd.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace sage_tsdb {
+namespace test {
+
+class ColumnKernelsTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        for (size_t i = 0; i < 1003; ++i) {
+            timestamps_.push_back(1000 + static_cast<int64_t>(i) * 10);
+            values_.push_back(std::sin(static_cast<double>(i)) * 100.0 + (i % 7));
+        }
+    }
+
+    static void expect_same(const BlockSummary& actual, const BlockSummary& expected) {
+        ASSERT_EQ(actual.count, expected.count);
+        EXPECT_NEAR(actual.sum, expected.sum, 1e-9 * std::abs(expected.sum) + 1e-9);
+        EXPECT_NEAR(actual.sum_squares, expected.sum_squares, 1e-9 * expected.sum_squares);
+        EXPECT_EQ(actual.min, expected.min);
+        EXPECT_EQ(actual.max, expected.max);
+        EXPECT_EQ(actual.first_timestamp, expected.first_timestamp);
+        EXPECT_EQ(actual.first, expected.first);
+        EXPECT_EQ(actual.last_timestamp, expected.last_timestamp);
+        EXPECT_EQ(actual.last, expected.last);
+    }
+
+    std::vector<int64_t> timestamps_;
+    std::vector<double> values_;
+};
+
+TEST_F(ColumnKernelsTest, SummarizeMatchesSequentialAdds) {
+    // Lengths around every lane width, including the remainder loop
+    for (size_t count : std::vector<size_t>{0, 1, 3, 4, 7, 8, 9, 17, 1003}) {
+        BlockSummary expected;
+        for (size_t i = 0; i < count; ++i) {
+            expected.add(timestamps_[i], values_[i]);
+        }
+        expect_same(column_kernels::summarize(timestamps_.data(), values_.data(), count), expected);
+    }
+}
+
+TEST_F(ColumnKernelsTest, SummarizeRowsGathersSelectedValues) {
+    std::vector<uint32_t> rows;
+    for (uint32_t i = 2; i < values_.size(); i += 3) {
+        rows.push_back(i);
+    }
+    for (size_t count : std::vector<size_t>{0, 1, 5, 8, 13, rows.size()}) {
+        BlockSummary expected;
+        for (size_t i = 0; i < count; ++i) {
+            expected.add(timestamps_[rows[i]], values_[rows[i]]);
+        }
+        expect_same(column_kernels::summarize_rows(timestamps_.data(), values_.data(),
+                                                   rows.data(), count), expected);
+    }
+}
+
+// Every vector level this CPU runs gives the scalar kernel's summary
+TEST_F(ColumnKernelsTest, VectorLevelsMatchScalar) {
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    std::vector<double> with_nan = values_;
+    for (size_t i : {0, 5, 12, 40, 41, 1002}) {
+        with_nan[i] = nan;
+    }
+    std::vector<uint32_t> rows;
+    for (uint32_t i = 0; i < values_.size(); i += 2) {
+        rows.push_back(i);
+    }
+
+    struct Case {
+        const std::vector<double>* values;
+        bool gather;
+    };
+    auto run = [&](const Case& c, size_t count) {
+        return c.gather ? column_kernels::summarize_rows(timestamps_.data(), c.values->data(),
+                                                         rows.data(), count)
+                        : column_kernels::summarize(timestamps_.data(), c.values->data(), count);
+    };
+    auto same = [](double a, double b) { return a == b || (std::isnan(a) && std::isnan(b)); };
+
+    const simd::Level saved = simd::active();
+    std::vector<size_t> counts;
+    for (size_t count = 0; count <= 33; ++count) {
+        counts.push_back(count);
+    }
+    counts.push_back(rows.size());
+    for (const Case& c : {Case{&values_, false}, Case{&with_nan, false},
+                          Case{&values_, true}, Case{&with_nan, true}}) {
+        for (size_t count : counts) {
+            simd::set_level(simd::Level::Scalar);
+            BlockSummary expected = run(c, count);
+            for (simd::Level level : {simd::Level::AVX2, simd::Level::AVX512}) {
+                if (simd::set_level(level) != level) {
+                    continue;  // Not supported here
+                }
+                BlockSummary actual = run(c, count);
+                SCOPED_TRACE(std::string(simd::name(level)) + " count " + std::to_string(count) +
+                             (c.gather ? " rows" : "") +
+                             (c.values == &with_nan ? " nan" : ""));
+                ASSERT_EQ(actual.count, expected.count);
+                if (std::isnan(expected.sum)) {
+                    EXPECT_TRUE(std::isnan(actual.sum));
+                    EXPECT_TRUE(std::isnan(actual.sum_squares));
+                } else {
+                    EXPECT_NEAR(actual.sum, expected.sum, 1e-9 * std::abs(expected.sum) + 1e-9);
+                    EXPECT_NEAR(actual.sum_squares, expected.sum_squares,
+                                1e-9 * expected.sum_squares);
+                }
+                EXPECT_TRUE(same(actual.min, expected.min)) << actual.min << " " << expected.min;
+                EXPECT_TRUE(same(actual.max, expected.max)) << actual.max << " " << expected.max;
+                EXPECT_TRUE(same(actual.first, expected.first));
+                EXPECT_TRUE(same(actual.last, expected.last));
+                EXPECT_EQ(actual.first_timestamp, expected.first_timestamp);
+                EXPECT_EQ(actual.last_timestamp, expected.last_timestamp);
+            }
+        }
+    }
+    simd::set_level(saved);
+}
+
+TEST(SimdTest, LevelIsCappedAtTheDetectedOne) {
+    const simd::Level saved = simd::active();
+    EXPECT_LE(saved, simd::detected());
+    EXPECT_EQ(simd::set_level(simd::Level::Scalar), simd::Level::Scalar);
+    EXPECT_EQ(simd::active(), simd::Level::Scalar);
+    EXPECT_EQ(simd::set_level(simd::Level::AVX512), simd::detected());
+    EXPECT_STREQ(simd::name(simd::Level::AVX2), "avx2");
+    simd::set_level(saved);
+}
+
+TEST_F(ColumnKernelsTest, SummaryValuePerAggregationType) {
+    BlockSummary summary = column_kernels::summarize(timestamps_.data(), values_.data(), 4);
+    double mean = (values_[0] + values_[1] + values_[2] + values_[3]) / 4;
+    EXPECT_EQ(summary.value(AggregationType::COUNT), 4.0);
+    EXPECT_NEAR(summary.value(AggregationType::AVG), mean, 1e-9);
+    EXPECT_EQ(summary.value(AggregationType::FIRST), values_[0]);
+    EXPECT_EQ(summary.value(AggregationType::LAST), values_[3]);
+    EXPECT_TRUE(std::isnan(BlockSummary().value(AggregationType::MIN)));
+}
+
+TEST(SketchTest, QuantilesWithinRankError) {
+    QuantileSketch sketch;
+    for (int i = 0; i < 100000; ++i) {
+        sketch.add(static_cast<double>((i * 7919) % 100000));
+    }
+    EXPECT_EQ(sketch.count(), 100000u);
+    EXPECT_EQ(sketch.quantile(0.0), 0.0);
+    EXPECT_EQ(sketch.quantile(1.0), 99999.0);
+    EXPECT_NEAR(sketch.quantile(0.5), 50000.0, 1000.0);
+    // Tails are much tighter than the middle
+    EXPECT_NEAR(sketch.quantile(0.99), 99000.0, 100.0);
+    EXPECT_NEAR(sketch.quantile(0.999), 99900.0, 20.0);
+    EXPECT_TRUE(std::isnan(QuantileSketch().quantile(0.5)));
+}
+
+TEST(SketchTest, MergedQuantilesMatchOneSketch) {
+    QuantileSketch whole;
+    std::vector<QuantileSketch> parts(10);
+    for (int i = 0; i < 50000; ++i) {
+        double value = std::sin(i) * 1000.0;
+        whole.add(value);
+        parts[i % parts.size()].add(value);
+    }
+    QuantileSketch merged;
+    for (const auto& part : parts) {
+        merged.merge(part);
+    }
+    EXPECT_EQ(merged.count(), whole.count());
+    for (double q : {0.01, 0.25, 0.5, 0.75, 0.99}) {
+        EXPECT_NEAR(merged.quantile(q), whole.quantile(q), 20.0) << q;
+    }
+}
+
+TEST(SketchTest, DistinctCountsEstimate) {
+    DistinctSketch sketch;
+    for (int round = 0; round < 3; ++round) {
+        for (int i = 0; i < 20000; ++i) {
+            sketch.add(static_cast<double>(i));
+        }
+    }
+    EXPECT_NEAR(sketch.estimate(), 20000.0, 20000.0 * 0.05);
+
+    DistinctSketch small;
+    for (double value : {1.0, 2.0, 2.0, 3.0, 0.0, -0.0}) {
+        small.add(value);
+    }
+    EXPECT_NEAR(small.estimate(), 4.0, 0.1);
+    EXPECT_EQ(DistinctSketch().estimate(), 0.0);
+}
+
+TEST(SketchTest, DistinctMergeIsUnion) {
+    DistinctSketch a, b, both;
+    for (int i = 0; i < 3000; ++i) {
+        a.add(i);
+        both.add(i);
+    }
+    for (int i = 2000; i < 6000; ++i) {
+        b.add(i);
+        both.add(i);
+    }
+    a.merge(b);
+    EXPECT_EQ(a.estimate(), both.estimate());
+    EXPECT_NEAR(a.estimate(), 6000.0, 6000.0 * 0.05);
+}
+
+TEST(SketchTest, SketchesRoundTrip) {
+    QuantileSketch quantiles;
+    DistinctSketch sparse, dense;
+    for (int i = 0; i < 5000; ++i) {
+        quantiles.add(i * 0.5);
+        dense.add(i);
+        if (i < 100) sparse.add(i);
+    }
+
+    std::vector<uint8_t> bytes;
+    quantiles.serialize(bytes);
+    sparse.serialize(bytes);
+    dense.serialize(bytes);
+    std::vector<double> values;
+    quantiles.encode(values);
+    sparse.encode(values);
+    dense.encode(values);
+
+    QuantileSketch q1, q2;
+    DistinctSketch s1, s2, d1, d2;
+    const uint8_t* ptr = bytes.data();
+    ASSERT_TRUE(q1.deserialize(ptr, bytes.data() + bytes.size()));
+    ASSERT_TRUE(s1.deserialize(ptr, bytes.data() + bytes.size()));
+    ASSERT_TRUE(d1.deserialize(ptr, bytes.data() + bytes.size()));
+    EXPECT_EQ(ptr, bytes.data() + bytes.size());
+    const double* at = values.data();
+    ASSERT_TRUE(q2.decode(at, values.data() + values.size()));
+    ASSERT_TRUE(s2.decode(at, values.data() + values.size()));
+    ASSERT_TRUE(d2.decode(at, values.data() + values.size()));
+    EXPECT_EQ(at, values.data() + values.size());
+
+    for (const auto* copy : {&q1, &q2}) {
+        EXPECT_EQ(copy->count(), quantiles.count());
+        EXPECT_DOUBLE_EQ(copy->quantile(0.9), quantiles.quantile(0.9));
+    }
+    EXPECT_EQ(s1.estimate(), sparse.estimate());
+    EXPECT_EQ(s2.estimate(), sparse.estimate());
+    EXPECT_EQ(d1.estimate(), dense.estimate());
+    EXPECT_EQ(d2.estimate(), dense.estimate());
+
+    // Truncated input is rejected
+    ptr = bytes.data();
+    EXPECT_FALSE(q1.deserialize(ptr, bytes.data() + 10));
+}
+
+TEST(SketchTest, BlockSummaryAnswersSketchAggregations) {
+    BlockSummary first, second;
+    for (int i = 0; i < 1000; ++i) {
+        (i < 500 ? first : second).add(i, static_cast<double>(i % 100));
+    }
+    first.merge(second);
+    EXPECT_NEAR(first.value(AggregationType::QUANTILE, 0.5), 49.5, 2.0);
+    EXPECT_NEAR(first.value(AggregationType::DISTINCT), 100.0, 2.0);
+
+    // Moments-only summaries cannot answer them
+    BlockSummary kernel = column_kernels::summarize(nullptr, nullptr, 0);
+    double value = 1.0;
+    int64_t timestamp = 0;
+    kernel = column_kernels::summarize(&timestamp, &value, 1);
+    EXPECT_FALSE(kernel.sketched);
+    EXPECT_TRUE(std::isnan(kernel.value(AggregationType::QUANTILE)));
+    first.merge(kernel);
+    EXPECT_FALSE(first.sketched);
+    EXPECT_TRUE(std::isnan(first.value(AggregationType::DISTINCT)));
+    EXPECT_EQ(first.count, 1001u);
+}
+
+} // namespace test
+} // namespace sage_tsdb
@@ -0,0 +1,109 @@
+#include "sage_tsdb/core/arena.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace sage_tsdb {
+namespace test {
+
+TEST(ArenaTest, AllocationsAreAlignedAndDisjoint) {
+    Arena arena;
+    std::vector<std::pair<char*, size_t>> chunks;
+    for (size_t i = 0; i < 2000; ++i) {
+        size_t bytes = 1 + (i * 37) % 200;
+        size_t alignment = size_t{1} << (i % 7);
+        auto* chunk = static_cast<char*>(arena.allocate(bytes, alignment));
+        ASSERT_EQ(reinterpret_cast<uintptr_t>(chunk) % alignment, 0u);
+        std::memset(chunk, static_cast<int>(i), bytes);
+        chunks.emplace_back(chunk, bytes);
+    }
+
+    std::sort(chunks.begin(), chunks.end());
+    for (size_t i = 1; i < chunks.size(); ++i) {
+        EXPECT_LE(chunks[i - 1].first + chunks[i - 1].second, chunks[i].first);
+    }
+    // ~200KB handed out over several blocks
+    EXPECT_GE(arena.memory_usage(), 2 * Arena::kBlockSize);
+}
+
+TEST(ArenaTest, LargeRequestsGetTheirOwnBlock) {
+    Arena arena;
+    arena.allocate(16);
+    size_t before = arena.memory_usage();
+
+    auto* large = static_cast<char*>(arena.allocate(Arena::kBlockSize * 2));
+    std::memset(large, 1, Arena::kBlockSize * 2);
+    EXPECT_GE(arena.memory_usage(), before + Arena::kBlockSize * 2);
+
+    // The current block keeps serving small requests
+    arena.allocate(16);
+    EXPECT_LT(arena.memory_usage(), before + Arena::kBlockSize * 3);
+}
+
+TEST(ArenaTest, ResetReleasesEverything) {
+    Arena arena;
+    for (int i = 0; i < 100; ++i) {
+        arena.allocate(4096);
+    }
+    arena.allocate(Arena::kBlockSize);
+    EXPECT_GT(arena.memory_usage(), 0u);
+
+    arena.reset();
+    EXPECT_EQ(arena.memory_usage(), 0u);
+    EXPECT_NE(arena.allocate(64), nullptr);
+}
+
+TEST(ArenaTest, BlocksAreChargedToTheTracker) {
+    auto tracker = std::make_shared<MemoryTracker>();
+    {
+        Arena arena(tracker);
+        arena.allocate(64);
+        arena.allocate(Arena::kBlockSize);
+        EXPECT_EQ(tracker->usage(), arena.memory_usage());
+
+        arena.reset();
+        EXPECT_EQ(tracker->usage(), 0u);
+        arena.allocate(64);
+        EXPECT_GT(tracker->usage(), 0u);
+    }
+    EXPECT_EQ(tracker->usage(), 0u);
+    EXPECT_GT(tracker->peak(), Arena::kBlockSize * 2);
+}
+
+TEST(ArenaTest, ConcurrentAllocations) {
+    Arena arena;
+    constexpr int kThreads = 4;
+    constexpr int kPerThread = 5000;
+    std::vector<std::vector<uint64_t*>> allocated(kThreads);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < kPerThread; ++i) {
+                auto* slot = static_cast<uint64_t*>(arena.allocate(sizeof(uint64_t) * 3,
+                                                                   alignof(uint64_t)));
+                slot[0] = slot[1] = slot[2] = static_cast<uint64_t>(t) * kPerThread + i;
+                allocated[t].push_back(slot);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    // No slot was handed out twice
+    for (int t = 0; t < kThreads; ++t) {
+        for (int i = 0; i < kPerThread; ++i) {
+            uint64_t expected = static_cast<uint64_t>(t) * kPerThread + i;
+            const uint64_t* slot = allocated[t][i];
+            ASSERT_EQ(slot[0], expected);
+            ASSERT_EQ(slot[2], expected);
+        }
+    }
+}
+
+} // namespace test
+} // namespace sage_tsdb
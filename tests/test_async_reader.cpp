@@ -0,0 +1,106 @@
+#include "sage_tsdb/core/async_reader.h"
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace sage_tsdb {
+namespace test {
+
+class AsyncReaderTest : public ::testing::TestWithParam<AsyncReader::Backend> {
+protected:
+    void SetUp() override {
+        path_ = "./test_async_reader.bin";
+        std::ofstream out(path_, std::ios::binary);
+        for (size_t i = 0; i < kFileSize; ++i) {
+            out.put(static_cast<char>(byte_at(i)));
+        }
+        out.close();
+        fd_ = ::open(path_.c_str(), O_RDONLY);
+        ASSERT_GE(fd_, 0);
+
+        reader_ = AsyncReader::create(GetParam(), 8, 3);
+        if (!reader_) {
+            GTEST_SKIP() << "io_uring is not available";
+        }
+    }
+
+    void TearDown() override {
+        if (fd_ >= 0) ::close(fd_);
+        fs::remove(path_);
+    }
+
+    static constexpr size_t kFileSize = 1 << 20;
+    static uint8_t byte_at(size_t offset) { return static_cast<uint8_t>((offset * 131) >> 3); }
+
+    std::string path_;
+    int fd_ = -1;
+    std::shared_ptr<AsyncReader> reader_;
+};
+
+TEST_P(AsyncReaderTest, ReadsEveryRequestOfALargeBatch) {
+    // More requests than the queue depth, of varying sizes
+    std::vector<std::vector<uint8_t>> buffers;
+    std::vector<AsyncReader::Request> requests;
+    for (size_t i = 0; i < 100; ++i) {
+        buffers.emplace_back(1000 + i * 37);
+    }
+    for (size_t i = 0; i < buffers.size(); ++i) {
+        AsyncReader::Request request;
+        request.fd = fd_;
+        request.offset = (i * 7919) % (kFileSize - buffers[i].size());
+        request.buffer = buffers[i].data();
+        request.size = buffers[i].size();
+        requests.push_back(request);
+    }
+
+    std::vector<int> completed(requests.size(), 0);
+    reader_->read_batch(requests, [&](size_t i) { ++completed[i]; });
+
+    for (size_t i = 0; i < requests.size(); ++i) {
+        EXPECT_EQ(completed[i], 1) << i;
+        ASSERT_EQ(requests[i].result, static_cast<int64_t>(requests[i].size)) << i;
+        for (size_t b = 0; b < buffers[i].size(); ++b) {
+            ASSERT_EQ(buffers[i][b], byte_at(requests[i].offset + b)) << i << " " << b;
+        }
+    }
+}
+
+TEST_P(AsyncReaderTest, ReportsShortReadsAndErrors) {
+    std::vector<uint8_t> tail(4096), bad(16);
+    std::vector<AsyncReader::Request> requests(2);
+    requests[0].fd = fd_;
+    requests[0].offset = kFileSize - 100;
+    requests[0].buffer = tail.data();
+    requests[0].size = tail.size();
+    requests[1].fd = -1;
+    requests[1].buffer = bad.data();
+    requests[1].size = bad.size();
+
+    reader_->read_batch(requests, [](size_t) {});
+    EXPECT_EQ(requests[0].result, 100);
+    EXPECT_EQ(tail[99], byte_at(kFileSize - 1));
+    EXPECT_LT(requests[1].result, 0);
+}
+
+INSTANTIATE_TEST_SUITE_P(Backends, AsyncReaderTest,
+                         ::testing::Values(AsyncReader::Backend::ThreadPool,
+                                           AsyncReader::Backend::IoUring),
+                         [](const ::testing::TestParamInfo<AsyncReader::Backend>& info) {
+                             return info.param == AsyncReader::Backend::IoUring
+                                 ? std::string("IoUring") : std::string("ThreadPool");
+                         });
+
+TEST(AsyncReaderFactoryTest, AutoAlwaysYieldsAReader) {
+    auto reader = AsyncReader::create();
+    ASSERT_NE(reader, nullptr);
+    EXPECT_STREQ(reader->name(),
+                 AsyncReader::io_uring_available() ? "io_uring" : "thread_pool");
+}
+
+} // namespace test
+} // namespace sage_tsdb
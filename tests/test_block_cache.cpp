@@ -0,0 +1,93 @@
+#include "sage_tsdb/core/block_cache.h"
+#include <gtest/gtest.h>
+
+namespace sage_tsdb {
+namespace test {
+
+namespace {
+
+BlockCache::Value make_value(int v) {
+    return std::make_shared<const int>(v);
+}
+
+} // namespace
+
+TEST(BlockCacheTest, LookupAfterInsert) {
+    BlockCache cache(1024, 0);
+    cache.insert({1, 100}, make_value(7), 10);
+
+    auto value = cache.lookup_as<int>({1, 100});
+    ASSERT_NE(value, nullptr);
+    EXPECT_EQ(*value, 7);
+    EXPECT_EQ(cache.lookup({1, 200}), nullptr);
+    EXPECT_EQ(cache.lookup({2, 100}), nullptr);
+
+    auto stats = cache.get_stats();
+    EXPECT_EQ(stats.hits, 1u);
+    EXPECT_EQ(stats.misses, 2u);
+    EXPECT_EQ(stats.usage_bytes, 10u);
+}
+
+TEST(BlockCacheTest, EvictsLeastRecentlyUsed) {
+    BlockCache cache(100, 0);
+    cache.insert({1, 0}, make_value(0), 40);
+    cache.insert({1, 1}, make_value(1), 40);
+
+    // Touch the first entry so the second becomes the eviction victim
+    ASSERT_NE(cache.lookup({1, 0}), nullptr);
+    cache.insert({1, 2}, make_value(2), 40);
+
+    EXPECT_NE(cache.lookup({1, 0}), nullptr);
+    EXPECT_EQ(cache.lookup({1, 1}), nullptr);
+    EXPECT_NE(cache.lookup({1, 2}), nullptr);
+    EXPECT_LE(cache.get_stats().usage_bytes, 100u);
+    EXPECT_EQ(cache.get_stats().evictions, 1u);
+}
+
+TEST(BlockCacheTest, HighPriorityOutlivesDataBlocks) {
+    BlockCache cache(100, 0, 0.5);
+    cache.insert({1, 0}, make_value(0), 30, BlockCache::Priority::High);
+
+    for (int i = 1; i <= 10; ++i) {
+        cache.insert({1, static_cast<uint64_t>(i)}, make_value(i), 30);
+    }
+
+    EXPECT_NE(cache.lookup({1, 0}), nullptr);
+    EXPECT_EQ(cache.get_stats().high_priority_usage_bytes, 30u);
+}
+
+TEST(BlockCacheTest, EvictedValueStaysValidForHolder) {
+    BlockCache cache(50, 0);
+    cache.insert({1, 0}, make_value(42), 50);
+    auto held = cache.lookup_as<int>({1, 0});
+
+    cache.insert({1, 1}, make_value(1), 50);
+    EXPECT_EQ(cache.lookup({1, 0}), nullptr);
+    ASSERT_NE(held, nullptr);
+    EXPECT_EQ(*held, 42);
+}
+
+TEST(BlockCacheTest, EraseFileDropsOnlyThatFile) {
+    BlockCache cache(1024);
+    for (uint64_t offset = 0; offset < 8; ++offset) {
+        cache.insert({1, offset}, make_value(1), 8);
+        cache.insert({2, offset}, make_value(2), 8);
+    }
+
+    cache.erase_file(1);
+    for (uint64_t offset = 0; offset < 8; ++offset) {
+        EXPECT_EQ(cache.lookup({1, offset}), nullptr);
+        EXPECT_NE(cache.lookup({2, offset}), nullptr);
+    }
+    EXPECT_EQ(cache.get_stats().num_entries, 8u);
+}
+
+TEST(BlockCacheTest, OversizedValueIsNotCached) {
+    BlockCache cache(64, 0);
+    cache.insert({1, 0}, make_value(0), 65);
+    EXPECT_EQ(cache.lookup({1, 0}), nullptr);
+    EXPECT_EQ(cache.get_stats().usage_bytes, 0u);
+}
+
+} // namespace test
+} // namespace sage_tsdb
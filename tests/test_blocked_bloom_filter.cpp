@@ -0,0 +1,68 @@
+#include "sage_tsdb/core/blocked_bloom_filter.h"
+#include <gtest/gtest.h>
+#include <vector>
+
+namespace sage_tsdb {
+namespace test {
+
+TEST(BlockedBloomFilterTest, NoFalseNegatives) {
+    BlockedBloomFilter filter(10000);
+    for (uint64_t key = 0; key < 10000; ++key) {
+        filter.add(key * 7919);
+    }
+    for (uint64_t key = 0; key < 10000; ++key) {
+        EXPECT_TRUE(filter.might_contain(key * 7919));
+    }
+}
+
+TEST(BlockedBloomFilterTest, FalsePositiveRateIsLow) {
+    BlockedBloomFilter filter(10000, 10);
+    for (uint64_t key = 0; key < 10000; ++key) {
+        filter.add(key);
+    }
+
+    size_t false_positives = 0;
+    for (uint64_t key = 1000000; key < 1100000; ++key) {
+        false_positives += filter.might_contain(key) ? 1 : 0;
+    }
+    // About 1% at 10 bits per key; blocking costs a little accuracy
+    EXPECT_LT(false_positives, 2500u);
+}
+
+TEST(BlockedBloomFilterTest, SerializationRoundTrip) {
+    BlockedBloomFilter filter(100);
+    std::vector<uint64_t> keys = {1, 42, BlockedBloomFilter::tag_key("host", "a")};
+    for (uint64_t key : keys) {
+        filter.add(key);
+    }
+
+    std::vector<uint8_t> bytes;
+    filter.serialize(bytes);
+    EXPECT_EQ(bytes.size(), sizeof(uint32_t) + filter.size_bytes());
+
+    BlockedBloomFilter restored;
+    const uint8_t* ptr = bytes.data();
+    ASSERT_TRUE(restored.deserialize(ptr, bytes.data() + bytes.size()));
+    EXPECT_EQ(ptr, bytes.data() + bytes.size());
+    EXPECT_TRUE(restored.might_contain_all(keys));
+
+    // Truncated input is rejected
+    const uint8_t* short_ptr = bytes.data();
+    EXPECT_FALSE(restored.deserialize(short_ptr, bytes.data() + bytes.size() - 1));
+}
+
+TEST(BlockedBloomFilterTest, EmptyFilterMatchesEverything) {
+    BlockedBloomFilter filter;
+    EXPECT_TRUE(filter.empty());
+    EXPECT_TRUE(filter.might_contain(123));
+    EXPECT_TRUE(filter.might_contain_all({1, 2, 3}));
+}
+
+TEST(BlockedBloomFilterTest, TagKeysDependOnKeyAndValue) {
+    EXPECT_NE(BlockedBloomFilter::tag_key("host", "a"), BlockedBloomFilter::tag_key("host", "b"));
+    EXPECT_NE(BlockedBloomFilter::tag_key("ab", "c"), BlockedBloomFilter::tag_key("a", "bc"));
+    EXPECT_EQ(BlockedBloomFilter::tag_key("host", "a"), BlockedBloomFilter::tag_key("host", "a"));
+}
+
+} // namespace test
+} // namespace sage_tsdb
@@ -0,0 +1,102 @@
+#include "sage_tsdb/core/bulk_file.h"
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+namespace sage_tsdb {
+namespace test {
+
+class BulkFileTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        test_dir_ = "./test_bulk_file_data";
+        fs::remove_all(test_dir_);
+        fs::create_directories(test_dir_);
+    }
+
+    void TearDown() override {
+        fs::remove_all(test_dir_);
+    }
+
+    std::string test_dir_;
+};
+
+TEST_F(BulkFileTest, RoundTripAcrossFrames) {
+    std::vector<TimeSeriesData> points;
+    for (int64_t i = 0; i < 10000; ++i) {
+        TimeSeriesData point(i * 1000, static_cast<double>(i) * 0.5);
+        point.tags["host"] = "h" + std::to_string(i % 7);
+        if (i % 5 == 0) {
+            point.value = std::vector<double>{1.0, static_cast<double>(i)};
+        }
+        if (i % 3 == 0) {
+            point.fields["code"] = i;
+            point.fields["ok"] = i % 2 == 0;
+        }
+        points.push_back(std::move(point));
+    }
+    std::string path = test_dir_ + "/points.sblk";
+    ASSERT_TRUE(write_bulk_file(path, points));
+
+    std::vector<TimeSeriesData> read;
+    ASSERT_TRUE(read_bulk_file(path, read));
+    ASSERT_EQ(read.size(), points.size());
+    for (size_t i = 0; i < points.size(); ++i) {
+        EXPECT_EQ(read[i].timestamp, points[i].timestamp);
+        EXPECT_EQ(read[i].value, points[i].value);
+        EXPECT_EQ(read[i].tags, points[i].tags);
+        EXPECT_EQ(read[i].fields, points[i].fields);
+    }
+}
+
+TEST_F(BulkFileTest, FramesAreSortedByTimestamp) {
+    BulkFileWriter writer;
+    ASSERT_TRUE(writer.open(test_dir_ + "/unsorted.sblk"));
+    for (int64_t ts : {30, 10, 20, 10}) {
+        ASSERT_TRUE(writer.append(TimeSeriesData(ts, static_cast<double>(ts))));
+    }
+    ASSERT_TRUE(writer.close());
+    EXPECT_EQ(writer.points_written(), 4u);
+
+    BulkFileReader reader;
+    ASSERT_TRUE(reader.open(test_dir_ + "/unsorted.sblk"));
+    std::vector<TimeSeriesData> read;
+    ASSERT_TRUE(reader.next(read));
+    EXPECT_FALSE(reader.next(read));
+    EXPECT_FALSE(reader.corrupt());
+    ASSERT_EQ(read.size(), 4u);
+    EXPECT_EQ(read[0].timestamp, 10);
+    EXPECT_EQ(read[1].timestamp, 10);
+    EXPECT_EQ(read[3].timestamp, 30);
+}
+
+TEST_F(BulkFileTest, RejectsForeignAndCorruptFiles) {
+    std::string foreign = test_dir_ + "/foreign.sblk";
+    std::ofstream(foreign) << "key,value\n1,2\n";
+    BulkFileReader reader;
+    EXPECT_FALSE(reader.open(foreign));
+    EXPECT_FALSE(reader.open(test_dir_ + "/missing.sblk"));
+
+    std::vector<TimeSeriesData> points;
+    for (int64_t i = 0; i < 100; ++i) {
+        points.emplace_back(i, static_cast<double>(i));
+    }
+    std::string path = test_dir_ + "/corrupt.sblk";
+    ASSERT_TRUE(write_bulk_file(path, points));
+    {
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        char byte;
+        file.seekg(40);
+        file.get(byte);
+        file.seekp(40);
+        file.put(static_cast<char>(~byte));
+    }
+    std::vector<TimeSeriesData> read;
+    EXPECT_FALSE(read_bulk_file(path, read));
+    EXPECT_TRUE(read.empty());
+}
+
+} // namespace test
+} // namespace sage_tsdb
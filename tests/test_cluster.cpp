@@ -0,0 +1,364 @@
+#include "sage_tsdb/cluster/cluster_router.h"
+#include "sage_tsdb/cluster/shard_server.h"
+#include "sage_tsdb/core/stream_table.h"
+#include "sage_tsdb/core/time_series_index.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <set>
+
+namespace fs = std::filesystem;
+
+namespace sage_tsdb {
+namespace test {
+
+using namespace cluster;
+
+namespace {
+
+TimeSeriesData point(int64_t timestamp, double value, const Tags& tags) {
+    return TimeSeriesData(timestamp, value, tags);
+}
+
+// 800 points over 16 hosts in 2 regions, each (timestamp, tags) once
+std::vector<TimeSeriesData> make_points() {
+    std::vector<TimeSeriesData> points;
+    for (int i = 0; i < 800; ++i) {
+        points.push_back(point(i * 5, i % 17,
+                               {{"host", "h" + std::to_string(i % 16)},
+                                {"region", i % 16 < 6 ? "eu" : "us"}}));
+    }
+    return points;
+}
+
+std::vector<TimeSeriesData> sorted(std::vector<TimeSeriesData> points) {
+    std::sort(points.begin(), points.end(), [](const TimeSeriesData& a, const TimeSeriesData& b) {
+        return a.timestamp != b.timestamp ? a.timestamp < b.timestamp : a.tags < b.tags;
+    });
+    return points;
+}
+
+ShardMap three_nodes() {
+    ShardMap map(16);
+    map.addNode({"a", "127.0.0.1", 1});
+    map.addNode({"b", "127.0.0.1", 2});
+    map.addNode({"c", "127.0.0.1", 3});
+    map.assignRoundRobin();
+    return map;
+}
+
+} // anonymous namespace
+
+TEST(ShardMapTest, SeriesPlacementKeepsTagsTogetherAndPrunes) {
+    ShardMap map = three_nodes();
+    map.setPlacement("cpu", TablePlacement{{"host"}, 0});
+
+    std::set<std::string> owners;
+    for (const auto& p : make_points()) {
+        TimeSeriesData other = point(p.timestamp + 1, 0, {{"host", p.tags.at("host")}});
+        EXPECT_EQ(map.ownerOf("cpu", p), map.ownerOf("cpu", other));
+        owners.insert(map.ownerOf("cpu", p));
+    }
+    EXPECT_GT(owners.size(), 1u);
+
+    const TimeSeriesData h3 = point(0, 0, {{"host", "h3"}});
+    auto nodes = map.nodesFor("cpu", TimeRange(0, 10000), {{"host", "h3"}, {"region", "us"}});
+    ASSERT_EQ(nodes.size(), 1u);
+    EXPECT_EQ(nodes[0], map.ownerOf("cpu", h3));
+    EXPECT_EQ(map.nodesFor("cpu", TimeRange(0, 10000), {{"region", "us"}}),
+              (std::vector<std::string>{"a", "b", "c"}));
+
+    // Moving a shard changes its owner only
+    size_t shard = map.shardOf("cpu", h3);
+    map.assign(shard, "c");
+    EXPECT_EQ(map.ownerOf("cpu", h3), "c");
+    EXPECT_THROW(map.assign(shard, "z"), std::invalid_argument);
+    EXPECT_THROW(map.addNode({"a", "127.0.0.1", 4}), std::invalid_argument);
+}
+
+TEST(ShardMapTest, TimePartitionsAndColocation) {
+    ShardMap map = three_nodes();
+    map.setPlacement("log", TablePlacement{{}, 1000});
+    EXPECT_EQ(map.shardOf("log", point(999, 0, {})), 0u);
+    EXPECT_EQ(map.shardOf("log", point(1000, 0, {{"host", "x"}})), 1u);
+    EXPECT_EQ(map.shardOf("log", point(-1, 0, {})), 15u);
+    EXPECT_EQ(map.nodesFor("log", TimeRange(0, 999), {}), std::vector<std::string>{"a"});
+    EXPECT_EQ(map.nodesFor("log", TimeRange(500, 1500), {}),
+              (std::vector<std::string>{"a", "b"}));
+
+    map.setPlacement("stream_s", TablePlacement{{ShardMap::kJoinKeyTag}, 0});
+    EXPECT_FALSE(map.joinsLocally("stream_s", "stream_r"));
+    map.colocate("stream_r", "stream_s");
+    EXPECT_TRUE(map.colocated("stream_r", "stream_s"));
+    EXPECT_EQ(map.placement("stream_r"), map.placement("stream_s"));
+    EXPECT_TRUE(map.joinsLocally("stream_s", "stream_r"));
+    for (int key = 0; key < 100; ++key) {
+        Tags tags = {{"key", std::to_string(key)}};
+        EXPECT_EQ(map.ownerOf("stream_s", point(key, 1, tags)),
+                  map.ownerOf("stream_r", point(key * 7, 2, tags)));
+    }
+
+    map.colocate("log", "stream_s");  // Takes the group's placement
+    EXPECT_FALSE(map.joinsLocally("log", "cpu"));
+    EXPECT_EQ(map.placement("log").partition_ms, 0);
+}
+
+TEST(ShardMapTest, TextFormRoundTrips) {
+    ShardMap map = three_nodes();
+    map.assign(5, "a");
+    map.setPlacement("cpu", TablePlacement{{"host", "region"}, 0});
+    map.setPlacement("log", TablePlacement{{}, 60000});
+    map.colocate("mem", "cpu");
+
+    ShardMap parsed;
+    std::string error;
+    ASSERT_TRUE(ShardMap::parse(map.serialize(), parsed, &error)) << error;
+    EXPECT_EQ(parsed.serialize(), map.serialize());
+    EXPECT_EQ(parsed.numShards(), 16u);
+    EXPECT_EQ(parsed.ownerOfShard(5), "a");
+    EXPECT_TRUE(parsed.colocated("mem", "cpu"));
+    EXPECT_EQ(parsed.placement("log").partition_ms, 60000);
+
+    ASSERT_TRUE(ShardMap::parse("# two nodes\nshards 4\nnode x h 1\nnode y h 2\n", parsed));
+    EXPECT_EQ(parsed.ownerOfShard(2), "x");
+    EXPECT_EQ(parsed.ownerOfShard(3), "y");
+
+    EXPECT_FALSE(ShardMap::parse("shards 4\n", parsed, &error));
+    EXPECT_FALSE(ShardMap::parse("node x h 1\nassign 64 x\n", parsed, &error));
+    EXPECT_FALSE(ShardMap::parse("node x h 1\nbogus\n", parsed, &error));
+    EXPECT_EQ(error, "line 2: unknown directive bogus");
+}
+
+TEST(ClusterProtocolTest, PartialsMergeToTheSingleShardResult) {
+    auto points = make_points();
+    std::vector<TimeSeriesData> even;
+    std::vector<TimeSeriesData> odd;
+    for (size_t i = 0; i < points.size(); ++i) {
+        (i % 2 ? odd : even).push_back(points[i]);
+    }
+
+    for (auto type : {AggregationType::AVG, AggregationType::FIRST, AggregationType::QUANTILE}) {
+        QueryConfig config(TimeRange(100, 3000));
+        config.aggregation = type;
+        config.window_size = 250;
+        config.group_by = {"region"};
+
+        std::vector<PartialAggregate> partials;
+        for (const auto* half : {&even, &odd}) {
+            std::vector<uint8_t> bytes;
+            encode_partials(partial_aggregate(*half, config), bytes);
+            std::vector<PartialAggregate> decoded;
+            ASSERT_TRUE(decode_partials(bytes.data(), bytes.size(), decoded));
+            partials.insert(partials.end(), decoded.begin(), decoded.end());
+            bytes.pop_back();
+            EXPECT_FALSE(decode_partials(bytes.data(), bytes.size(), decoded));
+        }
+        auto merged = finish_aggregate(partials, config);
+        auto whole = finish_aggregate(partial_aggregate(points, config), config);
+        ASSERT_EQ(merged.size(), whole.size());
+        for (size_t i = 0; i < merged.size(); ++i) {
+            EXPECT_EQ(merged[i].timestamp, whole[i].timestamp);
+            EXPECT_EQ(merged[i].tags, whole[i].tags);
+            EXPECT_NEAR(merged[i].as_double(), whole[i].as_double(),
+                        type == AggregationType::QUANTILE ? 2.0 : 1e-9);
+        }
+    }
+
+    std::vector<uint8_t> bytes;
+    QueryConfig config(TimeRange(1, 2), {{"host", "h1"}});
+    config.group_by = {"region"};
+    config.aggregation = AggregationType::STDDEV;
+    encode_query("cpu", config, bytes);
+    std::string table;
+    QueryConfig decoded;
+    ASSERT_TRUE(decode_query(bytes.data(), bytes.size(), table, decoded));
+    EXPECT_EQ(table, "cpu");
+    EXPECT_EQ(decoded.filter_tags, config.filter_tags);
+    EXPECT_EQ(decoded.group_by, config.group_by);
+    EXPECT_EQ(decoded.aggregation, AggregationType::STDDEV);
+}
+
+class ClusterTest : public ::testing::Test {
+protected:
+    static constexpr int kNodes = 3;
+
+    void SetUp() override {
+        ShardMap map(16);
+        for (int i = 0; i < kNodes; ++i) {
+            std::string dir = "./test_cluster_data_" + std::to_string(i);
+            fs::remove_all(dir);
+            managers_.push_back(std::make_shared<TableManager>(dir, 0));
+            NodeInfo node{"n" + std::to_string(i), "127.0.0.1", 0};
+            if (i > 0) {
+                // n0 is the router's own node, the others serve RPCs
+                ShardServerConfig config;
+                config.bind_address = "127.0.0.1";
+                config.port = 0;
+                config.table_config.enable_wal = false;
+                servers_.push_back(std::make_unique<ShardServer>(managers_.back(), config));
+                ASSERT_TRUE(servers_.back()->start()) << servers_.back()->lastError();
+                node.port = servers_.back()->port();
+            }
+            map.addNode(node);
+        }
+        map.assignRoundRobin();
+        map.setPlacement("cpu", TablePlacement{{"host"}, 0});
+
+        ClusterRouterConfig config;
+        config.local_node = "n0";
+        config.table_config.enable_wal = false;
+        router_ = std::make_unique<ClusterRouter>(map, managers_[0], config);
+    }
+
+    void TearDown() override {
+        router_.reset();
+        servers_.clear();
+        managers_.clear();
+        for (int i = 0; i < kNodes; ++i) {
+            fs::remove_all("./test_cluster_data_" + std::to_string(i));
+        }
+    }
+
+    std::vector<TimeSeriesData> stored(int node, const std::string& table) {
+        auto stream = managers_[node]->getStreamTable(table);
+        return stream ? stream->query(TimeRange(INT64_MIN, INT64_MAX)) : std::vector<TimeSeriesData>{};
+    }
+
+    std::vector<std::shared_ptr<TableManager>> managers_;
+    std::vector<std::unique_ptr<ShardServer>> servers_;
+    std::unique_ptr<ClusterRouter> router_;
+};
+
+TEST_F(ClusterTest, InsertsLandOnTheirOwners) {
+    auto points = make_points();
+    ASSERT_TRUE(router_->insertBatch("cpu", points)) << router_->lastError();
+    ASSERT_TRUE(router_->ping()) << router_->lastError();
+
+    size_t total = 0;
+    for (int i = 0; i < kNodes; ++i) {
+        auto local = stored(i, "cpu");
+        EXPECT_FALSE(local.empty()) << "node " << i;
+        for (const auto& p : local) {
+            EXPECT_EQ(router_->shardMap().ownerOf("cpu", p), "n" + std::to_string(i));
+        }
+        total += local.size();
+    }
+    EXPECT_EQ(total, points.size());
+
+    double rpcs = 0;
+    ASSERT_TRUE(managers_[1]->getMetricsRegistry()->read("sage_tsdb_shard_rpcs_total",
+                                                         {{"kind", "insert"}}, rpcs));
+    EXPECT_EQ(rpcs, 1.0);  // One batched RPC per node
+}
+
+TEST_F(ClusterTest, QueriesMatchASingleNode) {
+    auto points = make_points();
+    ASSERT_TRUE(router_->insertBatch("cpu", points)) << router_->lastError();
+    TimeSeriesIndex reference;
+    reference.add_batch(points);
+
+    QueryConfig raw(TimeRange(200, 3500));
+    raw.limit = 100;
+    std::vector<TimeSeriesData> out;
+    ASSERT_TRUE(router_->query("cpu", raw, out)) << router_->lastError();
+    auto expected = reference.query(raw);
+    ASSERT_EQ(out.size(), expected.size());
+    for (size_t i = 0; i < out.size(); ++i) {
+        EXPECT_EQ(out[i].timestamp, expected[i].timestamp);
+        EXPECT_EQ(out[i].as_double(), expected[i].as_double());
+    }
+
+    // Pruned to the one owner of h3
+    QueryConfig filtered(TimeRange(0, 4000), {{"host", "h3"}});
+    filtered.limit = 0;
+    ASSERT_TRUE(router_->query("cpu", filtered, out));
+    EXPECT_EQ(out.size(), 50u);
+    EXPECT_EQ(sorted(out).front().tags.at("host"), "h3");
+
+    using T = AggregationType;
+    for (auto type : {T::COUNT, T::SUM, T::AVG, T::MIN, T::MAX, T::FIRST, T::LAST, T::STDDEV,
+                      T::DISTINCT}) {
+        for (int64_t window : {int64_t{0}, int64_t{500}}) {
+            QueryConfig config(TimeRange(100, 3800));
+            config.aggregation = type;
+            config.window_size = window;
+            config.group_by = {"region"};
+            ASSERT_TRUE(router_->query("cpu", config, out)) << router_->lastError();
+            auto got = sorted(out);
+            auto want = sorted(reference.query(config));
+            ASSERT_EQ(got.size(), want.size()) << static_cast<int>(type) << " " << window;
+            for (size_t i = 0; i < got.size(); ++i) {
+                EXPECT_EQ(got[i].timestamp, want[i].timestamp);
+                EXPECT_EQ(got[i].tags, want[i].tags);
+                EXPECT_NEAR(got[i].as_double(), want[i].as_double(), 1e-9)
+                    << static_cast<int>(type) << " window " << got[i].timestamp;
+            }
+        }
+    }
+}
+
+TEST_F(ClusterTest, JoinStreamsAreCoLocated) {
+    ShardMap map = router_->shardMap();
+    map.setPlacement("stream_s", TablePlacement{{ShardMap::kJoinKeyTag}, 0});
+    map.colocate("stream_r", "stream_s");
+    ASSERT_TRUE(map.joinsLocally("stream_s", "stream_r"));
+    ClusterRouterConfig config;
+    config.local_node = "n0";
+    config.table_config.enable_wal = false;
+    ClusterRouter router(map, managers_[0], config);
+
+    std::vector<TimeSeriesData> s;
+    std::vector<TimeSeriesData> r;
+    for (int i = 0; i < 300; ++i) {
+        s.push_back(point(i, 1, {{"key", std::to_string(i % 40)}}));
+        r.push_back(point(i, 2, {{"key", std::to_string(i % 40)}}));
+    }
+    ASSERT_TRUE(router.insertBatch("stream_s", s));
+    ASSERT_TRUE(router.insertBatch("stream_r", r));
+
+    // Every key's S and R points sit on one node, and no key on two
+    std::map<std::string, int> key_node;
+    for (int i = 0; i < kNodes; ++i) {
+        std::set<std::string> s_keys;
+        std::set<std::string> r_keys;
+        for (const auto& p : stored(i, "stream_s")) s_keys.insert(p.tags.at("key"));
+        for (const auto& p : stored(i, "stream_r")) r_keys.insert(p.tags.at("key"));
+        EXPECT_EQ(s_keys, r_keys);
+        for (const auto& key : s_keys) {
+            EXPECT_TRUE(key_node.emplace(key, i).second) << key;
+        }
+    }
+    EXPECT_EQ(key_node.size(), 40u);
+}
+
+TEST_F(ClusterTest, FailuresAreReported) {
+    auto points = make_points();
+    servers_[1]->stop();  // n2 goes away
+
+    EXPECT_FALSE(router_->insertBatch("cpu", points));
+    EXPECT_NE(router_->lastError().find("n2"), std::string::npos) << router_->lastError();
+    EXPECT_FALSE(stored(1, "cpu").empty());  // The others still took theirs
+
+    std::vector<TimeSeriesData> out;
+    EXPECT_FALSE(router_->query("cpu", QueryConfig(TimeRange(0, 4000)), out));
+    EXPECT_FALSE(router_->ping());
+
+    // A server that does not create tables refuses inserts into missing ones
+    ShardServerConfig config;
+    config.bind_address = "127.0.0.1";
+    config.port = 0;
+    config.create_tables = false;
+    ShardServer strict(managers_[2], config);
+    ASSERT_TRUE(strict.start());
+    ShardMap map(4);
+    map.addNode({"s", "127.0.0.1", strict.port()});
+    map.assignRoundRobin();
+    ClusterRouter router(map);
+    EXPECT_FALSE(router.insertBatch("missing", points));
+    EXPECT_NE(router.lastError().find("no stream table missing"), std::string::npos)
+        << router.lastError();
+}
+
+} // namespace test
+} // namespace sage_tsdb
@@ -0,0 +1,238 @@
+/**
+ * @file test_compute_state_manager.cpp
+ * @brief Unit tests for ComputeStateManager checkpoints
+ */
+
+#include <gtest/gtest.h>
+
+#include "sage_tsdb/compute/compute_state_manager.h"
+#include "sage_tsdb/core/time_series_db.h"
+
+using namespace sage_tsdb;
+using namespace sage_tsdb::compute;
+
+namespace {
+
+ComputeState makeState(size_t operator_bytes, uint64_t window_id) {
+    ComputeState state;
+    state.watermark = static_cast<int64_t>(window_id) * 1000;
+    state.window_id = window_id;
+    state.processed_events = window_id * 10;
+    state.metadata["operator"] = "IAWJ";
+    state.operator_state.resize(operator_bytes);
+    for (size_t i = 0; i < operator_bytes; ++i) {
+        state.operator_state[i] = static_cast<uint8_t>(i * 31 + 7);
+    }
+    return state;
+}
+
+}  // namespace
+
+TEST(ComputeStateManagerTest, SaveAndLoadState) {
+    TimeSeriesDB db;
+    ComputeStateManager manager(&db);
+
+    EXPECT_FALSE(manager.hasState("engine"));
+    auto state = makeState(100, 3);
+    ASSERT_TRUE(manager.saveState("engine", state));
+    EXPECT_TRUE(manager.hasState("engine"));
+
+    ComputeState loaded;
+    ASSERT_TRUE(manager.loadState("engine", loaded));
+    EXPECT_EQ(loaded.compute_name, "engine");
+    EXPECT_EQ(loaded.window_id, 3u);
+    EXPECT_EQ(loaded.operator_state, state.operator_state);
+
+    // A second manager on the same database reads the table
+    ComputeStateManager other(&db);
+    ComputeState reloaded;
+    ASSERT_TRUE(other.loadState("engine", reloaded));
+    EXPECT_EQ(reloaded.window_id, 3u);
+    EXPECT_EQ(reloaded.operator_state, state.operator_state);
+}
+
+TEST(ComputeStateManagerTest, DeltaRoundTrip) {
+    std::vector<uint8_t> base(3 * ComputeStateManager::DELTA_PAGE_SIZE + 100, 1);
+    auto current = base;
+    current[ComputeStateManager::DELTA_PAGE_SIZE + 5] = 9;  // One changed page
+    current.resize(current.size() + 50, 2);                 // Grown last page
+
+    auto delta = ComputeStateManager::encodeDelta(base, current);
+    EXPECT_LT(delta.size(), 2 * ComputeStateManager::DELTA_PAGE_SIZE + 100);
+    std::vector<uint8_t> applied;
+    ASSERT_TRUE(ComputeStateManager::applyDelta(base, delta, applied));
+    EXPECT_EQ(applied, current);
+
+    // Shrinking keeps only the leading pages
+    std::vector<uint8_t> shorter(base.begin(), base.begin() + 10);
+    ASSERT_TRUE(ComputeStateManager::applyDelta(
+        base, ComputeStateManager::encodeDelta(base, shorter), applied));
+    EXPECT_EQ(applied, shorter);
+
+    // Truncated deltas are rejected
+    delta.pop_back();
+    EXPECT_FALSE(ComputeStateManager::applyDelta(base, delta, applied));
+}
+
+TEST(ComputeStateManagerTest, CheckpointsAfterTheBaseAreDeltas) {
+    TimeSeriesDB db;
+    ComputeStateManager manager(&db);
+    const size_t pages = 8;
+    auto state = makeState(pages * ComputeStateManager::DELTA_PAGE_SIZE, 1);
+
+    std::vector<ComputeState> saved;
+    for (uint64_t id = 1; id <= 4; ++id) {
+        state.window_id = id;
+        state.operator_state[(id % pages) * ComputeStateManager::DELTA_PAGE_SIZE] ^= 0xFF;
+        ASSERT_TRUE(manager.saveState("engine", state));
+        ASSERT_TRUE(manager.createCheckpoint("engine", id));
+        saved.push_back(state);
+    }
+    manager.flushCheckpoints();
+
+    auto stats = manager.getCheckpointStats();
+    EXPECT_EQ(stats.base_checkpoints, 1u);
+    EXPECT_EQ(stats.delta_checkpoints, 3u);
+    EXPECT_EQ(stats.pending, 0u);
+    EXPECT_LT(stats.operator_bytes_written, 2 * state.operator_state.size());
+
+    for (uint64_t id = 1; id <= 4; ++id) {
+        ComputeState restored;
+        ASSERT_TRUE(manager.restoreCheckpoint("engine", id, restored));
+        EXPECT_EQ(restored.window_id, id);
+        EXPECT_EQ(restored.metadata.at("operator"), "IAWJ");
+        EXPECT_EQ(restored.operator_state, saved[id - 1].operator_state);
+    }
+}
+
+TEST(ComputeStateManagerTest, LargeChangesWriteANewBase) {
+    TimeSeriesDB db;
+    ComputeStateManager manager(&db);
+    auto state = makeState(4 * ComputeStateManager::DELTA_PAGE_SIZE, 1);
+    ASSERT_TRUE(manager.saveState("engine", state));
+    ASSERT_TRUE(manager.createCheckpoint("engine", 1));
+
+    for (auto& byte : state.operator_state) {
+        byte = static_cast<uint8_t>(byte + 1);
+    }
+    ASSERT_TRUE(manager.saveState("engine", state));
+    ASSERT_TRUE(manager.createCheckpoint("engine", 2));
+    manager.flushCheckpoints();
+
+    auto stats = manager.getCheckpointStats();
+    EXPECT_EQ(stats.base_checkpoints, 2u);
+    EXPECT_EQ(stats.delta_checkpoints, 0u);
+}
+
+TEST(ComputeStateManagerTest, CheckpointKeepsTheSnapshotItWasTakenFrom) {
+    TimeSeriesDB db;
+    ComputeStateManager manager(&db);
+    auto first = makeState(1000, 1);
+    ASSERT_TRUE(manager.saveState("engine", first));
+    ASSERT_TRUE(manager.createCheckpoint("engine", 1));
+
+    // Saving again before the writer runs must not change checkpoint 1
+    auto second = makeState(2000, 2);
+    ASSERT_TRUE(manager.saveState("engine", second));
+
+    ComputeState restored;
+    ASSERT_TRUE(manager.restoreCheckpoint("engine", 1, restored));
+    EXPECT_EQ(restored.window_id, 1u);
+    EXPECT_EQ(restored.operator_state, first.operator_state);
+}
+
+TEST(ComputeStateManagerTest, LatestCheckpointByName) {
+    TimeSeriesDB db;
+    uint64_t id = 0;
+    {
+        ComputeStateManager manager(&db);
+        EXPECT_FALSE(manager.latestCheckpoint("engine", id));
+        EXPECT_FALSE(manager.createCheckpoint("engine", 1));  // Nothing saved
+
+        ASSERT_TRUE(manager.saveState("engine", makeState(64, 1)));
+        ASSERT_TRUE(manager.createCheckpoint("engine", 7));
+        ASSERT_TRUE(manager.createCheckpoint("engine", 5));
+        ASSERT_TRUE(manager.latestCheckpoint("engine", id));
+        EXPECT_EQ(id, 5u);  // Latest created, not the largest id
+    }  // Destructor writes the queued checkpoints
+
+    ComputeStateManager reopened(&db);
+    ASSERT_TRUE(reopened.latestCheckpoint("engine", id));
+    EXPECT_EQ(id, 5u);
+    ComputeState restored;
+    EXPECT_TRUE(reopened.restoreCheckpoint("engine", id, restored));
+    EXPECT_FALSE(reopened.restoreCheckpoint("engine", 99, restored));
+}
+
+TEST(ComputeStateManagerTest, DeletedStateIsNotLoaded) {
+    TimeSeriesDB db;
+    ComputeStateManager manager(&db);
+    EXPECT_FALSE(manager.deleteState("engine"));  // Nothing saved
+
+    ASSERT_TRUE(manager.saveState("engine", makeState(100, 1)));
+    ASSERT_TRUE(manager.saveState("other", makeState(100, 2)));
+    ASSERT_TRUE(manager.deleteState("engine"));
+    EXPECT_FALSE(manager.deleteState("engine"));
+
+    ComputeState loaded;
+    EXPECT_FALSE(manager.loadState("engine", loaded));
+    EXPECT_FALSE(manager.hasState("engine"));
+    EXPECT_FALSE(manager.createCheckpoint("engine", 1));
+    EXPECT_EQ(manager.listStates(), std::vector<std::string>{"other"});
+
+    // The tombstone is in the table, so a new manager does not see the state either
+    ComputeStateManager reopened(&db);
+    EXPECT_FALSE(reopened.loadState("engine", loaded));
+    EXPECT_FALSE(reopened.hasState("engine"));
+    ASSERT_TRUE(reopened.loadState("other", loaded));
+    EXPECT_EQ(loaded.window_id, 2u);
+
+    // Saving again brings it back
+    ASSERT_TRUE(manager.saveState("engine", makeState(100, 3)));
+    ASSERT_TRUE(manager.loadState("engine", loaded));
+    EXPECT_EQ(loaded.window_id, 3u);
+    ComputeStateManager again(&db);
+    ASSERT_TRUE(again.loadState("engine", loaded));
+    EXPECT_EQ(loaded.window_id, 3u);
+}
+
+TEST(ComputeStateManagerTest, DeletedCheckpointIsNotListedOrRestored) {
+    TimeSeriesDB db;
+    ComputeStateManager manager(&db);
+    const size_t pages = 8;
+    auto state = makeState(pages * ComputeStateManager::DELTA_PAGE_SIZE, 1);
+    ASSERT_TRUE(manager.saveState("engine", state));
+    ASSERT_TRUE(manager.createCheckpoint("engine", 1));  // Base
+    state.operator_state[0] ^= 0xFF;
+    state.window_id = 2;
+    ASSERT_TRUE(manager.saveState("engine", state));
+    ASSERT_TRUE(manager.createCheckpoint("engine", 2));  // Delta against 1
+    EXPECT_FALSE(manager.deleteCheckpoint("engine", 9));
+
+    // Deleting waits for the queued checkpoints
+    ASSERT_TRUE(manager.deleteCheckpoint("engine", 2));
+    EXPECT_FALSE(manager.deleteCheckpoint("engine", 2));
+    ComputeState restored;
+    EXPECT_FALSE(manager.restoreCheckpoint("engine", 2, restored));
+    auto listed = manager.listCheckpoints("engine");
+    ASSERT_EQ(listed.size(), 1u);
+    EXPECT_EQ(listed[0].first, 1u);
+    uint64_t latest = 0;
+    ASSERT_TRUE(manager.latestCheckpoint("engine", latest));
+    EXPECT_EQ(latest, 1u);
+
+    // A delta stays restorable after its base is deleted
+    state.operator_state[ComputeStateManager::DELTA_PAGE_SIZE] ^= 0xFF;
+    state.window_id = 3;
+    ASSERT_TRUE(manager.saveState("engine", state));
+    ASSERT_TRUE(manager.createCheckpoint("engine", 3));
+    ASSERT_TRUE(manager.deleteCheckpoint("engine", 1));
+    EXPECT_EQ(manager.getCheckpointStats().delta_checkpoints, 2u);
+    EXPECT_FALSE(manager.restoreCheckpoint("engine", 1, restored));
+    ASSERT_TRUE(manager.restoreCheckpoint("engine", 3, restored));
+    EXPECT_EQ(restored.window_id, 3u);
+    EXPECT_EQ(restored.operator_state, state.operator_state);
+    listed = manager.listCheckpoints("engine");
+    ASSERT_EQ(listed.size(), 1u);
+    EXPECT_EQ(listed[0].first, 3u);
+}
@@ -0,0 +1,153 @@
+#include "sage_tsdb/utils/csv_data_loader.h"
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+namespace sage_tsdb {
+namespace test {
+
+using utils::CSVDataLoader;
+using utils::PECJTuple;
+
+class CSVDataLoaderTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        test_dir_ = "./test_csv_data";
+        if (fs::exists(test_dir_)) {
+            fs::remove_all(test_dir_);
+        }
+        fs::create_directories(test_dir_);
+    }
+
+    void TearDown() override {
+        if (fs::exists(test_dir_)) {
+            fs::remove_all(test_dir_);
+        }
+    }
+
+    std::string write(const std::string& name, const std::string& content) {
+        std::string path = test_dir_ + "/" + name;
+        std::ofstream(path, std::ios::binary) << content;
+        return path;
+    }
+
+    // Large enough to be split into several chunks
+    std::string writeLarge(const std::string& name, size_t rows) {
+        std::string content = "key,value,eventTime,arrivalTime\n";
+        for (size_t i = 0; i < rows; ++i) {
+            content += std::to_string(i % 97) + "," + std::to_string(i) + ".5," +
+                       std::to_string(i * 10) + "," + std::to_string(i * 10 + 3) + "\n";
+        }
+        return write(name, content);
+    }
+
+    std::string test_dir_;
+};
+
+TEST_F(CSVDataLoaderTest, LoadAllParsesRows) {
+    auto path = write("small.csv",
+                      "key,value,eventTime,arrivalTime\n"
+                      "1,2.5,100,110\r\n"
+                      "# comment\n"
+                      "\n"
+                      "2, 3.25 ,200,205.0\n"
+                      "3,-1e3,300,301");
+    CSVDataLoader loader(path);
+    auto tuples = loader.loadAll();
+    ASSERT_EQ(tuples.size(), 3u);
+    EXPECT_EQ(tuples[0].key, 1u);
+    EXPECT_EQ(tuples[0].value, 2.5);
+    EXPECT_EQ(tuples[0].arrivalTime, 110u);
+    EXPECT_EQ(tuples[1].value, 3.25);
+    EXPECT_EQ(tuples[1].arrivalTime, 205u);
+    EXPECT_EQ(tuples[2].value, -1000.0);
+    EXPECT_EQ(tuples[2].eventTime, 300u);
+}
+
+TEST_F(CSVDataLoaderTest, ParseErrorsNameTheLine) {
+    auto path = write("bad.csv", "key,value,eventTime,arrivalTime\n1,1,1,1\n2,x,2,2\n");
+    CSVDataLoader loader(path);
+    try {
+        loader.loadAll();
+        FAIL() << "expected a parse error";
+    } catch (const std::runtime_error& e) {
+        EXPECT_NE(std::string(e.what()).find("line 3"), std::string::npos) << e.what();
+    }
+    EXPECT_THROW(CSVDataLoader(test_dir_ + "/missing.csv").loadAll(), std::runtime_error);
+    EXPECT_TRUE(CSVDataLoader(write("empty.csv", "")).loadAll().empty());
+}
+
+TEST_F(CSVDataLoaderTest, ParallelChunksMatchSequentialOrder) {
+    constexpr size_t kRows = 200000;  // ~5MB
+    auto path = writeLarge("large.csv", kRows);
+
+    auto parallel = CSVDataLoader(path, true, 4).loadAll();
+    auto single = CSVDataLoader(path, true, 1).loadAll();
+    ASSERT_EQ(parallel.size(), kRows);
+    ASSERT_EQ(single.size(), kRows);
+    for (size_t i = 0; i < kRows; ++i) {
+        ASSERT_EQ(parallel[i].key, i % 97);
+        ASSERT_EQ(parallel[i].value, static_cast<double>(i) + 0.5);
+        ASSERT_EQ(parallel[i].eventTime, single[i].eventTime);
+    }
+
+    // Errors deep in a later chunk still report their line in the file
+    std::string content = "key,value,eventTime,arrivalTime\n";
+    for (size_t i = 0; i < kRows; ++i) {
+        content += (i == kRows - 10) ? "oops\n" : "1,1,1,1\n";
+    }
+    auto bad = write("bad_large.csv", content);
+    try {
+        CSVDataLoader(bad, true, 4).loadAll();
+        FAIL() << "expected a parse error";
+    } catch (const std::runtime_error& e) {
+        std::string expected = "line " + std::to_string(kRows - 10 + 2) + " ";
+        EXPECT_NE(std::string(e.what()).find(expected), std::string::npos) << e.what();
+    }
+}
+
+TEST_F(CSVDataLoaderTest, StreamStopsAtMaxTuples) {
+    auto path = writeLarge("stream.csv", 100);
+    std::vector<PECJTuple> seen;
+    size_t count = CSVDataLoader(path).loadStream(
+        [&](const PECJTuple& tuple) { seen.push_back(tuple); }, 10);
+    EXPECT_EQ(count, 10u);
+    ASSERT_EQ(seen.size(), 10u);
+    EXPECT_EQ(seen[9].eventTime, 90u);
+}
+
+TEST_F(CSVDataLoaderTest, LoadFromFileUsesHeaderColumns) {
+    auto path = write("reordered.csv",
+                      "eventTime,key,arriveTime,value\n"
+                      "1.5,7,2,0.25\n"
+                      "short,line\n"
+                      "3,8,4,0.5\n");
+    auto records = CSVDataLoader::loadFromFile(path, 1000);
+    ASSERT_EQ(records.size(), 2u);
+    EXPECT_EQ(records[0].key, 7);
+    EXPECT_EQ(records[0].value, 0.25);
+    EXPECT_EQ(records[0].event_time, 1500);
+    EXPECT_EQ(records[0].arrival_time, 2000);
+    EXPECT_EQ(records[1].key, 8);
+
+    EXPECT_TRUE(CSVDataLoader::loadFromFile(test_dir_ + "/missing.csv").empty());
+}
+
+TEST_F(CSVDataLoaderTest, LoadTimeSeriesBuildsPoints) {
+    constexpr size_t kRows = 100000;
+    auto path = writeLarge("points.csv", kRows);
+    auto records = CSVDataLoader::loadFromFile(path, 1, 4);
+    auto points = CSVDataLoader::loadTimeSeries(path, "S", 1, 4);
+    ASSERT_EQ(points.size(), kRows);
+    for (size_t i = 0; i < kRows; i += 997) {
+        auto expected = CSVDataLoader::toTimeSeriesData(records[i], "S");
+        EXPECT_EQ(points[i].timestamp, expected.timestamp);
+        EXPECT_EQ(points[i].tags, expected.tags);
+        EXPECT_EQ(points[i].fields, expected.fields);
+    }
+}
+
+} // namespace test
+} // namespace sage_tsdb
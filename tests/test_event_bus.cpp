@@ -0,0 +1,304 @@
+#include <gtest/gtest.h>
+#include "sage_tsdb/plugins/event_bus.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <set>
+#include <thread>
+#include <vector>
+
+using namespace sage_tsdb;
+using namespace sage_tsdb::plugins;
+
+namespace {
+
+// Wait until pred holds or a second passes
+template <typename Pred>
+bool waitFor(Pred pred) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    while (!pred()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+Event custom(int64_t ts) {
+    return Event(EventType::CUSTOM, ts);
+}
+
+}  // namespace
+
+TEST(MpmcRingTest, FifoAndBounded) {
+    MpmcRing<int> ring(3);
+    EXPECT_EQ(ring.capacity(), 4u);
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_TRUE(ring.try_push(int(i)));
+    }
+    EXPECT_FALSE(ring.try_push(4));
+    EXPECT_EQ(ring.size_approx(), 4u);
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_EQ(ring.try_pop(), i);
+    }
+    EXPECT_FALSE(ring.try_pop());
+}
+
+TEST(MpmcRingTest, ConcurrentProducersAndConsumers) {
+    MpmcRing<int> ring(64);
+    const int producers = 4;
+    const int per_producer = 10000;
+    std::atomic<long long> sum{0};
+    std::atomic<int> popped{0};
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&, p]() {
+            for (int i = 0; i < per_producer; ++i) {
+                int value = p * per_producer + i;
+                while (!ring.try_push(int(value))) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (int c = 0; c < 2; ++c) {
+        threads.emplace_back([&]() {
+            while (popped.load() < producers * per_producer) {
+                if (auto value = ring.try_pop()) {
+                    sum += *value;
+                    popped++;
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    long long n = producers * per_producer;
+    EXPECT_EQ(sum.load(), n * (n - 1) / 2);
+}
+
+TEST(EventBusTest, InternedSources) {
+    auto a = intern_source("plugin-a");
+    auto again = intern_source(std::string("plugin-") + "a");
+    auto b = intern_source("plugin-b");
+    EXPECT_EQ(a.id, again.id);
+    EXPECT_EQ(a.name.data(), again.name.data());  // Same storage, no copy
+    EXPECT_NE(a.id, b.id);
+    EXPECT_EQ(intern_source("").id, 0u);
+
+    Event event(EventType::CUSTOM, 1, nullptr, "plugin-a");
+    EXPECT_EQ(event.source, "plugin-a");
+    EXPECT_EQ(event.source_id, a.id);
+}
+
+TEST(EventBusTest, DeliversToSubscribersOfTheType) {
+    EventBus bus;
+    std::atomic<int> results{0};
+    std::atomic<int> customs{0};
+    std::shared_ptr<AlgorithmResult> seen;
+    std::mutex seen_mutex;
+    bus.subscribe(EventType::RESULT_READY, [&](const Event& event) {
+        std::lock_guard<std::mutex> lock(seen_mutex);
+        seen = std::static_pointer_cast<AlgorithmResult>(event.payload);
+        EXPECT_EQ(event.source, "algo");
+        results++;
+    });
+    int custom_id = bus.subscribe(EventType::CUSTOM, [&](const Event&) { customs++; });
+    bus.start();
+
+    auto result = std::make_shared<AlgorithmResult>();
+    result->timestamp = 42;
+    EXPECT_TRUE(bus.publish_result(result, "algo"));
+    EXPECT_TRUE(bus.publish(custom(1)));
+    ASSERT_TRUE(waitFor([&]() { return results == 1 && customs == 1; }));
+    {
+        std::lock_guard<std::mutex> lock(seen_mutex);
+        EXPECT_EQ(seen, result);  // Same object: the payload is shared, not copied
+    }
+
+    bus.unsubscribe(custom_id);
+    EXPECT_TRUE(bus.publish(custom(2)));
+    ASSERT_TRUE(waitFor([&]() { return bus.getStats().delivered == 3; }));
+    EXPECT_EQ(customs, 1);
+    bus.stop();
+}
+
+TEST(EventBusTest, DropNewestWhenFull) {
+    EventBusConfig config;
+    config.capacity = 4;
+    config.overflow = OverflowPolicy::DROP_NEWEST;
+    EventBus bus(config);
+
+    for (int64_t ts = 0; ts < 6; ++ts) {
+        EXPECT_EQ(bus.publish(custom(ts)), ts < 4);
+    }
+    std::vector<Event> drained;
+    EXPECT_EQ(bus.drain(drained, 10), 4u);
+    EXPECT_EQ(drained.front().timestamp, 0);
+    EXPECT_EQ(drained.back().timestamp, 3);
+    EXPECT_EQ(bus.getStats().dropped_newest, 2u);
+}
+
+TEST(EventBusTest, DropOldestWhenFull) {
+    EventBusConfig config;
+    config.capacity = 4;
+    config.overflow = OverflowPolicy::DROP_OLDEST;
+    EventBus bus(config);
+
+    for (int64_t ts = 0; ts < 6; ++ts) {
+        EXPECT_TRUE(bus.publish(custom(ts)));
+    }
+    std::vector<Event> drained;
+    EXPECT_EQ(bus.drain(drained, 10), 4u);
+    EXPECT_EQ(drained.front().timestamp, 2);
+    EXPECT_EQ(drained.back().timestamp, 5);
+    EXPECT_EQ(bus.getStats().dropped_oldest, 2u);
+}
+
+TEST(EventBusTest, BlockWaitsForSlowSubscriber) {
+    EventBusConfig config;
+    config.capacity = 4;
+    config.batch_size = 2;
+    EventBus bus(config);
+    std::vector<int64_t> seen;
+    bus.subscribe(EventType::CUSTOM, [&](const Event& event) {
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+        seen.push_back(event.timestamp);
+    });
+    bus.start();
+
+    // Many more events than fit: none is lost, publishers wait instead
+    const int64_t count = 100;
+    for (int64_t ts = 0; ts < count; ++ts) {
+        EXPECT_TRUE(bus.publish(custom(ts)));
+    }
+    ASSERT_TRUE(waitFor([&]() { return bus.getStats().delivered == count; }));
+    bus.stop();
+
+    ASSERT_EQ(seen.size(), static_cast<size_t>(count));
+    for (int64_t ts = 0; ts < count; ++ts) {
+        EXPECT_EQ(seen[ts], ts);
+    }
+    auto stats = bus.getStats();
+    EXPECT_GT(stats.blocked_publishes, 0u);
+    EXPECT_EQ(stats.dropped_newest + stats.dropped_oldest, 0u);
+}
+
+TEST(EventBusTest, BlockOnStoppedBusDrops) {
+    EventBusConfig config;
+    config.capacity = 2;
+    EventBus bus(config);
+    EXPECT_TRUE(bus.publish(custom(0)));
+    EXPECT_TRUE(bus.publish(custom(1)));
+    EXPECT_FALSE(bus.publish(custom(2)));  // Would wait forever
+
+    // Queued events are delivered once started
+    std::atomic<int> delivered{0};
+    bus.subscribe(EventType::CUSTOM, [&](const Event&) { delivered++; });
+    bus.start();
+    EXPECT_TRUE(waitFor([&]() { return delivered == 2; }));
+    EXPECT_FALSE(bus.configure(config));  // Not while running
+}
+
+TEST(EventBusTest, SlowSubscriberDoesNotStallOthers) {
+    EventBusConfig config;
+    config.capacity = 8;
+    EventBus bus(config);
+    std::atomic<bool> release{false};
+    std::atomic<int> slow_seen{0};
+    std::atomic<int> fast_seen{0};
+    SubscriberOptions slow;
+    slow.name = "slow";
+    slow.capacity = 4;
+    slow.policy = DeliveryPolicy::DROP;
+    bus.subscribe(EventType::CUSTOM, [&](const Event&) {
+        while (!release) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        slow_seen++;
+    }, slow);
+    SubscriberOptions fast;
+    fast.name = "fast";
+    bus.subscribe(EventType::CUSTOM, [&](const Event&) { fast_seen++; }, fast);
+    bus.start();
+
+    // The slow subscriber is stuck in its first callback throughout
+    const int count = 100;
+    for (int64_t ts = 0; ts < count; ++ts) {
+        EXPECT_TRUE(bus.publish(custom(ts)));
+    }
+    ASSERT_TRUE(waitFor([&]() { return fast_seen == count; }));
+    EXPECT_EQ(slow_seen, 0);
+
+    auto stats = bus.getSubscriberStats();
+    ASSERT_EQ(stats.size(), 2u);
+    EXPECT_EQ(stats[0].name, "slow");
+    EXPECT_GT(stats[0].dropped, 0u);
+    EXPECT_LE(stats[0].queued, 4u);
+    EXPECT_EQ(stats[1].name, "fast");
+    EXPECT_EQ(stats[1].delivered, static_cast<uint64_t>(count));
+    EXPECT_EQ(stats[1].dropped, 0u);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    EXPECT_GE(bus.getSubscriberStats()[0].lag_us, 5000);  // Stuck callback shows as lag
+
+    release = true;
+    bus.stop();
+    auto after = bus.getSubscriberStats();
+    EXPECT_EQ(after[0].delivered + after[0].dropped, static_cast<uint64_t>(count));
+    EXPECT_GE(after[0].max_lag_us, 5000);
+}
+
+TEST(EventBusTest, SampleKeepsEveryNthWhenBehind) {
+    EventBus bus;
+    std::atomic<bool> release{false};
+    std::atomic<int> seen{0};
+    SubscriberOptions options;
+    options.capacity = 8;
+    options.policy = DeliveryPolicy::SAMPLE;
+    options.sample_every = 4;
+    bus.subscribe(EventType::CUSTOM, [&](const Event&) {
+        while (!release) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        seen++;
+    }, options);
+    bus.start();
+
+    const uint64_t count = 40;
+    for (uint64_t ts = 0; ts < count; ++ts) {
+        bus.publish(custom(static_cast<int64_t>(ts)));
+    }
+    ASSERT_TRUE(waitFor([&]() { return bus.getStats().delivered == count; }));
+    release = true;
+    bus.stop();
+
+    auto stats = bus.getSubscriberStats()[0];
+    EXPECT_GT(stats.sampled_out, 0u);
+    EXPECT_EQ(stats.delivered + stats.dropped + stats.sampled_out, count);
+    EXPECT_EQ(static_cast<uint64_t>(seen.load()), stats.delivered);
+    EXPECT_EQ(stats.name, "subscriber-0");
+}
+
+TEST(EventBusTest, UnsubscribeFromOwnCallback) {
+    EventBus bus;
+    std::atomic<int> seen{0};
+    std::atomic<int> id{-1};
+    id = bus.subscribe(EventType::CUSTOM, [&](const Event&) {
+        seen++;
+        bus.unsubscribe(id);
+    });
+    bus.start();
+    for (int64_t ts = 0; ts < 10; ++ts) {
+        bus.publish(custom(ts));
+    }
+    ASSERT_TRUE(waitFor([&]() { return bus.getStats().delivered == 10; }));
+    bus.stop();
+    EXPECT_EQ(seen, 1);
+    EXPECT_TRUE(bus.getSubscriberStats().empty());
+}
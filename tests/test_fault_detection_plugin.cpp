@@ -2,6 +2,7 @@
 #include "sage_tsdb/plugins/adapters/fault_detection_adapter.h"
 #include "sage_tsdb/plugins/plugin_registry.h"
 #include "sage_tsdb/core/time_series_data.h"
+#include "sage_tsdb/core/simd.h"
 #include <memory>
 #include <vector>
 #include <cmath>
@@ -130,6 +131,127 @@ TEST_F(FaultDetectionAdapterTest, StatisticsTest) {
     adapter.stop();
 }
 
+TEST_F(FaultDetectionAdapterTest, FeedBatchMatchesFeedData) {
+    FaultDetectionAdapter single(config_);
+    single.initialize(config_);
+    single.start();
+    FaultDetectionAdapter batched(config_);
+    batched.initialize(config_);
+    batched.start();
+    
+    std::vector<TimeSeriesData> samples(200);
+    for (size_t i = 0; i < samples.size(); i++) {
+        samples[i].timestamp = static_cast<int64_t>(i) * 1000;
+        samples[i].value = (i % 50 == 49) ? 500.0 : 100.0 + std::sin(i * 0.3);
+    }
+    for (const auto& data : samples) {
+        single.feedData(data);
+    }
+    std::span<const TimeSeriesData> all(samples);
+    batched.feedBatch(all.first(64));
+    batched.feedBatch(all.subspan(64));
+    
+    auto single_stats = single.getStats();
+    auto batched_stats = batched.getStats();
+    EXPECT_EQ(batched_stats["total_samples"], 200);
+    EXPECT_EQ(batched_stats["anomalies_detected"], single_stats["anomalies_detected"]);
+    
+    auto single_results = single.getDetectionResults(200);
+    auto batched_results = batched.getDetectionResults(200);
+    ASSERT_EQ(batched_results.size(), single_results.size());
+    for (size_t i = 0; i < single_results.size(); i++) {
+        EXPECT_EQ(batched_results[i].timestamp, single_results[i].timestamp);
+        EXPECT_EQ(batched_results[i].is_anomaly, single_results[i].is_anomaly);
+        EXPECT_DOUBLE_EQ(batched_results[i].anomaly_score, single_results[i].anomaly_score);
+    }
+    
+    single.stop();
+    batched.stop();
+}
+
+TEST_F(FaultDetectionAdapterTest, VectorScoresMatchScalar) {
+    config_["series_tags"] = "sensor";
+    std::vector<TimeSeriesData> samples;
+    for (int i = 0; i < 400; i++) {
+        TimeSeriesData data;
+        data.timestamp = i * 1000;
+        data.value = (i % 37 == 36) ? 300.0 : 100.0 + std::sin(i * 0.3) * (i % 5);
+        data.tags["sensor"] = "s" + std::to_string(i % 3);
+        samples.push_back(data);
+    }
+    
+    // Batches of every length up to two AVX-512 widths, then the rest
+    auto score = [&](simd::Level level) {
+        simd::set_level(level);
+        FaultDetectionAdapter adapter(config_);
+        adapter.initialize(config_);
+        adapter.start();
+        std::span<const TimeSeriesData> all(samples);
+        size_t offset = 0;
+        for (size_t n = 1; n <= 17; n++) {
+            adapter.feedBatch(all.subspan(offset, n));
+            offset += n;
+        }
+        adapter.feedBatch(all.subspan(offset));
+        auto results = adapter.getDetectionResults(samples.size());
+        adapter.stop();
+        return results;
+    };
+    
+    const simd::Level saved = simd::active();
+    auto expected = score(simd::Level::Scalar);
+    for (simd::Level level : {simd::Level::AVX2, simd::Level::AVX512}) {
+        if (simd::detected() < level) {
+            continue;  // Not supported here
+        }
+        auto actual = score(level);
+        ASSERT_EQ(actual.size(), expected.size()) << simd::name(level);
+        for (size_t i = 0; i < expected.size(); i++) {
+            EXPECT_EQ(actual[i].is_anomaly, expected[i].is_anomaly) << simd::name(level) << " " << i;
+            EXPECT_EQ(actual[i].anomaly_score, expected[i].anomaly_score) << simd::name(level) << " " << i;
+            EXPECT_EQ(actual[i].features["std_dev"], expected[i].features["std_dev"]);
+        }
+    }
+    simd::set_level(saved);
+}
+
+TEST_F(FaultDetectionAdapterTest, SeriesKeepSeparateStatistics) {
+    config_["series_tags"] = "sensor";
+    FaultDetectionAdapter adapter(config_);
+    adapter.initialize(config_);
+    adapter.start();
+    
+    // Two sensors at very different levels, interleaved: against one global
+    // mean every point would look far off
+    std::vector<TimeSeriesData> batch;
+    for (int i = 0; i < 200; i++) {
+        TimeSeriesData data;
+        data.timestamp = i * 1000;
+        bool hot = i % 2 == 1;
+        data.value = (hot ? 1000.0 : 10.0) + std::sin(i * 0.7);
+        data.tags["sensor"] = hot ? "hot" : "cold";
+        data.tags["run"] = std::to_string(i);  // Not part of the series key
+        batch.push_back(data);
+    }
+    adapter.feedBatch(batch);
+    EXPECT_EQ(adapter.getStats()["anomalies_detected"], 0);
+    EXPECT_EQ(adapter.getModelMetrics()["series_count"], 2.0);
+    
+    // A spike that is normal for the hot sensor is an anomaly for the cold one
+    TimeSeriesData spike;
+    spike.timestamp = 200000;
+    spike.value = 1000.0;
+    spike.tags["sensor"] = "cold";
+    adapter.feedData(spike);
+    auto last = adapter.getDetectionResults(1);
+    ASSERT_EQ(last.size(), 1u);
+    EXPECT_TRUE(last[0].is_anomaly);
+    EXPECT_EQ(last[0].severity, FaultDetectionAdapter::Severity::CRITICAL);
+    EXPECT_NEAR(last[0].features["mean"], 10.0 + 990.0 / 101.0, 0.1);
+    
+    adapter.stop();
+}
+
 TEST_F(FaultDetectionAdapterTest, ModelMetricsTest) {
     FaultDetectionAdapter adapter(config_);
     adapter.initialize(config_);
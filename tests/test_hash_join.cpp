@@ -0,0 +1,209 @@
+#include "sage_tsdb/core/hash_join.h"
+#include "sage_tsdb/core/simd.h"
+#include <gtest/gtest.h>
+#include <random>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace sage_tsdb {
+namespace test {
+
+namespace {
+
+struct Stream {
+    std::vector<uint64_t> keys;
+    std::vector<double> values;
+};
+
+Stream make_stream(size_t n, uint64_t distinct_keys, uint64_t key_base, uint32_t seed) {
+    std::mt19937_64 rng(seed);
+    std::uniform_int_distribution<uint64_t> key(0, distinct_keys - 1);
+    std::uniform_real_distribution<double> value(0.0, 100.0);
+    Stream stream;
+    for (size_t i = 0; i < n; ++i) {
+        stream.keys.push_back(key_base + key(rng));
+        stream.values.push_back(value(rng));
+    }
+    return stream;
+}
+
+// Nested-loop semantics via per-key counts and R value sums
+JoinAggregate reference_join(const Stream& s, const Stream& r) {
+    std::unordered_map<uint64_t, uint64_t> s_counts;
+    for (uint64_t key : s.keys) {
+        s_counts[key]++;
+    }
+    JoinAggregate result;
+    for (size_t i = 0; i < r.keys.size(); ++i) {
+        auto it = s_counts.find(r.keys[i]);
+        if (it != s_counts.end()) {
+            result.pairs += it->second;
+            result.sum += static_cast<double>(it->second) * r.values[i];
+        }
+    }
+    return result;
+}
+
+void expect_matches(const Stream& s, const Stream& r) {
+    auto expected = reference_join(s, r);
+    auto count = join_kernels::hash_join(s.keys.data(), s.keys.size(),
+                                         r.keys.data(), nullptr, r.keys.size());
+    EXPECT_EQ(count.pairs, expected.pairs);
+    EXPECT_EQ(count.partitions_joined, count.partitions);
+
+    auto summed = join_kernels::hash_join(s.keys.data(), s.keys.size(),
+                                          r.keys.data(), r.values.data(), r.keys.size());
+    EXPECT_EQ(summed.pairs, expected.pairs);
+    EXPECT_NEAR(summed.sum, expected.sum, 1e-9 * std::max(1.0, expected.sum));
+}
+
+}  // namespace
+
+TEST(HashJoinTest, EmptyInputs) {
+    std::vector<uint64_t> keys{1, 2, 3};
+    auto result = join_kernels::hash_join(keys.data(), keys.size(), nullptr, nullptr, 0);
+    EXPECT_EQ(result.pairs, 0u);
+    result = join_kernels::hash_join(nullptr, 0, keys.data(), nullptr, keys.size());
+    EXPECT_EQ(result.pairs, 0u);
+}
+
+TEST(HashJoinTest, SmallJoinsMatchReference) {
+    // Few hot keys, including key 0 (the value of empty table slots)
+    expect_matches(make_stream(1000, 10, 0, 1), make_stream(1500, 10, 0, 2));
+    // Build on R (the smaller side): sums come from the table
+    expect_matches(make_stream(3000, 50, 0, 3), make_stream(700, 50, 0, 4));
+    // Mostly distinct keys, many collisions in the home slots
+    expect_matches(make_stream(2000, 1u << 20, 0, 5), make_stream(2000, 1u << 20, 0, 6));
+    // Keys using the upper 32 bits, only partly overlapping
+    expect_matches(make_stream(2000, 4000, uint64_t{1} << 40, 7),
+                   make_stream(2000, 4000, (uint64_t{1} << 40) + 2000, 8));
+}
+
+// Every vector probe this CPU runs agrees with the scalar probe
+TEST(HashJoinTest, VectorProbesMatchScalar) {
+    std::vector<std::pair<Stream, Stream>> inputs;
+    // Probe sides of every tail length, built on S and on R
+    for (size_t n = 1; n <= 19; ++n) {
+        inputs.emplace_back(make_stream(8, 6, 0, 100 + n), make_stream(n, 6, 0, 200 + n));
+        inputs.emplace_back(make_stream(n + 20, 6, 0, 300 + n), make_stream(n, 6, 0, 400 + n));
+    }
+    inputs.emplace_back(make_stream(2000, 1u << 20, 0, 5), make_stream(2003, 1u << 20, 0, 6));
+    inputs.emplace_back(make_stream(3001, 50, 0, 3), make_stream(700, 50, 0, 4));
+    inputs.emplace_back(make_stream(30000, 8000, uint64_t{1} << 40, 7),
+                        make_stream(25000, 8000, uint64_t{1} << 40, 8));
+
+    const simd::Level saved = simd::active();
+    for (const auto& [s, r] : inputs) {
+        simd::set_level(simd::Level::Scalar);
+        auto count = join_kernels::hash_join(s.keys.data(), s.keys.size(),
+                                             r.keys.data(), nullptr, r.keys.size());
+        auto summed = join_kernels::hash_join(s.keys.data(), s.keys.size(),
+                                              r.keys.data(), r.values.data(), r.keys.size());
+        EXPECT_EQ(count.pairs, reference_join(s, r).pairs);
+        for (simd::Level level : {simd::Level::AVX2, simd::Level::AVX512}) {
+            if (simd::set_level(level) != level) {
+                continue;  // Not supported here
+            }
+            SCOPED_TRACE(std::string(simd::name(level)) + " " + std::to_string(s.keys.size()) +
+                         " x " + std::to_string(r.keys.size()));
+            auto vector_count = join_kernels::hash_join(s.keys.data(), s.keys.size(),
+                                                        r.keys.data(), nullptr, r.keys.size());
+            auto vector_summed = join_kernels::hash_join(s.keys.data(), s.keys.size(),
+                                                         r.keys.data(), r.values.data(),
+                                                         r.keys.size());
+            EXPECT_EQ(vector_count.pairs, count.pairs);
+            EXPECT_EQ(vector_summed.pairs, summed.pairs);
+            EXPECT_NEAR(vector_summed.sum, summed.sum, 1e-9 * std::max(1.0, summed.sum));
+        }
+    }
+    simd::set_level(saved);
+}
+
+TEST(HashJoinTest, PartitionedJoinsMatchReference) {
+    auto s = make_stream(100000, 20000, 0, 11);
+    auto r = make_stream(120000, 20000, 0, 12);
+    auto result = join_kernels::hash_join(s.keys.data(), s.keys.size(),
+                                          r.keys.data(), nullptr, r.keys.size());
+    EXPECT_GT(result.partitions, 1u);
+    expect_matches(s, r);
+
+    // Skewed: one key carries half of each stream
+    for (size_t i = 0; i < s.keys.size(); i += 2) {
+        s.keys[i] = 42;
+    }
+    for (size_t i = 0; i < r.keys.size(); i += 2) {
+        r.keys[i] = 42;
+    }
+    expect_matches(s, r);
+}
+
+TEST(HashJoinTest, StopCoversJoinedPartitionsOnly) {
+    auto s = make_stream(50000, 10000, 0, 21);
+    auto r = make_stream(50000, 10000, 0, 22);
+    auto full = join_kernels::hash_join(s.keys.data(), s.keys.size(),
+                                        r.keys.data(), nullptr, r.keys.size());
+    ASSERT_GT(full.partitions, 1u);
+
+    // The first partition always runs, then the join stops
+    auto cut = join_kernels::hash_join(s.keys.data(), s.keys.size(),
+                                       r.keys.data(), nullptr, r.keys.size(),
+                                       []() { return true; });
+    EXPECT_EQ(cut.partitions, full.partitions);
+    EXPECT_EQ(cut.partitions_joined, 1u);
+    EXPECT_GT(cut.pairs, 0u);
+    EXPECT_LT(cut.pairs, full.pairs);
+    // Keys are spread evenly, so the scaled-up partition is close to the total
+    double estimate = static_cast<double>(cut.pairs) * cut.partitions;
+    EXPECT_NEAR(estimate, static_cast<double>(full.pairs), 0.35 * full.pairs);
+}
+
+TEST(HashJoinTest, ParallelBucketsMergeToReference) {
+    auto s = make_stream(60000, 20000, 0, 31);
+    auto r = make_stream(80000, 20000, 0, 32);
+    auto expected = reference_join(s, r);
+
+    std::vector<std::thread> threads;
+    auto submit = [&threads](std::function<void()> task) {
+        threads.emplace_back(std::move(task));
+        return true;
+    };
+    auto buckets = join_kernels::parallel_hash_join(s.keys.data(), s.keys.size(),
+                                                    r.keys.data(), r.values.data(), r.keys.size(),
+                                                    4, submit);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    ASSERT_EQ(buckets.size(), 4u);
+    EXPECT_EQ(threads.size(), 3u);
+
+    JoinAggregate merged;
+    for (const auto& bucket : buckets) {
+        EXPECT_GT(bucket.pairs, 0u);  // Keys are spread over every bucket
+        EXPECT_EQ(bucket.partitions_joined, bucket.partitions);
+        merged.pairs += bucket.pairs;
+        merged.sum += bucket.sum;
+    }
+    EXPECT_EQ(merged.pairs, expected.pairs);
+    EXPECT_NEAR(merged.sum, expected.sum, 1e-9 * expected.sum);
+}
+
+TEST(HashJoinTest, ParallelJoinRunsInlineWhenNothingIsQueued) {
+    auto s = make_stream(5000, 500, 0, 41);
+    auto r = make_stream(5000, 500, 0, 42);
+    auto expected = reference_join(s, r);
+
+    auto refuse = [](std::function<void()>) { return false; };
+    auto buckets = join_kernels::parallel_hash_join(s.keys.data(), s.keys.size(),
+                                                    r.keys.data(), nullptr, r.keys.size(),
+                                                    3, refuse);
+    ASSERT_EQ(buckets.size(), 3u);
+    uint64_t pairs = 0;
+    for (const auto& bucket : buckets) {
+        pairs += bucket.pairs;
+    }
+    EXPECT_EQ(pairs, expected.pairs);
+}
+
+}  // namespace test
+}  // namespace sage_tsdb
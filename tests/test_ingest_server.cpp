@@ -0,0 +1,361 @@
+#include "sage_tsdb/server/ingest_server.h"
+#include "sage_tsdb/server/metrics_server.h"
+#include <gtest/gtest.h>
+#include <arpa/inet.h>
+#include <cstring>
+#include <filesystem>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace sage_tsdb {
+namespace test {
+
+using namespace server;
+
+namespace {
+
+int connect_to(int type, int port) {
+    int fd = ::socket(AF_INET, type, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    if (fd >= 0 && ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+void send_all(int fd, const void* data, size_t size) {
+    const char* ptr = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t n = ::send(fd, ptr, size, 0);
+        ASSERT_GT(n, 0);
+        ptr += n;
+        size -= static_cast<size_t>(n);
+    }
+}
+
+// Poll until pred holds or about five seconds have passed
+template <typename Pred>
+bool wait_until(Pred pred) {
+    for (int i = 0; i < 500 && !pred(); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return pred();
+}
+
+} // anonymous namespace
+
+TEST(LineProtocolTest, ParsesTagsFieldsAndTimestamp) {
+    LinePoint point;
+    std::string error;
+    ASSERT_EQ(parse_line("cpu,host=a\\ b,region=eu value=1.5,count=3i,ok=t,"
+                         "msg=\"say \\\"hi\\\"\",big=7u 1700000000000\r",
+                         point, LineProtocolOptions{}, &error),
+              LineStatus::Point) << error;
+    EXPECT_EQ(point.table, "cpu");
+    EXPECT_EQ(point.data.timestamp, 1700000000000);
+    EXPECT_DOUBLE_EQ(point.data.as_double(), 1.5);
+    EXPECT_EQ(point.data.tags.at("host"), "a b");
+    EXPECT_EQ(point.data.tags.at("region"), "eu");
+    EXPECT_EQ(point.data.fields.count("value"), 0u);
+    EXPECT_TRUE(point.data.fields.at("count").is_int64());
+    EXPECT_EQ(point.data.fields.at("count").as_int64(), 3);
+    EXPECT_TRUE(point.data.fields.at("ok").as_bool());
+    EXPECT_EQ(point.data.fields.at("msg").to_string(), "say \"hi\"");
+    EXPECT_EQ(point.data.fields.at("big").as_int64(), 7);
+
+    // Without the value field the first numeric field is the value
+    LineProtocolOptions options;
+    options.timestamp_divisor = 1000000;
+    ASSERT_EQ(parse_line("mem,host=a used=\"x\",free=42i 5000000000", point, options),
+              LineStatus::Point);
+    EXPECT_EQ(point.data.timestamp, 5000);
+    EXPECT_DOUBLE_EQ(point.data.as_double(), 42.0);
+    EXPECT_EQ(point.data.fields.at("free").as_int64(), 42);
+
+    // No timestamp: now, in milliseconds
+    ASSERT_EQ(parse_line("disk value=1", point), LineStatus::Point);
+    EXPECT_GT(point.data.timestamp, 1600000000000);
+    EXPECT_LT(point.data.timestamp, 100000000000000);
+}
+
+TEST(LineProtocolTest, SkipsAndRejects) {
+    LinePoint point;
+    std::string error;
+    EXPECT_EQ(parse_line("", point), LineStatus::Skipped);
+    EXPECT_EQ(parse_line("   ", point), LineStatus::Skipped);
+    EXPECT_EQ(parse_line("# comment", point), LineStatus::Skipped);
+
+    for (const char* bad : {"cpu", "cpu ", "cpu,host value=1", "cpu,host= value=1",
+                            "cpu value=abc", "cpu value=1 12x", "cpu msg=\"open",
+                            "cpu value=\"text\"", ",host=a value=1"}) {
+        error.clear();
+        EXPECT_EQ(parse_line(bad, point, LineProtocolOptions{}, &error), LineStatus::Error) << bad;
+        EXPECT_FALSE(error.empty()) << bad;
+    }
+}
+
+TEST(LineProtocolTest, BinaryFrameRoundTrip) {
+    std::vector<TimeSeriesData> points;
+    for (int i = 0; i < 100; ++i) {
+        points.emplace_back(i, i * 0.25, Tags{{"key", std::to_string(i % 3)}});
+    }
+    std::vector<uint8_t> frame;
+    encode_binary_frame("stream_s", points.data(), points.size(), frame);
+    ASSERT_GT(frame.size(), kBinaryHeaderBytes);
+
+    uint32_t size;
+    std::memcpy(&size, frame.data(), sizeof(size));
+    ASSERT_EQ(size, frame.size() - kBinaryHeaderBytes);
+
+    std::string table;
+    std::vector<TimeSeriesData> decoded;
+    ASSERT_TRUE(decode_binary_payload(frame.data() + kBinaryHeaderBytes, size, table, decoded));
+    EXPECT_EQ(table, "stream_s");
+    ASSERT_EQ(decoded.size(), points.size());
+    EXPECT_EQ(decoded[42].timestamp, 42);
+    EXPECT_DOUBLE_EQ(decoded[42].as_double(), 10.5);
+    EXPECT_EQ(decoded[42].tags.at("key"), "0");
+
+    EXPECT_FALSE(decode_binary_payload(frame.data() + kBinaryHeaderBytes, 1, table, decoded));
+}
+
+class IngestServerTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        test_dir_ = "./test_ingest_server_data";
+        fs::remove_all(test_dir_);
+        manager_ = std::make_shared<TableManager>(test_dir_, 0);
+        config_.bind_address = "127.0.0.1";
+        config_.tcp_port = 0;
+        config_.flush_interval = std::chrono::milliseconds(20);
+        config_.table_config.enable_wal = false;
+    }
+
+    void TearDown() override {
+        manager_.reset();
+        fs::remove_all(test_dir_);
+    }
+
+    size_t count(const std::string& table) {
+        auto stream = manager_->getStreamTable(table);
+        return stream ? stream->query(TimeRange(0, 1000000)).size() : 0;
+    }
+
+    std::string test_dir_;
+    std::shared_ptr<TableManager> manager_;
+    IngestServerConfig config_;
+};
+
+TEST_F(IngestServerTest, TcpLinesAndBinaryFrames) {
+    IngestServer server(manager_, config_);
+    ASSERT_TRUE(server.start()) << server.lastError();
+    ASSERT_GT(server.tcpPort(), 0);
+
+    int lines = connect_to(SOCK_STREAM, server.tcpPort());
+    ASSERT_GE(lines, 0);
+    std::string text;
+    for (int i = 0; i < 1000; ++i) {
+        text += "stream_s,key=" + std::to_string(i % 4) + " value=" + std::to_string(i) + " " +
+                std::to_string(i) + "\n";
+    }
+    text += "bad line\n";
+    // Split mid-line: the tail waits for the rest
+    send_all(lines, text.data(), 1234);
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    send_all(lines, text.data() + 1234, text.size() - 1234);
+
+    int binary = connect_to(SOCK_STREAM, server.tcpPort());
+    ASSERT_GE(binary, 0);
+    std::vector<TimeSeriesData> points;
+    for (int i = 0; i < 500; ++i) {
+        points.emplace_back(i, i * 2.0, Tags{{"key", "1"}});
+    }
+    std::vector<uint8_t> frames(sizeof(kBinaryMagic));
+    std::memcpy(frames.data(), &kBinaryMagic, sizeof(kBinaryMagic));
+    encode_binary_frame("stream_r", points.data(), 300, frames);
+    encode_binary_frame("stream_r", points.data() + 300, 200, frames);
+    send_all(binary, frames.data(), frames.size());
+
+    ASSERT_TRUE(wait_until([&] { return count("stream_s") == 1000 && count("stream_r") == 500; }));
+
+    // Counters are published after the batch lands in the tables
+    std::vector<ConnectionStats> connections;
+    ASSERT_TRUE(wait_until([&] {
+        connections = server.getConnectionStats();
+        uint64_t written = 0;
+        for (const auto& conn : connections) written += conn.points_written;
+        return written == 1500;
+    }));
+    ASSERT_EQ(connections.size(), 2u);
+    for (const auto& conn : connections) {
+        EXPECT_FALSE(conn.udp);
+        EXPECT_EQ(conn.points_written, conn.binary ? 500u : 1000u);
+        EXPECT_EQ(conn.parse_errors, conn.binary ? 0u : 1u);
+        EXPECT_GT(conn.bytes_received, 0u);
+        EXPECT_GT(conn.points_per_second(), 0.0);
+    }
+
+    ::close(lines);
+    ::close(binary);
+    ASSERT_TRUE(wait_until([&] { return server.getStats().active_connections == 0; }));
+    server.stop();
+
+    auto stats = server.getStats();
+    EXPECT_EQ(stats.connections_accepted, 2u);
+    EXPECT_EQ(stats.points_written, 1500u);
+    EXPECT_EQ(stats.parse_errors, 1u);
+    EXPECT_EQ(stats.write_errors, 0u);
+
+    auto row = manager_->getStreamTable("stream_s")->query(TimeRange(7, 7));
+    ASSERT_EQ(row.size(), 1u);
+    EXPECT_DOUBLE_EQ(row[0].as_double(), 7.0);
+    EXPECT_EQ(row[0].tags.at("key"), "3");
+}
+
+TEST_F(IngestServerTest, ClosingConnectionFlushesUnterminatedLine) {
+    config_.flush_interval = std::chrono::milliseconds(60000);
+    config_.batch_points = 1000000;
+    IngestServer server(manager_, config_);
+    ASSERT_TRUE(server.start());
+
+    int fd = connect_to(SOCK_STREAM, server.tcpPort());
+    ASSERT_GE(fd, 0);
+    std::string text = "t value=1 1\nt value=2 2";
+    send_all(fd, text.data(), text.size());
+    ::close(fd);
+
+    ASSERT_TRUE(wait_until([&] { return count("t") == 2; }));
+    server.stop();
+}
+
+TEST_F(IngestServerTest, UdpDatagrams) {
+    config_.tcp_port = -1;
+    config_.udp_port = 0;
+    IngestServer server(manager_, config_);
+    ASSERT_TRUE(server.start()) << server.lastError();
+    EXPECT_EQ(server.tcpPort(), -1);
+    ASSERT_GT(server.udpPort(), 0);
+
+    int fd = connect_to(SOCK_DGRAM, server.udpPort());
+    ASSERT_GE(fd, 0);
+    for (int i = 0; i < 10; ++i) {
+        std::string datagram = "u value=" + std::to_string(i) + " " + std::to_string(i * 2) +
+                               "\nu value=1 " + std::to_string(i * 2 + 1);
+        send_all(fd, datagram.data(), datagram.size());
+    }
+    std::vector<TimeSeriesData> points{TimeSeriesData(100, 1.0), TimeSeriesData(101, 2.0)};
+    std::vector<uint8_t> frame(sizeof(kBinaryMagic));
+    std::memcpy(frame.data(), &kBinaryMagic, sizeof(kBinaryMagic));
+    encode_binary_frame("u", points.data(), points.size(), frame);
+    send_all(fd, frame.data(), frame.size());
+    ::close(fd);
+
+    ASSERT_TRUE(wait_until([&] { return count("u") == 22; }));
+    ASSERT_TRUE(wait_until([&] {
+        auto connections = server.getConnectionStats();
+        return connections.size() == 1 && connections[0].udp &&
+               connections[0].points_written == 22;
+    }));
+    server.stop();
+    EXPECT_TRUE(server.getConnectionStats().empty());
+}
+
+TEST_F(IngestServerTest, StopsReadingUnderMemoryPressure) {
+    const size_t budget = 1024 * 1024;
+    manager_->setGlobalMemoryLimit(budget);
+    auto write_buffer = manager_->getWriteBufferManager();
+    write_buffer->reserve(budget);  // Held by no table, so nothing can flush it
+    ASSERT_TRUE(write_buffer->is_under_pressure());
+
+    IngestServer server(manager_, config_);
+    ASSERT_TRUE(server.start());
+    ASSERT_TRUE(wait_until([&] { return server.getStats().paused; }));
+
+    int fd = connect_to(SOCK_STREAM, server.tcpPort());
+    ASSERT_GE(fd, 0);
+    std::string text = "p value=1 1\np value=2 2\n";
+    send_all(fd, text.data(), text.size());
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_EQ(count("p"), 0u);
+    EXPECT_EQ(server.getStats().points_written, 0u);
+
+    write_buffer->free(budget);
+    ASSERT_TRUE(wait_until([&] { return count("p") == 2; }));
+    EXPECT_FALSE(server.getStats().paused);
+    EXPECT_GE(server.getStats().backpressure_pauses, 1u);
+
+    ::close(fd);
+    server.stop();
+}
+
+TEST_F(IngestServerTest, RejectsConnectionsOverLimit) {
+    config_.max_connections = 1;
+    IngestServer server(manager_, config_);
+    ASSERT_TRUE(server.start());
+
+    int first = connect_to(SOCK_STREAM, server.tcpPort());
+    ASSERT_TRUE(wait_until([&] { return server.getStats().active_connections == 1; }));
+    int second = connect_to(SOCK_STREAM, server.tcpPort());
+    ASSERT_TRUE(wait_until([&] { return server.getStats().connections_rejected == 1; }));
+
+    ::close(first);
+    ::close(second);
+    server.stop();
+    EXPECT_FALSE(server.isRunning());
+}
+
+TEST_F(IngestServerTest, MetricsEndpointServesRegistry) {
+    IngestServer server(manager_, config_);
+    ASSERT_TRUE(server.start());
+    MetricsServerConfig metrics_config;
+    metrics_config.bind_address = "127.0.0.1";
+    metrics_config.port = 0;
+    MetricsServer metrics(manager_->getMetricsRegistry(), metrics_config);
+    ASSERT_TRUE(metrics.start()) << metrics.lastError();
+    ASSERT_GT(metrics.port(), 0);
+
+    int fd = connect_to(SOCK_STREAM, server.tcpPort());
+    std::string text = "m,key=a value=1 1\nm,key=a value=2 2\n";
+    send_all(fd, text.data(), text.size());
+    ASSERT_TRUE(wait_until([&] { return server.getStats().points_written == 2; }));
+
+    auto fetch = [&](const std::string& request) {
+        int http = connect_to(SOCK_STREAM, metrics.port());
+        EXPECT_GE(http, 0);
+        send_all(http, request.data(), request.size());
+        std::string reply;
+        char buffer[4096];
+        ssize_t n;
+        while ((n = ::recv(http, buffer, sizeof(buffer), 0)) > 0) {
+            reply.append(buffer, static_cast<size_t>(n));
+        }
+        ::close(http);
+        return reply;
+    };
+
+    std::string reply = fetch("GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    EXPECT_EQ(reply.rfind("HTTP/1.1 200 OK\r\n", 0), 0u) << reply;
+    EXPECT_NE(reply.find("Content-Type: text/plain; version=0.0.4"), std::string::npos);
+    EXPECT_NE(reply.find("sage_tsdb_ingest_points_total 2\n"), std::string::npos) << reply;
+    EXPECT_NE(reply.find("sage_tsdb_ingest_active_connections 1\n"), std::string::npos);
+    EXPECT_NE(reply.find("sage_tsdb_table_points_total{table=\"m\"} 2\n"), std::string::npos);
+
+    reply = fetch("GET / HTTP/1.1\r\n\r\n");
+    EXPECT_EQ(reply.rfind("HTTP/1.1 404", 0), 0u) << reply;
+
+    ::close(fd);
+    metrics.stop();
+    EXPECT_FALSE(metrics.isRunning());
+    server.stop();
+}
+
+} // namespace test
+} // namespace sage_tsdb
@@ -0,0 +1,98 @@
+#include "sage_tsdb/core/latency_histogram.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace sage_tsdb {
+namespace test {
+
+TEST(LatencyHistogramTest, BucketsCoverValuesContiguously) {
+    // Small values are exact
+    for (uint64_t v = 0; v < LatencyHistogram::kSubBucketCount; ++v) {
+        EXPECT_EQ(LatencyHistogram::bucket_index(v), v);
+    }
+    // Each bucket starts right after the previous one ends
+    for (size_t i = 1; i < LatencyHistogram::kBucketCount; ++i) {
+        ASSERT_EQ(LatencyHistogram::bucket_lowest(i),
+                  LatencyHistogram::bucket_highest(i - 1) + 1) << "bucket " << i;
+        ASSERT_EQ(LatencyHistogram::bucket_index(LatencyHistogram::bucket_lowest(i)), i);
+        ASSERT_EQ(LatencyHistogram::bucket_index(LatencyHistogram::bucket_highest(i)), i);
+    }
+    // Values past the range land in the last bucket
+    EXPECT_EQ(LatencyHistogram::bucket_index(UINT64_MAX), LatencyHistogram::kBucketCount - 1);
+}
+
+TEST(LatencyHistogramTest, PercentilesWithinRelativeError) {
+    LatencyHistogram histogram;
+    std::mt19937_64 rng(7);
+    std::lognormal_distribution<double> dist(8.0, 1.5);
+    std::vector<uint64_t> samples;
+    for (int i = 0; i < 50000; ++i) {
+        uint64_t v = static_cast<uint64_t>(dist(rng));
+        samples.push_back(v);
+        histogram.record(v);
+    }
+    std::sort(samples.begin(), samples.end());
+
+    auto snap = histogram.snapshot();
+    EXPECT_EQ(snap.count, samples.size());
+    EXPECT_EQ(snap.min, samples.front());
+    EXPECT_EQ(snap.max, samples.back());
+    for (double q : {0.5, 0.9, 0.99, 0.999}) {
+        size_t rank = static_cast<size_t>(std::ceil(q * samples.size())) - 1;
+        double exact = static_cast<double>(samples[rank]);
+        double reported = static_cast<double>(snap.percentile(q));
+        EXPECT_GE(reported, exact) << "q=" << q;
+        EXPECT_LE(reported, exact * 1.035 + 1) << "q=" << q;
+    }
+    EXPECT_EQ(snap.percentile(1.0), samples.back());
+}
+
+TEST(LatencyHistogramTest, ConcurrentRecordsAreAllCounted) {
+    LatencyHistogram histogram;
+    constexpr int kThreads = 8;
+    constexpr int kPerThread = 20000;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&histogram, t]() {
+            for (int i = 0; i < kPerThread; ++i) {
+                histogram.record(static_cast<uint64_t>(t * 1000 + i % 1000));
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    EXPECT_EQ(histogram.count(), static_cast<uint64_t>(kThreads * kPerThread));
+    auto snap = histogram.snapshot();
+    EXPECT_EQ(snap.count, static_cast<uint64_t>(kThreads * kPerThread));
+    EXPECT_EQ(snap.min, 0u);
+    EXPECT_EQ(snap.max, static_cast<uint64_t>(kThreads * 1000 - 1));
+}
+
+TEST(LatencyHistogramTest, ResetClearsEverything) {
+    LatencyHistogram histogram;
+    EXPECT_EQ(histogram.snapshot().percentile(0.99), 0u);
+
+    histogram.record(10);
+    histogram.record(1000);
+    histogram.reset();
+    auto snap = histogram.snapshot();
+    EXPECT_EQ(snap.count, 0u);
+    EXPECT_EQ(snap.min, 0u);
+    EXPECT_EQ(snap.max, 0u);
+    EXPECT_EQ(snap.percentile(0.5), 0u);
+
+    histogram.record(42);
+    snap = histogram.snapshot();
+    EXPECT_EQ(snap.count, 1u);
+    EXPECT_EQ(snap.percentile(0.5), 42u);
+    EXPECT_DOUBLE_EQ(snap.mean, 42.0);
+}
+
+}  // namespace test
+}  // namespace sage_tsdb
@@ -0,0 +1,1575 @@
+#include "sage_tsdb/core/lsm_tree.h"
+#include "sage_tsdb/core/block_codec.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+namespace sage_tsdb {
+namespace test {
+
+class LSMTreeTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        test_dir_ = "./test_lsm_data";
+        if (fs::exists(test_dir_)) {
+            fs::remove_all(test_dir_);
+        }
+        fs::create_directories(test_dir_);
+    }
+
+    void TearDown() override {
+        if (fs::exists(test_dir_)) {
+            fs::remove_all(test_dir_);
+        }
+    }
+
+    std::map<int64_t, TimeSeriesData> generate_series(size_t count) {
+        std::map<int64_t, TimeSeriesData> data;
+        int64_t ts = 1700000000000;
+        for (size_t i = 0; i < count; ++i) {
+            // Mostly regular 1s interval with occasional jitter
+            ts += 1000 + ((i % 17 == 0) ? static_cast<int64_t>(i % 5) : 0);
+            TimeSeriesData point;
+            point.timestamp = ts;
+            point.value = 20.0 + std::sin(static_cast<double>(i) / 50.0);
+            point.tags["sensor"] = (i % 2 == 0) ? "s1" : "s2";
+            point.tags["region"] = "east";
+            data[ts] = point;
+        }
+        return data;
+    }
+
+    static std::vector<TimeSeriesData> to_points(const std::map<int64_t, TimeSeriesData>& data) {
+        std::vector<TimeSeriesData> points;
+        points.reserve(data.size());
+        for (const auto& [ts, point] : data) {
+            points.push_back(point);
+        }
+        return points;
+    }
+
+    std::string test_dir_;
+};
+
+TEST_F(LSMTreeTest, ColumnarBlockRoundTrip) {
+    std::vector<TimeSeriesData> points;
+    int64_t ts = -5000;
+    for (int i = 0; i < 300; ++i) {
+        ts += (i % 7 == 0) ? 1 : 100000 + i * 13;
+        TimeSeriesData point;
+        point.timestamp = ts;
+        if (i % 10 == 3) {
+            point.value = std::vector<double>{1.0 * i, -2.5, 1e300};
+        } else {
+            point.value = (i % 4 == 0) ? 42.0 : i * 0.1;
+        }
+        point.tags["host"] = "h" + std::to_string(i % 3);
+        if (i % 5 == 0) {
+            point.fields["note"] = "n" + std::to_string(i);
+        }
+        points.push_back(point);
+    }
+
+    std::vector<uint8_t> encoded;
+    ColumnarBlock::encode(points.data(), points.size(), encoded);
+
+    std::vector<TimeSeriesData> decoded;
+    ASSERT_TRUE(ColumnarBlock::decode(encoded.data(), encoded.size(), decoded));
+    ASSERT_EQ(decoded.size(), points.size());
+    for (size_t i = 0; i < points.size(); ++i) {
+        EXPECT_EQ(decoded[i].timestamp, points[i].timestamp);
+        EXPECT_EQ(decoded[i].is_scalar(), points[i].is_scalar());
+        if (points[i].is_scalar()) {
+            EXPECT_EQ(decoded[i].as_double(), points[i].as_double());
+        } else {
+            EXPECT_EQ(decoded[i].as_vector(), points[i].as_vector());
+        }
+        EXPECT_EQ(decoded[i].tags, points[i].tags);
+        EXPECT_EQ(decoded[i].fields, points[i].fields);
+    }
+
+    // Truncated blocks must be rejected rather than read out of bounds
+    std::vector<TimeSeriesData> partial;
+    EXPECT_FALSE(ColumnarBlock::decode(encoded.data(), encoded.size() / 2, partial));
+}
+
+TEST_F(LSMTreeTest, ColumnarSSTableRoundTrip) {
+    auto data = generate_series(10000);
+
+    SSTableOptions row_options;
+    SSTable row_table(test_dir_ + "/L0_1.sst", 0, 1, row_options);
+    ASSERT_TRUE(row_table.build_from_memtable(to_points(data)));
+
+    SSTableOptions columnar_options;
+    columnar_options.format_version = SSTable::kColumnarFormatVersion;
+    columnar_options.block_size_points = 1024;
+    SSTable columnar_table(test_dir_ + "/L0_2.sst", 0, 2, columnar_options);
+    ASSERT_TRUE(columnar_table.build_from_memtable(to_points(data)));
+
+    EXPECT_LT(fs::file_size(test_dir_ + "/L0_2.sst") * 4,
+              fs::file_size(test_dir_ + "/L0_1.sst"));
+
+    // Reopen from disk and compare against the source data
+    SSTable reopened(test_dir_ + "/L0_2.sst", 0, 2);
+    ASSERT_TRUE(reopened.open());
+    EXPECT_EQ(reopened.get_format_version(), SSTable::kColumnarFormatVersion);
+    EXPECT_EQ(reopened.get_min_timestamp(), data.begin()->first);
+    EXPECT_EQ(reopened.get_max_timestamp(), data.rbegin()->first);
+
+    auto all = reopened.range_query(data.begin()->first, data.rbegin()->first);
+    ASSERT_EQ(all.size(), data.size());
+    auto it = data.begin();
+    for (const auto& point : all) {
+        EXPECT_EQ(point.timestamp, it->first);
+        EXPECT_EQ(point.as_double(), it->second.as_double());
+        EXPECT_EQ(point.tags, it->second.tags);
+        ++it;
+    }
+
+    // Point lookups across block boundaries
+    auto probe = std::next(data.begin(), 5000);
+    TimeSeriesData result;
+    ASSERT_TRUE(reopened.get(probe->first, result));
+    EXPECT_EQ(result.as_double(), probe->second.as_double());
+    EXPECT_FALSE(reopened.get(probe->first + 1, result));
+
+    auto window = reopened.range_query(std::next(data.begin(), 1000)->first,
+                                       std::next(data.begin(), 3047)->first);
+    EXPECT_EQ(window.size(), 2048u);
+}
+
+TEST_F(LSMTreeTest, TypedFieldsRoundTrip) {
+    std::vector<TimeSeriesData> points;
+    for (int64_t ts = 1; ts <= 200; ++ts) {
+        TimeSeriesData point(ts, static_cast<double>(ts), {{"host", "h1"}});
+        point.fields["count"] = ts * 1000000007;
+        point.fields["ratio"] = ts / 3.0;
+        point.fields["ok"] = ts % 2 == 0;
+        point.fields["unit"] = "ms";
+        points.push_back(point);
+    }
+    auto check = [&](const std::vector<TimeSeriesData>& decoded) {
+        ASSERT_EQ(decoded.size(), points.size());
+        for (size_t i = 0; i < points.size(); ++i) {
+            EXPECT_EQ(decoded[i].fields, points[i].fields);
+            EXPECT_TRUE(decoded[i].fields.at("count").is_int64());
+            EXPECT_TRUE(decoded[i].fields.at("ratio").is_double());
+            EXPECT_TRUE(decoded[i].fields.at("ok").is_bool());
+            EXPECT_TRUE(decoded[i].fields.at("unit").is_string());
+        }
+    };
+
+    std::vector<uint8_t> block;
+    ColumnarBlock::encode(points.data(), points.size(), block);
+    std::vector<TimeSeriesData> decoded;
+    ASSERT_TRUE(ColumnarBlock::decode(block.data(), block.size(), decoded));
+    check(decoded);
+
+    for (uint32_t version : {SSTable::kRowFormatVersion, SSTable::kColumnarFormatVersion}) {
+        SSTableOptions options;
+        options.format_version = version;
+        std::string path = test_dir_ + "/L0_" + std::to_string(version) + ".sst";
+        SSTable writer(path, 0, version, options);
+        ASSERT_TRUE(writer.build_from_memtable(points));
+        SSTable reopened(path, 0, version);
+        ASSERT_TRUE(reopened.open());
+        check(reopened.range_query(1, 200));
+    }
+
+    WriteAheadLog wal(test_dir_ + "/typed.wal");
+    for (const auto& point : points) {
+        ASSERT_TRUE(wal.append(point.timestamp, point));
+    }
+    check(wal.recover());
+}
+
+TEST_F(LSMTreeTest, TextFieldsStillReadable) {
+    std::string path = test_dir_ + "/text.wal";
+    {
+        // Unframed log from before fields were typed: text values
+        std::ofstream out(path, std::ios::binary);
+        int64_t ts = 1;
+        uint8_t value_type = 0;
+        double value = 1.0;
+        uint32_t num_tags = 0, num_fields = 1, key_len = 5, val_len = 4;
+        out.write(reinterpret_cast<const char*>(&ts), sizeof(ts));
+        out.write(reinterpret_cast<const char*>(&value_type), sizeof(value_type));
+        out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+        out.write(reinterpret_cast<const char*>(&num_tags), sizeof(num_tags));
+        out.write(reinterpret_cast<const char*>(&num_fields), sizeof(num_fields));
+        out.write(reinterpret_cast<const char*>(&key_len), sizeof(key_len));
+        out.write("value", 5);
+        out.write(reinterpret_cast<const char*>(&val_len), sizeof(val_len));
+        out.write("12.5", 4);
+    }
+
+    WriteAheadLog wal(path);
+    auto records = wal.recover();
+    ASSERT_EQ(records.size(), 1u);
+    const FieldValue& field = records[0].fields.at("value");
+    EXPECT_TRUE(field.is_string());
+    EXPECT_EQ(field.to_string(), "12.5");
+    EXPECT_EQ(field.as_double(), 12.5);
+    EXPECT_EQ(field.as_int64(), 12);
+
+    // Typed values convert the other way for string users
+    EXPECT_EQ(FieldValue(0.1).to_string(), "0.1");
+    EXPECT_EQ(FieldValue(int64_t{-7}).to_string(), "-7");
+    EXPECT_EQ(FieldValue(true).to_string(), "true");
+    EXPECT_EQ(FieldValue(UINT64_MAX).as_uint64(), UINT64_MAX);
+    EXPECT_EQ(FieldValue("18446744073709551615").as_uint64(), UINT64_MAX);
+}
+
+TEST_F(LSMTreeTest, RowFormatStillReadable) {
+    auto data = generate_series(500);
+
+    SSTable writer(test_dir_ + "/L0_1.sst", 0, 1);
+    ASSERT_TRUE(writer.build_from_memtable(to_points(data)));
+
+    SSTableOptions columnar_options;
+    columnar_options.format_version = SSTable::kColumnarFormatVersion;
+    SSTable reader(test_dir_ + "/L0_1.sst", 0, 1, columnar_options);
+    ASSERT_TRUE(reader.open());
+    EXPECT_EQ(reader.get_format_version(), SSTable::kRowFormatVersion);
+
+    auto all = reader.range_query(data.begin()->first, data.rbegin()->first);
+    EXPECT_EQ(all.size(), data.size());
+}
+
+TEST_F(LSMTreeTest, CompressedTreeSurvivesReopen) {
+    LSMConfig config;
+    config.data_dir = test_dir_ + "/tree";
+    config.enable_compression = true;
+    config.block_size_points = 256;
+
+    auto data = generate_series(2000);
+    {
+        LSMTree tree(config);
+        for (const auto& [ts, point] : data) {
+            ASSERT_TRUE(tree.put(ts, point));
+        }
+        ASSERT_TRUE(tree.flush());
+    }
+
+    LSMTree tree(config);
+    auto all = tree.range_query(data.begin()->first, data.rbegin()->first);
+    ASSERT_EQ(all.size(), data.size());
+
+    auto probe = std::next(data.begin(), 777);
+    TimeSeriesData result;
+    ASSERT_TRUE(tree.get(probe->first, result));
+    EXPECT_EQ(result.as_double(), probe->second.as_double());
+}
+
+TEST_F(LSMTreeTest, MappedReadsSurviveUnlink) {
+    auto data = generate_series(3000);
+    std::string path = test_dir_ + "/L1_7.sst";
+
+    SSTable writer(path, 1, 7);
+    ASSERT_TRUE(writer.build_from_memtable(to_points(data)));
+
+    SSTableOptions stream_options;
+    stream_options.use_mmap = false;
+    auto streamed = std::make_shared<SSTable>(path, 1, 7, stream_options);
+    auto mapped = std::make_shared<SSTable>(path, 1, 7);
+    ASSERT_TRUE(streamed->open());
+    ASSERT_TRUE(mapped->open());
+
+    auto expected = streamed->range_query(INT64_MIN, INT64_MAX);
+    ASSERT_EQ(expected.size(), data.size());
+
+    // Compaction may delete the file while readers still hold the table
+    fs::remove(path);
+
+    std::vector<std::thread> readers;
+    std::atomic<size_t> mismatches{0};
+    for (int t = 0; t < 4; ++t) {
+        readers.emplace_back([&, t]() {
+            for (size_t i = t; i < expected.size(); i += 4) {
+                TimeSeriesData result;
+                if (!mapped->get(expected[i].timestamp, result) ||
+                    result.as_double() != expected[i].as_double() ||
+                    result.tags != expected[i].tags) {
+                    mismatches++;
+                }
+            }
+        });
+    }
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    EXPECT_EQ(mismatches.load(), 0u);
+
+    auto all = mapped->range_query(INT64_MIN, INT64_MAX);
+    EXPECT_EQ(all.size(), expected.size());
+}
+
+TEST_F(LSMTreeTest, SharedBlockCacheServesRepeatedQueries) {
+    auto cache = std::make_shared<BlockCache>(64 * 1024 * 1024);
+
+    LSMConfig config;
+    config.data_dir = test_dir_ + "/cached";
+    config.block_cache = cache;
+
+    auto data = generate_series(1000);
+    LSMTree tree(config);
+    for (const auto& [ts, point] : data) {
+        ASSERT_TRUE(tree.put(ts, point));
+    }
+    ASSERT_TRUE(tree.flush());
+
+    auto first = tree.range_query(data.begin()->first, data.rbegin()->first);
+    auto after_first = tree.get_statistics();
+    auto second = tree.range_query(data.begin()->first, data.rbegin()->first);
+    auto after_second = tree.get_statistics();
+
+    ASSERT_EQ(first.size(), data.size());
+    ASSERT_EQ(second.size(), data.size());
+    EXPECT_GT(after_first.block_cache_misses, 0u);
+    EXPECT_EQ(after_second.block_cache_misses, after_first.block_cache_misses);
+    EXPECT_GT(after_second.block_cache_hits, after_first.block_cache_hits);
+    EXPECT_GT(cache->get_stats().high_priority_usage_bytes, 0u);
+}
+
+TEST_F(LSMTreeTest, SparseIndexMemoryScalesWithBlocks) {
+    auto data = generate_series(20000);
+
+    SSTable writer(test_dir_ + "/L0_1.sst", 0, 1);
+    ASSERT_TRUE(writer.build_from_memtable(to_points(data)));
+
+    SSTable reader(test_dir_ + "/L0_1.sst", 0, 1);
+    ASSERT_TRUE(reader.open());
+
+    // A dense index would need 20 bytes per point
+    size_t bloom_bytes = (data.size() * 10 + 7) / 8;
+    size_t num_blocks = (data.size() + SSTable::kRowBlockPoints - 1) / SSTable::kRowBlockPoints;
+    size_t index_bytes = bloom_bytes +
+                         num_blocks * (sizeof(SSTable::BlockIndexEntry) + sizeof(BlockSummary));
+    // Key filters: one bucket per block for two series, plus the file filter
+    EXPECT_GE(reader.get_index_memory_bytes(), index_bytes);
+    EXPECT_LE(reader.get_index_memory_bytes(), index_bytes + (num_blocks + 1) * 64);
+
+    // Lookups at block boundaries still resolve through in-block scanning
+    for (size_t i : {size_t(0), SSTable::kRowBlockPoints - 1, SSTable::kRowBlockPoints,
+                     data.size() - 1}) {
+        auto it = std::next(data.begin(), i);
+        TimeSeriesData result;
+        ASSERT_TRUE(reader.get(it->first, result));
+        EXPECT_EQ(result.timestamp, it->first);
+    }
+
+    auto window = reader.range_query(std::next(data.begin(), 100)->first,
+                                     std::next(data.begin(), 299)->first);
+    EXPECT_EQ(window.size(), 200u);
+}
+
+TEST_F(LSMTreeTest, StatisticsReportIndexMemory) {
+    LSMConfig config;
+    config.data_dir = test_dir_ + "/stats";
+
+    LSMTree tree(config);
+    EXPECT_EQ(tree.get_statistics().index_memory_bytes, 0u);
+
+    for (const auto& [ts, point] : generate_series(1000)) {
+        ASSERT_TRUE(tree.put(ts, point));
+    }
+    ASSERT_TRUE(tree.flush());
+    EXPECT_GT(tree.get_statistics().index_memory_bytes, 0u);
+}
+
+TEST_F(LSMTreeTest, MemTableKeepsSeriesSharingATimestamp) {
+    MemTable memtable(1024 * 1024);
+    for (int64_t ts = 0; ts < 100; ++ts) {
+        for (const char* host : {"h1", "h2", "h3"}) {
+            TimeSeriesData point;
+            point.timestamp = ts;
+            point.value = static_cast<double>(ts);
+            point.tags["host"] = host;
+            ASSERT_TRUE(memtable.put(ts, point));
+        }
+    }
+
+    EXPECT_EQ(memtable.size(), 300u);
+    auto window = memtable.range_query(10, 19);
+    ASSERT_EQ(window.size(), 30u);
+    for (size_t i = 1; i < window.size(); ++i) {
+        EXPECT_LE(window[i - 1].timestamp, window[i].timestamp);
+    }
+}
+
+TEST_F(LSMTreeTest, MemTableChargesItsArenaToTheTracker) {
+    auto tracker = std::make_shared<MemoryTracker>();
+    {
+        MemTable memtable(1024 * 1024, nullptr, tracker);
+        for (int64_t ts = 0; ts < 1000; ++ts) {
+            TimeSeriesData point;
+            point.timestamp = ts;
+            point.value = static_cast<double>(ts);
+            ASSERT_TRUE(memtable.put(ts, point));
+        }
+        EXPECT_EQ(tracker->usage(), memtable.arena_bytes());
+        EXPECT_GT(tracker->usage(), 0u);
+    }
+    EXPECT_EQ(tracker->usage(), 0u);
+}
+
+TEST_F(LSMTreeTest, NewestVersionWinsAcrossMemTableAndSSTables) {
+    LSMConfig config;
+    config.data_dir = test_dir_ + "/versions";
+    LSMTree tree(config);
+
+    auto make_point = [](int64_t ts, const std::string& host, double value) {
+        TimeSeriesData point;
+        point.timestamp = ts;
+        point.value = value;
+        point.tags["host"] = host;
+        return point;
+    };
+
+    for (int64_t ts = 0; ts < 50; ++ts) {
+        ASSERT_TRUE(tree.put(ts, make_point(ts, "a", 1.0)));
+        ASSERT_TRUE(tree.put(ts, make_point(ts, "b", 1.0)));
+    }
+    ASSERT_TRUE(tree.flush());
+
+    // Overwrite series "a" twice: once flushed, once still in the MemTable
+    for (int64_t ts = 0; ts < 50; ++ts) {
+        ASSERT_TRUE(tree.put(ts, make_point(ts, "a", 2.0)));
+    }
+    ASSERT_TRUE(tree.flush());
+    for (int64_t ts = 0; ts < 50; ts += 2) {
+        ASSERT_TRUE(tree.put(ts, make_point(ts, "a", 3.0)));
+    }
+
+    auto all = tree.range_query(0, 49);
+    ASSERT_EQ(all.size(), 100u);
+    for (const auto& point : all) {
+        if (point.tags.at("host") == "b") {
+            EXPECT_EQ(point.as_double(), 1.0);
+        } else {
+            EXPECT_EQ(point.as_double(), point.timestamp % 2 == 0 ? 3.0 : 2.0);
+        }
+    }
+
+    // Point lookups resolve to the newest file first
+    TimeSeriesData result;
+    ASSERT_TRUE(tree.get(1, result));
+    EXPECT_EQ(result.timestamp, 1);
+}
+
+TEST_F(LSMTreeTest, ConcurrentMemTablePuts) {
+    MemTable memtable(64 * 1024 * 1024);
+    constexpr int kThreads = 4;
+    constexpr int kPerThread = 5000;
+
+    std::vector<std::thread> writers;
+    for (int t = 0; t < kThreads; ++t) {
+        writers.emplace_back([&, t]() {
+            for (int i = 0; i < kPerThread; ++i) {
+                TimeSeriesData point;
+                point.timestamp = i * kThreads + t;
+                point.value = static_cast<double>(t);
+                point.tags["writer"] = std::to_string(t);
+                memtable.put(point.timestamp, point);
+            }
+        });
+    }
+    for (auto& writer : writers) {
+        writer.join();
+    }
+
+    auto all = memtable.get_all();
+    ASSERT_EQ(all.size(), static_cast<size_t>(kThreads * kPerThread));
+    for (size_t i = 0; i < all.size(); ++i) {
+        EXPECT_EQ(all[i].timestamp, static_cast<int64_t>(i));
+    }
+}
+
+TEST_F(LSMTreeTest, Crc32cMatchesReferenceVector) {
+    const std::string check = "123456789";
+    EXPECT_EQ(crc32c(reinterpret_cast<const uint8_t*>(check.data()), check.size()), 0xE3069283u);
+
+    // Extending a checksum equals checksumming the concatenation
+    uint32_t head = crc32c(reinterpret_cast<const uint8_t*>(check.data()), 4);
+    EXPECT_EQ(crc32c(reinterpret_cast<const uint8_t*>(check.data()) + 4, check.size() - 4, head),
+              0xE3069283u);
+}
+
+TEST_F(LSMTreeTest, WalGroupCommitKeepsConcurrentAppends) {
+    std::string path = test_dir_ + "/group.wal";
+    constexpr int kThreads = 4;
+    constexpr int kPerThread = 250;
+
+    WalOptions options;
+    options.sync_mode = WalSyncMode::PerGroup;
+    {
+        WriteAheadLog wal(path, options);
+        std::vector<std::thread> writers;
+        for (int t = 0; t < kThreads; ++t) {
+            writers.emplace_back([&, t]() {
+                for (int i = 0; i < kPerThread; ++i) {
+                    TimeSeriesData point;
+                    point.timestamp = i;
+                    point.value = static_cast<double>(t);
+                    point.tags["writer"] = std::to_string(t);
+                    EXPECT_TRUE(wal.append(point.timestamp, point));
+                }
+            });
+        }
+        for (auto& writer : writers) {
+            writer.join();
+        }
+        EXPECT_GT(wal.get_num_syncs(), 0u);
+        EXPECT_LE(wal.get_num_syncs(), static_cast<uint64_t>(kThreads * kPerThread));
+    }
+
+    WriteAheadLog reopened(path, options);
+    auto records = reopened.recover();
+    ASSERT_EQ(records.size(), static_cast<size_t>(kThreads * kPerThread));
+
+    // Each writer's records stay in its own append order
+    std::map<std::string, int64_t> last_seen;
+    for (const auto& record : records) {
+        const auto& writer = record.tags.at("writer");
+        auto it = last_seen.find(writer);
+        if (it != last_seen.end()) {
+            EXPECT_LT(it->second, record.timestamp);
+        }
+        last_seen[writer] = record.timestamp;
+    }
+}
+
+TEST_F(LSMTreeTest, WalDropsTornTail) {
+    std::string path = test_dir_ + "/torn.wal";
+    {
+        WriteAheadLog wal(path);
+        for (int64_t ts = 0; ts < 10; ++ts) {
+            TimeSeriesData point(ts, static_cast<double>(ts));
+            ASSERT_TRUE(wal.append(ts, point));
+        }
+        ASSERT_TRUE(wal.sync());
+    }
+
+    // Simulate a crash halfway through a record
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::app);
+        uint32_t length = 64;
+        uint32_t crc = 0xDEADBEEF;
+        out.write(reinterpret_cast<const char*>(&length), sizeof(length));
+        out.write(reinterpret_cast<const char*>(&crc), sizeof(crc));
+        out.write("partial", 7);
+    }
+
+    WriteAheadLog wal(path);
+    EXPECT_EQ(wal.recover().size(), 10u);
+
+    // New records land after the last intact one
+    ASSERT_TRUE(wal.append(10, TimeSeriesData(10, 10.0)));
+    auto records = wal.recover();
+    ASSERT_EQ(records.size(), 11u);
+    EXPECT_EQ(records.back().timestamp, 10);
+}
+
+TEST_F(LSMTreeTest, WalConvertsUnframedLog) {
+    std::string path = test_dir_ + "/legacy.wal";
+    {
+        // Old layout: records back to back without header or checksums
+        std::ofstream out(path, std::ios::binary);
+        for (int64_t ts = 1; ts <= 3; ++ts) {
+            uint8_t value_type = 0;
+            double value = ts * 1.5;
+            uint32_t num_tags = 1, key_len = 4, val_len = 2, num_fields = 0;
+            out.write(reinterpret_cast<const char*>(&ts), sizeof(ts));
+            out.write(reinterpret_cast<const char*>(&value_type), sizeof(value_type));
+            out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+            out.write(reinterpret_cast<const char*>(&num_tags), sizeof(num_tags));
+            out.write(reinterpret_cast<const char*>(&key_len), sizeof(key_len));
+            out.write("host", 4);
+            out.write(reinterpret_cast<const char*>(&val_len), sizeof(val_len));
+            out.write("h1", 2);
+            out.write(reinterpret_cast<const char*>(&num_fields), sizeof(num_fields));
+        }
+    }
+
+    WriteAheadLog wal(path);
+    auto records = wal.recover();
+    ASSERT_EQ(records.size(), 3u);
+    EXPECT_EQ(records[2].timestamp, 3);
+    EXPECT_EQ(records[2].as_double(), 4.5);
+    EXPECT_EQ(records[2].tags.at("host"), "h1");
+}
+
+TEST_F(LSMTreeTest, WalLogsSeriesIdsWithACatalog) {
+    std::string plain_path = test_dir_ + "/plain.wal";
+    std::string id_path = test_dir_ + "/ids.wal";
+    std::string catalog_path = test_dir_ + "/SERIES";
+    Tags tags = {{"host", "a-rather-long-host-name"}, {"region", "us-east-1"}};
+    {
+        auto catalog = std::make_shared<SeriesCatalog>();
+        ASSERT_TRUE(catalog->open(catalog_path));
+        WalOptions options;
+        options.catalog = catalog;
+        WriteAheadLog plain(plain_path);
+        WriteAheadLog ids(id_path, options);
+        for (int64_t ts = 0; ts < 100; ++ts) {
+            TimeSeriesData point(ts, static_cast<double>(ts), tags);
+            ASSERT_TRUE(plain.append(ts, point));
+            ASSERT_TRUE(ids.append(ts, point));
+        }
+        ASSERT_TRUE(plain.sync());
+        ASSERT_TRUE(ids.sync());
+    }
+    EXPECT_LT(fs::file_size(id_path), fs::file_size(plain_path) / 2);
+
+    // Tags come back through the reopened catalog; records without ids mix in
+    auto catalog = std::make_shared<SeriesCatalog>();
+    ASSERT_TRUE(catalog->open(catalog_path));
+    WalOptions options;
+    options.catalog = catalog;
+    WriteAheadLog ids(id_path, options);
+    ASSERT_TRUE(WriteAheadLog(id_path).append(100, TimeSeriesData(100, 1.0, {{"host", "b"}})));
+    auto records = ids.recover();
+    ASSERT_EQ(records.size(), 101u);
+    EXPECT_EQ(records[42].tags, tags);
+    EXPECT_EQ(records[42].as_double(), 42.0);
+    EXPECT_EQ(records[100].tags.at("host"), "b");
+
+    // Without the catalog an id record cannot be decoded
+    EXPECT_TRUE(WriteAheadLog(id_path).recover().empty());
+}
+
+TEST_F(LSMTreeTest, TagsSurviveRecoveryThroughSeriesCatalog) {
+    LSMConfig config;
+    config.data_dir = test_dir_ + "/catalog";
+    config.wal_sync_mode = WalSyncMode::PerGroup;
+    auto series = generate_series(500);
+    {
+        LSMTree tree(config);
+        for (const auto& [ts, point] : series) {
+            ASSERT_TRUE(tree.put(ts, point));
+        }
+    }
+    EXPECT_TRUE(fs::exists(config.data_dir + "/SERIES"));
+
+    LSMTree tree(config);
+    ASSERT_TRUE(tree.recover_from_wal());
+    auto results = tree.range_query(INT64_MIN, INT64_MAX, 0);
+    ASSERT_EQ(results.size(), series.size());
+    for (const auto& point : results) {
+        EXPECT_EQ(point.tags, series.at(point.timestamp).tags);
+    }
+}
+
+TEST_F(LSMTreeTest, WalCanBeDisabled) {
+    LSMConfig config;
+    config.data_dir = test_dir_ + "/nowal";
+    config.enable_wal = false;
+
+    LSMTree tree(config);
+    for (const auto& [ts, point] : generate_series(100)) {
+        ASSERT_TRUE(tree.put(ts, point));
+    }
+    EXPECT_FALSE(fs::exists(config.data_dir + "/wal.log"));
+    EXPECT_EQ(tree.range_query(INT64_MIN, INT64_MAX).size(), 100u);
+}
+
+TEST_F(LSMTreeTest, MergingIteratorPrefersNewestVersion) {
+    auto make_point = [](int64_t ts, const std::string& host, double value) {
+        TimeSeriesData point;
+        point.timestamp = ts;
+        point.value = value;
+        point.tags["host"] = host;
+        return point;
+    };
+
+    // Older row file and newer columnar file overlapping on [50, 100)
+    std::vector<TimeSeriesData> older, newer;
+    for (int64_t ts = 0; ts < 100; ++ts) {
+        older.push_back(make_point(ts, "a", 1.0));
+    }
+    for (int64_t ts = 50; ts < 150; ++ts) {
+        newer.push_back(make_point(ts, "a", 2.0));
+    }
+
+    auto old_table = std::make_shared<SSTable>(test_dir_ + "/L0_1.sst", 0, 1);
+    ASSERT_TRUE(old_table->build_from_memtable(older));
+    SSTableOptions columnar;
+    columnar.format_version = SSTable::kColumnarFormatVersion;
+    columnar.block_size_points = 16;
+    auto new_table = std::make_shared<SSTable>(test_dir_ + "/L0_2.sst", 0, 2, columnar);
+    ASSERT_TRUE(new_table->build_from_memtable(newer));
+
+    std::vector<TimeSeriesData> merged;
+    for (MergingIterator it({new_table, old_table}); it.valid(); it.next()) {
+        merged.push_back(it.value());
+    }
+    ASSERT_EQ(merged.size(), 150u);
+    for (size_t i = 0; i < merged.size(); ++i) {
+        EXPECT_EQ(merged[i].timestamp, static_cast<int64_t>(i));
+        EXPECT_EQ(merged[i].as_double(), i < 50 ? 1.0 : 2.0);
+    }
+
+    // Streamed v1 output goes through a spill file that must not linger
+    SSTable output(test_dir_ + "/L1_3.sst", 1, 3);
+    ASSERT_TRUE(output.build_from_sstables({old_table, new_table}));
+    EXPECT_FALSE(fs::exists(test_dir_ + "/L1_3.sst.rows"));
+    SSTable reopened(test_dir_ + "/L1_3.sst", 1, 3);
+    ASSERT_TRUE(reopened.open());
+    EXPECT_EQ(reopened.get_num_entries(), 150u);
+    TimeSeriesData result;
+    ASSERT_TRUE(reopened.get(75, result));
+    EXPECT_EQ(result.as_double(), 2.0);
+}
+
+TEST_F(LSMTreeTest, CompactionSplitsOutputByTargetSize) {
+    LSMConfig config;
+    config.data_dir = test_dir_ + "/split";
+    config.level0_file_num_compaction_trigger = 2;
+    config.target_file_size_bytes = 32 * 1024;
+
+    auto data = generate_series(4000);
+    LSMTree tree(config);
+    for (const auto& [ts, point] : data) {
+        ASSERT_TRUE(tree.put(ts, point));
+    }
+    ASSERT_TRUE(tree.flush());
+
+    // Rewrite every other point, then let the second flush trigger compaction
+    size_t i = 0;
+    for (const auto& [ts, point] : data) {
+        if (i++ % 2 == 0) {
+            TimeSeriesData updated = point;
+            updated.value = -1.0;
+            ASSERT_TRUE(tree.put(ts, updated));
+        }
+    }
+    ASSERT_TRUE(tree.flush());
+    tree.wait_for_compaction();
+
+    auto stats = tree.get_statistics();
+    EXPECT_GT(stats.num_sstables, 2u);
+
+    auto all = tree.range_query(INT64_MIN, INT64_MAX);
+    ASSERT_EQ(all.size(), data.size());
+    i = 0;
+    for (const auto& point : all) {
+        EXPECT_EQ(point.as_double() == -1.0, i++ % 2 == 0);
+    }
+    for (const auto& entry : fs::directory_iterator(config.data_dir)) {
+        EXPECT_NE(entry.path().extension(), ".rows");
+    }
+}
+
+TEST_F(LSMTreeTest, ParallelSubcompactionsKeepEveryPoint) {
+    LSMConfig config;
+    config.data_dir = test_dir_ + "/parallel";
+    config.level0_file_num_compaction_trigger = 4;
+    config.target_file_size_bytes = 16 * 1024;
+    config.compaction_threads = 3;
+    config.max_subcompactions = 4;
+
+    auto data = generate_series(20000);
+    LSMTree tree(config);
+
+    // Four overlapping L0 files: each flush covers the whole time span
+    for (size_t round = 0; round < 4; ++round) {
+        size_t i = 0;
+        for (const auto& [ts, point] : data) {
+            if (i++ % 4 == round) {
+                ASSERT_TRUE(tree.put(ts, point));
+            }
+        }
+        ASSERT_TRUE(tree.flush());
+    }
+    tree.wait_for_compaction();
+
+    auto stats = tree.get_statistics();
+    EXPECT_GE(stats.compactions, 1u);
+    EXPECT_GE(stats.num_sstables, 4u);
+
+    auto all = tree.range_query(INT64_MIN, INT64_MAX);
+    ASSERT_EQ(all.size(), data.size());
+    auto it = data.begin();
+    for (const auto& point : all) {
+        ASSERT_EQ(point.timestamp, it->first);
+        ++it;
+    }
+}
+
+TEST_F(LSMTreeTest, MergingIteratorHonorsTimeRange) {
+    auto points = to_points(generate_series(1000));
+    auto table = std::make_shared<SSTable>(test_dir_ + "/L0_1.sst", 0, 1);
+    ASSERT_TRUE(table->build_from_memtable(points));
+
+    int64_t start = points[130].timestamp;
+    int64_t end = points[700].timestamp;
+    size_t count = 0;
+    for (MergingIterator it({table}, false, start, end); it.valid(); it.next()) {
+        EXPECT_EQ(it.value().timestamp, points[130 + count].timestamp);
+        ++count;
+    }
+    EXPECT_EQ(count, 571u);
+}
+
+TEST_F(LSMTreeTest, WritesSlowDownWithLevel0Files) {
+    LSMConfig config;
+    config.data_dir = test_dir_ + "/slowdown";
+    config.level0_file_num_compaction_trigger = 100;
+    config.level0_slowdown_writes_trigger = 1;
+    config.delayed_write_rate = 64 * 1024;
+
+    LSMTree tree(config);
+    auto data = generate_series(2000);
+    auto it = data.begin();
+    for (size_t i = 0; i < 100; ++i, ++it) {
+        ASSERT_TRUE(tree.put(it->first, it->second));
+    }
+    EXPECT_EQ(tree.get_statistics().write_slowdowns, 0u);
+
+    ASSERT_TRUE(tree.flush());
+    for (; it != data.end(); ++it) {
+        ASSERT_TRUE(tree.put(it->first, it->second));
+    }
+
+    auto stats = tree.get_statistics();
+    EXPECT_EQ(stats.level0_files, 1u);
+    EXPECT_EQ(stats.write_slowdowns, data.size() - 100);
+    EXPECT_GT(stats.write_stall_micros, 0u);
+}
+
+TEST_F(LSMTreeTest, WritesStopUntilLevel0Drains) {
+    LSMConfig config;
+    config.data_dir = test_dir_ + "/stop";
+    config.level0_file_num_compaction_trigger = 100;
+    config.level0_stop_writes_trigger = 2;
+
+    LSMTree tree(config);
+    for (int64_t round = 0; round < 2; ++round) {
+        ASSERT_TRUE(tree.put(round, TimeSeriesData(round, 1.0)));
+        ASSERT_TRUE(tree.flush());
+    }
+
+    std::atomic<bool> done{false};
+    std::thread writer([&]() {
+        tree.put(10, TimeSeriesData(10, 1.0));
+        done = true;
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_FALSE(done.load());
+
+    // Dropping the L0 files lifts the stop
+    tree.clear_all();
+    writer.join();
+    EXPECT_TRUE(done.load());
+
+    auto stats = tree.get_statistics();
+    EXPECT_EQ(stats.write_stops, 1u);
+    EXPECT_GT(stats.write_stall_micros, 50000u);
+}
+
+TEST_F(LSMTreeTest, RateLimiterThrottlesFlushes) {
+    auto limiter = std::make_shared<RateLimiter>(8ULL * 1024 * 1024 * 1024);
+
+    LSMConfig config;
+    config.data_dir = test_dir_ + "/limited";
+    config.rate_limiter = limiter;
+
+    LSMTree tree(config);
+    for (const auto& [ts, point] : generate_series(1000)) {
+        ASSERT_TRUE(tree.put(ts, point));
+    }
+    ASSERT_TRUE(tree.flush());
+
+    // Every byte of the new file was charged
+    auto stats = tree.get_statistics();
+    EXPECT_GE(limiter->get_total_bytes() + sizeof(SSTable::Metadata), stats.total_size_bytes);
+    EXPECT_GT(limiter->get_total_bytes(), stats.total_size_bytes / 2);
+}
+
+TEST_F(LSMTreeTest, IteratorMergesMemTablesAndSSTablesInOrder) {
+    LSMConfig config;
+    config.data_dir = test_dir_ + "/iterator";
+    LSMTree tree(config);
+
+    // Interleave timestamps across two files and the active MemTable
+    for (int64_t ts = 0; ts < 300; ts += 3) {
+        TimeSeriesData point(ts, 0.0);
+        ASSERT_TRUE(tree.put(ts, point));
+    }
+    ASSERT_TRUE(tree.flush());
+    for (int64_t ts = 1; ts < 300; ts += 3) {
+        TimeSeriesData point(ts, 1.0);
+        ASSERT_TRUE(tree.put(ts, point));
+    }
+    ASSERT_TRUE(tree.flush());
+    for (int64_t ts = 2; ts < 300; ts += 3) {
+        TimeSeriesData point(ts, 2.0);
+        ASSERT_TRUE(tree.put(ts, point));
+    }
+    // Newer version of a flushed point
+    TimeSeriesData rewritten(150, 9.0);
+    ASSERT_TRUE(tree.put(150, rewritten));
+
+    int64_t expected = 100;
+    for (auto it = tree.new_iterator(100, 199); it->valid(); it->next()) {
+        ASSERT_EQ(it->value().timestamp, expected);
+        EXPECT_EQ(it->value().as_double(), expected == 150 ? 9.0 : double(expected % 3));
+        ++expected;
+    }
+    EXPECT_EQ(expected, 200);
+
+    // An empty range yields nothing
+    EXPECT_FALSE(tree.new_iterator(1000, 2000)->valid());
+}
+
+TEST_F(LSMTreeTest, RangeQueryLimitStopsEarly) {
+    LSMConfig config;
+    config.data_dir = test_dir_ + "/limit";
+    LSMTree tree(config);
+
+    auto data = generate_series(5000);
+    for (const auto& [ts, point] : data) {
+        ASSERT_TRUE(tree.put(ts, point));
+    }
+    ASSERT_TRUE(tree.flush());
+
+    auto first = tree.range_query(INT64_MIN, INT64_MAX, 10);
+    ASSERT_EQ(first.size(), 10u);
+    auto expected = data.begin();
+    for (const auto& point : first) {
+        EXPECT_EQ(point.timestamp, (expected++)->first);
+    }
+    EXPECT_EQ(tree.range_query(INT64_MIN, INT64_MAX).size(), data.size());
+}
+
+TEST_F(LSMTreeTest, IteratorOutlivesCompaction) {
+    LSMConfig config;
+    config.data_dir = test_dir_ + "/iterator_compaction";
+    config.level0_file_num_compaction_trigger = 2;
+    LSMTree tree(config);
+
+    for (int64_t ts = 0; ts < 200; ++ts) {
+        TimeSeriesData point(ts, double(ts));
+        ASSERT_TRUE(tree.put(ts, point));
+        if (ts == 99) {
+            ASSERT_TRUE(tree.flush());
+        }
+    }
+    ASSERT_TRUE(tree.flush());
+
+    auto it = tree.new_iterator();
+    tree.trigger_compaction();
+    tree.wait_for_compaction();
+
+    size_t count = 0;
+    for (; it->valid(); it->next()) {
+        EXPECT_EQ(it->value().timestamp, int64_t(count));
+        ++count;
+    }
+    EXPECT_EQ(count, 200u);
+}
+
+TEST_F(LSMTreeTest, KeyFiltersSkipBlocksOfOtherSeries) {
+    // Four blocks, each holding a single host
+    std::vector<TimeSeriesData> points;
+    for (int64_t ts = 0; ts < 400; ++ts) {
+        TimeSeriesData point(ts, double(ts));
+        point.tags["host"] = "h" + std::to_string(ts / 100);
+        points.push_back(point);
+    }
+
+    for (uint32_t version : {SSTable::kRowFormatVersion, SSTable::kColumnarFormatVersion}) {
+        SSTableOptions options;
+        options.format_version = version;
+        options.block_size_points = 100;
+        std::string path = test_dir_ + "/filtered_v" + std::to_string(version) + ".sst";
+        {
+            SSTable writer(path, 0, 1, options);
+            ASSERT_TRUE(writer.build_from_memtable(points));
+        }
+
+        SSTable table(path, 0, 1, options);
+        ASSERT_TRUE(table.open());
+        EXPECT_TRUE(table.might_match(SSTable::filter_keys_for({{"host", "h2"}})));
+        EXPECT_FALSE(table.might_match(SSTable::filter_keys_for({{"host", "h9"}})));
+
+        // Only the blocks that may hold h2 are read (v1 blocks are 128 rows)
+        auto keys = SSTable::filter_keys_for({{"host", "h2"}});
+        size_t yielded = 0;
+        size_t matching = 0;
+        for (auto it = table.new_iterator(true, INT64_MIN, INT64_MAX, keys); it->valid(); it->next()) {
+            ++yielded;
+            matching += it->value().tags.at("host") == "h2" ? 1 : 0;
+        }
+        EXPECT_EQ(matching, 100u);
+        EXPECT_LT(yielded, 400u);
+
+        // Blocks past end_time are not read either
+        size_t bounded = 0;
+        for (auto it = table.new_iterator(true, 0, 50); it->valid(); it->next()) {
+            ++bounded;
+        }
+        EXPECT_LT(bounded, 400u);
+    }
+}
+
+TEST_F(LSMTreeTest, FilesWithoutKeyFiltersStillReadable) {
+    auto data = generate_series(2000);
+    std::string path = test_dir_ + "/legacy.sst";
+    SSTableOptions options;
+    options.format_version = SSTable::kColumnarFormatVersion;
+    options.block_size_points = 256;
+    {
+        SSTable writer(path, 0, 1, options);
+        ASSERT_TRUE(writer.build_from_memtable(to_points(data)));
+    }
+
+    // Cut the key filter section off, as in files written before it existed
+    uint64_t filters_offset = 0;
+    {
+        std::ifstream in(path, std::ios::binary);
+        in.seekg(-16, std::ios::end);
+        in.read(reinterpret_cast<char*>(&filters_offset), sizeof(filters_offset));
+    }
+    ASSERT_GT(filters_offset, 0u);
+    fs::resize_file(path, filters_offset);
+
+    SSTable table(path, 0, 1, options);
+    ASSERT_TRUE(table.open());
+    EXPECT_TRUE(table.might_match(SSTable::filter_keys_for({{"sensor", "none"}})));
+    EXPECT_EQ(table.range_query(INT64_MIN, INT64_MAX).size(), data.size());
+}
+
+TEST_F(LSMTreeTest, IteratorFiltersByTags) {
+    LSMConfig config;
+    config.data_dir = test_dir_ + "/tag_filter";
+    LSMTree tree(config);
+
+    for (int64_t ts = 0; ts < 300; ++ts) {
+        TimeSeriesData point(ts, double(ts));
+        point.tags["host"] = (ts % 3 == 0) ? "a" : "b";
+        ASSERT_TRUE(tree.put(ts, point));
+        if (ts == 149) {
+            ASSERT_TRUE(tree.flush());
+        }
+    }
+
+    size_t count = 0;
+    for (auto it = tree.new_iterator(INT64_MIN, INT64_MAX, {{"host", "a"}}); it->valid(); it->next()) {
+        EXPECT_EQ(it->value().timestamp % 3, 0);
+        ++count;
+    }
+    EXPECT_EQ(count, 100u);
+    EXPECT_FALSE(tree.new_iterator(INT64_MIN, INT64_MAX, {{"host", "c"}})->valid());
+}
+
+TEST_F(LSMTreeTest, ReopenOpensSSTablesLazily) {
+    LSMConfig config;
+    config.data_dir = test_dir_ + "/lazy";
+    auto data = generate_series(3000);
+    {
+        LSMTree tree(config);
+        size_t i = 0;
+        for (const auto& [ts, point] : data) {
+            ASSERT_TRUE(tree.put(ts, point));
+            if (++i % 1000 == 0) {
+                ASSERT_TRUE(tree.flush());
+            }
+        }
+    }
+    ASSERT_TRUE(fs::exists(config.data_dir + "/MANIFEST"));
+
+    LSMTree tree(config);
+    auto stats = tree.get_statistics();
+    EXPECT_GT(stats.num_sstables, 0u);
+    EXPECT_EQ(stats.loaded_sstables, 0u);
+
+    EXPECT_EQ(tree.range_query(INT64_MIN, INT64_MAX).size(), data.size());
+    EXPECT_GT(tree.get_statistics().loaded_sstables, 0u);
+}
+
+TEST_F(LSMTreeTest, ManifestDropsUnlistedSSTables) {
+    LSMConfig config;
+    config.data_dir = test_dir_ + "/orphans";
+    {
+        LSMTree tree(config);
+        for (const auto& [ts, point] : generate_series(500)) {
+            ASSERT_TRUE(tree.put(ts, point));
+        }
+    }
+
+    // A file left behind by a flush that crashed before the manifest update
+    std::string orphan = config.data_dir + "/L0_999.sst";
+    {
+        SSTable writer(orphan, 0, 999);
+        ASSERT_TRUE(writer.build_from_memtable(to_points(generate_series(10))));
+    }
+
+    LSMTree tree(config);
+    EXPECT_FALSE(fs::exists(orphan));
+    EXPECT_EQ(tree.range_query(INT64_MIN, INT64_MAX).size(), 500u);
+}
+
+TEST_F(LSMTreeTest, MemTableSequencedPutKeepsHighestSequence) {
+    MemTable memtable(1024 * 1024);
+    uint64_t first = memtable.reserve_sequences(2);
+
+    // Replay threads may insert a later version before an earlier one
+    memtable.put(5, TimeSeriesData(5, 2.0), first + 1);
+    memtable.put(5, TimeSeriesData(5, 1.0), first);
+
+    TimeSeriesData value;
+    ASSERT_TRUE(memtable.get(5, value));
+    EXPECT_EQ(value.as_double(), 2.0);
+    ASSERT_TRUE(memtable.put(6, TimeSeriesData(6, 3.0)));
+    EXPECT_EQ(memtable.range_query(0, 10).size(), 2u);
+}
+
+TEST_F(LSMTreeTest, MemTableMovedPutsAndClear) {
+    MemTable memtable(1024 * 1024);
+    for (int64_t ts = 0; ts < 1000; ++ts) {
+        TimeSeriesData point(ts, static_cast<double>(ts));
+        if (ts % 2 == 0) {
+            point.tags["host"] = "h" + std::to_string(ts % 10);
+            point.fields["note"] = std::string(40, 'x');
+        }
+        if (ts % 3 == 0) {
+            point.value = std::vector<double>{1.0, 2.0, static_cast<double>(ts)};
+        }
+        ASSERT_TRUE(memtable.put(ts, std::move(point)));
+    }
+    size_t used = memtable.arena_bytes();
+    EXPECT_GT(used, Arena::kBlockSize);
+
+    TimeSeriesData value;
+    ASSERT_TRUE(memtable.get(6, value));
+    EXPECT_EQ(value.tags.at("host"), "h6");
+    EXPECT_EQ(value.fields.at("note").to_string(), std::string(40, 'x'));
+    EXPECT_EQ(value.as_vector(), (std::vector<double>{1.0, 2.0, 6.0}));
+
+    // Dropping the arena frees everything but the new head's block
+    memtable.clear();
+    EXPECT_EQ(memtable.size(), 0u);
+    EXPECT_LE(memtable.arena_bytes(), Arena::kBlockSize + 64);
+    EXPECT_FALSE(memtable.get(6, value));
+    ASSERT_TRUE(memtable.put(7, TimeSeriesData(7, 7.0)));
+    ASSERT_TRUE(memtable.get(7, value));
+    EXPECT_EQ(value.as_double(), 7.0);
+}
+
+TEST_F(LSMTreeTest, MemTableFullLeavesMovedPointIntact) {
+    MemTable memtable(256);
+    TimeSeriesData first(1, 1.0);
+    first.tags["host"] = "h1";
+    ASSERT_TRUE(memtable.put(1, std::move(first)));
+
+    TimeSeriesData second(2, 2.0);
+    second.tags["host"] = std::string(512, 'h');
+    EXPECT_FALSE(memtable.put(2, std::move(second)));
+    EXPECT_EQ(second.tags.at("host").size(), 512u);
+}
+
+TEST_F(LSMTreeTest, MovedPutBatchAcrossMemTableSwitches) {
+    LSMConfig config;
+    config.data_dir = test_dir_ + "/moved";
+    config.memtable_size_bytes = 16 * 1024;
+    fs::create_directories(config.data_dir);
+    LSMTree tree(config);
+
+    std::vector<TimeSeriesData> batch;
+    for (int64_t ts = 0; ts < 2000; ++ts) {
+        TimeSeriesData point(ts, static_cast<double>(ts));
+        point.tags["host"] = "h" + std::to_string(ts % 4);
+        batch.push_back(std::move(point));
+    }
+    ASSERT_TRUE(tree.put_batch(std::move(batch)));
+
+    auto points = tree.range_query(0, 1999);
+    ASSERT_EQ(points.size(), 2000u);
+    for (int64_t ts = 0; ts < 2000; ++ts) {
+        EXPECT_EQ(points[ts].timestamp, ts);
+        EXPECT_EQ(points[ts].tags.at("host"), "h" + std::to_string(ts % 4));
+    }
+}
+
+TEST_F(LSMTreeTest, ParallelWalReplayKeepsLastVersion) {
+    LSMConfig config;
+    config.data_dir = test_dir_ + "/replay";
+    config.memtable_size_bytes = 64 * 1024 * 1024;
+    config.recovery_threads = 4;
+    fs::create_directories(config.data_dir);
+
+    // Enough frames for several segments; every timestamp is written five times
+    constexpr int64_t kRecords = 40000;
+    constexpr int64_t kTimestamps = kRecords / 5;
+    std::string wal_path = config.data_dir + "/wal.log";
+    {
+        WriteAheadLog wal(wal_path);
+        for (int64_t i = 0; i < kRecords; ++i) {
+            ASSERT_TRUE(wal.append(i % kTimestamps, TimeSeriesData(i % kTimestamps, double(i))));
+        }
+        ASSERT_TRUE(wal.sync());
+    }
+    {
+        std::ofstream out(wal_path, std::ios::binary | std::ios::app);
+        uint32_t length = 64;
+        uint32_t crc = 0xDEADBEEF;
+        out.write(reinterpret_cast<const char*>(&length), sizeof(length));
+        out.write(reinterpret_cast<const char*>(&crc), sizeof(crc));
+    }
+
+    LSMTree tree(config);
+    ASSERT_TRUE(tree.recover_from_wal());
+    auto results = tree.range_query(INT64_MIN, INT64_MAX);
+    ASSERT_EQ(results.size(), static_cast<size_t>(kTimestamps));
+    for (const auto& point : results) {
+        EXPECT_EQ(point.as_double(), double(point.timestamp + 4 * kTimestamps));
+    }
+}
+
+TEST_F(LSMTreeTest, FlushCutsSSTablesAtPartitionBoundaries) {
+    LSMConfig config;
+    config.data_dir = test_dir_ + "/partitioned";
+    config.partition_duration = 1000;
+    config.level0_file_num_compaction_trigger = 100;
+    LSMTree tree(config);
+
+    for (int64_t ts = 0; ts < 5000; ts += 10) {
+        ASSERT_TRUE(tree.put(ts, TimeSeriesData(ts, double(ts))));
+    }
+    ASSERT_TRUE(tree.flush());
+
+    auto stats = tree.get_statistics();
+    EXPECT_EQ(stats.num_sstables, 5u);
+    EXPECT_EQ(tree.range_query(INT64_MIN, INT64_MAX).size(), 500u);
+}
+
+TEST_F(LSMTreeTest, CompactionKeepsFilesInsidePartitions) {
+    LSMConfig config;
+    config.data_dir = test_dir_ + "/partitioned_compaction";
+    config.partition_duration = 1000;
+    config.level0_file_num_compaction_trigger = 2;
+    {
+        LSMTree tree(config);
+        // Two overlapping flushes, merged into level 1
+        for (int pass = 0; pass < 2; ++pass) {
+            for (int64_t ts = pass; ts < 3000; ts += 2) {
+                ASSERT_TRUE(tree.put(ts, TimeSeriesData(ts, double(ts))));
+            }
+            ASSERT_TRUE(tree.flush());
+        }
+        tree.wait_for_compaction();
+        EXPECT_GT(tree.get_statistics().compactions, 0u);
+        EXPECT_EQ(tree.range_query(INT64_MIN, INT64_MAX).size(), 3000u);
+    }
+
+    for (const auto& entry : fs::directory_iterator(config.data_dir)) {
+        if (entry.path().extension() != ".sst") continue;
+        SSTable table(entry.path().string(), 0, 0);
+        ASSERT_TRUE(table.open());
+        EXPECT_EQ(table.get_min_timestamp() / 1000, table.get_max_timestamp() / 1000)
+            << entry.path();
+    }
+}
+
+TEST_F(LSMTreeTest, DropBeforeUnlinksWholeFiles) {
+    LSMConfig config;
+    config.data_dir = test_dir_ + "/retention";
+    config.partition_duration = 1000;
+    config.level0_file_num_compaction_trigger = 100;
+    {
+        LSMTree tree(config);
+        for (int64_t ts = 0; ts < 4000; ts += 10) {
+            ASSERT_TRUE(tree.put(ts, TimeSeriesData(ts, double(ts))));
+        }
+        ASSERT_TRUE(tree.flush());
+        ASSERT_EQ(tree.get_statistics().num_sstables, 4u);
+
+        // Partitions 0 and 1 go away as files; 2500 only hides half of partition 2
+        EXPECT_EQ(tree.drop_before(2500), 200u);
+        auto stats = tree.get_statistics();
+        EXPECT_EQ(stats.num_sstables, 2u);
+        EXPECT_EQ(stats.expired_sstables, 2u);
+        TimeSeriesData hidden;
+        EXPECT_FALSE(tree.get(2400, hidden));
+
+        auto results = tree.range_query(INT64_MIN, INT64_MAX);
+        ASSERT_EQ(results.size(), 150u);
+        EXPECT_EQ(results.front().timestamp, 2500);
+    }
+
+    // The cutoff is kept in the manifest
+    LSMTree reopened(config);
+    EXPECT_EQ(reopened.get_retention_cutoff(), 2500);
+    EXPECT_EQ(reopened.range_query(INT64_MIN, INT64_MAX).size(), 150u);
+}
+
+TEST_F(LSMTreeTest, TtlExpiresOldPartitions) {
+    LSMConfig config;
+    config.data_dir = test_dir_ + "/ttl";
+    config.partition_duration = 1000;
+    config.ttl = 2000;
+    config.level0_file_num_compaction_trigger = 100;
+    LSMTree tree(config);
+
+    for (int64_t ts = 0; ts < 6000; ts += 10) {
+        ASSERT_TRUE(tree.put(ts, TimeSeriesData(ts, double(ts))));
+        if (ts % 1000 == 990) {
+            ASSERT_TRUE(tree.flush());
+        }
+    }
+
+    // Newest point 5990: everything before 3990 has expired
+    auto stats = tree.get_statistics();
+    EXPECT_EQ(stats.num_sstables, 3u);
+    EXPECT_EQ(stats.expired_points, 300u);
+    auto results = tree.range_query(INT64_MIN, INT64_MAX);
+    ASSERT_FALSE(results.empty());
+    EXPECT_EQ(results.front().timestamp, 3990);
+}
+
+TEST_F(LSMTreeTest, CheckpointLinksFilesAndRestores) {
+    LSMConfig config;
+    config.data_dir = test_dir_ + "/tree";
+    config.level0_file_num_compaction_trigger = 100;
+    const std::string checkpoint = test_dir_ + "/checkpoint";
+    LSMTree tree(config);
+
+    for (int64_t ts = 0; ts < 1000; ++ts) {
+        ASSERT_TRUE(tree.put(ts, TimeSeriesData(ts, double(ts))));
+        if (ts % 250 == 249) {
+            ASSERT_TRUE(tree.flush());
+        }
+    }
+    // Left in the MemTable: the checkpoint flushes it
+    ASSERT_TRUE(tree.put(1000, TimeSeriesData(1000, 1000.0)));
+    ASSERT_TRUE(tree.create_checkpoint(checkpoint));
+    EXPECT_FALSE(tree.create_checkpoint(checkpoint));
+
+    // Every file is a hard link of a live SSTable, not a copy
+    size_t linked = 0;
+    for (const auto& entry : fs::directory_iterator(checkpoint)) {
+        if (entry.path().extension() == ".sst") {
+            EXPECT_TRUE(fs::equivalent(entry.path(), config.data_dir / entry.path().filename()));
+            EXPECT_EQ(fs::hard_link_count(entry.path()), 2u);
+            ++linked;
+        }
+    }
+    EXPECT_EQ(linked, tree.get_statistics().num_sstables);
+
+    // Writes after the checkpoint, partly flushed, and a clear
+    for (int64_t ts = 0; ts < 2000; ts += 2) {
+        ASSERT_TRUE(tree.put(ts, TimeSeriesData(ts, -1.0)));
+    }
+    ASSERT_TRUE(tree.flush());
+    ASSERT_TRUE(tree.put(5000, TimeSeriesData(5000, 5000.0)));
+    tree.clear_all();
+    ASSERT_TRUE(tree.put(7000, TimeSeriesData(7000, 7000.0)));
+
+    auto check = [](LSMTree& restored) {
+        auto results = restored.range_query(INT64_MIN, INT64_MAX);
+        ASSERT_EQ(results.size(), 1001u);
+        for (size_t i = 0; i < results.size(); ++i) {
+            ASSERT_EQ(results[i].timestamp, static_cast<int64_t>(i));
+            ASSERT_EQ(results[i].as_double(), static_cast<double>(i));
+        }
+    };
+    ASSERT_TRUE(tree.restore_checkpoint(checkpoint));
+    check(tree);
+    EXPECT_EQ(tree.get_newest_timestamp(), 1000);
+
+    // The checkpoint survives writes to the restored tree and restores again
+    ASSERT_TRUE(tree.put(10, TimeSeriesData(10, -10.0)));
+    ASSERT_TRUE(tree.flush());
+    ASSERT_TRUE(tree.restore_checkpoint(checkpoint));
+    check(tree);
+
+    LSMTree reopened(config);
+    check(reopened);
+    EXPECT_FALSE(tree.restore_checkpoint(test_dir_ + "/missing"));
+}
+
+TEST_F(LSMTreeTest, AggregateMatchesDecodedScan) {
+    LSMConfig config;
+    config.data_dir = test_dir_ + "/aggregate";
+    config.enable_compression = true;
+    config.block_size_points = 128;
+    config.level0_file_num_compaction_trigger = 100;
+    LSMTree tree(config);
+
+    // Two disjoint flushes, one overlapping flush with newer versions, and
+    // points still in the MemTable
+    for (int64_t ts = 0; ts < 4000; ++ts) {
+        ASSERT_TRUE(tree.put(ts, TimeSeriesData(ts, double(ts % 97))));
+    }
+    ASSERT_TRUE(tree.flush());
+    for (int64_t ts = 4000; ts < 8000; ++ts) {
+        ASSERT_TRUE(tree.put(ts, TimeSeriesData(ts, double(ts % 89))));
+    }
+    ASSERT_TRUE(tree.flush());
+    for (int64_t ts = 5000; ts < 5100; ++ts) {
+        ASSERT_TRUE(tree.put(ts, TimeSeriesData(ts, -1.0)));
+    }
+    ASSERT_TRUE(tree.flush());
+    for (int64_t ts = 7900; ts < 8100; ++ts) {
+        ASSERT_TRUE(tree.put(ts, TimeSeriesData(ts, 1000.0)));
+    }
+
+    for (auto [start, end] : std::vector<std::pair<int64_t, int64_t>>{
+             {INT64_MIN, INT64_MAX}, {123, 6789}, {5050, 5060}, {7000, 7999}}) {
+        BlockSummary expected;
+        for (const auto& point : tree.range_query(start, end)) {
+            expected.add(point);
+        }
+        auto summary = tree.aggregate(start, end);
+        EXPECT_EQ(summary.count, expected.count) << start << ".." << end;
+        EXPECT_DOUBLE_EQ(summary.sum, expected.sum);
+        EXPECT_EQ(summary.min, expected.min);
+        EXPECT_EQ(summary.max, expected.max);
+        EXPECT_EQ(summary.first, expected.first);
+        EXPECT_EQ(summary.last, expected.last);
+        EXPECT_DOUBLE_EQ(summary.value(AggregationType::AVG),
+                         expected.value(AggregationType::AVG));
+    }
+    EXPECT_GT(tree.get_statistics().summarized_blocks, 0u);
+}
+
+TEST_F(LSMTreeTest, AggregateDecodesOnlyEdgeBlocks) {
+    LSMConfig config;
+    config.data_dir = test_dir_ + "/aggregate_edges";
+    config.enable_compression = true;
+    config.block_size_points = 100;
+    config.block_cache = std::make_shared<BlockCache>(64 * 1024 * 1024);
+    LSMTree tree(config);
+    for (int64_t ts = 0; ts < 10000; ++ts) {
+        ASSERT_TRUE(tree.put(ts, TimeSeriesData(ts, 1.0)));
+    }
+    ASSERT_TRUE(tree.flush());
+
+    // 100 blocks; the range cuts into the first and last one it touches
+    auto before = tree.get_statistics();
+    auto summary = tree.aggregate(150, 9849);
+    auto after = tree.get_statistics();
+    EXPECT_EQ(summary.count, 9700u);
+    EXPECT_EQ(summary.value(AggregationType::SUM), 9700.0);
+    EXPECT_EQ(after.summarized_blocks - before.summarized_blocks, 96u);
+    EXPECT_LE(after.block_cache_misses - before.block_cache_misses, 3u);
+
+    // Tag filters cannot use the summaries
+    EXPECT_EQ(tree.aggregate(150, 9849, {{"host", "a"}}).count, 0u);
+}
+
+TEST_F(LSMTreeTest, AggregateSketchesFromBlockSummaries) {
+    for (bool block_sketches : {false, true}) {
+        LSMConfig config;
+        config.data_dir = test_dir_ + "/aggregate_sketches_" + std::to_string(block_sketches);
+        config.enable_compression = true;
+        config.block_size_points = 100;
+        config.block_sketches = block_sketches;
+        LSMTree tree(config);
+        for (int64_t ts = 0; ts < 10000; ++ts) {
+            ASSERT_TRUE(tree.put(ts, TimeSeriesData(ts, double(ts % 1000))));
+        }
+        ASSERT_TRUE(tree.flush());
+
+        // Sketches only come from the blocks when they were stored
+        auto before = tree.get_statistics();
+        auto summary = tree.aggregate(0, 9999, {}, true);
+        auto after = tree.get_statistics();
+        EXPECT_EQ(after.summarized_blocks > before.summarized_blocks, block_sketches);
+        ASSERT_TRUE(summary.sketched);
+        EXPECT_NEAR(summary.value(AggregationType::QUANTILE, 0.99), 990.0, 5.0);
+        EXPECT_NEAR(summary.value(AggregationType::DISTINCT), 1000.0, 50.0);
+
+        // Without sketches requested, summaries drop them
+        EXPECT_FALSE(tree.aggregate(0, 9999).sketched);
+    }
+}
+
+namespace {
+
+// Forwards to the thread pool, counting what goes through it
+class CountingReader : public AsyncReader {
+public:
+    CountingReader() : inner_(AsyncReader::create(AsyncReader::Backend::ThreadPool, 16, 2)) {}
+    void read_batch(std::vector<Request>& requests,
+                    const std::function<void(size_t)>& on_complete) override {
+        ++batches;
+        max_batch = std::max(max_batch, requests.size());
+        inner_->read_batch(requests, on_complete);
+    }
+    const char* name() const override { return "counting"; }
+    
+    std::atomic<size_t> batches{0};
+    size_t max_batch = 0;
+    
+private:
+    std::shared_ptr<AsyncReader> inner_;
+};
+
+} // namespace
+
+TEST_F(LSMTreeTest, AsyncReaderBatchesBlocksOfAllFiles) {
+    LSMConfig config;
+    config.data_dir = test_dir_ + "/async";
+    config.enable_compression = true;
+    config.block_size_points = 64;
+    config.level0_file_num_compaction_trigger = 100;
+    config.enable_wal = false;
+    {
+        // Eight files over the same time range, the last one overriding
+        LSMTree tree(config);
+        for (int64_t f = 0; f < 8; ++f) {
+            for (int64_t i = 0; i < 1000; ++i) {
+                int64_t ts = i * 8 + f;
+                TimeSeriesData point(ts, f == 7 ? -1.0 : double(ts));
+                point.tags["host"] = (i % 2) ? "a" : "b";
+                ASSERT_TRUE(tree.put(ts, point));
+            }
+            ASSERT_TRUE(tree.flush());
+        }
+        ASSERT_TRUE(tree.put(3, TimeSeriesData(3, 42.0)));
+        ASSERT_TRUE(tree.flush());
+    }
+    
+    LSMTree plain(config);
+    auto expected = plain.range_query(100, 7000);
+    auto count_tagged = [](LSMTree& tree) {
+        size_t count = 0;
+        for (auto iter = tree.new_iterator(100, 7000, {{"host", "a"}}); iter->valid();
+             iter->next()) {
+            ++count;
+        }
+        return count;
+    };
+    size_t expected_tagged = count_tagged(plain);
+    ASSERT_GT(expected_tagged, 0u);
+    
+    for (bool use_mmap : {true, false}) {
+        auto reader = std::make_shared<CountingReader>();
+        config.use_mmap_reads = use_mmap;
+        config.async_reader = reader;
+        config.readahead_blocks = 4;
+        LSMTree tree(config);
+        
+        auto results = tree.range_query(100, 7000);
+        ASSERT_EQ(results.size(), expected.size());
+        for (size_t i = 0; i < results.size(); ++i) {
+            ASSERT_EQ(results[i].timestamp, expected[i].timestamp);
+            ASSERT_EQ(results[i].as_double(), expected[i].as_double());
+        }
+        EXPECT_EQ(count_tagged(tree), expected_tagged);
+        
+        // The first batch covers readahead_blocks of each overlapping file
+        EXPECT_GE(reader->max_batch, 8u * 4u);
+        EXPECT_GT(reader->batches.load(), 1u);
+    }
+}
+
+} // namespace test
+} // namespace sage_tsdb
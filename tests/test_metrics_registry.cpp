@@ -0,0 +1,267 @@
+#include "sage_tsdb/core/block_cache.h"
+#include "sage_tsdb/core/metrics_registry.h"
+#include "sage_tsdb/core/resource_manager.h"
+#include "sage_tsdb/core/table_manager.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace sage_tsdb {
+namespace test {
+
+TEST(MetricsRegistryTest, CounterSumsAcrossThreads) {
+    Counter counter;
+    constexpr int kThreads = 8;
+    constexpr int kPerThread = 50000;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&counter]() {
+            for (int i = 0; i < kPerThread; ++i) {
+                counter.inc();
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(counter.value(), static_cast<uint64_t>(kThreads * kPerThread));
+
+    counter.inc(5);
+    EXPECT_EQ(counter.value(), static_cast<uint64_t>(kThreads * kPerThread + 5));
+    counter.reset();
+    EXPECT_EQ(counter.value(), 0u);
+}
+
+TEST(MetricsRegistryTest, OwnedMetricsAreSharedByNameAndLabels) {
+    MetricsRegistry registry;
+    auto a = registry.counter("requests_total", "Requests", {{"path", "/a"}});
+    auto same = registry.counter("requests_total", "Requests", {{"path", "/a"}});
+    auto b = registry.counter("requests_total", "Requests", {{"path", "/b"}});
+    EXPECT_EQ(a, same);
+    EXPECT_NE(a, b);
+    EXPECT_EQ(registry.size(), 2u);
+
+    a->inc(3);
+    b->inc();
+    double value = 0;
+    ASSERT_TRUE(registry.read("requests_total", {{"path", "/a"}}, value));
+    EXPECT_EQ(value, 3.0);
+    EXPECT_FALSE(registry.read("requests_total", {{"path", "/c"}}, value));
+
+    auto gauge = registry.gauge("temperature", "Temperature");
+    gauge->set(20.5);
+    gauge->add(-0.5);
+    ASSERT_TRUE(registry.read("temperature", {}, value));
+    EXPECT_EQ(value, 20.0);
+}
+
+TEST(MetricsRegistryTest, RejectsInvalidNamesAndTypeConflicts) {
+    MetricsRegistry registry;
+    EXPECT_THROW(registry.counter("", "x"), std::invalid_argument);
+    EXPECT_THROW(registry.counter("1abc", "x"), std::invalid_argument);
+    EXPECT_THROW(registry.counter("a-b", "x"), std::invalid_argument);
+    EXPECT_THROW(registry.counter("ok", "x", {{"bad-label", "v"}}), std::invalid_argument);
+    EXPECT_THROW(registry.counter("ok", "x", {{"le", "1"}}), std::invalid_argument);
+
+    registry.counter("shared", "x");
+    EXPECT_THROW(registry.gauge("shared", "x"), std::invalid_argument);
+    EXPECT_THROW(registry.histogram("shared", "x"), std::invalid_argument);
+    EXPECT_THROW((void)registry.addGauge("shared", "x", {}, [] { return 1.0; }),
+                 std::invalid_argument);
+}
+
+TEST(MetricsRegistryTest, HandleUnregistersCallback) {
+    MetricsRegistry registry;
+    double source = 7;
+    {
+        auto handle = registry.addGauge("callback", "Callback", {{"k", "v"}},
+                                        [&source] { return source; });
+        double value = 0;
+        ASSERT_TRUE(registry.read("callback", {{"k", "v"}}, value));
+        EXPECT_EQ(value, 7.0);
+
+        // Moving keeps a single registration
+        MetricsRegistry::Handle moved = std::move(handle);
+        EXPECT_FALSE(handle);
+        EXPECT_TRUE(moved);
+        EXPECT_EQ(registry.size(), 1u);
+    }
+    EXPECT_EQ(registry.size(), 0u);
+    EXPECT_EQ(registry.exportPrometheus().find("callback"), std::string::npos);
+}
+
+TEST(MetricsRegistryTest, PrometheusTextFormat) {
+    MetricsRegistry registry;
+    registry.counter("app_events_total", "Events seen", {{"kind", "a\"b\\c\nd"}})->inc(42);
+    registry.gauge("app_ratio", "A ratio")->set(0.25);
+    auto histogram = registry.histogram("app_latency_seconds", "Latency");
+    histogram->record(50);       // 50 us
+    histogram->record(2000);     // 2 ms
+    histogram->record(3000000);  // 3 s
+
+    std::string text = registry.exportPrometheus();
+    EXPECT_NE(text.find("# HELP app_events_total Events seen\n"
+                        "# TYPE app_events_total counter\n"
+                        "app_events_total{kind=\"a\\\"b\\\\c\\nd\"} 42\n"),
+              std::string::npos) << text;
+    EXPECT_NE(text.find("# TYPE app_ratio gauge\napp_ratio 0.25\n"), std::string::npos) << text;
+    EXPECT_NE(text.find("# TYPE app_latency_seconds histogram\n"), std::string::npos) << text;
+    EXPECT_NE(text.find("app_latency_seconds_bucket{le=\"0.0001\"} 1\n"), std::string::npos) << text;
+    EXPECT_NE(text.find("app_latency_seconds_bucket{le=\"0.0025\"} 2\n"), std::string::npos) << text;
+    EXPECT_NE(text.find("app_latency_seconds_bucket{le=\"2.5\"} 2\n"), std::string::npos) << text;
+    EXPECT_NE(text.find("app_latency_seconds_bucket{le=\"5\"} 3\n"), std::string::npos) << text;
+    EXPECT_NE(text.find("app_latency_seconds_bucket{le=\"+Inf\"} 3\n"), std::string::npos) << text;
+    EXPECT_NE(text.find("app_latency_seconds_count 3\n"), std::string::npos) << text;
+    EXPECT_NE(text.find("app_latency_seconds_sum 3.00205"), std::string::npos) << text;
+}
+
+TEST(MetricsRegistryTest, TableManagerExportsTableAndLsmMetrics) {
+    std::string dir = "./test_metrics_registry_data";
+    fs::remove_all(dir);
+    {
+        auto manager = std::make_shared<TableManager>(dir, 0);
+        TableConfig config;
+        config.enable_wal = false;
+        ASSERT_TRUE(manager->createStreamTable("metered", config));
+        auto table = manager->getStreamTable("metered");
+        for (int i = 0; i < 100; ++i) {
+            table->insert(TimeSeriesData(i, static_cast<double>(i)));
+        }
+        table->query(TimeRange(0, 100));
+
+        auto registry = manager->getMetricsRegistry();
+        double value = 0;
+        ASSERT_TRUE(registry->read("sage_tsdb_table_points_total", {{"table", "metered"}}, value));
+        EXPECT_EQ(value, 100.0);
+        ASSERT_TRUE(registry->read("sage_tsdb_table_max_timestamp", {{"table", "metered"}}, value));
+        EXPECT_EQ(value, 99.0);
+
+        std::string text = manager->exportMetrics();
+        EXPECT_NE(text.find("sage_tsdb_table_query_seconds_count{table=\"metered\"} 1\n"),
+                  std::string::npos) << text;
+        EXPECT_NE(text.find("sage_tsdb_lsm_sstables{table=\"metered\"}"), std::string::npos);
+        EXPECT_NE(text.find("sage_tsdb_write_buffer_limit_bytes"), std::string::npos);
+
+        // Metrics go away with the last reference to a dropped table
+        table.reset();
+        ASSERT_TRUE(manager->dropTable("metered"));
+        EXPECT_FALSE(registry->read("sage_tsdb_table_points_total", {{"table", "metered"}}, value));
+    }
+    fs::remove_all(dir);
+}
+
+TEST(MetricsRegistryTest, TableManagerExportsBlockCacheStats) {
+    std::string dir = "./test_metrics_registry_cache_data";
+    fs::remove_all(dir);
+    {
+        auto manager = std::make_shared<TableManager>(dir, 1 << 20);
+        auto cache = manager->getBlockCache();
+        ASSERT_NE(cache, nullptr);
+        auto block = std::make_shared<int>(7);
+        cache->insert({1, 0}, block, 4096);
+        cache->insert({1, 4096}, block, 4096, BlockCache::Priority::High);
+        EXPECT_NE(cache->lookup({1, 0}), nullptr);
+        EXPECT_EQ(cache->lookup({2, 0}), nullptr);
+
+        auto registry = manager->getMetricsRegistry();
+        auto read = [&](const char* name) {
+            double value = -1;
+            EXPECT_TRUE(registry->read(name, {}, value)) << name;
+            return value;
+        };
+        auto stats = cache->get_stats();
+        EXPECT_EQ(read("sage_tsdb_block_cache_hits_total"), 1.0);
+        EXPECT_EQ(read("sage_tsdb_block_cache_misses_total"), 1.0);
+        EXPECT_EQ(read("sage_tsdb_block_cache_inserts_total"), 2.0);
+        EXPECT_EQ(read("sage_tsdb_block_cache_entries"), 2.0);
+        EXPECT_EQ(read("sage_tsdb_block_cache_usage_bytes"), static_cast<double>(stats.usage_bytes));
+        EXPECT_EQ(stats.usage_bytes, 8192u);
+        EXPECT_EQ(read("sage_tsdb_block_cache_high_priority_usage_bytes"), 4096.0);
+        EXPECT_EQ(read("sage_tsdb_block_cache_capacity_bytes"), static_cast<double>(1 << 20));
+
+        cache->erase_file(1);
+        EXPECT_EQ(read("sage_tsdb_block_cache_entries"), 0.0);
+        EXPECT_EQ(read("sage_tsdb_block_cache_usage_bytes"), 0.0);
+    }
+    fs::remove_all(dir);
+}
+
+TEST(MetricsRegistryTest, TableManagerWithoutBlockCacheHasNoCacheMetrics) {
+    std::string dir = "./test_metrics_registry_nocache_data";
+    fs::remove_all(dir);
+    {
+        TableManager manager(dir, 0);
+        double value = 0;
+        EXPECT_FALSE(manager.getMetricsRegistry()->read("sage_tsdb_block_cache_hits_total", {},
+                                                        value));
+    }
+    fs::remove_all(dir);
+}
+
+TEST(MetricsRegistryTest, ResourceManagerExportsHandleUsage) {
+    auto registry = std::make_shared<MetricsRegistry>();
+    auto resources = core::createResourceManager();
+    resources->setGlobalLimits(4, 1ULL << 30);
+
+    core::ResourceRequest request;
+    request.requested_threads = 1;
+    request.max_memory_bytes = 256ULL << 20;
+    auto before = resources->allocate("early", request);
+    ASSERT_NE(before, nullptr);
+
+    // Handles allocated before and after attaching are both exported
+    resources->attachMetrics(registry);
+    auto after = resources->allocateForCompute("engine", request);
+    ASSERT_NE(after, nullptr);
+
+    const Tags early{{"kind", "plugin"}, {"handle", "early"}};
+    const Tags engine{{"kind", "compute"}, {"handle", "engine"}};
+
+    core::ResourceUsage usage;
+    usage.memory_used_bytes = 1000;
+    usage.queue_length = 3;
+    usage.tuples_processed = 42;
+    before->reportUsage(usage);
+    before->memoryTracker()->consume(24);
+
+    double value = 0;
+    ASSERT_TRUE(registry->read("sage_tsdb_resource_memory_bytes", early, value));
+    EXPECT_EQ(value, 1024.0);
+    ASSERT_TRUE(registry->read("sage_tsdb_resource_queue_length", early, value));
+    EXPECT_EQ(value, 3.0);
+    ASSERT_TRUE(registry->read("sage_tsdb_resource_tuples_processed_total", early, value));
+    EXPECT_EQ(value, 42.0);
+
+    std::atomic<bool> ran{false};
+    ASSERT_TRUE(after->submitTask([&ran]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        ran = true;
+    }));
+    for (int i = 0; i < 500 && !ran; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    ASSERT_TRUE(ran);
+    resources->throttleCompute("engine", 0.5);
+    ASSERT_TRUE(registry->read("sage_tsdb_resource_throttle_factor", engine, value));
+    EXPECT_EQ(value, 0.5);
+    ASSERT_TRUE(registry->read("sage_tsdb_resource_cpu_limit", engine, value));
+    EXPECT_EQ(value, 0.5);
+    ASSERT_TRUE(registry->read("sage_tsdb_resource_memory_throttled", engine, value));
+    EXPECT_EQ(value, 0.0);
+
+    // Released handles drop their series even while still referenced
+    resources->releaseCompute("engine");
+    EXPECT_FALSE(registry->read("sage_tsdb_resource_throttle_factor", engine, value));
+    resources->attachMetrics(nullptr);
+    EXPECT_FALSE(registry->read("sage_tsdb_resource_memory_bytes", early, value));
+    EXPECT_EQ(registry->size(), 0u);
+}
+
+} // namespace test
+} // namespace sage_tsdb
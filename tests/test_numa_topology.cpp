@@ -0,0 +1,72 @@
+#include "sage_tsdb/core/numa_topology.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+namespace sage_tsdb {
+namespace test {
+
+using core::NumaTopology;
+
+TEST(NumaTopologyTest, ParsesCpuLists) {
+    EXPECT_EQ(NumaTopology::parse_cpu_list("0-3,8,10-11\n"),
+              (std::vector<int>{0, 1, 2, 3, 8, 10, 11}));
+    EXPECT_EQ(NumaTopology::parse_cpu_list("5"), (std::vector<int>{5}));
+    EXPECT_TRUE(NumaTopology::parse_cpu_list("").empty());
+    // Malformed and reversed ranges are skipped, duplicates merged
+    EXPECT_EQ(NumaTopology::parse_cpu_list("x,4-2,1,1-2"), (std::vector<int>{1, 2}));
+}
+
+TEST(NumaTopologyTest, LoadsNodesFromSysfsLayout) {
+    auto dir = std::filesystem::temp_directory_path() /
+               ("numa_topology_test_" + std::to_string(::testing::UnitTest::GetInstance()->random_seed()));
+    std::filesystem::remove_all(dir);
+    auto write_node = [&](const std::string& name, const std::string& cpulist) {
+        std::filesystem::create_directories(dir / name);
+        std::ofstream(dir / name / "cpulist") << cpulist << "\n";
+    };
+    write_node("node1", "4-7");
+    write_node("node0", "0-3");
+    write_node("node2", "");  // Memory only
+    write_node("possible", "0-2");
+    std::ofstream(dir / "online") << "0-2\n";
+
+    auto topology = NumaTopology::load(dir.string());
+    ASSERT_EQ(topology.node_count(), 2u);
+    EXPECT_EQ(topology.nodes()[0].id, 0);
+    EXPECT_EQ(topology.nodes()[1].id, 1);
+    EXPECT_EQ(topology.nodes()[1].cpus, (std::vector<int>{4, 5, 6, 7}));
+    EXPECT_EQ(topology.node_of_cpu(5), 1);
+    EXPECT_EQ(topology.node_of_cpu(8), -1);
+    EXPECT_EQ(topology.node(2), nullptr);
+
+    EXPECT_EQ(NumaTopology::load((dir / "missing").string()).node_count(), 0u);
+    std::filesystem::remove_all(dir);
+}
+
+TEST(NumaTopologyTest, SystemTopologyCoversThisThread) {
+    const auto& topology = NumaTopology::system();
+    ASSERT_GE(topology.node_count(), 1u);
+    int cpu = core::current_cpu();
+    if (cpu >= 0) {
+        EXPECT_GE(topology.node_of_cpu(cpu), 0);
+    }
+
+    // A pinned thread stays on the node's CPUs
+    const auto& node = topology.nodes().front();
+    int observed = -2;
+    std::thread pinned([&]() {
+        if (core::pin_current_thread(node.cpus)) {
+            observed = core::current_cpu();
+        }
+    });
+    pinned.join();
+    if (observed >= 0) {
+        EXPECT_TRUE(std::binary_search(node.cpus.begin(), node.cpus.end(), observed));
+    }
+}
+
+}  // namespace test
+}  // namespace sage_tsdb
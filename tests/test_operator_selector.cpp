@@ -0,0 +1,110 @@
+/**
+ * @file test_operator_selector.cpp
+ * @brief Unit tests for the cost-based Auto operator choice
+ */
+
+#include <gtest/gtest.h>
+
+#ifdef PECJ_MODE_INTEGRATED
+#include "sage_tsdb/compute/operator_selector.h"
+
+using namespace sage_tsdb::compute;
+
+namespace {
+
+// 10000 tuples over 100 keys in a 1s window
+WorkloadSample window() {
+    WorkloadSample sample;
+    sample.input_tuples = 10000;
+    sample.window_len_us = 1000000;
+    sample.distinct_keys = 100;
+    sample.selectivity = 0.01;
+    return sample;
+}
+
+// Model latency of IAWJ on window(), i.e. a calibration of 1
+constexpr double IAWJ_MS = 1.5;
+
+}  // namespace
+
+TEST(OperatorSelectorTest, StaysOnExactOperatorWithoutDisorder) {
+    OperatorSelector selector(100.0);
+    EXPECT_EQ(selector.current(), PECJOperatorType::IAWJ);
+
+    for (uint64_t id = 0; id < 5; ++id) {
+        selector.observeWindow(PECJOperatorType::IAWJ, window(), IAWJ_MS);
+        EXPECT_EQ(selector.choose(id), PECJOperatorType::IAWJ);
+    }
+    EXPECT_EQ(selector.switches(), 0u);
+    EXPECT_DOUBLE_EQ(selector.arrivalRate(), 10000.0);
+    for (const auto& estimate : selector.estimates()) {
+        EXPECT_EQ(estimate.error, 0.0) << operatorName(estimate.type);
+    }
+}
+
+TEST(OperatorSelectorTest, DisorderSwitchesToCompensatingOperator) {
+    OperatorSelector selector(100.0);
+    selector.observeWindow(PECJOperatorType::IAWJ, window(), IAWJ_MS);
+    selector.observeLateTuples(1000);
+    EXPECT_NEAR(selector.disorder(), 1000.0 / 11000.0, 1e-9);
+
+    EXPECT_EQ(selector.choose(7), PECJOperatorType::PECJ);
+    auto decisions = selector.decisions();
+    ASSERT_EQ(decisions.size(), 1u);
+    EXPECT_EQ(decisions[0].window_id, 7u);
+    EXPECT_EQ(decisions[0].from, "IAWJ");
+    EXPECT_EQ(decisions[0].to, "PECJ");
+    EXPECT_LT(decisions[0].predicted_error, 0.05);
+    EXPECT_GT(decisions[0].disorder, 0.0);
+}
+
+TEST(OperatorSelectorTest, TightSloTradesAccuracyForLatency) {
+    // PECJ is predicted at 5.1ms, MSWJ at 4.8ms on this workload
+    OperatorSelector selector(5.0);
+    selector.observeWindow(PECJOperatorType::IAWJ, window(), IAWJ_MS);
+    selector.observeLateTuples(1000);
+    EXPECT_EQ(selector.choose(0), PECJOperatorType::MSWJ);
+
+    for (const auto& estimate : selector.estimates()) {
+        if (estimate.type == PECJOperatorType::PECJ) {
+            EXPECT_FALSE(estimate.meets_slo);
+        }
+    }
+}
+
+TEST(OperatorSelectorTest, MeasuredLatencyCorrectsTheModel) {
+    OperatorSelector selector(20.0);
+    selector.observeWindow(PECJOperatorType::IAWJ, window(), IAWJ_MS);
+    selector.observeLateTuples(1000);
+    ASSERT_EQ(selector.choose(0), PECJOperatorType::PECJ);
+
+    // PECJ turns out 20x slower than modelled: back to what meets the SLO,
+    // but not before min_windows_per_switch windows
+    for (uint64_t id = 1; id < selector.min_windows_per_switch; ++id) {
+        selector.observeWindow(PECJOperatorType::PECJ, window(), 100.0);
+        EXPECT_EQ(selector.choose(id), PECJOperatorType::PECJ);
+    }
+    selector.observeWindow(PECJOperatorType::PECJ, window(), 100.0);
+    EXPECT_EQ(selector.choose(selector.min_windows_per_switch), PECJOperatorType::IAWJ);
+    EXPECT_EQ(selector.switches(), 2u);
+}
+
+TEST(OperatorSelectorTest, TimedOutWindowCountsAsSloMiss) {
+    OperatorSelector selector(10.0, {PECJOperatorType::PECJ, PECJOperatorType::SHJ});
+    auto sample = window();
+    sample.selectivity = 0.0;
+    selector.observeWindow(PECJOperatorType::PECJ, sample, 1.0, true);
+    for (const auto& estimate : selector.estimates()) {
+        if (estimate.type == PECJOperatorType::PECJ) {
+            EXPECT_GE(estimate.latency_ms, 20.0);
+        }
+    }
+    EXPECT_EQ(selector.choose(0), PECJOperatorType::SHJ);
+}
+
+TEST(OperatorSelectorTest, RejectsInvalidArguments) {
+    EXPECT_THROW(OperatorSelector(0.0), std::invalid_argument);
+    EXPECT_THROW(OperatorSelector(10.0, {}), std::invalid_argument);
+}
+
+#endif // PECJ_MODE_INTEGRATED
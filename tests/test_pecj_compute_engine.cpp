@@ -19,11 +19,19 @@
 #include <iostream>
 #include <vector>
 #include <string>
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
 
 #ifdef PECJ_MODE_INTEGRATED
 #include "sage_tsdb/compute/pecj_compute_engine.h"
+#include "sage_tsdb/compute/shared_scan.h"
 #include "sage_tsdb/core/time_series_db.h"
+#include "sage_tsdb/core/resource_manager.h"
 
 using namespace sage_tsdb;
 using namespace sage_tsdb::compute;
@@ -316,6 +324,542 @@ TEST_F(PECJComputeEngineTest, ExecuteWithoutInitialization) {
 
 #endif // PECJ_FULL_INTEGRATION
 
+// ============================================================================
+// Pane Mode Tests (independent of the PECJ library)
+// ============================================================================
+
+TEST_F(PECJComputeEngineTest, PaneModeMatchesFullWindowJoin) {
+    PECJComputeEngine engine;
+    auto config = createConfig("IAWJ");
+    config.window_len_us = 1000000;
+    config.slide_len_us = 250000;
+    config.enable_pane_mode = true;
+    ASSERT_TRUE(engine.initialize(config, db_.get(), nullptr));
+    
+    int64_t base_ts = 1000000;
+    insertTestData(base_ts, 3000);  // 3 seconds, 1ms apart
+    
+    // Reference: per-key counts over the whole window
+    auto expected = [&](int64_t start, int64_t end) {
+        std::map<std::string, size_t> s_keys, r_keys;
+        for (const auto& point : db_->query("stream_s", sage_tsdb::TimeRange(start, end - 1))) {
+            s_keys[point.tags.at("key")]++;
+        }
+        for (const auto& point : db_->query("stream_r", sage_tsdb::TimeRange(start, end - 1))) {
+            r_keys[point.tags.at("key")]++;
+        }
+        size_t count = 0;
+        for (const auto& [key, n] : s_keys) {
+            count += n * r_keys[key];
+        }
+        return count;
+    };
+    
+    uint64_t window_id = 0;
+    for (int64_t start = base_ts; start + 1000000 <= base_ts + 3000000; start += 250000) {
+        compute::TimeRange range(start, start + 1000000);
+        auto status = engine.executeWindowJoin(window_id++, range);
+        ASSERT_TRUE(status.success) << status.error;
+        EXPECT_TRUE(status.used_panes);
+        EXPECT_EQ(status.join_count, expected(start, start + 1000000)) << "window at " << start;
+        EXPECT_EQ(status.input_s_count, 1000u);
+        if (start > base_ts) {
+            // Each slide reads only the new pane
+            EXPECT_EQ(status.panes_computed, 1u);
+        }
+    }
+    
+    auto metrics = engine.getMetrics();
+    EXPECT_EQ(metrics.panes_computed, 12u);  // Every pane read once
+    EXPECT_EQ(metrics.total_windows_completed, window_id);
+    
+    // Jumping back rebuilds the window from panes
+    auto status = engine.executeWindowJoin(window_id, compute::TimeRange(base_ts, base_ts + 1000000));
+    EXPECT_EQ(status.join_count, expected(base_ts, base_ts + 1000000));
+}
+
+TEST_F(PECJComputeEngineTest, PaneModeSkipsUnalignedWindows) {
+    PECJComputeEngine engine;
+    auto config = createConfig("IAWJ");
+    config.enable_pane_mode = true;
+    ASSERT_TRUE(engine.initialize(config, db_.get(), nullptr));
+    
+    auto status = engine.executeWindowJoin(1, compute::TimeRange(1000001, 2000001));
+    EXPECT_FALSE(status.used_panes);
+}
+
+TEST_F(PECJComputeEngineTest, ScanReportsInputCountsAcrossWindows) {
+    PECJComputeEngine engine;
+    auto config = createConfig("IAWJ");
+    ASSERT_TRUE(engine.initialize(config, db_.get(), nullptr));
+    
+    int64_t base_ts = 1000000;
+    insertTestData(base_ts, 1000);
+    
+    auto status = engine.executeWindowJoin(0, compute::TimeRange(base_ts, base_ts + 1000000));
+    ASSERT_TRUE(status.success) << status.error;
+    EXPECT_EQ(status.input_s_count, 1000u);
+    EXPECT_EQ(status.input_r_count, 1000u);
+    
+    // A smaller window reuses the buffers without keeping stale tuples
+    status = engine.executeWindowJoin(1, compute::TimeRange(base_ts, base_ts + 99999));
+    ASSERT_TRUE(status.success) << status.error;
+    EXPECT_EQ(status.input_s_count, 100u);
+    EXPECT_EQ(status.input_r_count, 100u);
+    
+    status = engine.executeWindowJoin(2, compute::TimeRange(base_ts + 5000000, base_ts + 6000000));
+    ASSERT_TRUE(status.success) << status.error;
+    EXPECT_EQ(status.input_s_count, 0u);
+}
+
+TEST_F(PECJComputeEngineTest, EnginesShareScansOfTheSameStreams) {
+    int64_t base_ts = 1000000;
+    insertTestData(base_ts, 3000);
+    
+    // Window lengths of the concurrent queries; pane mode and the kernel
+    // both read the tables
+    struct Query {
+        uint64_t window_len_us;
+        bool panes;
+    };
+    const std::vector<Query> queries = {{1000000, false}, {500000, false}, {1000000, true}};
+    
+    auto runAll = [&](SharedScanCoordinator* scan) {
+        std::vector<std::unique_ptr<PECJComputeEngine>> engines;
+        for (const auto& query : queries) {
+            auto config = createConfig("IAWJ");
+            config.enable_simd = true;
+            config.window_len_us = query.window_len_us;
+            config.enable_pane_mode = query.panes;
+            engines.push_back(std::make_unique<PECJComputeEngine>());
+            EXPECT_TRUE(engines.back()->initialize(config, db_.get(), nullptr));
+            engines.back()->setSharedScan(scan);
+        }
+        std::vector<size_t> counts;
+        for (int64_t start = base_ts; start + 1000000 <= base_ts + 3000000; start += 500000) {
+            for (size_t q = 0; q < queries.size(); ++q) {
+                int64_t len = static_cast<int64_t>(queries[q].window_len_us);
+                auto status = engines[q]->executeWindowJoin(0, compute::TimeRange(start, start + len - 1));
+                EXPECT_TRUE(status.success) << status.error;
+                counts.push_back(status.join_count);
+            }
+        }
+        return counts;
+    };
+    
+    auto unshared = runAll(nullptr);
+    SharedScanCoordinator scan(db_.get(), 100000);
+    EXPECT_EQ(runAll(&scan), unshared);
+    
+    // Every segment of both tables was read once for all three queries
+    auto stats = scan.getStats();
+    EXPECT_EQ(stats.segments_read, 2u * 30u);
+    EXPECT_GT(stats.segment_hits, 0u);
+    EXPECT_EQ(stats.consumers, 0u);  // Engines unregistered on destruction
+}
+
+TEST_F(PECJComputeEngineTest, OperatorReusedAcrossWindows) {
+    PECJComputeEngine engine;
+    auto config = createConfig("IAWJ");
+    ASSERT_TRUE(engine.initialize(config, db_.get(), nullptr));
+    EXPECT_EQ(engine.getMetrics().pooled_operators, 1u);
+    
+    int64_t base_ts = 1000000;
+    insertTestData(base_ts, 2000);
+    for (uint64_t w = 0; w < 4; ++w) {
+        int64_t start = base_ts + static_cast<int64_t>(w) * 250000;
+        auto status = engine.executeWindowJoin(w, compute::TimeRange(start, start + 1000000));
+        ASSERT_TRUE(status.success) << status.error;
+    }
+    
+    // Sequential windows keep running on the operator built by initialize()
+    EXPECT_EQ(engine.getMetrics().pooled_operators, 1u);
+}
+
+TEST_F(PECJComputeEngineTest, ConcurrentWindowsCheckOutBoundedOperators) {
+    PECJComputeEngine engine;
+    auto config = createConfig("IAWJ");
+    config.max_concurrent_windows = 2;
+    ASSERT_TRUE(engine.initialize(config, db_.get(), nullptr));
+    
+    int64_t base_ts = 1000000;
+    insertTestData(base_ts, 2000);
+    
+    std::vector<std::thread> threads;
+    std::vector<size_t> s_counts(8);
+    for (size_t t = 0; t < s_counts.size(); ++t) {
+        threads.emplace_back([&, t]() {
+            int64_t start = base_ts + static_cast<int64_t>(t) * 100000;
+            auto status = engine.executeWindowJoin(t, compute::TimeRange(start, start + 999999));
+            s_counts[t] = status.success ? status.input_s_count : 0;
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    
+    // Each window scanned its own inputs: no buffer shared between windows
+    for (size_t count : s_counts) {
+        EXPECT_EQ(count, 1000u);
+    }
+    EXPECT_GE(engine.getMetrics().pooled_operators, 1u);
+    EXPECT_LE(engine.getMetrics().pooled_operators, 2u);
+}
+
+// ============================================================================
+// Join Kernel Tests (enable_simd, independent of the PECJ library)
+// ============================================================================
+
+TEST_F(PECJComputeEngineTest, JoinKernelMatchesReference) {
+    int64_t base_ts = 1000000;
+    insertTestData(base_ts, 2000);
+    
+    // Reference: S count times R value summed per key, over the tuples
+    // the window scan reads (the table query includes end_us)
+    compute::TimeRange range(base_ts + 100000, base_ts + 1099999);
+    std::map<std::string, size_t> s_keys;
+    for (const auto& point : db_->query("stream_s", sage_tsdb::TimeRange(range.start_us, range.end_us))) {
+        s_keys[point.tags.at("key")]++;
+    }
+    size_t expected_count = 0;
+    double expected_sum = 0.0;
+    for (const auto& point : db_->query("stream_r", sage_tsdb::TimeRange(range.start_us, range.end_us))) {
+        size_t matches = s_keys[point.tags.at("key")];
+        expected_count += matches;
+        expected_sum += static_cast<double>(matches) * point.fields.at("value").as_double();
+    }
+    ASSERT_GT(expected_count, 0u);
+    
+    for (bool join_sum : {false, true}) {
+        PECJComputeEngine engine;
+        auto config = createConfig(join_sum ? "SHJ" : "IAWJ");
+        config.enable_simd = true;
+        config.join_sum = join_sum;
+        ASSERT_TRUE(engine.initialize(config, db_.get(), nullptr));
+        
+        auto status = engine.executeWindowJoin(0, range);
+        ASSERT_TRUE(status.success) << status.error;
+        EXPECT_TRUE(status.used_join_kernel);
+        EXPECT_FALSE(status.used_aqp);
+        EXPECT_EQ(status.input_s_count, 1000u);
+        EXPECT_EQ(status.input_r_count, 1000u);
+        if (join_sum) {
+            EXPECT_EQ(status.join_count, static_cast<size_t>(std::llround(expected_sum)));
+        } else {
+            EXPECT_EQ(status.join_count, expected_count);
+        }
+    }
+}
+
+TEST_F(PECJComputeEngineTest, JoinKernelSplitsLargeWindowsByKey) {
+    auto resources = core::createResourceManager();
+    core::ResourceRequest request;
+    request.requested_threads = 4;
+    auto handle = resources->allocate("window_join", request);
+    ASSERT_NE(handle, nullptr);
+    
+    int64_t base_ts = 1000000;
+    insertTestData(base_ts, 2000);
+    compute::TimeRange range(base_ts, base_ts + 1999999);
+    
+    for (bool join_sum : {false, true}) {
+        auto config = createConfig("IAWJ");
+        config.enable_simd = true;
+        config.join_sum = join_sum;
+        
+        PECJComputeEngine serial;
+        ASSERT_TRUE(serial.initialize(config, db_.get(), nullptr));
+        auto expected = serial.executeWindowJoin(0, range);
+        ASSERT_TRUE(expected.success) << expected.error;
+        EXPECT_EQ(expected.join_buckets, 1u);
+        
+        config.max_threads = 4;
+        config.parallel_join_min_tuples = 0;
+        PECJComputeEngine parallel;
+        ASSERT_TRUE(parallel.initialize(config, db_.get(), handle.get()));
+        auto status = parallel.executeWindowJoin(0, range);
+        ASSERT_TRUE(status.success) << status.error;
+        // One bucket per thread, within the handle's quota
+        size_t quota = static_cast<size_t>(handle->getAllocated().requested_threads);
+        EXPECT_EQ(status.join_buckets, std::min<size_t>(4, quota));
+        EXPECT_FALSE(status.used_aqp);
+        EXPECT_EQ(status.input_s_count, 2000u);
+        // 10 keys * 200 * 200 pairs; sums may differ in the last bits
+        if (join_sum) {
+            EXPECT_NEAR(static_cast<double>(status.join_count),
+                        static_cast<double>(expected.join_count), 1.0);
+        } else {
+            EXPECT_EQ(status.join_count, 400000u);
+            EXPECT_EQ(status.join_count, expected.join_count);
+        }
+    }
+}
+
+TEST_F(PECJComputeEngineTest, JoinKernelOnlyForExactOperators) {
+    insertTestData(1000000, 100);
+    
+    PECJComputeEngine engine;
+    auto config = createConfig("IMA");
+    config.enable_simd = true;
+    ASSERT_TRUE(engine.initialize(config, db_.get(), nullptr));
+    auto status = engine.executeWindowJoin(0, compute::TimeRange(1000000, 2000000));
+    EXPECT_FALSE(status.used_join_kernel);
+    
+    // Aligned windows still prefer the pane cache
+    PECJComputeEngine pane_engine;
+    config = createConfig("IAWJ");
+    config.enable_simd = true;
+    config.enable_pane_mode = true;
+    ASSERT_TRUE(pane_engine.initialize(config, db_.get(), nullptr));
+    status = pane_engine.executeWindowJoin(0, compute::TimeRange(1000000, 2000000));
+    EXPECT_TRUE(status.used_panes);
+    EXPECT_FALSE(status.used_join_kernel);
+    EXPECT_EQ(status.join_count, 10u * 10u * 10u);
+}
+
+// ============================================================================
+// Deadline Tests (pane path, independent of the PECJ library)
+// ============================================================================
+
+TEST_F(PECJComputeEngineTest, LateTuplesJoinAgainstRetainedState) {
+    int64_t base_ts = 1000000;
+    insertTestData(base_ts, 1000);
+    compute::TimeRange range(base_ts, base_ts + 999999);
+    
+    // Late tuples inside the window, on keys present and absent
+    std::vector<TimeSeriesData> late_s, late_r;
+    for (int i = 0; i < 30; ++i) {
+        TimeSeriesData point;
+        point.timestamp = base_ts + 100 + i;
+        point.tags["key"] = std::to_string(i % 12);
+        point.fields["value"] = std::to_string(7.5 + i);
+        (i % 3 == 0 ? late_r : late_s).push_back(point);
+    }
+    
+    for (bool join_sum : {false, true}) {
+        SCOPED_TRACE(join_sum ? "join sum" : "join count");
+        PECJComputeEngine engine;
+        auto config = createConfig("IAWJ");
+        config.enable_simd = true;
+        config.join_sum = join_sum;
+        config.retain_late_state = true;
+        ASSERT_TRUE(engine.initialize(config, db_.get(), nullptr));
+        
+        auto first = engine.executeWindowJoin(1, range);
+        ASSERT_TRUE(first.success) << first.error;
+        EXPECT_EQ(engine.getMetrics().retained_windows, 1u);
+        
+        auto corrected = engine.joinLateTuples(1, late_s, late_r);
+        ASSERT_TRUE(corrected.success) << corrected.error;
+        EXPECT_TRUE(corrected.late_correction);
+        EXPECT_EQ(corrected.input_s_count, late_s.size());
+        EXPECT_GT(corrected.join_count, first.join_count);
+        
+        // Same as recomputing the window with the late tuples in the tables
+        auto reference_db = std::make_unique<TimeSeriesDB>();
+        reference_db->createTable("stream_s");
+        reference_db->createTable("stream_r");
+        for (const char* table : {"stream_s", "stream_r"}) {
+            for (const auto& point : db_->query(table, sage_tsdb::TimeRange(range.start_us, range.end_us))) {
+                reference_db->insert(table, point);
+            }
+        }
+        for (const auto& point : late_s) reference_db->insert("stream_s", point);
+        for (const auto& point : late_r) reference_db->insert("stream_r", point);
+        PECJComputeEngine reference;
+        ASSERT_TRUE(reference.initialize(config, reference_db.get(), nullptr));
+        auto full = reference.executeWindowJoin(1, range);
+        ASSERT_TRUE(full.success) << full.error;
+        if (join_sum) {
+            EXPECT_NEAR(static_cast<double>(corrected.join_count), static_cast<double>(full.join_count), 1.0);
+        } else {
+            EXPECT_EQ(corrected.join_count, full.join_count);
+        }
+        
+        // Later batches add to the corrected state
+        auto again = engine.joinLateTuples(1, late_s, {});
+        ASSERT_TRUE(again.success);
+        EXPECT_GT(again.join_count, corrected.join_count);
+        EXPECT_EQ(engine.getMetrics().late_corrections, 2u);
+    }
+}
+
+TEST_F(PECJComputeEngineTest, LateStateExpiresAfterMaxDelay) {
+    insertTestData(1000000, 3000);
+    std::vector<TimeSeriesData> late_s(1);
+    late_s[0].timestamp = 1000100;
+    late_s[0].tags["key"] = "1";
+    
+    {
+        // Not retained unless enabled
+        PECJComputeEngine engine;
+        auto config = createConfig("IAWJ");
+        config.enable_simd = true;
+        ASSERT_TRUE(engine.initialize(config, db_.get(), nullptr));
+        ASSERT_TRUE(engine.executeWindowJoin(1, compute::TimeRange(1000000, 1999999)).success);
+        EXPECT_FALSE(engine.joinLateTuples(1, late_s, {}).success);
+    }
+    
+    PECJComputeEngine engine;
+    auto config = createConfig("IAWJ");
+    config.enable_simd = true;
+    config.retain_late_state = true;
+    config.max_delay_us = 500000;
+    ASSERT_TRUE(engine.initialize(config, db_.get(), nullptr));
+    ASSERT_TRUE(engine.executeWindowJoin(1, compute::TimeRange(1000000, 1999999)).success);
+    EXPECT_FALSE(engine.joinLateTuples(2, late_s, {}).success);
+    
+    // Window 2 starts before window 1's end + max_delay: both are kept
+    ASSERT_TRUE(engine.executeWindowJoin(2, compute::TimeRange(1500000, 2499999)).success);
+    EXPECT_EQ(engine.getMetrics().retained_windows, 2u);
+    // Window 3 starts past it: window 1 is dropped
+    ASSERT_TRUE(engine.executeWindowJoin(3, compute::TimeRange(2500000, 3499999)).success);
+    EXPECT_EQ(engine.getMetrics().retained_windows, 2u);
+    EXPECT_FALSE(engine.joinLateTuples(1, late_s, {}).success);
+    EXPECT_TRUE(engine.joinLateTuples(2, late_s, {}).success);
+    
+    engine.expireLateState(10000000);
+    EXPECT_EQ(engine.getMetrics().retained_windows, 0u);
+}
+
+TEST_F(PECJComputeEngineTest, AutoOperatorSwitchesOnDisorder) {
+    PECJComputeEngine engine;
+    auto config = createConfig("Auto");
+    config.enable_simd = true;
+    config.retain_late_state = true;
+    config.max_delay_us = 10000000;
+    ASSERT_TRUE(engine.initialize(config, db_.get(), nullptr));
+    EXPECT_EQ(engine.activeOperator(), "IAWJ");
+    
+    int64_t base_ts = 1000000;
+    insertTestData(base_ts, 1000);
+    compute::TimeRange range(base_ts, base_ts + 999999);
+    
+    // In-order data: the exact join runs on the kernel and stays
+    auto status = engine.executeWindowJoin(0, range);
+    ASSERT_TRUE(status.success) << status.error;
+    EXPECT_TRUE(status.used_join_kernel);
+    EXPECT_EQ(status.key_cardinality, 10u);
+    EXPECT_EQ(engine.activeOperator(), "IAWJ");
+    
+    // A quarter of the tuples arrive late: the next window compensates
+    std::vector<TimeSeriesData> late(500);
+    for (size_t i = 0; i < late.size(); ++i) {
+        late[i].timestamp = base_ts + static_cast<int64_t>(i) * 1000;
+        late[i].tags["key"] = std::to_string(i % 10);
+        late[i].fields["value"] = "1";
+    }
+    ASSERT_TRUE(engine.joinLateTuples(0, late, {}).success);
+    status = engine.executeWindowJoin(1, range);
+    ASSERT_TRUE(status.success) << status.error;
+    EXPECT_NE(engine.activeOperator(), "IAWJ");
+    
+    status = engine.executeWindowJoin(2, range);
+    ASSERT_TRUE(status.success) << status.error;
+    EXPECT_FALSE(status.used_join_kernel);  // Compensating operators run on PECJ
+    
+    auto metrics = engine.getMetrics();
+    EXPECT_EQ(metrics.active_operator, engine.activeOperator());
+    EXPECT_EQ(metrics.operator_switches, 1u);
+    ASSERT_EQ(metrics.operator_decisions.size(), 1u);
+    EXPECT_EQ(metrics.operator_decisions[0].window_id, 1u);
+    EXPECT_EQ(metrics.operator_decisions[0].from, "IAWJ");
+    EXPECT_EQ(metrics.operator_decisions[0].to, metrics.active_operator);
+}
+
+TEST_F(PECJComputeEngineTest, WindowPastDeadlineReturnsScaledEstimate) {
+    PECJComputeEngine engine;
+    auto config = createConfig("IAWJ");
+    config.slide_len_us = 250000;
+    config.enable_pane_mode = true;
+    ASSERT_TRUE(engine.initialize(config, db_.get(), nullptr));
+    
+    int64_t base_ts = 1000000;
+    insertTestData(base_ts, 2000);  // Keys spread evenly: 25 per key per pane and stream
+    
+    // Expired before the first check: one pane is joined, then the window stops
+    CancellationToken token;
+    token.cancel();
+    auto status = engine.executeWindowJoin(0, compute::TimeRange(base_ts, base_ts + 1000000), token);
+    ASSERT_TRUE(status.success) << status.error;
+    EXPECT_TRUE(status.timeout_occurred);
+    EXPECT_TRUE(status.used_aqp);
+    EXPECT_EQ(status.panes_computed, 1u);
+    EXPECT_EQ(status.input_s_count, 250u);
+    // 10 keys * 25 * 25 pairs in the pane, scaled by (4 panes / 1)^2
+    EXPECT_EQ(status.join_count, 100000u);
+    EXPECT_DOUBLE_EQ(status.aqp_estimate, 100000.0);
+    
+    // The next window slides on from the partial aggregate, exactly
+    status = engine.executeWindowJoin(1, compute::TimeRange(base_ts + 250000, base_ts + 1250000));
+    ASSERT_TRUE(status.success) << status.error;
+    EXPECT_FALSE(status.timeout_occurred);
+    EXPECT_EQ(status.join_count, 100000u);
+    EXPECT_EQ(status.input_s_count, 1000u);
+    
+    auto metrics = engine.getMetrics();
+    EXPECT_EQ(metrics.timeout_windows, 1u);
+    EXPECT_EQ(metrics.total_windows_completed, 2u);
+}
+
+TEST_F(PECJComputeEngineTest, TimedOutWindowIsCompletedInBackground) {
+    auto resources = core::createResourceManager();
+    core::ResourceRequest request;
+    request.requested_threads = 1;
+    request.priority = -1;  // Below the windows' own handle
+    auto background = resources->allocate("exact_completion", request);
+    ASSERT_NE(background, nullptr);
+    
+    PECJComputeEngine engine;
+    auto config = createConfig("IAWJ");
+    config.slide_len_us = 250000;
+    config.enable_pane_mode = true;
+    ASSERT_TRUE(engine.initialize(config, db_.get(), nullptr));
+    engine.setBackgroundHandle(background.get());
+    
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<ComputeStatus> exact;
+    engine.onExactResult([&](const ComputeStatus& status) {
+        std::lock_guard<std::mutex> lock(mutex);
+        exact.push_back(status);
+        cv.notify_all();
+    });
+    
+    int64_t base_ts = 1000000;
+    insertTestData(base_ts, 1000);
+    // Skew the last pane so the one-pane estimate is off
+    for (int i = 0; i < 100; ++i) {
+        TimeSeriesData point;
+        point.timestamp = base_ts + 900000 + i;
+        point.tags["key"] = "0";
+        db_->insert("stream_s", point);
+    }
+    
+    CancellationToken token;
+    token.cancel();
+    auto status = engine.executeWindowJoin(7, compute::TimeRange(base_ts, base_ts + 1000000), token);
+    ASSERT_TRUE(status.success) << status.error;
+    EXPECT_TRUE(status.timeout_occurred);
+    EXPECT_EQ(status.join_count, 100000u);
+    
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        ASSERT_TRUE(cv.wait_for(lock, std::chrono::seconds(5), [&]() { return !exact.empty(); }));
+    }
+    EXPECT_EQ(exact[0].window_id, 7u);
+    EXPECT_TRUE(exact[0].exact_completion);
+    EXPECT_FALSE(exact[0].timeout_occurred);
+    EXPECT_FALSE(exact[0].used_aqp);
+    EXPECT_EQ(exact[0].join_count, 100000u + 100u * 100u);  // Key 0 has 100 R tuples
+    
+    // The late result does not count as another window
+    auto metrics = engine.getMetrics();
+    EXPECT_EQ(metrics.total_windows_completed, 1u);
+    EXPECT_EQ(metrics.timeout_windows, 1u);
+    EXPECT_EQ(metrics.exact_completions, 1u);
+}
+
 // ============================================================================
 // Metrics Tests
 // ============================================================================
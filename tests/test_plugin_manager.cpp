@@ -0,0 +1,180 @@
+#include <gtest/gtest.h>
+#include "sage_tsdb/plugins/plugin_manager.h"
+#include "sage_tsdb/plugins/plugin_registry.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+using namespace sage_tsdb;
+using namespace sage_tsdb::plugins;
+
+namespace {
+
+// Records how points arrive: one by one or in batches
+class CountingPlugin : public IAlgorithmPlugin {
+public:
+    bool initialize(const PluginConfig&) override { return true; }
+    void feedData(const TimeSeriesData&) override { points++; }
+    void feedBatch(std::span<const TimeSeriesData> batch) override {
+        batches++;
+        points += batch.size();
+        size_t largest = max_batch.load();
+        while (batch.size() > largest && !max_batch.compare_exchange_weak(largest, batch.size())) {}
+    }
+    AlgorithmResult process() override { return {}; }
+    std::map<std::string, int64_t> getStats() const override {
+        return {{"points", static_cast<int64_t>(points.load())},
+                {"batches", static_cast<int64_t>(batches.load())},
+                {"max_batch", static_cast<int64_t>(max_batch.load())}};
+    }
+    void reset() override {}
+    bool start() override { return true; }
+    bool stop() override { return true; }
+    std::string getName() const override { return "CountingPlugin"; }
+    std::string getVersion() const override { return "1.0.0"; }
+
+    std::atomic<size_t> points{0};
+    std::atomic<size_t> batches{0};
+    std::atomic<size_t> max_batch{0};
+};
+
+std::shared_ptr<TimeSeriesData> point(int64_t timestamp) {
+    auto data = std::make_shared<TimeSeriesData>();
+    data->timestamp = timestamp;
+    data->value = 1.0;
+    return data;
+}
+
+class PluginManagerTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        PluginRegistry::instance().register_plugin("counting", [](const PluginConfig&) {
+            return std::make_shared<CountingPlugin>();
+        });
+    }
+
+    void start(PluginManager& manager, size_t batch_size, uint64_t delay_us) {
+        PluginManager::ResourceConfig config;
+        config.thread_pool_size = 1;
+        config.feed_batch_size = batch_size;
+        config.feed_batch_delay_us = delay_us;
+        manager.setResourceConfig(config);
+        ASSERT_TRUE(manager.initialize());
+        ASSERT_TRUE(manager.loadPlugin("counting", {{"threads", "1"}, {"memory_mb", "1"}}));
+        ASSERT_TRUE(manager.startAll());
+    }
+
+    static std::map<std::string, int64_t> stats(PluginManager& manager) {
+        return manager.getPlugin("counting")->getStats();
+    }
+};
+
+} // anonymous namespace
+
+TEST_F(PluginManagerTest, FeedsFullBatches) {
+    PluginManager manager;
+    start(manager, 16, 10000000);  // Delay far beyond the test
+
+    for (int i = 0; i < 40; i++) {
+        manager.feedDataToAll(point(i));
+    }
+    auto before_flush = stats(manager);
+    EXPECT_EQ(before_flush["points"], 32);
+    EXPECT_EQ(before_flush["batches"], 2);
+    EXPECT_EQ(before_flush["max_batch"], 16);
+
+    manager.flushFeeds();
+    auto after_flush = stats(manager);
+    EXPECT_EQ(after_flush["points"], 40);
+    EXPECT_EQ(after_flush["batches"], 3);
+}
+
+TEST_F(PluginManagerTest, PartialBatchFedAfterDelay) {
+    PluginManager manager;
+    start(manager, 1000, 2000);
+
+    for (int i = 0; i < 5; i++) {
+        manager.feedDataToAll(point(i));
+    }
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (stats(manager)["points"] < 5 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    auto fed = stats(manager);
+    EXPECT_EQ(fed["points"], 5);
+    EXPECT_EQ(fed["batches"], 1);
+}
+
+TEST_F(PluginManagerTest, BatchSizeOneFeedsEachPoint) {
+    PluginManager manager;
+    start(manager, 1, 10000000);
+
+    for (int i = 0; i < 7; i++) {
+        manager.feedDataToAll(point(i));
+    }
+    auto fed = stats(manager);
+    EXPECT_EQ(fed["points"], 7);
+    EXPECT_EQ(fed["max_batch"], 1);
+}
+
+TEST_F(PluginManagerTest, StopFlushesPendingPoints) {
+    auto manager = std::make_unique<PluginManager>();
+    start(*manager, 64, 10000000);
+    auto plugin = manager->getPlugin("counting");
+
+    for (int i = 0; i < 10; i++) {
+        manager->feedDataToAll(point(i));
+    }
+    EXPECT_EQ(plugin->getStats()["points"], 0);
+    manager->stopAll();
+    EXPECT_EQ(plugin->getStats()["points"], 10);
+}
+
+TEST_F(PluginManagerTest, ReportsSubscriberLag) {
+    PluginManager manager;
+    start(manager, 1, 10000000);
+
+    manager.feedDataToAll(point(1));
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (manager.getAllStats()["_subscriber:plugin_manager.data"]["delivered"] < 1 &&
+           std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    auto all = manager.getAllStats();
+    EXPECT_EQ(all["_event_bus"]["published"], 1);
+    EXPECT_EQ(all["_subscriber:plugin_manager.data"]["delivered"], 1);
+    EXPECT_GE(all["_subscriber:plugin_manager.data"]["max_lag_us"], 0);
+    ASSERT_TRUE(all.count("_subscriber:plugin_manager.results"));
+    EXPECT_EQ(all["_subscriber:plugin_manager.results"]["dropped"], 0);
+}
+
+TEST_F(PluginManagerTest, ExportsPluginStatsIntoRegistry) {
+    auto registry = std::make_shared<MetricsRegistry>();
+    PluginManager manager;
+    manager.attachMetrics(registry);
+    start(manager, 4, 10000000);
+
+    for (int i = 0; i < 8; ++i) {
+        manager.feedDataToAll(point(i));
+    }
+    manager.flushFeeds();
+
+    // Read through getStats() at scrape time
+    double value = 0;
+    ASSERT_TRUE(registry->read("sage_tsdb_plugin_stat", {{"plugin", "counting"}, {"stat", "points"}},
+                               value));
+    EXPECT_EQ(value, static_cast<double>(stats(manager)["points"]));
+    EXPECT_EQ(value, 8.0);
+    ASSERT_TRUE(registry->read("sage_tsdb_plugin_stat",
+                               {{"plugin", "counting"}, {"stat", "max_batch"}}, value));
+    EXPECT_EQ(value, 4.0);
+
+    // The plugin fell back to stub mode, which gives its resource handle back
+    EXPECT_FALSE(registry->read("sage_tsdb_resource_memory_bytes",
+                                {{"kind", "plugin"}, {"handle", "counting"}}, value));
+
+    ASSERT_TRUE(manager.unloadPlugin("counting"));
+    EXPECT_FALSE(registry->read("sage_tsdb_plugin_stat", {{"plugin", "counting"}, {"stat", "points"}},
+                                value));
+}
@@ -0,0 +1,57 @@
+"""
+NumPy round trip through the Python bindings (add_numpy -> query_numpy)
+
+Run after building/installing the extension, e.g. `pip install -e .` then
+`pytest tests/test_python_numpy.py`.
+"""
+
+import pytest
+
+np = pytest.importorskip("numpy")
+sage_tsdb = pytest.importorskip("sage_tsdb")
+
+
+def test_add_numpy_query_numpy_round_trip():
+    db = sage_tsdb.TimeSeriesDB()
+    timestamps = np.arange(1000, 2000, 10, dtype=np.int64)
+    values = np.linspace(0.0, 1.0, timestamps.size)
+
+    added = db.add_numpy(timestamps, values, {"sensor": "a"})
+    assert added == timestamps.size
+    assert len(db) == timestamps.size
+
+    ts, vs = db.query_numpy(sage_tsdb.TimeRange(0, 10_000))
+    assert ts.dtype == np.int64
+    assert vs.dtype == np.float64
+    np.testing.assert_array_equal(ts, timestamps)
+    np.testing.assert_array_equal(vs, values)
+
+
+def test_query_numpy_filters_by_tags_and_range():
+    db = sage_tsdb.TimeSeriesDB()
+    timestamps = np.arange(0, 100, dtype=np.int64)
+    db.add_numpy(timestamps, timestamps.astype(np.float64), {"sensor": "a"})
+    db.add_numpy(timestamps, -timestamps.astype(np.float64), {"sensor": "b"})
+
+    config = sage_tsdb.QueryConfig()
+    config.time_range = sage_tsdb.TimeRange(10, 19)
+    config.filter_tags = {"sensor": "b"}
+    ts, vs = db.query_numpy(config)
+    np.testing.assert_array_equal(ts, np.arange(10, 20, dtype=np.int64))
+    np.testing.assert_array_equal(vs, -np.arange(10, 20, dtype=np.float64))
+
+
+def test_add_numpy_converts_other_dtypes():
+    db = sage_tsdb.TimeSeriesDB()
+    # int32 timestamps and float32 values are converted once (forcecast)
+    db.add_numpy(np.array([3, 1, 2], dtype=np.int32),
+                 np.array([0.5, 1.5, 2.5], dtype=np.float32))
+    ts, vs = db.query_numpy(sage_tsdb.TimeRange(0, 10))
+    assert sorted(zip(ts.tolist(), vs.tolist())) == [(1, 1.5), (2, 2.5), (3, 0.5)]
+
+
+def test_add_numpy_rejects_mismatched_lengths():
+    db = sage_tsdb.TimeSeriesDB()
+    with pytest.raises(ValueError):
+        db.add_numpy(np.arange(3, dtype=np.int64), np.zeros(2))
+    assert len(db) == 0
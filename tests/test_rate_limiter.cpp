@@ -0,0 +1,72 @@
+#include "sage_tsdb/core/rate_limiter.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace sage_tsdb {
+namespace test {
+
+namespace {
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+TEST(RateLimiterTest, CapsThroughput) {
+    // 1MB/s with a 100ms bucket: 400KB needs at least ~0.3s of refills
+    RateLimiter limiter(1024 * 1024, std::chrono::milliseconds(100));
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 100; ++i) {
+        limiter.request(4096);
+    }
+    EXPECT_GE(seconds_since(start), 0.25);
+    EXPECT_EQ(limiter.get_total_bytes(), 100u * 4096u);
+    EXPECT_GT(limiter.get_total_wait_micros(), 0u);
+}
+
+TEST(RateLimiterTest, LargeRequestsAreSplit) {
+    RateLimiter limiter(1024 * 1024, std::chrono::milliseconds(10));
+
+    // Much larger than the 10KB bucket, must still complete
+    auto start = std::chrono::steady_clock::now();
+    limiter.request(200 * 1024);
+    EXPECT_GE(seconds_since(start), 0.15);
+}
+
+TEST(RateLimiterTest, ZeroRateDisablesLimiting) {
+    RateLimiter limiter(0);
+
+    auto start = std::chrono::steady_clock::now();
+    limiter.request(1ULL << 30);
+    EXPECT_LT(seconds_since(start), 0.1);
+
+    limiter.set_bytes_per_second(512 * 1024);
+    EXPECT_EQ(limiter.get_bytes_per_second(), 512u * 1024u);
+}
+
+TEST(RateLimiterTest, SharedAcrossThreads) {
+    RateLimiter limiter(2 * 1024 * 1024, std::chrono::milliseconds(50));
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> writers;
+    for (int t = 0; t < 4; ++t) {
+        writers.emplace_back([&]() {
+            for (int i = 0; i < 64; ++i) {
+                limiter.request(4096);
+            }
+        });
+    }
+    for (auto& writer : writers) {
+        writer.join();
+    }
+
+    // 1MB total minus the initial 100KB burst at 2MB/s
+    EXPECT_GE(seconds_since(start), 0.4);
+}
+
+} // namespace test
+} // namespace sage_tsdb
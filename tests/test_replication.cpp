@@ -0,0 +1,239 @@
+#include "sage_tsdb/cluster/replication.h"
+#include "sage_tsdb/cluster/shard_server.h"
+#include "sage_tsdb/core/stream_table.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <filesystem>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+namespace sage_tsdb {
+namespace test {
+
+using namespace cluster;
+using namespace std::chrono_literals;
+
+namespace {
+
+// count points from timestamp start over 8 hosts
+std::vector<TimeSeriesData> make_points(int64_t start, int count) {
+    std::vector<TimeSeriesData> points;
+    for (int i = 0; i < count; ++i) {
+        points.emplace_back(start + i * 10, i % 13,
+                            Tags{{"host", "h" + std::to_string(i % 8)}});
+    }
+    return points;
+}
+
+std::vector<TimeSeriesData> sorted(std::vector<TimeSeriesData> points) {
+    std::sort(points.begin(), points.end(), [](const TimeSeriesData& a, const TimeSeriesData& b) {
+        return a.timestamp != b.timestamp ? a.timestamp < b.timestamp : a.tags < b.tags;
+    });
+    return points;
+}
+
+void expect_same(const std::vector<TimeSeriesData>& expected,
+                 const std::vector<TimeSeriesData>& actual) {
+    ASSERT_EQ(expected.size(), actual.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        EXPECT_EQ(expected[i].timestamp, actual[i].timestamp);
+        EXPECT_EQ(expected[i].tags, actual[i].tags);
+        EXPECT_DOUBLE_EQ(expected[i].as_double(), actual[i].as_double());
+    }
+}
+
+} // anonymous namespace
+
+TEST(TableInsertListenerTest, CoversExistingAndNewTables) {
+    const std::string dir = "./test_replication_listener";
+    fs::remove_all(dir);
+    {
+        TableManager manager(dir, 0);
+        TableConfig config;
+        config.enable_wal = false;
+        ASSERT_TRUE(manager.createStreamTable("a", config));
+
+        std::map<std::string, size_t> seen;
+        std::mutex mutex;
+        uint64_t id = manager.addTableInsertListener(
+            [&](const std::string& table, const TimeSeriesData*, size_t count) {
+                std::lock_guard<std::mutex> lock(mutex);
+                seen[table] += count;
+            });
+        ASSERT_TRUE(manager.createStreamTable("b", config));
+        manager.getStreamTable("a")->insertBatch(make_points(0, 5));
+        manager.getStreamTable("b")->insertBatch(make_points(0, 3));
+        EXPECT_EQ(seen["a"], 5u);
+        EXPECT_EQ(seen["b"], 3u);
+
+        manager.removeTableInsertListener(id);
+        manager.getStreamTable("a")->insertBatch(make_points(100, 5));
+        ASSERT_TRUE(manager.createStreamTable("c", config));
+        manager.getStreamTable("c")->insertBatch(make_points(0, 5));
+        EXPECT_EQ(seen["a"], 5u);
+        EXPECT_EQ(seen.count("c"), 0u);
+    }
+    fs::remove_all(dir);
+}
+
+class ReplicationTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        for (const char* dir : {kLeaderDir, kFollowerDir}) {
+            fs::remove_all(dir);
+        }
+        leader_ = std::make_shared<TableManager>(kLeaderDir, 0);
+        follower_manager_ = std::make_shared<TableManager>(kFollowerDir, 0);
+        table_config_.enable_wal = false;
+    }
+
+    void TearDown() override {
+        follower_.reset();
+        server_.reset();
+        log_.reset();
+        leader_.reset();
+        follower_manager_.reset();
+        for (const char* dir : {kLeaderDir, kFollowerDir}) {
+            fs::remove_all(dir);
+        }
+    }
+
+    void startLeader(ReplicationLogOptions options = {}) {
+        log_ = std::make_shared<ReplicationLog>(leader_, options);
+        ShardServerConfig config;
+        config.bind_address = "127.0.0.1";
+        config.port = 0;
+        server_ = std::make_unique<ShardServer>(leader_, config);
+        server_->setReplicationLog(log_);
+        ASSERT_TRUE(server_->start()) << server_->lastError();
+    }
+
+    void startFollower(std::chrono::milliseconds max_staleness = 2000ms) {
+        FollowerConfig config;
+        config.leader_port = server_->port();
+        config.max_staleness = max_staleness;
+        config.reconnect_interval = 20ms;
+        config.table_config = table_config_;
+        follower_ = std::make_unique<ReplicaFollower>(follower_manager_, config);
+        follower_->start();
+    }
+
+    void write(const std::string& table, const std::vector<TimeSeriesData>& points) {
+        if (!leader_->hasTable(table)) {
+            ASSERT_TRUE(leader_->createStreamTable(table, table_config_));
+        }
+        leader_->getStreamTable(table)->insertBatch(points);
+    }
+
+    // Wait for the follower to apply everything written so far
+    void catchUp() {
+        uint64_t id = log_->seal();
+        ASSERT_TRUE(follower_->waitForSegment(id, 5s)) << follower_->lastError();
+    }
+
+    std::vector<TimeSeriesData> all(TableManager& manager, const std::string& table) {
+        auto stream = manager.getStreamTable(table);
+        return stream ? sorted(stream->query(TimeRange(INT64_MIN, INT64_MAX)))
+                      : std::vector<TimeSeriesData>{};
+    }
+
+    static constexpr const char* kLeaderDir = "./test_replication_leader";
+    static constexpr const char* kFollowerDir = "./test_replication_follower";
+
+    TableConfig table_config_;
+    std::shared_ptr<TableManager> leader_;
+    std::shared_ptr<TableManager> follower_manager_;
+    std::shared_ptr<ReplicationLog> log_;
+    std::unique_ptr<ShardServer> server_;
+    std::unique_ptr<ReplicaFollower> follower_;
+};
+
+TEST_F(ReplicationTest, SnapshotThenSegments) {
+    // Written before the log existed: reaches the follower by snapshot only
+    write("cpu", make_points(0, 500));
+    ReplicationLogOptions options;
+    options.snapshot_chunk_points = 64;    // Many chunks and split ranges
+    startLeader(options);
+    startFollower();
+    catchUp();
+    expect_same(all(*leader_, "cpu"), all(*follower_manager_, "cpu"));
+
+    // Later writes, to a new table too, arrive as segments
+    write("cpu", make_points(5000, 300));
+    write("mem", make_points(0, 200));
+    catchUp();
+    expect_same(all(*leader_, "cpu"), all(*follower_manager_, "cpu"));
+    expect_same(all(*leader_, "mem"), all(*follower_manager_, "mem"));
+
+    QueryConfig config(TimeRange(1000, 6000), {{"host", "h3"}});
+    config.limit = 100000;
+    std::vector<TimeSeriesData> replica;
+    ASSERT_TRUE(follower_->query("cpu", config, replica)) << follower_->lastError();
+    expect_same(sorted(leader_->query("cpu", config)), sorted(replica));
+
+    std::vector<TimeSeriesData> latest;
+    ASSERT_TRUE(follower_->queryLatest("mem", 5, latest)) << follower_->lastError();
+    expect_same(leader_->getStreamTable("mem")->queryLatest(5), latest);
+    EXPECT_LT(follower_->staleness(), 2000ms);
+}
+
+TEST_F(ReplicationTest, ResumesAfterRestart) {
+    startLeader();
+    startFollower();
+    write("cpu", make_points(0, 100));
+    catchUp();
+    uint64_t applied = follower_->appliedSegment();
+    EXPECT_GT(applied, 0u);
+
+    follower_->stop();
+    write("cpu", make_points(2000, 100));
+    log_->seal();
+    write("cpu", make_points(4000, 100));
+    follower_->start();
+    catchUp();
+    EXPECT_GT(follower_->appliedSegment(), applied);
+    expect_same(all(*leader_, "cpu"), all(*follower_manager_, "cpu"));
+}
+
+TEST_F(ReplicationTest, FollowerBehindTheLogTakesASnapshot) {
+    ReplicationLogOptions options;
+    options.retain_bytes = 1;              // Keep the newest segment only
+    startLeader(options);
+    startFollower();
+    write("cpu", make_points(0, 100));
+    catchUp();
+
+    follower_->stop();
+    for (int i = 1; i <= 5; ++i) {
+        write("cpu", make_points(i * 10000, 50));
+        log_->seal();
+    }
+    follower_->start();
+    catchUp();
+    expect_same(all(*leader_, "cpu"), all(*follower_manager_, "cpu"));
+}
+
+TEST_F(ReplicationTest, StaleReadsFail) {
+    startLeader();
+    startFollower(300ms);
+    write("cpu", make_points(0, 50));
+    catchUp();
+    auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (follower_->staleness() > 300ms && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(10ms);
+    }
+    std::vector<TimeSeriesData> out;
+    ASSERT_TRUE(follower_->query("cpu", QueryConfig(TimeRange(0, 10000)), out))
+        << follower_->lastError();
+    EXPECT_EQ(out.size(), 50u);
+
+    // No heartbeats once the leader is gone
+    server_->stop();
+    std::this_thread::sleep_for(600ms);
+    EXPECT_FALSE(follower_->query("cpu", QueryConfig(TimeRange(0, 10000)), out));
+    EXPECT_FALSE(follower_->queryLatest("cpu", 1, out));
+}
+
+} // namespace test
+} // namespace sage_tsdb
@@ -5,19 +5,27 @@
  * 测试内容：
  * 1. BasicAllocation - 测试基本资源分配功能，验证线程和内存分配
  * 2. TaskSubmission - 测试任务提交和执行，验证多任务并发执行
+ * 2a. QueueLengthReported - 测试排队任务计入 queue_length
  * 3. UsageReporting - 测试资源使用情况上报，验证指标收集
  * 4. GlobalLimits - 测试全局资源限制设置，验证多插件资源管理
  * 5. TotalUsage - 测试总资源使用统计，验证跨插件资源汇总
  * 6. Release - 测试资源释放功能，验证资源正确回收
  * 7. PressureDetection - 测试资源压力检测，验证高负载下的压力识别
+ * 8. NumaPlacement - 测试 NUMA 节点放置，验证绑核与 ResourceUsage 中的放置信息
+ * 9. ThrottleComputeEnforced - 测试 throttleCompute 真正限制计算引擎的 CPU 时间
+ * 10. CriticalMemoryThrottles - 测试内存达到 critical_memory_bytes 后自动限流
+ * 11. LowPriorityYields - 测试低优先级句柄在高优先级任务等待时被要求让出
  * 
  * 依赖：ResourceManager 类及相关接口
  */
 
 #include "sage_tsdb/core/resource_manager.h"
+#include "sage_tsdb/core/arena.h"
+#include "sage_tsdb/core/numa_topology.h"
 #include <gtest/gtest.h>
 #include <chrono>
 #include <thread>
+#include <algorithm>
 #include <atomic>
 
 using namespace sage_tsdb::core;
@@ -100,6 +108,53 @@ TEST_F(ResourceManagerTest, TaskSubmission) {
     EXPECT_EQ(counter.load(), 10);
 }
 
+/**
+ * @test QueueLengthReported
+ * @brief 测试 queue_length 包含尚未开始的任务
+ * 
+ * 测试目的：验证 ResourceUsage::queue_length 等于上报值加上等待执行的任务数
+ * 测试步骤：
+ *   1. 分配1个线程的资源，提交一个阻塞任务占住配额
+ *   2. 再提交5个任务，上报 queue_length = 2
+ *   3. 验证查询到的 queue_length 为 7，放行后回到 2
+ */
+TEST_F(ResourceManagerTest, QueueLengthReported) {
+    ResourceRequest req;
+    req.requested_threads = 1;
+    
+    auto handle = rm_->allocate("queue_plugin", req);
+    ASSERT_NE(handle, nullptr);
+    
+    std::atomic<bool> release{false};
+    std::atomic<bool> started{false};
+    std::atomic<int> done{0};
+    ASSERT_TRUE(handle->submitTask([&]() {
+        started.store(true);
+        while (!release.load()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        done.fetch_add(1);
+    }));
+    while (!started.load()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    for (int i = 0; i < 5; ++i) {
+        ASSERT_TRUE(handle->submit([&done]() { done.fetch_add(1); }));
+    }
+    
+    ResourceUsage usage;
+    usage.queue_length = 2;
+    handle->reportUsage(usage);
+    EXPECT_EQ(rm_->queryUsage("queue_plugin").queue_length, 7);
+    
+    release.store(true);
+    for (int i = 0; i < 500 && done.load() < 6; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(done.load(), 6);
+    EXPECT_EQ(rm_->queryUsage("queue_plugin").queue_length, 2);
+}
+
 /**
  * @test UsageReporting
  * @brief 测试资源使用情况上报功能
@@ -247,6 +302,218 @@ TEST_F(ResourceManagerTest, PressureDetection) {
     handle.reset();
 }
 
+/**
+ * @test NumaPlacement
+ * @brief 测试按 NUMA 节点分配资源
+ * 
+ * 测试目的：验证请求指定节点时任务运行在该节点的 CPU 上，并在 ResourceUsage 中体现放置
+ * 测试步骤：
+ *   1. 请求第一个节点，验证 numa_node 与 cpus，并验证任务所在 CPU 属于该节点
+ *   2. 请求不存在的节点，验证分配失败
+ *   3. 开启 NUMA 感知模式，验证未指定节点的请求被放到某个节点上
+ */
+TEST_F(ResourceManagerTest, NumaPlacement) {
+    const auto& topology = NumaTopology::system();
+    const auto& node = topology.nodes().front();
+    
+    ResourceRequest req;
+    req.requested_threads = 1;
+    req.numa_node = node.id;
+    auto handle = rm_->allocate("numa_plugin", req);
+    ASSERT_NE(handle, nullptr);
+    EXPECT_EQ(handle->getAllocated().numa_node, node.id);
+    
+    auto usage = rm_->queryUsage("numa_plugin");
+    EXPECT_EQ(usage.numa_node, node.id);
+    EXPECT_EQ(usage.cpus, node.cpus);
+    
+    std::atomic<int> cpu{-2};
+    ASSERT_TRUE(handle->submitTask([&cpu]() { cpu.store(current_cpu()); }));
+    for (int i = 0; i < 500 && cpu.load() == -2; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    ASSERT_NE(cpu.load(), -2);
+    if (cpu.load() >= 0) {
+        EXPECT_TRUE(std::binary_search(node.cpus.begin(), node.cpus.end(), cpu.load()));
+    }
+    
+    // Unbound handles report no placement
+    ResourceRequest plain;
+    plain.requested_threads = 1;
+    ASSERT_NE(rm_->allocate("plain_plugin", plain), nullptr);
+    EXPECT_EQ(rm_->queryUsage("plain_plugin").numa_node, -1);
+    EXPECT_TRUE(rm_->queryUsage("plain_plugin").cpus.empty());
+    
+    ResourceRequest missing;
+    missing.requested_threads = 1;
+    missing.numa_node = 4096;
+    EXPECT_EQ(rm_->allocate("missing_node_plugin", missing), nullptr);
+    
+    rm_->setNumaAware(true);
+    auto placed = rm_->allocateForCompute("numa_engine", plain);
+    ASSERT_NE(placed, nullptr);
+    int placed_node = rm_->getComputeUsage("numa_engine").numa_node;
+    EXPECT_NE(topology.node(placed_node), nullptr);
+    
+    rm_->release("numa_plugin");
+    rm_->release("plain_plugin");
+    rm_->releaseCompute("numa_engine");
+}
+
+/**
+ * @test ThrottleComputeEnforced
+ * @brief 测试 throttleCompute 的限流在任务路径上生效
+ * 
+ * 测试目的：验证限流系数换算为 CPU 限额并体现在 ResourceUsage 中，系数 0 时任务暂停
+ * 测试步骤：
+ *   1. 为计算引擎分配2个线程，限流到 0.25，验证 cpu_limit 为 0.5
+ *   2. 限流到 0，提交任务，验证任务不执行
+ *   3. 解除限流，验证任务执行且 cpu_time_ns 记入了任务耗时
+ */
+TEST_F(ResourceManagerTest, ThrottleComputeEnforced) {
+    rm_->setGlobalLimits(16, 4ULL * 1024 * 1024 * 1024);
+    
+    ResourceRequest req;
+    req.requested_threads = 2;
+    auto handle = rm_->allocateForCompute("throttled_engine", req);
+    ASSERT_NE(handle, nullptr);
+    EXPECT_DOUBLE_EQ(rm_->getComputeUsage("throttled_engine").cpu_limit, -1.0);
+    
+    rm_->throttleCompute("throttled_engine", 0.25);
+    auto usage = rm_->getComputeUsage("throttled_engine");
+    EXPECT_DOUBLE_EQ(usage.throttle_factor, 0.25);
+    EXPECT_DOUBLE_EQ(usage.cpu_limit, 0.5);
+    
+    rm_->throttleCompute("throttled_engine", 0.0);
+    std::atomic<bool> ran{false};
+    ASSERT_TRUE(handle->submitTask([&ran]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        ran.store(true);
+    }));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_FALSE(ran.load());
+    EXPECT_EQ(rm_->getComputeUsage("throttled_engine").queue_length, 1u);
+    
+    rm_->throttleCompute("throttled_engine", 1.0);
+    for (int i = 0; i < 500 && !ran.load(); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_TRUE(ran.load());
+    usage = rm_->getComputeUsage("throttled_engine");
+    EXPECT_DOUBLE_EQ(usage.cpu_limit, -1.0);
+    EXPECT_GE(usage.cpu_time_ns, 5000000u);
+    
+    rm_->releaseCompute("throttled_engine");
+}
+
+/**
+ * @test CriticalMemoryThrottles
+ * @brief 测试内存达到硬限制后自动限流
+ * 
+ * 测试目的：验证记入 memoryTracker() 的内存计入 memory_used_bytes，超过
+ *           critical_memory_bytes 后句柄被限流，回落到 max_memory_bytes 以下后解除
+ * 测试步骤：
+ *   1. 分配 max_cpu = 1、软限制 1MB、硬限制 2MB 的资源
+ *   2. 在句柄的 Arena 中分配 3MB，验证 memory_throttled 且 cpu_limit 降为 0.25
+ *   3. 释放 Arena，验证限流解除
+ */
+TEST_F(ResourceManagerTest, CriticalMemoryThrottles) {
+    rm_->setGlobalLimits(16, 4ULL * 1024 * 1024 * 1024);
+    
+    ResourceRequest req;
+    req.requested_threads = 2;
+    req.max_cpu = 1.0;
+    req.max_memory_bytes = 1024 * 1024;
+    req.critical_memory_bytes = 2 * 1024 * 1024;
+    auto handle = rm_->allocate("memory_plugin", req);
+    ASSERT_NE(handle, nullptr);
+    ASSERT_NE(handle->memoryTracker(), nullptr);
+    EXPECT_DOUBLE_EQ(rm_->queryUsage("memory_plugin").cpu_limit, 1.0);
+    
+    sage_tsdb::Arena arena(handle->memoryTracker());
+    for (int i = 0; i < 3; ++i) {
+        arena.allocate(1024 * 1024);
+    }
+    auto usage = rm_->queryUsage("memory_plugin");
+    EXPECT_GE(usage.memory_used_bytes, 3u * 1024 * 1024);
+    EXPECT_TRUE(usage.memory_throttled);
+    EXPECT_DOUBLE_EQ(usage.cpu_limit, 0.25);
+    
+    // Throttled tasks still run, just slower
+    std::atomic<bool> ran{false};
+    ASSERT_TRUE(handle->submitTask([&ran]() { ran.store(true); }));
+    for (int i = 0; i < 500 && !ran.load(); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_TRUE(ran.load());
+    
+    arena.reset();
+    usage = rm_->queryUsage("memory_plugin");
+    EXPECT_FALSE(usage.memory_throttled);
+    EXPECT_DOUBLE_EQ(usage.cpu_limit, 1.0);
+    
+    rm_->release("memory_plugin");
+}
+
+/**
+ * @test LowPriorityYields
+ * @brief 测试计算引擎与插件之间按优先级抢占
+ * 
+ * 测试目的：验证低优先级句柄的长任务在高优先级任务等待时收到 shouldYield()
+ * 测试步骤：
+ *   1. 插件（优先级 0）与计算引擎各提交一个长任务
+ *   2. 计算引擎（优先级 10）占满配额后再提交任务
+ *   3. 验证插件收到让出请求而引擎没有，yields 计入 ResourceUsage
+ */
+TEST_F(ResourceManagerTest, LowPriorityYields) {
+    rm_->setGlobalLimits(16, 4ULL * 1024 * 1024 * 1024);
+    
+    ResourceRequest low_req;
+    low_req.requested_threads = 1;
+    auto plugin = rm_->allocate("batch_plugin", low_req);
+    ResourceRequest high_req;
+    high_req.requested_threads = 1;
+    high_req.priority = 10;
+    auto engine = rm_->allocateForCompute("urgent_engine", high_req);
+    ASSERT_NE(plugin, nullptr);
+    ASSERT_NE(engine, nullptr);
+    EXPECT_FALSE(plugin->shouldYield());
+    
+    // Hold every worker so the engine's task has to wait
+    std::atomic<bool> release{false};
+    std::atomic<int> started{0};
+    std::atomic<int> finished{0};
+    auto hold = [&]() {
+        started.fetch_add(1);
+        while (!release.load()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        finished.fetch_add(1);
+    };
+    ASSERT_TRUE(plugin->submitTask(hold));
+    ASSERT_TRUE(engine->submitTask(hold));
+    for (int i = 0; i < 500 && started.load() < 2; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    ASSERT_EQ(started.load(), 2);
+    
+    std::atomic<bool> ran{false};
+    ASSERT_TRUE(engine->submitTask([&ran]() { ran.store(true); }));
+    EXPECT_TRUE(plugin->shouldYield());
+    EXPECT_FALSE(engine->shouldYield());
+    EXPECT_GE(rm_->queryUsage("batch_plugin").yields, 1u);
+    release.store(true);
+    
+    for (int i = 0; i < 500 && (!ran.load() || finished.load() < 2); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_TRUE(ran.load());
+    EXPECT_EQ(finished.load(), 2);
+    
+    rm_->release("batch_plugin");
+    rm_->releaseCompute("urgent_engine");
+}
+
 int main(int argc, char** argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
@@ -0,0 +1,132 @@
+#include "sage_tsdb/core/roaring_bitmap.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <random>
+#include <set>
+
+namespace sage_tsdb {
+namespace test {
+
+namespace {
+
+RoaringBitmap from_set(const std::set<uint32_t>& values) {
+    RoaringBitmap bitmap;
+    for (uint32_t value : values) {
+        bitmap.add(value);
+    }
+    return bitmap;
+}
+
+std::set<uint32_t> random_set(std::mt19937& rng, size_t count, uint32_t max) {
+    std::uniform_int_distribution<uint32_t> dist(0, max);
+    std::set<uint32_t> values;
+    while (values.size() < count) {
+        values.insert(dist(rng));
+    }
+    return values;
+}
+
+} // namespace
+
+TEST(RoaringBitmapTest, AddContainsAndIterate) {
+    RoaringBitmap bitmap;
+    EXPECT_TRUE(bitmap.empty());
+    // Out of order, duplicated and spread over several containers
+    for (uint32_t value : {70000u, 5u, 3u, 5u, 65535u, 65536u, 4000000000u}) {
+        bitmap.add(value);
+    }
+    EXPECT_EQ(bitmap.cardinality(), 6u);
+    EXPECT_TRUE(bitmap.contains(65536));
+    EXPECT_FALSE(bitmap.contains(4));
+    EXPECT_EQ(bitmap.to_vector(),
+              (std::vector<uint32_t>{3, 5, 65535, 65536, 70000, 4000000000u}));
+}
+
+TEST(RoaringBitmapTest, DenseContainersBecomeBitmaps) {
+    RoaringBitmap sparse;
+    RoaringBitmap dense;
+    for (uint32_t i = 0; i < 60000; ++i) {
+        dense.add(i);
+        if (i % 100 == 0) sparse.add(i);
+    }
+    EXPECT_EQ(dense.cardinality(), 60000u);
+    // A 8KB bitmap instead of 120KB of array
+    EXPECT_LT(dense.size_bytes(), 16u * 1024u);
+
+    RoaringBitmap both = dense;
+    both &= sparse;
+    EXPECT_EQ(both.to_vector(), sparse.to_vector());
+}
+
+TEST(RoaringBitmapTest, RangeMatchesPlainSet) {
+    for (auto [lo, hi] : std::vector<std::pair<uint32_t, uint32_t>>{
+             {0, 0}, {10, 20}, {65530, 65542}, {100, 200000}, {64, 128}}) {
+        auto values = RoaringBitmap::range(lo, hi).to_vector();
+        ASSERT_EQ(values.size(), hi - lo) << lo << ".." << hi;
+        for (size_t i = 0; i < values.size(); ++i) {
+            ASSERT_EQ(values[i], lo + i);
+        }
+    }
+}
+
+TEST(RoaringBitmapTest, IntersectionMatchesSetIntersection) {
+    std::mt19937 rng(42);
+    // Sparse/sparse, sparse/dense (galloping), dense/dense
+    for (auto [na, nb] : std::vector<std::pair<size_t, size_t>>{
+             {2000, 3000}, {50, 20000}, {30000, 40000}}) {
+        auto a = random_set(rng, na, 200000);
+        auto b = random_set(rng, nb, 200000);
+        auto c = random_set(rng, 50000, 200000);
+
+        std::vector<uint32_t> expected;
+        for (uint32_t value : a) {
+            if (b.count(value) && c.count(value)) expected.push_back(value);
+        }
+
+        auto ba = from_set(a), bb = from_set(b), bc = from_set(c);
+        auto result = RoaringBitmap::intersect({&ba, &bb, &bc});
+        EXPECT_EQ(result.to_vector(), expected) << na << " " << nb;
+        EXPECT_EQ(result.cardinality(), expected.size());
+    }
+    EXPECT_TRUE(RoaringBitmap::intersect({}).empty());
+}
+
+TEST(RoaringBitmapTest, FromSortedAndEarlyStop) {
+    std::vector<uint32_t> values;
+    for (uint32_t i = 0; i < 10000; ++i) {
+        values.push_back(i * 3);
+    }
+    auto bitmap = RoaringBitmap::from_sorted(values.data(), values.size());
+    EXPECT_EQ(bitmap.to_vector(), values);
+
+    size_t seen = 0;
+    bitmap.for_each([&](uint32_t) { return ++seen < 10; });
+    EXPECT_EQ(seen, 10u);
+}
+
+TEST(RoaringBitmapTest, SuffixIterationAndRemoval) {
+    RoaringBitmap bitmap;
+    for (uint32_t i = 0; i < 200000; i += (i < 70000 ? 1 : 7)) {
+        bitmap.add(i);
+    }
+    for (uint32_t first : {0u, 5u, 65600u, 70003u, 300000u}) {
+        std::vector<uint32_t> expected;
+        for (uint32_t value : bitmap.to_vector()) {
+            if (value >= first) expected.push_back(value);
+        }
+        std::vector<uint32_t> suffix;
+        bitmap.for_each_from(first, [&](uint32_t value) {
+            suffix.push_back(value);
+            return true;
+        });
+        EXPECT_EQ(suffix, expected) << first;
+
+        RoaringBitmap prefix = bitmap;
+        prefix.remove_from(first);
+        EXPECT_EQ(prefix.cardinality() + expected.size(), bitmap.cardinality()) << first;
+        EXPECT_FALSE(prefix.contains(first));
+    }
+}
+
+} // namespace test
+} // namespace sage_tsdb
@@ -0,0 +1,104 @@
+#include "sage_tsdb/core/series_catalog.h"
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+namespace sage_tsdb {
+namespace test {
+
+class SeriesCatalogTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        path_ = "./test_series_catalog.bin";
+        fs::remove(path_);
+    }
+
+    void TearDown() override {
+        fs::remove(path_);
+    }
+
+    static Tags series(int i) {
+        return {{"host", "h" + std::to_string(i % 7)}, {"sensor", "s" + std::to_string(i)}};
+    }
+
+    std::string path_;
+};
+
+TEST_F(SeriesCatalogTest, InternsEachTagSetOnce) {
+    SeriesCatalog catalog;
+    uint32_t a = catalog.intern(series(1));
+    uint32_t b = catalog.intern(series(2));
+    EXPECT_EQ(a, 0u);
+    EXPECT_EQ(b, 1u);
+    EXPECT_EQ(catalog.intern(series(1)), a);
+    EXPECT_EQ(catalog.intern(Tags{}), 2u);
+    EXPECT_EQ(catalog.size(), 3u);
+
+    EXPECT_EQ(catalog.tags(b), series(2));
+    EXPECT_EQ(catalog.find(series(2)), b);
+    EXPECT_EQ(catalog.find(series(3)), SeriesCatalog::kInvalidId);
+    EXPECT_FALSE(catalog.contains(3));
+    EXPECT_GT(catalog.memory_bytes(), 0u);
+}
+
+TEST_F(SeriesCatalogTest, ReopenKeepsIdsAndDropsTornTail) {
+    {
+        SeriesCatalog catalog;
+        ASSERT_TRUE(catalog.open(path_));
+        for (int i = 0; i < 100; ++i) {
+            ASSERT_EQ(catalog.intern(series(i)), static_cast<uint32_t>(i));
+        }
+    }
+    {
+        // Crash halfway through a record
+        std::ofstream out(path_, std::ios::binary | std::ios::app);
+        uint32_t length = 64, crc = 0;
+        out.write(reinterpret_cast<const char*>(&length), sizeof(length));
+        out.write(reinterpret_cast<const char*>(&crc), sizeof(crc));
+        out.write("partial", 7);
+    }
+
+    SeriesCatalog catalog;
+    ASSERT_TRUE(catalog.open(path_));
+    ASSERT_EQ(catalog.size(), 100u);
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_EQ(catalog.tags(static_cast<uint32_t>(i)), series(i));
+    }
+    EXPECT_EQ(catalog.intern(series(100)), 100u);
+
+    SeriesCatalog reopened;
+    ASSERT_TRUE(reopened.open(path_));
+    EXPECT_EQ(reopened.find(series(100)), 100u);
+}
+
+TEST_F(SeriesCatalogTest, ConcurrentInternAgreesOnIds) {
+    SeriesCatalog catalog;
+    constexpr int kThreads = 4;
+    constexpr int kSeries = 500;
+    std::vector<std::vector<uint32_t>> ids(kThreads, std::vector<uint32_t>(kSeries));
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < kSeries; ++i) {
+                ids[t][i] = catalog.intern(series(i));
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    EXPECT_EQ(catalog.size(), static_cast<size_t>(kSeries));
+    for (int i = 0; i < kSeries; ++i) {
+        for (int t = 1; t < kThreads; ++t) {
+            EXPECT_EQ(ids[t][i], ids[0][i]);
+        }
+        EXPECT_EQ(catalog.tags(ids[0][i]), series(i));
+    }
+}
+
+} // namespace test
+} // namespace sage_tsdb
@@ -0,0 +1,185 @@
+#include "sage_tsdb/core/sharded_table.h"
+#include "sage_tsdb/core/time_series_db.h"
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <set>
+
+namespace fs = std::filesystem;
+
+namespace sage_tsdb {
+namespace test {
+
+class ShardedTableTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        test_dir_ = "./test_sharded_table_data";
+        fs::remove_all(test_dir_);
+    }
+
+    void TearDown() override {
+        fs::remove_all(test_dir_);
+    }
+
+    // 16 hosts with 2 sensors each; one point per millisecond round-robin
+    static std::vector<TimeSeriesData> points(int count) {
+        std::vector<TimeSeriesData> batch;
+        for (int i = 0; i < count; ++i) {
+            Tags tags = {{"host", "h" + std::to_string(i % 16)},
+                         {"sensor", "s" + std::to_string(i % 2)}};
+            batch.emplace_back(i, static_cast<double>(i), tags);
+        }
+        return batch;
+    }
+
+    std::string test_dir_;
+};
+
+TEST_F(ShardedTableTest, BatchesSpreadAcrossShardsAndMergeInOrder) {
+    ShardedTableConfig config;
+    config.num_shards = 4;
+    config.shard_by = {"host"};
+    ShardedTable table(config);
+
+    auto indices = table.insertBatch(points(4000));
+    ASSERT_EQ(indices.size(), 4000u);
+    EXPECT_EQ(indices.front(), 0u);
+    EXPECT_EQ(indices.back(), 3999u);
+    EXPECT_EQ(table.size(), 4000u);
+
+    std::set<size_t> used;
+    for (int h = 0; h < 16; ++h) {
+        used.insert(table.shard_of({{"host", "h" + std::to_string(h)}, {"sensor", "s0"}}));
+    }
+    EXPECT_GT(used.size(), 1u);
+
+    QueryConfig all(TimeRange{0, 3999});
+    all.limit = 0;
+    auto results = table.query(all);
+    ASSERT_EQ(results.size(), 4000u);
+    for (size_t i = 0; i < results.size(); ++i) {
+        ASSERT_EQ(results[i].timestamp, static_cast<int64_t>(i));
+    }
+
+    QueryConfig limited(TimeRange{100, 3999});
+    limited.limit = 10;
+    auto first = table.query(limited);
+    ASSERT_EQ(first.size(), 10u);
+    EXPECT_EQ(first.front().timestamp, 100);
+    EXPECT_EQ(first.back().timestamp, 109);
+}
+
+TEST_F(ShardedTableTest, FiltersVisitOnlyMatchingShards) {
+    ShardedTableConfig config;
+    config.num_shards = 8;
+    config.shard_by = {"host"};
+    ShardedTable table(config);
+    table.insertBatch(points(1600));
+
+    // Binding the shard key routes to one shard
+    Tags host = {{"host", "h3"}};
+    auto shards = table.candidate_shards(host);
+    ASSERT_EQ(shards.size(), 1u);
+    EXPECT_EQ(shards[0], table.shard_of(host));
+
+    QueryConfig config_h3(TimeRange{0, 1599}, host);
+    config_h3.limit = 0;
+    auto results = table.query(config_h3);
+    ASSERT_EQ(results.size(), 100u);
+    for (const auto& point : results) {
+        EXPECT_EQ(point.tags.at("host"), "h3");
+    }
+
+    // Values no shard has seen prune everything
+    EXPECT_TRUE(table.candidate_shards({{"host", "h99"}}).empty());
+    EXPECT_TRUE(table.candidate_shards({{"sensor", "s9"}}).empty());
+
+    // Other tags fan out to the shards holding them
+    QueryConfig sensor(TimeRange{0, 1599}, {{"sensor", "s1"}});
+    sensor.limit = 0;
+    EXPECT_EQ(table.query(sensor).size(), 800u);
+}
+
+TEST_F(ShardedTableTest, AggregatesAcrossShards) {
+    ShardedTableConfig config;
+    config.num_shards = 4;
+    config.shard_by = {"host"};
+    ShardedTable table(config);
+    table.insertBatch(points(1600));
+
+    // Groups spanning shards: aggregated after the merge
+    QueryConfig by_sensor(TimeRange{0, 1599});
+    by_sensor.limit = 0;
+    by_sensor.aggregation = AggregationType::COUNT;
+    by_sensor.window_size = 800;
+    by_sensor.group_by = {"sensor"};
+    auto counts = table.query(by_sensor);
+    ASSERT_EQ(counts.size(), 4u);
+    for (const auto& bucket : counts) {
+        EXPECT_DOUBLE_EQ(bucket.as_double(), 400.0);
+    }
+    EXPECT_EQ(counts[0].timestamp, 0);
+    EXPECT_EQ(counts[3].timestamp, 800);
+
+    QueryConfig average(TimeRange{0, 1599});
+    average.aggregation = AggregationType::AVG;
+    auto avg = table.query(average);
+    ASSERT_EQ(avg.size(), 1u);
+    EXPECT_DOUBLE_EQ(avg[0].as_double(), 799.5);
+
+    // Groups within shards: pushed down, same answer per host
+    QueryConfig by_host(TimeRange{0, 1599});
+    by_host.limit = 0;
+    by_host.aggregation = AggregationType::SUM;
+    by_host.group_by = {"host"};
+    auto sums = table.query(by_host);
+    ASSERT_EQ(sums.size(), 16u);
+    double total = 0.0;
+    for (const auto& bucket : sums) {
+        total += bucket.as_double();
+    }
+    EXPECT_DOUBLE_EQ(total, 1599.0 * 1600.0 / 2.0);
+}
+
+TEST_F(ShardedTableTest, ShardsRecoverFromTheirLogs) {
+    ShardedTableConfig config;
+    config.num_shards = 3;
+    config.data_dir = test_dir_;
+    config.lsm.wal_sync_mode = WalSyncMode::PerGroup;
+    {
+        ShardedTable table(config);
+        table.insertBatch(points(300));
+        table.insert(TimeSeriesData(300, 300.0, {{"host", "h0"}, {"sensor", "s0"}}));
+    }
+    for (size_t i = 0; i < config.num_shards; ++i) {
+        EXPECT_TRUE(fs::exists(test_dir_ + "/shard-" + std::to_string(i)));
+    }
+
+    ShardedTable reopened(config);
+    EXPECT_EQ(reopened.size(), 301u);
+    QueryConfig h0(TimeRange{0, 300}, {{"host", "h0"}});
+    h0.limit = 0;
+    auto results = reopened.query(h0);
+    ASSERT_EQ(results.size(), 20u);
+    EXPECT_EQ(results.back().timestamp, 300);
+    EXPECT_EQ(reopened.insert(TimeSeriesData(301, 1.0)), 301u);
+}
+
+TEST_F(ShardedTableTest, TimeSeriesDBRoutesShardedTables) {
+    TimeSeriesDB db;
+    ShardedTableConfig config;
+    config.num_shards = 4;
+    ASSERT_TRUE(db.createShardedTable("metrics", config));
+    EXPECT_FALSE(db.createTable("metrics"));
+    EXPECT_TRUE(db.hasTable("metrics"));
+
+    db.insertBatch("metrics", points(64));
+    db.insert("metrics", TimeSeriesData(64, 64.0, {{"host", "h0"}, {"sensor", "s0"}}));
+    EXPECT_EQ(db.query("metrics", TimeRange{0, 64}).size(), 65u);
+    EXPECT_EQ(db.query("metrics", TimeRange{0, 64}, {{"host", "h0"}}).size(), 5u);
+
+    EXPECT_TRUE(db.dropTable("metrics"));
+    EXPECT_FALSE(db.hasTable("metrics"));
+}
+
+} // namespace test
+} // namespace sage_tsdb
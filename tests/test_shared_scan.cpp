@@ -0,0 +1,162 @@
+/**
+ * @file test_shared_scan.cpp
+ * @brief Unit tests for SharedScanCoordinator
+ */
+
+#include <gtest/gtest.h>
+
+#include "sage_tsdb/compute/shared_scan.h"
+#include "sage_tsdb/core/time_series_db.h"
+
+#include <limits>
+#include <thread>
+#include <vector>
+
+using namespace sage_tsdb;
+using namespace sage_tsdb::compute;
+
+namespace {
+
+class SharedScanTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        db_.createTable("stream_s");
+        db_.createTable("stream_r");
+        // One tuple per millisecond over [0, 1s), keys 0..9
+        for (int64_t i = 0; i < 1000; ++i) {
+            TimeSeriesData s;
+            s.timestamp = i * 1000;
+            s.tags["key"] = std::to_string(i % 10);
+            s.fields["value"] = std::to_string(i);
+            db_.insert("stream_s", s);
+
+            TimeSeriesData r = s;
+            r.timestamp += 500;
+            r.tags["key"] = std::to_string(i % 5);
+            db_.insert("stream_r", r);
+        }
+    }
+
+    ScanColumns direct(const std::string& table, int64_t start, int64_t end) {
+        ScanColumns out;
+        int64_t min_ts = std::numeric_limits<int64_t>::max();
+        int64_t max_ts = std::numeric_limits<int64_t>::min();
+        scanTableRange(db_, table, start, end, out, min_ts, max_ts);
+        return out;
+    }
+
+    ScanColumns shared(SharedScanCoordinator& scan, const std::string& table,
+                       int64_t start, int64_t end) {
+        ScanColumns out;
+        int64_t min_ts = std::numeric_limits<int64_t>::max();
+        int64_t max_ts = std::numeric_limits<int64_t>::min();
+        scan.scan(table, start, end, out, min_ts, max_ts);
+        return out;
+    }
+
+    TimeSeriesDB db_;
+};
+
+}  // namespace
+
+TEST_F(SharedScanTest, ScanMatchesDirectRead) {
+    SharedScanCoordinator scan(&db_, 100000);
+
+    // Ranges inside, across and on segment boundaries
+    for (auto [start, end] : {std::pair<int64_t, int64_t>{0, 99999},
+                              {150000, 420500}, {99999, 100000}, {900000, 2000000}}) {
+        auto expected = direct("stream_r", start, end);
+        auto actual = shared(scan, "stream_r", start, end);
+        EXPECT_EQ(actual.keys, expected.keys) << start << ".." << end;
+        EXPECT_EQ(actual.values, expected.values);
+        EXPECT_EQ(actual.event_times, expected.event_times);
+    }
+}
+
+TEST_F(SharedScanTest, SegmentsAreReadOnce) {
+    SharedScanCoordinator scan(&db_, 100000);
+    shared(scan, "stream_s", 0, 499999);
+    EXPECT_EQ(scan.getStats().segments_read, 5u);
+
+    // Overlapping windows of other lengths only read the new segments
+    shared(scan, "stream_s", 200000, 699999);
+    shared(scan, "stream_s", 0, 999999);
+    auto stats = scan.getStats();
+    EXPECT_EQ(stats.segments_read, 10u);
+    EXPECT_EQ(stats.segment_hits, 10u);
+
+    // Other tables have their own segments
+    shared(scan, "stream_r", 0, 99999);
+    EXPECT_EQ(scan.getStats().segments_read, 11u);
+}
+
+TEST_F(SharedScanTest, ConcurrentScansShareOneRead) {
+    SharedScanCoordinator scan(&db_, 1000000);
+    std::vector<std::thread> threads;
+    std::vector<size_t> sizes(8);
+    for (size_t t = 0; t < sizes.size(); ++t) {
+        threads.emplace_back([&, t]() { sizes[t] = shared(scan, "stream_s", 0, 999999).size(); });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (size_t size : sizes) {
+        EXPECT_EQ(size, 1000u);
+    }
+    EXPECT_EQ(scan.getStats().segments_read, 1u);
+}
+
+TEST_F(SharedScanTest, PanesSharedBySlideAndTables) {
+    SharedScanCoordinator scan(&db_, 100000);
+    auto first = scan.pane("stream_s", "stream_r", 250000, 1);
+    auto again = scan.pane("stream_s", "stream_r", 250000, 1);
+    EXPECT_EQ(first, again);
+    EXPECT_EQ(first->s_count, 250u);
+    EXPECT_EQ(first->r_count, 250u);
+    EXPECT_EQ(first->s_keys.at(3), 25u);
+    EXPECT_EQ(first->r_keys.at(3), 50u);
+
+    // Another slide is another pane
+    auto other = scan.pane("stream_s", "stream_r", 500000, 1);
+    EXPECT_NE(first, other);
+    EXPECT_EQ(other->s_count, 500u);
+
+    auto stats = scan.getStats();
+    EXPECT_EQ(stats.panes_computed, 2u);
+    EXPECT_EQ(stats.pane_hits, 1u);
+}
+
+TEST_F(SharedScanTest, AdvanceDropsWhatNoConsumerNeeds) {
+    SharedScanCoordinator scan(&db_, 100000);
+    uint64_t fast = scan.registerConsumer();
+    uint64_t slow = scan.registerConsumer();
+    shared(scan, "stream_s", 0, 999999);
+    scan.pane("stream_s", "stream_r", 500000, 0);  // Also reads 5 segments of stream_r
+    EXPECT_EQ(scan.getStats().cached_segments, 15u);
+
+    // The slow consumer still needs everything
+    scan.advance(fast, 600000);
+    EXPECT_EQ(scan.getStats().cached_segments, 15u);
+
+    scan.advance(slow, 300000);
+    auto stats = scan.getStats();
+    EXPECT_EQ(stats.cached_segments, 7u + 2u);
+    EXPECT_EQ(stats.cached_panes, 1u);  // [0, 500000) still overlaps
+
+    // Once the slow consumer leaves, the fast one decides
+    scan.unregisterConsumer(slow);
+    stats = scan.getStats();
+    EXPECT_EQ(stats.cached_segments, 4u);
+    EXPECT_EQ(stats.cached_panes, 0u);
+    EXPECT_EQ(stats.consumers, 1u);
+
+    // Evicted segments are read again when needed
+    shared(scan, "stream_s", 0, 99999);
+    EXPECT_EQ(scan.getStats().segments_read, 16u);
+}
+
+TEST(SharedScanCoordinatorTest, RejectsInvalidArguments) {
+    EXPECT_THROW(SharedScanCoordinator(nullptr), std::invalid_argument);
+    TimeSeriesDB db;
+    EXPECT_THROW(SharedScanCoordinator(&db, 0), std::invalid_argument);
+}
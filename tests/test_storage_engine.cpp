@@ -2,6 +2,7 @@
 #include "sage_tsdb/core/time_series_db.h"
 #include <gtest/gtest.h>
 #include <filesystem>
+#include <fstream>
 #include <chrono>
 
 namespace fs = std::filesystem;
@@ -272,6 +273,90 @@ TEST_F(StorageEngineTest, ComplexTagsAndFields) {
     EXPECT_EQ(loaded_data[0].fields, point.fields);
 }
 
+TEST_F(StorageEngineTest, QueryStreamsWithFilterAndLimit) {
+    auto test_data = generate_test_data(300);
+    ASSERT_TRUE(engine_->save(test_data, test_dir_ + "/query.tsdb"));
+    
+    QueryConfig config(TimeRange(test_data[10].timestamp, test_data[200].timestamp),
+                       {{"sensor", "temp_1"}});
+    config.limit = 5;
+    auto results = engine_->query(config);
+    
+    ASSERT_EQ(results.size(), 5u);
+    int64_t previous = INT64_MIN;
+    for (const auto& point : results) {
+        EXPECT_EQ(point.tags.at("sensor"), "temp_1");
+        EXPECT_EQ(point.tags.count("__file_path__"), 0u);
+        EXPECT_GT(point.timestamp, previous);
+        previous = point.timestamp;
+    }
+    EXPECT_EQ(results.front().timestamp, test_data[10].timestamp);
+    
+    config.limit = 0;
+    EXPECT_EQ(engine_->query(config).size(), 64u);
+}
+
+TEST_F(StorageEngineTest, QueryAggregatesByWindow) {
+    auto test_data = generate_test_data(300);
+    ASSERT_TRUE(engine_->save(test_data, test_dir_ + "/aggregate.tsdb"));
+    
+    QueryConfig config(TimeRange(test_data.front().timestamp, test_data.back().timestamp));
+    config.aggregation = AggregationType::SUM;
+    auto total = engine_->query(config);
+    ASSERT_EQ(total.size(), 1u);
+    EXPECT_DOUBLE_EQ(total[0].as_double(), 300 * 100.0 + 299 * 300 / 2.0);
+    
+    // 60 s windows over points 1 s apart
+    config.aggregation = AggregationType::COUNT;
+    config.window_size = 60000;
+    config.limit = 0;
+    auto windows = engine_->query(config);
+    ASSERT_GE(windows.size(), 5u);
+    double count = 0;
+    for (size_t i = 0; i < windows.size(); ++i) {
+        EXPECT_EQ(windows[i].timestamp % 60000, 0);
+        EXPECT_LE(windows[i].as_double(), 60.0);
+        count += windows[i].as_double();
+    }
+    EXPECT_EQ(count, 300.0);
+    
+    config.aggregation = AggregationType::MAX;
+    config.filter_tags = {{"sensor", "temp_1"}};
+    config.window_size = 0;
+    auto max = engine_->query(config);
+    ASSERT_EQ(max.size(), 1u);
+    EXPECT_EQ(max[0].as_double(), 100.0 + 298);
+}
+
+TEST_F(StorageEngineTest, QueryAggregatesPerGroup) {
+    auto test_data = generate_test_data(300);
+    ASSERT_TRUE(engine_->save(test_data, test_dir_ + "/groups.tsdb"));
+    
+    QueryConfig config(TimeRange(test_data.front().timestamp, test_data.back().timestamp));
+    config.aggregation = AggregationType::COUNT;
+    config.group_by = {"sensor"};
+    config.limit = 0;
+    auto groups = engine_->query(config);
+    ASSERT_EQ(groups.size(), 3u);
+    for (const auto& point : groups) {
+        EXPECT_EQ(point.as_double(), 100.0);
+        EXPECT_EQ(point.tags.size(), 1u);
+        EXPECT_EQ(point.tags.count("sensor"), 1u);
+    }
+    
+    // Filter tags are kept next to the group's
+    config.aggregation = AggregationType::FIRST;
+    config.filter_tags = {{"location", "room_1"}};
+    config.window_size = 60000;
+    auto windows = engine_->query(config);
+    ASSERT_FALSE(windows.empty());
+    EXPECT_EQ(windows[0].tags.at("location"), "room_1");
+    EXPECT_EQ(windows[0].as_double(), 101.0);
+    for (size_t i = 1; i < windows.size(); ++i) {
+        EXPECT_LE(windows[i - 1].timestamp, windows[i].timestamp);
+    }
+}
+
 // Integration test with TimeSeriesDB
 class TimeSeriesDBPersistenceTest : public ::testing::Test {
 protected:
@@ -416,5 +501,102 @@ TEST_F(TimeSeriesDBPersistenceTest, PersistenceWithQuery) {
     EXPECT_EQ(results.size(), 50);
 }
 
+TEST_F(StorageEngineTest, ChunkedSnapshotLoadsInParallelInOrder) {
+    // Several chunks, some vector values, fields on every point
+    const size_t count = SnapshotWriter::kChunkPoints * 3 + 123;
+    std::vector<TimeSeriesData> data;
+    data.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        TimeSeriesData point(static_cast<int64_t>(i) * 10, static_cast<double>(i),
+                             {{"sensor", "s" + std::to_string(i % 5)}});
+        if (i % 1000 == 0) {
+            point.value = std::vector<double>{1.0, static_cast<double>(i)};
+        }
+        point.fields["seq"] = static_cast<int64_t>(i);
+        data.push_back(std::move(point));
+    }
+    std::string file_path = test_dir_ + "/chunked.tsdb";
+    ASSERT_TRUE(engine_->save_chunked(data.begin(), data.end(), file_path));
+    EXPECT_TRUE(StorageEngine::is_chunked_file(file_path));
+    EXPECT_GT(engine_->get_statistics()["bytes_written"], 0u);
+
+    SnapshotReader reader;
+    ASSERT_TRUE(reader.open(file_path));
+    ASSERT_EQ(reader.chunks().size(), 4u);
+    EXPECT_EQ(reader.point_count(), count);
+    EXPECT_EQ(reader.chunks()[1].min_timestamp,
+              static_cast<int64_t>(SnapshotWriter::kChunkPoints) * 10);
+
+    for (size_t threads : {1u, 4u}) {
+        std::vector<TimeSeriesData> loaded;
+        size_t chunks = 0;
+        ASSERT_TRUE(engine_->load_chunked(file_path, [&](std::vector<TimeSeriesData>&& chunk) {
+            chunks++;
+            loaded.insert(loaded.end(), chunk.begin(), chunk.end());
+        }, threads));
+        EXPECT_EQ(chunks, 4u);
+        ASSERT_EQ(loaded.size(), count);
+        for (size_t i = 0; i < count; i += 997) {
+            EXPECT_EQ(loaded[i].timestamp, data[i].timestamp);
+            EXPECT_EQ(loaded[i].value, data[i].value);
+            EXPECT_EQ(loaded[i].tags, data[i].tags);
+            EXPECT_EQ(loaded[i].fields, data[i].fields);
+        }
+    }
+
+    // load() reads snapshots too
+    EXPECT_EQ(engine_->load(file_path).size(), count);
+}
+
+TEST_F(StorageEngineTest, ChunkedSnapshotRejectsDamage) {
+    auto data = generate_test_data(SnapshotWriter::kChunkPoints + 10);
+    std::string file_path = test_dir_ + "/damaged.tsdb";
+    ASSERT_TRUE(engine_->save_chunked(data.begin(), data.end(), file_path));
+
+    // A flipped byte in the second chunk: the first is still delivered
+    SnapshotReader reader;
+    ASSERT_TRUE(reader.open(file_path));
+    auto offset = reader.chunks()[1].offset + 5;
+    reader = SnapshotReader();
+    {
+        std::fstream file(file_path, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(static_cast<std::streamoff>(offset));
+        file.put('\x7f');
+    }
+    size_t delivered = 0;
+    EXPECT_FALSE(engine_->load_chunked(file_path, [&](std::vector<TimeSeriesData>&& chunk) {
+        delivered += chunk.size();
+    }, 2));
+    EXPECT_EQ(delivered, SnapshotWriter::kChunkPoints);
+
+    // Truncation loses the trailer, so the file is not a snapshot at all
+    fs::resize_file(file_path, fs::file_size(file_path) - 3);
+    EXPECT_FALSE(StorageEngine::is_chunked_file(file_path));
+    EXPECT_FALSE(engine_->load_chunked(file_path, [](std::vector<TimeSeriesData>&&) {}));
+}
+
+TEST_F(TimeSeriesDBPersistenceTest, SnapshotKeepsEveryPoint) {
+    // More points than a default query returns
+    const int count = 5000;
+    for (int i = 0; i < count; ++i) {
+        db_->add(1000 + i, static_cast<double>(i), {{"key", std::to_string(i % 7)}});
+    }
+    std::string file_path = test_dir_ + "/large_snapshot.tsdb";
+    ASSERT_TRUE(db_->save_to_disk(file_path));
+    EXPECT_TRUE(StorageEngine::is_chunked_file(file_path));
+
+    db_->clear();
+    ASSERT_TRUE(db_->load_from_disk(file_path));
+    EXPECT_EQ(db_->size(), static_cast<size_t>(count));
+
+    QueryConfig config(TimeRange(1000, 1000 + count));
+    config.limit = 0;
+    auto points = db_->query(config);
+    ASSERT_EQ(points.size(), static_cast<size_t>(count));
+    EXPECT_EQ(points[4321].timestamp, 1000 + 4321);
+    EXPECT_DOUBLE_EQ(points[4321].as_double(), 4321.0);
+    EXPECT_EQ(points[4321].tags.at("key"), std::to_string(4321 % 7));
+}
+
 } // namespace test
 } // namespace sage_tsdb
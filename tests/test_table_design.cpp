@@ -1,7 +1,11 @@
 #include <gtest/gtest.h>
 #include "sage_tsdb/core/stream_table.h"
+#include "sage_tsdb/core/bulk_file.h"
 #include "sage_tsdb/core/join_result_table.h"
 #include "sage_tsdb/core/table_manager.h"
+#include <atomic>
+#include <filesystem>
+#include <thread>
 
 using namespace sage_tsdb;
 
@@ -57,6 +61,45 @@ TEST_F(StreamTableTest, BatchInsert) {
     EXPECT_EQ(table->size(), 100);
 }
 
+TEST_F(StreamTableTest, ScalarTableRejectsArrays) {
+    TableConfig config;
+    config.scalar_values = true;
+    StreamTable scalars("scalar_stream", config);
+    
+    scalars.insert(TimeSeriesData(1000, 1.5));
+    EXPECT_THROW(scalars.insert(TimeSeriesData(2000, std::vector<double>{1.0, 2.0})),
+                 std::invalid_argument);
+    
+    // 含数组值的批次整批拒绝
+    std::vector<TimeSeriesData> batch = {TimeSeriesData(3000, 3.0),
+                                         TimeSeriesData(4000, std::vector<double>{4.0})};
+    EXPECT_THROW(scalars.insertBatch(batch), std::invalid_argument);
+    EXPECT_EQ(scalars.size(), 1u);
+    EXPECT_EQ(scalars.query(TimeRange(0, 5000)).size(), 1u);
+}
+
+TEST_F(StreamTableTest, MovedBatchInsert) {
+    std::vector<TimeSeriesData> batch;
+    for (int i = 0; i < 100; i++) {
+        TimeSeriesData data(i * 1000, static_cast<double>(i));
+        data.tags["sensor"] = (i % 2 == 0) ? "a" : "b";
+        data.fields["unit"] = std::string("celsius");
+        batch.push_back(std::move(data));
+    }
+    
+    auto indices = table->insertBatch(std::move(batch));
+    ASSERT_EQ(indices.size(), 100u);
+    EXPECT_EQ(table->size(), 100u);
+    
+    // 标签与字段随数据点移入 MemTable
+    auto results = table->query(TimeRange(0, 99000), {{"sensor", "a"}});
+    ASSERT_EQ(results.size(), 50u);
+    for (const auto& data : results) {
+        EXPECT_EQ(static_cast<int64_t>(data.as_double()) % 2, 0);
+        EXPECT_EQ(data.fields.at("unit").to_string(), "celsius");
+    }
+}
+
 TEST_F(StreamTableTest, QueryWithTimeRange) {
     // 插入 10 条数据
     for (int i = 0; i < 10; i++) {
@@ -114,6 +157,38 @@ TEST_F(StreamTableTest, QueryLatest) {
     EXPECT_EQ(latest[2].timestamp, 7000);
 }
 
+TEST_F(StreamTableTest, QueryLatestPerSeries) {
+    for (int i = 0; i < 30; i++) {
+        table->insert(TimeSeriesData(i * 1000, static_cast<double>(i),
+                                     Tags{{"symbol", i % 3 == 0 ? "AAPL" : "MSFT"}}));
+    }
+    // 乱序到达的旧数据不会覆盖最新值；同一时间戳与标签的数据点被替换
+    table->insert(TimeSeriesData(500, -1.0, Tags{{"symbol", "AAPL"}}));
+    table->insert(TimeSeriesData(29000, 99.0, Tags{{"symbol", "MSFT"}}));
+    
+    auto current = table->queryLatestPerSeries();
+    ASSERT_EQ(current.size(), 2);
+    EXPECT_EQ(current[0].tags.at("symbol"), "AAPL");
+    EXPECT_EQ(current[0].timestamp, 27000);
+    EXPECT_EQ(current[1].timestamp, 29000);
+    EXPECT_DOUBLE_EQ(current[1].as_double(), 99.0);
+    
+    auto msft = table->queryLatestPerSeries(1, {{"symbol", "MSFT"}});
+    ASSERT_EQ(msft.size(), 1);
+    EXPECT_EQ(msft[0].timestamp, 29000);
+    
+    // 超出每序列缓存容量时扫描全表
+    auto aapl = table->queryLatestPerSeries(3, {{"symbol", "AAPL"}});
+    ASSERT_EQ(aapl.size(), 3);
+    EXPECT_EQ(aapl[0].timestamp, 27000);
+    EXPECT_EQ(aapl[2].timestamp, 21000);
+    
+    auto latest = table->queryLatest(2);
+    ASSERT_EQ(latest.size(), 2);
+    EXPECT_EQ(latest[0].timestamp, 29000);
+    EXPECT_EQ(latest[1].timestamp, 28000);
+}
+
 TEST_F(StreamTableTest, CreateIndex) {
     EXPECT_TRUE(table->createIndex("symbol"));
     EXPECT_FALSE(table->createIndex("symbol")); // 重复创建
@@ -136,6 +211,305 @@ TEST_F(StreamTableTest, Clear) {
     EXPECT_TRUE(table->empty());
 }
 
+TEST_F(StreamTableTest, DropBefore) {
+    for (int i = 0; i < 10; i++) {
+        TimeSeriesData data(i * 1000, static_cast<double>(i));
+        table->insert(data);
+    }
+    
+    table->dropBefore(5000);
+    
+    auto results = table->query(TimeRange(0, 10000));
+    ASSERT_EQ(results.size(), 5);
+    EXPECT_EQ(results[0].timestamp, 5000);
+    EXPECT_EQ(table->count(TimeRange(0, 4999)), 0);
+}
+
+TEST_F(StreamTableTest, ConcurrentInsertAndQuery) {
+    constexpr int kWriters = 4;
+    constexpr int kPerWriter = 2000;
+    std::atomic<bool> done{false};
+    std::atomic<int> failures{0};
+    
+    // 查询不加锁：与写入并发时每次看到的都是有序且只增不减的快照
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 2; r++) {
+        readers.emplace_back([&]() {
+            size_t last_size = 0;
+            while (!done.load()) {
+                auto results = table->query(TimeRange(0, kWriters * kPerWriter));
+                if (results.size() < last_size) {
+                    failures++;
+                }
+                last_size = results.size();
+                for (size_t k = 1; k < results.size(); k++) {
+                    if (results[k - 1].timestamp >= results[k].timestamp) {
+                        failures++;
+                        break;
+                    }
+                }
+                table->count(TimeRange(0, kWriters * kPerWriter));
+                table->queryLatest(10);
+            }
+        });
+    }
+    
+    std::vector<std::thread> writers;
+    for (int w = 0; w < kWriters; w++) {
+        writers.emplace_back([&, w]() {
+            for (int i = 0; i < kPerWriter; i++) {
+                int64_t ts = static_cast<int64_t>(i) * kWriters + w;
+                table->insert(TimeSeriesData(ts, static_cast<double>(ts)));
+            }
+        });
+    }
+    for (auto& writer : writers) {
+        writer.join();
+    }
+    done = true;
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    
+    EXPECT_EQ(failures.load(), 0);
+    EXPECT_EQ(table->size(), static_cast<size_t>(kWriters * kPerWriter));
+    EXPECT_EQ(table->query(TimeRange(0, kWriters * kPerWriter)).size(),
+              static_cast<size_t>(kWriters * kPerWriter));
+}
+
+TEST(StreamTableRetentionTest, TtlHidesExpiredData) {
+    TableConfig config;
+    config.ttl = 3000;
+    StreamTable table("ttl_stream", config);
+    
+    for (int i = 0; i < 10; i++) {
+        table.insert(TimeSeriesData(i * 1000, static_cast<double>(i)));
+    }
+    
+    // 最新时间戳 9000，早于 6000 的数据过期
+    EXPECT_EQ(table.count(TimeRange(0, 10000)), 4);
+    EXPECT_EQ(table.queryLatest(100).size(), 4);
+}
+
+TEST(StreamTableLsmTest, QueriesReadFlushedData) {
+    const std::string dir = "./test_stream_lsm_data";
+    std::filesystem::remove_all(dir);
+    TableConfig config;
+    config.data_dir = dir;
+    config.partition_duration = 100;
+    
+    {
+        StreamTable table("lsm_stream", config);
+        // 两个序列共用时间戳
+        for (int i = 0; i < 100; i++) {
+            table.insert(TimeSeriesData(i * 10, static_cast<double>(i), {{"key", "a"}}));
+            table.insert(TimeSeriesData(i * 10, static_cast<double>(-i), {{"key", "b"}}));
+        }
+        ASSERT_TRUE(table.flush());
+        
+        // 新数据留在 MemTable；覆盖一条已 flush 的数据
+        for (int i = 100; i < 150; i++) {
+            table.insert(TimeSeriesData(i * 10, static_cast<double>(i), {{"key", "a"}}));
+        }
+        table.insert(TimeSeriesData(500, 1000.0, {{"key", "a"}}));
+        
+        auto results = table.query(TimeRange(0, 2000));
+        ASSERT_EQ(results.size(), 250u);
+        for (size_t i = 1; i < results.size(); i++) {
+            EXPECT_LE(results[i - 1].timestamp, results[i].timestamp);
+        }
+        
+        auto key_a = table.query(TimeRange(400, 600), {{"key", "a"}});
+        ASSERT_EQ(key_a.size(), 21u);
+        EXPECT_DOUBLE_EQ(key_a[10].as_double(), 1000.0);
+        EXPECT_EQ(table.count(TimeRange(0, 995)), 200u);
+        EXPECT_EQ(table.count(TimeRange(1000, 2000)), 50u);
+    }
+    
+    // 重新打开：历史数据从 SSTable 读出
+    {
+        StreamTable table("lsm_stream", config);
+        EXPECT_EQ(table.count(TimeRange(0, 2000)), 250u);
+        auto key_b = table.query(TimeRange(0, 2000), {{"key", "b"}});
+        ASSERT_EQ(key_b.size(), 100u);
+        EXPECT_DOUBLE_EQ(key_b.back().as_double(), -99.0);
+        
+        table.clear();
+        EXPECT_EQ(table.count(TimeRange(0, 2000)), 0u);
+    }
+    std::filesystem::remove_all(dir);
+}
+
+TEST(StreamTableLsmTest, BulkImportAndExport) {
+    const std::string dir = "./test_stream_bulk_data";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    
+    // 文件内乱序且含重复键：同一 (timestamp, tags) 以靠后的版本为准
+    std::vector<TimeSeriesData> points;
+    for (int i = 9999; i >= 0; i--) {
+        TimeSeriesData data(i * 10, static_cast<double>(i), {{"key", i % 2 ? "a" : "b"}});
+        data.fields["note"] = std::string("n") + std::to_string(i % 3);
+        points.push_back(std::move(data));
+    }
+    points.push_back(TimeSeriesData(50, 500.0, {{"key", "a"}}));
+    ASSERT_TRUE(write_bulk_file(dir + "/in.sblk", points));
+    
+    TableConfig config;
+    config.data_dir = dir + "/db";
+    config.memtable_size_bytes = 256 * 1024;  // 分多批写成 SSTable
+    config.enable_timestamp_index = true;
+    {
+        StreamTable table("bulk", config);
+        std::atomic<size_t> notified{0};
+        table.addInsertListener([&](const TimeSeriesData*, size_t count) { notified += count; });
+        
+        EXPECT_EQ(table.importFile(dir + "/in.sblk"), 10000u);
+        EXPECT_EQ(notified.load(), 10000u);
+        EXPECT_EQ(table.getStats().memtable_records, 0u);  // 未经过 MemTable
+        EXPECT_EQ(table.count(TimeRange(0, 100000)), 10000u);
+        
+        auto key_a = table.query(TimeRange(50, 50), {{"key", "a"}});
+        ASSERT_EQ(key_a.size(), 1u);
+        EXPECT_DOUBLE_EQ(key_a[0].as_double(), 500.0);
+        
+        // 导出再读回：与 query() 结果一致
+        EXPECT_EQ(table.exportFile(dir + "/out.sblk", TimeRange(1000, 1990), {{"key", "b"}}), 50u);
+        std::vector<TimeSeriesData> exported;
+        ASSERT_TRUE(read_bulk_file(dir + "/out.sblk", exported));
+        auto expected = table.query(TimeRange(1000, 1990), {{"key", "b"}});
+        ASSERT_EQ(exported.size(), expected.size());
+        for (size_t i = 0; i < exported.size(); i++) {
+            EXPECT_EQ(exported[i].timestamp, expected[i].timestamp);
+            EXPECT_EQ(exported[i].tags, expected[i].tags);
+            EXPECT_EQ(exported[i].fields, expected[i].fields);
+        }
+        
+        EXPECT_THROW(table.importFile(dir + "/missing.sblk"), std::runtime_error);
+    }
+    
+    // 导入的 SSTable 重新打开后仍在
+    {
+        StreamTable table("bulk", config);
+        EXPECT_EQ(table.count(TimeRange(0, 100000)), 10000u);
+    }
+    std::filesystem::remove_all(dir);
+}
+
+TEST(StreamTableLsmTest, BackgroundFlushKeepsEveryPoint) {
+    const std::string dir = "./test_stream_flush_data";
+    std::filesystem::remove_all(dir);
+    TableConfig config;
+    config.data_dir = dir;
+    config.memtable_size_bytes = 32 * 1024;          // 每个 MemTable 只容纳几百条
+    config.max_immutable_memtables = 1;
+    config.enable_wal = false;
+    
+    {
+        StreamTable table("flush_stream", config);
+        std::vector<TimeSeriesData> batch;
+        for (int i = 0; i < 4000; i++) {
+            batch.emplace_back(i, static_cast<double>(i), Tags{{"key", std::to_string(i % 4)}});
+        }
+        table.insertBatch({batch.begin(), batch.begin() + 2000});
+        for (int i = 2000; i < 4000; i++) {
+            table.insert(batch[i]);
+        }
+        
+        // 后台 flush 进行中查询也能看到全部数据
+        EXPECT_EQ(table.count(TimeRange(0, 3999)), 4000u);
+        ASSERT_TRUE(table.flush());
+        
+        auto stats = table.getStats();
+        EXPECT_EQ(stats.flush_queue_depth, 0u);
+        EXPECT_GT(stats.flush_count, 1u);
+        EXPECT_GE(stats.avg_flush_ms, 0.0);
+        
+        auto key_1 = table.query(TimeRange(0, 3999), {{"key", "1"}});
+        ASSERT_EQ(key_1.size(), 1000u);
+        EXPECT_EQ(key_1.front().timestamp, 1);
+        EXPECT_EQ(key_1.back().timestamp, 3997);
+    }
+    std::filesystem::remove_all(dir);
+}
+
+TEST(StreamTableLsmTest, LatestCacheWarmsAfterRestart) {
+    const std::string dir = "./test_stream_latest_data";
+    std::filesystem::remove_all(dir);
+    TableConfig config;
+    config.data_dir = dir;
+    config.latest_cache_size = 16;
+    
+    {
+        StreamTable table("latest_stream", config);
+        for (int i = 0; i < 100; i++) {
+            table.insert(TimeSeriesData(i, static_cast<double>(i), Tags{{"key", std::to_string(i % 4)}}));
+        }
+        ASSERT_TRUE(table.flush());
+    }
+    
+    // 重新打开时缓存为空，首次查询从 LSM-Tree 回填
+    {
+        StreamTable table("latest_stream", config);
+        table.insert(TimeSeriesData(50, -1.0, Tags{{"key", "9"}}));
+        
+        auto latest = table.queryLatest(5);
+        ASSERT_EQ(latest.size(), 5);
+        EXPECT_EQ(latest[0].timestamp, 99);
+        EXPECT_EQ(latest[4].timestamp, 95);
+        
+        auto current = table.queryLatestPerSeries();
+        ASSERT_EQ(current.size(), 5);
+        EXPECT_EQ(current[0].timestamp, 96);  // key=0
+        EXPECT_EQ(current[4].timestamp, 50);  // key=9，重启后写入
+        
+        // 超出缓存容量时扫描全表
+        EXPECT_EQ(table.queryLatest(40).back().timestamp, 60);
+    }
+    std::filesystem::remove_all(dir);
+}
+
+TEST(StreamTableLsmTest, CheckpointAndRestore) {
+    const std::string dir = "./test_stream_checkpoint_data";
+    std::filesystem::remove_all(dir);
+    TableConfig config;
+    config.data_dir = dir + "/table";
+    config.latest_cache_size = 16;
+    
+    {
+        StreamTable table("checkpoint_stream", config);
+        EXPECT_FALSE(StreamTable("memory_only").createCheckpoint(dir + "/memory"));
+        
+        for (int i = 0; i < 100; i++) {
+            table.insert(TimeSeriesData(i, static_cast<double>(i), Tags{{"key", std::to_string(i % 4)}}));
+        }
+        // 未 flush 的数据也进入 checkpoint
+        ASSERT_TRUE(table.createCheckpoint(dir + "/checkpoint"));
+        
+        for (int i = 100; i < 200; i++) {
+            table.insert(TimeSeriesData(i, -1.0, Tags{{"key", "9"}}));
+        }
+        table.insert(TimeSeriesData(10, -1.0, Tags{{"key", "2"}}));
+        ASSERT_EQ(table.count(TimeRange(0, 1000)), 200u);
+        
+        ASSERT_TRUE(table.restoreCheckpoint(dir + "/checkpoint"));
+        EXPECT_EQ(table.count(TimeRange(0, 1000)), 100u);
+        auto results = table.query(TimeRange(0, 1000), {{"key", "2"}});
+        ASSERT_EQ(results.size(), 25u);
+        EXPECT_DOUBLE_EQ(results[2].as_double(), 10.0);
+        
+        // 缓存随恢复失效，重新从 LSM-Tree 回填
+        auto latest = table.queryLatest(1);
+        ASSERT_EQ(latest.size(), 1u);
+        EXPECT_EQ(latest[0].timestamp, 99);
+        
+        // 恢复后可继续写入
+        table.insert(TimeSeriesData(100, 100.0, Tags{{"key", "0"}}));
+        EXPECT_EQ(table.count(TimeRange(0, 1000)), 101u);
+    }
+    std::filesystem::remove_all(dir);
+}
+
 // ========== JoinResultTable 测试 ==========
 
 class JoinResultTableTest : public ::testing::Test {
@@ -253,6 +627,125 @@ TEST_F(JoinResultTableTest, InsertSimpleResult) {
     EXPECT_EQ(table->size(), 1);
 }
 
+TEST_F(JoinResultTableTest, PayloadRoundTrip) {
+    std::vector<std::pair<TimeSeriesData, TimeSeriesData>> pairs;
+    for (int i = 0; i < 50; i++) {
+        TimeSeriesData left(1000 + i, static_cast<double>(i), Tags{{"stream", "S"}});
+        TimeSeriesData right(990 + 2 * i, std::vector<double>{0.5 * i, -1.0}, Tags{{"stream", "R"}});
+        right.fields["note"] = std::string("a\0b", 3);
+        right.fields["score"] = 0.25 * i;
+        left.fields["seq"] = i;
+        pairs.emplace_back(left, right);
+    }
+    
+    JoinResultTable::JoinRecord record;
+    record.window_id = 7;
+    record.timestamp = 2000;
+    record.join_count = pairs.size();
+    record.serializePayload(pairs);
+    ASSERT_FALSE(record.payload.empty());
+    
+    table->insertJoinResult(record);
+    auto results = table->queryByWindow(7);
+    ASSERT_EQ(results.size(), 1);
+    
+    auto decoded = results[0].deserializePayload();
+    ASSERT_EQ(decoded.size(), pairs.size());
+    for (size_t i = 0; i < pairs.size(); i++) {
+        EXPECT_EQ(decoded[i].first.timestamp, pairs[i].first.timestamp);
+        EXPECT_EQ(decoded[i].first.as_double(), pairs[i].first.as_double());
+        EXPECT_EQ(decoded[i].first.tags, pairs[i].first.tags);
+        EXPECT_EQ(decoded[i].first.fields, pairs[i].first.fields);
+        EXPECT_EQ(decoded[i].second.timestamp, pairs[i].second.timestamp);
+        EXPECT_EQ(decoded[i].second.as_vector(), pairs[i].second.as_vector());
+        EXPECT_EQ(decoded[i].second.tags, pairs[i].second.tags);
+        EXPECT_EQ(decoded[i].second.fields, pairs[i].second.fields);
+    }
+    
+    record.payload.resize(record.payload.size() / 2);
+    EXPECT_THROW(record.deserializePayload(), std::runtime_error);
+}
+
+TEST_F(JoinResultTableTest, MetricsRoundTrip) {
+    JoinResultTable::JoinRecord record;
+    record.window_id = 3;
+    record.timestamp = 3000;
+    record.join_count = 12345;
+    record.aqp_estimate = 12000.5;
+    record.selectivity = 0.125;
+    record.metrics.computation_time_ms = 7.25;
+    record.metrics.memory_used_bytes = 1ull << 33;
+    record.metrics.threads_used = 8;
+    record.metrics.cpu_usage_percent = 93.5;
+    record.metrics.used_aqp = true;
+    record.metrics.algorithm_type = "PAWJ";
+    record.error_message = "partial";
+    record.tags = {{"query_id", "q1"}};
+    table->insertJoinResult(record);
+    
+    auto results = table->queryByTags({{"query_id", "q1"}});
+    ASSERT_EQ(results.size(), 1);
+    const auto& r = results[0];
+    EXPECT_EQ(r.window_id, 3);
+    EXPECT_EQ(r.join_count, 12345);
+    EXPECT_EQ(r.aqp_estimate, 12000.5);
+    EXPECT_EQ(r.selectivity, 0.125);
+    EXPECT_EQ(r.metrics.computation_time_ms, 7.25);
+    EXPECT_EQ(r.metrics.memory_used_bytes, 1ull << 33);
+    EXPECT_EQ(r.metrics.threads_used, 8);
+    EXPECT_EQ(r.metrics.cpu_usage_percent, 93.5);
+    EXPECT_TRUE(r.metrics.used_aqp);
+    EXPECT_EQ(r.metrics.algorithm_type, "PAWJ");
+    EXPECT_EQ(r.error_message, "partial");
+    EXPECT_EQ(r.tags, (Tags{{"query_id", "q1"}}));
+    
+    // 同一窗口、时间戳与标签的记录覆盖旧版本
+    record.join_count = 1;
+    table->insertJoinResult(record);
+    EXPECT_EQ(table->size(), 1);
+    EXPECT_EQ(table->queryAggregateStats(TimeRange(0, 10000)).total_joins, 1);
+    EXPECT_EQ(table->getStats().error_count, 1);
+}
+
+TEST(JoinResultTableLsmTest, ReopenRebuildsColumns) {
+    const std::string dir = "./test_join_columns_data";
+    std::filesystem::remove_all(dir);
+    TableConfig config;
+    config.data_dir = dir;
+    
+    {
+        JoinResultTable table("join_columns", config);
+        for (int i = 1; i <= 20; i++) {
+            JoinResultTable::JoinRecord record;
+            record.window_id = i;
+            record.timestamp = i * 1000;
+            record.join_count = i;
+            record.metrics.used_aqp = (i % 2 == 0);
+            table.insertJoinResult(record);
+        }
+    }
+    
+    {
+        JoinResultTable table("join_columns", config);
+        EXPECT_EQ(table.size(), 20);
+        
+        auto stats = table.queryAggregateStats(TimeRange(5000, 10000));
+        EXPECT_EQ(stats.total_windows, 6);
+        EXPECT_EQ(stats.total_joins, 5 + 6 + 7 + 8 + 9 + 10);
+        EXPECT_EQ(stats.aqp_usage_count, 3);
+        
+        auto win = table.queryByWindow(12);
+        ASSERT_EQ(win.size(), 1);
+        EXPECT_EQ(win[0].join_count, 12);
+        
+        EXPECT_EQ(table.deleteOldResults(11000), 10);
+        EXPECT_EQ(table.size(), 10);
+        EXPECT_TRUE(table.queryByWindow(3).empty());
+        EXPECT_EQ(table.queryByWindow(15).size(), 1);
+    }
+    std::filesystem::remove_all(dir);
+}
+
 // ========== TableManager 测试 ==========
 
 class TableManagerTest : public ::testing::Test {
@@ -367,6 +860,50 @@ TEST_F(TableManagerTest, BatchOperations) {
     EXPECT_EQ(results["stream2"].size(), 5);
 }
 
+TEST_F(TableManagerTest, BatchOperationsReportPerTableErrors) {
+    manager->createPECJTables();
+    
+    // 线程池只有一个线程，调用线程也要参与执行
+    auto rm = core::createResourceManager();
+    core::ResourceRequest request;
+    request.requested_threads = 1;
+    manager->setWorkerPool(rm->allocate("table_manager", request));
+    
+    std::map<std::string, std::vector<TimeSeriesData>> batch_data;
+    for (int i = 0; i < 100; i++) {
+        TimeSeriesData data(i * 1000, static_cast<double>(i));
+        batch_data["stream_s"].push_back(data);
+        batch_data["stream_r"].push_back(data);
+        batch_data["missing"].push_back(data);
+        batch_data["join_results"].push_back(data);
+    }
+    
+    std::map<std::string, std::string> errors;
+    auto indices = manager->insertBatchToTables(batch_data, &errors);
+    
+    ASSERT_EQ(indices.size(), 2);
+    EXPECT_EQ(indices["stream_s"].front(), 0);
+    EXPECT_EQ(indices["stream_r"].back(), 99);
+    ASSERT_EQ(errors.size(), 2);
+    EXPECT_NE(errors["missing"].find("does not exist"), std::string::npos);
+    EXPECT_NE(errors["join_results"].find("not a StreamTable"), std::string::npos);
+    
+    std::map<std::string, TimeRange> queries;
+    queries["stream_s"] = TimeRange(0, 49999);
+    queries["stream_r"] = TimeRange(50000, 99999);
+    queries["missing"] = TimeRange(0, 99999);
+    
+    errors.clear();
+    auto results = manager->queryBatchFromTables(queries, &errors);
+    
+    EXPECT_EQ(results["stream_s"].size(), 50);
+    EXPECT_EQ(results["stream_r"].size(), 50);
+    EXPECT_EQ(results.count("missing"), 0);
+    EXPECT_EQ(errors.size(), 1);
+    
+    manager->setWorkerPool(nullptr);
+}
+
 TEST_F(TableManagerTest, GlobalStats) {
     manager->createPECJTables();
     
@@ -387,6 +924,204 @@ TEST_F(TableManagerTest, GlobalStats) {
     EXPECT_EQ(stats.table_sizes.size(), 3);
 }
 
+TEST(TableManagerCheckpointTest, CreateListRestoreDelete) {
+    const std::string dir = "./test_manager_checkpoint_data";
+    std::filesystem::remove_all(dir);
+    {
+        TableManager manager(dir, 0);
+        ASSERT_TRUE(manager.createStreamTable("a"));
+        ASSERT_TRUE(manager.createStreamTable("b"));
+        auto a = manager.getStreamTable("a");
+        auto b = manager.getStreamTable("b");
+        for (int i = 0; i < 50; i++) {
+            a->insert(TimeSeriesData(i, static_cast<double>(i)));
+            b->insert(TimeSeriesData(i, static_cast<double>(-i)));
+        }
+        ASSERT_TRUE(manager.createCheckpoint("cp1"));
+        EXPECT_FALSE(manager.createCheckpoint("cp1"));
+        EXPECT_FALSE(manager.createCheckpoint("../escape"));
+        
+        for (int i = 50; i < 80; i++) {
+            a->insert(TimeSeriesData(i, static_cast<double>(i)));
+        }
+        b->clear();
+        ASSERT_TRUE(manager.createStreamTable("c"));
+        manager.getStreamTable("c")->insert(TimeSeriesData(1, 1.0));
+        ASSERT_TRUE(manager.createCheckpoint("cp2"));
+        EXPECT_EQ(manager.listCheckpoints(), (std::vector<std::string>{"cp1", "cp2"}));
+        
+        // c 在 cp1 之后创建，恢复时被清空
+        ASSERT_TRUE(manager.restoreCheckpoint("cp1"));
+        EXPECT_EQ(a->count(TimeRange(0, 100)), 50u);
+        EXPECT_EQ(b->count(TimeRange(0, 100)), 50u);
+        EXPECT_EQ(manager.getStreamTable("c")->count(TimeRange(0, 100)), 0u);
+        
+        ASSERT_TRUE(manager.restoreCheckpoint("cp2"));
+        EXPECT_EQ(a->count(TimeRange(0, 100)), 80u);
+        EXPECT_EQ(b->count(TimeRange(0, 100)), 0u);
+        EXPECT_EQ(manager.getStreamTable("c")->count(TimeRange(0, 100)), 1u);
+        
+        // 删除 checkpoint 不影响表中仍在使用的文件
+        ASSERT_TRUE(manager.deleteCheckpoint("cp2"));
+        EXPECT_FALSE(manager.restoreCheckpoint("cp2"));
+        EXPECT_EQ(manager.listCheckpoints(), std::vector<std::string>{"cp1"});
+        EXPECT_EQ(a->count(TimeRange(0, 100)), 80u);
+    }
+    EXPECT_FALSE(TableManager("").createCheckpoint("cp"));
+    std::filesystem::remove_all(dir);
+}
+
+// ========== Rollup 测试 ==========
+
+class RollupTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        std::filesystem::remove_all(dir);
+        manager = std::make_unique<TableManager>(dir, 0);
+    }
+    
+    void TearDown() override {
+        manager.reset();
+        std::filesystem::remove_all(dir);
+    }
+    
+    const std::string dir = "./test_rollup_data";
+    std::unique_ptr<TableManager> manager;
+};
+
+TEST_F(RollupTest, MatchesRawAggregation) {
+    manager->createStreamTable("raw");
+    manager->createStreamTable("plain");
+    
+    RollupConfig rollup;
+    rollup.name = "raw_1s";
+    rollup.source_table = "raw";
+    rollup.bucket_width = 1000;
+    rollup.group_by = {"key"};
+    rollup.allowed_lateness = 500;
+    ASSERT_TRUE(manager->createRollup(rollup));
+    EXPECT_FALSE(manager->createRollup(rollup));  // 名称重复
+    
+    auto raw = manager->getStreamTable("raw");
+    auto plain = manager->getStreamTable("plain");
+    std::vector<TimeSeriesData> batch;
+    for (int i = 0; i < 1000; i++) {
+        batch.emplace_back(i * 10, static_cast<double>(i % 37), Tags{{"key", i % 2 ? "a" : "b"}});
+    }
+    // 水位线内的乱序数据照常计入
+    batch.emplace_back(9100, 100.0, Tags{{"key", "a"}});
+    raw->insertBatch(batch);
+    plain->insertBatch(batch);
+    raw->insert(TimeSeriesData(9995, 1.0, Tags{{"key", "b"}}));
+    plain->insert(TimeSeriesData(9995, 1.0, Tags{{"key", "b"}}));
+    
+    auto stats = manager->getRollup("raw_1s")->getStats();
+    EXPECT_EQ(stats.points, 1002u);
+    EXPECT_EQ(stats.late_dropped, 0u);
+    EXPECT_GT(stats.sealed_buckets, 0u);
+    
+    // 对齐与不对齐的范围、分组与过滤，结果都与源表上的计算一致
+    for (auto type : {AggregationType::AVG, AggregationType::MAX, AggregationType::FIRST,
+                      AggregationType::LAST, AggregationType::STDDEV}) {
+        for (auto [start, end] : {std::pair<int64_t, int64_t>{0, 9999}, {1234, 8765}}) {
+            QueryConfig config(TimeRange(start, end));
+            config.aggregation = type;
+            config.window_size = 2000;
+            config.group_by = {"key"};
+            auto expected = manager->query("plain", config);
+            auto actual = manager->query("raw", config);
+            ASSERT_EQ(actual.size(), expected.size());
+            for (size_t i = 0; i < actual.size(); i++) {
+                EXPECT_EQ(actual[i].timestamp, expected[i].timestamp);
+                EXPECT_EQ(actual[i].tags, expected[i].tags);
+                EXPECT_NEAR(actual[i].as_double(), expected[i].as_double(), 1e-9);
+            }
+        }
+    }
+    
+    // 落在已 seal 桶中的迟到数据被丢弃
+    raw->insert(TimeSeriesData(100, 5.0, Tags{{"key", "a"}}));
+    EXPECT_EQ(manager->getRollup("raw_1s")->getStats().late_dropped, 1u);
+}
+
+TEST_F(RollupTest, SketchAggregationsMergeAcrossBuckets) {
+    manager->createStreamTable("raw");
+    manager->createStreamTable("plain");
+    
+    RollupConfig rollup;
+    rollup.name = "raw_1s";
+    rollup.source_table = "raw";
+    rollup.bucket_width = 1000;
+    rollup.aggregations = {AggregationType::QUANTILE, AggregationType::DISTINCT};
+    ASSERT_TRUE(manager->createRollup(rollup));
+    
+    std::vector<TimeSeriesData> batch;
+    for (int i = 0; i < 10000; i++) {
+        batch.emplace_back(i, static_cast<double>((i * 37) % 1000));
+    }
+    manager->getStreamTable("raw")->insertBatch(batch);
+    manager->getStreamTable("plain")->insertBatch(batch);
+    
+    // 桶内草图合并到 4s 窗口，与源表上的计算一致（去重计数的寄存器完全相同）
+    QueryConfig config(TimeRange(0, 7999));
+    config.window_size = 4000;
+    config.aggregation = AggregationType::DISTINCT;
+    auto expected = manager->query("plain", config);
+    auto actual = manager->query("raw", config);
+    ASSERT_EQ(actual.size(), 2u);
+    ASSERT_EQ(expected.size(), 2u);
+    for (size_t i = 0; i < actual.size(); i++) {
+        EXPECT_EQ(actual[i].as_double(), expected[i].as_double());
+        EXPECT_NEAR(actual[i].as_double(), 1000.0, 50.0);
+    }
+    
+    config.aggregation = AggregationType::QUANTILE;
+    config.quantile = 0.99;
+    actual = manager->query("raw", config);
+    ASSERT_EQ(actual.size(), 2u);
+    for (const auto& point : actual) {
+        EXPECT_NEAR(point.as_double(), 990.0, 5.0);
+    }
+}
+
+TEST_F(RollupTest, PlannerReadsRollupForCoarseQueries) {
+    manager->createStreamTable("raw");
+    
+    RollupConfig rollup;
+    rollup.name = "raw_1s";
+    rollup.source_table = "raw";
+    rollup.bucket_width = 1000;
+    rollup.aggregations = {AggregationType::COUNT, AggregationType::SUM};
+    ASSERT_TRUE(manager->createRollup(rollup));
+    
+    auto raw = manager->getStreamTable("raw");
+    for (int i = 0; i < 10000; i++) {
+        raw->insert(TimeSeriesData(i, 1.0));
+    }
+    // 源表数据不再可见后，只有 rollup 还能回答
+    raw->dropBefore(20000);
+    
+    QueryConfig config(TimeRange(0, 7999));
+    config.aggregation = AggregationType::COUNT;
+    config.window_size = 4000;
+    auto result = manager->query("raw", config);
+    ASSERT_EQ(result.size(), 2u);
+    EXPECT_EQ(result[0].timestamp, 0);
+    EXPECT_DOUBLE_EQ(result[0].as_double(), 4000.0);
+    
+    // rollup 不支持的聚合、不是桶宽整数倍的窗口都回退到源表
+    config.aggregation = AggregationType::AVG;
+    EXPECT_TRUE(manager->query("raw", config).empty());
+    config.aggregation = AggregationType::COUNT;
+    config.window_size = 1500;
+    EXPECT_TRUE(manager->query("raw", config).empty());
+    
+    // 删除源表后 rollup 停止维护
+    EXPECT_TRUE(manager->dropTable("raw"));
+    EXPECT_EQ(manager->getRollup("raw_1s"), nullptr);
+    EXPECT_TRUE(manager->hasTable("raw_1s"));
+}
+
 // ========== 集成测试 ==========
 
 TEST(IntegrationTest, EndToEndWorkflow) {
@@ -1,5 +1,6 @@
 #include <gtest/gtest.h>
 #include "sage_tsdb/core/time_series_index.h"
+#include <atomic>
 #include <thread>
 
 using namespace sage_tsdb;
@@ -125,6 +126,90 @@ TEST_F(TimeSeriesIndexTest, OutOfOrderInserts) {
     }
 }
 
+TEST_F(TimeSeriesIndexTest, MultiTagQueryAfterOutOfOrderInserts) {
+    // Shuffled rows so sorting has to renumber every posting
+    std::vector<int> order;
+    for (int i = 0; i < 3000; ++i) {
+        order.push_back((i * 7919) % 3000);
+    }
+    for (int i : order) {
+        sage_tsdb::Tags tags;
+        tags["sensor_id"] = "sensor_0" + std::to_string(i % 3);
+        tags["region"] = (i % 2 == 0) ? "east" : "west";
+        index->add(TimeSeriesData(base_time + i * 1000, static_cast<double>(i), tags));
+    }
+    
+    TimeRange range{base_time + 100 * 1000, base_time + 2000 * 1000};
+    QueryConfig config(range);
+    config.filter_tags["sensor_id"] = "sensor_01";
+    config.filter_tags["region"] = "west";
+    auto results = index->query(config);
+    
+    // i % 6 == 1 for 100 <= i <= 2000
+    std::vector<double> expected;
+    for (int i = 100; i <= 2000; ++i) {
+        if (i % 6 == 1) expected.push_back(static_cast<double>(i));
+    }
+    ASSERT_EQ(results.size(), expected.size());
+    for (size_t i = 0; i < results.size(); ++i) {
+        EXPECT_EQ(results[i].as_double(), expected[i]);
+    }
+    
+    config.limit = 5;
+    EXPECT_EQ(index->query(config).size(), 5u);
+    config.filter_tags["region"] = "north";
+    EXPECT_TRUE(index->query(config).empty());
+}
+
+TEST_F(TimeSeriesIndexTest, LatePointsMergeWithoutResort) {
+    // Every tenth point arrives late; enough of them to trigger merges
+    std::vector<int> late;
+    for (int i = 0; i < 30000; ++i) {
+        if (i % 10 == 3) {
+            late.push_back(i);
+            continue;
+        }
+        sage_tsdb::Tags tags;
+        tags["sensor_id"] = (i % 2 == 0) ? "even" : "odd";
+        index->add(TimeSeriesData(base_time + i, static_cast<double>(i), tags));
+        if (i % 10 == 9) {
+            // Flush the pending late ones a little behind the head
+            for (int j : late) {
+                sage_tsdb::Tags late_tags;
+                late_tags["sensor_id"] = (j % 2 == 0) ? "even" : "odd";
+                index->add(TimeSeriesData(base_time + j, static_cast<double>(j), late_tags));
+            }
+            late.clear();
+        }
+        
+        if (i == 5009 || i == 29999) {
+            // Query while late points may still sit in the delta buffer
+            TimeRange range{base_time + 1000, base_time + i};
+            QueryConfig config(range);
+            config.limit = 0;
+            config.filter_tags["sensor_id"] = "odd";
+            auto results = index->query(config);
+            ASSERT_EQ(results.size(), static_cast<size_t>((i - 1000 + 1) / 2));
+            for (size_t k = 0; k < results.size(); ++k) {
+                ASSERT_EQ(results[k].timestamp, base_time + 1001 + 2 * static_cast<int64_t>(k));
+            }
+            
+            QueryConfig all(TimeRange{base_time, base_time + i});
+            all.limit = 0;
+            auto everything = index->query(all);
+            ASSERT_EQ(everything.size(), static_cast<size_t>(i + 1));
+            for (size_t k = 0; k < everything.size(); ++k) {
+                ASSERT_EQ(everything[k].timestamp, base_time + static_cast<int64_t>(k));
+            }
+        }
+    }
+    
+    EXPECT_EQ(index->size(), 30000u);
+    for (size_t k : {size_t(0), size_t(3), size_t(12345), size_t(29999)}) {
+        EXPECT_EQ(index->get(k).timestamp, base_time + static_cast<int64_t>(k));
+    }
+}
+
 TEST_F(TimeSeriesIndexTest, ConcurrentReads) {
     // Add initial data
     for (int i = 0; i < 100; ++i) {
@@ -154,6 +239,79 @@ TEST_F(TimeSeriesIndexTest, ConcurrentReads) {
     EXPECT_EQ(successful_reads, 10);
 }
 
+TEST_F(TimeSeriesIndexTest, ReadersSeeSnapshotsWhileWriting) {
+    // Enough points to seal several chunks; every 7th arrives late so the
+    // delta buffer is merged while readers are running
+    constexpr int kPoints = 5 * static_cast<int>(TimeSeriesIndex::kChunkRows);
+    std::atomic<bool> done{false};
+    std::atomic<int> failures{0};
+    
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; ++t) {
+        readers.emplace_back([&, t]() {
+            size_t last_count = 0;
+            while (!done.load()) {
+                QueryConfig config(TimeRange{base_time, base_time + kPoints});
+                config.limit = 0;
+                if (t % 2 == 1) {
+                    config.filter_tags["parity"] = "odd";
+                }
+                auto results = index->query(config);
+                // Points are only added: a later snapshot never has fewer
+                if (results.size() < last_count) {
+                    ++failures;
+                }
+                last_count = results.size();
+                for (size_t k = 0; k < results.size(); ++k) {
+                    const auto& point = results[k];
+                    bool ordered = k == 0 || results[k - 1].timestamp < point.timestamp;
+                    bool intact = point.as_double() == static_cast<double>(point.timestamp - base_time);
+                    bool tagged = t % 2 == 0 || point.tags.at("parity") == "odd";
+                    if (!ordered || !intact || !tagged) {
+                        ++failures;
+                        break;
+                    }
+                }
+                
+                config.aggregation = AggregationType::COUNT;
+                auto counts = index->query(config);
+                if (!counts.empty() && counts[0].as_double() < static_cast<double>(last_count)) {
+                    ++failures;
+                }
+            }
+        });
+    }
+    
+    std::vector<int> order;
+    order.reserve(kPoints);
+    for (int i = 0; i < kPoints; ++i) {
+        if (i % 7 == 3 && i + 20 < kPoints) {
+            continue;                       // Sent 20 points late
+        }
+        order.push_back(i);
+        if (i >= 20 && (i - 20) % 7 == 3) {
+            order.push_back(i - 20);
+        }
+    }
+    ASSERT_EQ(order.size(), static_cast<size_t>(kPoints));
+    for (int i : order) {
+        sage_tsdb::Tags tags;
+        tags["parity"] = (i % 2 == 0) ? "even" : "odd";
+        index->add(TimeSeriesData(base_time + i, static_cast<double>(i), tags));
+    }
+    done = true;
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    
+    EXPECT_EQ(failures.load(), 0);
+    EXPECT_EQ(index->size(), static_cast<size_t>(kPoints));
+    QueryConfig odd(TimeRange{base_time, base_time + kPoints});
+    odd.limit = 0;
+    odd.filter_tags["parity"] = "odd";
+    EXPECT_EQ(index->query(odd).size(), static_cast<size_t>(kPoints / 2));
+}
+
 TEST_F(TimeSeriesIndexTest, Clear) {
     // Add data
     for (int i = 0; i < 10; ++i) {
@@ -185,3 +343,277 @@ TEST_F(TimeSeriesIndexTest, Statistics) {
     // TimeSeriesIndex doesn't have get_stats, just verify size
     EXPECT_EQ(index->size(), 50);
 }
+
+TEST_F(TimeSeriesIndexTest, SharedCatalogStoresEachSeriesOnce) {
+    auto catalog = std::make_shared<SeriesCatalog>();
+    TimeSeriesIndex first(catalog);
+    TimeSeriesIndex second(catalog);
+    
+    for (int i = 0; i < 1000; ++i) {
+        Tags tags = {{"host", "h" + std::to_string(i % 4)}, {"key", std::to_string(i % 2)}};
+        // Every fifth point arrives late and goes through the delta buffer
+        int64_t ts = base_time + (i % 5 == 0 ? i - 3 : i) * 1000;
+        first.add(TimeSeriesData(ts, static_cast<double>(i), tags));
+        second.add(TimeSeriesData(ts, static_cast<double>(-i), tags));
+    }
+    EXPECT_EQ(catalog->size(), 4u);
+    
+    QueryConfig config(TimeRange{base_time, base_time + 1000 * 1000});
+    config.filter_tags = {{"host", "h2"}};
+    config.limit = 0;
+    auto results = first.query(config);
+    ASSERT_EQ(results.size(), 250u);
+    for (size_t i = 0; i < results.size(); ++i) {
+        EXPECT_EQ(results[i].tags.at("host"), "h2");
+        EXPECT_EQ(results[i].tags.at("key"), "0");
+        if (i > 0) {
+            EXPECT_LE(results[i - 1].timestamp, results[i].timestamp);
+        }
+    }
+    EXPECT_EQ(second.get(0).tags.at("host"), "h0");
+}
+
+TEST_F(TimeSeriesIndexTest, AggregationScansColumns) {
+    // Scalars, a vector point and late points, over two hosts
+    for (int i = 0; i < 2000; ++i) {
+        int64_t ts = base_time + (i % 10 == 9 ? i - 50 : i) * 1000;
+        Tags tags = {{"host", i % 2 == 0 ? "a" : "b"}};
+        if (i == 100) {
+            index->add(TimeSeriesData(ts, std::vector<double>{100.0, 7.0}, tags));
+        } else {
+            index->add(TimeSeriesData(ts, static_cast<double>(i), tags));
+        }
+    }
+    
+    QueryConfig config(TimeRange{base_time + 500 * 1000, base_time + 1500 * 1000});
+    config.limit = 0;
+    config.filter_tags = {{"host", "a"}};
+    auto points = index->query(config);
+    ASSERT_FALSE(points.empty());
+    
+    BlockSummary expected;
+    for (const auto& point : points) {
+        expected.add(point);
+    }
+    for (auto type : {AggregationType::SUM, AggregationType::COUNT, AggregationType::MIN,
+                      AggregationType::MAX, AggregationType::AVG, AggregationType::STDDEV,
+                      AggregationType::FIRST, AggregationType::LAST}) {
+        config.aggregation = type;
+        auto result = index->query(config);
+        ASSERT_EQ(result.size(), 1u);
+        EXPECT_EQ(result[0].timestamp, config.time_range.start_time);
+        EXPECT_EQ(result[0].tags.at("host"), "a");
+        EXPECT_NEAR(result[0].as_double(), expected.value(type), 1e-6);
+    }
+    
+    // Vector values survive the columnar layout
+    EXPECT_EQ(index->query(QueryConfig(TimeRange{base_time + 100000, base_time + 100000}))[0]
+                  .as_vector().size(), 2u);
+    
+    config.time_range = TimeRange{base_time - 10000000, base_time - 5000000};
+    EXPECT_TRUE(index->query(config).empty());
+}
+
+TEST_F(TimeSeriesIndexTest, WindowedAggregationPerGroup) {
+    // Two hosts, one point per second each, a few late arrivals
+    for (int i = 0; i < 600; ++i) {
+        int64_t second = i % 50 == 49 ? i - 30 : i;
+        for (std::string host : {"a", "b"}) {
+            Tags tags = {{"host", host}, {"dc", "x"}};
+            double value = host == "a" ? second : 1000 + second;
+            index->add(TimeSeriesData(base_time + second * 1000, value, tags));
+        }
+    }
+    
+    QueryConfig config(TimeRange{base_time, base_time + 600 * 1000 - 1});
+    config.aggregation = AggregationType::MAX;
+    config.window_size = 60 * 1000;
+    config.group_by = {"host"};
+    config.limit = 0;
+    auto results = index->query(config);
+    
+    // Windows are relative to the epoch, so the range spans 10 or 11
+    int64_t first_window = base_time - base_time % config.window_size;
+    size_t windows = static_cast<size_t>(
+        (base_time + 599 * 1000 - first_window) / config.window_size + 1);
+    ASSERT_EQ(results.size(), 2 * windows);
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto& point = results[i];
+        EXPECT_EQ(point.timestamp, first_window + static_cast<int64_t>(i / 2) * config.window_size);
+        EXPECT_EQ(point.tags.size(), 1u);
+        
+        // Reference: MAX of the raw points of this window and host
+        QueryConfig raw(TimeRange{point.timestamp, point.timestamp + config.window_size - 1},
+                        point.tags);
+        raw.limit = 0;
+        double expected = -1;
+        for (const auto& p : index->query(raw)) {
+            expected = std::max(expected, p.as_double());
+        }
+        EXPECT_EQ(point.as_double(), expected);
+    }
+    EXPECT_EQ(results[0].tags.at("host"), "a");
+    EXPECT_EQ(results[1].tags.at("host"), "b");
+    
+    // Ungrouped windows agree with the per-group counts
+    config.group_by.clear();
+    config.aggregation = AggregationType::COUNT;
+    auto counts = index->query(config);
+    ASSERT_EQ(counts.size(), windows);
+    double total = 0;
+    for (const auto& point : counts) {
+        total += point.as_double();
+    }
+    EXPECT_EQ(total, 1200.0);
+    
+    config.limit = 3;
+    EXPECT_EQ(index->query(config).size(), 3u);
+}
+
+TEST_F(TimeSeriesIndexTest, ResultViewReadsPointsInPlace) {
+    // Late points, vector values and fields, across several chunks
+    for (int i = 0; i < 5000; ++i) {
+        Tags tags = {{"host", i % 2 ? "a" : "b"}};
+        TimeSeriesData data(i * 10, static_cast<double>(i), tags);
+        if (i % 100 == 0) {
+            data.value = std::vector<double>{1.0 * i, 2.0 * i};
+            data.fields = {{"note", std::to_string(i)}};
+        }
+        index->add(data);
+    }
+    for (int i = 0; i < 20; ++i) {
+        index->add(TimeSeriesData(i * 100 + 5, -1.0 * i, {{"host", "b"}}));
+    }
+    
+    QueryConfig config(TimeRange{0, 50000}, {{"host", "b"}});
+    config.limit = 0;
+    auto expected = index->query(config);
+    auto view = index->query_view(config);
+    ASSERT_EQ(view.size(), expected.size());
+    for (size_t i = 0; i < view.size(); ++i) {
+        auto point = view[i];
+        ASSERT_EQ(point.timestamp(), expected[i].timestamp);
+        EXPECT_EQ(point.as_double(), expected[i].as_double());
+        EXPECT_EQ(point.is_vector(), expected[i].is_array());
+        EXPECT_EQ(point.tags(), expected[i].tags);
+        EXPECT_EQ(point.fields(), expected[i].fields);
+        EXPECT_EQ(point.to_data().value, expected[i].value);
+    }
+    
+    // Writes, merges and clear() after the query leave the view as it was
+    for (int i = 0; i < 2000; ++i) {
+        index->add(TimeSeriesData(i, 0.0, {{"host", "a"}}));
+    }
+    index->clear();
+    index->add(TimeSeriesData(10, 1.0, {{"host", "b"}}));
+    auto copies = view.materialize();
+    ASSERT_EQ(copies.size(), expected.size());
+    size_t i = 0;
+    for (auto point : view) {
+        EXPECT_EQ(point.timestamp(), expected[i].timestamp);
+        EXPECT_EQ(copies[i].timestamp, expected[i].timestamp);
+        EXPECT_EQ(copies[i].value, expected[i].value);
+        ++i;
+    }
+    
+    // Aggregated results are owned by the view
+    config.aggregation = AggregationType::COUNT;
+    auto counts = index->query_view(config);
+    ASSERT_EQ(counts.size(), 1u);
+    EXPECT_EQ(counts[0].as_double(), 1.0);
+    EXPECT_EQ(counts[0].tags().at("host"), "b");
+}
+
+TEST_F(TimeSeriesIndexTest, SideColumnAddedToPublishedChunk) {
+    // Plain scalars first; the vector point arrives in the same chunk while
+    // a view of the scalars is held
+    for (int i = 0; i < 40; ++i) {
+        index->add(TimeSeriesData(i * 10, static_cast<double>(i)));
+    }
+    QueryConfig config(TimeRange{0, 100000});
+    config.limit = 0;
+    auto before = index->query_view(config);
+
+    TimeSeriesData vector_point(400, std::vector<double>{7.0, 8.0});
+    index->add(vector_point);
+    TimeSeriesData with_fields(410, 9.0);
+    with_fields.fields["unit"] = "ms";
+    index->add(with_fields);
+    for (int i = 0; i < 10; ++i) {
+        index->add(TimeSeriesData(i * 10 + 5, -1.0 * i));   // Late points
+    }
+    for (int i = 42; i < 1200; ++i) {
+        index->add(TimeSeriesData(i * 10, static_cast<double>(i)));
+    }
+
+    ASSERT_EQ(before.size(), 40u);
+    for (size_t i = 0; i < before.size(); ++i) {
+        EXPECT_FALSE(before[i].is_vector());
+        EXPECT_EQ(before[i].as_double(), static_cast<double>(i));
+    }
+
+    auto all = index->query(config);
+    ASSERT_EQ(all.size(), 1210u);
+    for (const auto& point : all) {
+        if (point.timestamp == 400) {
+            EXPECT_EQ(point.as_vector(), (std::vector<double>{7.0, 8.0}));
+        } else if (point.timestamp == 410) {
+            EXPECT_EQ(point.fields.at("unit").to_string(), "ms");
+        } else {
+            EXPECT_TRUE(point.is_scalar());
+            EXPECT_TRUE(point.fields.empty());
+        }
+    }
+}
+
+TEST_F(TimeSeriesIndexTest, ScalarIndexRejectsVectors) {
+    TimeSeriesIndex scalars(nullptr, true);
+    EXPECT_TRUE(scalars.scalar_values());
+    scalars.add(TimeSeriesData(1, 1.0));
+    EXPECT_THROW(scalars.add(TimeSeriesData(2, std::vector<double>{1.0, 2.0})),
+                 std::invalid_argument);
+    EXPECT_EQ(scalars.size(), 1u);
+}
+
+TEST_F(TimeSeriesIndexTest, ColumnsInAndOut) {
+    index->add(TimeSeriesData(base_time + 500, 0.5, {{"key", "9"}}));
+
+    // Two series as columns; the second run arrives partly late
+    std::vector<int64_t> timestamps;
+    std::vector<double> values;
+    for (int i = 0; i < 1000; ++i) {
+        timestamps.push_back(base_time + i * 10);
+        values.push_back(static_cast<double>(i));
+    }
+    EXPECT_EQ(index->add_columns(timestamps.data(), values.data(), 1000, {{"key", "1"}}), 1u);
+    EXPECT_EQ(index->add_columns(timestamps.data(), values.data(), 10, {{"key", "2"}}), 1001u);
+    EXPECT_EQ(index->add_columns(nullptr, nullptr, 0), 1011u);
+    EXPECT_EQ(index->size(), 1011u);
+
+    QueryConfig config(TimeRange(base_time, base_time + 99));
+    config.filter_tags = {{"key", "2"}};
+    auto view = index->query_view(config);
+    ASSERT_EQ(view.size(), 10u);
+    std::vector<int64_t> ts(view.size());
+    std::vector<double> vs(view.size());
+    view.copy_columns(ts.data(), vs.data());
+    for (size_t i = 0; i < ts.size(); ++i) {
+        EXPECT_EQ(ts[i], base_time + static_cast<int64_t>(i) * 10);
+        EXPECT_EQ(vs[i], static_cast<double>(i));
+        EXPECT_EQ(view[i].tags().at("key"), "2");
+    }
+
+    // Whole range: main run and late rows alike, in timestamp order
+    QueryConfig whole(TimeRange(base_time, base_time + 100000));
+    whole.limit = 0;
+    auto all = index->query_view(whole);
+    ASSERT_EQ(all.size(), 1011u);
+    std::vector<int64_t> all_ts(all.size());
+    std::vector<double> all_vs(all.size());
+    all.copy_columns(all_ts.data(), all_vs.data());
+    auto points = all.materialize();
+    for (size_t i = 0; i < points.size(); ++i) {
+        EXPECT_EQ(all_ts[i], points[i].timestamp);
+        EXPECT_EQ(all_vs[i], points[i].as_double());
+    }
+}
@@ -0,0 +1,150 @@
+// The macros are exercised whether or not the build compiles them in
+#ifndef SAGE_TSDB_ENABLE_TRACING
+#define SAGE_TSDB_ENABLE_TRACING
+#endif
+#include "sage_tsdb/core/trace.h"
+#include <gtest/gtest.h>
+#include <cstring>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace sage_tsdb {
+namespace test {
+
+class TraceTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        Tracer::instance().clear();
+        Tracer::instance().enable(true);
+    }
+
+    void TearDown() override {
+        Tracer::instance().enable(false);
+        Tracer::instance().clear();
+    }
+
+    static std::vector<TraceEvent> named(const char* name) {
+        std::vector<TraceEvent> events;
+        for (const auto& event : Tracer::instance().collect()) {
+            if (std::strcmp(event.name, name) == 0) {
+                events.push_back(event);
+            }
+        }
+        return events;
+    }
+};
+
+TEST_F(TraceTest, SpansRecordScopeAndArgument) {
+    {
+        SAGE_TSDB_TRACE_SCOPE_ARG("test", "outer", "window_id", 42);
+        SAGE_TSDB_TRACE_BEGIN(inner, "test", "inner");
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        SAGE_TSDB_TRACE_END(inner);
+        SAGE_TSDB_TRACE_END(inner);  // A second end() is a no-op
+    }
+
+    auto outer = named("outer");
+    auto inner = named("inner");
+    ASSERT_EQ(outer.size(), 1u);
+    ASSERT_EQ(inner.size(), 1u);
+    EXPECT_STREQ(outer[0].category, "test");
+    EXPECT_STREQ(outer[0].arg_name, "window_id");
+    EXPECT_EQ(outer[0].arg, 42u);
+    EXPECT_EQ(inner[0].arg_name, nullptr);
+    EXPECT_GE(inner[0].duration_ns, 2000000);
+    EXPECT_LE(outer[0].start_ns, inner[0].start_ns);
+    EXPECT_GE(outer[0].start_ns + outer[0].duration_ns, inner[0].start_ns + inner[0].duration_ns);
+    EXPECT_EQ(outer[0].tid, inner[0].tid);
+}
+
+TEST_F(TraceTest, DisabledTracerRecordsNothing) {
+    Tracer::instance().enable(false);
+    {
+        SAGE_TSDB_TRACE_SCOPE("test", "ignored");
+        SAGE_TSDB_TRACE_RECORD("test", "ignored", 1, 2, nullptr, 0);
+    }
+    EXPECT_EQ(SAGE_TSDB_TRACE_NOW(), 0);
+    EXPECT_TRUE(named("ignored").empty());
+
+    // A span open while tracing is switched on stays unrecorded
+    SAGE_TSDB_TRACE_BEGIN(late, "test", "ignored");
+    Tracer::instance().enable(true);
+    SAGE_TSDB_TRACE_END(late);
+    EXPECT_TRUE(named("ignored").empty());
+}
+
+TEST_F(TraceTest, RingKeepsNewestSpans) {
+    Tracer::instance().setBufferEvents(8);
+    std::thread writer([]() {
+        for (uint64_t i = 0; i < 20; ++i) {
+            Tracer::instance().record("test", "ring", static_cast<int64_t>(i) + 1,
+                                      static_cast<int64_t>(i) + 2, "i", i);
+        }
+    });
+    writer.join();
+    Tracer::instance().setBufferEvents(Tracer::kDefaultBufferEvents);
+
+    auto events = named("ring");
+    ASSERT_EQ(events.size(), 8u);
+    for (size_t i = 0; i < events.size(); ++i) {
+        EXPECT_EQ(events[i].arg, 12 + i);
+    }
+}
+
+TEST_F(TraceTest, ThreadsRecordIntoTheirOwnRings) {
+    constexpr int kThreads = 4;
+    constexpr int kSpans = 1000;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([]() {
+            for (int i = 0; i < kSpans; ++i) {
+                SAGE_TSDB_TRACE_SCOPE("test", "threaded");
+            }
+        });
+    }
+    // Collecting while threads record is allowed
+    for (int i = 0; i < 10; ++i) {
+        Tracer::instance().collect();
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    auto events = named("threaded");
+    EXPECT_EQ(events.size(), static_cast<size_t>(kThreads * kSpans));
+    std::set<uint32_t> tids;
+    for (size_t i = 0; i < events.size(); ++i) {
+        tids.insert(events[i].tid);
+        if (i > 0) {
+            EXPECT_LE(events[i - 1].start_ns, events[i].start_ns);
+        }
+    }
+    EXPECT_EQ(tids.size(), static_cast<size_t>(kThreads));
+
+    // Rings of exited threads go with clear()
+    Tracer::instance().clear();
+    EXPECT_TRUE(named("threaded").empty());
+}
+
+TEST_F(TraceTest, ChromeTraceJson) {
+    Tracer::instance().setThreadName("main \"test\"");
+    int64_t start = Tracer::nowNs();
+    SAGE_TSDB_TRACE_RECORD("compute", "window.queued", start, start + 1500, "window_id", 7);
+
+    std::ostringstream out;
+    Tracer::instance().writeChromeTrace(out);
+    std::string json = out.str();
+    EXPECT_EQ(json.rfind("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", 0), 0u) << json;
+    EXPECT_NE(json.find("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"),
+              std::string::npos);
+    EXPECT_NE(json.find("\"args\":{\"name\":\"main \\\"test\\\"\"}"), std::string::npos) << json;
+    EXPECT_NE(json.find("{\"name\":\"window.queued\",\"cat\":\"compute\",\"ph\":\"X\""),
+              std::string::npos) << json;
+    EXPECT_NE(json.find("\"dur\":1.500,\"args\":{\"window_id\":7}}"), std::string::npos) << json;
+    EXPECT_EQ(json.substr(json.size() - 4), "\n]}\n");
+}
+
+} // namespace test
+} // namespace sage_tsdb
@@ -211,3 +211,203 @@ TEST_F(WindowAggregatorTest, MultipleProcessCalls) {
     EXPECT_GT(results2.size(), 0);
 }
 
+
+TEST_F(WindowAggregatorTest, StreamingSlidingMatchesBatch) {
+    // Values go up and down so min/max must survive evictions
+    std::vector<TimeSeriesData> data;
+    for (int i = 0; i < 200; ++i) {
+        double value = static_cast<double>((i * 37) % 101) - 50.0;
+        data.emplace_back(base_time + i * 700, value);
+    }
+    
+    for (const char* aggregation : {"min", "max", "sum", "count", "stddev", "first", "last"}) {
+        AlgorithmConfig config;
+        config["window_type"] = "sliding";
+        config["window_size"] = "10000";
+        config["slide_interval"] = "3000";
+        config["aggregation"] = aggregation;
+        WindowAggregator batch(config);
+        WindowAggregator stream(config);
+        
+        auto expected = batch.process(data);
+        for (const auto& point : data) {
+            stream.push(point);
+        }
+        std::vector<TimeSeriesData> results = stream.flush();
+        
+        ASSERT_EQ(results.size(), expected.size()) << aggregation;
+        for (size_t i = 0; i < results.size(); ++i) {
+            EXPECT_EQ(results[i].timestamp, expected[i].timestamp);
+            EXPECT_NEAR(results[i].as_double(), expected[i].as_double(), 1e-9) << aggregation;
+            
+            // Brute force over the window
+            int64_t start = results[i].timestamp;
+            double min = 1e9, max = -1e9;
+            int count = 0;
+            for (const auto& point : data) {
+                if (point.timestamp >= start && point.timestamp < start + 10000) {
+                    min = std::min(min, point.as_double());
+                    max = std::max(max, point.as_double());
+                    ++count;
+                }
+            }
+            if (std::string(aggregation) == "min") {
+                EXPECT_DOUBLE_EQ(results[i].as_double(), min);
+            }
+            if (std::string(aggregation) == "max") {
+                EXPECT_DOUBLE_EQ(results[i].as_double(), max);
+            }
+            EXPECT_EQ(results[i].fields.at("window_size").as_int64(), count);
+        }
+    }
+}
+
+TEST_F(WindowAggregatorTest, WatermarkClosesWindows) {
+    AlgorithmConfig config;
+    config["window_type"] = "tumbling";
+    config["window_size"] = "5000";
+    config["aggregation"] = "sum";
+    WindowAggregator agg(config);
+    
+    for (const auto& point : create_data(3, 1000000)) {
+        agg.push(point);
+    }
+    EXPECT_TRUE(agg.advance_watermark(1004999).empty());
+    auto closed = agg.advance_watermark(1005000);
+    ASSERT_EQ(closed.size(), 1);
+    EXPECT_EQ(closed[0].timestamp, 1000000);
+    EXPECT_DOUBLE_EQ(closed[0].as_double(), 6.0);
+    EXPECT_TRUE(agg.flush().empty());
+}
+
+TEST_F(WindowAggregatorTest, WatermarkClosesSession) {
+    AlgorithmConfig config;
+    config["window_type"] = "session";
+    config["session_gap"] = "2000";
+    config["aggregation"] = "count";
+    WindowAggregator agg(config);
+    
+    agg.push(TimeSeriesData(base_time, 1.0));
+    agg.push(TimeSeriesData(base_time + 1500, 2.0));
+    // A point at last + gap could still join
+    EXPECT_TRUE(agg.advance_watermark(base_time + 3500).empty());
+    auto closed = agg.advance_watermark(base_time + 3501);
+    ASSERT_EQ(closed.size(), 1);
+    EXPECT_EQ(closed[0].timestamp, base_time);
+    EXPECT_DOUBLE_EQ(closed[0].as_double(), 2.0);
+}
+
+TEST_F(WindowAggregatorTest, LatePointsDropped) {
+    AlgorithmConfig config;
+    config["window_type"] = "tumbling";
+    config["window_size"] = "5000";
+    config["aggregation"] = "count";
+    WindowAggregator agg(config);
+    
+    agg.push(TimeSeriesData(base_time + 2000, 1.0));
+    agg.push(TimeSeriesData(base_time + 1000, 1.0));   // Out of order, ahead of the watermark
+    EXPECT_TRUE(agg.advance_watermark(base_time + 3000).empty());
+    agg.push(TimeSeriesData(base_time + 2500, 1.0));   // Behind the watermark
+    auto results = agg.flush();
+    
+    ASSERT_EQ(results.size(), 1);
+    EXPECT_DOUBLE_EQ(results[0].as_double(), 2.0);
+    EXPECT_EQ(agg.get_stats().at("late_points"), 1);
+}
+
+TEST_F(WindowAggregatorTest, ReorderedPointsWaitForWatermark) {
+    // Points arrive up to 3 positions (2100 ms) out of order, the
+    // watermark trails the newest point by 3000 ms
+    std::vector<TimeSeriesData> data;
+    for (int i = 0; i < 120; ++i) {
+        data.push_back(TimeSeriesData(base_time + i * 700, static_cast<double>((i * 37) % 101)));
+    }
+    std::vector<TimeSeriesData> arrival = data;
+    for (size_t i = 0; i + 3 < arrival.size(); i += 4) {
+        std::swap(arrival[i], arrival[i + 3]);
+    }
+    
+    for (const char* type : {"tumbling", "sliding", "session"}) {
+        for (const char* aggregation : {"sum", "first", "last", "max"}) {
+            AlgorithmConfig config;
+            config["window_type"] = type;
+            config["window_size"] = "5000";
+            config["slide_interval"] = "2000";
+            config["session_gap"] = "600";
+            config["aggregation"] = aggregation;
+            WindowAggregator batch(config);
+            WindowAggregator stream(config);
+            
+            auto expected = batch.process(data);
+            std::vector<TimeSeriesData> results;
+            int64_t newest = INT64_MIN;
+            for (const auto& point : arrival) {
+                stream.push(point);
+                newest = std::max(newest, point.timestamp);
+                auto closed = stream.advance_watermark(newest - 3000);
+                results.insert(results.end(), closed.begin(), closed.end());
+            }
+            EXPECT_GT(results.size(), 0u) << type;
+            EXPECT_GT(stream.get_stats().at("buffered_points"), 0);
+            auto rest = stream.flush();
+            results.insert(results.end(), rest.begin(), rest.end());
+            
+            EXPECT_EQ(stream.get_stats().at("late_points"), 0) << type;
+            EXPECT_EQ(stream.get_stats().at("buffered_points"), 0);
+            ASSERT_EQ(results.size(), expected.size()) << type << " " << aggregation;
+            for (size_t i = 0; i < results.size(); ++i) {
+                EXPECT_EQ(results[i].timestamp, expected[i].timestamp);
+                EXPECT_DOUBLE_EQ(results[i].as_double(), expected[i].as_double())
+                    << type << " " << aggregation << " window " << i;
+            }
+        }
+    }
+}
+
+TEST_F(WindowAggregatorTest, UnsortedBatch) {
+    AlgorithmConfig config;
+    config["window_type"] = "session";
+    config["session_gap"] = "1500";
+    config["aggregation"] = "sum";
+    WindowAggregator agg(config);
+    
+    auto data = create_data(6, base_time);
+    std::swap(data[0], data[4]);
+    data.push_back(TimeSeriesData(base_time + 20000, 100.0));
+    auto results = agg.process(data);
+    
+    ASSERT_EQ(results.size(), 2);
+    EXPECT_DOUBLE_EQ(results[0].as_double(), 21.0);
+    EXPECT_DOUBLE_EQ(results[1].as_double(), 100.0);
+    EXPECT_EQ(agg.get_stats().at("late_points"), 0);
+}
+
+TEST_F(WindowAggregatorTest, SketchAggregations) {
+    for (const char* type : {"tumbling", "sliding", "session"}) {
+        // Each aggregator gets its own fully built config
+        auto make_config = [type](const char* aggregation) {
+            AlgorithmConfig config;
+            config["window_type"] = type;
+            config["window_size"] = "100000";
+            config["slide_interval"] = "50000";
+            config["session_gap"] = "100000";
+            config["aggregation"] = aggregation;
+            return config;
+        };
+        WindowAggregator quantile(make_config("p99"));
+        WindowAggregator distinct(make_config("distinct"));
+        
+        // 100 points per window start, values 0..99 twice over
+        std::vector<TimeSeriesData> data;
+        data.reserve(200);
+        for (int i = 0; i < 200; ++i) {
+            data.emplace_back(i * 500, static_cast<double>(i % 100));
+        }
+        auto q = quantile.process(data);
+        auto d = distinct.process(data);
+        ASSERT_FALSE(q.empty()) << type;
+        ASSERT_EQ(q.size(), d.size());
+        EXPECT_NEAR(q[0].as_double(), 98.0, 1.5) << type;
+        EXPECT_NEAR(d[0].as_double(), 100.0, 3.0) << type;
+    }
+}
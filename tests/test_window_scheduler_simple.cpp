@@ -9,13 +9,23 @@
 
 #include "sage_tsdb/compute/window_scheduler.h"
 #include "sage_tsdb/compute/pecj_compute_engine.h"
+#include "sage_tsdb/core/resource_manager.h"
+#include "sage_tsdb/core/join_result_table.h"
+#include "sage_tsdb/core/stream_table.h"
+#include "sage_tsdb/core/table_manager.h"
+#include "sage_tsdb/core/time_series_db.h"
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <mutex>
+#include <thread>
 
 using namespace sage_tsdb;
 using namespace sage_tsdb::compute;
 
 // Test TimeRange operations
 TEST(TimeRangeTest, BasicOperations) {
-    TimeRange range(1000000, 2000000);
+    compute::TimeRange range(1000000, 2000000);
     
     // Test contains
     EXPECT_TRUE(range.contains(1500000));
@@ -30,7 +40,7 @@ TEST(TimeRangeTest, BasicOperations) {
     // Test valid
     EXPECT_TRUE(range.valid());
     
-    TimeRange invalid_range(2000000, 1000000);
+    compute::TimeRange invalid_range(2000000, 1000000);
     EXPECT_FALSE(invalid_range.valid());
 }
 
@@ -67,6 +77,298 @@ TEST(SchedulingMetricsTest, Initialization) {
     EXPECT_EQ(metrics.active_windows, 0);
 }
 
+// Scheduler wired to a stub engine, with a polling interval far longer
+// than any wait below: windows can only fire through notifications
+class WindowSchedulerTriggerTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        std::filesystem::remove_all(kDataDir);
+        tables_ = std::make_unique<TableManager>(kDataDir, 0);
+        tables_->createStreamTable("stream_s");
+        tables_->createStreamTable("stream_r");
+        
+        db_.createTable("stream_s");
+        db_.createTable("stream_r");
+        resources_ = core::createResourceManager();
+        core::ResourceRequest request;
+        request.requested_threads = 1;
+        handle_ = resources_->allocate("window_scheduler_test", request);
+        ASSERT_NE(handle_, nullptr);
+        
+        ComputeConfig compute_config;
+        ASSERT_TRUE(engine_.initialize(compute_config, &db_, handle_.get()));
+    }
+    
+    void TearDown() override {
+        scheduler_.reset();
+        handle_.reset();
+        tables_.reset();
+        std::filesystem::remove_all(kDataDir);
+    }
+    
+    void startScheduler(WindowSchedulerConfig config,
+                        std::chrono::milliseconds callback_delay = std::chrono::milliseconds(0),
+                        PECJComputeEngine* engine = nullptr) {
+        config.trigger_interval_us = 60ULL * 1000 * 1000;
+        scheduler_ = std::make_unique<WindowScheduler>(config, engine ? engine : &engine_,
+                                                       tables_.get(), handle_.get());
+        scheduler_->onWindowCompleted([this, callback_delay](const WindowInfo&, const ComputeStatus& status) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                completed_++;
+                statuses_.push_back(status);
+                cv_.notify_all();
+            }
+            // Holds the window's concurrency slot, delaying queued windows
+            std::this_thread::sleep_for(callback_delay);
+        });
+        ASSERT_TRUE(scheduler_->start());
+    }
+    
+    bool waitCompleted(size_t count) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return cv_.wait_for(lock, std::chrono::seconds(5), [&]() { return completed_ >= count; });
+    }
+    
+    static constexpr const char* kDataDir = "/tmp/test_window_scheduler";
+    std::unique_ptr<TableManager> tables_;
+    TimeSeriesDB db_;
+    std::shared_ptr<core::ResourceManager> resources_;
+    std::shared_ptr<core::ResourceHandle> handle_;
+    PECJComputeEngine engine_;
+    std::unique_ptr<WindowScheduler> scheduler_;
+    
+    // S tuples of key 1 from ts on, in both the scheduler's table and the engine's db
+    void insertStreamS(int64_t ts, size_t count) {
+        std::vector<TimeSeriesData> batch(count);
+        for (size_t i = 0; i < count; ++i) {
+            batch[i].timestamp = ts + static_cast<int64_t>(i) * 1000;
+            batch[i].tags["key"] = "1";
+            batch[i].value = 1.0;
+            db_.insert("stream_s", batch[i]);
+        }
+        tables_->getStreamTable("stream_s")->insertBatch(batch);
+    }
+    
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    size_t completed_ = 0;
+    std::vector<ComputeStatus> statuses_;
+};
+
+TEST_F(WindowSchedulerTriggerTest, WatchedTableInsertTriggersCountWindow) {
+    WindowSchedulerConfig config;
+    config.window_type = WindowType::Tumbling;
+    config.trigger_policy = TriggerPolicy::CountBased;
+    config.trigger_count_threshold = 10;
+    startScheduler(config);
+    scheduler_->watchTable("stream_s", 0);
+    
+    auto table = tables_->getStreamTable("stream_s");
+    std::vector<TimeSeriesData> batch(10);
+    for (size_t i = 0; i < batch.size(); ++i) {
+        batch[i].timestamp = 1000000 + static_cast<int64_t>(i) * 1000;
+        batch[i].value = 1.0;
+    }
+    table->insertBatch(batch);
+    
+    ASSERT_TRUE(waitCompleted(1));
+    auto metrics = scheduler_->getMetrics();
+    EXPECT_EQ(metrics.total_windows_scheduled, 1u);
+    EXPECT_LT(metrics.avg_scheduling_latency_ms, 50.0);
+    EXPECT_LT(metrics.p99_scheduling_latency_ms, 50.0);
+    // The batch's insert time to the window result
+    EXPECT_GT(metrics.p99_end_to_end_latency_ms, 0.0);
+    EXPECT_LE(metrics.p50_end_to_end_latency_ms, metrics.p99_end_to_end_latency_ms);
+    EXPECT_GE(metrics.p99_end_to_end_latency_ms, metrics.avg_window_completion_ms);
+    scheduler_->stop();
+}
+
+TEST_F(WindowSchedulerTriggerTest, EngineMetricsAreExported) {
+    PECJComputeEngine engine;
+    ComputeConfig compute_config;
+    compute_config.enable_simd = true;  // Exact joins without the PECJ library
+    ASSERT_TRUE(engine.initialize(compute_config, &db_, handle_.get()));
+    
+    WindowSchedulerConfig config;
+    config.window_type = WindowType::Tumbling;
+    config.trigger_policy = TriggerPolicy::CountBased;
+    config.trigger_count_threshold = 10;
+    config.enable_adaptive_scheduling = false;
+    startScheduler(config, std::chrono::milliseconds(0), &engine);
+    scheduler_->watchTable("stream_s", 0);
+    
+    for (int i = 0; i < 10; ++i) {
+        TimeSeriesData r;
+        r.timestamp = 1500000 + i;
+        r.tags["key"] = "1";
+        r.value = 1.0;
+        db_.insert("stream_r", r);
+    }
+    insertStreamS(1000000, 10);
+    ASSERT_TRUE(waitCompleted(1));
+    scheduler_->stop();
+    
+    // The engine's counters sit in the TableManager's registry, labelled like the scheduler's
+    auto registry = tables_->getMetricsRegistry();
+    const Tags labels{{"stream_s", config.stream_s_table}, {"stream_r", config.stream_r_table}};
+    auto engine_metrics = engine.getMetrics();
+    double value = 0;
+    ASSERT_TRUE(registry->read("sage_tsdb_compute_windows_completed_total", labels, value));
+    EXPECT_EQ(value, static_cast<double>(engine_metrics.total_windows_completed));
+    EXPECT_GE(value, 1.0);
+    ASSERT_TRUE(registry->read("sage_tsdb_compute_tuples_processed_total", labels, value));
+    EXPECT_EQ(value, static_cast<double>(engine_metrics.total_tuples_processed));
+    EXPECT_EQ(value, 20.0);
+    ASSERT_TRUE(registry->read("sage_tsdb_compute_sample_rate", labels, value));
+    EXPECT_EQ(value, 1.0);
+    EXPECT_NE(registry->exportPrometheus().find("sage_tsdb_compute_window_seconds_count"),
+              std::string::npos);
+    
+    // and leave with the scheduler
+    scheduler_.reset();
+    EXPECT_FALSE(registry->read("sage_tsdb_compute_windows_completed_total", labels, value));
+}
+
+TEST_F(WindowSchedulerTriggerTest, WatermarkAdvanceTriggersWindow) {
+    WindowSchedulerConfig config;
+    config.window_type = WindowType::Tumbling;
+    config.trigger_policy = TriggerPolicy::Watermark;
+    config.watermark_slack_us = 1000;
+    startScheduler(config);
+    
+    scheduler_->onDataInserted("stream_s", 1500000);  // Window [1000000, 2000000)
+    EXPECT_EQ(scheduler_->getPendingWindowCount(), 0u);
+    
+    // Just short of end + slack: nothing fires
+    scheduler_->updateWatermark(2000999);
+    EXPECT_EQ(scheduler_->getPendingWindowCount(), 0u);
+    EXPECT_EQ(scheduler_->getMetrics().total_windows_scheduled, 0u);
+    
+    scheduler_->updateWatermark(2001000);
+    ASSERT_TRUE(waitCompleted(1));
+    scheduler_->stop();
+    EXPECT_EQ(scheduler_->getActiveWindowCount(), 0u);
+}
+
+TEST_F(WindowSchedulerTriggerTest, AdaptiveControllerReactsToLatency) {
+    WindowSchedulerConfig config;
+    config.trigger_policy = TriggerPolicy::Manual;
+    config.enable_adaptive_scheduling = false;  // Steps driven by the test
+    config.max_concurrent_windows = 1;
+    config.max_adaptive_windows = 2;
+    config.target_p99_latency_ms = 5.0;
+    config.trigger_count_threshold = 100;
+    startScheduler(config, std::chrono::milliseconds(30));
+    
+    for (uint64_t id = 1; id <= 6; ++id) {
+        int64_t start = static_cast<int64_t>(id) * 1000000;
+        ASSERT_TRUE(scheduler_->scheduleWindow(id, compute::TimeRange(start, start + 1000000)));
+    }
+    
+    // Window 2 waited ~30ms behind window 1 while others are still queued
+    ASSERT_TRUE(waitCompleted(2));
+    scheduler_->adapt();
+    auto metrics = scheduler_->getMetrics();
+    EXPECT_EQ(metrics.concurrency_limit, 2u);
+    EXPECT_EQ(metrics.adaptations, 1u);
+    EXPECT_NE(metrics.last_adaptation.find("concurrency 1 -> 2"), std::string::npos)
+        << metrics.last_adaptation;
+    
+    // Still over the SLO with nothing queued and concurrency at its ceiling
+    ASSERT_TRUE(waitCompleted(6));
+    scheduler_->stop();
+    scheduler_->adapt();
+    metrics = scheduler_->getMetrics();
+    EXPECT_TRUE(metrics.aqp_active) << metrics.last_adaptation;
+    EXPECT_DOUBLE_EQ(engine_.getSampleRate(), config.aqp_sample_rate);
+    
+    // No windows since: within the SLO, so shedding is undone
+    scheduler_->adapt();
+    metrics = scheduler_->getMetrics();
+    EXPECT_FALSE(metrics.aqp_active);
+    EXPECT_DOUBLE_EQ(engine_.getSampleRate(), 1.0);
+    EXPECT_EQ(metrics.count_threshold, 100u);
+    EXPECT_EQ(metrics.adaptations, 3u);
+}
+
+TEST_F(WindowSchedulerTriggerTest, LateTuplesCorrectCompletedWindow) {
+    tables_->createJoinResultTable("join_results");
+    PECJComputeEngine engine;
+    ComputeConfig compute_config;
+    compute_config.enable_simd = true;  // Exact joins without the PECJ library
+    compute_config.retain_late_state = true;
+    ASSERT_TRUE(engine.initialize(compute_config, &db_, handle_.get()));
+    
+    WindowSchedulerConfig config;
+    config.window_type = WindowType::Tumbling;
+    config.trigger_policy = TriggerPolicy::CountBased;
+    config.trigger_count_threshold = 10;
+    config.enable_adaptive_scheduling = false;
+    startScheduler(config, std::chrono::milliseconds(0), &engine);
+    scheduler_->watchTable("stream_s", 0);
+    
+    // R is only read by the engine
+    for (int i = 0; i < 10; ++i) {
+        TimeSeriesData r;
+        r.timestamp = 1500000 + i;
+        r.tags["key"] = "1";
+        r.value = 1.0;
+        db_.insert("stream_r", r);
+    }
+    insertStreamS(1000000, 10);
+    ASSERT_TRUE(waitCompleted(1));
+    
+    // Two tuples for the completed window: each pairs with the 10 R tuples
+    insertStreamS(1100000, 2);
+    ASSERT_TRUE(waitCompleted(2));
+    scheduler_->stop();
+    
+    std::lock_guard<std::mutex> lock(mutex_);
+    EXPECT_EQ(statuses_[0].join_count, 100u);
+    EXPECT_FALSE(statuses_[0].late_correction);
+    size_t corrected = 0;
+    for (size_t i = 1; i < statuses_.size(); ++i) {
+        EXPECT_TRUE(statuses_[i].late_correction);
+        corrected = statuses_[i].join_count;
+    }
+    EXPECT_EQ(corrected, 120u);
+    
+    auto metrics = scheduler_->getMetrics();
+    EXPECT_EQ(metrics.late_data_count, 2u);
+    EXPECT_GE(metrics.late_windows_corrected, 1u);
+    EXPECT_EQ(metrics.late_windows_recomputed, 0u);
+    EXPECT_TRUE(scheduler_->getWindowInfo(statuses_[0].window_id).has_late_data);
+    
+    auto records = tables_->getJoinResultTable("join_results")->queryByWindow(statuses_[0].window_id);
+    ASSERT_FALSE(records.empty());
+    EXPECT_EQ(records.back().join_count, 120u);
+    EXPECT_EQ(records.back().tags.at("correction"), "late");
+}
+
+TEST_F(WindowSchedulerTriggerTest, LateTuplesWithoutRetainedStateRecompute) {
+    WindowSchedulerConfig config;
+    config.window_type = WindowType::Tumbling;
+    config.trigger_policy = TriggerPolicy::CountBased;
+    config.trigger_count_threshold = 10;
+    config.enable_adaptive_scheduling = false;
+    startScheduler(config);
+    scheduler_->watchTable("stream_s", 0);
+    
+    insertStreamS(1000000, 10);
+    ASSERT_TRUE(waitCompleted(1));
+    insertStreamS(1100000, 1);
+    ASSERT_TRUE(waitCompleted(2));
+    scheduler_->stop();
+    
+    std::lock_guard<std::mutex> lock(mutex_);
+    EXPECT_FALSE(statuses_[1].late_correction);
+    EXPECT_EQ(statuses_[1].input_s_count, 11u);  // The window was read again
+    auto metrics = scheduler_->getMetrics();
+    EXPECT_EQ(metrics.late_windows_recomputed, 1u);
+    EXPECT_EQ(metrics.late_windows_corrected, 0u);
+}
+
 #endif // PECJ_MODE_INTEGRATED
 
 int main(int argc, char** argv) {
@@ -0,0 +1,352 @@
+#include "sage_tsdb/core/work_stealing_executor.h"
+#include "sage_tsdb/core/numa_topology.h"
+#include <gtest/gtest.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+namespace sage_tsdb {
+namespace test {
+
+using core::Task;
+using core::TaskQueue;
+using core::WorkStealingDeque;
+using core::WorkStealingExecutor;
+
+namespace {
+
+// Wait until pred() holds, for at most five seconds
+template <typename Pred>
+bool wait_for(Pred pred) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (!pred()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+}  // namespace
+
+TEST(TaskTest, RunsInlineAndHeapCallables) {
+    int calls = 0;
+    Task small([&calls]() { ++calls; });
+    Task moved = std::move(small);
+    EXPECT_FALSE(small);
+    ASSERT_TRUE(moved);
+    moved();
+    EXPECT_EQ(calls, 1);
+
+    // Larger than the inline buffer: stored on the heap, same behaviour
+    std::array<int, 32> big{};
+    big[31] = 41;
+    Task large([big, &calls]() { calls += big[31]; });
+    Task target;
+    target = std::move(large);
+    target();
+    EXPECT_EQ(calls, 42);
+
+    // Captured state is destroyed exactly once
+    auto token = std::make_shared<int>(0);
+    {
+        Task holder([token]() {});
+        Task other = std::move(holder);
+        EXPECT_EQ(token.use_count(), 2);
+    }
+    EXPECT_EQ(token.use_count(), 1);
+}
+
+TEST(WorkStealingDequeTest, OwnerIsLifoThievesAreFifo) {
+    WorkStealingDeque<int> deque(4);
+    std::array<int, 4> items{0, 1, 2, 3};
+    for (auto& item : items) {
+        ASSERT_TRUE(deque.push(&item));
+    }
+    EXPECT_FALSE(deque.push(&items[0]));  // Full
+
+    EXPECT_EQ(deque.steal(), &items[0]);
+    EXPECT_EQ(deque.pop(), &items[3]);
+    EXPECT_EQ(deque.steal(), &items[1]);
+    EXPECT_EQ(deque.pop(), &items[2]);
+    EXPECT_EQ(deque.pop(), nullptr);
+    EXPECT_EQ(deque.steal(), nullptr);
+    EXPECT_TRUE(deque.empty());
+}
+
+TEST(WorkStealingDequeTest, ConcurrentStealsTakeEachItemOnce) {
+    constexpr int kItems = 20000;
+    WorkStealingDeque<int> deque(256);
+    std::vector<int> items(kItems);
+    std::atomic<int> taken{0};
+    std::vector<std::atomic<int>> seen(kItems);
+    std::atomic<bool> done{false};
+
+    std::vector<std::thread> thieves;
+    for (int t = 0; t < 3; ++t) {
+        thieves.emplace_back([&]() {
+            while (!done.load() || !deque.empty()) {
+                if (int* item = deque.steal()) {
+                    seen[item - items.data()].fetch_add(1);
+                    taken.fetch_add(1);
+                }
+            }
+        });
+    }
+
+    for (int i = 0; i < kItems; ++i) {
+        while (!deque.push(&items[i])) {
+            if (int* item = deque.pop()) {
+                seen[item - items.data()].fetch_add(1);
+                taken.fetch_add(1);
+            }
+        }
+    }
+    while (int* item = deque.pop()) {
+        seen[item - items.data()].fetch_add(1);
+        taken.fetch_add(1);
+    }
+    done.store(true);
+    for (auto& thief : thieves) {
+        thief.join();
+    }
+
+    EXPECT_EQ(taken.load(), kItems);
+    for (int i = 0; i < kItems; ++i) {
+        ASSERT_EQ(seen[i].load(), 1) << "item " << i;
+    }
+}
+
+TEST(WorkStealingExecutorTest, RunsSubmittedAndNestedTasks) {
+    WorkStealingExecutor executor(4);
+    auto queue = executor.create_queue(0, 4);
+
+    constexpr int kParents = 100;
+    constexpr int kChildren = 10;
+    std::atomic<int> done{0};
+    for (int i = 0; i < kParents; ++i) {
+        ASSERT_TRUE(executor.submit(queue, [&executor, queue, &done]() {
+            // Children go to this worker's deque and may be stolen
+            for (int j = 0; j < kChildren; ++j) {
+                executor.submit(queue, [&done]() { done.fetch_add(1); });
+            }
+            done.fetch_add(1);
+        }));
+    }
+
+    EXPECT_TRUE(wait_for([&]() { return done.load() == kParents * (kChildren + 1); }));
+    EXPECT_TRUE(wait_for([&]() { return queue->pending() == 0; }));
+}
+
+TEST(WorkStealingExecutorTest, NodeQueuesRunOnlyOnTheirNodeWorkers) {
+    const auto& node = core::NumaTopology::system().nodes().front();
+    WorkStealingExecutor executor(2);
+    executor.ensure_workers(2, node.id, node.cpus);
+    EXPECT_EQ(executor.worker_count(), 4u);
+    EXPECT_EQ(executor.worker_count(node.id), 2u);
+    auto bound = executor.create_queue(0, 2, node.id);
+    auto unbound = executor.create_queue(0, 2);
+    EXPECT_EQ(bound->node(), node.id);
+    EXPECT_EQ(unbound->node(), -1);
+
+    std::mutex mutex;
+    std::set<std::thread::id> bound_threads;
+    std::set<std::thread::id> unbound_threads;
+    std::atomic<int> done{0};
+    auto record = [&](std::set<std::thread::id>& threads) {
+        std::lock_guard<std::mutex> lock(mutex);
+        threads.insert(std::this_thread::get_id());
+    };
+    constexpr int kTasks = 200;
+    for (int i = 0; i < kTasks; ++i) {
+        // A bound task's follow-up on the unbound queue leaves the node
+        ASSERT_TRUE(executor.submit(bound, [&, unbound]() {
+            record(bound_threads);
+            executor.submit(unbound, [&]() {
+                record(unbound_threads);
+                done.fetch_add(1);
+            });
+            done.fetch_add(1);
+        }));
+    }
+
+    ASSERT_TRUE(wait_for([&]() { return done.load() == 2 * kTasks; }));
+    std::lock_guard<std::mutex> lock(mutex);
+    EXPECT_LE(bound_threads.size(), 2u);
+    EXPECT_LE(unbound_threads.size(), 2u);
+    for (const auto& id : bound_threads) {
+        EXPECT_EQ(unbound_threads.count(id), 0u);
+    }
+}
+
+TEST(WorkStealingExecutorTest, QuotaLimitsConcurrencyAndPendingIsExact) {
+    WorkStealingExecutor executor(4);
+    auto queue = executor.create_queue(0, 1);
+
+    std::atomic<bool> release{false};
+    std::atomic<int> running{0};
+    std::atomic<int> peak{0};
+    std::atomic<int> done{0};
+    for (int i = 0; i < 8; ++i) {
+        executor.submit(queue, [&]() {
+            int now = running.fetch_add(1) + 1;
+            int prev = peak.load();
+            while (now > prev && !peak.compare_exchange_weak(prev, now)) {}
+            while (!release.load()) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            running.fetch_sub(1);
+            done.fetch_add(1);
+        });
+    }
+
+    ASSERT_TRUE(wait_for([&]() { return running.load() == 1; }));
+    EXPECT_EQ(queue->running(), 1u);
+    EXPECT_EQ(queue->pending(), 7u);
+
+    release.store(true);
+    EXPECT_TRUE(wait_for([&]() { return done.load() == 8; }));
+    EXPECT_EQ(peak.load(), 1);
+    EXPECT_EQ(queue->pending(), 0u);
+}
+
+TEST(WorkStealingExecutorTest, HigherPriorityQueueIsServedFirst) {
+    WorkStealingExecutor executor(1);
+    auto low = executor.create_queue(0, 1);
+    auto high = executor.create_queue(10, 1);
+
+    // Hold the only worker while both queues fill up
+    std::atomic<bool> release{false};
+    executor.submit(low, [&]() {
+        while (!release.load()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+    ASSERT_TRUE(wait_for([&]() { return low->running() == 1; }));
+
+    std::mutex mutex;
+    std::vector<int> order;
+    for (int i = 0; i < 3; ++i) {
+        executor.submit(low, [&, i]() { std::lock_guard<std::mutex> l(mutex); order.push_back(i); });
+        executor.submit(high, [&, i]() { std::lock_guard<std::mutex> l(mutex); order.push_back(100 + i); });
+    }
+    release.store(true);
+
+    ASSERT_TRUE(wait_for([&]() { std::lock_guard<std::mutex> l(mutex); return order.size() == 6; }));
+    EXPECT_EQ(order, (std::vector<int>{100, 101, 102, 0, 1, 2}));
+}
+
+TEST(WorkStealingExecutorTest, CpuLimitBoundsWorkerTime) {
+    WorkStealingExecutor executor(2);
+    auto queue = executor.create_queue(0, 2);
+    executor.set_cpu_limit(*queue, 0.25);
+    EXPECT_DOUBLE_EQ(queue->cpu_limit(), 0.25);
+
+    // 80 tasks of 10ms would keep both workers busy for 400ms unthrottled
+    std::atomic<int> done{0};
+    for (int i = 0; i < 80; ++i) {
+        executor.submit(queue, [&]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            done.fetch_add(1);
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(400));
+
+    // 0.25 x 400ms, plus the 25ms burst and two tasks in flight
+    uint64_t busy_ms = queue->busy_ns() / 1000000;
+    EXPECT_GT(busy_ms, 0u);
+    EXPECT_LE(busy_ms, 200u);
+    EXPECT_LT(done.load(), 40);
+    EXPECT_GT(queue->throttled(), 0u);
+
+    executor.set_cpu_limit(*queue, -1.0);
+    EXPECT_TRUE(wait_for([&]() { return done.load() == 80; }));
+}
+
+TEST(WorkStealingExecutorTest, PausedQueueKeepsItsTasks) {
+    WorkStealingExecutor executor(1);
+    auto queue = executor.create_queue(0, 1);
+    executor.set_cpu_limit(*queue, 0.0);
+
+    std::atomic<int> ran{0};
+    for (int i = 0; i < 3; ++i) {
+        executor.submit(queue, [&]() { ran.fetch_add(1); });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_EQ(ran.load(), 0);
+    EXPECT_EQ(queue->pending(), 3u);
+
+    executor.set_cpu_limit(*queue, -1.0);
+    EXPECT_TRUE(wait_for([&]() { return ran.load() == 3; }));
+}
+
+TEST(WorkStealingExecutorTest, LowPriorityTasksYieldToWaitingWork) {
+    WorkStealingExecutor executor(1);
+    auto low = executor.create_queue(0, 1);
+    auto high = executor.create_queue(10, 1);
+
+    // A long task that checks between steps whether to hand its worker over
+    std::atomic<bool> yielded{false};
+    std::atomic<bool> started{false};
+    std::atomic<bool> finished{false};
+    executor.submit(low, [&]() {
+        started.store(true);
+        wait_for([&]() { return executor.should_yield(*low); });
+        yielded.store(executor.should_yield(*low));
+        finished.store(true);
+    });
+    ASSERT_TRUE(wait_for([&]() { return started.load(); }));
+    EXPECT_FALSE(executor.should_yield(*high));
+
+    std::atomic<bool> ran{false};
+    executor.submit(high, [&]() { ran.store(true); });
+    ASSERT_TRUE(wait_for([&]() { return ran.load() && finished.load(); }));
+    EXPECT_TRUE(yielded.load());
+    EXPECT_GE(low->yields(), 1u);
+}
+
+TEST(WorkStealingExecutorTest, ClosedQueueDropsPendingTasks) {
+    WorkStealingExecutor executor(1);
+    auto queue = executor.create_queue(0, 1);
+
+    std::atomic<bool> release{false};
+    std::atomic<int> ran{0};
+    executor.submit(queue, [&]() {
+        while (!release.load()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        ran.fetch_add(1);
+    });
+    ASSERT_TRUE(wait_for([&]() { return queue->running() == 1; }));
+    for (int i = 0; i < 5; ++i) {
+        executor.submit(queue, [&]() { ran.fetch_add(1); });
+    }
+
+    executor.close_queue(*queue);
+    EXPECT_EQ(queue->pending(), 0u);
+    EXPECT_FALSE(executor.submit(queue, [&]() { ran.fetch_add(1); }));
+
+    release.store(true);
+    ASSERT_TRUE(wait_for([&]() { return queue->running() == 0; }));
+    EXPECT_EQ(ran.load(), 1);
+}
+
+TEST(WorkStealingExecutorTest, StopRejectsNewTasks) {
+    auto queue_holder = std::shared_ptr<TaskQueue>();
+    {
+        WorkStealingExecutor executor(2);
+        queue_holder = executor.create_queue(0, 2);
+        executor.stop();
+        EXPECT_FALSE(executor.submit(queue_holder, []() {}));
+    }
+    EXPECT_FALSE(queue_holder->is_open());
+}
+
+}  // namespace test
+}  // namespace sage_tsdb
@@ -0,0 +1,169 @@
+#include "sage_tsdb/core/write_buffer_manager.h"
+#include "sage_tsdb/core/resource_manager.h"
+#include "sage_tsdb/core/table_manager.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <filesystem>
+#include <thread>
+
+namespace sage_tsdb {
+namespace test {
+
+namespace {
+
+// A memtable stand-in whose flush immediately moves its bytes to the queue
+struct FakeTable {
+    WriteBufferManager* manager;
+    size_t bytes = 0;
+    WriteBufferManager::Clock::time_point since = WriteBufferManager::Clock::now();
+    int flushes = 0;
+
+    void write(size_t n) {
+        manager->reserve(n);
+        bytes += n;
+    }
+
+    WriteBufferManager::Client client() {
+        WriteBufferManager::Client c;
+        c.mutable_bytes = [this]() { return bytes; };
+        c.mutable_since = [this]() { return since; };
+        c.request_flush = [this]() {
+            if (bytes == 0) {
+                return false;
+            }
+            manager->schedule_free(bytes);
+            bytes = 0;
+            ++flushes;
+            return true;
+        };
+        return c;
+    }
+};
+
+} // namespace
+
+TEST(WriteBufferManagerTest, TracksMutableAndQueuedBytes) {
+    WriteBufferManager manager(1000, 0.5);
+    FakeTable table{&manager};
+    manager.add_client(table.client());
+
+    table.write(300);
+    EXPECT_EQ(manager.get_memory_usage(), 300u);
+    EXPECT_EQ(manager.get_mutable_memory_usage(), 300u);
+    EXPECT_FALSE(manager.should_flush());
+
+    table.write(300);
+    EXPECT_TRUE(manager.should_flush());
+    EXPECT_TRUE(manager.is_under_pressure());
+
+    // Rotated bytes still count against the budget until they are freed
+    ASSERT_TRUE(manager.flush_one());
+    EXPECT_EQ(manager.get_mutable_memory_usage(), 0u);
+    EXPECT_EQ(manager.get_memory_usage(), 600u);
+    EXPECT_FALSE(manager.should_flush());
+
+    manager.free(600);
+    EXPECT_EQ(manager.get_memory_usage(), 0u);
+    EXPECT_FALSE(manager.is_under_pressure());
+}
+
+TEST(WriteBufferManagerTest, LargestPolicyPicksBiggestMemtable) {
+    WriteBufferManager manager(1000, 0.5, WriteBufferManager::FlushPolicy::Largest);
+    FakeTable small{&manager}, large{&manager};
+    manager.add_client(small.client());
+    manager.add_client(large.client());
+
+    small.write(100);
+    large.write(400);
+    ASSERT_TRUE(manager.flush_one());
+    EXPECT_EQ(large.flushes, 1);
+    EXPECT_EQ(small.flushes, 0);
+}
+
+TEST(WriteBufferManagerTest, OldestPolicyPicksEarliestMemtable) {
+    WriteBufferManager manager(1000, 0.5, WriteBufferManager::FlushPolicy::Oldest);
+    FakeTable old_table{&manager}, new_table{&manager};
+    old_table.since -= std::chrono::seconds(10);
+    manager.add_client(old_table.client());
+    manager.add_client(new_table.client());
+
+    old_table.write(100);
+    new_table.write(400);
+    ASSERT_TRUE(manager.flush_one());
+    EXPECT_EQ(old_table.flushes, 1);
+    EXPECT_EQ(new_table.flushes, 0);
+}
+
+TEST(WriteBufferManagerTest, WritersStallAtHardLimit) {
+    WriteBufferManager manager(1000);
+    FakeTable table{&manager};
+    manager.add_client(table.client());
+    table.write(1000);
+
+    // The stalled writer rotates the memtable itself; it resumes once freed
+    std::thread releaser([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        manager.free(1000);
+    });
+    auto start = std::chrono::steady_clock::now();
+    manager.wait_for_room();
+    releaser.join();
+
+    EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(40));
+    EXPECT_EQ(table.flushes, 1);
+    EXPECT_EQ(manager.get_stall_count(), 1u);
+    EXPECT_GT(manager.get_total_stall_micros(), 0u);
+}
+
+TEST(WriteBufferManagerTest, ZeroBudgetOnlyTracks) {
+    WriteBufferManager manager(0);
+    manager.reserve(1ULL << 30);
+    EXPECT_FALSE(manager.should_flush());
+    EXPECT_FALSE(manager.is_under_pressure());
+    manager.wait_for_room();
+    EXPECT_EQ(manager.get_stall_count(), 0u);
+}
+
+TEST(WriteBufferManagerTest, TableManagerSharesBudgetAcrossTables) {
+    const std::string dir = "./test_write_buffer_data";
+    std::filesystem::remove_all(dir);
+    {
+        TableManager manager(dir, 0);
+        const size_t budget = 256 * 1024;
+        manager.setGlobalMemoryLimit(budget);
+
+        TableConfig config;
+        config.memtable_size_bytes = 64 * 1024 * 1024;  // Never fills on its own
+        config.enable_wal = false;
+        ASSERT_TRUE(manager.createStreamTable("s1", config));
+        ASSERT_TRUE(manager.createStreamTable("s2", config));
+        auto s1 = manager.getStreamTable("s1");
+        auto s2 = manager.getStreamTable("s2");
+
+        auto rm = core::createResourceManager();
+        rm->attachWriteBuffer(manager.getWriteBufferManager());
+
+        for (int i = 0; i < 20000; i++) {
+            TimeSeriesData data(i, static_cast<double>(i), Tags{{"key", std::to_string(i % 8)}});
+            s1->insert(data);
+            if (i % 4 == 0) {
+                s2->insert(data);
+            }
+        }
+
+        // The budget, not the 64MB memtables, bounded memory use
+        auto stats = manager.getGlobalStats();
+        EXPECT_GT(stats.write_buffer_flushes, 0u);
+        EXPECT_LE(manager.getCurrentMemoryUsage(), budget * 2);
+        EXPECT_EQ(s1->count(TimeRange(0, 19999)), 20000u);
+        EXPECT_EQ(s2->count(TimeRange(0, 19999)), 5000u);
+
+        manager.flushAllTables();
+        EXPECT_EQ(manager.getWriteBufferManager()->get_memory_usage(), 0u);
+        EXPECT_FALSE(rm->isUnderPressure());
+    }
+    std::filesystem::remove_all(dir);
+}
+
+} // namespace test
+} // namespace sage_tsdb